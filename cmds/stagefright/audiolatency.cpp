@@ -0,0 +1,376 @@
+/*
+ * Copyright (C) 2012 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Measures the round trip latency from AudioTrack to AudioRecord, through
+// the normal mixer and through the fast mixer. Short impulses are played at
+// a fixed period and detected in what the microphone (or a loopback cable)
+// captures; the time between handing an impulse to AudioTrack and reading it
+// back from AudioRecord is one round trip. The distribution of the round
+// trips is reported next to AudioTrack::latency() plus
+// AudioRecord::latency(), to validate the low latency configuration of a
+// device.
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "audiolatency"
+#include <utils/Log.h>
+
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <binder/ProcessState.h>
+#include <media/AudioRecord.h>
+#include <media/AudioSystem.h>
+#include <media/AudioTrack.h>
+#include <media/stagefright/foundation/ALooper.h>
+#include <utils/threads.h>
+#include <utils/Vector.h>
+
+static void usage(const char *me) {
+    fprintf(stderr, "usage: %s [-F] fast track only\n"
+                    "\t\t[-N] normal track only\n"
+                    "\t\t[-n impulses per track (default 20)]\n"
+                    "\t\t[-p impulse period in ms (default 500)]\n"
+                    "\t\t[-t detection threshold, 1 to 32767 (default 8000)]\n"
+                    "\t\t[-r sample rate (default output rate)]\n"
+                    "\t\t[-o CSV output file]\n",
+                    me);
+
+    exit(1);
+}
+
+namespace android {
+
+struct Impulses {
+    Impulses(uint32_t sampleRate, uint32_t periodFrames, int maxNumImpulses)
+        : mSampleRate(sampleRate),
+          mPeriodFrames(periodFrames),
+          mMaxNumImpulses(maxNumImpulses),
+          mNumFramesPlayed(0),
+          mNumImpulsesPlayed(0) {
+    }
+
+    // Called on the AudioTrack callback thread.
+    void fill(int16_t *data, size_t numFrames) {
+        memset(data, 0, numFrames * sizeof(int16_t));
+
+        for (size_t i = 0; i < numFrames; ++i, ++mNumFramesPlayed) {
+            if ((mNumFramesPlayed % mPeriodFrames) != kLeadInFrames
+                    || mNumImpulsesPlayed == mMaxNumImpulses) {
+                continue;
+            }
+
+            for (size_t j = i; j < numFrames && j < i + kImpulseFrames; ++j) {
+                data[j] = kImpulseLevel;
+            }
+
+            // The impulse enters the track now, i frames into the buffer.
+            Mutex::Autolock autoLock(mLock);
+            mPlayTimesUs.push(
+                    ALooper::GetNowUs() + (int64_t)i * 1000000ll / mSampleRate);
+            ++mNumImpulsesPlayed;
+        }
+    }
+
+    // Returns the play time of the earliest impulse played before
+    // captureTimeUs and at most a period earlier, or -1. Impulses which
+    // were never captured are dropped on the way.
+    int64_t match(int64_t captureTimeUs) {
+        int64_t periodUs = (int64_t)mPeriodFrames * 1000000ll / mSampleRate;
+
+        Mutex::Autolock autoLock(mLock);
+        while (!mPlayTimesUs.isEmpty()) {
+            int64_t playTimeUs = mPlayTimesUs.itemAt(0);
+            if (playTimeUs > captureTimeUs) {
+                return -1;
+            }
+
+            mPlayTimesUs.removeAt(0);
+            if (captureTimeUs - playTimeUs < periodUs) {
+                return playTimeUs;
+            }
+        }
+        return -1;
+    }
+
+    bool done() {
+        Mutex::Autolock autoLock(mLock);
+        return mNumImpulsesPlayed == mMaxNumImpulses;
+    }
+
+private:
+    enum {
+        kLeadInFrames = 64,
+        kImpulseFrames = 32,
+        kImpulseLevel = 29000,
+    };
+
+    uint32_t mSampleRate;
+    uint32_t mPeriodFrames;
+    int mMaxNumImpulses;
+    uint64_t mNumFramesPlayed;
+    int mNumImpulsesPlayed;
+
+    Mutex mLock;
+    Vector<int64_t> mPlayTimesUs;
+};
+
+}  // namespace android
+
+using namespace android;
+
+static void audioCallback(int event, void *user, void *info) {
+    if (event != AudioTrack::EVENT_MORE_DATA) {
+        return;
+    }
+
+    AudioTrack::Buffer *buffer = static_cast<AudioTrack::Buffer *>(info);
+    static_cast<Impulses *>(user)->fill(buffer->i16, buffer->frameCount);
+}
+
+static int CompareIncreasing(const int64_t *a, const int64_t *b) {
+    return (*a) < (*b) ? -1 : (*a) > (*b) ? 1 : 0;
+}
+
+static status_t measure(
+        FILE *csv, bool fast, uint32_t sampleRate, uint32_t periodMs,
+        int numImpulses, int threshold) {
+    const char *path = fast ? "fast" : "normal";
+    uint32_t periodFrames = sampleRate * periodMs / 1000;
+
+    int minRecordFrames;
+    if (AudioRecord::getMinFrameCount(&minRecordFrames, sampleRate,
+                AUDIO_FORMAT_PCM_16_BIT, 1) != OK) {
+        minRecordFrames = 0;
+    }
+
+    // Read in small chunks, so that the capture time of each frame can be
+    // told apart.
+    size_t chunkFrames = minRecordFrames > 0 ? minRecordFrames / 2 : 256;
+    Vector<int16_t> chunk;
+    chunk.insertAt(0, 0, chunkFrames);
+
+    AudioRecord record(AUDIO_SOURCE_MIC, sampleRate, AUDIO_FORMAT_PCM_16_BIT,
+                       AUDIO_CHANNEL_IN_MONO, minRecordFrames);
+    if (record.initCheck() != OK) {
+        fprintf(stderr, "unable to create an AudioRecord at %u Hz.\n",
+                sampleRate);
+        return record.initCheck();
+    }
+
+    Impulses impulses(sampleRate, periodFrames, numImpulses);
+    AudioTrack track(AUDIO_STREAM_MUSIC, sampleRate, AUDIO_FORMAT_PCM_16_BIT,
+                     AUDIO_CHANNEL_OUT_MONO, 0 /* frameCount */,
+                     fast ? AUDIO_OUTPUT_FLAG_FAST : AUDIO_OUTPUT_FLAG_NONE,
+                     audioCallback, &impulses);
+    if (track.initCheck() != OK) {
+        fprintf(stderr, "unable to create an AudioTrack at %u Hz.\n",
+                sampleRate);
+        return track.initCheck();
+    }
+
+    record.start();
+    track.start();
+
+    Vector<int64_t> roundTripsUs;
+    int64_t lastDetectionUs = -1;
+    int64_t periodUs = (int64_t)periodMs * 1000ll;
+    int64_t stopUs = -1;
+
+    for (;;) {
+        ssize_t n = record.read(chunk.editArray(), chunkFrames * sizeof(int16_t));
+        int64_t nowUs = ALooper::GetNowUs();
+        if (n <= 0) {
+            break;
+        }
+
+        size_t numFrames = n / sizeof(int16_t);
+        for (size_t i = 0; i < numFrames; ++i) {
+            int sample = chunk.itemAt(i);
+            if (abs(sample) < threshold) {
+                continue;
+            }
+
+            int64_t captureTimeUs =
+                nowUs - (int64_t)(numFrames - i) * 1000000ll / sampleRate;
+
+            // Ignore the rest of the impulse and its echoes.
+            if (lastDetectionUs >= 0
+                    && captureTimeUs - lastDetectionUs < periodUs / 2) {
+                continue;
+            }
+            lastDetectionUs = captureTimeUs;
+
+            int64_t playTimeUs = impulses.match(captureTimeUs);
+            if (playTimeUs >= 0) {
+                roundTripsUs.push(captureTimeUs - playTimeUs);
+            }
+        }
+
+        // Keep listening for one period after the last impulse.
+        if (stopUs < 0 && impulses.done()) {
+            stopUs = nowUs + periodUs;
+        }
+        if (stopUs >= 0 && nowUs >= stopUs) {
+            break;
+        }
+    }
+
+    track.stop();
+    record.stop();
+
+    uint32_t reportedMs = track.latency() + record.latency();
+
+    printf("%-7s frames %5u latency %4u ms + %4u ms: ", path,
+           track.frameCount(), track.latency(), record.latency());
+
+    if (roundTripsUs.isEmpty()) {
+        printf("no impulse detected of %d played\n", numImpulses);
+    } else {
+        roundTripsUs.sort(CompareIncreasing);
+
+        size_t count = roundTripsUs.size();
+        int64_t sumUs = 0;
+        for (size_t i = 0; i < count; ++i) {
+            sumUs += roundTripsUs.itemAt(i);
+        }
+
+        printf("%u/%d detected, round trip min %.2f p50 %.2f p90 %.2f "
+               "max %.2f mean %.2f ms\n",
+               count, numImpulses, roundTripsUs.itemAt(0) / 1E3,
+               roundTripsUs.itemAt((count - 1) / 2) / 1E3,
+               roundTripsUs.itemAt((count - 1) * 9 / 10) / 1E3,
+               roundTripsUs.itemAt(count - 1) / 1E3,
+               sumUs / 1E3 / count);
+    }
+
+    if (csv != NULL) {
+        for (size_t i = 0; i < roundTripsUs.size(); ++i) {
+            fprintf(csv, "%s,%u,%u,%u,%u,%lld\n", path, sampleRate,
+                    track.frameCount(), reportedMs, i, roundTripsUs.itemAt(i));
+        }
+        fflush(csv);
+    }
+
+    return OK;
+}
+
+int main(int argc, char **argv) {
+    const char *me = argv[0];
+
+    bool useNormal = true;
+    bool useFast = true;
+    int numImpulses = 20;
+    int periodMs = 500;
+    int threshold = 8000;
+    int sampleRate = 0;
+    const char *csvPath = NULL;
+
+    int res;
+    while ((res = getopt(argc, argv, "hFNn:p:t:r:o:")) >= 0) {
+        switch (res) {
+            case 'F':
+            {
+                useNormal = false;
+                break;
+            }
+
+            case 'N':
+            {
+                useFast = false;
+                break;
+            }
+
+            case 'n':
+            {
+                numImpulses = atoi(optarg);
+                break;
+            }
+
+            case 'p':
+            {
+                periodMs = atoi(optarg);
+                break;
+            }
+
+            case 't':
+            {
+                threshold = atoi(optarg);
+                break;
+            }
+
+            case 'r':
+            {
+                sampleRate = atoi(optarg);
+                break;
+            }
+
+            case 'o':
+            {
+                csvPath = optarg;
+                break;
+            }
+
+            case '?':
+            case 'h':
+            default:
+            {
+                usage(me);
+            }
+        }
+    }
+
+    if (optind != argc || (!useNormal && !useFast) || numImpulses < 1
+            || periodMs < 50 || threshold < 1 || threshold > 32767
+            || sampleRate < 0) {
+        usage(me);
+    }
+
+    ProcessState::self()->startThreadPool();
+
+    // Fast tracks are only granted at the output's own rate.
+    if (sampleRate == 0
+            && AudioSystem::getOutputSamplingRate(&sampleRate) != OK) {
+        sampleRate = 44100;
+    }
+
+    FILE *csv = NULL;
+    if (csvPath != NULL) {
+        csv = fopen(csvPath, "w");
+        if (csv == NULL) {
+            fprintf(stderr, "unable to open '%s'.\n", csvPath);
+            return 1;
+        }
+
+        fprintf(csv, "path,sample_rate,track_frames,reported_latency_ms,"
+                     "impulse,round_trip_us\n");
+    }
+
+    int result = 0;
+    if (useNormal && measure(csv, false /* fast */, sampleRate, periodMs,
+                             numImpulses, threshold) != OK) {
+        result = 1;
+    }
+    if (useFast && measure(csv, true /* fast */, sampleRate, periodMs,
+                           numImpulses, threshold) != OK) {
+        result = 1;
+    }
+
+    if (csv != NULL) {
+        fclose(csv);
+    }
+
+    return result;
+}
@@ -0,0 +1,334 @@
+/*
+ * Copyright (C) 2012 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Compares ABitReader with the byte at a time reader it replaced, on the
+// bit patterns of ATSParser::parseTS over random transport stream packets
+// and of SPS parsing over random Exp-Golomb codes. Both readers must return
+// the same values; the time per packet and per code is reported for each.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <media/stagefright/foundation/ABitReader.h>
+
+using namespace android;
+
+// The reader ABitReader used to be: a 32-bit reservoir refilled one byte
+// at a time and a loop in getBits.
+struct LegacyBitReader {
+    LegacyBitReader(const uint8_t *data, size_t size)
+        : mData(data),
+          mSize(size),
+          mReservoir(0),
+          mNumBitsLeft(0) {
+    }
+
+    uint32_t getBits(size_t n) {
+        uint32_t result = 0;
+        while (n > 0) {
+            if (mNumBitsLeft == 0) {
+                fillReservoir();
+            }
+
+            size_t m = n;
+            if (m > mNumBitsLeft) {
+                m = mNumBitsLeft;
+            }
+
+            result = (result << m) | (mReservoir >> (32 - m));
+            mReservoir <<= m;
+            mNumBitsLeft -= m;
+
+            n -= m;
+        }
+
+        return result;
+    }
+
+    void skipBits(size_t n) {
+        while (n > 32) {
+            getBits(32);
+            n -= 32;
+        }
+
+        if (n > 0) {
+            getBits(n);
+        }
+    }
+
+    uint32_t getUE() {
+        unsigned numZeroes = 0;
+        while (getBits(1) == 0) {
+            ++numZeroes;
+        }
+
+        unsigned x = getBits(numZeroes);
+
+        return x + (1u << numZeroes) - 1;
+    }
+
+    size_t numBitsLeft() const {
+        return mSize * 8 + mNumBitsLeft;
+    }
+
+private:
+    const uint8_t *mData;
+    size_t mSize;
+
+    uint32_t mReservoir;
+    size_t mNumBitsLeft;
+
+    void fillReservoir() {
+        if (mSize == 0) {
+            fprintf(stderr, "read past the end of the data\n");
+            exit(1);
+        }
+
+        mReservoir = 0;
+        size_t i;
+        for (i = 0; mSize > 0 && i < 4; ++i) {
+            mReservoir = (mReservoir << 8) | *mData;
+
+            ++mData;
+            --mSize;
+        }
+
+        mNumBitsLeft = 8 * i;
+        mReservoir <<= 32 - mNumBitsLeft;
+    }
+};
+
+static const size_t kTSPacketSize = 188;
+
+static int64_t getNowNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ll + ts.tv_nsec;
+}
+
+// The transport packet header and adaptation field as ATSParser reads them,
+// then a section of 8-bit fields in the payload, as in a PSI table.
+template <class Reader>
+static uint32_t parseTS(const uint8_t *data) {
+    Reader br(data, kTSPacketSize);
+
+    uint32_t sum = br.getBits(8);           // sync_byte
+    sum += br.getBits(1);                   // transport_error_indicator
+    sum += br.getBits(1);                   // payload_unit_start_indicator
+    br.skipBits(1);                         // transport_priority
+    sum += br.getBits(13);                  // PID
+    br.skipBits(2);                         // transport_scrambling_control
+    unsigned adaptation = br.getBits(2);    // adaptation_field_control
+    sum += br.getBits(4);                   // continuity_counter
+
+    if (adaptation == 2 || adaptation == 3) {
+        unsigned length = br.getBits(8) % 100;
+        if (length > 0) {
+            sum += br.getBits(1);           // discontinuity_indicator
+            br.skipBits(length * 8 - 1);
+        }
+    }
+
+    while (br.numBitsLeft() >= 40) {
+        sum += br.getBits(8);
+        sum += br.getBits(3);
+        sum += br.getBits(13);
+        br.skipBits(4);
+        sum += br.getBits(12);
+    }
+    br.skipBits(br.numBitsLeft());
+
+    return sum;
+}
+
+template <class Reader>
+static uint32_t parseCodes(const uint8_t *data, size_t size, size_t numCodes) {
+    Reader br(data, size);
+
+    uint32_t sum = 0;
+    for (size_t i = 0; i < numCodes; ++i) {
+        sum += br.getUE();
+        sum += br.getBits(1);
+    }
+
+    return sum;
+}
+
+// Writes an Exp-Golomb code and a flag for each value, MSB first.
+struct BitWriter {
+    BitWriter(uint8_t *data) : mData(data), mNumBits(0) {}
+
+    void putBits(uint32_t x, size_t n) {
+        while (n > 0) {
+            --n;
+            if ((x >> n) & 1) {
+                mData[mNumBits / 8] |= 0x80 >> (mNumBits % 8);
+            }
+            ++mNumBits;
+        }
+    }
+
+    void putUE(uint32_t x) {
+        uint32_t code = x + 1;
+        size_t numBits = 32 - __builtin_clz(code);
+        putBits(0, numBits - 1);
+        putBits(code, numBits);
+    }
+
+    size_t size() const {
+        return (mNumBits + 7) / 8;
+    }
+
+private:
+    uint8_t *mData;
+    size_t mNumBits;
+};
+
+template <class Reader>
+static double benchTS(const uint8_t *packets, size_t numPackets,
+        int64_t durationNs, uint32_t *sum) {
+    int64_t numParsed = 0;
+    int64_t startNs = getNowNs();
+    int64_t elapsedNs;
+    *sum = 0;
+    do {
+        for (size_t i = 0; i < numPackets; ++i) {
+            *sum += parseTS<Reader>(packets + i * kTSPacketSize);
+        }
+        numParsed += numPackets;
+        elapsedNs = getNowNs() - startNs;
+    } while (elapsedNs < durationNs);
+
+    return (double)elapsedNs / numParsed;
+}
+
+template <class Reader>
+static double benchCodes(const uint8_t *data, size_t size, size_t numCodes,
+        int64_t durationNs, uint32_t *sum) {
+    int64_t numParsed = 0;
+    int64_t startNs = getNowNs();
+    int64_t elapsedNs;
+    *sum = 0;
+    do {
+        *sum += parseCodes<Reader>(data, size, numCodes);
+        numParsed += numCodes;
+        elapsedNs = getNowNs() - startNs;
+    } while (elapsedNs < durationNs);
+
+    return (double)elapsedNs / numParsed;
+}
+
+static void usage(const char *me) {
+    fprintf(stderr, "usage: %s [-d ms per workload (default 500)]\n"
+                    "\t\t[-n TS packets (default 1024)]\n"
+                    "\t\t[-c Exp-Golomb codes (default 16384)]\n",
+                    me);
+
+    exit(1);
+}
+
+int main(int argc, char **argv) {
+    int64_t durationNs = 500000000ll;
+    size_t numPackets = 1024;
+    size_t numCodes = 16384;
+
+    int res;
+    while ((res = getopt(argc, argv, "hd:n:c:")) >= 0) {
+        switch (res) {
+            case 'd':
+            {
+                durationNs = atoll(optarg) * 1000000ll;
+                break;
+            }
+
+            case 'n':
+            {
+                numPackets = atoi(optarg);
+                break;
+            }
+
+            case 'c':
+            {
+                numCodes = atoi(optarg);
+                break;
+            }
+
+            case '?':
+            case 'h':
+            default:
+            {
+                usage(argv[0]);
+            }
+        }
+    }
+
+    if (optind != argc || durationNs <= 0 || numPackets < 1 || numCodes < 1) {
+        usage(argv[0]);
+    }
+
+    srand48(1);
+
+    uint8_t *packets = new uint8_t[numPackets * kTSPacketSize];
+    for (size_t i = 0; i < numPackets * kTSPacketSize; ++i) {
+        packets[i] = lrand48() & 0xff;
+    }
+    for (size_t i = 0; i < numPackets; ++i) {
+        packets[i * kTSPacketSize] = 0x47;
+    }
+
+    // Mostly small values, as in an SPS, with an occasional large one.
+    uint8_t *codes = new uint8_t[numCodes * 9 + 8];
+    memset(codes, 0, numCodes * 9 + 8);
+    BitWriter writer(codes);
+    for (size_t i = 0; i < numCodes; ++i) {
+        uint32_t x = (lrand48() % 16 == 0) ? lrand48() % 100000 : lrand48() % 8;
+        writer.putUE(x);
+        writer.putBits(lrand48() & 1, 1);
+    }
+
+    for (size_t i = 0; i < numPackets; ++i) {
+        const uint8_t *packet = packets + i * kTSPacketSize;
+        if (parseTS<LegacyBitReader>(packet) != parseTS<ABitReader>(packet)) {
+            fprintf(stderr, "TS packet %u parses differently\n", i);
+            return 1;
+        }
+    }
+    if (parseCodes<LegacyBitReader>(codes, writer.size(), numCodes)
+            != parseCodes<ABitReader>(codes, writer.size(), numCodes)) {
+        fprintf(stderr, "Exp-Golomb codes parse differently\n");
+        return 1;
+    }
+
+    printf("%-10s %12s %12s %8s\n", "workload", "legacy ns", "ns", "speedup");
+
+    uint32_t legacySum, sum;
+    double legacyNs = benchTS<LegacyBitReader>(packets, numPackets, durationNs, &legacySum);
+    double ns = benchTS<ABitReader>(packets, numPackets, durationNs, &sum);
+    printf("%-10s %12.1f %12.1f %7.2fx\n", "ts", legacyNs, ns, legacyNs / ns);
+
+    legacyNs = benchCodes<LegacyBitReader>(codes, writer.size(), numCodes, durationNs,
+            &legacySum);
+    ns = benchCodes<ABitReader>(codes, writer.size(), numCodes, durationNs, &sum);
+    printf("%-10s %12.1f %12.1f %7.2fx\n", "ue", legacyNs, ns, legacyNs / ns);
+
+    delete[] codes;
+    delete[] packets;
+
+    return 0;
+}
@@ -0,0 +1,681 @@
+/*
+ * Copyright (C) 2012 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Decodes every reference stream given on the command line with every
+// decoder MediaCodecList lists for its video (or audio) track, both through
+// OMXCodec and through MediaCodec/ACodec, and reports per stream, component
+// and path the frame rate, the CPU time, the peak RSS and percentiles of the
+// per frame latency. The results are averaged over the repetitions that
+// follow the warmup runs, and can be written as CSV to track regressions.
+//
+// The decoders run in mediaserver, so besides this process' CPU time the
+// CPU time the whole device spent while decoding is reported, from
+// /proc/stat.
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "codecbench"
+#include <utils/Log.h>
+
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include <binder/ProcessState.h>
+#include <media/stagefright/foundation/ABuffer.h>
+#include <media/stagefright/foundation/ADebug.h>
+#include <media/stagefright/foundation/ALooper.h>
+#include <media/stagefright/foundation/AMessage.h>
+#include <media/stagefright/foundation/AString.h>
+#include <media/stagefright/DataSource.h>
+#include <media/stagefright/MediaBuffer.h>
+#include <media/stagefright/MediaCodec.h>
+#include <media/stagefright/MediaCodecList.h>
+#include <media/stagefright/MediaDefs.h>
+#include <media/stagefright/MediaErrors.h>
+#include <media/stagefright/MediaExtractor.h>
+#include <media/stagefright/MediaSource.h>
+#include <media/stagefright/MetaData.h>
+#include <media/stagefright/NuMediaExtractor.h>
+#include <media/stagefright/OMXClient.h>
+#include <media/stagefright/OMXCodec.h>
+#include <utils/KeyedVector.h>
+#include <utils/Vector.h>
+
+static void usage(const char *me) {
+    fprintf(stderr, "usage: %s [-a] benchmark audio instead of video tracks\n"
+                    "\t\t[-w warmup runs (default 1)]\n"
+                    "\t\t[-n measured runs (default 3)]\n"
+                    "\t\t[-m max frames per run (default all)]\n"
+                    "\t\t[-c only components whose name contains this]\n"
+                    "\t\t[-s] software components only\n"
+                    "\t\t[-H] hardware components only\n"
+                    "\t\t[-O] OMXCodec only\n"
+                    "\t\t[-A] MediaCodec (ACodec) only\n"
+                    "\t\t[-o CSV output file]\n"
+                    "\t\tstream...\n",
+                    me);
+
+    exit(1);
+}
+
+namespace android {
+
+struct BenchOptions {
+    bool mUseAudio;
+    int mNumWarmupRuns;
+    int mNumRuns;
+    int64_t mMaxNumFrames;  // 0 means decode all available.
+    const char *mComponentFilter;
+    bool mSoftwareOnly;
+    bool mHardwareOnly;
+    bool mUseOMXCodec;
+    bool mUseACodec;
+};
+
+struct RunStats {
+    int64_t mNumFrames;
+    int64_t mElapsedUs;
+    int64_t mProcessCpuUs;
+    int64_t mSystemCpuUs;
+    Vector<int64_t> mLatenciesUs;
+};
+
+struct StreamInfo {
+    AString mPath;
+    size_t mTrackIndex;
+    AString mMime;
+    int32_t mWidth;
+    int32_t mHeight;
+    int32_t mSampleRate;
+    int32_t mChannelCount;
+};
+
+}  // namespace android
+
+using namespace android;
+
+static const int64_t kTimeoutUs = 10000ll;
+
+static int64_t getProcessCpuUs() {
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return 0;
+    }
+
+    return (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000000ll
+        + usage.ru_utime.tv_usec + usage.ru_stime.tv_usec;
+}
+
+static long getPeakRssKB() {
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return 0;
+    }
+
+    return usage.ru_maxrss;
+}
+
+// Time all CPUs spent outside of the idle and iowait states.
+static int64_t getSystemCpuUs() {
+    FILE *file = fopen("/proc/stat", "r");
+    if (file == NULL) {
+        return 0;
+    }
+
+    unsigned long long user = 0, nice = 0, system = 0, idle = 0;
+    unsigned long long iowait = 0, irq = 0, softirq = 0;
+    int n = fscanf(file, "cpu %llu %llu %llu %llu %llu %llu %llu",
+                   &user, &nice, &system, &idle, &iowait, &irq, &softirq);
+    fclose(file);
+
+    if (n < 4) {
+        return 0;
+    }
+
+    long ticksPerSecond = sysconf(_SC_CLK_TCK);
+    if (ticksPerSecond <= 0) {
+        return 0;
+    }
+
+    unsigned long long busy = user + nice + system + irq + softirq;
+    return (int64_t)(busy * 1000000ll / ticksPerSecond);
+}
+
+static int CompareIncreasing(const int64_t *a, const int64_t *b) {
+    return (*a) < (*b) ? -1 : (*a) > (*b) ? 1 : 0;
+}
+
+// Expects sorted latencies.
+static int64_t percentile(const Vector<int64_t> &latenciesUs, int percent) {
+    if (latenciesUs.isEmpty()) {
+        return 0;
+    }
+
+    return latenciesUs.itemAt((latenciesUs.size() - 1) * percent / 100);
+}
+
+static bool isSoftwareComponent(const char *name) {
+    return !strncmp(name, "OMX.google.", 11);
+}
+
+static void startRun(RunStats *stats) {
+    stats->mNumFrames = 0;
+    stats->mLatenciesUs.clear();
+    stats->mElapsedUs = ALooper::GetNowUs();
+    stats->mProcessCpuUs = getProcessCpuUs();
+    stats->mSystemCpuUs = getSystemCpuUs();
+}
+
+static void finishRun(RunStats *stats) {
+    stats->mElapsedUs = ALooper::GetNowUs() - stats->mElapsedUs;
+    stats->mProcessCpuUs = getProcessCpuUs() - stats->mProcessCpuUs;
+    stats->mSystemCpuUs = getSystemCpuUs() - stats->mSystemCpuUs;
+}
+
+static bool findStream(const char *path, bool useAudio, StreamInfo *info) {
+    sp<NuMediaExtractor> extractor = new NuMediaExtractor;
+    if (extractor->setDataSource(path) != OK) {
+        fprintf(stderr, "unable to instantiate extractor for '%s'.\n", path);
+        return false;
+    }
+
+    for (size_t i = 0; i < extractor->countTracks(); ++i) {
+        sp<AMessage> format;
+        if (extractor->getTrackFormat(i, &format) != OK) {
+            continue;
+        }
+
+        AString mime;
+        CHECK(format->findString("mime", &mime));
+
+        if (strncasecmp(mime.c_str(), useAudio ? "audio/" : "video/", 6)) {
+            continue;
+        }
+
+        info->mPath = path;
+        info->mTrackIndex = i;
+        info->mMime = mime;
+        info->mWidth = info->mHeight = 0;
+        info->mSampleRate = info->mChannelCount = 0;
+        format->findInt32("width", &info->mWidth);
+        format->findInt32("height", &info->mHeight);
+        format->findInt32("sample-rate", &info->mSampleRate);
+        format->findInt32("channel-count", &info->mChannelCount);
+        return true;
+    }
+
+    fprintf(stderr, "'%s' has no %s track.\n",
+            path, useAudio ? "audio" : "video");
+    return false;
+}
+
+static void findDecoders(
+        const StreamInfo &info, const BenchOptions &options,
+        Vector<AString> *components) {
+    const MediaCodecList *list = MediaCodecList::getInstance();
+    if (list == NULL) {
+        return;
+    }
+
+    ssize_t index = 0;
+    while ((index = list->findCodecByType(
+                    info.mMime.c_str(), false /* encoder */, index)) >= 0) {
+        const char *name = list->getCodecName(index);
+        ++index;
+
+        if (options.mSoftwareOnly && !isSoftwareComponent(name)) {
+            continue;
+        }
+        if (options.mHardwareOnly && isSoftwareComponent(name)) {
+            continue;
+        }
+        if (options.mComponentFilter != NULL
+                && strstr(name, options.mComponentFilter) == NULL) {
+            continue;
+        }
+
+        components->push(AString(name));
+    }
+}
+
+// Every read() of the decoder blocks until it has produced a buffer, so the
+// time a read takes is the frame's latency.
+static status_t runOMXCodec(
+        OMXClient *client, const StreamInfo &info, const char *component,
+        int64_t maxNumFrames, RunStats *stats) {
+    sp<DataSource> dataSource = DataSource::CreateFromURI(info.mPath.c_str());
+    if (dataSource == NULL) {
+        return UNKNOWN_ERROR;
+    }
+
+    sp<MediaExtractor> extractor = MediaExtractor::Create(dataSource);
+    if (extractor == NULL) {
+        return UNKNOWN_ERROR;
+    }
+
+    sp<MediaSource> source = extractor->getTrack(info.mTrackIndex);
+    if (source == NULL) {
+        return UNKNOWN_ERROR;
+    }
+
+    sp<MediaSource> decoder = OMXCodec::Create(
+            client->interface(), source->getFormat(), false /* createEncoder */,
+            source, component);
+    if (decoder == NULL) {
+        return NAME_NOT_FOUND;
+    }
+
+    startRun(stats);
+
+    status_t err = decoder->start();
+    if (err != OK) {
+        return err;
+    }
+
+    for (;;) {
+        MediaBuffer *buffer;
+        int64_t startUs = ALooper::GetNowUs();
+        err = decoder->read(&buffer);
+        int64_t latencyUs = ALooper::GetNowUs() - startUs;
+
+        if (err == INFO_FORMAT_CHANGED) {
+            continue;
+        } else if (err != OK) {
+            break;
+        }
+
+        if (buffer->range_length() > 0) {
+            stats->mLatenciesUs.push(latencyUs);
+            ++stats->mNumFrames;
+        }
+
+        buffer->release();
+        buffer = NULL;
+
+        if (maxNumFrames > 0 && stats->mNumFrames == maxNumFrames) {
+            break;
+        }
+    }
+
+    decoder->stop();
+    finishRun(stats);
+
+    return (err == OK || err == ERROR_END_OF_STREAM) ? OK : err;
+}
+
+// The latency of a frame is the time from queueing its input buffer to
+// dequeueing the output buffer with the same timestamp.
+static status_t runACodec(
+        const sp<ALooper> &looper, const StreamInfo &info,
+        const char *component, int64_t maxNumFrames, RunStats *stats) {
+    sp<NuMediaExtractor> extractor = new NuMediaExtractor;
+    if (extractor->setDataSource(info.mPath.c_str()) != OK) {
+        return UNKNOWN_ERROR;
+    }
+
+    sp<AMessage> format;
+    status_t err = extractor->getTrackFormat(info.mTrackIndex, &format);
+    if (err != OK) {
+        return err;
+    }
+
+    err = extractor->selectTrack(info.mTrackIndex);
+    if (err != OK) {
+        return err;
+    }
+
+    sp<MediaCodec> codec = MediaCodec::CreateByComponentName(looper, component);
+    if (codec == NULL) {
+        return NAME_NOT_FOUND;
+    }
+
+    startRun(stats);
+
+    err = codec->configure(format, NULL /* surface */, NULL /* crypto */,
+                           0 /* flags */);
+    if (err == OK) {
+        err = codec->start();
+    }
+
+    Vector<sp<ABuffer> > inBuffers;
+    if (err == OK) {
+        err = codec->getInputBuffers(&inBuffers);
+    }
+
+    if (err != OK) {
+        codec->release();
+        return err;
+    }
+
+    KeyedVector<int64_t, int64_t> queueTimesUs;
+    bool signalledInputEOS = false;
+    bool sawOutputEOS = false;
+
+    while (err == OK && !sawOutputEOS) {
+        size_t index;
+
+        if (!signalledInputEOS
+                && codec->dequeueInputBuffer(&index, kTimeoutUs) == OK) {
+            const sp<ABuffer> &buffer = inBuffers.itemAt(index);
+
+            int64_t timeUs;
+            if (extractor->readSampleData(buffer) == OK
+                    && extractor->getSampleTime(&timeUs) == OK) {
+                queueTimesUs.add(timeUs, ALooper::GetNowUs());
+                err = codec->queueInputBuffer(
+                        index, 0 /* offset */, buffer->size(), timeUs,
+                        0 /* flags */);
+                extractor->advance();
+            } else {
+                err = codec->queueInputBuffer(
+                        index, 0 /* offset */, 0 /* size */, 0ll /* timeUs */,
+                        MediaCodec::BUFFER_FLAG_EOS);
+                signalledInputEOS = true;
+            }
+
+            if (err != OK) {
+                break;
+            }
+        }
+
+        size_t offset;
+        size_t size;
+        int64_t presentationTimeUs;
+        uint32_t flags;
+        status_t outErr = codec->dequeueOutputBuffer(
+                &index, &offset, &size, &presentationTimeUs, &flags,
+                kTimeoutUs);
+
+        if (outErr == OK) {
+            if (size > 0) {
+                ssize_t queued = queueTimesUs.indexOfKey(presentationTimeUs);
+                if (queued >= 0) {
+                    stats->mLatenciesUs.push(
+                            ALooper::GetNowUs() - queueTimesUs.valueAt(queued));
+                    queueTimesUs.removeItemsAt(queued);
+                }
+                ++stats->mNumFrames;
+            }
+
+            err = codec->releaseOutputBuffer(index);
+
+            if (flags & MediaCodec::BUFFER_FLAG_EOS) {
+                sawOutputEOS = true;
+            }
+
+            if (maxNumFrames > 0 && stats->mNumFrames == maxNumFrames) {
+                break;
+            }
+        } else if (outErr != INFO_OUTPUT_BUFFERS_CHANGED
+                && outErr != INFO_FORMAT_CHANGED
+                && outErr != -EAGAIN) {
+            err = outErr;
+        }
+    }
+
+    codec->release();
+    finishRun(stats);
+
+    return err;
+}
+
+static void printHeader(FILE *csv) {
+    printf("%-32s %-30s %-9s %6s %8s %9s %9s %8s %8s %8s %8s\n",
+           "stream", "component", "path", "frames", "fps", "cpu ms",
+           "sys ms", "rss KB", "p50 us", "p90 us", "p99 us");
+
+    if (csv != NULL) {
+        fprintf(csv, "stream,mime,width,height,sample_rate,channels,"
+                     "component,path,runs,frames,fps,process_cpu_ms,"
+                     "system_cpu_ms,peak_rss_kb,latency_p50_us,"
+                     "latency_p90_us,latency_p99_us,latency_max_us\n");
+    }
+}
+
+// Reports the averages of the measured runs, and the latency percentiles of
+// all their frames together.
+static void report(
+        FILE *csv, const StreamInfo &info, const char *component,
+        const char *path, Vector<RunStats> *runs) {
+    int64_t numRuns = runs->size();
+    int64_t numFrames = 0;
+    int64_t elapsedUs = 0;
+    int64_t processCpuUs = 0;
+    int64_t systemCpuUs = 0;
+    Vector<int64_t> latenciesUs;
+
+    for (size_t i = 0; i < runs->size(); ++i) {
+        const RunStats &run = runs->itemAt(i);
+        numFrames += run.mNumFrames;
+        elapsedUs += run.mElapsedUs;
+        processCpuUs += run.mProcessCpuUs;
+        systemCpuUs += run.mSystemCpuUs;
+        latenciesUs.appendVector(run.mLatenciesUs);
+    }
+
+    latenciesUs.sort(CompareIncreasing);
+
+    double fps = elapsedUs > 0 ? numFrames * 1E6 / elapsedUs : 0;
+    long peakRssKB = getPeakRssKB();
+    int64_t maxUs = latenciesUs.isEmpty() ? 0 : latenciesUs.top();
+
+    const char *name = strrchr(info.mPath.c_str(), '/');
+    name = (name != NULL) ? name + 1 : info.mPath.c_str();
+
+    printf("%-32s %-30s %-9s %6lld %8.2f %9.2f %9.2f %8ld %8lld %8lld %8lld\n",
+           name, component, path, numFrames / numRuns, fps,
+           processCpuUs / 1E3 / numRuns, systemCpuUs / 1E3 / numRuns,
+           peakRssKB, percentile(latenciesUs, 50),
+           percentile(latenciesUs, 90), percentile(latenciesUs, 99));
+
+    if (csv != NULL) {
+        fprintf(csv, "%s,%s,%d,%d,%d,%d,%s,%s,%lld,%lld,%.2f,%.2f,%.2f,%ld,"
+                     "%lld,%lld,%lld,%lld\n",
+                info.mPath.c_str(), info.mMime.c_str(), info.mWidth,
+                info.mHeight, info.mSampleRate, info.mChannelCount,
+                component, path, numRuns, numFrames / numRuns, fps,
+                processCpuUs / 1E3 / numRuns, systemCpuUs / 1E3 / numRuns,
+                peakRssKB, percentile(latenciesUs, 50),
+                percentile(latenciesUs, 90), percentile(latenciesUs, 99),
+                maxUs);
+        fflush(csv);
+    }
+}
+
+static void benchmark(
+        OMXClient *client, const sp<ALooper> &looper, FILE *csv,
+        const StreamInfo &info, const char *component, bool useACodec,
+        const BenchOptions &options) {
+    const char *path = useACodec ? "acodec" : "omxcodec";
+    Vector<RunStats> runs;
+
+    for (int i = 0; i < options.mNumWarmupRuns + options.mNumRuns; ++i) {
+        RunStats stats;
+        status_t err = useACodec
+            ? runACodec(looper, info, component, options.mMaxNumFrames, &stats)
+            : runOMXCodec(client, info, component, options.mMaxNumFrames,
+                          &stats);
+
+        if (err != OK) {
+            fprintf(stderr, "%s: %s through %s failed with %d.\n",
+                    info.mPath.c_str(), component, path, err);
+            return;
+        }
+
+        if (i >= options.mNumWarmupRuns) {
+            runs.push(stats);
+        }
+    }
+
+    if (!runs.isEmpty()) {
+        report(csv, info, component, path, &runs);
+    }
+}
+
+int main(int argc, char **argv) {
+    const char *me = argv[0];
+
+    BenchOptions options;
+    options.mUseAudio = false;
+    options.mNumWarmupRuns = 1;
+    options.mNumRuns = 3;
+    options.mMaxNumFrames = 0;
+    options.mComponentFilter = NULL;
+    options.mSoftwareOnly = false;
+    options.mHardwareOnly = false;
+    options.mUseOMXCodec = true;
+    options.mUseACodec = true;
+
+    const char *csvPath = NULL;
+
+    int res;
+    while ((res = getopt(argc, argv, "haw:n:m:c:sHOAo:")) >= 0) {
+        switch (res) {
+            case 'a':
+            {
+                options.mUseAudio = true;
+                break;
+            }
+
+            case 'w':
+            {
+                options.mNumWarmupRuns = atoi(optarg);
+                break;
+            }
+
+            case 'n':
+            {
+                options.mNumRuns = atoi(optarg);
+                break;
+            }
+
+            case 'm':
+            {
+                options.mMaxNumFrames = atoll(optarg);
+                break;
+            }
+
+            case 'c':
+            {
+                options.mComponentFilter = optarg;
+                break;
+            }
+
+            case 's':
+            {
+                options.mSoftwareOnly = true;
+                break;
+            }
+
+            case 'H':
+            {
+                options.mHardwareOnly = true;
+                break;
+            }
+
+            case 'O':
+            {
+                options.mUseACodec = false;
+                break;
+            }
+
+            case 'A':
+            {
+                options.mUseOMXCodec = false;
+                break;
+            }
+
+            case 'o':
+            {
+                csvPath = optarg;
+                break;
+            }
+
+            case '?':
+            case 'h':
+            default:
+            {
+                usage(me);
+            }
+        }
+    }
+
+    argc -= optind;
+    argv += optind;
+
+    if (argc < 1 || options.mNumWarmupRuns < 0 || options.mNumRuns < 1
+            || (options.mSoftwareOnly && options.mHardwareOnly)
+            || (!options.mUseOMXCodec && !options.mUseACodec)) {
+        usage(me);
+    }
+
+    FILE *csv = NULL;
+    if (csvPath != NULL) {
+        csv = fopen(csvPath, "w");
+        if (csv == NULL) {
+            fprintf(stderr, "unable to open '%s'.\n", csvPath);
+            return 1;
+        }
+    }
+
+    ProcessState::self()->startThreadPool();
+
+    DataSource::RegisterDefaultSniffers();
+
+    OMXClient client;
+    CHECK_EQ(client.connect(), (status_t)OK);
+
+    sp<ALooper> looper = new ALooper;
+    looper->start();
+
+    printHeader(csv);
+
+    for (int i = 0; i < argc; ++i) {
+        StreamInfo info;
+        if (!findStream(argv[i], options.mUseAudio, &info)) {
+            continue;
+        }
+
+        Vector<AString> components;
+        findDecoders(info, options, &components);
+        if (components.isEmpty()) {
+            fprintf(stderr, "%s: no decoder for %s.\n",
+                    argv[i], info.mMime.c_str());
+            continue;
+        }
+
+        for (size_t j = 0; j < components.size(); ++j) {
+            const char *component = components.itemAt(j).c_str();
+
+            if (options.mUseOMXCodec) {
+                benchmark(&client, looper, csv, info, component,
+                          false /* useACodec */, options);
+            }
+            if (options.mUseACodec) {
+                benchmark(&client, looper, csv, info, component,
+                          true /* useACodec */, options);
+            }
+        }
+    }
+
+    looper->stop();
+    client.disconnect();
+
+    if (csv != NULL) {
+        fclose(csv);
+    }
+
+    return 0;
+}
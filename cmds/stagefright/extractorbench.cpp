@@ -0,0 +1,422 @@
+/*
+ * Copyright (C) 2012 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Opens each file given on the command line with the extractor that sniffs
+// it, through a DataSource proxy that counts the readAt calls and bytes the
+// extractor issues and can delay each of them by a round trip time plus the
+// transfer time at a given bandwidth, to look like network storage.
+// For each file it reports the time, readAt calls, bytes and read syscalls
+// needed to open it, to get the first sample of every track, to seek and,
+// optionally, to read every sample.
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "extractorbench"
+#include <utils/Log.h>
+
+#include <unistd.h>
+
+#include <binder/ProcessState.h>
+#include <media/stagefright/foundation/ADebug.h>
+#include <media/stagefright/foundation/ALooper.h>
+#include <media/stagefright/DataSource.h>
+#include <media/stagefright/MediaBuffer.h>
+#include <media/stagefright/MediaDefs.h>
+#include <media/stagefright/MediaErrors.h>
+#include <media/stagefright/MediaExtractor.h>
+#include <media/stagefright/MediaSource.h>
+#include <media/stagefright/MetaData.h>
+#include <utils/threads.h>
+
+#include "include/NuCachedSource2.h"
+
+static void usage(const char *me) {
+    fprintf(stderr, "usage: %s [-d round trip time per read in ms]\n"
+                    "\t\t[-b bandwidth in kbit/s (default unlimited)]\n"
+                    "\t\t[-C] read through NuCachedSource2\n"
+                    "\t\t[-x container mime type to skip sniffing]\n"
+                    "\t\t[-s number of seeks per track (default 4)]\n"
+                    "\t\t[-r] read every sample of every track\n"
+                    "\t\t[-o CSV output file]\n"
+                    "\t\tfile...\n",
+                    me);
+
+    exit(1);
+}
+
+namespace android {
+
+struct IOStats {
+    int64_t mNumReads;
+    int64_t mNumBytes;
+    int64_t mReadUs;
+    int64_t mNumSyscalls;
+
+    IOStats()
+        : mNumReads(0), mNumBytes(0), mReadUs(0), mNumSyscalls(0) {}
+};
+
+// Forwards everything to the wrapped source, except getMappedRange, so that
+// every byte an extractor looks at goes through readAt.
+struct CountingDataSource : public DataSource {
+    CountingDataSource(
+            const sp<DataSource> &source, int64_t rttUs,
+            int64_t bandwidthBps)
+        : mSource(source),
+          mRttUs(rttUs),
+          mBandwidthBps(bandwidthBps) {
+    }
+
+    virtual status_t initCheck() const {
+        return mSource->initCheck();
+    }
+
+    virtual ssize_t readAt(off64_t offset, void *data, size_t size) {
+        int64_t startUs = ALooper::GetNowUs();
+
+        ssize_t n = mSource->readAt(offset, data, size);
+
+        int64_t delayUs = mRttUs;
+        if (n > 0 && mBandwidthBps > 0) {
+            delayUs += n * 8000000ll / mBandwidthBps;
+        }
+        if (delayUs > 0) {
+            usleep(delayUs);
+        }
+
+        Mutex::Autolock autoLock(mLock);
+        ++mStats.mNumReads;
+        if (n > 0) {
+            mStats.mNumBytes += n;
+        }
+        mStats.mReadUs += ALooper::GetNowUs() - startUs;
+
+        return n;
+    }
+
+    virtual status_t getSize(off64_t *size) {
+        return mSource->getSize(size);
+    }
+
+    virtual uint32_t flags() {
+        return mSource->flags();
+    }
+
+    virtual String8 getUri() {
+        return mSource->getUri();
+    }
+
+    virtual String8 getMIMEType() const {
+        return mSource->getMIMEType();
+    }
+
+    IOStats stats() {
+        Mutex::Autolock autoLock(mLock);
+        return mStats;
+    }
+
+protected:
+    virtual ~CountingDataSource() {}
+
+private:
+    sp<DataSource> mSource;
+    int64_t mRttUs;
+    int64_t mBandwidthBps;
+
+    Mutex mLock;
+    IOStats mStats;
+
+    CountingDataSource(const CountingDataSource &);
+    CountingDataSource &operator=(const CountingDataSource &);
+};
+
+}  // namespace android
+
+using namespace android;
+
+static int64_t gRttUs;
+static int64_t gBandwidthBps;
+static bool gUseCache;
+static const char *gContainerMime;
+static int gNumSeeks;
+static bool gReadAll;
+
+// Read syscalls this process has made, from /proc/self/io.
+static int64_t getNumReadSyscalls() {
+    FILE *file = fopen("/proc/self/io", "r");
+    if (file == NULL) {
+        return 0;
+    }
+
+    char line[64];
+    long long syscr = 0;
+    while (fgets(line, sizeof(line), file) != NULL) {
+        if (sscanf(line, "syscr: %lld", &syscr) == 1) {
+            break;
+        }
+    }
+    fclose(file);
+
+    return syscr;
+}
+
+struct Phase {
+    int64_t mStartUs;
+    IOStats mStartStats;
+};
+
+static void startPhase(const sp<CountingDataSource> &source, Phase *phase) {
+    phase->mStartStats = source->stats();
+    phase->mStartStats.mNumSyscalls = getNumReadSyscalls();
+    phase->mStartUs = ALooper::GetNowUs();
+}
+
+static void reportPhase(
+        FILE *csv, const sp<CountingDataSource> &source, const Phase &phase,
+        const char *path, const char *container, const char *name,
+        int track, int64_t count) {
+    int64_t elapsedUs = ALooper::GetNowUs() - phase.mStartUs;
+    IOStats stats = source->stats();
+    int64_t numReads = stats.mNumReads - phase.mStartStats.mNumReads;
+    int64_t numBytes = stats.mNumBytes - phase.mStartStats.mNumBytes;
+    int64_t readUs = stats.mReadUs - phase.mStartStats.mReadUs;
+    int64_t numSyscalls =
+        getNumReadSyscalls() - phase.mStartStats.mNumSyscalls;
+
+    printf("%-12s %5d %10.2f %8lld %10lld %10.2f %8lld %8lld\n",
+           name, track, elapsedUs / 1E3, numReads, numBytes, readUs / 1E3,
+           numSyscalls, count);
+
+    if (csv != NULL) {
+        fprintf(csv, "%s,%s,%lld,%lld,%s,%d,%lld,%lld,%lld,%lld,%lld,%lld\n",
+                path, container, gRttUs, gBandwidthBps, name, track,
+                elapsedUs, numReads, numBytes, readUs, numSyscalls, count);
+        fflush(csv);
+    }
+}
+
+static status_t benchmarkFile(FILE *csv, const char *path) {
+    sp<DataSource> fileSource = DataSource::CreateFromURI(path);
+    if (fileSource == NULL) {
+        fprintf(stderr, "unable to create data source for '%s'.\n", path);
+        return UNKNOWN_ERROR;
+    }
+
+    sp<CountingDataSource> counter =
+        new CountingDataSource(fileSource, gRttUs, gBandwidthBps);
+
+    sp<DataSource> source = counter;
+    if (gUseCache) {
+        source = new NuCachedSource2(counter);
+    }
+
+    printf("%s\n", path);
+    printf("%-12s %5s %10s %8s %10s %10s %8s %8s\n", "phase", "track",
+           "ms", "reads", "bytes", "read ms", "syscr", "samples");
+
+    Phase phase;
+    startPhase(counter, &phase);
+
+    sp<MediaExtractor> extractor = MediaExtractor::Create(source, gContainerMime);
+    if (extractor == NULL) {
+        fprintf(stderr, "no extractor for '%s'.\n", path);
+        return UNKNOWN_ERROR;
+    }
+
+    const char *container = "unknown";
+    sp<MetaData> fileMeta = extractor->getMetaData();
+    if (fileMeta != NULL) {
+        fileMeta->findCString(kKeyMIMEType, &container);
+    }
+
+    size_t numTracks = extractor->countTracks();
+    for (size_t i = 0; i < numTracks; ++i) {
+        extractor->getTrackMetaData(i);
+    }
+
+    reportPhase(csv, counter, phase, path, container, "open", -1, 0);
+
+    for (size_t i = 0; i < numTracks; ++i) {
+        sp<MediaSource> track = extractor->getTrack(i);
+        if (track == NULL) {
+            continue;
+        }
+
+        startPhase(counter, &phase);
+
+        if (track->start() != OK) {
+            fprintf(stderr, "unable to start track %d.\n", i);
+            continue;
+        }
+
+        MediaBuffer *buffer;
+        status_t err = track->read(&buffer);
+        if (err == OK) {
+            buffer->release();
+            buffer = NULL;
+        }
+
+        reportPhase(csv, counter, phase, path, container, "first-sample", i,
+                    err == OK ? 1 : 0);
+
+        int64_t durationUs;
+        sp<MetaData> meta = track->getFormat();
+        if (gNumSeeks > 0 && meta->findInt64(kKeyDuration, &durationUs)
+                && durationUs > 0) {
+            // Seek backwards over the track, so that no seek is served by
+            // what the previous one read.
+            for (int j = gNumSeeks; j > 0; --j) {
+                MediaSource::ReadOptions options;
+                options.setSeekTo(durationUs * j / (gNumSeeks + 1));
+
+                startPhase(counter, &phase);
+                err = track->read(&buffer, &options);
+                if (err == OK) {
+                    buffer->release();
+                    buffer = NULL;
+                }
+
+                reportPhase(csv, counter, phase, path, container, "seek", i,
+                            err == OK ? 1 : 0);
+            }
+        }
+
+        if (gReadAll) {
+            MediaSource::ReadOptions options;
+            options.setSeekTo(0);
+
+            startPhase(counter, &phase);
+            int64_t numSamples = 0;
+            while (track->read(&buffer, &options) == OK) {
+                options.clearSeekTo();
+                buffer->release();
+                buffer = NULL;
+                ++numSamples;
+            }
+
+            reportPhase(csv, counter, phase, path, container, "read-all", i,
+                        numSamples);
+        }
+
+        track->stop();
+    }
+
+    printf("\n");
+    return OK;
+}
+
+int main(int argc, char **argv) {
+    const char *me = argv[0];
+
+    gRttUs = 0;
+    gBandwidthBps = 0;
+    gUseCache = false;
+    gContainerMime = NULL;
+    gNumSeeks = 4;
+    gReadAll = false;
+
+    const char *csvPath = NULL;
+
+    int res;
+    while ((res = getopt(argc, argv, "hd:b:Cx:s:ro:")) >= 0) {
+        switch (res) {
+            case 'd':
+            {
+                gRttUs = atoll(optarg) * 1000ll;
+                break;
+            }
+
+            case 'b':
+            {
+                gBandwidthBps = atoll(optarg) * 1000ll;
+                break;
+            }
+
+            case 'C':
+            {
+                gUseCache = true;
+                break;
+            }
+
+            case 'x':
+            {
+                gContainerMime = optarg;
+                break;
+            }
+
+            case 's':
+            {
+                gNumSeeks = atoi(optarg);
+                break;
+            }
+
+            case 'r':
+            {
+                gReadAll = true;
+                break;
+            }
+
+            case 'o':
+            {
+                csvPath = optarg;
+                break;
+            }
+
+            case '?':
+            case 'h':
+            default:
+            {
+                usage(me);
+            }
+        }
+    }
+
+    argc -= optind;
+    argv += optind;
+
+    if (argc < 1 || gRttUs < 0 || gBandwidthBps < 0 || gNumSeeks < 0) {
+        usage(me);
+    }
+
+    FILE *csv = NULL;
+    if (csvPath != NULL) {
+        csv = fopen(csvPath, "w");
+        if (csv == NULL) {
+            fprintf(stderr, "unable to open '%s'.\n", csvPath);
+            return 1;
+        }
+
+        fprintf(csv, "file,container,rtt_us,bandwidth_bps,phase,track,"
+                     "elapsed_us,reads,bytes,read_us,read_syscalls,"
+                     "samples\n");
+    }
+
+    ProcessState::self()->startThreadPool();
+
+    DataSource::RegisterDefaultSniffers();
+
+    int result = 0;
+    for (int i = 0; i < argc; ++i) {
+        if (benchmarkFile(csv, argv[i]) != OK) {
+            result = 1;
+        }
+    }
+
+    if (csv != NULL) {
+        fclose(csv);
+    }
+
+    return result;
+}
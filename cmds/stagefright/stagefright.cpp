@@ -63,6 +63,7 @@ static long gMaxNumFrames;  // 0 means decode all available.
 static long gReproduceBug;  // if not -1.
 static bool gPreferSoftwareCodec;
 static bool gForceToUseHardwareCodec;
+static bool gBatchAudioOutput;
 static bool gPlaybackAudio;
 static bool gWriteMP4;
 static bool gDisplayHistogram;
@@ -180,6 +181,9 @@ static void playSource(OMXClient *client, sp<MediaSource> &source) {
             CHECK(!gPreferSoftwareCodec);
             flags |= OMXCodec::kHardwareCodecsOnly;
         }
+        if (gBatchAudioOutput) {
+            flags |= OMXCodec::kBatchAudioOutputBuffers;
+        }
         rawSource = OMXCodec::Create(
             client->interface(), meta, false /* createEncoder */, source,
             NULL /* matchComponentName */,
@@ -600,6 +604,8 @@ static void usage(const char *me) {
     fprintf(stderr, "       -t(humbnail) extract video thumbnail or album art\n");
     fprintf(stderr, "       -s(oftware) prefer software codec\n");
     fprintf(stderr, "       -r(hardware) force to use hardware codec\n");
+    fprintf(stderr, "       -B batch several frames per software audio "
+                    "decoder output buffer\n");
     fprintf(stderr, "       -o playback audio\n");
     fprintf(stderr, "       -w(rite) filename (write to .mp4 file)\n");
     fprintf(stderr, "       -k seek test\n");
@@ -673,6 +679,7 @@ int main(int argc, char **argv) {
     gReproduceBug = -1;
     gPreferSoftwareCodec = false;
     gForceToUseHardwareCodec = false;
+    gBatchAudioOutput = false;
     gPlaybackAudio = false;
     gWriteMP4 = false;
     gDisplayHistogram = false;
@@ -681,7 +688,7 @@ int main(int argc, char **argv) {
     sp<LiveSession> liveSession;
 
     int res;
-    while ((res = getopt(argc, argv, "han:lm:b:ptsrow:kxSTd:D:")) >= 0) {
+    while ((res = getopt(argc, argv, "han:lm:b:ptsrBow:kxSTd:D:")) >= 0) {
         switch (res) {
             case 'a':
             {
@@ -763,6 +770,12 @@ int main(int argc, char **argv) {
                 break;
             }
 
+            case 'B':
+            {
+                gBatchAudioOutput = true;
+                break;
+            }
+
             case 'o':
             {
                 gPlaybackAudio = true;
@@ -35,6 +35,10 @@
 
 #define DECRYPT_FILE_ERROR -1
 
+// The media scanner looks up every file it finds, don't let the cache of
+// per path results grow with the size of the media collection
+#define MAX_PATH_CACHE_SIZE 256
+
 using namespace android;
 
 const String8 DrmManager::EMPTY_STRING("");
@@ -121,6 +125,7 @@ status_t DrmManager::loadPlugIns(const String8& plugInDirPath) {
             delete info;
         }
     }
+    updatePlugInIdMaps();
     return DRM_NO_ERROR;
 }
 
@@ -130,9 +135,57 @@ status_t DrmManager::unloadPlugIns() {
     mDecryptSessionMap.clear();
     mPlugInManager.unloadPlugIns();
     mSupportInfoToPlugInIdMap.clear();
+    updatePlugInIdMaps();
     return DRM_NO_ERROR;
 }
 
+void DrmManager::updatePlugInIdMaps() {
+    mMimeTypeToPlugInIdMap.clear();
+    mFileSuffixToPlugInIdsMap.clear();
+
+    for (unsigned int index = 0; index < mSupportInfoToPlugInIdMap.size(); index++) {
+        DrmSupportInfo drmSupportInfo = mSupportInfoToPlugInIdMap.keyAt(index);
+        const String8& plugInId = mSupportInfoToPlugInIdMap.valueAt(index);
+
+        DrmSupportInfo::MimeTypeIterator mimeIt = drmSupportInfo.getMimeTypeIterator();
+        while (mimeIt.hasNext()) {
+            String8 mimeType = mimeIt.next();
+            mimeType.toLower();
+            if (mMimeTypeToPlugInIdMap.indexOfKey(mimeType) < 0) {
+                mMimeTypeToPlugInIdMap.add(mimeType, plugInId);
+            }
+        }
+
+        DrmSupportInfo::FileSuffixIterator suffixIt = drmSupportInfo.getFileSuffixIterator();
+        while (suffixIt.hasNext()) {
+            String8 fileSuffix = suffixIt.next();
+            fileSuffix.toLower();
+            ssize_t suffixIndex = mFileSuffixToPlugInIdsMap.indexOfKey(fileSuffix);
+            if (suffixIndex < 0) {
+                suffixIndex = mFileSuffixToPlugInIdsMap.add(fileSuffix, Vector<String8>());
+            }
+            Vector<String8>& plugInIds = mFileSuffixToPlugInIdsMap.editValueAt(suffixIndex);
+            bool found = false;
+            for (unsigned int i = 0; i < plugInIds.size(); i++) {
+                if (plugInIds.itemAt(i) == plugInId) {
+                    found = true;
+                    break;
+                }
+            }
+            if (!found) {
+                plugInIds.push(plugInId);
+            }
+        }
+    }
+
+    clearPathCache();
+}
+
+void DrmManager::clearPathCache() {
+    Mutex::Autolock _l(mPathCacheLock);
+    mPathToPlugInIdCache.clear();
+}
+
 status_t DrmManager::setDrmServiceListener(
             int uniqueId, const sp<IDrmServiceListener>& drmServiceListener) {
     Mutex::Autolock _l(mListenerLock);
@@ -196,6 +249,7 @@ status_t DrmManager::installDrmEngine(int uniqueId, const String8& absolutePath)
     DrmSupportInfo* info = rDrmEngine.getSupportInfo(0);
     mSupportInfoToPlugInIdMap.add(*info, absolutePath);
     delete info;
+    updatePlugInIdMaps();
 
     return DRM_NO_ERROR;
 }
@@ -223,6 +277,8 @@ DrmInfoStatus* DrmManager::processDrmInfo(int uniqueId, const DrmInfo* drmInfo)
     Mutex::Autolock _l(mLock);
     const String8 plugInId = getSupportedPlugInId(drmInfo->getMimeType());
     if (EMPTY_STRING != plugInId) {
+        // This may install or remove rights
+        clearPathCache();
         IDrmEngine& rDrmEngine = mPlugInManager.getPlugIn(plugInId);
         return rDrmEngine.processDrmInfo(uniqueId, drmInfo);
     }
@@ -262,6 +318,7 @@ status_t DrmManager::saveRights(int uniqueId, const DrmRights& drmRights,
     if (EMPTY_STRING != plugInId) {
         IDrmEngine& rDrmEngine = mPlugInManager.getPlugIn(plugInId);
         result = rDrmEngine.saveRights(uniqueId, drmRights, rightsPath, contentPath);
+        clearPathCache();
     }
     return result;
 }
@@ -336,6 +393,7 @@ status_t DrmManager::removeRights(int uniqueId, const String8& path) {
     if (EMPTY_STRING != plugInId) {
         IDrmEngine& rDrmEngine = mPlugInManager.getPlugIn(plugInId);
         result = rDrmEngine.removeRights(uniqueId, path);
+        clearPathCache();
     }
     return result;
 }
@@ -350,6 +408,7 @@ status_t DrmManager::removeAllRights(int uniqueId) {
             break;
         }
     }
+    clearPathCache();
     return result;
 }
 
@@ -560,13 +619,12 @@ String8 DrmManager::getSupportedPlugInId(const String8& mimeType) {
     String8 plugInId("");
 
     if (EMPTY_STRING != mimeType) {
-        for (unsigned int index = 0; index < mSupportInfoToPlugInIdMap.size(); index++) {
-            const DrmSupportInfo& drmSupportInfo = mSupportInfoToPlugInIdMap.keyAt(index);
+        String8 key(mimeType);
+        key.toLower();
 
-            if (drmSupportInfo.isSupportedMimeType(mimeType)) {
-                plugInId = mSupportInfoToPlugInIdMap.valueFor(drmSupportInfo);
-                break;
-            }
+        ssize_t index = mMimeTypeToPlugInIdMap.indexOfKey(key);
+        if (index >= 0) {
+            plugInId = mMimeTypeToPlugInIdMap.valueAt(index);
         }
     }
     return plugInId;
@@ -574,25 +632,46 @@ String8 DrmManager::getSupportedPlugInId(const String8& mimeType) {
 
 String8 DrmManager::getSupportedPlugInIdFromPath(int uniqueId, const String8& path) {
     String8 plugInId("");
-    const String8 fileSuffix = path.getPathExtension();
+    String8 fileSuffix = path.getPathExtension();
+    fileSuffix.toLower();
 
-    for (unsigned int index = 0; index < mSupportInfoToPlugInIdMap.size(); index++) {
-        const DrmSupportInfo& drmSupportInfo = mSupportInfoToPlugInIdMap.keyAt(index);
+    ssize_t suffixIndex = mFileSuffixToPlugInIdsMap.indexOfKey(fileSuffix);
+    if (suffixIndex < 0) {
+        // No plug-in claims the suffix, nothing to ask them about
+        return plugInId;
+    }
+
+    {
+        Mutex::Autolock _l(mPathCacheLock);
+        ssize_t index = mPathToPlugInIdCache.indexOfKey(path);
+        if (index >= 0) {
+            return mPathToPlugInIdCache.valueAt(index);
+        }
+    }
 
-        if (drmSupportInfo.isSupportedFileSuffix(fileSuffix)) {
-            String8 key = mSupportInfoToPlugInIdMap.valueFor(drmSupportInfo);
-            IDrmEngine& drmEngine = mPlugInManager.getPlugIn(key);
+    const Vector<String8>& plugInIds = mFileSuffixToPlugInIdsMap.valueAt(suffixIndex);
+    for (unsigned int index = 0; index < plugInIds.size(); index++) {
+        const String8& key = plugInIds.itemAt(index);
+        IDrmEngine& drmEngine = mPlugInManager.getPlugIn(key);
 
-            if (drmEngine.canHandle(uniqueId, path)) {
-                plugInId = key;
-                break;
-            }
+        if (drmEngine.canHandle(uniqueId, path)) {
+            plugInId = key;
+            break;
         }
     }
+
+    Mutex::Autolock _l(mPathCacheLock);
+    if (mPathToPlugInIdCache.size() >= MAX_PATH_CACHE_SIZE) {
+        mPathToPlugInIdCache.clear();
+    }
+    mPathToPlugInIdCache.add(path, plugInId);
     return plugInId;
 }
 
 void DrmManager::onInfo(const DrmInfoEvent& event) {
+    // Rights may have been installed or removed in the background
+    clearPathCache();
+
     Mutex::Autolock _l(mListenerLock);
     for (unsigned int index = 0; index < mServiceListeners.size(); index++) {
         int uniqueId = mServiceListeners.keyAt(index);
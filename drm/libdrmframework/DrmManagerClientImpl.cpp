@@ -40,6 +40,14 @@ DrmManagerClientImpl* DrmManagerClientImpl::create(
     return new DrmManagerClientImpl();
 }
 
+DrmManagerClientImpl::~DrmManagerClientImpl() {
+    Mutex::Autolock _l(mReadAheadLock);
+    for (size_t i = 0; i < mReadAheadBlocks.size(); ++i) {
+        delete [] mReadAheadBlocks.valueAt(i).data;
+    }
+    mReadAheadBlocks.clear();
+}
+
 void DrmManagerClientImpl::remove(int uniqueId) {
     getDrmManagerService()->removeUniqueId(uniqueId);
 }
@@ -276,6 +284,7 @@ status_t DrmManagerClientImpl::closeDecryptSession(
         int uniqueId, sp<DecryptHandle> &decryptHandle) {
     status_t status = DRM_ERROR_UNKNOWN;
     if (NULL != decryptHandle.get()) {
+        clearReadAhead(decryptHandle);
         status = getDrmManagerService()->closeDecryptSession(
                 uniqueId, decryptHandle.get());
     }
@@ -320,13 +329,59 @@ status_t DrmManagerClientImpl::finalizeDecryptUnit(
 ssize_t DrmManagerClientImpl::pread(int uniqueId, sp<DecryptHandle> &decryptHandle,
             void* buffer, ssize_t numBytes, off64_t offset) {
     ssize_t retCode = INVALID_VALUE;
-    if ((NULL != decryptHandle.get()) && (NULL != buffer) && (0 < numBytes)) {
-        retCode = getDrmManagerService()->pread(
+    if ((NULL == decryptHandle.get()) || (NULL == buffer) || (0 >= numBytes)) {
+        return retCode;
+    }
+
+    if (numBytes >= kReadAheadSize) {
+        return getDrmManagerService()->pread(
                 uniqueId, decryptHandle.get(), buffer, numBytes, offset);
     }
+
+    Mutex::Autolock _l(mReadAheadLock);
+
+    ssize_t index = mReadAheadBlocks.indexOfKey(decryptHandle->decryptId);
+    if (index < 0) {
+        ReadAheadBlock block;
+        block.offset = 0;
+        block.size = 0;
+        block.data = new char[kReadAheadSize];
+        index = mReadAheadBlocks.add(decryptHandle->decryptId, block);
+    }
+
+    ReadAheadBlock& block = mReadAheadBlocks.editValueAt(index);
+    if (offset < block.offset || offset + numBytes > block.offset + block.size) {
+        // Fetch a whole block in one transaction starting at this read,
+        // the ones following it are likely to be served from it.
+        block.size = 0;
+        retCode = getDrmManagerService()->pread(
+                uniqueId, decryptHandle.get(), block.data, kReadAheadSize, offset);
+        if (0 >= retCode) {
+            return retCode;
+        }
+        block.offset = offset;
+        block.size = retCode;
+    }
+
+    // Short only at the end of the content.
+    retCode = block.offset + block.size - offset;
+    if (retCode > numBytes) {
+        retCode = numBytes;
+    }
+    memcpy(buffer, block.data + (offset - block.offset), retCode);
     return retCode;
 }
 
+void DrmManagerClientImpl::clearReadAhead(sp<DecryptHandle> &decryptHandle) {
+    Mutex::Autolock _l(mReadAheadLock);
+
+    ssize_t index = mReadAheadBlocks.indexOfKey(decryptHandle->decryptId);
+    if (index >= 0) {
+        delete [] mReadAheadBlocks.valueAt(index).data;
+        mReadAheadBlocks.removeItemsAt(index);
+    }
+}
+
 status_t DrmManagerClientImpl::notify(const DrmInfoEvent& event) {
     if (NULL != mOnInfoListener.get()) {
         Mutex::Autolock _l(mLock);
@@ -140,6 +140,14 @@ private:
 
     bool canHandle(int uniqueId, const String8& path);
 
+    /**
+     * Rebuilds the mime type and file suffix lookup tables from
+     * mSupportInfoToPlugInIdMap, and drops the cached per path results
+     */
+    void updatePlugInIdMaps();
+
+    void clearPathCache();
+
 private:
     Vector<int> mUniqueIdVector;
     static const String8 EMPTY_STRING;
@@ -152,6 +160,13 @@ private:
     Mutex mConvertLock;
     TPlugInManager<IDrmEngine> mPlugInManager;
     KeyedVector< DrmSupportInfo, String8 > mSupportInfoToPlugInIdMap;
+    // Lower case mime types and file suffixes to the plug-ins supporting
+    // them, in the order mSupportInfoToPlugInIdMap would be searched
+    KeyedVector< String8, String8 > mMimeTypeToPlugInIdMap;
+    KeyedVector< String8, Vector<String8> > mFileSuffixToPlugInIdsMap;
+    // Plug-in, or EMPTY_STRING if none, found for recently looked up paths
+    Mutex mPathCacheLock;
+    KeyedVector< String8, String8 > mPathToPlugInIdCache;
     KeyedVector< int, IDrmEngine*> mConvertSessionMap;
     KeyedVector< int, sp<IDrmServiceListener> > mServiceListeners;
     KeyedVector< int, IDrmEngine*> mDecryptSessionMap;
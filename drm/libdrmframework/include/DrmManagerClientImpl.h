@@ -18,6 +18,7 @@
 #define __DRM_MANAGER_CLIENT_IMPL_H__
 
 #include <binder/IMemory.h>
+#include <utils/KeyedVector.h>
 #include <utils/threads.h>
 #include <drm/DrmManagerClient.h>
 
@@ -42,7 +43,7 @@ public:
 
     static void remove(int uniqueId);
 
-    virtual ~DrmManagerClientImpl() { }
+    virtual ~DrmManagerClientImpl();
 
 public:
     /**
@@ -375,6 +376,8 @@ public:
 
     /**
      * Reads the specified number of bytes from an open DRM file.
+     * Small reads are served from a block of decrypted data read ahead
+     * per decrypt session, instead of one transaction each.
      *
      * @param[in] uniqueId Unique identifier for a session
      * @param[in] decryptHandle Handle for the decryption session
@@ -408,9 +411,31 @@ private:
     status_t installDrmEngine(int uniqueId, const String8& drmEngineFile);
 
 private:
+    /**
+     * Drops the data read ahead for the given decrypt session
+     *
+     * @param[in] decryptHandle Handle for the decryption session
+     */
+    void clearReadAhead(sp<DecryptHandle> &decryptHandle);
+
     Mutex mLock;
     sp<DrmManagerClient::OnInfoListener> mOnInfoListener;
 
+    enum {
+        // Reads of at least this size bypass the read ahead block.
+        kReadAheadSize = 64 * 1024,
+    };
+
+    struct ReadAheadBlock {
+        off64_t offset;
+        ssize_t size;
+        char* data;
+    };
+
+    Mutex mReadAheadLock;
+    // By decryptId of the session the block was read for.
+    KeyedVector<int, ReadAheadBlock> mReadAheadBlocks;
+
     class DeathNotifier: public IBinder::DeathRecipient {
         public:
             DeathNotifier() {}
@@ -21,6 +21,7 @@
 #include <linux/socket.h>
 
 #include <binder/IInterface.h>
+#include <binder/IMemory.h>
 #include <binder/IServiceManager.h>
 
 namespace android {
@@ -69,6 +70,23 @@ class ICommonClock : public IInterface {
         STATE_WAIT_FOR_ELECTION,
     };
 
+    // The local to common time transform, as the service publishes it in the
+    // memory returned by getSharedTransform so that clients can convert
+    // between the two time bases in process.  The service makes seq odd
+    // before it updates the other fields and even again once it is done;
+    // readers retry whenever they see an odd seq, or a different seq after
+    // reading the fields.  valid is cleared, and timelineID set to
+    // kInvalidTimelineID, whenever common time is not valid.
+    struct SharedTransform {
+        volatile int32_t seq;
+        int32_t valid;
+        uint64_t timelineID;
+        int64_t localZero;
+        int64_t commonZero;
+        int32_t localToCommonNumer;
+        uint32_t localToCommonDenom;
+    };
+
     virtual status_t isCommonTimeValid(bool* valid, uint32_t* timelineID) = 0;
     virtual status_t commonTimeToLocalTime(int64_t commonTime,
                                            int64_t* localTime) = 0;
@@ -88,6 +106,13 @@ class ICommonClock : public IInterface {
     virtual status_t unregisterListener(
             const sp<ICommonClockListener>& listener) = 0;
 
+    // Returns the read only memory holding the service's SharedTransform.
+    // Services which don't publish one return INVALID_OPERATION, and their
+    // clients keep making a binder call for every conversion.
+    virtual status_t getSharedTransform(sp<IMemory>* mem) {
+        return INVALID_OPERATION;
+    }
+
     // Simple helper to make it easier to connect to the CommonClock service.
     static inline sp<ICommonClock> getInstance() {
         sp<IBinder> binder = defaultServiceManager()->checkService(
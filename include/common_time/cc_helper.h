@@ -19,7 +19,9 @@
 
 #include <stdint.h>
 #include <common_time/ICommonClock.h>
+#include <utils/LinearTransform.h>
 #include <utils/threads.h>
+#include <utils/Vector.h>
 
 namespace android {
 
@@ -40,6 +42,12 @@ namespace android {
 // ref counted ICommonClock interface across all clients and automatically
 // registering and unregistering a listener whenever there are CCHelper
 // instances active in the process.
+//
+// When the service publishes its local to common transform in shared memory,
+// commonTimeToLocalTime and localTimeToCommonTime are computed in process
+// from it without taking the lock or making a binder call.  They fall back to
+// asking the service whenever it doesn't publish one, common time is not
+// valid, or the transform keeps changing under the reader.
 class CCHelper {
   public:
     CCHelper();
@@ -59,12 +67,34 @@ class CCHelper {
         void onTimelineChanged(uint64_t timelineID);
     };
 
+    class CommonClockDeathRecipient : public IBinder::DeathRecipient {
+      public:
+        virtual void binderDied(const wp<IBinder>& who);
+    };
+
+    // number of times a reader tries to get a consistent copy of the shared
+    // transform before falling back to a binder call
+    static const int kMaxSharedTransformReads = 4;
+
     static bool verifyClock_l();
+    static void mapSharedTransform_l();
+    static bool readSharedTransform(LinearTransform* xform);
+
+    status_t commonTimeToLocalTimeIPC(int64_t commonTime, int64_t* localTime);
+    status_t localTimeToCommonTimeIPC(int64_t localTime, int64_t* commonTime);
 
     static Mutex lock_;
     static sp<ICommonClock> common_clock_;
     static sp<ICommonClockListener> common_clock_listener_;
+    static sp<IBinder::DeathRecipient> death_recipient_;
     static uint32_t ref_count_;
+
+    // the mapping of the current service's SharedTransform; NULL until one
+    // is mapped and again once the service dies.  Mappings are only released
+    // with the process, as a reader may still be looking at one when the
+    // service is replaced.
+    static const ICommonClock::SharedTransform* volatile shared_transform_;
+    static Vector<sp<IMemory> > shared_transform_mem_;
 };
 
 
@@ -271,6 +271,26 @@ public:
             status_t    setPositionUpdatePeriod(uint32_t updatePeriod);
             status_t    getPositionUpdatePeriod(uint32_t *updatePeriod) const;
 
+    /* Sets the number of frames delivered per EVENT_MORE_DATA callback, and makes the
+     * callback thread wait until that many frames have been recorded before calling back,
+     * instead of calling back each time the record thread has written a few frames.
+     * Long running captures use a large value so that the client thread wakes up less often.
+     * If the AudioRecord has been opened with no callback function associated,
+     * the operation will fail.
+     *
+     * Parameters:
+     *
+     * notificationFrames:  frames per callback, at most frameCount(). 0 means half of
+     *                      frameCount().
+     *
+     * Returned status (from utils/Errors.h) can be:
+     *  - NO_ERROR: successful operation
+     *  - INVALID_OPERATION: the AudioRecord has no callback installed.
+     *  - BAD_VALUE: notificationFrames is larger than frameCount()
+     */
+            status_t    setNotificationFrames(uint32_t notificationFrames);
+            uint32_t    getNotificationFrames() const;
+
 
     /* Gets record head position. The position is the  total number of frames
      * recorded since record start.
@@ -329,6 +349,22 @@ public:
      */
             ssize_t     read(void* buffer, size_t size);
 
+    /* Zero-copy alternative to read(): returns in audioBuffer the recorded frames as they lie
+     * in the shared buffer, up to audioBuffer->frameCount frames (0 for all the contiguous
+     * frames available), waiting for data like read() does. The caller consumes the data in
+     * place and hands it back with releaseReadBuffer(), after lowering audioBuffer->frameCount
+     * if it consumed less. Only one read buffer can be outstanding at a time; the shared
+     * buffer is kept mapped until it is released, even if the IAudioRecord is recreated.
+     *
+     * Returned status (from utils/Errors.h) can be:
+     *  - NO_ERROR: audioBuffer holds at least one frame
+     *  - NO_MORE_BUFFERS: the AudioRecord is stopped and no more data is available
+     *  - INVALID_OPERATION: a read buffer is already outstanding
+     *  - TIMED_OUT: no data was recorded within the read timeout
+     */
+            status_t    obtainReadBuffer(Buffer* audioBuffer);
+            void        releaseReadBuffer(Buffer* audioBuffer);
+
     /* Return the amount of input frames lost in the audio driver since the last call of this
      * function.  Audio driver is expected to reset the value to 0 and restart counting upon
      * returning the current value by this function call.  Such loss typically occurs when the
@@ -389,6 +425,7 @@ private:
     void*                   mUserData;
     uint32_t                mNotificationFrames;
     uint32_t                mRemainingFrames;
+    bool                    mBatchNotifications;
     uint32_t                mMarkerPosition;
     bool                    mMarkerReached;
     uint32_t                mNewPosition;
@@ -396,6 +433,9 @@ private:
     record_flags            mFlags;
     uint32_t                mChannelMask;
     audio_io_handle_t       mInput;
+    // strong references held while a buffer from obtainReadBuffer() is outstanding
+    sp<IAudioRecord>        mReadRecord;
+    sp<IMemory>             mReadMemory;
 #ifdef QCOM_HARDWARE
     bool                    mFirstread;
 #endif
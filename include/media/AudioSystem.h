@@ -165,6 +165,12 @@ public:
         uint32_t latency;
     };
 
+    // returns the whole configuration of an output: from the cache when ioConfigChanged() has
+    // reported it, otherwise with a single IAudioFlinger::getOutputConfig() call
+    static status_t getOutputDescriptor(audio_io_handle_t output, OutputDescriptor *desc);
+    // same for the output the stream is currently routed to
+    static status_t getStreamOutputDescriptor(audio_stream_type_t stream, OutputDescriptor *desc);
+
     // Events used to synchronize actions between audio sessions.
     // For instance SYNC_EVENT_PRESENTATION_COMPLETE can be used to delay recording start until playback
     // is complete on another audio session.
@@ -288,6 +294,9 @@ private:
 
     static sp<IAudioPolicyService> gAudioPolicyService;
 
+    // output the stream is routed to, from gStreamOutputMap when known
+    static audio_io_handle_t getStreamOutput(audio_stream_type_t stream);
+
     // mapping between stream types and outputs
     static DefaultKeyedVector<audio_stream_type_t, audio_io_handle_t> gStreamOutputMap;
     // list of output descriptors containing cached parameters
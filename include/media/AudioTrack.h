@@ -349,6 +349,27 @@ public:
             status_t    setPositionUpdatePeriod(uint32_t updatePeriod);
             status_t    getPositionUpdatePeriod(uint32_t *updatePeriod) const;
 
+    /* Enables batched writes for a streaming track: a client blocked in write() or
+     * obtainBuffer() is only woken up once the frames played during latencyMs are free
+     * in the buffer, rather than after every mix period of AudioFlinger.  This trades
+     * buffer fill level for fewer wakeups of the client, and larger writes.
+     * The batch is limited to half the buffer.  latencyMs == 0 restores the default behavior.
+     *
+     * Parameters:
+     *
+     * latencyMs:  maximum duration of audio the client accepts being behind when woken up.
+     *
+     * Returned status (from utils/Errors.h) can be:
+     *  - NO_ERROR: successful operation
+     *  - INVALID_OPERATION: the AudioTrack uses a static buffer or is a timed track.
+     */
+            status_t    setWriteBatching(uint32_t latencyMs);
+
+    /* Returns the number of times a blocked write() or obtainBuffer() was woken up by
+     * AudioFlinger since the last call to setWriteBatching() or track creation.
+     */
+            uint32_t    getWakeups() const;
+
     /* Sets playback head position within AudioTrack buffer. The new position is specified
      * in number of frames.
      * This method must be called with the AudioTrack in paused or stopped state.
@@ -507,6 +528,7 @@ protected:
             status_t setLoop_l(uint32_t loopStart, uint32_t loopEnd, int loopCount);
             audio_io_handle_t getOutput_l();
             status_t restoreTrack_l(audio_track_cblk_t*& cblk, bool fromStart);
+            void applyWriteBatching_l();
             bool stopped_l() const { return !mActive; }
 
 #ifdef QCOM_HARDWARE
@@ -559,6 +581,9 @@ protected:
     bool                    mIsTimed;
     int                     mPreviousPriority;          // before start()
     SchedPolicy             mPreviousSchedulingGroup;
+    uint32_t                mWriteBatchMs;              // protected by mLock
+    uint32_t                mWakeups;                   // protected by mLock
+    nsecs_t                 mWakeupsSince;              // when mWakeups was last reset
 };
 
 class TimedAudioTrack : public AudioTrack
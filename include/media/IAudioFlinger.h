@@ -111,6 +111,15 @@ public:
     // return estimated latency in milliseconds
     virtual     uint32_t    latency(audio_io_handle_t output) const = 0;
 
+    // return the sample rate, format, channel mask, frame count and latency of an output
+    // in a single call, as reported to IAudioFlingerClient::ioConfigChanged()
+    virtual     status_t    getOutputConfig(audio_io_handle_t output,
+                                            uint32_t *samplingRate,
+                                            audio_format_t *format,
+                                            audio_channel_mask_t *channelMask,
+                                            size_t *frameCount,
+                                            uint32_t *latency) const = 0;
+
     /* set/get the audio hardware state. This will probably be used by
      * the preference panel, mostly.
      */
@@ -25,6 +25,7 @@
 namespace android {
 
 struct AString;
+struct IMemory;
 
 struct ICrypto : public IInterface {
     DECLARE_META_INTERFACE(Crypto);
@@ -51,6 +52,36 @@ struct ICrypto : public IInterface {
             void *dstPtr,
             AString *errorDetailMsg) = 0;
 
+    // One access unit of decryptBatch(), at mSrcOffset in the source memory
+    // and, unless secure, at mDstOffset in the destination memory. In secure
+    // mode mDstPtr is the opaque secure buffer to decrypt into.
+    struct DecryptUnit {
+        uint8_t mKey[16];
+        uint8_t mIV[16];
+        CryptoPlugin::Mode mMode;
+        size_t mSrcOffset;
+        size_t mDstOffset;
+        void *mDstPtr;
+        const CryptoPlugin::SubSample *mSubSamples;
+        size_t mNumSubSamples;
+    };
+
+    enum {
+        kMaxDecryptUnits = 64,
+    };
+
+    // Decrypts up to kMaxDecryptUnits access units in one call. Source and
+    // destination are shared memory, so unlike decrypt() no data is copied
+    // through the transaction. Stops at the first unit that fails and
+    // returns its error; *numDecrypted is the number of units done.
+    virtual status_t decryptBatch(
+            bool secure,
+            const sp<IMemory> &srcMem,
+            const sp<IMemory> &dstMem,
+            const DecryptUnit *units, size_t numUnits,
+            size_t *numDecrypted,
+            AString *errorDetailMsg) = 0;
+
 private:
     DISALLOW_EVIL_CONSTRUCTORS(ICrypto);
 };
@@ -34,6 +34,20 @@ namespace android {
 
 // ----------------------------------------------------------------------------
 
+/* Control block at the start of the memory returned by IDirectTrack::allocateRing(),
+ * followed by size bytes of ring data.  front and rear are byte counts which wrap
+ * around at 2^32: front is only advanced by the track, rear only by the client.
+ * The client publishes data by advancing rear, and only calls signalRing() if the
+ * track is waiting and at least watermark bytes are available.
+ */
+struct direct_track_ring_t {
+    volatile int32_t    front;
+    volatile int32_t    rear;
+    volatile int32_t    waiting;
+    uint32_t            size;
+    uint32_t            watermark;
+};
+
 class IDirectTrack : public IInterface
 {
 public:
@@ -73,6 +87,15 @@ public:
     virtual ssize_t     write(const void*, size_t) =  0;
 
     virtual int64_t     getTimeStamp() =  0;
+
+    /* Switches the track to ring mode and returns the shared ring, which holds a
+     * direct_track_ring_t followed by size bytes of data.  In ring mode write() must
+     * not be used: the track plays whatever the client adds to the ring.
+     */
+    virtual sp<IMemory> allocateRing(size_t size, size_t watermark) = 0;
+
+    /* Wakes up a track waiting for data in its ring. */
+    virtual void        signalRing() = 0;
 };
 
 // ----------------------------------------------------------------------------
@@ -167,6 +167,10 @@ public:
     DECLARE_META_INTERFACE(OMXObserver);
 
     virtual void onMessage(const omx_message &msg) = 0;
+
+    // Delivers messages that were queued up together, in order, with a
+    // single transaction. The default hands them to onMessage one by one.
+    virtual void onMessages(const List<omx_message> &messages);
 };
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -18,6 +18,7 @@
 #define JETPLAYER_H_
 
 #include <utils/threads.h>
+#include <utils/Vector.h>
 
 #include <libsonivox/jet.h>
 #include <libsonivox/eas_types.h>
@@ -39,9 +40,11 @@ public:
     static const int JET_NUMQUEUEDSEGMENT_UPDATE = 3;
     static const int JET_PAUSE_UPDATE            = 4;
 
+    // renderQueueDepth is the number of blocks rendered ahead of the AudioTrack
     JetPlayer(void *javaJetPlayer,
             int maxTracks = 32,
-            int trackBufferSize = 1200);
+            int trackBufferSize = 1200,
+            int renderQueueDepth = 2);
     ~JetPlayer();
     int init();
     int release();
@@ -67,6 +70,10 @@ private:
     int                 render();
     void                fireUpdateOnStatusChange();
     void                fireEventsFromJetQueue();
+    void                queuePendingSegments();
+    void                writeRenderQueue(const EAS_PCM* data, size_t size);
+    size_t              readRenderQueue(void* data, size_t size);
+    static void         audioCallback(int event, void* user, void *info);
 
     JetPlayer() {} // no default constructor
     void dump();
@@ -95,6 +102,29 @@ private:
 
     char                mJetFilePath[PATH_MAX];
 
+    // segments from queueSegment(), handed to JET by the render thread so that the caller
+    // does not wait for the segment to be loaded
+    struct PendingSegment {
+        int                 segmentNum;
+        int                 libNum;
+        int                 repeatCount;
+        int                 transpose;
+        EAS_U32             muteFlags;
+        EAS_U8              userID;
+    };
+    Mutex               mPendingLock;
+    Vector<PendingSegment> mPendingSegments;
+
+    // ring of audio rendered ahead of the AudioTrack, read by its callback thread
+    Mutex               mQueueLock;
+    Condition           mQueueCondition;
+    EAS_PCM*            mRenderQueue;
+    int                 mRenderQueueDepth;  // in blocks of MIX_NUM_BUFFERS mix buffers
+    size_t              mBlockSize;         // in bytes
+    size_t              mQueueSize;         // in bytes
+    size_t              mQueueReadOffset;   // in bytes
+    size_t              mQueueFilled;       // in bytes
+
     class JetPlayerThread : public Thread {
     public:
         JetPlayerThread(JetPlayer *player) : mPlayer(player) {
@@ -403,6 +403,12 @@ private:
     // If the xml configuration file does exist, use the settings
     // from the xml
     static MediaProfiles* createInstanceFromXmlFile(const char *xml);
+
+    // Uses the snapshot of the xml configuration file written the first
+    // time it was parsed, or parses the file and writes the snapshot.
+    static MediaProfiles* createInstanceFromCacheOrXmlFile(const char *xml);
+    static MediaProfiles* createInstanceFromCache(const char *xml);
+    void writeCache(const char *xml) const;
     static output_format createEncoderOutputFileFormat(const char **atts);
     static VideoCodec* createVideoCodec(const char **atts, MediaProfiles *profiles);
     static AudioCodec* createAudioCodec(const char **atts, MediaProfiles *profiles);
@@ -35,7 +35,7 @@ class SoundPool;
 // for queued events
 class SoundPoolEvent {
 public:
-    SoundPoolEvent(int msg, int arg1=0, int arg2=0) :
+    SoundPoolEvent(int msg=INVALID, int arg1=0, int arg2=0) :
         mMsg(msg), mArg1(arg1), mArg2(arg2) {}
     int         mMsg;
     int         mArg1;
@@ -122,6 +122,9 @@ public:
     void init(SoundPool* soundPool);
     void play(const sp<Sample>& sample, int channelID, float leftVolume, float rightVolume,
             int priority, int loop, float rate);
+    // creates a stopped track for this configuration if the channel is idle and has no
+    // compatible one, so that the next play() of such a sample can reuse it
+    void prewarm(uint32_t sampleRate, int numChannels, audio_format_t format);
     void setVolume_l(float leftVolume, float rightVolume);
     void setVolume(float leftVolume, float rightVolume);
     void stop_l();
@@ -144,6 +147,10 @@ private:
     static void callback(int event, void* user, void *info);
     void process(int event, void *info, unsigned long toggle);
     bool doStop_l();
+    bool canReuseTrack_l(uint32_t sampleRate, int numChannels, audio_format_t format,
+            uint32_t frameCount);
+    AudioTrack* createTrack(uint32_t sampleRate, int numChannels, audio_format_t format,
+            uint32_t frameCount, uint32_t bufferFrames, unsigned long toggle);
 
     SoundPool*          mSoundPool;
     AudioTrack*         mAudioTrack;
@@ -180,6 +187,15 @@ public:
     void setRate(int channelID, float rate);
     audio_stream_type_t streamType() const { return mStreamType; }
     int srcQuality() const { return mSrcQuality; }
+    // AUDIO_OUTPUT_FLAG_FAST by default, applies to the tracks created from now on
+    void setOutputFlags(audio_output_flags_t flags);
+    audio_output_flags_t outputFlags() const { return mOutputFlags; }
+    // stopped tracks are created ahead of time on up to count idle channels, so that
+    // play() of a sample with this configuration does not wait for AudioFlinger
+    void prewarm(uint32_t sampleRate, int numChannels, audio_format_t format, int count);
+    // with several decode threads (media.soundpool.decode-threads), samples may finish
+    // loading out of order; this delivers their SAMPLE_LOADED events in load() order
+    void setLoadCallbacksInOrder(bool inOrder);
 
     // called from SoundPoolThread
     void sampleLoaded(int sampleID);
@@ -222,6 +238,7 @@ private:
     int                     mMaxChannels;
     audio_stream_type_t     mStreamType;
     int                     mSrcQuality;
+    audio_output_flags_t    mOutputFlags;
     int                     mAllocated;
     int                     mNextSampleID;
     int                     mNextChannelID;
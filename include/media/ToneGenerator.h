@@ -288,7 +288,7 @@ private:
             WAVEGEN_STOP  // Stop wave on zero crossing
         };
 
-        WaveGenerator(unsigned short samplingRate, unsigned short frequency,
+        WaveGenerator(uint32_t samplingRate, unsigned short frequency,
                 float volume);
         ~WaveGenerator();
 
@@ -297,13 +297,18 @@ private:
 
     private:
         static const short GEN_AMP = 32000;  // amplitude of generator
-        static const short S_Q14 = 14;  // shift for Q14
         static const short S_Q15 = 15;  // shift for Q15
 
-        short mA1_Q14;  // Q14 coefficient
-        // delay line of full amplitude generator
-        short mS1, mS2;  // delay line S2 oldest
-        short mS2_0;  // saved value for reinitialisation
+        // one period of a GEN_AMP sine, plus the first sample again so that
+        // interpolation never needs to wrap around
+        static const int kSineTableBits = 9;
+        static const int kSineTableSize = 1 << kSineTableBits;
+        static short sSineTable[kSineTableSize + 1];
+        static pthread_once_t sSineTableOnce;
+        static void initSineTable();
+
+        uint32_t mPhase;  // current phase, 2^32 is one period
+        uint32_t mPhaseIncrement;  // phase increment per sample
         short mAmplitude_Q15;  // Q15 amplitude
     };
 
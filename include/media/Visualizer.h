@@ -21,6 +21,10 @@
 #include <audio_effects/effect_visualizer.h>
 #include <string.h>
 
+// Proprietary command of the platform Visualizer effect returning the waveform followed by
+// its FFT as computed by getFft(). Must match the definition in EffectVisualizer.cpp.
+#define VISUALIZER_CMD_CAPTURE_FFT (VISUALIZER_CMD_CAPTURE + 1)
+
 /**
  * The Visualizer class enables application to retrieve part of the currently playing audio for
  * visualization purpose. It is not an audio recording interface and only returns partial and low
@@ -150,6 +154,8 @@ private:
     };
 
     status_t doFft(uint8_t *fft, uint8_t *waveform);
+    // captures the waveform and its FFT, computed by the effect when supported
+    status_t getWaveFormAndFft(uint8_t *waveform, uint8_t *fft);
     void periodicCapture();
     uint32_t initCaptureSize();
 
@@ -162,6 +168,7 @@ private:
     void *mCaptureCbkUser;
     sp<CaptureThread> mCaptureThread;
     uint32_t mCaptureFlags;
+    bool mEffectFft;    // false once the effect failed VISUALIZER_CMD_CAPTURE_FFT
 };
 
 
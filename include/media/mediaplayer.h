@@ -153,6 +153,23 @@ enum media_parameter_keys {
     // Playback rate expressed in permille (1000 is normal speed), saved as int32_t, with negative
     // values used for rewinding or reverse playback.
     KEY_PARAMETER_PLAYBACK_RATE_PERMILLE = 1300,                // set only
+
+    // Return a Parcel containing five int64s describing video frame timing: frames
+    // decoded, frames dropped before decoding, frames rendered on time, frames rendered
+    // more than one display refresh late and frames dropped by the renderer.
+    KEY_PARAMETER_VIDEO_FRAME_STATS = 1400,                     // get only
+
+    // How following seeks position the stream, saved as int32_t: 0 starts at the closest
+    // sync frame, 1 does the same and then decodes only sync frames (scrubbing), 2 starts
+    // exactly at the seek time by decoding without rendering from the preceding sync frame.
+    KEY_PARAMETER_SEEK_MODE = 1500,                             // set only
+
+    // Return a Parcel containing nine int64s describing decoding and rendering so far:
+    // video frames decoded, video frames dropped, average decode time per video frame in
+    // us, current and maximum video lateness against the audio clock in us, number of
+    // rebuffering events, total time spent rebuffering in us, bytes cached ahead and
+    // duration cached ahead in us. Values a player cannot measure are -1.
+    KEY_PARAMETER_PLAYBACK_STATS = 1600,                        // get only
 };
 
 // Keep INVOKE_ID_* in sync with MediaPlayer.java.
@@ -21,6 +21,8 @@
 #include <utils/threads.h>
 #include <utils/List.h>
 #include <utils/Errors.h>
+#include <utils/String8.h>
+#include <utils/Vector.h>
 #include <pthread.h>
 
 struct dirent;
@@ -51,6 +53,14 @@ struct MediaScanner {
     virtual MediaScanResult processDirectory(
             const char *path, MediaScannerClient &client);
 
+    // Scans all of |paths| as if by processFile(), using up to |maxThreads|
+    // threads where the scanner supports it. The client is only ever called
+    // from the calling thread, one file after another in the order given.
+    // Stops at the first file that results in MEDIA_SCAN_RESULT_ERROR.
+    virtual MediaScanResult processFiles(
+            const Vector<String8> &paths, MediaScannerClient &client,
+            size_t maxThreads);
+
     void setLocale(const char *locale);
 
     // extracts album art as a block of data
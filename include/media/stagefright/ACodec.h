@@ -61,14 +61,20 @@ struct ACodec : public AHierarchicalStateMachine {
         IOMX::buffer_id bufferIDAt(size_t index) const;
         sp<ABuffer> bufferAt(size_t index) const;
 
+        // The shared memory behind bufferAt(index), NULL if it has none.
+        sp<IMemory> memoryAt(size_t index) const;
+
     private:
         friend struct ACodec;
 
         Vector<IOMX::buffer_id> mBufferIDs;
         Vector<sp<ABuffer> > mBuffers;
+        Vector<sp<IMemory> > mMemories;
 
         PortDescription();
-        void addBuffer(IOMX::buffer_id id, const sp<ABuffer> &buffer);
+        void addBuffer(
+                IOMX::buffer_id id, const sp<ABuffer> &buffer,
+                const sp<IMemory> &mem);
 
         DISALLOW_EVIL_CONSTRUCTORS(PortDescription);
     };
@@ -127,7 +133,13 @@ private:
         Status mStatus;
 
         sp<ABuffer> mData;
+        sp<IMemory> mMem;
         sp<GraphicBuffer> mGraphicBuffer;
+
+        // The messages of the last transit of this buffer to or from the
+        // client, kept for reuse by the next one.
+        sp<AMessage> mTransitNotify;
+        sp<AMessage> mTransitReply;
     };
 
     sp<AMessage> mNotify;
@@ -161,6 +173,11 @@ private:
     bool mSentFormat;
     bool mIsEncoder;
 
+    // Systrace counters of this kind of codec, the same as OMXCodec's.
+    const char *mInputTimeTraceName;
+    const char *mOutputTimeTraceName;
+    const char *mOutputQueuedTraceName;
+
     bool mShutdownInProgress;
 
     // If "mKeepComponentAllocated" we only transition back to Loaded state
@@ -185,6 +202,13 @@ private:
     status_t freeOutputBuffersNotOwnedByComponent();
     BufferInfo *dequeueBufferFromNativeWindow();
 
+    // Returns the notification and reply messages for handing "info" to
+    // the client, reusing those of its previous transit once nobody else
+    // refers to them, so that a buffer round trip doesn't allocate.
+    void obtainTransitMessages(
+            BufferInfo *info, uint32_t replyWhat,
+            sp<AMessage> *notify, sp<AMessage> *reply);
+
     BufferInfo *findBufferByID(
             uint32_t portIndex, IOMX::buffer_id bufferID,
             ssize_t *index = NULL);
@@ -247,6 +271,7 @@ private:
     bool allYourBuffersAreBelongToUs();
 
     size_t countBuffersOwnedByComponent(OMX_U32 portIndex) const;
+    size_t countBuffersOwnedByDownstream(OMX_U32 portIndex) const;
 
     void deferMessage(const sp<AMessage> &msg);
     void processDeferredMessages();
@@ -21,12 +21,14 @@
 
 #include <media/MediaPlayerInterface.h>
 #include <media/stagefright/MediaBuffer.h>
+#include <media/stagefright/MediaSource.h>
 #include <media/stagefright/TimeSource.h>
 #include <utils/threads.h>
 
+#include <pthread.h>
+
 namespace android {
 
-class MediaSource;
 class AudioTrack;
 class AwesomePlayer;
 
@@ -130,6 +132,59 @@ private:
     AwesomePlayer *mObserver;
     int64_t mPinnedTimeUs;
 
+    // What getRealTimeUs(), getMediaTimeUs() and getMediaTimeMapping()
+    // need, copied from the fields above whenever they change under mLock.
+    // The copy is guarded by a sequence count that is odd while it is
+    // being written, so that AwesomePlayer's video event can read the
+    // time without ever waiting for the audio callback.
+    struct TimeMapping {
+        int64_t mNumFramesPlayed;
+        int64_t mNumFramesPlayedSysTimeUs;
+        int64_t mPinnedTimeUs;
+        int64_t mPositionTimeMediaUs;
+        int64_t mPositionTimeRealUs;
+        int64_t mLatencyUs;
+        int64_t mSeekTimeUs;
+        bool mSeeking;
+        bool mReachedEOS;
+    };
+
+    volatile int32_t mTimeMappingSeq;
+    TimeMapping mTimeMapping;
+
+    void publishTimeMapping_l();
+    void readTimeMapping(TimeMapping *mapping) const;
+
+    // The next decoded buffer, read from mSource on the prefetch thread
+    // while the audio callback drains mInputBuffer.
+    Mutex mPrefetchLock;
+    Condition mPrefetchCondition;
+    pthread_t mPrefetchThread;
+    bool mPrefetchStarted;
+    bool mPrefetchDone;
+
+    // Set while the thread is inside mSource->read().
+    bool mPrefetchReading;
+
+    // Set while the audio callback performs a seek, the thread stays idle.
+    bool mPrefetchSeeking;
+
+    // Set once a read has failed, the thread stays idle until the next seek.
+    bool mPrefetchReachedEOS;
+
+    bool mPrefetchReady;
+    MediaBuffer *mPrefetchedBuffer;
+    status_t mPrefetchResult;
+
+    void startPrefetch();
+    void stopPrefetch();
+    void flushPrefetch_l();
+    status_t readSource(
+            MediaBuffer **buffer, const MediaSource::ReadOptions &options);
+
+    static void *PrefetchThreadWrapper(void *me);
+    void prefetchThreadEntry();
+
     static void AudioCallback(int event, void *user, void *info);
     void AudioCallback(int event, void *info);
 
@@ -139,7 +194,7 @@ private:
 
     size_t fillBuffer(void *data, size_t size);
 
-    int64_t getRealTimeUsLocked() const;
+    int64_t getRealTimeUs(const TimeMapping &mapping) const;
 
     void reset();
 
@@ -24,6 +24,7 @@
 #include <media/stagefright/MediaSource.h>
 #include <media/stagefright/MediaBuffer.h>
 #include <utils/List.h>
+#include <utils/Vector.h>
 
 #include <system/audio.h>
 
@@ -67,6 +68,10 @@ private:
         // This is the initial mute duration to suppress
         // the video recording signal tone
         kAutoRampStartUs = 700000,
+
+        // Upper bound for the capture batch configured through
+        // "media.stagefright.audio-batch-ms".
+        kMaxBatchDurationMs = 500,
     };
 
     Mutex mLock;
@@ -88,6 +93,17 @@ private:
 
     List<MediaBuffer * > mBuffersReceived;
 
+    // When non-zero, callback data is collected into buffers of this
+    // many bytes taken from mFreeBuffers instead of being queued as a
+    // new buffer per AudioRecord callback.
+    size_t mBatchSizeBytes;
+    Vector<MediaBuffer *> mFreeBuffers;
+
+    // The batch currently being filled and the callback time of the
+    // data at its start.
+    MediaBuffer *mPendingBuffer;
+    int64_t mPendingBufferTimeUs;
+
     void trackMaxAmplitude(int16_t *data, int nSamples);
 
     // This is used to raise the volume from mute to the
@@ -97,6 +113,9 @@ private:
         uint8_t *data,   size_t bytes);
 
     void queueInputBuffer_l(MediaBuffer *buffer, int64_t timeUs);
+    void initBatching();
+    void batchInputData_l(const uint8_t *data, size_t size, int64_t timeUs);
+    void releaseFreeBuffers_l();
     void releaseQueuedFrames_l();
     void waitOutstandingEncodingFrames_l();
     status_t reset();
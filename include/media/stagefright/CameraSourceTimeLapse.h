@@ -140,6 +140,12 @@ private:
     // Otherwise returns false.
     bool trySettingVideoSize(int32_t width, int32_t height);
 
+    // Lowers the camera's preview frame rate to the lowest supported one
+    // that still delivers a few frames per capture interval, so that fewer
+    // frames are delivered only to be skipped. Returns true if the frame
+    // rate was changed.
+    bool trySettingCaptureFrameRate();
+
     // When video camera is used for time lapse capture, returns true
     // until enough time has passed for the next time lapse frame. When
     // the frame needs to be encoded, it returns false and also modifies
@@ -150,9 +156,6 @@ private:
     // Wrapper to enter threadTimeLapseEntry()
     static void *ThreadTimeLapseWrapper(void *me);
 
-    // Creates a copy of source_data into a new memory of final type MemoryBase.
-    sp<IMemory> createIMemoryCopy(const sp<IMemory> &source_data);
-
     CameraSourceTimeLapse(const CameraSourceTimeLapse &);
     CameraSourceTimeLapse &operator=(const CameraSourceTimeLapse &);
 };
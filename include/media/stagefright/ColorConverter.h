@@ -23,6 +23,8 @@
 
 #include <stdint.h>
 #include <utils/Errors.h>
+#include <utils/threads.h>
+#include <utils/Vector.h>
 
 #include <OMX_Video.h>
 
@@ -34,6 +36,16 @@ struct ColorConverter {
 
     bool isValid() const;
 
+    // Lets convert() split large frames into bands of rows that are
+    // converted concurrently by up to |numThreads| threads, including the
+    // calling one. The default of 1 converts on the calling thread only.
+    void setNumThreads(size_t numThreads);
+
+    // Whether convert() accepts a destination crop rectangle of a
+    // different size than the source one, in which case the source is
+    // resampled to fit.
+    bool supportsScaling() const;
+
     status_t convert(
             const void *srcBits,
             size_t srcWidth, size_t srcHeight,
@@ -60,25 +72,90 @@ private:
         size_t mCropLeft, mCropTop, mCropRight, mCropBottom;
     };
 
+    // Where the rows of the crop rectangle of a 4:2:0 source start. Each
+    // chroma row covers two luma rows and consecutive chroma samples are
+    // |mChromaStep| bytes apart.
+    struct PlaneLayout {
+        const uint8_t *mY, *mU, *mV;
+        size_t mLumaStride, mChromaStride, mChromaStep;
+        bool mSwapRB;
+    };
+
+    struct Worker;
+
+    // Converts |numRows| rows of the destination crop rectangle starting at
+    // the even row |firstRow|.
+    typedef status_t (ColorConverter::*ConvertFunc)(
+            const BitmapParams &src, const BitmapParams &dst,
+            size_t firstRow, size_t numRows);
+
     OMX_COLOR_FORMATTYPE mSrcFormat, mDstFormat;
     uint8_t *mClip;
 
+    size_t mNumThreads;
+    Vector<sp<Worker> > mWorkers;
+
+    // Protects the current job below, which is handed out band by band.
+    Mutex mLock;
+    Condition mWorkAvailableCondition;
+    Condition mWorkDoneCondition;
+    bool mExiting;
+    ConvertFunc mJobFunc;
+    const BitmapParams *mJobSrc;
+    const BitmapParams *mJobDst;
+    size_t mJobNumRows;
+    size_t mJobRowsPerBand;
+    size_t mJobNumBands;
+    size_t mJobNextBand;
+    size_t mJobBandsPending;
+    status_t mJobErr;
+
     uint8_t *initClip();
 
+    status_t convertRows(
+            ConvertFunc func, const BitmapParams &src, const BitmapParams &dst);
+
+    void convertNextBand_l();
+    bool workerLoop();
+
     status_t convertCbYCrY(
-            const BitmapParams &src, const BitmapParams &dst);
+            const BitmapParams &src, const BitmapParams &dst,
+            size_t firstRow, size_t numRows);
 
     status_t convertYUV420Planar(
-            const BitmapParams &src, const BitmapParams &dst);
+            const BitmapParams &src, const BitmapParams &dst,
+            size_t firstRow, size_t numRows);
 
     status_t convertQCOMYUV420SemiPlanar(
-            const BitmapParams &src, const BitmapParams &dst);
+            const BitmapParams &src, const BitmapParams &dst,
+            size_t firstRow, size_t numRows);
 
     status_t convertYUV420SemiPlanar(
-            const BitmapParams &src, const BitmapParams &dst);
+            const BitmapParams &src, const BitmapParams &dst,
+            size_t firstRow, size_t numRows);
 
     status_t convertTIYUV420PackedSemiPlanar(
-            const BitmapParams &src, const BitmapParams &dst);
+            const BitmapParams &src, const BitmapParams &dst,
+            size_t firstRow, size_t numRows);
+
+    // Nearest neighbour resampling of any of the formats with a
+    // PlaneLayout.
+    status_t convertScaledYUV420(
+            const BitmapParams &src, const BitmapParams &dst,
+            size_t firstRow, size_t numRows);
+
+    void getPlaneLayout(const BitmapParams &src, PlaneLayout *layout) const;
+
+    static bool isValidARGBSource(OMX_COLOR_FORMATTYPE format);
+
+    // Converts one row of 4:2:0 YUV to RGB565 or, if |argb| is set, to
+    // ARGB8888. Consecutive chroma samples are |chromaStep| bytes apart,
+    // 1 for planar and 2 for semi-planar sources. |swapRB| exchanges red
+    // and blue, as the semi-planar QCOM and NV12 converters always have.
+    static void convertRow(
+            const uint8_t *src_y, const uint8_t *src_u, const uint8_t *src_v,
+            size_t chromaStep, bool swapRB, const uint8_t *kAdjustedClip,
+            void *dstBits, bool argb, size_t width);
 
     ColorConverter(const ColorConverter &);
     ColorConverter &operator=(const ColorConverter &);
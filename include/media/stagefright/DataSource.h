@@ -31,6 +31,7 @@
 
 namespace android {
 
+struct ABuffer;
 struct AMessage;
 class String8;
 
@@ -71,6 +72,13 @@ public:
         return ERROR_UNSUPPORTED;
     }
 
+    // Returns the size bytes at offset without copying them, if they are
+    // in memory already, or NULL. The returned buffer keeps that memory
+    // alive, and should be treated as read-only.
+    virtual sp<ABuffer> getMappedRange(off64_t offset, size_t size) {
+        return NULL;
+    }
+
     ////////////////////////////////////////////////////////////////////////////
 
     bool sniff(String8 *mimeType, float *confidence, sp<AMessage> *meta);
@@ -22,6 +22,7 @@
 
 #include <media/stagefright/DataSource.h>
 #include <media/stagefright/MediaErrors.h>
+#include <utils/String8.h>
 #include <utils/threads.h>
 #include <drm/DrmManagerClient.h>
 
@@ -38,6 +39,8 @@ public:
 
     virtual status_t getSize(off64_t *size);
 
+    virtual sp<ABuffer> getMappedRange(off64_t offset, size_t size);
+
 #ifdef QCOM_HARDWARE
     virtual status_t getCurrentOffset(off64_t *size);
 #endif
@@ -46,6 +49,12 @@ public:
 
     virtual void getDrmInfo(sp<DecryptHandle> &handle, DrmManagerClient **client);
 
+    // The path of the file, if known, used as a hint by sniff().
+    virtual String8 getUri();
+
+    // The number of system calls issued to read the file so far.
+    uint32_t getNumSyscalls();
+
 protected:
     virtual ~FileSource();
 
@@ -53,8 +62,22 @@ private:
     int mFd;
     int64_t mOffset;
     int64_t mLength;
+    String8 mUri;
     Mutex mLock;
 
+    // Set if the file is memory mapped, see init().
+    uint8_t *mMapping;
+    size_t mMappingSize;
+    uint8_t *mData;
+
+    // Access pattern, for the madvise() hints of the mapping.
+    off64_t mLastReadEnd;
+    uint32_t mNumSequentialReads;
+    int mAdvice;
+    off64_t mReadAheadEnd;
+
+    uint32_t mNumSyscalls;
+
     /*for DRM*/
     sp<DecryptHandle> mDecryptHandle;
     DrmManagerClient *mDrmManagerClient;
@@ -62,6 +85,9 @@ private:
     int64_t mDrmBufSize;
     unsigned char *mDrmBuf;
 
+    void init();
+    void adviseAccess_l(off64_t offset, size_t size);
+
     ssize_t readAtDRM(off64_t offset, void *data, size_t size);
 
     FileSource(const FileSource &);
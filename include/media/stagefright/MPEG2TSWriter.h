@@ -49,7 +49,17 @@ protected:
 
 private:
     enum {
-        kWhatSourceNotify = 'noti'
+        kWhatSourceNotify = 'noti',
+        kWhatWritePCR     = 'pcr ',
+        kWhatFlush        = 'flsh',
+    };
+
+    enum {
+        kTSPacketSize = 188,
+
+        // Packets are collected and written out this many at a time,
+        // 7 packets (1316 bytes) fill a UDP datagram on ethernet.
+        kNumTSPacketsPerWrite = 7,
     };
 
     struct SourceInfo;
@@ -70,8 +80,27 @@ private:
     int64_t mNumTSPacketsWritten;
     int64_t mNumTSPacketsBeforeMeta;
 
+    // Packets are assembled in place and written out once the arena
+    // holds kNumTSPacketsPerWrite of them.
+    uint8_t *mPacketArena;
+    size_t mNumPacketsInArena;
+
+    // PCRs are sent on a fixed schedule, derived from the time of the
+    // first access unit and the time elapsed since it was written.
+    bool mPCRStarted;
+    int32_t mPCRGeneration;
+    int64_t mPCRBaseTimeUs;
+    int64_t mPCRBaseRealTimeUs;
+    int64_t mNextPCRRealTimeUs;
+
     void init();
 
+    uint8_t *nextTSPacket();
+    void flushTSPackets();
+
+    void startPCR(int64_t timeUs);
+    void writePCR();
+
     void writeTS();
     void writeProgramAssociationTable();
     void writeProgramMap();
@@ -78,10 +78,15 @@ private:
     off_t mMdatOffset;
     uint8_t *mMoovBoxBuffer;
     off64_t mMoovBoxBufferOffset;
+    off64_t mMoovBoxBufferSize;
     bool  mWriteMoovBoxToMemory;
     off64_t mFreeBoxOffset;
     bool mStreamableFile;
     off64_t mEstimatedMoovBoxSize;
+
+    // Whether a movie box outgrowing its reserved space is moved in front
+    // of the media data at stop rather than written after it.
+    bool mRelocateMoovBox;
     uint32_t mInterleaveDurationUs;
     int32_t mTimeScale;
     int64_t mStartTimestampUs;
@@ -90,6 +95,29 @@ private:
     bool mAreGeoTagsAvailable;
     int32_t mStartTimeOffsetMs;
 
+    // Fragmented files carry a movie box without samples, written once
+    // the codec specific data of all tracks is known, followed by one
+    // 'moof'/'mdat' pair per track fragment of about mFragmentDurationUs.
+    // The movie box is rewritten with the durations and a 'mfra' box is
+    // appended when recording stops.
+    int64_t mFragmentDurationUs;
+    bool mFragmentsStarted;  // Every track had a fragment to write
+    off64_t mMoovOffset;     // -1 until the movie box is written
+    off64_t mMoovSize;
+    uint32_t mFragmentSequenceNumber;
+
+    // Sequential writes to mFd are collected in mWriteBuffer and written
+    // out in large pieces ending on kWriteAlignment boundaries. Only one
+    // thread writes samples at a time, the writer thread or the single
+    // track's thread.
+    uint8_t *mWriteBuffer;
+    size_t mWriteBufferLength;
+    off64_t mWriteBufferFileOffset;  // where mWriteBuffer starts in the file
+
+    int64_t mNumFileWrites;
+    int64_t mTotalFileWriteTimeUs;
+    int64_t mMaxFileWriteTimeUs;
+
     Mutex mLock;
 
     List<Track *> mTracks;
@@ -133,6 +161,10 @@ private:
     List<ChunkInfo> mChunkInfos;            // Chunk infos
     Condition       mChunkReadyCondition;   // Signal that chunks are available
 
+    void writeFile(const void *data, size_t size);
+    void seekFile(off64_t offset);
+    void flushWriteBuffer(bool all);
+
     // Writer thread handling
     status_t startWriterThread();
     void stopWriterThread();
@@ -173,10 +205,17 @@ private:
     bool use32BitFileOffset() const;
     bool exceedsFileDurationLimit();
     bool isFileStreamable() const;
+    bool isFragmented() const { return mFragmentDurationUs > 0; }
+    int64_t fragmentDuration() const { return mFragmentDurationUs; }
     void trackProgressStatus(size_t trackId, int64_t timeUs, status_t err = OK);
     void writeCompositionMatrix(int32_t degrees);
     void writeMvhdBox(int64_t durationUs);
     void writeMoovBox(int64_t durationUs);
+    status_t relocateMoovBox(int64_t durationUs);
+    status_t shiftMediaData(off64_t shift);
+    void writeMvexBox(int64_t durationUs);
+    void writeMfraBox();
+    void finalizeFragmentedFile(int64_t durationUs);
     void writeFtypBox(MetaData *param);
     void writeUdtaBox();
     void writeGeoDataBox();
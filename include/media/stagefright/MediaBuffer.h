@@ -54,6 +54,12 @@ public:
 
     MediaBuffer(const sp<ABuffer> &buffer);
 
+    // Wraps buffer without copying it, e.g. a view returned by
+    // DataSource::getMappedRange(). The MediaBuffer is returned with a
+    // reference like one acquired from a MediaBufferGroup, and deletes
+    // itself once that and those of its clones are released.
+    static MediaBuffer *CreateView(const sp<ABuffer> &buffer);
+
     // Decrements the reference count and returns the buffer to its
     // associated MediaBufferGroup if the reference count drops to 0.
     void release();
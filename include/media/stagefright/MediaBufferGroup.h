@@ -21,6 +21,7 @@
 #include <media/stagefright/MediaBuffer.h>
 #include <utils/Errors.h>
 #include <utils/threads.h>
+#include <utils/Vector.h>
 
 namespace android {
 
@@ -34,10 +35,24 @@ public:
 
     void add_buffer(MediaBuffer *buffer);
 
+    // Lets the group allocate buffers of the size of the first one added,
+    // up to maxNumBuffers in total, rather than block when all are in use.
+    void setMaxNumBuffers(size_t maxNumBuffers);
+
     // Blocks until a buffer is available and returns it to the caller,
     // the returned buffer will have a reference count of 1.
     status_t acquire_buffer(MediaBuffer **buffer);
 
+    struct Stats {
+        uint32_t mNumBuffers;
+        uint32_t mNumAcquires;
+        uint32_t mNumWaits;     // acquisitions that had to block
+        int64_t mWaitTimeUs;    // total time blocked
+        int64_t mMaxWaitTimeUs;
+    };
+
+    void getStats(Stats *stats);
+
 protected:
     virtual void signalBufferReturned(MediaBuffer *buffer);
 
@@ -49,6 +64,15 @@ private:
 
     MediaBuffer *mFirstBuffer, *mLastBuffer;
 
+    // The buffers with a reference count of 0, most recently returned last.
+    Vector<MediaBuffer *> mFreeBuffers;
+    size_t mNumWaiters;
+
+    size_t mMaxNumBuffers;
+    Stats mStats;
+
+    void add_buffer_l(MediaBuffer *buffer);
+
     MediaBufferGroup(const MediaBufferGroup &);
     MediaBufferGroup &operator=(const MediaBufferGroup &);
 };
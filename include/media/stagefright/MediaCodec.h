@@ -21,6 +21,7 @@
 #include <gui/ISurfaceTexture.h>
 #include <media/hardware/CryptoAPI.h>
 #include <media/stagefright/foundation/AHandler.h>
+#include <utils/threads.h>
 #include <utils/Vector.h>
 
 namespace android {
@@ -30,6 +31,8 @@ struct ACodec;
 struct AMessage;
 struct AString;
 struct ICrypto;
+struct IMemory;
+struct MemoryDealer;
 struct SoftwareRenderer;
 struct SurfaceTextureClient;
 
@@ -106,6 +109,11 @@ struct MediaCodec : public AHandler {
     status_t getInputBuffers(Vector<sp<ABuffer> > *buffers) const;
     status_t getOutputBuffers(Vector<sp<ABuffer> > *buffers) const;
 
+    // Posts a copy of "notify" whenever dequeueInputBuffer ("output" = 0) or
+    // dequeueOutputBuffer ("output" = 1) stops returning -EAGAIN, i.e. when a
+    // buffer, an output change or an error becomes available. NULL disables it.
+    void setDequeueNotify(const sp<AMessage> &notify);
+
 protected:
     virtual ~MediaCodec();
     virtual void onMessageReceived(const sp<AMessage> &msg);
@@ -160,7 +168,9 @@ private:
     struct BufferInfo {
         void *mBufferID;
         sp<ABuffer> mData;
+        sp<IMemory> mMem;               // behind mData, if shared
         sp<ABuffer> mEncryptedData;
+        sp<IMemory> mEncryptedMem;      // behind mEncryptedData, if shared
         sp<AMessage> mNotify;
         bool mOwnedByClient;
     };
@@ -186,8 +196,20 @@ private:
 
     sp<ICrypto> mCrypto;
 
+    // Holds the encrypted input in memory shared with the crypto service,
+    // which then decrypts without copying data through binder.
+    sp<MemoryDealer> mCryptoDealer;
+
     List<sp<ABuffer> > mCSD;
 
+    // Whether a dequeue on each port would return something other than
+    // -EAGAIN, published by the looper after each message so that callers
+    // can wait for it without posting messages.
+    Mutex mDequeueLock;
+    Condition mDequeueCondition;
+    bool mDequeueReady[2];
+    sp<AMessage> mDequeueNotify;
+
     MediaCodec(const sp<ALooper> &looper);
 
     static status_t PostAndAwaitResponse(
@@ -207,6 +229,9 @@ private:
     bool handleDequeueOutputBuffer(uint32_t replyID, bool newRequest = false);
     void cancelPendingDequeueOperations();
 
+    void updateDequeueReady();
+    bool waitForDequeueReady(int32_t portIndex, int64_t timeoutUs);
+
     void extractCSD(const sp<AMessage> &format);
     status_t queueCSDInputBuffer(size_t bufferIndex);
 
@@ -84,6 +84,9 @@ private:
     status_t initCheck() const;
     void parseXMLFile(FILE *file);
 
+    status_t readCache(const char *cachePath, const char *xmlPath);
+    void writeCache(const char *cachePath, const char *xmlPath) const;
+
     static void StartElementHandlerWrapper(
             void *me, const char *name, const char **attrs);
 
@@ -29,8 +29,16 @@ class MetaData;
 
 class MediaExtractor : public RefBase {
 public:
+    enum CreateFlags {
+        // The extractor is only asked for container and track metadata,
+        // extractors that support it skip building their sample indices
+        // and return NULL from getTrack().
+        kMetadataOnly = 1,
+    };
+
     static sp<MediaExtractor> Create(
-            const sp<DataSource> &source, const char *mime = NULL);
+            const sp<DataSource> &source, const char *mime = NULL,
+            uint32_t flags = 0);
 
     virtual size_t countTracks() = 0;
     virtual sp<MediaSource> getTrack(size_t index) = 0;
@@ -60,6 +60,10 @@ enum {
     kKeyVorbisInfo        = 'vinf',  // raw data
     kKeyVorbisBooks       = 'vboo',  // raw data
     kKeyWantsNALFragments = 'NALf',
+
+    // PCM sample width in bits. Passed to a raw audio source's start() to
+    // ask for samples wider than 16 bits if the content has them.
+    kKeyBitsPerSample     = 'bits',  // int32_t
     kKeyIsSyncFrame       = 'sync',  // int32_t (bool)
     kKeyIsCodecConfig     = 'conf',  // int32_t (bool)
     kKeyTime              = 'time',  // int64_t (usecs)
@@ -68,6 +72,7 @@ enum {
     kKeyTargetTime        = 'tarT',  // int64_t (usecs)
     kKeyDriftTime         = 'dftT',  // int64_t (usecs)
     kKeyAnchorTime        = 'ancT',  // int64_t (usecs)
+    kKeyQueueLatency      = 'qlat',  // int64_t (usecs, queued to read)
     kKeyDuration          = 'dura',  // int64_t (usecs)
     kKeyColorFormat       = 'colf',
     kKeyPlatformPrivate   = 'priv',  // pointer
@@ -89,6 +94,11 @@ enum {
     kKeyYear              = 'year',  // cstring
     kKeyAlbumArt          = 'albA',  // compressed image data
     kKeyAlbumArtMIME      = 'alAM',  // cstring
+
+    // Where kKeyAlbumArt's data lies in the file, set instead of it by
+    // extractors that leave reading the image to whoever wants it.
+    kKeyAlbumArtOffset    = 'alAO',  // int64_t (bytes)
+    kKeyAlbumArtSize      = 'alAS',  // int32_t (bytes)
     kKeyAuthor            = 'auth',  // cstring
     kKeyCDTrackNumber     = 'cdtr',  // cstring
     kKeyDiscNumber        = 'dnum',  // cstring
@@ -106,6 +116,14 @@ enum {
     kKey64BitFileOffset   = 'fobt',  // int32_t (bool)
     kKey2ByteNalLength    = '2NAL',  // int32_t (bool)
 
+    // Set this key to author a fragmented file with track fragments
+    // of about the given duration
+    kKeyFragmentDurationUs = 'frgd',  // int64_t
+
+    // Set this key to move a movie box larger than the space reserved
+    // for it in front of the media data when authoring stops
+    kKeyRelocateMoovBox   = 'rmov',  // int32_t (bool)
+
     // Identify the file output format for authoring
     // Please see <media/mediarecorder.h> for the supported
     // file output formats.
@@ -268,13 +286,16 @@ private:
         void getData(uint32_t *type, const void **data, size_t *size) const;
         String8 asString() const;
 
+        void swap(typed_data &other);
+
     private:
         uint32_t mType;
         size_t mSize;
 
+        // Large enough for all the scalar types and Rect.
         union {
             void *ext_data;
-            float reservoir;
+            int64_t reservoir[2];
         } u;
 
         bool usesReservoir() const {
@@ -297,7 +318,26 @@ private:
         int32_t mLeft, mTop, mRight, mBottom;
     };
 
-    KeyedVector<uint32_t, typed_data> mItems;
+    struct item {
+        uint32_t mKey;
+        typed_data mData;
+    };
+
+    // The items sorted by key. The first kNumInlineItems are stored
+    // inline, and the storage is never shrunk: clearing and refilling a
+    // MetaData, like that of a recycled MediaBuffer, allocates nothing.
+    // The items past mNumItems are empty.
+    enum {
+        kNumInlineItems = 8,
+    };
+
+    item mInlineItems[kNumInlineItems];
+    item *mItems;
+    size_t mNumItems;
+    size_t mCapacity;
+
+    ssize_t indexOfKey(uint32_t key, size_t *position) const;
+    void reserve(size_t numItems);
 
     // MetaData &operator=(const MetaData &);
 };
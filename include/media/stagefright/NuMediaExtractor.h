@@ -18,9 +18,11 @@
 #define NU_MEDIA_EXTRACTOR_H_
 
 #include <media/stagefright/foundation/ABase.h>
+#include <media/stagefright/foundation/AHandlerReflector.h>
 #include <media/stagefright/MediaSource.h>
 #include <utils/Errors.h>
 #include <utils/KeyedVector.h>
+#include <utils/List.h>
 #include <utils/RefBase.h>
 #include <utils/String8.h>
 #include <utils/threads.h>
@@ -29,6 +31,7 @@
 namespace android {
 
 struct ABuffer;
+struct ALooper;
 struct AMessage;
 struct DataSource;
 struct MediaBuffer;
@@ -61,8 +64,17 @@ struct NuMediaExtractor : public RefBase {
             MediaSource::ReadOptions::SeekMode mode =
                 MediaSource::ReadOptions::SEEK_CLOSEST_SYNC);
 
+    // Reads the samples of the selected tracks on a background thread, up to
+    // windowUs ahead of the current sample of each track. 0 disables it, which
+    // is the default unless media.stagefright.extractor-prefetch-ms is set.
+    status_t setPrefetchWindow(int64_t windowUs);
+
     status_t advance();
     status_t readSampleData(const sp<ABuffer> &buffer);
+
+    // Same as above, but returns the sample's own buffer instead of copying
+    // it when it was prefetched. The buffer must not be modified.
+    status_t readSampleData(sp<ABuffer> *buffer);
     status_t getSampleTrackIndex(size_t *trackIndex);
     status_t getSampleTime(int64_t *sampleTimeUs);
     status_t getSampleMeta(sp<MetaData> *sampleMeta);
@@ -73,21 +85,44 @@ protected:
     virtual ~NuMediaExtractor();
 
 private:
+    friend struct AHandlerReflector<NuMediaExtractor>;
+
+    enum {
+        kWhatPrefetch   = 'pref',
+    };
+
     enum TrackFlags {
         kIsVorbis       = 1,
     };
 
+    // A sample is either the buffer read on the caller's thread, or a copy
+    // of it made by the prefetcher, already laid out as readSampleData()
+    // returns it: the source's single MediaBuffer cannot be held on to.
+    struct Sample {
+        MediaBuffer *mBuffer;
+        sp<ABuffer> mData;
+        sp<MetaData> mMeta;
+        int64_t mTimeUs;
+    };
+
     struct TrackInfo {
         sp<MediaSource> mSource;
         size_t mTrackIndex;
         status_t mFinalResult;
-        MediaBuffer *mSample;
-        int64_t mSampleTimeUs;
+        List<Sample> mSamples;  // the first one is the current sample
+        size_t mPrefetchedBytes;
+        bool mReading;  // the prefetcher is reading from mSource
 
         uint32_t mTrackFlags;  // bitmask of "TrackFlags"
     };
 
     mutable Mutex mLock;
+    Condition mCondition;
+
+    sp<AHandlerReflector<NuMediaExtractor> > mReflector;
+    sp<ALooper> mLooper;
+    int64_t mPrefetchWindowUs;
+    bool mPrefetchPending;
 
     sp<DataSource> mDataSource;
 
@@ -104,6 +139,13 @@ private:
                 MediaSource::ReadOptions::SEEK_CLOSEST_SYNC);
 
     void releaseTrackSamples();
+    void releaseSamples(TrackInfo *info);
+    void waitForPrefetch(ssize_t index = -1);
+
+    void schedulePrefetch();
+    ssize_t pickTrackToPrefetch();
+    void onPrefetch();
+    void onMessageReceived(const sp<AMessage> &msg);
 
     bool getTotalBitrate(int64_t *bitRate) const;
     void updateDurationAndBitrate();
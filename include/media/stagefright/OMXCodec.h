@@ -27,6 +27,7 @@ Copyright (c) 2012, Code Aurora Forum. All rights reserved.
 #include <media/IOMX.h>
 #include <media/stagefright/MediaBuffer.h>
 #include <media/stagefright/MediaSource.h>
+#include <utils/String8.h>
 #include <utils/threads.h>
 
 #include <OMX_Audio.h>
@@ -65,6 +66,10 @@ struct OMXCodec : public MediaSource,
 
         // Secure decoding mode
         kUseSecureInputBuffers = 256,
+
+        // Offline decoding: software audio decoders pack as many frames
+        // as fit into each, enlarged, output buffer instead of one.
+        kBatchAudioOutputBuffers = 1024,
 #ifdef QCOM_HARDWARE
         kEnableThumbnailMode = 512,
 
@@ -168,6 +173,11 @@ private:
         kPortIndexOutput = 1
     };
 
+    enum {
+        // output buffer size, in default sized frames, with kBatchAudioOutputBuffers
+        kNumBatchedFrames = 8
+    };
+
     enum PortStatus {
         ENABLED,
         DISABLING,
@@ -248,6 +258,32 @@ private:
     List<size_t> mFilledBuffers;
     Condition mBufferFilled;
 
+    // Systrace counters of this kind of codec, see kCodecTraceNames.
+    const char *mInputTimeTraceName;
+    const char *mOutputTimeTraceName;
+    const char *mOutputQueuedTraceName;
+
+    // How far the decoder ran ahead of the client, sampled at each read()
+    // past the first few following a start or seek. Used to size the output
+    // port of the next instance of this component at this resolution.
+    struct OutputOccupancy {
+        size_t mNumWarmupReads;
+        size_t mNumReads;
+        size_t mNumStalls;      // reads that had to wait for the decoder
+        size_t mMinQueued;      // fewest decoded buffers available at a read
+        size_t mTotalQueued;
+    };
+    OutputOccupancy mOutputOccupancy;
+
+    // Identifies the component and output resolution, empty unless the
+    // output buffers come from a native window.
+    String8 mOutputBufferCountKey;
+
+    // Video encoder input frames copied into the input buffers and those
+    // handed over by reference, such as camera metadata buffers.
+    size_t mNumInputFramesCopied;
+    size_t mNumInputFramesShared;
+
     // Used to record the decoding time for an output picture from
     // a video encoder.
     List<int64_t> mDecodingTimeList;
@@ -316,6 +352,8 @@ private:
 
     void setMinBufferSize(OMX_U32 portIndex, OMX_U32 size);
 
+    void enableBatchOutputBuffers();
+
     void setRawAudioFormat(
             OMX_U32 portIndex, int32_t sampleRate, int32_t numChannels);
 
@@ -323,6 +361,10 @@ private:
     status_t allocateBuffersOnPort(OMX_U32 portIndex);
     status_t allocateOutputBuffersFromNativeWindow();
 
+    void resetOutputOccupancy_l();
+    void recordOutputOccupancy_l(bool stalled);
+    void updateOutputBufferCountHistory_l();
+
     status_t queueBufferToNativeWindow(BufferInfo *info);
     status_t cancelBufferToNativeWindow(BufferInfo *info);
     BufferInfo* dequeueBufferFromNativeWindow();
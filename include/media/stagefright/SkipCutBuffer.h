@@ -36,6 +36,8 @@ class SkipCutBuffer: public RefBase {
     // Submit one MediaBuffer for skipping and cutting. This may consume all or
     // some of the data in the buffer, or it may add data to it.
     // After this, the caller should continue processing the buffer as usual.
+    // The buffer is trimmed in place, only the last 'cut' bytes seen so far
+    // are copied aside, and put back in front of the next buffer's data.
     void submit(MediaBuffer *buffer);
     void submit(const sp<ABuffer>& buffer);    // same as above, but with an ABuffer
     void clear();
@@ -45,6 +47,7 @@ class SkipCutBuffer: public RefBase {
     virtual ~SkipCutBuffer();
 
  private:
+    void trim(char *base, size_t *offset, size_t *length);
     void write(const char *src, size_t num);
     size_t read(char *dst, size_t num);
     int32_t mFrontPadding;
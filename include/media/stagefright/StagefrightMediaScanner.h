@@ -22,6 +22,8 @@
 
 namespace android {
 
+class MediaMetadataRetriever;
+
 struct StagefrightMediaScanner : public MediaScanner {
     StagefrightMediaScanner();
     virtual ~StagefrightMediaScanner();
@@ -30,15 +32,31 @@ struct StagefrightMediaScanner : public MediaScanner {
             const char *path, const char *mimeType,
             MediaScannerClient &client);
 
+    // Extracts the metadata of several files at once, each thread reusing
+    // one retriever for all the files it scans.
+    virtual MediaScanResult processFiles(
+            const Vector<String8> &paths, MediaScannerClient &client,
+            size_t maxThreads);
+
     virtual char *extractAlbumArt(int fd);
 
 private:
+    struct FileScan;
+    struct BatchScan;
+
     StagefrightMediaScanner(const StagefrightMediaScanner &);
     StagefrightMediaScanner &operator=(const StagefrightMediaScanner &);
 
-    MediaScanResult processFileInternal(
-            const char *path, const char *mimeType,
-            MediaScannerClient &client);
+    // Collects what processFile() reports about |path| without calling
+    // into the client, so that it can run on any thread.
+    static void extractFileScan(
+            const char *path, const sp<MediaMetadataRetriever> &retriever,
+            FileScan *scan);
+
+    MediaScanResult deliverFileScan(
+            const FileScan &scan, MediaScannerClient &client);
+
+    static void *BatchThreadWrapper(void *me);
 };
 
 }  // namespace android
@@ -83,6 +83,15 @@ public:
     status_t setFrameRate(int32_t fps) ;
     int32_t getFrameRate( ) const;
 
+    // Frames arriving faster than this are dropped before they reach the
+    // encoder. 0 (the default) passes on every frame.
+    status_t setMaxFrameRate(int32_t fps);
+
+    // In low latency mode the producer never waits for the encoder, a
+    // newly queued frame replaces one the encoder hasn't picked up yet.
+    // Must be set before the producer connects.
+    status_t setLowLatencyMode(bool enable);
+
     // The call for the StageFrightRecorder to tell us that
     // it is done using the MediaBuffer data so that its state
     // can be set to FREE for dequeuing
@@ -193,6 +202,18 @@ private:
     // encoder
     int mNumFramesEncoded;
 
+    // Frames released unencoded to honor mMaxFrameRate.
+    int32_t mMaxFrameRate;
+    int mNumFramesDropped;
+
+    // Time from queueBuffer on the producer side to the frame being read
+    // by the encoder, also attached to each buffer as kKeyQueueLatency.
+    int64_t mTotalQueueLatencyUs;
+    int64_t mMaxQueueLatencyUs;
+
+    // The meta data buffers returned by the encoder, reused by read().
+    Vector<MediaBuffer *> mFreeMetadataBuffers;
+
     // mFirstFrameTimestamp is the timestamp of the first received frame.
     // It is used to offset the output timestamps so recording starts at time 0.
     int64_t mFirstFrameTimestamp;
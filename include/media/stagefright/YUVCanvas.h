@@ -67,6 +67,12 @@ public:
             int32_t skipX, int32_t skipY,
             const YUVImage &srcImage);
 
+    // Scales all of srcImage to the size of the canvas' target image
+    // (mYUVImage), which must have the same format. Unlike downsample()
+    // this filters: exact halving averages 2x2 blocks, any other size is
+    // resampled bilinearly.
+    void resize(const YUVImage &srcImage);
+
 private:
     YUVImage& mYUVImage;
 
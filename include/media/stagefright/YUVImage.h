@@ -98,13 +98,35 @@ public:
             int32_t destStartX, int32_t destStartY,
             const YUVImage &srcImage, YUVImage &destImage);
 
+    // Copies entire rows between a planar and a semi planar image,
+    // interleaving or deinterleaving the U and V rows on the way.
+    static void fastCopyRectangleAcrossFormats(
+            const Rect& srcRect,
+            int32_t destStartX, int32_t destStartY,
+            const YUVImage &srcImage, YUVImage &destImage);
+
     // Tries to use memcopy to copy entire rows of data.
-    // Returns false if fast copy is not possible for the passed image formats.
+    // Returns false if fast copy is not possible for the passed image formats,
+    // or, across formats, for a rectangle that isn't aligned to 2x2 blocks.
     static bool fastCopyRectangle(
             const Rect& srcRect,
             int32_t destStartX, int32_t destStartY,
             const YUVImage &srcImage, YUVImage &destImage);
 
+    // Fills the rectangle a row at a time. The U/V values of every 2x2 block
+    // the rectangle touches are set, as calling setPixelValue() on each of
+    // its pixels would.
+    void fillRectangle(const Rect& rect,
+            uint8_t yValue, uint8_t uValue, uint8_t vValue);
+
+    // Downscales srcImage into destImage, which must have the same format
+    // and half its width and height, averaging every 2x2 block of samples.
+    static void downscaleBy2(const YUVImage &srcImage, YUVImage &destImage);
+
+    // Resizes srcImage to the size of destImage, which must have the same
+    // format, with bilinear interpolation of every plane.
+    static void resizeBilinear(const YUVImage &srcImage, YUVImage &destImage);
+
     // Convert the given YUV value to RGB.
     void yuv2rgb(uint8_t yValue, uint8_t uValue, uint8_t vValue,
         uint8_t *r, uint8_t *g, uint8_t *b) const;
@@ -114,6 +136,23 @@ public:
     bool writeToPPM(const char *filename) const;
 
 private:
+    // One plane of samples, in which every pixel has |mChannels|
+    // consecutive bytes, i.e. the interleaved U/V plane of semi planar
+    // images is a single plane with two channels.
+    struct Plane {
+        uint8_t *mData;
+        int32_t mWidth;
+        int32_t mHeight;
+        int32_t mStride;
+        int32_t mChannels;
+    };
+
+    // Fills |planes| with the Y plane followed by the chroma planes and
+    // returns the number of planes.
+    int32_t getPlanes(Plane *planes) const;
+
+    static void resizePlane(const Plane &src, const Plane &dest);
+
     // YUV Format of the image.
     YUVFormat mYUVFormat;
 
@@ -28,8 +28,29 @@ namespace android {
 struct ABitReader {
     ABitReader(const uint8_t *data, size_t size);
 
-    uint32_t getBits(size_t n);
-    void skipBits(size_t n);
+    // Reads of up to 32 bits that the reservoir already holds are inline;
+    // only refills, and reads past the end of the data, are checked.
+    uint32_t getBits(size_t n) {
+        if (n > 0 && n <= mNumBitsLeft && n <= 32) {
+            uint32_t result = mReservoir >> (64 - n);
+            mReservoir <<= n;
+            mNumBitsLeft -= n;
+            return result;
+        }
+        return getBitsSlow(n);
+    }
+
+    void skipBits(size_t n) {
+        if (n < mNumBitsLeft) {
+            mReservoir <<= n;
+            mNumBitsLeft -= n;
+            return;
+        }
+        skipBitsSlow(n);
+    }
+
+    // Reads an unsigned Exp-Golomb code, ue(v) in ISO/IEC 14496-10.
+    uint32_t getUE();
 
     void putBits(uint32_t x, size_t n);
 
@@ -41,10 +62,12 @@ private:
     const uint8_t *mData;
     size_t mSize;
 
-    uint32_t mReservoir;  // left-aligned bits
+    uint64_t mReservoir;  // left-aligned bits, the bits past mNumBitsLeft are 0
     size_t mNumBitsLeft;
 
     void fillReservoir();
+    uint32_t getBitsSlow(size_t n);
+    void skipBitsSlow(size_t n);
 
     DISALLOW_EVIL_CONSTRUCTORS(ABitReader);
 };
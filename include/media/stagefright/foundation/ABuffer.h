@@ -42,6 +42,12 @@ struct ABuffer : public RefBase {
 
     void setRange(size_t offset, size_t size);
 
+    // Returns a buffer referring to "size" bytes of this buffer's data,
+    // starting "offset" bytes into the current range, without copying.
+    // The slice keeps the underlying storage alive. Writes through either
+    // buffer are visible in the other.
+    sp<ABuffer> slice(size_t offset, size_t size);
+
     void setInt32Data(int32_t data) { mInt32Data = data; }
     int32_t int32Data() const { return mInt32Data; }
 
@@ -54,6 +60,9 @@ private:
     sp<AMessage> mFarewell;
     sp<AMessage> mMeta;
 
+    // For a slice, the buffer owning the storage.
+    sp<ABuffer> mBacking;
+
     void *mData;
     size_t mCapacity;
     size_t mRangeOffset;
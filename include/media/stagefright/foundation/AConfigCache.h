@@ -0,0 +1,85 @@
+/*
+ * Copyright (C) 2012 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef A_CONFIG_CACHE_H_
+
+#define A_CONFIG_CACHE_H_
+
+#include <sys/types.h>
+#include <stdint.h>
+
+#include <media/stagefright/foundation/ABase.h>
+#include <media/stagefright/foundation/AString.h>
+#include <utils/Errors.h>
+#include <utils/Vector.h>
+
+namespace android {
+
+// A binary snapshot of what was parsed out of a configuration file such as
+// /etc/media_codecs.xml. It holds 32-bit integers and strings in the order
+// they were written. A snapshot is only valid for a configuration file with
+// the same path, size and modification time as when it was written.
+
+struct AConfigCacheWriter {
+    AConfigCacheWriter(uint32_t magic);
+
+    void writeInt32(int32_t value);
+    void writeString(const char *s);
+
+    // Atomically replaces |cachePath| with the snapshot of |sourcePath|.
+    status_t commit(const char *cachePath, const char *sourcePath);
+
+private:
+    uint32_t mMagic;
+    Vector<uint32_t> mData;
+
+    DISALLOW_EVIL_CONSTRUCTORS(AConfigCacheWriter);
+};
+
+struct AConfigCacheReader {
+    AConfigCacheReader();
+    ~AConfigCacheReader();
+
+    // Maps |cachePath| and returns OK if it is a snapshot of the current
+    // |sourcePath| written with the same |magic|.
+    status_t open(const char *cachePath, const char *sourcePath, uint32_t magic);
+
+    // Once a read runs past the end of the snapshot these return 0 and an
+    // empty string, and status() is no longer OK.
+    int32_t readInt32();
+    AString readString();
+
+    // Reads a count of items that need at least |itemSize| more words each.
+    size_t readCount(size_t itemSize = 1);
+
+    status_t status() const { return mStatus; }
+
+private:
+    void *mBase;
+    size_t mSize;
+
+    const uint32_t *mData;
+    size_t mNumWords;
+    size_t mOffset;
+
+    status_t mStatus;
+
+    DISALLOW_EVIL_CONSTRUCTORS(AConfigCacheReader);
+};
+
+}  // namespace android
+
+#endif  // A_CONFIG_CACHE_H_
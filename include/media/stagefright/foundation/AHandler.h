@@ -40,6 +40,7 @@ protected:
     virtual void onMessageReceived(const sp<AMessage> &msg) = 0;
 
 private:
+    friend struct ALooper;
     friend struct ALooperRoster;
 
     ALooper::handler_id mID;
@@ -24,6 +24,7 @@
 #include <utils/KeyedVector.h>
 #include <utils/List.h>
 #include <utils/RefBase.h>
+#include <utils/Vector.h>
 #include <utils/threads.h>
 
 namespace android {
@@ -61,15 +62,27 @@ private:
 
     struct Event {
         int64_t mWhenUs;
+        uint64_t mSequence;  // keeps events due at the same time in order
         sp<AMessage> mMessage;
     };
 
+    // At most this many due events are taken off the queue per wakeup.
+    enum {
+        kMaxNumEventsPerLoop = 8,
+    };
+
     Mutex mLock;
     Condition mQueueChangedCondition;
 
     AString mName;
 
-    List<Event> mEventQueue;
+    // A binary min-heap ordered by (mWhenUs, mSequence).
+    Vector<Event> mEventQueue;
+    uint64_t mNextSequence;
+
+    // The handlers registered on this looper, so that delivering a message
+    // only takes this looper's lock rather than the roster's.
+    KeyedVector<handler_id, wp<AHandler> > mHandlers;
 
     struct LooperThread;
     sp<LooperThread> mThread;
@@ -78,6 +91,14 @@ private:
     void post(const sp<AMessage> &msg, int64_t delayUs);
     bool loop();
 
+    void addHandler(handler_id handlerID, const wp<AHandler> &handler);
+    void removeHandler(handler_id handlerID);
+    sp<AHandler> findHandler_l(handler_id handlerID);
+
+    static bool EventBefore(const Event &a, const Event &b);
+    void pushEvent_l(const Event &event);
+    void popEvent_l(Event *event);
+
     DISALLOW_EVIL_CONSTRUCTORS(ALooper);
 };
 
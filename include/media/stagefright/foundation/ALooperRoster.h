@@ -32,7 +32,6 @@ struct ALooperRoster {
     void unregisterHandler(ALooper::handler_id handlerID);
 
     status_t postMessage(const sp<AMessage> &msg, int64_t delayUs = 0);
-    void deliverMessage(const sp<AMessage> &msg);
 
     status_t postAndAwaitResponse(
             const sp<AMessage> &msg, sp<AMessage> *response);
@@ -41,12 +40,50 @@ struct ALooperRoster {
 
     sp<ALooper> findLooper(ALooper::handler_id handlerID);
 
+    // Latency statistics are only collected if the
+    // "media.stagefright.looper-stats" property was set to 1 or true when
+    // the process started.
+    bool statsEnabled() const {
+        return mStatsEnabled;
+    }
+
+    // Records how long a message waited past its due time and how long its
+    // handler took, both in microseconds.
+    void recordLatency(
+            ALooper::handler_id handlerID, uint32_t what,
+            int64_t queueDelayUs, int64_t handlerTimeUs);
+
+    void dump(int fd);
+
 private:
     struct HandlerInfo {
         wp<ALooper> mLooper;
         wp<AHandler> mHandler;
     };
 
+    // Bucket 0 counts values below 1us, bucket i > 0 those in
+    // [2^(i-1), 2^i) us and the last bucket everything above.
+    struct LatencyHistogram {
+        enum {
+            kNumBuckets = 24,
+        };
+
+        LatencyHistogram();
+
+        void add(int64_t valueUs);
+        void appendTo(AString *s, const char *label) const;
+
+        uint32_t mCount;
+        int64_t mTotalUs;
+        int64_t mMaxUs;
+        uint32_t mBuckets[kNumBuckets];
+    };
+
+    struct LatencyStats {
+        LatencyHistogram mQueueDelay;
+        LatencyHistogram mHandlerTime;
+    };
+
     Mutex mLock;
     KeyedVector<ALooper::handler_id, HandlerInfo> mHandlers;
     ALooper::handler_id mNextHandlerID;
@@ -55,6 +92,13 @@ private:
 
     KeyedVector<uint32_t, sp<AMessage> > mReplies;
 
+    bool mStatsEnabled;
+
+    // Keyed by (handler id << 32 | what), guarded by mStatsLock so that
+    // recording never contends with posting messages.
+    Mutex mStatsLock;
+    KeyedVector<uint64_t, LatencyStats> mStats;
+
     status_t postMessage_l(const sp<AMessage> &msg, int64_t delayUs);
 
     DISALLOW_EVIL_CONSTRUCTORS(ALooperRoster);
@@ -143,6 +143,7 @@ private:
     Item mItems[kMaxNumItems];
     size_t mNumItems;
 
+    size_t findItemIndex(const char *name) const;
     Item *allocateItem(const char *name);
     void freeItem(Item *item);
     const Item *findItem(const char *name, Type type) const;
@@ -111,6 +111,10 @@ public:
 
                 // Cache line boundary (32 bytes)
 
+                // client write-only, server read-only: for batched writes, the minimum number of
+                // frames available to the client before stepServer() wakes it up, 0 to always wake
+                uint32_t    wakeThreshold;
+
                 // Since the control block is always located in shared memory, this constructor
                 // is only used for placement new().  It is never used for regular new() or stack.
                             audio_track_cblk_t();
@@ -96,6 +96,7 @@ public:
         mDisplayWidth = copy.mDisplayWidth;
         mDisplayHeight = copy.mDisplayHeight;
         mSize = copy.mSize;
+        mRotationAngle = copy.mRotationAngle;
         mData = NULL;  // initialize it first
         if (mSize > 0 && copy.mData != NULL) {
             mData = new uint8_t[mSize];
@@ -36,6 +36,7 @@ LOCAL_SRC_FILES:=          \
     VideoEditorBGAudioProcessing.cpp \
     PreviewRenderer.cpp \
     I420ColorConverter.cpp \
+    FrameSlicer.cpp \
     NativeWindowRenderer.cpp
 
 LOCAL_MODULE_TAGS := optional
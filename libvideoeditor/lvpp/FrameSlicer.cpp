@@ -0,0 +1,154 @@
+/*
+ * Copyright (C) 2012 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "FrameSlicer"
+#include <utils/Log.h>
+
+#include <stdlib.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <cutils/properties.h>
+
+#include "FrameSlicer.h"
+
+namespace android {
+
+static pthread_once_t sInstanceOnce = PTHREAD_ONCE_INIT;
+static FrameSlicer* sInstance = NULL;
+
+static void createInstance() {
+    sInstance = new FrameSlicer();
+}
+
+// static
+FrameSlicer& FrameSlicer::getInstance() {
+    pthread_once(&sInstanceOnce, createInstance);
+    return *sInstance;
+}
+
+FrameSlicer::FrameSlicer()
+    : mNumWorkers(0)
+    , mGeneration(0)
+    , mNextWorker(0)
+    , mPending(0)
+    , mFunc(NULL)
+    , mCookie(NULL) {
+    char value[PROPERTY_VALUE_MAX];
+    long numSlices = sysconf(_SC_NPROCESSORS_ONLN);
+
+    if (property_get("videoeditor.preview.slices", value, NULL) > 0) {
+        numSlices = atoi(value);
+    }
+    if (numSlices < 1) {
+        numSlices = 1;
+    } else if (numSlices > kMaxSlices) {
+        numSlices = kMaxSlices;
+    }
+
+    // the thread calling run() processes one of the slices
+    for (long i = 1; i < numSlices; i++) {
+        if (!createThread(threadStart, this)) {
+            ALOGW("could not create worker thread %ld", i);
+            break;
+        }
+        mNumWorkers++;
+    }
+    ALOGV("%d worker threads", mNumWorkers);
+}
+
+void FrameSlicer::run(SliceFunc func, void* cookie, uint32_t numRows, uint32_t rowAlign) {
+    uint32_t numSlices = mNumWorkers + 1;
+    if (numSlices > numRows / kMinSliceRows) {
+        numSlices = numRows / kMinSliceRows;
+    }
+    if (numSlices <= 1 || mRunLock.tryLock() != NO_ERROR) {
+        func(cookie, 0, numRows);
+        return;
+    }
+
+    uint32_t sliceRows = (numRows / rowAlign / numSlices) * rowAlign;
+    uint32_t start = 0;
+    {
+        Mutex::Autolock autoLock(mLock);
+        for (uint32_t i = 0; i < mNumWorkers; i++) {
+            mSliceStart[i] = start;
+            mSliceRows[i] = (i < numSlices - 1) ? sliceRows : 0;
+            start += mSliceRows[i];
+        }
+        mFunc = func;
+        mCookie = cookie;
+        mPending = mNumWorkers;
+        mGeneration++;
+        mWorkCond.broadcast();
+    }
+
+    func(cookie, start, numRows - start);
+
+    {
+        Mutex::Autolock autoLock(mLock);
+        while (mPending > 0) {
+            mDoneCond.wait(mLock);
+        }
+    }
+    mRunLock.unlock();
+}
+
+// static
+int FrameSlicer::threadStart(void* self) {
+    ((FrameSlicer*)self)->workerThread();
+    return 0;
+}
+
+void FrameSlicer::workerThread() {
+    uint32_t index;
+    uint32_t generation = 0;
+
+    {
+        Mutex::Autolock autoLock(mLock);
+        index = mNextWorker++;
+    }
+
+    for (;;) {
+        SliceFunc func;
+        void* cookie;
+        uint32_t start, rows;
+        {
+            Mutex::Autolock autoLock(mLock);
+            while (mGeneration == generation) {
+                mWorkCond.wait(mLock);
+            }
+            generation = mGeneration;
+            func = mFunc;
+            cookie = mCookie;
+            start = mSliceStart[index];
+            rows = mSliceRows[index];
+        }
+
+        if (rows > 0) {
+            func(cookie, start, rows);
+        }
+
+        {
+            Mutex::Autolock autoLock(mLock);
+            if (--mPending == 0) {
+                mDoneCond.signal();
+            }
+        }
+    }
+}
+
+}  // namespace android
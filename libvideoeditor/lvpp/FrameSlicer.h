@@ -0,0 +1,80 @@
+/*
+ * Copyright (C) 2012 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FRAME_SLICER_H_
+#define FRAME_SLICER_H_
+
+#include <stdint.h>
+#include <utils/threads.h>
+
+// The FrameSlicer runs a function over horizontal bands of a frame at the
+// same time, on a small pool of worker threads shared by the process. The
+// calling thread processes the last band itself and returns once all the
+// bands are done.
+//
+// The number of bands is the number of online CPUs (at most kMaxSlices),
+// and can be overridden with the videoeditor.preview.slices property,
+// 1 disabling the worker threads. A call made while another one is running
+// (from another preview, or from a slice function) processes the whole
+// frame on the calling thread.
+
+namespace android {
+
+class FrameSlicer {
+public:
+    // Processes rows [firstRow, firstRow + numRows) of the frame.
+    typedef void (*SliceFunc)(void* cookie, uint32_t firstRow, uint32_t numRows);
+
+    static FrameSlicer& getInstance();
+
+    // Splits numRows in bands of a multiple of rowAlign rows, and calls
+    // func for each of them. Bands smaller than kMinSliceRows are merged.
+    void run(SliceFunc func, void* cookie, uint32_t numRows, uint32_t rowAlign);
+
+private:
+    enum {
+        kMaxSlices = 4,
+        kMinSliceRows = 32,
+    };
+
+    FrameSlicer();
+
+    static int threadStart(void* self);
+    void workerThread();
+
+    Mutex mRunLock;  // held by the caller of run() for the whole call
+
+    Mutex mLock;
+    Condition mWorkCond;
+    Condition mDoneCond;
+    uint32_t mNumWorkers;
+    uint32_t mGeneration;  // bumped for each job given to the workers
+    uint32_t mNextWorker;  // index handed to the next worker thread to start
+    uint32_t mPending;     // workers still running the current job
+
+    // the current job, worker i processes mSliceRows[i] rows from mSliceStart[i]
+    SliceFunc mFunc;
+    void* mCookie;
+    uint32_t mSliceStart[kMaxSlices];
+    uint32_t mSliceRows[kMaxSlices];
+
+    FrameSlicer(const FrameSlicer&);
+    FrameSlicer& operator=(const FrameSlicer&);
+};
+
+}  // namespace android
+
+#endif  // FRAME_SLICER_H_
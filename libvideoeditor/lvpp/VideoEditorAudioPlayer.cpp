@@ -598,7 +598,6 @@ size_t VideoEditorAudioPlayer::fillBuffer(void *data, size_t size) {
 
     M4OSA_ERR err = M4NO_ERROR;
     M4AM_Buffer16 bgFrame = {NULL, 0};
-    M4AM_Buffer16 mixFrame = {NULL, 0};
     M4AM_Buffer16 ptFrame = {NULL, 0};
     int64_t currentSteamTS = 0;
     int64_t startTimeForBT = 0;
@@ -686,10 +685,6 @@ size_t VideoEditorAudioPlayer::fillBuffer(void *data, size_t size) {
                                                        (M4OSA_Char*)"bgFrame");
                         bgFrame.m_bufferSize = len;
 
-                        mixFrame.m_dataAddress = (M4OSA_UInt16*)M4OSA_32bitAlignedMalloc(len, 1,
-                                                    (M4OSA_Char*)"mixFrame");
-                        mixFrame.m_bufferSize = len;
-
                         ALOGV("mix with bgm with size %lld", mBGAudioPCMFileLength);
 
                         CHECK(mInputBuffer->meta_data()->findInt64(kKeyTime,
@@ -758,13 +753,10 @@ size_t VideoEditorAudioPlayer::fillBuffer(void *data, size_t size) {
                                     ptFrame.m_dataAddress = (M4OSA_UInt16*)ptr;
                                     ptFrame.m_bufferSize = len;
 
-                                    // Call to mix and duck
+                                    // Call to mix and duck, overwriting
+                                    // the decoded buffer
                                     mAudioProcess->mixAndDuck(
-                                         &ptFrame, &bgFrame, &mixFrame);
-
-                                        // Overwrite the decoded buffer
-                                    memcpy((void *)ptr,
-                                         (void *)mixFrame.m_dataAddress, len);
+                                         &ptFrame, &bgFrame, &ptFrame);
                                 }
                             }
                         } else if (mAudioMixSettings->bLoop){
@@ -782,9 +774,6 @@ size_t VideoEditorAudioPlayer::fillBuffer(void *data, size_t size) {
                         if (bgFrame.m_dataAddress) {
                             free(bgFrame.m_dataAddress);
                         }
-                        if (mixFrame.m_dataAddress) {
-                            free(mixFrame.m_dataAddress);
-                        }
                     } else {
                         // No mixing;
                         // take care of volume level of primary track
@@ -19,6 +19,10 @@
 #include <utils/Log.h>
 #include "VideoEditorBGAudioProcessing.h"
 
+#ifdef __ARM_NEON__
+#include <arm_neon.h>
+#endif
+
 namespace android {
 
 VideoEditorBGAudioProcessing::VideoEditorBGAudioProcessing() {
@@ -45,6 +49,42 @@ VideoEditorBGAudioProcessing::VideoEditorBGAudioProcessing() {
     mBTChannelCount = 1;
 }
 
+// Every scaled sample is truncated to 16 bits before the next step, and the
+// halves of both tracks are summed before being brought back to the original
+// amplitude, so the NEON path gives exactly the same output as the C loop.
+static inline M4OSA_Int16 scaleSample(M4OSA_Int16 sample, M4OSA_Float factor) {
+    return (M4OSA_Int16)(M4OSA_Int32)(sample * factor);
+}
+
+static inline M4OSA_Int16 mixSamples(M4OSA_Int16 bt, M4OSA_Int16 pt) {
+    // bring the mix back to the original amplitude level, clipping
+    // negative values one above the full scale as the mix always did
+    M4OSA_Int32 mix = (bt / 2 + pt / 2) * 2;
+    if (mix < -32766) {
+        return -32766;
+    } else if (mix > 32767) {
+        return 32767;
+    }
+    return (M4OSA_Int16)mix;
+}
+
+#ifdef __ARM_NEON__
+static inline int16x8_t scaleSamples(int16x8_t samples, float32x4_t factor) {
+    int32x4_t lo = vcvtq_s32_f32(vmulq_f32(
+            vcvtq_f32_s32(vmovl_s16(vget_low_s16(samples))), factor));
+    int32x4_t hi = vcvtq_s32_f32(vmulq_f32(
+            vcvtq_f32_s32(vmovl_s16(vget_high_s16(samples))), factor));
+    return vcombine_s16(vmovn_s32(lo), vmovn_s32(hi));
+}
+
+// x / 2 rounded toward zero like the C division
+static inline int16x8_t halveSamples(int16x8_t samples) {
+    int16x8_t sign = vreinterpretq_s16_u16(
+            vshrq_n_u16(vreinterpretq_u16_s16(samples), 15));
+    return vshrq_n_s16(vaddq_s16(samples, sign), 1);
+}
+#endif
+
 M4OSA_Int32 VideoEditorBGAudioProcessing::mixAndDuck(
         void *primaryTrackBuffer,
         void *backgroundTrackBuffer,
@@ -59,37 +99,41 @@ M4OSA_Int32 VideoEditorBGAudioProcessing::mixAndDuck(
     M4AM_Buffer16* pMixedOutBuffer  = (M4AM_Buffer16*)outBuffer;
 
     // Output size if same as PT size
-    pMixedOutBuffer->m_bufferSize = pPrimaryTrack->m_bufferSize;
+    const M4OSA_UInt32 ptSize = pPrimaryTrack->m_bufferSize;
+    pMixedOutBuffer->m_bufferSize = ptSize;
 
-    // Before mixing, we need to have only PT as out buffer
-    memcpy((void *)pMixedOutBuffer->m_dataAddress,
-        (void *)pPrimaryTrack->m_dataAddress, pMixedOutBuffer->m_bufferSize);
-
-    // Initialize ducking variables
-    // Initially contains the input primary track
-    M4OSA_Int16 *pPTMdata2 = (M4OSA_Int16*)pMixedOutBuffer->m_dataAddress;
+    // The out buffer may be the primary track itself: every sample is only
+    // read before its mix is written, and the ducking analysis comes first.
+    const M4OSA_Int16 *pPTMdata = (const M4OSA_Int16*)pPrimaryTrack->m_dataAddress;
 
     // Contains BG track processed data(like channel conversion etc..
-    M4OSA_Int16 *pBTMdata1 = (M4OSA_Int16*) pBackgroundTrack->m_dataAddress;
+    const M4OSA_Int16 *pBTMdata = (const M4OSA_Int16*)pBackgroundTrack->m_dataAddress;
+    M4OSA_Int16 *pOutMdata = (M4OSA_Int16*)pMixedOutBuffer->m_dataAddress;
 
     // Since we need to give sample count and not buffer size
-    M4OSA_UInt32 uiPCMsize = pMixedOutBuffer->m_bufferSize / 2 ;
+    const size_t n = ptSize / sizeof(M4OSA_Int16);
 
     if ((mDucking_enable) && (mPTVolLevel != 0.0)) {
-        M4OSA_Int32 peakDbValue = 0;
-        M4OSA_Int32 previousDbValue = 0;
-        M4OSA_Int16 *pPCM16Sample = (M4OSA_Int16*)pPrimaryTrack->m_dataAddress;
-        const size_t n = pPrimaryTrack->m_bufferSize / sizeof(M4OSA_Int16);
-
-        for (size_t loopIndex = 0; loopIndex < n; ++loopIndex) {
-            if (pPCM16Sample[loopIndex] >= 0) {
-                peakDbValue = previousDbValue > pPCM16Sample[loopIndex] ?
-                        previousDbValue : pPCM16Sample[loopIndex];
-                previousDbValue = peakDbValue;
-            } else {
-                peakDbValue = previousDbValue > -pPCM16Sample[loopIndex] ?
-                        previousDbValue: -pPCM16Sample[loopIndex];
-                previousDbValue = peakDbValue;
+        M4OSA_UInt32 peakDbValue = 0;
+        size_t loopIndex = 0;
+
+#ifdef __ARM_NEON__
+        uint16x8_t peak = vdupq_n_u16(0);
+        for (; loopIndex + 8 <= n; loopIndex += 8) {
+            // |-32768| doesn't fit in a signed lane, but does as unsigned
+            peak = vmaxq_u16(peak, vreinterpretq_u16_s16(
+                    vabsq_s16(vld1q_s16(pPTMdata + loopIndex))));
+        }
+        uint16x4_t peak4 = vmax_u16(vget_low_u16(peak), vget_high_u16(peak));
+        peak4 = vpmax_u16(peak4, peak4);
+        peak4 = vpmax_u16(peak4, peak4);
+        peakDbValue = vget_lane_u16(peak4, 0);
+#endif
+        for (; loopIndex < n; ++loopIndex) {
+            M4OSA_Int32 sample = pPTMdata[loopIndex];
+            M4OSA_UInt32 magnitude = sample >= 0 ? sample : -sample;
+            if (magnitude > peakDbValue) {
+                peakDbValue = magnitude;
             }
         }
 
@@ -137,55 +181,36 @@ M4OSA_Int32 VideoEditorBGAudioProcessing::mixAndDuck(
         }
     } // end if - mDucking_enable
 
-
     // Mixing logic
     ALOGV("Out of Ducking analysis uiPCMsize %d %f %f",
             mDoDucking, mDuckingFactor, mBTVolLevel);
-    while (uiPCMsize-- > 0) {
-
-        // Set vol factor for BT and PT
-        *pBTMdata1 = (M4OSA_Int16)(*pBTMdata1*mBTVolLevel);
-        *pPTMdata2 = (M4OSA_Int16)(*pPTMdata2*mPTVolLevel);
-
-        // Mix the two samples
-        if (mDoDucking) {
-
-            // Duck the BG track to ducking factor value before mixing
-            *pBTMdata1 = (M4OSA_Int16)((*pBTMdata1)*(mDuckingFactor));
-
-            // mix as normal case
-            *pBTMdata1 = (M4OSA_Int16)(*pBTMdata1 /2 + *pPTMdata2 /2);
-        } else {
-
-            *pBTMdata1 = (M4OSA_Int16)((*pBTMdata1)*(mDuckingFactor));
-            *pBTMdata1 = (M4OSA_Int16)(*pBTMdata1 /2 + *pPTMdata2 /2);
-        }
-
-        M4OSA_Int32 temp;
-        if (*pBTMdata1 < 0) {
-            temp = -(*pBTMdata1) * 2; // bring to original Amplitude level
-
-            if (temp > 32767) {
-                *pBTMdata1 = -32766; // less then max allowed value
-            } else {
-                *pBTMdata1 = (M4OSA_Int16)(-temp);
-            }
-        } else {
-            temp = (*pBTMdata1) * 2; // bring to original Amplitude level
-            if ( temp > 32768) {
-                *pBTMdata1 = 32767; // less than max allowed value
-            } else {
-                *pBTMdata1 = (M4OSA_Int16)temp;
-            }
-        }
 
-        pBTMdata1++;
-        pPTMdata2++;
+    // The BG track is ducked by mDuckingFactor, which is back to 1.0
+    // whenever ducking is off or fully faded in.
+    const M4OSA_Float btVolLevel = mBTVolLevel;
+    const M4OSA_Float ptVolLevel = mPTVolLevel;
+    const M4OSA_Float duckingFactor = mDuckingFactor;
+    size_t i = 0;
+
+#ifdef __ARM_NEON__
+    const float32x4_t btVol = vdupq_n_f32(btVolLevel);
+    const float32x4_t ptVol = vdupq_n_f32(ptVolLevel);
+    const float32x4_t duck = vdupq_n_f32(duckingFactor);
+    const int16x8_t minMix = vdupq_n_s16(-32766);
+    for (; i + 8 <= n; i += 8) {
+        int16x8_t bt = scaleSamples(vld1q_s16(pBTMdata + i), btVol);
+        int16x8_t pt = scaleSamples(vld1q_s16(pPTMdata + i), ptVol);
+        bt = scaleSamples(bt, duck);
+        int16x8_t mix = vaddq_s16(halveSamples(bt), halveSamples(pt));
+        vst1q_s16(pOutMdata + i, vmaxq_s16(vqaddq_s16(mix, mix), minMix));
+    }
+#endif
+    for (; i < n; ++i) {
+        M4OSA_Int16 bt = scaleSample(pBTMdata[i], btVolLevel);
+        M4OSA_Int16 pt = scaleSample(pPTMdata[i], ptVolLevel);
+        bt = scaleSample(bt, duckingFactor);
+        pOutMdata[i] = mixSamples(bt, pt);
     }
-
-    memcpy((void *)pMixedOutBuffer->m_dataAddress,
-        (void *)pBackgroundTrack->m_dataAddress,
-        pBackgroundTrack->m_bufferSize);
 
     ALOGV("mixAndDuck: X");
     return M4NO_ERROR;
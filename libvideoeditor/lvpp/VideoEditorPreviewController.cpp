@@ -62,6 +62,7 @@ VideoEditorPreviewController::VideoEditorPreviewController()
     ALOGV("VideoEditorPreviewController");
     mRenderingMode = M4xVSS_kBlackBorders;
     mIsFiftiesEffectStarted = false;
+    resetPostProcessStats(&mPostProcessStats);
 
     for (int i = 0; i < kTotalNumPlayerInstances; ++i) {
         mVePlayer[i] = NULL;
@@ -600,6 +601,8 @@ M4OSA_ERR VideoEditorPreviewController::startPreview(
         }
     }
 
+    resetPostProcessStats(&mPostProcessStats);
+
     // Open the thread semaphore
     M4OSA_semaphoreOpen(&mSemThreadWait, 1);
 
@@ -664,6 +667,7 @@ M4OSA_UInt32 VideoEditorPreviewController::stopPreview() {
 
         mThreadContext = NULL;
     }
+    logPostProcessStats(&mPostProcessStats);
 
     // Close the semaphore first
     {
@@ -1428,6 +1432,7 @@ M4OSA_ERR VideoEditorPreviewController::applyVideoEffect(
     //postProcessParams.renderer = mTarget;
     postProcessParams.overlayFrameRGBBuffer = NULL;
     postProcessParams.overlayFrameYUVBuffer = NULL;
+    postProcessParams.stats = &mPostProcessStats;
 
     mTarget->getBufferYV12(&(postProcessParams.pOutBuffer), &(postProcessParams.outBufferStride));
 
@@ -120,6 +120,8 @@ private:
     bool bStopThreadInProgress;
     M4OSA_Context mSemThreadWait;
     bool mIsFiftiesEffectStarted;
+    // time spent applying each effect, logged when the preview stops
+    vePostProcessStats mPostProcessStats;
 
     sp<VideoEditorPlayer::VeAudioOutput> mVEAudioSink;
     VideoEditorAudioPlayer *mVEAudioPlayer;
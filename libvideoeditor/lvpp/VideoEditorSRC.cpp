@@ -29,8 +29,10 @@
 
 namespace android {
 
-VideoEditorSRC::VideoEditorSRC(const sp<MediaSource> &source) {
-    ALOGV("VideoEditorSRC %p(%p)", this, source.get());
+VideoEditorSRC::VideoEditorSRC(const sp<MediaSource> &source,
+        size_t outputFrameCount) {
+    ALOGV("VideoEditorSRC %p(%p) %d frames", this, source.get(), outputFrameCount);
+    CHECK(outputFrameCount > 0);
     static const int32_t kDefaultSamplingFreqencyHz = kFreq32000Hz;
     mSource = source;
     mResampler = NULL;
@@ -41,6 +43,8 @@ VideoEditorSRC::VideoEditorSRC(const sp<MediaSource> &source) {
     mInitialTimeStampUs = -1;
     mAccuOutBufferSize  = 0;
     mSeekTimeUs = -1;
+    mOutputFrameCount = outputFrameCount;
+    mTmpBuffer = NULL;
     mBuffer = NULL;
     mLeftover = 0;
     mFormatChanged = false;
@@ -63,6 +67,8 @@ VideoEditorSRC::VideoEditorSRC(const sp<MediaSource> &source) {
 VideoEditorSRC::~VideoEditorSRC() {
     ALOGV("~VideoEditorSRC %p(%p)", this, mSource.get());
     stop();
+    free(mTmpBuffer);
+    mTmpBuffer = NULL;
 }
 
 status_t VideoEditorSRC::start(MetaData *params) {
@@ -128,18 +134,21 @@ status_t VideoEditorSRC::read(
             mSeekMode = mode;
         }
 
-        // We ask for 1024 frames in output
-        // resampler output is always 2 channels and 32 bits
-        const size_t kOutputFrameCount = 1024;
-        const size_t kBytes = kOutputFrameCount * 2 * sizeof(int32_t);
-        int32_t *pTmpBuffer = (int32_t *)calloc(1, kBytes);
-        if (!pTmpBuffer) {
-            ALOGE("calloc failed to allocate memory: %d bytes", kBytes);
-            return NO_MEMORY;
+        // resampler output is always 2 channels and 32 bits. The buffer
+        // isn't freed by stop(), which may be called below.
+        const size_t kBytes = mOutputFrameCount * 2 * sizeof(int32_t);
+        if (mTmpBuffer == NULL) {
+            mTmpBuffer = (int32_t *)malloc(kBytes);
+            if (!mTmpBuffer) {
+                ALOGE("malloc failed to allocate memory: %d bytes", kBytes);
+                return NO_MEMORY;
+            }
         }
+        // the resampler accumulates into its output
+        memset(mTmpBuffer, 0, kBytes);
 
         // Resample to target quality
-        mResampler->resample(pTmpBuffer, kOutputFrameCount, this);
+        mResampler->resample(mTmpBuffer, mOutputFrameCount, this);
 
         if (mStopPending) {
             stop();
@@ -150,19 +159,17 @@ status_t VideoEditorSRC::read(
         if (mFormatChanged) {
             mFormatChanged = false;
             checkAndSetResampler();
-            free(pTmpBuffer);
             return read(buffer_out, NULL);
         }
 
         // Create a new MediaBuffer
-        int32_t outBufferSize = kOutputFrameCount * 2 * sizeof(int16_t);
+        int32_t outBufferSize = mOutputFrameCount * 2 * sizeof(int16_t);
         MediaBuffer* outBuffer = new MediaBuffer(outBufferSize);
 
         // Convert back to 2 channels and 16 bits
         ditherAndClamp(
                 (int32_t *)((uint8_t*)outBuffer->data() + outBuffer->range_offset()),
-                pTmpBuffer, kOutputFrameCount);
-        free(pTmpBuffer);
+                mTmpBuffer, mOutputFrameCount);
 
         // Compute and set the new timestamp
         sp<MetaData> to = outBuffer->meta_data();
@@ -200,92 +207,98 @@ status_t VideoEditorSRC::read(
 
 status_t VideoEditorSRC::getNextBuffer(AudioBufferProvider::Buffer *pBuffer, int64_t pts) {
     ALOGV("getNextBuffer %d, chan = %d", pBuffer->frameCount, mChannelCnt);
-    uint32_t done = 0;
-    uint32_t want = pBuffer->frameCount * mChannelCnt * 2;
-    pBuffer->raw = malloc(want);
-
-    while (mStarted && want > 0) {
-        // If we don't have any data left, read a new buffer.
-        if (!mBuffer) {
-            // if we seek, reset the initial time stamp and accumulated time
-            ReadOptions options;
-            if (mSeekTimeUs >= 0) {
-                ALOGV("%p cacheMore_l Seek requested = %lld", this, mSeekTimeUs);
-                ReadOptions::SeekMode mode = mSeekMode;
-                options.setSeekTo(mSeekTimeUs, mode);
-                mSeekTimeUs = -1;
-                mInitialTimeStampUs = -1;
-                mAccuOutBufferSize = 0;
-            }
-
-            status_t err = mSource->read(&mBuffer, &options);
-
-            if (err != OK) {
-                free(pBuffer->raw);
-                pBuffer->raw = NULL;
-                pBuffer->frameCount = 0;
-            }
+    const int32_t frameSize = mChannelCnt * sizeof(int16_t);
+
+    // If we don't have any data left, read a new buffer.
+    while (mStarted && !mBuffer) {
+        // if we seek, reset the initial time stamp and accumulated time
+        ReadOptions options;
+        if (mSeekTimeUs >= 0) {
+            ALOGV("%p cacheMore_l Seek requested = %lld", this, mSeekTimeUs);
+            ReadOptions::SeekMode mode = mSeekMode;
+            options.setSeekTo(mSeekTimeUs, mode);
+            mSeekTimeUs = -1;
+            mInitialTimeStampUs = -1;
+            mAccuOutBufferSize = 0;
+        }
 
-            if (err == INFO_FORMAT_CHANGED) {
-                ALOGV("getNextBuffer: source read returned INFO_FORMAT_CHANGED");
-                // At this point we cannot switch to a new AudioResampler because
-                // we are in a callback called by the AudioResampler itself. So
-                // just remember the fact that the format has changed, and let
-                // read() handles this.
-                mFormatChanged = true;
-                return err;
-            }
+        status_t err = mSource->read(&mBuffer, &options);
 
-            // EOS or some other error
-            if (err != OK) {
-                ALOGV("EOS or some err: %d", err);
-                // We cannot call stop() here because stop() will release the
-                // AudioResampler, and we are in a callback of the AudioResampler.
-                // So just remember the fact and let read() call stop().
-                mStopPending = true;
-                return err;
-            }
+        if (err != OK) {
+            pBuffer->raw = NULL;
+            pBuffer->frameCount = 0;
+        }
 
-            CHECK(mBuffer);
-            mLeftover = mBuffer->range_length();
-            if (mInitialTimeStampUs == -1) {
-                int64_t curTS;
-                sp<MetaData> from = mBuffer->meta_data();
-                from->findInt64(kKeyTime, &curTS);
-                ALOGV("setting mInitialTimeStampUs to %lld", mInitialTimeStampUs);
-                mInitialTimeStampUs = curTS;
-            }
+        if (err == INFO_FORMAT_CHANGED) {
+            ALOGV("getNextBuffer: source read returned INFO_FORMAT_CHANGED");
+            // At this point we cannot switch to a new AudioResampler because
+            // we are in a callback called by the AudioResampler itself. So
+            // just remember the fact that the format has changed, and let
+            // read() handles this.
+            mFormatChanged = true;
+            return err;
         }
 
-        // Now copy data to the destination
-        uint32_t todo = mLeftover;
-        if (todo > want) {
-            todo = want;
+        // EOS or some other error
+        if (err != OK) {
+            ALOGV("EOS or some err: %d", err);
+            // We cannot call stop() here because stop() will release the
+            // AudioResampler, and we are in a callback of the AudioResampler.
+            // So just remember the fact and let read() call stop().
+            mStopPending = true;
+            return err;
         }
 
-        uint8_t* end = (uint8_t*)mBuffer->data() + mBuffer->range_offset()
-                + mBuffer->range_length();
-        memcpy((uint8_t*)pBuffer->raw + done, end - mLeftover, todo);
-        done += todo;
-        want -= todo;
-        mLeftover -= todo;
+        CHECK(mBuffer);
+        mLeftover = mBuffer->range_length();
+        if (mInitialTimeStampUs == -1) {
+            int64_t curTS;
+            sp<MetaData> from = mBuffer->meta_data();
+            from->findInt64(kKeyTime, &curTS);
+            ALOGV("setting mInitialTimeStampUs to %lld", mInitialTimeStampUs);
+            mInitialTimeStampUs = curTS;
+        }
 
-        // Release MediaBuffer as soon as possible.
-        if (mLeftover == 0) {
+        if (mLeftover < frameSize) {
             mBuffer->release();
             mBuffer = NULL;
         }
     }
 
-    pBuffer->frameCount = done / (mChannelCnt * 2);
+    if (!mBuffer) {
+        pBuffer->raw = NULL;
+        pBuffer->frameCount = 0;
+        return ERROR_END_OF_STREAM;
+    }
+
+    // Let the resampler read the decoded data in place rather than from a
+    // copy, mBuffer is kept until all of it was consumed.
+    size_t frames = mLeftover / frameSize;
+    if (frames > pBuffer->frameCount) {
+        frames = pBuffer->frameCount;
+    }
+    uint8_t* end = (uint8_t*)mBuffer->data() + mBuffer->range_offset()
+            + mBuffer->range_length();
+    pBuffer->raw = end - mLeftover;
+    pBuffer->frameCount = frames;
     ALOGV("getNextBuffer done %d", pBuffer->frameCount);
     return OK;
 }
 
 
 void VideoEditorSRC::releaseBuffer(AudioBufferProvider::Buffer *pBuffer) {
-    ALOGV("releaseBuffer: %p", pBuffers);
-    free(pBuffer->raw);
+    ALOGV("releaseBuffer: %p", pBuffer);
+    const int32_t frameSize = mChannelCnt * sizeof(int16_t);
+    if (mBuffer != NULL && pBuffer->raw != NULL) {
+        mLeftover -= pBuffer->frameCount * frameSize;
+
+        // Release MediaBuffer as soon as possible.
+        if (mLeftover < frameSize) {
+            mBuffer->release();
+            mBuffer = NULL;
+            mLeftover = 0;
+        }
+    }
     pBuffer->raw = NULL;
     pBuffer->frameCount = 0;
 }
@@ -322,7 +335,7 @@ void VideoEditorSRC::checkAndSetResampler() {
                         16 /* bit depth */,
                         mChannelCnt,
                         mOutputSampleRate,
-                        AudioResampler::DEFAULT);
+                        AudioResampler::HIGH_POLYPHASE_QUALITY);
         CHECK(mResampler);
         mResampler->setSampleRate(mSampleRate);
         mResampler->setVolume(kUnityGain, kUnityGain);
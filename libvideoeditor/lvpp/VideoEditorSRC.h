@@ -27,7 +27,10 @@ struct MediaBuffer;
 class VideoEditorSRC : public MediaSource , public AudioBufferProvider {
 
 public:
-    VideoEditorSRC(const sp<MediaSource> &source);
+    // outputFrameCount is the number of frames of each resampled buffer
+    // read() returns
+    VideoEditorSRC(const sp<MediaSource> &source,
+            size_t outputFrameCount = kDefaultOutputFrameCount);
 
     virtual status_t start (MetaData *params = NULL);
     virtual status_t stop();
@@ -51,6 +54,10 @@ public:
         kFreq48000Hz = 48000,
     };
 
+    enum {
+        kDefaultOutputFrameCount = 1024,
+    };
+
 protected :
     virtual ~VideoEditorSRC();
 
@@ -63,6 +70,13 @@ private:
     bool mStarted;
     sp<MetaData> mOutputFormat;
 
+    // Output of the resampler, always 2 channels and 32 bits, kept from
+    // one read() to the next
+    size_t mOutputFrameCount;
+    int32_t *mTmpBuffer;
+
+    // getNextBuffer() hands out the data of mBuffer in place, mLeftover
+    // bytes of it are still to be consumed by the resampler
     MediaBuffer* mBuffer;
     int32_t mLeftover;
     bool mFormatChanged;
@@ -16,9 +16,11 @@
 
 #include "VideoEditorTools.h"
 #include "PreviewRenderer.h"
+#include "FrameSlicer.h"
 /*+ Handle the image files here */
 #include <utils/Log.h>
 /*- Handle the image files here */
+#include <utils/Timers.h>
 
 const M4VIFI_UInt8   M4VIFI_ClipTable[1256]
 = {
@@ -857,11 +859,8 @@ unsigned char M4VFL_modifyLumaWithScale(M4ViComImagePlane *plane_in,
         /* copy chroma */
         for (j = u_height; j != 0; j--)
         {
-            for (i = u_width; i != 0; i--)
-            {
-                memcpy((void *)p_cdest_line, (void *)p_csrc_line, u_width);
-                memcpy((void *)p_cdest, (void *)p_csrc, u_width);
-            }
+            memcpy((void *)p_cdest_line, (void *)p_csrc_line, u_width);
+            memcpy((void *)p_cdest, (void *)p_csrc, u_width);
             p_cdest_line += u_stride_out;
             p_cdest += u_stride_out;
             p_csrc_line += u_stride;
@@ -1438,12 +1437,17 @@ M4VIFI_UInt8 M4VIFI_YUV420toYUV420(void *user_data, M4VIFI_ImagePlane PlaneIn[3]
  * @return  M4VIFI_ILLEGAL_FRAME_WIDTH:  Error in width
  ***********************************************************************************************
 */
-M4VIFI_UInt8    M4VIFI_ResizeBilinearYUV420toYUV420(void *pUserData,
-                                                                M4VIFI_ImagePlane *pPlaneIn,
-                                                                M4VIFI_ImagePlane *pPlaneOut)
+/*
+ Resizes rows [u32_first_row, u32_first_row + u32_num_rows) of one plane of
+ M4VIFI_ResizeBilinearYUV420toYUV420. The accumulators are advanced to the
+ first row, so that the rows come out the same as when done in one pass.
+*/
+static void resizeBilinearPlaneRows(M4VIFI_ImagePlane *pPlaneIn,
+                                    M4VIFI_ImagePlane *pPlaneOut,
+                                    M4VIFI_UInt32 u32_first_row,
+                                    M4VIFI_UInt32 u32_num_rows)
 {
     M4VIFI_UInt8    *pu8_data_in, *pu8_data_out, *pu8dum;
-    M4VIFI_UInt32   u32_plane;
     M4VIFI_UInt32   u32_width_in, u32_width_out, u32_height_in, u32_height_out;
     M4VIFI_UInt32   u32_stride_in, u32_stride_out;
     M4VIFI_UInt32   u32_x_inc, u32_y_inc;
@@ -1451,215 +1455,262 @@ M4VIFI_UInt8    M4VIFI_ResizeBilinearYUV420toYUV420(void *pUserData,
     M4VIFI_UInt32   u32_width, u32_height;
     M4VIFI_UInt32   u32_y_frac;
     M4VIFI_UInt32   u32_x_frac;
-    M4VIFI_UInt32   u32_temp_value;
+    M4VIFI_UInt32   u32_temp_value = 0;
     M4VIFI_UInt8    *pu8_src_top;
     M4VIFI_UInt8    *pu8_src_bottom;
+    uint64_t        u64_y_accum_first;
 
     M4VIFI_UInt8    u8Wflag = 0;
     M4VIFI_UInt8    u8Hflag = 0;
     M4VIFI_UInt32   loop = 0;
 
+    /* Set the working pointers at the beginning of the input/output data field */
+    pu8_data_in     = pPlaneIn->pac_data + pPlaneIn->u_topleft;
+    pu8_data_out    = pPlaneOut->pac_data + pPlaneOut->u_topleft;
+
+    /* Get the memory jump corresponding to a row jump */
+    u32_stride_in   = pPlaneIn->u_stride;
+    u32_stride_out  = pPlaneOut->u_stride;
+
+    /* Set the bounds of the active image */
+    u32_width_in    = pPlaneIn->u_width;
+    u32_height_in   = pPlaneIn->u_height;
+
+    u32_width_out   = pPlaneOut->u_width;
+    u32_height_out  = pPlaneOut->u_height;
 
     /*
-     If input width is equal to output width and input height equal to
-     output height then M4VIFI_YUV420toYUV420 is called.
+    For the case , width_out = width_in , set the flag to avoid
+    accessing one column beyond the input width.In this case the last
+    column is replicated for processing
     */
-    if ((pPlaneIn[0].u_height == pPlaneOut[0].u_height) &&
-              (pPlaneIn[0].u_width == pPlaneOut[0].u_width))
-    {
-        return M4VIFI_YUV420toYUV420(pUserData, pPlaneIn, pPlaneOut);
+    if (u32_width_out == u32_width_in) {
+        u32_width_out = u32_width_out-1;
+        u8Wflag = 1;
     }
 
-    /* Check for the YUV width and height are even */
-    if ((IS_EVEN(pPlaneIn[0].u_height) == FALSE)    ||
-        (IS_EVEN(pPlaneOut[0].u_height) == FALSE))
+    /* Compute horizontal ratio between src and destination width.*/
+    if (u32_width_out >= u32_width_in)
     {
-        return M4VIFI_ILLEGAL_FRAME_HEIGHT;
+        u32_x_inc   = ((u32_width_in-1) * MAX_SHORT) / (u32_width_out-1);
+    }
+    else
+    {
+        u32_x_inc   = (u32_width_in * MAX_SHORT) / (u32_width_out);
     }
 
-    if ((IS_EVEN(pPlaneIn[0].u_width) == FALSE) ||
-        (IS_EVEN(pPlaneOut[0].u_width) == FALSE))
+    /*
+    For the case , height_out = height_in , set the flag to avoid
+    accessing one row beyond the input height.In this case the last
+    row is replicated for processing
+    */
+    if (u32_height_out == u32_height_in) {
+        u32_height_out = u32_height_out-1;
+        u8Hflag = 1;
+    }
+
+    /* Compute vertical ratio between src and destination height.*/
+    if (u32_height_out >= u32_height_in)
     {
-        return M4VIFI_ILLEGAL_FRAME_WIDTH;
+        u32_y_inc   = ((u32_height_in - 1) * MAX_SHORT) / (u32_height_out-1);
+    }
+    else
+    {
+        u32_y_inc = (u32_height_in * MAX_SHORT) / (u32_height_out);
     }
 
-    /* Loop on planes */
-    for(u32_plane = 0;u32_plane < PLANES;u32_plane++)
+    /*
+    Calculate initial accumulator value : u32_y_accum_start.
+    u32_y_accum_start is coded on 15 bits, and represents a value
+    between 0 and 0.5
+    */
+    if (u32_y_inc >= MAX_SHORT)
     {
-        /* Set the working pointers at the beginning of the input/output data field */
-        pu8_data_in     = pPlaneIn[u32_plane].pac_data + pPlaneIn[u32_plane].u_topleft;
-        pu8_data_out    = pPlaneOut[u32_plane].pac_data + pPlaneOut[u32_plane].u_topleft;
+    /*
+    Keep the fractionnal part, assimung that integer  part is coded
+    on the 16 high bits and the fractional on the 15 low bits
+    */
+        u32_y_accum = u32_y_inc & 0xffff;
 
-        /* Get the memory jump corresponding to a row jump */
-        u32_stride_in   = pPlaneIn[u32_plane].u_stride;
-        u32_stride_out  = pPlaneOut[u32_plane].u_stride;
+        if (!u32_y_accum)
+        {
+            u32_y_accum = MAX_SHORT;
+        }
 
-        /* Set the bounds of the active image */
-        u32_width_in    = pPlaneIn[u32_plane].u_width;
-        u32_height_in   = pPlaneIn[u32_plane].u_height;
+        u32_y_accum >>= 1;
+    }
+    else
+    {
+        u32_y_accum = 0;
+    }
 
-        u32_width_out   = pPlaneOut[u32_plane].u_width;
-        u32_height_out  = pPlaneOut[u32_plane].u_height;
 
-        /*
-        For the case , width_out = width_in , set the flag to avoid
-        accessing one column beyond the input width.In this case the last
-        column is replicated for processing
-        */
-        if (u32_width_out == u32_width_in) {
-            u32_width_out = u32_width_out-1;
-            u8Wflag = 1;
-        }
+    /*
+    Calculate initial accumulator value : u32_x_accum_start.
+    u32_x_accum_start is coded on 15 bits, and represents a value
+    between 0 and 0.5
+    */
+    if (u32_x_inc >= MAX_SHORT)
+    {
+        u32_x_accum_start = u32_x_inc & 0xffff;
 
-        /* Compute horizontal ratio between src and destination width.*/
-        if (u32_width_out >= u32_width_in)
+        if (!u32_x_accum_start)
         {
-            u32_x_inc   = ((u32_width_in-1) * MAX_SHORT) / (u32_width_out-1);
-        }
-        else
-        {
-            u32_x_inc   = (u32_width_in * MAX_SHORT) / (u32_width_out);
+            u32_x_accum_start = MAX_SHORT;
         }
 
-        /*
-        For the case , height_out = height_in , set the flag to avoid
-        accessing one row beyond the input height.In this case the last
-        row is replicated for processing
-        */
-        if (u32_height_out == u32_height_in) {
-            u32_height_out = u32_height_out-1;
-            u8Hflag = 1;
-        }
+        u32_x_accum_start >>= 1;
+    }
+    else
+    {
+        u32_x_accum_start = 0;
+    }
 
-        /* Compute vertical ratio between src and destination height.*/
-        if (u32_height_out >= u32_height_in)
-        {
-            u32_y_inc   = ((u32_height_in - 1) * MAX_SHORT) / (u32_height_out-1);
-        }
-        else
-        {
-            u32_y_inc = (u32_height_in * MAX_SHORT) / (u32_height_out);
-        }
+    /* Skip the rows before the first one */
+    u64_y_accum_first = u32_y_accum + (uint64_t)u32_first_row * u32_y_inc;
+    pu8_data_in += (M4VIFI_UInt32)(u64_y_accum_first >> 16) * u32_stride_in;
+    u32_y_accum = (M4VIFI_UInt32)(u64_y_accum_first & 0xffff);
+    pu8_data_out += u32_first_row * u32_stride_out;
+
+    /* The replicated last row is not interpolated */
+    if (u32_first_row >= u32_height_out) {
+        u32_height = 0;
+    } else if (u32_first_row + u32_num_rows > u32_height_out) {
+        u32_height = u32_height_out - u32_first_row;
+    } else {
+        u32_height = u32_num_rows;
+    }
+    pu8dum = pu8_data_out - u32_stride_out;
 
-        /*
-        Calculate initial accumulator value : u32_y_accum_start.
-        u32_y_accum_start is coded on 15 bits, and represents a value
-        between 0 and 0.5
-        */
-        if (u32_y_inc >= MAX_SHORT)
-        {
-        /*
-        Keep the fractionnal part, assimung that integer  part is coded
-        on the 16 high bits and the fractional on the 15 low bits
-        */
-            u32_y_accum = u32_y_inc & 0xffff;
+    /*
+    Bilinear interpolation linearly interpolates along each row, and
+    then uses that result in a linear interpolation donw each column.
+    Each estimated pixel in the output image is a weighted combination
+    of its four neighbours according to the formula:
+    F(p',q')=f(p,q)R(-a)R(b)+f(p,q-1)R(-a)R(b-1)+f(p+1,q)R(1-a)R(b)+
+    f(p+&,q+1)R(1-a)R(b-1) with  R(x) = / x+1  -1 =< x =< 0 \ 1-x
+    0 =< x =< 1 and a (resp. b)weighting coefficient is the distance
+    from the nearest neighbor in the p (resp. q) direction
+    */
 
-            if (!u32_y_accum)
-            {
-                u32_y_accum = MAX_SHORT;
-            }
+    while (u32_height--) { /* Scan all the row */
 
-            u32_y_accum >>= 1;
-        }
-        else
-        {
-            u32_y_accum = 0;
-        }
+        /* Vertical weight factor */
+        u32_y_frac = (u32_y_accum>>12)&15;
 
+        /* Reinit accumulator */
+        u32_x_accum = u32_x_accum_start;
 
-        /*
-        Calculate initial accumulator value : u32_x_accum_start.
-        u32_x_accum_start is coded on 15 bits, and represents a value
-        between 0 and 0.5
-        */
-        if (u32_x_inc >= MAX_SHORT)
-        {
-            u32_x_accum_start = u32_x_inc & 0xffff;
+        u32_width = u32_width_out;
 
-            if (!u32_x_accum_start)
-            {
-                u32_x_accum_start = MAX_SHORT;
-            }
+        do { /* Scan along each row */
+            pu8_src_top = pu8_data_in + (u32_x_accum >> 16);
+            pu8_src_bottom = pu8_src_top + u32_stride_in;
+            u32_x_frac = (u32_x_accum >> 12)&15; /* Horizontal weight factor */
 
-            u32_x_accum_start >>= 1;
-        }
-        else
-        {
-            u32_x_accum_start = 0;
-        }
+            /* Weighted combination */
+            u32_temp_value = (M4VIFI_UInt8)(((pu8_src_top[0]*(16-u32_x_frac) +
+                                             pu8_src_top[1]*u32_x_frac)*(16-u32_y_frac) +
+                                            (pu8_src_bottom[0]*(16-u32_x_frac) +
+                                             pu8_src_bottom[1]*u32_x_frac)*u32_y_frac )>>8);
+
+            *pu8_data_out++ = (M4VIFI_UInt8)u32_temp_value;
 
-        u32_height = u32_height_out;
+            /* Update horizontal accumulator */
+            u32_x_accum += u32_x_inc;
+        } while(--u32_width);
 
         /*
-        Bilinear interpolation linearly interpolates along each row, and
-        then uses that result in a linear interpolation donw each column.
-        Each estimated pixel in the output image is a weighted combination
-        of its four neighbours according to the formula:
-        F(p',q')=f(p,q)R(-a)R(b)+f(p,q-1)R(-a)R(b-1)+f(p+1,q)R(1-a)R(b)+
-        f(p+&,q+1)R(1-a)R(b-1) with  R(x) = / x+1  -1 =< x =< 0 \ 1-x
-        0 =< x =< 1 and a (resp. b)weighting coefficient is the distance
-        from the nearest neighbor in the p (resp. q) direction
+           This u8Wflag flag gets in to effect if input and output
+           width is same, and height may be different. So previous
+           pixel is replicated here
         */
+        if (u8Wflag) {
+            *pu8_data_out = (M4VIFI_UInt8)u32_temp_value;
+        }
 
-        do { /* Scan all the row */
-
-            /* Vertical weight factor */
-            u32_y_frac = (u32_y_accum>>12)&15;
-
-            /* Reinit accumulator */
-            u32_x_accum = u32_x_accum_start;
+        pu8dum = (pu8_data_out-u32_width_out);
+        pu8_data_out = pu8_data_out + u32_stride_out - u32_width_out;
 
-            u32_width = u32_width_out;
+        /* Update vertical accumulator */
+        u32_y_accum += u32_y_inc;
+        if (u32_y_accum>>16) {
+            pu8_data_in = pu8_data_in + (u32_y_accum >> 16) * u32_stride_in;
+            u32_y_accum &= 0xffff;
+        }
+    }
 
-            do { /* Scan along each row */
-                pu8_src_top = pu8_data_in + (u32_x_accum >> 16);
-                pu8_src_bottom = pu8_src_top + u32_stride_in;
-                u32_x_frac = (u32_x_accum >> 12)&15; /* Horizontal weight factor */
+    /*
+    This u8Hflag flag gets in to effect if input and output height
+    is same, and width may be different. So previous pixel row is
+    replicated here, by the slice that ends with the plane
+    */
+    if (u8Hflag && u32_first_row + u32_num_rows > u32_height_out &&
+            u32_first_row < u32_height_out) {
+        for(loop =0; loop < (u32_width_out+u8Wflag); loop++) {
+            *pu8_data_out++ = (M4VIFI_UInt8)*pu8dum++;
+        }
+    }
+}
 
-                /* Weighted combination */
-                u32_temp_value = (M4VIFI_UInt8)(((pu8_src_top[0]*(16-u32_x_frac) +
-                                                 pu8_src_top[1]*u32_x_frac)*(16-u32_y_frac) +
-                                                (pu8_src_bottom[0]*(16-u32_x_frac) +
-                                                 pu8_src_bottom[1]*u32_x_frac)*u32_y_frac )>>8);
+typedef struct {
+    M4VIFI_ImagePlane *pPlaneIn;
+    M4VIFI_ImagePlane *pPlaneOut;
+} ResizeSlice;
 
-                *pu8_data_out++ = (M4VIFI_UInt8)u32_temp_value;
+static void resizeBilinearSlice(void *cookie, uint32_t firstRow, uint32_t numRows)
+{
+    ResizeSlice *slice = (ResizeSlice *)cookie;
+    M4VIFI_UInt32 u32_plane;
 
-                /* Update horizontal accumulator */
-                u32_x_accum += u32_x_inc;
-            } while(--u32_width);
+    /* Both luma rows of a chroma row are in the same slice */
+    for(u32_plane = 0;u32_plane < PLANES;u32_plane++)
+    {
+        if (u32_plane == 0) {
+            resizeBilinearPlaneRows(&slice->pPlaneIn[0], &slice->pPlaneOut[0],
+                firstRow, numRows);
+        } else {
+            resizeBilinearPlaneRows(&slice->pPlaneIn[u32_plane],
+                &slice->pPlaneOut[u32_plane], firstRow >> 1, numRows >> 1);
+        }
+    }
+}
 
-            /*
-               This u8Wflag flag gets in to effect if input and output
-               width is same, and height may be different. So previous
-               pixel is replicated here
-            */
-            if (u8Wflag) {
-                *pu8_data_out = (M4VIFI_UInt8)u32_temp_value;
-            }
+M4VIFI_UInt8    M4VIFI_ResizeBilinearYUV420toYUV420(void *pUserData,
+                                                                M4VIFI_ImagePlane *pPlaneIn,
+                                                                M4VIFI_ImagePlane *pPlaneOut)
+{
+    ResizeSlice slice;
 
-            pu8dum = (pu8_data_out-u32_width_out);
-            pu8_data_out = pu8_data_out + u32_stride_out - u32_width_out;
+    /*
+     If input width is equal to output width and input height equal to
+     output height then M4VIFI_YUV420toYUV420 is called.
+    */
+    if ((pPlaneIn[0].u_height == pPlaneOut[0].u_height) &&
+              (pPlaneIn[0].u_width == pPlaneOut[0].u_width))
+    {
+        return M4VIFI_YUV420toYUV420(pUserData, pPlaneIn, pPlaneOut);
+    }
 
-            /* Update vertical accumulator */
-            u32_y_accum += u32_y_inc;
-            if (u32_y_accum>>16) {
-                pu8_data_in = pu8_data_in + (u32_y_accum >> 16) * u32_stride_in;
-                u32_y_accum &= 0xffff;
-            }
-        } while(--u32_height);
+    /* Check for the YUV width and height are even */
+    if ((IS_EVEN(pPlaneIn[0].u_height) == FALSE)    ||
+        (IS_EVEN(pPlaneOut[0].u_height) == FALSE))
+    {
+        return M4VIFI_ILLEGAL_FRAME_HEIGHT;
+    }
 
-        /*
-        This u8Hflag flag gets in to effect if input and output height
-        is same, and width may be different. So previous pixel row is
-        replicated here
-        */
-        if (u8Hflag) {
-            for(loop =0; loop < (u32_width_out+u8Wflag); loop++) {
-                *pu8_data_out++ = (M4VIFI_UInt8)*pu8dum++;
-            }
-        }
+    if ((IS_EVEN(pPlaneIn[0].u_width) == FALSE) ||
+        (IS_EVEN(pPlaneOut[0].u_width) == FALSE))
+    {
+        return M4VIFI_ILLEGAL_FRAME_WIDTH;
     }
 
+    /* Resize horizontal bands of the output on the slicer threads */
+    slice.pPlaneIn = pPlaneIn;
+    slice.pPlaneOut = pPlaneOut;
+    android::FrameSlicer::getInstance().run(resizeBilinearSlice, &slice,
+        pPlaneOut[0].u_height, 2);
+
     return M4VIFI_OK;
 }
 
@@ -3218,6 +3269,64 @@ M4OSA_ERR prepareFramingStructure(
     return err;
 }
 
+/*
+ * Color and luma effects are applied to horizontal bands of the frame on the
+ * FrameSlicer threads. The rows of a band are described by image planes
+ * pointing into the full frame planes.
+ */
+typedef struct {
+    M4VIFI_ImagePlane *planeIn;
+    M4VIFI_ImagePlane *planeOut;
+    M4xVSS_ColorStruct *colorContext;
+    M4OSA_Int32 lumFactor;
+    M4OSA_ERR err;
+} EffectSlice;
+
+static M4OSA_Void slicePlanes(const M4VIFI_ImagePlane *planes,
+    M4VIFI_ImagePlane *slice, M4OSA_UInt32 firstRow, M4OSA_UInt32 numRows) {
+
+    for (int i = 0; i < 3; i++) {
+        M4OSA_UInt32 first = (i == 0) ? firstRow : (firstRow >> 1);
+        M4OSA_UInt32 end = (i == 0) ? (firstRow + numRows) : ((firstRow + numRows) >> 1);
+
+        if (end > planes[i].u_height) {
+            end = planes[i].u_height;
+        }
+        slice[i] = planes[i];
+        slice[i].u_topleft += first * planes[i].u_stride;
+        slice[i].u_height = (end > first) ? (end - first) : 0;
+    }
+}
+
+static void colorEffectSlice(void *cookie, uint32_t firstRow, uint32_t numRows) {
+    EffectSlice *effect = (EffectSlice *)cookie;
+    M4VIFI_ImagePlane planeIn[3], planeOut[3];
+
+    slicePlanes(effect->planeIn, planeIn, firstRow, numRows);
+    slicePlanes(effect->planeOut, planeOut, firstRow, numRows);
+    M4OSA_ERR err = M4VSS3GPP_externalVideoEffectColor(
+     (M4OSA_Void *)effect->colorContext, planeIn, planeOut, NULL,
+     effect->colorContext->colorEffectType);
+    if (err != M4NO_ERROR) {
+        // every band fails the same way
+        effect->err = err;
+    }
+}
+
+static void lumaEffectSlice(void *cookie, uint32_t firstRow, uint32_t numRows) {
+    EffectSlice *effect = (EffectSlice *)cookie;
+    M4VIFI_ImagePlane planeIn[3], planeOut[3];
+
+    slicePlanes(effect->planeIn, planeIn, firstRow, numRows);
+    slicePlanes(effect->planeOut, planeOut, firstRow, numRows);
+    M4OSA_ERR err = M4VFL_modifyLumaWithScale(
+     (M4ViComImagePlane*)planeIn, (M4ViComImagePlane*)planeOut,
+     effect->lumFactor, NULL);
+    if (err != M4NO_ERROR) {
+        effect->err = err;
+    }
+}
+
 M4OSA_ERR applyColorEffect(M4xVSS_VideoEffectType colorEffect,
     M4VIFI_ImagePlane *planeIn, M4VIFI_ImagePlane *planeOut,
     M4VIFI_UInt8 *buffer1, M4VIFI_UInt8 *buffer2, M4OSA_UInt16 rgbColorData) {
@@ -3228,9 +3337,22 @@ M4OSA_ERR applyColorEffect(M4xVSS_VideoEffectType colorEffect,
     colorContext.colorEffectType = colorEffect;
     colorContext.rgb16ColorData = rgbColorData;
 
-    err = M4VSS3GPP_externalVideoEffectColor(
-     (M4OSA_Void *)&colorContext, planeIn, planeOut, NULL,
-     colorEffect);
+    if (colorEffect == M4xVSS_kVideoEffectType_Gradient) {
+        // the gradient depends on the row position in the whole frame
+        err = M4VSS3GPP_externalVideoEffectColor(
+         (M4OSA_Void *)&colorContext, planeIn, planeOut, NULL,
+         colorEffect);
+    } else {
+        EffectSlice effect;
+        effect.planeIn = planeIn;
+        effect.planeOut = planeOut;
+        effect.colorContext = &colorContext;
+        effect.lumFactor = 0;
+        effect.err = M4NO_ERROR;
+        android::FrameSlicer::getInstance().run(colorEffectSlice, &effect,
+            planeOut[0].u_height, 2);
+        err = effect.err;
+    }
 
     if(err != M4NO_ERROR) {
         ALOGV("M4VSS3GPP_externalVideoEffectColor(%d) error %d",
@@ -3258,10 +3380,16 @@ M4OSA_ERR applyLumaEffect(M4VSS3GPP_VideoEffectType videoEffect,
     M4VIFI_UInt8 *buffer1, M4VIFI_UInt8 *buffer2, M4OSA_Int32 lum_factor) {
 
     M4OSA_ERR err = M4NO_ERROR;
+    EffectSlice effect;
 
-    err = M4VFL_modifyLumaWithScale(
-         (M4ViComImagePlane*)planeIn,(M4ViComImagePlane*)planeOut,
-         lum_factor, NULL);
+    effect.planeIn = planeIn;
+    effect.planeOut = planeOut;
+    effect.colorContext = NULL;
+    effect.lumFactor = lum_factor;
+    effect.err = M4NO_ERROR;
+    android::FrameSlicer::getInstance().run(lumaEffectSlice, &effect,
+        planeOut[0].u_height, 2);
+    err = effect.err;
 
     if(err != M4NO_ERROR) {
         ALOGE("M4VFL_modifyLumaWithScale(%d) error %d", videoEffect, (int)err);
@@ -3284,6 +3412,50 @@ M4OSA_ERR applyLumaEffect(M4VSS3GPP_VideoEffectType videoEffect,
     return err;
 }
 
+static const char *const kPostProcessStageNames[VE_NUM_STAGES] = {
+    "black and white", "pink", "green", "sepia", "negative", "framing",
+    "fifties", "color rgb16", "gradient", "fade from black", NULL,
+    "fade to black", "rendering mode",
+};
+
+// Adds the time since stageStart to the stage of the effect bit (or
+// VE_STAGE_RENDERING_MODE)
+static M4OSA_Void recordStage(vePostProcessStats *stats, M4OSA_UInt32 effect,
+    nsecs_t stageStart) {
+
+    if (stats == NULL) {
+        return;
+    }
+    M4OSA_UInt32 stage = 0;
+    while (stage < VE_NUM_STAGES - 1 && !(effect & (1 << stage))) {
+        stage++;
+    }
+    int64_t us = ns2us(systemTime() - stageStart);
+    stats->count[stage]++;
+    stats->totalUs[stage] += us;
+    if (us > stats->maxUs[stage]) {
+        stats->maxUs[stage] = us;
+    }
+}
+
+M4OSA_Void resetPostProcessStats(vePostProcessStats *stats) {
+    memset(stats, 0, sizeof(vePostProcessStats));
+}
+
+M4OSA_Void logPostProcessStats(const vePostProcessStats *stats) {
+    if (stats->frames == 0) {
+        return;
+    }
+    ALOGI("post processed %u frames", stats->frames);
+    for (int i = 0; i < VE_NUM_STAGES; i++) {
+        if (stats->count[i] == 0) {
+            continue;
+        }
+        ALOGI("  %s: %u frames, avg %lld us, max %lld us", kPostProcessStageNames[i],
+            stats->count[i], stats->totalUs[i] / stats->count[i], stats->maxUs[i]);
+    }
+}
+
 M4OSA_ERR applyEffectsAndRenderingMode(vePostProcessParams *params,
     M4OSA_UInt32 reportedWidth, M4OSA_UInt32 reportedHeight) {
 
@@ -3296,6 +3468,10 @@ M4OSA_ERR applyEffectsAndRenderingMode(vePostProcessParams *params,
     M4xVSS_FiftiesStruct fiftiesCtx;
     M4OSA_UInt32 frameSize = 0, i=0;
 
+    if (params->stats != NULL) {
+        params->stats->frames++;
+    }
+
     frameSize = (params->videoWidth*params->videoHeight*3) >> 1;
 
     finalOutputBuffer = (M4VIFI_UInt8*)M4OSA_32bitAlignedMalloc(frameSize, M4VS,
@@ -3333,51 +3509,62 @@ M4OSA_ERR applyEffectsAndRenderingMode(vePostProcessParams *params,
     // output YUV frame so that concurrent effects are both applied
 
     if(params->currentVideoEffect & VIDEO_EFFECT_BLACKANDWHITE) {
+        nsecs_t stageStart = systemTime();
         err = applyColorEffect(M4xVSS_kVideoEffectType_BlackAndWhite,
               planeIn, planeOut, (M4VIFI_UInt8 *)finalOutputBuffer,
               (M4VIFI_UInt8 *)tempOutputBuffer, 0);
         if(err != M4NO_ERROR) {
             return err;
         }
+        recordStage(params->stats, VIDEO_EFFECT_BLACKANDWHITE, stageStart);
     }
 
     if(params->currentVideoEffect & VIDEO_EFFECT_PINK) {
+        nsecs_t stageStart = systemTime();
         err = applyColorEffect(M4xVSS_kVideoEffectType_Pink,
               planeIn, planeOut, (M4VIFI_UInt8 *)finalOutputBuffer,
               (M4VIFI_UInt8 *)tempOutputBuffer, 0);
         if(err != M4NO_ERROR) {
             return err;
         }
+        recordStage(params->stats, VIDEO_EFFECT_PINK, stageStart);
     }
 
     if(params->currentVideoEffect & VIDEO_EFFECT_GREEN) {
+        nsecs_t stageStart = systemTime();
         err = applyColorEffect(M4xVSS_kVideoEffectType_Green,
               planeIn, planeOut, (M4VIFI_UInt8 *)finalOutputBuffer,
               (M4VIFI_UInt8 *)tempOutputBuffer, 0);
         if(err != M4NO_ERROR) {
             return err;
         }
+        recordStage(params->stats, VIDEO_EFFECT_GREEN, stageStart);
     }
 
     if(params->currentVideoEffect & VIDEO_EFFECT_SEPIA) {
+        nsecs_t stageStart = systemTime();
         err = applyColorEffect(M4xVSS_kVideoEffectType_Sepia,
               planeIn, planeOut, (M4VIFI_UInt8 *)finalOutputBuffer,
               (M4VIFI_UInt8 *)tempOutputBuffer, 0);
         if(err != M4NO_ERROR) {
             return err;
         }
+        recordStage(params->stats, VIDEO_EFFECT_SEPIA, stageStart);
     }
 
     if(params->currentVideoEffect & VIDEO_EFFECT_NEGATIVE) {
+        nsecs_t stageStart = systemTime();
         err = applyColorEffect(M4xVSS_kVideoEffectType_Negative,
               planeIn, planeOut, (M4VIFI_UInt8 *)finalOutputBuffer,
               (M4VIFI_UInt8 *)tempOutputBuffer, 0);
         if(err != M4NO_ERROR) {
             return err;
         }
+        recordStage(params->stats, VIDEO_EFFECT_NEGATIVE, stageStart);
     }
 
     if(params->currentVideoEffect & VIDEO_EFFECT_GRADIENT) {
+        nsecs_t stageStart = systemTime();
         // find the effect in effectSettings array
         for(i=0;i<params->numberEffects;i++) {
             if(params->effectsSettings[i].VideoEffectType ==
@@ -3391,9 +3578,11 @@ M4OSA_ERR applyEffectsAndRenderingMode(vePostProcessParams *params,
         if(err != M4NO_ERROR) {
             return err;
         }
+        recordStage(params->stats, VIDEO_EFFECT_GRADIENT, stageStart);
     }
 
     if(params->currentVideoEffect & VIDEO_EFFECT_COLOR_RGB16) {
+        nsecs_t stageStart = systemTime();
         // Find the effect in effectSettings array
         for(i=0;i<params->numberEffects;i++) {
             if(params->effectsSettings[i].VideoEffectType ==
@@ -3407,9 +3596,11 @@ M4OSA_ERR applyEffectsAndRenderingMode(vePostProcessParams *params,
         if(err != M4NO_ERROR) {
             return err;
         }
+        recordStage(params->stats, VIDEO_EFFECT_COLOR_RGB16, stageStart);
     }
 
     if(params->currentVideoEffect & VIDEO_EFFECT_FIFTIES) {
+        nsecs_t stageStart = systemTime();
         // Find the effect in effectSettings array
         for(i=0;i<params->numberEffects;i++) {
             if(params->effectsSettings[i].VideoEffectType ==
@@ -3452,9 +3643,11 @@ M4OSA_ERR applyEffectsAndRenderingMode(vePostProcessParams *params,
             swapImagePlanes(planeIn, planeOut,(M4VIFI_UInt8 *)finalOutputBuffer,
              (M4VIFI_UInt8 *)tempOutputBuffer);
         }
+        recordStage(params->stats, VIDEO_EFFECT_FIFTIES, stageStart);
     }
 
     if(params->currentVideoEffect & VIDEO_EFFECT_FRAMING) {
+        nsecs_t stageStart = systemTime();
 
         M4xVSS_FramingStruct framingCtx;
         // Find the effect in effectSettings array
@@ -3509,9 +3702,11 @@ M4OSA_ERR applyEffectsAndRenderingMode(vePostProcessParams *params,
             swapImagePlanes(planeIn, planeOut,(M4VIFI_UInt8 *)finalOutputBuffer,
              (M4VIFI_UInt8 *)tempOutputBuffer);
         }
+        recordStage(params->stats, VIDEO_EFFECT_FRAMING, stageStart);
     }
 
     if(params->currentVideoEffect & VIDEO_EFFECT_FADEFROMBLACK) {
+        nsecs_t stageStart = systemTime();
         /* find the effect in effectSettings array*/
         for(i=0;i<params->numberEffects;i++) {
             if(params->effectsSettings[i].VideoEffectType ==
@@ -3534,9 +3729,11 @@ M4OSA_ERR applyEffectsAndRenderingMode(vePostProcessParams *params,
                 return err;
             }
         }
+        recordStage(params->stats, VIDEO_EFFECT_FADEFROMBLACK, stageStart);
     }
 
     if(params->currentVideoEffect & VIDEO_EFFECT_FADETOBLACK) {
+        nsecs_t stageStart = systemTime();
         // Find the effect in effectSettings array
         for(i=0;i<params->numberEffects;i++) {
             if(params->effectsSettings[i].VideoEffectType ==
@@ -3558,6 +3755,7 @@ M4OSA_ERR applyEffectsAndRenderingMode(vePostProcessParams *params,
                 return err;
             }
         }
+        recordStage(params->stats, VIDEO_EFFECT_FADETOBLACK, stageStart);
     }
 
     ALOGV("doMediaRendering CALL getBuffer()");
@@ -3574,7 +3772,9 @@ M4OSA_ERR applyEffectsAndRenderingMode(vePostProcessParams *params,
     prepareYV12ImagePlane(planeOut, yv12PlaneWidth, yv12PlaneHeight,
      (M4OSA_UInt32)params->outBufferStride, (M4VIFI_UInt8 *)params->pOutBuffer);
 
+    nsecs_t stageStart = systemTime();
     err = applyRenderingMode(planeIn, planeOut, params->renderingMode);
+    recordStage(params->stats, VE_STAGE_RENDERING_MODE, stageStart);
 
     if(M4OSA_NULL != finalOutputBuffer) {
         free(finalOutputBuffer);
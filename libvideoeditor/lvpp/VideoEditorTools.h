@@ -50,6 +50,20 @@ enum {
     VIDEO_EFFECT_FADETOBLACK        = 2048,
 };
 
+// Time spent in the stages of applyEffectsAndRenderingMode(), indexed by
+// the bit number of the VIDEO_EFFECT_ value, the rendering mode coming last
+enum {
+    VE_STAGE_RENDERING_MODE         = 4096,
+    VE_NUM_STAGES                   = 13,
+};
+
+typedef struct {
+    M4OSA_UInt32 frames;
+    M4OSA_UInt32 count[VE_NUM_STAGES];
+    int64_t totalUs[VE_NUM_STAGES];
+    int64_t maxUs[VE_NUM_STAGES];
+} vePostProcessStats;
+
 typedef struct {
     M4VIFI_UInt8 *vidBuffer;
     M4OSA_UInt32 videoWidth;
@@ -68,6 +82,7 @@ typedef struct {
     size_t outBufferStride;
     M4VIFI_UInt8*  overlayFrameRGBBuffer;
     M4VIFI_UInt8*  overlayFrameYUVBuffer;
+    vePostProcessStats* stats; // NULL if the stages are not timed
 } vePostProcessParams;
 
 M4VIFI_UInt8 M4VIFI_YUV420PlanarToYUV420Semiplanar(void *user_data, M4VIFI_ImagePlane *PlaneIn, M4VIFI_ImagePlane *PlaneOut );
@@ -136,6 +151,10 @@ M4OSA_ERR applyLumaEffect(M4VSS3GPP_VideoEffectType videoEffect,
 M4OSA_ERR applyEffectsAndRenderingMode(vePostProcessParams *params,
     M4OSA_UInt32 reportedWidth, M4OSA_UInt32 reportedHeight);
 
+M4OSA_Void resetPostProcessStats(vePostProcessStats *stats);
+
+M4OSA_Void logPostProcessStats(const vePostProcessStats *stats);
+
 android::status_t getVideoSizeByResolution(M4VIDEOEDITING_VideoFrameSize resolution,
     uint32_t *pWidth, uint32_t *pHeight);
 
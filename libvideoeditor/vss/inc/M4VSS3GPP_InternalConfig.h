@@ -33,6 +33,9 @@
 #define M4VSS3GPP_NO_STSS_JUMP_POINT                    40000 /**< If 3gp file does not contain
                                                                    an STSS table (no rap frames),
                                                                    jump backward 40 s maximum */
+#define M4VSS3GPP_ANALYSIS_THREADS                      3     /**< Clips analysed at the same
+                                                                   time, including the calling
+                                                                   thread */
 
 /*****************/
 /* Writer config */
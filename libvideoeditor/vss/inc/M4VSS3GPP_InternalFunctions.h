@@ -543,6 +543,22 @@ M4OSA_UInt32 M4VSS3GPP_intGetFrameSize_EVRC(M4OSA_MemAddr8 pAudioFrame);
 M4OSA_ERR M4VSS3GPP_intBuildAnalysis(M4VSS3GPP_ClipContext *pClipCtxt,
                                      M4VIDEOEDITING_ClipProperties *pClipProperties);
 
+/**
+ ******************************************************************************
+ * M4OSA_ERR M4VSS3GPP_intAnalyseClips()
+ * @brief    Analyse the clips of the list that are not analysed yet
+ * @note    Up to M4VSS3GPP_ANALYSIS_THREADS clips are analysed at the same time.
+ * @param   pClipList            (IN/OUT) Clip settings, their ClipProperties are filled
+ * @param    uiClipNumber        (IN) Number of clips in pClipList
+ * @param    pFileReadPtrFct        (IN) File reader functions
+ * @return    M4NO_ERROR:            No error
+ * @return    The error of M4VSS3GPP_editAnalyseClip() for the first clip that failed
+ ******************************************************************************
+*/
+M4OSA_ERR M4VSS3GPP_intAnalyseClips(M4VSS3GPP_ClipSettings *pClipList,
+                                    M4OSA_UInt32 uiClipNumber,
+                                    M4OSA_FileReadPointer *pFileReadPtrFct);
+
 /**
  ******************************************************************************
  * M4OSA_ERR M4VSS3GPP_intCreateAudioEncoder()
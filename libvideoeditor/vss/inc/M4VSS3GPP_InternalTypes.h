@@ -605,6 +605,8 @@ typedef struct
                                                               external effect is active */
     M4OSA_Int32              iInOutTimeOffset;
     M4OSA_Bool               bEncodeTillEoF;
+    M4OSA_Bool               bH264StreamCopy;   /**< The H.264 AUs of all the clips are
+                                                     copied, no video encoder is used */
     M4xVSS_EditSettings      xVSS;
     M4OSA_Context            m_air_context;
 
@@ -40,6 +40,11 @@
  *    OSAL headers */
 #include "M4OSA_Memory.h" /* OSAL memory management */
 #include "M4OSA_Debug.h"  /* OSAL debug management */
+#include "M4OSA_Mutex.h"
+#include "M4OSA_Semaphore.h"
+#include "M4OSA_Thread.h"
+
+#include <stdlib.h>
 
 /**
  ******************************************************************************
@@ -189,6 +194,207 @@ M4OSA_ERR M4VSS3GPP_editAnalyseClip( M4OSA_Void *pClip,
     return M4NO_ERROR;
 }
 
+/**
+ * Shared by the threads of M4VSS3GPP_intAnalyseClips() */
+typedef struct
+{
+    M4VSS3GPP_ClipSettings *pClipList;
+    M4OSA_UInt32 uiClipNumber;
+    M4OSA_FileReadPointer *pFileReadPtrFct;
+    M4OSA_Context hMutex;     /**< Protects uiNextClip */
+    M4OSA_UInt32 uiNextClip;  /**< Next clip to look at */
+    M4OSA_ERR *pErrors;       /**< Analysis result of each clip */
+    M4OSA_Context hSemDone;   /**< Posted by each thread once no clip is left */
+} M4VSS3GPP_AnalysisJob;
+
+/**
+ ******************************************************************************
+ * M4OSA_Bool M4VSS3GPP_intAnalyseNextClip()
+ * @brief    Take the next clip to analyse from the job and analyse it
+ * @return    M4OSA_FALSE if no clip was left
+ ******************************************************************************
+ */
+static M4OSA_Bool M4VSS3GPP_intAnalyseNextClip( M4VSS3GPP_AnalysisJob *pJob )
+{
+    M4VSS3GPP_ClipSettings *pClip = M4OSA_NULL;
+    M4OSA_UInt32 uiClip;
+
+    M4OSA_mutexLock(pJob->hMutex, M4OSA_WAIT_FOREVER);
+    while( pJob->uiNextClip < pJob->uiClipNumber )
+    {
+        uiClip = pJob->uiNextClip++;
+        if( M4OSA_FALSE == pJob->pClipList[uiClip].ClipProperties.bAnalysed )
+        {
+            pClip = &pJob->pClipList[uiClip];
+            break;
+        }
+    }
+    M4OSA_mutexUnlock(pJob->hMutex);
+
+    if( M4OSA_NULL == pClip )
+    {
+        return M4OSA_FALSE;
+    }
+
+    /**< Analysis not provided by the integrator */
+    pJob->pErrors[uiClip] = M4VSS3GPP_editAnalyseClip(pClip->pFile,
+        pClip->FileType, &pClip->ClipProperties, pJob->pFileReadPtrFct);
+    return M4OSA_TRUE;
+}
+
+/**
+ ******************************************************************************
+ * M4OSA_ERR M4VSS3GPP_intAnalysisThread()
+ * @brief    OSAL thread function of the extra analysis threads
+ * @note    Returns a warning to end the thread once no clip is left
+ ******************************************************************************
+ */
+static M4OSA_ERR M4VSS3GPP_intAnalysisThread( M4OSA_Void *pParam )
+{
+    M4VSS3GPP_AnalysisJob *pJob = (M4VSS3GPP_AnalysisJob *)pParam;
+
+    if( M4OSA_FALSE == M4VSS3GPP_intAnalyseNextClip(pJob) )
+    {
+        M4OSA_semaphorePost(pJob->hSemDone);
+        return M4WAR_NO_MORE_STREAM;
+    }
+    return M4NO_ERROR;
+}
+
+/**
+ ******************************************************************************
+ * M4OSA_ERR M4VSS3GPP_intAnalyseClips()
+ * @brief    Analyse the clips of the list that are not analysed yet
+ * @note    The calling thread analyses clips too, along with up to
+ *          M4VSS3GPP_ANALYSIS_THREADS - 1 OSAL threads. Each clip is opened
+ *          in its own clip context, so the analyses are independent.
+ ******************************************************************************
+ */
+M4OSA_ERR M4VSS3GPP_intAnalyseClips( M4VSS3GPP_ClipSettings *pClipList,
+                                    M4OSA_UInt32 uiClipNumber,
+                                    M4OSA_FileReadPointer *pFileReadPtrFct )
+{
+    M4OSA_ERR err = M4NO_ERROR;
+    M4VSS3GPP_AnalysisJob job;
+    M4OSA_Context hThreads[M4VSS3GPP_ANALYSIS_THREADS - 1];
+    M4OSA_ThreadState state;
+    M4OSA_UInt32 uiToAnalyse = 0;
+    M4OSA_UInt32 uiThreads = 0;
+    M4OSA_UInt32 i;
+
+    for ( i = 0; i < uiClipNumber; i++ )
+    {
+        if( M4OSA_FALSE == pClipList[i].ClipProperties.bAnalysed )
+        {
+            uiToAnalyse++;
+        }
+    }
+    if( 0 == uiToAnalyse )
+    {
+        return M4NO_ERROR;
+    }
+
+    job.pClipList = pClipList;
+    job.uiClipNumber = uiClipNumber;
+    job.pFileReadPtrFct = pFileReadPtrFct;
+    job.uiNextClip = 0;
+    job.hMutex = M4OSA_NULL;
+    job.hSemDone = M4OSA_NULL;
+    job.pErrors = (M4OSA_ERR *)M4OSA_32bitAlignedMalloc(
+        sizeof(M4OSA_ERR) * uiClipNumber, M4VSS3GPP, (M4OSA_Char *)"analysis errors");
+
+    if( M4OSA_NULL == job.pErrors )
+    {
+        M4OSA_TRACE1_0(
+            "M4VSS3GPP_intAnalyseClips: unable to allocate pErrors, returning M4ERR_ALLOC");
+        return M4ERR_ALLOC;
+    }
+    for ( i = 0; i < uiClipNumber; i++ )
+    {
+        job.pErrors[i] = M4NO_ERROR;
+    }
+
+    err = M4OSA_mutexOpen(&job.hMutex);
+    if( M4NO_ERROR == err )
+    {
+        err = M4OSA_semaphoreOpen(&job.hSemDone, 0);
+    }
+    if( M4NO_ERROR != err )
+    {
+        M4OSA_TRACE1_1("M4VSS3GPP_intAnalyseClips: OSAL init error 0x%x", err);
+        goto cleanup;
+    }
+
+    /**
+    * Start the extra threads. If one can't be started, the others
+    * (at worst the calling thread alone) analyse its clips */
+    while( uiThreads < M4VSS3GPP_ANALYSIS_THREADS - 1 && uiThreads + 1 < uiToAnalyse )
+    {
+        err = M4OSA_threadSyncOpen(&hThreads[uiThreads],
+            (M4OSA_ThreadDoIt)M4VSS3GPP_intAnalysisThread);
+        if( M4NO_ERROR != err )
+        {
+            break;
+        }
+        err = M4OSA_threadSyncStart(hThreads[uiThreads], (M4OSA_Void *)&job);
+        if( M4NO_ERROR != err )
+        {
+            M4OSA_threadSyncClose(hThreads[uiThreads]);
+            break;
+        }
+        uiThreads++;
+    }
+    err = M4NO_ERROR;
+
+    while( M4VSS3GPP_intAnalyseNextClip(&job) )
+    {
+    }
+
+    /**
+    * Wait for the threads to end. They post hSemDone just before returning
+    * from their last doIt call, after which their state goes back to opened */
+    for ( i = 0; i < uiThreads; i++ )
+    {
+        M4OSA_semaphoreWait(job.hSemDone, M4OSA_WAIT_FOREVER);
+    }
+    for ( i = 0; i < uiThreads; i++ )
+    {
+        M4OSA_threadSyncGetState(hThreads[i], &state);
+        while( M4OSA_kThreadOpened != state )
+        {
+            M4OSA_threadSleep(1);
+            M4OSA_threadSyncGetState(hThreads[i], &state);
+        }
+        M4OSA_threadSyncClose(hThreads[i]);
+    }
+
+    /**
+    * Report the error of the first failing clip, as the sequential analysis did */
+    for ( i = 0; i < uiClipNumber; i++ )
+    {
+        if( M4NO_ERROR != job.pErrors[i] )
+        {
+            M4OSA_TRACE1_2(
+                "M4VSS3GPP_intAnalyseClips: M4VSS3GPP_editAnalyseClip(%d) returns 0x%x!",
+                i, job.pErrors[i]);
+            err = job.pErrors[i];
+            break;
+        }
+    }
+
+cleanup:
+    if( M4OSA_NULL != job.hSemDone )
+    {
+        M4OSA_semaphoreClose(job.hSemDone);
+    }
+    if( M4OSA_NULL != job.hMutex )
+    {
+        M4OSA_mutexClose(job.hMutex);
+    }
+    free(job.pErrors);
+    return err;
+}
+
 /**
  ******************************************************************************
  * M4OSA_ERR M4VSS3GPP_editCheckClipCompatibility()
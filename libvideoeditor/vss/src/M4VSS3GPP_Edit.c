@@ -67,6 +67,8 @@ static M4OSA_ERR M4VSS3GPP_intSwitchToNextClip(
 static M4OSA_ERR
 M4VSS3GPP_intComputeOutputVideoAndAudioDsi( M4VSS3GPP_InternalEditContext *pC,
                                            M4OSA_UInt8 uiMasterClip );
+static M4OSA_Bool M4VSS3GPP_intCheckH264StreamCopy(
+    M4VSS3GPP_InternalEditContext *pC );
 static M4OSA_Void M4VSS3GPP_intComputeOutputAverageVideoBitrate(
     M4VSS3GPP_InternalEditContext *pC );
 
@@ -241,6 +243,7 @@ M4OSA_ERR M4VSS3GPP_editInit( M4VSS3GPP_EditContext *pContext,
 
     pC->iInOutTimeOffset = 0;
     pC->bEncodeTillEoF = M4OSA_FALSE;
+    pC->bH264StreamCopy = M4OSA_FALSE;
     pC->nbActiveEffects = 0;
     pC->nbActiveEffects1 = 0;
     pC->bIssecondClip = M4OSA_FALSE;
@@ -610,23 +613,15 @@ M4OSA_ERR M4VSS3GPP_editOpen( M4VSS3GPP_EditContext pContext,
 
     /**
     * Test the clip analysis data, if it is not provided, analyse the clips by ourselves. */
-    for ( i = 0; i < pC->uiClipNumber; i++ )
-    {
-        if( M4OSA_FALSE == pC->pClipList[i].ClipProperties.bAnalysed )
-        {
-            /**< Analysis not provided by the integrator */
-            err = M4VSS3GPP_editAnalyseClip(pC->pClipList[i].pFile,
-                pC->pClipList[i].FileType, &pC->pClipList[i].ClipProperties,
-                pC->pOsaFileReadPtr);
+    err = M4VSS3GPP_intAnalyseClips(pC->pClipList, pC->uiClipNumber,
+        pC->pOsaFileReadPtr);
 
-            if( M4NO_ERROR != err )
-            {
-                M4OSA_TRACE1_1(
-                    "M4VSS3GPP_editOpen: M4VSS3GPP_editAnalyseClip returns 0x%x!",
-                    err);
-                return err;
-            }
-        }
+    if( M4NO_ERROR != err )
+    {
+        M4OSA_TRACE1_1(
+            "M4VSS3GPP_editOpen: M4VSS3GPP_intAnalyseClips returns 0x%x!",
+            err);
+        return err;
     }
 
     /**
@@ -1053,6 +1048,11 @@ M4OSA_ERR M4VSS3GPP_editOpen( M4VSS3GPP_EditContext pContext,
             break;
     }
 
+    /**
+    * H.264 clips are re-encoded, unless the whole edit is a plain trim and
+    * concatenation of compatible clips */
+    pC->bH264StreamCopy = M4VSS3GPP_intCheckH264StreamCopy(pC);
+
     for (i=0; i<pC->uiClipNumber; i++) {
         if (pC->pClipList[i].bTranscodingRequired == M4OSA_FALSE) {
             /** If not transcoded in Analysis phase, check
@@ -1064,8 +1064,8 @@ M4OSA_ERR M4VSS3GPP_editOpen( M4VSS3GPP_EditContext pContext,
                    pC->ewc.uiVideoWidth) ||
                   (pC->pClipList[i].ClipProperties.uiVideoHeight !=
                    pC->ewc.uiVideoHeight) ||
-                  (pC->pClipList[i].ClipProperties.VideoStreamType ==
-                   M4VIDEOEDITING_kH264) ||
+                  ((pC->pClipList[i].ClipProperties.VideoStreamType ==
+                   M4VIDEOEDITING_kH264) && !pC->bH264StreamCopy) ||
                   (pC->pClipList[i].ClipProperties.VideoStreamType ==
                    M4VIDEOEDITING_kMPEG4 &&
                    pC->pClipList[i].ClipProperties.uiVideoTimeScale !=
@@ -2665,6 +2665,32 @@ M4VSS3GPP_intComputeOutputVideoAndAudioDsi( M4VSS3GPP_InternalEditContext *pC,
         pC->ewc.pVideoOutputDsi[6] = pC->xVSS.outputVideoProfile;
     }
 
+    /**
+    * H.264 stream copy case: all the clips share the DSI of the first one */
+    else if( ( M4SYS_kH264 == pC->ewc.VideoStreamType)
+        && (M4OSA_TRUE == pC->bH264StreamCopy) )
+    {
+        pStreamForDsi = &(pC->pC1->pVideoStream->m_basicProperties);
+
+        pC->ewc.pVideoOutputDsi =
+            (M4OSA_MemAddr8)M4OSA_32bitAlignedMalloc(
+            pStreamForDsi->m_H264decoderSpecificInfoSize, M4VSS3GPP,
+            (M4OSA_Char *)"pC->ewc.pVideoOutputDsi (H264 copy)");
+
+        if( M4OSA_NULL == pC->ewc.pVideoOutputDsi )
+        {
+            M4OSA_TRACE1_0(
+                "M4VSS3GPP_intComputeOutputVideoAndAudioDsi():\
+                unable to allocate pVideoOutputDsi (H264 copy), returning M4ERR_ALLOC");
+            return M4ERR_ALLOC;
+        }
+        pC->ewc.uiVideoOutputDsiSize =
+            (M4OSA_UInt16)pStreamForDsi->m_H264decoderSpecificInfoSize;
+        memcpy((void *)pC->ewc.pVideoOutputDsi,
+            (void *)pStreamForDsi->m_pH264DecoderSpecificInfo,
+            pStreamForDsi->m_H264decoderSpecificInfoSize);
+    }
+
     /**
     * MPEG-4 case */
     else if( M4SYS_kMPEG_4 == pC->ewc.VideoStreamType ||
@@ -3476,3 +3502,170 @@ static M4OSA_Void M4VSS3GPP_intComputeOutputAverageVideoBitrate(
     pC->ewc.uiVideoBitrate = ( total_bitsum / total_duration) * 1000;
 }
 
+
+/**
+ ******************************************************************************
+ * M4OSA_Bool  M4VSS3GPP_intCheckH264StreamCopy()
+ * @brief    Check if the H.264 AUs of all the clips can be written to the output
+ *          file as they are read, without any video encoder.
+ * @note    The writer has a single DSI, so it's only possible when all the clips share
+ *          the same SPS and PPS, and nothing requires re-encoding a frame: no
+ *          effect, no transition, and each begin cut falls on a sync frame.
+ *          Baseline profile is required as the copy doesn't reorder frames.
+ *          Clips with a begin cut are opened to check the sync frame position.
+ * @param   pC    (IN) Internal edit context
+ * @return  M4OSA_TRUE if the stream copy can be used
+ ******************************************************************************
+ */
+static M4OSA_Bool M4VSS3GPP_intCheckH264StreamCopy(
+    M4VSS3GPP_InternalEditContext *pC )
+{
+    M4VSS3GPP_ClipSettings *pClipSettings;
+    M4VSS3GPP_ClipContext *pClip;
+    M4_StreamHandler *pStream;
+    M4OSA_UInt8 *pRefDsi = M4OSA_NULL;
+    M4OSA_UInt32 uiRefDsiSize = 0;
+    M4OSA_Bool bCopy = M4OSA_TRUE;
+    M4OSA_Int32 iCts;
+    M4OSA_ERR err;
+    M4OSA_UInt32 i;
+
+    if( ( M4VIDEOEDITING_kH264 != pC->xVSS.outputVideoFormat)
+        || (M4OSA_TRUE == pC->bIsMMS) )
+    {
+        return M4OSA_FALSE;
+    }
+
+    for ( i = 0; i < pC->nbEffects; i++ )
+    {
+        if( M4VSS3GPP_kVideoEffectType_None != pC->pEffectsList[i].VideoEffectType )
+        {
+            M4OSA_TRACE2_0("M4VSS3GPP_intCheckH264StreamCopy: video effect, no copy");
+            return M4OSA_FALSE;
+        }
+    }
+
+    for ( i = 0; i + 1 < pC->uiClipNumber; i++ )
+    {
+        if( pC->pTransitionList[i].uiTransitionDuration > 0 )
+        {
+            M4OSA_TRACE2_0("M4VSS3GPP_intCheckH264StreamCopy: transition, no copy");
+            return M4OSA_FALSE;
+        }
+    }
+
+    for ( i = 0; i < pC->uiClipNumber; i++ )
+    {
+        pClipSettings = &pC->pClipList[i];
+
+        if( ( ( M4VIDEOEDITING_kFileType_3GPP != pClipSettings->FileType)
+            && (M4VIDEOEDITING_kFileType_MP4 != pClipSettings->FileType))
+            || (M4OSA_TRUE == pClipSettings->bTranscodingRequired)
+            || (M4VIDEOEDITING_kH264 != pClipSettings->ClipProperties.VideoStreamType)
+            || (pClipSettings->ClipProperties.uiVideoWidth != pC->ewc.uiVideoWidth)
+            || (pClipSettings->ClipProperties.uiVideoHeight != pC->ewc.uiVideoHeight) )
+        {
+            M4OSA_TRACE2_1("M4VSS3GPP_intCheckH264StreamCopy: clip %d not copyable", i);
+            bCopy = M4OSA_FALSE;
+            break;
+        }
+
+        pClip = M4OSA_NULL;
+        err = M4VSS3GPP_intClipInit(&pClip, pC->pOsaFileReadPtr);
+
+        if( M4NO_ERROR == err )
+        {
+            err = M4VSS3GPP_intClipOpen(pClip, pClipSettings,
+                M4OSA_TRUE, M4OSA_FALSE, M4OSA_TRUE);
+        }
+
+        if( ( M4NO_ERROR != err) || (M4OSA_NULL == pClip->pVideoStream) )
+        {
+            M4OSA_TRACE1_2(
+                "M4VSS3GPP_intCheckH264StreamCopy: cannot open clip %d (0x%x)", i, err);
+            bCopy = M4OSA_FALSE;
+        }
+        else
+        {
+            pStream = &pClip->pVideoStream->m_basicProperties;
+
+            /**
+            * The second byte of the avcC box is the profile_idc, 66 is baseline */
+            if( ( M4OSA_NULL == pStream->m_pH264DecoderSpecificInfo)
+                || (pStream->m_H264decoderSpecificInfoSize < 2)
+                || (66 != pStream->m_pH264DecoderSpecificInfo[1]) )
+            {
+                bCopy = M4OSA_FALSE;
+            }
+            else if( M4OSA_NULL == pRefDsi )
+            {
+                uiRefDsiSize = pStream->m_H264decoderSpecificInfoSize;
+                pRefDsi = (M4OSA_UInt8 *)M4OSA_32bitAlignedMalloc(uiRefDsiSize,
+                    M4VSS3GPP, (M4OSA_Char *)"H264 stream copy DSI");
+
+                if( M4OSA_NULL == pRefDsi )
+                {
+                    bCopy = M4OSA_FALSE;
+                }
+                else
+                {
+                    memcpy((void *)pRefDsi,
+                        (void *)pStream->m_pH264DecoderSpecificInfo, uiRefDsiSize);
+                }
+            }
+            else if( ( uiRefDsiSize != pStream->m_H264decoderSpecificInfoSize)
+                || (0 != memcmp((void *)pRefDsi,
+                (void *)pStream->m_pH264DecoderSpecificInfo, uiRefDsiSize)) )
+            {
+                bCopy = M4OSA_FALSE;
+            }
+
+            /**
+            * The reader jumps to the sync frame preceding the begin cut, it must be the
+            * begin cut itself (give or take the rounding of the reader's ms times) */
+            if( ( M4OSA_TRUE == bCopy) && (pClipSettings->uiBeginCutTime > 0) )
+            {
+                iCts = (M4OSA_Int32)pClipSettings->uiBeginCutTime;
+                err = pClip->ShellAPI.m_pReader->m_pFctJump(pClip->pReaderContext,
+                    (M4_StreamHandler *)pClip->pVideoStream, &iCts);
+
+                if( M4NO_ERROR == err )
+                {
+                    err = pClip->ShellAPI.m_pReaderDataIt->m_pFctGetNextAu(
+                        pClip->pReaderContext, (M4_StreamHandler *)pClip->pVideoStream,
+                        &pClip->VideoAU);
+                }
+
+                if( ( M4NO_ERROR != err) || (pClip->VideoAU.m_CTS + 1
+                    < (M4OSA_Double)pClipSettings->uiBeginCutTime) )
+                {
+                    bCopy = M4OSA_FALSE;
+                }
+            }
+
+            if( M4OSA_FALSE == bCopy )
+            {
+                M4OSA_TRACE2_1(
+                    "M4VSS3GPP_intCheckH264StreamCopy: clip %d needs re-encoding", i);
+            }
+        }
+
+        if( M4OSA_NULL != pClip )
+        {
+            M4VSS3GPP_intClipCleanUp(pClip);
+        }
+
+        if( M4OSA_FALSE == bCopy )
+        {
+            break;
+        }
+    }
+
+    if( M4OSA_NULL != pRefDsi )
+    {
+        free(pRefDsi);
+    }
+
+    M4OSA_TRACE1_1("M4VSS3GPP_intCheckH264StreamCopy: returning %d", bCopy);
+    return bCopy;
+}
@@ -264,11 +264,16 @@ M4OSA_ERR M4VSS3GPP_intEditStepVideo( M4VSS3GPP_InternalEditContext *pC )
                     iNextCts = pC->pC1->iEndTime;
 
                 /**
-                * If the AU is good to be written, write it, else just skip it */
+                * If the AU is good to be written, write it, else just skip it.
+                * When copying H.264, every AU is written since the next ones reference it,
+                * even when the clip has a higher frame rate than the output. */
                 if( ( M4OSA_FALSE == bSkipFrame)
                     && (( pC->pC1->VideoAU.m_CTS >= iCts)
+                    || ((M4OSA_TRUE == pC->bH264StreamCopy)
+                    && (pC->pC1->VideoAU.m_CTS + pC->pC1->iVoffset
+                    > pC->ewc.WriterVideoAU.CTS)))
                     && (pC->pC1->VideoAU.m_CTS < iNextCts)
-                    && (pC->pC1->VideoAU.m_size > 0)) )
+                    && (pC->pC1->VideoAU.m_size > 0) )
                 {
                     /**
                     * Get the output AU to write into */
@@ -292,7 +297,16 @@ M4OSA_ERR M4VSS3GPP_intEditStepVideo( M4VSS3GPP_InternalEditContext *pC )
                     // Decorrelate input and output encoding timestamp to handle encoder prefetch
                     pC->ewc.WriterVideoAU.CTS = (M4OSA_Time)pC->pC1->VideoAU.m_CTS +
                         (M4OSA_Time)pC->pC1->iVoffset;
-                    pC->ewc.dInputVidCts += pC->dOutputFrameDuration;
+                    if( M4OSA_TRUE == pC->bH264StreamCopy )
+                    {
+                        /* Follow the copied AUs rather than the output frame rate */
+                        pC->ewc.dInputVidCts = (M4OSA_Double)pC->ewc.WriterVideoAU.CTS
+                            + pC->dOutputFrameDuration;
+                    }
+                    else
+                    {
+                        pC->ewc.dInputVidCts += pC->dOutputFrameDuration;
+                    }
                     offset = 0;
                     /* for h.264 stream do not read the 1st 4 bytes as they are header
                      indicators */
@@ -812,7 +826,11 @@ static M4OSA_ERR M4VSS3GPP_intCheckVideoMode(
         to catch all P-frames after the cut) */
         else if( M4OSA_TRUE == pC->bClip1AtBeginCut )
         {
-            if(pC->pC1->pSettings->ClipProperties.VideoStreamType == M4VIDEOEDITING_kH264) {
+            if( M4OSA_TRUE == pC->bH264StreamCopy ) {
+                /* The begin cut was checked to be on a sync frame, copy from it */
+                pC->Vstate = M4VSS3GPP_kEditVideoState_READ_WRITE;
+            } else if(pC->pC1->pSettings->ClipProperties.VideoStreamType ==
+                M4VIDEOEDITING_kH264) {
                 pC->Vstate = M4VSS3GPP_kEditVideoState_DECODE_ENCODE;
                 pC->bEncodeTillEoF = M4OSA_TRUE;
             } else if( ( M4VSS3GPP_kEditVideoState_BEGIN_CUT == previousVstate)
@@ -15,6 +15,7 @@
  */
 
 #define LOG_NDEBUG 1
+#include <stdlib.h>
 #include <audio_utils/primitives.h>
 #include <utils/Log.h>
 #include "AudioMixer.h"
@@ -48,15 +49,25 @@ struct VideoEditorResampler : public AudioBufferProvider {
     M4OSA_Int32 outSamplingRate;
     M4OSA_Int32 inSamplingRate;
 
+    // frames mInput and mTmpInBuffer can hold
+    size_t mInputFrames;
+    // what getNextBuffer() hands to the resampler, which may only consume
+    // part of it in one resample() call and the rest in the next one
     int16_t *mTmpInBuffer;
+
+    // 32 bit stereo output of resample(), grown to the largest outFrameCount
+    int32_t *mTmpOutBuffer;
+    size_t mTmpOutFrames;
 };
 
 #define MAX_SAMPLEDURATION_FOR_CONVERTION 40 //ms
 
 status_t VideoEditorResampler::getNextBuffer(AudioBufferProvider::Buffer *pBuffer, int64_t pts) {
 
+    if (pBuffer->frameCount > mInputFrames) {
+        pBuffer->frameCount = mInputFrames;
+    }
     uint32_t dataSize = pBuffer->frameCount * this->nbChannels * sizeof(int16_t);
-    mTmpInBuffer = (int16_t*)malloc(dataSize);
     memcpy(mTmpInBuffer, this->mInput, dataSize);
     pBuffer->raw = (void*)mTmpInBuffer;
 
@@ -65,11 +76,8 @@ status_t VideoEditorResampler::getNextBuffer(AudioBufferProvider::Buffer *pBuffe
 
 void VideoEditorResampler::releaseBuffer(AudioBufferProvider::Buffer *pBuffer) {
 
-    if(pBuffer->raw != NULL) {
-        free(pBuffer->raw);
-        pBuffer->raw = NULL;
-        mTmpInBuffer = NULL;
-    }
+    // mTmpInBuffer is kept for the next getNextBuffer()
+    pBuffer->raw = NULL;
     pBuffer->frameCount = 0;
 }
 
@@ -79,8 +87,11 @@ M4OSA_Context  LVAudioResamplerCreate(M4OSA_Int32 bitDepth, M4OSA_Int32 inChanne
                                      M4OSA_Int32 sampleRate, M4OSA_Int32 quality) {
 
     VideoEditorResampler *context = new VideoEditorResampler();
+    // The polyphase sinc resampler is the one AudioFlinger uses for its best
+    // quality, its filters are computed once per sample rate ratio.
     context->mResampler = AudioResampler::create(
-        bitDepth, inChannelCount, sampleRate, AudioResampler::DEFAULT);
+        bitDepth, inChannelCount, sampleRate,
+        AudioResampler::HIGH_POLYPHASE_QUALITY);
     if (context->mResampler == NULL) {
         return NULL;
     }
@@ -89,7 +100,10 @@ M4OSA_Context  LVAudioResamplerCreate(M4OSA_Int32 bitDepth, M4OSA_Int32 inChanne
     context->nbChannels = inChannelCount;
     context->outSamplingRate = sampleRate;
     context->mInput = NULL;
+    context->mInputFrames = 0;
     context->mTmpInBuffer = NULL;
+    context->mTmpOutBuffer = NULL;
+    context->mTmpOutFrames = 0;
 
     return ((M4OSA_Context )context);
 }
@@ -106,8 +120,13 @@ void LVAudiosetSampleRate(M4OSA_Context resamplerContext, M4OSA_Int32 inSampleRa
      */
     context->inSamplingRate = inSampleRate;
     // Allocate buffer for maximum allowed number of samples.
-    context->mInput = (int16_t*)malloc( (inSampleRate * MAX_SAMPLEDURATION_FOR_CONVERTION *
-                                   context->nbChannels * sizeof(int16_t)) / 1000);
+    free(context->mInput);
+    free(context->mTmpInBuffer);
+    context->mInputFrames = (inSampleRate * MAX_SAMPLEDURATION_FOR_CONVERTION) / 1000;
+    context->mInput = (int16_t*)malloc(
+        context->mInputFrames * context->nbChannels * sizeof(int16_t));
+    context->mTmpInBuffer = (int16_t*)malloc(
+        context->mInputFrames * context->nbChannels * sizeof(int16_t));
 }
 
 void LVAudiosetVolume(M4OSA_Context resamplerContext, M4OSA_Int16 left, M4OSA_Int16 right) {
@@ -132,6 +151,11 @@ void LVDestroy(M4OSA_Context resamplerContext) {
         context->mInput = NULL;
     }
 
+    if (context->mTmpOutBuffer != NULL) {
+        free(context->mTmpOutBuffer);
+        context->mTmpOutBuffer = NULL;
+    }
+
     if (context->mResampler != NULL) {
         delete context->mResampler;
         context->mResampler = NULL;
@@ -148,23 +172,33 @@ void LVAudioresample_LowQuality(M4OSA_Int16* out, M4OSA_Int16* input,
 
     VideoEditorResampler *context =
       (VideoEditorResampler *)resamplerContext;
-    int32_t *pTmpBuffer = NULL;
 
     context->nbSamples = (context->inSamplingRate * outFrameCount) / context->outSamplingRate;
+    if ((size_t)context->nbSamples > context->mInputFrames) {
+        context->nbSamples = context->mInputFrames;
+    }
     memcpy(context->mInput,input,(context->nbSamples * context->nbChannels * sizeof(int16_t)));
 
     /*
      SRC module always gives stereo output, hence 2 for stereo audio
     */
-    pTmpBuffer = (int32_t*)malloc(outFrameCount * 2 * sizeof(int32_t));
-    memset(pTmpBuffer, 0x00, outFrameCount * 2 * sizeof(int32_t));
+    if ((size_t)outFrameCount > context->mTmpOutFrames) {
+        free(context->mTmpOutBuffer);
+        context->mTmpOutBuffer = (int32_t*)malloc(outFrameCount * 2 * sizeof(int32_t));
+        if (context->mTmpOutBuffer == NULL) {
+            ALOGE("LVAudioresample_LowQuality: cannot allocate %d frames", outFrameCount);
+            context->mTmpOutFrames = 0;
+            memset(out, 0, outFrameCount * 2 * sizeof(int16_t));
+            return;
+        }
+        context->mTmpOutFrames = outFrameCount;
+    }
+    memset(context->mTmpOutBuffer, 0x00, outFrameCount * 2 * sizeof(int32_t));
 
-    context->mResampler->resample((int32_t *)pTmpBuffer,
+    context->mResampler->resample(context->mTmpOutBuffer,
        (size_t)outFrameCount, (VideoEditorResampler *)resamplerContext);
     // Convert back to 16 bits
-    ditherAndClamp((int32_t*)out, pTmpBuffer, outFrameCount);
-    free(pTmpBuffer);
-    pTmpBuffer = NULL;
+    ditherAndClamp((int32_t*)out, context->mTmpOutBuffer, outFrameCount);
 }
 
 }
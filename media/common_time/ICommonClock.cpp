@@ -38,6 +38,7 @@ enum {
     GET_MASTER_ADDRESS,
     REGISTER_LISTENER,
     UNREGISTER_LISTENER,
+    GET_SHARED_TRANSFORM,
 };
 
 const String16 ICommonClock::kServiceName("common_time.clock");
@@ -229,6 +230,23 @@ class BpCommonClock : public BpInterface<ICommonClock>
 
         return status;
     }
+
+    virtual status_t getSharedTransform(sp<IMemory>* mem) {
+        Parcel data, reply;
+        data.writeInterfaceToken(ICommonClock::getInterfaceDescriptor());
+        status_t status = remote()->transact(GET_SHARED_TRANSFORM, data,
+                                             &reply);
+        if (status == OK) {
+            status = reply.readInt32();
+            if (status == OK) {
+                *mem = interface_cast<IMemory>(reply.readStrongBinder());
+                if (*mem == NULL) {
+                    status = UNKNOWN_ERROR;
+                }
+            }
+        }
+        return status;
+    }
 };
 
 IMPLEMENT_META_INTERFACE(CommonClock, "android.os.ICommonClock");
@@ -387,6 +405,20 @@ status_t BnCommonClock::onTransact(uint32_t code,
             reply->writeInt32(status);
             return OK;
         } break;
+
+        case GET_SHARED_TRANSFORM: {
+            CHECK_INTERFACE(ICommonClock, data, reply);
+            sp<IMemory> mem;
+            status_t status = getSharedTransform(&mem);
+            if ((status == OK) && (mem == NULL)) {
+                status = UNKNOWN_ERROR;
+            }
+            reply->writeInt32(status);
+            if (status == OK) {
+                reply->writeStrongBinder(mem->asBinder());
+            }
+            return OK;
+        } break;
     }
     return BBinder::onTransact(code, data, reply, flags);
 }
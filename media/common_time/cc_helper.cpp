@@ -18,6 +18,8 @@
 
 #include <common_time/cc_helper.h>
 #include <common_time/ICommonClock.h>
+#include <cutils/atomic.h>
+#include <utils/Log.h>
 #include <utils/threads.h>
 
 namespace android {
@@ -25,7 +27,10 @@ namespace android {
 Mutex CCHelper::lock_;
 sp<ICommonClock> CCHelper::common_clock_;
 sp<ICommonClockListener> CCHelper::common_clock_listener_;
+sp<IBinder::DeathRecipient> CCHelper::death_recipient_;
 uint32_t CCHelper::ref_count_ = 0;
+const ICommonClock::SharedTransform* volatile CCHelper::shared_transform_;
+Vector<sp<IMemory> > CCHelper::shared_transform_mem_;
 
 bool CCHelper::verifyClock_l() {
     bool ret = false;
@@ -34,6 +39,11 @@ bool CCHelper::verifyClock_l() {
         common_clock_ = ICommonClock::getInstance();
         if (common_clock_ == NULL)
             goto bailout;
+
+        if (death_recipient_ == NULL)
+            death_recipient_ = new CommonClockDeathRecipient();
+        common_clock_->asBinder()->linkToDeath(death_recipient_);
+        mapSharedTransform_l();
     }
 
     if (ref_count_ > 0) {
@@ -51,12 +61,60 @@ bool CCHelper::verifyClock_l() {
 
 bailout:
     if (!ret) {
+        shared_transform_ = NULL;
         common_clock_listener_ = NULL;
         common_clock_ = NULL;
     }
     return ret;
 }
 
+void CCHelper::mapSharedTransform_l() {
+    shared_transform_ = NULL;
+
+    sp<IMemory> mem;
+    if (OK != common_clock_->getSharedTransform(&mem))
+        return;
+
+    if ((mem->pointer() == NULL) ||
+        (mem->size() < sizeof(ICommonClock::SharedTransform))) {
+        ALOGW("ignoring a shared transform of %d bytes", mem->size());
+        return;
+    }
+
+    shared_transform_mem_.push(mem);
+    android_memory_barrier();
+    shared_transform_ =
+        static_cast<const ICommonClock::SharedTransform*>(mem->pointer());
+}
+
+bool CCHelper::readSharedTransform(LinearTransform* xform) {
+    const ICommonClock::SharedTransform* shared = shared_transform_;
+    if (shared == NULL)
+        return false;
+    android_memory_barrier();
+
+    for (int i = 0; i < kMaxSharedTransformReads; ++i) {
+        int32_t seq = shared->seq;
+        if (seq & 1)
+            continue;
+        android_memory_barrier();
+
+        bool valid = shared->valid &&
+                     (shared->timelineID != ICommonClock::kInvalidTimelineID);
+        xform->a_zero = shared->localZero;
+        xform->b_zero = shared->commonZero;
+        xform->a_to_b_numer = shared->localToCommonNumer;
+        xform->a_to_b_denom = shared->localToCommonDenom;
+
+        android_memory_barrier();
+        if (shared->seq == seq)
+            return valid && (xform->a_to_b_numer != 0) &&
+                   (xform->a_to_b_denom != 0);
+    }
+
+    return false;
+}
+
 CCHelper::CCHelper() {
     Mutex::Autolock lock(&lock_);
     ref_count_++;
@@ -85,6 +143,38 @@ void CCHelper::CommonClockListener::onTimelineChanged(uint64_t timelineID) {
     // find out when clients die.
 }
 
+void CCHelper::CommonClockDeathRecipient::binderDied(const wp<IBinder>& who) {
+    // Stop trusting the dead service's transform right away, and forget the
+    // service so that the next call reconnects and registers a new listener.
+    Mutex::Autolock lock(&lock_);
+    if ((common_clock_ == NULL) || (common_clock_->asBinder() != who.promote()))
+        return;
+
+    shared_transform_ = NULL;
+    common_clock_listener_ = NULL;
+    common_clock_ = NULL;
+}
+
+status_t CCHelper::commonTimeToLocalTime(int64_t commonTime,
+                                         int64_t* localTime) {
+    LinearTransform xform;
+    if (readSharedTransform(&xform) &&
+        xform.doReverseTransform(commonTime, localTime))
+        return OK;
+
+    return commonTimeToLocalTimeIPC(commonTime, localTime);
+}
+
+status_t CCHelper::localTimeToCommonTime(int64_t localTime,
+                                         int64_t* commonTime) {
+    LinearTransform xform;
+    if (readSharedTransform(&xform) &&
+        xform.doForwardTransform(localTime, commonTime))
+        return OK;
+
+    return localTimeToCommonTimeIPC(localTime, commonTime);
+}
+
 // Helper methods which attempts to make calls to the common time binder
 // service.  If the first attempt fails with DEAD_OBJECT, the helpers will
 // attempt to make a connection to the service again (assuming that the process
@@ -113,9 +203,11 @@ void CCHelper::CommonClockListener::onTimelineChanged(uint64_t timelineID) {
 
 CCHELPER_METHOD(isCommonTimeValid(bool* valid, uint32_t* timelineID),
                 isCommonTimeValid(valid, timelineID))
-CCHELPER_METHOD(commonTimeToLocalTime(int64_t commonTime, int64_t* localTime),
+CCHELPER_METHOD(commonTimeToLocalTimeIPC(int64_t commonTime,
+                                        int64_t* localTime),
                 commonTimeToLocalTime(commonTime, localTime))
-CCHELPER_METHOD(localTimeToCommonTime(int64_t localTime, int64_t* commonTime),
+CCHELPER_METHOD(localTimeToCommonTimeIPC(int64_t localTime,
+                                        int64_t* commonTime),
                 localTimeToCommonTime(localTime, commonTime))
 CCHELPER_METHOD(getCommonTime(int64_t* commonTime),
                 getCommonTime(commonTime))
@@ -23,17 +23,22 @@ LOCAL_C_INCLUDES := \
     frameworks/av/include \
     frameworks/av/media \
     frameworks/av/media/libstagefright \
+    frameworks/av/services/audioflinger \
     frameworks/native/include/media/openmax
 
 LOCAL_SHARED_LIBRARIES := \
     libcommon_time_client \
     libbinder \
+    libcutils \
     libmedia \
     libmedia_native \
     libstagefright \
     libstagefright_foundation \
     libutils
 
+LOCAL_STATIC_LIBRARIES := \
+    libscheduling_policy
+
 LOCAL_LDLIBS := \
     -lpthread
 
@@ -43,6 +43,9 @@ AAH_RXPlayer::AAH_RXPlayer()
     current_epoch_known_ = false;
     data_source_set_     = false;
     sock_fd_             = -1;
+    rx_batch_buf_        = NULL;
+    rx_wakeups_          = 0;
+    rx_packets_          = 0;
 
     substreams_.setCapacity(4);
 
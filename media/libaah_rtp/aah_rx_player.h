@@ -100,21 +100,32 @@ class AAH_RXPlayer : public MediaPlayerInterface {
     // allocator is replaced with a different implementation (private heap,
     // free-list, circular buffer, etc) which reduces potential heap
     // fragmentation issues which might arise from the frequent allocation and
-    // destruction of the received UDP traffic.
+    // destruction of the received UDP traffic.  Buffers for typical sized
+    // datagrams are recycled through a process wide free list (see
+    // reservePool).
     struct PacketBuffer {
         ssize_t length_;
         uint8_t data_[1];
 
-        // TODO : consider changing this to be some form of ring buffer or free
-        // pool system instead of just using the heap in order to avoid heap
-        // fragmentation.
         static PacketBuffer* allocate(ssize_t length);
         static void destroy(PacketBuffer* pb);
 
+        // Grow the free list to hold up to count buffers and fill it.
+        static void reservePool(uint32_t count);
+
+        // Number of allocations which found the free list empty.
+        static uint32_t poolMisses();
+
       private:
         // Force people to use allocate/destroy instead of new/delete.
         PacketBuffer() { }
         ~PacketBuffer() { }
+
+        static Mutex         pool_lock_;
+        static PacketBuffer* pool_free_;
+        static uint32_t      pool_free_count_;
+        static uint32_t      pool_capacity_;
+        static uint32_t      pool_misses_;
     };
 
     struct RetransRequest {
@@ -124,6 +135,18 @@ class AAH_RXPlayer : public MediaPlayerInterface {
         uint16_t start_seq_;
         uint16_t end_seq_;
     };
+
+    // Forward error correction packet header.  The payload which follows is
+    // the XOR of count_ packets starting at start_seq_, each zero padded to
+    // the length of the longest.
+    struct FECHeader {
+        uint32_t magic_;
+        uint32_t epoch_;
+        uint16_t start_seq_;
+        uint16_t length_xor_;
+        uint8_t  count_;
+        uint8_t  reserved_;
+    };
 #pragma pack(pop)
 
     enum GapStatus {
@@ -175,12 +198,34 @@ class AAH_RXPlayer : public MediaPlayerInterface {
         // next successful read from fetch buffer will indicate a discontinuity.
         void processNAK(const SeqNoGap* nak = NULL);
 
+        // Hand a buffer returned by fetchBuffer back to the ring once the
+        // caller is done with it.  Once the transmitter has been seen sending
+        // FEC packets, the most recent buffers are kept around to take part in
+        // repairs; otherwise the buffer is simply destroyed.
+        void retireBuffer(PacketBuffer* buf);
+
+        // Use an FEC packet to rebuild the one missing member of its group,
+        // if exactly one is missing.  Returns false under the same conditions
+        // as pushBuffer.
+        bool processFEC(const uint8_t* data, ssize_t amt);
+
+        // Returns true if FEC is in use and the FEC packet which could repair
+        // the end of gap has not shown up yet.
+        bool isAwaitingFEC(const SeqNoGap& gap);
+
         // Compute the number of milliseconds until the inactivity timer for
         // this RTP stream.  Returns -1 if there is no active timeout, or 0 if
         // the system has already timed out.
         int computeInactivityTimeout();
 
+        // Number of recently fetched buffers kept for FEC repairs; senders
+        // never put more than this many packets in one FEC group.
+        static const uint32_t kFECHistorySize = 64;
+
       private:
+        bool pushBuffer_l(PacketBuffer* buf, uint16_t seq);
+        PacketBuffer* findFECMember_l(uint16_t seq, uint16_t norm_wr_seq);
+
         Mutex          lock_;
         PacketBuffer** ring_;
         uint32_t       capacity_;
@@ -195,6 +240,10 @@ class AAH_RXPlayer : public MediaPlayerInterface {
         uint64_t       rtp_activity_timeout_;
         bool           rtp_activity_timeout_valid_;
 
+        PacketBuffer*  fec_history_[kFECHistorySize];
+        bool           fec_active_;
+        uint16_t       fec_end_seq_;
+
         DISALLOW_EVIL_CONSTRUCTORS(RXRingBuffer);
     };
 
@@ -262,6 +311,9 @@ class AAH_RXPlayer : public MediaPlayerInterface {
     void                cleanupSocket();
     void                resetPipeline();
     void                reset_l();
+    int                 receivePackets(PacketBuffer** pbs,
+                                       struct sockaddr_in* froms,
+                                       int max_packets);
     bool                processRX(PacketBuffer* pb);
     void                processRingBuffer();
     void                processCommandPacket(PacketBuffer* pb);
@@ -279,6 +331,12 @@ class AAH_RXPlayer : public MediaPlayerInterface {
     int                 sock_fd_;
     bool                multicast_joined_;
 
+    // Space for a batch of datagrams read with one recvmmsg call.  NULL if
+    // the kernel doesn't support recvmmsg.
+    uint8_t*            rx_batch_buf_;
+    uint32_t            rx_wakeups_;
+    uint32_t            rx_packets_;
+
     struct sockaddr_in  transmitter_addr_;
     bool                transmitter_known_;
 
@@ -288,6 +346,8 @@ class AAH_RXPlayer : public MediaPlayerInterface {
     SeqNoGap            current_gap_;
     GapStatus           current_gap_status_;
     uint64_t            next_retrans_req_time_;
+    bool                fec_hold_active_;
+    uint64_t            fec_hold_deadline_;
 
     RXRingBuffer        ring_buffer_;
     SubstreamVec        substreams_;
@@ -298,9 +358,13 @@ class AAH_RXPlayer : public MediaPlayerInterface {
     sp<IAudioFlinger>   audio_flinger_;
 
     static const uint32_t kRTPRingBufferSize;
+    static const int      kRXBatchSize;
+    static const size_t   kMaxUDPPacketLen;
     static const uint32_t kRetransRequestMagic;
     static const uint32_t kFastStartRequestMagic;
     static const uint32_t kRetransNAKMagic;
+    static const uint32_t kFECMagic;
+    static const uint32_t kFECRepairTimeoutUSec;
     static const uint32_t kGapRerequestTimeoutUSec;
     static const uint32_t kFastStartTimeoutUSec;
     static const uint32_t kRTPActivityTimeoutUSec;
@@ -20,26 +20,46 @@
 
 #include <fcntl.h>
 #include <poll.h>
+#include <stdlib.h>
 #include <sys/socket.h>
+#include <sys/syscall.h>
 #include <time.h>
+#include <unistd.h>
 #include <utils/misc.h>
 
 #include <media/stagefright/Utils.h>
 
 #include "aah_rx_player.h"
 #include "aah_tx_packet.h"
+#include "SchedulingPolicyService.h"
 
 namespace android {
 
+// Share of a CPU the work thread may use at SCHED_FIFO before it is demoted.
+static const int32_t kWorkThreadCpuBudgetPercent = 30;
+
 const uint32_t AAH_RXPlayer::kRetransRequestMagic =
     FOURCC('T','r','e','q');
 const uint32_t AAH_RXPlayer::kRetransNAKMagic =
     FOURCC('T','n','a','k');
 const uint32_t AAH_RXPlayer::kFastStartRequestMagic =
     FOURCC('T','f','s','t');
+const uint32_t AAH_RXPlayer::kFECMagic =
+    FOURCC('T','f','e','c');
 const uint32_t AAH_RXPlayer::kGapRerequestTimeoutUSec = 75000;
 const uint32_t AAH_RXPlayer::kFastStartTimeoutUSec = 800000;
+const uint32_t AAH_RXPlayer::kFECRepairTimeoutUSec = 100000;
 const uint32_t AAH_RXPlayer::kRTPActivityTimeoutUSec = 10000000;
+const int      AAH_RXPlayer::kRXBatchSize = 8;
+const size_t   AAH_RXPlayer::kMaxUDPPacketLen = 1 << 16;
+
+#ifdef __NR_recvmmsg
+// Matches the kernel's struct mmsghdr, which the C library doesn't declare.
+struct rx_mmsghdr {
+    struct msghdr msg_hdr;
+    unsigned int  msg_len;
+};
+#endif
 
 static inline int16_t fetchInt16(uint8_t* data) {
     return static_cast<int16_t>(U16_AT(data));
@@ -71,6 +91,18 @@ status_t AAH_RXPlayer::startWorkThread() {
 
     if (res != OK) {
         ALOGE("Failed to start work thread (res = %d)", res);
+        return res;
+    }
+
+    // Packets are timestamped and retransmissions requested on this thread,
+    // so it benefits from deterministic scheduling; the budget keeps a
+    // packet storm from starving the rest of the system.
+    pid_t tid = thread_wrapper_->getTid();
+    int err = requestPriorityWithBudget(getpid(), tid, 1,
+                                        kWorkThreadCpuBudgetPercent);
+    if (err != 0) {
+        ALOGW("SCHED_FIFO is unavailable for work thread tid %d (err = %d)",
+              tid, err);
     }
 
     return res;
@@ -108,8 +140,14 @@ void AAH_RXPlayer::cleanupSocket() {
 
         close(sock_fd_);
         sock_fd_ = -1;
+
+        ALOGI("RX stats: %u packets in %u wakeups, %u packet pool misses",
+              rx_packets_, rx_wakeups_, PacketBuffer::poolMisses());
     }
 
+    free(rx_batch_buf_);
+    rx_batch_buf_ = NULL;
+
     resetPipeline();
 }
 
@@ -126,6 +164,7 @@ void AAH_RXPlayer::resetPipeline() {
     substreams_.clear();
 
     current_gap_status_ = kGS_NoGap;
+    fec_hold_active_ = false;
 }
 
 bool AAH_RXPlayer::setupSocket() {
@@ -212,6 +251,19 @@ bool AAH_RXPlayer::setupSocket() {
         multicast_joined_ = true;
     }
 
+#ifdef __NR_recvmmsg
+    // If this fails, we just fall back on reading one datagram at a time.
+    rx_batch_buf_ = static_cast<uint8_t*>(
+            malloc(kRXBatchSize * kMaxUDPPacketLen));
+#endif
+    rx_wakeups_ = 0;
+    rx_packets_ = 0;
+
+    // Keep enough packet buffers around to fill the ring without going back
+    // to the heap.
+    PacketBuffer::reservePool(kRTPRingBufferSize +
+                              RXRingBuffer::kFECHistorySize);
+
     return true;
 
 bailout:
@@ -280,90 +332,68 @@ bool AAH_RXPlayer::threadLoop() {
         // socket moving valid RTP information into the ring buffer to be
         // processed.
         if (poll_fds[1].revents) {
-            struct sockaddr_in from;
-            socklen_t from_len;
+            PacketBuffer* pbs[kRXBatchSize];
+            struct sockaddr_in froms[kRXBatchSize];
 
-            ssize_t res = 0;
+            ++rx_wakeups_;
             while (!thread_wrapper_->exitPending()) {
-                // Check the size of any pending packet.
-                res = recv(sock_fd_, NULL, 0, MSG_PEEK | MSG_TRUNC);
-
-                // Error?
-                if (res < 0) {
-                    // If the error is anything other than would block,
-                    // something has gone very wrong.
-                    if ((errno != EAGAIN) && (errno != EWOULDBLOCK)) {
-                        ALOGE("Fatal socket error during recvfrom (%d, %d)",
-                              (int)res, errno);
-                        goto bailout;
-                    }
-
-                    // Socket is out of data, just break out of processing and
-                    // wait for more.
-                    break;
-                }
-
-                // Allocate a payload.
-                PacketBuffer* pb = PacketBuffer::allocate(res);
-                if (NULL == pb) {
-                    ALOGE("Fatal error, failed to allocate packet buffer of"
-                          " length %u", static_cast<uint32_t>(res));
+                int count = receivePackets(pbs, froms, kRXBatchSize);
+                if (count < 0) {
                     goto bailout;
                 }
 
-                // Fetch the data.
-                from_len = sizeof(from);
-                res = recvfrom(sock_fd_, pb->data_, pb->length_, 0,
-                               reinterpret_cast<struct sockaddr*>(&from),
-                               &from_len);
-                if (res != pb->length_) {
-                    ALOGE("Fatal error, fetched packet length (%d) does not"
-                          " match peeked packet length (%u).  This should never"
-                          " happen.  (errno = %d)",
-                          static_cast<int>(res),
-                          static_cast<uint32_t>(pb->length_),
-                          errno);
+                // Socket is out of data, just break out of processing and
+                // wait for more.
+                if (!count) {
+                    break;
                 }
 
-                bool drop_packet = false;
-                if (transmitter_known_) {
-                    if (from.sin_addr.s_addr !=
-                        transmitter_addr_.sin_addr.s_addr) {
-                        uint32_t a = ntohl(from.sin_addr.s_addr);
-                        uint16_t p = ntohs(from.sin_port);
-                        ALOGV("Dropping packet from unknown transmitter"
-                              " %u.%u.%u.%u:%hu",
-                              ((a >> 24) & 0xFF),
-                              ((a >> 16) & 0xFF),
-                              ((a >>  8) & 0xFF),
-                              ( a        & 0xFF),
-                              p);
-
-                        drop_packet = true;
+                rx_packets_ += count;
+                for (int i = 0; i < count; ++i) {
+                    struct sockaddr_in& from = froms[i];
+                    PacketBuffer* pb = pbs[i];
+
+                    bool drop_packet = false;
+                    if (transmitter_known_) {
+                        if (from.sin_addr.s_addr !=
+                            transmitter_addr_.sin_addr.s_addr) {
+                            uint32_t a = ntohl(from.sin_addr.s_addr);
+                            uint16_t p = ntohs(from.sin_port);
+                            ALOGV("Dropping packet from unknown transmitter"
+                                  " %u.%u.%u.%u:%hu",
+                                  ((a >> 24) & 0xFF),
+                                  ((a >> 16) & 0xFF),
+                                  ((a >>  8) & 0xFF),
+                                  ( a        & 0xFF),
+                                  p);
+
+                            drop_packet = true;
+                        } else {
+                            transmitter_addr_.sin_port = from.sin_port;
+                        }
                     } else {
-                        transmitter_addr_.sin_port = from.sin_port;
+                        memcpy(&transmitter_addr_, &from, sizeof(from));
+                        transmitter_known_ = true;
                     }
-                } else {
-                    memcpy(&transmitter_addr_, &from, sizeof(from));
-                    transmitter_known_ = true;
-                }
 
-                if (!drop_packet) {
-                    bool serious_error = !processRX(pb);
-
-                    if (serious_error) {
-                        // Something went "seriously wrong".  Currently, the
-                        // only trigger for this should be a ring buffer
-                        // overflow.  The current failsafe behavior for when
-                        // something goes seriously wrong is to just reset the
-                        // pipeline.  The system should behave as if this
-                        // AAH_RXPlayer was just set up for the first time.
-                        ALOGE("Something just went seriously wrong with the"
-                              " pipeline.  Resetting.");
-                        resetPipeline();
+                    if (!drop_packet) {
+                        bool serious_error = !processRX(pb);
+
+                        if (serious_error) {
+                            // Something went "seriously wrong".  Currently,
+                            // the only trigger for this should be a ring
+                            // buffer overflow.  The current failsafe behavior
+                            // for when something goes seriously wrong is to
+                            // just reset the pipeline.  The system should
+                            // behave as if this AAH_RXPlayer was just set up
+                            // for the first time.
+                            ALOGE("Something just went seriously wrong with"
+                                  " the pipeline.  Resetting.");
+                            resetPipeline();
+                        }
+                    } else {
+                        PacketBuffer::destroy(pb);
                     }
-                } else {
-                    PacketBuffer::destroy(pb);
                 }
             }
         }
@@ -407,6 +437,126 @@ bailout:
     return false;
 }
 
+// Fetch up to max_packets datagrams from the socket.  Returns the number of
+// packets fetched (0 if the socket has run dry), or -1 on a fatal error.
+int AAH_RXPlayer::receivePackets(PacketBuffer** pbs,
+                                 struct sockaddr_in* froms,
+                                 int max_packets) {
+#ifdef __NR_recvmmsg
+    if (NULL != rx_batch_buf_) {
+        struct rx_mmsghdr msgs[kRXBatchSize];
+        struct iovec iovs[kRXBatchSize];
+
+        if (max_packets > kRXBatchSize) {
+            max_packets = kRXBatchSize;
+        }
+
+        memset(msgs, 0, sizeof(msgs));
+        for (int i = 0; i < max_packets; ++i) {
+            iovs[i].iov_base = rx_batch_buf_ + (i * kMaxUDPPacketLen);
+            iovs[i].iov_len  = kMaxUDPPacketLen;
+            msgs[i].msg_hdr.msg_name    = &froms[i];
+            msgs[i].msg_hdr.msg_namelen = sizeof(froms[i]);
+            msgs[i].msg_hdr.msg_iov     = &iovs[i];
+            msgs[i].msg_hdr.msg_iovlen  = 1;
+        }
+
+        int res = syscall(__NR_recvmmsg, sock_fd_, msgs, max_packets,
+                          MSG_DONTWAIT, NULL);
+        if (res < 0) {
+            if ((errno == EAGAIN) || (errno == EWOULDBLOCK)) {
+                return 0;
+            }
+
+            if (errno != ENOSYS) {
+                ALOGE("Fatal socket error during recvmmsg (%d, %d)",
+                      res, errno);
+                return -1;
+            }
+
+            ALOGI("recvmmsg is not supported, reading one packet at a time");
+            free(rx_batch_buf_);
+            rx_batch_buf_ = NULL;
+        } else {
+            // Copy the datagrams out of the batch buffer so the pool only
+            // needs to hold buffers sized for the packets actually received.
+            int count = 0;
+            for (int i = 0; i < res; ++i) {
+                ssize_t len = msgs[i].msg_len;
+                if (!len) {
+                    continue;
+                }
+
+                PacketBuffer* pb = PacketBuffer::allocate(len);
+                if (NULL == pb) {
+                    ALOGE("Fatal error, failed to allocate packet buffer of"
+                          " length %u", static_cast<uint32_t>(len));
+                    while (count > 0) {
+                        PacketBuffer::destroy(pbs[--count]);
+                    }
+                    return -1;
+                }
+
+                memcpy(pb->data_, iovs[i].iov_base, len);
+                if (count != i) {
+                    froms[count] = froms[i];
+                }
+                pbs[count++] = pb;
+            }
+
+            // A batch made up entirely of empty datagrams is not the same
+            // thing as the socket running dry; try again.
+            if (!count && (res > 0)) {
+                return receivePackets(pbs, froms, max_packets);
+            }
+
+            return count;
+        }
+    }
+#endif
+
+    // Check the size of any pending packet.
+    ssize_t res = recv(sock_fd_, NULL, 0, MSG_PEEK | MSG_TRUNC);
+
+    // Error?
+    if (res < 0) {
+        // If the error is anything other than would block, something has gone
+        // very wrong.
+        if ((errno != EAGAIN) && (errno != EWOULDBLOCK)) {
+            ALOGE("Fatal socket error during recvfrom (%d, %d)",
+                  (int)res, errno);
+            return -1;
+        }
+
+        return 0;
+    }
+
+    // Allocate a payload.
+    PacketBuffer* pb = PacketBuffer::allocate(res);
+    if (NULL == pb) {
+        ALOGE("Fatal error, failed to allocate packet buffer of"
+              " length %u", static_cast<uint32_t>(res));
+        return -1;
+    }
+
+    // Fetch the data.
+    socklen_t from_len = sizeof(froms[0]);
+    res = recvfrom(sock_fd_, pb->data_, pb->length_, 0,
+                   reinterpret_cast<struct sockaddr*>(&froms[0]),
+                   &from_len);
+    if (res != pb->length_) {
+        ALOGE("Fatal error, fetched packet length (%d) does not"
+              " match peeked packet length (%u).  This should never"
+              " happen.  (errno = %d)",
+              static_cast<int>(res),
+              static_cast<uint32_t>(pb->length_),
+              errno);
+    }
+
+    pbs[0] = pb;
+    return 1;
+}
+
 bool AAH_RXPlayer::processRX(PacketBuffer* pb) {
     CHECK(NULL != pb);
 
@@ -448,6 +598,27 @@ bool AAH_RXPlayer::processRX(PacketBuffer* pb) {
         return true;
     }
 
+    // FEC packets don't carry a TRTP sequence number; give them straight to
+    // the ring buffer to repair any single loss in the group they cover.
+    if (nak_magic == kFECMagic) {
+        if (amt < static_cast<ssize_t>(sizeof(FECHeader))) {
+            ALOGV("Dropping packet, too short to contain FEC header"
+                  " (%u bytes)", static_cast<uint32_t>(amt));
+            goto drop_packet;
+        }
+
+        FECHeader* fec = reinterpret_cast<FECHeader*>(data);
+        epoch = ntohl(fec->epoch_) & 0x3FFFFF;
+        if (!current_epoch_known_ || (epoch != current_epoch_)) {
+            ALOGV("Dropping FEC packet from epoch %u", epoch);
+            goto drop_packet;
+        }
+
+        bool ret = ring_buffer_.processFEC(data, amt);
+        PacketBuffer::destroy(pb);
+        return ret;
+    }
+
     // According to the TRTP spec, version should be 2, padding should be 0,
     // extension should be 0 and CSRCCnt should be 0.  If any of these tests
     // fail, we chuck the packet.
@@ -604,7 +775,7 @@ void AAH_RXPlayer::processRingBuffer() {
         }
 
 process_next_packet:
-        PacketBuffer::destroy(pb);
+        ring_buffer_.retireBuffer(pb);
     }  // end of main processing while loop.
 }
 
@@ -717,6 +888,7 @@ bool AAH_RXPlayer::processGaps() {
                               gap.start_seq_, gap.end_seq_);
                         ring_buffer_.processNAK();
                         current_gap_status_ = kGS_NoGap;
+                        fec_hold_active_ = false;
                         return true;
                     }
                 }
@@ -728,9 +900,28 @@ bool AAH_RXPlayer::processGaps() {
         }
     } else {
         current_gap_status_ = kGS_NoGap;
+        fec_hold_active_ = false;
     }
 
     if (send_retransmit_request) {
+        // If the transmitter is sending FEC and the FEC packet covering this
+        // gap has not arrived yet, give it a chance to repair the gap before
+        // paying a round trip for a retransmission.
+        if ((kGS_NormalGap == gap_status) && ring_buffer_.isAwaitingFEC(gap)) {
+            uint64_t now = monotonicUSecNow();
+            if (!fec_hold_active_) {
+                fec_hold_active_ = true;
+                fec_hold_deadline_ = now + kFECRepairTimeoutUSec;
+            }
+
+            if (now < fec_hold_deadline_) {
+                current_gap_ = gap;
+                current_gap_status_ = gap_status;
+                next_retrans_req_time_ = fec_hold_deadline_;
+                return false;
+            }
+        }
+
         // If we have been working on a fast start, and it is still not filled
         // in, even after the extended retransmit time out, give up and skip it.
         // The system should fall back into its normal slow-start behavior.
@@ -739,6 +930,7 @@ bool AAH_RXPlayer::processGaps() {
             ALOGV("Fast start is taking forever; giving up.");
             ring_buffer_.processNAK();
             current_gap_status_ = kGS_NoGap;
+            fec_hold_active_ = false;
             return true;
         }
 
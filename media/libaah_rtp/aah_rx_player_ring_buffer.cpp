@@ -18,15 +18,24 @@
 //#define LOG_NDEBUG 0
 #include <utils/Log.h>
 
+#include <arpa/inet.h>
+
 #include "aah_rx_player.h"
 
 namespace android {
 
+const uint32_t AAH_RXPlayer::RXRingBuffer::kFECHistorySize;
+
+static inline uint16_t fetchSeqNo(const uint8_t* data) {
+    return (static_cast<uint16_t>(data[2]) << 8) | data[3];
+}
+
 AAH_RXPlayer::RXRingBuffer::RXRingBuffer(uint32_t capacity) {
     capacity_ = capacity;
     rd_ = wr_ = 0;
     ring_ = new PacketBuffer*[capacity];
     memset(ring_, 0, sizeof(PacketBuffer*) * capacity);
+    memset(fec_history_, 0, sizeof(fec_history_));
     reset();
 }
 
@@ -49,8 +58,16 @@ void AAH_RXPlayer::RXRingBuffer::reset() {
         }
     }
 
+    for (uint32_t i = 0; i < kFECHistorySize; ++i) {
+        if (NULL != fec_history_[i]) {
+            PacketBuffer::destroy(fec_history_[i]);
+            fec_history_[i] = NULL;
+        }
+    }
+
     rd_ = wr_ = 0;
     rd_seq_known_ = false;
+    fec_active_ = false;
     waiting_for_fast_start_ = true;
     fetched_first_packet_ = false;
     rtp_activity_timeout_valid_ = false;
@@ -59,6 +76,11 @@ void AAH_RXPlayer::RXRingBuffer::reset() {
 bool AAH_RXPlayer::RXRingBuffer::pushBuffer(PacketBuffer* buf,
                                                 uint16_t seq) {
     AutoMutex lock(&lock_);
+    return pushBuffer_l(buf, seq);
+}
+
+bool AAH_RXPlayer::RXRingBuffer::pushBuffer_l(PacketBuffer* buf,
+                                              uint16_t seq) {
     CHECK(NULL != ring_);
     CHECK(NULL != buf);
 
@@ -326,6 +348,158 @@ void AAH_RXPlayer::RXRingBuffer::processNAK(const SeqNoGap* nak) {
     fetched_first_packet_ = false;
 }
 
+void AAH_RXPlayer::RXRingBuffer::retireBuffer(PacketBuffer* buf) {
+    AutoMutex lock(&lock_);
+    CHECK(NULL != buf);
+
+    // Only TRTP packets (at least 12 bytes long) ever make it into the ring.
+    if (!fec_active_ || (buf->length_ < 12)) {
+        PacketBuffer::destroy(buf);
+        return;
+    }
+
+    uint32_t slot = fetchSeqNo(buf->data_) % kFECHistorySize;
+    if (NULL != fec_history_[slot]) {
+        PacketBuffer::destroy(fec_history_[slot]);
+    }
+    fec_history_[slot] = buf;
+}
+
+// Find the packet with the given sequence number, either still waiting in
+// the ring or already fetched and sitting in the FEC history.  Returns NULL if
+// we don't have it.
+AAH_RXPlayer::PacketBuffer*
+AAH_RXPlayer::RXRingBuffer::findFECMember_l(uint16_t seq,
+                                            uint16_t norm_wr_seq) {
+    uint16_t norm_seq = seq - rd_seq_;
+
+    if (!(norm_seq & 0x8000)) {
+        if (norm_seq >= norm_wr_seq) {
+            return NULL;
+        }
+        return ring_[(rd_ + norm_seq) % capacity_];
+    }
+
+    PacketBuffer* pb = fec_history_[seq % kFECHistorySize];
+    if ((NULL != pb) && (fetchSeqNo(pb->data_) == seq)) {
+        return pb;
+    }
+
+    return NULL;
+}
+
+bool AAH_RXPlayer::RXRingBuffer::processFEC(const uint8_t* data,
+                                            ssize_t amt) {
+    AutoMutex lock(&lock_);
+    CHECK(NULL != ring_);
+    CHECK(amt >= static_cast<ssize_t>(sizeof(FECHeader)));
+
+    const FECHeader* hdr = reinterpret_cast<const FECHeader*>(data);
+    uint16_t start_seq  = ntohs(hdr->start_seq_);
+    uint16_t length_xor = ntohs(hdr->length_xor_);
+    uint32_t count      = hdr->count_;
+    const uint8_t* parity = data + sizeof(FECHeader);
+    ssize_t parity_len  = amt - sizeof(FECHeader);
+
+    if (!count || (count > kFECHistorySize)) {
+        ALOGV("Dropping FEC packet with bad group size %u", count);
+        return true;
+    }
+
+    // From here on, keep fetched packets around so that later groups can be
+    // repaired even if their first few members have already been played.
+    uint16_t end_seq = start_seq + count - 1;
+    if (!fec_active_ ||
+        !(static_cast<uint16_t>(end_seq - fec_end_seq_) & 0x8000)) {
+        fec_end_seq_ = end_seq;
+    }
+    fec_active_ = true;
+
+    if (!rd_seq_known_ || waiting_for_fast_start_) {
+        return true;
+    }
+
+    uint16_t norm_wr_seq = ((wr_ + capacity_ - rd_) % capacity_);
+    PacketBuffer* members[kFECHistorySize];
+    uint32_t found = 0;
+    uint32_t missing = 0;
+    uint16_t missing_seq = 0;
+
+    for (uint32_t i = 0; i < count; ++i) {
+        uint16_t seq = start_seq + i;
+        PacketBuffer* pb = findFECMember_l(seq, norm_wr_seq);
+
+        if (NULL != pb) {
+            members[found++] = pb;
+        } else {
+            missing_seq = seq;
+            if (++missing > 1) {
+                // XOR parity can only rebuild a single packet.
+                return true;
+            }
+        }
+    }
+
+    if (!missing) {
+        return true;
+    }
+
+    // If the read pointer has already moved past the missing packet, it's too
+    // late for it to do any good.  If it's too far ahead, repairing it would
+    // overflow the ring.
+    uint16_t norm_missing = missing_seq - rd_seq_;
+    if ((norm_missing & 0x8000) || (norm_missing >= (capacity_ - 1))) {
+        return true;
+    }
+
+    uint16_t len = length_xor;
+    for (uint32_t i = 0; i < found; ++i) {
+        len ^= static_cast<uint16_t>(members[i]->length_);
+    }
+
+    if ((len < 12) || (len > parity_len)) {
+        ALOGV("Dropping FEC packet; recovered length %hu is bogus", len);
+        return true;
+    }
+
+    PacketBuffer* rec = PacketBuffer::allocate(len);
+    if (NULL == rec) {
+        return true;
+    }
+
+    memcpy(rec->data_, parity, len);
+    for (uint32_t i = 0; i < found; ++i) {
+        ssize_t member_len = (members[i]->length_ < len) ? members[i]->length_
+                                                         : len;
+        const uint8_t* src = members[i]->data_;
+        for (ssize_t j = 0; j < member_len; ++j) {
+            rec->data_[j] ^= src[j];
+        }
+    }
+
+    if (fetchSeqNo(rec->data_) != missing_seq) {
+        ALOGV("Dropping FEC repair of seq %hu; sequence number mismatch",
+              missing_seq);
+        PacketBuffer::destroy(rec);
+        return true;
+    }
+
+    ALOGV("Repaired seq %hu using FEC group [%hu, %hu]",
+          missing_seq, start_seq, end_seq);
+    return pushBuffer_l(rec, missing_seq);
+}
+
+bool AAH_RXPlayer::RXRingBuffer::isAwaitingFEC(const SeqNoGap& gap) {
+    AutoMutex lock(&lock_);
+
+    if (!fec_active_) {
+        return false;
+    }
+
+    uint16_t delta = gap.end_seq_ - fec_end_seq_;
+    return (delta != 0) && !(delta & 0x8000);
+}
+
 int AAH_RXPlayer::RXRingBuffer::computeInactivityTimeout() {
     AutoMutex lock(&lock_);
 
@@ -341,15 +515,43 @@ int AAH_RXPlayer::RXRingBuffer::computeInactivityTimeout() {
     return (rtp_activity_timeout_ - now) / 1000;
 }
 
+// Packet buffers for datagrams of up to kPoolBufferLen bytes all have the same
+// allocation size, so when destroyed they go onto a free list for the next
+// datagram instead of back to the heap.  The free list holds at most
+// pool_capacity_ buffers; larger datagrams always come from the heap.
+static const ssize_t kPoolBufferLen = 2048 - sizeof(ssize_t);
+
+Mutex                      AAH_RXPlayer::PacketBuffer::pool_lock_;
+AAH_RXPlayer::PacketBuffer* AAH_RXPlayer::PacketBuffer::pool_free_ = NULL;
+uint32_t                   AAH_RXPlayer::PacketBuffer::pool_free_count_ = 0;
+uint32_t                   AAH_RXPlayer::PacketBuffer::pool_capacity_ = 0;
+uint32_t                   AAH_RXPlayer::PacketBuffer::pool_misses_ = 0;
+
 AAH_RXPlayer::PacketBuffer*
 AAH_RXPlayer::PacketBuffer::allocate(ssize_t length) {
     if (length <= 0) {
         return NULL;
     }
 
-    uint32_t alloc_len = sizeof(PacketBuffer) + length;
-    PacketBuffer* ret = reinterpret_cast<PacketBuffer*>(
-                        new uint8_t[alloc_len]);
+    PacketBuffer* ret = NULL;
+    ssize_t alloc_payload = length;
+    if (length <= kPoolBufferLen) {
+        AutoMutex lock(&pool_lock_);
+        if (NULL != pool_free_) {
+            // The free list link lives in the data portion of a free buffer.
+            ret = pool_free_;
+            memcpy(&pool_free_, ret->data_, sizeof(pool_free_));
+            --pool_free_count_;
+        } else {
+            ++pool_misses_;
+        }
+        alloc_payload = kPoolBufferLen;
+    }
+
+    if (NULL == ret) {
+        uint32_t alloc_len = sizeof(PacketBuffer) + alloc_payload;
+        ret = reinterpret_cast<PacketBuffer*>(new uint8_t[alloc_len]);
+    }
 
     if (NULL != ret) {
         ret->length_ = length;
@@ -359,8 +561,46 @@ AAH_RXPlayer::PacketBuffer::allocate(ssize_t length) {
 }
 
 void AAH_RXPlayer::PacketBuffer::destroy(PacketBuffer* pb) {
+    if (NULL == pb) {
+        return;
+    }
+
+    if (pb->length_ <= kPoolBufferLen) {
+        AutoMutex lock(&pool_lock_);
+        if (pool_free_count_ < pool_capacity_) {
+            memcpy(pb->data_, &pool_free_, sizeof(pool_free_));
+            pool_free_ = pb;
+            ++pool_free_count_;
+            return;
+        }
+    }
+
     uint8_t* kill_me = reinterpret_cast<uint8_t*>(pb);
     delete[] kill_me;
 }
 
+void AAH_RXPlayer::PacketBuffer::reservePool(uint32_t count) {
+    AutoMutex lock(&pool_lock_);
+    if (count > pool_capacity_) {
+        pool_capacity_ = count;
+    }
+
+    while (pool_free_count_ < pool_capacity_) {
+        uint32_t alloc_len = sizeof(PacketBuffer) + kPoolBufferLen;
+        PacketBuffer* pb = reinterpret_cast<PacketBuffer*>(
+                           new uint8_t[alloc_len]);
+        if (NULL == pb) {
+            break;
+        }
+        memcpy(pb->data_, &pool_free_, sizeof(pool_free_));
+        pool_free_ = pb;
+        ++pool_free_count_;
+    }
+}
+
+uint32_t AAH_RXPlayer::PacketBuffer::poolMisses() {
+    AutoMutex lock(&pool_lock_);
+    return pool_misses_;
+}
+
 }  // namespace android
@@ -19,10 +19,14 @@
 
 #include <netinet/in.h>
 #include <poll.h>
+#include <stdlib.h>
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
 #include <unistd.h>
 
+#include <cutils/properties.h>
 #include <media/stagefright/foundation/AMessage.h>
 #include <utils/misc.h>
 
@@ -39,14 +43,48 @@ const int AAH_TXSender::kRetryTrimIntervalUs = 100000;
 const int AAH_TXSender::kHeartbeatIntervalUs = 1000000;
 const int AAH_TXSender::kRetryBufferCapacity = 100;
 const nsecs_t AAH_TXSender::kHeartbeatTimeout = 600ull * 1000000000ull;
+const int AAH_TXSender::kMaxFECGroupSize = 32;
+const size_t AAH_TXSender::kMaxSendBatch = 32;
+const int AAH_TXSender::kMaxFECPayloadLen = 65507 - sizeof(FECPacket);
+
+// initial 4-byte ID of a forward error correction packet
+const uint32_t AAH_TXSender::kFECPacketID = 'Tfec';
+
+#ifdef __NR_sendmmsg
+// Matches the kernel's struct mmsghdr, which the C library doesn't declare.
+struct tx_mmsghdr {
+    struct msghdr msg_hdr;
+    unsigned int msg_len;
+};
+#endif
 
 Mutex AAH_TXSender::sLock;
 wp<AAH_TXSender> AAH_TXSender::sInstance;
 uint32_t AAH_TXSender::sNextEpoch;
 bool AAH_TXSender::sNextEpochValid = false;
 
-AAH_TXSender::AAH_TXSender() : mSocket(-1) {
+AAH_TXSender::AAH_TXSender()
+        : mSocket(-1)
+        , mFECGroupSize(0)
+        , mBatchSendSupported(true) {
     mLastSentPacketTime = systemTime();
+
+    // Each FEC packet lets receivers repair one lost packet out of a group
+    // without waiting for a retransmission, at a bandwidth cost of one packet
+    // per group.
+    char value[PROPERTY_VALUE_MAX];
+    if (property_get("media.aah.fec_group_size", value, NULL)) {
+        mFECGroupSize = atoi(value);
+        if (mFECGroupSize < 0) {
+            mFECGroupSize = 0;
+        } else if (mFECGroupSize > kMaxFECGroupSize) {
+            mFECGroupSize = kMaxFECGroupSize;
+        }
+    }
+
+    if (mFECGroupSize) {
+        ALOGI("sending one FEC packet per %d packets", mFECGroupSize);
+    }
 }
 
 sp<AAH_TXSender> AAH_TXSender::GetInstance() {
@@ -221,13 +259,16 @@ void AAH_TXSender::onSendPacket(const sp<AMessage>& msg) {
     mLastSentPacketTime = systemTime();
 }
 
-void AAH_TXSender::doSendPacket_l(const sp<TRTPPacket>& packet,
-                                  const Endpoint& endpoint) {
+// Assign the packet its place in the endpoint's sequence and add it to the
+// endpoint's retry buffer.  Returns NULL if the endpoint no longer exists.
+AAH_TXSender::EndpointState* AAH_TXSender::sequencePacket_l(
+        const sp<TRTPPacket>& packet,
+        const Endpoint& endpoint) {
     EndpointState* eps = mEndpointMap.valueFor(endpoint);
     if (!eps) {
         // the endpoint state has disappeared, so the player that sent this
         // packet must be dead.
-        return;
+        return NULL;
     }
 
     // assign the packet's sequence number
@@ -238,6 +279,16 @@ void AAH_TXSender::doSendPacket_l(const sp<TRTPPacket>& packet,
     RetryBuffer& retry = eps->retry;
     retry.push_back(packet);
 
+    return eps;
+}
+
+void AAH_TXSender::doSendPacket_l(const sp<TRTPPacket>& packet,
+                                  const Endpoint& endpoint) {
+    EndpointState* eps = sequencePacket_l(packet, endpoint);
+    if (!eps) {
+        return;
+    }
+
     // send the packet
     struct sockaddr_in addr;
     memset(&addr, 0, sizeof(addr));
@@ -254,6 +305,147 @@ void AAH_TXSender::doSendPacket_l(const sp<TRTPPacket>& packet,
     if (result == -1) {
         ALOGW("%s sendto failed", __PRETTY_FUNCTION__);
     }
+
+    if (mFECGroupSize) {
+        addToFECGroup_l(eps, packet, endpoint);
+    }
+}
+
+// Send a group of datagrams using as few system calls as possible.
+void AAH_TXSender::sendBatch(const Datagram* datagrams, size_t count) {
+    size_t sent = 0;
+
+#ifdef __NR_sendmmsg
+    while (mBatchSendSupported && (sent < count)) {
+        struct tx_mmsghdr msgs[kMaxSendBatch];
+        struct iovec iovs[kMaxSendBatch];
+
+        size_t batch = count - sent;
+        if (batch > kMaxSendBatch) {
+            batch = kMaxSendBatch;
+        }
+
+        memset(msgs, 0, sizeof(msgs[0]) * batch);
+        for (size_t i = 0; i < batch; i++) {
+            const Datagram& dg = datagrams[sent + i];
+            iovs[i].iov_base = const_cast<void*>(dg.data);
+            iovs[i].iov_len = dg.len;
+            msgs[i].msg_hdr.msg_name = const_cast<struct sockaddr*>(dg.addr);
+            msgs[i].msg_hdr.msg_namelen = dg.addrLen;
+            msgs[i].msg_hdr.msg_iov = &iovs[i];
+            msgs[i].msg_hdr.msg_iovlen = 1;
+        }
+
+        int result = syscall(__NR_sendmmsg, mSocket, msgs, batch, 0);
+        if (result == -1 && errno == ENOSYS) {
+            ALOGI("%s sendmmsg not supported", __PRETTY_FUNCTION__);
+            mBatchSendSupported = false;
+            break;
+        }
+
+        if (result <= 0) {
+            // skip the datagram which could not be sent, as sendto would
+            ALOGW("%s sendmmsg failed (errno %d)", __PRETTY_FUNCTION__, errno);
+            result = 1;
+        }
+        sent += result;
+    }
+#endif
+
+    for (; sent < count; sent++) {
+        const Datagram& dg = datagrams[sent];
+        ssize_t result = sendto(mSocket, dg.data, dg.len, 0,
+                                dg.addr, dg.addrLen);
+        if (result == -1) {
+            ALOGW("%s sendto failed", __PRETTY_FUNCTION__);
+        }
+    }
+}
+
+void AAH_TXSender::addToFECGroup_l(EndpointState* eps,
+                                   const sp<TRTPPacket>& packet,
+                                   const Endpoint& endpoint) {
+    FECGroup& fec = eps->fec;
+    const uint8_t* data = packet->getPacket();
+    int len = packet->getPacketLen();
+
+    if (fec.parity == NULL) {
+        fec.parity = new uint8_t[kMaxFECPayloadLen];
+        if (fec.parity == NULL) {
+            return;
+        }
+        memset(fec.parity, 0, kMaxFECPayloadLen);
+    }
+
+    if (len > kMaxFECPayloadLen) {
+        // can't protect a packet this large; abandon the group in progress
+        memset(fec.parity, 0, fec.parityLen);
+        fec.parityLen = 0;
+        fec.count = 0;
+        return;
+    }
+
+    if (fec.count == 0) {
+        fec.startSeq = packet->getSeqNumber();
+        fec.startTime = systemTime();
+        fec.lengthXor = 0;
+    }
+
+    for (int i = 0; i < len; i++) {
+        fec.parity[i] ^= data[i];
+    }
+    if (len > fec.parityLen) {
+        fec.parityLen = len;
+    }
+    fec.lengthXor ^= len;
+    fec.count++;
+
+    if (fec.count >= mFECGroupSize) {
+        sendFECPacket_l(eps, endpoint);
+    }
+}
+
+void AAH_TXSender::sendFECPacket_l(EndpointState* eps,
+                                   const Endpoint& endpoint) {
+    FECGroup& fec = eps->fec;
+    if (fec.count == 0) {
+        return;
+    }
+
+    FECPacket header;
+    header.id = htonl(kFECPacketID);
+    header.epoch = htonl(eps->epoch);
+    header.startSeq = htons(fec.startSeq);
+    header.lengthXor = htons(fec.lengthXor);
+    header.count = fec.count;
+    header.reserved = 0;
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = endpoint.addr;
+    addr.sin_port = endpoint.port;
+
+    struct iovec iov[2];
+    iov[0].iov_base = &header;
+    iov[0].iov_len = sizeof(header);
+    iov[1].iov_base = fec.parity;
+    iov[1].iov_len = fec.parityLen;
+
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_name = &addr;
+    msg.msg_namelen = sizeof(addr);
+    msg.msg_iov = iov;
+    msg.msg_iovlen = NELEM(iov);
+
+    if (sendmsg(mSocket, &msg, 0) == -1) {
+        ALOGW("%s sendmsg failed", __PRETTY_FUNCTION__);
+    }
+
+    memset(fec.parity, 0, fec.parityLen);
+    fec.parityLen = 0;
+    fec.count = 0;
 }
 
 void AAH_TXSender::trimRetryBuffers() {
@@ -275,6 +467,12 @@ void AAH_TXSender::trimRetryBuffers() {
             }
         }
 
+        // don't leave a partial FEC group waiting for more packets for long
+        if (eps->fec.count > 0 &&
+            (localTimeNow - eps->fec.startTime) >= us2ns(kRetryTrimIntervalUs)) {
+            sendFECPacket_l(eps, mEndpointMap.keyAt(i));
+        }
+
         if (retry.isEmpty() && eps->playerRefCount == 0) {
             endpointsToRemove.add(mEndpointMap.keyAt(i));
         }
@@ -302,8 +500,16 @@ void AAH_TXSender::sendHeartbeats() {
     Mutex::Autolock lock(mEndpointLock);
 
     if (shouldSendHeartbeats_l()) {
-        for (size_t i = 0; i < mEndpointMap.size(); i++) {
-            EndpointState* eps = mEndpointMap.editValueAt(i);
+        size_t count = mEndpointMap.size();
+        Vector<sp<TRTPPacket> > packets;
+        Vector<struct sockaddr_in> addrs;
+        Vector<Datagram> datagrams;
+
+        packets.setCapacity(count);
+        addrs.setCapacity(count);
+        datagrams.setCapacity(count);
+
+        for (size_t i = 0; i < count; i++) {
             const Endpoint& ep = mEndpointMap.keyAt(i);
 
             sp<TRTPControlPacket> packet = new TRTPControlPacket();
@@ -313,7 +519,35 @@ void AAH_TXSender::sendHeartbeats() {
                                   AAH_TXPlayer::kAAHRetryKeepAroundTimeNs);
             packet->pack();
 
-            doSendPacket_l(packet, ep);
+            sequencePacket_l(packet, ep);
+            packets.add(packet);
+
+            struct sockaddr_in addr;
+            memset(&addr, 0, sizeof(addr));
+            addr.sin_family = AF_INET;
+            addr.sin_addr.s_addr = ep.addr;
+            addr.sin_port = ep.port;
+            addrs.add(addr);
+        }
+
+        // addrs no longer changes size, so pointers into it stay valid
+        for (size_t i = 0; i < count; i++) {
+            Datagram dg;
+            dg.data = packets[i]->getPacket();
+            dg.len = packets[i]->getPacketLen();
+            dg.addr = reinterpret_cast<const struct sockaddr*>(&addrs[i]);
+            dg.addrLen = sizeof(addrs[i]);
+            datagrams.add(dg);
+        }
+
+        // send the heartbeats for all of the endpoints at once
+        sendBatch(datagrams.array(), datagrams.size());
+
+        if (mFECGroupSize) {
+            for (size_t i = 0; i < count; i++) {
+                addToFECGroup_l(mEndpointMap.editValueAt(i), packets[i],
+                                mEndpointMap.keyAt(i));
+            }
         }
     }
 
@@ -500,20 +734,20 @@ void AAH_TXSender::RetryReceiver::handleRetryRequest() {
     }
 
     // send the retry packets
+    Vector<Datagram> datagrams;
+    datagrams.setCapacity(endIndex - startIndex + 1);
     for (int i = startIndex; i <= endIndex; i++) {
         const sp<TRTPPacket>& replyPacket = retry[i];
 
-        result = sendto(mSender->mSocket,
-                        replyPacket->getPacket(),
-                        replyPacket->getPacketLen(),
-                        0,
-                        &requestSrcAddr,
-                        requestSrcAddrLen);
-
-        if (result == -1) {
-            ALOGW("%s sendto failed", __PRETTY_FUNCTION__);
-        }
+        Datagram dg;
+        dg.data = replyPacket->getPacket();
+        dg.len = replyPacket->getPacketLen();
+        dg.addr = &requestSrcAddr;
+        dg.addrLen = requestSrcAddrLen;
+        datagrams.add(dg);
     }
+
+    mSender->sendBatch(datagrams.array(), datagrams.size());
 }
 
 // Endpoint
@@ -540,6 +774,20 @@ AAH_TXSender::EndpointState::EndpointState(uint32_t _epoch)
     , nextProgramID(0)
     , epoch(_epoch) { }
 
+// FECGroup
+
+AAH_TXSender::FECGroup::FECGroup()
+    : parity(NULL)
+    , parityLen(0)
+    , lengthXor(0)
+    , startSeq(0)
+    , count(0)
+    , startTime(0) { }
+
+AAH_TXSender::FECGroup::~FECGroup() {
+    delete[] parity;
+}
+
 // CircularBuffer
 
 template <typename T>
@@ -93,10 +93,23 @@ class AAH_TXSender : public virtual RefBase {
 
     typedef CircularBuffer<sp<TRTPPacket> > RetryBuffer;
 
+    // XOR parity of the packets sent to an endpoint since its last FEC packet
+    struct FECGroup {
+        FECGroup();
+        ~FECGroup();
+        uint8_t* parity;
+        int parityLen;
+        uint16_t lengthXor;
+        uint16_t startSeq;
+        int count;
+        nsecs_t startTime;
+    };
+
     // state maintained on a per-endpoint basis
     struct EndpointState {
         EndpointState(uint32_t epoch);
         RetryBuffer retry;
+        FECGroup fec;
         int playerRefCount;
         uint16_t trtpSeqNumber;
         uint16_t nextProgramID;
@@ -106,8 +119,23 @@ class AAH_TXSender : public virtual RefBase {
     friend class AHandlerReflector<AAH_TXSender>;
     void onMessageReceived(const sp<AMessage>& msg);
     void onSendPacket(const sp<AMessage>& msg);
+    // a datagram to be sent by sendBatch
+    struct Datagram {
+        const void* data;
+        size_t len;
+        const struct sockaddr* addr;
+        socklen_t addrLen;
+    };
+
+    EndpointState* sequencePacket_l(const sp<TRTPPacket>& packet,
+                                    const Endpoint& endpoint);
     void doSendPacket_l(const sp<TRTPPacket>& packet,
                         const Endpoint& endpoint);
+    void sendBatch(const Datagram* datagrams, size_t count);
+    void addToFECGroup_l(EndpointState* eps,
+                         const sp<TRTPPacket>& packet,
+                         const Endpoint& endpoint);
+    void sendFECPacket_l(EndpointState* eps, const Endpoint& endpoint);
     void trimRetryBuffers();
     void sendHeartbeats();
     bool shouldSendHeartbeats_l();
@@ -118,6 +146,12 @@ class AAH_TXSender : public virtual RefBase {
     int mSocket;
     nsecs_t mLastSentPacketTime;
 
+    // number of packets protected by each FEC packet; 0 disables FEC
+    int mFECGroupSize;
+
+    // cleared if the kernel turns out not to support sendmmsg
+    volatile bool mBatchSendSupported;
+
     DefaultKeyedVector<Endpoint, EndpointState*> mEndpointMap;
     Mutex mEndpointLock;
 
@@ -125,6 +159,10 @@ class AAH_TXSender : public virtual RefBase {
     static const int kHeartbeatIntervalUs;
     static const int kRetryBufferCapacity;
     static const nsecs_t kHeartbeatTimeout;
+    static const int kMaxFECGroupSize;
+    static const size_t kMaxSendBatch;
+    static const int kMaxFECPayloadLen;
+    static const uint32_t kFECPacketID;
 
     class RetryReceiver : public Thread {
       private:
@@ -157,6 +195,18 @@ struct RetryPacket {
     uint16_t seqEnd;
 } __attribute__((packed));
 
+// Header of a forward error correction packet.  The payload which follows is
+// the XOR of count packets, starting with startSeq, each zero padded to the
+// length of the longest.  FEC packets do not use a TRTP sequence number.
+struct FECPacket {
+    uint32_t id;
+    uint32_t epoch;
+    uint16_t startSeq;
+    uint16_t lengthXor;
+    uint8_t count;
+    uint8_t reserved;
+} __attribute__((packed));
+
 }  // namespace android
 
 #endif  // __AAH_TX_SENDER_H__
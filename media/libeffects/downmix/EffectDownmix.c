@@ -22,10 +22,27 @@
 #include <stdbool.h>
 #include "EffectDownmix.h"
 
+#ifdef __ARM_NEON__
+#include <arm_neon.h>
+#endif
+
 // Do not submit with DOWNMIX_TEST_CHANNEL_INDEX defined, strictly for testing
 //#define DOWNMIX_TEST_CHANNEL_INDEX 0
 // Do not submit with DOWNMIX_ALWAYS_USE_GENERIC_DOWNMIXER defined, strictly for testing
 //#define DOWNMIX_ALWAYS_USE_GENERIC_DOWNMIXER 0
+// Do not submit with DOWNMIX_BENCHMARK defined, strictly for testing: compares the NEON fold
+// functions against the C ones for bit exactness and speed when the library is loaded
+//#define DOWNMIX_BENCHMARK 0
+
+#ifdef __ARM_NEON__
+#ifdef DOWNMIX_BENCHMARK
+#include <time.h>
+static bool sDownmixUseNeon = true;
+#define DOWNMIX_USE_NEON sDownmixUseNeon
+#else
+#define DOWNMIX_USE_NEON true
+#endif
+#endif
 
 #define MINUS_3_DB_IN_Q19_12 2896 // -3dB = 0.707 * 2^12 = 2896
 
@@ -152,6 +169,53 @@ void Downmix_testIndexComputation(uint32_t mask) {
 }
 #endif
 
+#if defined(DOWNMIX_BENCHMARK) && defined(__ARM_NEON__)
+typedef void (*downmix_fold_t)(int16_t *pSrc, int16_t*pDst, size_t numFrames, bool accumulate);
+
+static int64_t Downmix_benchmarkNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+// strictly for testing, logs the time taken by the C and NEON versions of a fold function
+// and whether they produce the same output
+static void Downmix_benchmarkFold(const char *name, downmix_fold_t fold, int channels) {
+    // a number of frames that is not a multiple of 4 also exercises the scalar tail
+    enum { kNumFrames = 1021, kIterations = 1000 };
+    int16_t src[kNumFrames * 8];
+    int16_t dstC[kNumFrames * 2];
+    int16_t dstNeon[kNumFrames * 2];
+    uint32_t seed = 1;
+    size_t i;
+    for (i = 0; i < kNumFrames * channels; i++) {
+        seed = seed * 1103515245 + 12345;
+        src[i] = (int16_t)(seed >> 16);
+    }
+    int accumulate;
+    for (accumulate = 0; accumulate <= 1; accumulate++) {
+        int64_t elapsed[2];
+        int neon;
+        for (neon = 0; neon <= 1; neon++) {
+            int16_t *dst = neon ? dstNeon : dstC;
+            sDownmixUseNeon = neon;
+            int64_t start = Downmix_benchmarkNs();
+            int n;
+            for (n = 0; n < kIterations; n++) {
+                // start from the same destination contents for each version
+                memset(dst, 0x55, sizeof(dstC));
+                fold(src, dst, kNumFrames, accumulate);
+            }
+            elapsed[neon] = Downmix_benchmarkNs() - start;
+        }
+        ALOGI("DOWNMIX_BENCHMARK: %s accumulate=%d C %lld ns NEON %lld ns, output %s", name,
+                accumulate, elapsed[0], elapsed[1],
+                memcmp(dstC, dstNeon, sizeof(dstC)) == 0 ? "identical" : "DIFFERS");
+    }
+    sDownmixUseNeon = true;
+}
+#endif
+
 
 /*----------------------------------------------------------------------------
  * Effect API implementation
@@ -189,6 +253,13 @@ int32_t DownmixLib_Create(const effect_uuid_t *uuid,
 
     ALOGV("DownmixLib_Create()");
 
+#if defined(DOWNMIX_BENCHMARK) && defined(__ARM_NEON__)
+    Downmix_benchmarkFold("quad", Downmix_foldFromQuad, 4);
+    Downmix_benchmarkFold("surround", Downmix_foldFromSurround, 4);
+    Downmix_benchmarkFold("5.1", Downmix_foldFrom5Point1, 6);
+    Downmix_benchmarkFold("7.1", Downmix_foldFrom7Point1, 8);
+#endif
+
 #ifdef DOWNMIX_TEST_CHANNEL_INDEX
     // should work (won't log an error)
     ALOGI("DOWNMIX_TEST_CHANNEL_INDEX: should work:");
@@ -797,6 +868,129 @@ int Downmix_getParameter(downmix_object_t *pDownmixer, int32_t param, size_t *pS
 } /* end Downmix_getParameter */
 
 
+#ifdef __ARM_NEON__
+/*----------------------------------------------------------------------------
+ * NEON fold kernels
+ *----------------------------------------------------------------------------
+ * The kernels below downmix 4 frames at a time and are bit exact with the C code of the
+ * corresponding Downmix_foldFrom*() functions, which process the remaining frames.
+ * The input channels are loaded as pairs of 16-bit samples, so that de-interleaving splits a
+ * frame into (FL, FR), (FC, LFE or RC), (RL, RR) and (SL, SR) vectors having the layout of the
+ * stereo output.
+ *----------------------------------------------------------------------------
+ */
+
+// stores 4 stereo frames in Q19.12 format, with or without accumulation in pDst
+static inline void Downmix_neonStore(int16_t *pDst, int32x4_t lo, int32x4_t hi,
+        bool accumulate) {
+    if (accumulate) {
+        const int16x8_t dst = vld1q_s16(pDst);
+        lo = vaddw_s16(vshrq_n_s32(lo, 13), vget_low_s16(dst));
+        hi = vaddw_s16(vshrq_n_s32(hi, 13), vget_high_s16(dst));
+        vst1q_s16(pDst, vcombine_s16(vqmovn_s32(lo), vqmovn_s32(hi)));
+    } else {
+        vst1q_s16(pDst, vcombine_s16(vqshrn_n_s32(lo, 13), vqshrn_n_s32(hi, 13)));
+    }
+}
+
+// returns (A(-3dB) + B(-3dB)) of a vector of (A, B) pairs, in both channels of 4 frames
+static inline void Downmix_neonMinus3dBPair(int16x8_t pair, int32x4_t *lo, int32x4_t *hi) {
+    const int32x4_t l = vmull_n_s16(vget_low_s16(pair), MINUS_3_DB_IN_Q19_12);
+    const int32x4_t h = vmull_n_s16(vget_high_s16(pair), MINUS_3_DB_IN_Q19_12);
+    *lo = vaddq_s32(l, vrev64q_s32(l));
+    *hi = vaddq_s32(h, vrev64q_s32(h));
+}
+
+static size_t Downmix_foldFromQuad_neon(int16_t *pSrc, int16_t*pDst, size_t numFrames,
+        bool accumulate) {
+    size_t frames = numFrames & ~3;
+    size_t i;
+    for (i = 0; i < frames; i += 4) {
+        const int32x4x2_t in = vld2q_s32((const int32_t *)pSrc);
+        // (FL + RL) / 2, (FR + RR) / 2
+        int16x8_t out = vhaddq_s16(vreinterpretq_s16_s32(in.val[0]),
+                vreinterpretq_s16_s32(in.val[1]));
+        if (accumulate) {
+            out = vqaddq_s16(vld1q_s16(pDst), out);
+        }
+        vst1q_s16(pDst, out);
+        pSrc += 16;
+        pDst += 8;
+    }
+    return frames;
+}
+
+static size_t Downmix_foldFromSurround_neon(int16_t *pSrc, int16_t*pDst, size_t numFrames,
+        bool accumulate) {
+    size_t frames = numFrames & ~3;
+    size_t i;
+    for (i = 0; i < frames; i += 4) {
+        const int32x4x2_t in = vld2q_s32((const int32_t *)pSrc);
+        const int16x8_t front = vreinterpretq_s16_s32(in.val[0]);
+        int32x4_t lo, hi;
+        // FC(-3dB) + RC(-3dB)
+        Downmix_neonMinus3dBPair(vreinterpretq_s16_s32(in.val[1]), &lo, &hi);
+        // FL/FR + centerPlusRearContrib
+        lo = vaddq_s32(lo, vshll_n_s16(vget_low_s16(front), 12));
+        hi = vaddq_s32(hi, vshll_n_s16(vget_high_s16(front), 12));
+        Downmix_neonStore(pDst, lo, hi, accumulate);
+        pSrc += 16;
+        pDst += 8;
+    }
+    return frames;
+}
+
+static size_t Downmix_foldFrom5Point1_neon(int16_t *pSrc, int16_t*pDst, size_t numFrames,
+        bool accumulate) {
+    size_t frames = numFrames & ~3;
+    size_t i;
+    for (i = 0; i < frames; i += 4) {
+        const int32x4x3_t in = vld3q_s32((const int32_t *)pSrc);
+        const int16x8_t front = vreinterpretq_s16_s32(in.val[0]);
+        const int16x8_t rear = vreinterpretq_s16_s32(in.val[2]);
+        int32x4_t lo, hi;
+        // FC(-3dB) + LFE(-3dB)
+        Downmix_neonMinus3dBPair(vreinterpretq_s16_s32(in.val[1]), &lo, &hi);
+        // FL/FR + centerPlusLfeContrib + RL/RR
+        lo = vaddq_s32(lo, vshll_n_s16(vget_low_s16(front), 12));
+        hi = vaddq_s32(hi, vshll_n_s16(vget_high_s16(front), 12));
+        lo = vaddq_s32(lo, vshll_n_s16(vget_low_s16(rear), 12));
+        hi = vaddq_s32(hi, vshll_n_s16(vget_high_s16(rear), 12));
+        Downmix_neonStore(pDst, lo, hi, accumulate);
+        pSrc += 24;
+        pDst += 8;
+    }
+    return frames;
+}
+
+static size_t Downmix_foldFrom7Point1_neon(int16_t *pSrc, int16_t*pDst, size_t numFrames,
+        bool accumulate) {
+    size_t frames = numFrames & ~3;
+    size_t i;
+    for (i = 0; i < frames; i += 4) {
+        const int32x4x4_t in = vld4q_s32((const int32_t *)pSrc);
+        const int16x8_t front = vreinterpretq_s16_s32(in.val[0]);
+        const int16x8_t rear = vreinterpretq_s16_s32(in.val[2]);
+        const int16x8_t side = vreinterpretq_s16_s32(in.val[3]);
+        int32x4_t lo, hi;
+        // FC(-3dB) + LFE(-3dB)
+        Downmix_neonMinus3dBPair(vreinterpretq_s16_s32(in.val[1]), &lo, &hi);
+        // FL/FR + centerPlusLfeContrib + SL/SR + RL/RR
+        lo = vaddq_s32(lo, vshll_n_s16(vget_low_s16(front), 12));
+        hi = vaddq_s32(hi, vshll_n_s16(vget_high_s16(front), 12));
+        lo = vaddq_s32(lo, vshll_n_s16(vget_low_s16(side), 12));
+        hi = vaddq_s32(hi, vshll_n_s16(vget_high_s16(side), 12));
+        lo = vaddq_s32(lo, vshll_n_s16(vget_low_s16(rear), 12));
+        hi = vaddq_s32(hi, vshll_n_s16(vget_high_s16(rear), 12));
+        Downmix_neonStore(pDst, lo, hi, accumulate);
+        pSrc += 32;
+        pDst += 8;
+    }
+    return frames;
+}
+#endif
+
+
 /*----------------------------------------------------------------------------
  * Downmix_foldFromQuad()
  *----------------------------------------------------------------------------
@@ -819,6 +1013,15 @@ void Downmix_foldFromQuad(int16_t *pSrc, int16_t*pDst, size_t numFrames, bool ac
     // sample at index 1 is FR
     // sample at index 2 is RL
     // sample at index 3 is RR
+#ifdef __ARM_NEON__
+    if (DOWNMIX_USE_NEON) {
+        const size_t neonFrames =
+                Downmix_foldFromQuad_neon(pSrc, pDst, numFrames, accumulate);
+        pSrc += neonFrames * 4;
+        pDst += neonFrames * 2;
+        numFrames -= neonFrames;
+    }
+#endif
     if (accumulate) {
         while (numFrames) {
             // FL + RL
@@ -866,6 +1069,15 @@ void Downmix_foldFromSurround(int16_t *pSrc, int16_t*pDst, size_t numFrames, boo
     // sample at index 1 is FR
     // sample at index 2 is FC
     // sample at index 3 is RC
+#ifdef __ARM_NEON__
+    if (DOWNMIX_USE_NEON) {
+        const size_t neonFrames =
+                Downmix_foldFromSurround_neon(pSrc, pDst, numFrames, accumulate);
+        pSrc += neonFrames * 4;
+        pDst += neonFrames * 2;
+        numFrames -= neonFrames;
+    }
+#endif
     // code is mostly duplicated between the two values of accumulate to avoid repeating the test
     // for every sample
     if (accumulate) {
@@ -927,6 +1139,15 @@ void Downmix_foldFrom5Point1(int16_t *pSrc, int16_t*pDst, size_t numFrames, bool
     // sample at index 3 is LFE
     // sample at index 4 is RL
     // sample at index 5 is RR
+#ifdef __ARM_NEON__
+    if (DOWNMIX_USE_NEON) {
+        const size_t neonFrames =
+                Downmix_foldFrom5Point1_neon(pSrc, pDst, numFrames, accumulate);
+        pSrc += neonFrames * 6;
+        pDst += neonFrames * 2;
+        numFrames -= neonFrames;
+    }
+#endif
     // code is mostly duplicated between the two values of accumulate to avoid repeating the test
     // for every sample
     if (accumulate) {
@@ -992,6 +1213,15 @@ void Downmix_foldFrom7Point1(int16_t *pSrc, int16_t*pDst, size_t numFrames, bool
     // sample at index 5 is RR
     // sample at index 6 is SL
     // sample at index 7 is SR
+#ifdef __ARM_NEON__
+    if (DOWNMIX_USE_NEON) {
+        const size_t neonFrames =
+                Downmix_foldFrom7Point1_neon(pSrc, pDst, numFrames, accumulate);
+        pSrc += neonFrames * 8;
+        pDst += neonFrames * 2;
+        numFrames -= neonFrames;
+    }
+#endif
     // code is mostly duplicated between the two values of accumulate to avoid repeating the test
     // for every sample
     if (accumulate) {
@@ -21,6 +21,9 @@
 #include <string.h>
 #include <stdlib.h>
 #include <dlfcn.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <sys/stat.h>
 
 #include <cutils/misc.h>
 #include <cutils/config_utils.h>
@@ -34,6 +37,22 @@ static list_elem_t *gCurLib;    // current library in enumeration process
 static list_elem_t *gCurEffect; // current effect in enumeration process
 static uint32_t gCurEffectIdx;       // current effect index in enumeration process
 static lib_entry_t *gCachedLibrary;  // last library accessed by getLibrary()
+static list_elem_t *gDescCache; // list of lib_cache_entry_t: read from AUDIO_EFFECT_CACHE_FILE during init()
+static int gDescCacheDirty; // a descriptor was queried from a library and the cache file must be rewritten
+
+// AUDIO_EFFECT_CACHE_FILE starts with a cache_header_t followed by numLibs records of:
+// uint32_t path length, path, int64_t mtime, int64_t size, uint32_t numEffects and
+// numEffects effect_descriptor_t
+#define CACHE_MAGIC 0x43434645 // "EFCC"
+#define CACHE_VERSION 1
+#define CACHE_MAX_EFFECTS 256 // per library, sanity check when reading the file
+
+typedef struct cache_header_s {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t descSize; // sizeof(effect_descriptor_t)
+    uint32_t numLibs;
+} cache_header_t;
 
 static int gInitDone; // true is global initialization has been preformed
 static int gCanQueryEffect; // indicates that call to EffectQueryEffect() is valid, i.e. that the list of effects
@@ -48,9 +67,14 @@ static int init();
 static int loadEffectConfigFile(const char *path);
 static int loadLibraries(cnode *root);
 static int loadLibrary(cnode *root, const char *name);
+static int openLibrary(lib_entry_t *l);
 static int loadEffects(cnode *root);
 static int loadEffect(cnode *node);
 static lib_entry_t *getLibrary(const char *path);
+static void readDescriptorCache(const char *path);
+static void writeDescriptorCache(const char *path);
+static void freeDescriptorCache();
+static effect_descriptor_t *getCachedDescriptor(lib_entry_t *l, const effect_uuid_t *uuid);
 static void resetEffectEnumeration();
 static uint32_t updateNumEffects();
 static int findEffect(const effect_uuid_t *type,
@@ -290,6 +314,12 @@ int EffectCreate(const effect_uuid_t *uuid, int32_t sessionId, int32_t ioId, eff
         goto exit;
     }
 
+    ret = openLibrary(l);
+    if (ret < 0) {
+        ALOGW("EffectCreate() could not open library %s for fx %s", l->name, d->name);
+        goto exit;
+    }
+
     // create effect in library
     ret = l->desc->create_effect(uuid, sessionId, ioId, &itfe);
     if (ret != 0) {
@@ -393,11 +423,16 @@ int init() {
 
     pthread_mutex_init(&gLibLock, NULL);
 
+    readDescriptorCache(AUDIO_EFFECT_CACHE_FILE);
     if (access(AUDIO_EFFECT_VENDOR_CONFIG_FILE, R_OK) == 0) {
         loadEffectConfigFile(AUDIO_EFFECT_VENDOR_CONFIG_FILE);
     } else if (access(AUDIO_EFFECT_DEFAULT_CONFIG_FILE, R_OK) == 0) {
         loadEffectConfigFile(AUDIO_EFFECT_DEFAULT_CONFIG_FILE);
     }
+    if (gDescCacheDirty) {
+        writeDescriptorCache(AUDIO_EFFECT_CACHE_FILE);
+    }
+    freeDescriptorCache();
 
     updateNumEffects();
     gInitDone = 1;
@@ -444,8 +479,7 @@ int loadLibraries(cnode *root)
 int loadLibrary(cnode *root, const char *name)
 {
     cnode *node;
-    void *hdl;
-    audio_effect_library_t *desc;
+    struct stat st;
     list_elem_t *e;
     lib_entry_t *l;
 
@@ -454,15 +488,52 @@ int loadLibrary(cnode *root, const char *name)
         return -EINVAL;
     }
 
-    hdl = dlopen(node->value, RTLD_NOW);
+    if (stat(node->value, &st) != 0) {
+        ALOGW("loadLibrary() failed to find %s", node->value);
+        return -EINVAL;
+    }
+
+    // add entry for library in gLibraryList. The library itself is opened by
+    // openLibrary() when a descriptor is not in the cache or an effect is created.
+    l = malloc(sizeof(lib_entry_t));
+    l->name = strndup(name, PATH_MAX);
+    l->path = strndup(node->value, PATH_MAX);
+    l->handle = NULL;
+    l->desc = NULL;
+    l->mtime = (int64_t)st.st_mtime;
+    l->size = (int64_t)st.st_size;
+    l->effects = NULL;
+    pthread_mutex_init(&l->lock, NULL);
+
+    e = malloc(sizeof(list_elem_t));
+    e->object = l;
+    pthread_mutex_lock(&gLibLock);
+    e->next = gLibraryList;
+    gLibraryList = e;
+    pthread_mutex_unlock(&gLibLock);
+    ALOGV("getLibrary() linked library %p for path %s", l, node->value);
+
+    return 0;
+}
+
+int openLibrary(lib_entry_t *l)
+{
+    void *hdl;
+    audio_effect_library_t *desc;
+
+    if (l->handle != NULL) {
+        return 0;
+    }
+
+    hdl = dlopen(l->path, RTLD_NOW);
     if (hdl == NULL) {
-        ALOGW("loadLibrary() failed to open %s", node->value);
+        ALOGW("openLibrary() failed to open %s", l->path);
         goto error;
     }
 
     desc = (audio_effect_library_t *)dlsym(hdl, AUDIO_EFFECT_LIBRARY_INFO_SYM_AS_STR);
     if (desc == NULL) {
-        ALOGW("loadLibrary() could not find symbol %s", AUDIO_EFFECT_LIBRARY_INFO_SYM_AS_STR);
+        ALOGW("openLibrary() could not find symbol %s", AUDIO_EFFECT_LIBRARY_INFO_SYM_AS_STR);
         goto error;
     }
 
@@ -473,26 +544,13 @@ int loadLibrary(cnode *root, const char *name)
 
     if (EFFECT_API_VERSION_MAJOR(desc->version) !=
             EFFECT_API_VERSION_MAJOR(EFFECT_LIBRARY_API_VERSION)) {
-        ALOGW("loadLibrary() bad lib version %08x", desc->version);
+        ALOGW("openLibrary() bad lib version %08x", desc->version);
         goto error;
     }
 
-    // add entry for library in gLibraryList
-    l = malloc(sizeof(lib_entry_t));
-    l->name = strndup(name, PATH_MAX);
-    l->path = strndup(node->value, PATH_MAX);
     l->handle = hdl;
     l->desc = desc;
-    l->effects = NULL;
-    pthread_mutex_init(&l->lock, NULL);
-
-    e = malloc(sizeof(list_elem_t));
-    e->object = l;
-    pthread_mutex_lock(&gLibLock);
-    e->next = gLibraryList;
-    gLibraryList = e;
-    pthread_mutex_unlock(&gLibLock);
-    ALOGV("getLibrary() linked library %p for path %s", l, node->value);
+    ALOGV("openLibrary() opened library %p for path %s", l, l->path);
 
     return 0;
 
@@ -525,6 +583,7 @@ int loadEffect(cnode *root)
     effect_uuid_t uuid;
     lib_entry_t *l;
     effect_descriptor_t *d;
+    effect_descriptor_t *cached;
     list_elem_t *e;
 
     node = config_find(root, LIBRARY_TAG);
@@ -548,12 +607,22 @@ int loadEffect(cnode *root)
     }
 
     d = malloc(sizeof(effect_descriptor_t));
-    if (l->desc->get_descriptor(&uuid, d) != 0) {
-        char s[40];
-        uuidToString(&uuid, s, 40);
-        ALOGW("Error querying effect %s on lib %s", s, l->name);
-        free(d);
-        return -EINVAL;
+    cached = getCachedDescriptor(l, &uuid);
+    if (cached != NULL) {
+        memcpy(d, cached, sizeof(effect_descriptor_t));
+    } else {
+        if (openLibrary(l) != 0) {
+            free(d);
+            return -EINVAL;
+        }
+        if (l->desc->get_descriptor(&uuid, d) != 0) {
+            char s[40];
+            uuidToString(&uuid, s, 40);
+            ALOGW("Error querying effect %s on lib %s", s, l->name);
+            free(d);
+            return -EINVAL;
+        }
+        gDescCacheDirty = 1;
     }
 #if (LOG_NDEBUG==0)
     char s[256];
@@ -596,6 +665,157 @@ lib_entry_t *getLibrary(const char *name)
     return NULL;
 }
 
+void readDescriptorCache(const char *path)
+{
+    FILE *f;
+    cache_header_t header;
+    uint32_t i;
+
+    f = fopen(path, "rb");
+    if (f == NULL) {
+        ALOGV("readDescriptorCache() no cache file %s", path);
+        return;
+    }
+    if (fread(&header, sizeof(header), 1, f) != 1 ||
+            header.magic != CACHE_MAGIC ||
+            header.version != CACHE_VERSION ||
+            header.descSize != sizeof(effect_descriptor_t)) {
+        ALOGW("readDescriptorCache() ignoring invalid cache file %s", path);
+        fclose(f);
+        return;
+    }
+
+    for (i = 0; i < header.numLibs; i++) {
+        lib_cache_entry_t *c;
+        list_elem_t *e;
+        uint32_t pathLen;
+
+        if (fread(&pathLen, sizeof(pathLen), 1, f) != 1 || pathLen == 0 || pathLen >= PATH_MAX) {
+            break;
+        }
+        c = calloc(1, sizeof(lib_cache_entry_t));
+        c->path = malloc(pathLen + 1);
+        if (fread(c->path, pathLen, 1, f) != 1 ||
+                fread(&c->mtime, sizeof(c->mtime), 1, f) != 1 ||
+                fread(&c->size, sizeof(c->size), 1, f) != 1 ||
+                fread(&c->numEffects, sizeof(c->numEffects), 1, f) != 1 ||
+                c->numEffects > CACHE_MAX_EFFECTS) {
+            free(c->path);
+            free(c);
+            break;
+        }
+        c->path[pathLen] = '\0';
+        if (c->numEffects != 0) {
+            c->effects = malloc(c->numEffects * sizeof(effect_descriptor_t));
+            if (fread(c->effects, sizeof(effect_descriptor_t), c->numEffects, f) !=
+                    c->numEffects) {
+                free(c->effects);
+                free(c->path);
+                free(c);
+                break;
+            }
+        }
+        e = malloc(sizeof(list_elem_t));
+        e->object = c;
+        e->next = gDescCache;
+        gDescCache = e;
+    }
+    if (i != header.numLibs) {
+        ALOGW("readDescriptorCache() cache file %s truncated after %u libraries", path, i);
+        gDescCacheDirty = 1;
+    }
+    fclose(f);
+}
+
+void writeDescriptorCache(const char *path)
+{
+    char tmpPath[PATH_MAX];
+    FILE *f;
+    cache_header_t header;
+    list_elem_t *e;
+    int ok = 1;
+
+    snprintf(tmpPath, PATH_MAX, "%s.tmp", path);
+    f = fopen(tmpPath, "wb");
+    if (f == NULL) {
+        ALOGW("writeDescriptorCache() could not create %s", tmpPath);
+        return;
+    }
+
+    header.magic = CACHE_MAGIC;
+    header.version = CACHE_VERSION;
+    header.descSize = sizeof(effect_descriptor_t);
+    header.numLibs = 0;
+    for (e = gLibraryList; e != NULL; e = e->next) {
+        header.numLibs++;
+    }
+    ok = fwrite(&header, sizeof(header), 1, f) == 1;
+
+    for (e = gLibraryList; e != NULL && ok; e = e->next) {
+        lib_entry_t *l = (lib_entry_t *)e->object;
+        uint32_t pathLen = strlen(l->path);
+        uint32_t numEffects = 0;
+        list_elem_t *efx;
+
+        for (efx = l->effects; efx != NULL; efx = efx->next) {
+            numEffects++;
+        }
+        ok = fwrite(&pathLen, sizeof(pathLen), 1, f) == 1 &&
+                fwrite(l->path, pathLen, 1, f) == 1 &&
+                fwrite(&l->mtime, sizeof(l->mtime), 1, f) == 1 &&
+                fwrite(&l->size, sizeof(l->size), 1, f) == 1 &&
+                fwrite(&numEffects, sizeof(numEffects), 1, f) == 1;
+        for (efx = l->effects; efx != NULL && ok; efx = efx->next) {
+            ok = fwrite(efx->object, sizeof(effect_descriptor_t), 1, f) == 1;
+        }
+    }
+
+    if (fclose(f) != 0) {
+        ok = 0;
+    }
+    if (!ok || rename(tmpPath, path) != 0) {
+        ALOGW("writeDescriptorCache() could not write %s", path);
+        unlink(tmpPath);
+        return;
+    }
+    ALOGV("writeDescriptorCache() wrote %u libraries to %s", header.numLibs, path);
+}
+
+void freeDescriptorCache()
+{
+    while (gDescCache) {
+        list_elem_t *e = gDescCache;
+        lib_cache_entry_t *c = (lib_cache_entry_t *)e->object;
+
+        gDescCache = e->next;
+        free(c->effects);
+        free(c->path);
+        free(c);
+        free(e);
+    }
+}
+
+effect_descriptor_t *getCachedDescriptor(lib_entry_t *l, const effect_uuid_t *uuid)
+{
+    list_elem_t *e;
+    uint32_t i;
+
+    for (e = gDescCache; e != NULL; e = e->next) {
+        lib_cache_entry_t *c = (lib_cache_entry_t *)e->object;
+
+        // a library replaced on the file system is queried again
+        if (strcmp(c->path, l->path) != 0 || c->mtime != l->mtime || c->size != l->size) {
+            continue;
+        }
+        for (i = 0; i < c->numEffects; i++) {
+            if (memcmp(&c->effects[i].uuid, uuid, sizeof(effect_uuid_t)) == 0) {
+                return &c->effects[i];
+            }
+        }
+        return NULL;
+    }
+    return NULL;
+}
 
 void resetEffectEnumeration()
 {
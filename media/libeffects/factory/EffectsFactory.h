@@ -32,15 +32,29 @@ typedef struct list_elem_s {
     struct list_elem_s *next;
 } list_elem_t;
 
+// Descriptors of the effects of a library are cached in AUDIO_EFFECT_CACHE_FILE
+// so that the library is only opened when one of its effects is created.
+#define AUDIO_EFFECT_CACHE_FILE "/data/misc/media/audio_effects.cache"
+
 typedef struct lib_entry_s {
-    audio_effect_library_t *desc;
+    audio_effect_library_t *desc; // NULL until the library is opened
     char *name;
     char *path;
-    void *handle;
+    void *handle;                 // NULL until the library is opened
+    int64_t mtime;                // modification time and size of the library file,
+    int64_t size;                 // keys of its entry in the descriptor cache
     list_elem_t *effects; //list of effect_descriptor_t
     pthread_mutex_t lock;
 } lib_entry_t;
 
+typedef struct lib_cache_entry_s {
+    char *path;
+    int64_t mtime;
+    int64_t size;
+    uint32_t numEffects;
+    effect_descriptor_t *effects;
+} lib_cache_entry_t;
+
 typedef struct effect_entry_s {
     struct effect_interface_s *itfe;
     effect_handle_t subItfe;
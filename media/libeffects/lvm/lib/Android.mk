@@ -105,6 +105,10 @@ LOCAL_SRC_FILES:= \
 
 LOCAL_MODULE:= libmusicbundle
 
+ifeq ($(ARCH_ARM_HAVE_NEON),true)
+    LOCAL_ARM_NEON := true
+endif
+
 
 
 LOCAL_C_INCLUDES += \
@@ -168,6 +172,10 @@ LOCAL_SRC_FILES:= \
 
 LOCAL_MODULE:= libreverb
 
+ifeq ($(ARCH_ARM_HAVE_NEON),true)
+    LOCAL_ARM_NEON := true
+endif
+
 
 
 LOCAL_C_INCLUDES += \
@@ -177,3 +185,39 @@ LOCAL_C_INCLUDES += \
     $(LOCAL_PATH)/Common/src
 
 include $(BUILD_STATIC_LIBRARY)
+
+# NEON and C filter kernel benchmark
+include $(CLEAR_VARS)
+
+LOCAL_ARM_MODE := arm
+
+LOCAL_SRC_FILES:= \
+    Common/test/lvm_filter_bench.c \
+    Common/src/BQ_2I_D32F32C30_TRC_WRA_01.c \
+    Common/src/BQ_2I_D32F32Cll_TRC_WRA_01_Init.c \
+    Common/src/PK_2I_D32F32C30G11_TRC_WRA_01.c \
+    Common/src/PK_2I_D32F32C14G11_TRC_WRA_01.c \
+    Common/src/PK_2I_D32F32CssGss_TRC_WRA_01_Init.c \
+    Common/src/PK_2I_D32F32CllGss_TRC_WRA_01_Init.c \
+    Common/src/BQ_2I_D16F32C14_TRC_WRA_01.c \
+    Common/src/BQ_2I_D16F32Css_TRC_WRA_01_init.c \
+    Common/src/FO_2I_D16F32C15_LShx_TRC_WRA_01.c \
+    Common/src/FO_2I_D16F32Css_LShx_TRC_WRA_01_Init.c \
+    Common/src/Core_MixSoft_1St_D32C31_WRA.c \
+    Common/src/Core_MixInSoft_D32C31_SAT.c \
+    Common/src/Core_MixHard_2St_D32C31_SAT.c
+
+LOCAL_CFLAGS += -DLVM_NEON_BENCHMARK
+
+LOCAL_MODULE:= lvm_filter_bench
+LOCAL_MODULE_TAGS := debug
+
+ifeq ($(ARCH_ARM_HAVE_NEON),true)
+    LOCAL_ARM_NEON := true
+endif
+
+LOCAL_C_INCLUDES += \
+    $(LOCAL_PATH)/Common/lib \
+    $(LOCAL_PATH)/Common/src
+
+include $(BUILD_EXECUTABLE)
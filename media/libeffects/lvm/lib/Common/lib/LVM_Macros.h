@@ -32,6 +32,12 @@ extern "C" {
         of overflow is undefined.
 
 ***********************************************************************************/
+#if defined(__arm__) && !defined(MUL32x32INTO32)
+/* SMULL plus a shift is bit exact with the generic version below for ShiftR 1 to 63 */
+#define MUL32x32INTO32(A,B,C,ShiftR)   \
+        {(C) = (LVM_INT32)(((long long)(A) * (LVM_INT32)(B)) >> (ShiftR));}
+#endif
+
 #ifndef MUL32x32INTO32
 #define MUL32x32INTO32(A,B,C,ShiftR)   \
         {LVM_INT32 MUL32x32INTO32_temp,MUL32x32INTO32_temp2,MUL32x32INTO32_mask,MUL32x32INTO32_HH,MUL32x32INTO32_HL,MUL32x32INTO32_LH,MUL32x32INTO32_LL;\
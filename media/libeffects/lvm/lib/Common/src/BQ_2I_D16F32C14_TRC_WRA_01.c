@@ -18,6 +18,7 @@
 #include "BIQUAD.h"
 #include "BQ_2I_D16F32Css_TRC_WRA_01_Private.h"
 #include "LVM_Macros.h"
+#include "LVM_NEON.h"
 
 /**************************************************************************
  ASSUMPTIONS:
@@ -46,6 +47,15 @@ void BQ_2I_D16F32C14_TRC_WRA_01 (           Biquad_Instance_t       *pInstance,
         LVM_INT16 ii;
         PFilter_State pBiquadState = (PFilter_State) pInstance;
 
+#ifdef __ARM_NEON__
+        if (LVM_USE_NEON)
+        {
+            BQ_2I_D16F32_NEON(pBiquadState->coefs, pBiquadState->pDelays,
+                              pDataIn, pDataOut, NrSamples, 14);
+            return;
+        }
+#endif
+
         for (ii = NrSamples; ii != 0; ii--)
         {
 
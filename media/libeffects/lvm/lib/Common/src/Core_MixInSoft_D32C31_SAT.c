@@ -21,6 +21,7 @@
 
 #include "Mixer_private.h"
 #include "LVM_Macros.h"
+#include "LVM_NEON.h"
 
 /**********************************************************************************
    FUNCTION CORE_MIXSOFT_1ST_D32C31_WRA
@@ -73,6 +74,21 @@ void Core_MixInSoft_D32C31_SAT(     Mix_1St_Cll_t       *pInstance,
         pInstance->Current = TargetTimesOneMinAlpha + CurrentTimesAlpha;                /* Q0 + Q0 into Q0*/
         CurrentShort = (LVM_INT16)(pInstance->Current>>16);                             /* From Q31 to Q15*/
 
+#ifdef __ARM_NEON__
+        if (LVM_USE_NEON){
+            /* The saturating shift of the halved sum gives the same clipping as the C code */
+            int32x4_t In = vld1q_s32((const int32_t *)src);
+            int32x4_t Out = vld1q_s32((const int32_t *)dst);
+            int32x4_t Mix = vcombine_s32(vshrn_n_s64(vmull_n_s32(vget_low_s32(In), CurrentShort), 15),
+                                         vshrn_n_s64(vmull_n_s32(vget_high_s32(In), CurrentShort), 15));
+            Out = vqshlq_n_s32(vaddq_s32(vshrq_n_s32(Out, 1), vshrq_n_s32(Mix, 1)), 1);
+            vst1q_s32((int32_t *)dst, Out);
+            src += 4;
+            dst += 4;
+            continue;
+        }
+#endif
+
         for (jj = 4; jj!=0 ; jj--){
         Temp1=*src++;
         Temp2=*dst;
@@ -21,6 +21,7 @@
 
 #include "Mixer_private.h"
 #include "LVM_Macros.h"
+#include "LVM_NEON.h"
 
 /**********************************************************************************
    FUNCTION CORE_MIXSOFT_1ST_D32C31_WRA
@@ -70,6 +71,18 @@ void Core_MixSoft_1St_D32C31_WRA(   Mix_1St_Cll_t       *pInstance,
         MUL32x32INTO32(pInstance->Current,pInstance->Alpha,CurrentTimesAlpha,31)  /* Q31 * Q31 in Q31 */
         pInstance->Current = TargetTimesOneMinAlpha + CurrentTimesAlpha;          /* Q31 + Q31 into Q31*/
         CurrentShort = (LVM_INT16)(pInstance->Current>>16);                       /* From Q31 to Q15*/
+#ifdef __ARM_NEON__
+        if (LVM_USE_NEON)
+        {
+            /* (src * CurrentShort) >> 15 on 4 samples, as MUL32x16INTO32 */
+            int32x4_t In = vld1q_s32((const int32_t *)src);
+            src += 4;
+            vst1q_s32((int32_t *)dst, vcombine_s32(vshrn_n_s64(vmull_n_s32(vget_low_s32(In), CurrentShort), 15),
+                                                   vshrn_n_s64(vmull_n_s32(vget_high_s32(In), CurrentShort), 15)));
+            dst += 4;
+            continue;
+        }
+#endif
             Temp1=*src;
             src++;
 
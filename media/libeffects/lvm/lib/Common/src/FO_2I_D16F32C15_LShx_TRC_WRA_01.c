@@ -18,6 +18,7 @@
 #include "BIQUAD.h"
 #include "FO_2I_D16F32Css_LShx_TRC_WRA_01_Private.h"
 #include "LVM_Macros.h"
+#include "LVM_NEON.h"
 
 /**************************************************************************
 ASSUMPTIONS:
@@ -50,6 +51,37 @@ void FO_2I_D16F32C15_LShx_TRC_WRA_01(Biquad_Instance_t       *pInstance,
 
         Shift = pBiquadState->Shift;
 
+#ifdef __ARM_NEON__
+        if (LVM_USE_NEON)
+        {
+            /* The delays are {xL, yL, xR, yR}, vld2 splits them into {xL, xR} and {yL, yR} */
+            int32x2x2_t delays = vld2_s32((const int32_t *)pBiquadState->pDelays);
+            int32x2_t OutShift = vdup_n_s32(Shift - 15);
+            int32x2_t x0, yn;
+            int16x4_t out;
+
+            for (ii = NrSamples; ii != 0; ii--)
+            {
+                x0 = vdup_n_s32(pDataIn[0]);
+                x0 = vset_lane_s32(pDataIn[1], x0, 1);
+                pDataIn += 2;
+                yn = vmul_n_s32(delays.val[0], pBiquadState->coefs[0]);
+                yn = vmla_n_s32(yn, x0, pBiquadState->coefs[1]);
+                yn = vadd_s32(yn, vshrn_n_s64(vmull_n_s32(delays.val[1], pBiquadState->coefs[2]), 15));
+                delays.val[0] = x0;
+                delays.val[1] = yn;
+
+                /* Shift right by (15-Shift) and saturate to 16 bits */
+                out = vqmovn_s32(vcombine_s32(vshl_s32(yn, OutShift), vdup_n_s32(0)));
+                *pDataOut++ = vget_lane_s16(out, 0);
+                *pDataOut++ = vget_lane_s16(out, 1);
+            }
+
+            vst2_s32((int32_t *)pBiquadState->pDelays, delays);
+            return;
+        }
+#endif
+
 
         for (ii = NrSamples; ii != 0; ii--)
         {
@@ -0,0 +1,133 @@
+/*
+ * Copyright (C) 2012 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __LVM_NEON_H__
+#define __LVM_NEON_H__
+
+/**********************************************************************************
+   INCLUDE FILES
+***********************************************************************************/
+
+#include "LVM_Types.h"
+
+#ifdef __ARM_NEON__
+#include <arm_neon.h>
+
+/**********************************************************************************
+   DEFINITIONS
+***********************************************************************************/
+
+/*
+ * The NEON versions of the stereo filters and the 32-bit mixers process the left and
+ * right channels (or four samples) in parallel.  Every product is shifted and narrowed
+ * on its own exactly as MUL32x32INTO32 and MUL32x16INTO32 do, and the sums wrap or
+ * saturate like the C code, so the output is bit exact.
+ *
+ * LVM_NEON_BENCHMARK builds (lvm_filter_bench) can switch back to the C code at run
+ * time through LVM_NEON_Enabled, to compare both in the same binary.
+ */
+#ifdef LVM_NEON_BENCHMARK
+extern LVM_INT16 LVM_NEON_Enabled;
+#define LVM_USE_NEON    LVM_NEON_Enabled
+#else
+#define LVM_USE_NEON    1
+#endif
+
+/**********************************************************************************
+   FUNCTION BQ_2I_D16F32_NEON
+
+   Shared by BQ_2I_D16F32C13/C14/C15_TRC_WRA_01, which only differ by the Q format
+   CoefShift of their coefficients.
+***********************************************************************************/
+static inline int32x2_t BQ_2I_D16F32_NEON_Frame(int32x2_t          x0,
+                                                int32x2_t          *pX1,
+                                                int32x2_t          *pX2,
+                                                int32x2_t          *pY1,
+                                                int32x2_t          *pY2,
+                                                const LVM_INT16    *pCoefs,
+                                                int32x2_t          DelayShift)
+{
+    int32x2_t yn;
+
+    /* yn = A2 * x(n-2) + A1 * x(n-1) + A0 * x(n) in QCoefShift */
+    yn = vmul_n_s32(*pX2, pCoefs[0]);
+    yn = vmla_n_s32(yn, *pX1, pCoefs[1]);
+    yn = vmla_n_s32(yn, x0, pCoefs[2]);
+
+    /* yn += ((-B2 * y(n-2)) >> 16) + ((-B1 * y(n-1)) >> 16), y in Q16 */
+    yn = vadd_s32(yn, vshrn_n_s64(vmull_n_s32(*pY2, pCoefs[3]), 16));
+    yn = vadd_s32(yn, vshrn_n_s64(vmull_n_s32(*pY1, pCoefs[4]), 16));
+
+    *pX2 = *pX1;
+    *pX1 = x0;
+    *pY2 = *pY1;
+    *pY1 = vshl_s32(yn, DelayShift);
+    return yn;
+}
+
+static inline void BQ_2I_D16F32_NEON(const LVM_INT16    *pCoefs,
+                                     LVM_INT32          *pDelays,
+                                     LVM_INT16          *pDataIn,
+                                     LVM_INT16          *pDataOut,
+                                     LVM_INT16          NrSamples,
+                                     LVM_INT16          CoefShift)
+{
+    int32x2_t x1 = vld1_s32((const int32_t *)pDelays);
+    int32x2_t x2 = vld1_s32((const int32_t *)(pDelays + 2));
+    int32x2_t y1 = vld1_s32((const int32_t *)(pDelays + 4));
+    int32x2_t y2 = vld1_s32((const int32_t *)(pDelays + 6));
+    int32x2_t DelayShift = vdup_n_s32(16 - CoefShift);
+    int32x4_t OutShift = vdupq_n_s32(-CoefShift);
+    int32x4_t in, out;
+    int32x2_t o0, o1;
+    LVM_INT16 tail[4];
+    LVM_INT16 ii;
+
+    /* Two stereo frames per iteration */
+    for (ii = NrSamples >> 1; ii != 0; ii--)
+    {
+        in = vmovl_s16(vld1_s16(pDataIn));
+        pDataIn += 4;
+        o0 = BQ_2I_D16F32_NEON_Frame(vget_low_s32(in), &x1, &x2, &y1, &y2, pCoefs, DelayShift);
+        o1 = BQ_2I_D16F32_NEON_Frame(vget_high_s32(in), &x1, &x2, &y1, &y2, pCoefs, DelayShift);
+        out = vshlq_s32(vcombine_s32(o0, o1), OutShift);
+        vst1_s16(pDataOut, vmovn_s32(out));
+        pDataOut += 4;
+    }
+
+    if (NrSamples & 1)
+    {
+        tail[0] = pDataIn[0];
+        tail[1] = pDataIn[1];
+        tail[2] = 0;
+        tail[3] = 0;
+        in = vmovl_s16(vld1_s16(tail));
+        o0 = BQ_2I_D16F32_NEON_Frame(vget_low_s32(in), &x1, &x2, &y1, &y2, pCoefs, DelayShift);
+        out = vshlq_s32(vcombine_s32(o0, o0), OutShift);
+        vst1_s16(tail, vmovn_s32(out));
+        pDataOut[0] = tail[0];
+        pDataOut[1] = tail[1];
+    }
+
+    vst1_s32((int32_t *)pDelays, x1);
+    vst1_s32((int32_t *)(pDelays + 2), x2);
+    vst1_s32((int32_t *)(pDelays + 4), y1);
+    vst1_s32((int32_t *)(pDelays + 6), y2);
+}
+
+#endif /* __ARM_NEON__ */
+
+#endif /* __LVM_NEON_H__ */
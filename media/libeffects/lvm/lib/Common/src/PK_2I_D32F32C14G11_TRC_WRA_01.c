@@ -18,6 +18,7 @@
 #include "BIQUAD.h"
 #include "PK_2I_D32F32CssGss_TRC_WRA_01_Private.h"
 #include "LVM_Macros.h"
+#include "LVM_NEON.h"
 
 /**************************************************************************
  ASSUMPTIONS:
@@ -47,6 +48,40 @@ void PK_2I_D32F32C14G11_TRC_WRA_01 ( Biquad_Instance_t       *pInstance,
         LVM_INT16 ii;
         PFilter_State pBiquadState = (PFilter_State) pInstance;
 
+#ifdef __ARM_NEON__
+        if (LVM_USE_NEON)
+        {
+            /* Left and right in the two lanes, each product shifted as by MUL32x16INTO32 */
+            int32x2_t x1 = vld1_s32((const int32_t *)pBiquadState->pDelays);
+            int32x2_t x2 = vld1_s32((const int32_t *)(pBiquadState->pDelays + 2));
+            int32x2_t y1 = vld1_s32((const int32_t *)(pBiquadState->pDelays + 4));
+            int32x2_t y2 = vld1_s32((const int32_t *)(pBiquadState->pDelays + 6));
+            int32x2_t x0, yn;
+
+            for (ii = NrSamples; ii != 0; ii--)
+            {
+                x0 = vld1_s32((const int32_t *)pDataIn);
+                pDataIn += 2;
+                yn = vshrn_n_s64(vmull_n_s32(vsub_s32(x0, x2), pBiquadState->coefs[0]), 14);
+                yn = vadd_s32(yn, vshrn_n_s64(vmull_n_s32(y2, pBiquadState->coefs[1]), 14));
+                yn = vadd_s32(yn, vshrn_n_s64(vmull_n_s32(y1, pBiquadState->coefs[2]), 14));
+                x2 = x1;
+                x1 = x0;
+                y2 = y1;
+                y1 = yn;
+                yn = vadd_s32(vshrn_n_s64(vmull_n_s32(yn, pBiquadState->coefs[3]), 11), x0);
+                vst1_s32((int32_t *)pDataOut, yn);
+                pDataOut += 2;
+            }
+
+            vst1_s32((int32_t *)pBiquadState->pDelays, x1);
+            vst1_s32((int32_t *)(pBiquadState->pDelays + 2), x2);
+            vst1_s32((int32_t *)(pBiquadState->pDelays + 4), y1);
+            vst1_s32((int32_t *)(pBiquadState->pDelays + 6), y2);
+            return;
+        }
+#endif
+
          for (ii = NrSamples; ii != 0; ii--)
          {
 
@@ -0,0 +1,239 @@
+/*
+ * Copyright (C) 2012 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Runs the stereo filters and 32-bit mixers of the LVM Common library that
+// have NEON versions over random input, once with LVM_NEON_Enabled cleared
+// and once with it set. Reports the time per stereo frame of both for a
+// range of block sizes and fails if their outputs or filter states differ.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "BIQUAD.h"
+#include "Mixer.h"
+#include "LVM_NEON.h"
+
+LVM_INT16 LVM_NEON_Enabled = 1;
+
+#define MAX_FRAMES  512
+#define TOTAL_FRAMES (1 << 20)
+
+static LVM_INT32 gIn32[MAX_FRAMES * 2];
+static LVM_INT32 gOut32[2][MAX_FRAMES * 2];
+static LVM_INT16 gIn16[MAX_FRAMES * 2];
+static LVM_INT16 gOut16[2][MAX_FRAMES * 2];
+
+typedef struct
+{
+    Biquad_Instance_t       Instance;
+    Biquad_2I_Order2_Taps_t Taps;
+    Biquad_2I_Order1_Taps_t FOTaps;
+    Mix_1St_Cll_t           Mix1;
+    Mix_2St_Cll_t           Mix2;
+} State_t;
+
+typedef void (*Init_t)(State_t *pState);
+typedef void (*Run_t)(State_t *pState, int pass, LVM_INT16 n);
+
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* Stable filters at 44.1 kHz in the Q formats the kernels expect */
+static void initBQ32(State_t *pState)
+{
+    BQ_C32_Coefs_t Coefs = { 1060974118, -2136678637, 1077507553, -1060974118, 2119269259 };
+    BQ_2I_D32F32Cll_TRC_WRA_01_Init(&pState->Instance, &pState->Taps, &Coefs);
+}
+
+static void runBQ32(State_t *pState, int pass, LVM_INT16 n)
+{
+    BQ_2I_D32F32C30_TRC_WRA_01(&pState->Instance, gIn32, gOut32[pass], n);
+}
+
+static void initPK30(State_t *pState)
+{
+    PK_C32_Coefs_t Coefs = { 24657017, -1024124245, 2023027543, 1024 };
+    PK_2I_D32F32CllGss_TRC_WRA_01_Init(&pState->Instance, &pState->Taps, &Coefs);
+}
+
+static void runPK30(State_t *pState, int pass, LVM_INT16 n)
+{
+    PK_2I_D32F32C30G11_TRC_WRA_01(&pState->Instance, gIn32, gOut32[pass], n);
+}
+
+static void initPK14(State_t *pState)
+{
+    PK_C16_Coefs_t Coefs = { 376, -15627, 30868, 1024 };
+    PK_2I_D32F32CssGss_TRC_WRA_01_Init(&pState->Instance, &pState->Taps, &Coefs);
+}
+
+static void runPK14(State_t *pState, int pass, LVM_INT16 n)
+{
+    PK_2I_D32F32C14G11_TRC_WRA_01(&pState->Instance, gIn32, gOut32[pass], n);
+}
+
+static void initBQ16(State_t *pState)
+{
+    BQ_C16_Coefs_t Coefs = { 7140, -14104, 7140, -7426, 15026 };
+    BQ_2I_D16F32Css_TRC_WRA_01_Init(&pState->Instance, &pState->Taps, &Coefs);
+}
+
+static void runBQ16(State_t *pState, int pass, LVM_INT16 n)
+{
+    BQ_2I_D16F32C14_TRC_WRA_01(&pState->Instance, gIn16, gOut16[pass], n);
+}
+
+static void initFO16(State_t *pState)
+{
+    FO_C16_LShx_Coefs_t Coefs = { -22384, 22384, 12000, 2 };
+    FO_2I_D16F32Css_LShx_TRC_WRA_01_Init(&pState->Instance, &pState->FOTaps, &Coefs);
+}
+
+static void runFO16(State_t *pState, int pass, LVM_INT16 n)
+{
+    FO_2I_D16F32C15_LShx_TRC_WRA_01(&pState->Instance, gIn16, gOut16[pass], n);
+}
+
+static void initMix(State_t *pState)
+{
+    memset(&pState->Mix1, 0, sizeof(pState->Mix1));
+    memset(&pState->Mix2, 0, sizeof(pState->Mix2));
+    pState->Mix1.Alpha = 0x7FF00000;
+    pState->Mix1.Target = 0x7FFFFFFF;
+    pState->Mix2.Current1 = 0x5A000000;
+    pState->Mix2.Current2 = 0x40000000;
+}
+
+static void runMixSoft(State_t *pState, int pass, LVM_INT16 n)
+{
+    Core_MixSoft_1St_D32C31_WRA(&pState->Mix1, gIn32, gOut32[pass], (LVM_INT16)(n * 2));
+}
+
+static void runMixInSoft(State_t *pState, int pass, LVM_INT16 n)
+{
+    memcpy(gOut32[pass], gIn32 + 1, (n * 2 - 1) * sizeof(LVM_INT32));
+    Core_MixInSoft_D32C31_SAT(&pState->Mix1, gIn32, gOut32[pass], (LVM_INT16)(n * 2));
+}
+
+static void runMixHard(State_t *pState, int pass, LVM_INT16 n)
+{
+    Core_MixHard_2St_D32C31_SAT(&pState->Mix2, gIn32, gIn32 + 1, gOut32[pass],
+                                (LVM_INT16)(n * 2 - 1));
+}
+
+typedef struct
+{
+    const char  *pName;
+    Init_t      init;
+    Run_t       run;
+} Kernel_t;
+
+static const Kernel_t kKernels[] = {
+    { "BQ_2I_D32F32C30",    initBQ32,   runBQ32 },
+    { "PK_2I_D32F32C30G11", initPK30,   runPK30 },
+    { "PK_2I_D32F32C14G11", initPK14,   runPK14 },
+    { "BQ_2I_D16F32C14",    initBQ16,   runBQ16 },
+    { "FO_2I_D16F32C15",    initFO16,   runFO16 },
+    { "Core_MixSoft_1St",   initMix,    runMixSoft },
+    { "Core_MixInSoft",     initMix,    runMixInSoft },
+    { "Core_MixHard_2St",   initMix,    runMixHard },
+};
+
+static void fillInput(LVM_INT32 amplitude)
+{
+    int i;
+    for (i = 0; i < MAX_FRAMES * 2; i++) {
+        LVM_INT32 r = (LVM_INT32)(((lrand48() & 0xFFFF) - 0x8000) << 15);
+        gIn32[i] = (LVM_INT32)(((long long)r * amplitude) >> 31);
+        gIn16[i] = (LVM_INT16)(gIn32[i] >> 16);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    static const LVM_INT16 kBlockSizes[] = { 16, 32, 64, 128, 256, 512 };
+    int failed = 0;
+    size_t k, b;
+
+    (void)argc;
+    (void)argv;
+    srand48(1);
+
+#ifndef __ARM_NEON__
+    printf("built without NEON, both passes run the C code\n");
+#endif
+    printf("%-20s %6s %10s %10s %8s\n", "kernel", "frames", "C ns", "NEON ns", "speedup");
+
+    for (k = 0; k < sizeof(kKernels) / sizeof(kKernels[0]); k++) {
+        const Kernel_t *pKernel = &kKernels[k];
+        for (b = 0; b < sizeof(kBlockSizes) / sizeof(kBlockSizes[0]); b++) {
+            LVM_INT16 n = kBlockSizes[b];
+            State_t state[2];
+            double elapsed[2];
+            int pass, i;
+
+            for (pass = 0; pass < 2; pass++) {
+                memset(&state[pass], 0, sizeof(state[pass]));
+                pKernel->init(&state[pass]);
+            }
+
+            /* check bit exactness first, loud blocks exercise wrapping and clipping */
+            srand48(k * 100 + b);
+            for (i = 0; i < 64; i++) {
+                fillInput((i & 1) ? 0x7FFFFFFF : 0x10000000);
+                for (pass = 0; pass < 2; pass++) {
+                    LVM_NEON_Enabled = (LVM_INT16)pass;
+                    pKernel->run(&state[pass], pass, n);
+                }
+                if (memcmp(gOut32[0], gOut32[1], sizeof(gOut32[0])) != 0 ||
+                    memcmp(gOut16[0], gOut16[1], sizeof(gOut16[0])) != 0) {
+                    failed = 1;
+                }
+            }
+            if (memcmp(&state[0].Taps, &state[1].Taps, sizeof(state[0].Taps)) != 0 ||
+                memcmp(&state[0].FOTaps, &state[1].FOTaps, sizeof(state[0].FOTaps)) != 0 ||
+                memcmp(&state[0].Mix1, &state[1].Mix1, sizeof(state[0].Mix1)) != 0 ||
+                memcmp(&state[0].Mix2, &state[1].Mix2, sizeof(state[0].Mix2)) != 0) {
+                failed = 1;
+            }
+
+            fillInput(0x10000000);
+            for (pass = 0; pass < 2; pass++) {
+                double start = now();
+                LVM_NEON_Enabled = (LVM_INT16)pass;
+                for (i = 0; i < TOTAL_FRAMES / n; i++) {
+                    pKernel->run(&state[pass], pass, n);
+                }
+                elapsed[pass] = now() - start;
+            }
+
+            printf("%-20s %6d %10.2f %10.2f %7.2fx\n", pKernel->pName, n,
+                   elapsed[0] * 1e9 / TOTAL_FRAMES, elapsed[1] * 1e9 / TOTAL_FRAMES,
+                   elapsed[1] > 0 ? elapsed[0] / elapsed[1] : 0);
+            if (failed) {
+                printf("%s: NEON output differs from the C output\n", pKernel->pName);
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
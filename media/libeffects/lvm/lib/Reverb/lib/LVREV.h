@@ -84,6 +84,15 @@ typedef enum
 } LVREV_NumDelayLines_en;
 
 
+/* Late reverberation processing rate */
+typedef enum
+{
+    LVREV_LATE_FULLRATE    = 0,                         /* Delay lines run at the sample rate */
+    LVREV_LATE_HALFRATE    = 1,                         /* Delay lines run at half the sample rate */
+    LVREV_LATERATE_DUMMY   = LVM_MAXENUM
+} LVREV_LateRate_en;
+
+
 /****************************************************************************************/
 /*                                                                                      */
 /*  Structures                                                                          */
@@ -113,6 +122,7 @@ typedef struct
     LVM_UINT16                  Density;                /* Echo density, 0 to 100 for minimum to maximum density */
     LVM_UINT16                  Damping;                /* Damping */
     LVM_UINT16                  RoomSize;               /* Simulated room size, 1 to 100 for minimum to maximum size */
+    LVREV_LateRate_en           LateRate;               /* Rate of the delay lines, half rate trades quality for load */
 
 } LVREV_ControlParams_st;
 
@@ -46,6 +46,8 @@ LVREV_ReturnStatus_en LVREV_ApplyNewSettings (LVREV_Instance_st     *pPrivate)
 
     LVM_Mode_en  OperatingMode;
     LVM_INT32    NumberOfDelayLines;
+    LVM_Fs_en    LateSampleRate;
+    LVM_INT16    bLateRateChange;
 
 
     /* Check for NULL pointer */
@@ -69,6 +71,28 @@ LVREV_ReturnStatus_en LVREV_ApplyNewSettings (LVREV_Instance_st     *pPrivate)
         NumberOfDelayLines = 1;
     }
 
+    /*
+     * Select the sample rate of the delay lines, half rate is only used from 16kHz up.
+     * LVM_FS_16000 to LVM_FS_48000 are in the same order as their halves LVM_FS_8000
+     * to LVM_FS_24000.
+     */
+    LateSampleRate = pPrivate->NewParams.SampleRate;
+    if((pPrivate->NewParams.LateRate   == LVREV_LATE_HALFRATE) &&
+       (pPrivate->NewParams.SampleRate >= LVM_FS_16000))
+    {
+        LateSampleRate = (LVM_Fs_en)(pPrivate->NewParams.SampleRate - (LVM_FS_16000 - LVM_FS_8000));
+    }
+    bLateRateChange = (LVM_INT16)(LateSampleRate != pPrivate->LateSampleRate);
+
+    /*
+     * The delay lines hold samples at the old rate, replaying them at the new one would
+     * shift the pitch of the tail
+     */
+    if((bLateRateChange == LVM_TRUE) && (pPrivate->bFirstControl == LVM_FALSE))
+    {
+        LVREV_ClearAudioBuffers((LVREV_Handle_t)pPrivate);
+    }
+
     /*
      * Update the high pass filter coefficients
      */
@@ -93,18 +117,29 @@ LVREV_ReturnStatus_en LVREV_ApplyNewSettings (LVREV_Instance_st     *pPrivate)
      */
     if((pPrivate->NewParams.LPF        != pPrivate->CurrentParams.LPF)        ||
        (pPrivate->NewParams.SampleRate != pPrivate->CurrentParams.SampleRate) ||
+       (bLateRateChange                == LVM_TRUE)                           ||
        (pPrivate->bFirstControl        == LVM_TRUE))
     {
         LVM_INT32       Omega;
         FO_C32_Coefs_t  Coeffs;
+        LVM_UINT16      LPF = pPrivate->NewParams.LPF;
 
 
+        /*
+         * At half rate the filter also limits what aliases when decimating
+         */
+        if((LateSampleRate != pPrivate->NewParams.SampleRate) &&
+           (LPF > (LVM_FsTable[LateSampleRate] >> 1)))
+        {
+            LPF = (LVM_UINT16)(LVM_FsTable[LateSampleRate] >> 1);
+        }
+
         Coeffs.A0 = 0x7FFFFFFF;
         Coeffs.A1 = 0;
         Coeffs.B1 = 0;
-        if(pPrivate->NewParams.LPF <= (LVM_FsTable[pPrivate->NewParams.SampleRate] >> 1))
+        if(LPF <= (LVM_FsTable[pPrivate->NewParams.SampleRate] >> 1))
         {
-            Omega = LVM_GetOmega(pPrivate->NewParams.LPF, pPrivate->NewParams.SampleRate);
+            Omega = LVM_GetOmega(LPF, pPrivate->NewParams.SampleRate);
 
             /*
              * Do not apply filter if w =2*pi*fc/fs >= 2.9
@@ -139,13 +174,13 @@ LVREV_ReturnStatus_en LVREV_ApplyNewSettings (LVREV_Instance_st     *pPrivate)
      * Update the T delay number of samples and the all pass delay number of samples
      */
     if( (pPrivate->NewParams.RoomSize   != pPrivate->CurrentParams.RoomSize)   ||
-        (pPrivate->NewParams.SampleRate != pPrivate->CurrentParams.SampleRate) ||
+        (bLateRateChange                == LVM_TRUE)                           ||
         (pPrivate->bFirstControl        == LVM_TRUE))
     {
 
         LVM_UINT32  Temp;
         LVM_INT32   APDelaySize;
-        LVM_INT32   Fs = LVM_GetFsFromTable(pPrivate->NewParams.SampleRate);
+        LVM_INT32   Fs = LVM_GetFsFromTable(LateSampleRate);
         LVM_UINT32  DelayLengthSamples = (LVM_UINT32)(Fs * pPrivate->RoomSizeInms);
         LVM_INT16   i;
         LVM_INT16   ScaleTable[]  = {LVREV_T_3_Power_minus0_on_4, LVREV_T_3_Power_minus1_on_4, LVREV_T_3_Power_minus2_on_4, LVREV_T_3_Power_minus3_on_4};
@@ -228,6 +263,10 @@ LVREV_ReturnStatus_en LVREV_ApplyNewSettings (LVREV_Instance_st     *pPrivate)
          * Limit the maximum block length
          */
         pPrivate->MaxBlkLen=pPrivate->MaxBlkLen-2;                                  /* Just as a precausion, but no problem if we remove this line      */
+        if(LateSampleRate != pPrivate->NewParams.SampleRate)
+        {
+            pPrivate->MaxBlkLen = pPrivate->MaxBlkLen << 1;                         /* Half rate, a block only moves the delays by half its length     */
+        }
         if(pPrivate->MaxBlkLen > pPrivate->InstanceParams.MaxBlockSize)
         {
             pPrivate->MaxBlkLen = (LVM_INT32)pPrivate->InstanceParams.MaxBlockSize;
@@ -239,7 +278,7 @@ LVREV_ReturnStatus_en LVREV_ApplyNewSettings (LVREV_Instance_st     *pPrivate)
      * Update the low pass filter coefficient
      */
     if( (pPrivate->NewParams.Damping    != pPrivate->CurrentParams.Damping)    ||
-        (pPrivate->NewParams.SampleRate != pPrivate->CurrentParams.SampleRate) ||
+        (bLateRateChange                == LVM_TRUE)                           ||
         (pPrivate->bFirstControl        == LVM_TRUE))
     {
 
@@ -264,9 +303,9 @@ LVREV_ReturnStatus_en LVREV_ApplyNewSettings (LVREV_Instance_st     *pPrivate)
             {
                 Temp = Damping;
             }
-            if(Temp <= (LVM_FsTable[pPrivate->NewParams.SampleRate] >> 1))
+            if(Temp <= (LVM_FsTable[LateSampleRate] >> 1))
             {
-                Omega = LVM_GetOmega((LVM_UINT16)Temp, pPrivate->NewParams.SampleRate);
+                Omega = LVM_GetOmega((LVM_UINT16)Temp, LateSampleRate);
                 LVM_FO_LPF(Omega, &Coeffs);
             }
             else
@@ -284,12 +323,12 @@ LVREV_ReturnStatus_en LVREV_ApplyNewSettings (LVREV_Instance_st     *pPrivate)
      * Update All-pass filter mixer time constants
      */
     if( (pPrivate->NewParams.RoomSize   != pPrivate->CurrentParams.RoomSize)   ||
-        (pPrivate->NewParams.SampleRate != pPrivate->CurrentParams.SampleRate) ||
+        (bLateRateChange                == LVM_TRUE)                           ||
         (pPrivate->NewParams.Density    != pPrivate->CurrentParams.Density))
     {
         LVM_INT16   i;
-        LVM_INT32   Alpha    = (LVM_INT32)LVM_Mixer_TimeConstant(LVREV_ALLPASS_TC, LVM_GetFsFromTable(pPrivate->NewParams.SampleRate), 1);
-        LVM_INT32   AlphaTap = (LVM_INT32)LVM_Mixer_TimeConstant(LVREV_ALLPASS_TAP_TC, LVM_GetFsFromTable(pPrivate->NewParams.SampleRate), 1);
+        LVM_INT32   Alpha    = (LVM_INT32)LVM_Mixer_TimeConstant(LVREV_ALLPASS_TC, LVM_GetFsFromTable(LateSampleRate), 1);
+        LVM_INT32   AlphaTap = (LVM_INT32)LVM_Mixer_TimeConstant(LVREV_ALLPASS_TAP_TC, LVM_GetFsFromTable(LateSampleRate), 1);
 
         for (i=0; i<4; i++)
         {
@@ -493,21 +532,30 @@ LVREV_ReturnStatus_en LVREV_ApplyNewSettings (LVREV_Instance_st     *pPrivate)
 
 
     /*
-     * Update the bypass mixer time constant
+     * Update the feedback mixer time constant
      */
-    if((pPrivate->NewParams.SampleRate   != pPrivate->CurrentParams.SampleRate)   ||
+    if((bLateRateChange                  == LVM_TRUE)                             ||
        (pPrivate->bFirstControl          == LVM_TRUE))
     {
         LVM_UINT16   NumChannels = 1;                       /* Assume MONO format */
         LVM_INT32    Alpha;
 
-        Alpha = (LVM_INT32)LVM_Mixer_TimeConstant(LVREV_FEEDBACKMIXER_TC, LVM_GetFsFromTable(pPrivate->NewParams.SampleRate), NumChannels);
+        Alpha = (LVM_INT32)LVM_Mixer_TimeConstant(LVREV_FEEDBACKMIXER_TC, LVM_GetFsFromTable(LateSampleRate), NumChannels);
         pPrivate->FeedbackMixer[0].Alpha=Alpha;
         pPrivate->FeedbackMixer[1].Alpha=Alpha;
         pPrivate->FeedbackMixer[2].Alpha=Alpha;
         pPrivate->FeedbackMixer[3].Alpha=Alpha;
+    }
+
+
+    /*
+     * Update the bypass mixer time constant
+     */
+    if((pPrivate->NewParams.SampleRate   != pPrivate->CurrentParams.SampleRate)   ||
+       (pPrivate->bFirstControl          == LVM_TRUE))
+    {
+        LVM_UINT16   NumChannels = 2;                       /* Always stereo output */
 
-        NumChannels = 2;                                    /* Always stereo output */
         pPrivate->BypassMixer.Alpha1 = (LVM_INT32)LVM_Mixer_TimeConstant(LVREV_BYPASSMIXER_TC, LVM_GetFsFromTable(pPrivate->NewParams.SampleRate), NumChannels);
         pPrivate->BypassMixer.Alpha2 = pPrivate->BypassMixer.Alpha1;
         pPrivate->GainMixer.Alpha    = pPrivate->BypassMixer.Alpha1;
@@ -580,6 +628,7 @@ LVREV_ReturnStatus_en LVREV_ApplyNewSettings (LVREV_Instance_st     *pPrivate)
      */
     pPrivate->CurrentParams = pPrivate->NewParams;
     pPrivate->CurrentParams.OperatingMode = OperatingMode;
+    pPrivate->LateSampleRate = LateSampleRate;
 
 
     /*
@@ -98,6 +98,11 @@ LVREV_ReturnStatus_en LVREV_ClearAudioBuffers(LVREV_Handle_t  hInstance)
         LoadConst_32(0,pLVREV_Private->pDelay_T[0], (LVM_INT16)LVREV_MAX_T0_DELAY);
     }
 
+    pLVREV_Private->HalfRatePhase     = 0;
+    pLVREV_Private->HalfRateInput     = 0;
+    pLVREV_Private->HalfRateOutput[0] = 0;
+    pLVREV_Private->HalfRateOutput[1] = 0;
+
     return LVREV_SUCCESS;
 }
 
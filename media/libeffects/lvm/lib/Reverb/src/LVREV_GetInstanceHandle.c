@@ -217,6 +217,7 @@ LVREV_ReturnStatus_en LVREV_GetInstanceHandle(LVREV_Handle_t            *phInsta
     pLVREV_Private->CurrentParams.SampleRate    = LVM_FS_INVALID;
     pLVREV_Private->CurrentParams.OperatingMode = LVM_MODE_DUMMY;
     pLVREV_Private->CurrentParams.SourceFormat  = LVM_SOURCE_DUMMY;
+    pLVREV_Private->LateSampleRate              = LVM_FS_INVALID;
 
     pLVREV_Private->bControlPending             = LVM_FALSE;
     pLVREV_Private->bFirstControl               = LVM_TRUE;
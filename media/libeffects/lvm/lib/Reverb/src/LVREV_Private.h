@@ -130,6 +130,7 @@ typedef struct
     LVM_CHAR                bDisableReverb;             /* Flag to indicate that the mix level is 0% and the reverb can be disabled */
     LVM_INT32               RoomSizeInms;               /* Room size in msec */
     LVM_INT32               MaxBlkLen;                  /* Maximum block size for internal processing */
+    LVM_Fs_en               LateSampleRate;             /* Sample rate the delay lines run at */
 
     /* Aligned memory pointers */
     LVREV_FastData_st       *pFastData;                 /* Fast data memory base address */
@@ -159,6 +160,11 @@ typedef struct
     LVM_INT16               Gain;                       /* Gain applied to output to maintain average signal power */
     Mix_1St_Cll_t           GainMixer;                  /* Gain smoothing */
 
+    /* Half rate delay lines */
+    LVM_INT16               HalfRatePhase;              /* 1 when a full rate input sample is pending */
+    LVM_INT32               HalfRateInput;              /* Pending full rate input sample */
+    LVM_INT32               HalfRateOutput[2];          /* Last half rate stereo output */
+
 } LVREV_Instance_st;
 
 
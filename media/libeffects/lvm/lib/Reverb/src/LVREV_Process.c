@@ -23,6 +23,11 @@
 #include "LVREV_Private.h"
 #include "VectorArithmetic.h"
 
+static void ReverbDelayLines(LVREV_Instance_st *pPrivate, LVM_INT32 *pTemp, LVM_UINT16 NumSamples);
+static LVM_INT16 HalfRate_Decimate(LVREV_Instance_st *pPrivate, LVM_INT32 *pData, LVM_INT16 NumSamples);
+static void HalfRate_Interpolate(LVREV_Instance_st *pPrivate, const LVM_INT32 *pSrc,
+                                 LVM_INT32 *pDst, LVM_INT16 NumSamples);
+
 
 /****************************************************************************************/
 /*                                                                                      */
@@ -178,13 +183,11 @@ LVREV_ReturnStatus_en LVREV_Process(LVREV_Handle_t      hInstance,
 
 void ReverbBlock(LVM_INT32 *pInput, LVM_INT32 *pOutput, LVREV_Instance_st *pPrivate, LVM_UINT16 NumSamples)
 {
-    LVM_INT16   j, size;
-    LVM_INT32   *pDelayLine;
-    LVM_INT32   *pDelayLineInput = pPrivate->pScratch;
-    LVM_INT32   *pScratch = pPrivate->pScratch;
+    LVM_INT16   size;
+    LVM_INT16   LateSamples;
     LVM_INT32   *pIn;
     LVM_INT32   *pTemp = pPrivate->pInputSave;
-    LVM_INT32   NumberOfDelayLines;
+    LVM_INT32   *pWet;
 
     /******************************************************************************
      * All calculations will go into the buffer pointed to by pTemp, this will    *
@@ -201,19 +204,6 @@ void ReverbBlock(LVM_INT32 *pInput, LVM_INT32 *pOutput, LVREV_Instance_st *pPriv
      * and the final output is converted to STEREO after the mixer                *
      ******************************************************************************/
 
-    if(pPrivate->InstanceParams.NumDelays == LVREV_DELAYLINES_4 )
-    {
-        NumberOfDelayLines = 4;
-    }
-    else if(pPrivate->InstanceParams.NumDelays == LVREV_DELAYLINES_2 )
-    {
-        NumberOfDelayLines = 2;
-    }
-    else
-    {
-        NumberOfDelayLines = 1;
-    }
-
     if(pPrivate->CurrentParams.SourceFormat == LVM_MONO)
     {
         pIn = pInput;
@@ -251,6 +241,95 @@ void ReverbBlock(LVM_INT32 *pInput, LVM_INT32 *pOutput, LVREV_Instance_st *pPriv
                                 pTemp,
                                 (LVM_INT16)NumSamples);
 
+    /*
+     *  Late reverberation, at half rate the stereo output of the delay lines is
+     *  interpolated straight into the output buffer
+     */
+    if(pPrivate->LateSampleRate != pPrivate->CurrentParams.SampleRate)
+    {
+        LateSamples = HalfRate_Decimate(pPrivate, pTemp, (LVM_INT16)NumSamples);
+        if(LateSamples != 0)
+        {
+            ReverbDelayLines(pPrivate, pTemp, (LVM_UINT16)LateSamples);
+        }
+        HalfRate_Interpolate(pPrivate, pTemp, pOutput, (LVM_INT16)NumSamples);
+        pWet = pOutput;
+    }
+    else
+    {
+        ReverbDelayLines(pPrivate, pTemp, NumSamples);
+        pWet = pTemp;
+    }
+
+
+    /*
+     *  Dry/wet mixer
+     */
+
+    size = (LVM_INT16)(NumSamples << 1);
+    MixSoft_2St_D32C31_SAT(&pPrivate->BypassMixer,
+                           pWet,
+                           pWet,
+                           pOutput,
+                           size);
+
+    /* Apply Gain*/
+
+    Shift_Sat_v32xv32 (LVREV_OUTPUTGAIN_SHIFT,
+                       pOutput,
+                       pOutput,
+                       size);
+
+    MixSoft_1St_D32C31_WRA(&pPrivate->GainMixer,
+                           pOutput,
+                           pOutput,
+                           size);
+
+    return;
+}
+
+
+/****************************************************************************************/
+/*                                                                                      */
+/* FUNCTION:                ReverbDelayLines                                            */
+/*                                                                                      */
+/* DESCRIPTION:                                                                         */
+/*  Runs the delay lines of the LVREV module at the late reverberation sample rate.    */
+/*                                                                                      */
+/* PARAMETERS:                                                                          */
+/*  pPrivate                Pointer to the instance private parameters                  */
+/*  pTemp                   Mono input, replaced by the stereo output                   */
+/*  NumSamples              Number of samples at the late reverberation sample rate     */
+/*                                                                                      */
+/* RETURNS:                                                                             */
+/*  void                                                                                */
+/*                                                                                      */
+/* NOTES:                                                                               */
+/*  1. pTemp must hold 2 * NumSamples samples                                           */
+/*                                                                                      */
+/****************************************************************************************/
+
+static void ReverbDelayLines(LVREV_Instance_st *pPrivate, LVM_INT32 *pTemp, LVM_UINT16 NumSamples)
+{
+    LVM_INT16   j;
+    LVM_INT32   *pDelayLine;
+    LVM_INT32   *pDelayLineInput = pPrivate->pScratch;
+    LVM_INT32   *pScratch = pPrivate->pScratch;
+    LVM_INT32   NumberOfDelayLines;
+
+    if(pPrivate->InstanceParams.NumDelays == LVREV_DELAYLINES_4 )
+    {
+        NumberOfDelayLines = 4;
+    }
+    else if(pPrivate->InstanceParams.NumDelays == LVREV_DELAYLINES_2 )
+    {
+        NumberOfDelayLines = 2;
+    }
+    else
+    {
+        NumberOfDelayLines = 1;
+    }
+
     /*
      *  Process all delay lines
      */
@@ -453,31 +532,105 @@ void ReverbBlock(LVM_INT32 *pInput, LVM_INT32 *pOutput, LVREV_Instance_st *pPriv
             break;
     }
 
+    return;
+}
 
-    /*
-     *  Dry/wet mixer
-     */
 
-    size = (LVM_INT16)(NumSamples << 1);
-    MixSoft_2St_D32C31_SAT(&pPrivate->BypassMixer,
-                           pTemp,
-                           pTemp,
-                           pOutput,
-                           size);
+/****************************************************************************************/
+/*                                                                                      */
+/* FUNCTION:                HalfRate_Decimate                                           */
+/*                                                                                      */
+/* DESCRIPTION:                                                                         */
+/*  Averages pairs of mono samples, in place. A sample left over at the end of the      */
+/*  block is paired with the first one of the next block.                               */
+/*                                                                                      */
+/* PARAMETERS:                                                                          */
+/*  pPrivate                Pointer to the instance private parameters                  */
+/*  pData                   Full rate input, replaced by the half rate output           */
+/*  NumSamples              Number of full rate samples                                 */
+/*                                                                                      */
+/* RETURNS:                                                                             */
+/*  The number of half rate samples                                                     */
+/*                                                                                      */
+/****************************************************************************************/
 
-    /* Apply Gain*/
+static LVM_INT16 HalfRate_Decimate(LVREV_Instance_st *pPrivate, LVM_INT32 *pData, LVM_INT16 NumSamples)
+{
+    LVM_INT16   ii;
+    LVM_INT16   Phase = pPrivate->HalfRatePhase;
+    LVM_INT32   Pending = pPrivate->HalfRateInput;
+    LVM_INT32   *pDst = pData;
 
-    Shift_Sat_v32xv32 (LVREV_OUTPUTGAIN_SHIFT,
-                       pOutput,
-                       pOutput,
-                       size);
+    for (ii = 0; ii < NumSamples; ii++)
+    {
+        if (Phase == 0)
+        {
+            Pending = pData[ii];
+        }
+        else
+        {
+            *pDst++ = (Pending >> 1) + (pData[ii] >> 1);
+        }
+        Phase ^= 1;
+    }
+    pPrivate->HalfRateInput = Pending;
 
-    MixSoft_1St_D32C31_WRA(&pPrivate->GainMixer,
-                           pOutput,
-                           pOutput,
-                           size);
+    return (LVM_INT16)(pDst - pData);
+}
 
-    return;
+
+/****************************************************************************************/
+/*                                                                                      */
+/* FUNCTION:                HalfRate_Interpolate                                        */
+/*                                                                                      */
+/* DESCRIPTION:                                                                         */
+/*  Two phase interpolator for the stereo output of the delay lines. The full rate      */
+/*  sample that completes a decimated pair gets the mean of the last two half rate      */
+/*  outputs, the other one repeats the last output.                                     */
+/*                                                                                      */
+/* PARAMETERS:                                                                          */
+/*  pPrivate                Pointer to the instance private parameters                  */
+/*  pSrc                    Half rate stereo input                                      */
+/*  pDst                    Full rate stereo output                                     */
+/*  NumSamples              Number of full rate samples (stereo frames)                 */
+/*                                                                                      */
+/* RETURNS:                                                                             */
+/*  void                                                                                */
+/*                                                                                      */
+/* NOTES:                                                                               */
+/*  1. Must be called after HalfRate_Decimate with the same NumSamples                  */
+/*                                                                                      */
+/****************************************************************************************/
+
+static void HalfRate_Interpolate(LVREV_Instance_st *pPrivate, const LVM_INT32 *pSrc,
+                                 LVM_INT32 *pDst, LVM_INT16 NumSamples)
+{
+    LVM_INT16   ii;
+    LVM_INT16   Phase = pPrivate->HalfRatePhase;
+    LVM_INT32   Left  = pPrivate->HalfRateOutput[0];
+    LVM_INT32   Right = pPrivate->HalfRateOutput[1];
+
+    for (ii = NumSamples; ii != 0; ii--)
+    {
+        if (Phase == 0)
+        {
+            pDst[0] = Left;
+            pDst[1] = Right;
+        }
+        else
+        {
+            pDst[0] = (Left >> 1) + (pSrc[0] >> 1);
+            pDst[1] = (Right >> 1) + (pSrc[1] >> 1);
+            Left  = pSrc[0];
+            Right = pSrc[1];
+            pSrc += 2;
+        }
+        pDst += 2;
+        Phase ^= 1;
+    }
+    pPrivate->HalfRatePhase     = Phase;
+    pPrivate->HalfRateOutput[0] = Left;
+    pPrivate->HalfRateOutput[1] = Right;
 }
 
 
@@ -105,6 +105,11 @@ LVREV_ReturnStatus_en LVREV_SetControlParameters(LVREV_Handle_t           hInsta
         return LVREV_OUTOFRANGE;
     }
 
+    if ((pNewParams->LateRate != LVREV_LATE_FULLRATE) && (pNewParams->LateRate != LVREV_LATE_HALFRATE))
+    {
+        return LVREV_OUTOFRANGE;
+    }
+
 
 
     /*
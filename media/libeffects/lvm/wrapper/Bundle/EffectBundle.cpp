@@ -133,6 +133,7 @@ int  LvmBundle_init            (EffectContext *pContext);
 int  LvmEffect_enable          (EffectContext *pContext);
 int  LvmEffect_disable         (EffectContext *pContext);
 void LvmEffect_free            (EffectContext *pContext);
+void LvmBundle_updateBypass    (EffectContext *pContext);
 int  Effect_setConfig          (EffectContext *pContext, effect_config_t *pConfig);
 void Effect_getConfig          (EffectContext *pContext, effect_config_t *pConfig);
 int  BassBoost_setParameter    (EffectContext *pContext, void *pParam, void *pValue);
@@ -295,6 +296,10 @@ extern "C" int EffectCreate(const effect_uuid_t *uuid,
         pContext->pBundledContext->positionSaved            = 0;
         pContext->pBundledContext->workBuffer               = NULL;
         pContext->pBundledContext->frameCount               = -1;
+        pContext->pBundledContext->bNeutralSettings         = LVM_FALSE;
+        pContext->pBundledContext->bBypassed                = LVM_FALSE;
+        pContext->pBundledContext->bypassCheckBuffer        = NULL;
+        pContext->pBundledContext->bypassCheckFrames        = 0;
         pContext->pBundledContext->SamplesToExitCountVirt   = 0;
         pContext->pBundledContext->SamplesToExitCountBb     = 0;
         pContext->pBundledContext->SamplesToExitCountEq     = 0;
@@ -460,6 +465,9 @@ extern "C" int EffectRelease(effect_handle_t handle){
         if (pContext->pBundledContext->workBuffer != NULL) {
             free(pContext->pBundledContext->workBuffer);
         }
+        if (pContext->pBundledContext->bypassCheckBuffer != NULL) {
+            free(pContext->pBundledContext->bypassCheckBuffer);
+        }
         delete pContext->pBundledContext;
         pContext->pBundledContext = LVM_NULL;
     }
@@ -767,6 +775,22 @@ int LvmBundle_process(LVM_INT16        *pIn,
     fflush(pContext->pBundledContext->PcmInPtr);
     #endif
 
+    /* While the settings are neutral keep the input to see whether LVM still changes it */
+    LVM_INT16 *pCheck = pIn;
+    if (pContext->pBundledContext->bNeutralSettings == LVM_TRUE && pIn == pOutTmp) {
+        if (pContext->pBundledContext->bypassCheckFrames < frameCount) {
+            free(pContext->pBundledContext->bypassCheckBuffer);
+            pContext->pBundledContext->bypassCheckBuffer =
+                    (LVM_INT16 *)malloc(frameCount * sizeof(LVM_INT16) * 2);
+            pContext->pBundledContext->bypassCheckFrames =
+                    pContext->pBundledContext->bypassCheckBuffer != NULL ? frameCount : 0;
+        }
+        pCheck = pContext->pBundledContext->bypassCheckBuffer;
+        if (pCheck != NULL) {
+            memcpy(pCheck, pIn, frameCount * sizeof(LVM_INT16) * 2);
+        }
+    }
+
     //ALOGV("Calling LVM_Process");
 
     /* Process the samples */
@@ -784,6 +808,14 @@ int LvmBundle_process(LVM_INT16        *pIn,
     fflush(pContext->pBundledContext->PcmOutPtr);
     #endif
 
+    /* Once the smoothing and the tails of disabled effects have died out, LVM_Process copies
+       its input: stop calling it until the settings change */
+    if (pContext->pBundledContext->bNeutralSettings == LVM_TRUE && pCheck != NULL &&
+            memcmp(pCheck, pOutTmp, frameCount * sizeof(LVM_INT16) * 2) == 0) {
+        ALOGV("\tLvmBundle_process output settled, bypassing LVM_Process");
+        pContext->pBundledContext->bBypassed = LVM_TRUE;
+    }
+
     if (pContext->config.outputCfg.accessMode == EFFECT_BUFFER_ACCESS_ACCUMULATE){
         for (int i=0; i<frameCount*2; i++){
             pOut[i] = clamp16((LVM_INT32)pOut[i] + (LVM_INT32)pOutTmp[i]);
@@ -792,6 +824,55 @@ int LvmBundle_process(LVM_INT16        *pIn,
     return 0;
 }    /* end LvmBundle_process */
 
+//----------------------------------------------------------------------------
+// LvmBundle_updateBypass()
+//----------------------------------------------------------------------------
+// Purpose:
+// Called after the settings of the bundle may have changed. Checks whether every
+// effect is at a setting that leaves the audio unchanged, and leaves bypass so
+// that LvmBundle_process can check again that LVM has settled to a copy.
+//
+// Inputs:
+//  pContext:   effect engine context
+//
+//----------------------------------------------------------------------------
+
+void LvmBundle_updateBypass(EffectContext *pContext){
+    LVM_ControlParams_t     ActiveParams;                           /* Current control Parameters */
+    LVM_ReturnStatus_en     LvmStatus = LVM_SUCCESS;                /* Function call status */
+    bool                    neutral = LVM_TRUE;
+
+    pContext->pBundledContext->bBypassed = LVM_FALSE;
+    pContext->pBundledContext->bNeutralSettings = LVM_FALSE;
+
+    LvmStatus = LVM_GetControlParameters(pContext->pBundledContext->hInstance, &ActiveParams);
+    LVM_ERROR_CHECK(LvmStatus, "LVM_GetControlParameters", "LvmBundle_updateBypass")
+    if(LvmStatus != LVM_SUCCESS) return;
+
+    if (ActiveParams.BE_OperatingMode == LVM_BE_ON && ActiveParams.BE_EffectLevel != 0) {
+        neutral = LVM_FALSE;
+    }
+    if (ActiveParams.VirtualizerOperatingMode == LVM_MODE_ON && ActiveParams.CS_EffectLevel != 0) {
+        neutral = LVM_FALSE;
+    }
+    if (ActiveParams.EQNB_OperatingMode == LVM_EQNB_ON) {
+        for (int i = 0; i < ActiveParams.EQNB_NBands; i++) {
+            if (ActiveParams.pEQNB_BandDefinition[i].Gain != 0) {
+                neutral = LVM_FALSE;
+            }
+        }
+    }
+    if (ActiveParams.TE_OperatingMode == LVM_TE_ON && ActiveParams.TE_EffectLevel != 0) {
+        neutral = LVM_FALSE;
+    }
+    if (ActiveParams.VC_EffectLevel != 0 || ActiveParams.VC_Balance != 0) {
+        neutral = LVM_FALSE;
+    }
+
+    pContext->pBundledContext->bNeutralSettings = neutral;
+    //ALOGV("\tLvmBundle_updateBypass neutral settings %d", neutral);
+}    /* end LvmBundle_updateBypass */
+
 //----------------------------------------------------------------------------
 // LvmEffect_enable()
 //----------------------------------------------------------------------------
@@ -2604,6 +2685,21 @@ int16_t LVC_Convert_VolToDb(uint32_t vol){
 } // namespace
 
 extern "C" {
+/* Copies or accumulates the input to the output for when LVM_Process is not called */
+static void Effect_copy(EffectContext      *pContext,
+                        audio_buffer_t     *inBuffer,
+                        audio_buffer_t     *outBuffer){
+    // 2 is for stereo input
+    if (pContext->config.outputCfg.accessMode == EFFECT_BUFFER_ACCESS_ACCUMULATE) {
+        for (size_t i=0; i < outBuffer->frameCount*2; i++){
+            outBuffer->s16[i] =
+                    clamp16((LVM_INT32)outBuffer->s16[i] + (LVM_INT32)inBuffer->s16[i]);
+        }
+    } else if (outBuffer->raw != inBuffer->raw) {
+        memcpy(outBuffer->raw, inBuffer->raw, outBuffer->frameCount*sizeof(LVM_INT16)*2);
+    }
+}
+
 /* Effect Control Interface Implementation: Process */
 int Effect_process(effect_handle_t     self,
                               audio_buffer_t         *inBuffer,
@@ -2703,29 +2799,39 @@ int Effect_process(effect_handle_t     self,
             ALOGV("\tEffect_process() processing last frame");
         }
         pContext->pBundledContext->NumberEffectsCalled = 0;
-        /* Process all the available frames, block processing is
-           handled internalLY by the LVM bundle */
-        lvmStatus = android::LvmBundle_process(    (LVM_INT16 *)inBuffer->raw,
-                                                (LVM_INT16 *)outBuffer->raw,
-                                                outBuffer->frameCount,
-                                                pContext);
-        if(lvmStatus != LVM_SUCCESS){
-            ALOGV("\tLVM_ERROR : LvmBundle_process returned error %d", lvmStatus);
-            return lvmStatus;
+        if(pContext->pBundledContext->bBypassed == LVM_FALSE){
+            /* Process all the available frames, block processing is
+               handled internalLY by the LVM bundle */
+            lvmStatus = android::LvmBundle_process(    (LVM_INT16 *)inBuffer->raw,
+                                                    (LVM_INT16 *)outBuffer->raw,
+                                                    outBuffer->frameCount,
+                                                    pContext);
+            if(lvmStatus != LVM_SUCCESS){
+                ALOGV("\tLVM_ERROR : LvmBundle_process returned error %d", lvmStatus);
+                return lvmStatus;
+            }
+        } else {
+            Effect_copy(pContext, inBuffer, outBuffer);
+        }
+
+        if(pContext->pBundledContext->bBypassed == LVM_TRUE){
+            // Nothing is left of the disabled effects in the output, so they can stop now
+            // rather than when their exit count runs out
+            if(pContext->pBundledContext->bBassEnabled == LVM_FALSE){
+                pContext->pBundledContext->SamplesToExitCountBb = 0;
+            }
+            if(pContext->pBundledContext->bEqualizerEnabled == LVM_FALSE){
+                pContext->pBundledContext->SamplesToExitCountEq = 0;
+            }
+            if(pContext->pBundledContext->bVirtualizerEnabled == LVM_FALSE){
+                pContext->pBundledContext->SamplesToExitCountVirt = 0;
+            }
         }
     } else {
         //ALOGV("\tEffect_process Not Calling process with %d effects enabled, %d called: Effect %d",
         //pContext->pBundledContext->NumberEffectsEnabled,
         //pContext->pBundledContext->NumberEffectsCalled, pContext->EffectType);
-        // 2 is for stereo input
-        if (pContext->config.outputCfg.accessMode == EFFECT_BUFFER_ACCESS_ACCUMULATE) {
-            for (size_t i=0; i < outBuffer->frameCount*2; i++){
-                outBuffer->s16[i] =
-                        clamp16((LVM_INT32)outBuffer->s16[i] + (LVM_INT32)inBuffer->s16[i]);
-            }
-        } else {
-            memcpy(outBuffer->raw, inBuffer->raw, outBuffer->frameCount*sizeof(LVM_INT16)*2);
-        }
+        Effect_copy(pContext, inBuffer, outBuffer);
     }
 
     return status;
@@ -3239,6 +3345,10 @@ int Effect_command(effect_handle_t  self,
             return -EINVAL;
     }
 
+    if (cmdCode != EFFECT_CMD_GET_PARAM && cmdCode != EFFECT_CMD_GET_CONFIG) {
+        android::LvmBundle_updateBypass(pContext);
+    }
+
     //ALOGV("\tEffect_command end...\n\n");
     return 0;
 }    /* end Effect_command */
@@ -95,6 +95,11 @@ struct BundledEffectContext{
     int                             SamplesToExitCountVirt;
     LVM_INT16                       *workBuffer;
     int                             frameCount;
+    // Bypass of LVM_Process while every effect is at a neutral setting
+    bool                            bNeutralSettings;         /* 0 dB EQ/volume, strength 0 */
+    bool                            bBypassed;                /* LVM output settled to input */
+    LVM_INT16                       *bypassCheckBuffer;       /* Input copy for in place check */
+    int                             bypassCheckFrames;
     #ifdef LVM_PCM
     FILE                            *PcmInPtr;
     FILE                            *PcmOutPtr;
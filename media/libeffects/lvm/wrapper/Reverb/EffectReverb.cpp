@@ -857,6 +857,7 @@ int Reverb_init(ReverbContext *pContext){
     params.Density        = 100;
     params.Damping        = 21;
     params.RoomSize       = 100;
+    params.LateRate       = LVREV_LATE_FULLRATE;
 
     pContext->SamplesToExitCount = (params.T60 * pContext->config.inputCfg.samplingRate)/1000;
 
@@ -1497,6 +1498,65 @@ int32_t ReverbGetDensity(ReverbContext *pContext){
     return pContext->SavedDensity;
 }
 
+//----------------------------------------------------------------------------
+// ReverbSetQuality()
+//----------------------------------------------------------------------------
+// Purpose:
+// Select the rate of the late reverberation
+//
+// Inputs:
+//  pContext:   effect engine context
+//  quality:    REVERB_QUALITY_HIGH or REVERB_QUALITY_LOW
+//
+//----------------------------------------------------------------------------
+
+int ReverbSetQuality(ReverbContext *pContext, uint16_t quality){
+    LVREV_ControlParams_st    ActiveParams;              /* Current control Parameters */
+    LVREV_ReturnStatus_en     LvmStatus=LVREV_SUCCESS;     /* Function call status */
+
+    if (quality != REVERB_QUALITY_HIGH && quality != REVERB_QUALITY_LOW) {
+        return -EINVAL;
+    }
+
+    /* Get the current settings */
+    LvmStatus = LVREV_GetControlParameters(pContext->hInstance, &ActiveParams);
+    LVM_ERROR_CHECK(LvmStatus, "LVREV_GetControlParameters", "ReverbSetQuality")
+
+    ActiveParams.LateRate = (quality == REVERB_QUALITY_LOW) ?
+            LVREV_LATE_HALFRATE : LVREV_LATE_FULLRATE;
+
+    /* Activate the initial settings */
+    LvmStatus = LVREV_SetControlParameters(pContext->hInstance, &ActiveParams);
+    LVM_ERROR_CHECK(LvmStatus, "LVREV_SetControlParameters", "ReverbSetQuality")
+    if(LvmStatus != LVREV_SUCCESS) return -EINVAL;
+
+    ALOGV("\tReverbSetQuality %s", quality == REVERB_QUALITY_LOW ? "low" : "high");
+    return 0;
+}
+
+//----------------------------------------------------------------------------
+// ReverbGetQuality()
+//----------------------------------------------------------------------------
+// Purpose:
+// Get the rate of the late reverberation
+//
+// Inputs:
+//  pContext:   effect engine context
+//
+//----------------------------------------------------------------------------
+
+uint16_t ReverbGetQuality(ReverbContext *pContext){
+    LVREV_ControlParams_st    ActiveParams;              /* Current control Parameters */
+    LVREV_ReturnStatus_en     LvmStatus=LVREV_SUCCESS;     /* Function call status */
+
+    /* Get the current settings */
+    LvmStatus = LVREV_GetControlParameters(pContext->hInstance, &ActiveParams);
+    LVM_ERROR_CHECK(LvmStatus, "LVREV_GetControlParameters", "ReverbGetQuality")
+
+    return (ActiveParams.LateRate == LVREV_LATE_HALFRATE) ?
+            REVERB_QUALITY_LOW : REVERB_QUALITY_HIGH;
+}
+
 //----------------------------------------------------------------------------
 // Reverb_LoadPreset()
 //----------------------------------------------------------------------------
@@ -1567,6 +1627,15 @@ int Reverb_getParameter(ReverbContext *pContext,
     t_reverb_settings *pProperties;
 
     //ALOGV("\tReverb_getParameter start");
+    if (param == REVERB_PARAM_QUALITY) {
+        if (*pValueSize < sizeof(uint16_t)) {
+            return -EINVAL;
+        }
+        *(uint16_t *)pValue = ReverbGetQuality(pContext);
+        *pValueSize = sizeof(uint16_t);
+        return 0;
+    }
+
     if (pContext->preset) {
         if (param != REVERB_PARAM_PRESET || *pValueSize < sizeof(uint16_t)) {
             return -EINVAL;
@@ -1783,6 +1852,10 @@ int Reverb_setParameter (ReverbContext *pContext, void *pParam, void *pValue){
     int32_t param = *pParamTemp++;
 
     //ALOGV("\tReverb_setParameter start");
+    if (param == REVERB_PARAM_QUALITY) {
+        return ReverbSetQuality(pContext, *(uint16_t *)pValue);
+    }
+
     if (pContext->preset) {
         if (param != REVERB_PARAM_PRESET) {
             return -EINVAL;
@@ -33,6 +33,13 @@ extern "C" {
 #define LVREV_MEM_USAGE         71+(LVREV_MAX_FRAME_SIZE>>7)     // Expressed in kB
 //#define LVM_PCM
 
+// Vendor parameter, accepted by both the environmental and the preset reverbs: uint16_t,
+// REVERB_QUALITY_LOW runs the late reverberation at half the sample rate for about a third
+// less load, at the cost of the top octave of the tail.
+#define REVERB_PARAM_QUALITY    0x10000
+#define REVERB_QUALITY_HIGH     0
+#define REVERB_QUALITY_LOW      1
+
 typedef struct _LPFPair_t
 {
     int16_t Room_HF;
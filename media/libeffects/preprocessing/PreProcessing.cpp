@@ -95,6 +95,17 @@ struct preproc_effect_s {
 #endif
 };
 
+// Processing time per stage of a session
+typedef struct preproc_stats_s {
+    size_t frames;                      // number of 10 ms frames through ProcessStream()
+    nsecs_t inResamplerNs;              // time in the input resampler
+    nsecs_t apmNs;                      // time in ProcessStream()
+    nsecs_t apmMaxNs;                   // longest ProcessStream() call
+    nsecs_t outResamplerNs;             // time in the output resampler
+    size_t revFrames;                   // number of 10 ms frames through AnalyzeReverseStream()
+    nsecs_t revNs;                      // time in the reverse resampler and AnalyzeReverseStream()
+} preproc_stats_t;
+
 // Session context
 struct preproc_session_s {
     struct preproc_effect_s effects[PREPROC_NUM_EFFECTS]; // effects in this session
@@ -131,6 +142,8 @@ struct preproc_session_s {
     size_t revBufSize;                  // reverse channel input buffer size
     size_t framesRev;                   // number of frames in reverse channel input buffer
     SpeexResamplerState *revResampler;  // handle on reverse channel input speex resampler
+    uint32_t addedDelayUs;              // delay added by the 10 ms buffering and the resamplers
+    preproc_stats_t stats;              // processing time per stage since last enabled
 };
 
 #ifdef DUAL_MIC_TEST
@@ -813,6 +826,8 @@ extern "C" int Session_CreateEffect(preproc_session_t *session,
         session->revResampler = NULL;
         session->revBuf = NULL;
         session->revBufSize = 0;
+        session->addedDelayUs = 0;
+        memset(&session->stats, 0, sizeof(preproc_stats_t));
     }
     status = Effect_Create(&session->effects[procId], session, interface);
     if (status < 0) {
@@ -858,11 +873,11 @@ int Session_ReleaseEffect(preproc_session_t *session,
             speex_resampler_destroy(session->revResampler);
             session->revResampler = NULL;
         }
-        delete session->inBuf;
+        free(session->inBuf);
         session->inBuf = NULL;
-        delete session->outBuf;
+        free(session->outBuf);
         session->outBuf = NULL;
-        delete session->revBuf;
+        free(session->revBuf);
         session->revBuf = NULL;
 
         session->io = 0;
@@ -997,6 +1012,18 @@ int Session_SetConfig(preproc_session_t *session, effect_config_t *config)
         }
     }
 
+    // a full 10 ms frame is gathered before processing, plus the resampler filter delays
+    session->addedDelayUs = (session->frameCount * 1000000) / session->samplingRate;
+    if (session->inResampler != NULL) {
+        session->addedDelayUs +=
+                (speex_resampler_get_input_latency(session->inResampler) * 1000000) /
+                        session->samplingRate +
+                (speex_resampler_get_output_latency(session->outResampler) * 1000000) /
+                        session->samplingRate;
+    }
+    ALOGV("Session_SetConfig processing at %d Hz, added delay %d us",
+         session->apmSamplingRate, session->addedDelayUs);
+
     session->state = PREPROC_SESSION_STATE_CONFIG;
     return 0;
 }
@@ -1057,10 +1084,30 @@ void Session_GetReverseConfig(preproc_session_t *session, effect_config_t *confi
             (EFFECT_CONFIG_SMP_RATE | EFFECT_CONFIG_CHANNELS | EFFECT_CONFIG_FORMAT);
 }
 
+// Logs the processing time of each stage since the session was enabled
+void Session_LogStats(preproc_session_t *session)
+{
+    preproc_stats_t *stats = &session->stats;
+
+    if (stats->frames == 0) {
+        return;
+    }
+    ALOGD("session %d: %d frames at %d Hz, added delay %d us, per 10 ms: "
+          "in resampler %lld us, apm %lld us (max %lld us), out resampler %lld us, "
+          "reverse %lld us over %d frames",
+          session->id, stats->frames, session->apmSamplingRate, session->addedDelayUs,
+          ns2us(stats->inResamplerNs) / stats->frames,
+          ns2us(stats->apmNs) / stats->frames, ns2us(stats->apmMaxNs),
+          ns2us(stats->outResamplerNs) / stats->frames,
+          stats->revFrames ? ns2us(stats->revNs) / stats->revFrames : 0,
+          stats->revFrames);
+}
+
 void Session_SetProcEnabled(preproc_session_t *session, uint32_t procId, bool enabled)
 {
     if (enabled) {
         if(session->enabledMsk == 0) {
+            memset(&session->stats, 0, sizeof(preproc_stats_t));
             session->framesIn = 0;
             if (session->inResampler != NULL) {
                 speex_resampler_reset_mem(session->inResampler);
@@ -1083,6 +1130,9 @@ void Session_SetProcEnabled(preproc_session_t *session, uint32_t procId, bool en
         if (HasReverseStream(procId)) {
             session->revEnabledMsk &= ~(1 << procId);
         }
+        if (session->enabledMsk == 0) {
+            Session_LogStats(session);
+        }
     }
     ALOGV("Session_SetProcEnabled proc %d, enabled %d enabledMsk %08x revEnabledMsk %08x",
          procId, enabled, session->enabledMsk, session->revEnabledMsk);
@@ -1190,7 +1240,7 @@ int PreProcessingFx_Process(effect_handle_t     self,
             memcpy(outBuffer->s16,
                   session->outBuf,
                   fr * session->outChannelCount * sizeof(int16_t));
-            memcpy(session->outBuf,
+            memmove(session->outBuf,
                   session->outBuf + fr * session->outChannelCount,
                   (session->framesOut - fr) * session->outChannelCount * sizeof(int16_t));
             session->framesOut -= fr;
@@ -1207,14 +1257,19 @@ int PreProcessingFx_Process(effect_handle_t     self,
             if (inBuffer->frameCount < fr) {
                 fr = inBuffer->frameCount;
             }
-            if (session->inBufSize < session->framesIn + fr) {
-                session->inBufSize = session->framesIn + fr;
-                session->inBuf = (int16_t *)realloc(session->inBuf,
-                                 session->inBufSize * session->inChannelCount * sizeof(int16_t));
+            // resample straight from the client buffer when it holds a whole frame
+            int16_t *in = inBuffer->s16;
+            if (session->framesIn != 0 || fr < session->frameCount) {
+                if (session->inBufSize < session->framesIn + fr) {
+                    session->inBufSize = session->framesIn + fr;
+                    session->inBuf = (int16_t *)realloc(session->inBuf,
+                                     session->inBufSize * session->inChannelCount * sizeof(int16_t));
+                }
+                memcpy(session->inBuf + session->framesIn * session->inChannelCount,
+                       inBuffer->s16,
+                       fr * session->inChannelCount * sizeof(int16_t));
+                in = session->inBuf;
             }
-            memcpy(session->inBuf + session->framesIn * session->inChannelCount,
-                   inBuffer->s16,
-                   fr * session->inChannelCount * sizeof(int16_t));
 #ifdef DUAL_MIC_TEST
             pthread_mutex_lock(&gPcmDumpLock);
             if (gPcmDumpFh != NULL) {
@@ -1231,24 +1286,34 @@ int PreProcessingFx_Process(effect_handle_t     self,
             }
             size_t frIn = session->framesIn;
             size_t frOut = session->apmFrameCount;
+            nsecs_t start = systemTime();
             if (session->inChannelCount == 1) {
                 speex_resampler_process_int(session->inResampler,
                                             0,
-                                            session->inBuf,
+                                            in,
                                             &frIn,
                                             session->procFrame->_payloadData,
                                             &frOut);
             } else {
                 speex_resampler_process_interleaved_int(session->inResampler,
-                                                        session->inBuf,
+                                                        in,
                                                         &frIn,
                                                         session->procFrame->_payloadData,
                                                         &frOut);
             }
-            memcpy(session->inBuf,
-                   session->inBuf + frIn * session->inChannelCount,
-                   (session->framesIn - frIn) * session->inChannelCount * sizeof(int16_t));
+            session->stats.inResamplerNs += systemTime() - start;
+            // keep what the resampler did not consume for the next frame
             session->framesIn -= frIn;
+            if (session->framesIn != 0) {
+                if (in != session->inBuf && session->inBufSize < session->framesIn) {
+                    session->inBufSize = session->framesIn;
+                    session->inBuf = (int16_t *)realloc(session->inBuf,
+                                     session->inBufSize * session->inChannelCount * sizeof(int16_t));
+                }
+                memmove(session->inBuf,
+                        in + frIn * session->inChannelCount,
+                        session->framesIn * session->inChannelCount * sizeof(int16_t));
+            }
         } else {
             size_t fr = session->frameCount - session->framesIn;
             if (inBuffer->frameCount < fr) {
@@ -1277,46 +1342,82 @@ int PreProcessingFx_Process(effect_handle_t     self,
         session->procFrame->_payloadDataLengthInSamples =
                 session->apmFrameCount * session->inChannelCount;
 
+        nsecs_t start = systemTime();
         effect->session->apm->ProcessStream(session->procFrame);
-
-        if (session->outBufSize < session->framesOut + session->frameCount) {
-            session->outBufSize = session->framesOut + session->frameCount;
-            session->outBuf = (int16_t *)realloc(session->outBuf,
-                              session->outBufSize * session->outChannelCount * sizeof(int16_t));
+        nsecs_t apmNs = systemTime() - start;
+        session->stats.apmNs += apmNs;
+        if (apmNs > session->stats.apmMaxNs) {
+            session->stats.apmMaxNs = apmNs;
         }
+        session->stats.frames++;
 
+        // All frames kept in outBuf were written out above, so the processed frame goes
+        // straight to the client buffer when it fits and only the overflow is kept.
+        size_t frRoom = framesRq - framesWr;
+        int16_t *out = outBuffer->s16 + framesWr * session->outChannelCount;
         if (session->outResampler != NULL) {
             size_t frIn = session->apmFrameCount;
             size_t frOut = session->frameCount;
+            if (frRoom < session->frameCount) {
+                if (session->outBufSize < session->frameCount) {
+                    session->outBufSize = session->frameCount;
+                    session->outBuf = (int16_t *)realloc(session->outBuf,
+                                      session->outBufSize * session->outChannelCount * sizeof(int16_t));
+                }
+                out = session->outBuf;
+            }
+            start = systemTime();
             if (session->inChannelCount == 1) {
                 speex_resampler_process_int(session->outResampler,
                                     0,
                                     session->procFrame->_payloadData,
                                     &frIn,
-                                    session->outBuf + session->framesOut * session->outChannelCount,
+                                    out,
                                     &frOut);
             } else {
                 speex_resampler_process_interleaved_int(session->outResampler,
                                     session->procFrame->_payloadData,
                                     &frIn,
-                                    session->outBuf + session->framesOut * session->outChannelCount,
+                                    out,
                                     &frOut);
             }
-            session->framesOut += frOut;
+            session->stats.outResamplerNs += systemTime() - start;
+            if (out != session->outBuf) {
+                outBuffer->frameCount += frOut;
+                return 0;
+            }
+            session->framesOut = frOut;
         } else {
-            memcpy(session->outBuf + session->framesOut * session->outChannelCount,
+            size_t fr = session->frameCount;
+            if (frRoom < fr) {
+                fr = frRoom;
+            }
+            memcpy(out,
                    session->procFrame->_payloadData,
-                   session->frameCount * session->outChannelCount * sizeof(int16_t));
-            session->framesOut += session->frameCount;
+                   fr * session->outChannelCount * sizeof(int16_t));
+            outBuffer->frameCount += fr;
+            session->framesOut = session->frameCount - fr;
+            if (session->framesOut == 0) {
+                return 0;
+            }
+            if (session->outBufSize < session->framesOut) {
+                session->outBufSize = session->framesOut;
+                session->outBuf = (int16_t *)realloc(session->outBuf,
+                                  session->outBufSize * session->outChannelCount * sizeof(int16_t));
+            }
+            memcpy(session->outBuf,
+                   session->procFrame->_payloadData + fr * session->outChannelCount,
+                   session->framesOut * session->outChannelCount * sizeof(int16_t));
+            return 0;
         }
         size_t fr = session->framesOut;
-        if (framesRq - framesWr < fr) {
-            fr = framesRq - framesWr;
+        if (frRoom < fr) {
+            fr = frRoom;
         }
         memcpy(outBuffer->s16 + framesWr * session->outChannelCount,
               session->outBuf,
               fr * session->outChannelCount * sizeof(int16_t));
-        memcpy(session->outBuf,
+        memmove(session->outBuf,
               session->outBuf + fr * session->outChannelCount,
               (session->framesOut - fr) * session->outChannelCount * sizeof(int16_t));
         session->framesOut -= fr;
@@ -1731,19 +1832,25 @@ int PreProcessingFx_ProcessReverse(effect_handle_t     self,
 
     if ((session->revProcessedMsk & session->revEnabledMsk) == session->revEnabledMsk) {
         effect->session->revProcessedMsk = 0;
+        nsecs_t start = systemTime();
         if (session->revResampler != NULL) {
             size_t fr = session->frameCount - session->framesRev;
             if (inBuffer->frameCount < fr) {
                 fr = inBuffer->frameCount;
             }
-            if (session->revBufSize < session->framesRev + fr) {
-                session->revBufSize = session->framesRev + fr;
-                session->revBuf = (int16_t *)realloc(session->revBuf,
-                                  session->revBufSize * session->inChannelCount * sizeof(int16_t));
+            // resample straight from the client buffer when it holds a whole frame
+            int16_t *in = inBuffer->s16;
+            if (session->framesRev != 0 || fr < session->frameCount) {
+                if (session->revBufSize < session->framesRev + fr) {
+                    session->revBufSize = session->framesRev + fr;
+                    session->revBuf = (int16_t *)realloc(session->revBuf,
+                                      session->revBufSize * session->inChannelCount * sizeof(int16_t));
+                }
+                memcpy(session->revBuf + session->framesRev * session->inChannelCount,
+                       inBuffer->s16,
+                       fr * session->inChannelCount * sizeof(int16_t));
+                in = session->revBuf;
             }
-            memcpy(session->revBuf + session->framesRev * session->inChannelCount,
-                   inBuffer->s16,
-                   fr * session->inChannelCount * sizeof(int16_t));
 
             session->framesRev += fr;
             inBuffer->frameCount = fr;
@@ -1755,21 +1862,29 @@ int PreProcessingFx_ProcessReverse(effect_handle_t     self,
             if (session->inChannelCount == 1) {
                 speex_resampler_process_int(session->revResampler,
                                             0,
-                                            session->revBuf,
+                                            in,
                                             &frIn,
                                             session->revFrame->_payloadData,
                                             &frOut);
             } else {
                 speex_resampler_process_interleaved_int(session->revResampler,
-                                                        session->revBuf,
+                                                        in,
                                                         &frIn,
                                                         session->revFrame->_payloadData,
                                                         &frOut);
             }
-            memcpy(session->revBuf,
-                   session->revBuf + frIn * session->inChannelCount,
-                   (session->framesRev - frIn) * session->inChannelCount * sizeof(int16_t));
+            // keep what the resampler did not consume for the next frame
             session->framesRev -= frIn;
+            if (session->framesRev != 0) {
+                if (in != session->revBuf && session->revBufSize < session->framesRev) {
+                    session->revBufSize = session->framesRev;
+                    session->revBuf = (int16_t *)realloc(session->revBuf,
+                                      session->revBufSize * session->inChannelCount * sizeof(int16_t));
+                }
+                memmove(session->revBuf,
+                        in + frIn * session->inChannelCount,
+                        session->framesRev * session->inChannelCount * sizeof(int16_t));
+            }
         } else {
             size_t fr = session->frameCount - session->framesRev;
             if (inBuffer->frameCount < fr) {
@@ -1788,6 +1903,8 @@ int PreProcessingFx_ProcessReverse(effect_handle_t     self,
         session->revFrame->_payloadDataLengthInSamples =
                 session->apmFrameCount * session->inChannelCount;
         effect->session->apm->AnalyzeReverseStream(session->revFrame);
+        session->stats.revNs += systemTime() - start;
+        session->stats.revFrames++;
         return 0;
     } else {
         return -ENODATA;
@@ -22,7 +22,9 @@
 #include <string.h>
 #include <new>
 #include <time.h>
+#include <cutils/atomic.h>
 #include <audio_effects/effect_visualizer.h>
+#include <audio_utils/fixedfft.h>
 
 
 extern "C" {
@@ -54,17 +56,29 @@ enum visualizer_state_e {
 
 #define CAPTURE_BUF_SIZE 65536 // "64k should be enough for everyone"
 
+// Returns the waveform followed by its FFT, in the format of Visualizer::getFft(), in a reply
+// of twice the capture size. The FFT is computed once per capture point and served to all
+// the clients of the effect from the cache. Must match the definition in media/Visualizer.h.
+#define VISUALIZER_CMD_CAPTURE_FFT (VISUALIZER_CMD_CAPTURE + 1)
+
 struct VisualizerContext {
     const struct effect_interface_s *mItfe;
     effect_config_t mConfig;
-    uint32_t mCaptureIdx;
+    // written by the audio thread only, after the capture buffer, with release semantics
+    volatile int32_t mCaptureIdx;
     uint32_t mCaptureSize;
     uint32_t mScalingMode;
     uint8_t mState;
-    uint8_t mLastCaptureIdx;
+    uint32_t mLastCaptureIdx;
     uint32_t mLatency;
     struct timespec mBufferUpdateTime;
     uint8_t mCaptureBuf[CAPTURE_BUF_SIZE];
+    // last FFT computed, valid for the capture point and size it was computed for
+    bool mFftValid;
+    int32_t mFftCapturePoint;
+    uint32_t mFftCaptureSize;
+    uint8_t mFftWaveform[VISUALIZER_CAPTURE_SIZE_MAX];
+    uint8_t mFft[VISUALIZER_CAPTURE_SIZE_MAX];
 };
 
 //
@@ -77,6 +91,7 @@ void Visualizer_reset(VisualizerContext *pContext)
     pContext->mLastCaptureIdx = 0;
     pContext->mBufferUpdateTime.tv_sec = 0;
     pContext->mLatency = 0;
+    pContext->mFftValid = false;
     memset(pContext->mCaptureBuf, 0x80, CAPTURE_BUF_SIZE);
 }
 
@@ -330,9 +345,9 @@ int Visualizer_process(
         buf[captIdx] = ((uint8_t)smp)^0x80;
     }
 
-    // XXX the following two should really be atomic, though it probably doesn't
-    // matter much for visualization purposes
-    pContext->mCaptureIdx = captIdx;
+    // publish the samples written above to the capture commands; the update time stamp
+    // is only used for stall detection and need not be exact
+    android_atomic_release_store(captIdx, &pContext->mCaptureIdx);
     // update last buffer update time stamp
     if (clock_gettime(CLOCK_MONOTONIC, &pContext->mBufferUpdateTime) < 0) {
         pContext->mBufferUpdateTime.tv_sec = 0;
@@ -353,6 +368,101 @@ int Visualizer_process(
     return 0;
 }   // end Visualizer_process
 
+// Copies the current capture window into waveform and returns the capture point it starts
+// at, or returns false if the effect is not active and the waveform is silence.
+// Called from the command thread only: mCaptureIdx is the only state shared with
+// Visualizer_process() and is read once with acquire semantics.
+static bool Visualizer_capture(VisualizerContext *pContext, uint8_t *waveform,
+        int32_t *pCapturePoint)
+{
+    if (pContext->mState != VISUALIZER_STATE_ACTIVE) {
+        memset(waveform, 0x80, pContext->mCaptureSize);
+        return false;
+    }
+    uint32_t captureIdx = android_atomic_acquire_load(&pContext->mCaptureIdx);
+    int32_t latencyMs = pContext->mLatency;
+    uint32_t deltaMs = 0;
+    if (pContext->mBufferUpdateTime.tv_sec != 0) {
+        struct timespec ts;
+        if (clock_gettime(CLOCK_MONOTONIC, &ts) == 0) {
+            time_t secs = ts.tv_sec - pContext->mBufferUpdateTime.tv_sec;
+            long nsec = ts.tv_nsec - pContext->mBufferUpdateTime.tv_nsec;
+            if (nsec < 0) {
+                --secs;
+                nsec += 1000000000;
+            }
+            deltaMs = secs * 1000 + nsec / 1000000;
+            latencyMs -= deltaMs;
+            if (latencyMs < 0) {
+                latencyMs = 0;
+            }
+        }
+    }
+    uint32_t deltaSmpl = pContext->mConfig.inputCfg.samplingRate * latencyMs / 1000;
+
+    int32_t capturePoint = captureIdx - pContext->mCaptureSize - deltaSmpl;
+    int32_t captureSize = pContext->mCaptureSize;
+    uint8_t *dst = waveform;
+    if (capturePoint < 0) {
+        int32_t size = -capturePoint;
+        if (size > captureSize) {
+            size = captureSize;
+        }
+        memcpy(dst,
+               pContext->mCaptureBuf + CAPTURE_BUF_SIZE + capturePoint,
+               size);
+        dst += size;
+        captureSize -= size;
+        capturePoint = 0;
+    }
+    memcpy(dst,
+           pContext->mCaptureBuf + capturePoint,
+           captureSize);
+    if (pCapturePoint != NULL) {
+        *pCapturePoint = captureIdx - pContext->mCaptureSize - deltaSmpl;
+    }
+
+    // if audio framework has stopped playing audio although the effect is still
+    // active we must clear the capture buffer to return silence
+    if ((pContext->mLastCaptureIdx == captureIdx) &&
+            (pContext->mBufferUpdateTime.tv_sec != 0)) {
+        if (deltaMs > MAX_STALL_TIME_MS) {
+            ALOGV("capture going to idle");
+            pContext->mBufferUpdateTime.tv_sec = 0;
+            memset(waveform, 0x80, pContext->mCaptureSize);
+        }
+    }
+    pContext->mLastCaptureIdx = captureIdx;
+    return true;
+}
+
+// Same conversion as Visualizer::doFft() on the client side.
+static void Visualizer_fft(uint8_t *fft, const uint8_t *waveform, uint32_t captureSize)
+{
+    int32_t workspace[VISUALIZER_CAPTURE_SIZE_MAX >> 1];
+    int32_t nonzero = 0;
+
+    for (uint32_t i = 0; i < captureSize; i += 2) {
+        workspace[i >> 1] =
+                ((waveform[i] ^ 0x80) << 24) | ((waveform[i + 1] ^ 0x80) << 8);
+        nonzero |= workspace[i >> 1];
+    }
+
+    if (nonzero) {
+        fixed_fft_real(captureSize >> 1, workspace);
+    }
+
+    for (uint32_t i = 0; i < captureSize; i += 2) {
+        short tmp = workspace[i >> 1] >> 21;
+        while (tmp > 127 || tmp < -128) tmp >>= 1;
+        fft[i] = tmp;
+        tmp = workspace[i >> 1];
+        tmp >>= 5;
+        while (tmp > 127 || tmp < -128) tmp >>= 1;
+        fft[i + 1] = tmp;
+    }
+}
+
 int Visualizer_command(effect_handle_t self, uint32_t cmdCode, uint32_t cmdSize,
         void *pCmdData, uint32_t *replySize, void *pReplyData) {
 
@@ -485,62 +595,37 @@ int Visualizer_command(effect_handle_t self, uint32_t cmdCode, uint32_t cmdSize,
                     *replySize, pContext->mCaptureSize);
             return -EINVAL;
         }
-        if (pContext->mState == VISUALIZER_STATE_ACTIVE) {
-            int32_t latencyMs = pContext->mLatency;
-            uint32_t deltaMs = 0;
-            if (pContext->mBufferUpdateTime.tv_sec != 0) {
-                struct timespec ts;
-                if (clock_gettime(CLOCK_MONOTONIC, &ts) == 0) {
-                    time_t secs = ts.tv_sec - pContext->mBufferUpdateTime.tv_sec;
-                    long nsec = ts.tv_nsec - pContext->mBufferUpdateTime.tv_nsec;
-                    if (nsec < 0) {
-                        --secs;
-                        nsec += 1000000000;
-                    }
-                    deltaMs = secs * 1000 + nsec / 1000000;
-                    latencyMs -= deltaMs;
-                    if (latencyMs < 0) {
-                        latencyMs = 0;
-                    }
-                }
-            }
-            uint32_t deltaSmpl = pContext->mConfig.inputCfg.samplingRate * latencyMs / 1000;
-
-            int32_t capturePoint = pContext->mCaptureIdx - pContext->mCaptureSize - deltaSmpl;
-            int32_t captureSize = pContext->mCaptureSize;
-            if (capturePoint < 0) {
-                int32_t size = -capturePoint;
-                if (size > captureSize) {
-                    size = captureSize;
-                }
-                memcpy(pReplyData,
-                       pContext->mCaptureBuf + CAPTURE_BUF_SIZE + capturePoint,
-                       size);
-                pReplyData += size;
-                captureSize -= size;
-                capturePoint = 0;
-            }
-            memcpy(pReplyData,
-                   pContext->mCaptureBuf + capturePoint,
-                   captureSize);
-
-
-            // if audio framework has stopped playing audio although the effect is still
-            // active we must clear the capture buffer to return silence
-            if ((pContext->mLastCaptureIdx == pContext->mCaptureIdx) &&
-                    (pContext->mBufferUpdateTime.tv_sec != 0)) {
-                if (deltaMs > MAX_STALL_TIME_MS) {
-                    ALOGV("capture going to idle");
-                    pContext->mBufferUpdateTime.tv_sec = 0;
-                    memset(pReplyData, 0x80, pContext->mCaptureSize);
-                }
-            }
-            pContext->mLastCaptureIdx = pContext->mCaptureIdx;
+        Visualizer_capture(pContext, (uint8_t *)pReplyData, NULL);
+        break;
+
+    case VISUALIZER_CMD_CAPTURE_FFT: {
+        uint32_t captureSize = pContext->mCaptureSize;
+        if (pReplyData == NULL || *replySize != 2 * captureSize ||
+                captureSize > VISUALIZER_CAPTURE_SIZE_MAX) {
+            ALOGV("VISUALIZER_CMD_CAPTURE_FFT() error *replySize %d pContext->mCaptureSize %d",
+                    *replySize, captureSize);
+            return -EINVAL;
+        }
+        uint8_t *waveform = (uint8_t *)pReplyData;
+        uint8_t *fft = waveform + captureSize;
+        int32_t capturePoint;
+        if (!Visualizer_capture(pContext, waveform, &capturePoint)) {
+            memset(fft, 0, captureSize);
+            break;
+        }
+        if (!pContext->mFftValid || pContext->mFftCapturePoint != capturePoint ||
+                pContext->mFftCaptureSize != captureSize ||
+                memcmp(pContext->mFftWaveform, waveform, captureSize) != 0) {
+            Visualizer_fft(fft, waveform, captureSize);
+            memcpy(pContext->mFftWaveform, waveform, captureSize);
+            memcpy(pContext->mFft, fft, captureSize);
+            pContext->mFftCapturePoint = capturePoint;
+            pContext->mFftCaptureSize = captureSize;
+            pContext->mFftValid = true;
         } else {
-            memset(pReplyData, 0x80, pContext->mCaptureSize);
+            memcpy(fft, pContext->mFft, captureSize);
         }
-
-        break;
+        } break;
 
     default:
         ALOGW("Visualizer_command invalid command %d",cmdCode);
@@ -312,6 +312,7 @@ status_t AudioRecord::set(
     mCbf = cbf;
     mNotificationFrames = notificationFrames;
     mRemainingFrames = notificationFrames;
+    mBatchNotifications = false;
     mUserData = user;
     // TODO: add audio hardware input latency here
     mLatency = (1000*mFrameCount) / sampleRate;
@@ -549,6 +550,27 @@ status_t AudioRecord::getPositionUpdatePeriod(uint32_t *updatePeriod) const
     return NO_ERROR;
 }
 
+status_t AudioRecord::setNotificationFrames(uint32_t notificationFrames)
+{
+    if (mCbf == NULL) return INVALID_OPERATION;
+
+    if (notificationFrames > mFrameCount) return BAD_VALUE;
+    if (notificationFrames == 0) {
+        notificationFrames = mFrameCount/2;
+    }
+
+    mNotificationFrames = notificationFrames;
+    mRemainingFrames = notificationFrames;
+    mBatchNotifications = true;
+
+    return NO_ERROR;
+}
+
+uint32_t AudioRecord::getNotificationFrames() const
+{
+    return mNotificationFrames;
+}
+
 status_t AudioRecord::getPosition(uint32_t *position) const
 {
     if (position == NULL) return BAD_VALUE;
@@ -807,6 +829,65 @@ ssize_t AudioRecord::read(void* buffer, size_t userSize)
     return read;
 }
 
+status_t AudioRecord::obtainReadBuffer(Buffer* audioBuffer)
+{
+    mLock.lock();
+    if (mReadMemory != 0) {
+        mLock.unlock();
+        ALOGE("obtainReadBuffer() previous read buffer not released");
+        return INVALID_OPERATION;
+    }
+    // keep the IAudioRecord and IMemory alive until releaseReadBuffer(): obtainBuffer() may
+    // recreate them while the client is still accessing the returned region
+    mReadRecord = mAudioRecord;
+    mReadMemory = mCblkMemory;
+    if (audioBuffer->frameCount == 0) {
+        audioBuffer->frameCount = mFrameCount;
+    }
+    mLock.unlock();
+
+    // same wait count as read(), see there
+    status_t err = obtainBuffer(audioBuffer, ((2 * MAX_RUN_TIMEOUT_MS) / WAIT_PERIOD_MS));
+    if (err == status_t(STOPPED)) {
+        err = NO_ERROR;
+    }
+    if (err != NO_ERROR || audioBuffer->frameCount == 0) {
+        audioBuffer->frameCount = 0;
+        audioBuffer->size = 0;
+        audioBuffer->raw = NULL;
+        AutoMutex lock(mLock);
+        mReadRecord.clear();
+        mReadMemory.clear();
+        return err == NO_ERROR ? status_t(NO_MORE_BUFFERS) : err;
+    }
+    return NO_ERROR;
+}
+
+void AudioRecord::releaseReadBuffer(Buffer* audioBuffer)
+{
+    sp<IAudioRecord> audioRecord;
+    sp<IMemory> iMem;
+    {
+        AutoMutex lock(mLock);
+        if (mReadMemory == 0) {
+            ALOGW("releaseReadBuffer() no read buffer outstanding");
+            return;
+        }
+        // only step the user position if the buffer still belongs to the current cblk
+        if (mReadMemory == mCblkMemory) {
+            mCblk->stepUser(audioBuffer->frameCount);
+        }
+        audioRecord = mReadRecord;
+        iMem = mReadMemory;
+        mReadRecord.clear();
+        mReadMemory.clear();
+    }
+    audioBuffer->frameCount = 0;
+    audioBuffer->size = 0;
+    audioBuffer->raw = NULL;
+    // the last references may be dropped here, outside of mLock
+}
+
 // -------------------------------------------------------------------------
 
 bool AudioRecord::processAudioBuffer(const sp<ClientRecordThread>& thread)
@@ -839,6 +920,23 @@ bool AudioRecord::processAudioBuffer(const sp<ClientRecordThread>& thread)
         }
     }
 
+    // When batching, sleep until the whole notification period has been recorded rather than
+    // being woken up by each write of the record thread. The sleep is bounded by the period
+    // so that markers and position updates are still handled in time.
+    if (mBatchNotifications && mActive) {
+        uint32_t framesReady = cblk->framesReady();
+        if (framesReady < frames) {
+            uint32_t waitUs = (uint32_t)(((uint64_t)(frames - framesReady) * 1000000) /
+                    cblk->sampleRate);
+            bool timedEvents = mUpdatePeriod > 0 || (!mMarkerReached && (mMarkerPosition > 0));
+            if (timedEvents && waitUs > WAIT_PERIOD_MS * 1000) {
+                waitUs = WAIT_PERIOD_MS * 1000;
+            }
+            usleep(waitUs);
+            return true;
+        }
+    }
+
     do {
         audioBuffer.frameCount = frames;
         // Calling obtainBuffer() with a wait count of 1
@@ -34,8 +34,10 @@ Mutex AudioSystem::gLock;
 sp<IAudioFlinger> AudioSystem::gAudioFlinger;
 sp<AudioSystem::AudioFlingerClient> AudioSystem::gAudioFlingerClient;
 audio_error_callback AudioSystem::gAudioErrorCallback = NULL;
-// Cached values
+// Cached values, kept up to date by AudioFlingerClient::ioConfigChanged() once the client
+// is registered with AudioFlinger, all protected by gLock
 
+DefaultKeyedVector<audio_stream_type_t, audio_io_handle_t> AudioSystem::gStreamOutputMap(0);
 DefaultKeyedVector<audio_io_handle_t, AudioSystem::OutputDescriptor *> AudioSystem::gOutputs(0);
 
 // Cached values for recording queries, all protected by gLock
@@ -212,13 +214,7 @@ status_t AudioSystem::getOutputSamplingRate(int* samplingRate, int streamType) {
 
 status_t AudioSystem::getOutputSamplingRate(int* samplingRate, audio_stream_type_t streamType)
 {
-    audio_io_handle_t output;
-
-    if (streamType == AUDIO_STREAM_DEFAULT) {
-        streamType = AUDIO_STREAM_MUSIC;
-    }
-
-    output = getOutput(streamType);
+    audio_io_handle_t output = getStreamOutput(streamType);
     if (output == 0) {
         return PERMISSION_DENIED;
     }
@@ -230,21 +226,12 @@ status_t AudioSystem::getSamplingRate(audio_io_handle_t output,
                                       audio_stream_type_t streamType,
                                       int* samplingRate)
 {
-    OutputDescriptor *outputDesc;
-
-    gLock.lock();
-    outputDesc = AudioSystem::gOutputs.valueFor(output);
-    if (outputDesc == NULL) {
-        ALOGV("getOutputSamplingRate() no output descriptor for output %d in gOutputs", output);
-        gLock.unlock();
-        const sp<IAudioFlinger>& af = AudioSystem::get_audio_flinger();
-        if (af == 0) return PERMISSION_DENIED;
-        *samplingRate = af->sampleRate(output);
-    } else {
-        ALOGV("getOutputSamplingRate() reading from output desc");
-        *samplingRate = outputDesc->samplingRate;
-        gLock.unlock();
+    OutputDescriptor desc;
+    status_t status = getOutputDescriptor(output, &desc);
+    if (status != NO_ERROR) {
+        return status;
     }
+    *samplingRate = desc.samplingRate;
 
     ALOGV("getSamplingRate() streamType %d, output %d, sampling rate %d", streamType, output, *samplingRate);
 
@@ -258,13 +245,7 @@ status_t AudioSystem::getOutputFrameCount(int* frameCount, int streamType) {
 
 status_t AudioSystem::getOutputFrameCount(int* frameCount, audio_stream_type_t streamType)
 {
-    audio_io_handle_t output;
-
-    if (streamType == AUDIO_STREAM_DEFAULT) {
-        streamType = AUDIO_STREAM_MUSIC;
-    }
-
-    output = getOutput(streamType);
+    audio_io_handle_t output = getStreamOutput(streamType);
     if (output == 0) {
         return PERMISSION_DENIED;
     }
@@ -276,19 +257,12 @@ status_t AudioSystem::getFrameCount(audio_io_handle_t output,
                                     audio_stream_type_t streamType,
                                     int* frameCount)
 {
-    OutputDescriptor *outputDesc;
-
-    gLock.lock();
-    outputDesc = AudioSystem::gOutputs.valueFor(output);
-    if (outputDesc == NULL) {
-        gLock.unlock();
-        const sp<IAudioFlinger>& af = AudioSystem::get_audio_flinger();
-        if (af == 0) return PERMISSION_DENIED;
-        *frameCount = af->frameCount(output);
-    } else {
-        *frameCount = outputDesc->frameCount;
-        gLock.unlock();
+    OutputDescriptor desc;
+    status_t status = getOutputDescriptor(output, &desc);
+    if (status != NO_ERROR) {
+        return status;
     }
+    *frameCount = desc.frameCount;
 
     ALOGV("getFrameCount() streamType %d, output %d, frameCount %d", streamType, output, *frameCount);
 
@@ -297,13 +271,7 @@ status_t AudioSystem::getFrameCount(audio_io_handle_t output,
 
 status_t AudioSystem::getOutputLatency(uint32_t* latency, audio_stream_type_t streamType)
 {
-    audio_io_handle_t output;
-
-    if (streamType == AUDIO_STREAM_DEFAULT) {
-        streamType = AUDIO_STREAM_MUSIC;
-    }
-
-    output = getOutput(streamType);
+    audio_io_handle_t output = getStreamOutput(streamType);
     if (output == 0) {
         return PERMISSION_DENIED;
     }
@@ -315,25 +283,105 @@ status_t AudioSystem::getLatency(audio_io_handle_t output,
                                  audio_stream_type_t streamType,
                                  uint32_t* latency)
 {
-    OutputDescriptor *outputDesc;
+    OutputDescriptor desc;
+    status_t status = getOutputDescriptor(output, &desc);
+    if (status != NO_ERROR) {
+        return status;
+    }
+    *latency = desc.latency;
 
+    ALOGV("getLatency() streamType %d, output %d, latency %d", streamType, output, *latency);
+
+    return NO_ERROR;
+}
+
+status_t AudioSystem::getStreamOutputDescriptor(audio_stream_type_t streamType,
+                                                OutputDescriptor *desc)
+{
+    audio_io_handle_t output = getStreamOutput(streamType);
+    if (output == 0) {
+        return PERMISSION_DENIED;
+    }
+
+    return getOutputDescriptor(output, desc);
+}
+
+status_t AudioSystem::getOutputDescriptor(audio_io_handle_t output, OutputDescriptor *desc)
+{
     gLock.lock();
-    outputDesc = AudioSystem::gOutputs.valueFor(output);
-    if (outputDesc == NULL) {
-        gLock.unlock();
-        const sp<IAudioFlinger>& af = AudioSystem::get_audio_flinger();
-        if (af == 0) return PERMISSION_DENIED;
-        *latency = af->latency(output);
-    } else {
-        *latency = outputDesc->latency;
+    const OutputDescriptor *outputDesc = gOutputs.valueFor(output);
+    if (outputDesc != NULL) {
+        *desc = *outputDesc;
         gLock.unlock();
+        return NO_ERROR;
     }
+    gLock.unlock();
 
-    ALOGV("getLatency() streamType %d, output %d, latency %d", streamType, output, *latency);
+    ALOGV("getOutputDescriptor() no output descriptor for output %d in gOutputs", output);
+    // get_audio_flinger() registers for ioConfigChanged(), which keeps the entry added
+    // below up to date from now on
+    const sp<IAudioFlinger>& af = AudioSystem::get_audio_flinger();
+    if (af == 0) return PERMISSION_DENIED;
+
+    uint32_t samplingRate;
+    audio_format_t format;
+    audio_channel_mask_t channelMask;
+    size_t frameCount;
+    uint32_t latency;
+    if (af->getOutputConfig(output, &samplingRate, &format, &channelMask, &frameCount,
+            &latency) != NO_ERROR) {
+        // not a playback thread, such as a direct session: query each value and do not cache
+        desc->samplingRate = af->sampleRate(output);
+        desc->format = af->format(output);
+        desc->channels = audio_channel_out_mask_from_count(af->channelCount(output));
+        desc->frameCount = af->frameCount(output);
+        desc->latency = af->latency(output);
+        return NO_ERROR;
+    }
 
+    desc->samplingRate = samplingRate;
+    desc->format = format;
+    desc->channels = channelMask;
+    desc->frameCount = frameCount;
+    desc->latency = latency;
+
+    Mutex::Autolock _l(gLock);
+    // ioConfigChanged() may have added a newer configuration in the meantime
+    ssize_t index = gOutputs.indexOfKey(output);
+    if (index < 0) {
+        gOutputs.add(output, new OutputDescriptor(*desc));
+    } else {
+        *desc = *gOutputs.valueAt(index);
+    }
     return NO_ERROR;
 }
 
+audio_io_handle_t AudioSystem::getStreamOutput(audio_stream_type_t streamType)
+{
+    if (streamType == AUDIO_STREAM_DEFAULT) {
+        streamType = AUDIO_STREAM_MUSIC;
+    }
+
+    gLock.lock();
+    audio_io_handle_t output = gStreamOutputMap.valueFor(streamType);
+    gLock.unlock();
+    if (output != 0) {
+        return output;
+    }
+
+    // AudioFlinger reports the streams the policy moves to another output with
+    // STREAM_CONFIG_CHANGED, so only cache once registered for ioConfigChanged()
+    bool registered = AudioSystem::get_audio_flinger() != 0;
+    output = getOutput(streamType);
+    if (output != 0 && registered) {
+        Mutex::Autolock _l(gLock);
+        if (gStreamOutputMap.indexOfKey(streamType) < 0) {
+            gStreamOutputMap.add(streamType, output);
+        }
+    }
+    return output;
+}
+
 status_t AudioSystem::getInputBufferSize(uint32_t sampleRate, audio_format_t format, int channelCount,
     size_t* buffSize)
 {
@@ -427,6 +475,7 @@ void AudioSystem::AudioFlingerClient::binderDied(const wp<IBinder>& who) {
 
     AudioSystem::gAudioFlinger.clear();
     // clear output handles and stream to output map caches
+    AudioSystem::gStreamOutputMap.clear();
     AudioSystem::gOutputs.clear();
 
     if (gAudioErrorCallback) {
@@ -446,8 +495,14 @@ void AudioSystem::AudioFlingerClient::ioConfigChanged(int event, audio_io_handle
     Mutex::Autolock _l(AudioSystem::gLock);
 
     switch (event) {
-    case STREAM_CONFIG_CHANGED:
-        break;
+    case STREAM_CONFIG_CHANGED: {
+        if (param2 == NULL) break;
+        stream = (audio_stream_type_t) *(const uint32_t *)param2;
+        ALOGV("ioConfigChanged() stream %d moved to output %d", stream, ioHandle);
+        if (gStreamOutputMap.indexOfKey(stream) >= 0) {
+            gStreamOutputMap.replaceValueFor(stream, ioHandle);
+        }
+        } break;
     case OUTPUT_OPENED: {
         if (gOutputs.indexOfKey(ioHandle) >= 0) {
             ALOGV("ioConfigChanged() opening already existing output! %d", ioHandle);
@@ -468,24 +523,29 @@ void AudioSystem::AudioFlingerClient::ioConfigChanged(int event, audio_io_handle
         }
         ALOGV("ioConfigChanged() output %d closed", ioHandle);
 
+        delete gOutputs.valueFor(ioHandle);
         gOutputs.removeItem(ioHandle);
+        for (size_t i = gStreamOutputMap.size(); i > 0; i--) {
+            if (gStreamOutputMap.valueAt(i - 1) == ioHandle) {
+                gStreamOutputMap.removeItemsAt(i - 1);
+            }
+        }
         } break;
 
     case OUTPUT_CONFIG_CHANGED: {
-        int index = gOutputs.indexOfKey(ioHandle);
-        if (index < 0) {
-            ALOGW("ioConfigChanged() modifying unknow output! %d", ioHandle);
-            break;
-        }
         if (param2 == NULL) break;
         desc = (const OutputDescriptor *)param2;
 
         ALOGV("ioConfigChanged() new config for output %d samplingRate %d, format %d channels %d frameCount %d latency %d",
                 ioHandle, desc->samplingRate, desc->format,
                 desc->channels, desc->frameCount, desc->latency);
-        OutputDescriptor *outputDesc = gOutputs.valueAt(index);
-        delete outputDesc;
-        outputDesc =  new OutputDescriptor(*desc);
+        // an output first queried through getOutputDescriptor() is only added once the
+        // reply is back, so take the new configuration even if the output is unknown
+        int index = gOutputs.indexOfKey(ioHandle);
+        if (index >= 0) {
+            delete gOutputs.valueAt(index);
+        }
+        OutputDescriptor *outputDesc =  new OutputDescriptor(*desc);
         gOutputs.replaceValueFor(ioHandle, outputDesc);
     } break;
     case INPUT_OPENED:
@@ -758,6 +818,7 @@ void AudioSystem::clearAudioConfigCache()
 {
     Mutex::Autolock _l(gLock);
     ALOGV("clearAudioConfigCache()");
+    gStreamOutputMap.clear();
     gOutputs.clear();
 }
 
@@ -766,6 +827,8 @@ void AudioSystem::clearAudioConfigCache()
 void AudioSystem::AudioPolicyServiceClient::binderDied(const wp<IBinder>& who) {
     Mutex::Autolock _l(AudioSystem::gLock);
     AudioSystem::gAudioPolicyService.clear();
+    // the new policy service may route streams differently
+    AudioSystem::gStreamOutputMap.clear();
 
     ALOGW("AudioPolicyService server died!");
 }
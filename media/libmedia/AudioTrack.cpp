@@ -60,16 +60,14 @@ status_t AudioTrack::getMinFrameCount(
     //          audio_format_t format
     //          audio_channel_mask_t channelMask
     //          audio_output_flags_t flags
-    int afSampleRate;
-    if (AudioSystem::getOutputSamplingRate(&afSampleRate, streamType) != NO_ERROR) {
+    AudioSystem::OutputDescriptor desc;
+    if (AudioSystem::getStreamOutputDescriptor(streamType, &desc) != NO_ERROR) {
         return NO_INIT;
     }
-    int afFrameCount;
-    if (AudioSystem::getOutputFrameCount(&afFrameCount, streamType) != NO_ERROR) {
-        return NO_INIT;
-    }
-    uint32_t afLatency;
-    if (AudioSystem::getOutputLatency(&afLatency, streamType) != NO_ERROR) {
+    int afSampleRate = desc.samplingRate;
+    int afFrameCount = desc.frameCount;
+    uint32_t afLatency = desc.latency;
+    if (afSampleRate == 0 || afFrameCount == 0) {
         return NO_INIT;
     }
 
@@ -122,7 +120,8 @@ AudioTrack::AudioTrack()
     : mStatus(NO_INIT),
       mIsTimed(false),
       mPreviousPriority(ANDROID_PRIORITY_NORMAL),
-      mPreviousSchedulingGroup(SP_DEFAULT)
+      mPreviousSchedulingGroup(SP_DEFAULT),
+      mWriteBatchMs(0), mWakeups(0), mWakeupsSince(0)
 #ifdef QCOM_HARDWARE
       ,mAudioFlinger(NULL),
       mObserver(NULL)
@@ -144,7 +143,8 @@ AudioTrack::AudioTrack(
     : mStatus(NO_INIT),
       mIsTimed(false),
       mPreviousPriority(ANDROID_PRIORITY_NORMAL),
-      mPreviousSchedulingGroup(SP_DEFAULT)
+      mPreviousSchedulingGroup(SP_DEFAULT),
+      mWriteBatchMs(0), mWakeups(0), mWakeupsSince(0)
 #ifdef QCOM_HARDWARE
       ,mAudioFlinger(NULL),
       mObserver(NULL)
@@ -169,7 +169,8 @@ AudioTrack::AudioTrack(
         int sessionId)
     : mStatus(NO_INIT),
       mIsTimed(false),
-      mPreviousPriority(ANDROID_PRIORITY_NORMAL), mPreviousSchedulingGroup(SP_DEFAULT)
+      mPreviousPriority(ANDROID_PRIORITY_NORMAL), mPreviousSchedulingGroup(SP_DEFAULT),
+      mWriteBatchMs(0), mWakeups(0), mWakeupsSince(0)
 #ifdef QCOM_HARDWARE
       ,mAudioFlinger(NULL),
       mObserver(NULL)
@@ -194,7 +195,8 @@ AudioTrack::AudioTrack(
     : mStatus(NO_INIT),
       mIsTimed(false),
       mPreviousPriority(ANDROID_PRIORITY_NORMAL),
-      mPreviousSchedulingGroup(SP_DEFAULT)
+      mPreviousSchedulingGroup(SP_DEFAULT),
+      mWriteBatchMs(0), mWakeups(0), mWakeupsSince(0)
 #ifdef QCOM_HARDWARE
       ,mAudioFlinger(NULL),
       mObserver(NULL)
@@ -220,6 +222,9 @@ AudioTrack::~AudioTrack()
             mAudioTrackThread->requestExitAndWait();
             mAudioTrackThread.clear();
         }
+        // Release the control block before the track, so that AudioFlinger finds
+        // it unused and can recycle it for the next track when the track goes away.
+        mCblkMemory.clear();
 #ifdef QCOM_HARDWARE
         if (mAudioTrack != 0) {
             mAudioTrack.clear();
@@ -863,6 +868,36 @@ status_t AudioTrack::getPositionUpdatePeriod(uint32_t *updatePeriod) const
     return NO_ERROR;
 }
 
+status_t AudioTrack::setWriteBatching(uint32_t latencyMs)
+{
+    if (mSharedBuffer != 0 || mIsTimed) return INVALID_OPERATION;
+
+    AutoMutex lock(mLock);
+    mWriteBatchMs = latencyMs;
+    applyWriteBatching_l();
+    return NO_ERROR;
+}
+
+void AudioTrack::applyWriteBatching_l()
+{
+    if (mCblkMemory == 0) return;
+
+    uint32_t frames = (uint32_t) (((uint64_t) mWriteBatchMs * mCblk->sampleRate) / 1000);
+    // keep at least half the buffer filled when the client is woken up
+    if (frames > mCblk->frameCount / 2) {
+        frames = mCblk->frameCount / 2;
+    }
+    mCblk->wakeThreshold = frames;
+    mWakeups = 0;
+    mWakeupsSince = systemTime();
+}
+
+uint32_t AudioTrack::getWakeups() const
+{
+    AutoMutex lock(mLock);
+    return mWakeups;
+}
+
 status_t AudioTrack::setPosition(uint32_t position)
 {
     if (mIsTimed) return INVALID_OPERATION;
@@ -1122,6 +1157,7 @@ status_t AudioTrack::createTrack_l(
     mAudioTrack->attachAuxEffect(mAuxEffectId);
     mCblk->bufferTimeoutMs = MAX_STARTUP_TIMEOUT_MS;
     mCblk->waitTimeMs = 0;
+    applyWriteBatching_l();
     mRemainingFrames = mNotificationFramesAct;
     // FIXME don't believe this lie
     mLatency = afLatency + (1000*mCblk->frameCount) / sampleRate;
@@ -1172,6 +1208,9 @@ status_t AudioTrack::obtainBuffer(Buffer* audioBuffer, int32_t waitCount)
                 result = cblk->cv.waitRelative(cblk->lock, milliseconds(waitTimeMs));
                 cblk->lock.unlock();
                 mLock.lock();
+                if (result == NO_ERROR) {
+                    mWakeups++;
+                }
                 if (!mActive) {
                     return status_t(STOPPED);
                 }
@@ -1648,6 +1687,10 @@ status_t AudioTrack::dump(int fd, const Vector<String16>& args) const
     result.append(buffer);
     snprintf(buffer, 255, "  active(%d), latency (%d)\n", mActive, mLatency);
     result.append(buffer);
+    nsecs_t elapsed = systemTime() - mWakeupsSince;
+    snprintf(buffer, 255, "  write batching (%u ms), wakeups (%u, %.1f/s)\n", mWriteBatchMs,
+            mWakeups, elapsed > 0 ? mWakeups * 1e9 / elapsed : 0.0);
+    result.append(buffer);
     ::write(fd, result.string(), result.size());
     return NO_ERROR;
 }
@@ -1734,7 +1777,7 @@ audio_track_cblk_t::audio_track_cblk_t()
     : lock(Mutex::SHARED), cv(Condition::SHARED), user(0), server(0),
     userBase(0), serverBase(0), buffers(NULL), frameCount(0),
     loopStart(UINT_MAX), loopEnd(UINT_MAX), loopCount(0), mVolumeLR(0x10001000),
-    mSendLevel(0), flags(0)
+    mSendLevel(0), flags(0), wakeThreshold(0)
 {
 }
 
@@ -1828,7 +1871,11 @@ bool audio_track_cblk_t::stepServer(uint32_t frameCount)
     server = s;
 
     if (!(flags & CBLK_INVALID_MSK)) {
-        cv.signal();
+        // with batched writes, let the client sleep until it can write a whole batch
+        if (wakeThreshold == 0 || !(flags & CBLK_DIRECTION_MSK) ||
+                framesAvailable_l() >= wakeThreshold) {
+            cv.signal();
+        }
     }
     lock.unlock();
     return true;
@@ -76,8 +76,9 @@ enum {
 #endif
     LOAD_HW_MODULE,
 #ifdef QCOM_HARDWARE
-    CREATE_DIRECT_TRACK
+    CREATE_DIRECT_TRACK,
 #endif
+    GET_OUTPUT_CONFIG,
 };
 
 class BpAudioFlinger : public BpInterface<IAudioFlinger>
@@ -268,6 +269,30 @@ public:
         return reply.readInt32();
     }
 
+    virtual status_t getOutputConfig(audio_io_handle_t output,
+                                     uint32_t *samplingRate,
+                                     audio_format_t *format,
+                                     audio_channel_mask_t *channelMask,
+                                     size_t *frameCount,
+                                     uint32_t *latency) const
+    {
+        Parcel data, reply;
+        data.writeInterfaceToken(IAudioFlinger::getInterfaceDescriptor());
+        data.writeInt32((int32_t) output);
+        status_t status = remote()->transact(GET_OUTPUT_CONFIG, data, &reply);
+        if (status == NO_ERROR) {
+            status = reply.readInt32();
+        }
+        if (status == NO_ERROR) {
+            *samplingRate = reply.readInt32();
+            *format = (audio_format_t) reply.readInt32();
+            *channelMask = (audio_channel_mask_t) reply.readInt32();
+            *frameCount = reply.readInt32();
+            *latency = reply.readInt32();
+        }
+        return status;
+    }
+
     virtual status_t setMasterVolume(float value)
     {
         Parcel data, reply;
@@ -838,6 +863,25 @@ status_t BnAudioFlinger::onTransact(
             reply->writeInt32( latency((audio_io_handle_t) data.readInt32()) );
             return NO_ERROR;
         } break;
+        case GET_OUTPUT_CONFIG: {
+            CHECK_INTERFACE(IAudioFlinger, data, reply);
+            uint32_t samplingRate = 0;
+            audio_format_t format = AUDIO_FORMAT_DEFAULT;
+            audio_channel_mask_t channelMask = 0;
+            size_t frameCount = 0;
+            uint32_t latency = 0;
+            status_t status = getOutputConfig((audio_io_handle_t) data.readInt32(),
+                    &samplingRate, &format, &channelMask, &frameCount, &latency);
+            reply->writeInt32(status);
+            if (status == NO_ERROR) {
+                reply->writeInt32(samplingRate);
+                reply->writeInt32(format);
+                reply->writeInt32(channelMask);
+                reply->writeInt32(frameCount);
+                reply->writeInt32(latency);
+            }
+            return NO_ERROR;
+        } break;
         case SET_MASTER_VOLUME: {
             CHECK_INTERFACE(IAudioFlinger, data, reply);
             reply->writeInt32( setMasterVolume(data.readFloat()) );
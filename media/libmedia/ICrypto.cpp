@@ -18,6 +18,7 @@
 #define LOG_TAG "ICrypto"
 #include <utils/Log.h>
 
+#include <binder/IMemory.h>
 #include <binder/Parcel.h>
 #include <media/ICrypto.h>
 #include <media/stagefright/MediaErrors.h>
@@ -33,6 +34,7 @@ enum {
     DESTROY_PLUGIN,
     REQUIRES_SECURE_COMPONENT,
     DECRYPT,
+    DECRYPT_BATCH,
 };
 
 struct BpCrypto : public BpInterface<ICrypto> {
@@ -153,6 +155,61 @@ struct BpCrypto : public BpInterface<ICrypto> {
         return OK;
     }
 
+    virtual status_t decryptBatch(
+            bool secure,
+            const sp<IMemory> &srcMem,
+            const sp<IMemory> &dstMem,
+            const DecryptUnit *units, size_t numUnits,
+            size_t *numDecrypted,
+            AString *errorDetailMsg) {
+        *numDecrypted = 0;
+
+        if (srcMem == NULL || (!secure && dstMem == NULL)
+                || numUnits > kMaxDecryptUnits) {
+            return -EINVAL;
+        }
+
+        Parcel data, reply;
+        data.writeInterfaceToken(ICrypto::getInterfaceDescriptor());
+        data.writeInt32(secure);
+        data.writeStrongBinder(srcMem->asBinder());
+        if (!secure) {
+            data.writeStrongBinder(dstMem->asBinder());
+        }
+
+        data.writeInt32(numUnits);
+        for (size_t i = 0; i < numUnits; ++i) {
+            const DecryptUnit &unit = units[i];
+
+            data.writeInt32(unit.mMode);
+            data.write(unit.mKey, 16);
+            data.write(unit.mIV, 16);
+            data.writeInt32(unit.mSrcOffset);
+
+            if (secure) {
+                data.writeIntPtr((intptr_t)unit.mDstPtr);
+            } else {
+                data.writeInt32(unit.mDstOffset);
+            }
+
+            data.writeInt32(unit.mNumSubSamples);
+            data.write(
+                    unit.mSubSamples,
+                    sizeof(CryptoPlugin::SubSample) * unit.mNumSubSamples);
+        }
+
+        remote()->transact(DECRYPT_BATCH, data, &reply);
+
+        status_t result = reply.readInt32();
+        *numDecrypted = reply.readInt32();
+
+        if (result >= ERROR_DRM_VENDOR_MIN && result <= ERROR_DRM_VENDOR_MAX) {
+            errorDetailMsg->setTo(reply.readCString());
+        }
+
+        return result;
+    }
+
 private:
     DISALLOW_EVIL_CONSTRUCTORS(BpCrypto);
 };
@@ -295,6 +352,101 @@ status_t BnCrypto::onTransact(
             return OK;
         }
 
+        case DECRYPT_BATCH:
+        {
+            CHECK_INTERFACE(ICrypto, data, reply);
+
+            bool secure = data.readInt32() != 0;
+
+            sp<IMemory> srcMem =
+                interface_cast<IMemory>(data.readStrongBinder());
+
+            sp<IMemory> dstMem;
+            if (!secure) {
+                dstMem = interface_cast<IMemory>(data.readStrongBinder());
+            }
+
+            size_t numUnits = data.readInt32();
+            if (srcMem == NULL || (!secure && dstMem == NULL)
+                    || numUnits > kMaxDecryptUnits) {
+                reply->writeInt32(-EINVAL);
+                reply->writeInt32(0);
+
+                return OK;
+            }
+
+            Vector<DecryptUnit> units;
+            Vector<CryptoPlugin::SubSample> subSamples;
+            Vector<size_t> subSampleIndex;
+            status_t err = OK;
+
+            for (size_t i = 0; i < numUnits; ++i) {
+                DecryptUnit unit;
+                unit.mMode = (CryptoPlugin::Mode)data.readInt32();
+                data.read(unit.mKey, sizeof(unit.mKey));
+                data.read(unit.mIV, sizeof(unit.mIV));
+                unit.mSrcOffset = data.readInt32();
+
+                unit.mDstOffset = 0;
+                unit.mDstPtr = NULL;
+                if (secure) {
+                    unit.mDstPtr = (void *)data.readIntPtr();
+                } else {
+                    unit.mDstOffset = data.readInt32();
+                }
+
+                unit.mNumSubSamples = data.readInt32();
+                unit.mSubSamples = NULL;
+
+                if (unit.mNumSubSamples == 0 || unit.mNumSubSamples > 0x10000) {
+                    err = -EINVAL;
+                    break;
+                }
+
+                const void *table = data.readInplace(
+                        sizeof(CryptoPlugin::SubSample) * unit.mNumSubSamples);
+
+                if (table == NULL) {
+                    err = -EINVAL;
+                    break;
+                }
+
+                subSampleIndex.push(subSamples.size());
+                subSamples.appendArray(
+                        (const CryptoPlugin::SubSample *)table,
+                        unit.mNumSubSamples);
+
+                units.push(unit);
+            }
+
+            size_t numDecrypted = 0;
+            AString errorDetailMsg;
+
+            if (err == OK) {
+                // The subsample table may have moved as it grew.
+                for (size_t i = 0; i < units.size(); ++i) {
+                    units.editItemAt(i).mSubSamples =
+                        subSamples.array() + subSampleIndex[i];
+                }
+
+                err = decryptBatch(
+                        secure, srcMem, dstMem,
+                        units.array(), units.size(),
+                        &numDecrypted,
+                        &errorDetailMsg);
+            }
+
+            reply->writeInt32(err);
+            reply->writeInt32(numDecrypted);
+
+            if (err >= ERROR_DRM_VENDOR_MIN
+                    && err <= ERROR_DRM_VENDOR_MAX) {
+                reply->writeCString(errorDetailMsg.c_str());
+            }
+
+            return OK;
+        }
+
         default:
             return BBinder::onTransact(code, data, reply, flags);
     }
@@ -39,7 +39,9 @@ enum {
     PAUSE,
     SET_VOLUME,
     WRITE,
-    GET_TIMESTAMP
+    GET_TIMESTAMP,
+    ALLOCATE_RING,
+    SIGNAL_RING
 };
 
 class BpDirectTrack : public BpInterface<IDirectTrack>
@@ -113,6 +115,29 @@ public:
         int64_t tstamp = remote()->transact(GET_TIMESTAMP, data, &reply);
         return tstamp;
     }
+
+    virtual sp<IMemory> allocateRing(size_t size, size_t watermark)
+    {
+        Parcel data, reply;
+        sp<IMemory> ring;
+        data.writeInterfaceToken(IDirectTrack::getInterfaceDescriptor());
+        data.writeInt32(size);
+        data.writeInt32(watermark);
+        status_t status = remote()->transact(ALLOCATE_RING, data, &reply);
+        if (status == NO_ERROR) {
+            ring = interface_cast<IMemory>(reply.readStrongBinder());
+        } else {
+            ALOGW("allocateRing() error: %s", strerror(-status));
+        }
+        return ring;
+    }
+
+    virtual void signalRing()
+    {
+        Parcel data, reply;
+        data.writeInterfaceToken(IDirectTrack::getInterfaceDescriptor());
+        remote()->transact(SIGNAL_RING, data, &reply, IBinder::FLAG_ONEWAY);
+    }
 };
 
 IMPLEMENT_META_INTERFACE(DirectTrack, "android.media.IDirectTrack");
@@ -169,6 +194,19 @@ status_t BnDirectTrack::onTransact(
             reply->writeInt32(time);
             return NO_ERROR;
         }
+        case ALLOCATE_RING: {
+            CHECK_INTERFACE(IDirectTrack, data, reply);
+            size_t size = data.readInt32();
+            size_t watermark = data.readInt32();
+            sp<IMemory> ring = allocateRing(size, watermark);
+            reply->writeStrongBinder(ring != 0 ? ring->asBinder() : sp<IBinder>(0));
+            return NO_ERROR;
+        }
+        case SIGNAL_RING: {
+            CHECK_INTERFACE(IDirectTrack, data, reply);
+            signalRing();
+            return NO_ERROR;
+        }
         default:
             return BBinder::onTransact(code, data, reply, flags);
     }
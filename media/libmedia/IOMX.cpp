@@ -49,6 +49,7 @@ enum {
     GET_EXTENSION_INDEX,
     OBSERVER_ON_MSG,
     GET_GRAPHIC_BUFFER_USAGE,
+    OBSERVER_ON_MSGS,
 };
 
 class BpOMX : public BpInterface<IOMX> {
@@ -760,10 +761,34 @@ public:
 
         remote()->transact(OBSERVER_ON_MSG, data, &reply, IBinder::FLAG_ONEWAY);
     }
+
+    virtual void onMessages(const List<omx_message> &messages) {
+        if (messages.size() == 1) {
+            onMessage(*messages.begin());
+            return;
+        }
+
+        Parcel data, reply;
+        data.writeInterfaceToken(IOMXObserver::getInterfaceDescriptor());
+        data.writeInt32(messages.size());
+        for (List<omx_message>::const_iterator it = messages.begin();
+                it != messages.end(); ++it) {
+            data.write(&*it, sizeof(omx_message));
+        }
+
+        remote()->transact(OBSERVER_ON_MSGS, data, &reply, IBinder::FLAG_ONEWAY);
+    }
 };
 
 IMPLEMENT_META_INTERFACE(OMXObserver, "android.hardware.IOMXObserver");
 
+void IOMXObserver::onMessages(const List<omx_message> &messages) {
+    for (List<omx_message>::const_iterator it = messages.begin();
+            it != messages.end(); ++it) {
+        onMessage(*it);
+    }
+}
+
 status_t BnOMXObserver::onTransact(
     uint32_t code, const Parcel &data, Parcel *reply, uint32_t flags) {
     switch (code) {
@@ -780,6 +805,27 @@ status_t BnOMXObserver::onTransact(
             return NO_ERROR;
         }
 
+        case OBSERVER_ON_MSGS:
+        {
+            CHECK_INTERFACE(IOMXObserver, data, reply);
+
+            size_t count = data.readInt32();
+            if (count > data.dataAvail() / sizeof(omx_message)) {
+                return BAD_VALUE;
+            }
+
+            List<omx_message> messages;
+            for (size_t i = 0; i < count; ++i) {
+                omx_message msg;
+                data.read(&msg, sizeof(msg));
+                messages.push_back(msg);
+            }
+
+            onMessages(messages);
+
+            return NO_ERROR;
+        }
+
         default:
             return BBinder::onTransact(code, data, reply, flags);
     }
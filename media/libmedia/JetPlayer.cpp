@@ -27,10 +27,13 @@ namespace android
 {
 
 static const int MIX_NUM_BUFFERS = 4;
+// how long the render thread waits for room in the render queue before checking its state again
+static const int QUEUE_WAIT_MS = 10;
 static const S_EAS_LIB_CONFIG* pLibConfig = NULL;
 
 //-------------------------------------------------------------------------------------------------
-JetPlayer::JetPlayer(void *javaJetPlayer, int maxTracks, int trackBufferSize) :
+JetPlayer::JetPlayer(void *javaJetPlayer, int maxTracks, int trackBufferSize,
+        int renderQueueDepth) :
         mEventCallback(NULL),
         mJavaJetPlayerRef(javaJetPlayer),
         mTid(-1),
@@ -39,8 +42,15 @@ JetPlayer::JetPlayer(void *javaJetPlayer, int maxTracks, int trackBufferSize) :
         mMaxTracks(maxTracks),
         mEasData(NULL),
         mEasJetFileLoc(NULL),
+        mAudioBuffer(NULL),
         mAudioTrack(NULL),
-        mTrackBufferSize(trackBufferSize)
+        mTrackBufferSize(trackBufferSize),
+        mRenderQueue(NULL),
+        mRenderQueueDepth(renderQueueDepth < 1 ? 1 : renderQueueDepth),
+        mBlockSize(0),
+        mQueueSize(0),
+        mQueueReadOffset(0),
+        mQueueFilled(0)
 {
     ALOGV("JetPlayer constructor");
     mPreviousJetStatus.currentUserID = -1;
@@ -87,14 +97,16 @@ int JetPlayer::init()
         return result;
     }
 
-    // create the output AudioTrack
+    // create the output AudioTrack, fed from the render queue by its callback
     mAudioTrack = new AudioTrack();
     mAudioTrack->set(AUDIO_STREAM_MUSIC,  //TODO parameterize this
             pLibConfig->sampleRate,
             AUDIO_FORMAT_PCM_16_BIT,
             audio_channel_out_mask_from_count(pLibConfig->numChannels),
             mTrackBufferSize,
-            AUDIO_OUTPUT_FLAG_NONE);
+            AUDIO_OUTPUT_FLAG_NONE,
+            audioCallback,
+            this);
 
     // create render and playback thread
     {
@@ -130,11 +142,20 @@ int JetPlayer::release()
     Mutex::Autolock lock(mMutex);
     mPaused = true;
     mRender = false;
-    if (mEasData) {
-        JET_Pause(mEasData);
-        JET_CloseFile(mEasData);
-        JET_Shutdown(mEasData);
-        EAS_Shutdown(mEasData);
+    EAS_DATA_HANDLE easData = mEasData;
+    mEasData = NULL;
+
+    // wait for the render thread to exit, it frees the render buffers
+    mCondition.broadcast();
+    while (mTid > 0) {
+        mCondition.wait(mMutex);
+    }
+
+    if (easData) {
+        JET_Pause(easData);
+        JET_CloseFile(easData);
+        JET_Shutdown(easData);
+        EAS_Shutdown(easData);
     }
     if (mEasJetFileLoc) {
         free(mEasJetFileLoc);
@@ -146,11 +167,10 @@ int JetPlayer::release()
         delete mAudioTrack;
         mAudioTrack = NULL;
     }
-    if (mAudioBuffer) {
-        delete mAudioBuffer;
-        mAudioBuffer = NULL;
+    {
+        Mutex::Autolock pendingLock(mPendingLock);
+        mPendingSegments.clear();
     }
-    mEasData = NULL;
 
     return EAS_SUCCESS;
 }
@@ -160,14 +180,22 @@ int JetPlayer::release()
 int JetPlayer::render() {
     EAS_RESULT result = EAS_FAILURE;
     EAS_I32 count;
-    int temp;
     bool audioStarted = false;
 
     ALOGV("JetPlayer::render(): entering");
 
-    // allocate render buffer
+    // allocate render buffer and render queue
     mAudioBuffer =
         new EAS_PCM[pLibConfig->mixBufferSize * pLibConfig->numChannels * MIX_NUM_BUFFERS];
+    {
+        Mutex::Autolock l(mQueueLock);
+        mBlockSize = pLibConfig->mixBufferSize * pLibConfig->numChannels * sizeof(EAS_PCM)
+                * MIX_NUM_BUFFERS;
+        mQueueSize = mBlockSize * mRenderQueueDepth;
+        mRenderQueue = new EAS_PCM[mQueueSize / sizeof(EAS_PCM)];
+        mQueueReadOffset = 0;
+        mQueueFilled = 0;
+    }
 
     // signal main thread that we started
     {
@@ -181,14 +209,9 @@ int JetPlayer::render() {
 
         mMutex.lock(); // [[[[[[[[ LOCK ---------------------------------------
 
-        if (mEasData == NULL) {
-            mMutex.unlock();
-            ALOGV("JetPlayer::render(): NULL EAS data, exiting render.");
-            goto threadExit;
-        }
-
         // nothing to render, wait for client thread to wake us up
-        while (!mRender)
+        queuePendingSegments();
+        while (!mRender && mEasData != NULL)
         {
             ALOGV("JetPlayer::render(): signal wait");
             if (audioStarted) {
@@ -198,12 +221,52 @@ int JetPlayer::render() {
             }
             mCondition.wait(mMutex);
             ALOGV("JetPlayer::render(): signal rx'd");
+            queuePendingSegments();
+        }
+
+        if (mEasData == NULL) {
+            mMutex.unlock();
+            ALOGV("JetPlayer::render(): NULL EAS data, exiting render.");
+            goto threadExit;
         }
 
-        // render midi data into the input buffer
+        mMutex.unlock(); // UNLOCK ]]]]]]]] -----------------------------------
+
+        // check audio output track
+        if (mAudioTrack == NULL) {
+            ALOGE("JetPlayer::render(): output AudioTrack was not created");
+            goto threadExit;
+        }
+
+        // wait for room in the render queue, without holding mMutex so that JET calls from
+        // the application are not delayed
+        bool queueFull;
+        {
+            Mutex::Autolock l(mQueueLock);
+            queueFull = mQueueFilled + mBlockSize > mQueueSize;
+            if (queueFull && audioStarted) {
+                mQueueCondition.waitRelative(mQueueLock, milliseconds(QUEUE_WAIT_MS));
+            }
+        }
+        if (queueFull) {
+            // start audio output if necessary, it drains the queue
+            if (!audioStarted && mRender) {
+                ALOGV("JetPlayer::render(): starting audio playback");
+                mAudioTrack->start();
+                audioStarted = true;
+            }
+            continue;
+        }
+
+        // render midi data into the input buffer, one mix buffer per lock
         int num_output = 0;
         EAS_PCM* p = mAudioBuffer;
         for (int i = 0; i < MIX_NUM_BUFFERS; i++) {
+            Mutex::Autolock l(mMutex);
+            if (mEasData == NULL || !mRender) {
+                break;
+            }
+            queuePendingSegments();
             result = EAS_Render(mEasData, p, pLibConfig->mixBufferSize, &count);
             if (result != EAS_SUCCESS) {
                 ALOGE("JetPlayer::render(): EAS_Render returned error %ld", result);
@@ -217,27 +280,19 @@ int JetPlayer::render() {
 
         // update playback state
         //ALOGV("JetPlayer::render(): updating state");
-        JET_Status(mEasData, &mJetStatus);
-        fireUpdateOnStatusChange();
-        mPaused = mJetStatus.paused;
-
-        mMutex.unlock(); // UNLOCK ]]]]]]]] -----------------------------------
-
-        // check audio output track
-        if (mAudioTrack == NULL) {
-            ALOGE("JetPlayer::render(): output AudioTrack was not created");
-            goto threadExit;
+        mMutex.lock();
+        if (mEasData != NULL) {
+            JET_Status(mEasData, &mJetStatus);
+            fireUpdateOnStatusChange();
+            mPaused = mJetStatus.paused;
         }
+        mMutex.unlock();
 
-        // Write data to the audio hardware
-        //ALOGV("JetPlayer::render(): writing to audio output");
-        if ((temp = mAudioTrack->write(mAudioBuffer, num_output)) < 0) {
-            ALOGE("JetPlayer::render(): Error in writing:%d",temp);
-            return temp;
-        }
+        // queue the data for the audio hardware
+        writeRenderQueue(mAudioBuffer, num_output);
 
         // start audio output if necessary
-        if (!audioStarted) {
+        if (!audioStarted && num_output > 0) {
             ALOGV("JetPlayer::render(): starting audio playback");
             mAudioTrack->start();
             audioStarted = true;
@@ -252,14 +307,106 @@ threadExit:
     }
     delete [] mAudioBuffer;
     mAudioBuffer = NULL;
+    {
+        Mutex::Autolock l(mQueueLock);
+        delete [] mRenderQueue;
+        mRenderQueue = NULL;
+        mQueueFilled = 0;
+    }
     mMutex.lock();
     mTid = -1;
-    mCondition.signal();
+    mCondition.broadcast();
     mMutex.unlock();
     return result;
 }
 
 
+//-------------------------------------------------------------------------------------------------
+// append rendered audio to the render queue, which has room for it
+void JetPlayer::writeRenderQueue(const EAS_PCM* data, size_t size)
+{
+    Mutex::Autolock l(mQueueLock);
+    if (mRenderQueue == NULL || size > mQueueSize - mQueueFilled) {
+        return;
+    }
+    size_t writeOffset = (mQueueReadOffset + mQueueFilled) % mQueueSize;
+    size_t part = mQueueSize - writeOffset;
+    if (part > size) {
+        part = size;
+    }
+    memcpy((char *)mRenderQueue + writeOffset, data, part);
+    memcpy(mRenderQueue, (const char *)data + part, size - part);
+    mQueueFilled += size;
+}
+
+
+//-------------------------------------------------------------------------------------------------
+// take up to size bytes from the render queue, returns the number of bytes read
+// called from the AudioTrack callback thread
+size_t JetPlayer::readRenderQueue(void* data, size_t size)
+{
+    Mutex::Autolock l(mQueueLock);
+    if (mRenderQueue == NULL) {
+        return 0;
+    }
+    if (size > mQueueFilled) {
+        size = mQueueFilled;
+    }
+    size_t part = mQueueSize - mQueueReadOffset;
+    if (part > size) {
+        part = size;
+    }
+    memcpy(data, (const char *)mRenderQueue + mQueueReadOffset, part);
+    memcpy((char *)data + part, mRenderQueue, size - part);
+    mQueueReadOffset = (mQueueReadOffset + size) % mQueueSize;
+    mQueueFilled -= size;
+    mQueueCondition.signal();
+    return size;
+}
+
+
+//-------------------------------------------------------------------------------------------------
+void JetPlayer::audioCallback(int event, void* user, void *info)
+{
+    if (event != AudioTrack::EVENT_MORE_DATA) {
+        return;
+    }
+    AudioTrack::Buffer *buffer = static_cast<AudioTrack::Buffer *>(info);
+    // an empty queue returns 0, AudioTrack then calls back again a little later
+    buffer->size = static_cast<JetPlayer *>(user)->readRenderQueue(buffer->raw, buffer->size);
+}
+
+
+//-------------------------------------------------------------------------------------------------
+// hand the segments queued by queueSegment() over to the JET engine
+// precondition: mMutex locked
+void JetPlayer::queuePendingSegments()
+{
+    Vector<PendingSegment> segments;
+    {
+        Mutex::Autolock l(mPendingLock);
+        if (mPendingSegments.isEmpty()) {
+            return;
+        }
+        segments = mPendingSegments;
+        mPendingSegments.clear();
+    }
+    if (mEasData == NULL) {
+        return;
+    }
+
+    for (size_t i = 0; i < segments.size(); i++) {
+        const PendingSegment& segment = segments[i];
+        EAS_RESULT result = JET_QueueSegment(mEasData, segment.segmentNum, segment.libNum,
+                segment.repeatCount, segment.transpose, segment.muteFlags, segment.userID);
+        if (result != EAS_SUCCESS) {
+            ALOGE("JetPlayer::queuePendingSegments(): JET_QueueSegment(%d, %d) returned error %ld",
+                    segment.segmentNum, segment.libNum, result);
+        }
+    }
+}
+
+
 //-------------------------------------------------------------------------------------------------
 // fire up an update if any of the status fields has changed
 // precondition: mMutex locked
@@ -385,6 +532,8 @@ int JetPlayer::play()
     ALOGV("JetPlayer::play(): entering");
     Mutex::Autolock lock(mMutex);
 
+    // the segments must be in the JET queue before it plays
+    queuePendingSegments();
     EAS_RESULT result = JET_Play(mEasData);
 
     mPaused = false;
@@ -426,8 +575,29 @@ int JetPlayer::queueSegment(int segmentNum, int libNum, int repeatCount, int tra
 {
     ALOGV("JetPlayer::queueSegment segmentNum=%d, libNum=%d, repeatCount=%d, transpose=%d",
         segmentNum, libNum, repeatCount, transpose);
-    Mutex::Autolock lock(mMutex);
-    return JET_QueueSegment(mEasData, segmentNum, libNum, repeatCount, transpose, muteFlags, userID);
+    if (mTid <= 0) {
+        // no render thread to load the segment
+        Mutex::Autolock lock(mMutex);
+        return JET_QueueSegment(mEasData, segmentNum, libNum, repeatCount, transpose, muteFlags,
+                userID);
+    }
+
+    // loading the segment reads the file, leave that to the render thread; errors are logged
+    // there and show in the JET_NUMQUEUEDSEGMENT_UPDATE events
+    {
+        Mutex::Autolock lock(mPendingLock);
+        PendingSegment segment;
+        segment.segmentNum = segmentNum;
+        segment.libNum = libNum;
+        segment.repeatCount = repeatCount;
+        segment.transpose = transpose;
+        segment.muteFlags = muteFlags;
+        segment.userID = userID;
+        mPendingSegments.push(segment);
+    }
+    // wake up the render thread if it is waiting for play()
+    mCondition.signal();
+    return EAS_SUCCESS;
 }
 
 //-------------------------------------------------------------------------------------------------
@@ -457,6 +627,11 @@ int JetPlayer::clearQueue()
 {
     ALOGV("JetPlayer::clearQueue");
     Mutex::Autolock lock(mMutex);
+    {
+        // also drop the segments the render thread has not queued yet
+        Mutex::Autolock pendingLock(mPendingLock);
+        mPendingSegments.clear();
+    }
     return JET_Clear_Queue(mEasData);
 }
 
@@ -27,10 +27,17 @@
 #include <expat.h>
 #include <media/MediaProfiles.h>
 #include <media/stagefright/foundation/ADebug.h>
+#include <media/stagefright/foundation/AConfigCache.h>
 #include <OMX_Video.h>
 
 namespace android {
 
+// The profiles parsed out of the xml configuration file, after the required
+// profiles were added, so that apps touching MediaRecorder or CamcorderProfile
+// do not each need to parse the xml again.
+static const char kCachePath[] = "/data/misc/media/media_profiles.cache";
+static const uint32_t kCacheMagic = 0x4d505231;  // 'MPR1'
+
 Mutex MediaProfiles::sLock;
 bool MediaProfiles::sIsInitialized = false;
 MediaProfiles *MediaProfiles::sInstance = NULL;
@@ -629,15 +636,15 @@ MediaProfiles::getInstance()
             if (fp == NULL) {
                 ALOGW("could not find media config xml file");
                 sInstance = createDefaultInstance();
+                sInstance->checkAndAddRequiredProfilesIfNecessary();
             } else {
                 fclose(fp);  // close the file first.
-                sInstance = createInstanceFromXmlFile(defaultXmlFile);
+                sInstance = createInstanceFromCacheOrXmlFile(defaultXmlFile);
             }
         } else {
-            sInstance = createInstanceFromXmlFile(value);
+            sInstance = createInstanceFromCacheOrXmlFile(value);
         }
         CHECK(sInstance != NULL);
-        sInstance->checkAndAddRequiredProfilesIfNecessary();
         sIsInitialized = true;
     }
 
@@ -957,6 +964,267 @@ exit:
     return profiles;
 }
 
+/*static*/ MediaProfiles*
+MediaProfiles::createInstanceFromCacheOrXmlFile(const char *xml)
+{
+    MediaProfiles *profiles = createInstanceFromCache(xml);
+    if (profiles != NULL) {
+        return profiles;
+    }
+
+    profiles = createInstanceFromXmlFile(xml);
+    if (profiles != NULL) {
+        profiles->checkAndAddRequiredProfilesIfNecessary();
+        profiles->writeCache(xml);
+    }
+    return profiles;
+}
+
+/*static*/ MediaProfiles*
+MediaProfiles::createInstanceFromCache(const char *xml)
+{
+    AConfigCacheReader reader;
+    if (reader.open(kCachePath, xml, kCacheMagic) != OK) {
+        return NULL;
+    }
+
+    MediaProfiles *profiles = new MediaProfiles();
+
+    size_t n = reader.readCount(6);
+    for (size_t i = 0; i < n; ++i) {
+        CamcorderProfile *profile = new CamcorderProfile;
+        profile->mCameraId = reader.readInt32();
+        profile->mFileFormat = static_cast<output_format>(reader.readInt32());
+        profile->mQuality = static_cast<camcorder_quality>(reader.readInt32());
+        profile->mDuration = reader.readInt32();
+        if (reader.readInt32()) {
+            video_encoder codec = static_cast<video_encoder>(reader.readInt32());
+            int bitRate = reader.readInt32();
+            int frameWidth = reader.readInt32();
+            int frameHeight = reader.readInt32();
+            int frameRate = reader.readInt32();
+            profile->mVideoCodec =
+                new VideoCodec(codec, bitRate, frameWidth, frameHeight, frameRate);
+        }
+        if (reader.readInt32()) {
+            audio_encoder codec = static_cast<audio_encoder>(reader.readInt32());
+            int bitRate = reader.readInt32();
+            int sampleRate = reader.readInt32();
+            int channels = reader.readInt32();
+            profile->mAudioCodec = new AudioCodec(codec, bitRate, sampleRate, channels);
+        }
+        profiles->mCamcorderProfiles.add(profile);
+    }
+
+    n = reader.readCount(7);
+    for (size_t i = 0; i < n; ++i) {
+        audio_encoder codec = static_cast<audio_encoder>(reader.readInt32());
+        int minBitRate = reader.readInt32();
+        int maxBitRate = reader.readInt32();
+        int minSampleRate = reader.readInt32();
+        int maxSampleRate = reader.readInt32();
+        int minChannels = reader.readInt32();
+        int maxChannels = reader.readInt32();
+        profiles->mAudioEncoders.add(new AudioEncoderCap(codec,
+                minBitRate, maxBitRate, minSampleRate, maxSampleRate,
+                minChannels, maxChannels));
+    }
+
+    n = reader.readCount(9);
+    for (size_t i = 0; i < n; ++i) {
+        video_encoder codec = static_cast<video_encoder>(reader.readInt32());
+        int minBitRate = reader.readInt32();
+        int maxBitRate = reader.readInt32();
+        int minFrameWidth = reader.readInt32();
+        int maxFrameWidth = reader.readInt32();
+        int minFrameHeight = reader.readInt32();
+        int maxFrameHeight = reader.readInt32();
+        int minFrameRate = reader.readInt32();
+        int maxFrameRate = reader.readInt32();
+        profiles->mVideoEncoders.add(new VideoEncoderCap(codec,
+                minBitRate, maxBitRate, minFrameWidth, maxFrameWidth,
+                minFrameHeight, maxFrameHeight, minFrameRate, maxFrameRate));
+    }
+
+    n = reader.readCount();
+    for (size_t i = 0; i < n; ++i) {
+        profiles->mAudioDecoders.add(new AudioDecoderCap(
+                static_cast<audio_decoder>(reader.readInt32())));
+    }
+
+    n = reader.readCount();
+    for (size_t i = 0; i < n; ++i) {
+        profiles->mVideoDecoders.add(new VideoDecoderCap(
+                static_cast<video_decoder>(reader.readInt32())));
+    }
+
+    n = reader.readCount();
+    for (size_t i = 0; i < n; ++i) {
+        profiles->mEncoderOutputFileFormats.add(
+                static_cast<output_format>(reader.readInt32()));
+    }
+
+    n = reader.readCount(2);
+    for (size_t i = 0; i < n; ++i) {
+        ImageEncodingQualityLevels *levels = new ImageEncodingQualityLevels;
+        levels->mCameraId = reader.readInt32();
+        size_t numLevels = reader.readCount();
+        for (size_t j = 0; j < numLevels; ++j) {
+            levels->mLevels.add(reader.readInt32());
+        }
+        profiles->mImageEncodingQualityLevels.add(levels);
+    }
+
+    n = reader.readCount(2);
+    for (size_t i = 0; i < n; ++i) {
+        int cameraId = reader.readInt32();
+        profiles->mStartTimeOffsets.add(cameraId, reader.readInt32());
+    }
+
+    n = reader.readCount();
+    for (size_t i = 0; i < n; ++i) {
+        profiles->mCameraIds.add(reader.readInt32());
+    }
+
+    if (reader.readInt32()) {
+        int inFrameWidth = reader.readInt32();
+        int inFrameHeight = reader.readInt32();
+        int outFrameWidth = reader.readInt32();
+        int outFrameHeight = reader.readInt32();
+        int frames = reader.readInt32();
+        profiles->mVideoEditorCap = new VideoEditorCap(
+                inFrameWidth, inFrameHeight, outFrameWidth, outFrameHeight, frames);
+    }
+
+    n = reader.readCount(3);
+    for (size_t i = 0; i < n; ++i) {
+        int codec = reader.readInt32();
+        int profile = reader.readInt32();
+        int level = reader.readInt32();
+        profiles->mVideoEditorExportProfiles.add(
+                new ExportVideoProfile(codec, profile, level));
+    }
+
+    if (reader.status() != OK) {
+        // MediaProfiles can't be deleted, a truncated snapshot is rare
+        // enough to not be worth freeing what was read before.
+        ALOGW("ignoring truncated %s", kCachePath);
+        return NULL;
+    }
+
+    return profiles;
+}
+
+void MediaProfiles::writeCache(const char *xml) const
+{
+    AConfigCacheWriter writer(kCacheMagic);
+
+    writer.writeInt32(mCamcorderProfiles.size());
+    for (size_t i = 0; i < mCamcorderProfiles.size(); ++i) {
+        const CamcorderProfile *profile = mCamcorderProfiles[i];
+        writer.writeInt32(profile->mCameraId);
+        writer.writeInt32(profile->mFileFormat);
+        writer.writeInt32(profile->mQuality);
+        writer.writeInt32(profile->mDuration);
+        writer.writeInt32(profile->mVideoCodec != NULL);
+        if (profile->mVideoCodec != NULL) {
+            writer.writeInt32(profile->mVideoCodec->mCodec);
+            writer.writeInt32(profile->mVideoCodec->mBitRate);
+            writer.writeInt32(profile->mVideoCodec->mFrameWidth);
+            writer.writeInt32(profile->mVideoCodec->mFrameHeight);
+            writer.writeInt32(profile->mVideoCodec->mFrameRate);
+        }
+        writer.writeInt32(profile->mAudioCodec != NULL);
+        if (profile->mAudioCodec != NULL) {
+            writer.writeInt32(profile->mAudioCodec->mCodec);
+            writer.writeInt32(profile->mAudioCodec->mBitRate);
+            writer.writeInt32(profile->mAudioCodec->mSampleRate);
+            writer.writeInt32(profile->mAudioCodec->mChannels);
+        }
+    }
+
+    writer.writeInt32(mAudioEncoders.size());
+    for (size_t i = 0; i < mAudioEncoders.size(); ++i) {
+        const AudioEncoderCap *cap = mAudioEncoders[i];
+        writer.writeInt32(cap->mCodec);
+        writer.writeInt32(cap->mMinBitRate);
+        writer.writeInt32(cap->mMaxBitRate);
+        writer.writeInt32(cap->mMinSampleRate);
+        writer.writeInt32(cap->mMaxSampleRate);
+        writer.writeInt32(cap->mMinChannels);
+        writer.writeInt32(cap->mMaxChannels);
+    }
+
+    writer.writeInt32(mVideoEncoders.size());
+    for (size_t i = 0; i < mVideoEncoders.size(); ++i) {
+        const VideoEncoderCap *cap = mVideoEncoders[i];
+        writer.writeInt32(cap->mCodec);
+        writer.writeInt32(cap->mMinBitRate);
+        writer.writeInt32(cap->mMaxBitRate);
+        writer.writeInt32(cap->mMinFrameWidth);
+        writer.writeInt32(cap->mMaxFrameWidth);
+        writer.writeInt32(cap->mMinFrameHeight);
+        writer.writeInt32(cap->mMaxFrameHeight);
+        writer.writeInt32(cap->mMinFrameRate);
+        writer.writeInt32(cap->mMaxFrameRate);
+    }
+
+    writer.writeInt32(mAudioDecoders.size());
+    for (size_t i = 0; i < mAudioDecoders.size(); ++i) {
+        writer.writeInt32(mAudioDecoders[i]->mCodec);
+    }
+
+    writer.writeInt32(mVideoDecoders.size());
+    for (size_t i = 0; i < mVideoDecoders.size(); ++i) {
+        writer.writeInt32(mVideoDecoders[i]->mCodec);
+    }
+
+    writer.writeInt32(mEncoderOutputFileFormats.size());
+    for (size_t i = 0; i < mEncoderOutputFileFormats.size(); ++i) {
+        writer.writeInt32(mEncoderOutputFileFormats[i]);
+    }
+
+    writer.writeInt32(mImageEncodingQualityLevels.size());
+    for (size_t i = 0; i < mImageEncodingQualityLevels.size(); ++i) {
+        const ImageEncodingQualityLevels *levels = mImageEncodingQualityLevels[i];
+        writer.writeInt32(levels->mCameraId);
+        writer.writeInt32(levels->mLevels.size());
+        for (size_t j = 0; j < levels->mLevels.size(); ++j) {
+            writer.writeInt32(levels->mLevels[j]);
+        }
+    }
+
+    writer.writeInt32(mStartTimeOffsets.size());
+    for (size_t i = 0; i < mStartTimeOffsets.size(); ++i) {
+        writer.writeInt32(mStartTimeOffsets.keyAt(i));
+        writer.writeInt32(mStartTimeOffsets.valueAt(i));
+    }
+
+    writer.writeInt32(mCameraIds.size());
+    for (size_t i = 0; i < mCameraIds.size(); ++i) {
+        writer.writeInt32(mCameraIds[i]);
+    }
+
+    writer.writeInt32(mVideoEditorCap != NULL);
+    if (mVideoEditorCap != NULL) {
+        writer.writeInt32(mVideoEditorCap->mMaxInputFrameWidth);
+        writer.writeInt32(mVideoEditorCap->mMaxInputFrameHeight);
+        writer.writeInt32(mVideoEditorCap->mMaxOutputFrameWidth);
+        writer.writeInt32(mVideoEditorCap->mMaxOutputFrameHeight);
+        writer.writeInt32(mVideoEditorCap->mMaxPrefetchYUVFrames);
+    }
+
+    writer.writeInt32(mVideoEditorExportProfiles.size());
+    for (size_t i = 0; i < mVideoEditorExportProfiles.size(); ++i) {
+        const ExportVideoProfile *profile = mVideoEditorExportProfiles[i];
+        writer.writeInt32(profile->mCodec);
+        writer.writeInt32(profile->mProfile);
+        writer.writeInt32(profile->mLevel);
+    }
+
+    writer.commit(kCachePath, xml);
+}
+
 Vector<output_format> MediaProfiles::getOutputFileFormats() const
 {
     return mEncoderOutputFileFormats;  // copy out
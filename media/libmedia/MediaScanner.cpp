@@ -106,6 +106,19 @@ MediaScanResult MediaScanner::processDirectory(
     return result;
 }
 
+MediaScanResult MediaScanner::processFiles(
+        const Vector<String8> &paths, MediaScannerClient &client,
+        size_t maxThreads) {
+    for (size_t i = 0; i < paths.size(); ++i) {
+        if (processFile(paths.itemAt(i).string(), NULL, client)
+                == MEDIA_SCAN_RESULT_ERROR) {
+            return MEDIA_SCAN_RESULT_ERROR;
+        }
+    }
+
+    return MEDIA_SCAN_RESULT_OK;
+}
+
 bool MediaScanner::shouldSkipDirectory(char *path) {
     if (path && mSkipList && mSkipIndex) {
         int len = strlen(path);
@@ -23,6 +23,8 @@
 // XXX needed for timing latency
 #include <utils/Timers.h>
 
+#include <cutils/properties.h>
+
 #include <media/AudioTrack.h>
 #include <media/mediaplayer.h>
 
@@ -58,6 +60,7 @@ SoundPool::SoundPool(int maxChannels, audio_stream_type_t streamType, int srcQua
     mDecodeThread = 0;
     mStreamType = streamType;
     mSrcQuality = srcQuality;
+    mOutputFlags = AUDIO_OUTPUT_FLAG_FAST;
     mAllocated = 0;
     mNextSampleID = 0;
     mNextChannelID = 0;
@@ -178,11 +181,23 @@ void SoundPool::quit()
 bool SoundPool::startThreads()
 {
     createThreadEtc(beginThread, this, "SoundPool");
-    if (mDecodeThread == NULL)
-        mDecodeThread = new SoundPoolThread(this);
+    if (mDecodeThread == NULL) {
+        // samples are decoded one at a time unless more threads are allowed
+        int numThreads = 1;
+        char value[PROPERTY_VALUE_MAX];
+        if (property_get("media.soundpool.decode-threads", value, NULL)) {
+            numThreads = atoi(value);
+        }
+        mDecodeThread = new SoundPoolThread(this, numThreads);
+    }
     return mDecodeThread != NULL;
 }
 
+void SoundPool::setLoadCallbacksInOrder(bool inOrder)
+{
+    mDecodeThread->setInOrder(inOrder);
+}
+
 SoundChannel* SoundPool::findChannel(int channelID)
 {
     for (int i = 0; i < mMaxChannels; ++i) {
@@ -427,6 +442,25 @@ void SoundPool::done_l(SoundChannel* channel)
     }
 }
 
+void SoundPool::setOutputFlags(audio_output_flags_t flags)
+{
+    Mutex::Autolock lock(&mLock);
+    mOutputFlags = flags;
+}
+
+void SoundPool::prewarm(uint32_t sampleRate, int numChannels, audio_format_t format, int count)
+{
+    ALOGV("prewarm sampleRate=%u, numChannels=%d, format=%d, count=%d",
+            sampleRate, numChannels, format, count);
+    Mutex::Autolock lock(&mLock);
+    for (int i = 0; i < mMaxChannels && count > 0; ++i) {
+        if (mChannelPool[i].state() == SoundChannel::IDLE) {
+            mChannelPool[i].prewarm(sampleRate, numChannels, format);
+            count--;
+        }
+    }
+}
+
 void SoundPool::setCallback(SoundPoolCallback* callback, void* user)
 {
     Mutex::Autolock lock(&mCallbackLock);
@@ -538,6 +572,21 @@ status_t Sample::doLoad()
 }
 
 
+static void getTrackFrameCounts(audio_stream_type_t streamType, uint32_t sampleRate,
+        uint32_t* totalFrames, uint32_t* bufferFrames)
+{
+    int afFrameCount;
+    int afSampleRate;
+    if (AudioSystem::getOutputFrameCount(&afFrameCount, streamType) != NO_ERROR) {
+        afFrameCount = kDefaultFrameCount;
+    }
+    if (AudioSystem::getOutputSamplingRate(&afSampleRate, streamType) != NO_ERROR) {
+        afSampleRate = kDefaultSampleRate;
+    }
+    *totalFrames = (kDefaultBufferCount * afFrameCount * sampleRate) / afSampleRate;
+    *bufferFrames = (*totalFrames + (kDefaultBufferCount - 1)) / kDefaultBufferCount;
+}
+
 void SoundChannel::init(SoundPool* soundPool)
 {
     mSoundPool = soundPool;
@@ -568,19 +617,11 @@ void SoundChannel::play(const sp<Sample>& sample, int nextChannelID, float leftV
         }
 
         // initialize track
-        int afFrameCount;
-        int afSampleRate;
-        audio_stream_type_t streamType = mSoundPool->streamType();
-        if (AudioSystem::getOutputFrameCount(&afFrameCount, streamType) != NO_ERROR) {
-            afFrameCount = kDefaultFrameCount;
-        }
-        if (AudioSystem::getOutputSamplingRate(&afSampleRate, streamType) != NO_ERROR) {
-            afSampleRate = kDefaultSampleRate;
-        }
         int numChannels = sample->numChannels();
         uint32_t sampleRate = uint32_t(float(sample->sampleRate()) * rate + 0.5);
-        uint32_t totalFrames = (kDefaultBufferCount * afFrameCount * sampleRate) / afSampleRate;
-        uint32_t bufferFrames = (totalFrames + (kDefaultBufferCount - 1)) / kDefaultBufferCount;
+        uint32_t totalFrames;
+        uint32_t bufferFrames;
+        getTrackFrameCounts(mSoundPool->streamType(), sampleRate, &totalFrames, &bufferFrames);
         uint32_t frameCount = 0;
 
         if (loop) {
@@ -601,20 +642,27 @@ void SoundChannel::play(const sp<Sample>& sample, int nextChannelID, float leftV
         // audio track while the new one is being started and avoids processing them with
         // wrong audio audio buffer size  (mAudioBufferSize)
         unsigned long toggle = mToggle ^ 1;
-        void *userData = (void *)((unsigned long)this | toggle);
-        uint32_t channels = (numChannels == 2) ?
-                AUDIO_CHANNEL_OUT_STEREO : AUDIO_CHANNEL_OUT_MONO;
 
         // do not create a new audio track if current track is compatible with sample parameters
+        oldTrack = mAudioTrack;
+        if (!loop && canReuseTrack_l(sampleRate, numChannels, sample->format(), frameCount)) {
+            ALOGV("reusing track %p", mAudioTrack);
+            newTrack = mAudioTrack;
+            oldTrack = NULL;
+            // the track keeps the user data it was created with
+            toggle = mToggle;
+        } else {
 #ifdef USE_SHARED_MEM_BUFFER
-        newTrack = new AudioTrack(streamType, sampleRate, sample->format(),
-                channels, sample->getIMemory(), AUDIO_OUTPUT_FLAG_NONE, callback, userData);
+            void *userData = (void *)((unsigned long)this | toggle);
+            uint32_t channels = (numChannels == 2) ?
+                    AUDIO_CHANNEL_OUT_STEREO : AUDIO_CHANNEL_OUT_MONO;
+            newTrack = new AudioTrack(mSoundPool->streamType(), sampleRate, sample->format(),
+                    channels, sample->getIMemory(), AUDIO_OUTPUT_FLAG_NONE, callback, userData);
 #else
-        newTrack = new AudioTrack(streamType, sampleRate, sample->format(),
-                channels, frameCount, AUDIO_OUTPUT_FLAG_FAST, callback, userData,
-                bufferFrames);
+            newTrack = createTrack(sampleRate, numChannels, sample->format(), frameCount,
+                    bufferFrames, toggle);
 #endif
-        oldTrack = mAudioTrack;
+        }
         status = newTrack->initCheck();
         if (status != NO_ERROR) {
             ALOGE("Error creating AudioTrack");
@@ -651,6 +699,69 @@ exit:
     }
 }
 
+// call with lock held, the channel must be idle
+bool SoundChannel::canReuseTrack_l(uint32_t sampleRate, int numChannels, audio_format_t format,
+        uint32_t frameCount)
+{
+#ifdef USE_SHARED_MEM_BUFFER
+    // the track plays from the memory of the sample it was created for
+    return false;
+#else
+    if (mAudioTrack == NULL || mAudioTrack->format() != format ||
+            mAudioTrack->channelCount() != numChannels ||
+            mAudioTrack->frameCount() < frameCount) {
+        return false;
+    }
+    return mAudioTrack->getSampleRate() == sampleRate ||
+            mAudioTrack->setSampleRate(sampleRate) == NO_ERROR;
+#endif
+}
+
+AudioTrack* SoundChannel::createTrack(uint32_t sampleRate, int numChannels,
+        audio_format_t format, uint32_t frameCount, uint32_t bufferFrames,
+        unsigned long toggle)
+{
+    void *userData = (void *)((unsigned long)this | toggle);
+    uint32_t channels = (numChannels == 2) ?
+            AUDIO_CHANNEL_OUT_STEREO : AUDIO_CHANNEL_OUT_MONO;
+    return new AudioTrack(mSoundPool->streamType(), sampleRate, format,
+            channels, frameCount, mSoundPool->outputFlags(), callback, userData,
+            bufferFrames);
+}
+
+// call with sound pool lock held
+void SoundChannel::prewarm(uint32_t sampleRate, int numChannels, audio_format_t format)
+{
+    AudioTrack* oldTrack;
+    AudioTrack* newTrack;
+    {
+        Mutex::Autolock lock(&mLock);
+
+        uint32_t totalFrames;
+        uint32_t bufferFrames;
+        getTrackFrameCounts(mSoundPool->streamType(), sampleRate, &totalFrames, &bufferFrames);
+        if (mState != IDLE || canReuseTrack_l(sampleRate, numChannels, format, totalFrames)) {
+            return;
+        }
+
+        unsigned long toggle = mToggle ^ 1;
+        newTrack = createTrack(sampleRate, numChannels, format, totalFrames, bufferFrames,
+                toggle);
+        if (newTrack->initCheck() != NO_ERROR) {
+            ALOGE("Error creating AudioTrack");
+            oldTrack = newTrack;
+        } else {
+            ALOGV("prewarmed track %p", newTrack);
+            oldTrack = mAudioTrack;
+            mToggle = toggle;
+            mAudioTrack = newTrack;
+        }
+    }
+
+    // as in the destructor, do not delete the track with mLock held
+    delete oldTrack;
+}
+
 void SoundChannel::nextEvent()
 {
     sp<Sample> sample;
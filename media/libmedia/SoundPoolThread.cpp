@@ -30,8 +30,12 @@ void SoundPoolThread::write(SoundPoolMsg msg) {
 
     // if thread is quitting, don't add to queue
     if (mRunning) {
+        if (msg.mMessageType == SoundPoolMsg::LOAD_SAMPLE) {
+            msg.mSequence = mNextSequence++;
+            mPending.add(msg.mSequence);
+        }
         mMsgQueue.push(msg);
-        mCondition.signal();
+        mCondition.broadcast();
     }
 }
 
@@ -42,7 +46,7 @@ const SoundPoolMsg SoundPoolThread::read() {
     }
     SoundPoolMsg msg = mMsgQueue[0];
     mMsgQueue.removeAt(0);
-    mCondition.signal();
+    mCondition.broadcast();
     return msg;
 }
 
@@ -50,21 +54,44 @@ void SoundPoolThread::quit() {
     Mutex::Autolock lock(&mLock);
     if (mRunning) {
         mRunning = false;
+        for (size_t i = 0; i < mMsgQueue.size(); ++i) {
+            if (mMsgQueue[i].mMessageType == SoundPoolMsg::LOAD_SAMPLE) {
+                mPending.remove(mMsgQueue[i].mSequence);
+            }
+        }
         mMsgQueue.clear();
-        mMsgQueue.push(SoundPoolMsg(SoundPoolMsg::KILL, 0));
-        mCondition.signal();
-        mCondition.wait(mLock);
+        for (int i = 0; i < mNumThreads; ++i) {
+            mMsgQueue.push(SoundPoolMsg(SoundPoolMsg::KILL, 0));
+        }
+        mCondition.broadcast();
+        // each thread finishes the sample it is decoding first
+        while (mNumThreads > 0) {
+            mCondition.wait(mLock);
+        }
     }
     ALOGV("return from quit");
 }
 
-SoundPoolThread::SoundPoolThread(SoundPool* soundPool) :
-    mSoundPool(soundPool)
+SoundPoolThread::SoundPoolThread(SoundPool* soundPool, int numThreads) :
+    mSoundPool(soundPool), mRunning(false), mNumThreads(0), mNextSequence(0),
+    mInOrder(false), mNotifying(false)
 {
-    mMsgQueue.setCapacity(maxMessages);
-    if (createThreadEtc(beginThread, this, "SoundPoolThread")) {
-        mRunning = true;
+    if (numThreads < 1) {
+        numThreads = 1;
+    } else if (numThreads > maxThreads) {
+        numThreads = maxThreads;
+    }
+    mMsgQueue.setCapacity(maxMessages + maxThreads);
+
+    Mutex::Autolock lock(&mLock);
+    for (int i = 0; i < numThreads; ++i) {
+        if (!createThreadEtc(beginThread, this, "SoundPoolThread")) {
+            break;
+        }
+        ++mNumThreads;
     }
+    mRunning = mNumThreads > 0;
+    ALOGV("started %d of %d decode threads", mNumThreads, numThreads);
 }
 
 SoundPoolThread::~SoundPoolThread()
@@ -84,11 +111,15 @@ int SoundPoolThread::run() {
         SoundPoolMsg msg = read();
         ALOGV("Got message m=%d, mData=%d", msg.mMessageType, msg.mData);
         switch (msg.mMessageType) {
-        case SoundPoolMsg::KILL:
+        case SoundPoolMsg::KILL: {
             ALOGV("goodbye");
+            Mutex::Autolock lock(&mLock);
+            --mNumThreads;
+            mCondition.broadcast();
             return NO_ERROR;
+        }
         case SoundPoolMsg::LOAD_SAMPLE:
-            doLoadSample(msg.mData);
+            doLoadSample(msg);
             break;
         default:
             ALOGW("run: Unrecognized message %d\n",
@@ -102,13 +133,56 @@ void SoundPoolThread::loadSample(int sampleID) {
     write(SoundPoolMsg(SoundPoolMsg::LOAD_SAMPLE, sampleID));
 }
 
-void SoundPoolThread::doLoadSample(int sampleID) {
+void SoundPoolThread::setInOrder(bool inOrder) {
+    Mutex::Autolock lock(&mLock);
+    mInOrder = inOrder;
+}
+
+void SoundPoolThread::doLoadSample(const SoundPoolMsg& msg) {
+    int sampleID = msg.mData;
     sp <Sample> sample = mSoundPool->findSample(sampleID);
     status_t status = -1;
     if (sample != 0) {
         status = sample->doLoad();
     }
-    mSoundPool->notify(SoundPoolEvent(SoundPoolEvent::SAMPLE_LOADED, sampleID, status));
+    sampleDone(msg.mSequence, SoundPoolEvent(SoundPoolEvent::SAMPLE_LOADED, sampleID, status));
+}
+
+// Called by the thread that decoded a sample. Whichever thread finds nobody
+// delivering events delivers all the ready ones, without holding mLock so
+// that the callback may load more samples.
+void SoundPoolThread::sampleDone(uint32_t sequence, const SoundPoolEvent& event) {
+    mLock.lock();
+    mDone.add(sequence, event);
+    if (!mNotifying) {
+        mNotifying = true;
+        SoundPoolEvent next;
+        while (nextEvent_l(&next)) {
+            mLock.unlock();
+            mSoundPool->notify(next);
+            mLock.lock();
+        }
+        mNotifying = false;
+    }
+    mLock.unlock();
+}
+
+bool SoundPoolThread::nextEvent_l(SoundPoolEvent* event) {
+    if (mDone.isEmpty()) {
+        return false;
+    }
+    ssize_t index = 0;
+    if (mInOrder) {
+        // wait for the oldest load still outstanding
+        index = mDone.indexOfKey(mPending[0]);
+        if (index < 0) {
+            return false;
+        }
+    }
+    *event = mDone.valueAt(index);
+    mPending.remove(mDone.keyAt(index));
+    mDone.removeItemsAt(index);
+    return true;
 }
 
 } // end namespace android
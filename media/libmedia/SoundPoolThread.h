@@ -19,6 +19,8 @@
 
 #include <utils/threads.h>
 #include <utils/Vector.h>
+#include <utils/KeyedVector.h>
+#include <utils/SortedVector.h>
 #include <media/AudioTrack.h>
 
 #include <media/SoundPool.h>
@@ -28,21 +30,28 @@ namespace android {
 class SoundPoolMsg {
 public:
     enum MessageType { INVALID, KILL, LOAD_SAMPLE };
-    SoundPoolMsg() : mMessageType(INVALID), mData(0) {}
+    SoundPoolMsg() : mMessageType(INVALID), mData(0), mSequence(0) {}
     SoundPoolMsg(MessageType MessageType, int data) :
-        mMessageType(MessageType), mData(data) {}
+        mMessageType(MessageType), mData(data), mSequence(0) {}
     uint16_t         mMessageType;
     uint16_t         mData;
+    uint32_t         mSequence;     // order of submission, for LOAD_SAMPLE
 };
 
 /*
- * This class handles background requests from the SoundPool
+ * This class handles background requests from the SoundPool.
+ * Samples are decoded by up to maxThreads threads at once; the load complete
+ * events are delivered one at a time, and in the order of the loadSample()
+ * calls if setInOrder(true) was called.
  */
 class SoundPoolThread {
 public:
-    SoundPoolThread(SoundPool* SoundPool);
+    static const int maxThreads = 4;
+
+    SoundPoolThread(SoundPool* SoundPool, int numThreads = 1);
     ~SoundPoolThread();
     void loadSample(int sampleID);
+    void setInOrder(bool inOrder);
     void quit();
     void write(SoundPoolMsg msg);
 
@@ -51,7 +60,9 @@ private:
 
     static int beginThread(void* arg);
     int run();
-    void doLoadSample(int sampleID);
+    void doLoadSample(const SoundPoolMsg& msg);
+    void sampleDone(uint32_t sequence, const SoundPoolEvent& event);
+    bool nextEvent_l(SoundPoolEvent* event);
     const SoundPoolMsg read();
 
     Mutex                   mLock;
@@ -59,6 +70,13 @@ private:
     Vector<SoundPoolMsg>    mMsgQueue;
     SoundPool*              mSoundPool;
     bool                    mRunning;
+    int                     mNumThreads;    // threads that have not exited yet
+
+    uint32_t                mNextSequence;
+    SortedVector<uint32_t>  mPending;       // loads whose event has not been delivered
+    KeyedVector<uint32_t, SoundPoolEvent> mDone;    // events waiting to be delivered
+    bool                    mInOrder;
+    bool                    mNotifying;     // a thread is delivering events
 };
 
 } // end namespace android
@@ -20,6 +20,7 @@
 
 #include <stdio.h>
 #include <math.h>
+#include <pthread.h>
 #include <utils/Log.h>
 #include <utils/RefBase.h>
 #include <utils/Timers.h>
@@ -1346,7 +1347,7 @@ bool ToneGenerator::prepareWave() {
             // Instantiate a wave generator if  ot already done for this frequency
             if (mWaveGens.indexOfKey(frequency) == NAME_NOT_FOUND) {
                 ToneGenerator::WaveGenerator *lpWaveGen =
-                        new ToneGenerator::WaveGenerator((unsigned short)mSamplingRate,
+                        new ToneGenerator::WaveGenerator(mSamplingRate,
                                 frequency,
                                 TONEGEN_GAIN/lNumWaves);
                 mWaveGens.add(frequency, lpWaveGen);
@@ -1455,6 +1456,28 @@ ToneGenerator::tone_type ToneGenerator::getToneForRegion(tone_type toneType) {
 
 //---------------------------------- public methods ----------------------------
 
+short ToneGenerator::WaveGenerator::sSineTable[kSineTableSize + 1];
+pthread_once_t ToneGenerator::WaveGenerator::sSineTableOnce = PTHREAD_ONCE_INIT;
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//    Method:        WaveGenerator::initSineTable()
+//
+//    Description:    Fills the sine table shared by all wave generators.
+//
+//    Input:
+//        none
+//
+//    Output:
+//        none
+//
+////////////////////////////////////////////////////////////////////////////////
+void ToneGenerator::WaveGenerator::initSineTable() {
+    for (int i = 0; i <= kSineTableSize; i++) {
+        sSineTable[i] = (short)floor(GEN_AMP * sin(2 * M_PI * i / kSineTableSize) + 0.5);
+    }
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 //
 //    Method:        WaveGenerator::WaveGenerator()
@@ -1470,29 +1493,22 @@ ToneGenerator::tone_type ToneGenerator::getToneForRegion(tone_type toneType) {
 //        none
 //
 ////////////////////////////////////////////////////////////////////////////////
-ToneGenerator::WaveGenerator::WaveGenerator(unsigned short samplingRate,
+ToneGenerator::WaveGenerator::WaveGenerator(uint32_t samplingRate,
         unsigned short frequency, float volume) {
-    double d0;
-    double F_div_Fs;  // frequency / samplingRate
+    pthread_once(&sSineTableOnce, initSineTable);
 
-    F_div_Fs = frequency / (double)samplingRate;
-    d0 = - (float)GEN_AMP * sin(2 * M_PI * F_div_Fs);
-    mS2_0 = (short)d0;
-    mS1 = 0;
-    mS2 = mS2_0;
+    // the phase increment is exact to within 2^-32 of a period per sample, unlike the
+    // Q14 coefficient of a recurrence, so the frequency does not depend on the rate
+    mPhase = 0;
+    mPhaseIncrement = (uint32_t)floor(frequency * 4294967296.0 / samplingRate + 0.5);
 
     mAmplitude_Q15 = (short)(32767. * 32767. * volume / GEN_AMP);
     // take some margin for amplitude fluctuation
     if (mAmplitude_Q15 > 32500)
         mAmplitude_Q15 = 32500;
 
-    d0 = 32768.0 * cos(2 * M_PI * F_div_Fs);  // Q14*2*cos()
-    if (d0 > 32767)
-        d0 = 32767;
-    mA1_Q14 = (short) d0;
-
-    ALOGV("WaveGenerator init, mA1_Q14: %d, mS2_0: %d, mAmplitude_Q15: %d",
-            mA1_Q14, mS2_0, mAmplitude_Q15);
+    ALOGV("WaveGenerator init, mPhaseIncrement: %u, mAmplitude_Q15: %d",
+            mPhaseIncrement, mAmplitude_Q15);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -1516,7 +1532,8 @@ ToneGenerator::WaveGenerator::~WaveGenerator() {
 //    Method:        WaveGenerator::getSamples()
 //
 //    Description:    Generates count samples of a sine wave and accumulates
-//        result in outBuffer.
+//        result in outBuffer. Samples are linearly interpolated from the sine
+//        table, the loops have no branch besides the loop condition.
 //
 //    Input:
 //        outBuffer:      Output buffer where to accumulate samples.
@@ -1529,19 +1546,18 @@ ToneGenerator::WaveGenerator::~WaveGenerator() {
 ////////////////////////////////////////////////////////////////////////////////
 void ToneGenerator::WaveGenerator::getSamples(short *outBuffer,
         unsigned int count, unsigned int command) {
-    long lS1, lS2;
-    long lA1, lAmplitude;
+    const int kFracShift = 32 - kSineTableBits - S_Q15;
+    uint32_t phase;
+    const uint32_t increment = mPhaseIncrement;
+    long lAmplitude;
     long Sample;  // current sample
 
     // init local
     if (command == WAVEGEN_START) {
-        lS1 = (long)0;
-        lS2 = (long)mS2_0;
+        phase = 0;
     } else {
-        lS1 = (long)mS1;
-        lS2 = (long)mS2;
+        phase = mPhase;
     }
-    lA1 = (long)mA1_Q14;
     lAmplitude = (long)mAmplitude_Q15;
 
     if (command == WAVEGEN_STOP) {
@@ -1552,10 +1568,10 @@ void ToneGenerator::WaveGenerator::getSamples(short *outBuffer,
         long dec = lAmplitude/count;
         // loop generation
         while (count--) {
-            Sample = ((lA1 * lS1) >> S_Q14) - lS2;
-            // shift delay
-            lS2 = lS1;
-            lS1 = Sample;
+            const short *s = sSineTable + (phase >> (32 - kSineTableBits));
+            long frac = (phase >> kFracShift) & ((1 << S_Q15) - 1);
+            Sample = s[0] + (((s[1] - s[0]) * frac) >> S_Q15);
+            phase += increment;
             Sample = ((lAmplitude>>16) * Sample) >> S_Q15;
             *(outBuffer++) += (short)Sample;  // put result in buffer
             lAmplitude -= dec;
@@ -1563,18 +1579,17 @@ void ToneGenerator::WaveGenerator::getSamples(short *outBuffer,
     } else {
         // loop generation
         while (count--) {
-            Sample = ((lA1 * lS1) >> S_Q14) - lS2;
-            // shift delay
-            lS2 = lS1;
-            lS1 = Sample;
+            const short *s = sSineTable + (phase >> (32 - kSineTableBits));
+            long frac = (phase >> kFracShift) & ((1 << S_Q15) - 1);
+            Sample = s[0] + (((s[1] - s[0]) * frac) >> S_Q15);
+            phase += increment;
             Sample = (lAmplitude * Sample) >> S_Q15;
             *(outBuffer++) += (short)Sample;  // put result in buffer
         }
     }
 
     // save status
-    mS1 = (short)lS1;
-    mS2 = (short)lS2;
+    mPhase = phase;
 }
 
 }  // end namespace android
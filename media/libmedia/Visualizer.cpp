@@ -43,7 +43,8 @@ Visualizer::Visualizer (int32_t priority,
         mSampleRate(44100000),
         mScalingMode(VISUALIZER_SCALING_MODE_NORMALIZED),
         mCaptureCallBack(NULL),
-        mCaptureCbkUser(NULL)
+        mCaptureCbkUser(NULL),
+        mEffectFft(true)
 {
     initCaptureSize();
 }
@@ -220,16 +221,38 @@ status_t Visualizer::getFft(uint8_t *fft)
     status_t status = NO_ERROR;
     if (mEnabled) {
         uint8_t buf[mCaptureSize];
-        status = getWaveForm(buf);
-        if (status == NO_ERROR) {
-            status = doFft(fft, buf);
-        }
+        status = getWaveFormAndFft(buf, fft);
     } else {
         memset(fft, 0, mCaptureSize);
     }
     return status;
 }
 
+status_t Visualizer::getWaveFormAndFft(uint8_t *waveform, uint8_t *fft)
+{
+    if (mEnabled && mEffectFft) {
+        // the effect computes the FFT once per capture point for all its clients
+        uint8_t buf[mCaptureSize * 2];
+        uint32_t replySize = mCaptureSize * 2;
+        status_t status = command(VISUALIZER_CMD_CAPTURE_FFT, 0, NULL, &replySize, buf);
+        ALOGV("getWaveFormAndFft() command returned %d", status);
+        if (status == NO_ERROR && replySize == mCaptureSize * 2) {
+            memcpy(waveform, buf, mCaptureSize);
+            memcpy(fft, buf + mCaptureSize, mCaptureSize);
+            return NO_ERROR;
+        }
+        if (status != NO_ERROR && status != DEAD_OBJECT) {
+            ALOGV("getWaveFormAndFft() effect FFT not supported, computing it locally");
+            mEffectFft = false;
+        }
+    }
+    status_t status = getWaveForm(waveform);
+    if (status == NO_ERROR) {
+        status = doFft(fft, waveform);
+    }
+    return status;
+}
+
 status_t Visualizer::doFft(uint8_t *fft, uint8_t *waveform)
 {
     int32_t workspace[mCaptureSize >> 1];
@@ -267,13 +290,12 @@ void Visualizer::periodicCapture()
         (mCaptureFlags & (CAPTURE_WAVEFORM|CAPTURE_FFT)) &&
         mCaptureSize != 0) {
         uint8_t waveform[mCaptureSize];
-        status_t status = getWaveForm(waveform);
-        if (status != NO_ERROR) {
-            return;
-        }
         uint8_t fft[mCaptureSize];
+        status_t status;
         if (mCaptureFlags & CAPTURE_FFT) {
-            status = doFft(fft, waveform);
+            status = getWaveFormAndFft(waveform, fft);
+        } else {
+            status = getWaveForm(waveform);
         }
         if (status != NO_ERROR) {
             return;
@@ -12,6 +12,7 @@ LOCAL_SRC_FILES:=               \
     MediaRecorderClient.cpp     \
     MediaPlayerService.cpp      \
     MetadataRetrieverClient.cpp \
+    MetadataRetrieverCache.cpp  \
     TestPlayerStub.cpp          \
     MidiMetadataRetriever.cpp   \
     MidiFile.cpp                \
@@ -37,6 +38,7 @@ LOCAL_SHARED_LIBRARIES :=     		\
 LOCAL_STATIC_LIBRARIES := \
         libstagefright_nuplayer                 \
         libstagefright_rtsp                     \
+        libscheduling_policy                    \
 
 LOCAL_C_INCLUDES :=                                               \
 	$(call include-path-for, graphics corecg)                       \
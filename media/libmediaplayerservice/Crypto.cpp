@@ -20,8 +20,10 @@
 
 #include "Crypto.h"
 
+#include <binder/IMemory.h>
 #include <media/hardware/CryptoAPI.h>
 #include <media/stagefright/foundation/ADebug.h>
+#include <media/stagefright/foundation/ALooper.h>
 #include <media/stagefright/foundation/AString.h>
 #include <media/stagefright/foundation/hexdump.h>
 #include <media/stagefright/MediaErrors.h>
@@ -34,11 +36,19 @@ Crypto::Crypto()
     : mInitCheck(NO_INIT),
       mLibHandle(NULL),
       mFactory(NULL),
-      mPlugin(NULL) {
+      mPlugin(NULL),
+      mNumDecryptCalls(0),
+      mNumDecryptUnits(0),
+      mNumBytesDecrypted(0),
+      mDecryptTimeUs(0) {
     mInitCheck = init();
 }
 
 Crypto::~Crypto() {
+    if (mPlugin != NULL) {
+        logDecryptStats_l();
+    }
+
     delete mPlugin;
     mPlugin = NULL;
 
@@ -121,6 +131,8 @@ status_t Crypto::destroyPlugin() {
         return -EINVAL;
     }
 
+    logDecryptStats_l();
+
     delete mPlugin;
     mPlugin = NULL;
 
@@ -160,9 +172,138 @@ status_t Crypto::decrypt(
         return -EINVAL;
     }
 
-    return mPlugin->decrypt(
+    ++mNumDecryptCalls;
+
+    return decrypt_l(
             secure, key, iv, mode, srcPtr, subSamples, numSubSamples, dstPtr,
             errorDetailMsg);
 }
 
+status_t Crypto::decryptBatch(
+        bool secure,
+        const sp<IMemory> &srcMem,
+        const sp<IMemory> &dstMem,
+        const DecryptUnit *units, size_t numUnits,
+        size_t *numDecrypted,
+        AString *errorDetailMsg) {
+    Mutex::Autolock autoLock(mLock);
+
+    *numDecrypted = 0;
+
+    if (mInitCheck != OK) {
+        return mInitCheck;
+    }
+
+    if (mPlugin == NULL) {
+        return -EINVAL;
+    }
+
+    if (srcMem == NULL || srcMem->pointer() == NULL) {
+        return -EINVAL;
+    }
+
+    if (!secure && (dstMem == NULL || dstMem->pointer() == NULL)) {
+        return -EINVAL;
+    }
+
+    ++mNumDecryptCalls;
+
+    const uint8_t *src = (const uint8_t *)srcMem->pointer();
+    size_t srcSize = srcMem->size();
+
+    uint8_t *dst = NULL;
+    size_t dstSize = 0;
+    if (!secure) {
+        dst = (uint8_t *)dstMem->pointer();
+        dstSize = dstMem->size();
+    }
+
+    for (size_t i = 0; i < numUnits; ++i) {
+        const DecryptUnit &unit = units[i];
+
+        size_t size = 0;
+        for (size_t j = 0; j < unit.mNumSubSamples; ++j) {
+            size += unit.mSubSamples[j].mNumBytesOfClearData;
+            size += unit.mSubSamples[j].mNumBytesOfEncryptedData;
+        }
+
+        // The offsets come from the client, the memory may be shared
+        // with others.
+        if (unit.mSrcOffset > srcSize || size > srcSize - unit.mSrcOffset) {
+            return -ERANGE;
+        }
+
+        if (!secure
+                && (unit.mDstOffset > dstSize
+                    || size > dstSize - unit.mDstOffset)) {
+            return -ERANGE;
+        }
+
+        status_t err = decrypt_l(
+                secure,
+                unit.mKey,
+                unit.mIV,
+                unit.mMode,
+                src + unit.mSrcOffset,
+                unit.mSubSamples, unit.mNumSubSamples,
+                secure ? unit.mDstPtr : dst + unit.mDstOffset,
+                errorDetailMsg);
+
+        if (err != OK) {
+            return err;
+        }
+
+        ++*numDecrypted;
+    }
+
+    return OK;
+}
+
+status_t Crypto::decrypt_l(
+        bool secure,
+        const uint8_t key[16],
+        const uint8_t iv[16],
+        CryptoPlugin::Mode mode,
+        const void *srcPtr,
+        const CryptoPlugin::SubSample *subSamples, size_t numSubSamples,
+        void *dstPtr,
+        AString *errorDetailMsg) {
+    int64_t startUs = ALooper::GetNowUs();
+
+    status_t err = mPlugin->decrypt(
+            secure, key, iv, mode, srcPtr, subSamples, numSubSamples, dstPtr,
+            errorDetailMsg);
+
+    mDecryptTimeUs += ALooper::GetNowUs() - startUs;
+
+    if (err != OK) {
+        return err;
+    }
+
+    ++mNumDecryptUnits;
+    for (size_t i = 0; i < numSubSamples; ++i) {
+        mNumBytesDecrypted += subSamples[i].mNumBytesOfClearData;
+        mNumBytesDecrypted += subSamples[i].mNumBytesOfEncryptedData;
+    }
+
+    return OK;
+}
+
+void Crypto::logDecryptStats_l() {
+    if (mNumDecryptUnits == 0) {
+        return;
+    }
+
+    ALOGI("decrypted %lld bytes in %lld access units, %lld calls, "
+          "%.2f MB/s in the plugin",
+          mNumBytesDecrypted, mNumDecryptUnits, mNumDecryptCalls,
+          mDecryptTimeUs > 0
+            ? (double)mNumBytesDecrypted / mDecryptTimeUs : 0.0);
+
+    mNumDecryptCalls = 0;
+    mNumDecryptUnits = 0;
+    mNumBytesDecrypted = 0;
+    mDecryptTimeUs = 0;
+}
+
 }  // namespace android
@@ -52,6 +52,14 @@ struct Crypto : public BnCrypto {
             void *dstPtr,
             AString *errorDetailMsg);
 
+    virtual status_t decryptBatch(
+            bool secure,
+            const sp<IMemory> &srcMem,
+            const sp<IMemory> &dstMem,
+            const DecryptUnit *units, size_t numUnits,
+            size_t *numDecrypted,
+            AString *errorDetailMsg);
+
 private:
     mutable Mutex mLock;
 
@@ -60,8 +68,26 @@ private:
     CryptoFactory *mFactory;
     CryptoPlugin *mPlugin;
 
+    // Throughput of the current plugin, logged when it is destroyed.
+    int64_t mNumDecryptCalls;
+    int64_t mNumDecryptUnits;
+    int64_t mNumBytesDecrypted;
+    int64_t mDecryptTimeUs;
+
     status_t init();
 
+    status_t decrypt_l(
+            bool secure,
+            const uint8_t key[16],
+            const uint8_t iv[16],
+            CryptoPlugin::Mode mode,
+            const void *srcPtr,
+            const CryptoPlugin::SubSample *subSamples, size_t numSubSamples,
+            void *dstPtr,
+            AString *errorDetailMsg);
+
+    void logDecryptStats_l();
+
     DISALLOW_EVIL_CONSTRUCTORS(Crypto);
 };
 
@@ -38,6 +38,7 @@
 #include <binder/IServiceManager.h>
 #include <binder/MemoryHeapBase.h>
 #include <binder/MemoryBase.h>
+#include <binder/MemoryDealer.h>
 #include <gui/SurfaceTextureClient.h>
 #include <utils/Errors.h>  // for status_t
 #include <utils/String8.h>
@@ -52,6 +53,7 @@
 #include <media/AudioTrack.h>
 #include <media/MemoryLeakTrackUtil.h>
 #include <media/stagefright/MediaErrors.h>
+#include <media/stagefright/foundation/ALooperRoster.h>
 
 #include <system/audio.h>
 
@@ -67,6 +69,7 @@
 #include "StagefrightPlayer.h"
 #include "nuplayer/NuPlayerDriver.h"
 
+#include <LiveSession.h>
 #include <OMX.h>
 
 #include "Crypto.h"
@@ -185,6 +188,8 @@ bool findMetadata(const Metadata::Filter& filter, const int32_t val)
 
 namespace android {
 
+extern ALooperRoster gLooperRoster;
+
 static bool checkPermission(const char* permissionString) {
 #ifndef HAVE_ANDROID_OS
     return true;
@@ -356,6 +361,25 @@ status_t MediaPlayerService::Client::dump(int fd, const Vector<String16>& args)
     write(fd, result.string(), result.size());
     if (mPlayer != NULL) {
         mPlayer->dump(fd, args);
+
+        Parcel stats;
+        if (mPlayer->getParameter(KEY_PARAMETER_PLAYBACK_STATS, &stats) == OK) {
+            int64_t values[9];
+            stats.setDataPosition(0);
+            for (size_t i = 0; i < sizeof(values) / sizeof(values[0]); ++i) {
+                values[i] = stats.readInt64();
+            }
+            result.clear();
+            snprintf(buffer, 255, "  framesDecoded(%lld), framesDropped(%lld), "
+                    "decodeTimeUs(%lld), lateByUs(%lld), maxLateByUs(%lld)\n",
+                    values[0], values[1], values[2], values[3], values[4]);
+            result.append(buffer);
+            snprintf(buffer, 255, "  rebuffers(%lld), rebufferTimeUs(%lld), "
+                    "cachedBytes(%lld), cachedDurationUs(%lld)\n",
+                    values[5], values[6], values[7], values[8]);
+            result.append(buffer);
+            write(fd, result.string(), result.size());
+        }
     }
     if (mAudioOutput != 0) {
         mAudioOutput->dump(fd, args);
@@ -464,6 +488,11 @@ status_t MediaPlayerService::dump(int fd, const Vector<String16>& args)
             result.append("\n");
         }
 
+        write(fd, result.string(), result.size());
+        result = "\n";
+        gLooperRoster.dump(fd);
+        LiveSession::DumpSessions(fd);
+
         bool dumpMem = false;
         for (size_t i = 0; i < args.size(); i++) {
             if (args[i] == String16("-m")) {
@@ -1359,18 +1388,140 @@ Exit:
     return mem;
 }
 
+static size_t kDecodeArenaSize = 2 * 1024 * 1024; // 2MB
+static size_t kMaxIdleDecoders = 2; // per player type, for concurrent decodes
+
+sp<MediaPlayerBase> MediaPlayerService::acquireDecoder(player_type playerType,
+        const sp<AudioCache>& cache)
+{
+    sp<MediaPlayerBase> player;
+    {
+        Mutex::Autolock lock(mDecoderLock);
+        ssize_t index = mIdleDecoders.indexOfKey(playerType);
+        if (index >= 0 && !mIdleDecoders.valueAt(index).isEmpty()) {
+            Vector<sp<MediaPlayerBase> >& idle = mIdleDecoders.editValueAt(index);
+            player = idle.top();
+            idle.pop();
+        }
+    }
+    if (player == 0) {
+        return android::createPlayer(playerType, cache.get(), cache->notify);
+    }
+    ALOGV("reusing decoder for player type %d", playerType);
+    player->setNotifyCallback(cache.get(), cache->notify);
+    return player;
+}
+
+void MediaPlayerService::releaseDecoder(player_type playerType,
+        const sp<MediaPlayerBase>& player)
+{
+    // the cache goes away with this decode, so the idle player must not refer to it
+    player->setNotifyCallback(0, 0);
+    static_cast<MediaPlayerInterface*>(player.get())->setAudioSink(0);
+
+    Mutex::Autolock lock(mDecoderLock);
+    ssize_t index = mIdleDecoders.indexOfKey(playerType);
+    if (index < 0) {
+        index = mIdleDecoders.add(playerType, Vector<sp<MediaPlayerBase> >());
+    }
+    Vector<sp<MediaPlayerBase> >& idle = mIdleDecoders.editValueAt(index);
+    if (idle.size() < kMaxIdleDecoders) {
+        idle.push(player);
+    }
+}
+
+bool MediaPlayerService::decodeCacheKey(int fd, int64_t offset, int64_t length,
+        String8* key) const
+{
+    struct stat sb;
+    if (fstat(fd, &sb) != 0 || !S_ISREG(sb.st_mode)) {
+        return false;
+    }
+    key->appendFormat("%llu:%llu:%ld:%lld:%lld:%lld",
+            (unsigned long long) sb.st_dev, (unsigned long long) sb.st_ino,
+            (long) sb.st_mtime, (long long) sb.st_size, offset, length);
+    return true;
+}
+
+sp<IMemory> MediaPlayerService::lookupDecodedSample(const String8& key,
+        uint32_t *pSampleRate, int* pNumChannels, audio_format_t* pFormat)
+{
+    Mutex::Autolock lock(mDecodeCacheLock);
+    ssize_t index = mDecodeCache.indexOfKey(key);
+    if (index < 0) {
+        return 0;
+    }
+    const DecodedSample& sample = mDecodeCache.valueAt(index);
+    sp<IMemory> mem = sample.mMemory.promote();
+    if (mem == 0) {
+        mDecodeCache.removeItemsAt(index);
+        return 0;
+    }
+    *pSampleRate = sample.mSampleRate;
+    *pNumChannels = sample.mNumChannels;
+    *pFormat = sample.mFormat;
+    return mem;
+}
+
+sp<IMemory> MediaPlayerService::addDecodedSample(const String8& key,
+        const sp<IMemory>& decoded, uint32_t sampleRate, int numChannels,
+        audio_format_t format)
+{
+    Mutex::Autolock lock(mDecodeCacheLock);
+
+    // forget the samples nobody uses anymore
+    for (size_t i = mDecodeCache.size(); i > 0; ) {
+        i--;
+        if (mDecodeCache.valueAt(i).mMemory.promote() == 0) {
+            mDecodeCache.removeItemsAt(i);
+        }
+    }
+
+    if (mDecodeArena == 0) {
+        mDecodeArena = new MemoryDealer(kDecodeArenaSize, "MediaPlayerServiceDecode");
+    }
+    sp<IMemory> mem = mDecodeArena->allocate(decoded->size());
+    if (mem == 0) {
+        // the arena is full, share the decode heap itself
+        ALOGV("decode arena full, caching %u bytes in place", decoded->size());
+        mem = decoded;
+    } else {
+        memcpy(mem->pointer(), decoded->pointer(), decoded->size());
+    }
+
+    DecodedSample sample;
+    sample.mMemory = mem;
+    sample.mSampleRate = sampleRate;
+    sample.mNumChannels = numChannels;
+    sample.mFormat = format;
+    mDecodeCache.add(key, sample);
+    return mem;
+}
+
 sp<IMemory> MediaPlayerService::decode(int fd, int64_t offset, int64_t length, uint32_t *pSampleRate, int* pNumChannels, audio_format_t* pFormat)
 {
     ALOGV("decode(%d, %lld, %lld)", fd, offset, length);
-    sp<MemoryBase> mem;
+    sp<IMemory> mem;
     sp<MediaPlayerBase> player;
+    String8 key;
+    bool cacheable = decodeCacheKey(fd, offset, length, &key);
+
+    if (cacheable) {
+        mem = lookupDecodedSample(key, pSampleRate, pNumChannels, pFormat);
+        if (mem != 0) {
+            ALOGV("decode cache hit %s", key.string());
+            ::close(fd);
+            return mem;
+        }
+    }
 
     player_type playerType = getPlayerType(fd, offset, length);
     ALOGV("player type = %d", playerType);
 
-    // create the right type of player
+    // create the right type of player, or reuse one that decoded an earlier sample
     sp<AudioCache> cache = new AudioCache("decode_fd");
-    player = android::createPlayer(playerType, cache.get(), cache->notify);
+    bool reusable = false;
+    player = acquireDecoder(playerType, cache);
     if (player == NULL) goto Exit;
     if (player->hardwareOutput()) goto Exit;
 
@@ -1399,10 +1550,20 @@ sp<IMemory> MediaPlayerService::decode(int fd, int64_t offset, int64_t length, u
     *pSampleRate = cache->sampleRate();
     *pNumChannels = cache->channelCount();
     *pFormat = cache->format();
+    if (cacheable) {
+        mem = addDecodedSample(key, mem, *pSampleRate, *pNumChannels, *pFormat);
+    }
     ALOGV("return memory @ %p, sampleRate=%u, channelCount = %d, format = %d", mem->pointer(), *pSampleRate, *pNumChannels, *pFormat);
+    // only a player that decoded successfully is trusted with the next sample
+    reusable = true;
 
 Exit:
-    if (player != 0) player->reset();
+    if (player != 0) {
+        player->reset();
+        if (reusable) {
+            releaseDecoder(playerType, player);
+        }
+    }
     ::close(fd);
     return mem;
 }
@@ -1540,6 +1701,22 @@ status_t MediaPlayerService::AudioOutput::open(
             ALOGE("open() error, can't derive mask for %d audio channels", channelCount);
             return NO_INIT;
         }
+        // A compressed session handed over by switchToNextOutput() is kept as long as the
+        // stream configuration does not change, so that playlist playback neither closes
+        // the output nor wakes the DSP up at track boundaries.
+        if (mRecycledTrack && mCallback != NULL && mCallbackData != NULL &&
+                flags == mFlags &&
+                mRecycledTrack->getSampleRate() == sampleRate &&
+                mRecycledTrack->channelCount() == channelCount &&
+                mRecycledTrack->format() == format) {
+            ALOGV("chaining compressed session to next output");
+            close();
+            mTrack = mRecycledTrack;
+            mRecycledTrack = NULL;
+            mCallbackData->setOutput(this);
+            mSampleRateHz = sampleRate;
+            return OK;
+        }
         AudioTrack *t;
         CallbackData *newcbd = NULL;
         if (mCallback != NULL) {
@@ -1618,6 +1795,43 @@ status_t MediaPlayerService::AudioOutput::open(
         }
     }
 
+    if (mRecycledTrack) {
+        // check if the existing track can be reused as-is before creating a new one, so that
+        // gapless transitions between matching formats don't set up a track at all.
+
+        bool reuse = true;
+        if ((mCallbackData == NULL && mCallback != NULL) ||
+                (mCallbackData != NULL && mCallback == NULL)) {
+            // recycled track uses callbacks but the caller wants to use writes, or vice versa
+            ALOGV("can't chain callback and write");
+            reuse = false;
+        } else if ((mRecycledTrack->getSampleRate() != sampleRate) ||
+                (mRecycledTrack->channelCount() != channelCount) ||
+                (mRecycledTrack->format() != format) ||
+                (mRecycledTrack->frameCount() < frameCount)) {
+            ALOGV("samplerate, channelcount, format or framecount differ: %d/%d Hz, %d/%d ch, "
+                  "%d/%d format, %d/%d frames",
+                  mRecycledTrack->getSampleRate(), sampleRate,
+                  mRecycledTrack->channelCount(), channelCount,
+                  mRecycledTrack->format(), format,
+                  mRecycledTrack->frameCount(), frameCount);
+            reuse = false;
+        } else if (flags != mFlags) {
+            ALOGV("output flags differ %08x/%08x", flags, mFlags);
+            reuse = false;
+        }
+        if (reuse) {
+            ALOGV("chaining to next output");
+            close();
+            mTrack = mRecycledTrack;
+            mRecycledTrack = NULL;
+            if (mCallbackData != NULL) {
+                mCallbackData->setOutput(this);
+            }
+            return OK;
+        }
+    }
+
     AudioTrack *t;
     CallbackData *newcbd = NULL;
     if (mCallback != NULL) {
@@ -1656,40 +1870,7 @@ status_t MediaPlayerService::AudioOutput::open(
 
 
     if (mRecycledTrack) {
-        // check if the existing track can be reused as-is, or if a new track needs to be created.
-
-        bool reuse = true;
-        if ((mCallbackData == NULL && mCallback != NULL) ||
-                (mCallbackData != NULL && mCallback == NULL)) {
-            // recycled track uses callbacks but the caller wants to use writes, or vice versa
-            ALOGV("can't chain callback and write");
-            reuse = false;
-        } else if ((mRecycledTrack->getSampleRate() != sampleRate) ||
-                (mRecycledTrack->channelCount() != channelCount) ||
-                (mRecycledTrack->frameCount() != t->frameCount())) {
-            ALOGV("samplerate, channelcount or framecount differ: %d/%d Hz, %d/%d ch, %d/%d frames",
-                  mRecycledTrack->getSampleRate(), sampleRate,
-                  mRecycledTrack->channelCount(), channelCount,
-                  mRecycledTrack->frameCount(), t->frameCount());
-            reuse = false;
-        } else if (flags != mFlags) {
-            ALOGV("output flags differ %08x/%08x", flags, mFlags);
-            reuse = false;
-        }
-        if (reuse) {
-            ALOGV("chaining to next output");
-            close();
-            mTrack = mRecycledTrack;
-            mRecycledTrack = NULL;
-            if (mCallbackData != NULL) {
-                mCallbackData->setOutput(this);
-            }
-            delete t;
-            delete newcbd;
-            return OK;
-        }
-        //usleep(500000);
-        // if we're not going to reuse the track, unblock and flush it
+        // the recycled track couldn't be reused, unblock and flush it
         if (mCallbackData != NULL) {
             mCallbackData->setOutput(NULL);
             mCallbackData->endTrackSwitch();
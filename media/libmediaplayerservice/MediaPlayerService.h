@@ -39,6 +39,7 @@ namespace android {
 
 class AudioTrack;
 class IMediaRecorder;
+class MemoryDealer;
 class IMediaMetadataRetriever;
 class IOMX;
 class MediaRecorderClient;
@@ -428,6 +429,40 @@ private:
                             MediaPlayerService();
     virtual                 ~MediaPlayerService();
 
+    // Samples decoded from a file descriptor are shared by every client decoding the same
+    // file, so that the click and notification sounds loaded by each SoundPool are decoded
+    // and stored once.  Entries hold weak references and go away with their last user.
+    struct DecodedSample {
+        wp<IMemory>         mMemory;
+        uint32_t            mSampleRate;
+        int                 mNumChannels;
+        audio_format_t      mFormat;
+    };
+
+            // returns false if the file cannot be identified, in which case it is not cached
+            bool            decodeCacheKey(int fd, int64_t offset, int64_t length,
+                                           String8* key) const;
+            sp<IMemory>     lookupDecodedSample(const String8& key, uint32_t *pSampleRate,
+                                                int* pNumChannels, audio_format_t* pFormat);
+            // copies the decoded data out of the 1MB decode heap into the shared arena
+            sp<IMemory>     addDecodedSample(const String8& key, const sp<IMemory>& decoded,
+                                             uint32_t sampleRate, int numChannels,
+                                             audio_format_t format);
+
+                Mutex                       mDecodeCacheLock;
+                KeyedVector<String8, DecodedSample> mDecodeCache;
+                sp<MemoryDealer>            mDecodeArena;
+
+            // decode() resets the player it used and keeps it for the next sample of the
+            // same player type, rather than creating a player for every sample
+            sp<MediaPlayerBase> acquireDecoder(player_type playerType,
+                                               const sp<AudioCache>& cache);
+            void            releaseDecoder(player_type playerType,
+                                           const sp<MediaPlayerBase>& player);
+
+                Mutex                       mDecoderLock;
+                KeyedVector<int, Vector<sp<MediaPlayerBase> > > mIdleDecoders;
+
     mutable     Mutex                       mLock;
                 SortedVector< wp<Client> >  mClients;
                 SortedVector< wp<MediaRecorderClient> > mMediaRecorderClients;
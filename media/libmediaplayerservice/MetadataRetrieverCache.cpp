@@ -0,0 +1,258 @@
+/*
+**
+** Copyright (C) 2012 The Android Open Source Project
+**
+** Licensed under the Apache License, Version 2.0 (the "License");
+** you may not use this file except in compliance with the License.
+** You may obtain a copy of the License at
+**
+**     http://www.apache.org/licenses/LICENSE-2.0
+**
+** Unless required by applicable law or agreed to in writing, software
+** distributed under the License is distributed on an "AS IS" BASIS,
+** WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+** See the License for the specific language governing permissions and
+** limitations under the License.
+*/
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "MetadataRetrieverCache"
+#include <utils/Log.h>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <cutils/properties.h>
+#include <private/media/VideoFrame.h>
+#include "MetadataRetrieverCache.h"
+
+namespace android {
+
+// Default memory cap, may be changed with the property
+// media.metadata.cache-kb; 0 disables the cache.
+static const size_t kDefaultMaxKBytes = 4096;
+static const size_t kMaxEntries = 256;
+
+// Approximate bookkeeping cost of an entry and of a metadata value.
+static const size_t kEntryOverhead = 64;
+static const size_t kMetadataItemOverhead = 16;
+
+static Mutex gInstanceLock;
+static MetadataRetrieverCache *gInstance = NULL;
+
+bool MetadataRetrieverCache::Key::operator==(const Key &other) const {
+    return mDevice == other.mDevice
+        && mInode == other.mInode
+        && mFileSize == other.mFileSize
+        && mModified == other.mModified
+        && mOffset == other.mOffset
+        && mLength == other.mLength;
+}
+
+// static
+MetadataRetrieverCache *MetadataRetrieverCache::getInstance() {
+    Mutex::Autolock autoLock(gInstanceLock);
+    if (gInstance == NULL) {
+        gInstance = new MetadataRetrieverCache;
+    }
+    return gInstance;
+}
+
+// static
+bool MetadataRetrieverCache::makeKey(
+        int fd, int64_t offset, int64_t length, Key *key) {
+    struct stat sb;
+    if (fstat(fd, &sb) != 0 || !S_ISREG(sb.st_mode)) {
+        // Pipes and sockets have no stable identity.
+        return false;
+    }
+
+    key->mDevice = sb.st_dev;
+    key->mInode = sb.st_ino;
+    key->mFileSize = sb.st_size;
+    key->mModified = sb.st_mtime;
+    key->mOffset = offset;
+    key->mLength = length;
+
+    return true;
+}
+
+MetadataRetrieverCache::MetadataRetrieverCache()
+    : mMaxBytes(kDefaultMaxKBytes * 1024),
+      mMaxEntries(kMaxEntries),
+      mTotalBytes(0),
+      mNumHits(0),
+      mNumMisses(0),
+      mNumEvictions(0) {
+    char value[PROPERTY_VALUE_MAX];
+    if (property_get("media.metadata.cache-kb", value, NULL)) {
+        mMaxBytes = (size_t)atoi(value) * 1024;
+    }
+
+    ALOGV("cache limit %u bytes", mMaxBytes);
+}
+
+MetadataRetrieverCache::~MetadataRetrieverCache() {
+    Mutex::Autolock autoLock(mLock);
+    while (!mEntries.empty()) {
+        erase_l(mEntries.begin());
+    }
+}
+
+bool MetadataRetrieverCache::contains(const Key &key) {
+    Mutex::Autolock autoLock(mLock);
+    for (List<Entry *>::iterator it = mEntries.begin();
+         it != mEntries.end(); ++it) {
+        if ((*it)->mKey == key) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool MetadataRetrieverCache::getMetadata(
+        const Key &key, KeyedVector<int, String8> *metadata) {
+    Mutex::Autolock autoLock(mLock);
+
+    List<Entry *>::iterator it = find_l(key, false, 0, 0);
+    if (it == mEntries.end()) {
+        ++mNumMisses;
+        return false;
+    }
+
+    ++mNumHits;
+    *metadata = (*it)->mMetadata;
+
+    return true;
+}
+
+void MetadataRetrieverCache::putMetadata(
+        const Key &key, const KeyedVector<int, String8> &metadata) {
+    if (!isEnabled()) {
+        return;
+    }
+
+    Entry *entry = new Entry;
+    entry->mKey = key;
+    entry->mIsFrame = false;
+    entry->mTimeUs = 0;
+    entry->mOption = 0;
+    entry->mMetadata = metadata;
+    entry->mFrame = NULL;
+    entry->mSize = kEntryOverhead;
+    for (size_t i = 0; i < metadata.size(); ++i) {
+        entry->mSize += metadata.valueAt(i).size() + kMetadataItemOverhead;
+    }
+
+    Mutex::Autolock autoLock(mLock);
+    insert_l(entry);
+}
+
+VideoFrame *MetadataRetrieverCache::getFrame(
+        const Key &key, int64_t timeUs, int option) {
+    Mutex::Autolock autoLock(mLock);
+
+    List<Entry *>::iterator it = find_l(key, true, timeUs, option);
+    if (it == mEntries.end()) {
+        ++mNumMisses;
+        return NULL;
+    }
+
+    ++mNumHits;
+    return new VideoFrame(*(*it)->mFrame);
+}
+
+void MetadataRetrieverCache::putFrame(
+        const Key &key, int64_t timeUs, int option, const VideoFrame &frame) {
+    // A single frame must not push out most of the cache.
+    size_t size = kEntryOverhead + sizeof(VideoFrame) + frame.mSize;
+    if (!isEnabled() || size > mMaxBytes / 4) {
+        return;
+    }
+
+    VideoFrame *copy = new VideoFrame(frame);
+    if (copy->mSize != frame.mSize) {
+        // The copy could not allocate the pixels.
+        delete copy;
+        return;
+    }
+
+    Entry *entry = new Entry;
+    entry->mKey = key;
+    entry->mIsFrame = true;
+    entry->mTimeUs = timeUs;
+    entry->mOption = option;
+    entry->mFrame = copy;
+    entry->mSize = size;
+
+    Mutex::Autolock autoLock(mLock);
+    insert_l(entry);
+}
+
+void MetadataRetrieverCache::dump(String8 *result) {
+    Mutex::Autolock autoLock(mLock);
+
+    const size_t SIZE = 256;
+    char buffer[SIZE];
+    snprintf(buffer, SIZE,
+            " MetadataRetrieverCache: %u entries, %u of %u bytes,"
+            " %u hits, %u misses, %u evictions\n",
+            mEntries.size(), mTotalBytes, mMaxBytes,
+            mNumHits, mNumMisses, mNumEvictions);
+    result->append(buffer);
+}
+
+List<MetadataRetrieverCache::Entry *>::iterator MetadataRetrieverCache::find_l(
+        const Key &key, bool isFrame, int64_t timeUs, int option) {
+    for (List<Entry *>::iterator it = mEntries.begin();
+         it != mEntries.end(); ++it) {
+        Entry *entry = *it;
+        if (entry->mIsFrame != isFrame || !(entry->mKey == key)) {
+            continue;
+        }
+
+        if (isFrame && (entry->mTimeUs != timeUs || entry->mOption != option)) {
+            continue;
+        }
+
+        if (it != mEntries.begin()) {
+            mEntries.erase(it);
+            mEntries.push_front(entry);
+        }
+        return mEntries.begin();
+    }
+
+    return mEntries.end();
+}
+
+void MetadataRetrieverCache::insert_l(Entry *entry) {
+    // Replace what another client may have added in the meantime.
+    List<Entry *>::iterator it =
+        find_l(entry->mKey, entry->mIsFrame, entry->mTimeUs, entry->mOption);
+    if (it != mEntries.end()) {
+        erase_l(it);
+    }
+
+    mEntries.push_front(entry);
+    mTotalBytes += entry->mSize;
+
+    while (mEntries.size() > 1
+            && (mTotalBytes > mMaxBytes || mEntries.size() > mMaxEntries)) {
+        erase_l(--mEntries.end());
+        ++mNumEvictions;
+    }
+}
+
+void MetadataRetrieverCache::erase_l(List<Entry *>::iterator it) {
+    Entry *entry = *it;
+    mTotalBytes -= entry->mSize;
+    mEntries.erase(it);
+
+    delete entry->mFrame;
+    delete entry;
+}
+
+}; // namespace android
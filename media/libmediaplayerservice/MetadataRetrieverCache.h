@@ -0,0 +1,108 @@
+/*
+**
+** Copyright (C) 2012 The Android Open Source Project
+**
+** Licensed under the Apache License, Version 2.0 (the "License");
+** you may not use this file except in compliance with the License.
+** You may obtain a copy of the License at
+**
+**     http://www.apache.org/licenses/LICENSE-2.0
+**
+** Unless required by applicable law or agreed to in writing, software
+** distributed under the License is distributed on an "AS IS" BASIS,
+** WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+** See the License for the specific language governing permissions and
+** limitations under the License.
+*/
+
+#ifndef ANDROID_METADATARETRIEVERCACHE_H
+#define ANDROID_METADATARETRIEVERCACHE_H
+
+#include <sys/types.h>
+
+#include <utils/threads.h>
+#include <utils/List.h>
+#include <utils/KeyedVector.h>
+#include <utils/String8.h>
+
+namespace android {
+
+class VideoFrame;
+
+// Process wide LRU cache of the metadata and the frames that
+// MetadataRetrieverClient extracted, keyed by the identity of the file
+// they came from, so that a client asking again for the same file is
+// answered without opening and parsing it. Only file descriptor sources
+// are cached; a file that is rewritten changes size or mtime and misses.
+class MetadataRetrieverCache
+{
+public:
+    struct Key {
+        dev_t   mDevice;
+        ino_t   mInode;
+        off64_t mFileSize;
+        time_t  mModified;
+        int64_t mOffset;
+        int64_t mLength;
+
+        bool operator==(const Key &other) const;
+    };
+
+    static MetadataRetrieverCache *getInstance();
+
+    // Fills in the key of the region [offset, offset + length) of fd.
+    static bool makeKey(int fd, int64_t offset, int64_t length, Key *key);
+
+    bool isEnabled() const { return mMaxBytes > 0; }
+
+    // Whether anything is cached for the source, i.e. it was opened
+    // successfully before.
+    bool contains(const Key &key);
+
+    // The cached metadata holds every key extractMetadata() returned a
+    // value for; keys that are absent have no value.
+    bool getMetadata(const Key &key, KeyedVector<int, String8> *metadata);
+    void putMetadata(const Key &key, const KeyedVector<int, String8> &metadata);
+
+    // Returns a copy of the cached frame, which the caller deletes, or NULL.
+    VideoFrame *getFrame(const Key &key, int64_t timeUs, int option);
+    void putFrame(const Key &key, int64_t timeUs, int option, const VideoFrame &frame);
+
+    void dump(String8 *result);
+
+private:
+    struct Entry {
+        Key mKey;
+        bool mIsFrame;
+        int64_t mTimeUs;
+        int mOption;
+        KeyedVector<int, String8> mMetadata;
+        VideoFrame *mFrame;
+        size_t mSize;
+    };
+
+    Mutex mLock;
+    List<Entry *> mEntries;     // most recently used first
+    size_t mMaxBytes;
+    size_t mMaxEntries;
+    size_t mTotalBytes;
+
+    uint32_t mNumHits;
+    uint32_t mNumMisses;
+    uint32_t mNumEvictions;
+
+    MetadataRetrieverCache();
+    ~MetadataRetrieverCache();
+
+    List<Entry *>::iterator find_l(
+            const Key &key, bool isFrame, int64_t timeUs, int option);
+    void insert_l(Entry *entry);
+    void erase_l(List<Entry *>::iterator it);
+
+    MetadataRetrieverCache(const MetadataRetrieverCache &);
+    MetadataRetrieverCache &operator=(const MetadataRetrieverCache &);
+};
+
+}; // namespace android
+
+#endif // ANDROID_METADATARETRIEVERCACHE_H
@@ -33,6 +33,7 @@
 #include <binder/IServiceManager.h>
 #include <media/MediaMetadataRetrieverInterface.h>
 #include <media/MediaPlayerInterface.h>
+#include <media/mediametadataretriever.h>
 #include <private/media/VideoFrame.h>
 #include "MidiMetadataRetriever.h"
 #include "MetadataRetrieverClient.h"
@@ -50,6 +51,11 @@ MetadataRetrieverClient::MetadataRetrieverClient(pid_t pid)
     mThumbnail = NULL;
     mAlbumArt = NULL;
     mRetriever = NULL;
+    mCacheable = false;
+    mFd = -1;
+    mOffset = 0;
+    mLength = 0;
+    mHasMetadata = false;
 }
 
 MetadataRetrieverClient::~MetadataRetrieverClient()
@@ -66,6 +72,7 @@ status_t MetadataRetrieverClient::dump(int fd, const Vector<String16>& args) con
     result.append(" MetadataRetrieverClient\n");
     snprintf(buffer, 255, "  pid(%d)\n", mPid);
     result.append(buffer);
+    MetadataRetrieverCache::getInstance()->dump(&result);
     write(fd, result.string(), result.size());
     write(fd, "\n", 1);
     return NO_ERROR;
@@ -78,9 +85,21 @@ void MetadataRetrieverClient::disconnect()
     mRetriever.clear();
     mThumbnail.clear();
     mAlbumArt.clear();
+    resetSource_l();
     IPCThreadState::self()->flushCommands();
 }
 
+void MetadataRetrieverClient::resetSource_l()
+{
+    if (mFd >= 0) {
+        ::close(mFd);
+        mFd = -1;
+    }
+    mCacheable = false;
+    mHasMetadata = false;
+    mMetadata.clear();
+}
+
 static sp<MediaMetadataRetrieverBase> createRetriever(player_type playerType)
 {
     sp<MediaMetadataRetrieverBase> p;
@@ -112,6 +131,7 @@ status_t MetadataRetrieverClient::setDataSource(
 {
     ALOGV("setDataSource(%s)", url);
     Mutex::Autolock lock(mLock);
+    resetSource_l();
     if (url == NULL) {
         return UNKNOWN_ERROR;
     }
@@ -128,6 +148,7 @@ status_t MetadataRetrieverClient::setDataSource(int fd, int64_t offset, int64_t
 {
     ALOGV("setDataSource fd=%d, offset=%lld, length=%lld", fd, offset, length);
     Mutex::Autolock lock(mLock);
+    resetSource_l();
     struct stat sb;
     int ret = fstat(fd, &sb);
     if (ret != 0) {
@@ -150,6 +171,26 @@ status_t MetadataRetrieverClient::setDataSource(int fd, int64_t offset, int64_t
         ALOGV("calculated length = %lld", length);
     }
 
+    MetadataRetrieverCache *cache = MetadataRetrieverCache::getInstance();
+    mCacheable = cache->isEnabled()
+        && MetadataRetrieverCache::makeKey(fd, offset, length, &mCacheKey);
+    if (mCacheable && cache->contains(mCacheKey)) {
+        // The file opened fine before; keep it to open the retriever
+        // only if a request misses the cache.
+        mFd = dup(fd);
+        ::close(fd);
+        if (mFd < 0) {
+            mCacheable = false;
+            return UNKNOWN_ERROR;
+        }
+        mOffset = offset;
+        mLength = length;
+        mRetriever.clear();
+        mHasMetadata = cache->getMetadata(mCacheKey, &mMetadata);
+        ALOGV("setDataSource: cached, metadata %s", mHasMetadata ? "hit" : "miss");
+        return NO_ERROR;
+    }
+
     player_type playerType = getPlayerType(fd, offset, length);
     ALOGV("player type = %d", playerType);
     sp<MediaMetadataRetrieverBase> p = createRetriever(playerType);
@@ -158,24 +199,64 @@ status_t MetadataRetrieverClient::setDataSource(int fd, int64_t offset, int64_t
         return NO_INIT;
     }
     status_t status = p->setDataSource(fd, offset, length);
-    if (status == NO_ERROR) mRetriever = p;
+    if (status == NO_ERROR) {
+        mRetriever = p;
+    } else {
+        mCacheable = false;
+    }
     ::close(fd);
     return status;
 }
 
+status_t MetadataRetrieverClient::openRetriever_l()
+{
+    if (mRetriever != NULL) {
+        return NO_ERROR;
+    }
+    if (mFd < 0) {
+        ALOGE("retriever is not initialized");
+        return NO_INIT;
+    }
+
+    player_type playerType = getPlayerType(mFd, mOffset, mLength);
+    ALOGV("player type = %d", playerType);
+    sp<MediaMetadataRetrieverBase> p = createRetriever(playerType);
+    if (p == NULL) {
+        return NO_INIT;
+    }
+    status_t status = p->setDataSource(mFd, mOffset, mLength);
+    if (status != NO_ERROR) {
+        ALOGE("failed to open the cached source: %d", status);
+        return status;
+    }
+    mRetriever = p;
+    ::close(mFd);
+    mFd = -1;
+    return NO_ERROR;
+}
+
 sp<IMemory> MetadataRetrieverClient::getFrameAtTime(int64_t timeUs, int option)
 {
     ALOGV("getFrameAtTime: time(%lld us) option(%d)", timeUs, option);
     Mutex::Autolock lock(mLock);
     mThumbnail.clear();
-    if (mRetriever == NULL) {
-        ALOGE("retriever is not initialized");
-        return NULL;
+    MetadataRetrieverCache *cache = MetadataRetrieverCache::getInstance();
+    VideoFrame *frame = NULL;
+    if (mCacheable) {
+        frame = cache->getFrame(mCacheKey, timeUs, option);
     }
-    VideoFrame *frame = mRetriever->getFrameAtTime(timeUs, option);
     if (frame == NULL) {
-        ALOGE("failed to capture a video frame");
-        return NULL;
+        if (openRetriever_l() != NO_ERROR) {
+            return NULL;
+        }
+        frame = mRetriever->getFrameAtTime(timeUs, option);
+        if (frame == NULL) {
+            ALOGE("failed to capture a video frame");
+            return NULL;
+        }
+        if (mCacheable) {
+            cache->putFrame(mCacheKey, timeUs, option, *frame);
+        }
     }
     size_t size = sizeof(VideoFrame) + frame->mSize;
     sp<MemoryHeapBase> heap = new MemoryHeapBase(size, 0, "MetadataRetrieverClient");
@@ -209,8 +290,7 @@ sp<IMemory> MetadataRetrieverClient::extractAlbumArt()
     ALOGV("extractAlbumArt");
     Mutex::Autolock lock(mLock);
     mAlbumArt.clear();
-    if (mRetriever == NULL) {
-        ALOGE("retriever is not initialized");
+    if (openRetriever_l() != NO_ERROR) {
         return NULL;
     }
     MediaAlbumArt *albumArt = mRetriever->extractAlbumArt();
@@ -243,11 +323,37 @@ const char* MetadataRetrieverClient::extractMetadata(int keyCode)
 {
     ALOGV("extractMetadata");
     Mutex::Autolock lock(mLock);
-    if (mRetriever == NULL) {
-        ALOGE("retriever is not initialized");
+    if (!mHasMetadata) {
+        if (openRetriever_l() != NO_ERROR) {
+            return NULL;
+        }
+        if (!mCacheable) {
+            return mRetriever->extractMetadata(keyCode);
+        }
+
+        // Callers ask for most keys in turn, so extract them all at once
+        // for the cache.
+        for (int key = METADATA_KEY_CD_TRACK_NUMBER; key <= METADATA_KEY_LOCATION; ++key) {
+            const char *value = mRetriever->extractMetadata(key);
+            if (value != NULL) {
+                mMetadata.add(key, String8(value));
+            }
+        }
+        mHasMetadata = true;
+        MetadataRetrieverCache::getInstance()->putMetadata(mCacheKey, mMetadata);
+    }
+    ssize_t index = mMetadata.indexOfKey(keyCode);
+    if (index < 0) {
+        if (keyCode < METADATA_KEY_CD_TRACK_NUMBER || keyCode > METADATA_KEY_LOCATION) {
+            // Not one of the keys the cache knows about.
+            if (openRetriever_l() != NO_ERROR) {
+                return NULL;
+            }
+            return mRetriever->extractMetadata(keyCode);
+        }
         return NULL;
     }
-    return mRetriever->extractMetadata(keyCode);
+    return mMetadata.valueAt(index).string();
 }
 
 }; // namespace android
@@ -27,6 +27,8 @@
 
 #include <media/MediaMetadataRetrieverInterface.h>
 
+#include "MetadataRetrieverCache.h"
+
 
 namespace android {
 
@@ -58,6 +60,9 @@ private:
     explicit MetadataRetrieverClient(pid_t pid);
     virtual ~MetadataRetrieverClient();
 
+    void                                   resetSource_l();
+    status_t                               openRetriever_l();
+
     mutable Mutex                          mLock;
     sp<MediaMetadataRetrieverBase>         mRetriever;
     pid_t                                  mPid;
@@ -65,6 +70,20 @@ private:
     // Keep the shared memory copy of album art and capture frame (for thumbnail)
     sp<IMemory>                            mAlbumArt;
     sp<IMemory>                            mThumbnail;
+
+    // Set when the source is a file that MetadataRetrieverCache may answer
+    // for. If the cache already knew the file, mRetriever is only created
+    // from mFd once a request misses.
+    bool                                   mCacheable;
+    MetadataRetrieverCache::Key            mCacheKey;
+    int                                    mFd;
+    int64_t                                mOffset;
+    int64_t                                mLength;
+
+    // Every metadata value of the source, once extracted or taken from the
+    // cache; extractMetadata() returns pointers into it.
+    bool                                   mHasMetadata;
+    KeyedVector<int, String8>              mMetadata;
 };
 
 }; // namespace android
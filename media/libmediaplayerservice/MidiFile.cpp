@@ -21,6 +21,7 @@
 #include "utils/Log.h"
 
 #include <stdio.h>
+#include <string.h>
 #include <assert.h>
 #include <limits.h>
 #include <unistd.h>
@@ -42,8 +43,13 @@ namespace android {
 
 // ----------------------------------------------------------------------------
 
-// The midi engine buffers are a bit small (128 frames), so we batch them up
+// The midi engine buffers are a bit small (128 frames), so we batch them up.
+// Once the output is open, each write covers half of the sink buffer, within these bounds.
 static const int NUM_BUFFERS = 4;
+static const int MAX_NUM_BUFFERS = 32;
+
+// audio rendered by prepare() so that start() does not wait for the synthesizer
+static const int PRERENDER_MS = 1000;
 
 // TODO: Determine appropriate return codes
 static status_t ERROR_NOT_OPEN = -1;
@@ -54,7 +60,8 @@ static status_t ERROR_ALLOCATE_FAILED = -4;
 static const S_EAS_LIB_CONFIG* pLibConfig = NULL;
 
 MidiFile::MidiFile() :
-    mEasData(NULL), mEasHandle(NULL), mAudioBuffer(NULL),
+    mEasData(NULL), mEasHandle(NULL), mAudioBuffer(NULL), mRenderBuffers(NUM_BUFFERS),
+    mPrerenderBuffer(NULL), mPrerenderSize(0), mPrerenderOffset(0),
     mPlayTime(-1), mDuration(-1), mState(EAS_STATE_ERROR),
     mStreamType(AUDIO_STREAM_MUSIC), mLoop(false), mExit(false),
     mPaused(false), mRender(false), mTid(-1)
@@ -186,9 +193,63 @@ status_t MidiFile::prepare()
         return ERROR_EAS_FAILURE;
     }
     updateState();
+    prerender_l();
     return NO_ERROR;
 }
 
+// call only with mutex held
+void MidiFile::prerender_l()
+{
+    discardPrerender_l();
+
+    int numBuffers = (pLibConfig->sampleRate * PRERENDER_MS / 1000 +
+            pLibConfig->mixBufferSize - 1) / pLibConfig->mixBufferSize;
+    mPrerenderBuffer = new EAS_PCM[pLibConfig->mixBufferSize * pLibConfig->numChannels * numBuffers];
+    if (!mPrerenderBuffer) {
+        ALOGW("mPrerenderBuffer allocate failed");
+        return;
+    }
+
+    EAS_PCM* p = mPrerenderBuffer;
+    for (int i = 0; i < numBuffers; i++) {
+        EAS_I32 count;
+        EAS_RESULT result = EAS_Render(mEasData, p, pLibConfig->mixBufferSize, &count);
+        if (result != EAS_SUCCESS) {
+            ALOGE("EAS_Render returned %ld", result);
+            break;
+        }
+        p += count * pLibConfig->numChannels;
+        mPrerenderSize += count * pLibConfig->numChannels * sizeof(EAS_PCM);
+        EAS_STATE state;
+        EAS_State(mEasData, mEasHandle, &state);
+        if (state != EAS_STATE_PLAY && state != EAS_STATE_READY) {
+            break;
+        }
+    }
+    // rendering moved the synthesizer to playing, but we have not started yet;
+    // the render thread updates the state once it writes the audio
+    ALOGV("prerendered %d bytes", mPrerenderSize);
+}
+
+// call only with mutex held
+void MidiFile::discardPrerender_l()
+{
+    if (mPrerenderBuffer) {
+        delete [] mPrerenderBuffer;
+        mPrerenderBuffer = NULL;
+    }
+    mPrerenderSize = 0;
+    mPrerenderOffset = 0;
+}
+
+// call only with mutex held
+EAS_I32 MidiFile::prerenderPendingMs_l() const
+{
+    size_t frames = (mPrerenderSize - mPrerenderOffset) /
+            (pLibConfig->numChannels * sizeof(EAS_PCM));
+    return EAS_I32((int64_t)frames * 1000 / pLibConfig->sampleRate);
+}
+
 status_t MidiFile::prepareAsync()
 {
     ALOGV("MidiFile::prepareAsync");
@@ -243,6 +304,8 @@ status_t MidiFile::stop()
         }
     }
     mPaused = false;
+    // let the render thread reach the paused state through EAS_Render
+    discardPrerender_l();
     return NO_ERROR;
 }
 
@@ -262,6 +325,7 @@ status_t MidiFile::seekTo(int position)
             ALOGE("EAS_Locate returned %ld", result);
             return ERROR_EAS_FAILURE;
         }
+        discardPrerender_l();
         EAS_GetLocation(mEasData, mEasHandle, &mPlayTime);
     }
     sendEvent(MEDIA_SEEK_COMPLETE);
@@ -399,6 +463,7 @@ status_t MidiFile::reset_nosync()
     mFileLocator.offset = 0;
     mFileLocator.length = 0;
 
+    discardPrerender_l();
     mPlayTime = -1;
     mDuration = -1;
     mLoop = false;
@@ -427,6 +492,21 @@ status_t MidiFile::createOutputTrack() {
         ALOGE("mAudioSink open failed");
         return ERROR_OPEN_FAILED;
     }
+
+    // write half of the sink buffer at a time rather than a few mix buffers, so that the
+    // render thread wakes up and writes less often
+    int renderBuffers = NUM_BUFFERS;
+    ssize_t frameCount = mAudioSink->frameCount();
+    if (frameCount > 0) {
+        renderBuffers = frameCount / (2 * pLibConfig->mixBufferSize);
+        if (renderBuffers < NUM_BUFFERS) {
+            renderBuffers = NUM_BUFFERS;
+        } else if (renderBuffers > MAX_NUM_BUFFERS) {
+            renderBuffers = MAX_NUM_BUFFERS;
+        }
+    }
+    ALOGV("rendering %d buffers per write", renderBuffers);
+    mRenderBuffers = renderBuffers;
     return NO_ERROR;
 }
 
@@ -439,7 +519,7 @@ int MidiFile::render() {
     ALOGV("MidiFile::render");
 
     // allocate render buffer
-    mAudioBuffer = new EAS_PCM[pLibConfig->mixBufferSize * pLibConfig->numChannels * NUM_BUFFERS];
+    mAudioBuffer = new EAS_PCM[pLibConfig->mixBufferSize * pLibConfig->numChannels * MAX_NUM_BUFFERS];
     if (!mAudioBuffer) {
         ALOGE("mAudioBuffer allocate failed");
         goto threadExit;
@@ -471,22 +551,48 @@ int MidiFile::render() {
         // render midi data into the input buffer
         //ALOGV("MidiFile::render - rendering audio");
         int num_output = 0;
-        EAS_PCM* p = mAudioBuffer;
-        for (int i = 0; i < NUM_BUFFERS; i++) {
-            result = EAS_Render(mEasData, p, pLibConfig->mixBufferSize, &count);
-            if (result != EAS_SUCCESS) {
-                ALOGE("EAS_Render returned %ld", result);
+        int blockSize = mRenderBuffers * pLibConfig->mixBufferSize *
+                pLibConfig->numChannels * sizeof(EAS_PCM);
+        if (mPrerenderOffset < mPrerenderSize) {
+            // play what prepare() rendered first
+            num_output = mPrerenderSize - mPrerenderOffset;
+            if (num_output > blockSize) {
+                num_output = blockSize;
+            }
+            memcpy(mAudioBuffer, (const char *)mPrerenderBuffer + mPrerenderOffset, num_output);
+            mPrerenderOffset += num_output;
+        } else {
+            if (mPrerenderBuffer) {
+                discardPrerender_l();
+            }
+            EAS_PCM* p = mAudioBuffer;
+            for (int i = 0; i < mRenderBuffers; i++) {
+                result = EAS_Render(mEasData, p, pLibConfig->mixBufferSize, &count);
+                if (result != EAS_SUCCESS) {
+                    ALOGE("EAS_Render returned %ld", result);
+                }
+                p += count * pLibConfig->numChannels;
+                num_output += count * pLibConfig->numChannels * sizeof(EAS_PCM);
             }
-            p += count * pLibConfig->numChannels;
-            num_output += count * pLibConfig->numChannels * sizeof(EAS_PCM);
         }
 
-        // update playback state and position
+        // update playback state and position, which lags the synthesizer by the
+        // prerendered audio not written yet
         // ALOGV("MidiFile::render - updating state");
         EAS_GetLocation(mEasData, mEasHandle, &mPlayTime);
         EAS_State(mEasData, mEasHandle, &mState);
-        if((mDuration > 0) && (mPlayTime >= mDuration))
+        if (mPrerenderOffset < mPrerenderSize) {
+            mPlayTime -= prerenderPendingMs_l();
+            // the synthesizer only moves to paused when rendering, and any end of
+            // playback it reached is still ahead in the prerendered audio
+            if (mState == EAS_STATE_PAUSING) {
+                mState = EAS_STATE_PAUSED;
+            } else if (mState != EAS_STATE_ERROR) {
+                mState = EAS_STATE_PLAY;
+            }
+        } else if((mDuration > 0) && (mPlayTime >= mDuration)) {
             mState = EAS_STATE_STOPPED;
+        }
         mMutex.unlock();
 
         // create audio output track if necessary
@@ -67,12 +67,19 @@ private:
             status_t    reset_nosync();
             int         render();
             void        updateState(){ EAS_State(mEasData, mEasHandle, &mState); }
+            void        prerender_l();
+            void        discardPrerender_l();
+            EAS_I32     prerenderPendingMs_l() const;
 
     Mutex               mMutex;
     Condition           mCondition;
     EAS_DATA_HANDLE     mEasData;
     EAS_HANDLE          mEasHandle;
     EAS_PCM*            mAudioBuffer;
+    int                 mRenderBuffers;     // EAS mix buffers rendered per sink write
+    EAS_PCM*            mPrerenderBuffer;   // audio rendered by prepare(), played first
+    size_t              mPrerenderSize;     // in bytes
+    size_t              mPrerenderOffset;   // in bytes, already written to the sink
     EAS_I32             mPlayTime;
     EAS_I32             mDuration;
     EAS_STATE           mState;
@@ -55,6 +55,7 @@
 #include <system/audio.h>
 
 #include "ARTPWriter.h"
+#include "TeeSource.h"
 #include <cutils/properties.h>
 
 #ifdef QCOM_HARDWARE
@@ -78,6 +79,7 @@ static void addBatteryData(uint32_t params) {
 StagefrightRecorder::StagefrightRecorder()
     : mWriter(NULL),
       mOutputFd(-1),
+      mStreamOutputFormat(OUTPUT_FORMAT_LIST_END),
       mAudioSource(AUDIO_SOURCE_CNT),
       mVideoSource(VIDEO_SOURCE_LIST_END),
       mStarted(false), mSurfaceMediaSource(NULL) {
@@ -479,6 +481,25 @@ status_t StagefrightRecorder::setParam64BitFileOffset(bool use64Bit) {
     return OK;
 }
 
+status_t StagefrightRecorder::setParamRelocateMoovBox(bool relocate) {
+    ALOGV("setParamRelocateMoovBox: %s", relocate? "true": "false");
+    mRelocateMoovBox = relocate;
+    return OK;
+}
+
+status_t StagefrightRecorder::setParamStreamOutputFormat(int32_t format) {
+    ALOGV("setParamStreamOutputFormat: %d", format);
+
+    // Only RTP can be streamed alongside a file, the other stream
+    // formats would need an output fd of their own.
+    if (format != OUTPUT_FORMAT_RTP_AVP) {
+        ALOGE("Unsupported stream output format: %d", format);
+        return BAD_VALUE;
+    }
+    mStreamOutputFormat = (output_format)format;
+    return OK;
+}
+
 status_t StagefrightRecorder::setParamVideoCameraId(int32_t cameraId) {
     ALOGV("setParamVideoCameraId: %d", cameraId);
     if (cameraId < 0) {
@@ -498,6 +519,16 @@ status_t StagefrightRecorder::setParamTrackTimeStatus(int64_t timeDurationUs) {
     return OK;
 }
 
+status_t StagefrightRecorder::setParamFragmentDuration(int64_t durationUs) {
+    ALOGV("setParamFragmentDuration: %lld us", durationUs);
+    if (durationUs < 0) {
+        ALOGE("Fragment duration (%lld us) is negative", durationUs);
+        return BAD_VALUE;
+    }
+    mFragmentDurationUs = durationUs;
+    return OK;
+}
+
 status_t StagefrightRecorder::setParamVideoEncoderProfile(int32_t profile) {
     ALOGV("setParamVideoEncoderProfile: %d", profile);
 
@@ -529,6 +560,22 @@ status_t StagefrightRecorder::setParamMovieTimeScale(int32_t timeScale) {
     return OK;
 }
 
+status_t StagefrightRecorder::setParamVideoLowLatency(bool lowLatency) {
+    ALOGV("setParamVideoLowLatency: %s", lowLatency? "true": "false");
+    mSurfaceLowLatency = lowLatency;
+    return OK;
+}
+
+status_t StagefrightRecorder::setParamVideoMaxFrameRate(int32_t fps) {
+    ALOGV("setParamVideoMaxFrameRate: %d", fps);
+    if (fps < 0) {
+        ALOGE("Max frame rate (%d) must not be negative", fps);
+        return BAD_VALUE;
+    }
+    mSurfaceMaxFrameRate = fps;
+    return OK;
+}
+
 status_t StagefrightRecorder::setParamVideoTimeScale(int32_t timeScale) {
     ALOGV("setParamVideoTimeScale: %d", timeScale);
 
@@ -628,6 +675,16 @@ status_t StagefrightRecorder::setParameter(
         if (safe_strtoi32(value.string(), &use64BitOffset)) {
             return setParam64BitFileOffset(use64BitOffset != 0);
         }
+    } else if (key == "param-relocate-moov-box") {
+        int32_t relocate;
+        if (safe_strtoi32(value.string(), &relocate)) {
+            return setParamRelocateMoovBox(relocate != 0);
+        }
+    } else if (key == "param-stream-output-format") {
+        int32_t format;
+        if (safe_strtoi32(value.string(), &format)) {
+            return setParamStreamOutputFormat(format);
+        }
     } else if (key == "param-geotag-longitude") {
         int64_t longitudex10000;
         if (safe_strtoi64(value.string(), &longitudex10000)) {
@@ -643,6 +700,11 @@ status_t StagefrightRecorder::setParameter(
         if (safe_strtoi64(value.string(), &timeDurationUs)) {
             return setParamTrackTimeStatus(timeDurationUs);
         }
+    } else if (key == "param-fragment-duration-us") {
+        int64_t durationUs;
+        if (safe_strtoi64(value.string(), &durationUs)) {
+            return setParamFragmentDuration(durationUs);
+        }
     } else if (key == "audio-param-sampling-rate") {
         int32_t sampling_rate;
         if (safe_strtoi32(value.string(), &sampling_rate)) {
@@ -698,6 +760,16 @@ status_t StagefrightRecorder::setParameter(
         if (safe_strtoi32(value.string(), &timeScale)) {
             return setParamVideoTimeScale(timeScale);
         }
+    } else if (key == "video-param-low-latency") {
+        int32_t lowLatency;
+        if (safe_strtoi32(value.string(), &lowLatency)) {
+            return setParamVideoLowLatency(lowLatency != 0);
+        }
+    } else if (key == "video-param-max-frame-rate") {
+        int32_t fps;
+        if (safe_strtoi32(value.string(), &fps)) {
+            return setParamVideoMaxFrameRate(fps);
+        }
     } else if (key == "time-lapse-enable") {
         int32_t timeLapseEnable;
         if (safe_strtoi32(value.string(), &timeLapseEnable)) {
@@ -1416,6 +1488,13 @@ status_t StagefrightRecorder::setupSurfaceMediaSource() {
     }
     CHECK(mFrameRate != -1);
 
+    if (err == OK && mSurfaceLowLatency) {
+        err = mSurfaceMediaSource->setLowLatencyMode(true);
+    }
+    if (err == OK && mSurfaceMaxFrameRate > 0) {
+        err = mSurfaceMediaSource->setMaxFrameRate(mSurfaceMaxFrameRate);
+    }
+
     mIsMetaDataStoredInVideoBuffers =
         mSurfaceMediaSource->isMetaDataStoredInVideoBuffers();
     return err;
@@ -1667,10 +1746,47 @@ status_t StagefrightRecorder::setupAudioEncoder(const sp<MediaWriter>& writer) {
         return UNKNOWN_ERROR;
     }
 
-    writer->addSource(audioEncoder);
+    writer->addSource(setupStreamSource(audioEncoder));
     return OK;
 }
 
+sp<MediaSource> StagefrightRecorder::setupStreamSource(
+        const sp<MediaSource> &encoder) {
+    if (mStreamOutputFormat != OUTPUT_FORMAT_RTP_AVP
+            || mStreamWriter != NULL
+            || (mOutputFormat != OUTPUT_FORMAT_DEFAULT
+                && mOutputFormat != OUTPUT_FORMAT_THREE_GPP
+                && mOutputFormat != OUTPUT_FORMAT_MPEG_4)) {
+        return encoder;
+    }
+
+    // ARTPWriter carries a single AVC, H.263 or AMR stream. Video is set
+    // up first and wins if both can be streamed.
+    const char *mime;
+    CHECK(encoder->getFormat()->findCString(kKeyMIMEType, &mime));
+    if (strcasecmp(mime, MEDIA_MIMETYPE_VIDEO_AVC)
+            && strcasecmp(mime, MEDIA_MIMETYPE_VIDEO_H263)
+            && strcasecmp(mime, MEDIA_MIMETYPE_AUDIO_AMR_NB)
+            && strcasecmp(mime, MEDIA_MIMETYPE_AUDIO_AMR_WB)) {
+        return encoder;
+    }
+
+    // The file writer gets every buffer and holds the encoder back while
+    // it is busy. The stream drops data instead, so that a slow network
+    // never stalls the recording.
+    const size_t kFileQueueSize = 2;
+    const size_t kStreamQueueSize = 16;
+
+    sp<TeeSource> tee = new TeeSource(encoder);
+    sp<MediaSource> fileSource = tee->createOutput(kFileQueueSize, false);
+
+    mStreamWriter = new ARTPWriter(mOutputFd);
+    mStreamWriter->addSource(tee->createOutput(kStreamQueueSize, true));
+
+    ALOGI("Streaming %s over RTP while recording", mime);
+    return fileSource;
+}
+
 status_t StagefrightRecorder::setupMPEG4Recording(
         int outputFd,
         int32_t videoWidth, int32_t videoHeight,
@@ -1678,6 +1794,7 @@ status_t StagefrightRecorder::setupMPEG4Recording(
         int32_t *totalBitRate,
         sp<MediaWriter> *mediaWriter) {
     mediaWriter->clear();
+    mStreamWriter.clear();
     *totalBitRate = 0;
     status_t err = OK;
     sp<MediaWriter> writer = new MPEG4Writer(outputFd);
@@ -1696,7 +1813,7 @@ status_t StagefrightRecorder::setupMPEG4Recording(
             return err;
         }
 
-        writer->addSource(encoder);
+        writer->addSource(setupStreamSource(encoder));
         *totalBitRate += videoBitRate;
     }
 
@@ -1741,12 +1858,16 @@ void StagefrightRecorder::setupMPEG4MetaData(int64_t startTimeUs, int32_t totalB
     (*meta)->setInt32(kKeyFileType, mOutputFormat);
     (*meta)->setInt32(kKeyBitRate, totalBitRate);
     (*meta)->setInt32(kKey64BitFileOffset, mUse64BitFileOffset);
+    (*meta)->setInt32(kKeyRelocateMoovBox, mRelocateMoovBox);
     if (mMovieTimeScale > 0) {
         (*meta)->setInt32(kKeyTimeScale, mMovieTimeScale);
     }
     if (mTrackEveryTimeDurationUs > 0) {
         (*meta)->setInt64(kKeyTrackTimeStatus, mTrackEveryTimeDurationUs);
     }
+    if (mFragmentDurationUs > 0) {
+        (*meta)->setInt64(kKeyFragmentDurationUs, mFragmentDurationUs);
+    }
     if (mRotationDegrees != 0) {
         (*meta)->setInt32(kKeyRotation, mRotationDegrees);
     }
@@ -1770,6 +1891,16 @@ status_t StagefrightRecorder::startMPEG4Recording() {
         return err;
     }
 
+    // Started after the file writer, so that the encoder is started with
+    // the file writer's parameters.
+    if (mStreamWriter != NULL) {
+        err = mStreamWriter->start();
+        if (err != OK) {
+            ALOGE("Failed to start the RTP stream: %d", err);
+            return err;
+        }
+    }
+
     return OK;
 }
 
@@ -1812,6 +1943,11 @@ status_t StagefrightRecorder::stop() {
         mWriter.clear();
     }
 
+    if (mStreamWriter != NULL) {
+        mStreamWriter->stop();
+        mStreamWriter.clear();
+    }
+
     if (mOutputFd >= 0) {
         ::close(mOutputFd);
         mOutputFd = -1;
@@ -1880,6 +2016,7 @@ status_t StagefrightRecorder::reset() {
 #endif
     mAudioSourceNode = 0;
     mUse64BitFileOffset = false;
+    mRelocateMoovBox = false;
     mMovieTimeScale  = -1;
     mAudioTimeScale  = -1;
     mVideoTimeScale  = -1;
@@ -1890,6 +2027,10 @@ status_t StagefrightRecorder::reset() {
     mMaxFileDurationUs = 0;
     mMaxFileSizeBytes = 0;
     mTrackEveryTimeDurationUs = 0;
+    mFragmentDurationUs = 0;
+    mStreamOutputFormat = OUTPUT_FORMAT_LIST_END;
+    mSurfaceLowLatency = false;
+    mSurfaceMaxFrameRate = 0;
     mCaptureTimeLapse = false;
     mTimeBetweenTimeLapseFrameCaptureUs = -1;
     mCameraSourceTimeLapse = NULL;
@@ -1944,10 +2085,16 @@ status_t StagefrightRecorder::dump(
     result.append(buffer);
     snprintf(buffer, SIZE, "     File offset length (bits): %d\n", mUse64BitFileOffset? 64: 32);
     result.append(buffer);
+    snprintf(buffer, SIZE, "     Relocate movie box: %s\n", mRelocateMoovBox? "true": "false");
+    result.append(buffer);
     snprintf(buffer, SIZE, "     Interleave duration (us): %d\n", mInterleaveDurationUs);
     result.append(buffer);
     snprintf(buffer, SIZE, "     Progress notification: %lld us\n", mTrackEveryTimeDurationUs);
     result.append(buffer);
+    snprintf(buffer, SIZE, "     Fragment duration (us): %lld\n", mFragmentDurationUs);
+    result.append(buffer);
+    snprintf(buffer, SIZE, "     Stream output format: %d\n", mStreamOutputFormat);
+    result.append(buffer);
     snprintf(buffer, SIZE, "   Audio\n");
     result.append(buffer);
     snprintf(buffer, SIZE, "     Source: %d\n", mAudioSource);
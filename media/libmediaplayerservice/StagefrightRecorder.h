@@ -75,6 +75,10 @@ private:
     sp<IMediaRecorderClient> mListener;
     sp<MediaWriter> mWriter;
     int mOutputFd;
+
+    // Optional RTP stream fed from the same encoder as an MPEG4 recording.
+    output_format mStreamOutputFormat;
+    sp<MediaWriter> mStreamWriter;
     sp<AudioSource> mAudioSourceNode;
 
     audio_source_t mAudioSource;
@@ -83,6 +87,7 @@ private:
     audio_encoder mAudioEncoder;
     video_encoder mVideoEncoder;
     bool mUse64BitFileOffset;
+    bool mRelocateMoovBox;
     int32_t mVideoWidth, mVideoHeight;
     int32_t mFrameRate;
     int32_t mVideoBitRate;
@@ -100,11 +105,16 @@ private:
     int64_t mMaxFileSizeBytes;
     int64_t mMaxFileDurationUs;
     int64_t mTrackEveryTimeDurationUs;
+    int64_t mFragmentDurationUs;  // 0 unless writing a fragmented file
     int32_t mRotationDegrees;  // Clockwise
     int32_t mLatitudex10000;
     int32_t mLongitudex10000;
     int32_t mStartTimeOffsetMs;
 
+    // Surface sources only, see SurfaceMediaSource.
+    bool mSurfaceLowLatency;
+    int32_t mSurfaceMaxFrameRate;
+
     bool mCaptureTimeLapse;
     int64_t mTimeBetweenTimeLapseFrameCaptureUs;
     sp<CameraSourceTimeLapse> mCameraSourceTimeLapse;
@@ -151,6 +161,7 @@ private:
     status_t setupSurfaceMediaSource();
 
     status_t setupAudioEncoder(const sp<MediaWriter>& writer);
+    sp<MediaSource> setupStreamSource(const sp<MediaSource> &encoder);
     status_t setupVideoEncoder(
             sp<MediaSource> cameraSource,
             int32_t videoBitRate,
@@ -170,10 +181,15 @@ private:
     status_t setParamVideoEncoderLevel(int32_t level);
     status_t setParamVideoCameraId(int32_t cameraId);
     status_t setParamVideoTimeScale(int32_t timeScale);
+    status_t setParamVideoLowLatency(bool lowLatency);
+    status_t setParamVideoMaxFrameRate(int32_t fps);
     status_t setParamVideoRotation(int32_t degrees);
     status_t setParamTrackTimeStatus(int64_t timeDurationUs);
+    status_t setParamFragmentDuration(int64_t durationUs);
     status_t setParamInterleaveDuration(int32_t durationUs);
     status_t setParam64BitFileOffset(bool use64BitFileOffset);
+    status_t setParamRelocateMoovBox(bool relocate);
+    status_t setParamStreamOutputFormat(int32_t format);
     status_t setParamMaxFileDurationUs(int64_t timeUs);
     status_t setParamMaxFileSizeBytes(int64_t bytes);
     status_t setParamMovieTimeScale(int32_t timeScale);
@@ -18,8 +18,10 @@
 
 #include "AnotherPacketSource.h"
 
+#include <cutils/properties.h>
 #include <media/stagefright/foundation/ABuffer.h>
 #include <media/stagefright/foundation/ADebug.h>
+#include <media/stagefright/foundation/ALooper.h>
 #include <media/stagefright/foundation/AMessage.h>
 #include <media/stagefright/DataSource.h>
 #include <media/stagefright/FileSource.h>
@@ -31,13 +33,26 @@
 
 namespace android {
 
+// static
+const int64_t NuPlayer::GenericSource::kDefaultReadAheadUs = 2000000ll;
+
+// static
+const int64_t NuPlayer::GenericSource::kFetchIntervalUs = 50000ll;
+
+// static
+const size_t NuPlayer::GenericSource::kMaxReadsPerFetch = 16;
+
 NuPlayer::GenericSource::GenericSource(
         const char *url,
         const KeyedVector<String8, String8> *headers,
         bool uidValid,
         uid_t uid)
     : mDurationUs(0ll),
-      mAudioIsVorbis(false) {
+      mAudioIsVorbis(false),
+      mReadAheadUs(kDefaultReadAheadUs),
+      mPendingSeekMode(SEEK_MODE_DEFAULT),
+      mSeekMode(SEEK_MODE_DEFAULT),
+      mLastVideoTimeUs(-1ll) {
     DataSource::RegisterDefaultSniffers();
 
     sp<DataSource> dataSource =
@@ -50,7 +65,11 @@ NuPlayer::GenericSource::GenericSource(
 NuPlayer::GenericSource::GenericSource(
         int fd, int64_t offset, int64_t length)
     : mDurationUs(0ll),
-      mAudioIsVorbis(false) {
+      mAudioIsVorbis(false),
+      mReadAheadUs(kDefaultReadAheadUs),
+      mPendingSeekMode(SEEK_MODE_DEFAULT),
+      mSeekMode(SEEK_MODE_DEFAULT),
+      mLastVideoTimeUs(-1ll) {
     DataSource::RegisterDefaultSniffers();
 
     sp<DataSource> dataSource = new FileSource(dup(fd), offset, length);
@@ -100,6 +119,10 @@ void NuPlayer::GenericSource::initFromDataSource(
 }
 
 NuPlayer::GenericSource::~GenericSource() {
+    if (mLooper != NULL) {
+        mLooper->unregisterHandler(mReflector->id());
+        mLooper->stop();
+    }
 }
 
 void NuPlayer::GenericSource::start() {
@@ -110,8 +133,6 @@ void NuPlayer::GenericSource::start() {
 
         mAudioTrack.mPackets =
             new AnotherPacketSource(mAudioTrack.mSource->getFormat());
-
-        readBuffer(true /* audio */);
     }
 
     if (mVideoTrack.mSource != NULL) {
@@ -119,11 +140,91 @@ void NuPlayer::GenericSource::start() {
 
         mVideoTrack.mPackets =
             new AnotherPacketSource(mVideoTrack.mSource->getFormat());
+    }
+
+    char value[PROPERTY_VALUE_MAX];
+    if (property_get("media.nuplayer.readahead-ms", value, NULL)) {
+        int64_t readAheadMs = atoll(value);
+        if (readAheadMs > 0) {
+            mReadAheadUs = readAheadMs * 1000ll;
+        }
+    }
+
+    mReflector = new AHandlerReflector<GenericSource>(this);
+
+    mLooper = new ALooper;
+    mLooper->setName("GenericSource");
+    mLooper->registerHandler(mReflector);
+    mLooper->start();
+
+    (new AMessage(kWhatFetch, mReflector->id()))->post();
+}
+
+void NuPlayer::GenericSource::onMessageReceived(const sp<AMessage> &msg) {
+    switch (msg->what()) {
+        case kWhatFetch:
+        {
+            // Come back right away while a queue is still below its target,
+            // poll for consumed data otherwise.
+            msg->post(onFetch() ? 0 : kFetchIntervalUs);
+            break;
+        }
+
+        case kWhatSeek:
+        {
+            uint32_t replyID;
+            CHECK(msg->senderAwaitsResponse(&replyID));
+
+            int64_t seekTimeUs;
+            CHECK(msg->findInt64("seekTimeUs", &seekTimeUs));
+
+            int32_t seekMode;
+            CHECK(msg->findInt32("seekMode", &seekMode));
+            mSeekMode = (SeekMode)seekMode;
+
+            onSeek(seekTimeUs);
+
+            (new AMessage)->postReply(replyID);
+            break;
+        }
 
-        readBuffer(false /* audio */);
+        default:
+            TRESPASS();
+            break;
     }
 }
 
+bool NuPlayer::GenericSource::onFetch() {
+    bool needMore = false;
+
+    for (int i = 0; i < 2; ++i) {
+        bool audio = (i == 0);
+        Track *track = audio ? &mAudioTrack : &mVideoTrack;
+
+        if (track->mSource == NULL) {
+            continue;
+        }
+
+        for (size_t n = 0; n < kMaxReadsPerFetch; ++n) {
+            status_t finalResult;
+            int64_t bufferedUs =
+                track->mPackets->getBufferedDurationUs(&finalResult);
+
+            if (finalResult != OK || bufferedUs >= mReadAheadUs) {
+                break;
+            }
+
+            readBuffer(audio);
+
+            if (n + 1 == kMaxReadsPerFetch) {
+                needMore = true;
+            }
+        }
+    }
+
+    return needMore;
+}
+
 status_t NuPlayer::GenericSource::feedMoreTSData() {
     return OK;
 }
@@ -151,11 +252,7 @@ status_t NuPlayer::GenericSource::dequeueAccessUnit(
         return finalResult == OK ? -EWOULDBLOCK : finalResult;
     }
 
-    status_t result = track->mPackets->dequeueAccessUnit(accessUnit);
-
-    readBuffer(audio, -1ll);
-
-    return result;
+    return track->mPackets->dequeueAccessUnit(accessUnit);
 }
 
 status_t NuPlayer::GenericSource::getDuration(int64_t *durationUs) {
@@ -164,22 +261,70 @@ status_t NuPlayer::GenericSource::getDuration(int64_t *durationUs) {
 }
 
 status_t NuPlayer::GenericSource::seekTo(int64_t seekTimeUs) {
+    sp<AMessage> msg = new AMessage(kWhatSeek, mReflector->id());
+    msg->setInt64("seekTimeUs", seekTimeUs);
+    msg->setInt32("seekMode", mPendingSeekMode);
+
+    // Wait for the seek so that NuPlayer doesn't dequeue data from before
+    // it, reads already in flight are finished first.
+    sp<AMessage> response;
+    return msg->postAndAwaitResponse(&response);
+}
+
+void NuPlayer::GenericSource::onSeek(int64_t seekTimeUs) {
+    // A precise seek decodes from the preceding sync frame and has the
+    // frames before the seek time dropped after decoding, the other modes
+    // start both tracks at the sync frame.
+    int64_t resumeAtTimeUs =
+        (mSeekMode == SEEK_MODE_PRECISE) ? seekTimeUs : -1ll;
+
+    sp<AMessage> extra;
+    if (resumeAtTimeUs >= 0) {
+        extra = new AMessage;
+        extra->setInt64("resume-at-mediatimeUs", resumeAtTimeUs);
+    }
+
+    // A seek into the data read ahead is served from the packet queue
+    // starting at the last sync frame before the seek time. Scrubbing
+    // always goes to the extractor since the queue may hold frames that
+    // aren't sync frames.
+    bool fromQueue = (mSeekMode != SEEK_MODE_SCRUB);
+
     if (mVideoTrack.mSource != NULL) {
         int64_t actualTimeUs;
-        readBuffer(false /* audio */, seekTimeUs, &actualTimeUs);
+        if (fromQueue && mVideoTrack.mPackets->seekWithinQueue(
+                    seekTimeUs, ATSParser::DISCONTINUITY_SEEK, extra,
+                    &actualTimeUs)) {
+            ALOGV("video seek to %lld us served from queue", seekTimeUs);
+        } else {
+            fromQueue = false;
+            readBuffer(false /* audio */, seekTimeUs, &actualTimeUs,
+                       resumeAtTimeUs);
+        }
 
-        seekTimeUs = actualTimeUs;
+        if (resumeAtTimeUs < 0) {
+            seekTimeUs = actualTimeUs;
+        }
     }
 
     if (mAudioTrack.mSource != NULL) {
-        readBuffer(true /* audio */, seekTimeUs);
+        int64_t actualTimeUs;
+        if (!(fromQueue && mAudioTrack.mPackets->seekWithinQueue(
+                    seekTimeUs, ATSParser::DISCONTINUITY_SEEK, extra,
+                    &actualTimeUs))) {
+            readBuffer(true /* audio */, seekTimeUs, NULL, resumeAtTimeUs);
+        }
     }
+}
 
+status_t NuPlayer::GenericSource::setSeekMode(SeekMode seekMode) {
+    mPendingSeekMode = seekMode;
     return OK;
 }
 
 void NuPlayer::GenericSource::readBuffer(
-        bool audio, int64_t seekTimeUs, int64_t *actualTimeUs) {
+        bool audio, int64_t seekTimeUs, int64_t *actualTimeUs,
+        int64_t resumeAtTimeUs) {
     Track *track = audio ? &mAudioTrack : &mVideoTrack;
     CHECK(track->mSource != NULL);
 
@@ -190,10 +335,19 @@ void NuPlayer::GenericSource::readBuffer(
     MediaSource::ReadOptions options;
 
     bool seeking = false;
+    bool scrubbing = !audio && mSeekMode == SEEK_MODE_SCRUB;
 
     if (seekTimeUs >= 0) {
-        options.setSeekTo(seekTimeUs);
+        options.setSeekTo(
+                seekTimeUs,
+                mSeekMode == SEEK_MODE_PRECISE
+                    ? MediaSource::ReadOptions::SEEK_PREVIOUS_SYNC
+                    : MediaSource::ReadOptions::SEEK_CLOSEST_SYNC);
         seeking = true;
+    } else if (scrubbing && mLastVideoTimeUs >= 0) {
+        options.setSeekTo(
+                mLastVideoTimeUs + 1,
+                MediaSource::ReadOptions::SEEK_NEXT_SYNC);
     }
 
     for (;;) {
@@ -232,6 +386,12 @@ void NuPlayer::GenericSource::readBuffer(
 
             buffer->meta()->setInt64("timeUs", timeUs);
 
+            int32_t isSync;
+            if (audio || (mbuf->meta_data()->findInt32(kKeyIsSyncFrame, &isSync)
+                        && isSync)) {
+                buffer->meta()->setInt32("isSync", true);
+            }
+
             if (actualTimeUs) {
                 *actualTimeUs = timeUs;
             }
@@ -239,9 +399,25 @@ void NuPlayer::GenericSource::readBuffer(
             mbuf->release();
             mbuf = NULL;
 
+            if (!audio) {
+                if (scrubbing && !seeking && timeUs <= mLastVideoTimeUs) {
+                    // No sync frame left after the last one.
+                    track->mPackets->signalEOS(ERROR_END_OF_STREAM);
+                    break;
+                }
+
+                mLastVideoTimeUs = timeUs;
+            }
+
             if (seeking) {
+                sp<AMessage> extra;
+                if (resumeAtTimeUs >= 0) {
+                    extra = new AMessage;
+                    extra->setInt64("resume-at-mediatimeUs", resumeAtTimeUs);
+                }
+
                 track->mPackets->queueDiscontinuity(
-                        ATSParser::DISCONTINUITY_SEEK, NULL);
+                        ATSParser::DISCONTINUITY_SEEK, extra);
             }
 
             track->mPackets->queueAccessUnit(buffer);
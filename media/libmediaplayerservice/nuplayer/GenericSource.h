@@ -23,8 +23,11 @@
 
 #include "ATSParser.h"
 
+#include <media/stagefright/foundation/AHandlerReflector.h>
+
 namespace android {
 
+struct ALooper;
 struct AnotherPacketSource;
 struct ARTSPController;
 struct DataSource;
@@ -49,11 +52,23 @@ struct NuPlayer::GenericSource : public NuPlayer::Source {
     virtual status_t getDuration(int64_t *durationUs);
     virtual status_t seekTo(int64_t seekTimeUs);
     virtual bool isSeekable();
+    virtual status_t setSeekMode(SeekMode seekMode);
 
 protected:
     virtual ~GenericSource();
 
 private:
+    friend struct AHandlerReflector<GenericSource>;
+
+    enum {
+        kWhatFetch = 'fetc',
+        kWhatSeek  = 'seek',
+    };
+
+    static const int64_t kDefaultReadAheadUs;
+    static const int64_t kFetchIntervalUs;
+    static const size_t kMaxReadsPerFetch;
+
     struct Track {
         sp<MediaSource> mSource;
         sp<AnotherPacketSource> mPackets;
@@ -65,11 +80,32 @@ private:
     int64_t mDurationUs;
     bool mAudioIsVorbis;
 
+    // Reads from the extractor happen on this looper, which keeps both
+    // packet queues filled up to mReadAheadUs.
+    sp<ALooper> mLooper;
+    sp<AHandlerReflector<GenericSource> > mReflector;
+    int64_t mReadAheadUs;
+
+    // Mode requested by NuPlayer, passed on with the next seek.
+    SeekMode mPendingSeekMode;
+
+    // The following are only accessed on mLooper.
+    SeekMode mSeekMode;
+
+    // While scrubbing, the time of the last video frame read, the next read
+    // skips ahead to the sync frame following it.
+    int64_t mLastVideoTimeUs;
+
     void initFromDataSource(const sp<DataSource> &dataSource);
 
+    void onMessageReceived(const sp<AMessage> &msg);
+    bool onFetch();
+    void onSeek(int64_t seekTimeUs);
+
     void readBuffer(
             bool audio,
-            int64_t seekTimeUs = -1ll, int64_t *actualTimeUs = NULL);
+            int64_t seekTimeUs = -1ll, int64_t *actualTimeUs = NULL,
+            int64_t resumeAtTimeUs = -1ll);
 
     DISALLOW_EVIL_CONSTRUCTORS(GenericSource);
 };
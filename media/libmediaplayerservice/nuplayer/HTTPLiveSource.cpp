@@ -105,6 +105,11 @@ status_t NuPlayer::HTTPLiveSource::feedMoreTSData() {
         return mFinalResult;
     }
 
+    if (mTSParser->isFull()) {
+        // Let the decoders catch up before queueing any more.
+        return OK;
+    }
+
     sp<LiveDataSource> source =
         static_cast<LiveDataSource *>(mLiveSession->getDataSource().get());
 
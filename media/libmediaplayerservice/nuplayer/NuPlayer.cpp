@@ -63,7 +63,13 @@ NuPlayer::NuPlayer()
       mSkipRenderingVideoUntilMediaTimeUs(-1ll),
       mVideoLateByUs(0ll),
       mNumFramesTotal(0ll),
-      mNumFramesDropped(0ll)
+      mNumFramesDropped(0ll),
+      mVideoDecodeTimeUs(0ll),
+      mNumVideoFramesTimed(0ll),
+      mMaxVideoLateByUs(0ll),
+      mNumRebuffers(0ll),
+      mRebufferTimeUs(0ll),
+      mRebufferStartUs(-1ll)
 #ifdef QCOM_HARDWARE
       ,mPauseIndication(false),
       mSourceType(kDefaultSource) 
@@ -188,9 +194,10 @@ void NuPlayer::resetAsync() {
     (new AMessage(kWhatReset, id()))->post();
 }
 
-void NuPlayer::seekToAsync(int64_t seekTimeUs) {
+void NuPlayer::seekToAsync(int64_t seekTimeUs, SeekMode seekMode) {
     sp<AMessage> msg = new AMessage(kWhatSeek, id());
     msg->setInt64("seekTimeUs", seekTimeUs);
+    msg->setInt32("seekMode", seekMode);
     msg->post();
 }
 
@@ -266,6 +273,13 @@ void NuPlayer::onMessageReceived(const sp<AMessage> &msg) {
             mVideoLateByUs = 0;
             mNumFramesTotal = 0;
             mNumFramesDropped = 0;
+            mVideoFeedTimesUs.clear();
+            mVideoDecodeTimeUs = 0;
+            mNumVideoFramesTimed = 0;
+            mMaxVideoLateByUs = 0;
+            mNumRebuffers = 0;
+            mRebufferTimeUs = 0;
+            mRebufferStartUs = -1;
 
             mSource->start();
 
@@ -381,6 +395,7 @@ void NuPlayer::onMessageReceived(const sp<AMessage> &msg) {
                     mFlushingVideo = FLUSHED;
 
                     mVideoLateByUs = 0;
+                    mVideoFeedTimesUs.clear();
                 }
 
                 ALOGV("decoder %s flush completed", audio ? "audio" : "video");
@@ -535,6 +550,10 @@ void NuPlayer::onMessageReceived(const sp<AMessage> &msg) {
 
                 CHECK(msg->findInt64("videoLateByUs", &mVideoLateByUs));
 
+                if (mVideoLateByUs > mMaxVideoLateByUs) {
+                    mMaxVideoLateByUs = mVideoLateByUs;
+                }
+
                 if (mDriver != NULL) {
                     sp<NuPlayerDriver> driver = mDriver.promote();
                     if (driver != NULL) {
@@ -546,6 +565,32 @@ void NuPlayer::onMessageReceived(const sp<AMessage> &msg) {
 
                         driver->notifyFrameStats(
                                 mNumFramesTotal, mNumFramesDropped);
+
+                        int64_t numFramesOnTime, numFramesLate;
+                        int64_t numFramesDroppedByRenderer;
+                        CHECK(msg->findInt64(
+                                    "numFramesOnTime", &numFramesOnTime));
+                        CHECK(msg->findInt64("numFramesLate", &numFramesLate));
+                        CHECK(msg->findInt64(
+                                    "numFramesDropped",
+                                    &numFramesDroppedByRenderer));
+
+                        driver->notifyRenderStats(
+                                numFramesOnTime, numFramesLate,
+                                numFramesDroppedByRenderer);
+
+                        int64_t rebufferTimeUs = mRebufferTimeUs;
+                        if (mRebufferStartUs >= 0) {
+                            rebufferTimeUs +=
+                                ALooper::GetNowUs() - mRebufferStartUs;
+                        }
+
+                        driver->notifyPlaybackStats(
+                                mNumVideoFramesTimed > 0
+                                    ? mVideoDecodeTimeUs / mNumVideoFramesTimed
+                                    : -1,
+                                mVideoLateByUs, mMaxVideoLateByUs,
+                                mNumRebuffers, rebufferTimeUs);
                     }
                 }
             } else if (what == Renderer::kWhatFlushComplete) {
@@ -625,9 +670,13 @@ void NuPlayer::onMessageReceived(const sp<AMessage> &msg) {
             status_t nRet = OK;
             CHECK(msg->findInt64("seekTimeUs", &seekTimeUs));
 
-            ALOGW("kWhatSeek seekTimeUs=%lld us (%.2f secs)",
-                 seekTimeUs, seekTimeUs / 1E6);
+            int32_t seekMode;
+            CHECK(msg->findInt32("seekMode", &seekMode));
+
+            ALOGW("kWhatSeek seekTimeUs=%lld us (%.2f secs), mode %d",
+                 seekTimeUs, seekTimeUs / 1E6, seekMode);
 
+            mSource->setSeekMode((SeekMode)seekMode);
             nRet = mSource->seekTo(seekTimeUs);
 #ifdef QCOM_HARDWARE
             if (mSourceType == kHttpLiveSource) {
@@ -917,6 +966,11 @@ status_t NuPlayer::feedDecoderInputData(bool audio, const sp<AMessage> &msg) {
         status_t err = mSource->dequeueAccessUnit(audio, &accessUnit);
 
         if (err == -EWOULDBLOCK) {
+            // The decoder is starving, count it once until data flows again.
+            if (mRebufferStartUs < 0) {
+                ++mNumRebuffers;
+                mRebufferStartUs = ALooper::GetNowUs();
+            }
             return err;
         } else if (err != OK) {
             if (err == INFO_DISCONTINUITY) {
@@ -1002,6 +1056,22 @@ status_t NuPlayer::feedDecoderInputData(bool audio, const sp<AMessage> &msg) {
 
     // ALOGV("returned a valid buffer of %s data", audio ? "audio" : "video");
 
+    int64_t nowUs = ALooper::GetNowUs();
+
+    if (mRebufferStartUs >= 0) {
+        mRebufferTimeUs += nowUs - mRebufferStartUs;
+        mRebufferStartUs = -1;
+    }
+
+    int64_t feedTimeUs;
+    if (!audio && accessUnit->meta()->findInt64("timeUs", &feedTimeUs)) {
+        if (mVideoFeedTimesUs.size() >= kMaxVideoFeedTimes) {
+            // Access units the decoder never returned, forget the oldest.
+            mVideoFeedTimesUs.removeItemsAt(0);
+        }
+        mVideoFeedTimesUs.add(feedTimeUs, nowUs);
+    }
+
 #if 0
     int64_t mediaTimeUs;
     CHECK(accessUnit->meta()->findInt64("timeUs", &mediaTimeUs));
@@ -1039,6 +1109,17 @@ void NuPlayer::renderBuffer(bool audio, const sp<AMessage> &msg) {
     sp<ABuffer> buffer;
     CHECK(msg->findBuffer("buffer", &buffer));
 
+    int64_t outputTimeUs;
+    if (!audio && buffer->meta()->findInt64("timeUs", &outputTimeUs)) {
+        ssize_t index = mVideoFeedTimesUs.indexOfKey(outputTimeUs);
+        if (index >= 0) {
+            mVideoDecodeTimeUs +=
+                ALooper::GetNowUs() - mVideoFeedTimesUs.valueAt(index);
+            ++mNumVideoFramesTimed;
+            mVideoFeedTimesUs.removeItemsAt(index);
+        }
+    }
+
     int64_t &skipUntilMediaTimeUs =
         audio
             ? mSkipRenderingAudioUntilMediaTimeUs
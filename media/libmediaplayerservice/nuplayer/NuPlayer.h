@@ -52,8 +52,20 @@ struct NuPlayer : public AHandler {
     // Will notify the driver through "notifyResetComplete" once finished.
     void resetAsync();
 
+    enum SeekMode {
+        // Start at the sync frame closest to the seek time.
+        SEEK_MODE_DEFAULT,
+        // Start at the closest sync frame and decode only sync frames until
+        // the next seek, for scrubbing.
+        SEEK_MODE_SCRUB,
+        // Decode from the preceding sync frame without rendering until the
+        // seek time is reached.
+        SEEK_MODE_PRECISE,
+    };
+
     // Will notify the driver through "notifySeekComplete" once finished.
-    void seekToAsync(int64_t seekTimeUs);
+    void seekToAsync(
+            int64_t seekTimeUs, SeekMode seekMode = SEEK_MODE_DEFAULT);
 
 #ifdef QCOM_HARDWARE
     status_t prepareAsync();
@@ -140,6 +152,21 @@ private:
     int64_t mVideoLateByUs;
     int64_t mNumFramesTotal, mNumFramesDropped;
 
+    // Playback telemetry reported through KEY_PARAMETER_PLAYBACK_STATS.
+    // mVideoFeedTimesUs maps the media time of the video access units that
+    // are inside the decoder to the time they were queued, so that the
+    // decode time of each output buffer can be measured.
+    enum {
+        kMaxVideoFeedTimes = 64,
+    };
+    KeyedVector<int64_t, int64_t> mVideoFeedTimesUs;
+    int64_t mVideoDecodeTimeUs;
+    int64_t mNumVideoFramesTimed;
+    int64_t mMaxVideoLateByUs;
+    int64_t mNumRebuffers;
+    int64_t mRebufferTimeUs;
+    int64_t mRebufferStartUs;
+
 #ifdef QCOM_HARDWARE
     bool mPauseIndication;
 #endif
@@ -33,10 +33,19 @@ NuPlayerDriver::NuPlayerDriver()
       mPositionUs(-1),
       mNumFramesTotal(0),
       mNumFramesDropped(0),
+      mNumFramesRenderedOnTime(0),
+      mNumFramesRenderedLate(0),
+      mNumFramesDroppedByRenderer(0),
+      mVideoDecodeTimeUs(-1),
+      mVideoLateByUs(0),
+      mMaxVideoLateByUs(0),
+      mNumRebuffers(0),
+      mRebufferTimeUs(0),
       mLooper(new ALooper),
       mState(UNINITIALIZED),
       mAtEOS(false),
-      mStartupSeekTimeUs(-1) {
+      mStartupSeekTimeUs(-1),
+      mSeekMode(NuPlayer::SEEK_MODE_DEFAULT) {
     mLooper->setName("NuPlayerDriver Looper");
 
     mLooper->start(
@@ -143,7 +152,8 @@ status_t NuPlayerDriver::start() {
                 if (mStartupSeekTimeUs == 0) {
                     notifySeekComplete();
                 } else {
-                    mPlayer->seekToAsync(mStartupSeekTimeUs);
+                    mPlayer->seekToAsync(
+                            mStartupSeekTimeUs, (NuPlayer::SeekMode)mSeekMode);
                 }
 
                 mStartupSeekTimeUs = -1;
@@ -211,7 +221,7 @@ status_t NuPlayerDriver::seekTo(int msec) {
         case PAUSED:
         {
             mAtEOS = false;
-            mPlayer->seekToAsync(seekTimeUs);
+            mPlayer->seekToAsync(seekTimeUs, (NuPlayer::SeekMode)mSeekMode);
             break;
         }
 
@@ -282,6 +292,17 @@ void NuPlayerDriver::setAudioSink(const sp<AudioSink> &audioSink) {
 }
 
 status_t NuPlayerDriver::setParameter(int key, const Parcel &request) {
+    if (key == KEY_PARAMETER_SEEK_MODE) {
+        int32_t seekMode = request.readInt32();
+        if (seekMode < NuPlayer::SEEK_MODE_DEFAULT
+                || seekMode > NuPlayer::SEEK_MODE_PRECISE) {
+            return BAD_VALUE;
+        }
+
+        mSeekMode = seekMode;
+        return OK;
+    }
+
     status_t err = INVALID_OPERATION;
 #ifdef QCOM_HARDWARE
     err = UNKNOWN_ERROR;
@@ -294,6 +315,30 @@ status_t NuPlayerDriver::setParameter(int key, const Parcel &request) {
 }
 
 status_t NuPlayerDriver::getParameter(int key, Parcel *reply) {
+    if (key == KEY_PARAMETER_VIDEO_FRAME_STATS) {
+        Mutex::Autolock autoLock(mLock);
+        reply->writeInt64(mNumFramesTotal);
+        reply->writeInt64(mNumFramesDropped);
+        reply->writeInt64(mNumFramesRenderedOnTime);
+        reply->writeInt64(mNumFramesRenderedLate);
+        reply->writeInt64(mNumFramesDroppedByRenderer);
+        return OK;
+    } else if (key == KEY_PARAMETER_PLAYBACK_STATS) {
+        // Access units dropped ahead of the decoder never get decoded, and
+        // NuPlayer has no cache in front of its sources.
+        Mutex::Autolock autoLock(mLock);
+        reply->writeInt64(mNumFramesTotal - mNumFramesDropped);
+        reply->writeInt64(mNumFramesDropped + mNumFramesDroppedByRenderer);
+        reply->writeInt64(mVideoDecodeTimeUs);
+        reply->writeInt64(mVideoLateByUs);
+        reply->writeInt64(mMaxVideoLateByUs);
+        reply->writeInt64(mNumRebuffers);
+        reply->writeInt64(mRebufferTimeUs);
+        reply->writeInt64(-1);
+        reply->writeInt64(-1);
+        return OK;
+    }
+
     status_t err = INVALID_OPERATION;
 #ifdef QCOM_HARDWARE
     err = UNKNOWN_ERROR;
@@ -338,6 +383,27 @@ void NuPlayerDriver::notifyFrameStats(
     mNumFramesDropped = numFramesDropped;
 }
 
+void NuPlayerDriver::notifyRenderStats(
+        int64_t numFramesOnTime, int64_t numFramesLate,
+        int64_t numFramesDropped) {
+    Mutex::Autolock autoLock(mLock);
+    mNumFramesRenderedOnTime = numFramesOnTime;
+    mNumFramesRenderedLate = numFramesLate;
+    mNumFramesDroppedByRenderer = numFramesDropped;
+}
+
+void NuPlayerDriver::notifyPlaybackStats(
+        int64_t videoDecodeTimeUs, int64_t videoLateByUs,
+        int64_t maxVideoLateByUs, int64_t numRebuffers,
+        int64_t rebufferTimeUs) {
+    Mutex::Autolock autoLock(mLock);
+    mVideoDecodeTimeUs = videoDecodeTimeUs;
+    mVideoLateByUs = videoLateByUs;
+    mMaxVideoLateByUs = maxVideoLateByUs;
+    mNumRebuffers = numRebuffers;
+    mRebufferTimeUs = rebufferTimeUs;
+}
+
 status_t NuPlayerDriver::dump(int fd, const Vector<String16> &args) const {
     Mutex::Autolock autoLock(mLock);
 
@@ -350,6 +416,19 @@ status_t NuPlayerDriver::dump(int fd, const Vector<String16> &args) const {
                  mNumFramesDropped,
                  mNumFramesTotal == 0
                     ? 0.0 : (double)mNumFramesDropped / mNumFramesTotal);
+    fprintf(out, "  numFramesRenderedOnTime(%lld), numFramesRenderedLate(%lld), "
+                 "numFramesDroppedByRenderer(%lld)\n",
+                 mNumFramesRenderedOnTime,
+                 mNumFramesRenderedLate,
+                 mNumFramesDroppedByRenderer);
+    fprintf(out, "  videoDecodeTimeUs(%lld), videoLateByUs(%lld), "
+                 "maxVideoLateByUs(%lld), numRebuffers(%lld), "
+                 "rebufferTimeUs(%lld)\n",
+                 mVideoDecodeTimeUs,
+                 mVideoLateByUs,
+                 mMaxVideoLateByUs,
+                 mNumRebuffers,
+                 mRebufferTimeUs);
 
     fclose(out);
     out = NULL;
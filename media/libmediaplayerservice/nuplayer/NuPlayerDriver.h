@@ -66,6 +66,13 @@ struct NuPlayerDriver : public MediaPlayerInterface {
     void notifyPosition(int64_t positionUs);
     void notifySeekComplete();
     void notifyFrameStats(int64_t numFramesTotal, int64_t numFramesDropped);
+    void notifyRenderStats(
+            int64_t numFramesOnTime, int64_t numFramesLate,
+            int64_t numFramesDropped);
+    void notifyPlaybackStats(
+            int64_t videoDecodeTimeUs, int64_t videoLateByUs,
+            int64_t maxVideoLateByUs, int64_t numRebuffers,
+            int64_t rebufferTimeUs);
     void notifyListener(int msg, int ext1 = 0, int ext2 = 0);
 
 protected:
@@ -82,6 +89,14 @@ private:
     int64_t mPositionUs;
     int64_t mNumFramesTotal;
     int64_t mNumFramesDropped;
+    int64_t mNumFramesRenderedOnTime;
+    int64_t mNumFramesRenderedLate;
+    int64_t mNumFramesDroppedByRenderer;
+    int64_t mVideoDecodeTimeUs;
+    int64_t mVideoLateByUs;
+    int64_t mMaxVideoLateByUs;
+    int64_t mNumRebuffers;
+    int64_t mRebufferTimeUs;
     // <<<
 
     sp<ALooper> mLooper;
@@ -98,6 +113,7 @@ private:
     bool mAtEOS;
 
     int64_t mStartupSeekTimeUs;
+    int32_t mSeekMode;  // NuPlayer::SeekMode
 
     DISALLOW_EVIL_CONSTRUCTORS(NuPlayerDriver);
 };
@@ -20,15 +20,29 @@
 
 #include "NuPlayerRenderer.h"
 
+#include <unistd.h>
+
+#include <cutils/properties.h>
 #include <media/stagefright/foundation/ABuffer.h>
 #include <media/stagefright/foundation/ADebug.h>
 #include <media/stagefright/foundation/AMessage.h>
 
+#include "SchedulingPolicyService.h"
+
 namespace android {
 
 // static
 const int64_t NuPlayer::Renderer::kMinPositionUpdateDelayUs = 100000ll;
 
+// static
+const int64_t NuPlayer::Renderer::kDefaultVsyncPeriodUs = 16667ll;
+
+// static
+const int64_t NuPlayer::Renderer::kMaxVideoLateUs = 40000ll;
+
+// Share of a CPU the looper thread may use at SCHED_FIFO before it is demoted.
+static const int32_t kRealtimeBudgetPercent = 25;
+
 NuPlayer::Renderer::Renderer(
         const sp<MediaPlayerBase::AudioSink> &sink,
         const sp<AMessage> &notify)
@@ -51,10 +65,43 @@ NuPlayer::Renderer::Renderer(
       mWasPaused(false),
 #endif
       mLastPositionUpdateUs(-1ll),
-      mVideoLateByUs(0ll) {
+      mVideoLateByUs(0ll),
+      mVsyncPeriodUs(kDefaultVsyncPeriodUs),
+      mVsyncAnchorUs(-1ll),
+      mVideoDrainTargetUs(-1ll),
+      mVideoDrainLatencyUs(0ll),
+      mNumFramesOnTime(0ll),
+      mNumFramesLate(0ll),
+      mNumFramesDropped(0ll),
+      mRealtimeTid(0) {
+    char value[PROPERTY_VALUE_MAX];
+    if (property_get("media.nuplayer.refresh-rate", value, NULL)) {
+        int refreshRate = atoi(value);
+        if (refreshRate > 0) {
+            mVsyncPeriodUs = 1000000ll / refreshRate;
+        }
+    }
 }
 
 NuPlayer::Renderer::~Renderer() {
+    // The looper thread outlives us, don't leave it real-time.
+    if (mRealtimeTid > 0) {
+        releasePriority(mRealtimeTid);
+    }
+}
+
+void NuPlayer::Renderer::requestRealtime() {
+    // Only tried once, whether or not it is granted.
+    mRealtimeTid = gettid();
+
+    int err = requestPriorityWithBudget(
+            getpid(), mRealtimeTid, 1, kRealtimeBudgetPercent);
+
+    if (err != 0) {
+        ALOGW("SCHED_FIFO is unavailable for the renderer, tid %d; error %d",
+              mRealtimeTid, err);
+        mRealtimeTid = -1;
+    }
 }
 
 void NuPlayer::Renderer::queueBuffer(
@@ -119,6 +166,10 @@ void NuPlayer::Renderer::resume() {
 }
 
 void NuPlayer::Renderer::onMessageReceived(const sp<AMessage> &msg) {
+    if (mRealtimeTid == 0) {
+        requestRealtime();
+    }
+
     switch (msg->what()) {
         case kWhatDrainAudioQueue:
         {
@@ -357,10 +408,17 @@ void NuPlayer::Renderer::postDrainVideoQueue() {
             int64_t realTimeUs =
                 (mediaTimeUs - mAnchorTimeMediaUs) + mAnchorTimeRealUs;
 
-            delayUs = realTimeUs - ALooper::GetNowUs();
+            delayUs = alignToVsync(realTimeUs) - mVideoDrainLatencyUs
+                    - ALooper::GetNowUs();
         }
     }
 
+    if (delayUs > 0) {
+        mVideoDrainTargetUs = ALooper::GetNowUs() + delayUs;
+    } else {
+        mVideoDrainTargetUs = -1ll;
+    }
+
     msg->post(delayUs);
 
     mDrainVideoQueuePending = true;
@@ -390,16 +448,61 @@ void NuPlayer::Renderer::onDrainVideoQueue() {
     int64_t mediaTimeUs;
     CHECK(entry->mBuffer->meta()->findInt64("timeUs", &mediaTimeUs));
 
+    int64_t nowUs = ALooper::GetNowUs();
+
+    if (mVideoDrainTargetUs >= 0) {
+        // Track how late the looper delivers the drain message so that the
+        // next frames can be posted that much earlier.
+        int64_t latencyUs = nowUs - mVideoDrainTargetUs;
+        if (latencyUs < 0) {
+            latencyUs = 0;
+        } else if (latencyUs > mVsyncPeriodUs) {
+            latencyUs = mVsyncPeriodUs;
+        }
+        mVideoDrainLatencyUs = (7 * mVideoDrainLatencyUs + latencyUs) / 8;
+        mVideoDrainTargetUs = -1ll;
+    }
+
     int64_t realTimeUs = mediaTimeUs - mAnchorTimeMediaUs + mAnchorTimeRealUs;
-    mVideoLateByUs = ALooper::GetNowUs() - realTimeUs;
+    mVideoLateByUs = nowUs - realTimeUs;
+
+    bool tooLate = (mVideoLateByUs > kMaxVideoLateUs);
 
-    bool tooLate = (mVideoLateByUs > 40000);
+    if (!tooLate && mVideoLateByUs > 0) {
+        // Running behind: if the next frame is due before the display
+        // refreshes again this one would only be visible for a moment, drop
+        // it now instead of pushing every following frame further back.
+        List<QueueEntry>::iterator it = mVideoQueue.begin();
+        ++it;
+
+        int64_t nextMediaTimeUs;
+        if (it != mVideoQueue.end() && (*it).mBuffer != NULL
+                && (*it).mBuffer->meta()->findInt64(
+                    "timeUs", &nextMediaTimeUs)) {
+            int64_t nextRealTimeUs =
+                nextMediaTimeUs - mAnchorTimeMediaUs + mAnchorTimeRealUs;
+
+            tooLate = (nextRealTimeUs <= nowUs + mVsyncPeriodUs);
+        }
+    }
 
     if (tooLate) {
         ALOGV("video late by %lld us (%.2f secs)",
              mVideoLateByUs, mVideoLateByUs / 1E6);
+
+        ++mNumFramesDropped;
     } else {
         ALOGV("rendering video at media time %.2f secs", mediaTimeUs / 1E6);
+
+        if (mVsyncAnchorUs < 0) {
+            mVsyncAnchorUs = nowUs;
+        }
+
+        if (mVideoLateByUs > mVsyncPeriodUs) {
+            ++mNumFramesLate;
+        } else {
+            ++mNumFramesOnTime;
+        }
     }
 
     entry->mNotifyConsumed->setInt32("render", !tooLate);
@@ -636,9 +739,25 @@ void NuPlayer::Renderer::notifyPosition() {
     notify->setInt32("what", kWhatPosition);
     notify->setInt64("positionUs", positionUs);
     notify->setInt64("videoLateByUs", mVideoLateByUs);
+    notify->setInt64("numFramesOnTime", mNumFramesOnTime);
+    notify->setInt64("numFramesLate", mNumFramesLate);
+    notify->setInt64("numFramesDropped", mNumFramesDropped);
     notify->post();
 }
 
+int64_t NuPlayer::Renderer::alignToVsync(int64_t realTimeUs) {
+    if (mVsyncAnchorUs < 0 || realTimeUs < mVsyncAnchorUs) {
+        return realTimeUs;
+    }
+
+    // Round to the nearest refresh so that frames keep a steady cadence
+    // instead of following the jitter of the looper.
+    int64_t numVsyncs =
+        (realTimeUs - mVsyncAnchorUs + mVsyncPeriodUs / 2) / mVsyncPeriodUs;
+
+    return mVsyncAnchorUs + numVsyncs * mVsyncPeriodUs;
+}
+
 void NuPlayer::Renderer::onPause() {
     CHECK(!mPaused);
 
@@ -75,6 +75,8 @@ private:
     };
 
     static const int64_t kMinPositionUpdateDelayUs;
+    static const int64_t kDefaultVsyncPeriodUs;
+    static const int64_t kMaxVideoLateUs;
 
     sp<MediaPlayerBase::AudioSink> mAudioSink;
     sp<AMessage> mNotify;
@@ -106,6 +108,26 @@ private:
     int64_t mLastPositionUpdateUs;
     int64_t mVideoLateByUs;
 
+    // Video frames are scheduled on a grid of display refreshes anchored at
+    // the first frame rendered, and posted early by the average latency
+    // with which the drain message was delivered in the past.
+    int64_t mVsyncPeriodUs;
+    int64_t mVsyncAnchorUs;
+    int64_t mVideoDrainTargetUs;
+    int64_t mVideoDrainLatencyUs;
+
+    int64_t mNumFramesOnTime;
+    int64_t mNumFramesLate;
+    int64_t mNumFramesDropped;
+
+    // Thread our messages are delivered on, which is made SCHED_FIFO with
+    // a CPU budget; 0 before the first message, -1 if that was refused.
+    pid_t mRealtimeTid;
+
+    void requestRealtime();
+
+    int64_t alignToVsync(int64_t realTimeUs);
+
     bool onDrainAudioQueue();
     void postDrainAudioQueue(int64_t delayUs = 0);
 
@@ -51,6 +51,12 @@ struct NuPlayer::Source : public RefBase {
         return false;
     }
 
+    // Applies to the seeks that follow, sources that can't honour a mode
+    // keep seeking the way they always have.
+    virtual status_t setSeekMode(SeekMode seekMode) {
+        return INVALID_OPERATION;
+    }
+
 #ifdef QCOM_HARDWARE
     virtual status_t getNewSeekTime(int64_t* newSeek) {
         return INVALID_OPERATION;
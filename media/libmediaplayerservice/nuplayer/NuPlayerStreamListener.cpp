@@ -92,6 +92,39 @@ void NuPlayer::NuPlayerStreamListener::issueCommand(
     }
 }
 
+ssize_t NuPlayer::NuPlayerStreamListener::dequeueCommand_l(
+        sp<AMessage> *extra) {
+    QueueEntry *entry = &*mQueue.begin();
+    CHECK(entry->mIsCommand);
+
+    switch (entry->mCommand) {
+        case EOS:
+        {
+            mQueue.erase(mQueue.begin());
+            entry = NULL;
+
+            mEOS = true;
+            return 0;
+        }
+
+        case DISCONTINUITY:
+        {
+            *extra = entry->mExtra;
+
+            mQueue.erase(mQueue.begin());
+            entry = NULL;
+
+            return INFO_DISCONTINUITY;
+        }
+
+        default:
+            TRESPASS();
+            break;
+    }
+
+    return 0;
+}
+
 ssize_t NuPlayer::NuPlayerStreamListener::read(
         void *data, size_t size, sp<AMessage> *extra) {
     CHECK_GT(size, 0u);
@@ -113,30 +146,7 @@ ssize_t NuPlayer::NuPlayerStreamListener::read(
     QueueEntry *entry = &*mQueue.begin();
 
     if (entry->mIsCommand) {
-        switch (entry->mCommand) {
-            case EOS:
-            {
-                mQueue.erase(mQueue.begin());
-                entry = NULL;
-
-                mEOS = true;
-                return 0;
-            }
-
-            case DISCONTINUITY:
-            {
-                *extra = entry->mExtra;
-
-                mQueue.erase(mQueue.begin());
-                entry = NULL;
-
-                return INFO_DISCONTINUITY;
-            }
-
-            default:
-                TRESPASS();
-                break;
-        }
+        return dequeueCommand_l(extra);
     }
 
     size_t copy = entry->mSize;
@@ -161,4 +171,65 @@ ssize_t NuPlayer::NuPlayerStreamListener::read(
     return copy;
 }
 
+ssize_t NuPlayer::NuPlayerStreamListener::readDirect(
+        const uint8_t **data, size_t size, sp<AMessage> *extra) {
+    CHECK_GT(size, 0u);
+
+    *data = NULL;
+    extra->clear();
+
+    Mutex::Autolock autoLock(mLock);
+
+    if (mEOS) {
+        return 0;
+    }
+
+    if (mQueue.empty()) {
+        mSendDataNotification = true;
+
+        return -EWOULDBLOCK;
+    }
+
+    QueueEntry *entry = &*mQueue.begin();
+
+    if (entry->mIsCommand) {
+        return dequeueCommand_l(extra);
+    }
+
+    size_t avail = entry->mSize;
+    if (avail > size) {
+        avail = size;
+    }
+
+    if (avail >= kTSPacketSize) {
+        avail -= avail % kTSPacketSize;
+    }
+
+    // The entry stays at the head of the queue, and queueBuffer() only
+    // appends, so the buffer cannot be recycled before consume().
+    *data = (const uint8_t *)mBuffers.editItemAt(entry->mIndex)->pointer()
+        + entry->mOffset;
+
+    return avail;
+}
+
+void NuPlayer::NuPlayerStreamListener::consume(size_t size) {
+    Mutex::Autolock autoLock(mLock);
+
+    CHECK(!mQueue.empty());
+
+    QueueEntry *entry = &*mQueue.begin();
+    CHECK(!entry->mIsCommand);
+    CHECK_LE(size, entry->mSize);
+
+    entry->mOffset += size;
+    entry->mSize -= size;
+
+    if (entry->mSize == 0) {
+        mSource->onBufferAvailable(entry->mIndex);
+        mQueue.erase(mQueue.begin());
+        entry = NULL;
+    }
+}
+
 }  // namespace android
@@ -39,12 +39,24 @@ struct NuPlayer::NuPlayerStreamListener : public BnStreamListener {
     void start();
     ssize_t read(void *data, size_t size, sp<AMessage> *extra);
 
+    // Like read(), but instead of copying returns in *data a pointer to at
+    // most "size" bytes of the shared buffer at the head of the queue,
+    // rounded down to whole transport packets unless less than one packet
+    // is queued. The bytes stay owned by the listener, and the buffer is
+    // not handed back to the source, until they are consume()d.
+    ssize_t readDirect(const uint8_t **data, size_t size, sp<AMessage> *extra);
+    void consume(size_t size);
+
 private:
     enum {
         kNumBuffers = 8,
         kBufferSize = 188 * 10
     };
 
+    enum {
+        kTSPacketSize = 188
+    };
+
     struct QueueEntry {
         bool mIsCommand;
 
@@ -66,6 +78,8 @@ private:
     bool mEOS;
     bool mSendDataNotification;
 
+    ssize_t dequeueCommand_l(sp<AMessage> *extra);
+
     DISALLOW_EVIL_CONSTRUCTORS(NuPlayerStreamListener);
 };
 
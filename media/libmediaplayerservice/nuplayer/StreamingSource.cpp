@@ -29,12 +29,22 @@
 #include <media/stagefright/foundation/AMessage.h>
 #include <media/stagefright/MediaSource.h>
 #include <media/stagefright/MetaData.h>
+#include <cutils/properties.h>
 
 namespace android {
 
 NuPlayer::StreamingSource::StreamingSource(const sp<IStreamSource> &source)
     : mSource(source),
-      mFinalResult(OK) {
+      mFinalResult(OK),
+      mZeroCopy(false) {
+    // Parse the transport stream straight out of the buffers shared with
+    // the IStreamSource instead of copying it out one packet at a time.
+    // The client can still write to those buffers while they are parsed.
+    char value[PROPERTY_VALUE_MAX];
+    if (property_get("media.nuplayer.ts-zerocopy", value, NULL)
+            && (!strcmp(value, "1") || !strcasecmp(value, "true"))) {
+        mZeroCopy = true;
+    }
 }
 
 NuPlayer::StreamingSource::~StreamingSource() {
@@ -52,10 +62,34 @@ status_t NuPlayer::StreamingSource::feedMoreTSData() {
         return mFinalResult;
     }
 
-    for (int32_t i = 0; i < 50; ++i) {
+    if (mTSParser->isFull()) {
+        // Let the decoders catch up before queueing any more.
+        return OK;
+    }
+
+    static const size_t kMaxPacketsPerFeed = 50;
+
+    size_t numPackets = 0;
+    while (numPackets < kMaxPacketsPerFeed) {
         char buffer[188];
+        const uint8_t *data = NULL;
         sp<AMessage> extra;
-        ssize_t n = mStreamListener->read(buffer, sizeof(buffer), &extra);
+        ssize_t n;
+
+        if (mZeroCopy) {
+            n = mStreamListener->readDirect(
+                    &data,
+                    (kMaxPacketsPerFeed - numPackets) * sizeof(buffer),
+                    &extra);
+
+            if (n > 0 && (size_t)n < sizeof(buffer)) {
+                // Less than a packet left in this buffer.
+                data = NULL;
+                n = mStreamListener->read(buffer, sizeof(buffer), &extra);
+            }
+        } else {
+            n = mStreamListener->read(buffer, sizeof(buffer), &extra);
+        }
 
         if (n == 0) {
             ALOGI("input data EOS reached.");
@@ -79,9 +113,23 @@ status_t NuPlayer::StreamingSource::feedMoreTSData() {
 
             mTSParser->signalDiscontinuity(
                     (ATSParser::DiscontinuityType)type, extra);
+            ++numPackets;
         } else if (n < 0) {
             CHECK_EQ(n, -EWOULDBLOCK);
             break;
+        } else if (data != NULL) {
+            status_t err = feedPackets(data, n);
+            mStreamListener->consume(n);
+
+            if (err != OK) {
+                ALOGE("TS Parser returned error %d", err);
+
+                mTSParser->signalEOS(err);
+                mFinalResult = err;
+                break;
+            }
+
+            numPackets += n / sizeof(buffer);
         } else {
             if (buffer[0] == 0x00) {
                 // XXX legacy
@@ -101,7 +149,50 @@ status_t NuPlayer::StreamingSource::feedMoreTSData() {
                     break;
                 }
             }
+
+            ++numPackets;
+        }
+    }
+
+    return OK;
+}
+
+// Feeds whole packets to the parser, as many as possible per call, while
+// still honouring the legacy in-band discontinuity packets.
+status_t NuPlayer::StreamingSource::feedPackets(
+        const uint8_t *data, size_t size) {
+    static const size_t kTSPacketSize = 188;
+
+    CHECK_EQ(size % kTSPacketSize, 0u);
+
+    size_t start = 0;
+    for (size_t offset = 0; offset < size; offset += kTSPacketSize) {
+        const uint8_t *packet = data + offset;
+        if (packet[0] != 0x00) {
+            continue;
+        }
+
+        if (offset > start) {
+            status_t err = mTSParser->feedTSPackets(
+                    data + start, offset - start);
+
+            if (err != OK) {
+                return err;
+            }
         }
+
+        // XXX legacy
+        mTSParser->signalDiscontinuity(
+                packet[1] == 0x00
+                    ? ATSParser::DISCONTINUITY_SEEK
+                    : ATSParser::DISCONTINUITY_FORMATCHANGE,
+                NULL);
+
+        start = offset + kTSPacketSize;
+    }
+
+    if (size > start) {
+        return mTSParser->feedTSPackets(data + start, size - start);
     }
 
     return OK;
@@ -44,6 +44,9 @@ private:
     status_t mFinalResult;
     sp<NuPlayerStreamListener> mStreamListener;
     sp<ATSParser> mTSParser;
+    bool mZeroCopy;
+
+    status_t feedPackets(const uint8_t *data, size_t size);
 
     DISALLOW_EVIL_CONSTRUCTORS(StreamingSource);
 };
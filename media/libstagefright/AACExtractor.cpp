@@ -20,6 +20,7 @@
 
 #include "include/AACExtractor.h"
 #include "include/avc_utils.h"
+#include "include/FrameOffsetIndex.h"
 
 #include <media/stagefright/foundation/ABuffer.h>
 #include <media/stagefright/foundation/AMessage.h>
@@ -38,7 +39,7 @@ class AACSource : public MediaSource {
 public:
     AACSource(const sp<DataSource> &source,
               const sp<MetaData> &meta,
-              const Vector<uint64_t> &offset_vector,
+              const sp<FrameOffsetIndex> &index,
               int64_t frame_duration_us);
 
     virtual status_t start(MetaData *params = NULL);
@@ -62,9 +63,16 @@ private:
     bool mStarted;
     MediaBufferGroup *mGroup;
 
-    Vector<uint64_t> mOffsetVector;
+    sp<FrameOffsetIndex> mIndex;
     int64_t mFrameDurationUs;
 
+    // Number of the frame at mOffset, only an estimate after a seek past
+    // the indexed frames, in which case mFrameExact is false.
+    int64_t mFrame;
+    bool mFrameExact;
+
+    void seekToFrame(int64_t frame);
+
     AACSource(const AACSource &);
     AACSource &operator=(const AACSource &);
 };
@@ -132,6 +140,59 @@ static size_t getAdtsFrameLength(const sp<DataSource> &source, off64_t offset, s
     return frameSize;
 }
 
+// A frame is recorded in the index every this many frames.
+static const size_t kFramesPerIndexEntry = 50;
+
+// Frames read at open time to estimate the duration.
+static const size_t kNumProbeFrames = 64;
+
+// Seeks at most this far past the indexed frames walk the frame headers,
+// seeks further than that are interpolated.
+static const int64_t kMaxWalkUs = 10000000ll;
+
+static const size_t kMaxResyncBytes = 16384;
+
+// Looks for an ADTS frame at or after "*offset" that is followed by
+// another one, or by the end of the stream.
+static bool resyncAdts(const sp<DataSource> &source, off64_t *offset) {
+    uint8_t buffer[1024];
+    off64_t pos = *offset;
+    off64_t end = pos + kMaxResyncBytes;
+
+    while (pos < end) {
+        ssize_t n = source->readAt(pos, buffer, sizeof(buffer));
+        if (n < 2) {
+            return false;
+        }
+
+        for (ssize_t i = 0; i + 1 < n; ++i) {
+            if (buffer[i] != 0xff || (buffer[i + 1] & 0xf6) != 0xf0) {
+                continue;
+            }
+
+            size_t frameSize = getAdtsFrameLength(source, pos + i, NULL);
+            if (frameSize == 0) {
+                continue;
+            }
+
+            uint8_t next;
+            if (source->readAt(pos + i + frameSize, &next, 1) == 1
+                    && getAdtsFrameLength(
+                        source, pos + i + frameSize, NULL) == 0) {
+                continue;
+            }
+
+            *offset = pos + i;
+            return true;
+        }
+
+        // Keep the last byte, it might start a syncword.
+        pos += n - 1;
+    }
+
+    return false;
+}
+
 AACExtractor::AACExtractor(
         const sp<DataSource> &source, const sp<AMessage> &_meta)
     : mDataSource(source),
@@ -167,26 +228,40 @@ AACExtractor::AACExtractor(
 
     mMeta = MakeAACCodecSpecificData(profile, sf_index, channel);
 
-    off64_t streamSize, numFrames = 0;
-    size_t frameSize = 0;
-    int64_t duration = 0;
+    // Round up and get the duration
+    mFrameDurationUs = (1024 * 1000000ll + (sr - 1)) / sr;
+
+    // Only the first few frames are indexed now, the sources index the
+    // rest as they read them.
+    off64_t firstFrameOffset = offset;
+    mIndex = new FrameOffsetIndex(firstFrameOffset, kFramesPerIndexEntry);
 
-    if (mDataSource->getSize(&streamSize) == OK) {
-         while (offset < streamSize) {
-            if ((frameSize = getAdtsFrameLength(source, offset, NULL)) == 0) {
+    size_t frameSize = 0;
+    for (size_t i = 0; i < kNumProbeFrames; ++i) {
+        if ((frameSize = getAdtsFrameLength(source, offset, NULL)) == 0) {
+            if (i == 0) {
                 return;
             }
-
-            mOffsetVector.push(offset);
-
-            offset += frameSize;
-            numFrames ++;
+            mIndex->setComplete();
+            break;
         }
 
-        // Round up and get the duration
-        mFrameDurationUs = (1024 * 1000000ll + (sr - 1)) / sr;
-        duration = numFrames * mFrameDurationUs;
-        mMeta->setInt64(kKeyDuration, duration);
+        mIndex->addFrame(i, offset, frameSize);
+        offset += frameSize;
+    }
+
+    off64_t streamSize;
+    if (mIndex->isComplete()) {
+        mMeta->setInt64(
+                kKeyDuration, mIndex->countFrames() * mFrameDurationUs);
+    } else if (mDataSource->getSize(&streamSize) == OK) {
+        // Extrapolate from the average size of the probed frames.
+        int64_t numFrames = mIndex->countFrames();
+        off64_t probedSize = mIndex->endOffset() - firstFrameOffset;
+        numFrames +=
+            ((streamSize - mIndex->endOffset()) * numFrames) / probedSize;
+
+        mMeta->setInt64(kKeyDuration, numFrames * mFrameDurationUs);
     }
 
     mInitCheck = OK;
@@ -216,7 +291,7 @@ sp<MediaSource> AACExtractor::getTrack(size_t index) {
         return NULL;
     }
 
-    return new AACSource(mDataSource, mMeta, mOffsetVector, mFrameDurationUs);
+    return new AACSource(mDataSource, mMeta, mIndex, mFrameDurationUs);
 }
 
 sp<MetaData> AACExtractor::getTrackMetaData(size_t index, uint32_t flags) {
@@ -234,7 +309,7 @@ const size_t AACSource::kMaxFrameSize = 8192;
 
 AACSource::AACSource(
         const sp<DataSource> &source, const sp<MetaData> &meta,
-        const Vector<uint64_t> &offset_vector,
+        const sp<FrameOffsetIndex> &index,
         int64_t frame_duration_us)
     : mDataSource(source),
       mMeta(meta),
@@ -242,8 +317,10 @@ AACSource::AACSource(
       mCurrentTimeUs(0),
       mStarted(false),
       mGroup(NULL),
-      mOffsetVector(offset_vector),
-      mFrameDurationUs(frame_duration_us) {
+      mIndex(index),
+      mFrameDurationUs(frame_duration_us),
+      mFrame(0),
+      mFrameExact(true) {
 }
 
 AACSource::~AACSource() {
@@ -255,12 +332,11 @@ AACSource::~AACSource() {
 status_t AACSource::start(MetaData *params) {
     CHECK(!mStarted);
 
-    if (mOffsetVector.empty()) {
-        mOffset = 0;
-    } else {
-        mOffset = mOffsetVector.itemAt(0);
-    }
+    int64_t entryFrame;
+    CHECK(mIndex->findFrame(0, &entryFrame, &mOffset));
 
+    mFrame = 0;
+    mFrameExact = true;
     mCurrentTimeUs = 0;
     mGroup = new MediaBufferGroup;
     mGroup->add_buffer(new MediaBuffer(kMaxFrameSize));
@@ -292,14 +368,16 @@ status_t AACSource::read(
     if (options && options->getSeekTo(&seekTimeUs, &mode)) {
         if (mFrameDurationUs > 0) {
             int64_t seekFrame = seekTimeUs / mFrameDurationUs;
-            mCurrentTimeUs = seekFrame * mFrameDurationUs;
-
-            mOffset = mOffsetVector.itemAt(seekFrame);
+            seekToFrame(seekFrame < 0 ? 0 : seekFrame);
+            mCurrentTimeUs = mFrame * mFrameDurationUs;
         }
     }
 
     size_t frameSize, frameSizeWithoutHeader, headerSize;
     if ((frameSize = getAdtsFrameLength(mDataSource, mOffset, &headerSize)) == 0) {
+        if (mFrameExact) {
+            mIndex->setComplete();
+        }
         return ERROR_END_OF_STREAM;
     }
 
@@ -322,13 +400,61 @@ status_t AACSource::read(
     buffer->meta_data()->setInt64(kKeyTime, mCurrentTimeUs);
     buffer->meta_data()->setInt32(kKeyIsSyncFrame, 1);
 
+    if (mFrameExact) {
+        mIndex->addFrame(mFrame, mOffset, frameSize);
+    }
+
     mOffset += frameSize;
     mCurrentTimeUs += mFrameDurationUs;
+    ++mFrame;
 
     *out = buffer;
     return OK;
 }
 
+void AACSource::seekToFrame(int64_t frame) {
+    int64_t entryFrame;
+    off64_t offset;
+    if (!mIndex->findFrame(frame, &entryFrame, &offset)) {
+        entryFrame = mIndex->countFrames();
+        offset = mIndex->endOffset();
+
+        if (!mIndex->isComplete()
+                && (frame - entryFrame) * mFrameDurationUs > kMaxWalkUs) {
+            // Too far past the indexed frames to walk there now, land on
+            // the first frame after the interpolated offset instead.
+            offset = mIndex->estimateOffset(frame, 0);
+            if (!resyncAdts(mDataSource, &offset)) {
+                ALOGW("no frame near interpolated offset %lld", offset);
+            }
+
+            ALOGV("seek to frame %lld interpolated to offset %lld",
+                 frame, offset);
+
+            mFrame = frame;
+            mFrameExact = false;
+            mOffset = offset;
+            return;
+        }
+    }
+
+    mFrame = entryFrame;
+    mFrameExact = true;
+    mOffset = offset;
+
+    // Walk the frame headers, extending the index as we go.
+    while (mFrame < frame) {
+        size_t frameSize = getAdtsFrameLength(mDataSource, mOffset, NULL);
+        if (frameSize == 0) {
+            break;
+        }
+
+        mIndex->addFrame(mFrame, mOffset, frameSize);
+        mOffset += frameSize;
+        ++mFrame;
+    }
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 
 bool SniffAAC(
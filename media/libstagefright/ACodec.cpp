@@ -16,6 +16,8 @@
 
 //#define LOG_NDEBUG 0
 #define LOG_TAG "ACodec"
+#define ATRACE_TAG ATRACE_TAG_VIDEO
+#include <utils/Trace.h>
 
 #include <media/stagefright/ACodec.h>
 
@@ -413,6 +415,9 @@ ACodec::ACodec()
       mNode(NULL),
       mSentFormat(false),
       mIsEncoder(false),
+      mInputTimeTraceName(NULL),
+      mOutputTimeTraceName(NULL),
+      mOutputQueuedTraceName(NULL),
       mShutdownInProgress(false),
       mEncoderDelay(0),
       mEncoderPadding(0),
@@ -540,6 +545,7 @@ status_t ACodec::allocateBuffersOnPort(OMX_U32 portIndex) {
 
                 if (mem != NULL) {
                     info.mData = new ABuffer(mem->pointer(), def.nBufferSize);
+                    info.mMem = mem;
                 }
 
                 mBuffers[portIndex].push(info);
@@ -561,7 +567,7 @@ status_t ACodec::allocateBuffersOnPort(OMX_U32 portIndex) {
     for (size_t i = 0; i < mBuffers[portIndex].size(); ++i) {
         const BufferInfo &info = mBuffers[portIndex][i];
 
-        desc->addBuffer(info.mBufferID, info.mData);
+        desc->addBuffer(info.mBufferID, info.mData, info.mMem);
     }
 
     notify->setObject("portDesc", desc);
@@ -849,6 +855,35 @@ status_t ACodec::freeBuffer(OMX_U32 portIndex, size_t i) {
     return OK;
 }
 
+void ACodec::obtainTransitMessages(
+        BufferInfo *info, uint32_t replyWhat,
+        sp<AMessage> *notify, sp<AMessage> *reply) {
+    // A message only referenced from here has been handled by the client
+    // and, for the reply, by us. The notification is overwritten with the
+    // same keys each time, so it isn't cleared.
+    if (info->mTransitNotify == NULL
+            || info->mTransitNotify->getStrongCount() > 1) {
+        info->mTransitNotify = mNotify->dup();
+    } else {
+        // Drop the reference to the previous reply.
+        info->mTransitNotify->setMessage("reply", NULL);
+    }
+
+    if (info->mTransitReply == NULL
+            || info->mTransitReply->getStrongCount() > 1) {
+        info->mTransitReply = new AMessage(replyWhat, id());
+    } else {
+        info->mTransitReply->clear();
+        info->mTransitReply->setWhat(replyWhat);
+    }
+
+    info->mTransitReply->setPointer("buffer-id", info->mBufferID);
+    info->mTransitNotify->setMessage("reply", info->mTransitReply);
+
+    *notify = info->mTransitNotify;
+    *reply = info->mTransitReply;
+}
+
 ACodec::BufferInfo *ACodec::findBufferByID(
         uint32_t portIndex, IOMX::buffer_id bufferID,
         ssize_t *index) {
@@ -960,6 +995,23 @@ status_t ACodec::configureCodec(
 
     mIsEncoder = encoder;
 
+    bool isVideo = !strncasecmp(mime, "video/", 6);
+    if (isVideo) {
+        mInputTimeTraceName = encoder
+            ? "Video Encoder Input Time (ms)" : "Video Decoder Input Time (ms)";
+        mOutputTimeTraceName = encoder
+            ? "Video Encoder Output Time (ms)" : "Video Decoder Output Time (ms)";
+        mOutputQueuedTraceName = encoder
+            ? "Video Encoder Output Queued" : "Video Decoder Output Queued";
+    } else {
+        mInputTimeTraceName = encoder
+            ? "Audio Encoder Input Time (ms)" : "Audio Decoder Input Time (ms)";
+        mOutputTimeTraceName = encoder
+            ? "Audio Encoder Output Time (ms)" : "Audio Decoder Output Time (ms)";
+        mOutputQueuedTraceName = encoder
+            ? "Audio Encoder Output Queued" : "Audio Decoder Output Queued";
+    }
+
     status_t err = setComponentRole(encoder /* isEncoder */, mime);
 
     if (err != OK) {
@@ -1313,8 +1365,8 @@ status_t ACodec::setupAMRCodec(bool encoder, bool isWAMR, int32_t bitrate) {
 }
 
 status_t ACodec::setupG711Codec(bool encoder, int32_t numChannels) {
-    CHECK(!encoder);  // XXX TODO
-
+    // The PCM side of both the decoder and the encoder is the input port,
+    // the companded side picks up its channel count from there.
     return setupRawAudioFormat(
             kPortIndexInput, 8000 /* sampleRate */, numChannels);
 }
@@ -2083,6 +2135,20 @@ size_t ACodec::countBuffersOwnedByComponent(OMX_U32 portIndex) const {
     return n;
 }
 
+size_t ACodec::countBuffersOwnedByDownstream(OMX_U32 portIndex) const {
+    size_t n = 0;
+
+    for (size_t i = 0; i < mBuffers[portIndex].size(); ++i) {
+        const BufferInfo &info = mBuffers[portIndex].itemAt(i);
+
+        if (info.mStatus == BufferInfo::OWNED_BY_DOWNSTREAM) {
+            ++n;
+        }
+    }
+
+    return n;
+}
+
 bool ACodec::allYourBuffersAreBelongToUs(
         OMX_U32 portIndex) {
     for (size_t i = 0; i < mBuffers[portIndex].size(); ++i) {
@@ -2393,9 +2459,11 @@ ACodec::PortDescription::PortDescription() {
 }
 
 void ACodec::PortDescription::addBuffer(
-        IOMX::buffer_id id, const sp<ABuffer> &buffer) {
+        IOMX::buffer_id id, const sp<ABuffer> &buffer,
+        const sp<IMemory> &mem) {
     mBufferIDs.push_back(id);
     mBuffers.push_back(buffer);
+    mMemories.push_back(mem);
 }
 
 size_t ACodec::PortDescription::countBuffers() {
@@ -2410,6 +2478,10 @@ sp<ABuffer> ACodec::PortDescription::bufferAt(size_t index) const {
     return mBuffers.itemAt(index);
 }
 
+sp<IMemory> ACodec::PortDescription::memoryAt(size_t index) const {
+    return mMemories.itemAt(index);
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 
 ACodec::BaseState::BaseState(ACodec *codec, const sp<AState> &parentState)
@@ -2537,6 +2609,8 @@ bool ACodec::BaseState::onOMXEvent(
 }
 
 bool ACodec::BaseState::onOMXEmptyBufferDone(IOMX::buffer_id bufferID) {
+    ScopedTrace trace(ATRACE_TAG, "ACodec::onOMXEmptyBufferDone");
+
     ALOGV("[%s] onOMXEmptyBufferDone %p",
          mCodec->mComponentName.c_str(), bufferID);
 
@@ -2574,24 +2648,24 @@ void ACodec::BaseState::postFillThisBuffer(BufferInfo *info) {
 
     CHECK_EQ((int)info->mStatus, (int)BufferInfo::OWNED_BY_US);
 
-    sp<AMessage> notify = mCodec->mNotify->dup();
+    sp<AMessage> notify;
+    sp<AMessage> reply;
+    mCodec->obtainTransitMessages(info, kWhatInputBufferFilled, &notify, &reply);
+
     notify->setInt32("what", ACodec::kWhatFillThisBuffer);
     notify->setPointer("buffer-id", info->mBufferID);
 
     info->mData->meta()->clear();
     notify->setBuffer("buffer", info->mData);
 
-    sp<AMessage> reply = new AMessage(kWhatInputBufferFilled, mCodec->id());
-    reply->setPointer("buffer-id", info->mBufferID);
-
-    notify->setMessage("reply", reply);
-
     notify->post();
 
     info->mStatus = BufferInfo::OWNED_BY_UPSTREAM;
 }
 
 void ACodec::BaseState::onInputBufferFilled(const sp<AMessage> &msg) {
+    ScopedTrace trace(ATRACE_TAG, "ACodec::onInputBufferFilled");
+
     IOMX::buffer_id bufferID;
     CHECK(msg->findPointer("buffer-id", &bufferID));
 
@@ -2671,6 +2745,8 @@ void ACodec::BaseState::onInputBufferFilled(const sp<AMessage> &msg) {
                 } else {
                     ALOGV("[%s] calling emptyBuffer %p w/ time %lld us",
                          mCodec->mComponentName.c_str(), bufferID, timeUs);
+
+                    ATRACE_INT(mCodec->mInputTimeTraceName, timeUs / 1000);
                 }
 
                 CHECK_EQ(mCodec->mOMX->emptyBuffer(
@@ -2765,6 +2841,8 @@ bool ACodec::BaseState::onOMXFillBufferDone(
         int64_t timeUs,
         void *platformPrivate,
         void *dataPtr) {
+    ScopedTrace trace(ATRACE_TAG, "ACodec::onOMXFillBufferDone");
+
     ALOGV("[%s] onOMXFillBufferDone %p time %lld us, flags = 0x%08lx",
          mCodec->mComponentName.c_str(), bufferID, timeUs, flags);
 
@@ -2809,23 +2887,26 @@ bool ACodec::BaseState::onOMXFillBufferDone(
             }
             info->mData->meta()->setInt64("timeUs", timeUs);
 
-            sp<AMessage> notify = mCodec->mNotify->dup();
+            sp<AMessage> notify;
+            sp<AMessage> reply;
+            mCodec->obtainTransitMessages(
+                    info, kWhatOutputBufferDrained, &notify, &reply);
+
             notify->setInt32("what", ACodec::kWhatDrainThisBuffer);
             notify->setPointer("buffer-id", info->mBufferID);
             notify->setBuffer("buffer", info->mData);
             notify->setInt32("flags", flags);
 
-            sp<AMessage> reply =
-                new AMessage(kWhatOutputBufferDrained, mCodec->id());
-
-            reply->setPointer("buffer-id", info->mBufferID);
-
-            notify->setMessage("reply", reply);
-
             notify->post();
 
             info->mStatus = BufferInfo::OWNED_BY_DOWNSTREAM;
 
+            ATRACE_INT(mCodec->mOutputTimeTraceName, timeUs / 1000);
+            if (Tracer::isTagEnabled(ATRACE_TAG)) {
+                ATRACE_INT(mCodec->mOutputQueuedTraceName,
+                           mCodec->countBuffersOwnedByDownstream(kPortIndexOutput));
+            }
+
             if (flags & OMX_BUFFERFLAG_EOS) {
                 ALOGV("[%s] saw output EOS", mCodec->mComponentName.c_str());
 
@@ -2853,6 +2934,8 @@ bool ACodec::BaseState::onOMXFillBufferDone(
 }
 
 void ACodec::BaseState::onOutputBufferDrained(const sp<AMessage> &msg) {
+    ScopedTrace trace(ATRACE_TAG, "ACodec::onOutputBufferDrained");
+
     IOMX::buffer_id bufferID;
     CHECK(msg->findPointer("buffer-id", &bufferID));
 
@@ -2879,6 +2962,11 @@ void ACodec::BaseState::onOutputBufferDrained(const sp<AMessage> &msg) {
         info->mStatus = BufferInfo::OWNED_BY_US;
     }
 
+    if (Tracer::isTagEnabled(ATRACE_TAG)) {
+        ATRACE_INT(mCodec->mOutputQueuedTraceName,
+                   mCodec->countBuffersOwnedByDownstream(kPortIndexOutput));
+    }
+
     PortMode mode = getPortMode(kPortIndexOutput);
 
     switch (mode) {
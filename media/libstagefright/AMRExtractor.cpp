@@ -19,6 +19,7 @@
 #include <utils/Log.h>
 
 #include "include/AMRExtractor.h"
+#include "include/FrameOffsetIndex.h"
 
 #include <media/stagefright/foundation/ADebug.h>
 #include <media/stagefright/DataSource.h>
@@ -36,8 +37,7 @@ public:
     AMRSource(const sp<DataSource> &source,
               const sp<MetaData> &meta,
               bool isWide,
-              const off64_t *offset_table,
-              size_t offset_table_length);
+              const sp<FrameOffsetIndex> &index);
 
     virtual status_t start(MetaData *params = NULL);
     virtual status_t stop();
@@ -60,8 +60,14 @@ private:
     bool mStarted;
     MediaBufferGroup *mGroup;
 
-    off64_t mOffsetTable[OFFSET_TABLE_LEN];
-    size_t mOffsetTableLength;
+    sp<FrameOffsetIndex> mIndex;
+
+    // Number of the frame at mOffset, only an estimate after a seek past
+    // the indexed frames, in which case mFrameExact is false.
+    int64_t mFrame;
+    bool mFrameExact;
+
+    status_t seekToFrame(int64_t frame);
 
     AMRSource(const AMRSource &);
     AMRSource &operator=(const AMRSource &);
@@ -113,10 +119,63 @@ static status_t getFrameSizeByOffset(const sp<DataSource> &source,
     return OK;
 }
 
+// A frame is recorded in the index every this many frames, once a second.
+static const size_t kFramesPerIndexEntry = 50;
+
+// Frames read at open time to estimate the duration.
+static const size_t kNumProbeFrames = 64;
+
+// Seeks at most this many frames past the indexed ones walk the frame
+// headers, seeks further than that are interpolated.
+static const int64_t kMaxWalkFrames = 500;
+
+static const size_t kMaxResyncBytes = 4096;
+
+// Frame headers that must follow one another to consider a position found
+// by resyncing a frame boundary.
+static const size_t kNumResyncFrames = 4;
+
+// Looks for kNumResyncFrames consecutive valid frames at or after
+// "*offset", stopping early at the end of the stream.
+static bool resyncAMR(
+        const sp<DataSource> &source, bool isWide, off64_t *offset) {
+    for (off64_t pos = *offset; pos < *offset + (off64_t)kMaxResyncBytes;
+            ++pos) {
+        off64_t frameOffset = pos;
+        size_t numFrames = 0;
+        bool reachedEnd = false;
+        while (numFrames < kNumResyncFrames) {
+            uint8_t header;
+            if (source->readAt(frameOffset, &header, 1) < 1) {
+                reachedEnd = true;
+                break;
+            }
+            if (header & 0x83) {
+                // Padding bits must be 0.
+                break;
+            }
+            size_t frameSize = getFrameSize(isWide, (header >> 3) & 0x0f);
+            if (frameSize == 0) {
+                break;
+            }
+            frameOffset += frameSize;
+            ++numFrames;
+        }
+
+        if (numFrames == kNumResyncFrames || (reachedEnd && numFrames > 0)) {
+            *offset = pos;
+            return true;
+        } else if (reachedEnd) {
+            return false;
+        }
+    }
+
+    return false;
+}
+
 AMRExtractor::AMRExtractor(const sp<DataSource> &source)
     : mDataSource(source),
-      mInitCheck(NO_INIT),
-      mOffsetTableLength(0) {
+      mInitCheck(NO_INIT) {
     String8 mimeType;
     float confidence;
     if (!SniffAMR(mDataSource, &mimeType, &confidence, NULL)) {
@@ -133,30 +192,37 @@ AMRExtractor::AMRExtractor(const sp<DataSource> &source)
     mMeta->setInt32(kKeyChannelCount, 1);
     mMeta->setInt32(kKeySampleRate, mIsWide ? 16000 : 8000);
 
-    off64_t offset = mIsWide ? 9 : 6;
-    off64_t streamSize;
-    size_t frameSize, numFrames = 0;
-    int64_t duration = 0;
-
-    if (mDataSource->getSize(&streamSize) == OK) {
-         while (offset < streamSize) {
-            if (getFrameSizeByOffset(source, offset, mIsWide, &frameSize) != OK) {
-                return;
-            }
-
-            if ((numFrames % 50 == 0) && (numFrames / 50 < OFFSET_TABLE_LEN)) {
-                CHECK_EQ(mOffsetTableLength, numFrames / 50);
-                mOffsetTable[mOffsetTableLength] = offset - (mIsWide ? 9: 6);
-                mOffsetTableLength ++;
-            }
-
-            offset += frameSize;
-            duration += 20000;  // Each frame is 20ms
-            numFrames ++;
+    off64_t firstFrameOffset = mIsWide ? 9 : 6;
+    off64_t offset = firstFrameOffset;
+
+    // Only the first few frames are indexed now, the sources index the
+    // rest as they read them.
+    mIndex = new FrameOffsetIndex(firstFrameOffset, kFramesPerIndexEntry);
+
+    size_t frameSize;
+    for (size_t i = 0; i < kNumProbeFrames; ++i) {
+        status_t err = getFrameSizeByOffset(source, offset, mIsWide, &frameSize);
+        if (err == ERROR_MALFORMED && i == 0) {
+            return;
+        } else if (err != OK) {
+            mIndex->setComplete();
+            break;
         }
 
-        mMeta->setInt64(kKeyDuration, duration);
+        mIndex->addFrame(i, offset, frameSize);
+        offset += frameSize;
+    }
+
+    off64_t streamSize;
+    int64_t numFrames = mIndex->countFrames();
+    if (!mIndex->isComplete() && numFrames > 0
+            && mDataSource->getSize(&streamSize) == OK) {
+        // Extrapolate from the average size of the probed frames.
+        off64_t probedSize = mIndex->endOffset() - firstFrameOffset;
+        numFrames +=
+            ((streamSize - mIndex->endOffset()) * numFrames) / probedSize;
     }
+    mMeta->setInt64(kKeyDuration, numFrames * 20000);  // Each frame is 20ms
 
     mInitCheck = OK;
 }
@@ -185,8 +251,7 @@ sp<MediaSource> AMRExtractor::getTrack(size_t index) {
         return NULL;
     }
 
-    return new AMRSource(mDataSource, mMeta, mIsWide,
-            mOffsetTable, mOffsetTableLength);
+    return new AMRSource(mDataSource, mMeta, mIsWide, mIndex);
 }
 
 sp<MetaData> AMRExtractor::getTrackMetaData(size_t index, uint32_t flags) {
@@ -201,7 +266,7 @@ sp<MetaData> AMRExtractor::getTrackMetaData(size_t index, uint32_t flags) {
 
 AMRSource::AMRSource(
         const sp<DataSource> &source, const sp<MetaData> &meta,
-        bool isWide, const off64_t *offset_table, size_t offset_table_length)
+        bool isWide, const sp<FrameOffsetIndex> &index)
     : mDataSource(source),
       mMeta(meta),
       mIsWide(isWide),
@@ -209,10 +274,9 @@ AMRSource::AMRSource(
       mCurrentTimeUs(0),
       mStarted(false),
       mGroup(NULL),
-      mOffsetTableLength(offset_table_length) {
-    if (mOffsetTableLength > 0 && mOffsetTableLength <= OFFSET_TABLE_LEN) {
-        memcpy ((char*)mOffsetTable, (char*)offset_table, sizeof(off64_t) * mOffsetTableLength);
-    }
+      mIndex(index),
+      mFrame(0),
+      mFrameExact(true) {
 }
 
 AMRSource::~AMRSource() {
@@ -226,6 +290,8 @@ status_t AMRSource::start(MetaData *params) {
 
     mOffset = mIsWide ? 9 : 6;
     mCurrentTimeUs = 0;
+    mFrame = 0;
+    mFrameExact = true;
     mGroup = new MediaBufferGroup;
     mGroup->add_buffer(new MediaBuffer(128));
     mStarted = true;
@@ -254,31 +320,21 @@ status_t AMRSource::read(
     int64_t seekTimeUs;
     ReadOptions::SeekMode mode;
     if (options && options->getSeekTo(&seekTimeUs, &mode)) {
-        size_t size;
         int64_t seekFrame = seekTimeUs / 20000ll;  // 20ms per frame.
-        mCurrentTimeUs = seekFrame * 20000ll;
-
-        int index = seekFrame / 50;
-        if (index >= (int)mOffsetTableLength) {
-            index = mOffsetTableLength - 1;
-        }
-
-        mOffset = mOffsetTable[index] + (mIsWide ? 9 : 6);
-
-        for (int i = 0; i< seekFrame - index * 50; i++) {
-            status_t err;
-            if ((err = getFrameSizeByOffset(mDataSource, mOffset,
-                            mIsWide, &size)) != OK) {
-                return err;
-            }
-            mOffset += size;
+        status_t err = seekToFrame(seekFrame < 0 ? 0 : seekFrame);
+        if (err != OK) {
+            return err;
         }
+        mCurrentTimeUs = mFrame * 20000ll;
     }
 
     uint8_t header;
     ssize_t n = mDataSource->readAt(mOffset, &header, 1);
 
     if (n < 1) {
+        if (mFrameExact) {
+            mIndex->setComplete();
+        }
         return ERROR_END_OF_STREAM;
     }
 
@@ -316,14 +372,68 @@ status_t AMRSource::read(
     buffer->meta_data()->setInt64(kKeyTime, mCurrentTimeUs);
     buffer->meta_data()->setInt32(kKeyIsSyncFrame, 1);
 
+    if (mFrameExact) {
+        mIndex->addFrame(mFrame, mOffset, frameSize);
+    }
+
     mOffset += frameSize;
     mCurrentTimeUs += 20000;  // Each frame is 20ms
+    ++mFrame;
 
     *out = buffer;
 
     return OK;
 }
 
+status_t AMRSource::seekToFrame(int64_t frame) {
+    int64_t entryFrame;
+    off64_t offset;
+    if (!mIndex->findFrame(frame, &entryFrame, &offset)) {
+        entryFrame = mIndex->countFrames();
+        offset = mIndex->endOffset();
+
+        if (!mIndex->isComplete() && frame - entryFrame > kMaxWalkFrames) {
+            // Too far past the indexed frames to walk there now, land on
+            // the first frame after the interpolated offset instead.
+            offset = mIndex->estimateOffset(frame, 0);
+            if (!resyncAMR(mDataSource, mIsWide, &offset)) {
+                ALOGW("no frame near interpolated offset %lld", offset);
+            }
+
+            ALOGV("seek to frame %lld interpolated to offset %lld",
+                 frame, offset);
+
+            mFrame = frame;
+            mFrameExact = false;
+            mOffset = offset;
+            return OK;
+        }
+    }
+
+    mFrame = entryFrame;
+    mFrameExact = true;
+    mOffset = offset;
+
+    // Walk the frame headers, extending the index as we go.
+    while (mFrame < frame) {
+        size_t size;
+        status_t err = getFrameSizeByOffset(mDataSource, mOffset, mIsWide, &size);
+        if (err == ERROR_IO) {
+            // Past the end, the next read reports it.
+            mIndex->setComplete();
+            break;
+        } else if (err != OK) {
+            return err;
+        }
+
+        mIndex->addFrame(mFrame, mOffset, size);
+        mOffset += size;
+        ++mFrame;
+    }
+
+    return OK;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 
 bool SniffAMR(
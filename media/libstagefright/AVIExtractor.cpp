@@ -35,6 +35,9 @@
 
 namespace android {
 
+// Larger dwSuggestedBufferSize values in stream headers are ignored.
+static const size_t kMaxSuggestedBufferSize = 16 * 1024 * 1024;
+
 struct AVIExtractor::AVISource : public MediaSource {
     AVISource(const sp<AVIExtractor> &extractor, size_t trackIndex);
 
@@ -185,6 +188,15 @@ status_t AVIExtractor::AVISource::read(
         MediaBuffer *out;
         CHECK_EQ(mBufferGroup->acquire_buffer(&out), (status_t)OK);
 
+        if (size > out->size()) {
+            // The OpenDML index segments that weren't loaded yet when the
+            // maximum sample size was determined may hold larger samples.
+            ALOGV("sample of %d bytes exceeds the maximum sample size", size);
+
+            out->release();
+            out = new MediaBuffer(size);
+        }
+
         ssize_t n = mExtractor->mDataSource->readAt(offset, out->data(), size);
 
         if (n < (ssize_t)size) {
@@ -412,11 +424,15 @@ status_t AVIExtractor::parseHeaders() {
         return (status_t)res;
     }
 
+    if (hasOpenDMLIndex()) {
+        mFoundIndex = true;
+    }
+
     if (mMovieOffset == 0ll || !mFoundIndex) {
         return ERROR_MALFORMED;
     }
 
-    return OK;
+    return finishIndex();
 }
 
 ssize_t AVIExtractor::parseChunk(off64_t offset, off64_t size, int depth) {
@@ -509,8 +525,24 @@ ssize_t AVIExtractor::parseChunk(off64_t offset, off64_t size, int depth) {
                 break;
             }
 
+            case FOURCC('i', 'n', 'd', 'x'):
+            {
+                err = parseSuperIndex(offset + 8, chunkSize);
+                break;
+            }
+
             case FOURCC('i', 'd', 'x', '1'):
             {
+                if (hasOpenDMLIndex()) {
+                    // Only covers the first RIFF chunk of an OpenDML file.
+                    ALOGV("ignoring idx1 in favour of the OpenDML index");
+                    break;
+                }
+
+                for (size_t i = 0; i < mTracks.size(); ++i) {
+                    mTracks.editItemAt(i).mIndexSegments.clear();
+                }
+
                 err = parseIndex(offset + 8, chunkSize);
                 break;
             }
@@ -628,6 +660,7 @@ status_t AVIExtractor::parseStreamHeader(off64_t offset, size_t size) {
     uint32_t rate = U32LE_AT(&data[20]);
     uint32_t scale = U32LE_AT(&data[24]);
 
+    uint32_t suggestedBufferSize = U32LE_AT(&data[36]);
     uint32_t sampleSize = U32LE_AT(&data[44]);
 
     const char *mime = NULL;
@@ -675,6 +708,9 @@ status_t AVIExtractor::parseStreamHeader(off64_t offset, size_t size) {
     track->mThumbnailSampleSize = 0;
     track->mThumbnailSampleIndex = -1;
     track->mMaxSampleSize = 0;
+    track->mSuggestedBufferSize = suggestedBufferSize;
+    track->mNumSamples = 0;
+    track->mLoadedSegment = -1;
     track->mAvgChunkSize = 1.0;
     track->mFirstChunkSize = 0;
 
@@ -856,7 +892,225 @@ status_t AVIExtractor::parseIndex(off64_t offset, size_t size) {
         size -= 16;
     }
 
-    if (!mTracks.isEmpty()) {
+    mFoundIndex = true;
+
+    return OK;
+}
+
+status_t AVIExtractor::parseSuperIndex(off64_t offset, size_t size) {
+    if (mTracks.isEmpty()) {
+        return ERROR_MALFORMED;
+    }
+
+    Track *track = &mTracks.editItemAt(mTracks.size() - 1);
+
+    if (track->mKind == Track::OTHER || size < 24) {
+        return OK;
+    }
+
+    sp<ABuffer> buffer = new ABuffer(size);
+    ssize_t n = mDataSource->readAt(offset, buffer->data(), buffer->size());
+
+    if (n < (ssize_t)size) {
+        return n < 0 ? (status_t)n : ERROR_MALFORMED;
+    }
+
+    const uint8_t *data = buffer->data();
+
+    uint16_t longsPerEntry = U16LE_AT(data);
+    uint8_t indexType = data[3];
+    uint32_t numEntries = U32LE_AT(&data[4]);
+
+    // Only an index of standard indexes ("AVI_INDEX_OF_INDEXES") is
+    // supported, otherwise idx1 has to do.
+    if (indexType != 0 || longsPerEntry != 4
+            || numEntries > (size - 24) / 16) {
+        ALOGW("Unsupported OpenDML super index, type %d", indexType);
+        return OK;
+    }
+
+    data += 24;
+
+    for (uint32_t i = 0; i < numEntries; ++i) {
+        IndexSegment segment;
+        segment.mOffset = (off64_t)U64LE_AT(data);
+        segment.mSize = U32LE_AT(&data[8]);
+        segment.mFirstSample = track->mNumSamples;
+
+        status_t err = parseIndexSegment(&segment);
+
+        if (err != OK) {
+            ALOGW("Malformed OpenDML index segment at 0x%08llx",
+                  segment.mOffset);
+
+            track->mIndexSegments.clear();
+            track->mNumSamples = 0;
+
+            return OK;
+        }
+
+        track->mIndexSegments.push(segment);
+        track->mNumSamples += segment.mNumSamples;
+
+        data += 16;
+    }
+
+    ALOGV("OpenDML index of %d segments, %d samples",
+          track->mIndexSegments.size(), track->mNumSamples);
+
+    return OK;
+}
+
+status_t AVIExtractor::parseIndexSegment(IndexSegment *segment) {
+    uint8_t tmp[32];
+    ssize_t n = mDataSource->readAt(segment->mOffset, tmp, sizeof(tmp));
+
+    if (n < (ssize_t)sizeof(tmp)) {
+        return n < 0 ? (status_t)n : ERROR_MALFORMED;
+    }
+
+    // 'ix##' chunk header
+    uint32_t chunkSize = U32LE_AT(&tmp[4]);
+
+    const uint8_t *data = &tmp[8];
+
+    uint16_t longsPerEntry = U16LE_AT(data);
+    uint8_t indexType = data[3];
+    uint32_t numEntries = U32LE_AT(&data[4]);
+
+    // A standard index ("AVI_INDEX_OF_CHUNKS").
+    if (memcmp(tmp, "ix", 2) || chunkSize < 24
+            || indexType != 1 || longsPerEntry != 2
+            || numEntries > (chunkSize - 24) / 8) {
+        return ERROR_MALFORMED;
+    }
+
+    segment->mSize = chunkSize;
+    segment->mBaseOffset = (off64_t)U64LE_AT(&data[12]);
+    segment->mNumSamples = numEntries;
+
+    return OK;
+}
+
+status_t AVIExtractor::loadIndexSegment(Track *track, size_t segmentIndex) {
+    const IndexSegment &segment = track->mIndexSegments.itemAt(segmentIndex);
+
+    size_t size = segment.mNumSamples * 8;
+
+    sp<ABuffer> buffer = new ABuffer(size);
+    ssize_t n = mDataSource->readAt(
+            segment.mOffset + 8 + 24, buffer->data(), buffer->size());
+
+    if (n < (ssize_t)size) {
+        return n < 0 ? (status_t)n : ERROR_MALFORMED;
+    }
+
+    const uint8_t *data = buffer->data();
+
+    track->mLoadedSegment = -1;
+    track->mSamples.clear();
+    track->mSamples.setCapacity(segment.mNumSamples);
+
+    for (size_t i = 0; i < segment.mNumSamples; ++i) {
+        uint32_t offset = U32LE_AT(data);
+        uint32_t chunkSize = U32LE_AT(&data[4]);
+
+        SampleInfo info;
+        info.mOffset = offset;
+
+        // The top bit flags samples that are _not_ key frames.
+        info.mIsKey = (chunkSize & 0x80000000) == 0;
+        chunkSize &= 0x7fffffff;
+
+        if (chunkSize > track->mMaxSampleSize) {
+            track->mMaxSampleSize = chunkSize;
+        }
+
+        track->mSamples.push(info);
+
+        data += 8;
+    }
+
+    track->mLoadedSegment = segmentIndex;
+
+    return OK;
+}
+
+bool AVIExtractor::hasOpenDMLIndex() const {
+    bool found = false;
+
+    for (size_t i = 0; i < mTracks.size(); ++i) {
+        const Track &track = mTracks.itemAt(i);
+
+        if (track.mKind == Track::OTHER) {
+            continue;
+        }
+
+        if (track.mIndexSegments.isEmpty()) {
+            return false;
+        }
+
+        found = true;
+    }
+
+    return found;
+}
+
+status_t AVIExtractor::scanSyncSamples(size_t trackIndex) {
+    static const size_t kMaxNumSyncSamplesToScan = 20;
+
+    Mutex::Autolock autoLock(mLock);
+
+    Track *track = &mTracks.editItemAt(trackIndex);
+
+    for (size_t i = 0; i < track->mNumSamples
+            && track->mNumSyncSamples < kMaxNumSyncSamplesToScan; ++i) {
+        off64_t offset;
+        bool isKey;
+        status_t err = getSampleEntry_l(track, i, &offset, &isKey);
+
+        if (err != OK) {
+            return err;
+        }
+
+        if (!isKey) {
+            continue;
+        }
+
+        size_t size;
+        int64_t timeUs;
+        err = getSampleInfo_l(
+                trackIndex, i, &offset, &size, &isKey, &timeUs);
+
+        if (err != OK) {
+            return err;
+        }
+
+        if (size > track->mThumbnailSampleSize) {
+            track->mThumbnailSampleSize = size;
+            track->mThumbnailSampleIndex = i;
+        }
+
+        ++track->mNumSyncSamples;
+    }
+
+    // Segments that haven't been loaded may hold larger samples than
+    // those seen so far, the muxer's suggestion covers them if it's sane.
+    if (track->mSuggestedBufferSize > track->mMaxSampleSize
+            && track->mSuggestedBufferSize <= kMaxSuggestedBufferSize) {
+        track->mMaxSampleSize = track->mSuggestedBufferSize;
+    }
+
+    return OK;
+}
+
+status_t AVIExtractor::finishIndex() {
+    if (!hasOpenDMLIndex() && !mTracks.isEmpty()) {
+        for (size_t i = 0; i < mTracks.size(); ++i) {
+            Track *track = &mTracks.editItemAt(i);
+            track->mNumSamples = track->mSamples.size();
+        }
+
         off64_t offset;
         size_t size;
         bool isKey;
@@ -879,13 +1133,21 @@ status_t AVIExtractor::parseIndex(off64_t offset, size_t size) {
     for (size_t i = 0; i < mTracks.size(); ++i) {
         Track *track = &mTracks.editItemAt(i);
 
+        if (!track->mIndexSegments.isEmpty()) {
+            status_t err = scanSyncSamples(i);
+
+            if (err != OK) {
+                return err;
+            }
+        }
+
         if (track->mBytesPerSample > 0) {
             // Assume all chunks are roughly the same size for now.
 
             // Compute the avg. size of the first 128 chunks (if there are
             // that many), but exclude the size of the first one, since
             // it may be an outlier.
-            size_t numSamplesToAverage = track->mSamples.size();
+            size_t numSamplesToAverage = track->mNumSamples;
             if (numSamplesToAverage > 256) {
                 numSamplesToAverage = 256;
             }
@@ -922,7 +1184,7 @@ status_t AVIExtractor::parseIndex(off64_t offset, size_t size) {
 
         int64_t durationUs;
         CHECK_EQ((status_t)OK,
-                 getSampleTime(i, track->mSamples.size() - 1, &durationUs));
+                 getSampleTime(i, track->mNumSamples - 1, &durationUs));
 
         ALOGV("track %d duration = %.2f secs", i, durationUs / 1E6);
 
@@ -958,8 +1220,6 @@ status_t AVIExtractor::parseIndex(off64_t offset, size_t size) {
         }
     }
 
-    mFoundIndex = true;
-
     return OK;
 }
 
@@ -1120,22 +1380,78 @@ status_t AVIExtractor::getSampleInfo(
         size_t trackIndex, size_t sampleIndex,
         off64_t *offset, size_t *size, bool *isKey,
         int64_t *sampleTimeUs) {
-    if (trackIndex >= mTracks.size()) {
+    Mutex::Autolock autoLock(mLock);
+
+    return getSampleInfo_l(
+            trackIndex, sampleIndex, offset, size, isKey, sampleTimeUs);
+}
+
+status_t AVIExtractor::getSampleEntry_l(
+        Track *track, size_t sampleIndex, off64_t *offset, bool *isKey) {
+    if (sampleIndex >= track->mNumSamples) {
         return -ERANGE;
     }
 
-    const Track &track = mTracks.itemAt(trackIndex);
+    if (track->mIndexSegments.isEmpty()) {
+        const SampleInfo &info = track->mSamples.itemAt(sampleIndex);
+
+        if (!mOffsetsAreAbsolute) {
+            *offset = info.mOffset + mMovieOffset + 8;
+        } else {
+            *offset = info.mOffset;
+        }
+
+        *isKey = info.mIsKey;
+
+        return OK;
+    }
+
+    // Find the segment covering the sample.
+    size_t lo = 0;
+    size_t hi = track->mIndexSegments.size();
+    while (hi - lo > 1) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (track->mIndexSegments.itemAt(mid).mFirstSample <= sampleIndex) {
+            lo = mid;
+        } else {
+            hi = mid;
+        }
+    }
+
+    if (track->mLoadedSegment != (ssize_t)lo) {
+        status_t err = loadIndexSegment(track, lo);
 
-    if (sampleIndex >= track.mSamples.size()) {
+        if (err != OK) {
+            return err;
+        }
+    }
+
+    const IndexSegment &segment = track->mIndexSegments.itemAt(lo);
+    const SampleInfo &info =
+        track->mSamples.itemAt(sampleIndex - segment.mFirstSample);
+
+    // Standard index entries point past the chunk header.
+    *offset = segment.mBaseOffset + info.mOffset - 8;
+    *isKey = info.mIsKey;
+
+    return OK;
+}
+
+status_t AVIExtractor::getSampleInfo_l(
+        size_t trackIndex, size_t sampleIndex,
+        off64_t *offset, size_t *size, bool *isKey,
+        int64_t *sampleTimeUs) {
+    if (trackIndex >= mTracks.size()) {
         return -ERANGE;
     }
 
-    const SampleInfo &info = track.mSamples.itemAt(sampleIndex);
+    const Track &track = mTracks.itemAt(trackIndex);
 
-    if (!mOffsetsAreAbsolute) {
-        *offset = info.mOffset + mMovieOffset + 8;
-    } else {
-        *offset = info.mOffset;
+    status_t err = getSampleEntry_l(
+            &mTracks.editItemAt(trackIndex), sampleIndex, offset, isKey);
+
+    if (err != OK) {
+        return err;
     }
 
     *size = 0;
@@ -1156,8 +1472,6 @@ status_t AVIExtractor::getSampleInfo(
     *offset += 8;
     *size = U32LE_AT(&tmp[4]);
 
-    *isKey = info.mIsKey;
-
     if (track.mBytesPerSample > 0) {
         size_t sampleStartInBytes;
         if (sampleIndex == 0) {
@@ -1187,12 +1501,14 @@ status_t AVIExtractor::getSampleTime(
 status_t AVIExtractor::getSampleIndexAtTime(
         size_t trackIndex,
         int64_t timeUs, MediaSource::ReadOptions::SeekMode mode,
-        size_t *sampleIndex) const {
+        size_t *sampleIndex) {
+    Mutex::Autolock autoLock(mLock);
+
     if (trackIndex >= mTracks.size()) {
         return -ERANGE;
     }
 
-    const Track &track = mTracks.itemAt(trackIndex);
+    Track &track = mTracks.editItemAt(trackIndex);
 
     ssize_t closestSampleIndex;
 
@@ -1213,7 +1529,7 @@ status_t AVIExtractor::getSampleIndexAtTime(
         closestSampleIndex = timeUs / track.mRate * track.mScale / 1000000ll;
     }
 
-    ssize_t numSamples = track.mSamples.size();
+    ssize_t numSamples = track.mNumSamples;
 
     if (closestSampleIndex < 0) {
         closestSampleIndex = 0;
@@ -1227,12 +1543,19 @@ status_t AVIExtractor::getSampleIndexAtTime(
         return OK;
     }
 
+    off64_t offset;
+    bool isKey;
+
     ssize_t prevSyncSampleIndex = closestSampleIndex;
     while (prevSyncSampleIndex >= 0) {
-        const SampleInfo &info =
-            track.mSamples.itemAt(prevSyncSampleIndex);
+        status_t err =
+            getSampleEntry_l(&track, prevSyncSampleIndex, &offset, &isKey);
 
-        if (info.mIsKey) {
+        if (err != OK) {
+            return err;
+        }
+
+        if (isKey) {
             break;
         }
 
@@ -1241,10 +1564,14 @@ status_t AVIExtractor::getSampleIndexAtTime(
 
     ssize_t nextSyncSampleIndex = closestSampleIndex;
     while (nextSyncSampleIndex < numSamples) {
-        const SampleInfo &info =
-            track.mSamples.itemAt(nextSyncSampleIndex);
+        status_t err =
+            getSampleEntry_l(&track, nextSyncSampleIndex, &offset, &isKey);
+
+        if (err != OK) {
+            return err;
+        }
 
-        if (info.mIsKey) {
+        if (isKey) {
             break;
         }
 
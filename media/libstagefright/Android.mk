@@ -57,11 +57,15 @@ LOCAL_SRC_FILES:=                         \
         CameraSource.cpp                  \
         CameraSourceTimeLapse.cpp         \
         DataSource.cpp                    \
+        DecodeAheadSource.cpp             \
         DRMExtractor.cpp                  \
         ESDS.cpp                          \
         FileSource.cpp                    \
         FLACExtractor.cpp                 \
+        FrameOffsetIndex.cpp              \
+        FrameScanSeeker.cpp               \
         HTTPBase.cpp                      \
+        JPEGDecoder.cpp                   \
         JPEGSource.cpp                    \
         MP3Extractor.cpp                  \
         MPEG2TSWriter.cpp                 \
@@ -86,6 +90,7 @@ LOCAL_SRC_FILES:=                         \
         StagefrightMediaScanner.cpp       \
         StagefrightMetadataRetriever.cpp  \
         SurfaceMediaSource.cpp            \
+        TeeSource.cpp                     \
         ThrottledSource.cpp               \
         TimeSource.cpp                    \
         TimedEventQueue.cpp               \
@@ -124,6 +129,7 @@ LOCAL_C_INCLUDES:= \
         $(TOP)/frameworks/native/include/media/openmax \
         $(TOP)/external/expat/lib \
         $(TOP)/external/flac/include \
+        $(TOP)/external/jpeg \
         $(TOP)/external/tremolo \
         $(TOP)/external/openssl/include \
         $(TOP)/hardware/qcom/display/libgralloc \
@@ -142,6 +148,7 @@ LOCAL_SHARED_LIBRARIES := \
         libgui \
         libicui18n \
         libicuuc \
+        libjpeg \
         liblog \
         libmedia \
         libmedia_native \
@@ -19,7 +19,11 @@
 #define LOG_TAG "AudioPlayer"
 #include <utils/Log.h>
 
+#include <sched.h>
+#include <sys/prctl.h>
+
 #include <binder/IPCThreadState.h>
+#include <cutils/atomic.h>
 #include <media/AudioTrack.h>
 #include <media/stagefright/foundation/ADebug.h>
 #include <media/stagefright/foundation/ALooper.h>
@@ -49,6 +53,7 @@ AudioPlayer::AudioPlayer(
       mSeeking(false),
       mReachedEOS(false),
       mFinalStatus(OK),
+      mSeekTimeUs(0),
       mStarted(false),
 #ifdef QCOM_HARDWARE
       mSourcePaused(false),
@@ -59,7 +64,18 @@ AudioPlayer::AudioPlayer(
       mAudioSink(audioSink),
       mAllowDeepBuffering(allowDeepBuffering),
       mObserver(observer),
-      mPinnedTimeUs(-1ll) {
+      mPinnedTimeUs(-1ll),
+      mTimeMappingSeq(0),
+      mPrefetchStarted(false),
+      mPrefetchDone(false),
+      mPrefetchReading(false),
+      mPrefetchSeeking(false),
+      mPrefetchReachedEOS(false),
+      mPrefetchReady(false),
+      mPrefetchedBuffer(NULL),
+      mPrefetchResult(OK) {
+    Mutex::Autolock autoLock(mLock);
+    publishTimeMapping_l();
 }
 
 AudioPlayer::~AudioPlayer() {
@@ -110,8 +126,10 @@ status_t AudioPlayer::start(bool sourceAlreadyStarted) {
         mFirstBufferResult = OK;
         mIsFirstBuffer = false;
     } else if(mFirstBufferResult != OK) {
+        Mutex::Autolock autoLock(mLock);
         mReachedEOS = true;
         mFinalStatus = mFirstBufferResult;
+        publishTimeMapping_l();
         return mFirstBufferResult;
     } else {
         mIsFirstBuffer = true;
@@ -163,6 +181,10 @@ status_t AudioPlayer::start(bool sourceAlreadyStarted) {
         mLatencyUs = (int64_t)mAudioSink->latency() * 1000;
         mFrameSize = mAudioSink->frameSize();
 
+        // Before the first callback, which would otherwise read mSource
+        // itself.
+        startPrefetch();
+
         mAudioSink->start();
     } else {
         // playing to an AudioTrack, set up mask if necessary
@@ -195,11 +217,17 @@ status_t AudioPlayer::start(bool sourceAlreadyStarted) {
         mLatencyUs = (int64_t)mAudioTrack->latency() * 1000;
         mFrameSize = mAudioTrack->frameSize();
 
+        startPrefetch();
+
         mAudioTrack->start();
     }
 
-    mStarted = true;
-    mPinnedTimeUs = -1ll;
+    {
+        Mutex::Autolock autoLock(mLock);
+        mStarted = true;
+        mPinnedTimeUs = -1ll;
+        publishTimeMapping_l();
+    }
 
     return OK;
 }
@@ -214,8 +242,10 @@ void AudioPlayer::pause(bool playPendingSamples) {
             mAudioTrack->stop();
         }
 
+        Mutex::Autolock autoLock(mLock);
         mNumFramesPlayed = 0;
         mNumFramesPlayedSysTimeUs = ALooper::GetNowUs();
+        publishTimeMapping_l();
     } else {
         if (mAudioSink.get() != NULL) {
             mAudioSink->pause();
@@ -223,7 +253,9 @@ void AudioPlayer::pause(bool playPendingSamples) {
             mAudioTrack->pause();
         }
 
+        Mutex::Autolock autoLock(mLock);
         mPinnedTimeUs = ALooper::GetNowUs();
+        publishTimeMapping_l();
     }
 #ifdef QCOM_HARDWARE
     CHECK(mSource != NULL);
@@ -277,6 +309,8 @@ void AudioPlayer::reset() {
         mInputBuffer = NULL;
     }
 
+    stopPrefetch();
+
 #ifdef QCOM_HARDWARE
     mSourcePaused = false;
 #endif
@@ -292,6 +326,7 @@ void AudioPlayer::reset() {
     }
     IPCThreadState::self()->flushCommands();
 
+    Mutex::Autolock autoLock(mLock);
     mNumFramesPlayed = 0;
     mNumFramesPlayedSysTimeUs = ALooper::GetNowUs();
     mPositionTimeMediaUs = -1;
@@ -300,6 +335,7 @@ void AudioPlayer::reset() {
     mReachedEOS = false;
     mFinalStatus = OK;
     mStarted = false;
+    publishTimeMapping_l();
 }
 
 // static
@@ -431,7 +467,7 @@ size_t AudioPlayer::fillBuffer(void *data, size_t size) {
 
                 mIsFirstBuffer = false;
             } else {
-                err = mSource->read(&mInputBuffer, &options);
+                err = readSource(&mInputBuffer, options);
             }
 
             CHECK((err == OK && mInputBuffer != NULL)
@@ -478,6 +514,7 @@ size_t AudioPlayer::fillBuffer(void *data, size_t size) {
 
                 mReachedEOS = true;
                 mFinalStatus = err;
+                publishTimeMapping_l();
                 break;
             }
 
@@ -494,6 +531,8 @@ size_t AudioPlayer::fillBuffer(void *data, size_t size) {
                 ((mNumFramesPlayed + size_done / mFrameSize) * 1000000)
                     / mSampleRate;
 
+            publishTimeMapping_l();
+
             ALOGV("buffer->size() = %d, "
                  "mPositionTimeMediaUs=%.2f mPositionTimeRealUs=%.2f",
                  mInputBuffer->range_length(),
@@ -521,6 +560,13 @@ size_t AudioPlayer::fillBuffer(void *data, size_t size) {
 
         size_done += copy;
         size_remaining -= copy;
+
+        // Hand the buffer back right away, sources with a single output
+        // buffer can only decode ahead once it is returned.
+        if (mInputBuffer->range_length() == 0) {
+            mInputBuffer->release();
+            mInputBuffer = NULL;
+        }
     }
 
     {
@@ -533,6 +579,8 @@ size_t AudioPlayer::fillBuffer(void *data, size_t size) {
             mNumFramesPlayedSysTimeUs = ALooper::GetNowUs();
             mPinnedTimeUs = -1ll;
         }
+
+        publishTimeMapping_l();
     }
 
     if (postEOS) {
@@ -547,64 +595,70 @@ size_t AudioPlayer::fillBuffer(void *data, size_t size) {
 }
 
 int64_t AudioPlayer::getRealTimeUs() {
-    Mutex::Autolock autoLock(mLock);
-    return getRealTimeUsLocked();
+    TimeMapping mapping;
+    readTimeMapping(&mapping);
+    return getRealTimeUs(mapping);
 }
 
-int64_t AudioPlayer::getRealTimeUsLocked() const {
+int64_t AudioPlayer::getRealTimeUs(const TimeMapping &mapping) const {
     CHECK(mStarted);
     CHECK_NE(mSampleRate, 0);
-    int64_t result = -mLatencyUs + (mNumFramesPlayed * 1000000) / mSampleRate;
+    int64_t result = -mapping.mLatencyUs
+        + (mapping.mNumFramesPlayed * 1000000) / mSampleRate;
 
     // Compensate for large audio buffers, updates of mNumFramesPlayed
     // are less frequent, therefore to get a "smoother" notion of time we
     // compensate using system time.
     int64_t diffUs;
-    if (mPinnedTimeUs >= 0ll) {
-        if(mReachedEOS)
+    if (mapping.mPinnedTimeUs >= 0ll) {
+        if(mapping.mReachedEOS)
             diffUs = ALooper::GetNowUs();
         else
-            diffUs = mPinnedTimeUs;
+            diffUs = mapping.mPinnedTimeUs;
 
     } else {
         diffUs = ALooper::GetNowUs();
     }
 
-    diffUs -= mNumFramesPlayedSysTimeUs;
+    diffUs -= mapping.mNumFramesPlayedSysTimeUs;
 
-    if(result + diffUs <= mPositionTimeRealUs)
+    if(result + diffUs <= mapping.mPositionTimeRealUs)
         return result + diffUs;
     else
-        return mPositionTimeRealUs;
+        return mapping.mPositionTimeRealUs;
 }
 
 int64_t AudioPlayer::getMediaTimeUs() {
-    Mutex::Autolock autoLock(mLock);
+    TimeMapping mapping;
+    readTimeMapping(&mapping);
 
-    if (mPositionTimeMediaUs < 0 || mPositionTimeRealUs < 0) {
-        if (mSeeking) {
-            return mSeekTimeUs;
+    if (mapping.mPositionTimeMediaUs < 0 || mapping.mPositionTimeRealUs < 0) {
+        if (mapping.mSeeking) {
+            return mapping.mSeekTimeUs;
         }
 
         return 0;
     }
 
-    int64_t realTimeOffset = getRealTimeUsLocked() - mPositionTimeRealUs;
+    int64_t realTimeOffset =
+        getRealTimeUs(mapping) - mapping.mPositionTimeRealUs;
     if (realTimeOffset < 0) {
         realTimeOffset = 0;
     }
 
-    return mPositionTimeMediaUs + realTimeOffset;
+    return mapping.mPositionTimeMediaUs + realTimeOffset;
 }
 
 bool AudioPlayer::getMediaTimeMapping(
         int64_t *realtime_us, int64_t *mediatime_us) {
-    Mutex::Autolock autoLock(mLock);
+    TimeMapping mapping;
+    readTimeMapping(&mapping);
 
-    *realtime_us = mPositionTimeRealUs;
-    *mediatime_us = mPositionTimeMediaUs;
+    *realtime_us = mapping.mPositionTimeRealUs;
+    *mediatime_us = mapping.mPositionTimeMediaUs;
 
-    return mPositionTimeRealUs != -1 && mPositionTimeMediaUs != -1;
+    return mapping.mPositionTimeRealUs != -1
+        && mapping.mPositionTimeMediaUs != -1;
 }
 
 status_t AudioPlayer::seekTo(int64_t time_us) {
@@ -619,6 +673,8 @@ status_t AudioPlayer::seekTo(int64_t time_us) {
     mNumFramesPlayed = 0;
     mNumFramesPlayedSysTimeUs = ALooper::GetNowUs();
 
+    publishTimeMapping_l();
+
     if (mAudioSink != NULL) {
         mAudioSink->flush();
     } else {
@@ -628,4 +684,195 @@ status_t AudioPlayer::seekTo(int64_t time_us) {
     return OK;
 }
 
+void AudioPlayer::publishTimeMapping_l() {
+    // Odd while the copy is inconsistent.
+    int32_t seq = android_atomic_inc(&mTimeMappingSeq) + 1;
+    android_memory_barrier();
+
+    mTimeMapping.mNumFramesPlayed = mNumFramesPlayed;
+    mTimeMapping.mNumFramesPlayedSysTimeUs = mNumFramesPlayedSysTimeUs;
+    mTimeMapping.mPinnedTimeUs = mPinnedTimeUs;
+    mTimeMapping.mPositionTimeMediaUs = mPositionTimeMediaUs;
+    mTimeMapping.mPositionTimeRealUs = mPositionTimeRealUs;
+    mTimeMapping.mLatencyUs = mLatencyUs;
+    mTimeMapping.mSeekTimeUs = mSeekTimeUs;
+    mTimeMapping.mSeeking = mSeeking;
+    mTimeMapping.mReachedEOS = mReachedEOS;
+
+    android_atomic_release_store(seq + 1, &mTimeMappingSeq);
+}
+
+void AudioPlayer::readTimeMapping(TimeMapping *mapping) const {
+    for (;;) {
+        int32_t seq = android_atomic_acquire_load(&mTimeMappingSeq);
+        if ((seq & 1) == 0) {
+            *mapping = mTimeMapping;
+            android_memory_barrier();
+
+            if (android_atomic_acquire_load(&mTimeMappingSeq) == seq) {
+                return;
+            }
+        }
+
+        // The writer only holds the copy for a handful of stores.
+        sched_yield();
+    }
+}
+
+void AudioPlayer::startPrefetch() {
+    CHECK(!mPrefetchStarted);
+
+    mPrefetchDone = false;
+    mPrefetchReading = false;
+    mPrefetchSeeking = false;
+    mPrefetchReachedEOS = mReachedEOS;
+    mPrefetchReady = false;
+
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_JOINABLE);
+
+    pthread_create(&mPrefetchThread, &attr, PrefetchThreadWrapper, this);
+
+    pthread_attr_destroy(&attr);
+
+    mPrefetchStarted = true;
+}
+
+void AudioPlayer::stopPrefetch() {
+    if (!mPrefetchStarted) {
+        return;
+    }
+
+    {
+        Mutex::Autolock autoLock(mPrefetchLock);
+        mPrefetchDone = true;
+
+        // Hand the decoded buffer back so that a read blocked in the
+        // decoder can complete.
+        flushPrefetch_l();
+        mPrefetchCondition.broadcast();
+    }
+
+    void *dummy;
+    pthread_join(mPrefetchThread, &dummy);
+
+    Mutex::Autolock autoLock(mPrefetchLock);
+    flushPrefetch_l();
+
+    mPrefetchStarted = false;
+}
+
+void AudioPlayer::flushPrefetch_l() {
+    if (mPrefetchedBuffer != NULL) {
+        mPrefetchedBuffer->release();
+        mPrefetchedBuffer = NULL;
+    }
+    mPrefetchReady = false;
+}
+
+status_t AudioPlayer::readSource(
+        MediaBuffer **buffer, const MediaSource::ReadOptions &options) {
+    *buffer = NULL;
+
+    if (!mPrefetchStarted) {
+        return mSource->read(buffer, &options);
+    }
+
+    Mutex::Autolock autoLock(mPrefetchLock);
+
+    int64_t seekTimeUs;
+    MediaSource::ReadOptions::SeekMode mode;
+    if (options.getSeekTo(&seekTimeUs, &mode)) {
+        mPrefetchSeeking = true;
+
+        flushPrefetch_l();
+        while (mPrefetchReading) {
+            mPrefetchCondition.wait(mPrefetchLock);
+        }
+
+        // The read that was in flight was discarded by the thread.
+        flushPrefetch_l();
+
+        mPrefetchLock.unlock();
+        status_t err = mSource->read(buffer, &options);
+        mPrefetchLock.lock();
+
+        mPrefetchSeeking = false;
+        mPrefetchReachedEOS = (err != OK);
+        mPrefetchCondition.broadcast();
+
+        return err;
+    }
+
+    while (!mPrefetchReady && !mPrefetchReachedEOS) {
+        mPrefetchCondition.wait(mPrefetchLock);
+    }
+
+    if (!mPrefetchReady) {
+        return mPrefetchResult;
+    }
+
+    *buffer = mPrefetchedBuffer;
+    mPrefetchedBuffer = NULL;
+    mPrefetchReady = false;
+    mPrefetchCondition.broadcast();
+
+    return mPrefetchResult;
+}
+
+// static
+void *AudioPlayer::PrefetchThreadWrapper(void *me) {
+    androidSetThreadPriority(0, ANDROID_PRIORITY_AUDIO);
+
+    static_cast<AudioPlayer *>(me)->prefetchThreadEntry();
+
+    return NULL;
+}
+
+void AudioPlayer::prefetchThreadEntry() {
+    prctl(PR_SET_NAME, (unsigned long)"AudioPrefetch", 0, 0, 0);
+
+    Mutex::Autolock autoLock(mPrefetchLock);
+
+    for (;;) {
+        while (!mPrefetchDone
+                && (mPrefetchSeeking || mPrefetchReachedEOS || mPrefetchReady)) {
+            mPrefetchCondition.wait(mPrefetchLock);
+        }
+
+        if (mPrefetchDone) {
+            break;
+        }
+
+        mPrefetchReading = true;
+
+        MediaBuffer *buffer = NULL;
+
+        mPrefetchLock.unlock();
+        status_t err = mSource->read(&buffer);
+        mPrefetchLock.lock();
+
+        mPrefetchReading = false;
+        mPrefetchCondition.broadcast();
+
+        if (mPrefetchSeeking || mPrefetchDone) {
+            if (buffer != NULL) {
+                buffer->release();
+            }
+            continue;
+        }
+
+        mPrefetchedBuffer = buffer;
+        mPrefetchResult = err;
+        mPrefetchReady = true;
+
+        if (err != OK) {
+            mPrefetchReachedEOS = true;
+        }
+
+        mPrefetchCondition.broadcast();
+    }
+}
+
 }
@@ -61,7 +61,10 @@ AudioSource::AudioSource(
       mSampleRate(sampleRate),
       mPrevSampleTimeUs(0),
       mNumFramesReceived(0),
-      mNumClientOwnedBuffers(0)
+      mNumClientOwnedBuffers(0),
+      mBatchSizeBytes(0),
+      mPendingBuffer(NULL),
+      mPendingBufferTimeUs(0)
 #ifdef QCOM_HARDWARE
       ,mFormat(AUDIO_FORMAT_PCM_16_BIT),
       mMime(MEDIA_MIMETYPE_AUDIO_RAW) 
@@ -116,6 +119,9 @@ AudioSource::AudioSource(
                     this,
                     frameCount);
         mInitCheck = mRecord->initCheck();
+        if (mInitCheck == OK) {
+            initBatching();
+        }
     } else {
         mInitCheck = status;
     }
@@ -127,6 +133,9 @@ AudioSource::AudioSource( audio_source_t inputSource, const sp<MetaData>& meta )
       mPrevSampleTimeUs(0),
       mNumFramesReceived(0),
       mNumClientOwnedBuffers(0),
+      mBatchSizeBytes(0),
+      mPendingBuffer(NULL),
+      mPendingBufferTimeUs(0),
       mFormat(AUDIO_FORMAT_PCM_16_BIT),
       mMime(MEDIA_MIMETYPE_AUDIO_RAW) {
 
@@ -175,6 +184,40 @@ AudioSource::AudioSource( audio_source_t inputSource, const sp<MetaData>& meta )
     mInitCheck = mRecord->initCheck();
 }
 #endif
+void AudioSource::initBatching() {
+    char value[PROPERTY_VALUE_MAX];
+    if (!property_get("media.stagefright.audio-batch-ms", value, NULL)) {
+        return;
+    }
+
+    int32_t batchDurationMs = atoi(value);
+    if (batchDurationMs <= 0) {
+        return;
+    }
+    if (batchDurationMs > kMaxBatchDurationMs) {
+        batchDurationMs = kMaxBatchDurationMs;
+    }
+
+#ifdef QCOM_HARDWARE
+    const size_t maxCallbackSize = mMaxBufferSize;
+#else
+    const size_t maxCallbackSize = kMaxBufferSize;
+#endif
+    const size_t frameSize = mRecord->frameSize();
+    const size_t batchSize =
+        ((int64_t)mSampleRate * batchDurationMs / 1000) * frameSize;
+
+    // Batches no larger than a single callback buffer would not save
+    // anything over queueing each callback buffer as is.
+    if (batchSize <= maxCallbackSize) {
+        return;
+    }
+
+    mBatchSizeBytes = batchSize;
+    ALOGI("Batching audio capture into %d byte buffers (%d ms)",
+            mBatchSizeBytes, batchDurationMs);
+}
+
 AudioSource::~AudioSource() {
     if (mStarted) {
         reset();
@@ -228,6 +271,21 @@ void AudioSource::releaseQueuedFrames_l() {
     }
 }
 
+void AudioSource::releaseFreeBuffers_l() {
+    ALOGV("releaseFreeBuffers_l");
+    if (mPendingBuffer != NULL) {
+        mFreeBuffers.push(mPendingBuffer);
+        mPendingBuffer = NULL;
+    }
+
+    for (size_t i = 0; i < mFreeBuffers.size(); ++i) {
+        MediaBuffer *buffer = mFreeBuffers.itemAt(i);
+        buffer->setObserver(0);
+        buffer->release();
+    }
+    mFreeBuffers.clear();
+}
+
 void AudioSource::waitOutstandingEncodingFrames_l() {
     ALOGV("waitOutstandingEncodingFrames_l: %lld", mNumClientOwnedBuffers);
     while (mNumClientOwnedBuffers > 0) {
@@ -249,6 +307,7 @@ status_t AudioSource::reset() {
     mRecord->stop();
     waitOutstandingEncodingFrames_l();
     releaseQueuedFrames_l();
+    releaseFreeBuffers_l();
 
     return OK;
 }
@@ -264,11 +323,13 @@ sp<MetaData> AudioSource::getFormat() {
 #ifdef QCOM_HARDWARE
     meta->setCString(kKeyMIMEType, mMime);
     meta->setInt32(kKeySampleRate, mRecord->getSampleRate());
-    meta->setInt32(kKeyMaxInputSize, mMaxBufferSize);
+    meta->setInt32(kKeyMaxInputSize,
+            mBatchSizeBytes > 0 ? mBatchSizeBytes : mMaxBufferSize);
 #else
     meta->setCString(kKeyMIMEType, MEDIA_MIMETYPE_AUDIO_RAW);
     meta->setInt32(kKeySampleRate, mSampleRate);
-    meta->setInt32(kKeyMaxInputSize, kMaxBufferSize);
+    meta->setInt32(kKeyMaxInputSize,
+            mBatchSizeBytes > 0 ? mBatchSizeBytes : kMaxBufferSize);
 #endif
     return meta;
 }
@@ -369,8 +430,14 @@ void AudioSource::signalBufferReturned(MediaBuffer *buffer) {
     ALOGV("signalBufferReturned: %p", buffer->data());
     Mutex::Autolock autoLock(mLock);
     --mNumClientOwnedBuffers;
-    buffer->setObserver(0);
-    buffer->release();
+    if (mBatchSizeBytes > 0) {
+        // Keep the batch buffer around for reuse, it is freed on reset().
+        buffer->meta_data()->clear();
+        mFreeBuffers.push(buffer);
+    } else {
+        buffer->setObserver(0);
+        buffer->release();
+    }
     mFrameEncodingCompletionCondition.signal();
     return;
 }
@@ -420,6 +487,18 @@ status_t AudioSource::dataCallbackTimestamp(
         ALOGW("Lost audio record data: %d bytes", numLostBytes);
     }
 
+    if (mBatchSizeBytes > 0) {
+        // Lost data is filled with silence inside the current batch.
+        batchInputData_l(NULL, numLostBytes, timeUs);
+        if (audioBuffer.size == 0) {
+            ALOGW("Nothing is available from AudioRecord callback buffer");
+            return OK;
+        }
+        batchInputData_l(
+                (const uint8_t *) audioBuffer.i16, audioBuffer.size, timeUs);
+        return OK;
+    }
+
     while (numLostBytes > 0) {
         size_t bufferSize = numLostBytes;
         if (numLostBytes > kMaxBufferSize) {
@@ -448,6 +527,44 @@ status_t AudioSource::dataCallbackTimestamp(
     return OK;
 }
 
+void AudioSource::batchInputData_l(
+        const uint8_t *data, size_t size, int64_t timeUs) {
+    while (size > 0) {
+        if (mPendingBuffer == NULL) {
+            if (mFreeBuffers.isEmpty()) {
+                mPendingBuffer = new MediaBuffer(mBatchSizeBytes);
+            } else {
+                mPendingBuffer = mFreeBuffers.top();
+                mFreeBuffers.pop();
+            }
+            mPendingBuffer->set_range(0, 0);
+            mPendingBufferTimeUs = timeUs;
+        }
+
+        const size_t offset = mPendingBuffer->range_length();
+        size_t copy = mBatchSizeBytes - offset;
+        if (copy > size) {
+            copy = size;
+        }
+
+        uint8_t *dst = (uint8_t *) mPendingBuffer->data() + offset;
+        if (data != NULL) {
+            memcpy(dst, data, copy);
+            data += copy;
+        } else {
+            memset(dst, 0, copy);
+        }
+        mPendingBuffer->set_range(0, offset + copy);
+        size -= copy;
+
+        if (offset + copy == mBatchSizeBytes) {
+            MediaBuffer *buffer = mPendingBuffer;
+            mPendingBuffer = NULL;
+            queueInputBuffer_l(buffer, mPendingBufferTimeUs);
+        }
+    }
+}
+
 void AudioSource::queueInputBuffer_l(MediaBuffer *buffer, int64_t timeUs) {
     const size_t bufferSize = buffer->range_length();
     const size_t frameSize = mRecord->frameSize();
@@ -462,9 +579,12 @@ void AudioSource::queueInputBuffer_l(MediaBuffer *buffer, int64_t timeUs) {
     }
     timestampUs += recordDurationUs;
 #else
+    // Derive the timestamp from the total number of frames received
+    // rather than accumulating rounded per-buffer durations, so that the
+    // rounding error does not build up over a long recording.
     const int64_t timestampUs =
-                 mPrevSampleTimeUs +
-                     ((1000000LL * (bufferSize / frameSize)) +
+                 mStartTimeUs +
+                     ((1000000LL * (mNumFramesReceived + bufferSize / frameSize)) +
                         (mSampleRate >> 1)) / mSampleRate;
 #endif
     if (mNumFramesReceived == 0) {
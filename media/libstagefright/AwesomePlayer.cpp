@@ -26,8 +26,10 @@ Copyright (c) 2012, Code Aurora Forum. All rights reserved.
 #include <utils/Trace.h>
 
 #include <dlfcn.h>
+#include <pthread.h>
 
 #include "include/AwesomePlayer.h"
+#include "include/DecodeAheadSource.h"
 #include "include/DRMExtractor.h"
 #include "include/SoftwareRenderer.h"
 #include "include/NuCachedSource2.h"
@@ -40,6 +42,7 @@ Copyright (c) 2012, Code Aurora Forum. All rights reserved.
 #include <media/IMediaPlayerService.h>
 #include <media/stagefright/foundation/hexdump.h>
 #include <media/stagefright/foundation/ADebug.h>
+#include <media/stagefright/foundation/ALooper.h>
 #include <media/stagefright/timedtext/TimedTextDriver.h>
 #include <media/stagefright/AudioPlayer.h>
 #ifdef QCOM_HARDWARE
@@ -82,6 +85,14 @@ static const size_t kHighWaterMarkBytes = 200000;
 static int64_t kVideoEarlyMarginUs = -10000LL;   //50 ms
 static int64_t kVideoLateMarginUs = 100000LL;  //100 ms
 static int64_t kVideoTooLateMarginUs = 500000LL;
+
+// Decoded video frames queued ahead of the video event, unless overridden
+// with media.stagefright.decode-ahead, 0 reads from the decoder directly.
+static const int32_t kNumDecodeAheadFrames = 2;
+
+// The periodic buffering and video lag checks may fire this late, so that
+// they usually share a wakeup with a video event.
+static const int64_t kPeriodicCheckSlackUs = 100000ll;
 #ifdef QCOM_HARDWARE
 int AwesomePlayer::mTunnelAliveAP = 0;
 #endif
@@ -648,6 +659,14 @@ void AwesomePlayer::reset_l() {
         mStats.mNumVideoFramesDecoded = 0;
         mStats.mNumVideoFramesDropped = 0;
 #endif
+        mStats.mVideoDecodeTimeUs = 0;
+        mStats.mVideoLatenessUs = 0;
+        mStats.mMaxVideoLatenessUs = 0;
+        mStats.mNumRebuffers = 0;
+        mStats.mRebufferTimeUs = 0;
+        mStats.mRebufferStartUs = -1;
+        mStats.mCachedBytes = -1;
+        mStats.mCachedDurationUs = -1;
         mStats.mVideoWidth = -1;
         mStats.mVideoHeight = -1;
         mStats.mFlags = 0;
@@ -768,6 +787,11 @@ void AwesomePlayer::onBufferingUpdate() {
         size_t cachedDataRemaining = mCachedSource->approxDataRemaining(&finalStatus);
         bool eos = (finalStatus != OK);
 
+        {
+            Mutex::Autolock autoLock(mStatsLock);
+            mStats.mCachedBytes = cachedDataRemaining;
+        }
+
         if (eos) {
             if (finalStatus == ERROR_END_OF_STREAM) {
 #ifdef QCOM_HARDWARE
@@ -876,6 +900,14 @@ void AwesomePlayer::onBufferingUpdate() {
         ALOGV("cachedDurationUs = %.2f secs, eos=%d",
              cachedDurationUs / 1E6, eos);
 
+        {
+            Mutex::Autolock autoLock(mStatsLock);
+            mStats.mCachedDurationUs = cachedDurationUs;
+        }
+
+        int64_t highWaterMarkUs = (mFlags & PREPARING)
+            ? getPrepareWaterMarkUs_l() : kHighWaterMarkUs;
+
         if ((mFlags & PLAYING) && !eos
                 && (cachedDurationUs < kLowWaterMarkUs)) {
             modifyFlags(CACHE_UNDERRUN, SET);
@@ -887,7 +919,7 @@ void AwesomePlayer::onBufferingUpdate() {
                 sendCacheStats();
             }
             notifyListener_l(MEDIA_INFO, MEDIA_INFO_BUFFERING_START);
-        } else if (eos || cachedDurationUs > kHighWaterMarkUs) {
+        } else if (eos || cachedDurationUs > highWaterMarkUs) {
             if (mFlags & CACHE_UNDERRUN) {
                 modifyFlags(CACHE_UNDERRUN, CLEAR);
                 if (mWVMExtractor == NULL) {
@@ -913,6 +945,26 @@ void AwesomePlayer::onBufferingUpdate() {
 #endif
 }
 
+// Before playback starts, the bandwidth earlier streams measured on this
+// network tells how much needs to be buffered to play through: less than
+// usual when it's well above the bitrate, more when it's below.
+int64_t AwesomePlayer::getPrepareWaterMarkUs_l() {
+    int64_t bitrate;
+    int32_t bandwidthBps;
+    if (mCachedSource == NULL || !getBitrate(&bitrate) || bitrate <= 0
+            || !HTTPBase::GetNetworkBandwidthEstimate(&bandwidthBps)) {
+        return kHighWaterMarkUs;
+    }
+
+    if (bandwidthBps >= 2 * bitrate) {
+        return (kLowWaterMarkUs + kHighWaterMarkUs) / 2;
+    } else if (bandwidthBps < bitrate) {
+        return 2 * kHighWaterMarkUs;
+    }
+
+    return kHighWaterMarkUs;
+}
+
 void AwesomePlayer::sendCacheStats() {
     sp<MediaPlayerBase> listener = mListener.promote();
     if (listener != NULL && mCachedSource != NULL) {
@@ -1646,7 +1698,7 @@ status_t AwesomePlayer::initAudioDecoder() {
             ((!strcasecmp(mime, MEDIA_MIMETYPE_AUDIO_MPEG)) ||
             (!strcasecmp(mime,MEDIA_MIMETYPE_AUDIO_AAC)))) {
 
-        if(mVideoSource != NULL) {
+        if(mVideoTrack != NULL) {
            char tunnelAVDecode[128];
            property_get("tunnel.audiovideo.decode",tunnelAVDecode,"0");
            if(((strncmp("true", tunnelAVDecode, 4) == 0)||(atoi(tunnelAVDecode)))) {
@@ -1679,12 +1731,13 @@ status_t AwesomePlayer::initAudioDecoder() {
         char lpaDecode[128];
         property_get("lpa.decode",lpaDecode,"0");
         if (mAudioTrack->getFormat()->findInt64(kKeyDuration, &durationUs)) {
+            Mutex::Autolock autoLock(mMiscStateLock);
             if (mDurationUs < 0 || durationUs > mDurationUs) {
                 mDurationUs = durationUs;
             }
         }
         if ((!strcasecmp(mime, MEDIA_MIMETYPE_AUDIO_MPEG) || !strcasecmp(mime,MEDIA_MIMETYPE_AUDIO_AAC))
-             && LPAPlayer::objectsAlive == 0 && mVideoSource == NULL && (strcmp("true",lpaDecode) == 0)) {
+             && LPAPlayer::objectsAlive == 0 && mVideoTrack == NULL && (strcmp("true",lpaDecode) == 0)) {
 
             flags |= OMXCodec::kSoftwareCodecsOnly;
         }
@@ -1796,6 +1849,21 @@ status_t AwesomePlayer::initVideoDecoder(uint32_t flags) {
             mVideoTrack,
             NULL, flags, USE_SURFACE_ALLOC ? mNativeWindow : NULL);
 
+    if (mVideoSource != NULL) {
+        // Keep a couple of frames decoded ahead of the video event so that
+        // a slow decode is absorbed before the frame is due.
+        int32_t numDecodeAheadFrames = kNumDecodeAheadFrames;
+        char value[PROPERTY_VALUE_MAX];
+        if (property_get("media.stagefright.decode-ahead", value, NULL)) {
+            numDecodeAheadFrames = atoi(value);
+        }
+
+        if (numDecodeAheadFrames > 0) {
+            mVideoSource =
+                new DecodeAheadSource(mVideoSource, numDecodeAheadFrames);
+        }
+    }
+
     if (mVideoSource != NULL) {
         int64_t durationUs;
         if (mVideoTrack->getFormat()->findInt64(kKeyDuration, &durationUs)) {
@@ -1968,6 +2036,9 @@ void AwesomePlayer::onVideoEvent() {
                         ? MediaSource::ReadOptions::SEEK_NEXT_SYNC
                         : MediaSource::ReadOptions::SEEK_CLOSEST_SYNC);
         }
+        ScopedTrace trace(ATRACE_TAG, "AwesomePlayer::readVideo");
+
+        int64_t decodeStartUs = ALooper::GetNowUs();
         for (;;) {
             status_t err = mVideoSource->read(&mVideoBuffer, &options);
             options.clearSeekTo();
@@ -2026,6 +2097,7 @@ void AwesomePlayer::onVideoEvent() {
         {
             Mutex::Autolock autoLock(mStatsLock);
             ++mStats.mNumVideoFramesDecoded;
+            mStats.mVideoDecodeTimeUs += ALooper::GetNowUs() - decodeStartUs;
         }
     }
 
@@ -2128,6 +2200,14 @@ void AwesomePlayer::onVideoEvent() {
 
         ATRACE_INT("Video Lateness (ms)", latenessUs / 1E3);
 
+        {
+            Mutex::Autolock autoLock(mStatsLock);
+            mStats.mVideoLatenessUs = latenessUs;
+            if (latenessUs > mStats.mMaxVideoLatenessUs) {
+                mStats.mMaxVideoLatenessUs = latenessUs;
+            }
+        }
+
         if (latenessUs > kVideoTooLateMarginUs
                 && mAudioPlayer != NULL
                 && mAudioPlayer->getMediaTimeMapping(
@@ -2164,6 +2244,7 @@ void AwesomePlayer::onVideoEvent() {
                 {
                     Mutex::Autolock autoLock(mStatsLock);
                     ++mStats.mNumVideoFramesDropped;
+                    ATRACE_INT("Video Frames Dropped", mStats.mNumVideoFramesDropped);
 #ifdef QCOM_HARDWARE
                     if(mStatistics) {
                         mStats.mConsecutiveFramesDropped++;
@@ -2206,7 +2287,12 @@ void AwesomePlayer::onVideoEvent() {
 
     if (mVideoRenderer != NULL) {
         mSinceLastDropped++;
-        mVideoRenderer->render(mVideoBuffer);
+
+        ATRACE_INT("Video Render Time (ms)", timeUs / 1000);
+        {
+            ScopedTrace trace(ATRACE_TAG, "AwesomePlayer::renderVideo");
+            mVideoRenderer->render(mVideoBuffer);
+        }
 
 #ifdef QCOM_HARDWARE
         if(mStatistics) {
@@ -2267,7 +2353,8 @@ void AwesomePlayer::postBufferingEvent_l() {
         return;
     }
     mBufferingEventPending = true;
-    mQueue.postEventWithDelay(mBufferingEvent, 1000000ll);
+    mQueue.postEventWithDelay(
+            mBufferingEvent, 1000000ll, kPeriodicCheckSlackUs);
 }
 
 void AwesomePlayer::postVideoLagEvent_l() {
@@ -2275,7 +2362,8 @@ void AwesomePlayer::postVideoLagEvent_l() {
         return;
     }
     mVideoLagEventPending = true;
-    mQueue.postEventWithDelay(mVideoLagEvent, 1000000ll);
+    mQueue.postEventWithDelay(
+            mVideoLagEvent, 1000000ll, kPeriodicCheckSlackUs);
 }
 
 void AwesomePlayer::postCheckAudioStatusEvent(int64_t delayUs) {
@@ -2622,6 +2710,19 @@ void AwesomePlayer::onPrepareAsyncEvent() {
         }
     }
 
+    char value[PROPERTY_VALUE_MAX];
+    if (mVideoTrack != NULL && mVideoSource == NULL
+            && mAudioTrack != NULL && mAudioSource == NULL
+            && property_get("media.stagefright.parallel-init", value, NULL)
+            && (!strcmp(value, "1") || !strcasecmp(value, "true"))) {
+        status_t err = initDecodersInParallel();
+
+        if (err != OK) {
+            abortPrepare(err);
+            return;
+        }
+    }
+
     if (mVideoTrack != NULL && mVideoSource == NULL) {
         status_t err = initVideoDecoder();
 
@@ -2649,6 +2750,48 @@ void AwesomePlayer::onPrepareAsyncEvent() {
     }
 }
 
+// static
+void *AwesomePlayer::InitAudioDecoderWrapper(void *me) {
+    AwesomePlayer *player = static_cast<AwesomePlayer *>(me);
+    player->mAudioDecoderInitResult = player->initAudioDecoder();
+
+    return NULL;
+}
+
+status_t AwesomePlayer::initDecodersInParallel() {
+    // Allocating a hardware decoder and its buffers takes a good part of
+    // the time to prepare, and the audio and video components do not
+    // depend on each other. Both init functions only touch their own track,
+    // the shared duration and stats are protected by their own locks.
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_JOINABLE);
+
+    pthread_t audioThread;
+    mAudioDecoderInitResult = OK;
+    int res = pthread_create(&audioThread, &attr, InitAudioDecoderWrapper, this);
+    pthread_attr_destroy(&attr);
+
+    if (res != 0) {
+        ALOGW("unable to start audio decoder thread (%d), "
+              "initializing decoders serially", res);
+        // The caller falls back to initializing both decoders itself.
+        return OK;
+    }
+
+    status_t err = initVideoDecoder();
+
+    void *dummy;
+    pthread_join(audioThread, &dummy);
+
+    if (err != OK) {
+        // reset_l stops and releases the audio decoder if it was created.
+        return err;
+    }
+
+    return mAudioDecoderInitResult;
+}
+
 void AwesomePlayer::finishAsyncPrepare_l() {
     if (mIsAsyncPrepare) {
         if (mVideoSource == NULL) {
@@ -2722,6 +2865,27 @@ status_t AwesomePlayer::getParameter(int key, Parcel *reply) {
             reply->writeInt32(channelCount);
         }
         return OK;
+    case KEY_PARAMETER_PLAYBACK_STATS:
+        {
+            Mutex::Autolock autoLock(mStatsLock);
+
+            int64_t rebufferTimeUs = mStats.mRebufferTimeUs;
+            if (mStats.mRebufferStartUs >= 0) {
+                rebufferTimeUs += ALooper::GetNowUs() - mStats.mRebufferStartUs;
+            }
+
+            reply->writeInt64(mStats.mNumVideoFramesDecoded);
+            reply->writeInt64(mStats.mNumVideoFramesDropped);
+            reply->writeInt64(mStats.mNumVideoFramesDecoded > 0
+                    ? mStats.mVideoDecodeTimeUs / mStats.mNumVideoFramesDecoded : -1);
+            reply->writeInt64(mStats.mVideoLatenessUs);
+            reply->writeInt64(mStats.mMaxVideoLatenessUs);
+            reply->writeInt64(mStats.mNumRebuffers);
+            reply->writeInt64(rebufferTimeUs);
+            reply->writeInt64(mStats.mCachedBytes);
+            reply->writeInt64(mStats.mCachedDurationUs);
+        }
+        return OK;
     default:
         {
             return ERROR_UNSUPPORTED;
@@ -3058,6 +3222,17 @@ void AwesomePlayer::modifyFlags(unsigned value, FlagMode mode) {
 
     {
         Mutex::Autolock autoLock(mStatsLock);
+
+        bool underrun = (mFlags & CACHE_UNDERRUN) != 0;
+        bool wasUnderrun = (mStats.mFlags & CACHE_UNDERRUN) != 0;
+        if (underrun && !wasUnderrun) {
+            ++mStats.mNumRebuffers;
+            mStats.mRebufferStartUs = ALooper::GetNowUs();
+        } else if (!underrun && wasUnderrun && mStats.mRebufferStartUs >= 0) {
+            mStats.mRebufferTimeUs += ALooper::GetNowUs() - mStats.mRebufferStartUs;
+            mStats.mRebufferStartUs = -1;
+        }
+
         mStats.mFlags = mFlags;
     }
 }
@@ -679,9 +679,10 @@ status_t CameraSource::reset() {
     }
 
     if (mCollectStats) {
-        ALOGI("Frames received/encoded/dropped: %d/%d/%d in %lld us",
+        ALOGI("Frames received/encoded/dropped: %d/%d/%d in %lld us (%s)",
                 mNumFramesReceived, mNumFramesEncoded, mNumFramesDropped,
-                mLastFrameTimestampUs - mFirstFrameTimeUs);
+                mLastFrameTimestampUs - mFirstFrameTimeUs,
+                mIsMetaDataStoredInVideoBuffers ? "meta data" : "frame data");
     }
 
     if (mNumGlitches > 0) {
@@ -18,14 +18,13 @@
 #define LOG_TAG "CameraSourceTimeLapse"
 
 #include <binder/IPCThreadState.h>
-#include <binder/MemoryBase.h>
-#include <binder/MemoryHeapBase.h>
 #include <media/stagefright/foundation/ADebug.h>
 #include <media/stagefright/CameraSource.h>
 #include <media/stagefright/CameraSourceTimeLapse.h>
 #include <media/stagefright/MetaData.h>
 #include <camera/Camera.h>
 #include <camera/CameraParameters.h>
+#include <cutils/properties.h>
 #include <utils/String8.h>
 #include <utils/Vector.h>
 
@@ -79,6 +78,15 @@ CameraSourceTimeLapse::CameraSourceTimeLapse(
         mInitCheck = NO_INIT;
     }
 
+    // Unless disabled, have the camera deliver fewer frames instead of
+    // skipping most of them here.
+    char value[PROPERTY_VALUE_MAX];
+    if (mInitCheck == OK
+            && (!property_get("media.stagefright.timelapse-lowfps", value, NULL)
+                || (strcmp(value, "0") && strcasecmp(value, "false")))) {
+        trySettingCaptureFrameRate();
+    }
+
     // Initialize quick stop variables.
     mQuickStop = false;
     mForceRead = false;
@@ -153,6 +161,63 @@ bool CameraSourceTimeLapse::trySettingVideoSize(
     return isSuccessful;
 }
 
+bool CameraSourceTimeLapse::trySettingCaptureFrameRate() {
+    ALOGV("trySettingCaptureFrameRate");
+
+    // A few camera frames per capture interval keep the time lapse frames
+    // close to the requested interval, which is only checked on arrival.
+    static const int64_t kFramesPerCaptureInterval = 4;
+
+    int64_t token = IPCThreadState::self()->clearCallingIdentity();
+    String8 s = mCamera->getParameters();
+
+    CameraParameters params(s);
+    int32_t currentFrameRate = params.getPreviewFrameRate();
+    const char *supportedFrameRates =
+            params.get(CameraParameters::KEY_SUPPORTED_PREVIEW_FRAME_RATES);
+
+    bool isSuccessful = false;
+    int32_t frameRate = -1;
+    if (currentFrameRate > 0 && supportedFrameRates != NULL
+            && mTimeBetweenFrameCaptureUs > 0) {
+        // Lowest supported rate of at least kFramesPerCaptureInterval frames
+        // per interval; if none is that fast keep the current one.
+        int64_t minFrameRate =
+            (kFramesPerCaptureInterval * 1000000LL + mTimeBetweenFrameCaptureUs - 1)
+                / mTimeBetweenFrameCaptureUs;
+
+        const char *p = supportedFrameRates;
+        while (*p != '\0') {
+            char *end;
+            long rate = strtol(p, &end, 10);
+            if (end == p) {
+                break;
+            }
+
+            if (rate > 0 && rate >= minFrameRate
+                    && (frameRate < 0 || rate < frameRate)) {
+                frameRate = rate;
+            }
+
+            p = (*end == ',') ? end + 1 : end;
+        }
+    }
+
+    if (frameRate > 0 && frameRate < currentFrameRate) {
+        params.setPreviewFrameRate(frameRate);
+        if (mCamera->setParameters(params.flatten()) == OK) {
+            ALOGI("Capturing time lapse frames at %d fps instead of %d fps",
+                frameRate, currentFrameRate);
+            isSuccessful = true;
+        } else {
+            ALOGW("Failed to set capture frame rate to %d fps", frameRate);
+        }
+    }
+
+    IPCThreadState::self()->restoreCallingIdentity(token);
+    return isSuccessful;
+}
+
 void CameraSourceTimeLapse::signalBufferReturned(MediaBuffer* buffer) {
     ALOGV("signalBufferReturned");
     Mutex::Autolock autoLock(mQuickStopLock);
@@ -208,19 +273,6 @@ status_t CameraSourceTimeLapse::read(
     }
 }
 
-sp<IMemory> CameraSourceTimeLapse::createIMemoryCopy(
-        const sp<IMemory> &source_data) {
-
-    ALOGV("createIMemoryCopy");
-    size_t source_size = source_data->size();
-    void* source_pointer = source_data->pointer();
-
-    sp<MemoryHeapBase> newMemoryHeap = new MemoryHeapBase(source_size);
-    sp<MemoryBase> newMemory = new MemoryBase(newMemoryHeap, 0, source_size);
-    memcpy(newMemory->pointer(), source_pointer, source_size);
-    return newMemory;
-}
-
 bool CameraSourceTimeLapse::skipCurrentFrame(int64_t timestampUs) {
     ALOGV("skipCurrentFrame");
     if (mSkipCurrentFrame) {
@@ -37,6 +37,7 @@
 
 #include "matroska/MatroskaExtractor.h"
 
+#include <media/stagefright/foundation/ABuffer.h>
 #include <media/stagefright/foundation/AMessage.h>
 #include <media/stagefright/DataSource.h>
 #include <media/stagefright/FileSource.h>
@@ -79,6 +80,238 @@ status_t DataSource::getCurrentOffset(off64_t *size) {
 
 ////////////////////////////////////////////////////////////////////////////////
 
+// Serves the sniffers' reads from the head of the file out of one buffer,
+// most of them look at the same first few kilobytes.
+struct SniffReadAheadSource : public DataSource {
+    SniffReadAheadSource(const sp<DataSource> &source)
+        : mSource(source),
+          mData(NULL),
+          mSize(0),
+          mReachedEOS(false) {
+    }
+
+    virtual status_t initCheck() const {
+        return mSource->initCheck();
+    }
+
+    virtual ssize_t readAt(off64_t offset, void *data, size_t size) {
+        if (offset < 0 || offset + (off64_t)size > (off64_t)kMaxReadAheadSize) {
+            return mSource->readAt(offset, data, size);
+        }
+
+        fill((size_t)offset + size);
+
+        if ((size_t)offset >= mSize) {
+            return mReachedEOS ? 0 : mSource->readAt(offset, data, size);
+        }
+
+        size_t copy = mSize - (size_t)offset;
+        if (copy > size) {
+            copy = size;
+        }
+        memcpy(data, mData + offset, copy);
+
+        return copy;
+    }
+
+    virtual status_t getSize(off64_t *size) {
+        return mSource->getSize(size);
+    }
+
+#ifdef QCOM_HARDWARE
+    virtual status_t getCurrentOffset(off64_t *size) {
+        return mSource->getCurrentOffset(size);
+    }
+#endif
+
+    virtual uint32_t flags() {
+        return mSource->flags();
+    }
+
+    virtual sp<ABuffer> getMappedRange(off64_t offset, size_t size) {
+        return mSource->getMappedRange(offset, size);
+    }
+
+    virtual sp<DecryptHandle> DrmInitialization(const char *mime = NULL) {
+        // Reads may be decrypted from now on.
+        mSize = 0;
+        mReachedEOS = false;
+
+        return mSource->DrmInitialization(mime);
+    }
+
+    virtual void getDrmInfo(
+            sp<DecryptHandle> &handle, DrmManagerClient **client) {
+        mSource->getDrmInfo(handle, client);
+    }
+
+    virtual String8 getUri() {
+        return mSource->getUri();
+    }
+
+    virtual String8 getMIMEType() const {
+        return mSource->getMIMEType();
+    }
+
+protected:
+    virtual ~SniffReadAheadSource() {
+        delete[] mData;
+        mData = NULL;
+    }
+
+private:
+    enum {
+        kReadAheadChunkSize = 16 * 1024,
+        kMaxReadAheadSize   = 64 * 1024,
+    };
+
+    sp<DataSource> mSource;
+    uint8_t *mData;
+    size_t mSize;
+    bool mReachedEOS;
+
+    // Reads ahead in whole chunks until |end| is buffered.
+    void fill(size_t end) {
+        if (mData == NULL) {
+            mData = new uint8_t[kMaxReadAheadSize];
+        }
+
+        while (mSize < end && !mReachedEOS) {
+            size_t size = kReadAheadChunkSize;
+            if (mSize + size > kMaxReadAheadSize) {
+                size = kMaxReadAheadSize - mSize;
+            }
+
+            ssize_t n = mSource->readAt(mSize, mData + mSize, size);
+            if (n <= 0) {
+                // Leave errors to the reads that run into them.
+                if (n == 0) {
+                    mReachedEOS = true;
+                }
+                break;
+            }
+
+            mSize += n;
+            if ((size_t)n < size) {
+                mReachedEOS = true;
+            }
+        }
+    }
+
+    SniffReadAheadSource(const SniffReadAheadSource &);
+    SniffReadAheadSource &operator=(const SniffReadAheadSource &);
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+// The containers a URI extension or a MIME type such as an HTTP
+// Content-Type points to, their sniffer is tried before all others.
+struct SnifferHint {
+    const char *mKey;
+    DataSource::SnifferFunc mSniffer;
+};
+
+static const SnifferHint kExtensionHints[] = {
+    { ".mp4", SniffMPEG4 },
+    { ".m4a", SniffMPEG4 },
+    { ".m4v", SniffMPEG4 },
+    { ".3gp", SniffMPEG4 },
+    { ".3gpp", SniffMPEG4 },
+    { ".3g2", SniffMPEG4 },
+    { ".mov", SniffMPEG4 },
+    { ".mkv", SniffMatroska },
+    { ".mka", SniffMatroska },
+    { ".webm", SniffMatroska },
+    { ".ogg", SniffOgg },
+    { ".oga", SniffOgg },
+    { ".wav", SniffWAV },
+    { ".flac", SniffFLAC },
+    { ".amr", SniffAMR },
+    { ".awb", SniffAMR },
+    { ".ts", SniffMPEG2TS },
+    { ".mp3", SniffMP3 },
+    { ".aac", SniffAAC },
+    { ".mpg", SniffMPEG2PS },
+    { ".mpeg", SniffMPEG2PS },
+};
+
+static const SnifferHint kMIMETypeHints[] = {
+    { "video/mp4", SniffMPEG4 },
+    { "audio/mp4", SniffMPEG4 },
+    { "video/3gpp", SniffMPEG4 },
+    { "audio/3gpp", SniffMPEG4 },
+    { "video/quicktime", SniffMPEG4 },
+    { "video/webm", SniffMatroska },
+    { "audio/webm", SniffMatroska },
+    { "video/x-matroska", SniffMatroska },
+    { "audio/x-matroska", SniffMatroska },
+    { "application/ogg", SniffOgg },
+    { "audio/ogg", SniffOgg },
+    { "audio/wav", SniffWAV },
+    { "audio/x-wav", SniffWAV },
+    { "audio/flac", SniffFLAC },
+    { "audio/amr", SniffAMR },
+    { "audio/amr-wb", SniffAMR },
+    { "video/mp2t", SniffMPEG2TS },
+    { "audio/mpeg", SniffMP3 },
+    { "audio/mp3", SniffMP3 },
+    { "audio/aac", SniffAAC },
+    { "audio/aacp", SniffAAC },
+    { "video/mpeg", SniffMPEG2PS },
+};
+
+// A hinted sniffer recognizing the content with at least this confidence
+// is accepted without running the others.
+static const float kMinHintedConfidence = 0.1f;
+
+static DataSource::SnifferFunc FindHintedSniffer(
+        const sp<DataSource> &source) {
+    String8 mimeType = source->getMIMEType();
+
+    // Drop parameters such as "; charset=...".
+    ssize_t end = mimeType.find(";");
+    if (end >= 0) {
+        mimeType.setTo(mimeType.string(), end);
+    }
+
+    static const size_t kNumMIMETypeHints =
+        sizeof(kMIMETypeHints) / sizeof(kMIMETypeHints[0]);
+
+    for (size_t i = 0; i < kNumMIMETypeHints; ++i) {
+        if (!strcasecmp(mimeType.string(), kMIMETypeHints[i].mKey)) {
+            return kMIMETypeHints[i].mSniffer;
+        }
+    }
+
+    String8 uri = source->getUri();
+
+    // Drop the query and fragment of a URL.
+    end = uri.find("?");
+    if (end < 0) {
+        end = uri.find("#");
+    }
+    if (end >= 0) {
+        uri.setTo(uri.string(), end);
+    }
+
+    String8 extension = uri.getPathExtension();
+
+    if (extension.isEmpty()) {
+        return NULL;
+    }
+
+    static const size_t kNumExtensionHints =
+        sizeof(kExtensionHints) / sizeof(kExtensionHints[0]);
+
+    for (size_t i = 0; i < kNumExtensionHints; ++i) {
+        if (!strcasecmp(extension.string(), kExtensionHints[i].mKey)) {
+            return kExtensionHints[i].mSniffer;
+        }
+    }
+
+    return NULL;
+}
+
 Mutex DataSource::gSnifferMutex;
 List<DataSource::SnifferFunc> DataSource::gSniffers;
 #ifdef QCOM_HARDWARE
@@ -91,7 +324,42 @@ bool DataSource::sniff(
     *mimeType = "";
     *confidence = 0.0f;
     meta->clear();
+
+    // Sources that cache what they read already make repeated reads cheap.
+    sp<DataSource> source = this;
+    if (!(flags() & kIsCachingDataSource)) {
+        source = new SniffReadAheadSource(source);
+    }
+
     Mutex::Autolock autoLock(gSnifferMutex);
+
+    // Try the sniffer the URI or MIME type points to first, it saves the
+    // others' reads of the header when it's right.
+    SnifferFunc hinted = FindHintedSniffer(source);
+    List<SnifferFunc>::iterator hintedPos = gSniffers.begin();
+    while (hintedPos != gSniffers.end() && *hintedPos != hinted) {
+        ++hintedPos;
+    }
+
+    if (hintedPos != gSniffers.end()
+            && hinted(source, mimeType, confidence, meta)
+            && *confidence >= kMinHintedConfidence
+#ifdef QCOM_HARDWARE
+            // The extended sniffer still gets to look at MPEG4 files.
+            && strcasecmp(mimeType->string(), MEDIA_MIMETYPE_CONTAINER_MPEG4)
+#endif
+            ) {
+        ALOGV("hinted sniffer found %s, confidence %f",
+              mimeType->string(), *confidence);
+
+        return true;
+    }
+
+    // Otherwise all sniffers get their say, the hinted one included.
+    *mimeType = "";
+    *confidence = 0.0f;
+    meta->clear();
+
     for (List<SnifferFunc>::iterator it = gSniffers.begin();
          it != gSniffers.end(); ++it) {
 
@@ -104,7 +372,7 @@ bool DataSource::sniff(
         String8 newMimeType;
         float newConfidence = 0.0;
         sp<AMessage> newMeta;
-        if ((*it)(this, &newMimeType, &newConfidence, &newMeta)) {
+        if ((*it)(source, &newMimeType, &newConfidence, &newMeta)) {
             if (newConfidence > *confidence) {
                 *mimeType = newMimeType;
                 *confidence = newConfidence;
@@ -125,7 +393,7 @@ bool DataSource::sniff(
                         String8 tmpMimeType;
                         float tmpConfidence = 0.0 ;
                         sp<AMessage> tmpMeta;
-                        (*extendedSnifferPosition)(this, &tmpMimeType, &tmpConfidence, &tmpMeta);
+                        (*extendedSnifferPosition)(source, &tmpMimeType, &tmpConfidence, &tmpMeta);
                         if (tmpConfidence > *confidence) {
                             *mimeType = tmpMimeType;
                             *confidence = tmpConfidence;
@@ -0,0 +1,229 @@
+/*
+ * Copyright (C) 2012 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "DecodeAheadSource"
+#include <utils/Log.h>
+
+#include "include/DecodeAheadSource.h"
+
+#include <sys/prctl.h>
+
+#include <media/stagefright/foundation/ADebug.h>
+#include <media/stagefright/MediaBuffer.h>
+#include <media/stagefright/MetaData.h>
+
+namespace android {
+
+DecodeAheadSource::DecodeAheadSource(
+        const sp<MediaSource> &source, size_t maxQueuedBuffers)
+    : mSource(source),
+      mMaxQueuedBuffers(maxQueuedBuffers),
+      mStarted(false),
+      mDone(false),
+      mReading(false),
+      mSeeking(false),
+      mReachedEOS(false),
+      mFinalResult(OK) {
+    CHECK_GT(mMaxQueuedBuffers, 0u);
+}
+
+DecodeAheadSource::~DecodeAheadSource() {
+    if (mStarted) {
+        stop();
+    }
+}
+
+status_t DecodeAheadSource::start(MetaData *params) {
+    CHECK(!mStarted);
+
+    status_t err = mSource->start(params);
+
+    if (err != OK) {
+        return err;
+    }
+
+    mDone = false;
+    mReading = false;
+    mSeeking = false;
+    mReachedEOS = false;
+    mFinalResult = OK;
+
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_JOINABLE);
+
+    pthread_create(&mThread, &attr, ThreadWrapper, this);
+
+    pthread_attr_destroy(&attr);
+
+    mStarted = true;
+
+    return OK;
+}
+
+status_t DecodeAheadSource::stop() {
+    CHECK(mStarted);
+
+    {
+        Mutex::Autolock autoLock(mLock);
+        mDone = true;
+
+        // Hand decoded buffers back so that a read blocked in the decoder
+        // can complete.
+        flushQueue_l();
+        mCondition.broadcast();
+    }
+
+    void *dummy;
+    pthread_join(mThread, &dummy);
+
+    {
+        Mutex::Autolock autoLock(mLock);
+        flushQueue_l();
+    }
+
+    mStarted = false;
+
+    return mSource->stop();
+}
+
+sp<MetaData> DecodeAheadSource::getFormat() {
+    return mSource->getFormat();
+}
+
+status_t DecodeAheadSource::pause() {
+    return mSource->pause();
+}
+
+status_t DecodeAheadSource::read(
+        MediaBuffer **out, const ReadOptions *options) {
+    *out = NULL;
+
+    int64_t seekTimeUs;
+    ReadOptions::SeekMode mode;
+    if (options != NULL && options->getSeekTo(&seekTimeUs, &mode)) {
+        {
+            Mutex::Autolock autoLock(mLock);
+            mSeeking = true;
+
+            flushQueue_l();
+            while (mReading) {
+                mCondition.wait(mLock);
+            }
+
+            // The read that was in flight was discarded by the thread.
+            flushQueue_l();
+        }
+
+        status_t err = mSource->read(out, options);
+
+        Mutex::Autolock autoLock(mLock);
+        mSeeking = false;
+        mReachedEOS = (err != OK && err != INFO_FORMAT_CHANGED);
+        mFinalResult = err;
+        mCondition.broadcast();
+
+        return err;
+    }
+
+    Mutex::Autolock autoLock(mLock);
+    while (mQueue.empty() && !mReachedEOS) {
+        mCondition.wait(mLock);
+    }
+
+    if (mQueue.empty()) {
+        return mFinalResult;
+    }
+
+    const Entry &entry = *mQueue.begin();
+    *out = entry.mBuffer;
+    status_t err = entry.mResult;
+    mQueue.erase(mQueue.begin());
+
+    mCondition.broadcast();
+
+    return err;
+}
+
+void DecodeAheadSource::flushQueue_l() {
+    while (!mQueue.empty()) {
+        const Entry &entry = *mQueue.begin();
+        if (entry.mBuffer != NULL) {
+            entry.mBuffer->release();
+        }
+        mQueue.erase(mQueue.begin());
+    }
+}
+
+// static
+void *DecodeAheadSource::ThreadWrapper(void *me) {
+    androidSetThreadPriority(0, ANDROID_PRIORITY_FOREGROUND);
+
+    static_cast<DecodeAheadSource *>(me)->threadEntry();
+
+    return NULL;
+}
+
+void DecodeAheadSource::threadEntry() {
+    prctl(PR_SET_NAME, (unsigned long)"DecodeAheadSource", 0, 0, 0);
+
+    Mutex::Autolock autoLock(mLock);
+
+    for (;;) {
+        while (!mDone
+                && (mSeeking || mReachedEOS
+                    || mQueue.size() >= mMaxQueuedBuffers)) {
+            mCondition.wait(mLock);
+        }
+
+        if (mDone) {
+            break;
+        }
+
+        mReading = true;
+
+        MediaBuffer *buffer = NULL;
+
+        mLock.unlock();
+        status_t err = mSource->read(&buffer);
+        mLock.lock();
+
+        mReading = false;
+        mCondition.broadcast();
+
+        if (mSeeking || mDone) {
+            if (buffer != NULL) {
+                buffer->release();
+            }
+            continue;
+        }
+
+        Entry entry;
+        entry.mBuffer = buffer;
+        entry.mResult = err;
+        mQueue.push_back(entry);
+
+        if (err != OK && err != INFO_FORMAT_CHANGED) {
+            mReachedEOS = true;
+            mFinalResult = err;
+        }
+
+        mCondition.broadcast();
+    }
+}
+
+}  // namespace android
@@ -19,6 +19,7 @@
 #include <utils/Log.h>
 
 #include "include/FLACExtractor.h"
+#include "include/DecodeAheadSource.h"
 // Vorbis comments
 #include "include/OggExtractor.h"
 // libFLAC parser
@@ -31,6 +32,7 @@
 #include <media/stagefright/MetaData.h>
 #include <media/stagefright/MediaSource.h>
 #include <media/stagefright/MediaBuffer.h>
+#include <utils/Vector.h>
 
 namespace android {
 
@@ -119,8 +121,10 @@ private:
     sp<MetaData> mTrackMetadata;
     bool mInitCheck;
 
-    // media buffers
+    // media buffers, each holding as many whole frames as fit in
+    // mBufferSamples samples per channel
     size_t mMaxBufferSize;
+    size_t mBufferSamples;
     MediaBufferGroup *mGroup;
     void (*mCopy)(short *dst, const int *const *src, unsigned nSamples);
 
@@ -135,6 +139,15 @@ private:
     FLAC__StreamMetadata_StreamInfo mStreamInfo;
     bool mStreamInfoValid;
 
+    // cached when the SEEKTABLE metadata is parsed by libFLAC, offsets
+    // are relative to the first frame
+    struct SeekPoint {
+        FLAC__uint64 mSample;
+        FLAC__uint64 mOffset;
+    };
+    Vector<SeekPoint> mSeekPoints;
+    off64_t mFirstFrameOffset;
+
     // cached when a decoded PCM block is "written" by libFLAC parser
     bool mWriteRequested;
     bool mWriteCompleted;
@@ -146,6 +159,9 @@ private:
 
     status_t init();
     MediaBuffer *readBuffer(bool doSeek, FLAC__uint64 sample);
+    bool decodeFrame();
+    bool checkFrame();
+    bool seekToSample(FLAC__uint64 sample, unsigned *skip);
 
     // no copy constructor or assignment
     FLACParser(const FLACParser &);
@@ -357,6 +373,26 @@ void FLACParser::metadataCallback(const FLAC__StreamMetadata *metadata)
         }
         }
         break;
+    case FLAC__METADATA_TYPE_SEEKTABLE:
+        {
+        const FLAC__StreamMetadata_SeekTable *st = &metadata->data.seek_table;
+        for (unsigned i = 0; i < st->num_points; ++i) {
+            const FLAC__StreamMetadata_SeekPoint *sp = &st->points[i];
+            if (sp->sample_number == FLAC__STREAM_METADATA_SEEKPOINT_PLACEHOLDER) {
+                continue;
+            }
+            // points must be sorted, ignore those that aren't
+            if (!mSeekPoints.isEmpty()
+                    && sp->sample_number <= mSeekPoints.top().mSample) {
+                continue;
+            }
+            SeekPoint point;
+            point.mSample = sp->sample_number;
+            point.mOffset = sp->stream_offset;
+            mSeekPoints.push(point);
+        }
+        }
+        break;
     case FLAC__METADATA_TYPE_PICTURE:
         if (mFileMetadata != 0) {
             const FLAC__StreamMetadata_Picture *p = &metadata->data.picture;
@@ -443,12 +479,14 @@ FLACParser::FLACParser(
       mTrackMetadata(trackMetadata),
       mInitCheck(false),
       mMaxBufferSize(0),
+      mBufferSamples(0),
       mGroup(NULL),
       mCopy(copyTrespass),
       mDecoder(NULL),
       mCurrentPos(0LL),
       mEOF(false),
       mStreamInfoValid(false),
+      mFirstFrameOffset(0),
       mWriteRequested(false),
       mWriteCompleted(false),
       mWriteBuffer(NULL),
@@ -488,6 +526,8 @@ status_t FLACParser::init()
             mDecoder, FLAC__METADATA_TYPE_PICTURE);
     FLAC__stream_decoder_set_metadata_respond(
             mDecoder, FLAC__METADATA_TYPE_VORBIS_COMMENT);
+    FLAC__stream_decoder_set_metadata_respond(
+            mDecoder, FLAC__METADATA_TYPE_SEEKTABLE);
     FLAC__StreamDecoderInitStatus initStatus;
     initStatus = FLAC__stream_decoder_init_stream(
             mDecoder,
@@ -505,6 +545,13 @@ status_t FLACParser::init()
         ALOGE("end_of_metadata failed");
         return NO_INIT;
     }
+    // seek points are relative to the first frame, which follows the metadata
+    FLAC__uint64 firstFrameOffset;
+    if (FLAC__stream_decoder_get_decode_position(mDecoder, &firstFrameOffset)) {
+        mFirstFrameOffset = firstFrameOffset;
+    } else {
+        mSeekPoints.clear();
+    }
     if (mStreamInfoValid) {
         // check channel count
         switch (getChannels()) {
@@ -581,12 +628,26 @@ status_t FLACParser::init()
     return OK;
 }
 
+// Buffers hold at least this many samples per channel, several frames at
+// the common block sizes, so that fewer buffers make their way through the
+// player.
+static const size_t kMinBufferSamples = 8192;
+
+// One buffer with the client, the others decoded ahead by DecodeAheadSource.
+static const size_t kNumBuffers = 4;
+
 void FLACParser::allocateBuffers()
 {
     CHECK(mGroup == NULL);
     mGroup = new MediaBufferGroup;
-    mMaxBufferSize = getMaxBlockSize() * getChannels() * sizeof(short);
-    mGroup->add_buffer(new MediaBuffer(mMaxBufferSize));
+    mBufferSamples = getMaxBlockSize();
+    if (mBufferSamples < kMinBufferSamples) {
+        mBufferSamples = kMinBufferSamples;
+    }
+    mMaxBufferSize = mBufferSamples * getChannels() * sizeof(short);
+    for (size_t i = 0; i < kNumBuffers; ++i) {
+        mGroup->add_buffer(new MediaBuffer(mMaxBufferSize));
+    }
 }
 
 void FLACParser::releaseBuffers()
@@ -596,37 +657,107 @@ void FLACParser::releaseBuffers()
     mGroup = NULL;
 }
 
-MediaBuffer *FLACParser::readBuffer(bool doSeek, FLAC__uint64 sample)
+// verify that block header keeps the promises made by STREAMINFO
+bool FLACParser::checkFrame()
 {
-    mWriteRequested = true;
-    mWriteCompleted = false;
-    if (doSeek) {
-        // We implement the seek callback, so this works without explicit flush
-        if (!FLAC__stream_decoder_seek_absolute(mDecoder, sample)) {
-            ALOGE("FLACParser::readBuffer seek to sample %llu failed", sample);
-            return NULL;
-        }
-        ALOGV("FLACParser::readBuffer seek to sample %llu succeeded", sample);
-    } else {
-        if (!FLAC__stream_decoder_process_single(mDecoder)) {
-            ALOGE("FLACParser::readBuffer process_single failed");
-            return NULL;
-        }
-    }
     if (!mWriteCompleted) {
-        ALOGV("FLACParser::readBuffer write did not complete");
-        return NULL;
+        ALOGV("FLACParser::checkFrame write did not complete");
+        return false;
     }
-    // verify that block header keeps the promises made by STREAMINFO
     unsigned blocksize = mWriteHeader.blocksize;
     if (blocksize == 0 || blocksize > getMaxBlockSize()) {
-        ALOGE("FLACParser::readBuffer write invalid blocksize %u", blocksize);
-        return NULL;
+        ALOGE("FLACParser::checkFrame write invalid blocksize %u", blocksize);
+        return false;
     }
     if (mWriteHeader.sample_rate != getSampleRate() ||
         mWriteHeader.channels != getChannels() ||
         mWriteHeader.bits_per_sample != getBitsPerSample()) {
-        ALOGE("FLACParser::readBuffer write changed parameters mid-stream");
+        ALOGE("FLACParser::checkFrame write changed parameters mid-stream");
+    }
+    CHECK(mWriteHeader.number_type == FLAC__FRAME_NUMBER_TYPE_SAMPLE_NUMBER);
+    return true;
+}
+
+bool FLACParser::decodeFrame()
+{
+    mWriteRequested = true;
+    mWriteCompleted = false;
+    if (!FLAC__stream_decoder_process_single(mDecoder)) {
+        ALOGE("FLACParser::decodeFrame process_single failed");
+        return false;
+    }
+    return checkFrame();
+}
+
+// Leaves the frame containing "sample" decoded, and the number of samples
+// preceding it within the frame in "skip".
+bool FLACParser::seekToSample(FLAC__uint64 sample, unsigned *skip)
+{
+    *skip = 0;
+
+    // The seek table leads straight to a nearby frame, where libFLAC's own
+    // seek would bisect the file, reading and decoding frames as it goes.
+    ssize_t point = -1;
+    for (size_t i = 0; i < mSeekPoints.size(); ++i) {
+        if (mSeekPoints.itemAt(i).mSample > sample) {
+            break;
+        }
+        point = i;
+    }
+
+    if (point >= 0 && sample < getTotalSamples()
+            && FLAC__stream_decoder_flush(mDecoder)) {
+        const SeekPoint &seekPoint = mSeekPoints.itemAt(point);
+        mCurrentPos = mFirstFrameOffset + seekPoint.mOffset;
+        mEOF = false;
+
+        // With a fixed block size the frames before the target can be
+        // skipped without decoding them to PCM.
+        if (mStreamInfo.min_blocksize == mStreamInfo.max_blocksize) {
+            FLAC__uint64 numFrames =
+                (sample - seekPoint.mSample) / getMaxBlockSize();
+            for (FLAC__uint64 i = 0; i < numFrames; ++i) {
+                if (!FLAC__stream_decoder_skip_single_frame(mDecoder)) {
+                    break;
+                }
+            }
+        }
+
+        while (decodeFrame()) {
+            FLAC__uint64 first = mWriteHeader.number.sample_number;
+            if (first > sample) {
+                break;
+            }
+            if (sample < first + mWriteHeader.blocksize) {
+                *skip = sample - first;
+                ALOGV("FLACParser::seekToSample %llu using seek table", sample);
+                return true;
+            }
+        }
+
+        ALOGW("FLACParser::seekToSample seek table doesn't match the stream");
+    }
+
+    mWriteRequested = true;
+    mWriteCompleted = false;
+    // We implement the seek callback, so this works without explicit flush
+    if (!FLAC__stream_decoder_seek_absolute(mDecoder, sample)) {
+        ALOGE("FLACParser::seekToSample seek to sample %llu failed", sample);
+        return false;
+    }
+    ALOGV("FLACParser::seekToSample seek to sample %llu succeeded", sample);
+    return checkFrame();
+}
+
+MediaBuffer *FLACParser::readBuffer(bool doSeek, FLAC__uint64 sample)
+{
+    unsigned skip = 0;
+    if (doSeek) {
+        if (!seekToSample(sample, &skip)) {
+            return NULL;
+        }
+    } else if (!decodeFrame()) {
+        return NULL;
     }
     // acquire a media buffer
     CHECK(mGroup != NULL);
@@ -635,18 +766,30 @@ MediaBuffer *FLACParser::readBuffer(bool doSeek, FLAC__uint64 sample)
     if (err != OK) {
         return NULL;
     }
-    size_t bufferSize = blocksize * getChannels() * sizeof(short);
-    CHECK(bufferSize <= mMaxBufferSize);
     short *data = (short *) buffer->data();
-    buffer->set_range(0, bufferSize);
-    // copy PCM from FLAC write buffer to our media buffer, with interleaving
-    (*mCopy)(data, mWriteBuffer, blocksize);
+    // copy PCM from FLAC write buffer to our media buffer, with interleaving,
+    // starting at the sought sample
+    const FLAC__int32 *src[2];
+    for (unsigned c = 0; c < getChannels(); ++c) {
+        src[c] = mWriteBuffer[c] + skip;
+    }
+    size_t numSamples = mWriteHeader.blocksize - skip;
+    (*mCopy)(data, src, numSamples);
     // fill in buffer metadata
-    CHECK(mWriteHeader.number_type == FLAC__FRAME_NUMBER_TYPE_SAMPLE_NUMBER);
-    FLAC__uint64 sampleNumber = mWriteHeader.number.sample_number;
+    FLAC__uint64 sampleNumber = mWriteHeader.number.sample_number + skip;
     int64_t timeUs = (1000000LL * sampleNumber) / getSampleRate();
     buffer->meta_data()->setInt64(kKeyTime, timeUs);
     buffer->meta_data()->setInt32(kKeyIsSyncFrame, 1);
+    // append the following frames for as long as another one surely fits,
+    // a failure surfaces again on the next read
+    while (numSamples + getMaxBlockSize() <= mBufferSamples && decodeFrame()) {
+        (*mCopy)(data + numSamples * getChannels(), mWriteBuffer,
+                mWriteHeader.blocksize);
+        numSamples += mWriteHeader.blocksize;
+    }
+    size_t bufferSize = numSamples * getChannels() * sizeof(short);
+    CHECK(bufferSize <= mMaxBufferSize);
+    buffer->set_range(0, bufferSize);
     return buffer;
 }
 
@@ -761,7 +904,10 @@ sp<MediaSource> FLACExtractor::getTrack(size_t index)
     if (mInitCheck != OK || index > 0) {
         return NULL;
     }
-    return new FLACSource(mDataSource, mTrackMetadata);
+    // Decoding runs ahead on its own thread, keeping all but one of the
+    // source's buffers filled.
+    return new DecodeAheadSource(
+            new FLACSource(mDataSource, mTrackMetadata), kNumBuffers - 1);
 }
 
 sp<MetaData> FLACExtractor::getTrackMetaData(
@@ -14,20 +14,54 @@
  * limitations under the License.
  */
 
+//#define LOG_NDEBUG 0
+#define LOG_TAG "FileSource"
+#include <utils/Log.h>
+
+#include <media/stagefright/foundation/ABuffer.h>
 #include <media/stagefright/foundation/ADebug.h>
 #include <media/stagefright/FileSource.h>
+#include <cutils/properties.h>
 #include <sys/types.h>
 #include <unistd.h>
 #include <sys/types.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <fcntl.h>
+#include <limits.h>
 
 namespace android {
 
+// Files up to this size are memory mapped if media.stagefright.mmap is set.
+// Not by default, since accessing a mapping of a file truncated or on
+// removed storage raises SIGBUS rather than failing the read.
+// The mapping is private and writable so that the views handed out by
+// getMappedRange() can be modified like any buffer, without affecting
+// the file.
+static const int64_t kMaxMappingSize = 256 * 1024 * 1024;
+
+// Reads starting less than this past the end of the previous one count as
+// sequential, which tolerates the interleaving of the tracks.
+static const off64_t kMaxSequentialGap = 1024 * 1024;
+
+// The mapping is advised sequential after this many sequential reads, and
+// the range that far ahead of the reads is advised to be needed soon.
+static const uint32_t kNumSequentialReadsForReadAhead = 8;
+static const off64_t kReadAheadSize = 1024 * 1024;
+
 FileSource::FileSource(const char *filename)
     : mFd(-1),
       mOffset(0),
       mLength(-1),
+      mUri(filename),
+      mMapping(NULL),
+      mMappingSize(0),
+      mData(NULL),
+      mLastReadEnd(0),
+      mNumSequentialReads(0),
+      mAdvice(MADV_NORMAL),
+      mReadAheadEnd(0),
+      mNumSyscalls(0),
       mDecryptHandle(NULL),
       mDrmManagerClient(NULL),
       mDrmBufOffset(0),
@@ -38,6 +72,7 @@ FileSource::FileSource(const char *filename)
 
     if (mFd >= 0) {
         mLength = lseek64(mFd, 0, SEEK_END);
+        init();
     } else {
         ALOGE("Failed to open file '%s'. (%s)", filename, strerror(errno));
     }
@@ -47,6 +82,14 @@ FileSource::FileSource(int fd, int64_t offset, int64_t length)
     : mFd(fd),
       mOffset(offset),
       mLength(length),
+      mMapping(NULL),
+      mMappingSize(0),
+      mData(NULL),
+      mLastReadEnd(0),
+      mNumSequentialReads(0),
+      mAdvice(MADV_NORMAL),
+      mReadAheadEnd(0),
+      mNumSyscalls(0),
       mDecryptHandle(NULL),
       mDrmManagerClient(NULL),
       mDrmBufOffset(0),
@@ -54,9 +97,62 @@ FileSource::FileSource(int fd, int64_t offset, int64_t length)
       mDrmBuf(NULL){
     CHECK(offset >= 0);
     CHECK(length >= 0);
+
+    // The file descriptor's path, unless the media is embedded in a larger
+    // file whose name says nothing about it.
+    if (offset == 0) {
+        char path[PATH_MAX];
+        String8 link = String8::format("/proc/self/fd/%d", fd);
+        ssize_t n = readlink(link.string(), path, sizeof(path) - 1);
+        if (n > 0) {
+            path[n] = '\0';
+            mUri = path;
+        }
+    }
+
+    init();
+}
+
+void FileSource::init() {
+    char value[PROPERTY_VALUE_MAX];
+    if (!property_get("media.stagefright.mmap", value, NULL)
+            || (strcmp(value, "1") && strcasecmp(value, "true"))) {
+        return;
+    }
+
+    if (mLength <= 0 || mLength > kMaxMappingSize) {
+        return;
+    }
+
+    // The mapping has to start on a page boundary.
+    off64_t pageSize = sysconf(_SC_PAGESIZE);
+    off64_t mappingOffset = mOffset / pageSize * pageSize;
+    size_t mappingSize = mLength + (mOffset - mappingOffset);
+
+    void *mapping = mmap64(
+            NULL, mappingSize, PROT_READ | PROT_WRITE, MAP_PRIVATE,
+            mFd, mappingOffset);
+    if (mapping == MAP_FAILED) {
+        ALOGW("Failed to map %lld bytes (%s)", mLength, strerror(errno));
+        return;
+    }
+
+    mMapping = (uint8_t *)mapping;
+    mMappingSize = mappingSize;
+    mData = mMapping + (mOffset - mappingOffset);
+
+    ALOGV("mapped %lld bytes", mLength);
 }
 
 FileSource::~FileSource() {
+    ALOGV("%u syscalls", mNumSyscalls);
+
+    if (mMapping != NULL) {
+        munmap(mMapping, mMappingSize);
+        mMapping = NULL;
+        mData = NULL;
+    }
+
     if (mFd >= 0) {
         close(mFd);
         mFd = -1;
@@ -104,17 +200,103 @@ ssize_t FileSource::readAt(off64_t offset, void *data, size_t size) {
     if (mDecryptHandle != NULL && DecryptApiType::CONTAINER_BASED
             == mDecryptHandle->decryptApiType) {
         return readAtDRM(offset, data, size);
-   } else {
-        off64_t result = lseek64(mFd, offset + mOffset, SEEK_SET);
-        if (result == -1) {
-            ALOGE("seek to %lld failed", offset + mOffset);
+    } else if (mData != NULL) {
+        adviseAccess_l(offset, size);
+
+        memcpy(data, mData + offset, size);
+        return size;
+    } else {
+        ++mNumSyscalls;
+        ssize_t n = pread64(mFd, data, size, offset + mOffset);
+        if (n < 0) {
+            ALOGE("read at %lld failed (%s)", offset + mOffset, strerror(errno));
             return UNKNOWN_ERROR;
         }
 
-        return ::read(mFd, data, size);
+        return n;
     }
 }
 
+// A view into the mapping of a FileSource, which it keeps alive.
+struct MappedRange : public ABuffer {
+    MappedRange(const sp<DataSource> &source, void *data, size_t size)
+        : ABuffer(data, size),
+          mSource(source) {
+    }
+
+protected:
+    virtual ~MappedRange() {}
+
+private:
+    sp<DataSource> mSource;
+
+    MappedRange(const MappedRange &);
+    MappedRange &operator=(const MappedRange &);
+};
+
+sp<ABuffer> FileSource::getMappedRange(off64_t offset, size_t size) {
+    Mutex::Autolock autoLock(mLock);
+
+    if (mData == NULL || mDecryptHandle != NULL
+            || offset < 0 || offset + (int64_t)size > mLength) {
+        return NULL;
+    }
+
+    adviseAccess_l(offset, size);
+
+    return new MappedRange(this, mData + offset, size);
+}
+
+void FileSource::adviseAccess_l(off64_t offset, size_t size) {
+    if (offset >= mLastReadEnd && offset - mLastReadEnd < kMaxSequentialGap) {
+        if (mNumSequentialReads < kNumSequentialReadsForReadAhead) {
+            ++mNumSequentialReads;
+        }
+    } else {
+        mNumSequentialReads = 0;
+        mReadAheadEnd = 0;
+    }
+    mLastReadEnd = offset + size;
+
+    int advice = (mNumSequentialReads == kNumSequentialReadsForReadAhead)
+        ? MADV_SEQUENTIAL : MADV_NORMAL;
+    if (advice != mAdvice) {
+        ++mNumSyscalls;
+        madvise(mMapping, mMappingSize, advice);
+        mAdvice = advice;
+    }
+
+    if (advice != MADV_SEQUENTIAL
+            || mLastReadEnd + kReadAheadSize / 2 < mReadAheadEnd) {
+        return;
+    }
+
+    // Keep the next kReadAheadSize bytes on their way in, by halves.
+    off64_t pageSize = sysconf(_SC_PAGESIZE);
+    off64_t start = (mReadAheadEnd > mLastReadEnd) ? mReadAheadEnd : mLastReadEnd;
+    off64_t end = mLastReadEnd + kReadAheadSize;
+    if (end > mLength) {
+        end = mLength;
+    }
+    if (start >= end) {
+        return;
+    }
+
+    off64_t mappingStart = start + (mData - mMapping);
+    mappingStart = mappingStart / pageSize * pageSize;
+    off64_t mappingEnd = end + (mData - mMapping);
+
+    ++mNumSyscalls;
+    madvise(mMapping + mappingStart, mappingEnd - mappingStart, MADV_WILLNEED);
+    mReadAheadEnd = end;
+}
+
+uint32_t FileSource::getNumSyscalls() {
+    Mutex::Autolock autoLock(mLock);
+
+    return mNumSyscalls;
+}
+
 status_t FileSource::getSize(off64_t *size) {
     Mutex::Autolock autoLock(mLock);
 
@@ -161,6 +343,10 @@ void FileSource::getDrmInfo(sp<DecryptHandle> &handle, DrmManagerClient **client
     *client = mDrmManagerClient;
 }
 
+String8 FileSource::getUri() {
+    return mUri;
+}
+
 ssize_t FileSource::readAtDRM(off64_t offset, void *data, size_t size) {
     size_t DRM_CACHE_SIZE = 1024;
     if (mDrmBuf == NULL) {
@@ -175,6 +361,7 @@ ssize_t FileSource::readAtDRM(off64_t offset, void *data, size_t size) {
     } else if (size <= DRM_CACHE_SIZE) {
         /* Buffer new data */
         mDrmBufOffset =  offset + mOffset;
+        ++mNumSyscalls;
         mDrmBufSize = mDrmManagerClient->pread(mDecryptHandle, mDrmBuf,
                 DRM_CACHE_SIZE, offset + mOffset);
         if (mDrmBufSize > 0) {
@@ -187,6 +374,7 @@ ssize_t FileSource::readAtDRM(off64_t offset, void *data, size_t size) {
         }
     } else {
         /* Too big chunk to cache. Call DRM directly */
+        ++mNumSyscalls;
         return mDrmManagerClient->pread(mDecryptHandle, data, size, offset + mOffset);
     }
 }
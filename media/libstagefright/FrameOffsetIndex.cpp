@@ -0,0 +1,109 @@
+/*
+ * Copyright (C) 2012 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "FrameOffsetIndex"
+#include <utils/Log.h>
+
+#include "include/FrameOffsetIndex.h"
+
+#include <media/stagefright/foundation/ADebug.h>
+
+namespace android {
+
+FrameOffsetIndex::FrameOffsetIndex(
+        off64_t firstFrameOffset, size_t framesPerEntry)
+    : mFirstFrameOffset(firstFrameOffset),
+      mFramesPerEntry(framesPerEntry),
+      mNumFrames(0),
+      mEndOffset(firstFrameOffset),
+      mComplete(false) {
+    CHECK_GT(mFramesPerEntry, 0u);
+}
+
+FrameOffsetIndex::~FrameOffsetIndex() {
+}
+
+void FrameOffsetIndex::addFrame(int64_t frame, off64_t offset, size_t size) {
+    Mutex::Autolock autoLock(mLock);
+
+    if (mComplete || frame != mNumFrames || offset != mEndOffset) {
+        return;
+    }
+
+    if ((frame % mFramesPerEntry) == 0) {
+        mOffsets.push(offset);
+    }
+
+    ++mNumFrames;
+    mEndOffset = offset + size;
+}
+
+void FrameOffsetIndex::setComplete() {
+    Mutex::Autolock autoLock(mLock);
+
+    if (!mComplete) {
+        ALOGV("index complete, %lld frames", mNumFrames);
+        mComplete = true;
+    }
+}
+
+bool FrameOffsetIndex::isComplete() {
+    Mutex::Autolock autoLock(mLock);
+    return mComplete;
+}
+
+int64_t FrameOffsetIndex::countFrames() {
+    Mutex::Autolock autoLock(mLock);
+    return mNumFrames;
+}
+
+off64_t FrameOffsetIndex::endOffset() {
+    Mutex::Autolock autoLock(mLock);
+    return mEndOffset;
+}
+
+bool FrameOffsetIndex::findFrame(
+        int64_t frame, int64_t *entryFrame, off64_t *offset) {
+    Mutex::Autolock autoLock(mLock);
+
+    if (frame < 0 || frame >= mNumFrames) {
+        return false;
+    }
+
+    size_t index = frame / mFramesPerEntry;
+    CHECK_LT(index, mOffsets.size());
+
+    *entryFrame = (int64_t)index * mFramesPerEntry;
+    *offset = mOffsets.itemAt(index);
+
+    return true;
+}
+
+off64_t FrameOffsetIndex::estimateOffset(
+        int64_t frame, size_t defaultFrameSize) {
+    Mutex::Autolock autoLock(mLock);
+
+    if (mNumFrames == 0) {
+        return mFirstFrameOffset + frame * defaultFrameSize;
+    }
+
+    off64_t indexedSize = mEndOffset - mFirstFrameOffset;
+
+    return mEndOffset + ((frame - mNumFrames) * indexedSize) / mNumFrames;
+}
+
+}  // namespace android
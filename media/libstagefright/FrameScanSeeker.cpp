@@ -0,0 +1,242 @@
+/*
+ * Copyright (C) 2012 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "FrameScanSeeker"
+#include <utils/Log.h>
+
+#include "include/FrameScanSeeker.h"
+#include "include/avc_utils.h"
+
+#include <sys/prctl.h>
+
+#include <media/stagefright/foundation/ADebug.h>
+#include <media/stagefright/DataSource.h>
+#include <media/stagefright/Utils.h>
+
+namespace android {
+
+// Same as in MP3Extractor, everything but the fields that may change
+// from frame to frame must match the first frame's header.
+static const uint32_t kMask = 0xfffe0c00;
+
+static const int64_t kEntryIntervalUs = 1000000ll;
+
+// Give up if this much data doesn't contain a single valid frame.
+static const size_t kMaxResyncBytes = 128 * 1024;
+
+static const size_t kScanBufferSize = 64 * 1024;
+
+FrameScanSeeker::FrameScanSeeker(
+        const sp<DataSource> &source, off64_t first_frame_pos,
+        uint32_t fixed_header)
+    : mSource(source),
+      mFirstFramePos(first_frame_pos),
+      mFixedHeader(fixed_header),
+      mStarted(false),
+      mDone(false),
+      mScannedUs(-1),
+      mComplete(false),
+      mDurationUs(0) {
+}
+
+FrameScanSeeker::~FrameScanSeeker() {
+    if (mStarted) {
+        mDone = true;
+
+        void *dummy;
+        pthread_join(mThread, &dummy);
+    }
+}
+
+void FrameScanSeeker::start() {
+    CHECK(!mStarted);
+
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_JOINABLE);
+
+    pthread_create(&mThread, &attr, ThreadWrapper, this);
+
+    pthread_attr_destroy(&attr);
+
+    mStarted = true;
+}
+
+bool FrameScanSeeker::getDuration(int64_t *durationUs) {
+    Mutex::Autolock autoLock(mLock);
+
+    if (!mComplete) {
+        return false;
+    }
+
+    *durationUs = mDurationUs;
+
+    return true;
+}
+
+bool FrameScanSeeker::getOffsetForTime(int64_t *timeUs, off64_t *pos) {
+    int64_t targetUs = *timeUs;
+    Entry entry;
+
+    {
+        Mutex::Autolock autoLock(mLock);
+
+        if (mEntries.isEmpty() || (targetUs > mScannedUs && !mComplete)) {
+            return false;
+        }
+
+        // Find the last entry at or before the target.
+        size_t lo = 0;
+        size_t hi = mEntries.size();
+        while (hi - lo > 1) {
+            size_t mid = lo + (hi - lo) / 2;
+            if (mEntries.itemAt(mid).mTimeUs <= targetUs) {
+                lo = mid;
+            } else {
+                hi = mid;
+            }
+        }
+
+        entry = mEntries.itemAt(lo);
+    }
+
+    // Walk the frames following the entry up to the one containing the
+    // target, that's at most kEntryIntervalUs worth of frame headers.
+    size_t frameSize;
+    int64_t frameUs;
+    while (entry.mTimeUs < targetUs
+            && findFrame(entry.mPos, &frameSize, &frameUs)
+            && entry.mTimeUs + frameUs <= targetUs) {
+        entry.mTimeUs += frameUs;
+        entry.mPos += frameSize;
+    }
+
+    *timeUs = entry.mTimeUs;
+    *pos = entry.mPos;
+
+    return true;
+}
+
+bool FrameScanSeeker::findFrame(
+        off64_t pos, size_t *frameSize, int64_t *frameUs) {
+    uint8_t headerData[4];
+    if (mSource->readAt(pos, headerData, 4) < 4) {
+        return false;
+    }
+
+    uint32_t header = U32_AT(headerData);
+
+    int sampleRate;
+    int numSamples;
+    if ((header & kMask) != (mFixedHeader & kMask)
+            || !GetMPEGAudioFrameSize(
+                header, frameSize, &sampleRate, NULL, NULL, &numSamples)) {
+        return false;
+    }
+
+    *frameUs = numSamples * 1000000ll / sampleRate;
+
+    return true;
+}
+
+// static
+void *FrameScanSeeker::ThreadWrapper(void *me) {
+    androidSetThreadPriority(0, ANDROID_PRIORITY_BACKGROUND);
+
+    static_cast<FrameScanSeeker *>(me)->threadEntry();
+
+    return NULL;
+}
+
+void FrameScanSeeker::threadEntry() {
+    prctl(PR_SET_NAME, (unsigned long)"FrameScanSeeker", 0, 0, 0);
+
+    uint8_t *buffer = new uint8_t[kScanBufferSize];
+    off64_t bufferPos = 0;
+    size_t bufferSize = 0;
+
+    off64_t pos = mFirstFramePos;
+    int64_t numSamples = 0;
+    int sampleRate = 0;
+    int64_t nextEntryUs = 0;
+    size_t resyncBytes = 0;
+    bool reachedEOS = false;
+
+    while (!mDone) {
+        if (pos < bufferPos || pos + 4 > bufferPos + (off64_t)bufferSize) {
+            ssize_t n = mSource->readAt(pos, buffer, kScanBufferSize);
+            if (n < 4) {
+                reachedEOS = true;
+                break;
+            }
+
+            bufferPos = pos;
+            bufferSize = n;
+        }
+
+        uint32_t header = U32_AT(&buffer[pos - bufferPos]);
+
+        size_t frameSize;
+        int frameSamples;
+        if ((header & kMask) != (mFixedHeader & kMask)
+                || !GetMPEGAudioFrameSize(
+                    header, &frameSize, &sampleRate, NULL, NULL,
+                    &frameSamples)) {
+            // Lost sync, look for the next frame one byte further.
+            if (++resyncBytes > kMaxResyncBytes) {
+                ALOGW("lost sync at offset %lld, index is incomplete", pos);
+                break;
+            }
+
+            ++pos;
+            continue;
+        }
+
+        resyncBytes = 0;
+
+        int64_t timeUs = numSamples * 1000000ll / sampleRate;
+
+        if (timeUs >= nextEntryUs) {
+            Entry entry;
+            entry.mTimeUs = timeUs;
+            entry.mPos = pos;
+
+            Mutex::Autolock autoLock(mLock);
+            mEntries.push(entry);
+            mScannedUs = timeUs;
+
+            nextEntryUs = timeUs + kEntryIntervalUs;
+        }
+
+        numSamples += frameSamples;
+        pos += frameSize;
+    }
+
+    delete[] buffer;
+    buffer = NULL;
+
+    if (reachedEOS && sampleRate > 0) {
+        Mutex::Autolock autoLock(mLock);
+        mComplete = true;
+        mDurationUs = numSamples * 1000000ll / sampleRate;
+
+        ALOGV("indexed %d entries, duration %lld us",
+              mEntries.size(), mDurationUs);
+    }
+}
+
+}  // namespace android
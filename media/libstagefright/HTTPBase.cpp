@@ -29,9 +29,33 @@
 
 #include <cutils/properties.h>
 #include <cutils/qtaguid.h>
+#include <utils/KeyedVector.h>
 
 namespace android {
 
+// Estimates of past streams, kept per network for as long as the process
+// lives so that new streams don't start out without one.
+struct NetworkBandwidth {
+    double mBandwidthBps;
+    int64_t mUpdatedUs;
+};
+
+static Mutex gNetworkBandwidthLock;
+static KeyedVector<String8, NetworkBandwidth> gNetworkBandwidth;
+
+// Weight of a new measurement in the per network average.
+static const double kNetworkBandwidthWeight = 0.25;
+
+// Per network estimates older than this are not trusted anymore.
+static const int64_t kMaxNetworkBandwidthAgeUs = 3600000000ll;  // 1 hour
+
+static const size_t kMaxNumNetworks = 16;
+
+// A source contributes to the per network estimate at most this often and
+// only once it has made this many measurements.
+static const int64_t kNetworkBandwidthUpdateIntervalUs = 1000000ll;
+static const size_t kMinNetworkBandwidthItems = 10;
+
 HTTPBase::HTTPBase()
     : mNumBandwidthHistoryItems(0),
       mTotalTransferTimeUs(0),
@@ -39,6 +63,7 @@ HTTPBase::HTTPBase()
       mPrevBandwidthMeasureTimeUs(0),
       mPrevEstimatedBandWidthKbps(0),
       mBandWidthCollectFreqMs(5000),
+      mPrevNetworkBandwidthUpdateUs(0),
       mUIDValid(false),
       mUID(0) {
 }
@@ -55,8 +80,26 @@ sp<HTTPBase> HTTPBase::Create(uint32_t flags) {
     }
 }
 
+sp<HTTPBase> HTTPBase::createConnection(off64_t offset) {
+    return NULL;
+}
+
+String8 HTTPBase::getCacheValidator() {
+    return String8();
+}
+
+void HTTPBase::setBandwidthOwner(const sp<HTTPBase> &owner) {
+    mBandwidthOwner = owner;
+}
+
 void HTTPBase::addBandwidthMeasurement(
         size_t numBytes, int64_t delayUs) {
+    sp<HTTPBase> owner = mBandwidthOwner.promote();
+    if (owner != NULL) {
+        owner->addBandwidthMeasurement(numBytes, delayUs);
+        return;
+    }
+
     Mutex::Autolock autoLock(mLock);
 
     BandwidthEntry entry;
@@ -85,13 +128,23 @@ void HTTPBase::addBandwidthMeasurement(
         }
     }
 
+    if (mNumBandwidthHistoryItems >= kMinNetworkBandwidthItems
+            && mTotalTransferTimeUs > 0) {
+        int64_t nowUs = ALooper::GetNowUs();
+        if (nowUs - mPrevNetworkBandwidthUpdateUs
+                >= kNetworkBandwidthUpdateIntervalUs) {
+            mPrevNetworkBandwidthUpdateUs = nowUs;
+            UpdateNetworkBandwidth(
+                    mTotalTransferBytes * 8E6 / mTotalTransferTimeUs);
+        }
+    }
 }
 
 bool HTTPBase::estimateBandwidth(int32_t *bandwidth_bps) {
     Mutex::Autolock autoLock(mLock);
 
     if (mNumBandwidthHistoryItems < 2) {
-        return false;
+        return GetNetworkBandwidthEstimate(bandwidth_bps);
     }
 
     *bandwidth_bps = ((double)mTotalTransferBytes * 8E6 / mTotalTransferTimeUs);
@@ -135,6 +188,93 @@ bool HTTPBase::getUID(uid_t *uid) const {
     return true;
 }
 
+// static
+String8 HTTPBase::GetNetworkKey() {
+    // The SSID isn't known down here, the Wi-Fi network is told apart by
+    // the gateway and DHCP server it handed out, cellular data by its
+    // radio technology.
+    char iface[PROPERTY_VALUE_MAX];
+    property_get("wifi.interface", iface, "wlan0");
+
+    char value[PROPERTY_VALUE_MAX];
+    if (property_get(String8::format("dhcp.%s.result", iface).string(),
+                value, NULL)
+            && !strcmp(value, "ok")) {
+        char gateway[PROPERTY_VALUE_MAX];
+        property_get(String8::format("dhcp.%s.gateway", iface).string(),
+                gateway, "");
+        property_get(String8::format("dhcp.%s.server", iface).string(),
+                value, "");
+
+        return String8::format("wifi:%s/%s", gateway, value);
+    }
+
+    property_get("gsm.network.type", value, "unknown");
+
+    return String8::format("mobile:%s", value);
+}
+
+// static
+void HTTPBase::UpdateNetworkBandwidth(double bandwidthBps) {
+    String8 key = GetNetworkKey();
+    int64_t nowUs = ALooper::GetNowUs();
+
+    Mutex::Autolock autoLock(gNetworkBandwidthLock);
+
+    ssize_t index = gNetworkBandwidth.indexOfKey(key);
+    if (index >= 0) {
+        NetworkBandwidth *entry = &gNetworkBandwidth.editValueAt(index);
+        if (nowUs - entry->mUpdatedUs > kMaxNetworkBandwidthAgeUs) {
+            entry->mBandwidthBps = bandwidthBps;
+        } else {
+            entry->mBandwidthBps +=
+                kNetworkBandwidthWeight * (bandwidthBps - entry->mBandwidthBps);
+        }
+        entry->mUpdatedUs = nowUs;
+        return;
+    }
+
+    if (gNetworkBandwidth.size() >= kMaxNumNetworks) {
+        size_t oldest = 0;
+        for (size_t i = 1; i < gNetworkBandwidth.size(); ++i) {
+            if (gNetworkBandwidth.valueAt(i).mUpdatedUs
+                    < gNetworkBandwidth.valueAt(oldest).mUpdatedUs) {
+                oldest = i;
+            }
+        }
+        gNetworkBandwidth.removeItemsAt(oldest);
+    }
+
+    NetworkBandwidth entry;
+    entry.mBandwidthBps = bandwidthBps;
+    entry.mUpdatedUs = nowUs;
+    gNetworkBandwidth.add(key, entry);
+
+    ALOGV("first bandwidth estimate for network %s: %.2f kbps",
+          key.string(), bandwidthBps / 1E3);
+}
+
+// static
+bool HTTPBase::GetNetworkBandwidthEstimate(int32_t *bandwidthBps) {
+    String8 key = GetNetworkKey();
+
+    Mutex::Autolock autoLock(gNetworkBandwidthLock);
+
+    ssize_t index = gNetworkBandwidth.indexOfKey(key);
+    if (index < 0) {
+        return false;
+    }
+
+    const NetworkBandwidth &entry = gNetworkBandwidth.valueAt(index);
+    if (ALooper::GetNowUs() - entry.mUpdatedUs > kMaxNetworkBandwidthAgeUs) {
+        return false;
+    }
+
+    *bandwidthBps = (int32_t)entry.mBandwidthBps;
+
+    return true;
+}
+
 // static
 void HTTPBase::RegisterSocketUserTag(int sockfd, uid_t uid, uint32_t kTag) {
     int res = qtaguid_tagSocket(sockfd, kTag, uid);
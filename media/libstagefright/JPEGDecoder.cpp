@@ -0,0 +1,668 @@
+/*
+ * Copyright (C) 2012 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "JPEGDecoder"
+#include <utils/Log.h>
+
+#include "include/JPEGDecoder.h"
+
+#include <setjmp.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+extern "C" {
+#include "jpeglib.h"
+}
+
+#include <media/stagefright/foundation/ADebug.h>
+#include <media/stagefright/ColorConverter.h>
+#include <media/stagefright/MediaBuffer.h>
+#include <media/stagefright/MediaCodecList.h>
+#include <media/stagefright/MediaDefs.h>
+#include <media/stagefright/MediaErrors.h>
+#include <media/stagefright/MediaSource.h>
+#include <media/stagefright/MetaData.h>
+#include <media/stagefright/OMXCodec.h>
+#include <private/media/VideoFrame.h>
+
+namespace android {
+
+// Quality of the thumbnails handed back by createThumbnail().
+static const int kThumbnailQuality = 85;
+
+// OMX decoders output the full resolution, stay away from huge images.
+static const int64_t kMaxOMXPixels = 4096 * 4096;
+
+struct ErrorManager {
+    struct jpeg_error_mgr mPub;
+    jmp_buf mJumpBuffer;
+};
+
+static void ErrorExit(j_common_ptr cinfo) {
+    ErrorManager *err = (ErrorManager *)cinfo->err;
+    (*cinfo->err->output_message)(cinfo);
+    longjmp(err->mJumpBuffer, 1);
+}
+
+static void OutputMessage(j_common_ptr cinfo) {
+    char buffer[JMSG_LENGTH_MAX];
+    (*cinfo->err->format_message)(cinfo, buffer);
+    ALOGW("libjpeg: %s", buffer);
+}
+
+static void SetErrorManager(j_common_ptr cinfo, ErrorManager *err) {
+    cinfo->err = jpeg_std_error(&err->mPub);
+    err->mPub.error_exit = ErrorExit;
+    err->mPub.output_message = OutputMessage;
+}
+
+// Reads the compressed image from memory.
+static void InitSource(j_decompress_ptr cinfo) {
+}
+
+static boolean FillInputBuffer(j_decompress_ptr cinfo) {
+    // The data is truncated, terminate it with a fake EOI marker like
+    // libjpeg's own stdio source does.
+    static const JOCTET kEOI[2] = { 0xff, JPEG_EOI };
+
+    WARNMS(cinfo, JWRN_JPEG_EOF);
+    cinfo->src->next_input_byte = kEOI;
+    cinfo->src->bytes_in_buffer = sizeof(kEOI);
+
+    return TRUE;
+}
+
+static void SkipInputData(j_decompress_ptr cinfo, long numBytes) {
+    if (numBytes <= 0) {
+        return;
+    }
+
+    if ((size_t)numBytes > cinfo->src->bytes_in_buffer) {
+        FillInputBuffer(cinfo);
+        return;
+    }
+
+    cinfo->src->next_input_byte += numBytes;
+    cinfo->src->bytes_in_buffer -= numBytes;
+}
+
+static void TermSource(j_decompress_ptr cinfo) {
+}
+
+static void SetMemorySource(
+        j_decompress_ptr cinfo, struct jpeg_source_mgr *src,
+        const void *data, size_t size) {
+    src->init_source = InitSource;
+    src->fill_input_buffer = FillInputBuffer;
+    src->skip_input_data = SkipInputData;
+    src->resync_to_restart = jpeg_resync_to_restart;
+    src->term_source = TermSource;
+    src->next_input_byte = (const JOCTET *)data;
+    src->bytes_in_buffer = size;
+
+    cinfo->src = src;
+}
+
+// Writes the compressed image to a buffer that grows as needed.
+struct MemoryDestination {
+    struct jpeg_destination_mgr mPub;
+    uint8_t *mData;
+    size_t mCapacity;
+};
+
+static void InitDestination(j_compress_ptr cinfo) {
+    MemoryDestination *dest = (MemoryDestination *)cinfo->dest;
+    dest->mPub.next_output_byte = dest->mData;
+    dest->mPub.free_in_buffer = dest->mCapacity;
+}
+
+static boolean EmptyOutputBuffer(j_compress_ptr cinfo) {
+    MemoryDestination *dest = (MemoryDestination *)cinfo->dest;
+
+    // libjpeg calls this with the whole buffer used, whatever
+    // free_in_buffer says.
+    size_t used = dest->mCapacity;
+    uint8_t *data = (uint8_t *)realloc(dest->mData, dest->mCapacity * 2);
+    if (data == NULL) {
+        ERREXIT1(cinfo, JERR_OUT_OF_MEMORY, 0);
+    }
+
+    dest->mData = data;
+    dest->mCapacity *= 2;
+    dest->mPub.next_output_byte = data + used;
+    dest->mPub.free_in_buffer = dest->mCapacity - used;
+
+    return TRUE;
+}
+
+static void TermDestination(j_compress_ptr cinfo) {
+}
+
+// The largest libjpeg scale down, 1/1 to 1/8, that keeps the longer side
+// at least |maxDimension| pixels.
+static int GetScaleDenom(int32_t width, int32_t height, int32_t maxDimension) {
+    int32_t longerSide = width > height ? width : height;
+
+    int denom = 1;
+    while (maxDimension > 0 && denom < 8
+            && longerSide / (denom * 2) >= maxDimension) {
+        denom *= 2;
+    }
+
+    return denom;
+}
+
+static void FitDimensions(
+        int32_t width, int32_t height, int32_t maxDimension,
+        int32_t *fitWidth, int32_t *fitHeight) {
+    int32_t longerSide = width > height ? width : height;
+
+    if (maxDimension <= 0 || longerSide <= maxDimension) {
+        *fitWidth = width;
+        *fitHeight = height;
+        return;
+    }
+
+    *fitWidth = (int32_t)((int64_t)width * maxDimension / longerSide);
+    *fitHeight = (int32_t)((int64_t)height * maxDimension / longerSide);
+
+    if (*fitWidth < 1) {
+        *fitWidth = 1;
+    }
+    if (*fitHeight < 1) {
+        *fitHeight = 1;
+    }
+}
+
+// Nearest neighbour resampling, only used for what the scaled IDCT could
+// not take off, i.e. less than a factor 2 for most images.
+static uint8_t *ScaleRGB888(
+        const uint8_t *src, int32_t srcWidth, int32_t srcHeight,
+        int32_t dstWidth, int32_t dstHeight) {
+    uint8_t *dst = (uint8_t *)malloc(dstWidth * dstHeight * 3);
+    if (dst == NULL) {
+        return NULL;
+    }
+
+    uint8_t *out = dst;
+    for (int32_t y = 0; y < dstHeight; ++y) {
+        const uint8_t *row =
+            src + (size_t)((int64_t)y * srcHeight / dstHeight) * srcWidth * 3;
+
+        for (int32_t x = 0; x < dstWidth; ++x) {
+            const uint8_t *pixel =
+                row + (size_t)((int64_t)x * srcWidth / dstWidth) * 3;
+
+            out[0] = pixel[0];
+            out[1] = pixel[1];
+            out[2] = pixel[2];
+            out += 3;
+        }
+    }
+
+    return dst;
+}
+
+static inline uint8_t from565to8(uint16_t p, int start, int bits) {
+    uint8_t c = (p >> start) & ((1 << bits) - 1);
+    return (c << (8 - bits)) | (c >> (bits - (8 - bits)));
+}
+
+static status_t ReadHeader(
+        const void *data, size_t size,
+        int32_t *width, int32_t *height, bool *progressive) {
+    struct jpeg_decompress_struct cinfo;
+    struct jpeg_source_mgr src;
+    ErrorManager err;
+
+    SetErrorManager((j_common_ptr)&cinfo, &err);
+    if (setjmp(err.mJumpBuffer)) {
+        jpeg_destroy_decompress(&cinfo);
+        return ERROR_MALFORMED;
+    }
+
+    jpeg_create_decompress(&cinfo);
+    SetMemorySource(&cinfo, &src, data, size);
+
+    jpeg_read_header(&cinfo, TRUE);
+
+    *width = cinfo.image_width;
+    *height = cinfo.image_height;
+    *progressive = cinfo.progressive_mode;
+
+    jpeg_destroy_decompress(&cinfo);
+
+    return OK;
+}
+
+// Baseline and progressive images alike, scaled in the IDCT.
+static status_t DecodeScaled(
+        const void *data, size_t size, int32_t maxDimension,
+        uint8_t **rgb, int32_t *width, int32_t *height) {
+    struct jpeg_decompress_struct cinfo;
+    struct jpeg_source_mgr src;
+    ErrorManager err;
+    uint8_t *volatile pixels = NULL;
+
+    SetErrorManager((j_common_ptr)&cinfo, &err);
+    if (setjmp(err.mJumpBuffer)) {
+        jpeg_destroy_decompress(&cinfo);
+        free(pixels);
+        return ERROR_MALFORMED;
+    }
+
+    jpeg_create_decompress(&cinfo);
+    SetMemorySource(&cinfo, &src, data, size);
+
+    jpeg_read_header(&cinfo, TRUE);
+
+    bool gray = (cinfo.jpeg_color_space == JCS_GRAYSCALE);
+
+    cinfo.scale_num = 1;
+    cinfo.scale_denom =
+        GetScaleDenom(cinfo.image_width, cinfo.image_height, maxDimension);
+    cinfo.out_color_space = gray ? JCS_GRAYSCALE : JCS_RGB;
+    if (maxDimension > 0) {
+        // Not worth the cycles for a thumbnail.
+        cinfo.dct_method = JDCT_IFAST;
+        cinfo.do_fancy_upsampling = FALSE;
+    }
+
+    jpeg_start_decompress(&cinfo);
+
+    ALOGV("decoding %ux%u %s image at 1/%u",
+         cinfo.image_width, cinfo.image_height,
+         cinfo.progressive_mode ? "progressive" : "baseline",
+         cinfo.scale_denom);
+
+    size_t stride = cinfo.output_width * 3;
+    pixels = (uint8_t *)malloc(stride * cinfo.output_height);
+    if (pixels == NULL) {
+        jpeg_destroy_decompress(&cinfo);
+        return NO_MEMORY;
+    }
+
+    while (cinfo.output_scanline < cinfo.output_height) {
+        uint8_t *row = pixels + cinfo.output_scanline * stride;
+        JSAMPROW rowPointer = row;
+        jpeg_read_scanlines(&cinfo, &rowPointer, 1);
+
+        if (gray) {
+            // Expand in place, from the end of the row backwards.
+            for (int32_t x = cinfo.output_width - 1; x >= 0; --x) {
+                row[x * 3] = row[x * 3 + 1] = row[x * 3 + 2] = row[x];
+            }
+        }
+    }
+
+    *width = cinfo.output_width;
+    *height = cinfo.output_height;
+    *rgb = pixels;
+
+    jpeg_finish_decompress(&cinfo);
+    jpeg_destroy_decompress(&cinfo);
+
+    return OK;
+}
+
+// Hands the whole compressed image to the OMX decoder as one buffer.
+struct CompressedImageSource : public MediaSource {
+    CompressedImageSource(
+            const void *data, size_t size, const sp<MetaData> &format)
+        : mData(data),
+          mSize(size),
+          mFormat(format),
+          mDone(false) {
+    }
+
+    virtual status_t start(MetaData *params) {
+        mDone = false;
+        return OK;
+    }
+
+    virtual status_t stop() {
+        return OK;
+    }
+
+    virtual sp<MetaData> getFormat() {
+        return mFormat;
+    }
+
+    virtual status_t read(
+            MediaBuffer **buffer, const ReadOptions *options) {
+        *buffer = NULL;
+
+        if (mDone) {
+            return ERROR_END_OF_STREAM;
+        }
+
+        // Doesn't own the data, the caller of decode() does.
+        *buffer = new MediaBuffer(const_cast<void *>(mData), mSize);
+        (*buffer)->meta_data()->setInt64(kKeyTime, 0);
+        mDone = true;
+
+        return OK;
+    }
+
+protected:
+    virtual ~CompressedImageSource() {}
+
+private:
+    const void *mData;
+    size_t mSize;
+    sp<MetaData> mFormat;
+    bool mDone;
+
+    CompressedImageSource(const CompressedImageSource &);
+    CompressedImageSource &operator=(const CompressedImageSource &);
+};
+
+JPEGDecoder::JPEGDecoder(const sp<IOMX> &omx)
+    : mOMX(omx),
+      mHaveOMXDecoder(false) {
+    const MediaCodecList *list = MediaCodecList::getInstance();
+    if (mOMX != NULL && list != NULL) {
+        mHaveOMXDecoder =
+            list->findCodecByType(MEDIA_MIMETYPE_IMAGE_JPEG, false) >= 0;
+    }
+}
+
+status_t JPEGDecoder::decode(
+        const void *data, size_t size, int32_t maxDimension,
+        uint8_t **rgb, int32_t *width, int32_t *height) {
+    *rgb = NULL;
+
+    int32_t imageWidth, imageHeight;
+    bool progressive;
+    status_t err = ReadHeader(data, size, &imageWidth, &imageHeight, &progressive);
+    if (err != OK) {
+        return err;
+    }
+
+    uint8_t *pixels = NULL;
+    int32_t decodedWidth, decodedHeight;
+
+    err = UNKNOWN_ERROR;
+    if (mHaveOMXDecoder && !progressive
+            && (int64_t)imageWidth * imageHeight <= kMaxOMXPixels) {
+        err = decodeWithOMX(
+                data, size, imageWidth, imageHeight, maxDimension,
+                &pixels, &decodedWidth, &decodedHeight);
+
+        if (err != OK) {
+            ALOGV("OMX decoder failed (%d), falling back to libjpeg", err);
+        }
+    }
+
+    if (err != OK) {
+        err = DecodeScaled(
+                data, size, maxDimension,
+                &pixels, &decodedWidth, &decodedHeight);
+
+        if (err != OK) {
+            return err;
+        }
+    }
+
+    int32_t fitWidth, fitHeight;
+    FitDimensions(
+            decodedWidth, decodedHeight, maxDimension, &fitWidth, &fitHeight);
+
+    if (fitWidth != decodedWidth || fitHeight != decodedHeight) {
+        uint8_t *scaled = ScaleRGB888(
+                pixels, decodedWidth, decodedHeight, fitWidth, fitHeight);
+        free(pixels);
+
+        if (scaled == NULL) {
+            return NO_MEMORY;
+        }
+        pixels = scaled;
+    }
+
+    *rgb = pixels;
+    *width = fitWidth;
+    *height = fitHeight;
+
+    return OK;
+}
+
+status_t JPEGDecoder::decodeWithOMX(
+        const void *data, size_t size,
+        int32_t width, int32_t height, int32_t maxDimension,
+        uint8_t **rgb, int32_t *outWidth, int32_t *outHeight) {
+    sp<MetaData> format = new MetaData;
+    format->setCString(kKeyMIMEType, MEDIA_MIMETYPE_IMAGE_JPEG);
+    format->setInt32(kKeyWidth, width);
+    format->setInt32(kKeyHeight, height);
+    format->setInt32(kKeyMaxInputSize, size);
+
+    sp<MediaSource> source = new CompressedImageSource(data, size, format);
+
+    sp<MediaSource> decoder = OMXCodec::Create(
+            mOMX, format, false /* createEncoder */, source, NULL,
+            OMXCodec::kHardwareCodecsOnly);
+
+    if (decoder == NULL) {
+        return ERROR_UNSUPPORTED;
+    }
+
+    status_t err = decoder->start();
+    if (err != OK) {
+        return err;
+    }
+
+    MediaBuffer *buffer = NULL;
+    do {
+        if (buffer != NULL) {
+            buffer->release();
+            buffer = NULL;
+        }
+        err = decoder->read(&buffer);
+    } while (err == INFO_FORMAT_CHANGED
+            || (err == OK && buffer->range_length() == 0));
+
+    if (err != OK) {
+        CHECK(buffer == NULL);
+        decoder->stop();
+        return err;
+    }
+
+    sp<MetaData> meta = decoder->getFormat();
+
+    int32_t srcFormat, srcWidth, srcHeight;
+    CHECK(meta->findInt32(kKeyColorFormat, &srcFormat));
+    CHECK(meta->findInt32(kKeyWidth, &srcWidth));
+    CHECK(meta->findInt32(kKeyHeight, &srcHeight));
+
+    // RGB565 first, it is what ColorConverter produces.
+    const uint8_t *src565 =
+        (const uint8_t *)buffer->data() + buffer->range_offset();
+    uint8_t *converted = NULL;
+    int32_t dstWidth = srcWidth;
+    int32_t dstHeight = srcHeight;
+
+    if (srcFormat != OMX_COLOR_Format16bitRGB565) {
+        ColorConverter converter(
+                (OMX_COLOR_FORMATTYPE)srcFormat, OMX_COLOR_Format16bitRGB565);
+
+        if (!converter.isValid()) {
+            buffer->release();
+            decoder->stop();
+            return ERROR_UNSUPPORTED;
+        }
+
+        if (converter.supportsScaling()) {
+            FitDimensions(
+                    srcWidth, srcHeight, maxDimension, &dstWidth, &dstHeight);
+
+            // Complete pixel pairs only.
+            dstWidth = dstWidth < 2 ? 2 : dstWidth & ~1;
+            dstHeight = dstHeight < 2 ? 2 : dstHeight & ~1;
+        }
+
+        converted = (uint8_t *)malloc(dstWidth * dstHeight * 2);
+        if (converted == NULL) {
+            buffer->release();
+            decoder->stop();
+            return NO_MEMORY;
+        }
+
+        err = converter.convert(
+                src565, srcWidth, srcHeight,
+                0, 0, srcWidth - 1, srcHeight - 1,
+                converted, dstWidth, dstHeight,
+                0, 0, dstWidth - 1, dstHeight - 1);
+
+        if (err != OK) {
+            free(converted);
+            buffer->release();
+            decoder->stop();
+            return err;
+        }
+
+        src565 = converted;
+    } else if (buffer->range_length() < (size_t)srcWidth * srcHeight * 2) {
+        buffer->release();
+        decoder->stop();
+        return ERROR_MALFORMED;
+    }
+
+    uint8_t *pixels = (uint8_t *)malloc(dstWidth * dstHeight * 3);
+    if (pixels != NULL) {
+        const uint16_t *in = (const uint16_t *)src565;
+        uint8_t *out = pixels;
+        for (int32_t i = 0; i < dstWidth * dstHeight; ++i) {
+            out[0] = from565to8(*in, 11, 5);
+            out[1] = from565to8(*in, 5, 6);
+            out[2] = from565to8(*in, 0, 5);
+            out += 3;
+            ++in;
+        }
+    }
+
+    free(converted);
+    buffer->release();
+    buffer = NULL;
+    decoder->stop();
+
+    if (pixels == NULL) {
+        return NO_MEMORY;
+    }
+
+    *rgb = pixels;
+    *outWidth = dstWidth;
+    *outHeight = dstHeight;
+
+    return OK;
+}
+
+MediaAlbumArt *JPEGDecoder::createThumbnail(
+        const MediaAlbumArt &art, int32_t maxDimension) {
+    if (art.mData == NULL || art.mSize < 2
+            || art.mData[0] != 0xff || art.mData[1] != 0xd8) {
+        // Not a JPEG, PNG album art is left for the caller to decode.
+        return NULL;
+    }
+
+    int32_t width, height;
+    bool progressive;
+    if (ReadHeader(art.mData, art.mSize, &width, &height, &progressive) != OK
+            || (width <= maxDimension && height <= maxDimension)) {
+        return NULL;
+    }
+
+    uint8_t *rgb;
+    if (decode(art.mData, art.mSize, maxDimension, &rgb, &width, &height) != OK) {
+        return NULL;
+    }
+
+    uint8_t *data;
+    size_t size;
+    status_t err = Encode(rgb, width, height, kThumbnailQuality, &data, &size);
+    free(rgb);
+
+    if (err != OK) {
+        return NULL;
+    }
+
+    MediaAlbumArt *thumbnail = new MediaAlbumArt;
+    thumbnail->mSize = size;
+    thumbnail->mData = new uint8_t[size];
+    memcpy(thumbnail->mData, data, size);
+    free(data);
+
+    ALOGV("album art thumbnail %dx%d, %d bytes instead of %d",
+         width, height, size, art.mSize);
+
+    return thumbnail;
+}
+
+// static
+status_t JPEGDecoder::Encode(
+        const uint8_t *rgb, int32_t width, int32_t height, int quality,
+        uint8_t **data, size_t *size) {
+    struct jpeg_compress_struct cinfo;
+    MemoryDestination dest;
+    ErrorManager err;
+
+    dest.mCapacity = 16384;
+    dest.mData = (uint8_t *)malloc(dest.mCapacity);
+    if (dest.mData == NULL) {
+        return NO_MEMORY;
+    }
+
+    SetErrorManager((j_common_ptr)&cinfo, &err);
+    if (setjmp(err.mJumpBuffer)) {
+        jpeg_destroy_compress(&cinfo);
+        free(dest.mData);
+        return UNKNOWN_ERROR;
+    }
+
+    jpeg_create_compress(&cinfo);
+
+    dest.mPub.init_destination = InitDestination;
+    dest.mPub.empty_output_buffer = EmptyOutputBuffer;
+    dest.mPub.term_destination = TermDestination;
+    cinfo.dest = &dest.mPub;
+
+    cinfo.image_width = width;
+    cinfo.image_height = height;
+    cinfo.input_components = 3;
+    cinfo.in_color_space = JCS_RGB;
+
+    jpeg_set_defaults(&cinfo);
+    jpeg_set_quality(&cinfo, quality, TRUE);
+
+    jpeg_start_compress(&cinfo, TRUE);
+
+    while (cinfo.next_scanline < cinfo.image_height) {
+        JSAMPROW rowPointer =
+            const_cast<uint8_t *>(rgb) + cinfo.next_scanline * width * 3;
+        jpeg_write_scanlines(&cinfo, &rowPointer, 1);
+    }
+
+    jpeg_finish_compress(&cinfo);
+
+    *data = dest.mData;
+    *size = dest.mCapacity - dest.mPub.free_in_buffer;
+
+    jpeg_destroy_compress(&cinfo);
+
+    return OK;
+}
+
+}  // namespace android
@@ -21,10 +21,12 @@
 #include "include/MP3Extractor.h"
 
 #include "include/avc_utils.h"
+#include "include/FrameScanSeeker.h"
 #include "include/ID3.h"
 #include "include/VBRISeeker.h"
 #include "include/XINGSeeker.h"
 
+#include <media/stagefright/foundation/ABuffer.h>
 #include <media/stagefright/foundation/ADebug.h>
 #include <media/stagefright/foundation/AMessage.h>
 #include <media/stagefright/DataSource.h>
@@ -214,7 +216,8 @@ public:
     MP3Source(
             const sp<MetaData> &meta, const sp<DataSource> &source,
             off64_t first_frame_pos, uint32_t fixed_header,
-            const sp<MP3Seeker> &seeker);
+            const sp<MP3Seeker> &seeker,
+            const sp<FrameScanSeeker> &frameScanSeeker);
 
     virtual status_t start(MetaData *params = NULL);
     virtual status_t stop();
@@ -236,6 +239,7 @@ private:
     int64_t mCurrentTimeUs;
     bool mStarted;
     sp<MP3Seeker> mSeeker;
+    sp<FrameScanSeeker> mFrameScanSeeker;
     MediaBufferGroup *mGroup;
 
     int64_t mBasisTimeUs;
@@ -390,9 +394,21 @@ sp<MediaSource> MP3Extractor::getTrack(size_t index) {
         return NULL;
     }
 
+    // Build an exact seek table in the background, unless reading the
+    // whole stream means downloading it.
+    if (mFrameScanSeeker == NULL
+            && !(mDataSource->flags()
+                    & (DataSource::kIsCachingDataSource
+                        | DataSource::kIsHTTPBasedSource))) {
+        mFrameScanSeeker =
+            new FrameScanSeeker(mDataSource, mFirstFramePos, mFixedHeader);
+
+        mFrameScanSeeker->start();
+    }
+
     return new MP3Source(
             mMeta, mDataSource, mFirstFramePos, mFixedHeader,
-            mSeeker);
+            mSeeker, mFrameScanSeeker);
 }
 
 sp<MetaData> MP3Extractor::getTrackMetaData(size_t index, uint32_t flags) {
@@ -408,7 +424,8 @@ sp<MetaData> MP3Extractor::getTrackMetaData(size_t index, uint32_t flags) {
 MP3Source::MP3Source(
         const sp<MetaData> &meta, const sp<DataSource> &source,
         off64_t first_frame_pos, uint32_t fixed_header,
-        const sp<MP3Seeker> &seeker)
+        const sp<MP3Seeker> &seeker,
+        const sp<FrameScanSeeker> &frameScanSeeker)
     : mMeta(meta),
       mDataSource(source),
       mFirstFramePos(first_frame_pos),
@@ -417,6 +434,7 @@ MP3Source::MP3Source(
       mCurrentTimeUs(0),
       mStarted(false),
       mSeeker(seeker),
+      mFrameScanSeeker(frameScanSeeker),
       mGroup(NULL),
       mBasisTimeUs(0),
       mSamplesRead(0) {
@@ -472,7 +490,11 @@ status_t MP3Source::read(
 
     if (options != NULL && options->getSeekTo(&seekTimeUs, &mode)) {
         int64_t actualSeekTimeUs = seekTimeUs;
-        if (mSeeker == NULL
+        if (mFrameScanSeeker != NULL
+                && mFrameScanSeeker->getOffsetForTime(
+                    &actualSeekTimeUs, &mCurrentPos)) {
+            mCurrentTimeUs = actualSeekTimeUs;
+        } else if (mSeeker == NULL
                 || !mSeeker->getOffsetForTime(&actualSeekTimeUs, &mCurrentPos)) {
             int32_t bitrate;
             if (!mMeta->findInt32(kKeyBitRate, &bitrate)) {
@@ -493,26 +515,18 @@ status_t MP3Source::read(
         mSamplesRead = 0;
     }
 
-    MediaBuffer *buffer;
-    status_t err = mGroup->acquire_buffer(&buffer);
-    if (err != OK) {
-        return err;
-    }
-
     size_t frame_size;
     int bitrate;
     int num_samples;
     int sample_rate;
     for (;;) {
-        ssize_t n = mDataSource->readAt(mCurrentPos, buffer->data(), 4);
+        uint8_t headerData[4];
+        ssize_t n = mDataSource->readAt(mCurrentPos, headerData, 4);
         if (n < 4) {
-            buffer->release();
-            buffer = NULL;
-
             return ERROR_END_OF_STREAM;
         }
 
-        uint32_t header = U32_AT((const uint8_t *)buffer->data());
+        uint32_t header = U32_AT(headerData);
 
         if ((header & kMask) == (mFixedHeader & kMask)
             && GetMPEGAudioFrameSize(
@@ -535,9 +549,6 @@ status_t MP3Source::read(
         if (!Resync(mDataSource, mFixedHeader, &pos, NULL, NULL)) {
             ALOGE("Unable to resync. Signalling end of stream.");
 
-            buffer->release();
-            buffer = NULL;
-
             return ERROR_END_OF_STREAM;
         }
 
@@ -546,14 +557,28 @@ status_t MP3Source::read(
         // Try again with the new position.
     }
 
-    CHECK(frame_size <= buffer->size());
+    MediaBuffer *buffer;
+
+    // If the frame is in memory already, it is returned as is rather than
+    // copied into one of our buffers.
+    sp<ABuffer> mapped = mDataSource->getMappedRange(mCurrentPos, frame_size);
+    if (mapped != NULL) {
+        buffer = MediaBuffer::CreateView(mapped);
+    } else {
+        status_t err = mGroup->acquire_buffer(&buffer);
+        if (err != OK) {
+            return err;
+        }
 
-    ssize_t n = mDataSource->readAt(mCurrentPos, buffer->data(), frame_size);
-    if (n < (ssize_t)frame_size) {
-        buffer->release();
-        buffer = NULL;
+        CHECK(frame_size <= buffer->size());
+
+        ssize_t n = mDataSource->readAt(mCurrentPos, buffer->data(), frame_size);
+        if (n < (ssize_t)frame_size) {
+            buffer->release();
+            buffer = NULL;
 
-        return ERROR_END_OF_STREAM;
+            return ERROR_END_OF_STREAM;
+        }
     }
 
     buffer->set_range(0, frame_size);
@@ -625,13 +650,20 @@ sp<MetaData> MP3Extractor::getMetaData() {
         meta->setCString(kMap[i].key, s);
     }
 
+    off64_t dataOffset;
     size_t dataSize;
     String8 mime;
-    const void *data = id3.getAlbumArt(&dataSize, &mime);
-
-    if (data) {
-        meta->setData(kKeyAlbumArt, MetaData::TYPE_NONE, data, dataSize);
+    if (id3.getAlbumArtLocation(&dataOffset, &dataSize, &mime)) {
+        meta->setInt64(kKeyAlbumArtOffset, dataOffset);
+        meta->setInt32(kKeyAlbumArtSize, dataSize);
         meta->setCString(kKeyAlbumArtMIME, mime.string());
+    } else {
+        const void *data = id3.getAlbumArt(&dataSize, &mime);
+
+        if (data) {
+            meta->setData(kKeyAlbumArt, MetaData::TYPE_NONE, data, dataSize);
+            meta->setCString(kKeyAlbumArtMIME, mime.string());
+        }
     }
 
     return meta;
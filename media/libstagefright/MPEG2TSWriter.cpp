@@ -33,6 +33,14 @@
 
 namespace android {
 
+// The PCR PID carries a PCR at least this often, the spec requires one
+// every 100ms.
+static const int64_t kPCRIntervalUs = 40000ll;
+
+// The PCR runs this far behind the PTS of the access units written at the
+// same time, which is the decoder's buffering headroom.
+static const int64_t kPCRDelayUs = 300000ll;
+
 struct MPEG2TSWriter::SourceInfo : public AHandler {
     SourceInfo(const sp<MediaSource> &source);
 
@@ -40,6 +48,7 @@ struct MPEG2TSWriter::SourceInfo : public AHandler {
     void stop();
 
     unsigned streamType() const;
+    unsigned continuityCounter() const;
     unsigned incrementContinuityCounter();
 
     void readMore();
@@ -120,6 +129,10 @@ unsigned MPEG2TSWriter::SourceInfo::streamType() const {
     return mStreamType;
 }
 
+unsigned MPEG2TSWriter::SourceInfo::continuityCounter() const {
+    return mContinuityCounter;
+}
+
 unsigned MPEG2TSWriter::SourceInfo::incrementContinuityCounter() {
     if (++mContinuityCounter == 16) {
         mContinuityCounter = 0;
@@ -502,6 +515,16 @@ MPEG2TSWriter::MPEG2TSWriter(
 void MPEG2TSWriter::init() {
     CHECK(mFile != NULL || mWriteFunc != NULL);
 
+    mPacketArena = (uint8_t *)malloc(kNumTSPacketsPerWrite * kTSPacketSize);
+    CHECK(mPacketArena != NULL);
+    mNumPacketsInArena = 0;
+
+    mPCRStarted = false;
+    mPCRGeneration = 0;
+    mPCRBaseTimeUs = 0;
+    mPCRBaseRealTimeUs = 0;
+    mNextPCRRealTimeUs = 0;
+
     mLooper = new ALooper;
     mLooper->setName("MPEG2TSWriter");
 
@@ -523,6 +546,9 @@ MPEG2TSWriter::~MPEG2TSWriter() {
         fclose(mFile);
         mFile = NULL;
     }
+
+    free(mPacketArena);
+    mPacketArena = NULL;
 }
 
 status_t MPEG2TSWriter::addSource(const sp<MediaSource> &source) {
@@ -551,6 +577,8 @@ status_t MPEG2TSWriter::start(MetaData *param) {
     mNumSourcesDone = 0;
     mNumTSPacketsWritten = 0;
     mNumTSPacketsBeforeMeta = 0;
+    mNumPacketsInArena = 0;
+    mPCRStarted = false;
 
     for (size_t i = 0; i < mSources.size(); ++i) {
         sp<AMessage> notify =
@@ -570,6 +598,13 @@ status_t MPEG2TSWriter::reset() {
     for (size_t i = 0; i < mSources.size(); ++i) {
         mSources.editItemAt(i)->stop();
     }
+
+    // Write out whatever is still collected in the arena and stop the
+    // PCR schedule, both happen on the looper.
+    sp<AMessage> response;
+    (new AMessage(kWhatFlush, mReflector->id()))->postAndAwaitResponse(
+            &response);
+
     mStarted = false;
 
     return OK;
@@ -612,7 +647,12 @@ void MPEG2TSWriter::onMessageReceived(const sp<AMessage> &msg) {
                     writeAccessUnit(sourceIndex, buffer);
                 }
 
-                ++mNumSourcesDone;
+                if (++mNumSourcesDone == mSources.size()) {
+                    ++mPCRGeneration;
+                    mPCRStarted = false;
+
+                    flushTSPackets();
+                }
             } else if (what == SourceInfo::kNotifyBuffer) {
                 sp<ABuffer> buffer;
                 CHECK(msg->findBuffer("buffer", &buffer));
@@ -679,6 +719,11 @@ void MPEG2TSWriter::onMessageReceived(const sp<AMessage> &msg) {
                 source->setLastAccessUnit(NULL);
 
                 writeTS();
+
+                if (!mPCRStarted) {
+                    startPCR(minTimeUs);
+                }
+
                 writeAccessUnit(minIndex, buffer);
 
                 source->readMore();
@@ -686,11 +731,134 @@ void MPEG2TSWriter::onMessageReceived(const sp<AMessage> &msg) {
             break;
         }
 
+        case kWhatWritePCR:
+        {
+            int32_t generation;
+            CHECK(msg->findInt32("generation", &generation));
+
+            if (generation != mPCRGeneration) {
+                break;
+            }
+
+            writePCR();
+
+            // Keep to the schedule rather than to the time this message
+            // happened to be delivered.
+            mNextPCRRealTimeUs += kPCRIntervalUs;
+            int64_t delayUs = mNextPCRRealTimeUs - ALooper::GetNowUs();
+            msg->post(delayUs > 0 ? delayUs : 0);
+            break;
+        }
+
+        case kWhatFlush:
+        {
+            uint32_t replyID;
+            CHECK(msg->senderAwaitsResponse(&replyID));
+
+            ++mPCRGeneration;
+            mPCRStarted = false;
+
+            flushTSPackets();
+
+            (new AMessage)->postReply(replyID);
+            break;
+        }
+
         default:
             TRESPASS();
     }
 }
 
+uint8_t *MPEG2TSWriter::nextTSPacket() {
+    if (mNumPacketsInArena == kNumTSPacketsPerWrite) {
+        flushTSPackets();
+    }
+
+    uint8_t *packet = mPacketArena + mNumPacketsInArena * kTSPacketSize;
+    ++mNumPacketsInArena;
+    ++mNumTSPacketsWritten;
+
+    return packet;
+}
+
+void MPEG2TSWriter::flushTSPackets() {
+    if (mNumPacketsInArena == 0) {
+        return;
+    }
+
+    const size_t size = mNumPacketsInArena * kTSPacketSize;
+    CHECK_EQ(internalWrite(mPacketArena, size), size);
+
+    mNumPacketsInArena = 0;
+}
+
+void MPEG2TSWriter::startPCR(int64_t timeUs) {
+    mPCRStarted = true;
+    mPCRBaseTimeUs = timeUs - kPCRDelayUs;
+    mPCRBaseRealTimeUs = ALooper::GetNowUs();
+    mNextPCRRealTimeUs = mPCRBaseRealTimeUs;
+
+    // Write the first one right away, ahead of the first access unit.
+    writePCR();
+
+    mNextPCRRealTimeUs += kPCRIntervalUs;
+
+    sp<AMessage> msg = new AMessage(kWhatWritePCR, mReflector->id());
+    msg->setInt32("generation", mPCRGeneration);
+    msg->post(kPCRIntervalUs);
+}
+
+void MPEG2TSWriter::writePCR() {
+    // 0x47
+    // transport_error_indicator = b0
+    // payload_unit_start_indicator = b0
+    // transport_priority = b0
+    // PID = b0 0001 1110 0001 (13 bits) [0x1e1, the PCR_PID]
+    // transport_scrambling_control = b00
+    // adaptation_field_control = b10 (adaptation field only, no payload)
+    // continuity_counter = b???? (not incremented without payload)
+    // -- adaptation field follows
+    // adaptation_field_length = 0xb7 (183)
+    // discontinuity_indicator = b0
+    // random_access_indicator = b0
+    // elementary_stream_priority_indicator = b0
+    // PCR_flag = b1
+    // OPCR_flag = b0
+    // splicing_point_flag = b0
+    // transport_private_data_flag = b0
+    // adaptation_field_extension_flag = b0
+    // program_clock_reference_base = b????????? (33 bits)
+    // reserved = b111111
+    // program_clock_reference_extension = b000000000 (9 bits)
+    // stuffing bytes 0xff follow
+
+    static const unsigned kPCR_PID = 0x1e1;
+
+    const int64_t nowUs = ALooper::GetNowUs();
+    const int64_t pcrUs = mPCRBaseTimeUs + (nowUs - mPCRBaseRealTimeUs);
+
+    // The PCR base is a 33 bit counter, it wraps like the PTS does.
+    const uint64_t PCR = (uint64_t)((pcrUs * 9ll) / 100ll) & 0x1ffffffffull;
+
+    uint8_t *packet = nextTSPacket();
+
+    uint8_t *ptr = packet;
+    *ptr++ = 0x47;
+    *ptr++ = 0x00 | (kPCR_PID >> 8);
+    *ptr++ = kPCR_PID & 0xff;
+    *ptr++ = 0x20 | mSources.editItemAt(0)->continuityCounter();
+    *ptr++ = 0xb7;
+    *ptr++ = 0x10;
+    *ptr++ = (PCR >> 25) & 0xff;
+    *ptr++ = (PCR >> 17) & 0xff;
+    *ptr++ = (PCR >> 9) & 0xff;
+    *ptr++ = (PCR >> 1) & 0xff;
+    *ptr++ = ((PCR & 1) << 7) | 0x7e;
+    *ptr++ = 0x00;
+
+    memset(ptr, 0xff, packet + kTSPacketSize - ptr);
+}
+
 void MPEG2TSWriter::writeProgramAssociationTable() {
     // 0x47
     // transport_error_indicator = b0
@@ -728,14 +896,12 @@ void MPEG2TSWriter::writeProgramAssociationTable() {
         0x00, 0x00, 0x00, 0x00   // b???? ???? ???? ???? ???? ???? ???? ????
     };
 
-    sp<ABuffer> buffer = new ABuffer(188);
-    memset(buffer->data(), 0, buffer->size());
-    memcpy(buffer->data(), kData, sizeof(kData));
+    uint8_t *packet = nextTSPacket();
+    memset(packet, 0, kTSPacketSize);
+    memcpy(packet, kData, sizeof(kData));
 
     static const unsigned kContinuityCounter = 5;
-    buffer->data()[3] |= kContinuityCounter;
-
-    CHECK_EQ(internalWrite(buffer->data(), buffer->size()), buffer->size());
+    packet[3] |= kContinuityCounter;
 }
 
 void MPEG2TSWriter::writeProgramMap() {
@@ -780,22 +946,22 @@ void MPEG2TSWriter::writeProgramMap() {
         0xe0, 0x00, 0xf0, 0x00   // b111? ???? ???? ???? 1111 0000 0000 0000
     };
 
-    sp<ABuffer> buffer = new ABuffer(188);
-    memset(buffer->data(), 0, buffer->size());
-    memcpy(buffer->data(), kData, sizeof(kData));
+    uint8_t *packet = nextTSPacket();
+    memset(packet, 0, kTSPacketSize);
+    memcpy(packet, kData, sizeof(kData));
 
     static const unsigned kContinuityCounter = 5;
-    buffer->data()[3] |= kContinuityCounter;
+    packet[3] |= kContinuityCounter;
 
     size_t section_length = 5 * mSources.size() + 4 + 9;
-    buffer->data()[6] |= section_length >> 8;
-    buffer->data()[7] = section_length & 0xff;
+    packet[6] |= section_length >> 8;
+    packet[7] = section_length & 0xff;
 
     static const unsigned kPCR_PID = 0x1e1;
-    buffer->data()[13] |= (kPCR_PID >> 8) & 0x1f;
-    buffer->data()[14] = kPCR_PID & 0xff;
+    packet[13] |= (kPCR_PID >> 8) & 0x1f;
+    packet[14] = kPCR_PID & 0xff;
 
-    uint8_t *ptr = &buffer->data()[sizeof(kData)];
+    uint8_t *ptr = &packet[sizeof(kData)];
     for (size_t i = 0; i < mSources.size(); ++i) {
         *ptr++ = mSources.editItemAt(i)->streamType();
 
@@ -810,8 +976,6 @@ void MPEG2TSWriter::writeProgramMap() {
     *ptr++ = 0x00;
     *ptr++ = 0x00;
     *ptr++ = 0x00;
-
-    CHECK_EQ(internalWrite(buffer->data(), buffer->size()), buffer->size());
 }
 
 void MPEG2TSWriter::writeAccessUnit(
@@ -851,9 +1015,6 @@ void MPEG2TSWriter::writeAccessUnit(
     // reserved = b1
     // the first fragment of "buffer" follows
 
-    sp<ABuffer> buffer = new ABuffer(188);
-    memset(buffer->data(), 0, buffer->size());
-
     const unsigned PID = 0x1e0 + sourceIndex + 1;
 
     const unsigned continuity_counter =
@@ -879,7 +1040,9 @@ void MPEG2TSWriter::writeAccessUnit(
         PES_packet_length = 0;
     }
 
-    uint8_t *ptr = buffer->data();
+    uint8_t *packet = nextTSPacket();
+
+    uint8_t *ptr = packet;
     *ptr++ = 0x47;
     *ptr++ = 0x40 | (PID >> 8);
     *ptr++ = PID & 0xff;
@@ -899,15 +1062,14 @@ void MPEG2TSWriter::writeAccessUnit(
     *ptr++ = (PTS >> 7) & 0xff;
     *ptr++ = ((PTS & 0x7f) << 1) | 1;
 
-    size_t sizeLeft = buffer->data() + buffer->size() - ptr;
+    size_t sizeLeft = packet + kTSPacketSize - ptr;
     size_t copy = accessUnit->size();
     if (copy > sizeLeft) {
         copy = sizeLeft;
     }
 
     memcpy(ptr, accessUnit->data(), copy);
-
-    CHECK_EQ(internalWrite(buffer->data(), buffer->size()), buffer->size());
+    memset(ptr + copy, 0, sizeLeft - copy);
 
     size_t offset = copy;
     while (offset < accessUnit->size()) {
@@ -922,26 +1084,25 @@ void MPEG2TSWriter::writeAccessUnit(
         // continuity_counter = b????
         // the fragment of "buffer" follows.
 
-        memset(buffer->data(), 0, buffer->size());
-
         const unsigned continuity_counter =
             mSources.editItemAt(sourceIndex)->incrementContinuityCounter();
 
-        ptr = buffer->data();
+        packet = nextTSPacket();
+
+        ptr = packet;
         *ptr++ = 0x47;
         *ptr++ = 0x00 | (PID >> 8);
         *ptr++ = PID & 0xff;
         *ptr++ = 0x10 | continuity_counter;
 
-        size_t sizeLeft = buffer->data() + buffer->size() - ptr;
+        size_t sizeLeft = packet + kTSPacketSize - ptr;
         size_t copy = accessUnit->size() - offset;
         if (copy > sizeLeft) {
             copy = sizeLeft;
         }
 
         memcpy(ptr, accessUnit->data() + offset, copy);
-        CHECK_EQ(internalWrite(buffer->data(), buffer->size()),
-                 buffer->size());
+        memset(ptr + copy, 0, sizeLeft - copy);
 
         offset += copy;
     }
@@ -20,7 +20,9 @@ Copyright (c) 2012, Code Aurora Forum. All rights reserved.
 --------------------------------------------------------------------------*/
 
 #define LOG_TAG "MPEG4Extractor"
+#define ATRACE_TAG ATRACE_TAG_VIDEO
 #include <utils/Log.h>
+#include <utils/Trace.h>
 
 #include "include/MPEG4Extractor.h"
 #include "include/SampleTable.h"
@@ -34,6 +36,7 @@ Copyright (c) 2012, Code Aurora Forum. All rights reserved.
 #include <string.h>
 
 #include <media/stagefright/foundation/ABitReader.h>
+#include <media/stagefright/foundation/ABuffer.h>
 #include <media/stagefright/foundation/ADebug.h>
 #include <media/stagefright/foundation/AMessage.h>
 #include <media/stagefright/DataSource.h>
@@ -43,18 +46,92 @@ Copyright (c) 2012, Code Aurora Forum. All rights reserved.
 #include <media/stagefright/MediaSource.h>
 #include <media/stagefright/MetaData.h>
 #include <media/stagefright/Utils.h>
+#include <utils/KeyedVector.h>
 #include <utils/String8.h>
 #include <cutils/properties.h>
 
 namespace android {
 
+// The movie fragments of a fragmented file are only parsed by the tracks
+// as they reach them. This holds what the tracks share to find them: the
+// defaults of the 'trex' boxes, the offset of the first 'moof' box, the
+// segment index ('sidx') preceding it if any, and the track fragment
+// random access boxes ('tfra') of the 'mfra' box at the end of the file.
+// The latter is only read on the first seek, so as not to delay playback.
+struct MPEG4FragmentIndex : public RefBase {
+    struct TrackDefaults {
+        TrackDefaults()
+            : mSampleDuration(0),
+              mSampleSize(0),
+              mSampleFlags(0) {
+        }
+
+        uint32_t mSampleDuration;
+        uint32_t mSampleSize;
+        uint32_t mSampleFlags;
+    };
+
+    MPEG4FragmentIndex(const sp<DataSource> &source);
+
+    void setTrackDefaults(uint32_t trackID, const TrackDefaults &defaults);
+    TrackDefaults getTrackDefaults(uint32_t trackID) const;
+
+    void setFirstFragmentOffset(off64_t offset);
+    off64_t getFirstFragmentOffset() const;
+
+    status_t parseSegmentIndex(off64_t data_offset, off64_t data_size);
+    int64_t getSegmentsDurationUs() const;
+
+    // Finds the last indexed fragment starting at or before timeUs with
+    // samples of trackID, returns false if there is none.
+    bool findFragment(
+            uint32_t trackID, int32_t timescale, int64_t timeUs,
+            off64_t *moofOffset, int64_t *fragmentTimeUs);
+
+protected:
+    virtual ~MPEG4FragmentIndex();
+
+private:
+    struct Segment {
+        off64_t mOffset;
+        int64_t mTimeUs;
+    };
+
+    // Times are in the timescale of the track.
+    struct RandomAccessEntry {
+        off64_t mMoofOffset;
+        uint64_t mTime;
+    };
+
+    mutable Mutex mLock;
+
+    sp<DataSource> mDataSource;
+    KeyedVector<uint32_t, TrackDefaults> mTrackDefaults;
+    off64_t mFirstFragmentOffset;
+
+    uint32_t mSegmentsReferenceID;
+    Vector<Segment> mSegments;
+    int64_t mSegmentsDurationUs;
+
+    bool mRandomAccessRead;
+    KeyedVector<uint32_t, Vector<RandomAccessEntry> > mRandomAccess;
+
+    void readRandomAccess_l();
+    status_t parseTrackFragmentRandomAccess_l(
+            off64_t data_offset, off64_t data_size);
+
+    MPEG4FragmentIndex(const MPEG4FragmentIndex &);
+    MPEG4FragmentIndex &operator=(const MPEG4FragmentIndex &);
+};
+
 class MPEG4Source : public MediaSource {
 public:
     // Caller retains ownership of both "dataSource" and "sampleTable".
     MPEG4Source(const sp<MetaData> &format,
                 const sp<DataSource> &dataSource,
                 int32_t timeScale,
-                const sp<SampleTable> &sampleTable);
+                const sp<SampleTable> &sampleTable,
+                const sp<MPEG4FragmentIndex> &fragmentIndex);
 
     virtual status_t start(MetaData *params = NULL);
     virtual status_t stop();
@@ -79,6 +156,9 @@ private:
     bool mIsAVC;
     size_t mNALLengthSize;
 
+    // Counter the composition time of every sample read is traced to.
+    const char *mSampleTimeTraceName;
+
     bool mStarted;
 
     MediaBufferGroup *mGroup;
@@ -89,6 +169,53 @@ private:
 
     uint8_t *mSrcBuffer;
 
+    // Fragmented files, the samples are those of their movie fragments
+    // rather than those of the sample table, and mCurrentSampleIndex is
+    // the index of the current sample in mCurrentSamples.
+    struct FragmentSample {
+        off64_t mOffset;
+        size_t mSize;
+        uint64_t mDecodingTime;
+        int32_t mCompositionOffset;
+        bool mIsSyncSample;
+    };
+
+    struct TrackFragmentHeader {
+        off64_t mBaseDataOffset;
+        uint32_t mSampleDuration;
+        uint32_t mSampleSize;
+        uint32_t mSampleFlags;
+    };
+
+    sp<MPEG4FragmentIndex> mFragmentIndex;
+    bool mIsFragmented;
+    uint32_t mTrackID;
+    MPEG4FragmentIndex::TrackDefaults mTrackDefaults;
+
+    // The fragments parsed so far, by 'moof' offset, with the decoding
+    // time of their first sample.
+    KeyedVector<off64_t, uint64_t> mFragments;
+
+    off64_t mCurrentMoofOffset;
+    off64_t mNextMoofOffset;
+    uint64_t mNextFragmentTime;
+    Vector<FragmentSample> mCurrentSamples;
+
+    status_t loadFragment_l(off64_t offset, uint64_t defaultTime);
+    status_t parseTrackFragment_l(
+            off64_t moofOffset, off64_t offset, off64_t end,
+            uint64_t *time);
+    status_t parseTrackFragmentRun_l(
+            off64_t data_offset, off64_t data_size,
+            const TrackFragmentHeader &header,
+            off64_t *sampleDataOffset, uint64_t *time);
+
+    status_t getFragmentedSample_l(
+            off64_t *offset, size_t *size, uint64_t *compositionTime,
+            bool *isSyncSample);
+    status_t seekFragmented_l(
+            uint64_t time, uint32_t findFlags, uint64_t *sampleTime);
+
 #ifdef QCOM_HARDWARE
     //For statistics profiling
     uint32_t mNumSamplesReadError;
@@ -117,6 +244,7 @@ struct MPEG4DataSource : public DataSource {
     virtual ssize_t readAt(off64_t offset, void *data, size_t size);
     virtual status_t getSize(off64_t *size);
     virtual uint32_t flags();
+    virtual sp<ABuffer> getMappedRange(off64_t offset, size_t size);
 
     status_t setCachedRange(off64_t offset, size_t size);
 
@@ -182,6 +310,10 @@ uint32_t MPEG4DataSource::flags() {
     return mSource->flags();
 }
 
+sp<ABuffer> MPEG4DataSource::getMappedRange(off64_t offset, size_t size) {
+    return mSource->getMappedRange(offset, size);
+}
+
 status_t MPEG4DataSource::setCachedRange(off64_t offset, size_t size) {
     Mutex::Autolock autoLock(mLock);
 
@@ -209,6 +341,336 @@ status_t MPEG4DataSource::setCachedRange(off64_t offset, size_t size) {
 
 ////////////////////////////////////////////////////////////////////////////////
 
+// Reads the header of the box at offset, end is that of the enclosing box
+// or of the file, negative if unknown. A size of 0 extends the box to end.
+static status_t readBoxHeader(
+        const sp<DataSource> &source, off64_t offset, off64_t end,
+        uint32_t *type, off64_t *size, off64_t *data_offset) {
+    uint32_t hdr[2];
+    if (source->readAt(offset, hdr, 8) < 8) {
+        return ERROR_END_OF_STREAM;
+    }
+
+    uint64_t box_size = ntohl(hdr[0]);
+    *type = ntohl(hdr[1]);
+    *data_offset = offset + 8;
+
+    if (box_size == 1) {
+        if (source->readAt(offset + 8, &box_size, 8) < 8) {
+            return ERROR_IO;
+        }
+        box_size = ntoh64(box_size);
+        *data_offset += 8;
+
+        if (box_size < 16) {
+            return ERROR_MALFORMED;
+        }
+    } else if (box_size == 0) {
+        if (end < 0) {
+            // The last box of a stream of unknown length.
+            return ERROR_END_OF_STREAM;
+        }
+        box_size = end - offset;
+    } else if (box_size < 8) {
+        return ERROR_MALFORMED;
+    }
+
+    if (end >= 0 && offset + (off64_t)box_size > end) {
+        return ERROR_MALFORMED;
+    }
+
+    *size = box_size;
+
+    return OK;
+}
+
+// The tables of the index boxes are read in one go, up to this size.
+static const off64_t kMaxFragmentIndexSize = 4 * 1024 * 1024;
+
+MPEG4FragmentIndex::MPEG4FragmentIndex(const sp<DataSource> &source)
+    : mDataSource(source),
+      mFirstFragmentOffset(-1),
+      mSegmentsReferenceID(0),
+      mSegmentsDurationUs(0),
+      mRandomAccessRead(false) {
+}
+
+MPEG4FragmentIndex::~MPEG4FragmentIndex() {
+}
+
+void MPEG4FragmentIndex::setTrackDefaults(
+        uint32_t trackID, const TrackDefaults &defaults) {
+    Mutex::Autolock autoLock(mLock);
+
+    mTrackDefaults.add(trackID, defaults);
+}
+
+MPEG4FragmentIndex::TrackDefaults MPEG4FragmentIndex::getTrackDefaults(
+        uint32_t trackID) const {
+    Mutex::Autolock autoLock(mLock);
+
+    ssize_t index = mTrackDefaults.indexOfKey(trackID);
+    if (index < 0) {
+        return TrackDefaults();
+    }
+
+    return mTrackDefaults.valueAt(index);
+}
+
+void MPEG4FragmentIndex::setFirstFragmentOffset(off64_t offset) {
+    Mutex::Autolock autoLock(mLock);
+
+    mFirstFragmentOffset = offset;
+}
+
+off64_t MPEG4FragmentIndex::getFirstFragmentOffset() const {
+    Mutex::Autolock autoLock(mLock);
+
+    return mFirstFragmentOffset;
+}
+
+int64_t MPEG4FragmentIndex::getSegmentsDurationUs() const {
+    Mutex::Autolock autoLock(mLock);
+
+    return mSegmentsDurationUs;
+}
+
+status_t MPEG4FragmentIndex::parseSegmentIndex(
+        off64_t data_offset, off64_t data_size) {
+    Mutex::Autolock autoLock(mLock);
+
+    if (data_size < 24 || data_size > kMaxFragmentIndexSize) {
+        return ERROR_MALFORMED;
+    }
+
+    uint8_t *buffer = new uint8_t[data_size];
+    if (mDataSource->readAt(data_offset, buffer, data_size) < data_size) {
+        delete[] buffer;
+        return ERROR_IO;
+    }
+
+    uint8_t version = buffer[0];
+    uint32_t referenceID = U32_AT(&buffer[4]);
+    uint32_t timescale = U32_AT(&buffer[8]);
+
+    uint64_t time, firstOffset;
+    size_t ptr;
+    if (version == 0) {
+        time = U32_AT(&buffer[12]);
+        firstOffset = U32_AT(&buffer[16]);
+        ptr = 20;
+    } else {
+        if (data_size < 32) {
+            delete[] buffer;
+            return ERROR_MALFORMED;
+        }
+        time = U64_AT(&buffer[12]);
+        firstOffset = U64_AT(&buffer[20]);
+        ptr = 28;
+    }
+
+    uint16_t referenceCount = U16_AT(&buffer[ptr + 2]);
+    ptr += 4;
+
+    if (timescale == 0 || ptr + 12 * referenceCount > (size_t)data_size) {
+        delete[] buffer;
+        return ERROR_MALFORMED;
+    }
+
+    if (!mSegments.isEmpty() && referenceID != mSegmentsReferenceID) {
+        // One index per track, those of the other tracks are redundant
+        // since the fragments hold all the tracks.
+        ALOGV("ignoring segment index of track %u", referenceID);
+        delete[] buffer;
+        return OK;
+    }
+    mSegmentsReferenceID = referenceID;
+
+    // Offsets are relative to the first byte following the index.
+    off64_t offset = data_offset + data_size + firstOffset;
+    for (uint16_t i = 0; i < referenceCount; ++i, ptr += 12) {
+        uint32_t reference = U32_AT(&buffer[ptr]);
+        uint32_t duration = U32_AT(&buffer[ptr + 4]);
+
+        if (reference & 0x80000000) {
+            // A reference to another segment index, which is not
+            // followed, that range is simply not indexed.
+            ALOGW("hierarchical segment index not supported");
+        } else {
+            Segment segment;
+            segment.mOffset = offset;
+            segment.mTimeUs = (time * 1000000ll) / timescale;
+            mSegments.push(segment);
+        }
+
+        offset += reference & 0x7fffffff;
+        time += duration;
+    }
+
+    mSegmentsDurationUs = (time * 1000000ll) / timescale;
+
+    delete[] buffer;
+
+    ALOGV("%d segments indexed, %lld us",
+         mSegments.size(), mSegmentsDurationUs);
+
+    return OK;
+}
+
+bool MPEG4FragmentIndex::findFragment(
+        uint32_t trackID, int32_t timescale, int64_t timeUs,
+        off64_t *moofOffset, int64_t *fragmentTimeUs) {
+    Mutex::Autolock autoLock(mLock);
+
+    if (!mSegments.isEmpty()) {
+        ssize_t found = -1;
+        for (size_t i = 0; i < mSegments.size(); ++i) {
+            if (mSegments[i].mTimeUs > timeUs) {
+                break;
+            }
+            found = i;
+        }
+
+        if (found < 0) {
+            return false;
+        }
+
+        *moofOffset = mSegments[found].mOffset;
+        *fragmentTimeUs = mSegments[found].mTimeUs;
+        return true;
+    }
+
+    if (!mRandomAccessRead) {
+        readRandomAccess_l();
+    }
+
+    ssize_t index = mRandomAccess.indexOfKey(trackID);
+    if (index < 0 || timescale <= 0) {
+        return false;
+    }
+
+    const Vector<RandomAccessEntry> &entries = mRandomAccess.valueAt(index);
+
+    ssize_t found = -1;
+    for (size_t i = 0; i < entries.size(); ++i) {
+        if ((int64_t)(entries[i].mTime * 1000000ll / timescale) > timeUs) {
+            break;
+        }
+        found = i;
+    }
+
+    if (found < 0) {
+        return false;
+    }
+
+    *moofOffset = entries[found].mMoofOffset;
+    *fragmentTimeUs = entries[found].mTime * 1000000ll / timescale;
+    return true;
+}
+
+void MPEG4FragmentIndex::readRandomAccess_l() {
+    mRandomAccessRead = true;
+
+    // The 'mfra' box ends with a 'mfro' box holding its size, which is
+    // the last box of the file.
+    off64_t fileSize;
+    if (mDataSource->getSize(&fileSize) != OK || fileSize < 16) {
+        return;
+    }
+
+    uint8_t mfro[16];
+    if (mDataSource->readAt(fileSize - 16, mfro, 16) < 16
+            || U32_AT(&mfro[0]) != 16
+            || U32_AT(&mfro[4]) != FOURCC('m', 'f', 'r', 'o')) {
+        return;
+    }
+
+    off64_t mfraOffset = fileSize - U32_AT(&mfro[12]);
+    if (mfraOffset < 0) {
+        return;
+    }
+
+    uint32_t type;
+    off64_t size, data_offset;
+    if (readBoxHeader(mDataSource, mfraOffset, fileSize,
+                &type, &size, &data_offset) != OK
+            || type != FOURCC('m', 'f', 'r', 'a')) {
+        return;
+    }
+
+    off64_t end = mfraOffset + size;
+    off64_t offset = data_offset;
+    while (offset < end) {
+        if (readBoxHeader(mDataSource, offset, end,
+                    &type, &size, &data_offset) != OK) {
+            break;
+        }
+
+        if (type == FOURCC('t', 'f', 'r', 'a')) {
+            status_t err = parseTrackFragmentRandomAccess_l(
+                    data_offset, offset + size - data_offset);
+            if (err != OK) {
+                ALOGW("ignoring malformed track fragment random access box");
+            }
+        }
+
+        offset += size;
+    }
+}
+
+status_t MPEG4FragmentIndex::parseTrackFragmentRandomAccess_l(
+        off64_t data_offset, off64_t data_size) {
+    if (data_size < 16 || data_size > kMaxFragmentIndexSize) {
+        return ERROR_MALFORMED;
+    }
+
+    uint8_t *buffer = new uint8_t[data_size];
+    if (mDataSource->readAt(data_offset, buffer, data_size) < data_size) {
+        delete[] buffer;
+        return ERROR_IO;
+    }
+
+    uint8_t version = buffer[0];
+    uint32_t trackID = U32_AT(&buffer[4]);
+    uint32_t lengths = U32_AT(&buffer[8]);
+    uint32_t numEntries = U32_AT(&buffer[12]);
+
+    // Followed by the traf, trun and sample numbers, which are not needed
+    // since the fragment is parsed from its start anyway.
+    size_t timeSize = (version == 1) ? 8 : 4;
+    size_t entrySize = 2 * timeSize
+        + ((lengths >> 4) & 3) + ((lengths >> 2) & 3) + (lengths & 3) + 3;
+
+    if (numEntries > (data_size - 16) / entrySize) {
+        delete[] buffer;
+        return ERROR_MALFORMED;
+    }
+
+    Vector<RandomAccessEntry> entries;
+    const uint8_t *ptr = &buffer[16];
+    for (uint32_t i = 0; i < numEntries; ++i, ptr += entrySize) {
+        RandomAccessEntry entry;
+        if (version == 1) {
+            entry.mTime = U64_AT(ptr);
+            entry.mMoofOffset = U64_AT(ptr + 8);
+        } else {
+            entry.mTime = U32_AT(ptr);
+            entry.mMoofOffset = U32_AT(ptr + 4);
+        }
+        entries.push(entry);
+    }
+
+    delete[] buffer;
+
+    mRandomAccess.add(trackID, entries);
+
+    ALOGV("track %u: %d random access points", trackID, numEntries);
+
+    return OK;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
 static void hexdump(const void *_data, size_t size) {
     const uint8_t *data = (const uint8_t *)_data;
     size_t offset = 0;
@@ -284,15 +746,18 @@ static const char *FourCC2MIME(uint32_t fourcc) {
     }
 }
 
-MPEG4Extractor::MPEG4Extractor(const sp<DataSource> &source)
+MPEG4Extractor::MPEG4Extractor(
+        const sp<DataSource> &source, uint32_t flags)
     : mDataSource(source),
       mInitCheck(NO_INIT),
       mHasVideo(false),
+      mMetadataOnly((flags & kMetadataOnly) != 0),
       mFirstTrack(NULL),
       mLastTrack(NULL),
       mFileMetaData(new MetaData),
       mFirstSINF(NULL),
-      mIsDrm(false) {
+      mIsDrm(false),
+      mMovieBoxCached(false) {
 }
 
 MPEG4Extractor::~MPEG4Extractor() {
@@ -362,7 +827,8 @@ sp<MetaData> MPEG4Extractor::getTrackMetaData(
     }
 
     if ((flags & kIncludeExtensiveMetaData)
-            && !track->includes_expensive_metadata) {
+            && !track->includes_expensive_metadata
+            && !mMetadataOnly) {
         track->includes_expensive_metadata = true;
 
         const char *mime;
@@ -395,6 +861,10 @@ status_t MPEG4Extractor::readMetaData() {
     }
 
     if (mInitCheck == OK) {
+        if (mFragmentIndex != NULL && !mIsDrm) {
+            parseFragmentedHeaders(offset);
+        }
+
         if (mHasVideo) {
             mFileMetaData->setCString(
                     kKeyMIMEType, MEDIA_MIMETYPE_CONTAINER_MPEG4);
@@ -622,6 +1092,9 @@ static void convertTimeToDate(int64_t time_1904, String8 *s) {
     s->setTo(tmp);
 }
 
+// Movie boxes larger than this are parsed from the data source directly.
+static const uint64_t kMaxCachedMovieBoxSize = 8 * 1024 * 1024;
+
 status_t MPEG4Extractor::parseChunk(off64_t *offset, int depth) {
     ALOGV("entering parseChunk %lld/%d", *offset, depth);
     uint32_t hdr[2];
@@ -710,12 +1183,27 @@ status_t MPEG4Extractor::parseChunk(off64_t *offset, int depth) {
         case FOURCC('e', 'd', 't', 's'):
 #endif
         {
+            if (chunk_type == FOURCC('m', 'o', 'o', 'v')
+                    && chunk_size <= kMaxCachedMovieBoxSize) {
+                // Parse the whole movie box from memory rather than with
+                // a read per field, which costs a round trip each on
+                // network and FUSE backed sources.
+                sp<MPEG4DataSource> cachedSource =
+                    new MPEG4DataSource(mDataSource);
+
+                if (cachedSource->setCachedRange(*offset, chunk_size) == OK) {
+                    mDataSource = cachedSource;
+                    mMovieBoxCached = true;
+                }
+            }
+
             if (chunk_type == FOURCC('s', 't', 'b', 'l')) {
                 ALOGV("sampleTable chunk is %d bytes long.", (size_t)chunk_size);
 
-                if (mDataSource->flags()
-                        & (DataSource::kWantsPrefetching
-                            | DataSource::kIsCachingDataSource)) {
+                if (!mMovieBoxCached
+                        && (mDataSource->flags()
+                            & (DataSource::kWantsPrefetching
+                                | DataSource::kIsCachingDataSource))) {
                     sp<MPEG4DataSource> cachedSource =
                         new MPEG4DataSource(mDataSource);
 
@@ -725,6 +1213,9 @@ status_t MPEG4Extractor::parseChunk(off64_t *offset, int depth) {
                 }
 
                 mLastTrack->sampleTable = new SampleTable(mDataSource);
+            } else if (chunk_type == FOURCC('m', 'v', 'e', 'x')
+                    && mFragmentIndex == NULL) {
+                mFragmentIndex = new MPEG4FragmentIndex(mDataSource);
             }
 
             bool isTrack = false;
@@ -1164,6 +1655,11 @@ status_t MPEG4Extractor::parseChunk(off64_t *offset, int depth) {
         case FOURCC('s', 't', 'c', 'o'):
         case FOURCC('c', 'o', '6', '4'):
         {
+            if (mMetadataOnly) {
+                *offset += chunk_size;
+                break;
+            }
+
             status_t err =
                 mLastTrack->sampleTable->setChunkOffsetParams(
                         chunk_type, data_offset, chunk_data_size);
@@ -1178,6 +1674,11 @@ status_t MPEG4Extractor::parseChunk(off64_t *offset, int depth) {
 
         case FOURCC('s', 't', 's', 'c'):
         {
+            if (mMetadataOnly) {
+                *offset += chunk_size;
+                break;
+            }
+
             status_t err =
                 mLastTrack->sampleTable->setSampleToChunkParams(
                         data_offset, chunk_data_size);
@@ -1201,11 +1702,27 @@ status_t MPEG4Extractor::parseChunk(off64_t *offset, int depth) {
                 return err;
             }
 
-            size_t max_size;
-            err = mLastTrack->sampleTable->getMaxSampleSize(&max_size);
+            // Finding the largest sample means reading all of their sizes.
+            size_t max_size = 0;
+            if (!mMetadataOnly) {
+                err = mLastTrack->sampleTable->getMaxSampleSize(&max_size);
 
-            if (err != OK) {
-                return err;
+                if (err != OK) {
+                    return err;
+                }
+            }
+
+            if (max_size == 0) {
+                // The samples of fragmented files are in their movie
+                // fragments, pick a size large enough for those.
+                int32_t width, height;
+                if (mLastTrack->meta->findInt32(kKeyWidth, &width)
+                        && mLastTrack->meta->findInt32(kKeyHeight, &height)
+                        && width > 0 && height > 0) {
+                    max_size = width * height * 3 / 2;
+                } else {
+                    max_size = 256 * 1024;
+                }
             }
 
             // Assume that a given buffer only contains at most 10 fragments,
@@ -1235,6 +1752,11 @@ status_t MPEG4Extractor::parseChunk(off64_t *offset, int depth) {
 
         case FOURCC('s', 't', 't', 's'):
         {
+            if (mMetadataOnly) {
+                *offset += chunk_size;
+                break;
+            }
+
             status_t err =
                 mLastTrack->sampleTable->setTimeToSampleParams(
                         data_offset, chunk_data_size);
@@ -1249,6 +1771,11 @@ status_t MPEG4Extractor::parseChunk(off64_t *offset, int depth) {
 
         case FOURCC('c', 't', 't', 's'):
         {
+            if (mMetadataOnly) {
+                *offset += chunk_size;
+                break;
+            }
+
             status_t err =
                 mLastTrack->sampleTable->setCompositionTimeToSampleParams(
                         data_offset, chunk_data_size);
@@ -1263,6 +1790,11 @@ status_t MPEG4Extractor::parseChunk(off64_t *offset, int depth) {
 
         case FOURCC('s', 't', 's', 's'):
         {
+            if (mMetadataOnly) {
+                *offset += chunk_size;
+                break;
+            }
+
             status_t err =
                 mLastTrack->sampleTable->setSyncSampleParams(
                         data_offset, chunk_data_size);
@@ -1530,6 +2062,32 @@ status_t MPEG4Extractor::parseChunk(off64_t *offset, int depth) {
             return parseDrmSINF(offset, data_offset);
         }
 
+        case FOURCC('t', 'r', 'e', 'x'):
+        {
+            if (chunk_data_size < 24) {
+                return ERROR_MALFORMED;
+            }
+
+            uint8_t buffer[24];
+            if (mDataSource->readAt(
+                        data_offset, buffer, sizeof(buffer))
+                    < (ssize_t)sizeof(buffer)) {
+                return ERROR_IO;
+            }
+
+            if (mFragmentIndex != NULL) {
+                MPEG4FragmentIndex::TrackDefaults defaults;
+                defaults.mSampleDuration = U32_AT(&buffer[12]);
+                defaults.mSampleSize = U32_AT(&buffer[16]);
+                defaults.mSampleFlags = U32_AT(&buffer[20]);
+
+                mFragmentIndex->setTrackDefaults(U32_AT(&buffer[4]), defaults);
+            }
+
+            *offset += chunk_size;
+            break;
+        }
+
         case FOURCC('h', 'd', 'l', 'r'):
         {
             uint32_t buffer;
@@ -1714,6 +2272,52 @@ status_t MPEG4Extractor::parseTrackHeader(
     return OK;
 }
 
+// Scans the boxes following the movie box of a fragmented file up to its
+// first movie fragment, reading the segment index on the way if any.
+status_t MPEG4Extractor::parseFragmentedHeaders(off64_t offset) {
+    off64_t fileSize;
+    if (mDataSource->getSize(&fileSize) != OK) {
+        fileSize = -1;
+    }
+
+    for (;;) {
+        uint32_t type;
+        off64_t size, data_offset;
+        if (readBoxHeader(mDataSource, offset, fileSize,
+                    &type, &size, &data_offset) != OK
+                || type == FOURCC('m', 'o', 'o', 'f')) {
+            break;
+        }
+
+        if (type == FOURCC('s', 'i', 'd', 'x')) {
+            status_t err = mFragmentIndex->parseSegmentIndex(
+                    data_offset, offset + size - data_offset);
+            if (err != OK) {
+                ALOGW("ignoring malformed segment index");
+            }
+        }
+
+        offset += size;
+    }
+
+    ALOGV("first movie fragment @ %lld", offset);
+    mFragmentIndex->setFirstFragmentOffset(offset);
+
+    // The movie box of a fragmented file usually has no duration.
+    int64_t segmentsDurationUs = mFragmentIndex->getSegmentsDurationUs();
+    if (segmentsDurationUs > 0) {
+        for (Track *track = mFirstTrack; track != NULL; track = track->next) {
+            int64_t durationUs;
+            if (!track->meta->findInt64(kKeyDuration, &durationUs)
+                    || durationUs <= 0) {
+                track->meta->setInt64(kKeyDuration, segmentsDurationUs);
+            }
+        }
+    }
+
+    return OK;
+}
+
 status_t MPEG4Extractor::parseMetaData(off64_t offset, size_t size) {
     if (size < 4) {
         return ERROR_MALFORMED;
@@ -1890,7 +2494,7 @@ status_t MPEG4Extractor::parseMetaData(off64_t offset, size_t size) {
 
 sp<MediaSource> MPEG4Extractor::getTrack(size_t index) {
     status_t err;
-    if ((err = readMetaData()) != OK) {
+    if (mMetadataOnly || (err = readMetaData()) != OK) {
         return NULL;
     }
 
@@ -1909,11 +2513,11 @@ sp<MediaSource> MPEG4Extractor::getTrack(size_t index) {
     }
 
     return new MPEG4Source(
-            track->meta, mDataSource, track->timescale, track->sampleTable);
+            track->meta, mDataSource, track->timescale, track->sampleTable,
+            mFragmentIndex);
 }
 
-// static
-status_t MPEG4Extractor::verifyTrack(Track *track) {
+status_t MPEG4Extractor::verifyTrack(Track *track) const {
     const char *mime;
     CHECK(track->meta->findCString(kKeyMIMEType, &mime));
 
@@ -1933,7 +2537,7 @@ status_t MPEG4Extractor::verifyTrack(Track *track) {
         }
     }
 
-    if (!track->sampleTable->isValid()) {
+    if (!mMetadataOnly && !track->sampleTable->isValid()) {
         // Make sure we have all the metadata we need.
         return ERROR_MALFORMED;
     }
@@ -2062,7 +2666,8 @@ MPEG4Source::MPEG4Source(
         const sp<MetaData> &format,
         const sp<DataSource> &dataSource,
         int32_t timeScale,
-        const sp<SampleTable> &sampleTable)
+        const sp<SampleTable> &sampleTable,
+        const sp<MPEG4FragmentIndex> &fragmentIndex)
     : mFormat(format),
       mDataSource(dataSource),
       mTimescale(timeScale),
@@ -2070,11 +2675,18 @@ MPEG4Source::MPEG4Source(
       mCurrentSampleIndex(0),
       mIsAVC(false),
       mNALLengthSize(0),
+      mSampleTimeTraceName(NULL),
       mStarted(false),
       mGroup(NULL),
       mBuffer(NULL),
       mWantsNALFragments(false),
-      mSrcBuffer(NULL)
+      mSrcBuffer(NULL),
+      mFragmentIndex(fragmentIndex),
+      mIsFragmented(false),
+      mTrackID(0),
+      mCurrentMoofOffset(-1),
+      mNextMoofOffset(-1),
+      mNextFragmentTime(0)
 #ifdef QCOM_HARDWARE
       , mNumSamplesReadError(0)
 #endif
@@ -2093,6 +2705,22 @@ MPEG4Source::MPEG4Source(
 
     mIsAVC = !strcasecmp(mime, MEDIA_MIMETYPE_VIDEO_AVC);
 
+    if (!strncasecmp(mime, "video/", 6)) {
+        mSampleTimeTraceName = "Video Sample Time (ms)";
+    } else if (!strncasecmp(mime, "audio/", 6)) {
+        mSampleTimeTraceName = "Audio Sample Time (ms)";
+    } else {
+        mSampleTimeTraceName = "Text Sample Time (ms)";
+    }
+
+    int32_t trackID;
+    if (mFragmentIndex != NULL && mSampleTable->countSamples() == 0
+            && mFormat->findInt32(kKeyTrackID, &trackID)) {
+        mIsFragmented = true;
+        mTrackID = trackID;
+        mTrackDefaults = mFragmentIndex->getTrackDefaults(mTrackID);
+    }
+
     if (mIsAVC) {
         uint32_t type;
         const void *data;
@@ -2172,6 +2800,8 @@ status_t MPEG4Source::stop() {
 
     mStarted = false;
     mCurrentSampleIndex = 0;
+    mCurrentMoofOffset = -1;
+    mCurrentSamples.clear();
 
     return OK;
 }
@@ -2203,6 +2833,8 @@ size_t MPEG4Source::parseNALSize(const uint8_t *data) const {
 
 status_t MPEG4Source::read(
         MediaBuffer **out, const ReadOptions *options) {
+    ScopedTrace trace(ATRACE_TAG, "MPEG4Source::read");
+
     Mutex::Autolock autoLock(mLock);
 
     CHECK(mStarted);
@@ -2231,59 +2863,80 @@ status_t MPEG4Source::read(
                 break;
         }
 
-        uint32_t sampleIndex;
-        status_t err = mSampleTable->findSampleAtTime(
-                seekTimeUs * mTimescale / 1000000,
-                &sampleIndex, findFlags);
+        if (mIsFragmented) {
+            // Like below, the sync sample preceding the closest sample for
+            // SEEK_CLOSEST.
+            uint64_t sampleTime;
+            status_t err = seekFragmented_l(
+                    seekTimeUs * mTimescale / 1000000,
+                    (mode == ReadOptions::SEEK_CLOSEST)
+                        ? SampleTable::kFlagBefore : findFlags,
+                    &sampleTime);
 
-        if (mode == ReadOptions::SEEK_CLOSEST) {
-            // We found the closest sample already, now we want the sync
-            // sample preceding it (or the sample itself of course), even
-            // if the subsequent sync sample is closer.
-            findFlags = SampleTable::kFlagBefore;
-        }
+            if (err != OK) {
+                return err;
+            }
 
-        uint32_t syncSampleIndex;
-        if (err == OK) {
-            err = mSampleTable->findSyncSampleNear(
-                    sampleIndex, &syncSampleIndex, findFlags);
-        }
+            if (mode == ReadOptions::SEEK_CLOSEST) {
+                targetSampleTimeUs = (sampleTime * 1000000ll) / mTimescale;
+            }
+        } else {
+            uint32_t sampleIndex;
+            status_t err = mSampleTable->findSampleAtTime(
+                    seekTimeUs * mTimescale / 1000000,
+                    &sampleIndex, findFlags);
+
+            if (mode == ReadOptions::SEEK_CLOSEST) {
+                // We found the closest sample already, now we want the sync
+                // sample preceding it (or the sample itself of course), even
+                // if the subsequent sync sample is closer.
+                findFlags = SampleTable::kFlagBefore;
+            }
 
-        uint64_t sampleTime;
-        if (err == OK) {
-            err = mSampleTable->getMetaDataForSample(
-                    sampleIndex, NULL, NULL, &sampleTime);
-        }
+            uint32_t syncSampleIndex;
+            if (err == OK) {
+                err = mSampleTable->findSyncSampleNear(
+                        sampleIndex, &syncSampleIndex, findFlags);
+            }
 
-        if (err != OK) {
-            if (err == ERROR_OUT_OF_RANGE) {
-                // An attempt to seek past the end of the stream would
-                // normally cause this ERROR_OUT_OF_RANGE error. Propagating
-                // this all the way to the MediaPlayer would cause abnormal
-                // termination. Legacy behaviour appears to be to behave as if
-                // we had seeked to the end of stream, ending normally.
-                err = ERROR_END_OF_STREAM;
+            uint64_t sampleTime;
+            if (err == OK) {
+                err = mSampleTable->getMetaDataForSample(
+                        sampleIndex, NULL, NULL, &sampleTime);
             }
-            return err;
-        }
 
-        if (mode == ReadOptions::SEEK_CLOSEST) {
-            targetSampleTimeUs = (sampleTime * 1000000ll) / mTimescale;
-        }
+            if (err != OK) {
+                if (err == ERROR_OUT_OF_RANGE) {
+                    // An attempt to seek past the end of the stream would
+                    // normally cause this ERROR_OUT_OF_RANGE error.
+                    // Propagating this all the way to the MediaPlayer would
+                    // cause abnormal termination. Legacy behaviour appears to
+                    // be to behave as if we had seeked to the end of stream,
+                    // ending normally.
+                    err = ERROR_END_OF_STREAM;
+                }
+                return err;
+            }
+
+            if (mode == ReadOptions::SEEK_CLOSEST) {
+                targetSampleTimeUs = (sampleTime * 1000000ll) / mTimescale;
+            }
 
 #if 0
-        uint64_t syncSampleTime;
-        CHECK_EQ(OK, mSampleTable->getMetaDataForSample(
-                    syncSampleIndex, NULL, NULL, &syncSampleTime));
-
-        ALOGI("seek to time %lld us => sample at time %lld us, "
-             "sync sample at time %lld us",
-             seekTimeUs,
-             sampleTime * 1000000ll / mTimescale,
-             syncSampleTime * 1000000ll / mTimescale);
+            uint64_t syncSampleTime;
+            CHECK_EQ(OK, mSampleTable->getMetaDataForSample(
+                        syncSampleIndex, NULL, NULL, &syncSampleTime));
+
+            ALOGI("seek to time %lld us => sample at time %lld us, "
+                 "sync sample at time %lld us",
+                 seekTimeUs,
+                 sampleTime * 1000000ll / mTimescale,
+                 syncSampleTime * 1000000ll / mTimescale);
 #endif
 
-        mCurrentSampleIndex = syncSampleIndex;
+            mCurrentSampleIndex = syncSampleIndex;
+        }
+
         if (mBuffer != NULL) {
             mBuffer->release();
             mBuffer = NULL;
@@ -2297,11 +2950,13 @@ status_t MPEG4Source::read(
     uint64_t cts;
     bool isSyncSample;
     bool newBuffer = false;
+    sp<ABuffer> mapped;
     if (mBuffer == NULL) {
         newBuffer = true;
 
-        status_t err =
-            mSampleTable->getMetaDataForSample(
+        status_t err = mIsFragmented
+            ? getFragmentedSample_l(&offset, &size, &cts, &isSyncSample)
+            : mSampleTable->getMetaDataForSample(
                     mCurrentSampleIndex, &offset, &size, &cts, &isSyncSample);
 
         if (err != OK) {
@@ -2311,19 +2966,27 @@ status_t MPEG4Source::read(
             return err;
         }
 
-        err = mGroup->acquire_buffer(&mBuffer);
+        // If the sample is in memory already, it is returned as is rather
+        // than copied into one of our buffers.
+        mapped = mDataSource->getMappedRange(offset, size);
 
-        if (err != OK) {
-            CHECK(mBuffer == NULL);
+        if (mapped != NULL && (!mIsAVC || mWantsNALFragments)) {
+            mBuffer = MediaBuffer::CreateView(mapped);
+        } else {
+            err = mGroup->acquire_buffer(&mBuffer);
+
+            if (err != OK) {
+                CHECK(mBuffer == NULL);
 #ifdef QCOM_HARDWARE
-            if (mStatistics) mNumSamplesReadError++;
+                if (mStatistics) mNumSamplesReadError++;
 #endif
-            return err;
+                return err;
+            }
         }
     }
 
     if (!mIsAVC || mWantsNALFragments) {
-        if (newBuffer) {
+        if (newBuffer && mapped == NULL) {
             if (size > mBuffer->size()) {
                 mBuffer->release();
                 mBuffer = NULL;
@@ -2341,12 +3004,15 @@ status_t MPEG4Source::read(
 #endif
                 return ERROR_IO;
             }
+        }
 
+        if (newBuffer) {
             CHECK(mBuffer != NULL);
             mBuffer->set_range(0, size);
             mBuffer->meta_data()->clear();
             mBuffer->meta_data()->setInt64(
                     kKeyTime, (cts * 1000000) / mTimescale);
+            ATRACE_INT(mSampleTimeTraceName, (cts * 1000) / mTimescale);
 
             if (targetSampleTimeUs >= 0) {
                 mBuffer->meta_data()->setInt64(
@@ -2411,9 +3077,14 @@ status_t MPEG4Source::read(
         ssize_t num_bytes_read = 0;
         int32_t drm = 0;
         bool usesDRM = (mFormat->findInt32(kKeyIsDRM, &drm) && drm != 0);
+        const uint8_t *srcBuffer = mSrcBuffer;
         if (usesDRM) {
             num_bytes_read =
                 mDataSource->readAt(offset, (uint8_t*)mBuffer->data(), size);
+        } else if (mapped != NULL) {
+            // Converted straight from the mapping.
+            srcBuffer = mapped->data();
+            num_bytes_read = size;
         } else {
             num_bytes_read = mDataSource->readAt(offset, mSrcBuffer, size);
         }
@@ -2441,7 +3112,7 @@ status_t MPEG4Source::read(
                 bool isMalFormed = (srcOffset + mNALLengthSize > size);
                 size_t nalLength = 0;
                 if (!isMalFormed) {
-                    nalLength = parseNALSize(&mSrcBuffer[srcOffset]);
+                    nalLength = parseNALSize(&srcBuffer[srcOffset]);
                     srcOffset += mNALLengthSize;
                     isMalFormed = srcOffset + nalLength > size;
                 }
@@ -2467,7 +3138,7 @@ status_t MPEG4Source::read(
                 dstData[dstOffset++] = 0;
                 dstData[dstOffset++] = 0;
                 dstData[dstOffset++] = 1;
-                memcpy(&dstData[dstOffset], &mSrcBuffer[srcOffset], nalLength);
+                memcpy(&dstData[dstOffset], &srcBuffer[srcOffset], nalLength);
                 srcOffset += nalLength;
                 dstOffset += nalLength;
             }
@@ -2479,6 +3150,7 @@ status_t MPEG4Source::read(
         mBuffer->meta_data()->clear();
         mBuffer->meta_data()->setInt64(
                 kKeyTime, (cts * 1000000) / mTimescale);
+        ATRACE_INT(mSampleTimeTraceName, (cts * 1000) / mTimescale);
 
         if (targetSampleTimeUs >= 0) {
             mBuffer->meta_data()->setInt64(
@@ -2498,6 +3170,463 @@ status_t MPEG4Source::read(
     }
 }
 
+// Parses the first movie fragment at or after offset with samples of this
+// track. defaultTime is the decoding time of its first sample unless the
+// fragment has a 'tfdt' box.
+status_t MPEG4Source::loadFragment_l(off64_t offset, uint64_t defaultTime) {
+    off64_t fileSize;
+    if (mDataSource->getSize(&fileSize) != OK) {
+        fileSize = -1;
+    }
+
+    for (;;) {
+        uint32_t type;
+        off64_t size, data_offset;
+        status_t err = readBoxHeader(
+                mDataSource, offset, fileSize, &type, &size, &data_offset);
+        if (err != OK) {
+            return err;
+        }
+
+        if (type == FOURCC('m', 'o', 'o', 'f')) {
+            mCurrentSamples.clear();
+
+            uint64_t time = defaultTime;
+            off64_t end = offset + size;
+            off64_t childOffset = data_offset;
+            while (childOffset < end) {
+                uint32_t childType;
+                off64_t childSize, childDataOffset;
+                err = readBoxHeader(
+                        mDataSource, childOffset, end,
+                        &childType, &childSize, &childDataOffset);
+                if (err != OK) {
+                    return (err == ERROR_END_OF_STREAM) ? ERROR_IO : err;
+                }
+
+                if (childType == FOURCC('t', 'r', 'a', 'f')) {
+                    err = parseTrackFragment_l(
+                            offset, childDataOffset, childOffset + childSize,
+                            &time);
+                    if (err != OK) {
+                        return err;
+                    }
+                }
+
+                childOffset += childSize;
+            }
+
+            mCurrentMoofOffset = offset;
+            mNextMoofOffset = end;
+
+            if (!mCurrentSamples.isEmpty()) {
+                mNextFragmentTime = time;
+                mFragments.add(offset, mCurrentSamples[0].mDecodingTime);
+
+                ALOGV("fragment @ %lld: %d samples",
+                     offset, mCurrentSamples.size());
+
+                return OK;
+            }
+        }
+
+        offset += size;
+    }
+}
+
+status_t MPEG4Source::parseTrackFragment_l(
+        off64_t moofOffset, off64_t offset, off64_t end, uint64_t *time) {
+    TrackFragmentHeader header;
+    bool foundHeader = false;
+
+    // Sample data offsets are relative to the start of the 'moof' box
+    // unless specified otherwise, the runs without one follow the
+    // previous run.
+    off64_t sampleDataOffset = -1;
+
+    while (offset < end) {
+        uint32_t type;
+        off64_t size, data_offset;
+        status_t err = readBoxHeader(
+                mDataSource, offset, end, &type, &size, &data_offset);
+        if (err != OK) {
+            return (err == ERROR_END_OF_STREAM) ? ERROR_IO : err;
+        }
+
+        off64_t data_size = offset + size - data_offset;
+
+        switch (type) {
+            case FOURCC('t', 'f', 'h', 'd'):
+            {
+                uint8_t buffer[32];
+                if (data_size < 8) {
+                    return ERROR_MALFORMED;
+                }
+                size_t n = data_size < (off64_t)sizeof(buffer)
+                    ? data_size : sizeof(buffer);
+                if (mDataSource->readAt(data_offset, buffer, n)
+                        < (ssize_t)n) {
+                    return ERROR_IO;
+                }
+
+                uint32_t flags = U32_AT(&buffer[0]) & 0xffffff;
+                if (U32_AT(&buffer[4]) != mTrackID) {
+                    // Some other track's fragment.
+                    return OK;
+                }
+
+                header.mBaseDataOffset = moofOffset;
+                header.mSampleDuration = mTrackDefaults.mSampleDuration;
+                header.mSampleSize = mTrackDefaults.mSampleSize;
+                header.mSampleFlags = mTrackDefaults.mSampleFlags;
+
+                size_t ptr = 8;
+                if (flags & 0x01) {  // base-data-offset-present
+                    if (ptr + 8 > n) {
+                        return ERROR_MALFORMED;
+                    }
+                    header.mBaseDataOffset = U64_AT(&buffer[ptr]);
+                    ptr += 8;
+                }
+                if (flags & 0x02) {  // sample-description-index-present
+                    ptr += 4;
+                }
+                if (flags & 0x08) {  // default-sample-duration-present
+                    if (ptr + 4 > n) {
+                        return ERROR_MALFORMED;
+                    }
+                    header.mSampleDuration = U32_AT(&buffer[ptr]);
+                    ptr += 4;
+                }
+                if (flags & 0x10) {  // default-sample-size-present
+                    if (ptr + 4 > n) {
+                        return ERROR_MALFORMED;
+                    }
+                    header.mSampleSize = U32_AT(&buffer[ptr]);
+                    ptr += 4;
+                }
+                if (flags & 0x20) {  // default-sample-flags-present
+                    if (ptr + 4 > n) {
+                        return ERROR_MALFORMED;
+                    }
+                    header.mSampleFlags = U32_AT(&buffer[ptr]);
+                    ptr += 4;
+                }
+
+                foundHeader = true;
+                break;
+            }
+
+            case FOURCC('t', 'f', 'd', 't'):
+            {
+                uint8_t buffer[12];
+                if (!foundHeader || data_size < 8) {
+                    return ERROR_MALFORMED;
+                }
+                size_t n = (data_size < 12) ? 8 : 12;
+                if (mDataSource->readAt(data_offset, buffer, n)
+                        < (ssize_t)n) {
+                    return ERROR_IO;
+                }
+
+                if (buffer[0] == 1) {
+                    if (n < 12) {
+                        return ERROR_MALFORMED;
+                    }
+                    *time = U64_AT(&buffer[4]);
+                } else {
+                    *time = U32_AT(&buffer[4]);
+                }
+                break;
+            }
+
+            case FOURCC('t', 'r', 'u', 'n'):
+            {
+                if (!foundHeader) {
+                    return ERROR_MALFORMED;
+                }
+
+                err = parseTrackFragmentRun_l(
+                        data_offset, data_size, header,
+                        &sampleDataOffset, time);
+                if (err != OK) {
+                    return err;
+                }
+                break;
+            }
+
+            default:
+                break;
+        }
+
+        offset += size;
+    }
+
+    return OK;
+}
+
+status_t MPEG4Source::parseTrackFragmentRun_l(
+        off64_t data_offset, off64_t data_size,
+        const TrackFragmentHeader &header,
+        off64_t *sampleDataOffset, uint64_t *time) {
+    uint8_t buffer[16];
+    if (data_size < 8) {
+        return ERROR_MALFORMED;
+    }
+    size_t n = data_size < (off64_t)sizeof(buffer) ? data_size : sizeof(buffer);
+    if (mDataSource->readAt(data_offset, buffer, n) < (ssize_t)n) {
+        return ERROR_IO;
+    }
+
+    uint32_t flags = U32_AT(&buffer[0]) & 0xffffff;
+    uint32_t sampleCount = U32_AT(&buffer[4]);
+
+    size_t ptr = 8;
+    if (flags & 0x01) {  // data-offset-present
+        if (ptr + 4 > n) {
+            return ERROR_MALFORMED;
+        }
+        *sampleDataOffset =
+            header.mBaseDataOffset + (int32_t)U32_AT(&buffer[ptr]);
+        ptr += 4;
+    } else if (*sampleDataOffset < 0) {
+        *sampleDataOffset = header.mBaseDataOffset;
+    }
+
+    bool hasFirstSampleFlags = false;
+    uint32_t firstSampleFlags = 0;
+    if (flags & 0x04) {  // first-sample-flags-present
+        if (ptr + 4 > n) {
+            return ERROR_MALFORMED;
+        }
+        hasFirstSampleFlags = true;
+        firstSampleFlags = U32_AT(&buffer[ptr]);
+        ptr += 4;
+    }
+
+    size_t entrySize = 0;
+    for (uint32_t bit = 0x100; bit <= 0x800; bit <<= 1) {
+        if (flags & bit) {
+            entrySize += 4;
+        }
+    }
+
+    // A run without per-sample data costs nothing to declare but
+    // mCurrentSamples entries, bound the number of samples anyway.
+    static const uint32_t kMaxNumFragmentSamples = 1 << 20;
+    if (sampleCount > kMaxNumFragmentSamples
+            || (off64_t)(ptr + (uint64_t)sampleCount * entrySize) > data_size) {
+        return ERROR_MALFORMED;
+    }
+
+    uint8_t *entries = NULL;
+    if (entrySize > 0 && sampleCount > 0) {
+        size_t entriesSize = sampleCount * entrySize;
+        entries = new uint8_t[entriesSize];
+        if (mDataSource->readAt(data_offset + ptr, entries, entriesSize)
+                < (ssize_t)entriesSize) {
+            delete[] entries;
+            return ERROR_IO;
+        }
+    }
+
+    const uint8_t *entry = entries;
+    for (uint32_t i = 0; i < sampleCount; ++i) {
+        uint32_t duration = header.mSampleDuration;
+        uint32_t size = header.mSampleSize;
+        uint32_t sampleFlags =
+            (i == 0 && hasFirstSampleFlags)
+                ? firstSampleFlags : header.mSampleFlags;
+        int32_t compositionOffset = 0;
+
+        if (flags & 0x100) {  // sample-duration-present
+            duration = U32_AT(entry);
+            entry += 4;
+        }
+        if (flags & 0x200) {  // sample-size-present
+            size = U32_AT(entry);
+            entry += 4;
+        }
+        if (flags & 0x400) {  // sample-flags-present
+            if (i > 0 || !hasFirstSampleFlags) {
+                sampleFlags = U32_AT(entry);
+            }
+            entry += 4;
+        }
+        if (flags & 0x800) {  // sample-composition-time-offsets-present
+            // Unsigned in version 0, but never that large in practice.
+            compositionOffset = (int32_t)U32_AT(entry);
+            entry += 4;
+        }
+
+        FragmentSample sample;
+        sample.mOffset = *sampleDataOffset;
+        sample.mSize = size;
+        sample.mDecodingTime = *time;
+        sample.mCompositionOffset = compositionOffset;
+        // sample_is_non_sync_sample
+        sample.mIsSyncSample = !(sampleFlags & 0x10000);
+        mCurrentSamples.push(sample);
+
+        *sampleDataOffset += size;
+        *time += duration;
+    }
+
+    delete[] entries;
+
+    return OK;
+}
+
+status_t MPEG4Source::getFragmentedSample_l(
+        off64_t *offset, size_t *size, uint64_t *compositionTime,
+        bool *isSyncSample) {
+    while (mCurrentSampleIndex >= mCurrentSamples.size()) {
+        status_t err;
+        if (mCurrentMoofOffset < 0) {
+            err = loadFragment_l(mFragmentIndex->getFirstFragmentOffset(), 0);
+        } else {
+            err = loadFragment_l(mNextMoofOffset, mNextFragmentTime);
+        }
+
+        if (err != OK) {
+            return err;
+        }
+
+        mCurrentSampleIndex = 0;
+    }
+
+    const FragmentSample &sample = mCurrentSamples[mCurrentSampleIndex];
+
+    int32_t max_size;
+    CHECK(mFormat->findInt32(kKeyMaxInputSize, &max_size));
+    if (sample.mSize > (size_t)max_size) {
+        ALOGE("fragment sample of %d bytes is too large", sample.mSize);
+        return ERROR_MALFORMED;
+    }
+
+    *offset = sample.mOffset;
+    *size = sample.mSize;
+
+    int64_t cts = sample.mDecodingTime + sample.mCompositionOffset;
+    *compositionTime = (cts > 0) ? cts : 0;
+
+    *isSyncSample = sample.mIsSyncSample;
+
+    return OK;
+}
+
+status_t MPEG4Source::seekFragmented_l(
+        uint64_t time, uint32_t findFlags, uint64_t *sampleTime) {
+    // Start from the closest fragment known to begin at or before time,
+    // whether it was parsed already or comes from the index.
+    off64_t offset = mFragmentIndex->getFirstFragmentOffset();
+    uint64_t fragmentTime = 0;
+
+    ssize_t lo = 0, hi = (ssize_t)mFragments.size() - 1;
+    while (lo <= hi) {
+        ssize_t mid = (lo + hi) / 2;
+        if (mFragments.valueAt(mid) <= time) {
+            offset = mFragments.keyAt(mid);
+            fragmentTime = mFragments.valueAt(mid);
+            lo = mid + 1;
+        } else {
+            hi = mid - 1;
+        }
+    }
+
+    off64_t indexedOffset;
+    int64_t indexedTimeUs;
+    if (mFragmentIndex->findFragment(
+                mTrackID, mTimescale, (time * 1000000ll) / mTimescale,
+                &indexedOffset, &indexedTimeUs)
+            && indexedOffset > offset) {
+        offset = indexedOffset;
+        fragmentTime = (indexedTimeUs * mTimescale) / 1000000ll;
+    }
+
+    status_t err = loadFragment_l(offset, fragmentTime);
+    if (err != OK) {
+        return err;
+    }
+
+    // Then parse the following fragments up to the one holding time.
+    while (mNextFragmentTime <= time) {
+        off64_t previousOffset = mCurrentMoofOffset;
+        uint64_t previousTime = mCurrentSamples[0].mDecodingTime;
+
+        err = loadFragment_l(mNextMoofOffset, mNextFragmentTime);
+        if (err == ERROR_END_OF_STREAM) {
+            // Past the last fragment, settle for the last one.
+            err = loadFragment_l(previousOffset, previousTime);
+            if (err != OK) {
+                return err;
+            }
+            break;
+        } else if (err != OK) {
+            return err;
+        }
+    }
+
+    size_t numSamples = mCurrentSamples.size();
+
+    // The last sample decoded at or before time.
+    size_t index = 0;
+    while (index + 1 < numSamples
+            && mCurrentSamples[index + 1].mDecodingTime <= time) {
+        ++index;
+    }
+
+    const FragmentSample &sample = mCurrentSamples[index];
+    int64_t cts = sample.mDecodingTime + sample.mCompositionOffset;
+    *sampleTime = (cts > 0) ? cts : 0;
+
+    size_t before = index;
+    while (before > 0 && !mCurrentSamples[before].mIsSyncSample) {
+        --before;
+    }
+
+    size_t after = index;
+    while (after < numSamples && !mCurrentSamples[after].mIsSyncSample) {
+        ++after;
+    }
+
+    switch (findFlags) {
+        case SampleTable::kFlagBefore:
+            mCurrentSampleIndex = before;
+            break;
+
+        case SampleTable::kFlagAfter:
+            // Fragments normally start with a sync sample, the next one
+            // is the first sample of the next fragment otherwise.
+            mCurrentSampleIndex = after;
+            break;
+
+        default:
+        {
+            if (after == numSamples) {
+                mCurrentSampleIndex = before;
+                break;
+            }
+
+            int64_t beforeDiff =
+                (int64_t)time - mCurrentSamples[before].mDecodingTime;
+            int64_t afterDiff =
+                (int64_t)mCurrentSamples[after].mDecodingTime - time;
+            if (beforeDiff < 0) {
+                beforeDiff = -beforeDiff;
+            }
+            if (afterDiff < 0) {
+                afterDiff = -afterDiff;
+            }
+
+            mCurrentSampleIndex = (beforeDiff <= afterDiff) ? before : after;
+            break;
+        }
+    }
+
+    return OK;
+}
+
 MPEG4Extractor::Track *MPEG4Extractor::findTrackByMimePrefix(
         const char *mimePrefix) {
     for (Track *track = mFirstTrack; track != NULL; track = track->next) {
@@ -2552,6 +3681,9 @@ static bool isCompatibleBrand(uint32_t fourcc) {
         FOURCC('3', 'g', 'p', '4'),
         FOURCC('m', 'p', '4', '1'),
         FOURCC('m', 'p', '4', '2'),
+        FOURCC('i', 's', 'o', '5'),  // Fragmented files
+        FOURCC('i', 's', 'o', '6'),
+        FOURCC('d', 'a', 's', 'h'),
 
         // Won't promise that the following file types can be played.
         // Just give these file types a chance.
@@ -20,6 +20,7 @@
 
 #include <arpa/inet.h>
 
+#include <errno.h>
 #include <pthread.h>
 #include <sys/prctl.h>
 
@@ -46,6 +47,70 @@ static const int64_t kMax32BitFileSize = 0x007fffffffLL;
 static const uint8_t kNalUnitTypeSeqParamSet = 0x07;
 static const uint8_t kNalUnitTypePicParamSet = 0x08;
 static const int64_t kInitialDelayTimeUs     = 700000LL;
+static const size_t kWriteBufferSize         = 256 * 1024;
+static const size_t kWriteAlignment          = 4096;
+static const size_t kMediaDataCopySize       = 1024 * 1024;
+
+// Movie box bytes other than the sample tables, per track and in total.
+static const int64_t kTrackHeaderSizeEstimate = 1024;
+static const int64_t kMoovHeaderSizeEstimate  = 256;
+
+// Keeps the entries of a sample table in fixed size arrays, so that a long
+// recording costs one allocation per kEntriesPerArray entries rather than a
+// list node per entry, and the tables are written out array by array.
+template<class TYPE>
+struct ListTableEntries {
+    enum {
+        kEntriesPerArray = 1024,  // must be a power of 2
+    };
+
+    ListTableEntries() : mNumEntries(0) {}
+
+    ~ListTableEntries() {
+        for (size_t i = 0; i < mArrays.size(); ++i) {
+            delete[] mArrays[i];
+        }
+    }
+
+    void add(const TYPE &entry) {
+        size_t index = mNumEntries & (kEntriesPerArray - 1);
+        if (index == 0) {
+            TYPE *arr = new TYPE[kEntriesPerArray];
+            CHECK(arr != NULL);
+            mArrays.push(arr);
+        }
+        mArrays.editTop()[index] = entry;
+        ++mNumEntries;
+    }
+
+    size_t count() const { return mNumEntries; }
+
+    const TYPE &itemAt(size_t i) const {
+        return mArrays[i / kEntriesPerArray][i & (kEntriesPerArray - 1)];
+    }
+
+    TYPE &editItemAt(size_t i) {
+        return mArrays.editItemAt(i / kEntriesPerArray)[i & (kEntriesPerArray - 1)];
+    }
+
+    // The entries as consecutive runs: array i holds numEntriesInArray(i).
+    size_t numArrays() const { return mArrays.size(); }
+    const TYPE *arrayAt(size_t i) const { return mArrays[i]; }
+    size_t numEntriesInArray(size_t i) const {
+        return (i + 1 < mArrays.size())
+            ? kEntriesPerArray : mNumEntries - i * kEntriesPerArray;
+    }
+
+    size_t allocatedBytes() const {
+        return mArrays.size() * kEntriesPerArray * sizeof(TYPE);
+    }
+
+private:
+    size_t mNumEntries;
+    Vector<TYPE *> mArrays;
+
+    DISALLOW_EVIL_CONSTRUCTORS(ListTableEntries);
+};
 
 class MPEG4Writer::Track {
 public:
@@ -60,6 +125,10 @@ public:
 
     int64_t getDurationUs() const;
     int64_t getEstimatedTrackSizeBytes() const;
+    int64_t getEstimatedSampleTableSizeBytes() const;
+    // Memory held by the sample tables, as opposed to their size in the file
+    size_t getSampleTableAllocatedBytes() const;
+    void shiftChunkOffsets(off64_t shift);
     void writeTrackHeader(bool use32BitOffset = true);
     void bufferChunk(int64_t timestampUs);
     bool isAvc() const { return mIsAvc; }
@@ -69,10 +138,15 @@ public:
     int32_t getTrackId() const { return mTrackId; }
     status_t dump(int fd, const Vector<String16>& args) const;
 
+    // Fragmented files only
+    void setFragmentStartTimeOffset(int64_t moovStartTimeUs);
+    void writeFragment(List<MediaBuffer *> *samples, uint32_t sequenceNumber);
+    void writeTrexBox();
+    void writeTfraBox();
+
 private:
     enum {
         kMaxCttsOffsetTimeUs = 1000000LL,  // 1 second
-        kSampleArraySize = 1000,
     };
 
     MPEG4Writer *mOwner;
@@ -92,31 +166,32 @@ private:
     bool mIsRealTimeRecording;
     int64_t mMaxTimeStampUs;
     int64_t mEstimatedTrackSizeBytes;
+    int64_t mEstimatedSampleTableSizeBytes;
     int64_t mMdatSizeBytes;
     int32_t mTimeScale;
 
     pthread_t mThread;
 
     /*
-     * mNumSamples is used to track the total number of samples in
-     * mSampleSizes List.
+     * mNumSamples is used to track the total number of samples, including
+     * those of a fragmented file, which are not added to mSampleSizes.
      *
-     * A linked list of fixed sized array is used here to reduce the time
-     * to write out stsz box.
+     * The sample sizes are kept in network byte order, so that the stsz
+     * box is written out one array at a time.
      */
     uint32_t            mNumSamples;
-    uint32_t*           mCurrentSampleSizeArr;
-    List<uint32_t *>    mSampleSizes;
+    ListTableEntries<uint32_t> mSampleSizes;
     bool                mSamplesHaveSameSize;
 
     List<MediaBuffer *> mChunkSamples;
 
     size_t              mNumStcoTableEntries;
-    List<off64_t>         mChunkOffsets;
+    ListTableEntries<off64_t> mChunkOffsets;
 
     size_t              mNumStscTableEntries;
     struct StscTableEntry {
 
+        StscTableEntry() {}
         StscTableEntry(uint32_t chunk, uint32_t samples, uint32_t id)
             : firstChunk(chunk),
               samplesPerChunk(samples),
@@ -126,13 +201,14 @@ private:
         uint32_t samplesPerChunk;
         uint32_t sampleDescriptionId;
     };
-    List<StscTableEntry> mStscTableEntries;
+    ListTableEntries<StscTableEntry> mStscTableEntries;
 
     size_t        mNumStssTableEntries;
-    List<int32_t> mStssTableEntries;
+    ListTableEntries<int32_t> mStssTableEntries;
 
     struct SttsTableEntry {
 
+        SttsTableEntry() {}
         SttsTableEntry(uint32_t count, uint32_t duration)
             : sampleCount(count), sampleDuration(duration) {}
 
@@ -140,9 +216,10 @@ private:
         uint32_t sampleDuration;  // time scale based
     };
     size_t        mNumSttsTableEntries;
-    List<SttsTableEntry> mSttsTableEntries;
+    ListTableEntries<SttsTableEntry> mSttsTableEntries;
 
     struct CttsTableEntry {
+        CttsTableEntry() {}
         CttsTableEntry(uint32_t count, int32_t timescaledDur)
             : sampleCount(count), sampleDuration(timescaledDur) {}
 
@@ -150,7 +227,7 @@ private:
         uint32_t sampleDuration;  // time scale based
     };
     size_t        mNumCttsTableEntries;
-    List<CttsTableEntry> mCttsTableEntries;
+    ListTableEntries<CttsTableEntry> mCttsTableEntries;
     int64_t mMinCttsOffsetTimeUs;
     int64_t mMaxCttsOffsetTimeUs;
 
@@ -211,6 +288,21 @@ private:
     status_t checkCodecSpecificData() const;
     int32_t mRotation;
 
+    // The track fragments starting with a sync sample, for the 'tfra' box.
+    struct FragmentIndexEntry {
+        FragmentIndexEntry(uint64_t time, off64_t moofOffset)
+            : mTime(time), mMoofOffset(moofOffset) {}
+
+        uint64_t mTime;  // time scale based
+        off64_t mMoofOffset;
+    };
+    List<FragmentIndexEntry> mFragmentIndexEntries;
+    int64_t mFragmentStartTimeOffsetTicks;
+
+    // The duration written to the track header, which is unknown until
+    // the track is done in a fragmented file.
+    int64_t getHeaderDurationUs() const;
+
     void updateTrackSizeEstimate();
     void addOneStscTableEntry(size_t chunkId, size_t sampleId);
     void addOneStssTableEntry(size_t sampleId);
@@ -267,7 +359,18 @@ MPEG4Writer::MPEG4Writer(const char *filename)
       mLatitudex10000(0),
       mLongitudex10000(0),
       mAreGeoTagsAvailable(false),
-      mStartTimeOffsetMs(-1) {
+      mStartTimeOffsetMs(-1),
+      mFragmentDurationUs(0),
+      mFragmentsStarted(false),
+      mMoovOffset(-1),
+      mMoovSize(0),
+      mFragmentSequenceNumber(0),
+      mWriteBuffer(NULL),
+      mWriteBufferLength(0),
+      mWriteBufferFileOffset(0),
+      mNumFileWrites(0),
+      mTotalFileWriteTimeUs(0),
+      mMaxFileWriteTimeUs(0) {
 
     mFd = open(filename, O_CREAT | O_LARGEFILE | O_TRUNC | O_RDWR);
     if (mFd >= 0) {
@@ -291,7 +394,18 @@ MPEG4Writer::MPEG4Writer(int fd)
       mLatitudex10000(0),
       mLongitudex10000(0),
       mAreGeoTagsAvailable(false),
-      mStartTimeOffsetMs(-1) {
+      mStartTimeOffsetMs(-1),
+      mFragmentDurationUs(0),
+      mFragmentsStarted(false),
+      mMoovOffset(-1),
+      mMoovSize(0),
+      mFragmentSequenceNumber(0),
+      mWriteBuffer(NULL),
+      mWriteBufferLength(0),
+      mWriteBufferFileOffset(0),
+      mNumFileWrites(0),
+      mTotalFileWriteTimeUs(0),
+      mMaxFileWriteTimeUs(0) {
 }
 
 MPEG4Writer::~MPEG4Writer() {
@@ -315,6 +429,11 @@ status_t MPEG4Writer::dump(
     result.append(buffer);
     snprintf(buffer, SIZE, "     mStarted: %s\n", mStarted? "true": "false");
     result.append(buffer);
+    snprintf(buffer, SIZE, "     file writes: %lld, avg %lld us, max %lld us\n",
+            mNumFileWrites,
+            mNumFileWrites > 0 ? mTotalFileWriteTimeUs / mNumFileWrites : 0,
+            mMaxFileWriteTimeUs);
+    result.append(buffer);
     ::write(fd, result.string(), result.size());
     for (List<Track *>::iterator it = mTracks.begin();
          it != mTracks.end(); ++it) {
@@ -333,6 +452,9 @@ status_t MPEG4Writer::Track::dump(
     snprintf(buffer, SIZE, "       reached EOS: %s\n",
             mReachedEOS? "true": "false");
     result.append(buffer);
+    snprintf(buffer, SIZE, "       sample tables: %d samples, %d bytes\n",
+            mNumSamples, getSampleTableAllocatedBytes());
+    result.append(buffer);
     ::write(fd, result.string(), result.size());
     return OK;
 }
@@ -463,6 +585,11 @@ status_t MPEG4Writer::start(MetaData *param) {
         }
     }
 
+    int32_t relocateMoovBox;
+    mRelocateMoovBox = param &&
+        param->findInt32(kKeyRelocateMoovBox, &relocateMoovBox) &&
+        relocateMoovBox;
+
     int32_t use2ByteNalLength;
     if (param &&
         param->findInt32(kKey2ByteNalLength, &use2ByteNalLength) &&
@@ -487,34 +614,61 @@ status_t MPEG4Writer::start(MetaData *param) {
     CHECK_GT(mTimeScale, 0);
     ALOGV("movie time scale: %d", mTimeScale);
 
+    if (!param ||
+        !param->findInt64(kKeyFragmentDurationUs, &mFragmentDurationUs) ||
+        mFragmentDurationUs < 0) {
+        mFragmentDurationUs = 0;
+    }
+
     mStreamableFile = true;
     mWriteMoovBoxToMemory = false;
     mMoovBoxBuffer = NULL;
     mMoovBoxBufferOffset = 0;
 
+    if (mWriteBuffer == NULL
+            && posix_memalign((void **)&mWriteBuffer,
+                    kWriteAlignment, kWriteBufferSize) != 0) {
+        // Fall back to writing to the file directly.
+        mWriteBuffer = NULL;
+    }
+    mWriteBufferLength = 0;
+    mWriteBufferFileOffset = lseek64(mFd, 0, SEEK_CUR);
+    if (mWriteBufferFileOffset < 0) {
+        mWriteBufferFileOffset = 0;
+    }
+
     writeFtypBox(param);
 
     mFreeBoxOffset = mOffset;
 
-    if (mEstimatedMoovBoxSize == 0) {
-        int32_t bitRate = -1;
-        if (param) {
-            param->findInt32(kKeyBitRate, &bitRate);
+    if (isFragmented()) {
+        // Neither space for the movie box nor a single 'mdat' box is
+        // needed, the movie box directly follows 'ftyp'.
+        ALOGI("Writing track fragments of %lld us", mFragmentDurationUs);
+        mFragmentsStarted = false;
+        mMoovOffset = -1;
+        mFragmentSequenceNumber = 0;
+    } else {
+        if (mEstimatedMoovBoxSize == 0) {
+            int32_t bitRate = -1;
+            if (param) {
+                param->findInt32(kKeyBitRate, &bitRate);
+            }
+            mEstimatedMoovBoxSize = estimateMoovBoxSize(bitRate);
         }
-        mEstimatedMoovBoxSize = estimateMoovBoxSize(bitRate);
-    }
-    CHECK_GE(mEstimatedMoovBoxSize, 8);
-    lseek64(mFd, mFreeBoxOffset, SEEK_SET);
-    writeInt32(mEstimatedMoovBoxSize);
-    write("free", 4);
+        CHECK_GE(mEstimatedMoovBoxSize, 8);
+        seekFile(mFreeBoxOffset);
+        writeInt32(mEstimatedMoovBoxSize);
+        write("free", 4);
 
-    mMdatOffset = mFreeBoxOffset + mEstimatedMoovBoxSize;
-    mOffset = mMdatOffset;
-    lseek64(mFd, mMdatOffset, SEEK_SET);
-    if (mUse32BitOffset) {
-        write("????mdat", 8);
-    } else {
-        write("\x00\x00\x00\x01mdat????????", 16);
+        mMdatOffset = mFreeBoxOffset + mEstimatedMoovBoxSize;
+        mOffset = mMdatOffset;
+        seekFile(mMdatOffset);
+        if (mUse32BitOffset) {
+            write("????mdat", 8);
+        } else {
+            write("\x00\x00\x00\x01mdat????????", 16);
+        }
     }
 
     status_t err = startWriterThread();
@@ -623,6 +777,16 @@ void MPEG4Writer::writeCompositionMatrix(int degrees) {
 }
 
 void MPEG4Writer::release() {
+    flushWriteBuffer(true /* all */);
+    free(mWriteBuffer);
+    mWriteBuffer = NULL;
+
+    if (mNumFileWrites > 0) {
+        ALOGD("%lld file writes, %lld us on average, %lld us at most",
+             mNumFileWrites, mTotalFileWriteTimeUs / mNumFileWrites,
+             mMaxFileWriteTimeUs);
+    }
+
     close(mFd);
     mFd = -1;
     mInitCheck = NO_INIT;
@@ -675,37 +839,73 @@ status_t MPEG4Writer::reset() {
         return err;
     }
 
+    if (isFragmented()) {
+        // Nothing at all was written if some track had no samples, which
+        // is an error.
+        if (mMoovOffset >= 0) {
+            finalizeFragmentedFile(maxDurationUs);
+        }
+
+        CHECK(mBoxes.empty());
+
+        release();
+        return err;
+    }
+
     // Fix up the size of the 'mdat' chunk.
     if (mUse32BitOffset) {
-        lseek64(mFd, mMdatOffset, SEEK_SET);
+        seekFile(mMdatOffset);
         int32_t size = htonl(static_cast<int32_t>(mOffset - mMdatOffset));
-        ::write(mFd, &size, 4);
+        writeFile(&size, 4);
     } else {
-        lseek64(mFd, mMdatOffset + 8, SEEK_SET);
+        seekFile(mMdatOffset + 8);
         int64_t size = mOffset - mMdatOffset;
         size = hton64(size);
-        ::write(mFd, &size, 8);
+        writeFile(&size, 8);
     }
-    lseek64(mFd, mOffset, SEEK_SET);
+    seekFile(mOffset);
 
     const off64_t moovOffset = mOffset;
     mWriteMoovBoxToMemory = true;
-    mMoovBoxBuffer = (uint8_t *) malloc(mEstimatedMoovBoxSize);
+    mMoovBoxBufferSize = mEstimatedMoovBoxSize;
+    mMoovBoxBuffer = (uint8_t *) malloc(mMoovBoxBufferSize);
     mMoovBoxBufferOffset = 0;
     CHECK(mMoovBoxBuffer != NULL);
     writeMoovBox(maxDurationUs);
 
     mWriteMoovBoxToMemory = false;
+    if (mStreamableFile && mMoovBoxBufferOffset + 8 > mEstimatedMoovBoxSize) {
+        // Kept in memory for relocation only.
+        status_t status = relocateMoovBox(maxDurationUs);
+        if (status != OK) {
+            if (status == ERROR_IO) {
+                // Some media data was moved already, nothing to salvage.
+                free(mMoovBoxBuffer);
+                mMoovBoxBuffer = NULL;
+                release();
+                return status;
+            }
+
+            seekFile(mOffset);
+            writeFile(mMoovBoxBuffer, mMoovBoxBufferOffset);
+            mOffset += mMoovBoxBufferOffset;
+            free(mMoovBoxBuffer);
+            mMoovBoxBuffer = NULL;
+            mMoovBoxBufferOffset = 0;
+            mStreamableFile = false;
+        }
+    }
+
     if (mStreamableFile) {
         CHECK_LE(mMoovBoxBufferOffset + 8, mEstimatedMoovBoxSize);
 
         // Moov box
-        lseek64(mFd, mFreeBoxOffset, SEEK_SET);
+        seekFile(mFreeBoxOffset);
         mOffset = mFreeBoxOffset;
         write(mMoovBoxBuffer, 1, mMoovBoxBufferOffset);
 
         // Free box
-        lseek64(mFd, mOffset, SEEK_SET);
+        seekFile(mOffset);
         writeInt32(mEstimatedMoovBoxSize - mMoovBoxBufferOffset);
         write("free", 4);
 
@@ -723,6 +923,108 @@ status_t MPEG4Writer::reset() {
     return err;
 }
 
+/*
+ * Makes room for the movie box in mMoovBoxBuffer in front of the media
+ * data by moving the latter towards the end of the file, and rewrites the
+ * box with the moved chunk offsets. Returns INVALID_OPERATION if the file
+ * was left untouched and ERROR_IO if moving the media data failed part way.
+ */
+status_t MPEG4Writer::relocateMoovBox(int64_t durationUs) {
+    // Grow the reserved space by whole pages, the new free box takes
+    // all of it the movie box doesn't.
+    off64_t shift = mMoovBoxBufferOffset + 8 - mEstimatedMoovBoxSize;
+    shift = (shift + kWriteAlignment - 1) / kWriteAlignment * kWriteAlignment;
+
+    if (mUse32BitOffset && mOffset + shift > kMax32BitFileSize) {
+        ALOGW("Not relocating the movie box, 32-bit chunk offsets overflow");
+        return INVALID_OPERATION;
+    }
+
+    int64_t startUs = systemTime() / 1000;
+    status_t err = shiftMediaData(shift);
+    if (err != OK) {
+        return err;
+    }
+    ALOGI("Moved %lld bytes of media data by %lld bytes in %lld us",
+         mOffset - mMdatOffset, shift, systemTime() / 1000 - startUs);
+
+    for (List<Track *>::iterator it = mTracks.begin();
+         it != mTracks.end(); ++it) {
+        (*it)->shiftChunkOffsets(shift);
+    }
+    mMdatOffset += shift;
+    mOffset += shift;
+    mEstimatedMoovBoxSize += shift;
+
+    // Only the chunk offsets changed, not the size of the box.
+    const off64_t moovBoxSize = mMoovBoxBufferOffset;
+    mWriteMoovBoxToMemory = true;
+    mMoovBoxBufferOffset = 0;
+    writeMoovBox(durationUs);
+    mWriteMoovBoxToMemory = false;
+    CHECK_EQ(mMoovBoxBufferOffset, moovBoxSize);
+
+    return OK;
+}
+
+// Moves the media data "shift" bytes towards the end of the file in large
+// sequential pieces, the last one first so that none is overwritten before
+// it has been copied.
+status_t MPEG4Writer::shiftMediaData(off64_t shift) {
+    flushWriteBuffer(true /* all */);
+
+    uint8_t *buffer = (uint8_t *)malloc(kMediaDataCopySize);
+    if (buffer == NULL) {
+        return INVALID_OPERATION;
+    }
+
+    status_t err = OK;
+    off64_t end = mOffset;
+    while (end > mMdatOffset) {
+        size_t n = kMediaDataCopySize;
+        if (end - mMdatOffset < (off64_t)n) {
+            n = end - mMdatOffset;
+        }
+        off64_t start = end - n;
+
+        if (pread64(mFd, buffer, n, start) != (ssize_t)n) {
+            // Most likely a write-only file descriptor if nothing was
+            // moved yet.
+            ALOGE("Failed to read %d bytes at offset %lld (%s)",
+                 n, start, strerror(errno));
+            err = (end == mOffset) ? INVALID_OPERATION : ERROR_IO;
+            break;
+        }
+
+        if (pwrite64(mFd, buffer, n, start + shift) != (ssize_t)n) {
+            ALOGE("Failed to write %d bytes at offset %lld (%s)",
+                 n, start + shift, strerror(errno));
+            err = ERROR_IO;
+            break;
+        }
+
+        end = start;
+    }
+
+    free(buffer);
+    return err;
+}
+
+void MPEG4Writer::finalizeFragmentedFile(int64_t durationUs) {
+    const off64_t endOffset = mOffset;
+
+    // The movie box has no sample tables, its size doesn't depend on
+    // the durations it is rewritten with.
+    seekFile(mMoovOffset);
+    mOffset = mMoovOffset;
+    writeMoovBox(durationUs);
+    CHECK_EQ(mOffset, mMoovOffset + mMoovSize);
+
+    seekFile(endOffset);
+    mOffset = endOffset;
+    writeMfraBox();
+}
+
 void MPEG4Writer::writeMvhdBox(int64_t durationUs) {
     time_t now = time(NULL);
     beginBox("mvhd");
@@ -759,9 +1061,40 @@ void MPEG4Writer::writeMoovBox(int64_t durationUs) {
         it != mTracks.end(); ++it, ++id) {
         (*it)->writeTrackHeader(mUse32BitOffset);
     }
+    if (isFragmented()) {
+        writeMvexBox(durationUs);
+    }
     endBox();  // moov
 }
 
+void MPEG4Writer::writeMvexBox(int64_t durationUs) {
+    beginBox("mvex");
+    beginBox("mehd");
+    writeInt32(0);             // version=0, flags=0
+    int32_t duration = (durationUs * mTimeScale + 5E5) / 1E6;
+    writeInt32(duration);      // fragment duration
+    endBox();  // mehd
+    for (List<Track *>::iterator it = mTracks.begin();
+        it != mTracks.end(); ++it) {
+        (*it)->writeTrexBox();
+    }
+    endBox();  // mvex
+}
+
+void MPEG4Writer::writeMfraBox() {
+    const off64_t mfraOffset = mOffset;
+    beginBox("mfra");
+    for (List<Track *>::iterator it = mTracks.begin();
+        it != mTracks.end(); ++it) {
+        (*it)->writeTfraBox();
+    }
+    beginBox("mfro");
+    writeInt32(0);             // version=0, flags=0
+    writeInt32(mOffset + 4 - mfraOffset);  // size of the 'mfra' box
+    endBox();  // mfro
+    endBox();  // mfra
+}
+
 void MPEG4Writer::writeFtypBox(MetaData *param) {
     beginBox("ftyp");
 
@@ -825,7 +1158,7 @@ void MPEG4Writer::unlock() {
 off64_t MPEG4Writer::addSample_l(MediaBuffer *buffer) {
     off64_t old_offset = mOffset;
 
-    ::write(mFd,
+    writeFile(
           (const uint8_t *)buffer->data() + buffer->range_offset(),
           buffer->range_length());
 
@@ -854,16 +1187,14 @@ off64_t MPEG4Writer::addLengthPrefixedSample_l(MediaBuffer *buffer) {
     size_t length = buffer->range_length();
 
     if (mUse4ByteNalLength) {
-        uint8_t x = length >> 24;
-        ::write(mFd, &x, 1);
-        x = (length >> 16) & 0xff;
-        ::write(mFd, &x, 1);
-        x = (length >> 8) & 0xff;
-        ::write(mFd, &x, 1);
-        x = length & 0xff;
-        ::write(mFd, &x, 1);
-
-        ::write(mFd,
+        uint8_t x[4];
+        x[0] = length >> 24;
+        x[1] = (length >> 16) & 0xff;
+        x[2] = (length >> 8) & 0xff;
+        x[3] = length & 0xff;
+        writeFile(x, 4);
+
+        writeFile(
               (const uint8_t *)buffer->data() + buffer->range_offset(),
               length);
 
@@ -871,17 +1202,83 @@ off64_t MPEG4Writer::addLengthPrefixedSample_l(MediaBuffer *buffer) {
     } else {
         CHECK_LT(length, 65536);
 
-        uint8_t x = length >> 8;
-        ::write(mFd, &x, 1);
-        x = length & 0xff;
-        ::write(mFd, &x, 1);
-        ::write(mFd, (const uint8_t *)buffer->data() + buffer->range_offset(), length);
+        uint8_t x[2];
+        x[0] = length >> 8;
+        x[1] = length & 0xff;
+        writeFile(x, 2);
+        writeFile((const uint8_t *)buffer->data() + buffer->range_offset(), length);
         mOffset += length + 2;
     }
 
     return old_offset;
 }
 
+void MPEG4Writer::writeFile(const void *data, size_t size) {
+    if (mWriteBuffer == NULL) {
+        ::write(mFd, data, size);
+        return;
+    }
+
+    const uint8_t *ptr = (const uint8_t *)data;
+    while (size > 0) {
+        size_t copy = kWriteBufferSize - mWriteBufferLength;
+        if (copy > size) {
+            copy = size;
+        }
+
+        memcpy(mWriteBuffer + mWriteBufferLength, ptr, copy);
+        mWriteBufferLength += copy;
+        ptr += copy;
+        size -= copy;
+
+        if (mWriteBufferLength == kWriteBufferSize) {
+            flushWriteBuffer(false /* all */);
+        }
+    }
+}
+
+void MPEG4Writer::seekFile(off64_t offset) {
+    flushWriteBuffer(true /* all */);
+
+    lseek64(mFd, offset, SEEK_SET);
+    mWriteBufferFileOffset = offset;
+}
+
+void MPEG4Writer::flushWriteBuffer(bool all) {
+    if (mWriteBufferLength == 0) {
+        return;
+    }
+
+    // Unless everything has to go out, keep the bytes past the last
+    // aligned file offset for the next write.
+    size_t length = mWriteBufferLength;
+    if (!all) {
+        size_t tail = (mWriteBufferFileOffset + length) % kWriteAlignment;
+        if (tail < length) {
+            length -= tail;
+        }
+    }
+
+    int64_t startUs = systemTime() / 1000;
+    ssize_t n = ::write(mFd, mWriteBuffer, length);
+    int64_t writeTimeUs = systemTime() / 1000 - startUs;
+
+    if (n != (ssize_t)length) {
+        ALOGE("Failed to write %d bytes at offset %lld (%s)",
+             length, mWriteBufferFileOffset, strerror(errno));
+    }
+
+    ++mNumFileWrites;
+    mTotalFileWriteTimeUs += writeTimeUs;
+    if (writeTimeUs > mMaxFileWriteTimeUs) {
+        mMaxFileWriteTimeUs = writeTimeUs;
+    }
+
+    mWriteBufferLength -= length;
+    memmove(mWriteBuffer, mWriteBuffer + length, mWriteBufferLength);
+    mWriteBufferFileOffset += length;
+}
+
 size_t MPEG4Writer::write(
         const void *ptr, size_t size, size_t nmemb) {
 
@@ -890,14 +1287,14 @@ size_t MPEG4Writer::write(
         // This happens only when we write the moov box at the end of
         // recording, not for each output video/audio frame we receive.
         off64_t moovBoxSize = 8 + mMoovBoxBufferOffset + bytes;
-        if (moovBoxSize > mEstimatedMoovBoxSize) {
+        if (moovBoxSize > mEstimatedMoovBoxSize && !mRelocateMoovBox) {
             for (List<off64_t>::iterator it = mBoxes.begin();
                  it != mBoxes.end(); ++it) {
                 (*it) += mOffset;
             }
-            lseek64(mFd, mOffset, SEEK_SET);
-            ::write(mFd, mMoovBoxBuffer, mMoovBoxBufferOffset);
-            ::write(mFd, ptr, size * nmemb);
+            seekFile(mOffset);
+            writeFile(mMoovBoxBuffer, mMoovBoxBufferOffset);
+            writeFile(ptr, size * nmemb);
             mOffset += (bytes + mMoovBoxBufferOffset);
             free(mMoovBoxBuffer);
             mMoovBoxBuffer = NULL;
@@ -905,11 +1302,18 @@ size_t MPEG4Writer::write(
             mWriteMoovBoxToMemory = false;
             mStreamableFile = false;
         } else {
+            // A box to be relocated is kept in memory whatever its size.
+            if (mMoovBoxBufferOffset + bytes > mMoovBoxBufferSize) {
+                mMoovBoxBufferSize = 2 * (mMoovBoxBufferOffset + bytes);
+                mMoovBoxBuffer =
+                    (uint8_t *)realloc(mMoovBoxBuffer, mMoovBoxBufferSize);
+                CHECK(mMoovBoxBuffer != NULL);
+            }
             memcpy(mMoovBoxBuffer + mMoovBoxBufferOffset, ptr, bytes);
             mMoovBoxBufferOffset += bytes;
         }
     } else {
-        ::write(mFd, ptr, size * nmemb);
+        writeFile(ptr, size * nmemb);
         mOffset += bytes;
     }
     return bytes;
@@ -935,10 +1339,10 @@ void MPEG4Writer::endBox() {
        int32_t x = htonl(mMoovBoxBufferOffset - offset);
        memcpy(mMoovBoxBuffer + offset, &x, 4);
     } else {
-        lseek64(mFd, offset, SEEK_SET);
+        seekFile(offset);
         writeInt32(mOffset - offset);
         mOffset -= 4;
-        lseek64(mFd, mOffset, SEEK_SET);
+        seekFile(mOffset);
     }
 }
 
@@ -1057,9 +1461,20 @@ bool MPEG4Writer::exceedsFileSizeLimit() {
     }
 
     int64_t nTotalBytesEstimate = static_cast<int64_t>(mEstimatedMoovBoxSize);
+    int64_t moovBoxSizeEstimate = kMoovHeaderSizeEstimate;
     for (List<Track *>::iterator it = mTracks.begin();
          it != mTracks.end(); ++it) {
         nTotalBytesEstimate += (*it)->getEstimatedTrackSizeBytes();
+        moovBoxSizeEstimate += kTrackHeaderSizeEstimate
+            + (*it)->getEstimatedSampleTableSizeBytes();
+    }
+
+    // A movie box outgrowing the reserved space either grows it when
+    // relocated or is written after the media data, wasting the space.
+    if (!isFragmented() && moovBoxSizeEstimate > mEstimatedMoovBoxSize) {
+        nTotalBytesEstimate += mRelocateMoovBox
+            ? moovBoxSizeEstimate - mEstimatedMoovBoxSize
+            : moovBoxSizeEstimate;
     }
 
     // Be conservative in the estimate: do not exceed 95% of
@@ -1130,12 +1545,14 @@ MPEG4Writer::Track::Track(
       mTrackId(trackId),
       mTrackDurationUs(0),
       mEstimatedTrackSizeBytes(0),
+      mEstimatedSampleTableSizeBytes(0),
       mSamplesHaveSameSize(true),
       mCodecSpecificData(NULL),
       mCodecSpecificDataSize(0),
       mGotAllCodecSpecificData(false),
       mReachedEOS(false),
-      mRotation(0) {
+      mRotation(0),
+      mFragmentStartTimeOffsetTicks(0) {
     getCodecSpecificDataFromInputFormatIfPossible();
 
     const char *mime;
@@ -1157,28 +1574,35 @@ void MPEG4Writer::Track::updateTrackSizeEstimate() {
     int64_t stszBoxSizeBytes = mSamplesHaveSameSize? 4: (mNumSamples * 4);
 
     mEstimatedTrackSizeBytes = mMdatSizeBytes;  // media data size
-    if (!mOwner->isFileStreamable()) {
-        // Reserved free space is not large enough to hold
-        // all meta data and thus wasted.
-        mEstimatedTrackSizeBytes += mNumStscTableEntries * 12 +  // stsc box size
-                                    mNumStssTableEntries * 4 +   // stss box size
-                                    mNumSttsTableEntries * 8 +   // stts box size
-                                    mNumCttsTableEntries * 8 +   // ctts box size
-                                    stcoBoxSizeBytes +           // stco box size
-                                    stszBoxSizeBytes;            // stsz box size
+    if (mOwner->isFragmented()) {
+        // The 'trun' entry of each sample is the bulk of the fragment
+        // headers.
+        mEstimatedTrackSizeBytes += mNumSamples * 16;
+        mEstimatedSampleTableSizeBytes = 0;
+        return;
     }
+
+    // Where the sample tables end up depends on whether the movie box
+    // fits the reserved space, which the owner accounts for.
+    mEstimatedSampleTableSizeBytes =
+                                mNumStscTableEntries * 12 +  // stsc box size
+                                mNumStssTableEntries * 4 +   // stss box size
+                                mNumSttsTableEntries * 8 +   // stts box size
+                                mNumCttsTableEntries * 8 +   // ctts box size
+                                stcoBoxSizeBytes +           // stco box size
+                                stszBoxSizeBytes;            // stsz box size
 }
 
 void MPEG4Writer::Track::addOneStscTableEntry(
         size_t chunkId, size_t sampleId) {
 
         StscTableEntry stscEntry(chunkId, sampleId, 1);
-        mStscTableEntries.push_back(stscEntry);
+        mStscTableEntries.add(stscEntry);
         ++mNumStscTableEntries;
 }
 
 void MPEG4Writer::Track::addOneStssTableEntry(size_t sampleId) {
-    mStssTableEntries.push_back(sampleId);
+    mStssTableEntries.add(sampleId);
     ++mNumStssTableEntries;
 }
 
@@ -1189,7 +1613,7 @@ void MPEG4Writer::Track::addOneSttsTableEntry(
         ALOGW("0-duration samples found: %d", sampleCount);
     }
     SttsTableEntry sttsEntry(sampleCount, duration);
-    mSttsTableEntries.push_back(sttsEntry);
+    mSttsTableEntries.add(sttsEntry);
     ++mNumSttsTableEntries;
 }
 
@@ -1200,13 +1624,13 @@ void MPEG4Writer::Track::addOneCttsTableEntry(
         return;
     }
     CttsTableEntry cttsEntry(sampleCount, duration);
-    mCttsTableEntries.push_back(cttsEntry);
+    mCttsTableEntries.add(cttsEntry);
     ++mNumCttsTableEntries;
 }
 
 void MPEG4Writer::Track::addChunkOffset(off64_t offset) {
     ++mNumStcoTableEntries;
-    mChunkOffsets.push_back(offset);
+    mChunkOffsets.add(offset);
 }
 
 void MPEG4Writer::Track::setTimeScale() {
@@ -1269,12 +1693,6 @@ MPEG4Writer::Track::~Track() {
         free(mCodecSpecificData);
         mCodecSpecificData = NULL;
     }
-
-    while (!mSampleSizes.empty()) {
-        List<uint32_t *>::iterator it = mSampleSizes.begin();
-        delete[] (*it);
-        mSampleSizes.erase(it);
-    }
 }
 
 void MPEG4Writer::Track::initTrackingProgressStatus(MetaData *params) {
@@ -1322,6 +1740,18 @@ void MPEG4Writer::writeChunkToFile(Chunk* chunk) {
     ALOGV("writeChunkToFile: %lld from %s track",
         chunk->mTimeStampUs, chunk->mTrack->isAudio()? "audio": "video");
 
+    if (isFragmented()) {
+        if (mMoovOffset < 0) {
+            mMoovOffset = mOffset;
+            writeMoovBox(0);
+            mMoovSize = mOffset - mMoovOffset;
+        }
+
+        chunk->mTrack->writeFragment(
+                &chunk->mSamples, ++mFragmentSequenceNumber);
+        return;
+    }
+
     int32_t isFirstSample = true;
     while (!chunk->mSamples.empty()) {
         List<MediaBuffer *>::iterator it = chunk->mSamples.begin();
@@ -1351,6 +1781,20 @@ void MPEG4Writer::writeAllChunks() {
         ++outstandingChunks;
     }
 
+    // Track fragments are only left if some track had no samples at all,
+    // there is no movie box to go with them.
+    for (List<ChunkInfo>::iterator it = mChunkInfos.begin();
+         it != mChunkInfos.end(); ++it) {
+        for (List<Chunk>::iterator chunkIt = it->mChunks.begin();
+             chunkIt != it->mChunks.end(); ++chunkIt) {
+            for (List<MediaBuffer *>::iterator sampleIt =
+                    chunkIt->mSamples.begin();
+                 sampleIt != chunkIt->mSamples.end(); ++sampleIt) {
+                (*sampleIt)->release();
+            }
+        }
+    }
+
     sendSessionSummary();
 
     mChunkInfos.clear();
@@ -1360,6 +1804,23 @@ void MPEG4Writer::writeAllChunks() {
 bool MPEG4Writer::findChunkToWrite(Chunk *chunk) {
     ALOGV("findChunkToWrite");
 
+    if (isFragmented() && !mFragmentsStarted) {
+        // The movie box preceding the fragments needs the codec specific
+        // data of all tracks, which they have once they buffered samples.
+        for (List<ChunkInfo>::iterator it = mChunkInfos.begin();
+             it != mChunkInfos.end(); ++it) {
+            if (it->mChunks.empty()) {
+                return false;
+            }
+        }
+
+        mFragmentsStarted = true;
+        for (List<Track *>::iterator it = mTracks.begin();
+             it != mTracks.end(); ++it) {
+            (*it)->setFragmentStartTimeOffset(mStartTimestampUs);
+        }
+    }
+
     int64_t minTimestampUs = 0x7FFFFFFFFFFFFFFFLL;
     Track *track = NULL;
     for (List<ChunkInfo>::iterator it = mChunkInfos.begin();
@@ -1517,6 +1978,7 @@ status_t MPEG4Writer::Track::start(MetaData *params) {
     mTrackDurationUs = 0;
     mReachedEOS = false;
     mEstimatedTrackSizeBytes = 0;
+    mEstimatedSampleTableSizeBytes = 0;
     mNumStcoTableEntries = 0;
     mNumStssTableEntries = 0;
     mNumStscTableEntries = 0;
@@ -2059,6 +2521,67 @@ status_t MPEG4Writer::Track::threadEntry() {
 #ifndef OMAP_ENHANCEMENT
         CHECK_GE(timestampUs, 0ll);
 #endif
+        if (mOwner->isFragmented()) {
+            // No sample tables are kept, the samples of the current
+            // fragment carry their times until it is written.
+            int64_t decodingTimeUs = timestampUs;
+            if (!mIsAudio) {
+                CHECK(meta_data->findInt64(kKeyDecodingTime, &decodingTimeUs));
+                decodingTimeUs -= previousPausedDurationUs;
+            }
+            CHECK_GE(decodingTimeUs, 0ll);
+
+            if (mIsRealTimeRecording && mIsAudio) {
+                updateDriftTime(meta_data);
+            }
+
+            if (decodingTimeUs > mTrackDurationUs) {
+                mTrackDurationUs = decodingTimeUs;
+            }
+
+            // Start video fragments with a sync sample unless that makes
+            // them twice as long as requested.
+            const int64_t fragmentDurationUs = mOwner->fragmentDuration();
+            int64_t chunkDurationUs = decodingTimeUs - chunkTimestampUs;
+            if (!mChunkSamples.empty()
+                    && chunkDurationUs >= fragmentDurationUs
+                    && (mIsAudio || isSync
+                        || chunkDurationUs >= 2 * fragmentDurationUs)) {
+                (*--mChunkSamples.end())->meta_data()->setInt64(
+                        kKeyDuration, decodingTimeUs - lastTimestampUs);
+                if (chunkDurationUs > mMaxChunkDurationUs) {
+                    mMaxChunkDurationUs = chunkDurationUs;
+                }
+                ++nChunks;
+                bufferChunk(chunkTimestampUs);
+            }
+            if (mChunkSamples.empty()) {
+                chunkTimestampUs = decodingTimeUs;
+            }
+
+            copy->meta_data()->setInt64(kKeyTime, timestampUs);
+            copy->meta_data()->setInt64(kKeyDecodingTime, decodingTimeUs);
+            copy->meta_data()->setInt32(kKeyIsSyncFrame, isSync);
+            mChunkSamples.push_back(copy);
+
+            ++mNumSamples;
+            if (isSync != 0) {
+                // Only counted, the fragments flag their sync samples.
+                ++mNumStssTableEntries;
+            }
+
+            lastDurationUs = decodingTimeUs - lastTimestampUs;
+            lastTimestampUs = decodingTimeUs;
+
+            if (mTrackingProgressStatus) {
+                if (mPreviousTrackTimeUs <= 0) {
+                    mPreviousTrackTimeUs = mStartTimestampUs;
+                }
+                trackProgressStatus(decodingTimeUs);
+            }
+            continue;
+        }
+
         if (!mIsAudio) {
             /*
              * Composition time: timestampUs
@@ -2133,14 +2656,7 @@ status_t MPEG4Writer::Track::threadEntry() {
                 (lastTimestampUs * mTimeScale + 500000LL) / 1000000LL);
         CHECK_GE(currDurationTicks, 0ll);
 
-        if ((mNumSamples % kSampleArraySize) == 0) {
-            uint32_t *arr = new uint32_t[kSampleArraySize];
-            CHECK(arr != NULL);
-            mSampleSizes.push_back(arr);
-            mCurrentSampleSizeArr = arr;
-        }
-
-        mCurrentSampleSizeArr[mNumSamples % kSampleArraySize] = htonl(sampleSize);
+        mSampleSizes.add(htonl(sampleSize));
         ++mNumSamples;
         if (mNumSamples > 2) {
 
@@ -2179,7 +2695,7 @@ status_t MPEG4Writer::Track::threadEntry() {
         if (!hasMultipleTracks) {
             off64_t offset = mIsAvc? mOwner->addLengthPrefixedSample_l(copy)
                                  : mOwner->addSample_l(copy);
-            if (mChunkOffsets.empty()) {
+            if (mChunkOffsets.count() == 0) {
                 addChunkOffset(offset);
             }
             copy->release();
@@ -2202,7 +2718,8 @@ status_t MPEG4Writer::Track::threadEntry() {
                     }
                     ++nChunks;
                     if (nChunks == 1 ||  // First chunk
-                        (--(mStscTableEntries.end()))->samplesPerChunk !=
+                        mStscTableEntries.itemAt(
+                            mStscTableEntries.count() - 1).samplesPerChunk !=
                          mChunkSamples.size()) {
                         addOneStscTableEntry(nChunks, mChunkSamples.size());
                     }
@@ -2221,7 +2738,14 @@ status_t MPEG4Writer::Track::threadEntry() {
     mOwner->trackProgressStatus(mTrackId, -1, err);
 
     // Last chunk
-    if (!hasMultipleTracks) {
+    if (mOwner->isFragmented()) {
+        if (!mChunkSamples.empty()) {
+            // Repeat the previous sample's duration for the last one.
+            (*--mChunkSamples.end())->meta_data()->setInt64(
+                    kKeyDuration, mNumSamples > 1 ? lastDurationUs : 0);
+            bufferChunk(chunkTimestampUs);
+        }
+    } else if (!hasMultipleTracks) {
         addOneStscTableEntry(1, mNumSamples);
     } else if (!mChunkSamples.empty()) {
         addOneStscTableEntry(++nChunks, mChunkSamples.size());
@@ -2238,13 +2762,16 @@ status_t MPEG4Writer::Track::threadEntry() {
         ++sampleCount;  // Count for the last sample
     }
 
-    if (mNumSamples <= 2) {
-        addOneSttsTableEntry(1, lastDurationTicks);
-        if (sampleCount - 1 > 0) {
-            addOneSttsTableEntry(sampleCount - 1, lastDurationTicks);
+    // The sample durations of fragmented files are in the fragments.
+    if (!mOwner->isFragmented()) {
+        if (mNumSamples <= 2) {
+            addOneSttsTableEntry(1, lastDurationTicks);
+            if (sampleCount - 1 > 0) {
+                addOneSttsTableEntry(sampleCount - 1, lastDurationTicks);
+            }
+        } else {
+            addOneSttsTableEntry(sampleCount, lastDurationTicks);
         }
-    } else {
-        addOneSttsTableEntry(sampleCount, lastDurationTicks);
     }
 
     // The last ctts box may not have been written yet, and this
@@ -2273,7 +2800,7 @@ status_t MPEG4Writer::Track::threadEntry() {
 }
 
 bool MPEG4Writer::Track::isTrackMalFormed() const {
-    if (mSampleSizes.empty()) {                      // no samples written
+    if (mNumSamples == 0) {                          // no samples written
         ALOGE("The number of recorded samples is 0");
         return true;
     }
@@ -2410,10 +2937,27 @@ int64_t MPEG4Writer::Track::getDurationUs() const {
     return mTrackDurationUs;
 }
 
+int64_t MPEG4Writer::Track::getHeaderDurationUs() const {
+    if (mOwner->isFragmented() && !mReachedEOS) {
+        return 0;
+    }
+    return mTrackDurationUs;
+}
+
 int64_t MPEG4Writer::Track::getEstimatedTrackSizeBytes() const {
     return mEstimatedTrackSizeBytes;
 }
 
+int64_t MPEG4Writer::Track::getEstimatedSampleTableSizeBytes() const {
+    return mEstimatedSampleTableSizeBytes;
+}
+
+void MPEG4Writer::Track::shiftChunkOffsets(off64_t shift) {
+    for (size_t i = 0; i < mChunkOffsets.count(); ++i) {
+        mChunkOffsets.editItemAt(i) += shift;
+    }
+}
+
 status_t MPEG4Writer::Track::checkCodecSpecificData() const {
     const char *mime;
     CHECK(mMeta->findCString(kKeyMIMEType, &mime));
@@ -2470,6 +3014,27 @@ void MPEG4Writer::Track::writeStblBox(bool use32BitOffset) {
         writeVideoFourCCBox();
     }
     mOwner->endBox();  // stsd
+    if (mOwner->isFragmented()) {
+        // All samples are in the fragments.
+        static const char *const kEmptyTables[] = { "stts", "stsc", "stsz" };
+        for (size_t i = 0; i < sizeof(kEmptyTables) / sizeof(kEmptyTables[0]);
+                ++i) {
+            mOwner->beginBox(kEmptyTables[i]);
+            mOwner->writeInt32(0);  // version=0, flags=0
+            if (i == 2) {
+                mOwner->writeInt32(0);  // sample size
+            }
+            mOwner->writeInt32(0);  // entry or sample count
+            mOwner->endBox();
+        }
+        mOwner->beginBox(use32BitOffset? "stco": "co64");
+        mOwner->writeInt32(0);  // version=0, flags=0
+        mOwner->writeInt32(0);  // entry count
+        mOwner->endBox();  // stco or co64
+        mOwner->endBox();  // stbl
+        return;
+    }
+    int64_t startTimeUs = systemTime() / 1000;
     writeSttsBox();
     writeCttsBox();
     if (!mIsAudio) {
@@ -2479,6 +3044,15 @@ void MPEG4Writer::Track::writeStblBox(bool use32BitOffset) {
     writeStscBox();
     writeStcoBox(use32BitOffset);
     mOwner->endBox();  // stbl
+    ALOGD("%s sample tables of %d samples, %d bytes in memory, written in %lld us",
+            mIsAudio? "Audio": "Video", mNumSamples, getSampleTableAllocatedBytes(),
+            systemTime() / 1000 - startTimeUs);
+}
+
+size_t MPEG4Writer::Track::getSampleTableAllocatedBytes() const {
+    return mSampleSizes.allocatedBytes() + mChunkOffsets.allocatedBytes() +
+            mStscTableEntries.allocatedBytes() + mStssTableEntries.allocatedBytes() +
+            mSttsTableEntries.allocatedBytes() + mCttsTableEntries.allocatedBytes();
 }
 
 void MPEG4Writer::Track::writeVideoFourCCBox() {
@@ -2662,7 +3236,7 @@ void MPEG4Writer::Track::writeTkhdBox(time_t now) {
     mOwner->writeInt32(now);           // modification time
     mOwner->writeInt32(mTrackId + 1);  // track id starts with 1
     mOwner->writeInt32(0);             // reserved
-    int64_t trakDurationUs = getDurationUs();
+    int64_t trakDurationUs = getHeaderDurationUs();
     int32_t mvhdTimeScale = mOwner->getTimeScale();
     int32_t tkhdDuration =
         (trakDurationUs * mvhdTimeScale + 5E5) / 1E6;
@@ -2723,7 +3297,7 @@ void MPEG4Writer::Track::writeHdlrBox() {
 }
 
 void MPEG4Writer::Track::writeMdhdBox(time_t now) {
-    int64_t trakDurationUs = getDurationUs();
+    int64_t trakDurationUs = getHeaderDurationUs();
     mOwner->beginBox("mdhd");
     mOwner->writeInt32(0);             // version=0, flags=0
     mOwner->writeInt32(now);           // creation time
@@ -2820,16 +3394,18 @@ void MPEG4Writer::Track::writeSttsBox() {
     mOwner->writeInt32(mNumSttsTableEntries);
 
     // Compensate for small start time difference from different media tracks
-    List<SttsTableEntry>::iterator it = mSttsTableEntries.begin();
-    CHECK(it != mSttsTableEntries.end() && it->sampleCount == 1);
-    mOwner->writeInt32(it->sampleCount);
-    mOwner->writeInt32(getStartTimeOffsetScaledTime() + it->sampleDuration);
+    CHECK(mSttsTableEntries.count() > 0
+            && mSttsTableEntries.itemAt(0).sampleCount == 1);
+    const SttsTableEntry &first = mSttsTableEntries.itemAt(0);
+    mOwner->writeInt32(first.sampleCount);
+    mOwner->writeInt32(getStartTimeOffsetScaledTime() + first.sampleDuration);
 
     int64_t totalCount = 1;
-    while (++it != mSttsTableEntries.end()) {
-        mOwner->writeInt32(it->sampleCount);
-        mOwner->writeInt32(it->sampleDuration);
-        totalCount += it->sampleCount;
+    for (size_t i = 1; i < mSttsTableEntries.count(); ++i) {
+        const SttsTableEntry &entry = mSttsTableEntries.itemAt(i);
+        mOwner->writeInt32(entry.sampleCount);
+        mOwner->writeInt32(entry.sampleDuration);
+        totalCount += entry.sampleCount;
     }
     CHECK_EQ(totalCount, mNumSamples);
     mOwner->endBox();  // stts
@@ -2847,7 +3423,7 @@ void MPEG4Writer::Track::writeCttsBox() {
 
     // Do not write ctts box when there is no need to have it.
     if ((mNumCttsTableEntries == 1 &&
-        mCttsTableEntries.begin()->sampleDuration == 0) ||
+        mCttsTableEntries.itemAt(0).sampleDuration == 0) ||
         mNumCttsTableEntries == 0) {
         return;
     }
@@ -2862,17 +3438,19 @@ void MPEG4Writer::Track::writeCttsBox() {
     mOwner->writeInt32(mNumCttsTableEntries);
 
     // Compensate for small start time difference from different media tracks
-    List<CttsTableEntry>::iterator it = mCttsTableEntries.begin();
-    CHECK(it != mCttsTableEntries.end() && it->sampleCount == 1);
-    mOwner->writeInt32(it->sampleCount);
+    CHECK(mCttsTableEntries.count() > 0
+            && mCttsTableEntries.itemAt(0).sampleCount == 1);
+    const CttsTableEntry &first = mCttsTableEntries.itemAt(0);
+    mOwner->writeInt32(first.sampleCount);
     mOwner->writeInt32(getStartTimeOffsetScaledTime() +
-            it->sampleDuration - mMinCttsOffsetTimeUs);
+            first.sampleDuration - mMinCttsOffsetTimeUs);
 
     int64_t totalCount = 1;
-    while (++it != mCttsTableEntries.end()) {
-        mOwner->writeInt32(it->sampleCount);
-        mOwner->writeInt32(it->sampleDuration - mMinCttsOffsetTimeUs);
-        totalCount += it->sampleCount;
+    for (size_t i = 1; i < mCttsTableEntries.count(); ++i) {
+        const CttsTableEntry &entry = mCttsTableEntries.itemAt(i);
+        mOwner->writeInt32(entry.sampleCount);
+        mOwner->writeInt32(entry.sampleDuration - mMinCttsOffsetTimeUs);
+        totalCount += entry.sampleCount;
     }
     CHECK_EQ(totalCount, mNumSamples);
     mOwner->endBox();  // ctts
@@ -2882,9 +3460,8 @@ void MPEG4Writer::Track::writeStssBox() {
     mOwner->beginBox("stss");
     mOwner->writeInt32(0);  // version=0, flags=0
     mOwner->writeInt32(mNumStssTableEntries);  // number of sync frames
-    for (List<int32_t>::iterator it = mStssTableEntries.begin();
-        it != mStssTableEntries.end(); ++it) {
-        mOwner->writeInt32(*it);
+    for (size_t i = 0; i < mStssTableEntries.count(); ++i) {
+        mOwner->writeInt32(mStssTableEntries.itemAt(i));
     }
     mOwner->endBox();  // stss
 }
@@ -2894,23 +3471,17 @@ void MPEG4Writer::Track::writeStszBox() {
     mOwner->beginBox("stsz");
     mOwner->writeInt32(0);  // version=0, flags=0
     if (mSamplesHaveSameSize) {
-        CHECK(mCurrentSampleSizeArr != 0);
-        mOwner->write(mCurrentSampleSizeArr, 4, 1);  // default sample size
+        CHECK_GT(mSampleSizes.count(), 0u);
+        mOwner->write(&mSampleSizes.itemAt(0), 4, 1);  // default sample size
     } else {
         mOwner->writeInt32(0);
     }
     mOwner->writeInt32(mNumSamples);
-    uint32_t nSamples = mNumSamples;
     if (!mSamplesHaveSameSize) {
-        for (List<uint32_t *>::iterator it = mSampleSizes.begin();
-            it != mSampleSizes.end(); ++it) {
-            if (nSamples >= kSampleArraySize) {
-                mOwner->write(*it, 4, kSampleArraySize);
-                nSamples -= kSampleArraySize;
-            } else {
-                mOwner->write(*it, 4, nSamples);
-                break;
-            }
+        CHECK_EQ(mSampleSizes.count(), mNumSamples);
+        for (size_t i = 0; i < mSampleSizes.numArrays(); ++i) {
+            mOwner->write(mSampleSizes.arrayAt(i), 4,
+                    mSampleSizes.numEntriesInArray(i));
         }
     }
     mOwner->endBox();  // stsz
@@ -2921,11 +3492,11 @@ void MPEG4Writer::Track::writeStscBox() {
     mOwner->beginBox("stsc");
     mOwner->writeInt32(0);  // version=0, flags=0
     mOwner->writeInt32(mNumStscTableEntries);
-    for (List<StscTableEntry>::iterator it = mStscTableEntries.begin();
-        it != mStscTableEntries.end(); ++it) {
-        mOwner->writeInt32(it->firstChunk);
-        mOwner->writeInt32(it->samplesPerChunk);
-        mOwner->writeInt32(it->sampleDescriptionId);
+    for (size_t i = 0; i < mStscTableEntries.count(); ++i) {
+        const StscTableEntry &entry = mStscTableEntries.itemAt(i);
+        mOwner->writeInt32(entry.firstChunk);
+        mOwner->writeInt32(entry.samplesPerChunk);
+        mOwner->writeInt32(entry.sampleDescriptionId);
     }
     mOwner->endBox();  // stsc
 }
@@ -2934,17 +3505,197 @@ void MPEG4Writer::Track::writeStcoBox(bool use32BitOffset) {
     mOwner->beginBox(use32BitOffset? "stco": "co64");
     mOwner->writeInt32(0);  // version=0, flags=0
     mOwner->writeInt32(mNumStcoTableEntries);
-    for (List<off64_t>::iterator it = mChunkOffsets.begin();
-        it != mChunkOffsets.end(); ++it) {
+    for (size_t i = 0; i < mChunkOffsets.count(); ++i) {
         if (use32BitOffset) {
-            mOwner->writeInt32(static_cast<int32_t>(*it));
+            mOwner->writeInt32(static_cast<int32_t>(mChunkOffsets.itemAt(i)));
         } else {
-            mOwner->writeInt64((*it));
+            mOwner->writeInt64(mChunkOffsets.itemAt(i));
         }
     }
     mOwner->endBox();  // stco or co64
 }
 
+void MPEG4Writer::Track::setFragmentStartTimeOffset(int64_t moovStartTimeUs) {
+    CHECK_GE(mStartTimestampUs, moovStartTimeUs);
+    mFragmentStartTimeOffsetTicks =
+        ((mStartTimestampUs - moovStartTimeUs) * mTimeScale + 500000LL)
+            / 1000000LL;
+}
+
+/*
+ * Writes the samples of a track fragment in a 'moof' box holding a single
+ * track fragment run, followed by their 'mdat' box. The samples carry
+ * their decoding and composition times, and the last one its duration.
+ */
+void MPEG4Writer::Track::writeFragment(
+        List<MediaBuffer *> *samples, uint32_t sequenceNumber) {
+    CHECK(!samples->empty());
+
+    const size_t nalLengthSize =
+        !mIsAvc ? 0 : (mOwner->useNalLengthFour() ? 4 : 2);
+
+    uint64_t mediaDataSize = 0;
+    for (List<MediaBuffer *>::iterator it = samples->begin();
+         it != samples->end(); ++it) {
+        mediaDataSize += (*it)->range_length() + nalLengthSize;
+    }
+    const bool useLargeMdat = (mediaDataSize + 8 > 0xffffffffLL);
+    const uint32_t mdatHeaderSize = useLargeMdat ? 16 : 8;
+
+    // sample-duration, -size, -flags and for video composition time
+    // offsets present, the data offset is relative to the 'moof' box.
+    const uint32_t trunFlags = 0x001 | 0x100 | 0x200 | 0x400
+        | (mIsAudio ? 0 : 0x800);
+    const uint32_t entrySize = mIsAudio ? 12 : 16;
+    const uint32_t trunSize = 20 + samples->size() * entrySize;
+    const uint32_t trafSize = 8 + 16 + 20 + trunSize;  // tfhd, tfdt, trun
+    const uint32_t moofSize = 8 + 16 + trafSize;       // mfhd, traf
+
+    int64_t firstDecodingTimeUs;
+    CHECK((*samples->begin())->meta_data()->findInt64(
+                kKeyDecodingTime, &firstDecodingTimeUs));
+    uint64_t baseDecodingTime =
+        (firstDecodingTimeUs * mTimeScale + 500000LL) / 1000000LL
+            + mFragmentStartTimeOffsetTicks;
+
+    int32_t isSync = false;
+    if (mIsAudio ||
+        ((*samples->begin())->meta_data()->findInt32(kKeyIsSyncFrame, &isSync)
+            && isSync)) {
+        mFragmentIndexEntries.push_back(
+                FragmentIndexEntry(baseDecodingTime, mOwner->mOffset));
+    }
+
+    mOwner->writeInt32(moofSize);
+    mOwner->writeFourcc("moof");
+
+    mOwner->writeInt32(16);
+    mOwner->writeFourcc("mfhd");
+    mOwner->writeInt32(0);               // version=0, flags=0
+    mOwner->writeInt32(sequenceNumber);
+
+    mOwner->writeInt32(trafSize);
+    mOwner->writeFourcc("traf");
+
+    mOwner->writeInt32(16);
+    mOwner->writeFourcc("tfhd");
+    mOwner->writeInt32(0x020000);        // version=0, default-base-is-moof
+    mOwner->writeInt32(mTrackId + 1);
+
+    mOwner->writeInt32(20);
+    mOwner->writeFourcc("tfdt");
+    mOwner->writeInt32(0x01000000);      // version=1, flags=0
+    mOwner->writeInt64(baseDecodingTime);
+
+    mOwner->writeInt32(trunSize);
+    mOwner->writeFourcc("trun");
+    mOwner->writeInt32(trunFlags);       // version=0
+    mOwner->writeInt32(samples->size());
+    mOwner->writeInt32(moofSize + mdatHeaderSize);  // data offset
+
+    for (List<MediaBuffer *>::iterator it = samples->begin();
+         it != samples->end(); ++it) {
+        sp<MetaData> meta = (*it)->meta_data();
+
+        int64_t decodingTimeUs, nextDecodingTimeUs;
+        CHECK(meta->findInt64(kKeyDecodingTime, &decodingTimeUs));
+
+        List<MediaBuffer *>::iterator next = it;
+        if (++next != samples->end()) {
+            CHECK((*next)->meta_data()->findInt64(
+                        kKeyDecodingTime, &nextDecodingTimeUs));
+        } else {
+            int64_t durationUs;
+            CHECK(meta->findInt64(kKeyDuration, &durationUs));
+            nextDecodingTimeUs = decodingTimeUs + durationUs;
+        }
+
+        // Rounding the times rather than the durations does not
+        // accumulate errors.
+        int64_t decodingTicks =
+            (decodingTimeUs * mTimeScale + 500000LL) / 1000000LL;
+        mOwner->writeInt32(
+                (nextDecodingTimeUs * mTimeScale + 500000LL) / 1000000LL
+                    - decodingTicks);
+        mOwner->writeInt32((*it)->range_length() + nalLengthSize);
+
+        isSync = false;
+        meta->findInt32(kKeyIsSyncFrame, &isSync);
+        if (mIsAudio || isSync) {
+            mOwner->writeInt32(0x02000000);  // depends on no other sample
+        } else {
+            mOwner->writeInt32(0x01010000);  // depends on others, non-sync
+        }
+
+        if (!mIsAudio) {
+            int64_t compositionTimeUs;
+            CHECK(meta->findInt64(kKeyTime, &compositionTimeUs));
+            int64_t offsetTicks =
+                (compositionTimeUs * mTimeScale + 500000LL) / 1000000LL
+                    - decodingTicks;
+            if (offsetTicks < 0) {
+                // Version 0 offsets are unsigned.
+                ALOGW("Sample presented before it is decoded: %lld ticks",
+                     offsetTicks);
+                offsetTicks = 0;
+            }
+            mOwner->writeInt32(offsetTicks);
+        }
+    }
+
+    if (useLargeMdat) {
+        mOwner->writeInt32(1);
+        mOwner->writeFourcc("mdat");
+        mOwner->writeInt64(mediaDataSize + 16);
+    } else {
+        mOwner->writeInt32(mediaDataSize + 8);
+        mOwner->writeFourcc("mdat");
+    }
+
+    while (!samples->empty()) {
+        List<MediaBuffer *>::iterator it = samples->begin();
+
+        if (mIsAvc) {
+            mOwner->addLengthPrefixedSample_l(*it);
+        } else {
+            mOwner->addSample_l(*it);
+        }
+
+        (*it)->release();
+        (*it) = NULL;
+        samples->erase(it);
+    }
+}
+
+void MPEG4Writer::Track::writeTrexBox() {
+    mOwner->beginBox("trex");
+    mOwner->writeInt32(0);             // version=0, flags=0
+    mOwner->writeInt32(mTrackId + 1);  // track id starts with 1
+    mOwner->writeInt32(1);             // default sample description index
+    mOwner->writeInt32(0);             // default sample duration
+    mOwner->writeInt32(0);             // default sample size
+    mOwner->writeInt32(0);             // default sample flags
+    mOwner->endBox();  // trex
+}
+
+void MPEG4Writer::Track::writeTfraBox() {
+    mOwner->beginBox("tfra");
+    mOwner->writeInt32(0x01000000);    // version=1, flags=0
+    mOwner->writeInt32(mTrackId + 1);
+    mOwner->writeInt32(0);             // 1-byte traf, trun and sample numbers
+    mOwner->writeInt32(mFragmentIndexEntries.size());
+    for (List<FragmentIndexEntry>::iterator it =
+            mFragmentIndexEntries.begin();
+         it != mFragmentIndexEntries.end(); ++it) {
+        mOwner->writeInt64(it->mTime);
+        mOwner->writeInt64(it->mMoofOffset);
+        mOwner->writeInt8(1);          // traf number
+        mOwner->writeInt8(1);          // trun number
+        mOwner->writeInt8(1);          // sample number
+    }
+    mOwner->endBox();  // tfra
+}
+
 void MPEG4Writer::writeUdtaBox() {
     beginBox("udta");
     writeGeoDataBox();
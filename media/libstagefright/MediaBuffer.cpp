@@ -85,6 +85,26 @@ MediaBuffer::MediaBuffer(const sp<ABuffer> &buffer)
       mOriginal(NULL) {
 }
 
+// Observes the buffers created by CreateView(), which have no group to
+// return to.
+struct ViewBufferObserver : public MediaBufferObserver {
+    virtual void signalBufferReturned(MediaBuffer *buffer) {
+        buffer->setObserver(NULL);
+        buffer->release();
+    }
+};
+
+static ViewBufferObserver gViewBufferObserver;
+
+// static
+MediaBuffer *MediaBuffer::CreateView(const sp<ABuffer> &buffer) {
+    MediaBuffer *view = new MediaBuffer(buffer);
+    view->setObserver(&gViewBufferObserver);
+    view->add_ref();
+
+    return view;
+}
+
 void MediaBuffer::release() {
     if (mObserver == NULL) {
         CHECK_EQ(mRefCount, 0);
@@ -17,6 +17,8 @@
 #define LOG_TAG "MediaBufferGroup"
 #include <utils/Log.h>
 
+#include <string.h>
+
 #include <media/stagefright/foundation/ADebug.h>
 #include <media/stagefright/MediaBuffer.h>
 #include <media/stagefright/MediaBufferGroup.h>
@@ -25,10 +27,17 @@ namespace android {
 
 MediaBufferGroup::MediaBufferGroup()
     : mFirstBuffer(NULL),
-      mLastBuffer(NULL) {
+      mLastBuffer(NULL),
+      mNumWaiters(0),
+      mMaxNumBuffers(0) {
+    memset(&mStats, 0, sizeof(mStats));
 }
 
 MediaBufferGroup::~MediaBufferGroup() {
+    ALOGV("%u buffers, %u acquisitions, %u waits totalling %lld us (max %lld us)",
+         mStats.mNumBuffers, mStats.mNumAcquires, mStats.mNumWaits,
+         mStats.mWaitTimeUs, mStats.mMaxWaitTimeUs);
+
     MediaBuffer *next;
     for (MediaBuffer *buffer = mFirstBuffer; buffer != NULL;
          buffer = next) {
@@ -44,6 +53,10 @@ MediaBufferGroup::~MediaBufferGroup() {
 void MediaBufferGroup::add_buffer(MediaBuffer *buffer) {
     Mutex::Autolock autoLock(mLock);
 
+    add_buffer_l(buffer);
+}
+
+void MediaBufferGroup::add_buffer_l(MediaBuffer *buffer) {
     buffer->setObserver(this);
 
     if (mLastBuffer) {
@@ -53,34 +66,80 @@ void MediaBufferGroup::add_buffer(MediaBuffer *buffer) {
     }
 
     mLastBuffer = buffer;
+
+    ++mStats.mNumBuffers;
+
+    if (buffer->refcount() == 0) {
+        mFreeBuffers.push(buffer);
+
+        if (mNumWaiters > 0) {
+            mCondition.signal();
+        }
+    }
+}
+
+void MediaBufferGroup::setMaxNumBuffers(size_t maxNumBuffers) {
+    Mutex::Autolock autoLock(mLock);
+
+    mMaxNumBuffers = maxNumBuffers;
 }
 
 status_t MediaBufferGroup::acquire_buffer(MediaBuffer **out) {
     Mutex::Autolock autoLock(mLock);
 
-    for (;;) {
-        for (MediaBuffer *buffer = mFirstBuffer;
-             buffer != NULL; buffer = buffer->nextBuffer()) {
-            if (buffer->refcount() == 0) {
-                buffer->add_ref();
-                buffer->reset();
+    ++mStats.mNumAcquires;
 
-                *out = buffer;
-                goto exit;
-            }
-        }
+    if (mFreeBuffers.isEmpty()
+            && mFirstBuffer != NULL && mFirstBuffer->mOwnsData
+            && mStats.mNumBuffers < mMaxNumBuffers) {
+        ALOGV("growing to %u buffers", mStats.mNumBuffers + 1);
+        add_buffer_l(new MediaBuffer(mFirstBuffer->size()));
+    }
 
+    if (mFreeBuffers.isEmpty()) {
         // All buffers are in use. Block until one of them is returned to us.
-        mCondition.wait(mLock);
+        ++mStats.mNumWaits;
+        nsecs_t startTime = systemTime();
+
+        ++mNumWaiters;
+        do {
+            mCondition.wait(mLock);
+        } while (mFreeBuffers.isEmpty());
+        --mNumWaiters;
+
+        int64_t waitTimeUs = (systemTime() - startTime) / 1000;
+        mStats.mWaitTimeUs += waitTimeUs;
+        if (waitTimeUs > mStats.mMaxWaitTimeUs) {
+            mStats.mMaxWaitTimeUs = waitTimeUs;
+        }
     }
 
-exit:
+    MediaBuffer *buffer = mFreeBuffers.top();
+    mFreeBuffers.pop();
+
+    CHECK_EQ(buffer->refcount(), 0);
+    buffer->add_ref();
+    buffer->reset();
+
+    *out = buffer;
+
     return OK;
 }
 
-void MediaBufferGroup::signalBufferReturned(MediaBuffer *) {
+void MediaBufferGroup::getStats(Stats *stats) {
     Mutex::Autolock autoLock(mLock);
-    mCondition.signal();
+
+    *stats = mStats;
+}
+
+void MediaBufferGroup::signalBufferReturned(MediaBuffer *buffer) {
+    Mutex::Autolock autoLock(mLock);
+
+    mFreeBuffers.push(buffer);
+
+    if (mNumWaiters > 0) {
+        mCondition.signal();
+    }
 }
 
 }  // namespace android
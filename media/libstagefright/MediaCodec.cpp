@@ -22,10 +22,13 @@
 
 #include "include/SoftwareRenderer.h"
 
+#include <binder/IMemory.h>
+#include <binder/MemoryDealer.h>
 #include <gui/SurfaceTextureClient.h>
 #include <media/ICrypto.h>
 #include <media/stagefright/foundation/ABuffer.h>
 #include <media/stagefright/foundation/ADebug.h>
+#include <media/stagefright/foundation/ALooper.h>
 #include <media/stagefright/foundation/AMessage.h>
 #include <media/stagefright/foundation/AString.h>
 #include <media/stagefright/foundation/hexdump.h>
@@ -68,6 +71,9 @@ MediaCodec::MediaCodec(const sp<ALooper> &looper)
       mDequeueInputReplyID(0),
       mDequeueOutputTimeoutGeneration(0),
       mDequeueOutputReplyID(0) {
+    // Until the looper has published anything, let the requests through.
+    mDequeueReady[kPortIndexInput] = true;
+    mDequeueReady[kPortIndexOutput] = true;
 }
 
 MediaCodec::~MediaCodec() {
@@ -232,13 +238,33 @@ status_t MediaCodec::queueSecureInputBuffer(
 }
 
 status_t MediaCodec::dequeueInputBuffer(size_t *index, int64_t timeoutUs) {
-    sp<AMessage> msg = new AMessage(kWhatDequeueInputBuffer, id());
-    msg->setInt64("timeoutUs", timeoutUs);
+    int64_t deadlineUs = ALooper::GetNowUs() + timeoutUs;
 
     sp<AMessage> response;
-    status_t err;
-    if ((err = PostAndAwaitResponse(msg, &response)) != OK) {
-        return err;
+    for (;;) {
+        // Wait here rather than parking the request in the looper, which
+        // then only sees the requests that can be served.
+        if (!waitForDequeueReady(kPortIndexInput, timeoutUs)) {
+            return -EAGAIN;
+        }
+
+        sp<AMessage> msg = new AMessage(kWhatDequeueInputBuffer, id());
+        msg->setInt64("timeoutUs", timeoutUs < 0ll ? timeoutUs : 0ll);
+
+        status_t err = PostAndAwaitResponse(msg, &response);
+
+        if (err == -EAGAIN && timeoutUs > 0ll) {
+            // Another thread got the buffer first.
+            timeoutUs = deadlineUs - ALooper::GetNowUs();
+            if (timeoutUs > 0ll) {
+                continue;
+            }
+        }
+
+        if (err != OK) {
+            return err;
+        }
+        break;
     }
 
     CHECK(response->findSize("index", index));
@@ -253,13 +279,31 @@ status_t MediaCodec::dequeueOutputBuffer(
         int64_t *presentationTimeUs,
         uint32_t *flags,
         int64_t timeoutUs) {
-    sp<AMessage> msg = new AMessage(kWhatDequeueOutputBuffer, id());
-    msg->setInt64("timeoutUs", timeoutUs);
+    int64_t deadlineUs = ALooper::GetNowUs() + timeoutUs;
 
     sp<AMessage> response;
-    status_t err;
-    if ((err = PostAndAwaitResponse(msg, &response)) != OK) {
-        return err;
+    for (;;) {
+        // See dequeueInputBuffer.
+        if (!waitForDequeueReady(kPortIndexOutput, timeoutUs)) {
+            return -EAGAIN;
+        }
+
+        sp<AMessage> msg = new AMessage(kWhatDequeueOutputBuffer, id());
+        msg->setInt64("timeoutUs", timeoutUs < 0ll ? timeoutUs : 0ll);
+
+        status_t err = PostAndAwaitResponse(msg, &response);
+
+        if (err == -EAGAIN && timeoutUs > 0ll) {
+            timeoutUs = deadlineUs - ALooper::GetNowUs();
+            if (timeoutUs > 0ll) {
+                continue;
+            }
+        }
+
+        if (err != OK) {
+            return err;
+        }
+        break;
     }
 
     CHECK(response->findSize("index", index));
@@ -327,6 +371,71 @@ status_t MediaCodec::flush() {
     return PostAndAwaitResponse(msg, &response);
 }
 
+void MediaCodec::setDequeueNotify(const sp<AMessage> &notify) {
+    Mutex::Autolock autoLock(mDequeueLock);
+    mDequeueNotify = notify;
+}
+
+// Returns false if a dequeue on the port is known to return -EAGAIN for the
+// whole timeout. A negative timeout waits in the looper as before.
+bool MediaCodec::waitForDequeueReady(int32_t portIndex, int64_t timeoutUs) {
+    if (timeoutUs < 0ll) {
+        return true;
+    }
+
+    Mutex::Autolock autoLock(mDequeueLock);
+
+    int64_t deadlineUs = ALooper::GetNowUs() + timeoutUs;
+    while (!mDequeueReady[portIndex]) {
+        int64_t remainingUs = deadlineUs - ALooper::GetNowUs();
+        if (remainingUs <= 0ll) {
+            return false;
+        }
+
+        mDequeueCondition.waitRelative(mDequeueLock, remainingUs * 1000ll);
+    }
+
+    return true;
+}
+
+// Called on the looper after each message, which is where the state below
+// changes.
+void MediaCodec::updateDequeueReady() {
+    bool failed = mState != STARTED || (mFlags & kFlagStickyError);
+
+    bool ready[2];
+    ready[kPortIndexInput] = failed
+        || (mFlags & kFlagDequeueInputPending)
+        || !mAvailPortBuffers[kPortIndexInput].empty();
+    ready[kPortIndexOutput] = failed
+        || (mFlags & (kFlagDequeueOutputPending
+                        | kFlagOutputBuffersChanged
+                        | kFlagOutputFormatChanged))
+        || !mAvailPortBuffers[kPortIndexOutput].empty();
+
+    Mutex::Autolock autoLock(mDequeueLock);
+
+    bool changed = false;
+    for (int32_t portIndex = 0; portIndex < 2; ++portIndex) {
+        if (ready[portIndex] == mDequeueReady[portIndex]) {
+            continue;
+        }
+
+        mDequeueReady[portIndex] = ready[portIndex];
+        changed = true;
+
+        if (ready[portIndex] && mDequeueNotify != NULL) {
+            sp<AMessage> notify = mDequeueNotify->dup();
+            notify->setInt32("output", portIndex == kPortIndexOutput);
+            notify->post();
+        }
+    }
+
+    if (changed) {
+        mDequeueCondition.broadcast();
+    }
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 
 void MediaCodec::cancelPendingDequeueOperations() {
@@ -571,15 +680,34 @@ void MediaCodec::onMessageReceived(const sp<AMessage> &msg) {
 
                     size_t numBuffers = portDesc->countBuffers();
 
+                    if (portIndex == kPortIndexInput && mCrypto != NULL) {
+                        size_t totalSize = 0;
+                        for (size_t i = 0; i < numBuffers; ++i) {
+                            totalSize += portDesc->bufferAt(i)->capacity();
+                        }
+                        mCryptoDealer =
+                            new MemoryDealer(totalSize, "MediaCodec");
+                    }
+
                     for (size_t i = 0; i < numBuffers; ++i) {
                         BufferInfo info;
                         info.mBufferID = portDesc->bufferIDAt(i);
                         info.mOwnedByClient = false;
                         info.mData = portDesc->bufferAt(i);
+                        info.mMem = portDesc->memoryAt(i);
 
                         if (portIndex == kPortIndexInput && mCrypto != NULL) {
-                            info.mEncryptedData =
-                                new ABuffer(info.mData->capacity());
+                            size_t capacity = info.mData->capacity();
+                            info.mEncryptedMem =
+                                mCryptoDealer->allocate(capacity);
+
+                            if (info.mEncryptedMem != NULL) {
+                                info.mEncryptedData = new ABuffer(
+                                        info.mEncryptedMem->pointer(),
+                                        capacity);
+                            } else {
+                                info.mEncryptedData = new ABuffer(capacity);
+                            }
                         }
 
                         buffers->push_back(info);
@@ -1135,6 +1263,8 @@ void MediaCodec::onMessageReceived(const sp<AMessage> &msg) {
         default:
             TRESPASS();
     }
+
+    updateDequeueReady();
 }
 
 void MediaCodec::extractCSD(const sp<AMessage> &format) {
@@ -1191,6 +1321,7 @@ void MediaCodec::setState(State newState) {
         mSoftRenderer = NULL;
 
         mCrypto.clear();
+        mCryptoDealer.clear();
         setNativeWindow(NULL);
 
         mOutputFormat.clear();
@@ -1346,16 +1477,50 @@ status_t MediaCodec::onQueueInputBuffer(const sp<AMessage> &msg) {
         AString *errorDetailMsg;
         CHECK(msg->findPointer("errorDetailMsg", (void **)&errorDetailMsg));
 
-        status_t err = mCrypto->decrypt(
-                (mFlags & kFlagIsSecure) != 0,
-                key,
-                iv,
-                mode,
-                info->mEncryptedData->base() + offset,
-                subSamples,
-                numSubSamples,
-                info->mData->base(),
-                errorDetailMsg);
+        bool secure = (mFlags & kFlagIsSecure) != 0;
+
+        status_t err;
+        if (info->mEncryptedMem != NULL && (secure || info->mMem != NULL)) {
+            // Both buffers are visible to the crypto service, decrypt
+            // straight from one into the other.
+            ICrypto::DecryptUnit unit;
+            memset(&unit, 0, sizeof(unit));
+
+            if (key != NULL) {
+                memcpy(unit.mKey, key, sizeof(unit.mKey));
+            }
+
+            if (iv != NULL) {
+                memcpy(unit.mIV, iv, sizeof(unit.mIV));
+            }
+
+            unit.mMode = mode;
+            unit.mSrcOffset = offset;
+            unit.mDstOffset = 0;
+            unit.mDstPtr = secure ? info->mData->base() : NULL;
+            unit.mSubSamples = subSamples;
+            unit.mNumSubSamples = numSubSamples;
+
+            size_t numDecrypted;
+            err = mCrypto->decryptBatch(
+                    secure,
+                    info->mEncryptedMem,
+                    info->mMem,
+                    &unit, 1,
+                    &numDecrypted,
+                    errorDetailMsg);
+        } else {
+            err = mCrypto->decrypt(
+                    secure,
+                    key,
+                    iv,
+                    mode,
+                    info->mEncryptedData->base() + offset,
+                    subSamples,
+                    numSubSamples,
+                    info->mData->base(),
+                    errorDetailMsg);
+        }
 
         if (err != OK) {
             return err;
@@ -21,6 +21,7 @@
 #include <media/stagefright/MediaCodecList.h>
 
 #include <media/stagefright/foundation/ADebug.h>
+#include <media/stagefright/foundation/AConfigCache.h>
 #include <media/stagefright/MediaErrors.h>
 #include <media/stagefright/OMXClient.h>
 #include <media/stagefright/OMXCodec.h>
@@ -32,6 +33,13 @@ namespace android {
 
 static Mutex sInitMutex;
 
+static const char kConfigPath[] = "/etc/media_codecs.xml";
+
+// What parseXMLFile made of kConfigPath, readable by every process but only
+// writable by mediaserver, which usually gets to it first after boot.
+static const char kCachePath[] = "/data/misc/media/media_codecs.cache";
+static const uint32_t kCacheMagic = 'MCL1';
+
 // static
 MediaCodecList *MediaCodecList::sCodecList;
 
@@ -48,14 +56,23 @@ const MediaCodecList *MediaCodecList::getInstance() {
 
 MediaCodecList::MediaCodecList()
     : mInitCheck(NO_INIT) {
-    FILE *file = fopen("/etc/media_codecs.xml", "r");
+    if (readCache(kCachePath, kConfigPath) != OK) {
+        FILE *file = fopen(kConfigPath, "r");
 
-    if (file == NULL) {
-        ALOGW("unable to open media codecs configuration xml file.");
-        return;
-    }
+        if (file == NULL) {
+            ALOGW("unable to open media codecs configuration xml file.");
+            return;
+        }
 
-    parseXMLFile(file);
+        parseXMLFile(file);
+
+        fclose(file);
+        file = NULL;
+
+        if (mInitCheck == OK) {
+            writeCache(kCachePath, kConfigPath);
+        }
+    }
 
     if (mInitCheck == OK) {
         // These are currently still used by the video editing suite.
@@ -84,9 +101,6 @@ MediaCodecList::MediaCodecList()
         ALOGI("%s", line.c_str());
     }
 #endif
-
-    fclose(file);
-    file = NULL;
 }
 
 MediaCodecList::~MediaCodecList() {
@@ -158,6 +172,76 @@ void MediaCodecList::parseXMLFile(FILE *file) {
     }
 }
 
+status_t MediaCodecList::readCache(const char *cachePath, const char *xmlPath) {
+    AConfigCacheReader reader;
+    status_t err = reader.open(cachePath, xmlPath, kCacheMagic);
+    if (err != OK) {
+        return err;
+    }
+
+    size_t numTypes = reader.readCount(2);
+    for (size_t i = 0; i < numTypes; ++i) {
+        AString name = reader.readString();
+        mTypes.add(name, reader.readInt32());
+    }
+
+    size_t numQuirks = reader.readCount(2);
+    for (size_t i = 0; i < numQuirks; ++i) {
+        AString name = reader.readString();
+        mCodecQuirks.add(name, reader.readInt32());
+    }
+
+    size_t numCodecs = reader.readCount(4);
+    for (size_t i = 0; i < numCodecs; ++i) {
+        mCodecInfos.push();
+        CodecInfo *info = &mCodecInfos.editItemAt(i);
+        info->mName = reader.readString();
+        info->mIsEncoder = reader.readInt32() != 0;
+        info->mTypes = reader.readInt32();
+        info->mQuirks = reader.readInt32();
+    }
+
+    if (reader.status() != OK) {
+        ALOGW("ignoring truncated %s", cachePath);
+
+        mCodecInfos.clear();
+        mCodecQuirks.clear();
+        mTypes.clear();
+        return reader.status();
+    }
+
+    mInitCheck = OK;
+
+    return OK;
+}
+
+void MediaCodecList::writeCache(const char *cachePath, const char *xmlPath) const {
+    AConfigCacheWriter writer(kCacheMagic);
+
+    writer.writeInt32(mTypes.size());
+    for (size_t i = 0; i < mTypes.size(); ++i) {
+        writer.writeString(mTypes.keyAt(i).c_str());
+        writer.writeInt32(mTypes.valueAt(i));
+    }
+
+    writer.writeInt32(mCodecQuirks.size());
+    for (size_t i = 0; i < mCodecQuirks.size(); ++i) {
+        writer.writeString(mCodecQuirks.keyAt(i).c_str());
+        writer.writeInt32(mCodecQuirks.valueAt(i));
+    }
+
+    writer.writeInt32(mCodecInfos.size());
+    for (size_t i = 0; i < mCodecInfos.size(); ++i) {
+        const CodecInfo &info = mCodecInfos.itemAt(i);
+        writer.writeString(info.mName.c_str());
+        writer.writeInt32(info.mIsEncoder);
+        writer.writeInt32(info.mTypes);
+        writer.writeInt32(info.mQuirks);
+    }
+
+    writer.commit(cachePath, xmlPath);
+}
+
 // static
 void MediaCodecList::StartElementHandlerWrapper(
         void *me, const char *name, const char **attrs) {
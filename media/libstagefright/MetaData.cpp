@@ -26,34 +26,106 @@
 
 namespace android {
 
-MetaData::MetaData() {
+MetaData::MetaData()
+    : mItems(mInlineItems),
+      mNumItems(0),
+      mCapacity(kNumInlineItems) {
 }
 
 MetaData::MetaData(const MetaData &from)
     : RefBase(),
-      mItems(from.mItems) {
+      mItems(mInlineItems),
+      mNumItems(0),
+      mCapacity(kNumInlineItems) {
+    reserve(from.mNumItems);
+
+    for (size_t i = 0; i < from.mNumItems; ++i) {
+        mItems[i].mKey = from.mItems[i].mKey;
+        mItems[i].mData = from.mItems[i].mData;
+    }
+    mNumItems = from.mNumItems;
 }
 
 MetaData::~MetaData() {
     clear();
+
+    if (mItems != mInlineItems) {
+        delete[] mItems;
+        mItems = NULL;
+    }
 }
 
 void MetaData::clear() {
-    mItems.clear();
+    for (size_t i = 0; i < mNumItems; ++i) {
+        mItems[i].mData.clear();
+    }
+    mNumItems = 0;
 }
 
 bool MetaData::remove(uint32_t key) {
-    ssize_t i = mItems.indexOfKey(key);
+    ssize_t i = indexOfKey(key, NULL);
 
     if (i < 0) {
         return false;
     }
 
-    mItems.removeItemsAt(i);
+    mItems[i].mData.clear();
+
+    // Move the now empty item to the end.
+    for (size_t j = i; j + 1 < mNumItems; ++j) {
+        mItems[j].mKey = mItems[j + 1].mKey;
+        mItems[j].mData.swap(mItems[j + 1].mData);
+    }
+    --mNumItems;
 
     return true;
 }
 
+ssize_t MetaData::indexOfKey(uint32_t key, size_t *position) const {
+    size_t lo = 0;
+    size_t hi = mNumItems;
+    while (lo < hi) {
+        size_t mid = (lo + hi) / 2;
+        if (mItems[mid].mKey == key) {
+            return mid;
+        } else if (mItems[mid].mKey < key) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    if (position != NULL) {
+        *position = lo;
+    }
+
+    return -1;
+}
+
+void MetaData::reserve(size_t numItems) {
+    if (numItems <= mCapacity) {
+        return;
+    }
+
+    size_t capacity = mCapacity * 2;
+    if (capacity < numItems) {
+        capacity = numItems;
+    }
+
+    item *items = new item[capacity];
+    for (size_t i = 0; i < mNumItems; ++i) {
+        items[i].mKey = mItems[i].mKey;
+        items[i].mData.swap(mItems[i].mData);
+    }
+
+    if (mItems != mInlineItems) {
+        delete[] mItems;
+    }
+
+    mItems = items;
+    mCapacity = capacity;
+}
+
 bool MetaData::setCString(uint32_t key, const char *value) {
     return setData(key, TYPE_C_STRING, value, strlen(value) + 1);
 }
@@ -186,32 +258,37 @@ bool MetaData::setData(
         uint32_t key, uint32_t type, const void *data, size_t size) {
     bool overwrote_existing = true;
 
-    ssize_t i = mItems.indexOfKey(key);
+    size_t position;
+    ssize_t i = indexOfKey(key, &position);
     if (i < 0) {
-        typed_data item;
-        i = mItems.add(key, item);
+        reserve(mNumItems + 1);
 
+        // Move the empty item past the end into place.
+        for (size_t j = mNumItems; j > position; --j) {
+            mItems[j].mKey = mItems[j - 1].mKey;
+            mItems[j].mData.swap(mItems[j - 1].mData);
+        }
+        mItems[position].mKey = key;
+        ++mNumItems;
+
+        i = position;
         overwrote_existing = false;
     }
 
-    typed_data &item = mItems.editValueAt(i);
-
-    item.setData(type, data, size);
+    mItems[i].mData.setData(type, data, size);
 
     return overwrote_existing;
 }
 
 bool MetaData::findData(uint32_t key, uint32_t *type,
                         const void **data, size_t *size) const {
-    ssize_t i = mItems.indexOfKey(key);
+    ssize_t i = indexOfKey(key, NULL);
 
     if (i < 0) {
         return false;
     }
 
-    const typed_data &item = mItems.valueAt(i);
-
-    item.getData(type, data, size);
+    mItems[i].mData.getData(type, data, size);
 
     return true;
 }
@@ -252,10 +329,13 @@ void MetaData::typed_data::clear() {
 
 void MetaData::typed_data::setData(
         uint32_t type, const void *data, size_t size) {
-    clear();
+    // Storage of the right size already is reused.
+    if (size != mSize) {
+        freeStorage();
+        allocateStorage(size);
+    }
 
     mType = type;
-    allocateStorage(size);
     memcpy(storage(), data, size);
 }
 
@@ -266,6 +346,24 @@ void MetaData::typed_data::getData(
     *data = storage();
 }
 
+void MetaData::typed_data::swap(typed_data &other) {
+    uint32_t type = mType;
+    mType = other.mType;
+    other.mType = type;
+
+    size_t size = mSize;
+    mSize = other.mSize;
+    other.mSize = size;
+
+    union {
+        void *ext_data;
+        int64_t reservoir[2];
+    } data;
+    memcpy(&data, &u, sizeof(u));
+    memcpy(&u, &other.u, sizeof(u));
+    memcpy(&other.u, &data, sizeof(u));
+}
+
 void MetaData::typed_data::allocateStorage(size_t size) {
     mSize = size;
 
@@ -332,11 +430,11 @@ static void MakeFourCCString(uint32_t x, char *s) {
 }
 
 void MetaData::dumpToLog() const {
-    for (int i = mItems.size(); --i >= 0;) {
-        int32_t key = mItems.keyAt(i);
+    for (int i = mNumItems; --i >= 0;) {
+        int32_t key = mItems[i].mKey;
         char cc[5];
         MakeFourCCString(key, cc);
-        const typed_data &item = mItems.valueAt(i);
+        const typed_data &item = mItems[i].mData;
         ALOGI("%s: %s", cc, item.asString().string());
     }
 }
@@ -21,6 +21,13 @@
 #include "include/NuCachedSource2.h"
 #include "include/HTTPBase.h"
 
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <unistd.h>
+
 #include <cutils/properties.h>
 #include <media/stagefright/foundation/ADebug.h>
 #include <media/stagefright/foundation/AMessage.h>
@@ -35,13 +42,18 @@ struct PageCache {
     struct Page {
         void *mData;
         size_t mSize;
+        off64_t mOffset;    // only valid for retained pages
     };
 
     Page *acquirePage();
     void releasePage(Page *page);
 
     void appendPage(Page *page);
-    size_t releaseFromStart(size_t maxBytes);
+
+    // Releases pages from the start of the active range, which begins at
+    // startOffset in the source. Released pages are retained, up to the
+    // retained limit, so that they can be read again without fetching them.
+    size_t releaseFromStart(size_t maxBytes, off64_t startOffset);
 
     size_t totalSize() const {
         return mTotalSize;
@@ -49,6 +61,34 @@ struct PageCache {
 
     void copy(size_t from, void *data, size_t size);
 
+    void setRetainedLimit(size_t maxBytes);
+
+    size_t retainedSize() const {
+        return mRetainedSize;
+    }
+
+    // Copies data at the given source offset from the retained pages,
+    // returns false unless the whole range is retained.
+    bool copyRetained(off64_t offset, void *data, size_t size);
+
+    // Fills page with the retained data starting at the given source
+    // offset, up to the end of the retained page containing it.
+    bool fetchRetained(off64_t offset, Page *page);
+
+    void retainPage(Page *page);
+
+    // Pages fetched ahead of the active range, kept sorted by offset.
+    void addPendingPage(Page *page);
+
+    // Appends the pending page starting at the given source offset to the
+    // active range. The pending pages preceding it are retained.
+    bool appendPendingPage(off64_t offset);
+
+    void retainPendingPages();
+
+    // Returns the offset of the first pending page, -1 if there is none.
+    off64_t firstPendingOffset() const;
+
 private:
     size_t mPageSize;
     size_t mTotalSize;
@@ -56,19 +96,31 @@ private:
     List<Page *> mActivePages;
     List<Page *> mFreePages;
 
+    // least recently used first
+    List<Page *> mRetainedPages;
+    size_t mRetainedSize;
+    size_t mRetainedLimit;
+
+    List<Page *> mPendingPages;
+
     void freePages(List<Page *> *list);
+    List<Page *>::iterator findRetained(off64_t offset);
 
     DISALLOW_EVIL_CONSTRUCTORS(PageCache);
 };
 
 PageCache::PageCache(size_t pageSize)
     : mPageSize(pageSize),
-      mTotalSize(0) {
+      mTotalSize(0),
+      mRetainedSize(0),
+      mRetainedLimit(0) {
 }
 
 PageCache::~PageCache() {
     freePages(&mActivePages);
     freePages(&mFreePages);
+    freePages(&mRetainedPages);
+    freePages(&mPendingPages);
 }
 
 void PageCache::freePages(List<Page *> *list) {
@@ -110,7 +162,7 @@ void PageCache::appendPage(Page *page) {
     mActivePages.push_back(page);
 }
 
-size_t PageCache::releaseFromStart(size_t maxBytes) {
+size_t PageCache::releaseFromStart(size_t maxBytes, off64_t startOffset) {
     size_t bytesReleased = 0;
 
     while (maxBytes > 0 && !mActivePages.empty()) {
@@ -124,16 +176,119 @@ size_t PageCache::releaseFromStart(size_t maxBytes) {
 
         mActivePages.erase(it);
 
+        page->mOffset = startOffset + bytesReleased;
+
         maxBytes -= page->mSize;
         bytesReleased += page->mSize;
 
-        releasePage(page);
+        retainPage(page);
     }
 
     mTotalSize -= bytesReleased;
     return bytesReleased;
 }
 
+void PageCache::setRetainedLimit(size_t maxBytes) {
+    mRetainedLimit = maxBytes;
+
+    while (mRetainedSize > mRetainedLimit) {
+        List<Page *>::iterator it = mRetainedPages.begin();
+        mRetainedSize -= (*it)->mSize;
+        releasePage(*it);
+        mRetainedPages.erase(it);
+    }
+}
+
+void PageCache::retainPage(Page *page) {
+    if (page->mSize > mRetainedLimit) {
+        releasePage(page);
+        return;
+    }
+
+    // Drop older copies of the same data, a range is retained at most once.
+    off64_t end = page->mOffset + page->mSize;
+    List<Page *>::iterator it = mRetainedPages.begin();
+    while (it != mRetainedPages.end()) {
+        Page *other = *it;
+        if (other->mOffset < end
+                && page->mOffset < other->mOffset + (off64_t)other->mSize) {
+            mRetainedSize -= other->mSize;
+            releasePage(other);
+            it = mRetainedPages.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    mRetainedPages.push_back(page);
+    mRetainedSize += page->mSize;
+
+    setRetainedLimit(mRetainedLimit);
+}
+
+List<PageCache::Page *>::iterator PageCache::findRetained(off64_t offset) {
+    List<Page *>::iterator it = mRetainedPages.begin();
+    while (it != mRetainedPages.end()) {
+        if (offset >= (*it)->mOffset
+                && offset < (*it)->mOffset + (off64_t)(*it)->mSize) {
+            break;
+        }
+        ++it;
+    }
+    return it;
+}
+
+bool PageCache::copyRetained(off64_t offset, void *data, size_t size) {
+    // Check that the whole range is retained before copying anything.
+    off64_t pos = offset;
+    while (pos < offset + (off64_t)size) {
+        List<Page *>::iterator it = findRetained(pos);
+        if (it == mRetainedPages.end()) {
+            return false;
+        }
+        pos = (*it)->mOffset + (*it)->mSize;
+    }
+
+    while (size > 0) {
+        List<Page *>::iterator it = findRetained(offset);
+        Page *page = *it;
+
+        size_t delta = offset - page->mOffset;
+        size_t copy = page->mSize - delta;
+        if (copy > size) {
+            copy = size;
+        }
+        memcpy(data, (const uint8_t *)page->mData + delta, copy);
+
+        // Mark as most recently used.
+        mRetainedPages.erase(it);
+        mRetainedPages.push_back(page);
+
+        data = (uint8_t *)data + copy;
+        offset += copy;
+        size -= copy;
+    }
+
+    return true;
+}
+
+bool PageCache::fetchRetained(off64_t offset, Page *page) {
+    List<Page *>::iterator it = findRetained(offset);
+    if (it == mRetainedPages.end()) {
+        return false;
+    }
+
+    Page *retained = *it;
+    size_t delta = offset - retained->mOffset;
+
+    // The fetched copy becomes part of the active range again, and will
+    // replace the retained one when it is released in turn.
+    page->mSize = retained->mSize - delta;
+    memcpy(page->mData, (const uint8_t *)retained->mData + delta, page->mSize);
+
+    return true;
+}
+
 void PageCache::copy(size_t from, void *data, size_t size) {
     ALOGV("copy from %d size %d", from, size);
 
@@ -175,6 +330,449 @@ void PageCache::copy(size_t from, void *data, size_t size) {
     }
 }
 
+void PageCache::addPendingPage(Page *page) {
+    List<Page *>::iterator it = mPendingPages.begin();
+    while (it != mPendingPages.end() && (*it)->mOffset < page->mOffset) {
+        ++it;
+    }
+    mPendingPages.insert(it, page);
+}
+
+bool PageCache::appendPendingPage(off64_t offset) {
+    while (!mPendingPages.empty()) {
+        List<Page *>::iterator it = mPendingPages.begin();
+        Page *page = *it;
+
+        if (page->mOffset > offset) {
+            return false;
+        }
+
+        mPendingPages.erase(it);
+
+        if (page->mOffset == offset) {
+            appendPage(page);
+            return true;
+        }
+
+        // Behind the active range already, after a seek or because the
+        // range was fetched twice.
+        retainPage(page);
+    }
+
+    return false;
+}
+
+void PageCache::retainPendingPages() {
+    while (!mPendingPages.empty()) {
+        List<Page *>::iterator it = mPendingPages.begin();
+        Page *page = *it;
+        mPendingPages.erase(it);
+
+        retainPage(page);
+    }
+}
+
+off64_t PageCache::firstPendingOffset() const {
+    if (mPendingPages.empty()) {
+        return -1;
+    }
+    return (*mPendingPages.begin())->mOffset;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Disk backed tier of the cache, storing the data fetched from an HTTP
+// source in a sparse file per content, along with an index of the byte
+// ranges it holds. Contents are identified by their URI, size and cache
+// validator and are evicted least recently opened first once the total
+// size of the cache directory goes over its limit.
+struct DiskPageCache {
+    static DiskPageCache *Open(
+            const char *dir, off64_t maxBytes,
+            const String8 &uri, const String8 &validator, off64_t size);
+
+    ~DiskPageCache();
+
+    // Returns the number of bytes read at offset, up to size, 0 if the
+    // data at offset is not cached.
+    ssize_t read(off64_t offset, void *data, size_t size);
+
+    void write(off64_t offset, const void *data, size_t size);
+
+private:
+    struct Range {
+        off64_t mStart;
+        off64_t mEnd;
+    };
+
+    struct Entry {
+        String8 mName;
+        time_t mTime;
+        off64_t mSize;
+    };
+
+    enum {
+        // The index is rewritten after this much data has been added.
+        kIndexWriteInterval = 4 * 1024 * 1024,
+    };
+
+    Mutex mLock;
+    String8 mIndexPath;
+    String8 mHeader;
+    int mFd;
+    Vector<Range> mRanges;  // sorted and disjoint
+    size_t mBytesSinceIndexWrite;
+
+    DiskPageCache(const String8 &indexPath, const String8 &header, int fd);
+
+    void readIndex();
+    void writeIndex_l();
+    void addRange_l(off64_t start, off64_t end);
+
+    static void Evict(const char *dir, off64_t maxBytes, const String8 &keep);
+
+    DISALLOW_EVIL_CONSTRUCTORS(DiskPageCache);
+};
+
+// static
+DiskPageCache *DiskPageCache::Open(
+        const char *dir, off64_t maxBytes,
+        const String8 &uri, const String8 &validator, off64_t size) {
+    if (validator.isEmpty() || size <= 0 || size > maxBytes) {
+        return NULL;
+    }
+
+    String8 header = String8::format("%lld %s %s\n", size, uri.string(), validator.string());
+
+    // 64-bit FNV-1a hash of the header as the file name.
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for (size_t i = 0; i < header.length(); ++i) {
+        hash = (hash ^ (uint8_t)header.string()[i]) * 0x100000001b3ull;
+    }
+    String8 name = String8::format("%016llx", hash);
+    String8 dataPath = String8::format("%s/%s.data", dir, name.string());
+    String8 indexPath = String8::format("%s/%s.idx", dir, name.string());
+
+    Evict(dir, maxBytes - size, name);
+
+    int fd = open(dataPath.string(), O_RDWR | O_CREAT | O_LARGEFILE, 0600);
+    if (fd < 0) {
+        ALOGW("cannot open disk cache file %s (%s)", dataPath.string(), strerror(errno));
+        return NULL;
+    }
+    // Mark as most recently used.
+    utimes(dataPath.string(), NULL);
+
+    DiskPageCache *cache = new DiskPageCache(indexPath, header, fd);
+    cache->readIndex();
+    return cache;
+}
+
+DiskPageCache::DiskPageCache(const String8 &indexPath, const String8 &header, int fd)
+    : mIndexPath(indexPath),
+      mHeader(header),
+      mFd(fd),
+      mBytesSinceIndexWrite(0) {
+}
+
+DiskPageCache::~DiskPageCache() {
+    Mutex::Autolock autoLock(mLock);
+    if (mBytesSinceIndexWrite > 0) {
+        writeIndex_l();
+    }
+    close(mFd);
+    mFd = -1;
+}
+
+ssize_t DiskPageCache::read(off64_t offset, void *data, size_t size) {
+    Mutex::Autolock autoLock(mLock);
+
+    for (size_t i = 0; i < mRanges.size(); ++i) {
+        const Range &range = mRanges[i];
+        if (offset < range.mStart) {
+            break;
+        }
+        if (offset < range.mEnd) {
+            if ((off64_t)size > range.mEnd - offset) {
+                size = range.mEnd - offset;
+            }
+            ssize_t n = pread64(mFd, data, size, offset);
+            return (n < 0) ? 0 : n;
+        }
+    }
+
+    return 0;
+}
+
+void DiskPageCache::write(off64_t offset, const void *data, size_t size) {
+    Mutex::Autolock autoLock(mLock);
+
+    ssize_t n = pwrite64(mFd, data, size, offset);
+    if (n <= 0) {
+        return;
+    }
+
+    addRange_l(offset, offset + n);
+
+    mBytesSinceIndexWrite += n;
+    if (mBytesSinceIndexWrite >= kIndexWriteInterval) {
+        writeIndex_l();
+    }
+}
+
+void DiskPageCache::addRange_l(off64_t start, off64_t end) {
+    // Merge with the overlapping and adjacent ranges.
+    size_t i = 0;
+    while (i < mRanges.size() && mRanges[i].mEnd < start) {
+        ++i;
+    }
+    while (i < mRanges.size() && mRanges[i].mStart <= end) {
+        if (mRanges[i].mStart < start) {
+            start = mRanges[i].mStart;
+        }
+        if (mRanges[i].mEnd > end) {
+            end = mRanges[i].mEnd;
+        }
+        mRanges.removeAt(i);
+    }
+
+    Range range;
+    range.mStart = start;
+    range.mEnd = end;
+    mRanges.insertAt(range, i);
+}
+
+void DiskPageCache::readIndex() {
+    int fd = open(mIndexPath.string(), O_RDONLY);
+    if (fd < 0) {
+        return;
+    }
+
+    String8 index;
+    char buffer[4096];
+    ssize_t n;
+    while ((n = ::read(fd, buffer, sizeof(buffer))) > 0) {
+        index.append(buffer, n);
+    }
+    close(fd);
+
+    // A different content with the same hash, or a stale index.
+    if (strncmp(index.string(), mHeader.string(), mHeader.length())) {
+        ALOGV("discarding disk cache index %s", mIndexPath.string());
+        ftruncate64(mFd, 0);
+        return;
+    }
+
+    Mutex::Autolock autoLock(mLock);
+
+    const char *s = index.string() + mHeader.length();
+    long long start, end;
+    int consumed;
+    while (sscanf(s, "%lld %lld\n%n", &start, &end, &consumed) == 2) {
+        if (start >= 0 && start < end) {
+            addRange_l(start, end);
+        }
+        s += consumed;
+    }
+}
+
+void DiskPageCache::writeIndex_l() {
+    String8 index(mHeader);
+    for (size_t i = 0; i < mRanges.size(); ++i) {
+        index.appendFormat("%lld %lld\n", mRanges[i].mStart, mRanges[i].mEnd);
+    }
+
+    // Only claim data that made it to the disk, and replace the index
+    // atomically.
+    fsync(mFd);
+
+    String8 tmpPath = mIndexPath;
+    tmpPath.append(".tmp");
+    int fd = open(tmpPath.string(), O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    if (fd < 0) {
+        return;
+    }
+    bool ok = ::write(fd, index.string(), index.length()) == (ssize_t)index.length();
+    close(fd);
+
+    if (!ok || rename(tmpPath.string(), mIndexPath.string()) < 0) {
+        unlink(tmpPath.string());
+        return;
+    }
+
+    mBytesSinceIndexWrite = 0;
+}
+
+// static
+void DiskPageCache::Evict(const char *dir, off64_t maxBytes, const String8 &keep) {
+    DIR *d = opendir(dir);
+    if (d == NULL) {
+        return;
+    }
+
+    Vector<Entry> entries;
+    off64_t totalSize = 0;
+    struct dirent *ent;
+    while ((ent = readdir(d)) != NULL) {
+        const char *ext = strrchr(ent->d_name, '.');
+        if (ext == NULL || strcmp(ext, ".data")) {
+            continue;
+        }
+
+        String8 path = String8::format("%s/%s", dir, ent->d_name);
+        struct stat st;
+        if (stat(path.string(), &st) < 0) {
+            continue;
+        }
+
+        Entry entry;
+        entry.mName.setTo(ent->d_name, ext - ent->d_name);
+        entry.mTime = st.st_mtime;
+        entry.mSize = (off64_t)st.st_blocks * 512;  // the files are sparse
+
+        // The size of the content being opened is accounted for by the caller.
+        if (entry.mName != keep) {
+            totalSize += entry.mSize;
+            entries.push(entry);
+        }
+    }
+    closedir(d);
+
+    while (totalSize > maxBytes && !entries.isEmpty()) {
+        size_t oldest = 0;
+        for (size_t i = 1; i < entries.size(); ++i) {
+            if (entries[i].mTime < entries[oldest].mTime) {
+                oldest = i;
+            }
+        }
+
+        const Entry &entry = entries[oldest];
+        ALOGV("evicting %s from the disk cache", entry.mName.string());
+        unlink(String8::format("%s/%s.data", dir, entry.mName.string()).string());
+        unlink(String8::format("%s/%s.idx", dir, entry.mName.string()).string());
+        totalSize -= entry.mSize;
+        entries.removeAt(oldest);
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Fetches ranges of the play-ahead region on an additional connection to
+// the HTTP source, one page at a time. The pages are handed to the page
+// cache as pending pages and appended to the active range in order.
+struct NuCachedSource2::RangeFetcher : public Thread {
+    RangeFetcher(NuCachedSource2 *owner);
+
+    // The following are protected by the owner's mLock.
+    bool mBusy;
+    off64_t mOffset;        // next offset to fetch
+    off64_t mEndOffset;
+    int32_t mGeneration;
+    sp<HTTPBase> mConnection;
+
+private:
+    NuCachedSource2 *mOwner;
+
+    virtual bool threadLoop();
+
+    DISALLOW_EVIL_CONSTRUCTORS(RangeFetcher);
+};
+
+NuCachedSource2::RangeFetcher::RangeFetcher(NuCachedSource2 *owner)
+    : Thread(false /* canCallJava */),
+      mBusy(false),
+      mOffset(0),
+      mEndOffset(0),
+      mGeneration(0),
+      mOwner(owner) {
+}
+
+bool NuCachedSource2::RangeFetcher::threadLoop() {
+    sp<HTTPBase> connection;
+    PageCache::Page *page;
+    int32_t generation;
+    off64_t offset;
+    size_t size;
+
+    {
+        Mutex::Autolock autoLock(mOwner->mLock);
+
+        while (!mBusy) {
+            if (exitPending()) {
+                return false;
+            }
+            mOwner->mRangeCondition.wait(mOwner->mLock);
+        }
+
+        if (exitPending()) {
+            return false;
+        }
+
+        if (mGeneration != mOwner->mRangeGeneration || mOffset >= mEndOffset) {
+            // Done, or obsoleted by a seek.
+            mBusy = false;
+            return true;
+        }
+
+        generation = mGeneration;
+        offset = mOffset;
+        size = kPageSize;
+        if (mEndOffset - offset < (off64_t)size) {
+            size = mEndOffset - offset;
+        }
+        connection = mConnection;
+        page = mOwner->mCache->acquirePage();
+    }
+
+    ssize_t n = 0;
+    if (mOwner->mDiskCache != NULL) {
+        n = mOwner->mDiskCache->read(offset, page->mData, size);
+    }
+
+    if (n <= 0) {
+        if (connection == NULL) {
+            connection = static_cast<HTTPBase *>(
+                    mOwner->mSource.get())->createConnection(offset);
+        }
+
+        n = (connection != NULL)
+                ? connection->readAt(offset, page->mData, size) : ERROR_IO;
+
+        if (n > 0 && mOwner->mDiskCache != NULL) {
+            mOwner->mDiskCache->write(offset, page->mData, n);
+        }
+    }
+
+    Mutex::Autolock autoLock(mOwner->mLock);
+
+    mConnection = connection;
+
+    if (n <= 0) {
+        mOwner->mCache->releasePage(page);
+        mBusy = false;
+
+        if (generation == mOwner->mRangeGeneration) {
+            // The main connection will fetch what is left of the range.
+            ALOGW("range fetch at %lld returned %ld, "
+                  "continuing with a single connection", offset, n);
+            mOwner->mNumConnections = 1;
+        }
+        return true;
+    }
+
+    page->mSize = n;
+    page->mOffset = offset;
+    mOffset += n;
+
+    if (generation == mOwner->mRangeGeneration) {
+        mOwner->mCache->addPendingPage(page);
+    } else {
+        mOwner->mCache->retainPage(page);
+    }
+
+    return true;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 
 NuCachedSource2::NuCachedSource2(
@@ -194,7 +792,18 @@ NuCachedSource2::NuCachedSource2(
       mHighwaterThresholdBytes(kDefaultHighWaterThreshold),
       mLowwaterThresholdBytes(kDefaultLowWaterThreshold),
       mKeepAliveIntervalUs(kDefaultKeepAliveIntervalUs),
-      mDisconnectAtHighwatermark(disconnectAtHighwatermark)
+      mDisconnectAtHighwatermark(disconnectAtHighwatermark),
+      mRetainedThresholdBytes(kDefaultRetainedThreshold),
+      mNumBytesHit(0),
+      mNumBytesRetainedHit(0),
+      mNumBytesMissed(0),
+      mNumBytesRetainedFetched(0),
+      mNumConnections(1),
+      mRangeGeneration(0),
+      mNextRangeOffset(0),
+      mWaitingForRange(false),
+      mDiskCache(NULL),
+      mNumBytesDiskFetched(0)
 #ifdef QCOM_HARDWARE
       ,mIsDownloadComplete(false)
 #endif
@@ -215,6 +824,29 @@ NuCachedSource2::NuCachedSource2(
         mKeepAliveIntervalUs = 0;
     }
 
+    mCache->setRetainedLimit(mRetainedThresholdBytes);
+
+    if (mSource->flags() & kIsHTTPBasedSource) {
+        openDiskCache();
+
+        char value[PROPERTY_VALUE_MAX];
+        if (property_get("media.stagefright.cache-conns", value, NULL)) {
+            int numConnections = atoi(value);
+            if (numConnections < 1) {
+                numConnections = 1;
+            } else if (numConnections > kMaxNumConnections) {
+                numConnections = kMaxNumConnections;
+            }
+            mNumConnections = numConnections;
+        }
+
+        for (size_t i = 1; i < mNumConnections; ++i) {
+            sp<RangeFetcher> fetcher = new RangeFetcher(this);
+            fetcher->run("NuCachedSource2Range");
+            mRangeFetchers.push(fetcher);
+        }
+    }
+
     mLooper->setName("NuCachedSource2");
     mLooper->registerHandler(mReflector);
     mLooper->start();
@@ -224,11 +856,65 @@ NuCachedSource2::NuCachedSource2(
 }
 
 NuCachedSource2::~NuCachedSource2() {
+    Vector<sp<HTTPBase> > connections;
+    {
+        Mutex::Autolock autoLock(mLock);
+        for (size_t i = 0; i < mRangeFetchers.size(); ++i) {
+            mRangeFetchers[i]->requestExit();
+            if (mRangeFetchers[i]->mConnection != NULL) {
+                connections.push(mRangeFetchers[i]->mConnection);
+            }
+        }
+        mRangeCondition.broadcast();
+    }
+    // Interrupt reads in progress.
+    for (size_t i = 0; i < connections.size(); ++i) {
+        connections[i]->disconnect();
+    }
+    for (size_t i = 0; i < mRangeFetchers.size(); ++i) {
+        mRangeFetchers[i]->requestExitAndWait();
+    }
+    mRangeFetchers.clear();
+
     mLooper->stop();
     mLooper->unregisterHandler(mReflector->id());
 
+    int64_t hitBytes, missBytes;
+    getCacheStats(&hitBytes, &missBytes);
+    ALOGI("cache hit ratio %lld/%lld bytes, %lld read from retained pages, "
+          "%lld fetched from retained pages, %lld fetched from disk",
+          hitBytes, hitBytes + missBytes, mNumBytesRetainedHit,
+          mNumBytesRetainedFetched, mNumBytesDiskFetched);
+
     delete mCache;
     mCache = NULL;
+
+    delete mDiskCache;
+    mDiskCache = NULL;
+}
+
+void NuCachedSource2::openDiskCache() {
+    char dir[PROPERTY_VALUE_MAX];
+    if (!property_get("media.stagefright.diskcache", dir, NULL)) {
+        return;
+    }
+
+    off64_t maxBytes = kDefaultDiskCacheSize;
+    char value[PROPERTY_VALUE_MAX];
+    if (property_get("media.stagefright.diskcache-kb", value, NULL)) {
+        maxBytes = atoll(value) * 1024;
+    }
+
+    off64_t size;
+    if (mSource->getSize(&size) != OK) {
+        return;
+    }
+
+    HTTPBase *source = static_cast<HTTPBase *>(mSource.get());
+    mDiskCache = DiskPageCache::Open(
+            dir, maxBytes, mSource->getUri(), source->getCacheValidator(), size);
+
+    ALOGV("disk cache %s", mDiskCache != NULL ? "enabled" : "not usable");
 }
 
 status_t NuCachedSource2::getEstimatedBandwidthKbps(int32_t *kbps) {
@@ -319,13 +1005,67 @@ void NuCachedSource2::fetchInternal() {
         }
     }
 
-    PageCache::Page *page = mCache->acquirePage();
+    PageCache::Page *page;
+    size_t size = kPageSize;
+    off64_t offset;
 
-    ssize_t n = mSource->readAt(
-            mCacheOffset + mCache->totalSize(), page->mData, kPageSize);
+    {
+        Mutex::Autolock autoLock(mLock);
+
+        offset = mCacheOffset + mCache->totalSize();
+
+        mWaitingForRange = false;
+        if (mCache->appendPendingPage(offset)) {
+            scheduleRanges_l();
+            return;
+        }
+
+        page = mCache->acquirePage();
+
+        // Data released from the active range earlier need not be fetched
+        // from the source again.
+        if (mCache->fetchRetained(offset, page)) {
+            ALOGV("fetched %d bytes from retained pages", page->mSize);
+            mNumBytesRetainedFetched += page->mSize;
+            mCache->appendPage(page);
+            return;
+        }
+
+        scheduleRanges_l();
+
+        off64_t nextOffset = nextFetchedOffset_l();
+        if (nextOffset == offset) {
+            // Another connection is fetching this data.
+            mCache->releasePage(page);
+            mWaitingForRange = true;
+            return;
+        } else if (nextOffset > offset && nextOffset - offset < (off64_t)size) {
+            size = nextOffset - offset;
+        }
+    }
+
+    ssize_t n = 0;
+    bool fromDisk = false;
+
+    if (mDiskCache != NULL) {
+        n = mDiskCache->read(offset, page->mData, size);
+        fromDisk = (n > 0);
+    }
+
+    if (!fromDisk) {
+        n = mSource->readAt(offset, page->mData, size);
+
+        if (n > 0 && mDiskCache != NULL) {
+            mDiskCache->write(offset, page->mData, n);
+        }
+    }
 
     Mutex::Autolock autoLock(mLock);
 
+    if (fromDisk) {
+        mNumBytesDiskFetched += n;
+    }
+
     if (n < 0) {
         ALOGE("source returned error %ld, %d retries left", n, mNumRetriesLeft);
         mFinalStatus = n;
@@ -396,6 +1136,8 @@ void NuCachedSource2::onFetch() {
         if (mFinalStatus != OK && mNumRetriesLeft > 0) {
             // We failed this time and will try again in 3 seconds.
             delayUs = 3000000ll;
+        } else if (mWaitingForRange) {
+            delayUs = 10000ll;
         } else {
             delayUs = 0;
         }
@@ -443,6 +1185,78 @@ void NuCachedSource2::onRead(const sp<AMessage> &msg) {
     mCondition.signal();
 }
 
+void NuCachedSource2::scheduleRanges_l() {
+    if (mNumConnections <= 1 || mFinalStatus != OK) {
+        return;
+    }
+
+    off64_t size;
+    if (mSource->getSize(&size) != OK) {
+        return;
+    }
+
+    // The range at the start of the play-ahead region is left to the main
+    // connection, the following ones are fetched concurrently.
+    off64_t offset = mCacheOffset + mCache->totalSize();
+    if (mNextRangeOffset < offset + kRangeSize) {
+        mNextRangeOffset = offset + kRangeSize;
+    }
+
+    off64_t maxOffset = offset + (off64_t)mNumConnections * kRangeSize;
+    if (maxOffset > mCacheOffset + (off64_t)mHighwaterThresholdBytes) {
+        maxOffset = mCacheOffset + mHighwaterThresholdBytes;
+    }
+    if (maxOffset > size) {
+        maxOffset = size;
+    }
+
+    bool scheduled = false;
+    for (size_t i = 0; i < mRangeFetchers.size()
+            && mNextRangeOffset < maxOffset; ++i) {
+        const sp<RangeFetcher> &fetcher = mRangeFetchers[i];
+        if (fetcher->mBusy) {
+            continue;
+        }
+
+        fetcher->mBusy = true;
+        fetcher->mOffset = mNextRangeOffset;
+        fetcher->mEndOffset = mNextRangeOffset + kRangeSize;
+        if (fetcher->mEndOffset > size) {
+            fetcher->mEndOffset = size;
+        }
+        fetcher->mGeneration = mRangeGeneration;
+        mNextRangeOffset = fetcher->mEndOffset;
+
+        ALOGV("fetching range %lld-%lld on connection %d",
+              fetcher->mOffset, fetcher->mEndOffset, i + 1);
+        scheduled = true;
+    }
+
+    if (scheduled) {
+        mRangeCondition.broadcast();
+    }
+}
+
+off64_t NuCachedSource2::nextFetchedOffset_l() const {
+    off64_t offset = mCacheOffset + mCache->totalSize();
+    off64_t nextOffset = mCache->firstPendingOffset();
+
+    for (size_t i = 0; i < mRangeFetchers.size(); ++i) {
+        const sp<RangeFetcher> &fetcher = mRangeFetchers[i];
+        if (fetcher->mBusy && fetcher->mGeneration == mRangeGeneration
+                && fetcher->mOffset < fetcher->mEndOffset
+                && fetcher->mEndOffset > offset
+                && (nextOffset < 0 || fetcher->mOffset < nextOffset)) {
+            nextOffset = fetcher->mOffset;
+        }
+    }
+
+    if (nextOffset >= 0 && nextOffset < offset) {
+        return offset;
+    }
+    return nextOffset;
+}
+
 void NuCachedSource2::restartPrefetcherIfNecessary_l(
         bool ignoreLowWaterThreshold, bool force) {
     static const size_t kGrayArea = 1024 * 1024;
@@ -467,7 +1281,7 @@ void NuCachedSource2::restartPrefetcherIfNecessary_l(
         maxBytes -= kGrayArea;
     }
 
-    size_t actualBytes = mCache->releaseFromStart(maxBytes);
+    size_t actualBytes = mCache->releaseFromStart(maxBytes, mCacheOffset);
     mCacheOffset += actualBytes;
 
     ALOGI("restarting prefetcher, totalSize = %d", mCache->totalSize());
@@ -489,7 +1303,16 @@ ssize_t NuCachedSource2::readAt(off64_t offset, void *data, size_t size) {
         mCache->copy(delta, data, size);
 
         mLastAccessPos = offset + size;
+        mNumBytesHit += size;
+
+        return size;
+    }
 
+    // Reads outside of the active range, like a moov atom at the end of the
+    // file, are served from the retained pages if possible without moving
+    // the active range.
+    if (mCache->copyRetained(offset, data, size)) {
+        mNumBytesRetainedHit += size;
         return size;
     }
 
@@ -512,11 +1335,18 @@ ssize_t NuCachedSource2::readAt(off64_t offset, void *data, size_t size) {
 
     if (result > 0) {
         mLastAccessPos = offset + result;
+        mNumBytesMissed += result;
     }
 
     return (ssize_t)result;
 }
 
+void NuCachedSource2::getCacheStats(int64_t *hitBytes, int64_t *missBytes) {
+    Mutex::Autolock autoLock(mLock);
+    *hitBytes = mNumBytesHit + mNumBytesRetainedHit;
+    *missBytes = mNumBytesMissed;
+}
+
 size_t NuCachedSource2::cachedSize() {
     Mutex::Autolock autoLock(mLock);
     return mCacheOffset + mCache->totalSize();
@@ -613,10 +1443,15 @@ status_t NuCachedSource2::seekInternal_l(off64_t offset) {
 
     ALOGI("new range: offset= %lld", offset);
 
+    size_t totalSize = mCache->totalSize();
+    CHECK_EQ(mCache->releaseFromStart(totalSize, mCacheOffset), totalSize);
+
     mCacheOffset = offset;
 
-    size_t totalSize = mCache->totalSize();
-    CHECK_EQ(mCache->releaseFromStart(totalSize), totalSize);
+    // Ranges fetched ahead of the old position are retained as well.
+    ++mRangeGeneration;
+    mCache->retainPendingPages();
+    mNextRangeOffset = 0;
 
     mNumRetriesLeft = kMaxNumRetries;
     mFetching = true;
@@ -662,11 +1497,13 @@ void NuCachedSource2::updateCacheParamsFromSystemProperty() {
 }
 
 void NuCachedSource2::updateCacheParamsFromString(const char *s) {
-    ssize_t lowwaterMarkKb, highwaterMarkKb;
+    ssize_t lowwaterMarkKb, highwaterMarkKb, retainedKb = -1;
     int keepAliveSecs;
 
-    if (sscanf(s, "%ld/%ld/%d",
-               &lowwaterMarkKb, &highwaterMarkKb, &keepAliveSecs) != 3) {
+    // The retained size is optional.
+    if (sscanf(s, "%ld/%ld/%d/%ld",
+               &lowwaterMarkKb, &highwaterMarkKb, &keepAliveSecs,
+               &retainedKb) < 3) {
         ALOGE("Failed to parse cache parameters from '%s'.", s);
         return;
     }
@@ -696,10 +1533,18 @@ void NuCachedSource2::updateCacheParamsFromString(const char *s) {
         mKeepAliveIntervalUs = kDefaultKeepAliveIntervalUs;
     }
 
-    ALOGV("lowwater = %d bytes, highwater = %d bytes, keepalive = %lld us",
+    if (retainedKb >= 0) {
+        mRetainedThresholdBytes = retainedKb * 1024;
+    } else {
+        mRetainedThresholdBytes = kDefaultRetainedThreshold;
+    }
+
+    ALOGV("lowwater = %d bytes, highwater = %d bytes, keepalive = %lld us, "
+         "retained = %d bytes",
          mLowwaterThresholdBytes,
          mHighwaterThresholdBytes,
-         mKeepAliveIntervalUs);
+         mKeepAliveIntervalUs,
+         mRetainedThresholdBytes);
 }
 
 // static
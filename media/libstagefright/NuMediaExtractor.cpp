@@ -26,6 +26,7 @@
 
 #include <media/stagefright/foundation/ABuffer.h>
 #include <media/stagefright/foundation/ADebug.h>
+#include <media/stagefright/foundation/ALooper.h>
 #include <media/stagefright/foundation/AMessage.h>
 #include <media/stagefright/DataSource.h>
 #include <media/stagefright/FileSource.h>
@@ -36,16 +37,64 @@
 #include <media/stagefright/MediaSource.h>
 #include <media/stagefright/MetaData.h>
 #include <media/stagefright/Utils.h>
+#include <cutils/properties.h>
 
 namespace android {
 
+// Bounds on what the prefetcher holds per track, whatever the window.
+static const size_t kMaxPrefetchedSamples = 512;
+static const size_t kMaxPrefetchedBytes = 4 * 1024 * 1024;
+
+static size_t GetSampleSize(MediaBuffer *buffer, bool isVorbis) {
+    size_t sampleSize = buffer->range_length();
+
+    if (isVorbis) {
+        // Each sample's data is suffixed by the number of page samples
+        // or -1 if not available.
+        sampleSize += sizeof(int32_t);
+    }
+
+    return sampleSize;
+}
+
+static void CopySampleData(MediaBuffer *buffer, bool isVorbis, uint8_t *dst) {
+    const uint8_t *src =
+        (const uint8_t *)buffer->data() + buffer->range_offset();
+
+    memcpy(dst, src, buffer->range_length());
+
+    if (isVorbis) {
+        int32_t numPageSamples;
+        if (!buffer->meta_data()->findInt32(
+                    kKeyValidSamples, &numPageSamples)) {
+            numPageSamples = -1;
+        }
+
+        memcpy(dst + buffer->range_length(),
+               &numPageSamples,
+               sizeof(numPageSamples));
+    }
+}
+
 NuMediaExtractor::NuMediaExtractor()
-    : mIsWidevineExtractor(false),
+    : mReflector(new AHandlerReflector<NuMediaExtractor>(this)),
+      mPrefetchWindowUs(0ll),
+      mPrefetchPending(false),
+      mIsWidevineExtractor(false),
       mTotalBitrate(-1ll),
       mDurationUs(-1ll) {
+    char value[PROPERTY_VALUE_MAX];
+    if (property_get("media.stagefright.extractor-prefetch-ms", value, NULL)) {
+        setPrefetchWindow(atoll(value) * 1000ll);
+    }
 }
 
 NuMediaExtractor::~NuMediaExtractor() {
+    if (mLooper != NULL) {
+        mLooper->stop();
+        mLooper->unregisterHandler(mReflector->id());
+    }
+
     releaseTrackSamples();
 
     for (size_t i = 0; i < mSelectedTracks.size(); ++i) {
@@ -226,8 +275,8 @@ status_t NuMediaExtractor::selectTrack(size_t index) {
     info->mSource = source;
     info->mTrackIndex = index;
     info->mFinalResult = OK;
-    info->mSample = NULL;
-    info->mSampleTimeUs = -1ll;
+    info->mPrefetchedBytes = 0;
+    info->mReading = false;
     info->mTrackFlags = 0;
 
     const char *mime;
@@ -237,6 +286,8 @@ status_t NuMediaExtractor::selectTrack(size_t index) {
         info->mTrackFlags |= kIsVorbis;
     }
 
+    schedulePrefetch();
+
     return OK;
 }
 
@@ -265,14 +316,11 @@ status_t NuMediaExtractor::unselectTrack(size_t index) {
         return OK;
     }
 
-    TrackInfo *info = &mSelectedTracks.editItemAt(i);
+    waitForPrefetch(i);
 
-    if (info->mSample != NULL) {
-        info->mSample->release();
-        info->mSample = NULL;
+    TrackInfo *info = &mSelectedTracks.editItemAt(i);
 
-        info->mSampleTimeUs = -1ll;
-    }
+    releaseSamples(info);
 
     CHECK_EQ((status_t)OK, info->mSource->stop());
 
@@ -283,14 +331,39 @@ status_t NuMediaExtractor::unselectTrack(size_t index) {
 
 void NuMediaExtractor::releaseTrackSamples() {
     for (size_t i = 0; i < mSelectedTracks.size(); ++i) {
-        TrackInfo *info = &mSelectedTracks.editItemAt(i);
+        releaseSamples(&mSelectedTracks.editItemAt(i));
+    }
+}
 
-        if (info->mSample != NULL) {
-            info->mSample->release();
-            info->mSample = NULL;
+void NuMediaExtractor::releaseSamples(TrackInfo *info) {
+    for (List<Sample>::iterator it = info->mSamples.begin();
+            it != info->mSamples.end(); ++it) {
+        if ((*it).mBuffer != NULL) {
+            (*it).mBuffer->release();
+        }
+    }
+    info->mSamples.clear();
+    info->mPrefetchedBytes = 0;
+}
 
-            info->mSampleTimeUs = -1ll;
+// Waits until the prefetcher no longer reads the given track, or any track
+// if index < 0. Called with mLock held.
+void NuMediaExtractor::waitForPrefetch(ssize_t index) {
+    for (;;) {
+        bool reading = false;
+        for (size_t i = 0; i < mSelectedTracks.size(); ++i) {
+            if ((index < 0 || (size_t)index == i)
+                    && mSelectedTracks.itemAt(i).mReading) {
+                reading = true;
+                break;
+            }
         }
+
+        if (!reading) {
+            return;
+        }
+
+        mCondition.wait(mLock);
     }
 }
 
@@ -299,30 +372,38 @@ ssize_t NuMediaExtractor::fetchTrackSamples(
     TrackInfo *minInfo = NULL;
     ssize_t minIndex = -1;
 
+    if (seekTimeUs >= 0ll) {
+        // Whatever is being prefetched is from before the seek.
+        waitForPrefetch();
+    }
+
     for (size_t i = 0; i < mSelectedTracks.size(); ++i) {
         TrackInfo *info = &mSelectedTracks.editItemAt(i);
 
         if (seekTimeUs >= 0ll) {
             info->mFinalResult = OK;
 
-            if (info->mSample != NULL) {
-                info->mSample->release();
-                info->mSample = NULL;
-                info->mSampleTimeUs = -1ll;
-            }
-        } else if (info->mFinalResult != OK) {
-            continue;
+            releaseSamples(info);
+        } else if (info->mSamples.empty() && info->mReading) {
+            // The prefetcher is reading this sample already.
+            waitForPrefetch(i);
+            info = &mSelectedTracks.editItemAt(i);
         }
 
-        if (info->mSample == NULL) {
+        if (info->mSamples.empty()) {
+            if (info->mFinalResult != OK) {
+                continue;
+            }
+
             MediaSource::ReadOptions options;
             if (seekTimeUs >= 0ll) {
                 options.setSeekTo(seekTimeUs, mode);
             }
-            status_t err = info->mSource->read(&info->mSample, &options);
+            MediaBuffer *buffer;
+            status_t err = info->mSource->read(&buffer, &options);
 
             if (err != OK) {
-                CHECK(info->mSample == NULL);
+                CHECK(buffer == NULL);
 
                 info->mFinalResult = err;
 
@@ -331,16 +412,19 @@ ssize_t NuMediaExtractor::fetchTrackSamples(
                           info->mTrackIndex, err);
                 }
 
-                info->mSampleTimeUs = -1ll;
                 continue;
-            } else {
-                CHECK(info->mSample != NULL);
-                CHECK(info->mSample->meta_data()->findInt64(
-                            kKeyTime, &info->mSampleTimeUs));
             }
+
+            Sample sample;
+            sample.mBuffer = buffer;
+            CHECK(buffer->meta_data()->findInt64(kKeyTime, &sample.mTimeUs));
+            info->mSamples.push_back(sample);
         }
 
-        if (minInfo == NULL  || info->mSampleTimeUs < minInfo->mSampleTimeUs) {
+        const Sample &sample = *info->mSamples.begin();
+
+        if (minInfo == NULL
+                || sample.mTimeUs < (*minInfo->mSamples.begin()).mTimeUs) {
             minInfo = info;
             minIndex = i;
         }
@@ -349,12 +433,152 @@ ssize_t NuMediaExtractor::fetchTrackSamples(
     return minIndex;
 }
 
+status_t NuMediaExtractor::setPrefetchWindow(int64_t windowUs) {
+    Mutex::Autolock autoLock(mLock);
+
+    if (windowUs < 0ll) {
+        return -EINVAL;
+    }
+
+    if (windowUs > 0ll && mLooper == NULL) {
+        mLooper = new ALooper;
+        mLooper->setName("NuMediaExtractor");
+        mLooper->registerHandler(mReflector);
+        mLooper->start();
+    }
+
+    mPrefetchWindowUs = windowUs;
+    schedulePrefetch();
+
+    return OK;
+}
+
+// Called with mLock held.
+void NuMediaExtractor::schedulePrefetch() {
+    if (mPrefetchWindowUs == 0ll || mLooper == NULL || mPrefetchPending) {
+        return;
+    }
+
+    mPrefetchPending = true;
+    (new AMessage(kWhatPrefetch, mReflector->id()))->post();
+}
+
+// Returns the track that is the least far ahead, among those that are below
+// the window. MediaSource does not expose the file offset of the next sample,
+// but muxers interleave tracks by time, so reading in time order reads the
+// file mostly forward. Called with mLock held.
+ssize_t NuMediaExtractor::pickTrackToPrefetch() {
+    ssize_t pickIndex = -1;
+    int64_t pickTimeUs = -1ll;
+
+    for (size_t i = 0; i < mSelectedTracks.size(); ++i) {
+        const TrackInfo &info = mSelectedTracks.itemAt(i);
+
+        if (info.mReading || info.mFinalResult != OK
+                || info.mSamples.size() >= kMaxPrefetchedSamples
+                || info.mPrefetchedBytes >= kMaxPrefetchedBytes) {
+            continue;
+        }
+
+        int64_t lastTimeUs = -1ll;
+        if (!info.mSamples.empty()) {
+            lastTimeUs = (*--info.mSamples.end()).mTimeUs;
+
+            if (lastTimeUs - (*info.mSamples.begin()).mTimeUs
+                    >= mPrefetchWindowUs) {
+                continue;
+            }
+        }
+
+        if (pickIndex < 0 || lastTimeUs < pickTimeUs) {
+            pickIndex = i;
+            pickTimeUs = lastTimeUs;
+        }
+    }
+
+    return pickIndex;
+}
+
+void NuMediaExtractor::onMessageReceived(const sp<AMessage> &msg) {
+    switch (msg->what()) {
+        case kWhatPrefetch:
+        {
+            onPrefetch();
+            break;
+        }
+
+        default:
+            TRESPASS();
+    }
+}
+
+// Reads one sample, without holding mLock during the read, then schedules
+// the next one.
+void NuMediaExtractor::onPrefetch() {
+    Mutex::Autolock autoLock(mLock);
+
+    mPrefetchPending = false;
+
+    ssize_t index = pickTrackToPrefetch();
+    if (index < 0) {
+        return;
+    }
+
+    TrackInfo *info = &mSelectedTracks.editItemAt(index);
+    info->mReading = true;
+
+    sp<MediaSource> source = info->mSource;
+    bool isVorbis = (info->mTrackFlags & kIsVorbis) != 0;
+
+    Sample sample;
+    sample.mBuffer = NULL;
+
+    mLock.unlock();
+
+    MediaBuffer *buffer;
+    status_t err = source->read(&buffer);
+
+    if (err == OK) {
+        sample.mData = new ABuffer(GetSampleSize(buffer, isVorbis));
+        CopySampleData(buffer, isVorbis, sample.mData->data());
+        sample.mMeta = new MetaData(*buffer->meta_data());
+        CHECK(sample.mMeta->findInt64(kKeyTime, &sample.mTimeUs));
+
+        buffer->release();
+        buffer = NULL;
+    }
+
+    mLock.lock();
+
+    // The track cannot have been unselected, unselectTrack() waits for us.
+    info = &mSelectedTracks.editItemAt(index);
+    info->mReading = false;
+
+    if (err != OK) {
+        info->mFinalResult = err;
+
+        if (err != ERROR_END_OF_STREAM) {
+            ALOGW("read on track %d failed with error %d",
+                  info->mTrackIndex, err);
+        }
+    } else {
+        info->mSamples.push_back(sample);
+        info->mPrefetchedBytes += sample.mData->size();
+    }
+
+    mCondition.broadcast();
+
+    schedulePrefetch();
+}
+
 status_t NuMediaExtractor::seekTo(
         int64_t timeUs, MediaSource::ReadOptions::SeekMode mode) {
     Mutex::Autolock autoLock(mLock);
 
     ssize_t minIndex = fetchTrackSamples(timeUs, mode);
 
+    schedulePrefetch();
+
     if (minIndex < 0) {
         return ERROR_END_OF_STREAM;
     }
@@ -373,9 +597,15 @@ status_t NuMediaExtractor::advance() {
 
     TrackInfo *info = &mSelectedTracks.editItemAt(minIndex);
 
-    info->mSample->release();
-    info->mSample = NULL;
-    info->mSampleTimeUs = -1ll;
+    List<Sample>::iterator it = info->mSamples.begin();
+    if ((*it).mBuffer != NULL) {
+        (*it).mBuffer->release();
+    } else {
+        info->mPrefetchedBytes -= (*it).mData->size();
+    }
+    info->mSamples.erase(it);
+
+    schedulePrefetch();
 
     return OK;
 }
@@ -390,38 +620,54 @@ status_t NuMediaExtractor::readSampleData(const sp<ABuffer> &buffer) {
     }
 
     TrackInfo *info = &mSelectedTracks.editItemAt(minIndex);
+    const Sample &sample = *info->mSamples.begin();
 
-    size_t sampleSize = info->mSample->range_length();
+    if (sample.mBuffer == NULL) {
+        if (buffer->capacity() < sample.mData->size()) {
+            return -ENOMEM;
+        }
 
-    if (info->mTrackFlags & kIsVorbis) {
-        // Each sample's data is suffixed by the number of page samples
-        // or -1 if not available.
-        sampleSize += sizeof(int32_t);
+        memcpy(buffer->data(), sample.mData->data(), sample.mData->size());
+        buffer->setRange(0, sample.mData->size());
+
+        return OK;
     }
 
+    bool isVorbis = (info->mTrackFlags & kIsVorbis) != 0;
+    size_t sampleSize = GetSampleSize(sample.mBuffer, isVorbis);
+
     if (buffer->capacity() < sampleSize) {
         return -ENOMEM;
     }
 
-    const uint8_t *src =
-        (const uint8_t *)info->mSample->data()
-            + info->mSample->range_offset();
+    CopySampleData(sample.mBuffer, isVorbis, buffer->data());
+    buffer->setRange(0, sampleSize);
 
-    memcpy((uint8_t *)buffer->data(), src, info->mSample->range_length());
+    return OK;
+}
 
-    if (info->mTrackFlags & kIsVorbis) {
-        int32_t numPageSamples;
-        if (!info->mSample->meta_data()->findInt32(
-                    kKeyValidSamples, &numPageSamples)) {
-            numPageSamples = -1;
-        }
+status_t NuMediaExtractor::readSampleData(sp<ABuffer> *buffer) {
+    Mutex::Autolock autoLock(mLock);
 
-        memcpy((uint8_t *)buffer->data() + info->mSample->range_length(),
-               &numPageSamples,
-               sizeof(numPageSamples));
+    *buffer = NULL;
+
+    ssize_t minIndex = fetchTrackSamples();
+
+    if (minIndex < 0) {
+        return ERROR_END_OF_STREAM;
     }
 
-    buffer->setRange(0, sampleSize);
+    TrackInfo *info = &mSelectedTracks.editItemAt(minIndex);
+    const Sample &sample = *info->mSamples.begin();
+
+    if (sample.mBuffer == NULL) {
+        *buffer = sample.mData;
+        return OK;
+    }
+
+    bool isVorbis = (info->mTrackFlags & kIsVorbis) != 0;
+    *buffer = new ABuffer(GetSampleSize(sample.mBuffer, isVorbis));
+    CopySampleData(sample.mBuffer, isVorbis, (*buffer)->data());
 
     return OK;
 }
@@ -451,7 +697,7 @@ status_t NuMediaExtractor::getSampleTime(int64_t *sampleTimeUs) {
     }
 
     TrackInfo *info = &mSelectedTracks.editItemAt(minIndex);
-    *sampleTimeUs = info->mSampleTimeUs;
+    *sampleTimeUs = (*info->mSamples.begin()).mTimeUs;
 
     return OK;
 }
@@ -468,7 +714,9 @@ status_t NuMediaExtractor::getSampleMeta(sp<MetaData> *sampleMeta) {
     }
 
     TrackInfo *info = &mSelectedTracks.editItemAt(minIndex);
-    *sampleMeta = info->mSample->meta_data();
+    const Sample &sample = *info->mSamples.begin();
+    *sampleMeta = sample.mBuffer != NULL
+        ? sample.mBuffer->meta_data() : sample.mMeta;
 
     return OK;
 }
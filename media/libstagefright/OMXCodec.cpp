@@ -21,7 +21,9 @@ Copyright (c) 2012, Code Aurora Forum. All rights reserved.
 
 //#define LOG_NDEBUG 0
 #define LOG_TAG "OMXCodec"
+#define ATRACE_TAG ATRACE_TAG_VIDEO
 #include <utils/Log.h>
+#include <utils/Trace.h>
 
 #include "include/AACEncoder.h"
 
@@ -42,6 +44,7 @@ Copyright (c) 2012, Code Aurora Forum. All rights reserved.
 #include <media/stagefright/OMXCodec.h>
 #include <media/stagefright/Utils.h>
 #include <media/stagefright/SkipCutBuffer.h>
+#include <utils/KeyedVector.h>
 #include <utils/Vector.h>
 #include <cutils/properties.h>
 
@@ -59,6 +62,30 @@ Copyright (c) 2012, Code Aurora Forum. All rights reserved.
 namespace android {
 
 #ifdef EXYNOS4_ENHANCEMENTS
+// Counters traced for every codec instance: the timestamps of the buffers
+// queued to and returned by the component, in ms, and the number of decoded
+// buffers waiting for read(). Indexed by [isVideo][isEncoder].
+struct CodecTraceNames {
+    const char *mInputTime;
+    const char *mOutputTime;
+    const char *mOutputQueued;
+};
+
+static const CodecTraceNames kCodecTraceNames[2][2] = {
+    {
+        { "Audio Decoder Input Time (ms)", "Audio Decoder Output Time (ms)",
+          "Audio Decoder Output Queued" },
+        { "Audio Encoder Input Time (ms)", "Audio Encoder Output Time (ms)",
+          "Audio Encoder Output Queued" },
+    },
+    {
+        { "Video Decoder Input Time (ms)", "Video Decoder Output Time (ms)",
+          "Video Decoder Output Queued" },
+        { "Video Encoder Input Time (ms)", "Video Encoder Output Time (ms)",
+          "Video Encoder Output Queued" },
+    },
+};
+
 static const int OMX_SEC_COLOR_FormatNV12TPhysicalAddress = 0x7F000001;
 static const int OMX_SEC_COLOR_FormatNV12LPhysicalAddress = 0x7F000002;
 static const int OMX_SEC_COLOR_FormatNV12LVirtualAddress = 0x7F000003;
@@ -509,6 +536,20 @@ sp<MediaSource> OMXCodec::Create(
 
             err = codec->configureCodec(meta);
 
+#ifndef QCOM_LEGACY_OMX
+            if (err == OK && createEncoder
+                    && (flags & kStoreMetaDataInVideoBuffers)) {
+                // Move on to the next encoder now rather than fail to
+                // allocate the input buffers of this one.
+                err = omx->storeMetaDataInBuffers(
+                        node, kPortIndexInput, OMX_TRUE);
+                if (err != OK) {
+                    ALOGW("'%s' does not take meta data in video buffers",
+                         componentName);
+                }
+            }
+#endif
+
             if (err == OK) {
                 if (!strcmp("OMX.Nvidia.mpeg2v.decode", componentName)) {
                     codec->mFlags |= kOnlySubmitOneInputBufferAtOneTime;
@@ -868,11 +909,30 @@ status_t OMXCodec::configureCodec(const sp<MetaData> &meta) {
         }
     }
 
+    if (!strcasecmp(MEDIA_MIMETYPE_IMAGE_JPEG, mMIME) && !mIsEncoder) {
+        // The whole image is submitted as a single input buffer.
+        int32_t width, height, compressedSize;
+        bool success = meta->findInt32(kKeyWidth, &width);
+        success = success && meta->findInt32(kKeyHeight, &height);
+        success = success && meta->findInt32(kKeyMaxInputSize, &compressedSize);
+        CHECK(success);
+
+        setJPEGInputFormat(width, height, (OMX_U32)compressedSize);
+        setImageOutputFormat(OMX_COLOR_Format16bitRGB565, width, height);
+    }
+
     int32_t maxInputSize;
     if (meta->findInt32(kKeyMaxInputSize, &maxInputSize)) {
         setMinBufferSize(kPortIndexInput, (OMX_U32)maxInputSize);
     }
 
+    if ((mFlags & kBatchAudioOutputBuffers)
+            && !mIsEncoder
+            && !strncasecmp(mMIME, "audio/", 6)
+            && !strncmp(mComponentName, "OMX.google.", 11)) {
+        enableBatchOutputBuffers();
+    }
+
     initOutputFormat(meta);
 #ifdef QCOM_HARDWARE
     if ((!strncasecmp(mMIME, "audio/", 6)) && (!strncmp(mComponentName, "OMX.qcom.", 9))) {
@@ -936,6 +996,57 @@ status_t OMXCodec::configureCodec(const sp<MetaData> &meta) {
     return OK;
 }
 
+// Output buffer counts learned from earlier instances of a component at a
+// given resolution, see updateOutputBufferCountHistory_l(). Only used if
+// the "media.stagefright.omx.adaptive-bufs" property is set to 1 or true.
+static Mutex gOutputBufferCountLock;
+static KeyedVector<String8, OMX_U32> gOutputBufferCounts;
+
+static const size_t kUnknownMinQueued = ~(size_t)0;
+
+static bool AdaptiveOutputBufferCountEnabled() {
+    char value[PROPERTY_VALUE_MAX];
+    return property_get("media.stagefright.omx.adaptive-bufs", value, NULL)
+        && (!strcmp(value, "1") || !strcasecmp(value, "true"));
+}
+
+void OMXCodec::enableBatchOutputBuffers() {
+    OMX_INDEXTYPE index;
+    status_t err = mOMX->getExtensionIndex(
+            mNode, "OMX.google.android.index.batchOutputBuffers", &index);
+
+    if (err != OK) {
+        CODEC_LOGV("component does not support batched output buffers");
+        return;
+    }
+
+    OMX_PARAM_U32TYPE params;
+    InitOMXParams(&params);
+    params.nPortIndex = kPortIndexOutput;
+    params.nU32 = 1;
+
+    err = mOMX->setParameter(mNode, index, &params, sizeof(params));
+
+    if (err != OK) {
+        CODEC_LOGE("failed to enable batched output buffers (err = %d)", err);
+        return;
+    }
+
+    OMX_PARAM_PORTDEFINITIONTYPE def;
+    InitOMXParams(&def);
+    def.nPortIndex = kPortIndexOutput;
+
+    err = mOMX->getParameter(
+            mNode, OMX_IndexParamPortDefinition, &def, sizeof(def));
+    CHECK_EQ(err, (status_t)OK);
+
+    // The decoder returns a buffer once it cannot take one more frame of
+    // the default buffer size, this leaves room for kNumBatchedFrames.
+    setMinBufferSize(kPortIndexOutput, def.nBufferSize * kNumBatchedFrames);
+
+    CODEC_LOGI("batching up to %d frames per output buffer", kNumBatchedFrames);
+}
+
 void OMXCodec::setMinBufferSize(OMX_U32 portIndex, OMX_U32 size) {
     OMX_PARAM_PORTDEFINITIONTYPE def;
     InitOMXParams(&def);
@@ -1799,6 +1910,13 @@ OMXCodec::OMXCodec(
 #endif
     mPortStatus[kPortIndexInput] = ENABLED;
     mPortStatus[kPortIndexOutput] = ENABLED;
+    mNumInputFramesCopied = 0;
+    mNumInputFramesShared = 0;
+    const CodecTraceNames &traceNames =
+        kCodecTraceNames[mIsVideo ? 1 : 0][mIsEncoder ? 1 : 0];
+    mInputTimeTraceName = traceNames.mInputTime;
+    mOutputTimeTraceName = traceNames.mOutputTime;
+    mOutputQueuedTraceName = traceNames.mOutputQueued;
 
     setComponentRole();
 }
@@ -1850,6 +1968,8 @@ void OMXCodec::setComponentRole(
             "audio_decoder.raw", "audio_encoder.raw" },
         { MEDIA_MIMETYPE_AUDIO_FLAC,
             "audio_decoder.flac", "audio_encoder.flac" },
+        { MEDIA_MIMETYPE_IMAGE_JPEG,
+            "image_decoder.jpeg", "image_encoder.jpeg" },
 #ifdef QCOM_HARDWARE
         { MEDIA_MIMETYPE_VIDEO_DIVX,
             "video_decoder.divx", NULL },
@@ -1990,6 +2110,71 @@ status_t OMXCodec::allocateBuffers() {
     return allocateBuffersOnPort(kPortIndexOutput);
 }
 
+void OMXCodec::resetOutputOccupancy_l() {
+    mOutputOccupancy.mNumWarmupReads = 0;
+    mOutputOccupancy.mNumReads = 0;
+    mOutputOccupancy.mNumStalls = 0;
+    mOutputOccupancy.mMinQueued = kUnknownMinQueued;
+    mOutputOccupancy.mTotalQueued = 0;
+}
+
+void OMXCodec::recordOutputOccupancy_l(bool stalled) {
+    // The decoder has to catch up after a start or seek.
+    static const size_t kNumWarmupReads = 8;
+
+    OutputOccupancy *occupancy = &mOutputOccupancy;
+    if (occupancy->mNumWarmupReads < kNumWarmupReads) {
+        ++occupancy->mNumWarmupReads;
+        return;
+    }
+
+    size_t queued = mFilledBuffers.size();
+
+    ++occupancy->mNumReads;
+    if (stalled) {
+        ++occupancy->mNumStalls;
+    } else if (queued < occupancy->mMinQueued) {
+        occupancy->mMinQueued = queued;
+    }
+    occupancy->mTotalQueued += queued;
+}
+
+void OMXCodec::updateOutputBufferCountHistory_l() {
+    // About ten seconds of video, shorter sessions say little.
+    static const size_t kMinNumReads = 300;
+    static const OMX_U32 kMaxNumOutputBuffers = 32;
+
+    const OutputOccupancy &occupancy = mOutputOccupancy;
+    if (mOutputBufferCountKey.isEmpty()
+            || occupancy.mNumReads < kMinNumReads) {
+        return;
+    }
+
+    // Add a buffer if more than 1% of the reads stalled. Otherwise drop the
+    // buffers that always held decoded frames, keeping one of them spare.
+    OMX_U32 numBuffers = mPortBuffers[kPortIndexOutput].size();
+    OMX_U32 newBufferCount = numBuffers;
+    if (occupancy.mNumStalls * 100 > occupancy.mNumReads) {
+        if (numBuffers < kMaxNumOutputBuffers) {
+            newBufferCount = numBuffers + 1;
+        }
+    } else if (occupancy.mMinQueued != kUnknownMinQueued
+            && occupancy.mMinQueued > 2) {
+        newBufferCount = numBuffers - (occupancy.mMinQueued - 2);
+    }
+
+    CODEC_LOGI("%lu output buffers: %d reads, %d stalled, "
+            "%.1f decoded buffers queued on average, at least %d",
+            numBuffers, occupancy.mNumReads, occupancy.mNumStalls,
+            (double)occupancy.mTotalQueued / occupancy.mNumReads,
+            occupancy.mMinQueued == kUnknownMinQueued ? 0 : occupancy.mMinQueued);
+
+    if (AdaptiveOutputBufferCountEnabled()) {
+        Mutex::Autolock autoLock(gOutputBufferCountLock);
+        gOutputBufferCounts.add(mOutputBufferCountKey, newBufferCount);
+    }
+}
+
 status_t OMXCodec::allocateBuffersOnPort(OMX_U32 portIndex) {
     if (mNativeWindow != NULL && portIndex == kPortIndexOutput) {
         return allocateOutputBuffersFromNativeWindow();
@@ -2398,8 +2583,34 @@ status_t OMXCodec::allocateOutputBuffersFromNativeWindow() {
     // XXX: Is this the right logic to use?  It's not clear to me what the OMX
     // buffer counts refer to - how do they account for the renderer holding on
     // to buffers?
-    if (def.nBufferCountActual < def.nBufferCountMin + minUndequeuedBufs) {
-        OMX_U32 newBufferCount = def.nBufferCountMin + minUndequeuedBufs;
+    OMX_U32 minBufferCount = def.nBufferCountMin + minUndequeuedBufs;
+    OMX_U32 newBufferCount = def.nBufferCountActual;
+    if (newBufferCount < minBufferCount) {
+        newBufferCount = minBufferCount;
+    }
+
+    mOutputBufferCountKey = String8::format(
+            "%s %lux%lu", mComponentName,
+            def.format.video.nFrameWidth, def.format.video.nFrameHeight);
+    resetOutputOccupancy_l();
+
+    if (AdaptiveOutputBufferCountEnabled()) {
+        Mutex::Autolock autoLock(gOutputBufferCountLock);
+
+        ssize_t index = gOutputBufferCounts.indexOfKey(mOutputBufferCountKey);
+        if (index >= 0) {
+            newBufferCount = gOutputBufferCounts.valueAt(index);
+            if (newBufferCount < minBufferCount) {
+                newBufferCount = minBufferCount;
+            }
+
+            CODEC_LOGI("using %lu output buffers learned from earlier "
+                    "playback instead of %lu",
+                    newBufferCount, def.nBufferCountActual);
+        }
+    }
+
+    if (newBufferCount != def.nBufferCountActual) {
         def.nBufferCountActual = newBufferCount;
         err = mOMX->setParameter(
                 mNode, OMX_IndexParamPortDefinition, &def, sizeof(def));
@@ -2917,6 +3128,10 @@ void OMXCodec::on_message(const omx_message &msg) {
 
                 mFilledBuffers.push_back(i);
                 mBufferFilled.signal();
+
+                ATRACE_INT(mOutputTimeTraceName,
+                        msg.u.extended_buffer_data.timestamp / 1000);
+                ATRACE_INT(mOutputQueuedTraceName, mFilledBuffers.size());
                 if (mIsEncoder) {
                     sched_yield();
                 }
@@ -3869,6 +4084,12 @@ bool OMXCodec::drainInputBuffer(BufferInfo *info) {
         CHECK(lastBufferTimeUs >= 0);
         if (mIsEncoder && mIsVideo) {
             mDecodingTimeList.push_back(lastBufferTimeUs);
+
+            if (releaseBuffer) {
+                ++mNumInputFramesCopied;
+            } else {
+                ++mNumInputFramesShared;
+            }
         }
 
         if (offset == 0) {
@@ -3954,6 +4175,8 @@ bool OMXCodec::drainInputBuffer(BufferInfo *info) {
                info->mBuffer, offset,
                timestampUs, timestampUs / 1E6);
 
+    ATRACE_INT(mInputTimeTraceName, timestampUs / 1000);
+
     err = mOMX->emptyBuffer(
             mNode, info->mBuffer, 0, offset,
             flags, timestampUs);
@@ -4050,6 +4273,7 @@ void OMXCodec::setState(State newState) {
 }
 
 status_t OMXCodec::waitForBufferFilled_l() {
+    ScopedTrace trace(ATRACE_TAG, "OMXCodec::waitForBufferFilled");
 
     if (mIsEncoder) {
         // For timelapse video recording, the timelapse video recording may
@@ -4461,7 +4685,7 @@ status_t OMXCodec::setWMAFormat(const sp<MetaData> &meta)
 }
 #endif
 void OMXCodec::setG711Format(int32_t numChannels) {
-    CHECK(!mIsEncoder);
+    // The PCM side of both the decoder and the encoder is the input port.
     setRawAudioFormat(kPortIndexInput, 8000, numChannels);
 }
 
@@ -4639,6 +4863,8 @@ status_t OMXCodec::start(MetaData *meta) {
     mTargetTimeUs = -1;
     mFilledBuffers.clear();
     mPaused = false;
+    mNumInputFramesCopied = 0;
+    mNumInputFramesShared = 0;
 
     return init();
 }
@@ -4652,6 +4878,18 @@ status_t OMXCodec::stop() {
         mAsyncCompletion.wait(mLock);
     }
 
+    updateOutputBufferCountHistory_l();
+
+    if (mIsEncoder && mIsVideo) {
+        CODEC_LOGI("%d input frames copied, %d passed by reference",
+                mNumInputFramesCopied, mNumInputFramesShared);
+        if ((mFlags & kStoreMetaDataInVideoBuffers)
+                && mNumInputFramesCopied > 0) {
+            ALOGW("[%s] %d input frames copied in meta data mode",
+                 mComponentName, mNumInputFramesCopied);
+        }
+    }
+
     bool isError = false;
 #ifdef QCOM_HARDWARE
     bool forceFlush = false;
@@ -4788,6 +5026,8 @@ sp<MetaData> OMXCodec::getFormat() {
 
 status_t OMXCodec::read(
         MediaBuffer **buffer, const ReadOptions *options) {
+    ScopedTrace trace(ATRACE_TAG, "OMXCodec::read");
+
     status_t err = OK;
     *buffer = NULL;
 
@@ -4847,6 +5087,7 @@ status_t OMXCodec::read(
         mSeekMode = seekMode;
 
         mFilledBuffers.clear();
+        mOutputOccupancy.mNumWarmupReads = 0;
 
         CHECK_EQ((int)mState, (int)EXECUTING);
 #ifdef QCOM_HARDWARE
@@ -4880,6 +5121,8 @@ status_t OMXCodec::read(
         }
     }
 
+    bool stalled = !seeking && !mNoMoreOutputData && mFilledBuffers.empty();
+
     while (mState != ERROR && !mNoMoreOutputData && mFilledBuffers.empty()) {
         if ((err = waitForBufferFilled_l()) != OK) {
             return err;
@@ -4905,8 +5148,13 @@ status_t OMXCodec::read(
         return INFO_FORMAT_CHANGED;
     }
 
+    if (!mOutputBufferCountKey.isEmpty()) {
+        recordOutputOccupancy_l(stalled);
+    }
+
     size_t index = *mFilledBuffers.begin();
     mFilledBuffers.erase(mFilledBuffers.begin());
+    ATRACE_INT(mOutputQueuedTraceName, mFilledBuffers.size());
 
     BufferInfo *info = &mPortBuffers[kPortIndexOutput].editItemAt(index);
     CHECK_EQ((int)info->mStatus, (int)OWNED_BY_US);
@@ -77,6 +77,11 @@ struct MyVorbisExtractor {
     status_t seekToOffset(off64_t offset);
     status_t readNextPacket(MediaBuffer **buffer);
 
+    // Once started, packets are read straight into the buffers of a
+    // MediaBufferGroup instead of a newly allocated MediaBuffer each.
+    void start();
+    void stop();
+
     status_t init();
 
     sp<MetaData> getFileMetaData() { return mFileMeta; }
@@ -97,6 +102,7 @@ private:
     };
 
     sp<DataSource> mSource;
+    MediaBufferGroup *mGroup;
     off64_t mOffset;
     Page mCurrentPage;
     uint64_t mPrevGranulePosition;
@@ -156,12 +162,14 @@ status_t OggSource::start(MetaData *params) {
         return INVALID_OPERATION;
     }
 
+    mExtractor->mImpl->start();
     mStarted = true;
 
     return OK;
 }
 
 status_t OggSource::stop() {
+    mExtractor->mImpl->stop();
     mStarted = false;
 
     return OK;
@@ -206,6 +214,7 @@ status_t OggSource::read(
 
 MyVorbisExtractor::MyVorbisExtractor(const sp<DataSource> &source)
     : mSource(source),
+      mGroup(NULL),
       mOffset(0),
       mPrevGranulePosition(0),
       mCurrentPageSize(0),
@@ -220,6 +229,8 @@ MyVorbisExtractor::MyVorbisExtractor(const sp<DataSource> &source)
 }
 
 MyVorbisExtractor::~MyVorbisExtractor() {
+    stop();
+
     vorbis_comment_clear(&mVc);
     vorbis_info_clear(&mVi);
 }
@@ -228,6 +239,24 @@ sp<MetaData> MyVorbisExtractor::getFormat() const {
     return mMeta;
 }
 
+void MyVorbisExtractor::start() {
+    if (mGroup != NULL) {
+        return;
+    }
+
+    // Larger than any audio packet in practice, the header packets that may
+    // not fit are read before the source is started.
+    const size_t kMaxPacketSize = 32768;
+
+    mGroup = new MediaBufferGroup;
+    mGroup->add_buffer(new MediaBuffer(kMaxPacketSize));
+}
+
+void MyVorbisExtractor::stop() {
+    delete mGroup;
+    mGroup = NULL;
+}
+
 status_t MyVorbisExtractor::findNextPage(
         off64_t startOffset, off64_t *pageOffset) {
     *pageOffset = startOffset;
@@ -478,12 +507,6 @@ status_t MyVorbisExtractor::readNextPacket(MediaBuffer **out) {
             size_t fullSize = packetSize;
             if (buffer != NULL) {
                 fullSize += buffer->range_length();
-            }
-            MediaBuffer *tmp = new MediaBuffer(fullSize);
-            if (buffer != NULL) {
-                memcpy(tmp->data(), buffer->data(), buffer->range_length());
-                tmp->set_range(0, buffer->range_length());
-                buffer->release();
             } else {
                 // XXX Not only is this not technically the correct time for
                 // this packet, we also stamp every packet in this page
@@ -495,9 +518,32 @@ status_t MyVorbisExtractor::readNextPacket(MediaBuffer **out) {
                     // Fortunately, the timestamp doesn't matter for those.
                     timeUs = mCurrentPage.mGranulePosition * 1000000ll / mVi.rate;
                 }
-                tmp->set_range(0, 0);
+
+                if (mGroup != NULL) {
+                    status_t err = mGroup->acquire_buffer(&buffer);
+                    if (err != OK) {
+                        return err;
+                    }
+                } else {
+                    buffer = new MediaBuffer(fullSize);
+                }
+                buffer->set_range(0, 0);
+            }
+
+            if (fullSize > buffer->size()) {
+                // The packet continues on the next page(s), move the part
+                // read so far to a buffer growing geometrically so that
+                // large packets are not copied again for every page.
+                size_t size = buffer->size() * 2;
+                if (size < fullSize) {
+                    size = fullSize;
+                }
+                MediaBuffer *tmp = new MediaBuffer(size);
+                memcpy(tmp->data(), buffer->data(), buffer->range_length());
+                tmp->set_range(0, buffer->range_length());
+                buffer->release();
+                buffer = tmp;
             }
-            buffer = tmp;
 
             ssize_t n = mSource->readAt(
                     dataOffset,
@@ -507,6 +553,7 @@ status_t MyVorbisExtractor::readNextPacket(MediaBuffer **out) {
             if (n < (ssize_t)packetSize) {
                 ALOGV("failed to read %d bytes at 0x%016llx, got %ld bytes",
                      packetSize, dataOffset, n);
+                buffer->release();
                 return ERROR_IO;
             }
 
@@ -70,6 +70,31 @@ status_t SampleIterator::seekTo(uint32_t sampleIndex) {
         return OK;
     }
 
+    if (mInitialized && sampleIndex == mCurrentSampleIndex + 1) {
+        // Sequential access within the current chunk, the next sample
+        // directly follows the current one.
+        uint32_t chunkRelativeSampleIndex =
+            (sampleIndex - mFirstChunkSampleIndex) % mSamplesPerChunk;
+
+        if (sampleIndex < mStopChunkSampleIndex
+                && chunkRelativeSampleIndex > 0) {
+            mCurrentSampleOffset += mCurrentSampleSize;
+            mCurrentSampleSize =
+                mCurrentChunkSampleSizes[chunkRelativeSampleIndex];
+
+            status_t err;
+            if ((err = findSampleTime(
+                            sampleIndex, &mCurrentSampleTime)) != OK) {
+                ALOGE("findSampleTime return error");
+                return err;
+            }
+
+            mCurrentSampleIndex = sampleIndex;
+
+            return OK;
+        }
+    }
+
     if (!mInitialized || sampleIndex < mFirstChunkSampleIndex) {
         reset();
     }
@@ -189,10 +214,10 @@ status_t SampleIterator::getChunkOffset(uint32_t chunk, off64_t *offset) {
     if (mTable->mChunkOffsetType == SampleTable::kChunkOffsetType32) {
         uint32_t offset32;
 
-        if (mTable->mDataSource->readAt(
+        if (mTable->readChunkOffsetData_l(
                     mTable->mChunkOffsetOffset + 8 + 4 * chunk,
                     &offset32,
-                    sizeof(offset32)) < (ssize_t)sizeof(offset32)) {
+                    sizeof(offset32)) != OK) {
             return ERROR_IO;
         }
 
@@ -201,10 +226,10 @@ status_t SampleIterator::getChunkOffset(uint32_t chunk, off64_t *offset) {
         CHECK_EQ(mTable->mChunkOffsetType, SampleTable::kChunkOffsetType64);
 
         uint64_t offset64;
-        if (mTable->mDataSource->readAt(
+        if (mTable->readChunkOffsetData_l(
                     mTable->mChunkOffsetOffset + 8 + 8 * chunk,
                     &offset64,
-                    sizeof(offset64)) < (ssize_t)sizeof(offset64)) {
+                    sizeof(offset64)) != OK) {
             return ERROR_IO;
         }
 
@@ -230,9 +255,9 @@ status_t SampleIterator::getSampleSizeDirect(
     switch (mTable->mSampleSizeFieldSize) {
         case 32:
         {
-            if (mTable->mDataSource->readAt(
+            if (mTable->readSampleSizeData_l(
                         mTable->mSampleSizeOffset + 12 + 4 * sampleIndex,
-                        size, sizeof(*size)) < (ssize_t)sizeof(*size)) {
+                        size, sizeof(*size)) != OK) {
                 return ERROR_IO;
             }
 
@@ -243,9 +268,9 @@ status_t SampleIterator::getSampleSizeDirect(
         case 16:
         {
             uint16_t x;
-            if (mTable->mDataSource->readAt(
+            if (mTable->readSampleSizeData_l(
                         mTable->mSampleSizeOffset + 12 + 2 * sampleIndex,
-                        &x, sizeof(x)) < (ssize_t)sizeof(x)) {
+                        &x, sizeof(x)) != OK) {
                 return ERROR_IO;
             }
 
@@ -256,9 +281,9 @@ status_t SampleIterator::getSampleSizeDirect(
         case 8:
         {
             uint8_t x;
-            if (mTable->mDataSource->readAt(
+            if (mTable->readSampleSizeData_l(
                         mTable->mSampleSizeOffset + 12 + sampleIndex,
-                        &x, sizeof(x)) < (ssize_t)sizeof(x)) {
+                        &x, sizeof(x)) != OK) {
                 return ERROR_IO;
             }
 
@@ -271,9 +296,9 @@ status_t SampleIterator::getSampleSizeDirect(
             CHECK_EQ(mTable->mSampleSizeFieldSize, 4);
 
             uint8_t x;
-            if (mTable->mDataSource->readAt(
+            if (mTable->readSampleSizeData_l(
                         mTable->mSampleSizeOffset + 12 + sampleIndex / 2,
-                        &x, sizeof(x)) < (ssize_t)sizeof(x)) {
+                        &x, sizeof(x)) != OK) {
                 return ERROR_IO;
             }
 
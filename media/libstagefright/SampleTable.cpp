@@ -15,6 +15,9 @@
  * limitations under the License.
  */
 
+#define __STDC_LIMIT_MACROS
+#include <stdint.h>
+
 #define LOG_TAG "SampleTable"
 //#define LOG_NDEBUG 0
 #include <utils/Log.h>
@@ -39,6 +42,13 @@ const uint32_t SampleTable::kSampleSizeType32 = FOURCC('s', 't', 's', 'z');
 // static
 const uint32_t SampleTable::kSampleSizeTypeCompact = FOURCC('s', 't', 'z', '2');
 
+// Size of the pages of the sample size and chunk offset tables read at once.
+static const size_t kTablePageSize = 4096;
+
+// findSampleAtTime() falls back to a table of all the samples sorted by
+// composition time if more samples than this need to be examined.
+static const uint32_t kMaxNumSamplesToSearch = 4096;
+
 ////////////////////////////////////////////////////////////////////////////////
 
 struct SampleTable::CompositionDeltaLookup {
@@ -119,10 +129,15 @@ SampleTable::SampleTable(const sp<DataSource> &source)
       mNumSampleSizes(0),
       mTimeToSampleCount(0),
       mTimeToSample(NULL),
+      mTimeToSampleRuns(NULL),
+      mNumTimeToSampleSamples(0),
+      mMaxTimeToSampleDelta(0),
       mSampleTimeEntries(NULL),
       mCompositionTimeDeltaEntries(NULL),
       mNumCompositionTimeDeltaEntries(0),
       mCompositionDeltaLookup(new CompositionDeltaLookup),
+      mMinCompositionTimeDelta(0),
+      mMaxCompositionTimeDelta(0),
       mSyncSampleOffset(-1),
       mNumSyncSamples(0),
       mSyncSamples(NULL),
@@ -150,6 +165,15 @@ SampleTable::~SampleTable() {
     delete[] mTimeToSample;
     mTimeToSample = NULL;
 
+    delete[] mTimeToSampleRuns;
+    mTimeToSampleRuns = NULL;
+
+    delete[] mSampleSizePage.mData;
+    mSampleSizePage.mData = NULL;
+
+    delete[] mChunkOffsetPage.mData;
+    mChunkOffsetPage.mData = NULL;
+
     delete mSampleIterator;
     mSampleIterator = NULL;
 }
@@ -355,6 +379,31 @@ status_t SampleTable::setTimeToSampleParams(
         mTimeToSample[i] = ntohl(mTimeToSample[i]);
     }
 
+    mTimeToSampleRuns = new TimeToSampleRun[mTimeToSampleCount];
+
+    uint64_t sampleIndex = 0;
+    uint64_t sampleTime = 0;
+    for (uint32_t i = 0; i < mTimeToSampleCount; ++i) {
+        if (sampleIndex > UINT32_MAX) {
+            return ERROR_MALFORMED;
+        }
+        mTimeToSampleRuns[i].mFirstSample = sampleIndex;
+        mTimeToSampleRuns[i].mFirstTime = sampleTime;
+
+        uint32_t n = mTimeToSample[2 * i];
+        uint32_t delta = mTimeToSample[2 * i + 1];
+        sampleIndex += n;
+        sampleTime += (uint64_t)n * delta;
+
+        if (delta > mMaxTimeToSampleDelta) {
+            mMaxTimeToSampleDelta = delta;
+        }
+    }
+    if (sampleIndex > UINT32_MAX) {
+        return ERROR_MALFORMED;
+    }
+    mNumTimeToSampleSamples = sampleIndex;
+
     return OK;
 }
 
@@ -401,6 +450,16 @@ status_t SampleTable::setCompositionTimeToSampleParams(
         mCompositionTimeDeltaEntries[i] = ntohl(mCompositionTimeDeltaEntries[i]);
     }
 
+    for (size_t i = 0; i < numEntries; ++i) {
+        uint32_t delta = mCompositionTimeDeltaEntries[2 * i + 1];
+        if (i == 0 || delta < mMinCompositionTimeDelta) {
+            mMinCompositionTimeDelta = delta;
+        }
+        if (i == 0 || delta > mMaxCompositionTimeDelta) {
+            mMaxCompositionTimeDelta = delta;
+        }
+    }
+
     mCompositionDeltaLookup->setEntries(
             mCompositionTimeDeltaEntries, mNumCompositionTimeDeltaEntries);
 
@@ -537,8 +596,152 @@ void SampleTable::buildSampleEntriesTable() {
           CompareIncreasingTime);
 }
 
+uint64_t SampleTable::getDecodingTime(uint32_t sampleIndex) const {
+    // Find the last run starting at or before sampleIndex.
+    uint32_t left = 0;
+    uint32_t right = mTimeToSampleCount;
+    while (right - left > 1) {
+        uint32_t center = left + (right - left) / 2;
+        if (mTimeToSampleRuns[center].mFirstSample <= sampleIndex) {
+            left = center;
+        } else {
+            right = center;
+        }
+    }
+
+    const TimeToSampleRun &run = mTimeToSampleRuns[left];
+    return run.mFirstTime
+        + (uint64_t)mTimeToSample[2 * left + 1] * (sampleIndex - run.mFirstSample);
+}
+
+uint32_t SampleTable::findFirstSampleAtDecodingTime(uint64_t time) const {
+    // Find the last run starting at or before time.
+    uint32_t left = 0;
+    uint32_t right = mTimeToSampleCount;
+    while (right - left > 1) {
+        uint32_t center = left + (right - left) / 2;
+        if (mTimeToSampleRuns[center].mFirstTime <= time) {
+            left = center;
+        } else {
+            right = center;
+        }
+    }
+
+    // Runs of zero duration samples all start at the same time, the first
+    // one of them holds the first sample at that time.
+    while (left > 0 && mTimeToSampleRuns[left - 1].mFirstTime == time) {
+        --left;
+    }
+
+    const TimeToSampleRun &run = mTimeToSampleRuns[left];
+    uint32_t count = mTimeToSample[2 * left];
+    uint32_t delta = mTimeToSample[2 * left + 1];
+    uint64_t offset = 0;
+    if (time > run.mFirstTime) {
+        offset = (delta > 0) ? (time - run.mFirstTime + delta - 1) / delta : count;
+    }
+    if (offset > count) {
+        offset = count;
+    }
+    return run.mFirstSample + offset;
+}
+
 status_t SampleTable::findSampleAtTime(
         uint64_t req_time, uint32_t *sample_index, uint32_t flags) {
+    if (mNumSampleSizes == 0 || mTimeToSampleCount == 0
+            || mNumTimeToSampleSamples < mNumSampleSizes) {
+        return findSampleAtTimeInTable(req_time, sample_index, flags);
+    }
+
+    // The composition time of a sample is its decoding time plus an offset
+    // in [minDelta, maxDelta]. The samples whose composition time is the
+    // closest to req_time on either side are thus decoded within spread of
+    // [req_time - maxDelta, req_time - minDelta], spread being the range of
+    // the offsets, give or take the duration of a sample.
+    const uint64_t minDelta = mMinCompositionTimeDelta;
+    const uint64_t maxDelta = mMaxCompositionTimeDelta;
+    const uint64_t margin = (maxDelta - minDelta) + mMaxTimeToSampleDelta;
+
+    uint64_t startTime = 0;
+    if (req_time > maxDelta + margin) {
+        startTime = req_time - maxDelta - margin;
+    }
+    uint64_t endTime = margin;
+    if (req_time + margin > minDelta && req_time + margin - minDelta > endTime) {
+        endTime = req_time + margin - minDelta;
+    }
+
+    uint32_t first = findFirstSampleAtDecodingTime(startTime);
+    uint32_t last = findFirstSampleAtDecodingTime(endTime + 1);
+    if (last > mNumSampleSizes) {
+        last = mNumSampleSizes;
+    }
+    if (first >= last || last - first > kMaxNumSamplesToSearch) {
+        return findSampleAtTimeInTable(req_time, sample_index, flags);
+    }
+
+    // The closest samples before (or at) and after (or at) req_time,
+    // and the first one in composition order.
+    bool hasBefore = false, hasAfter = false;
+    uint32_t beforeIndex = 0, afterIndex = 0, minIndex = first;
+    uint64_t beforeTime = 0, afterTime = 0, minTime = UINT64_MAX;
+
+    for (uint32_t i = first; i < last; ++i) {
+        uint64_t time = getDecodingTime(i)
+            + mCompositionDeltaLookup->getCompositionTimeOffset(i);
+
+        if (time <= req_time && (!hasBefore || time > beforeTime)) {
+            hasBefore = true;
+            beforeIndex = i;
+            beforeTime = time;
+        }
+        if (time >= req_time && (!hasAfter || time < afterTime)) {
+            hasAfter = true;
+            afterIndex = i;
+            afterTime = time;
+        }
+        if (time < minTime) {
+            minIndex = i;
+            minTime = time;
+        }
+    }
+
+    switch (flags) {
+        case kFlagBefore:
+        {
+            *sample_index = hasBefore ? beforeIndex : minIndex;
+            break;
+        }
+
+        case kFlagAfter:
+        {
+            if (!hasAfter) {
+                return ERROR_OUT_OF_RANGE;
+            }
+            *sample_index = afterIndex;
+            break;
+        }
+
+        default:
+        {
+            CHECK(flags == kFlagClosest);
+
+            if (!hasAfter || (hasBefore
+                    && abs_difference(afterTime, req_time)
+                        > abs_difference(beforeTime, req_time))) {
+                *sample_index = beforeIndex;
+            } else {
+                *sample_index = afterIndex;
+            }
+            break;
+        }
+    }
+
+    return OK;
+}
+
+status_t SampleTable::findSampleAtTimeInTable(
+        uint64_t req_time, uint32_t *sample_index, uint32_t flags) {
     buildSampleEntriesTable();
 
     uint32_t left = 0;
@@ -618,6 +821,52 @@ status_t SampleTable::findSampleAtTime(
     return OK;
 }
 
+status_t SampleTable::readTableData_l(
+        TablePage *page, off64_t tableOffset,
+        off64_t offset, void *data, size_t size) {
+    if (page->mData == NULL) {
+        page->mData = new uint8_t[kTablePageSize];
+    }
+
+    if (page->mOffset < 0
+            || offset < page->mOffset
+            || offset + (off64_t)size > page->mOffset + (off64_t)page->mSize) {
+        // Pages are aligned on the start of the table, so that an entry
+        // never straddles two pages.
+        off64_t pageOffset = tableOffset
+            + (offset - tableOffset) / kTablePageSize * kTablePageSize;
+
+        ssize_t n = mDataSource->readAt(pageOffset, page->mData, kTablePageSize);
+        if (n < 0) {
+            page->mOffset = -1;
+            return ERROR_IO;
+        }
+
+        page->mOffset = pageOffset;
+        page->mSize = n;
+
+        if (offset + (off64_t)size > pageOffset + n) {
+            return ERROR_IO;
+        }
+    }
+
+    memcpy(data, page->mData + (offset - page->mOffset), size);
+
+    return OK;
+}
+
+status_t SampleTable::readSampleSizeData_l(
+        off64_t offset, void *data, size_t size) {
+    return readTableData_l(
+            &mSampleSizePage, mSampleSizeOffset + 12, offset, data, size);
+}
+
+status_t SampleTable::readChunkOffsetData_l(
+        off64_t offset, void *data, size_t size) {
+    return readTableData_l(
+            &mChunkOffsetPage, mChunkOffsetOffset + 8, offset, data, size);
+}
+
 status_t SampleTable::findSyncSampleNear(
         uint32_t start_sample_index, uint32_t *sample_index, uint32_t flags) {
     Mutex::Autolock autoLock(mLock);
@@ -39,57 +39,66 @@ SkipCutBuffer::~SkipCutBuffer() {
 }
 
 void SkipCutBuffer::submit(MediaBuffer *buffer) {
-    int32_t offset = buffer->range_offset();
-    int32_t buflen = buffer->range_length();
-
-    // drop the initial data from the buffer if needed
-    if (mFrontPadding > 0) {
-        // still data left to drop
-        int32_t to_drop = (buflen < mFrontPadding) ? buflen : mFrontPadding;
-        offset += to_drop;
-        buflen -= to_drop;
-        buffer->set_range(offset, buflen);
-        mFrontPadding -= to_drop;
-    }
-
-
-    // append data to cutbuffer
-    char *src = ((char*) buffer->data()) + offset;
-    write(src, buflen);
-
-
-    // the mediabuffer is now empty. Fill it from cutbuffer, always leaving
-    // at least mBackPadding bytes in the cutbuffer
-    char *dst = (char*) buffer->data();
-    size_t copied = read(dst, buffer->size());
-    buffer->set_range(0, copied);
+    size_t offset = buffer->range_offset();
+    size_t length = buffer->range_length();
+    trim((char *)buffer->data(), &offset, &length);
+    buffer->set_range(offset, length);
 }
 
 void SkipCutBuffer::submit(const sp<ABuffer>& buffer) {
-    int32_t offset = buffer->offset();
-    int32_t buflen = buffer->size();
+    size_t offset = buffer->offset();
+    size_t length = buffer->size();
+    trim((char *)buffer->base(), &offset, &length);
+    buffer->setRange(offset, length);
+}
 
+void SkipCutBuffer::trim(char *base, size_t *offset, size_t *length) {
     // drop the initial data from the buffer if needed
     if (mFrontPadding > 0) {
         // still data left to drop
-        int32_t to_drop = (buflen < mFrontPadding) ? buflen : mFrontPadding;
-        offset += to_drop;
-        buflen -= to_drop;
-        buffer->setRange(offset, buflen);
+        size_t to_drop = (*length < (size_t)mFrontPadding) ? *length : mFrontPadding;
+        *offset += to_drop;
+        *length -= to_drop;
         mFrontPadding -= to_drop;
     }
 
+    if (mBackPadding == 0) {
+        // nothing is ever held back, the buffer goes out as it is
+        return;
+    }
+
+    // the cutbuffer holds at most mBackPadding bytes from earlier buffers,
+    // which have to go out in front of this buffer's data
+    size_t held = size();
 
-    // append data to cutbuffer
-    char *src = (char*) buffer->data();
-    write(src, buflen);
+    if (*length < (size_t)mBackPadding) {
+        // too little to hold back on its own, queue it behind the held
+        // data and hand out whatever exceeds mBackPadding
+        write(base + *offset, *length);
+        *length = read(base + *offset, *length);
+        return;
+    }
+
+    // hold back the last mBackPadding bytes of this buffer, and pass the
+    // rest through in place
+    size_t emit = *length - mBackPadding;
+    write(base + *offset + emit, mBackPadding);
+
+    size_t start;
+    if (*offset >= held) {
+        start = *offset - held;
+    } else {
+        // no room in front of the data for the held bytes
+        start = 0;
+        memmove(base + held, base + *offset, emit);
+    }
 
+    // the held data is at the front of the cutbuffer, ahead of what was
+    // just appended
+    CHECK_EQ(read(base + start, held), held);
 
-    // the mediabuffer is now empty. Fill it from cutbuffer, always leaving
-    // at least mBackPadding bytes in the cutbuffer
-    char *dst = (char*) buffer->base();
-    size_t copied = read(dst, buffer->capacity());
-    buffer->setRange(0, copied);
+    *offset = start;
+    *length = held + emit;
 }
 
 void SkipCutBuffer::clear() {
@@ -141,6 +150,7 @@ size_t SkipCutBuffer::read(char *dst, size_t num) {
     if (available < int32_t(num)) {
         num = available;
     }
+    size_t copied = num;
 
     size_t copyfirst = (mCapacity - mReadHead);
     if (copyfirst > num) copyfirst = num;
@@ -156,7 +166,7 @@ size_t SkipCutBuffer::read(char *dst, size_t num) {
             mReadHead += num;
         }
     }
-    return available;
+    return copied;
 }
 
 size_t SkipCutBuffer::size() {
@@ -27,6 +27,7 @@
 
 #include <media/mediametadataretriever.h>
 #include <private/media/VideoFrame.h>
+#include <utils/threads.h>
 
 // Sonivox includes
 #include <libsonivox/eas.h>
@@ -60,8 +61,43 @@ static bool FileHasAcceptableExtension(const char *extension) {
     return false;
 }
 
+// What scanning one file reported, to be replayed to the client.
+struct StagefrightMediaScanner::FileScan {
+    FileScan()
+        : mResult(MEDIA_SCAN_RESULT_SKIPPED),
+          mDone(false) {
+    }
+
+    MediaScanResult mResult;
+    bool mDone;
+    String8 mMimeType;
+    Vector<String8> mTagNames;
+    Vector<String8> mTagValues;
+
+    void addStringTag(const char *name, const char *value) {
+        mTagNames.push(String8(name));
+        mTagValues.push(String8(value));
+    }
+};
+
+// Files are handed out to the threads in order, but no thread starts on a
+// file more than this many files ahead of the one the client gets next.
+static const size_t kMaxScansAheadPerThread = 4;
+
+struct StagefrightMediaScanner::BatchScan {
+    const Vector<String8> *mPaths;
+
+    Mutex mLock;
+    Condition mCondition;
+    Vector<FileScan> mScans;
+    size_t mNextFile;
+    size_t mNextDelivery;
+    size_t mMaxScansAhead;
+    bool mAborted;
+};
+
 static MediaScanResult HandleMIDI(
-        const char *filename, MediaScannerClient *client) {
+        const char *filename, String8 *duration) {
     // get the library configuration and do sanity check
     const S_EAS_LIB_CONFIG* pLibConfig = EAS_Config();
     if ((pLibConfig == NULL) || (LIB_VERSION != pLibConfig->libVersion)) {
@@ -101,10 +137,7 @@ static MediaScanResult HandleMIDI(
 
     char buffer[20];
     sprintf(buffer, "%ld", temp);
-    status_t status = client->addStringTag("duration", buffer);
-    if (status != OK) {
-        return MEDIA_SCAN_RESULT_ERROR;
-    }
+    duration->setTo(buffer);
     return MEDIA_SCAN_RESULT_OK;
 }
 
@@ -113,24 +146,52 @@ MediaScanResult StagefrightMediaScanner::processFile(
         MediaScannerClient &client) {
     ALOGV("processFile '%s'.", path);
 
+    FileScan scan;
+    extractFileScan(path, new MediaMetadataRetriever, &scan);
+
+    return deliverFileScan(scan, client);
+}
+
+MediaScanResult StagefrightMediaScanner::deliverFileScan(
+        const FileScan &scan, MediaScannerClient &client) {
     client.setLocale(locale());
     client.beginFile();
-    MediaScanResult result = processFileInternal(path, mimeType, client);
+
+    MediaScanResult result = scan.mResult;
+
+    if (!scan.mMimeType.isEmpty()
+            && client.setMimeType(scan.mMimeType.string()) != OK) {
+        result = MEDIA_SCAN_RESULT_ERROR;
+    }
+
+    for (size_t i = 0;
+            result != MEDIA_SCAN_RESULT_ERROR && i < scan.mTagNames.size();
+            ++i) {
+        if (client.addStringTag(
+                    scan.mTagNames.itemAt(i).string(),
+                    scan.mTagValues.itemAt(i).string()) != OK) {
+            result = MEDIA_SCAN_RESULT_ERROR;
+        }
+    }
+
     client.endFile();
     return result;
 }
 
-MediaScanResult StagefrightMediaScanner::processFileInternal(
-        const char *path, const char *mimeType,
-        MediaScannerClient &client) {
+// static
+void StagefrightMediaScanner::extractFileScan(
+        const char *path, const sp<MediaMetadataRetriever> &retriever,
+        FileScan *scan) {
+    scan->mResult = MEDIA_SCAN_RESULT_SKIPPED;
+
     const char *extension = strrchr(path, '.');
 
     if (!extension) {
-        return MEDIA_SCAN_RESULT_SKIPPED;
+        return;
     }
 
     if (!FileHasAcceptableExtension(extension)) {
-        return MEDIA_SCAN_RESULT_SKIPPED;
+        return;
     }
 
     if (!strcasecmp(extension, ".mid")
@@ -142,32 +203,33 @@ MediaScanResult StagefrightMediaScanner::processFileInternal(
             || !strcasecmp(extension, ".rtx")
             || !strcasecmp(extension, ".ota")
             || !strcasecmp(extension, ".mxmf")) {
-        return HandleMIDI(path, &client);
+        String8 duration;
+        scan->mResult = HandleMIDI(path, &duration);
+        if (scan->mResult == MEDIA_SCAN_RESULT_OK) {
+            scan->addStringTag("duration", duration.string());
+        }
+        return;
     }
 
-    sp<MediaMetadataRetriever> mRetriever(new MediaMetadataRetriever);
-
     int fd = open(path, O_RDONLY | O_LARGEFILE);
     status_t status;
     if (fd < 0) {
         // couldn't open it locally, maybe the media server can?
-        status = mRetriever->setDataSource(path);
+        status = retriever->setDataSource(path);
     } else {
-        status = mRetriever->setDataSource(fd, 0, 0x7ffffffffffffffL);
+        status = retriever->setDataSource(fd, 0, 0x7ffffffffffffffL);
         close(fd);
     }
 
     if (status) {
-        return MEDIA_SCAN_RESULT_ERROR;
+        scan->mResult = MEDIA_SCAN_RESULT_ERROR;
+        return;
     }
 
     const char *value;
-    if ((value = mRetriever->extractMetadata(
+    if ((value = retriever->extractMetadata(
                     METADATA_KEY_MIMETYPE)) != NULL) {
-        status = client.setMimeType(value);
-        if (status) {
-            return MEDIA_SCAN_RESULT_ERROR;
-        }
+        scan->mMimeType.setTo(value);
     }
 
     struct KeyMap {
@@ -195,15 +257,130 @@ MediaScanResult StagefrightMediaScanner::processFileInternal(
 
     for (size_t i = 0; i < kNumEntries; ++i) {
         const char *value;
-        if ((value = mRetriever->extractMetadata(kKeyMap[i].key)) != NULL) {
-            status = client.addStringTag(kKeyMap[i].tag, value);
-            if (status != OK) {
-                return MEDIA_SCAN_RESULT_ERROR;
+        if ((value = retriever->extractMetadata(kKeyMap[i].key)) != NULL) {
+            scan->addStringTag(kKeyMap[i].tag, value);
+        }
+    }
+
+    scan->mResult = MEDIA_SCAN_RESULT_OK;
+}
+
+MediaScanResult StagefrightMediaScanner::processFiles(
+        const Vector<String8> &paths, MediaScannerClient &client,
+        size_t maxThreads) {
+    const size_t numFiles = paths.size();
+
+    size_t numThreads = maxThreads > 0 ? maxThreads : 1;
+    if (numThreads > numFiles) {
+        numThreads = numFiles;
+    }
+
+    if (numThreads <= 1) {
+        return MediaScanner::processFiles(paths, client, maxThreads);
+    }
+
+    ALOGV("processFiles %d files on %d threads", numFiles, numThreads);
+
+    BatchScan batch;
+    batch.mPaths = &paths;
+    batch.mScans.insertAt(FileScan(), 0, numFiles);
+    batch.mNextFile = 0;
+    batch.mNextDelivery = 0;
+    batch.mMaxScansAhead = numThreads * kMaxScansAheadPerThread;
+    batch.mAborted = false;
+
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_JOINABLE);
+
+    Vector<pthread_t> threads;
+    for (size_t i = 0; i < numThreads; ++i) {
+        pthread_t thread;
+        if (pthread_create(&thread, &attr, BatchThreadWrapper, &batch) != 0) {
+            ALOGW("unable to start media scanner thread");
+            break;
+        }
+        threads.push(thread);
+    }
+
+    pthread_attr_destroy(&attr);
+
+    if (threads.isEmpty()) {
+        return MediaScanner::processFiles(paths, client, maxThreads);
+    }
+
+    MediaScanResult result = MEDIA_SCAN_RESULT_OK;
+
+    {
+        Mutex::Autolock autoLock(batch.mLock);
+
+        while (batch.mNextDelivery < numFiles) {
+            while (!batch.mScans.itemAt(batch.mNextDelivery).mDone) {
+                batch.mCondition.wait(batch.mLock);
+            }
+
+            FileScan scan = batch.mScans.itemAt(batch.mNextDelivery);
+            batch.mScans.editItemAt(batch.mNextDelivery) = FileScan();
+            ++batch.mNextDelivery;
+            batch.mCondition.broadcast();
+
+            batch.mLock.unlock();
+            MediaScanResult fileResult = deliverFileScan(scan, client);
+            batch.mLock.lock();
+
+            if (fileResult == MEDIA_SCAN_RESULT_ERROR) {
+                result = MEDIA_SCAN_RESULT_ERROR;
+                batch.mAborted = true;
+                batch.mCondition.broadcast();
+                break;
             }
         }
     }
 
-    return MEDIA_SCAN_RESULT_OK;
+    for (size_t i = 0; i < threads.size(); ++i) {
+        void *dummy;
+        pthread_join(threads.itemAt(i), &dummy);
+    }
+
+    return result;
+}
+
+// static
+void *StagefrightMediaScanner::BatchThreadWrapper(void *me) {
+    BatchScan *batch = static_cast<BatchScan *>(me);
+    const size_t numFiles = batch->mPaths->size();
+
+    // Every file this thread scans goes through the same connection to the
+    // media server.
+    sp<MediaMetadataRetriever> retriever = new MediaMetadataRetriever;
+
+    Mutex::Autolock autoLock(batch->mLock);
+
+    for (;;) {
+        while (!batch->mAborted && batch->mNextFile < numFiles
+                && batch->mNextFile
+                    >= batch->mNextDelivery + batch->mMaxScansAhead) {
+            batch->mCondition.wait(batch->mLock);
+        }
+
+        if (batch->mAborted || batch->mNextFile >= numFiles) {
+            break;
+        }
+
+        size_t index = batch->mNextFile++;
+        const char *path = batch->mPaths->itemAt(index).string();
+
+        batch->mLock.unlock();
+        FileScan scan;
+        extractFileScan(path, retriever, &scan);
+        scan.mDone = true;
+        batch->mLock.lock();
+
+        batch->mScans.editItemAt(index) = scan;
+        batch->mCondition.broadcast();
+    }
+
+    return NULL;
 }
 
 char *StagefrightMediaScanner::extractAlbumArt(int fd) {
@@ -23,6 +23,7 @@ Copyright (c) 2012, Code Aurora Forum. All rights reserved.
 #include <utils/Log.h>
 
 #include "include/StagefrightMetadataRetriever.h"
+#include "include/JPEGDecoder.h"
 
 #include <media/stagefright/foundation/ADebug.h>
 #include <media/stagefright/ColorConverter.h>
@@ -33,14 +34,26 @@ Copyright (c) 2012, Code Aurora Forum. All rights reserved.
 #include <media/stagefright/OMXCodec.h>
 #include <media/stagefright/MediaDefs.h>
 #include <cutils/properties.h>
+#include <unistd.h>
 
 namespace android {
 
 StagefrightMetadataRetriever::StagefrightMetadataRetriever()
-    : mParsedMetaData(false),
-      mAlbumArt(NULL) {
+    : mExtractorIsMetadataOnly(false),
+      mParsedMetaData(false),
+      mAlbumArt(NULL),
+      mAlbumArtOffset(0),
+      mAlbumArtSize(0),
+      mAlbumArtScaled(false),
+      mThumbnailMaxDimension(0) {
     ALOGV("StagefrightMetadataRetriever()");
 
+    char value[PROPERTY_VALUE_MAX];
+    if (property_get("media.stagefright.thumbnail-size", value, NULL)
+            && atoi(value) > 0) {
+        mThumbnailMaxDimension = atoi(value);
+    }
+
     DataSource::RegisterDefaultSniffers();
     CHECK_EQ(mClient.connect(), (status_t)OK);
 }
@@ -48,6 +61,8 @@ StagefrightMetadataRetriever::StagefrightMetadataRetriever()
 StagefrightMetadataRetriever::~StagefrightMetadataRetriever() {
     ALOGV("~StagefrightMetadataRetriever()");
 
+    clearThumbnailDecoder();
+
     delete mAlbumArt;
     mAlbumArt = NULL;
 
@@ -58,10 +73,14 @@ status_t StagefrightMetadataRetriever::setDataSource(
         const char *uri, const KeyedVector<String8, String8> *headers) {
     ALOGV("setDataSource(%s)", uri);
 
+    clearThumbnailDecoder();
+
     mParsedMetaData = false;
     mMetaData.clear();
     delete mAlbumArt;
     mAlbumArt = NULL;
+    mAlbumArtSize = 0;
+    mAlbumArtScaled = false;
 
     mSource = DataSource::CreateFromURI(uri, headers);
 
@@ -70,7 +89,11 @@ status_t StagefrightMetadataRetriever::setDataSource(
         return UNKNOWN_ERROR;
     }
 
-    mExtractor = MediaExtractor::Create(mSource);
+    // Most clients only want the metadata, a full extractor is created
+    // once a frame is asked for.
+    mExtractor = MediaExtractor::Create(
+            mSource, NULL, MediaExtractor::kMetadataOnly);
+    mExtractorIsMetadataOnly = true;
 
     if (mExtractor == NULL) {
         ALOGE("Unable to instantiate an extractor for '%s'.", uri);
@@ -90,10 +113,14 @@ status_t StagefrightMetadataRetriever::setDataSource(
 
     ALOGV("setDataSource(%d, %lld, %lld)", fd, offset, length);
 
+    clearThumbnailDecoder();
+
     mParsedMetaData = false;
     mMetaData.clear();
     delete mAlbumArt;
     mAlbumArt = NULL;
+    mAlbumArtSize = 0;
+    mAlbumArtScaled = false;
 
     mSource = new FileSource(fd, offset, length);
 
@@ -104,7 +131,11 @@ status_t StagefrightMetadataRetriever::setDataSource(
         return err;
     }
 
-    mExtractor = MediaExtractor::Create(mSource);
+    // Most clients only want the metadata, a full extractor is created
+    // once a frame is asked for.
+    mExtractor = MediaExtractor::Create(
+            mSource, NULL, MediaExtractor::kMetadataOnly);
+    mExtractorIsMetadataOnly = true;
 
     if (mExtractor == NULL) {
         mSource.clear();
@@ -115,29 +146,27 @@ status_t StagefrightMetadataRetriever::setDataSource(
     return OK;
 }
 
-static VideoFrame *extractVideoFrameWithCodecFlags(
-        OMXClient *client,
-        const sp<MetaData> &trackMeta,
-        const sp<MediaSource> &source,
-        uint32_t flags,
-        int64_t frameTimeUs,
-        int seekMode) {
-    sp<MediaSource> decoder =
-        OMXCodec::Create(
-                client->interface(), source->getFormat(), false, source,
-                NULL, flags | OMXCodec::kClientNeedsFramebuffer);
+// Upper bound on the threads converting a thumbnail to RGB.
+static const size_t kMaxConversionThreads = 4;
 
-    if (decoder.get() == NULL) {
-        ALOGV("unable to instantiate video decoder.");
+// Scales |size| by |num| / |denom|, keeping it even and at least 2 so that
+// every pixel pair of the converted frame is complete.
+static int32_t scaleFrameDimension(int32_t size, int32_t num, int32_t denom) {
+    int32_t scaled = (int32_t)((int64_t)size * num / denom) & ~1;
 
-        return NULL;
-    }
+    return scaled < 2 ? 2 : scaled;
+}
 
-    status_t err = decoder->start();
-    if (err != OK) {
-        ALOGW("OMXCodec::start returned error %d (0x%08x)\n", err, err);
-        return NULL;
-    }
+// Seeks the started |decoder| and converts the frame it returns, scaled
+// down to fit |maxDimension| pixels if that is positive. The decoder is
+// left running.
+static VideoFrame *extractVideoFrameFromDecoder(
+        const sp<MediaSource> &decoder,
+        const sp<MetaData> &trackMeta,
+        int64_t frameTimeUs,
+        int seekMode,
+        int32_t maxDimension) {
+    status_t err;
 
     // Read one output buffer, ignore format change notifications
     // and spurious empty buffers.
@@ -180,7 +209,6 @@ static VideoFrame *extractVideoFrameWithCodecFlags(
         CHECK(buffer == NULL);
 
         ALOGV("decoding frame failed.");
-        decoder->stop();
 
         return NULL;
     }
@@ -196,8 +224,6 @@ static VideoFrame *extractVideoFrameWithCodecFlags(
         buffer->release();
         buffer = NULL;
 
-        decoder->stop();
-
         return NULL;
     }
 
@@ -233,18 +259,41 @@ static VideoFrame *extractVideoFrameWithCodecFlags(
         rotationAngle = 0;  // By default, no rotation
     }
 
+    int32_t srcFormat;
+    CHECK(meta->findInt32(kKeyColorFormat, &srcFormat));
+
+    ColorConverter converter(
+            (OMX_COLOR_FORMATTYPE)srcFormat, OMX_COLOR_Format16bitRGB565);
+
     VideoFrame *frame = new VideoFrame;
     frame->mWidth = crop_right - crop_left + 1;
     frame->mHeight = crop_bottom - crop_top + 1;
+
+    // In thumbnail mode the conversion does the downscaling that would
+    // otherwise be done on the full size frame by the caller.
+    int32_t scaleNum = 1;
+    int32_t scaleDenom = 1;
+    int32_t longerSide =
+        frame->mWidth > frame->mHeight ? frame->mWidth : frame->mHeight;
+    if (maxDimension > 0 && longerSide > maxDimension
+            && converter.supportsScaling()) {
+        scaleNum = maxDimension;
+        scaleDenom = longerSide;
+
+        frame->mWidth = scaleFrameDimension(frame->mWidth, scaleNum, scaleDenom);
+        frame->mHeight =
+            scaleFrameDimension(frame->mHeight, scaleNum, scaleDenom);
+
+        ALOGV("scaling %dx%d frame to %dx%d",
+             crop_right - crop_left + 1, crop_bottom - crop_top + 1,
+             frame->mWidth, frame->mHeight);
+    }
+
     frame->mDisplayWidth = frame->mWidth;
     frame->mDisplayHeight = frame->mHeight;
 #ifndef QCOM_HARDWARE
     frame->mSize = frame->mWidth * frame->mHeight * 2;
 #else
-
-    int32_t srcFormat;
-    CHECK(meta->findInt32(kKeyColorFormat, &srcFormat));
-
     frame_width_rounded = frame->mWidth;
     switch (srcFormat) {
         case OMX_QCOM_COLOR_FormatYVU420SemiPlanar:
@@ -265,19 +314,22 @@ static VideoFrame *extractVideoFrameWithCodecFlags(
 
     int32_t displayWidth, displayHeight;
     if (meta->findInt32(kKeyDisplayWidth, &displayWidth)) {
-        frame->mDisplayWidth = displayWidth;
+        frame->mDisplayWidth =
+            (int32_t)((int64_t)displayWidth * scaleNum / scaleDenom);
     }
     if (meta->findInt32(kKeyDisplayHeight, &displayHeight)) {
-        frame->mDisplayHeight = displayHeight;
+        frame->mDisplayHeight =
+            (int32_t)((int64_t)displayHeight * scaleNum / scaleDenom);
     }
 
-#ifndef QCOM_HARDWARE
-    int32_t srcFormat;
-    CHECK(meta->findInt32(kKeyColorFormat, &srcFormat));
-#endif
-
-    ColorConverter converter(
-            (OMX_COLOR_FORMATTYPE)srcFormat, OMX_COLOR_Format16bitRGB565);
+    // Thumbnails of HD content are large enough to be worth spreading
+    // the conversion over a few cores.
+    long numCores = sysconf(_SC_NPROCESSORS_ONLN);
+    size_t numThreads = numCores > 1 ? (size_t)numCores : 1;
+    if (numThreads > kMaxConversionThreads) {
+        numThreads = kMaxConversionThreads;
+    }
+    converter.setNumThreads(numThreads);
 
     if (converter.isValid()) {
         err = converter.convert(
@@ -303,8 +355,6 @@ static VideoFrame *extractVideoFrameWithCodecFlags(
     buffer->release();
     buffer = NULL;
 
-    decoder->stop();
-
     if (err != OK) {
         ALOGE("Colorconverter failed to convert frame.");
 
@@ -315,6 +365,46 @@ static VideoFrame *extractVideoFrameWithCodecFlags(
     return frame;
 }
 
+static VideoFrame *extractVideoFrameWithCodecFlags(
+        OMXClient *client,
+        const sp<MetaData> &trackMeta,
+        const sp<MediaSource> &source,
+        uint32_t flags,
+        int64_t frameTimeUs,
+        int seekMode,
+        int32_t maxDimension,
+        sp<MediaSource> *keepDecoder) {
+    sp<MediaSource> decoder =
+        OMXCodec::Create(
+                client->interface(), source->getFormat(), false, source,
+                NULL, flags | OMXCodec::kClientNeedsFramebuffer);
+
+    if (decoder.get() == NULL) {
+        ALOGV("unable to instantiate video decoder.");
+
+        return NULL;
+    }
+
+    status_t err = decoder->start();
+    if (err != OK) {
+        ALOGW("OMXCodec::start returned error %d (0x%08x)\n", err, err);
+        return NULL;
+    }
+
+    VideoFrame *frame = extractVideoFrameFromDecoder(
+            decoder, trackMeta, frameTimeUs, seekMode, maxDimension);
+
+    // A decoder that produced a frame can be handed on to serve the next
+    // request on the same track with just a seek.
+    if (frame != NULL && keepDecoder != NULL) {
+        *keepDecoder = decoder;
+    } else {
+        decoder->stop();
+    }
+
+    return frame;
+}
+
 VideoFrame *StagefrightMetadataRetriever::getFrameAtTime(
         int64_t timeUs, int option) {
 
@@ -338,6 +428,22 @@ VideoFrame *StagefrightMetadataRetriever::getFrameAtTime(
         return NULL;
     }
 
+    if (mThumbnailDecoder != NULL) {
+        VideoFrame *frame = extractVideoFrameFromDecoder(
+                mThumbnailDecoder, mThumbnailTrackMeta, timeUs, option,
+                mThumbnailMaxDimension);
+
+        if (frame != NULL) {
+            return frame;
+        }
+
+        ALOGV("kept decoder failed to extract a frame, starting a new one.");
+        clearThumbnailDecoder();
+    }
+
+    sp<MediaSource> *keepDecoder =
+        mThumbnailMaxDimension > 0 ? &mThumbnailDecoder : NULL;
+
     size_t n = mExtractor->countTracks();
     size_t i;
     for (i = 0; i < n; ++i) {
@@ -356,11 +462,22 @@ VideoFrame *StagefrightMetadataRetriever::getFrameAtTime(
         return NULL;
     }
 
+    sp<MediaSource> source = mExtractor->getTrack(i);
+
+    if (source.get() == NULL && mExtractorIsMetadataOnly) {
+        // The metadata only extractor doesn't hand out its tracks.
+        mExtractorIsMetadataOnly = false;
+
+        sp<MediaExtractor> extractor = MediaExtractor::Create(mSource);
+        if (extractor != NULL) {
+            mExtractor = extractor;
+            source = mExtractor->getTrack(i);
+        }
+    }
+
     sp<MetaData> trackMeta = mExtractor->getTrackMetaData(
             i, MediaExtractor::kIncludeExtensiveMetaData);
 
-    sp<MediaSource> source = mExtractor->getTrack(i);
-
     if (source.get() == NULL) {
         ALOGV("unable to instantiate video track.");
         return NULL;
@@ -381,7 +498,7 @@ VideoFrame *StagefrightMetadataRetriever::getFrameAtTime(
     VideoFrame *frame =
         extractVideoFrameWithCodecFlags(
                 &mClient, trackMeta, source, OMXCodec::kPreferSoftwareCodecs,
-                timeUs, option);
+                timeUs, option, mThumbnailMaxDimension, keepDecoder);
 #else
     const char *mime;
     bool success = trackMeta->findCString(kKeyMIMEType, &mime);
@@ -405,7 +522,7 @@ VideoFrame *StagefrightMetadataRetriever::getFrameAtTime(
         else {
             frame = extractVideoFrameWithCodecFlags(
                 &mClient, trackMeta, source, OMXCodec::kSoftwareCodecsOnly,
-                timeUs, option);
+                timeUs, option, mThumbnailMaxDimension, keepDecoder);
             if (frame == NULL){
                 // remake source to ensure its stopped before we start it
                 source.clear();
@@ -435,11 +552,25 @@ VideoFrame *StagefrightMetadataRetriever::getFrameAtTime(
 #endif
         frame = extractVideoFrameWithCodecFlags(&mClient, trackMeta,
                     source, flags,
-                    timeUs, option);
+                    timeUs, option, mThumbnailMaxDimension, keepDecoder);
     }
+
+    if (mThumbnailDecoder != NULL) {
+        mThumbnailTrackMeta = trackMeta;
+    }
+
     return frame;
 }
 
+void StagefrightMetadataRetriever::clearThumbnailDecoder() {
+    if (mThumbnailDecoder != NULL) {
+        mThumbnailDecoder->stop();
+        mThumbnailDecoder.clear();
+    }
+
+    mThumbnailTrackMeta.clear();
+}
+
 MediaAlbumArt *StagefrightMetadataRetriever::extractAlbumArt() {
     ALOGV("extractAlbumArt (extractor: %s)", mExtractor.get() != NULL ? "YES" : "NO");
 
@@ -453,6 +584,25 @@ MediaAlbumArt *StagefrightMetadataRetriever::extractAlbumArt() {
         mParsedMetaData = true;
     }
 
+    if (mAlbumArt == NULL && mAlbumArtSize > 0) {
+        mAlbumArt = readAlbumArt();
+        mAlbumArtSize = 0;
+    }
+
+    if (mAlbumArt != NULL && mThumbnailMaxDimension > 0 && !mAlbumArtScaled) {
+        // Hand out a small JPEG that is cheap to decode again, instead of
+        // a full size cover.
+        JPEGDecoder decoder(mClient.interface());
+        MediaAlbumArt *thumbnail =
+            decoder.createThumbnail(*mAlbumArt, mThumbnailMaxDimension);
+
+        if (thumbnail != NULL) {
+            delete mAlbumArt;
+            mAlbumArt = thumbnail;
+        }
+        mAlbumArtScaled = true;
+    }
+
     if (mAlbumArt) {
         return new MediaAlbumArt(*mAlbumArt);
     }
@@ -460,6 +610,30 @@ MediaAlbumArt *StagefrightMetadataRetriever::extractAlbumArt() {
     return NULL;
 }
 
+// Larger pictures are more likely to be garbage than cover art.
+static const size_t kMaxAlbumArtSize = 16 * 1024 * 1024;
+
+MediaAlbumArt *StagefrightMetadataRetriever::readAlbumArt() {
+    if (mAlbumArtSize > kMaxAlbumArtSize) {
+        ALOGW("ignoring album art of size %d", mAlbumArtSize);
+        return NULL;
+    }
+
+    MediaAlbumArt *art = new MediaAlbumArt;
+    art->mSize = mAlbumArtSize;
+    art->mData = new uint8_t[mAlbumArtSize];
+
+    if (mSource->readAt(mAlbumArtOffset, art->mData, mAlbumArtSize)
+            != (ssize_t)mAlbumArtSize) {
+        ALOGW("unable to read album art at offset %lld", mAlbumArtOffset);
+
+        delete art;
+        art = NULL;
+    }
+
+    return art;
+}
+
 const char *StagefrightMetadataRetriever::extractMetadata(int keyCode) {
     if (mExtractor == NULL) {
         return NULL;
@@ -521,12 +695,20 @@ void StagefrightMetadataRetriever::parseMetaData() {
     const void *data;
     uint32_t type;
     size_t dataSize;
+    int64_t albumArtOffset;
+    int32_t albumArtSize;
     if (meta->findData(kKeyAlbumArt, &type, &data, &dataSize)
             && mAlbumArt == NULL) {
         mAlbumArt = new MediaAlbumArt;
         mAlbumArt->mSize = dataSize;
         mAlbumArt->mData = new uint8_t[dataSize];
         memcpy(mAlbumArt->mData, data, dataSize);
+    } else if (meta->findInt64(kKeyAlbumArtOffset, &albumArtOffset)
+            && meta->findInt32(kKeyAlbumArtSize, &albumArtSize)
+            && albumArtSize > 0) {
+        // Read by extractAlbumArt(), the scanner doesn't ask for it.
+        mAlbumArtOffset = albumArtOffset;
+        mAlbumArtSize = albumArtSize;
     }
 
     size_t numTracks = mExtractor->countTracks();
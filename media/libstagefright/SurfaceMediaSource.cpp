@@ -48,6 +48,10 @@ SurfaceMediaSource::SurfaceMediaSource(uint32_t bufferWidth, uint32_t bufferHeig
     mStopped(false),
     mNumFramesReceived(0),
     mNumFramesEncoded(0),
+    mMaxFrameRate(0),
+    mNumFramesDropped(0),
+    mTotalQueueLatencyUs(0),
+    mMaxQueueLatencyUs(0),
     mFirstFrameTimestamp(0)
 #ifdef QCOM_HARDWARE
     ,mFirstBufferReleased(true)
@@ -97,6 +101,12 @@ SurfaceMediaSource::~SurfaceMediaSource() {
 #endif
     }
 
+    for (size_t i = 0; i < mFreeMetadataBuffers.size(); ++i) {
+        MediaBuffer *buffer = mFreeMetadataBuffers.itemAt(i);
+        buffer->setObserver(0);
+        buffer->release();
+    }
+    mFreeMetadataBuffers.clear();
 }
 
 nsecs_t SurfaceMediaSource::getTimestamp() {
@@ -138,6 +148,23 @@ status_t SurfaceMediaSource::setFrameRate(int32_t fps)
     return OK;
 }
 
+status_t SurfaceMediaSource::setMaxFrameRate(int32_t fps)
+{
+    Mutex::Autolock lock(mMutex);
+    if (fps < 0) {
+        return BAD_VALUE;
+    }
+    mMaxFrameRate = fps;
+    return OK;
+}
+
+status_t SurfaceMediaSource::setLowLatencyMode(bool enable)
+{
+    ALOGV("setLowLatencyMode: %d", enable);
+    Mutex::Autolock lock(mMutex);
+    return mBufferQueue->setSynchronousMode(!enable);
+}
+
 bool SurfaceMediaSource::isMetaDataStoredInVideoBuffers() const {
     ALOGV("isMetaDataStoredInVideoBuffers");
     return true;
@@ -170,6 +197,12 @@ status_t SurfaceMediaSource::reset()
     // TODO: Add waiting on mFrameCompletedCondition here?
     mStopped = true;
 
+    if (mNumFramesEncoded > 0) {
+        ALOGI("%d frames encoded, %d dropped, queue latency avg %lld us,"
+              " max %lld us", mNumFramesEncoded, mNumFramesDropped,
+              mTotalQueueLatencyUs / mNumFramesEncoded, mMaxQueueLatencyUs);
+    }
+
     mFrameAvailableCondition.signal();
 #ifdef QCOM_HARDWARE
     releaseBuffers();
@@ -211,9 +244,15 @@ sp<MetaData> SurfaceMediaSource::getFormat()
 // --------------------------------------------------------------
 // Note: Call only when you have the lock
 static void passMetadataBuffer(MediaBuffer **buffer,
-        buffer_handle_t bufferHandle) {
-    // MediaBuffer allocates and owns this data
-    MediaBuffer *tempBuffer = new MediaBuffer(4 + sizeof(buffer_handle_t));
+        Vector<MediaBuffer *> *freeBuffers, buffer_handle_t bufferHandle) {
+    MediaBuffer *tempBuffer;
+    if (!freeBuffers->isEmpty()) {
+        tempBuffer = freeBuffers->top();
+        freeBuffers->pop();
+    } else {
+        // MediaBuffer allocates and owns this data
+        tempBuffer = new MediaBuffer(4 + sizeof(buffer_handle_t));
+    }
     char *data = (char *)tempBuffer->data();
     if (data == NULL) {
         ALOGE("Cannot allocate memory for metadata buffer!");
@@ -241,6 +280,7 @@ status_t SurfaceMediaSource::read( MediaBuffer **buffer,
     // can be more than one "current" slots.
 
     BufferQueue::BufferItem item;
+    int64_t queuedTimeNs = 0;
     // If the recording has started and the queue is empty, then just
     // wait here till the frames come in from the client side
     while (!mStopped) {
@@ -269,8 +309,21 @@ status_t SurfaceMediaSource::read( MediaBuffer **buffer,
                     mStartTimeNs = item.mTimestamp - mStartTimeNs;
                 }
             }
+            queuedTimeNs = item.mTimestamp;
             item.mTimestamp = mStartTimeNs + (item.mTimestamp - mFirstFrameTimestamp);
 
+            // Allow for some jitter in the timestamps, so that e.g. a 60fps
+            // producer limited to 30fps keeps every other frame.
+            if (mMaxFrameRate > 0 && mNumFramesEncoded > 0) {
+                const int64_t minIntervalNs = 1000000000ll / mMaxFrameRate;
+                if (item.mTimestamp - mCurrentTimestamp
+                        < minIntervalNs - minIntervalNs / 8) {
+                    mBufferQueue->releaseBuffer(item.mBuf, EGL_NO_DISPLAY, EGL_NO_SYNC_KHR);
+                    ++mNumFramesDropped;
+                    continue;
+                }
+            }
+
             mNumFramesReceived++;
 
             break;
@@ -301,11 +354,25 @@ status_t SurfaceMediaSource::read( MediaBuffer **buffer,
 
     mNumFramesEncoded++;
     // Pass the data to the MediaBuffer. Pass in only the metadata
-    passMetadataBuffer(buffer, mBufferSlot[mCurrentSlot]->handle);
+    passMetadataBuffer(buffer, &mFreeMetadataBuffers,
+            mBufferSlot[mCurrentSlot]->handle);
+
+    // Producers timestamp their frames with the monotonic clock when
+    // queueing them unless told otherwise.
+    int64_t queueLatencyUs =
+        (systemTime(SYSTEM_TIME_MONOTONIC) - queuedTimeNs) / 1000;
+    if (queueLatencyUs < 0) {
+        queueLatencyUs = 0;
+    }
+    mTotalQueueLatencyUs += queueLatencyUs;
+    if (queueLatencyUs > mMaxQueueLatencyUs) {
+        mMaxQueueLatencyUs = queueLatencyUs;
+    }
 
     (*buffer)->setObserver(this);
     (*buffer)->add_ref();
     (*buffer)->meta_data()->setInt64(kKeyTime, mCurrentTimestamp / 1000);
+    (*buffer)->meta_data()->setInt64(kKeyQueueLatency, queueLatencyUs);
     ALOGV("Frames encoded = %d, timestamp = %lld, time diff = %lld",
             mNumFramesEncoded, mCurrentTimestamp / 1000,
             mCurrentTimestamp / 1000 - prevTimeStamp / 1000);
@@ -354,8 +421,9 @@ void SurfaceMediaSource::signalBufferReturned(MediaBuffer *buffer) {
 
             mBufferQueue->releaseBuffer(id, EGL_NO_DISPLAY, EGL_NO_SYNC_KHR);
 
-            buffer->setObserver(0);
-            buffer->release();
+            // Keep the meta data buffer for the next read().
+            buffer->meta_data()->clear();
+            mFreeMetadataBuffers.push(buffer);
 
             foundBuffer = true;
             break;
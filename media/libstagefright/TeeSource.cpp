@@ -0,0 +1,413 @@
+/*
+ * Copyright (C) 2012 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "TeeSource"
+#include <utils/Log.h>
+
+#include "include/TeeSource.h"
+
+#include <sys/prctl.h>
+
+#include <media/stagefright/foundation/ADebug.h>
+#include <media/stagefright/MediaBuffer.h>
+#include <media/stagefright/MediaErrors.h>
+#include <media/stagefright/MetaData.h>
+
+namespace android {
+
+struct TeeSource::Output : public MediaSource {
+    Output(const sp<TeeSource> &tee, size_t maxQueuedBuffers, bool lossy);
+
+    virtual status_t start(MetaData *params = NULL);
+    virtual status_t stop();
+
+    virtual sp<MetaData> getFormat();
+
+    virtual status_t read(
+            MediaBuffer **buffer, const ReadOptions *options = NULL);
+
+protected:
+    virtual ~Output();
+
+private:
+    friend struct TeeSource;
+
+    // Everything below is protected by the tee's lock.
+    sp<TeeSource> mTee;
+    size_t mMaxQueuedBuffers;
+    bool mLossy;
+    bool mStarted;
+    bool mDropUntilSyncFrame;
+    status_t mFinalResult;
+    size_t mNumBuffersDropped;
+    List<MediaBuffer *> mQueue;
+
+    void flushQueue_l();
+
+    Output(const Output &);
+    Output &operator=(const Output &);
+};
+
+TeeSource::Output::Output(
+        const sp<TeeSource> &tee, size_t maxQueuedBuffers, bool lossy)
+    : mTee(tee),
+      mMaxQueuedBuffers(maxQueuedBuffers),
+      mLossy(lossy),
+      mStarted(false),
+      mDropUntilSyncFrame(false),
+      mFinalResult(OK),
+      mNumBuffersDropped(0) {
+    CHECK_GT(mMaxQueuedBuffers, 0u);
+}
+
+TeeSource::Output::~Output() {
+    if (mStarted) {
+        stop();
+    }
+
+    mTee->removeOutput(this);
+}
+
+status_t TeeSource::Output::start(MetaData *params) {
+    return mTee->startOutput(this, params);
+}
+
+status_t TeeSource::Output::stop() {
+    return mTee->stopOutput(this);
+}
+
+sp<MetaData> TeeSource::Output::getFormat() {
+    return mTee->mSource->getFormat();
+}
+
+status_t TeeSource::Output::read(
+        MediaBuffer **buffer, const ReadOptions *options) {
+    // Encoded streams cannot be seeked, "options" is ignored.
+    return mTee->readOutput(this, buffer);
+}
+
+void TeeSource::Output::flushQueue_l() {
+    while (!mQueue.empty()) {
+        (*mQueue.begin())->release();
+        mQueue.erase(mQueue.begin());
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Lossy outputs get their own copy of the data so that buffers queued for
+// a slow consumer never keep the source from reusing its buffers.
+static MediaBuffer *CopyBuffer(MediaBuffer *buffer) {
+    MediaBuffer *copy = new MediaBuffer(buffer->range_length());
+    memcpy(copy->data(),
+           (const uint8_t *)buffer->data() + buffer->range_offset(),
+           buffer->range_length());
+    copy->set_range(0, buffer->range_length());
+
+    static const uint32_t kInt64Keys[] = {
+        kKeyTime, kKeyDecodingTime, kKeyDriftTime,
+    };
+    for (size_t i = 0; i < sizeof(kInt64Keys) / sizeof(kInt64Keys[0]); ++i) {
+        int64_t value;
+        if (buffer->meta_data()->findInt64(kInt64Keys[i], &value)) {
+            copy->meta_data()->setInt64(kInt64Keys[i], value);
+        }
+    }
+
+    static const uint32_t kInt32Keys[] = {
+        kKeyIsSyncFrame, kKeyIsCodecConfig,
+    };
+    for (size_t i = 0; i < sizeof(kInt32Keys) / sizeof(kInt32Keys[0]); ++i) {
+        int32_t value;
+        if (buffer->meta_data()->findInt32(kInt32Keys[i], &value)) {
+            copy->meta_data()->setInt32(kInt32Keys[i], value);
+        }
+    }
+
+    return copy;
+}
+
+static bool HasFlag(MediaBuffer *buffer, uint32_t key) {
+    int32_t value;
+    return buffer->meta_data()->findInt32(key, &value) && value != 0;
+}
+
+TeeSource::TeeSource(const sp<MediaSource> &source)
+    : mSource(source),
+      mIsVideo(false),
+      mNumStartedOutputs(0),
+      mStarted(false),
+      mDone(false) {
+    const char *mime;
+    CHECK(mSource->getFormat()->findCString(kKeyMIMEType, &mime));
+    mIsVideo = !strncasecmp(mime, "video/", 6);
+}
+
+TeeSource::~TeeSource() {
+    CHECK(!mStarted);
+    CHECK(mOutputs.isEmpty());
+}
+
+sp<MediaSource> TeeSource::createOutput(size_t maxQueuedBuffers, bool lossy) {
+    Mutex::Autolock autoLock(mLock);
+    CHECK(!mStarted);
+
+    Output *output = new Output(this, maxQueuedBuffers, lossy);
+    mOutputs.push(output);
+
+    return output;
+}
+
+void TeeSource::removeOutput(Output *output) {
+    Mutex::Autolock autoLock(mLock);
+    for (size_t i = 0; i < mOutputs.size(); ++i) {
+        if (mOutputs.itemAt(i) == output) {
+            mOutputs.removeAt(i);
+            return;
+        }
+    }
+
+    TRESPASS();
+}
+
+status_t TeeSource::startOutput(Output *output, MetaData *params) {
+    Mutex::Autolock autoLock(mLock);
+    if (output->mStarted || (mStarted && mDone)) {
+        return INVALID_OPERATION;
+    }
+
+    if (!mStarted) {
+        status_t err = mSource->start(params);
+        if (err != OK) {
+            return err;
+        }
+
+        mDone = false;
+
+        pthread_attr_t attr;
+        pthread_attr_init(&attr);
+        pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_JOINABLE);
+
+        pthread_create(&mThread, &attr, ThreadWrapper, this);
+
+        pthread_attr_destroy(&attr);
+
+        mStarted = true;
+
+        // The source starts out with its codec config data and a sync
+        // frame, nothing needs to be skipped.
+        output->mDropUntilSyncFrame = false;
+    } else {
+        // An output joining in mid stream gets the codec config data
+        // it missed and then waits for the next sync frame.
+        output->mDropUntilSyncFrame = mIsVideo;
+        for (size_t i = 0; i < mCodecConfigBuffers.size(); ++i) {
+            output->mQueue.push_back(
+                    CopyBuffer(mCodecConfigBuffers.itemAt(i)));
+        }
+    }
+
+    output->mStarted = true;
+    output->mFinalResult = OK;
+    output->mNumBuffersDropped = 0;
+    ++mNumStartedOutputs;
+
+    return OK;
+}
+
+status_t TeeSource::stopOutput(Output *output) {
+    {
+        Mutex::Autolock autoLock(mLock);
+        if (!output->mStarted) {
+            return OK;
+        }
+
+        if (output->mNumBuffersDropped > 0) {
+            ALOGI("output %p dropped %d buffers", output,
+                  output->mNumBuffersDropped);
+        }
+
+        output->mStarted = false;
+        output->flushQueue_l();
+        --mNumStartedOutputs;
+        mCondition.broadcast();
+
+        if (mNumStartedOutputs > 0) {
+            return OK;
+        }
+
+        mDone = true;
+    }
+
+    // Stopping the source first unblocks a read that is still pending
+    // on the thread.
+    status_t err = mSource->stop();
+
+    void *dummy;
+    pthread_join(mThread, &dummy);
+
+    Mutex::Autolock autoLock(mLock);
+    for (size_t i = 0; i < mCodecConfigBuffers.size(); ++i) {
+        mCodecConfigBuffers.itemAt(i)->release();
+    }
+    mCodecConfigBuffers.clear();
+    mStarted = false;
+
+    return err;
+}
+
+status_t TeeSource::readOutput(Output *output, MediaBuffer **buffer) {
+    *buffer = NULL;
+
+    Mutex::Autolock autoLock(mLock);
+    while (output->mStarted
+            && output->mQueue.empty() && output->mFinalResult == OK) {
+        mCondition.wait(mLock);
+    }
+
+    if (!output->mStarted) {
+        return ERROR_END_OF_STREAM;
+    }
+
+    if (output->mQueue.empty()) {
+        return output->mFinalResult;
+    }
+
+    *buffer = *output->mQueue.begin();
+    output->mQueue.erase(output->mQueue.begin());
+
+    // The thread may be waiting for room in this output's queue.
+    mCondition.broadcast();
+
+    return OK;
+}
+
+bool TeeSource::mustWait_l() const {
+    for (size_t i = 0; i < mOutputs.size(); ++i) {
+        const Output *output = mOutputs.itemAt(i);
+        if (output->mStarted && !output->mLossy
+                && output->mQueue.size() >= output->mMaxQueuedBuffers) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void TeeSource::queueBuffer_l(Output *output, MediaBuffer *buffer) {
+    if (!output->mLossy) {
+        // A clone shares the data and keeps the source's buffer from
+        // being returned until it is released, which only works for
+        // buffers that are handed out with an observer.
+        if (buffer->refcount() > 0) {
+            output->mQueue.push_back(buffer->clone());
+        } else {
+            output->mQueue.push_back(CopyBuffer(buffer));
+        }
+        return;
+    }
+
+    // Codec config data is never dropped, the consumer cannot decode
+    // anything without it.
+    if (!HasFlag(buffer, kKeyIsCodecConfig)) {
+        if (output->mDropUntilSyncFrame && !HasFlag(buffer, kKeyIsSyncFrame)) {
+            ++output->mNumBuffersDropped;
+            return;
+        }
+
+        if (output->mQueue.size() >= output->mMaxQueuedBuffers) {
+            ++output->mNumBuffersDropped;
+            output->mDropUntilSyncFrame = mIsVideo;
+            return;
+        }
+
+        output->mDropUntilSyncFrame = false;
+    }
+
+    output->mQueue.push_back(CopyBuffer(buffer));
+}
+
+void TeeSource::signalEOS_l(status_t err) {
+    for (size_t i = 0; i < mOutputs.size(); ++i) {
+        Output *output = mOutputs.editItemAt(i);
+        if (output->mStarted) {
+            output->mFinalResult = err;
+        }
+    }
+
+    mCondition.broadcast();
+}
+
+// static
+void *TeeSource::ThreadWrapper(void *me) {
+    static_cast<TeeSource *>(me)->threadEntry();
+
+    return NULL;
+}
+
+void TeeSource::threadEntry() {
+    prctl(PR_SET_NAME, (unsigned long)"TeeSource", 0, 0, 0);
+
+    Mutex::Autolock autoLock(mLock);
+
+    for (;;) {
+        while (!mDone && mustWait_l()) {
+            mCondition.wait(mLock);
+        }
+
+        if (mDone) {
+            break;
+        }
+
+        MediaBuffer *buffer = NULL;
+
+        mLock.unlock();
+        status_t err = mSource->read(&buffer);
+        mLock.lock();
+
+        if (mDone) {
+            if (buffer != NULL) {
+                buffer->release();
+            }
+            break;
+        }
+
+        if (err != OK) {
+            CHECK(buffer == NULL);
+            signalEOS_l(err);
+            break;
+        }
+
+        if (HasFlag(buffer, kKeyIsCodecConfig)) {
+            mCodecConfigBuffers.push(CopyBuffer(buffer));
+        }
+
+        for (size_t i = 0; i < mOutputs.size(); ++i) {
+            Output *output = mOutputs.editItemAt(i);
+            if (output->mStarted) {
+                queueBuffer_l(output, buffer);
+            }
+        }
+
+        buffer->release();
+        buffer = NULL;
+
+        mCondition.broadcast();
+    }
+}
+
+}  // namespace android
@@ -35,6 +35,7 @@ namespace android {
 
 TimedEventQueue::TimedEventQueue()
     : mNextEventID(1),
+      mNextSequence(0),
       mRunning(false),
       mStopped(false) {
 }
@@ -92,32 +93,33 @@ TimedEventQueue::event_id TimedEventQueue::postEventToBack(
 }
 
 TimedEventQueue::event_id TimedEventQueue::postEventWithDelay(
-        const sp<Event> &event, int64_t delay_us) {
+        const sp<Event> &event, int64_t delay_us, int64_t slack_us) {
     CHECK(delay_us >= 0);
-    return postTimedEvent(event, getRealTimeUs() + delay_us);
+    return postTimedEvent(event, getRealTimeUs() + delay_us, slack_us);
 }
 
 TimedEventQueue::event_id TimedEventQueue::postTimedEvent(
-        const sp<Event> &event, int64_t realtime_us) {
+        const sp<Event> &event, int64_t realtime_us, int64_t slack_us) {
+    CHECK(slack_us >= 0);
+
     Mutex::Autolock autoLock(mLock);
 
     event->setEventID(mNextEventID++);
 
-    List<QueueItem>::iterator it = mQueue.begin();
-    while (it != mQueue.end() && realtime_us >= (*it).realtime_us) {
-        ++it;
-    }
-
     QueueItem item;
     item.event = event;
     item.realtime_us = realtime_us;
+    item.deadline_us =
+        (realtime_us > INT64_MAX - slack_us) ? INT64_MAX : realtime_us + slack_us;
+    item.sequence = mNextSequence++;
 
-    if (it == mQueue.begin()) {
+    size_t index = mQueue.add(item);
+    siftUp_l(index);
+
+    if (mQueue[0].sequence == item.sequence) {
         mQueueHeadChangedCondition.signal();
     }
 
-    mQueue.insert(it, item);
-
     mQueueNotEmptyCondition.signal();
 
     return event->eventID();
@@ -156,21 +158,22 @@ void TimedEventQueue::cancelEvents(
         bool stopAfterFirstMatch) {
     Mutex::Autolock autoLock(mLock);
 
-    List<QueueItem>::iterator it = mQueue.begin();
-    while (it != mQueue.end()) {
-        if (!(*predicate)(cookie, (*it).event)) {
-            ++it;
+    // Removing an item moves the last one into its slot, so the slot is
+    // looked at again.
+    size_t i = 0;
+    while (i < mQueue.size()) {
+        if (!(*predicate)(cookie, mQueue[i].event)) {
+            ++i;
             continue;
         }
 
-        if (it == mQueue.begin()) {
+        if (i == 0) {
             mQueueHeadChangedCondition.signal();
         }
 
-        ALOGV("cancelling event %d", (*it).event->eventID());
+        ALOGV("cancelling event %d", mQueue[i].event->eventID());
 
-        (*it).event->setEventID(0);
-        it = mQueue.erase(it);
+        removeItemAt_l(i);
 
         if (stopAfterFirstMatch) {
             return;
@@ -214,7 +217,6 @@ void TimedEventQueue::threadEntry() {
                 mQueueNotEmptyCondition.wait(mLock);
             }
 
-            event_id eventID = 0;
             for (;;) {
                 if (mQueue.empty()) {
                     // The only event in the queue could have been cancelled
@@ -222,25 +224,27 @@ void TimedEventQueue::threadEntry() {
                     break;
                 }
 
-                List<QueueItem>::iterator it = mQueue.begin();
-                eventID = (*it).event->eventID();
+                const QueueItem &item = mQueue[0];
 
                 now_us = getRealTimeUs();
-                int64_t when_us = (*it).realtime_us;
+                int64_t when_us = item.realtime_us;
 
+                // An event whose time has passed fires now even if it still
+                // has slack left, since we are awake anyway. Otherwise we
+                // sleep until its deadline.
                 int64_t delay_us;
-                if (when_us < 0 || when_us == INT64_MAX) {
+                if (when_us < 0 || when_us == INT64_MAX || when_us <= now_us) {
                     delay_us = 0;
                 } else {
-                    delay_us = when_us - now_us;
+                    delay_us = item.deadline_us - now_us;
                 }
 
                 if (delay_us <= 0) {
+                    event = removeItemAt_l(0);
                     break;
                 }
 
                 static int64_t kMaxTimeoutUs = 10000000ll;  // 10 secs
-                bool timeoutCapped = false;
                 if (delay_us > kMaxTimeoutUs) {
                     ALOGW("delay_us exceeds max timeout: %lld us", delay_us);
 
@@ -249,26 +253,13 @@ void TimedEventQueue::threadEntry() {
                     // 10 secs at a time. This will also avoid overflow
                     // when converting from us to ns.
                     delay_us = kMaxTimeoutUs;
-                    timeoutCapped = true;
                 }
 
-                status_t err = mQueueHeadChangedCondition.waitRelative(
+                // Whether we timed out or the head changed, the head is
+                // looked at again: once its deadline has passed it fires.
+                mQueueHeadChangedCondition.waitRelative(
                         mLock, delay_us * 1000ll);
-
-                if (!timeoutCapped && err == -ETIMEDOUT) {
-                    // We finally hit the time this event is supposed to
-                    // trigger.
-                    now_us = getRealTimeUs();
-                    break;
-                }
             }
-
-            // The event w/ this id may have been cancelled while we're
-            // waiting for its trigger-time, in that case
-            // removeEventFromQueue_l will return NULL.
-            // Otherwise, the QueueItem will be removed
-            // from the queue and the referenced event returned.
-            event = removeEventFromQueue_l(eventID);
         }
 
         if (event != NULL) {
@@ -278,23 +269,75 @@ void TimedEventQueue::threadEntry() {
     }
 }
 
-sp<TimedEventQueue::Event> TimedEventQueue::removeEventFromQueue_l(
-        event_id id) {
-    for (List<QueueItem>::iterator it = mQueue.begin();
-         it != mQueue.end(); ++it) {
-        if ((*it).event->eventID() == id) {
-            sp<Event> event = (*it).event;
-            event->setEventID(0);
+// static
+bool TimedEventQueue::ItemBefore(const QueueItem &a, const QueueItem &b) {
+    if (a.deadline_us != b.deadline_us) {
+        return a.deadline_us < b.deadline_us;
+    }
+
+    return a.sequence < b.sequence;
+}
 
-            mQueue.erase(it);
+void TimedEventQueue::siftUp_l(size_t index) {
+    QueueItem item = mQueue[index];
 
-            return event;
+    while (index > 0) {
+        size_t parent = (index - 1) / 2;
+        if (!ItemBefore(item, mQueue[parent])) {
+            break;
         }
+
+        mQueue.editItemAt(index) = mQueue[parent];
+        index = parent;
     }
 
-    ALOGW("Event %d was not found in the queue, already cancelled?", id);
+    mQueue.editItemAt(index) = item;
+}
+
+void TimedEventQueue::siftDown_l(size_t index) {
+    const size_t n = mQueue.size();
+    QueueItem item = mQueue[index];
 
-    return NULL;
+    for (;;) {
+        size_t child = 2 * index + 1;
+        if (child >= n) {
+            break;
+        }
+
+        if (child + 1 < n && ItemBefore(mQueue[child + 1], mQueue[child])) {
+            ++child;
+        }
+
+        if (!ItemBefore(mQueue[child], item)) {
+            break;
+        }
+
+        mQueue.editItemAt(index) = mQueue[child];
+        index = child;
+    }
+
+    mQueue.editItemAt(index) = item;
+}
+
+sp<TimedEventQueue::Event> TimedEventQueue::removeItemAt_l(size_t index) {
+    sp<Event> event = mQueue[index].event;
+    event->setEventID(0);
+
+    size_t last = mQueue.size() - 1;
+    if (index < last) {
+        mQueue.editItemAt(index) = mQueue[last];
+    }
+    mQueue.removeAt(last);
+
+    if (index < last) {
+        if (index > 0 && ItemBefore(mQueue[index], mQueue[(index - 1) / 2])) {
+            siftUp_l(index);
+        } else {
+            siftDown_l(index);
+        }
+    }
+
+    return event;
 }
 
 }  // namespace android
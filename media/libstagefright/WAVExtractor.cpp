@@ -29,6 +29,11 @@
 #include <media/stagefright/MetaData.h>
 #include <utils/String8.h>
 #include <cutils/bitops.h>
+#include <cutils/properties.h>
+
+#ifdef __ARM_NEON__
+#include <arm_neon.h>
+#endif
 
 #define CHANNEL_MASK_USE_CHANNEL_ORDER 0
 
@@ -71,7 +76,8 @@ protected:
     virtual ~WAVSource();
 
 private:
-    static const size_t kMaxFrameSize;
+    static const size_t kDefaultBufferSize;
+    static const size_t kMaxBufferSize;
 
     sp<DataSource> mDataSource;
     sp<MetaData> mMeta;
@@ -85,6 +91,14 @@ private:
     MediaBufferGroup *mGroup;
     off64_t mCurrentPos;
 
+    // Size of the output buffers, and how much of the data chunk is read
+    // into each, a whole number of sample frames.
+    size_t mBufferSize;
+    size_t mReadSize;
+
+    // Set if the client asked for 24-bit samples as they are.
+    bool mPassthrough24Bit;
+
     WAVSource(const WAVSource &);
     WAVSource &operator=(const WAVSource &);
 };
@@ -312,7 +326,56 @@ status_t WAVExtractor::init() {
     return NO_INIT;
 }
 
-const size_t WAVSource::kMaxFrameSize = 32768;
+// The output buffer size can be raised with media.stagefright.wav-buffer-size
+// for high resolution content, where 32 KB lasts only a few milliseconds.
+const size_t WAVSource::kDefaultBufferSize = 32768;
+const size_t WAVSource::kMaxBufferSize = 1024 * 1024;
+
+// Both convert in place, 16 samples at a time with NEON.
+
+static void Convert8BitTo16Bit(
+        const uint8_t *src, int16_t *dst, size_t numSamples) {
+    // Requires (uint8_t *)dst + numSamples <= src, so that the output never
+    // overtakes the input.
+    size_t i = 0;
+
+#ifdef __ARM_NEON__
+    const uint8x16_t zero = vdupq_n_u8(0);
+    const uint8x16_t signBit = vdupq_n_u8(0x80);
+    for (; i + 16 <= numSamples; i += 16) {
+        uint8x16x2_t out;
+        out.val[0] = zero;
+        out.val[1] = veorq_u8(vld1q_u8(&src[i]), signBit);
+        vst2q_u8((uint8_t *)&dst[i], out);
+    }
+#endif
+
+    for (; i < numSamples; ++i) {
+        dst[i] = ((int16_t)src[i] - 128) * 256;
+    }
+}
+
+static void Convert24BitTo16Bit(
+        const uint8_t *src, int16_t *dst, size_t numSamples) {
+    // Requires dst <= src, the output is narrower than the input.
+    size_t i = 0;
+
+#ifdef __ARM_NEON__
+    for (; i + 16 <= numSamples; i += 16) {
+        // Drop the least significant byte of each sample.
+        uint8x16x3_t in = vld3q_u8(&src[3 * i]);
+        uint8x16x2_t out;
+        out.val[0] = in.val[1];
+        out.val[1] = in.val[2];
+        vst2q_u8((uint8_t *)&dst[i], out);
+    }
+#endif
+
+    for (; i < numSamples; ++i) {
+        const uint8_t *x = &src[3 * i];
+        dst[i] = (int16_t)(x[1] | x[2] << 8);
+    }
+}
 
 WAVSource::WAVSource(
         const sp<DataSource> &dataSource,
@@ -329,11 +392,38 @@ WAVSource::WAVSource(
       mOffset(offset),
       mSize(size),
       mStarted(false),
-      mGroup(NULL) {
+      mGroup(NULL),
+      mBufferSize(kDefaultBufferSize),
+      mReadSize(0),
+      mPassthrough24Bit(false) {
     CHECK(mMeta->findInt32(kKeySampleRate, &mSampleRate));
     CHECK(mMeta->findInt32(kKeyChannelCount, &mNumChannels));
 
-    mMeta->setInt32(kKeyMaxInputSize, kMaxFrameSize);
+    char value[PROPERTY_VALUE_MAX];
+    if (property_get("media.stagefright.wav-buffer-size", value, NULL)) {
+        char *end;
+        unsigned long size = strtoul(value, &end, 10);
+        if (end != value && *end == '\0'
+                && size >= kDefaultBufferSize && size <= kMaxBufferSize) {
+            mBufferSize = size;
+        }
+    }
+
+    // 8-bit PCM doubles in size when converted to 16-bit.
+    mReadSize = mBufferSize;
+    if (mWaveFormat == WAVE_FORMAT_PCM && mBitsPerSample == 8) {
+        mReadSize /= 2;
+    }
+
+    // Reads that split sample frames would have the next buffer start
+    // in the middle of one.
+    size_t frameSize = mNumChannels * (mBitsPerSample >> 3);
+    if (frameSize > 0) {
+        mReadSize -= mReadSize % frameSize;
+    }
+
+    mMeta->setInt32(kKeyBitsPerSample, mBitsPerSample);
+    mMeta->setInt32(kKeyMaxInputSize, mBufferSize);
 }
 
 WAVSource::~WAVSource() {
@@ -347,13 +437,15 @@ status_t WAVSource::start(MetaData *params) {
 
     CHECK(!mStarted);
 
-    mGroup = new MediaBufferGroup;
-    mGroup->add_buffer(new MediaBuffer(kMaxFrameSize));
+    int32_t bitsPerSample;
+    mPassthrough24Bit =
+        mWaveFormat == WAVE_FORMAT_PCM && mBitsPerSample == 24
+            && params != NULL
+            && params->findInt32(kKeyBitsPerSample, &bitsPerSample)
+            && bitsPerSample == 24;
 
-    if (mBitsPerSample == 8) {
-        // As a temporary buffer for 8->16 bit conversion.
-        mGroup->add_buffer(new MediaBuffer(kMaxFrameSize));
-    }
+    mGroup = new MediaBufferGroup;
+    mGroup->add_buffer(new MediaBuffer(mBufferSize));
 
     mCurrentPos = mOffset;
 
@@ -401,8 +493,7 @@ status_t WAVSource::read(
         return err;
     }
 
-    size_t maxBytesToRead =
-        mBitsPerSample == 8 ? kMaxFrameSize / 2 : kMaxFrameSize;
+    size_t maxBytesToRead = mReadSize;
 
     size_t maxBytesAvailable =
         (mCurrentPos - mOffset >= (off64_t)mSize)
@@ -412,9 +503,15 @@ status_t WAVSource::read(
         maxBytesToRead = maxBytesAvailable;
     }
 
-    ssize_t n = mDataSource->readAt(
-            mCurrentPos, buffer->data(),
-            maxBytesToRead);
+    // 8-bit samples are read into the second half of the buffer and
+    // expanded towards its start.
+    bool expand8Bit = (mWaveFormat == WAVE_FORMAT_PCM && mBitsPerSample == 8);
+    uint8_t *readPtr = (uint8_t *)buffer->data();
+    if (expand8Bit) {
+        readPtr += mReadSize;
+    }
+
+    ssize_t n = mDataSource->readAt(mCurrentPos, readPtr, maxBytesToRead);
 
     if (n <= 0) {
         buffer->release();
@@ -425,47 +522,21 @@ status_t WAVSource::read(
 
     buffer->set_range(0, n);
 
-    if (mWaveFormat == WAVE_FORMAT_PCM) {
-        if (mBitsPerSample == 8) {
-            // Convert 8-bit unsigned samples to 16-bit signed.
-
-            MediaBuffer *tmp;
-            CHECK_EQ(mGroup->acquire_buffer(&tmp), (status_t)OK);
+    if (expand8Bit) {
+        // Convert 8-bit unsigned samples to 16-bit signed.
+        Convert8BitTo16Bit(readPtr, (int16_t *)buffer->data(), n);
 
-            // The new buffer holds the sample number of samples, but each
-            // one is 2 bytes wide.
-            tmp->set_range(0, 2 * n);
+        buffer->set_range(0, 2 * n);
+    } else if (mWaveFormat == WAVE_FORMAT_PCM
+            && mBitsPerSample == 24 && !mPassthrough24Bit) {
+        // Convert 24-bit signed samples to 16-bit signed.
+        size_t numSamples = n / 3;
 
-            int16_t *dst = (int16_t *)tmp->data();
-            const uint8_t *src = (const uint8_t *)buffer->data();
-            ssize_t numBytes = n;
+        Convert24BitTo16Bit(
+                (const uint8_t *)buffer->data(), (int16_t *)buffer->data(),
+                numSamples);
 
-            while (numBytes-- > 0) {
-                *dst++ = ((int16_t)(*src) - 128) * 256;
-                ++src;
-            }
-
-            buffer->release();
-            buffer = tmp;
-        } else if (mBitsPerSample == 24) {
-            // Convert 24-bit signed samples to 16-bit signed.
-
-            const uint8_t *src =
-                (const uint8_t *)buffer->data() + buffer->range_offset();
-            int16_t *dst = (int16_t *)src;
-
-            size_t numSamples = buffer->range_length() / 3;
-            for (size_t i = 0; i < numSamples; ++i) {
-                int32_t x = (int32_t)(src[0] | src[1] << 8 | src[2] << 16);
-                x = (x << 8) >> 8;  // sign extension
-
-                x = x >> 8;
-                *dst++ = (int16_t)x;
-                src += 3;
-            }
-
-            buffer->set_range(buffer->range_offset(), 2 * numSamples);
-        }
+        buffer->set_range(0, 2 * numSamples);
     }
 
     size_t bytesPerSample = mBitsPerSample >> 3;
@@ -29,14 +29,7 @@
 namespace android {
 
 unsigned parseUE(ABitReader *br) {
-    unsigned numZeroes = 0;
-    while (br->getBits(1) == 0) {
-        ++numZeroes;
-    }
-
-    unsigned x = br->getBits(numZeroes);
-
-    return x + (1u << numZeroes) - 1;
+    return br->getUE();
 }
 
 // Determine video dimensions from the sequence parameterset.
@@ -167,9 +160,12 @@ status_t getNextNALUnit(
     size_t startOffset = offset;
 
     for (;;) {
-        while (offset < size && data[offset] != 0x01) {
-            ++offset;
-        }
+        // Let memchr find the candidate 0x01 bytes, it scans a word or
+        // vector at a time where the byte loop would go one by one.
+        const uint8_t *next =
+            (const uint8_t *)memchr(&data[offset], 0x01, size - offset);
+
+        offset = (next == NULL) ? size : next - data;
 
         if (offset == size) {
             if (startCodeFollows) {
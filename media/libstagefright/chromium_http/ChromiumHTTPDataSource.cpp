@@ -29,6 +29,10 @@
 
 namespace android {
 
+// Forward seeks up to this far read through the response instead of
+// paying for a new request.
+static const off64_t kMaxSkipBytes = 32768;
+
 ChromiumHTTPDataSource::ChromiumHTTPDataSource(uint32_t flags)
     : mFlags(flags),
       mState(DISCONNECTED),
@@ -47,6 +51,12 @@ ChromiumHTTPDataSource::~ChromiumHTTPDataSource() {
     delete mDelegate;
     mDelegate = NULL;
 
+    int32_t numOpened, numReused, numSSLHandshakes;
+    SfNetLog::GetConnectionStats(&numOpened, &numReused, &numSSLHandshakes);
+    LOG_PRI(ANDROID_LOG_INFO, LOG_TAG,
+            "connections opened %d, reused %d, ssl handshakes %d",
+            numOpened, numReused, numSSLHandshakes);
+
     clearDRMState_l();
 
     if (mDrmManagerClient != NULL) {
@@ -87,6 +97,7 @@ status_t ChromiumHTTPDataSource::connect_l(
 
     mURI = uri;
     mContentType = String8("application/octet-stream");
+    mCacheValidator.setTo("");
 
     if (headers != NULL) {
         mHeaders = *headers;
@@ -108,7 +119,8 @@ status_t ChromiumHTTPDataSource::connect_l(
 }
 
 void ChromiumHTTPDataSource::onConnectionEstablished(
-        int64_t contentSize, const char *contentType) {
+        int64_t contentSize, const char *contentType,
+        const char *cacheValidator) {
     Mutex::Autolock autoLock(mLock);
 
     if (mState != CONNECTING) {
@@ -120,6 +132,7 @@ void ChromiumHTTPDataSource::onConnectionEstablished(
     mState = CONNECTED;
     mContentSize = (contentSize < 0) ? -1 : contentSize + mCurrentOffset;
     mContentType = String8(contentType);
+    mCacheValidator = String8(cacheValidator);
     mCondition.broadcast();
 }
 
@@ -178,6 +191,11 @@ ssize_t ChromiumHTTPDataSource::readAt(off64_t offset, void *data, size_t size)
     }
 #endif
 
+    if (offset > mCurrentOffset && offset - mCurrentOffset <= kMaxSkipBytes
+            && skipTo_l(offset) == OK) {
+        CHECK_EQ(offset, mCurrentOffset);
+    }
+
     if (offset != mCurrentOffset) {
         AString tmp = mURI;
         KeyedVector<String8, String8> tmpHeaders = mHeaders;
@@ -219,6 +237,37 @@ ssize_t ChromiumHTTPDataSource::readAt(off64_t offset, void *data, size_t size)
     return ERROR_IO;
 }
 
+status_t ChromiumHTTPDataSource::skipTo_l(off64_t offset) {
+    uint8_t buffer[4096];
+
+    while (mCurrentOffset < offset) {
+        if (mState != CONNECTED) {
+            return ERROR_IO;
+        }
+
+        size_t n = sizeof(buffer);
+        if (offset - mCurrentOffset < (off64_t)n) {
+            n = offset - mCurrentOffset;
+        }
+
+        mState = READING;
+
+        mDelegate->initiateRead(buffer, n);
+
+        while (mState == READING) {
+            mCondition.wait(mLock);
+        }
+
+        if (mState != CONNECTED || mIOResult <= 0) {
+            return ERROR_IO;
+        }
+
+        mCurrentOffset += mIOResult;
+    }
+
+    return OK;
+}
+
 void ChromiumHTTPDataSource::onReadCompleted(ssize_t size) {
     Mutex::Autolock autoLock(mLock);
 
@@ -321,6 +370,12 @@ String8 ChromiumHTTPDataSource::getUri() {
     return String8(mURI.c_str());
 }
 
+String8 ChromiumHTTPDataSource::getCacheValidator() {
+    Mutex::Autolock autoLock(mLock);
+
+    return mCacheValidator;
+}
+
 String8 ChromiumHTTPDataSource::getMIMEType() const {
     Mutex::Autolock autoLock(mLock);
 
@@ -352,5 +407,38 @@ status_t ChromiumHTTPDataSource::reconnectAtOffset(off64_t offset) {
     return err;
 }
 
+sp<HTTPBase> ChromiumHTTPDataSource::createConnection(off64_t offset) {
+    AString uri;
+    KeyedVector<String8, String8> headers;
+
+    {
+        Mutex::Autolock autoLock(mLock);
+
+        if (mURI.empty()) {
+            return NULL;
+        }
+
+        uri = mURI;
+        headers = mHeaders;
+    }
+
+    sp<ChromiumHTTPDataSource> source = new ChromiumHTTPDataSource(mFlags);
+
+    uid_t uid;
+    if (getUID(&uid)) {
+        source->setUID(uid);
+    }
+    source->setBandwidthOwner(this);
+
+    status_t err = source->connect(uri.c_str(), &headers, offset);
+    if (err != OK) {
+        LOG_PRI(ANDROID_LOG_INFO, LOG_TAG,
+                "Additional connection failed w/ err 0x%08x", err);
+        return NULL;
+    }
+
+    return source;
+}
+
 }  // namespace android
 
@@ -35,6 +35,7 @@
 
 #include "include/ChromiumHTTPDataSource.h"
 
+#include <cutils/atomic.h>
 #include <cutils/log.h>
 #include <cutils/properties.h>
 #include <media/stagefright/MediaErrors.h>
@@ -125,16 +126,49 @@ static void MY_LOGV(const char *s) {
 #endif
 }
 
+static volatile int32_t gNumConnectionsOpened = 0;
+static volatile int32_t gNumConnectionsReused = 0;
+static volatile int32_t gNumSSLHandshakes = 0;
+
 SfNetLog::SfNetLog()
     : mNextID(1) {
 }
 
+// static
+void SfNetLog::GetConnectionStats(
+        int32_t *numOpened, int32_t *numReused, int32_t *numSSLHandshakes) {
+    *numOpened = android_atomic_acquire_load(&gNumConnectionsOpened);
+    *numReused = android_atomic_acquire_load(&gNumConnectionsReused);
+    *numSSLHandshakes = android_atomic_acquire_load(&gNumSSLHandshakes);
+}
+
 void SfNetLog::AddEntry(
         EventType type,
         const base::TimeTicks &time,
         const Source &source,
         EventPhase phase,
         EventParameters *params) {
+    switch (type) {
+        case TYPE_TCP_CONNECT:
+            if (phase == PHASE_BEGIN) {
+                android_atomic_inc(&gNumConnectionsOpened);
+            }
+            break;
+
+        case TYPE_SSL_CONNECT:
+            if (phase == PHASE_BEGIN) {
+                android_atomic_inc(&gNumSSLHandshakes);
+            }
+            break;
+
+        case TYPE_SOCKET_POOL_REUSED_AN_EXISTING_SOCKET:
+            android_atomic_inc(&gNumConnectionsReused);
+            break;
+
+        default:
+            break;
+    }
+
 #if 0
     MY_LOGI(StringPrintf(
                 "AddEntry time=%s type=%s source=%s phase=%s\n",
@@ -326,8 +360,15 @@ void SfDelegate::OnResponseStarted(net::URLRequest *request) {
     std::string contentType;
     request->GetResponseHeaderByName("Content-Type", &contentType);
 
+    std::string cacheValidator;
+    request->GetResponseHeaderByName("ETag", &cacheValidator);
+    if (cacheValidator.empty()) {
+        request->GetResponseHeaderByName("Last-Modified", &cacheValidator);
+    }
+
     mOwner->onConnectionEstablished(
-            request->GetExpectedContentSize(), contentType.c_str());
+            request->GetExpectedContentSize(), contentType.c_str(),
+            cacheValidator.c_str());
 }
 
 void SfDelegate::OnReadCompleted(net::URLRequest *request, int bytes_read) {
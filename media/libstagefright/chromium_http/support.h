@@ -44,6 +44,12 @@ struct SfNetLog : public net::NetLog {
     virtual uint32 NextID();
     virtual LogLevel GetLogLevel() const;
 
+    // All data sources share a single request context, and with it the
+    // socket pools keeping connections alive per host and the SSL session
+    // cache. These count the connections set up vs. picked from the pools.
+    static void GetConnectionStats(
+            int32_t *numOpened, int32_t *numReused, int32_t *numSSLHandshakes);
+
 private:
     uint32 mNextID;
 
@@ -1,10 +1,13 @@
 LOCAL_PATH:= $(call my-dir)
 
+# a board can select the decoder with AAC_LIBRARY := pv or fraunhofer
+ifeq ($(AAC_LIBRARY),)
 ifeq ($(ARCH_ARM_HAVE_ARMV7A),true)
 AAC_LIBRARY = fraunhofer
 else
 AAC_LIBRARY = pv
 endif
+endif
 
 ifeq ($(AAC_LIBRARY), fraunhofer)
   include $(CLEAR_VARS)
@@ -187,6 +190,11 @@ else # pv
 
   LOCAL_ARM_MODE := arm
 
+  # NEON SBR filterbanks and long window overlap and add
+  ifeq ($(ARCH_ARM_HAVE_NEON),true)
+    LOCAL_ARM_NEON := true
+  endif
+
   LOCAL_MODULE := libstagefright_aacdec
 
   include $(BUILD_STATIC_LIBRARY)
@@ -85,7 +85,7 @@ void SoftAAC2::initPorts() {
     def.eDir = OMX_DirOutput;
     def.nBufferCountMin = kNumOutputBuffers;
     def.nBufferCountActual = def.nBufferCountMin;
-    def.nBufferSize = 8192 * 2;
+    def.nBufferSize = kOutputBufferSize;
     def.bEnabled = OMX_TRUE;
     def.bPopulated = OMX_FALSE;
     def.eDomain = OMX_PortDomainAudio;
@@ -321,12 +321,13 @@ void SoftAAC2::onQueueFilled(OMX_U32 portIndex) {
             notifyEmptyBufferDone(inHeader);
 
             // flush out the decoder's delayed data by calling DecodeFrame one more time, with
-            // the AACDEC_FLUSH flag set
+            // the AACDEC_FLUSH flag set, after the frames already batched into this buffer
+            size_t used = outHeader->nOffset + outHeader->nFilledLen;
             INT_PCM *outBuffer =
-                    reinterpret_cast<INT_PCM *>(outHeader->pBuffer + outHeader->nOffset);
+                    reinterpret_cast<INT_PCM *>(outHeader->pBuffer + used);
             AAC_DECODER_ERROR decoderErr = aacDecoder_DecodeFrame(mAACDecoder,
                                                                   outBuffer,
-                                                                  outHeader->nAllocLen,
+                                                                  outHeader->nAllocLen - used,
                                                                   AACDEC_FLUSH);
             if (decoderErr != AAC_DEC_OK) {
                 mSignalledError = true;
@@ -334,12 +335,14 @@ void SoftAAC2::onQueueFilled(OMX_U32 portIndex) {
                 return;
             }
 
-            outHeader->nFilledLen =
+            if (outHeader->nFilledLen == 0) {
+                outHeader->nTimeStamp =
+                    mAnchorTimeUs
+                        + (mNumSamplesOutput * 1000000ll) / mStreamInfo->sampleRate;
+            }
+            outHeader->nFilledLen +=
                     mStreamInfo->frameSize * sizeof(int16_t) * mStreamInfo->numChannels;
             outHeader->nFlags = OMX_BUFFERFLAG_EOS;
-            outHeader->nTimeStamp =
-                mAnchorTimeUs
-                    + (mNumSamplesOutput * 1000000ll) / mStreamInfo->sampleRate;
 
             outQueue.erase(outQueue.begin());
             outInfo->mOwnedByUs = false;
@@ -406,8 +409,9 @@ void SoftAAC2::onQueueFilled(OMX_U32 portIndex) {
             inBufferLength[0] = inHeader->nFilledLen;
         }
 
-        // Fill and decode
-        INT_PCM *outBuffer = reinterpret_cast<INT_PCM *>(outHeader->pBuffer + outHeader->nOffset);
+        // Fill and decode, in batch mode after the frames already in the buffer
+        size_t outBufferUsed = outHeader->nOffset + outHeader->nFilledLen;
+        INT_PCM *outBuffer = reinterpret_cast<INT_PCM *>(outHeader->pBuffer + outBufferUsed);
         bytesValid[0] = inBufferLength[0];
 
         int prevSampleRate = mStreamInfo->sampleRate;
@@ -422,7 +426,7 @@ void SoftAAC2::onQueueFilled(OMX_U32 portIndex) {
 
             decoderErr = aacDecoder_DecodeFrame(mAACDecoder,
                                                 outBuffer,
-                                                outHeader->nAllocLen,
+                                                outHeader->nAllocLen - outBufferUsed,
                                                 0 /* flags */);
 
             if (decoderErr == AAC_DEC_NOT_ENOUGH_BITS) {
@@ -480,7 +484,7 @@ void SoftAAC2::onQueueFilled(OMX_U32 portIndex) {
             ALOGW("AAC decoder returned error %d, substituting silence",
                   decoderErr);
 
-            memset(outHeader->pBuffer + outHeader->nOffset, 0, numOutBytes);
+            memset(outBuffer, 0, numOutBytes);
 
             // Discard input buffer.
             inHeader->nFilledLen = 0;
@@ -500,20 +504,25 @@ void SoftAAC2::onQueueFilled(OMX_U32 portIndex) {
                 numOutBytes = 0;
             }
 
-            outHeader->nFilledLen = numOutBytes;
-            outHeader->nFlags = 0;
+            if (outHeader->nFilledLen == 0) {
+                outHeader->nFlags = 0;
+
+                outHeader->nTimeStamp =
+                    mAnchorTimeUs
+                        + (mNumSamplesOutput * 1000000ll) / mStreamInfo->sampleRate;
+            }
 
-            outHeader->nTimeStamp =
-                mAnchorTimeUs
-                    + (mNumSamplesOutput * 1000000ll) / mStreamInfo->sampleRate;
+            outHeader->nFilledLen += numOutBytes;
 
             mNumSamplesOutput += mStreamInfo->frameSize;
 
-            outInfo->mOwnedByUs = false;
-            outQueue.erase(outQueue.begin());
-            outInfo = NULL;
-            notifyFillBufferDone(outHeader);
-            outHeader = NULL;
+            if (!keepOutputBuffer(outHeader, kOutputBufferSize)) {
+                outInfo->mOwnedByUs = false;
+                outQueue.erase(outQueue.begin());
+                outInfo = NULL;
+                notifyFillBufferDone(outHeader);
+                outHeader = NULL;
+            }
         }
 
         if (inHeader->nFilledLen == 0) {
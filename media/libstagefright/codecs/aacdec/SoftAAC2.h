@@ -46,6 +46,7 @@ private:
     enum {
         kNumInputBuffers        = 4,
         kNumOutputBuffers       = 4,
+        kOutputBufferSize       = 8192 * 2,
     };
 
     HANDLE_AACDECODER mAACDecoder;
@@ -93,6 +93,10 @@ Copyright (c) ISO/IEC 2002.
 #include    "aac_mem_funcs.h"
 #include    "fxp_mul32.h"
 
+#ifdef __ARM_NEON__
+#include    <arm_neon.h>
+#endif
+
 
 
 /*----------------------------------------------------------------------------
@@ -112,6 +116,48 @@ Copyright (c) ISO/IEC 2002.
 ; Function Prototype declaration
 ----------------------------------------------------------------------------*/
 
+#ifdef __ARM_NEON__
+
+/*
+ *  Elements n and 64-n, n = 1..31, of array Y, computed for 4 consecutive n
+ *  at a time. vqdmulh of the coefficient by x<<15 is exactly
+ *  fxp_mul32_by_16() and cannot saturate, so Y is bit exact with the C loop.
+ */
+static void analysis_window_neon(const Int16 * X,
+                                 Int32 * Y,
+                                 const Int32 pt_C[8][5][4])
+{
+    for (Int32 n = 1; n < 32; n += 4)
+    {
+        const Int32 (*pt_C_n)[4] = pt_C[n >> 2];
+        int32x4_t realAccu1 = vdupq_n_s32(0);
+        int32x4_t realAccu2 = vdupq_n_s32(0);
+
+        for (Int32 k = 0; k < 5; k++)
+        {
+            int32x4_t coef = vld1q_s32(pt_C_n[k]);
+            int16x4_t tmp1 = vrev64_s16(vld1_s16(&X[-n - 3 - (k << 6)]));
+            int16x4_t tmp2 = vld1_s16(&X[-320 + n + (k << 6)]);
+
+            realAccu1 = vaddq_s32(realAccu1, vqdmulhq_s32(coef, vshll_n_s16(tmp1, 15)));
+            realAccu2 = vaddq_s32(realAccu2, vqdmulhq_s32(coef, vshll_n_s16(tmp2, 15)));
+        }
+
+        Int32 out1[4];
+        Int32 out2[4];
+        vst1q_s32(out1, realAccu1);
+        vst1q_s32(out2, realAccu2);
+
+        for (Int32 i = 0; i < 4 && n + i < 32; i++)
+        {
+            Y[n + i]      = out1[i];
+            Y[64 - n - i] = out2[i];
+        }
+    }
+}
+
+#endif
+
 /*----------------------------------------------------------------------------
 ; LOCAL STORE/BUFFER/POINTER DEFINITIONS
 ; Variable declaration - defined here and used outside this module
@@ -170,6 +216,13 @@ void calc_sbr_anafilterbank_LC(Int32 * Sr,
 
     /* create array Y */
 
+#ifdef __ARM_NEON__
+
+    analysis_window_neon(X, scratch_mem[0], sbrDecoderFilterbankCoefficients_an_filt_LC_neon);
+    p_Y_1 += 31;
+
+#else
+
     pt_X_1 = &X[-1];
     pt_X_2 = &X[-319];
 
@@ -245,6 +298,7 @@ void calc_sbr_anafilterbank_LC(Int32 * Sr,
     *(p_Y_1++) = fxp_mac32_by_16(*(pt_C), tmp1, realAccu1);
     *(p_Y_2--) = fxp_mac32_by_16(*(pt_C++), tmp2, realAccu2);
 
+#endif
 
     pt_X_1 = X;
 
@@ -305,6 +359,13 @@ void calc_sbr_anafilterbank(Int32 * Sr,
 
     /* create array Y */
 
+#ifdef __ARM_NEON__
+
+    analysis_window_neon(X, scratch_mem[0], sbrDecoderFilterbankCoefficients_an_filt_neon);
+    p_Y_1 += 31;
+
+#else
+
     pt_X_1 = &X[-1];
     pt_X_2 = &X[-319];
 
@@ -333,6 +394,7 @@ void calc_sbr_anafilterbank(Int32 * Sr,
         *(p_Y_2--) = fxp_mac32_by_16(*(pt_C++), tmp2, realAccu2);
     }
 
+#endif
 
     realAccu2  = fxp_mul32_by_16(Qfmt27(0.002620176F), X[ -32]);
     realAccu2  = fxp_mac32_by_16(Qfmt27(0.002620176F), X[-288], realAccu2);
@@ -83,6 +83,11 @@ Copyright (c) ISO/IEC 2002.
 /*----------------------------------------------------------------------------
 ; INCLUDES
 ----------------------------------------------------------------------------*/
+#ifdef __ARM_NEON__
+/* ahead of calc_sbr_synfilterbank.h, which defines N */
+#include    <arm_neon.h>
+#endif
+
 #include    "calc_sbr_synfilterbank.h"
 #include    "qmf_filterbank_coeff.h"
 #include    "synthesis_sub_band.h"
@@ -208,6 +213,54 @@ __inline Int16 sat(Int32 y)
 ; Function Prototype declaration
 ----------------------------------------------------------------------------*/
 
+#ifdef __ARM_NEON__
+
+/*
+ *  Output samples n and 64-n, n = 1..31, of the synthesis window, computed for
+ *  4 consecutive n at a time. The products, accumulation and rounding are the
+ *  same as in the C loop, so the output is bit exact.
+ */
+static void synthesis_window_neon(const Int16 V[1280], Int16 * timeSig)
+{
+    const Int16 *pt_C = &sbrDecoderFilterbankCoefficients_neon[0][0][0];
+
+    for (Int32 n = 1; n < 32; n += 4)
+    {
+        int32x4_t realAccu1 = vdupq_n_s32(ROUND_SYNFIL);
+        int32x4_t realAccu2 = vdupq_n_s32(ROUND_SYNFIL);
+
+        for (Int32 k = 0; k < 10; k++)
+        {
+            /* top halves of the coefficients apply to V[n + 256*j], bottom ones to V[n + 256*j + 192] */
+            Int32 offset = ((k >> 1) << 8) + (k & 1) * 192;
+            int16x4_t coef = vld1_s16(pt_C);
+            int16x4_t tmp1 = vld1_s16(&V[n + offset]);
+            int16x4_t tmp2 = vrev64_s16(vld1_s16(&V[1277 - n - offset]));
+
+            realAccu1 = vmlal_s16(realAccu1, tmp1, coef);
+            realAccu2 = vmlal_s16(realAccu2, tmp2, coef);
+            pt_C += 4;
+        }
+
+        /* saturate2() */
+        realAccu1 = vsubq_s32(realAccu1, vshrq_n_s32(realAccu1, 2));
+        realAccu2 = vsubq_s32(realAccu2, vshrq_n_s32(realAccu2, 2));
+
+        Int16 out1[4];
+        Int16 out2[4];
+        vst1_s16(out1, vqshrn_n_s32(realAccu1, N));
+        vst1_s16(out2, vqshrn_n_s32(realAccu2, N));
+
+        for (Int32 i = 0; i < 4 && n + i < 32; i++)
+        {
+            timeSig[  2*(n + i)] = out1[i];
+            timeSig[128 - 2*(n + i)] = out2[i];
+        }
+    }
+}
+
+#endif
+
 
 /*----------------------------------------------------------------------------
 ; LOCAL STORE/BUFFER/POINTER DEFINITIONS
@@ -312,6 +365,12 @@ void calc_sbr_synfilterbank_LC(Int32 * Sr,
 
         saturate2(realAccu1, realAccu2, pt_timeSig, pt_timeSig_2);
 
+#ifdef __ARM_NEON__
+
+        synthesis_window_neon(V, timeSig);
+
+#else
+
         pt_timeSig_2 = &timeSig[126];
 
         pt_V1 = &V[1];
@@ -374,6 +433,8 @@ void calc_sbr_synfilterbank_LC(Int32 * Sr,
             saturate2(realAccu1, realAccu2, pt_timeSig, pt_timeSig_2);
 
         }
+
+#endif
     }
     else
     {
@@ -510,6 +571,12 @@ void calc_sbr_synfilterbank(Int32 * Sr,
 
         saturate2(realAccu1, realAccu2, pt_timeSig, pt_timeSig_2);
 
+#ifdef __ARM_NEON__
+
+        synthesis_window_neon(V, timeSig);
+
+#else
+
         pt_timeSig_2 = &timeSig[126];
 
         pt_V1 = &V[1];
@@ -572,6 +639,8 @@ void calc_sbr_synfilterbank(Int32 * Sr,
             saturate2(realAccu1, realAccu2, pt_timeSig, pt_timeSig_2);
         }
 
+#endif
+
     }
     else
     {
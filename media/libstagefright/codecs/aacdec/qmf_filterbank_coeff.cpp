@@ -182,6 +182,126 @@ const Int32 sbrDecoderFilterbankCoefficients[155] =
     0xFFE500C5,  0x0822F8AC,  0x629B651C,  0xF6B00888,  0x00BCFFE7
 };
 
+#ifdef __ARM_NEON__
+
+/*
+ *  sbrDecoderFilterbankCoefficients regrouped for the NEON window of
+ *  calc_sbr_synfilterbank: for each block of 4 consecutive output samples
+ *  n = 4*b+1 .. 4*b+4, the top and bottom halves of coefficient k of the 4
+ *  samples are stored contiguously. Sample n = 32 does not exist and has all
+ *  zero coefficients.
+ */
+
+const Int16 sbrDecoderFilterbankCoefficients_neon[8][10][4] =
+{
+    {
+           -22,    -22,    -20,    -19,
+           102,    108,    114,    120,
+           524,    566,    610,    654,
+          2511,   2456,   2395,   2329,
+         13558,  13968,  14379,  14790,
+         31077,  31060,  31031,  30991,
+        -12744, -12339, -11936, -11536,
+          2607,   2647,   2682,   2712,
+          -445,   -407,   -370,   -334,
+            90,     84,     79,     73
+    },
+
+    {
+           -19,    -20,    -21,    -21,
+           126,    132,    137,    143,
+           699,    745,    792,    840,
+          2256,   2178,   2095,   2005,
+         15203,  15616,  16029,  16442,
+         30939,  30875,  30801,  30715,
+        -11139, -10744, -10353,  -9965,
+          2737,   2758,   2774,   2786,
+          -299,   -266,   -234,   -203,
+            67,     62,     57,     51
+    },
+
+    {
+           -22,    -23,    -24,    -24,
+           149,    154,    160,    165,
+           889,    939,    990,   1042,
+          1909,   1806,   1698,   1583,
+         16855,  17267,  17677,  18087,
+         30618,  30509,  30390,  30259,
+         -9581,  -9200,  -8823,  -8451,
+          2794,   2797,   2797,   2793,
+          -173,   -145,   -118,    -92,
+            46,     41,     36,     32
+    },
+
+    {
+           -25,    -26,    -27,    -28,
+           170,    175,    179,    184,
+          1095,   1147,   1201,   1255,
+          1462,   1335,   1200,   1059,
+         18495,  18901,  19305,  19706,
+         30118,  29966,  29803,  29630,
+         -8083,  -7719,  -7360,  -7006,
+          2786,   2775,   2760,   2743,
+           -67,    -44,    -21,      2,
+            28,     23,     19,     15
+    },
+
+    {
+           -28,    -29,    -29,    -29,
+           188,    191,    195,    198,
+          1310,   1365,   1421,   1476,
+           912,    758,    596,    429,
+         20105,  20501,  20893,  21282,
+         29446,  29252,  29048,  28834,
+         -6657,  -6314,  -5976,  -5643,
+          2722,   2698,   2671,   2643,
+            22,     40,     58,     74,
+            11,      8,      4,      1
+    },
+
+    {
+           -30,    -30,    -30,    -30,
+           200,    202,    204,    205,
+          1532,   1588,   1644,   1700,
+           254,     72,   -118,   -314,
+         21667,  22048,  22424,  22796,
+         28611,  28378,  28136,  27884,
+         -5316,  -4995,  -4680,  -4371,
+          2611,   2577,   2540,   2502,
+            90,    104,    117,    129,
+            -4,     -7,     -9,    -12
+    },
+
+    {
+           -30,    -30,    -29,    -29,
+           206,    206,    205,    204,
+          1756,   1811,   1867,   1921,
+          -516,   -725,   -942,  -1165,
+         23163,  23525,  23880,  24230,
+         27623,  27354,  27076,  26790,
+         -4068,  -3771,  -3480,  -3196,
+          2462,   2419,   2375,   2330,
+           141,    151,    160,    168,
+           -14,    -16,    -18,    -20
+    },
+
+    {
+           -28,    -28,    -27,      0,
+           202,    200,    197,      0,
+          1975,   2029,   2082,      0,
+         -1395,  -1632,  -1876,      0,
+         24575,  24912,  25243,      0,
+         26496,  26194,  25884,      0,
+         -2919,  -2648,  -2384,      0,
+          2283,   2234,   2184,      0,
+           176,    182,    188,      0,
+           -22,    -23,    -25,      0
+    }
+};
+
+#endif
+
+
 
 const Int32 sbrDecoderFilterbankCoefficients_down_smpl[160] =
 {
@@ -271,6 +391,83 @@ const Int32 sbrDecoderFilterbankCoefficients_an_filt_LC[155] =
     Qfmt27(1.20646855283790F), Qfmt27(0.09539224314440F), Qfmt27(0.00416760958657F)
 };
 
+#ifdef __ARM_NEON__
+
+/*
+ *  sbrDecoderFilterbankCoefficients_an_filt_LC regrouped the same way for the NEON
+ *  window of calc_sbr_anafilterbank_LC.
+ */
+
+const Int32 sbrDecoderFilterbankCoefficients_an_filt_LC_neon[8][5][4] =
+{
+    {
+        Qfmt27(-0.00079446133872F), Qfmt27(-0.00068946163857F), Qfmt27(-0.00071286404460F), Qfmt27(-0.00077308974337F),
+        Qfmt27(0.02197766364781F), Qfmt27(0.02537571195384F), Qfmt27(0.02892516313544F), Qfmt27(0.03262310249845F),
+        Qfmt27(0.54254182141522F), Qfmt27(0.57449847577240F), Qfmt27(0.60657315615086F), Qfmt27(0.63865835544980F),
+        Qfmt27(-0.47923775873194F), Qfmt27(-0.44806230039026F), Qfmt27(-0.41729436041451F), Qfmt27(-0.38701849746199F),
+        Qfmt27(-0.01574239605130F), Qfmt27(-0.01291535202742F), Qfmt27(-0.01026942774868F), Qfmt27(-0.00782586328859F)
+    },
+
+    {
+        Qfmt27(-0.00083027488297F), Qfmt27(-0.00089272089703F), Qfmt27(-0.00095851011196F), Qfmt27(-0.00101225729839F),
+        Qfmt27(0.03646915244785F), Qfmt27(0.04045671426315F), Qfmt27(0.04455021764484F), Qfmt27(0.04873676213679F),
+        Qfmt27(0.67068416485018F), Qfmt27(0.70254003810627F), Qfmt27(0.73415149000395F), Qfmt27(0.76545064960593F),
+        Qfmt27(-0.35729827194706F), Qfmt27(-0.32819525024294F), Qfmt27(-0.29977591877185F), Qfmt27(-0.27208998714049F),
+        Qfmt27(-0.00557215982767F), Qfmt27(-0.00351102841332F), Qfmt27(-0.00163598204794F), Qfmt27(0.00003903936539F)
+    },
+
+    {
+        Qfmt27(-0.00105230782648F), Qfmt27(-0.00108630976316F), Qfmt27(-0.00110794157381F), Qfmt27(-0.00110360418081F),
+        Qfmt27(0.05300654158217F), Qfmt27(0.05732502937107F), Qfmt27(0.06167350555855F), Qfmt27(0.06602157445253F),
+        Qfmt27(0.79631383686511F), Qfmt27(0.82666485395476F), Qfmt27(0.85641712130638F), Qfmt27(0.88547343436495F),
+        Qfmt27(-0.24519750285673F), Qfmt27(-0.21914753347432F), Qfmt27(-0.19396671004887F), Qfmt27(-0.16971665552213F),
+        Qfmt27(0.00154182229475F), Qfmt27(0.00286720203220F), Qfmt27(0.00402297937976F), Qfmt27(0.00500649278750F)
+    },
+
+    {
+        Qfmt27(-0.00109714405326F), Qfmt27(-0.00106490281247F), Qfmt27(-0.00102041023958F), Qfmt27(-0.00094051141595F),
+        Qfmt27(0.07034096875232F), Qfmt27(0.07461825625751F), Qfmt27(0.07879625324269F), Qfmt27(0.08286099010631F),
+        Qfmt27(0.91376152398903F), Qfmt27(0.94117890777861F), Qfmt27(0.96765488212662F), Qfmt27(0.99311573680798F),
+        Qfmt27(-0.14641770628514F), Qfmt27(-0.12410396326951F), Qfmt27(-0.10280530739363F), Qfmt27(-0.08254839941155F),
+        Qfmt27(0.00583386287581F), Qfmt27(0.00651097277313F), Qfmt27(0.00704839655425F), Qfmt27(0.00745513427428F)
+    },
+
+    {
+        Qfmt27(-0.00084090835475F), Qfmt27(-0.00072769348801F), Qfmt27(-0.00057913742435F), Qfmt27(-0.00040969484059F),
+        Qfmt27(0.08675566213219F), Qfmt27(0.09046949018457F), Qfmt27(0.09395575430420F), Qfmt27(0.09716267023308F),
+        Qfmt27(1.01745066253324F), Qfmt27(1.04060828658052F), Qfmt27(1.06251808919053F), Qfmt27(1.08310018709600F),
+        Qfmt27(-0.06332944781672F), Qfmt27(-0.04518854556363F), Qfmt27(-0.02811939233087F), Qfmt27(-0.01212147193047F),
+        Qfmt27(0.00774335382672F), Qfmt27(0.00790787636150F), Qfmt27(0.00797463714114F), Qfmt27(0.00795079915733F)
+    },
+
+    {
+        Qfmt27(-0.00020454902123F), Qfmt27(0.00001908481202F), Qfmt27(0.00028892665922F), Qfmt27(0.00056943874774F),
+        Qfmt27(0.10007381188066F), Qfmt27(0.10262701466139F), Qfmt27(0.10479373974558F), Qfmt27(0.10650970405576F),
+        Qfmt27(1.10227871198194F), Qfmt27(1.12001978353403F), Qfmt27(1.13624787143434F), Qfmt27(1.15091404672203F),
+        Qfmt27(0.00279527795884F), Qfmt27(0.01663452156443F), Qfmt27(0.02941522773279F), Qfmt27(0.04112872592057F),
+        Qfmt27(0.00784545014643F), Qfmt27(0.00766458213130F), Qfmt27(0.00741912981120F), Qfmt27(0.00712664923329F)
+    },
+
+    {
+        Qfmt27(0.00088238158168F), Qfmt27(0.00121741725989F), Qfmt27(0.00159101288509F), Qfmt27(0.00196610899088F),
+        Qfmt27(0.10776200996423F), Qfmt27(0.10848340171661F), Qfmt27(0.10864412991640F), Qfmt27(0.10819451041273F),
+        Qfmt27(1.16395714324633F), Qfmt27(1.17535833075364F), Qfmt27(1.18507099110810F), Qfmt27(1.19306425909871F),
+        Qfmt27(0.05181934748033F), Qfmt27(0.06148559051724F), Qfmt27(0.07014197759039F), Qfmt27(0.07784680399703F),
+        Qfmt27(0.00677868764313F), Qfmt27(0.00639363830229F), Qfmt27(0.00597707038378F), Qfmt27(0.00554476792518F)
+    },
+
+    {
+        Qfmt27(0.00238550675072F), Qfmt27(0.00280596092809F), Qfmt27(0.00325513071185F), Qfmt27(0.0F),
+        Qfmt27(0.10709920766553F), Qfmt27(0.10531144797543F), Qfmt27(0.10278145526768F), Qfmt27(0.0F),
+        Qfmt27(1.19929775892826F), Qfmt27(1.20377455661175F), Qfmt27(1.20646855283790F), Qfmt27(0.0F),
+        Qfmt27(0.08459352758522F), Qfmt27(0.09043115226911F), Qfmt27(0.09539224314440F), Qfmt27(0.0F),
+        Qfmt27(0.00509233837916F), Qfmt27(0.00463008004888F), Qfmt27(0.00416760958657F), Qfmt27(0.0F)
+    }
+};
+
+#endif
+
+
 
 
 #ifdef HQ_SBR
@@ -311,6 +508,83 @@ const Int32 sbrDecoderFilterbankCoefficients_an_filt[155] =
     Qfmt27(+ 0.002301725F),   Qfmt27(+ 0.072677464F),   Qfmt27(+ 0.853102095F),   Qfmt27(+ 0.067452502F),   Qfmt27(+ 0.002946945F)
 };
 
+#ifdef __ARM_NEON__
+
+/*
+ *  sbrDecoderFilterbankCoefficients_an_filt regrouped the same way for the NEON
+ *  window of calc_sbr_anafilterbank.
+ */
+
+const Int32 sbrDecoderFilterbankCoefficients_an_filt_neon[8][5][4] =
+{
+    {
+        Qfmt27(-0.000561769F), Qfmt27(-0.000487523F), Qfmt27(-0.000504071F), Qfmt27(-0.000546657F),
+        Qfmt27(+ 0.015540555F), Qfmt27(+ 0.017943338F), Qfmt27(+ 0.020453179F), Qfmt27(+ 0.023068017F),
+        Qfmt27(+ 0.383635001F), Qfmt27(+ 0.406231768F), Qfmt27(+ 0.428911992F), Qfmt27(+ 0.451599654F),
+        Qfmt27(-0.338872269F), Qfmt27(-0.316827891F), Qfmt27(-0.295071672F), Qfmt27(-0.273663404F),
+        Qfmt27(-0.011131555F), Qfmt27(-0.009132533F), Qfmt27(-0.007261582F), Qfmt27(-0.005533721F)
+    },
+
+    {
+        Qfmt27(-0.000587093F), Qfmt27(-0.000631249F), Qfmt27(-0.000677769F), Qfmt27(-0.000715774F),
+        Qfmt27(+ 0.025787585F), Qfmt27(+ 0.028607217F), Qfmt27(+ 0.031501761F), Qfmt27(+ 0.034462095F),
+        Qfmt27(+ 0.474245321F), Qfmt27(+ 0.496770825F), Qfmt27(+ 0.519123497F), Qfmt27(+ 0.541255345F),
+        Qfmt27(-0.252648031F), Qfmt27(-0.232069087F), Qfmt27(-0.211973585F), Qfmt27(-0.192396675F),
+        Qfmt27(-0.003940112F), Qfmt27(-0.002482672F), Qfmt27(-0.001156814F), Qfmt27(+ 0.000027605F)
+    },
+
+    {
+        Qfmt27(-0.000744094F), Qfmt27(-0.000768137F), Qfmt27(-0.000783433F), Qfmt27(-0.000780366F),
+        Qfmt27(+ 0.037481285F), Qfmt27(+ 0.040534917F), Qfmt27(+ 0.043609754F), Qfmt27(+ 0.046684303F),
+        Qfmt27(+ 0.563078914F), Qfmt27(+ 0.584540324F), Qfmt27(+ 0.605578354F), Qfmt27(+ 0.626124270F),
+        Qfmt27(-0.173380817F), Qfmt27(-0.154960707F), Qfmt27(-0.137155176F), Qfmt27(-0.120007798F),
+        Qfmt27(+ 0.001090233F), Qfmt27(+ 0.002027418F), Qfmt27(+ 0.002844676F), Qfmt27(+ 0.003540125F)
+    },
+
+    {
+        Qfmt27(-0.000775798F), Qfmt27(-0.000753000F), Qfmt27(-0.000721539F), Qfmt27(-0.000665042F),
+        Qfmt27(+ 0.049738576F), Qfmt27(+ 0.052763075F), Qfmt27(+ 0.055717365F), Qfmt27(+ 0.058591568F),
+        Qfmt27(+ 0.646126970F), Qfmt27(+ 0.665513988F), Qfmt27(+ 0.684235329F), Qfmt27(+ 0.702238872F),
+        Qfmt27(-0.103532953F), Qfmt27(-0.087754754F), Qfmt27(-0.072694330F), Qfmt27(-0.058370533F),
+        Qfmt27(+ 0.004125164F), Qfmt27(+ 0.004603953F), Qfmt27(+ 0.004983969F), Qfmt27(+ 0.005271576F)
+    },
+
+    {
+        Qfmt27(-0.000594612F), Qfmt27(-0.000514557F), Qfmt27(-0.000409512F), Qfmt27(-0.000289698F),
+        Qfmt27(+ 0.061345517F), Qfmt27(+ 0.063971590F), Qfmt27(+ 0.066436751F), Qfmt27(+ 0.068704383F),
+        Qfmt27(+ 0.719446263F), Qfmt27(+ 0.735821176F), Qfmt27(+ 0.751313746F), Qfmt27(+ 0.765867487F),
+        Qfmt27(-0.044780682F), Qfmt27(-0.031953127F), Qfmt27(-0.019883413F), Qfmt27(-0.008571175F),
+        Qfmt27(+ 0.005475378F), Qfmt27(+ 0.005591713F), Qfmt27(+ 0.005638920F), Qfmt27(+ 0.005622064F)
+    },
+
+    {
+        Qfmt27(-0.000144638F), Qfmt27(+ 0.000013495F), Qfmt27(+ 0.000204302F), Qfmt27(+ 0.000402654F),
+        Qfmt27(+ 0.070762871F), Qfmt27(+ 0.072568258F), Qfmt27(+ 0.074100364F), Qfmt27(+ 0.075313734F),
+        Qfmt27(+ 0.779428752F), Qfmt27(+ 0.791973584F), Qfmt27(+ 0.803448575F), Qfmt27(+ 0.813819127F),
+        Qfmt27(+ 0.001976560F), Qfmt27(+ 0.011762383F), Qfmt27(+ 0.020799707F), Qfmt27(+ 0.029082401F),
+        Qfmt27(+ 0.005547571F), Qfmt27(+ 0.005419678F), Qfmt27(+ 0.005246117F), Qfmt27(+ 0.005039302F)
+    },
+
+    {
+        Qfmt27(+ 0.000623938F), Qfmt27(+ 0.000860844F), Qfmt27(+ 0.001125016F), Qfmt27(+ 0.001390249F),
+        Qfmt27(+ 0.076199248F), Qfmt27(+ 0.076709349F), Qfmt27(+ 0.076823001F), Qfmt27(+ 0.076505072F),
+        Qfmt27(+ 0.823041989F), Qfmt27(+ 0.831103846F), Qfmt27(+ 0.837971734F), Qfmt27(+ 0.843623828F),
+        Qfmt27(+ 0.036641812F), Qfmt27(+ 0.043476878F), Qfmt27(+ 0.049597868F), Qfmt27(+ 0.055046003F),
+        Qfmt27(+ 0.004793256F), Qfmt27(+ 0.004520985F), Qfmt27(+ 0.004226427F), Qfmt27(+ 0.003920743F)
+    },
+
+    {
+        Qfmt27(+ 0.001686808F), Qfmt27(+ 0.001984114F), Qfmt27(+ 0.002301725F), Qfmt27(0.0F),
+        Qfmt27(+ 0.075730576F), Qfmt27(+ 0.074466439F), Qfmt27(+ 0.072677464F), Qfmt27(0.0F),
+        Qfmt27(+ 0.848031578F), Qfmt27(+ 0.851197152F), Qfmt27(+ 0.853102095F), Qfmt27(0.0F),
+        Qfmt27(+ 0.059816657F), Qfmt27(+ 0.063944481F), Qfmt27(+ 0.067452502F), Qfmt27(0.0F),
+        Qfmt27(+ 0.003600827F), Qfmt27(+ 0.003273961F), Qfmt27(+ 0.002946945F), Qfmt27(0.0F)
+    }
+};
+
+#endif
+
+
 
 
 #endif  /* HQ_SBR */
@@ -74,6 +74,14 @@ extern const Int32 sbrDecoderFilterbankCoefficients_an_filt_LC[155];
 extern const Int32 sbrDecoderFilterbankCoefficients_an_filt[155];
 #endif
 
+#ifdef __ARM_NEON__
+extern const Int16 sbrDecoderFilterbankCoefficients_neon[8][10][4];
+extern const Int32 sbrDecoderFilterbankCoefficients_an_filt_LC_neon[8][5][4];
+#ifdef HQ_SBR
+extern const Int32 sbrDecoderFilterbankCoefficients_an_filt_neon[8][5][4];
+#endif
+#endif
+
 /*----------------------------------------------------------------------------
 ; SIMPLE TYPEDEF'S
 ----------------------------------------------------------------------------*/
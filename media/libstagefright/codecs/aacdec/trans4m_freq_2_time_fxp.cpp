@@ -448,6 +448,10 @@ OUT          ==============================================================
 
 #include "fxp_mul32.h"
 
+#ifdef __ARM_NEON__
+#include <arm_neon.h>
+#endif
+
 
 /*----------------------------------------------------------------------------
 ; MACROS
@@ -533,6 +537,56 @@ __inline Int16 sat(Int32 y)
 ; Function Prototype declaration
 ----------------------------------------------------------------------------*/
 
+#ifdef __ARM_NEON__
+
+/*
+ *  ONLY_LONG_SEQUENCE windowing, overlap and add with the previous frame and
+ *  setup of the overlap and add buffer for the next one, 4 samples at a time.
+ *  The output is written every out_stride samples and is bit exact with the
+ *  limiter() of the C loops.
+ */
+static void long_window_overlap_add_neon(
+    const Int16 *pFreqInfo,
+    Int32       *pOverlap_and_Add_Buffer,
+    Int16       *pOutput_buffer,
+    Int          out_stride,
+    const Int16 *pLong_Window_prev,
+    const Int16 *pLong_Window_this,
+    Int          shift)
+{
+    const int32x4_t vshift = vdupq_n_s32(-shift);
+    const int32x4_t vround = vdupq_n_s32(ROUNDING);
+    const Int16 *pFreqInfo_2 = &pFreqInfo[LONG_WINDOW];
+    const Int16 *pLong_Window_2 = &pLong_Window_this[LONG_WINDOW - 4];
+
+    for (Int i = 0; i < LONG_WINDOW; i += 4)
+    {
+        int32x4_t temp = vmull_s16(vld1_s16(&pFreqInfo[i]), vld1_s16(&pLong_Window_prev[i]));
+        temp = vaddq_s32(vshlq_s32(temp, vshift), vld1q_s32(&pOverlap_and_Add_Buffer[i]));
+        int16x4_t out = vqshrn_n_s32(vaddq_s32(temp, vround), SCALING);
+
+        if (out_stride == 1)
+        {
+            vst1_s16(&pOutput_buffer[i], out);
+        }
+        else
+        {
+            Int16 *pOut = &pOutput_buffer[i * out_stride];
+            vst1_lane_s16(pOut, out, 0);
+            vst1_lane_s16(pOut + out_stride, out, 1);
+            vst1_lane_s16(pOut + 2 * out_stride, out, 2);
+            vst1_lane_s16(pOut + 3 * out_stride, out, 3);
+        }
+
+        /* the second half of the frame is windowed with the descending window */
+        int16x4_t win = vrev64_s16(vld1_s16(pLong_Window_2 - i));
+        temp = vmull_s16(vld1_s16(&pFreqInfo_2[i]), win);
+        vst1q_s32(&pOverlap_and_Add_Buffer[i], vshlq_s32(temp, vshift));
+    }
+}
+
+#endif
+
 
 /*----------------------------------------------------------------------------
 ; LOCAL VARIABLE DEFINITIONS
@@ -644,6 +698,18 @@ void trans4m_freq_2_time_fxp_1(
                 case ONLY_LONG_SEQUENCE:
                 default:
 
+#ifdef __ARM_NEON__
+
+                    long_window_overlap_add_neon(pFreqInfo,
+                                                 Time_data,
+                                                 Output_buffer,
+                                                 1,
+                                                 Long_Window_fxp[wnd_shape_prev_bk],
+                                                 Long_Window_fxp[wnd_shape_this_bk],
+                                                 exp + 15 - SCALING);
+
+#else
+
                     pOutput_buffer = Output_buffer;
 
                     pOverlap_and_Add_Buffer_1 = Time_data;
@@ -688,6 +754,8 @@ void trans4m_freq_2_time_fxp_1(
                         }
                     }
 
+#endif
+
                     break;
 
                 case LONG_START_SEQUENCE:
@@ -1647,6 +1715,18 @@ void trans4m_freq_2_time_fxp_2(
                 case ONLY_LONG_SEQUENCE:
                 default:
 
+#ifdef __ARM_NEON__
+
+                long_window_overlap_add_neon(pFreqInfo,
+                                             Time_data,
+                                             Interleaved_output,
+                                             2,
+                                             Long_Window_fxp[wnd_shape_prev_bk],
+                                             Long_Window_fxp[wnd_shape_this_bk],
+                                             exp + 15 - SCALING);
+
+#else
+
                 {
                     pOverlap_and_Add_Buffer_1 = Time_data;
 
@@ -1697,6 +1777,8 @@ void trans4m_freq_2_time_fxp_2(
 
                 }
 
+#endif
+
                 break;
 
                 case LONG_START_SEQUENCE:
@@ -45,6 +45,10 @@ SoftAACEncoder2::SoftAACEncoder2(
       mSampleRate(44100),
       mBitRate(0),
       mAACProfile(OMX_AUDIO_AACObjectLC),
+      mAACTools(OMX_AUDIO_AACToolAll),
+      mAudioBandWidth(0),
+      mFrameLength(0),
+      mSamplesPerFrame(0),
       mSentCodecSpecificData(false),
       mInputSize(0),
       mInputFrame(NULL),
@@ -145,8 +149,8 @@ OMX_ERRORTYPE SoftAACEncoder2::internalGetParameter(
             }
 
             aacParams->nBitRate = mBitRate;
-            aacParams->nAudioBandWidth = 0;
-            aacParams->nAACtools = 0;
+            aacParams->nAudioBandWidth = mAudioBandWidth;
+            aacParams->nAACtools = mAACTools;
             aacParams->nAACERtools = 0;
             aacParams->eAACProfile = (OMX_AUDIO_AACPROFILETYPE) mAACProfile;
             aacParams->eAACStreamFormat = OMX_AUDIO_AACStreamFormatMP4FF;
@@ -154,7 +158,8 @@ OMX_ERRORTYPE SoftAACEncoder2::internalGetParameter(
 
             aacParams->nChannels = mNumChannels;
             aacParams->nSampleRate = mSampleRate;
-            aacParams->nFrameLength = 0;
+            aacParams->nFrameLength =
+                (mSamplesPerFrame != 0) ? mSamplesPerFrame : mFrameLength;
 
             return OMX_ErrorNone;
         }
@@ -242,6 +247,9 @@ OMX_ERRORTYPE SoftAACEncoder2::internalSetParameter(
             if (aacParams->eAACProfile != OMX_AUDIO_AACObjectNull) {
                 mAACProfile = aacParams->eAACProfile;
             }
+            mAACTools = aacParams->nAACtools;
+            mAudioBandWidth = aacParams->nAudioBandWidth;
+            mFrameLength = aacParams->nFrameLength;
 
             if (setAudioParams() != OK) {
                 return OMX_ErrorUndefined;
@@ -292,6 +300,10 @@ static AUDIO_OBJECT_TYPE getAOTFromProfile(OMX_U32 profile) {
         return AOT_AAC_LC;
     } else if (profile == OMX_AUDIO_AACObjectHE) {
         return AOT_SBR;
+    } else if (profile == OMX_AUDIO_AACObjectHE_PS) {
+        return AOT_PS;
+    } else if (profile == OMX_AUDIO_AACObjectLD) {
+        return AOT_ER_AAC_LD;
     } else if (profile == OMX_AUDIO_AACObjectELD) {
         return AOT_ER_AAC_ELD;
     } else {
@@ -300,6 +312,18 @@ static AUDIO_OBJECT_TYPE getAOTFromProfile(OMX_U32 profile) {
     }
 }
 
+static bool isLowDelayProfile(OMX_U32 profile) {
+    return profile == OMX_AUDIO_AACObjectLD || profile == OMX_AUDIO_AACObjectELD;
+}
+
+// A client that leaves TNS or PNS out of nAACtools asks for the cheaper
+// encoding. OMX_AUDIO_AACToolNone is what clients that don't care send.
+bool SoftAACEncoder2::isReducedComplexity() const {
+    const OMX_U32 kFullTools = OMX_AUDIO_AACToolTNS | OMX_AUDIO_AACToolPNS;
+    return mAACTools != OMX_AUDIO_AACToolNone
+            && (mAACTools & kFullTools) != kFullTools;
+}
+
 status_t SoftAACEncoder2::setAudioParams() {
     // We call this whenever sample rate, number of channels or bitrate change
     // in reponse to setParameter calls.
@@ -331,6 +355,46 @@ status_t SoftAACEncoder2::setAudioParams() {
         return UNKNOWN_ERROR;
     }
 
+    // LD and ELD code 480 or 512 samples per frame, the other profiles
+    // always use 1024.
+    bool lowDelay = isLowDelayProfile(mAACProfile);
+    OMX_U32 frameLength = mFrameLength;
+    if (frameLength == 0) {
+        frameLength = lowDelay ? 512 : kNumSamplesPerFrame;
+    }
+    if (lowDelay ? (frameLength != 480 && frameLength != 512)
+                 : (frameLength != kNumSamplesPerFrame)) {
+        ALOGE("Unsupported frame length %lu for this AAC profile", frameLength);
+        return UNKNOWN_ERROR;
+    }
+    if (AACENC_OK != aacEncoder_SetParam(mAACEncoder, AACENC_GRANULE_LENGTH, frameLength)) {
+        ALOGE("Failed to set AAC encoder parameters");
+        return UNKNOWN_ERROR;
+    }
+
+    // Zero lets the encoder derive the audio bandwidth from the bitrate.
+    // A narrower band leaves fewer spectral lines for the psychoacoustic
+    // model and the quantizer to work on.
+    OMX_U32 bandWidth = mAudioBandWidth;
+    if (bandWidth > mSampleRate / 2) {
+        bandWidth = mSampleRate / 2;
+    }
+    if (AACENC_OK != aacEncoder_SetParam(mAACEncoder, AACENC_BANDWIDTH, bandWidth)) {
+        ALOGE("Failed to set AAC encoder parameters");
+        return UNKNOWN_ERROR;
+    }
+
+    // The afterburner re-runs the quantization loop to spend the bits
+    // better, which is the most expensive part of the encoder.
+    bool reducedComplexity = isReducedComplexity();
+    ALOGV("setAudioParams: tools 0x%08lx, bandwidth %lu Hz, %s complexity",
+         mAACTools, bandWidth, reducedComplexity ? "reduced" : "full");
+    if (AACENC_OK != aacEncoder_SetParam(mAACEncoder, AACENC_AFTERBURNER,
+            reducedComplexity ? 0 : 1)) {
+        ALOGE("Failed to set AAC encoder parameters");
+        return UNKNOWN_ERROR;
+    }
+
     return OK;
 }
 
@@ -370,6 +434,7 @@ void SoftAACEncoder2::onQueueFilled(OMX_U32 portIndex) {
             mSignalledError = true;
             return;
         }
+        mSamplesPerFrame = encInfo.frameLength;
 
         BufferInfo *outInfo = *outQueue.begin();
         OMX_BUFFERHEADERTYPE *outHeader = outInfo->mHeader;
@@ -386,13 +451,10 @@ void SoftAACEncoder2::onQueueFilled(OMX_U32 portIndex) {
         mSentCodecSpecificData = true;
     }
 
+    // Feed the encoder one of its frames at a time, for LD and ELD that is
+    // less than kNumSamplesPerFrame and we get one access unit per buffer.
     size_t numBytesPerInputFrame =
-        mNumChannels * kNumSamplesPerFrame * sizeof(int16_t);
-
-    // Limit input size so we only get one ELD frame
-    if (mAACProfile == OMX_AUDIO_AACObjectELD && numBytesPerInputFrame > 512) {
-        numBytesPerInputFrame = 512;
-    }
+        mNumChannels * mSamplesPerFrame * sizeof(int16_t);
 
     for (;;) {
         // We do the following until we run out of buffers.
@@ -54,6 +54,10 @@ private:
     OMX_U32 mSampleRate;
     OMX_U32 mBitRate;
     OMX_U32 mAACProfile;
+    OMX_U32 mAACTools;
+    OMX_U32 mAudioBandWidth;
+    OMX_U32 mFrameLength;
+    OMX_U32 mSamplesPerFrame;
 
     bool mSentCodecSpecificData;
     size_t mInputSize;
@@ -68,6 +72,7 @@ private:
     status_t initEncoder();
 
     status_t setAudioParams();
+    bool isReducedComplexity() const;
 
     DISALLOW_EVIL_CONSTRUCTORS(SoftAACEncoder2);
 };
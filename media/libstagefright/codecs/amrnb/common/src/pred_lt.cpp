@@ -80,6 +80,10 @@ terms listed above has been obtained from the copyright holder.
 #include "pred_lt.h"
 #include "cnst.h"
 
+#ifdef __ARM_NEON__
+#include <arm_neon.h>
+#endif
+
 /*----------------------------------------------------------------------------
 ; MACROS
 ; Define module specific macros here
@@ -316,6 +320,36 @@ void Pred_lt_3or6(
 
     p_exc = exc;
 
+#ifdef __ARM_NEON__
+    /*
+     * exc[n] = (0x4000 + sum(pX0[n-i] * c1[i] + pX0[n+1+i] * c2[i])) >> 15
+     * for 4 outputs at once. The last input of a block is at most
+     * exc[n+3+L_INTER10-T0], so lags too short for the block to only read
+     * outputs of the previous blocks are still done 2 by 2 below.
+     */
+    if (T0 > L_INTER10 + 3)
+    {
+        for (j = (L_subfr >> 2); j != 0 ; j--)
+        {
+            int32x4_t s = vdupq_n_s32(0x00004000L);
+
+            pC1 = Coeff_1;
+
+            for (i = 0; i < L_INTER10; i++)
+            {
+                s = vmlal_n_s16(s, vld1_s16(pX0 - i), *(pC1++));
+                s = vmlal_n_s16(s, vld1_s16(pX0 + 1 + i), *(pC1++));
+            }
+
+            vst1_s16(p_exc, vshrn_n_s32(s, 15));
+            p_exc += 4;
+            pX0 += 4;
+        }
+
+        return;
+    }
+#endif
+
     for (j = (L_subfr >> 1); j != 0 ; j--)
     {
         pX0++;
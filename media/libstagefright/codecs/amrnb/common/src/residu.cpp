@@ -74,6 +74,10 @@ terms listed above has been obtained from the copyright holder.
 #include "typedef.h"
 #include "cnst.h"
 
+#ifdef __ARM_NEON__
+#include <arm_neon.h>
+#endif
+
 /*----------------------------------------------------------------------------
 ; MACROS
 ; Define module specific macros here
@@ -200,8 +204,27 @@ void Residu(
     Word16 input_len        /* (i)     : size of filtering      */
 )
 {
+#ifdef __ARM_NEON__
+    /*
+     * 4 consecutive outputs per vector, one tap at a time. As below, the
+     * blocks are done from the end of the buffer so that residual_ptr may be
+     * the same as input_ptr, and the first (input_len & 3) outputs are not
+     * computed.
+     */
+    Word16 i, j;
 
+    for (i = input_len - 4; i >= (input_len & 3); i -= 4)
+    {
+        int32x4_t s = vdupq_n_s32(0x0000800L);
 
+        for (j = 0; j <= M; j++)
+        {
+            s = vmlal_n_s16(s, vld1_s16(&input_ptr[i - j]), coef_ptr[j]);
+        }
+
+        vst1_s16(&residual_ptr[i], vshrn_n_s32(s, 12));
+    }
+#else
     register Word16 i, j;
     Word32 s1;
     Word32 s2;
@@ -250,6 +273,7 @@ void Residu(
         *(p_residual_ptr--) = (Word16)(s4 >> 12);
 
     }
+#endif
 
     return;
 }
@@ -100,6 +100,10 @@ terms listed above has been obtained from the copyright holder.
 
 #include    "basic_op.h"
 
+#ifdef __ARM_NEON__
+#include <arm_neon.h>
+#endif
+
 /*----------------------------------------------------------------------------
 ; MACROS
 ; Define module specific macros here
@@ -116,6 +120,21 @@ terms listed above has been obtained from the copyright holder.
 ; LOCAL FUNCTION DEFINITIONS
 ; Function Prototype declaration
 ----------------------------------------------------------------------------*/
+#ifdef __ARM_NEON__
+/* Q12 accumulator to 16 bits, with the same overflow check as Syn_filt */
+static inline Word16 syn_filt_sat(Word32 s)
+{
+    if ((UWord32)(s - 0xf8000000L) < 0x0fffffffL)
+    {
+        return (Word16)(s >> 12);
+    }
+    else if (s > 0x07ffffffL)
+    {
+        return MAX_16;
+    }
+    return MIN_16;
+}
+#endif
 
 /*----------------------------------------------------------------------------
 ; LOCAL STORE/BUFFER/POINTER DEFINITIONS
@@ -337,6 +356,49 @@ void Syn_filt(
         *(p_y++) = temp;
     }
 
+#ifdef __ARM_NEON__
+    /*
+     * From here on the filter memory is all in y[]. The taps a[4..10] only
+     * reach outputs of previous blocks, so they are accumulated for 4 outputs
+     * at once; the 3 most recent taps are then applied output by output.
+     * The accumulation wraps like amrnb_fxp_msu_16_by_16bb, so the order of
+     * the taps does not change the result.
+     */
+    for (i = (lg - M) >> 2; i != 0; i--)
+    {
+        Word32 s[4];
+        int32x4_t acc = vdupq_n_s32(0x00000800L);
+
+        acc = vmlal_n_s16(acc, vld1_s16(p_x), a[0]);
+        for (j = 4; j <= M; j++)
+        {
+            acc = vmlsl_n_s16(acc, vld1_s16(p_y - j), a[j]);
+        }
+        vst1q_s32(s, acc);
+        p_x += 4;
+
+        for (j = 0; j < 4; j++)
+        {
+            s1 = amrnb_fxp_msu_16_by_16bb((Word32)a[1], (Word32)p_y[-1], s[j]);
+            s1 = amrnb_fxp_msu_16_by_16bb((Word32)a[2], (Word32)p_y[-2], s1);
+            s1 = amrnb_fxp_msu_16_by_16bb((Word32)a[3], (Word32)p_y[-3], s1);
+
+            *(p_y++) = syn_filt_sat(s1);
+        }
+    }
+
+    for (i = (lg - M) & 3; i != 0; i--)
+    {
+        s1 = amrnb_fxp_mac_16_by_16bb((Word32) * (p_x++), (Word32)a[0], 0x00000800L);
+
+        for (j = 1; j <= M; j++)
+        {
+            s1 = amrnb_fxp_msu_16_by_16bb((Word32)a[j], (Word32)p_y[-j], s1);
+        }
+
+        *(p_y++) = syn_filt_sat(s1);
+    }
+#else
     p_yy1 = &y[M-1];
 
     for (i = (lg - M) >> 1; i != 0; i--)
@@ -388,6 +450,7 @@ void Syn_filt(
             *(p_y++) = MIN_16;
         }
     }
+#endif
 
     /* Update of memory if update==1 */
     if (update != 0)
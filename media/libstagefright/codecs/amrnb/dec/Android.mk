@@ -81,3 +81,29 @@ LOCAL_MODULE := libstagefright_soft_amrdec
 LOCAL_MODULE_TAGS := optional
 
 include $(BUILD_SHARED_LIBRARY)
+
+################################################################################
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES := \
+        test/amrnbdec_bench.cpp
+
+LOCAL_C_INCLUDES := \
+        $(LOCAL_PATH)/src \
+        $(LOCAL_PATH)/include \
+        $(LOCAL_PATH)/../common/include \
+        $(LOCAL_PATH)/../common
+
+LOCAL_CFLAGS := -DOSCL_IMPORT_REF=
+
+LOCAL_STATIC_LIBRARIES := \
+        libstagefright_amrnbdec
+
+LOCAL_SHARED_LIBRARIES := \
+        libstagefright_amrnb_common
+
+LOCAL_MODULE := amrnbdec_bench
+LOCAL_MODULE_TAGS := debug
+
+include $(BUILD_EXECUTABLE)
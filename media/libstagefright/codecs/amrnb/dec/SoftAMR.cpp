@@ -294,7 +294,7 @@ void SoftAMR::onQueueFilled(OMX_U32 portIndex) {
             inInfo->mOwnedByUs = false;
             notifyEmptyBufferDone(inHeader);
 
-            outHeader->nFilledLen = 0;
+            // keep the frames already batched into this buffer, if any
             outHeader->nFlags = OMX_BUFFERFLAG_EOS;
 
             outQueue.erase(outQueue.begin());
@@ -311,12 +311,16 @@ void SoftAMR::onQueueFilled(OMX_U32 portIndex) {
         const uint8_t *inputPtr = inHeader->pBuffer + inHeader->nOffset;
         int32_t numBytesRead;
 
+        // in batch mode, append after the frames already in the buffer
+        int16_t *outPtr = reinterpret_cast<int16_t *>(
+                outHeader->pBuffer + outHeader->nOffset + outHeader->nFilledLen);
+
         if (mMode == MODE_NARROW) {
             numBytesRead =
                 AMRDecode(mState,
                   (Frame_Type_3GPP)((inputPtr[0] >> 3) & 0x0f),
                   (UWord8 *)&inputPtr[1],
-                  reinterpret_cast<int16_t *>(outHeader->pBuffer),
+                  outPtr,
                   MIME_IETF);
 
             if (numBytesRead == -1) {
@@ -354,8 +358,6 @@ void SoftAMR::onQueueFilled(OMX_U32 portIndex) {
             size_t frameSize = getFrameSize(mode);
             CHECK_GE(inHeader->nFilledLen, frameSize);
 
-            int16_t *outPtr = (int16_t *)outHeader->pBuffer;
-
             if (mode >= 9) {
                 // Produce silence instead of comfort noise and for
                 // speech lost/no data.
@@ -389,23 +391,29 @@ void SoftAMR::onQueueFilled(OMX_U32 portIndex) {
         inHeader->nOffset += numBytesRead;
         inHeader->nFilledLen -= numBytesRead;
 
-        outHeader->nFlags = 0;
-        outHeader->nOffset = 0;
+        bool firstFrame = (outHeader->nFilledLen == 0);
+        if (firstFrame) {
+            outHeader->nFlags = 0;
+        }
 
         if (mMode == MODE_NARROW) {
-            outHeader->nFilledLen = kNumSamplesPerFrameNB * sizeof(int16_t);
+            outHeader->nFilledLen += kNumSamplesPerFrameNB * sizeof(int16_t);
 
-            outHeader->nTimeStamp =
-                mAnchorTimeUs
-                    + (mNumSamplesOutput * 1000000ll) / kSampleRateNB;
+            if (firstFrame) {
+                outHeader->nTimeStamp =
+                    mAnchorTimeUs
+                        + (mNumSamplesOutput * 1000000ll) / kSampleRateNB;
+            }
 
             mNumSamplesOutput += kNumSamplesPerFrameNB;
         } else {
-            outHeader->nFilledLen = kNumSamplesPerFrameWB * sizeof(int16_t);
+            outHeader->nFilledLen += kNumSamplesPerFrameWB * sizeof(int16_t);
 
-            outHeader->nTimeStamp =
-                mAnchorTimeUs
-                    + (mNumSamplesOutput * 1000000ll) / kSampleRateWB;
+            if (firstFrame) {
+                outHeader->nTimeStamp =
+                    mAnchorTimeUs
+                        + (mNumSamplesOutput * 1000000ll) / kSampleRateWB;
+            }
 
             mNumSamplesOutput += kNumSamplesPerFrameWB;
         }
@@ -418,13 +426,20 @@ void SoftAMR::onQueueFilled(OMX_U32 portIndex) {
             inHeader = NULL;
         }
 
+        ++mInputBufferCount;
+
+        if (keepOutputBuffer(outHeader,
+                    (mMode == MODE_NARROW
+                        ? kNumSamplesPerFrameNB : kNumSamplesPerFrameWB)
+                        * sizeof(int16_t))) {
+            continue;
+        }
+
         outInfo->mOwnedByUs = false;
         outQueue.erase(outQueue.begin());
         outInfo = NULL;
         notifyFillBufferDone(outHeader);
         outHeader = NULL;
-
-        ++mInputBufferCount;
     }
 }
 
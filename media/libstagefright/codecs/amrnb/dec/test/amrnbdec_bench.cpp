@@ -0,0 +1,207 @@
+/*
+ * Copyright (C) 2012 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Decodes an AMR-NB file (RFC 4867 storage format) with
+// libstagefright_amrnbdec the way SoftAMR does, one frame per call, until
+// the requested amount of speech has been decoded, and reports the decoder
+// throughput. The decoded PCM of the first pass over the file can be written
+// out to check that optimizations of the decoder are bit exact.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "gsmamr_dec.h"
+
+static const char kAMRHeader[] = "#!AMR\n";
+static const size_t kNumSamplesPerFrame = 160;
+static const int kSampleRate = 8000;
+
+static void usage(const char *me) {
+    fprintf(stderr,
+            "usage: %s [-m cpu MHz] [-s seconds] [-o output.pcm] input.amr\n"
+            "  -m  clock used to convert CPU time to MCPS, defaults to\n"
+            "      cpuinfo_max_freq of cpu0\n"
+            "  -s  seconds of speech to decode, the file is decoded again\n"
+            "      from the start until they are reached (default: once)\n"
+            "  -o  write the decoded 16-bit PCM of the first pass\n",
+            me);
+}
+
+static int getCpuMHz() {
+    FILE *f = fopen("/sys/devices/system/cpu/cpu0/cpufreq/cpuinfo_max_freq", "r");
+    if (f == NULL) {
+        return 0;
+    }
+    int kHz = 0;
+    if (fscanf(f, "%d", &kHz) != 1) {
+        kHz = 0;
+    }
+    fclose(f);
+    return kHz / 1000;
+}
+
+static double cpuTime() {
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+int main(int argc, char **argv) {
+    int mhz = 0;
+    double seconds = 0;
+    const char *outPath = NULL;
+
+    int res;
+    while ((res = getopt(argc, argv, "m:s:o:h")) >= 0) {
+        switch (res) {
+            case 'm':
+                mhz = atoi(optarg);
+                break;
+            case 's':
+                seconds = atof(optarg);
+                break;
+            case 'o':
+                outPath = optarg;
+                break;
+            default:
+                usage(argv[0]);
+                return 1;
+        }
+    }
+
+    if (optind + 1 != argc || seconds < 0) {
+        usage(argv[0]);
+        return 1;
+    }
+    if (mhz <= 0) {
+        mhz = getCpuMHz();
+    }
+
+    FILE *in = fopen(argv[optind], "rb");
+    if (in == NULL) {
+        fprintf(stderr, "unable to open %s\n", argv[optind]);
+        return 1;
+    }
+    fseek(in, 0, SEEK_END);
+    size_t size = ftell(in);
+    fseek(in, 0, SEEK_SET);
+    uint8_t *data = (uint8_t *)malloc(size);
+    if (data == NULL || fread(data, 1, size, in) != size) {
+        fprintf(stderr, "unable to read %s\n", argv[optind]);
+        fclose(in);
+        free(data);
+        return 1;
+    }
+    fclose(in);
+
+    const size_t headerSize = sizeof(kAMRHeader) - 1;
+    if (size <= headerSize || memcmp(data, kAMRHeader, headerSize)) {
+        fprintf(stderr, "%s is not an AMR-NB file\n", argv[optind]);
+        free(data);
+        return 1;
+    }
+
+    FILE *out = NULL;
+    if (outPath != NULL) {
+        out = fopen(outPath, "wb");
+        if (out == NULL) {
+            fprintf(stderr, "unable to open %s\n", outPath);
+            free(data);
+            return 1;
+        }
+    }
+
+    void *decoder = NULL;
+    if (GSMInitDecode(&decoder, (Word8 *)"AMRNBDecoder") != 0) {
+        fprintf(stderr, "unable to initialize the decoder\n");
+        if (out != NULL) {
+            fclose(out);
+        }
+        free(data);
+        return 1;
+    }
+
+    int16_t pcm[kNumSamplesPerFrame];
+    long frames = 0;
+    long errors = 0;
+    double cpuSeconds = 0;
+    bool firstPass = true;
+
+    do {
+        size_t offset = headerSize;
+        while (offset < size) {
+            const uint8_t *frame = data + offset;
+
+            double t = cpuTime();
+            int32_t numBytesRead = AMRDecode(decoder,
+                    (Frame_Type_3GPP)((frame[0] >> 3) & 0x0f),
+                    (UWord8 *)&frame[1], pcm, MIME_IETF);
+            cpuSeconds += cpuTime() - t;
+
+            if (numBytesRead < 0) {
+                errors++;
+                break;
+            }
+            ++numBytesRead;  // Include the frame type header byte.
+
+            if (offset + numBytesRead > size) {
+                // truncated last frame
+                break;
+            }
+
+            if (out != NULL && firstPass) {
+                fwrite(pcm, sizeof(int16_t), kNumSamplesPerFrame, out);
+            }
+            frames++;
+            offset += numBytesRead;
+        }
+        firstPass = false;
+    } while (frames > 0 && errors == 0
+            && (double)frames * kNumSamplesPerFrame / kSampleRate < seconds);
+
+    if (out != NULL) {
+        fclose(out);
+    }
+    GSMDecodeFrameExit(&decoder);
+    free(data);
+
+    if (frames == 0) {
+        fprintf(stderr, "no AMR-NB frames found\n");
+        return 1;
+    }
+    if (errors > 0) {
+        fprintf(stderr, "decoding failed after %ld frames\n", frames);
+        return 1;
+    }
+
+    double audioSeconds = (double)frames * kNumSamplesPerFrame / kSampleRate;
+
+    printf("frames:     %ld\n", frames);
+    printf("audio:      %.3f s\n", audioSeconds);
+    printf("cpu:        %.3f s (%.1fx realtime, %.1f us per frame)\n", cpuSeconds,
+            cpuSeconds > 0 ? audioSeconds / cpuSeconds : 0, cpuSeconds / frames * 1e6);
+    if (mhz > 0) {
+        printf("load:       %.2f MCPS at %d MHz\n", cpuSeconds / audioSeconds * mhz, mhz);
+    } else {
+        printf("load:       unknown cpu clock, use -m to report MCPS\n");
+    }
+
+    return 0;
+}
@@ -112,6 +112,9 @@ ifeq ($(VOTT), v7)
 LOCAL_CFLAGS += -DARM -DARMV7 -DASM_OPT
 LOCAL_C_INCLUDES += $(LOCAL_PATH)/src/asm/ARMV5E
 LOCAL_C_INCLUDES += $(LOCAL_PATH)/src/asm/ARMV7
+# cor_h_x(), cor_h_vec_30() and search_ixiy() have NEON intrinsic versions
+# that complete the ARMV7 assembly set, built with -mfpu=neon
+LOCAL_ARM_NEON := true
 endif
 
 include $(BUILD_STATIC_LIBRARY)
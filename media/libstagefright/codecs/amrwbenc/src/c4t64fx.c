@@ -47,6 +47,10 @@
 
 #include "q_pulse.h"
 
+#ifdef __ARM_NEON__
+#include <arm_neon.h>
+#endif
+
 static Word16 tipos[36] = {
 	0, 1, 2, 3,                            /* starting point &ipos[0], 1st iter */
 	1, 2, 3, 0,                            /* starting point &ipos[4], 2nd iter */
@@ -680,6 +684,13 @@ void ACELP_4t64_fx(
 			else
 				p1 = h - iy;
 
+#ifdef __ARM_NEON__
+			for (i = 0; i < L_SUBFR; i+=8)
+			{
+				vst1q_s16(&vec[i], vaddq_s16(vld1q_s16(&vec[i]),
+							vaddq_s16(vld1q_s16(&p0[i]), vld1q_s16(&p1[i]))));
+			}
+#else
 			for (i = 0; i < L_SUBFR; i+=4)
 			{
 				vec[i]   += add1((*p0++), (*p1++));
@@ -687,6 +698,7 @@ void ACELP_4t64_fx(
 				vec[i+2] += add1((*p0++), (*p1++));
 				vec[i+3] += add1((*p0++), (*p1++));
 			}
+#endif
 		}
 		/* memorise the best codevector */
 		ps = vo_mult(ps, ps);
@@ -823,6 +835,67 @@ void ACELP_4t64_fx(
  * ~~~~~~~~~~~~~~~~~~~~~                                             *
  * Compute correlations of h[] with vec[] for the specified track.   *
  *-------------------------------------------------------------------*/
+#ifdef __ARM_NEON__
+/* sum of h[k] * vec[k] for k = 0..n-1 */
+static Word32 dot_h_vec_neon(Word16 h[], Word16 vec[], Word32 n)
+{
+	Word32 k, L_sum;
+	int32x4_t acc;
+	int32x2_t sum;
+	int16x8_t h8, v8;
+
+	acc = vdupq_n_s32(0);
+	for (k = 0; k + 8 <= n; k += 8)
+	{
+		h8 = vld1q_s16(&h[k]);
+		v8 = vld1q_s16(&vec[k]);
+		acc = vmlal_s16(acc, vget_low_s16(h8), vget_low_s16(v8));
+		acc = vmlal_s16(acc, vget_high_s16(h8), vget_high_s16(v8));
+	}
+	if (k + 4 <= n)
+	{
+		acc = vmlal_s16(acc, vld1_s16(&h[k]), vld1_s16(&vec[k]));
+		k += 4;
+	}
+	sum = vpadd_s32(vget_low_s32(acc), vget_high_s32(acc));
+	sum = vpadd_s32(sum, sum);
+	L_sum = vget_lane_s32(sum, 0);
+	for (; k < n; k++)
+		L_sum += h[k] * vec[k];
+
+	return L_sum;
+}
+
+/* Same as the C version below: cor_x[] correlates h[] with vec[] from pos on, */
+/* cor_y[] with vec[] from pos - 3 on, both up to the end of the subframe.    */
+void cor_h_vec_30(
+		Word16 h[],                           /* (i) scaled impulse response                 */
+		Word16 vec[],                         /* (i) scaled vector (/8) to correlate with h[] */
+		Word16 track,                         /* (i) track to use                            */
+		Word16 sign[],                        /* (i) sign vector                             */
+		Word16 rrixix[][NB_POS],              /* (i) correlation of h[x] with h[x]      */
+		Word16 cor_1[],                       /* (o) result of correlation (NB_POS elements) */
+		Word16 cor_2[]                        /* (o) result of correlation (NB_POS elements) */
+		)
+{
+	Word32 i, pos, corr;
+	Word32 L_sum1, L_sum2;
+
+	pos = track;
+	for (i = 0; i < NB_POS; i++)
+	{
+		L_sum1 = dot_h_vec_neon(h, &vec[pos], L_SUBFR - pos) << 2;
+		L_sum2 = dot_h_vec_neon(h, &vec[pos - 3], L_SUBFR + 3 - pos) << 2;
+
+		corr = vo_round(L_sum1);
+		cor_1[i] = vo_mult(corr, sign[pos]) + rrixix[track][i];
+		corr = vo_round(L_sum2);
+		cor_2[i] = vo_mult(corr, sign[pos-3]) + rrixix[0][i];
+		pos += STEP;
+	}
+	return;
+}
+#else
 void cor_h_vec_30(
 		Word16 h[],                           /* (i) scaled impulse response                 */
 		Word16 vec[],                         /* (i) scaled vector (/8) to correlate with h[] */
@@ -894,6 +967,7 @@ void cor_h_vec_30(
 	}
 	return;
 }
+#endif
 
 void cor_h_vec_012(
 		Word16 h[],                           /* (i) scaled impulse response                 */
@@ -981,6 +1055,9 @@ void search_ixiy(
 	Word16 alp_16, alpk;
 	Word16 *p0, *p1, *p2;
 	Word32 s, alp0, alp1, alp2;
+#ifdef __ARM_NEON__
+	Word16 dn_y[NB_POS], sq_y[NB_POS], alp_y[NB_POS];
+#endif
 
 	p0 = cor_x;
 	p1 = cor_y;
@@ -994,6 +1071,13 @@ void search_ixiy(
 	sqk = -1;
 	alpk = 1;
 
+#ifdef __ARM_NEON__
+	/* The correlations and energies of the NB_POS candidates for pulse 2 */
+	/* are computed 8 at a time, only the selection itself is sequential. */
+	for (y = 0; y < NB_POS; y++)
+		dn_y[y] = dn[track_y + y * STEP];
+#endif
+
 	for (x = track_x; x < L_SUBFR; x += STEP)
 	{
 		ps1 = *ps + dn[x];
@@ -1001,6 +1085,44 @@ void search_ixiy(
 
 		if (dn2[x] < thres_ix)
 		{
+#ifdef __ARM_NEON__
+			for (y = 0; y < NB_POS; y += 8)
+			{
+				int16x8_t ps2v, cy, rr;
+				int32x4_t a_lo, a_hi;
+
+				ps2v = vaddq_s16(vdupq_n_s16(ps1), vld1q_s16(&dn_y[y]));
+				cy = vld1q_s16(&p1[y]);
+				rr = vld1q_s16(&p2[y]);
+				a_lo = vaddq_s32(vaddq_s32(vdupq_n_s32(alp1),
+							vshll_n_s16(vget_low_s16(cy), 13)),
+						vshll_n_s16(vget_low_s16(rr), 14));
+				a_hi = vaddq_s32(vaddq_s32(vdupq_n_s32(alp1),
+							vshll_n_s16(vget_high_s16(cy), 13)),
+						vshll_n_s16(vget_high_s16(rr), 14));
+				vst1q_s16(&alp_y[y], vcombine_s16(vshrn_n_s32(a_lo, 16),
+							vshrn_n_s32(a_hi, 16)));
+				vst1q_s16(&sq_y[y], vcombine_s16(
+							vshrn_n_s32(vmull_s16(vget_low_s16(ps2v),
+									vget_low_s16(ps2v)), 15),
+							vshrn_n_s32(vmull_s16(vget_high_s16(ps2v),
+									vget_high_s16(ps2v)), 15)));
+			}
+			p2 += NB_POS;
+
+			pos = -1;
+			for (y = 0; y < NB_POS; y++)
+			{
+				s = vo_L_mult(alpk, sq_y[y]) - ((sqk * alp_y[y])<<1);
+
+				if (s > 0)
+				{
+					sqk = sq_y[y];
+					alpk = alp_y[y];
+					pos = track_y + y * STEP;
+				}
+			}
+#else
 			pos = -1;
 			for (y = track_y; y < L_SUBFR; y += STEP)
 			{
@@ -1020,6 +1142,7 @@ void search_ixiy(
 				}
 			}
 			p1 -= NB_POS;
+#endif
 
 			if (pos >= 0)
 			{
@@ -28,10 +28,72 @@
 #include "basic_op.h"
 #include "math_op.h"
 
+#ifdef __ARM_NEON__
+#include <arm_neon.h>
+#endif
+
 #define L_SUBFR   64
 #define NB_TRACK  4
 #define STEP      4
 
+#ifdef __ARM_NEON__
+/* Same arithmetic as the C version below: y32[i] is accumulated for 8 positions       */
+/* at a time over a copy of x[] followed by zeros, so that the products beyond the end */
+/* of the subframe vanish. The 4 lanes of each vector are the 4 tracks.                */
+void cor_h_x(
+		Word16 h[],                           /* (i) Q12 : impulse response of weighted synthesis filter */
+		Word16 x[],                           /* (i) Q0  : target vector                                 */
+		Word16 dn[]                           /* (o) <12bit : correlation between target and h[]         */
+	    )
+{
+	Word32 i, j;
+	Word32 L_tot, L_max;
+	Word16 xz[L_SUBFR + 8];
+	int32x4_t y32[L_SUBFR / 4];
+	int32x4_t acc0, acc1, vmax, shift, round;
+
+	for (i = 0; i < L_SUBFR; i++)
+		xz[i] = x[i];
+	for (; i < L_SUBFR + 8; i++)
+		xz[i] = 0;
+
+	vmax = vdupq_n_s32(0);
+	for (i = 0; i < L_SUBFR; i += 8)
+	{
+		acc0 = vdupq_n_s32(0);
+		acc1 = vdupq_n_s32(0);
+		for (j = 0; j < L_SUBFR - i; j++)
+		{
+			acc0 = vmlal_n_s16(acc0, vld1_s16(&xz[i + j]), h[j]);
+			acc1 = vmlal_n_s16(acc1, vld1_s16(&xz[i + j + 4]), h[j]);
+		}
+		/* 1 -> to avoid null dn[] */
+		acc0 = vaddq_s32(vshlq_n_s32(acc0, 1), vdupq_n_s32(1));
+		acc1 = vaddq_s32(vshlq_n_s32(acc1, 1), vdupq_n_s32(1));
+		y32[i >> 2] = acc0;
+		y32[(i >> 2) + 1] = acc1;
+		vmax = vmaxq_s32(vmax, vabsq_s32(acc0));
+		vmax = vmaxq_s32(vmax, vabsq_s32(acc1));
+	}
+
+	/* tot += 3*max / 8 */
+	L_tot = 1;
+	L_max = ((vgetq_lane_s32(vmax, 0) + vgetq_lane_s32(vmax, 1)
+				+ vgetq_lane_s32(vmax, 2) + vgetq_lane_s32(vmax, 3)) >> 2);
+	L_tot = vo_L_add(L_tot, L_max);       /* +max/4 */
+	L_tot = vo_L_add(L_tot, (L_max >> 1));  /* +max/8 */
+
+	/* Find the number of right shifts to do on y32[] so that    */
+	/* 6.0 x sumation of max of dn[] in each track not saturate. */
+	shift = vdupq_n_s32(norm_l(L_tot) - 4);             /* 4 -> 16 x tot */
+	round = vdupq_n_s32(0x8000);
+	for (i = 0; i < L_SUBFR / 4; i++)
+	{
+		vst1_s16(&dn[i << 2], vshrn_n_s32(vaddq_s32(vqshlq_s32(y32[i], shift), round), 16));
+	}
+	return;
+}
+#else
 void cor_h_x(
 		Word16 h[],                           /* (i) Q12 : impulse response of weighted synthesis filter */
 		Word16 x[],                           /* (i) Q0  : target vector                                 */
@@ -122,6 +184,4 @@ void cor_h_x(
 	}
 	return;
 }
-
-
-
+#endif
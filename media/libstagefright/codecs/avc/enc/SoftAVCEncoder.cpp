@@ -30,8 +30,40 @@
 
 #include "SoftAVCEncoder.h"
 
+#include <unistd.h>
+
 namespace android {
 
+// Vendor parameters (OMX_PARAM_U32TYPE) trading encoding speed for quality.
+// The preset selects the motion search range and sub-pel refinement, the
+// thread count only affects the speed of the motion search, not its result.
+static const char *kMotionSearchPresetExtension =
+    "OMX.google.android.index.motionSearchPreset";
+
+static const char *kMotionSearchThreadsExtension =
+    "OMX.google.android.index.motionSearchThreads";
+
+static const OMX_INDEXTYPE kIndexParamMotionSearchPreset =
+    (OMX_INDEXTYPE)(OMX_IndexVendorStartUnused + 1);
+
+static const OMX_INDEXTYPE kIndexParamMotionSearchThreads =
+    (OMX_INDEXTYPE)(OMX_IndexVendorStartUnused + 2);
+
+static const OMX_U32 kMaxMotionSearchThreads = 8;
+
+static int GetCPUCoreCount() {
+    int cpuCoreCount = 1;
+#if defined(_SC_NPROCESSORS_ONLN)
+    cpuCoreCount = sysconf(_SC_NPROCESSORS_ONLN);
+#else
+    // _SC_NPROC_ONLN must be defined...
+    cpuCoreCount = sysconf(_SC_NPROC_ONLN);
+#endif
+    CHECK(cpuCoreCount >= 1);
+    ALOGV("Number of CPU cores: %d", cpuCoreCount);
+    return cpuCoreCount;
+}
+
 template<class T>
 static void InitOMXParams(T *params) {
     params->nSize = sizeof(T);
@@ -179,11 +211,17 @@ SoftAVCEncoder::SoftAVCEncoder(
       mStarted(false),
       mSawInputEOS(false),
       mSignalledError(false),
+      mMotionSearchPreset(kMotionSearchPresetDefault),
+      mNumMotionSearchThreads(GetCPUCoreCount()),
       mHandle(new tagAVCHandle),
       mEncParams(new tagAVCEncParam),
       mInputFrameData(NULL),
       mSliceGroup(NULL) {
 
+    if (mNumMotionSearchThreads > kMaxMotionSearchThreads) {
+        mNumMotionSearchThreads = kMaxMotionSearchThreads;
+    }
+
     initPorts();
     ALOGI("Construct SoftAVCEncoder");
 }
@@ -209,7 +247,7 @@ OMX_ERRORTYPE SoftAVCEncoder::initEncParams() {
     mHandle->CBAVC_Free = FreeWrapper;
 
     CHECK(mEncParams != NULL);
-    memset(mEncParams, 0, sizeof(mEncParams));
+    memset(mEncParams, 0, sizeof(*mEncParams));
     mEncParams->rate_control = AVC_ON;
     mEncParams->initQP = 0;
     mEncParams->init_CBP_removal_delay = 1600;
@@ -238,13 +276,26 @@ OMX_ERRORTYPE SoftAVCEncoder::initEncParams() {
 
     mEncParams->data_par = AVC_OFF;
     mEncParams->fullsearch = AVC_OFF;
-    mEncParams->search_range = 16;
-    mEncParams->sub_pel = AVC_OFF;
+    switch (mMotionSearchPreset) {
+        case kMotionSearchPresetFast:
+            mEncParams->search_range = 8;
+            mEncParams->sub_pel = AVC_OFF;
+            break;
+        case kMotionSearchPresetQuality:
+            mEncParams->search_range = 32;
+            mEncParams->sub_pel = AVC_ON;
+            break;
+        default:
+            mEncParams->search_range = 16;
+            mEncParams->sub_pel = AVC_OFF;
+            break;
+    }
     mEncParams->submb_pred = AVC_OFF;
     mEncParams->rdopt_mode = AVC_OFF;
     mEncParams->bidir_pred = AVC_OFF;
 
     mEncParams->use_overrun_buffer = AVC_OFF;
+    mEncParams->num_me_threads = mNumMotionSearchThreads;
 
     if (mVideoColorFormat == OMX_COLOR_FormatYUV420SemiPlanar) {
         // Color conversion is needed.
@@ -522,6 +573,22 @@ OMX_ERRORTYPE SoftAVCEncoder::internalGetParameter(
             return OMX_ErrorNone;
         }
 
+        case kIndexParamMotionSearchPreset:
+        {
+            OMX_PARAM_U32TYPE *presetParams = (OMX_PARAM_U32TYPE *)params;
+
+            presetParams->nU32 = mMotionSearchPreset;
+            return OMX_ErrorNone;
+        }
+
+        case kIndexParamMotionSearchThreads:
+        {
+            OMX_PARAM_U32TYPE *threadParams = (OMX_PARAM_U32TYPE *)params;
+
+            threadParams->nU32 = mNumMotionSearchThreads;
+            return OMX_ErrorNone;
+        }
+
         default:
             return SimpleSoftOMXComponent::internalGetParameter(index, params);
     }
@@ -666,11 +733,54 @@ OMX_ERRORTYPE SoftAVCEncoder::internalSetParameter(
             return OMX_ErrorNone;
         }
 
+        // Both take effect when the encoder is next initialized.
+        case kIndexParamMotionSearchPreset:
+        {
+            const OMX_PARAM_U32TYPE *presetParams =
+                (const OMX_PARAM_U32TYPE *)params;
+
+            if (presetParams->nU32 > kMotionSearchPresetQuality) {
+                return OMX_ErrorBadParameter;
+            }
+
+            mMotionSearchPreset = presetParams->nU32;
+            return OMX_ErrorNone;
+        }
+
+        case kIndexParamMotionSearchThreads:
+        {
+            const OMX_PARAM_U32TYPE *threadParams =
+                (const OMX_PARAM_U32TYPE *)params;
+
+            if (threadParams->nU32 < 1
+                    || threadParams->nU32 > kMaxMotionSearchThreads) {
+                return OMX_ErrorBadParameter;
+            }
+
+            mNumMotionSearchThreads = threadParams->nU32;
+            return OMX_ErrorNone;
+        }
+
         default:
             return SimpleSoftOMXComponent::internalSetParameter(index, params);
     }
 }
 
+OMX_ERRORTYPE SoftAVCEncoder::getExtensionIndex(
+        const char *name, OMX_INDEXTYPE *index) {
+    if (!strcmp(name, kMotionSearchPresetExtension)) {
+        *index = kIndexParamMotionSearchPreset;
+        return OMX_ErrorNone;
+    }
+
+    if (!strcmp(name, kMotionSearchThreadsExtension)) {
+        *index = kIndexParamMotionSearchThreads;
+        return OMX_ErrorNone;
+    }
+
+    return SimpleSoftOMXComponent::getExtensionIndex(name, index);
+}
+
 void SoftAVCEncoder::onQueueFilled(OMX_U32 portIndex) {
     if (mSignalledError || mSawInputEOS) {
         return;
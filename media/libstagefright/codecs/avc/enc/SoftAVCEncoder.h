@@ -43,6 +43,9 @@ struct SoftAVCEncoder : public MediaBufferObserver,
     virtual OMX_ERRORTYPE internalSetParameter(
             OMX_INDEXTYPE index, const OMX_PTR params);
 
+    virtual OMX_ERRORTYPE getExtensionIndex(
+            const char *name, OMX_INDEXTYPE *index);
+
     virtual void onQueueFilled(OMX_U32 portIndex);
 
 
@@ -63,6 +66,13 @@ private:
         kNumBuffers = 2,
     };
 
+    // Values of the motion search preset, from the fastest to the best
+    enum {
+        kMotionSearchPresetFast = 0,
+        kMotionSearchPresetDefault = 1,
+        kMotionSearchPresetQuality = 2,
+    };
+
     // OMX input buffer's timestamp and flags
     typedef struct {
         int64_t mTimeUs;
@@ -87,6 +97,9 @@ private:
     bool     mSignalledError;
     bool     mIsIDRFrame;
 
+    OMX_U32  mMotionSearchPreset;
+    OMX_U32  mNumMotionSearchThreads;
+
     tagAVCHandle          *mHandle;
     tagAVCEncParam        *mEncParams;
     uint8_t               *mInputFrameData;
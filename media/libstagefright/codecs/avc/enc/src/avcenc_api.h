@@ -158,6 +158,9 @@ typedef struct tagAVCEncParam
 
     AVCFlag use_overrun_buffer;  /* do not throw away the frame if output buffer is not big enough.
                                     copy excess bits to the overrun buffer */
+
+    int num_me_threads; /* number of threads sharing the motion estimation of a frame, 0 or 1 to
+                        search on the calling thread only. The bitstream does not depend on it. */
 } AVCEncParams;
 
 
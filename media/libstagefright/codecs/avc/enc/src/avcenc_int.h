@@ -440,6 +440,8 @@ typedef struct tagEncObject
 
     /* encoding complexity control */
     uint fullsearch_enable; /* flag to enable full-pel full-search */
+    int numMEThreads;       /* number of threads for the motion estimation */
+    struct tagAVCMEThreads *meThreads; /* worker threads, NULL when searching on one thread */
 
     /* misc.*/
     bool outOfBandParamSet; /* flag to enable out-of-band param set */
@@ -55,6 +55,8 @@ AVCEnc_Status  SetEncodeParam(AVCHandle* avcHandle, AVCEncParams* encParam,
 
     encvid->fullsearch_enable = encParam->fullsearch;
 
+    encvid->numMEThreads = encParam->num_me_threads;
+
     encvid->outOfBandParamSet = ((encParam->out_of_band_param_set == AVC_ON) ? TRUE : FALSE);
 
     /* parameters derived from the the encParam that are used in SPS */
@@ -17,6 +17,8 @@
  */
 #include "avcenc_lib.h"
 
+#include <pthread.h>
+
 #define MIN_GOP     1   /* minimum size of GOP, 1/23/01, need to be tested */
 
 #define DEFAULT_REF_IDX     0  /* always from the first frame in the reflist */
@@ -64,47 +66,20 @@ uint32 num_cand = 0;
 #define FIXED_SUBMB_MODE    AVC_4x4
 /*************************************************************************/
 
-/* Initialize arrays necessary for motion search */
-AVCEnc_Status InitMotionSearchModule(AVCHandle *avcHandle)
-{
-    AVCEncObject *encvid = (AVCEncObject*) avcHandle->AVCObject;
-    AVCRateControl *rateCtrl = encvid->rateCtrl;
-    int search_range = rateCtrl->mvRange;
-    int number_of_subpel_positions = 4 * (2 * search_range + 3);
-    int max_mv_bits, max_mvd;
-    int temp_bits = 0;
-    uint8 *mvbits;
-    int bits, imax, imin, i;
-    uint8* subpel_pred = (uint8*) encvid->subpel_pred; // all 16 sub-pel positions
+#ifndef HTFM
+/* the hypothesis testing statistics are collected on a single thread */
+typedef struct tagAVCMEThreads AVCMEThreads;
 
+static AVCMEThreads *AVCCreateMEThreads(AVCHandle *avcHandle, int numThreads);
+static void AVCDestroyMEThreads(AVCHandle *avcHandle, AVCMEThreads *threads);
+static void AVCMotionSearchPass(AVCEncObject *encvid, int start_i, int incr_i, int type_pred,
+                                int *NumIntraSearch, int *totalSAD);
+#endif
 
-    while (number_of_subpel_positions > 0)
-    {
-        temp_bits++;
-        number_of_subpel_positions >>= 1;
-    }
-
-    max_mv_bits = 3 + 2 * temp_bits;
-    max_mvd  = (1 << (max_mv_bits >> 1)) - 1;
-
-    encvid->mvbits_array = (uint8*) avcHandle->CBAVC_Malloc(encvid->avcHandle->userData,
-                           sizeof(uint8) * (2 * max_mvd + 1), DEFAULT_ATTR);
-
-    if (encvid->mvbits_array == NULL)
-    {
-        return AVCENC_MEMORY_FAIL;
-    }
-
-    mvbits = encvid->mvbits  = encvid->mvbits_array + max_mvd;
-
-    mvbits[0] = 1;
-    for (bits = 3; bits <= max_mv_bits; bits += 2)
-    {
-        imax = 1    << (bits >> 1);
-        imin = imax >> 1;
-
-        for (i = imin; i < imax; i++)   mvbits[-i] = mvbits[i] = bits;
-    }
+/* Point the half-pel and quarter-pel candidates to the sub-pel buffers of encvid */
+static void AVCInitSubpelPointers(AVCEncObject *encvid)
+{
+    uint8* subpel_pred = (uint8*) encvid->subpel_pred; // all 16 sub-pel positions
 
     /* initialize half-pel search */
     encvid->hpel_cand[0] = subpel_pred + REF_CENTER;
@@ -165,6 +140,59 @@ AVCEnc_Status InitMotionSearchModule(AVCHandle *avcHandle)
     encvid->bilin_base[8][2] = subpel_pred + V2Q_H0Q * SUBPEL_PRED_BLK_SIZE;
     encvid->bilin_base[8][3] = subpel_pred + V2Q_H2Q * SUBPEL_PRED_BLK_SIZE;
 
+    return ;
+}
+
+/* Initialize arrays necessary for motion search */
+AVCEnc_Status InitMotionSearchModule(AVCHandle *avcHandle)
+{
+    AVCEncObject *encvid = (AVCEncObject*) avcHandle->AVCObject;
+    AVCRateControl *rateCtrl = encvid->rateCtrl;
+    int search_range = rateCtrl->mvRange;
+    int number_of_subpel_positions = 4 * (2 * search_range + 3);
+    int max_mv_bits, max_mvd;
+    int temp_bits = 0;
+    uint8 *mvbits;
+    int bits, imax, imin, i;
+
+
+    while (number_of_subpel_positions > 0)
+    {
+        temp_bits++;
+        number_of_subpel_positions >>= 1;
+    }
+
+    max_mv_bits = 3 + 2 * temp_bits;
+    max_mvd  = (1 << (max_mv_bits >> 1)) - 1;
+
+    encvid->mvbits_array = (uint8*) avcHandle->CBAVC_Malloc(encvid->avcHandle->userData,
+                           sizeof(uint8) * (2 * max_mvd + 1), DEFAULT_ATTR);
+
+    if (encvid->mvbits_array == NULL)
+    {
+        return AVCENC_MEMORY_FAIL;
+    }
+
+    mvbits = encvid->mvbits  = encvid->mvbits_array + max_mvd;
+
+    mvbits[0] = 1;
+    for (bits = 3; bits <= max_mv_bits; bits += 2)
+    {
+        imax = 1    << (bits >> 1);
+        imin = imax >> 1;
+
+        for (i = imin; i < imax; i++)   mvbits[-i] = mvbits[i] = bits;
+    }
+
+    AVCInitSubpelPointers(encvid);
+
+#ifndef HTFM
+    if (encvid->numMEThreads > 1)
+    {
+        /* without threads, the motion estimation runs on the calling thread */
+        encvid->meThreads = AVCCreateMEThreads(avcHandle, encvid->numMEThreads);
+    }
+#endif
 
     return AVCENC_SUCCESS;
 }
@@ -180,6 +208,14 @@ void CleanMotionSearchModule(AVCHandle *avcHandle)
         encvid->mvbits = NULL;
     }
 
+#ifndef HTFM
+    if (encvid->meThreads)
+    {
+        AVCDestroyMEThreads(avcHandle, encvid->meThreads);
+        encvid->meThreads = NULL;
+    }
+#endif
+
     return ;
 }
 
@@ -232,32 +268,124 @@ bool IntraDecisionABE(int *min_cost, uint8 *cur, int pitch, bool ave)
     return intra;
 }
 
+/* Motion search of the macroblock (i, j) of the current frame. The results are stored in the
+   entries of that macroblock only, the number of macroblocks to be intra searched and the SAD
+   of the macroblock are added to *NumIntraSearch and *totalSAD. */
+static void AVCMotionSearchMB(AVCEncObject *encvid, int i, int j, int type_pred,
+#ifdef HTFM
+                              HTFM_Stat *htfm_stat,
+#endif
+                              int *NumIntraSearch, int *totalSAD)
+{
+    AVCCommonObj *video = encvid->common;
+    AVCFrameIO *currInput = encvid->currInput;
+    int mbwidth = video->PicWidthInMbs;
+    int mbheight = video->PicHeightInMbs;
+    int pitch = currInput->pitch;
+    int mbnum = j * mbwidth + i;
+    AVCMacroblock *currMB = video->mblock + mbnum;
+    AVCMV *mot_mb_16x16 = encvid->mot16x16 + mbnum;
+    AVCRateControl *rateCtrl = encvid->rateCtrl;
+    uint8 *intraSearch = encvid->intraSearch;
+    uint FS_en = encvid->fullsearch_enable;
+    uint8 *cur, *best_cand[5];
+    int abe_cost, k;
+    int hp_guess = 0;
+    uint32 mv_uint32;
+
+    video->mbNum = mbnum;
+    video->currMB = currMB;
+
+    cur = currInput->YCbCr[0] + pitch * (j << 4) + (i << 4);
+
+    if (currMB->mb_intra == 0) /* for INTER mode */
+    {
+#if defined(HTFM)
+        HTFMPrepareCurMB_AVC(encvid, htfm_stat, cur, pitch);
+#else
+        AVCPrepareCurMB(encvid, cur, pitch);
+#endif
+        /************************************************************/
+        /******** full-pel 1MV search **********************/
+
+        AVCMBMotionSearch(encvid, cur, best_cand, i << 4, j << 4, type_pred,
+                          FS_en, &hp_guess);
+
+        abe_cost = encvid->min_cost[mbnum] = mot_mb_16x16->sad;
+
+        /* set mbMode and MVs */
+        currMB->mbMode = AVC_P16;
+        currMB->MBPartPredMode[0][0] = AVC_Pred_L0;
+        mv_uint32 = ((mot_mb_16x16->y) << 16) | ((mot_mb_16x16->x) & 0xffff);
+        for (k = 0; k < 32; k += 2)
+        {
+            currMB->mvL0[k>>1] = mv_uint32;
+        }
+
+        /* make a decision whether it should be tested for intra or not */
+        if (i != mbwidth - 1 && j != mbheight - 1 && i != 0 && j != 0)
+        {
+            if (false == IntraDecisionABE(&abe_cost, cur, pitch, true))
+            {
+                intraSearch[mbnum] = 0;
+            }
+            else
+            {
+                (*NumIntraSearch)++;
+                rateCtrl->MADofMB[mbnum] = abe_cost;
+            }
+        }
+        else // boundary MBs, always do intra search
+        {
+            (*NumIntraSearch)++;
+        }
+
+        *totalSAD += (int) rateCtrl->MADofMB[mbnum];//mot_mb_16x16->sad;
+    }
+    else    /* INTRA update, use for prediction */
+    {
+        mot_mb_16x16[0].x = mot_mb_16x16[0].y = 0;
+
+        /* reset all other MVs to zero */
+        /* mot_mb_16x8, mot_mb_8x16, mot_mb_8x8, etc. */
+        abe_cost = encvid->min_cost[mbnum] = 0x7FFFFFFF;  /* max value for int */
+
+        if (i != mbwidth - 1 && j != mbheight - 1 && i != 0 && j != 0)
+        {
+            IntraDecisionABE(&abe_cost, cur, pitch, false);
+
+            rateCtrl->MADofMB[mbnum] = abe_cost;
+            *totalSAD += abe_cost;
+        }
+
+        (*NumIntraSearch)++ ;
+        /* cannot do I16 prediction here because it needs full decoding. */
+        // intraSearch[mbnum] = 1;
+
+    }
+
+    return ;
+}
+
 /******* main function for macroblock prediction for the entire frame ***/
 /* if turns out to be IDR frame, set video->nal_unit_type to AVC_NALTYPE_IDR */
 void AVCMotionEstimation(AVCEncObject *encvid)
 {
     AVCCommonObj *video = encvid->common;
     int slice_type = video->slice_type;
-    AVCFrameIO *currInput = encvid->currInput;
     AVCPictureData *refPic = video->RefPicList0[0];
-    int i, j, k;
+    int i, j;
     int mbwidth = video->PicWidthInMbs;
     int mbheight = video->PicHeightInMbs;
     int totalMB = video->PicSizeInMbs;
-    int pitch = currInput->pitch;
-    AVCMacroblock *currMB, *mblock = video->mblock;
-    AVCMV *mot_mb_16x16, *mot16x16 = encvid->mot16x16;
+    AVCMacroblock *mblock = video->mblock;
     // AVCMV *mot_mb_16x8, *mot_mb_8x16, *mot_mb_8x8, etc;
     AVCRateControl *rateCtrl = encvid->rateCtrl;
     uint8 *intraSearch = encvid->intraSearch;
-    uint FS_en = encvid->fullsearch_enable;
 
     int NumIntraSearch, start_i, numLoop, incr_i;
-    int mbnum, offset;
-    uint8 *cur, *best_cand[5];
     int totalSAD = 0;   /* average SAD for rate control */
     int type_pred;
-    int abe_cost;
 
 #ifdef HTFM
     /***** HYPOTHESIS TESTING ********/  /* 2/28/01 */
@@ -267,10 +395,6 @@ void AVCMotionEstimation(AVCEncObject *encvid)
     double exp_lamda[15];
     /*********************************/
 #endif
-    int hp_guess = 0;
-    uint32 mv_uint32;
-
-    offset = 0;
 
     if (slice_type == AVC_I_SLICE)
     {
@@ -336,94 +460,29 @@ void AVCMotionEstimation(AVCEncObject *encvid)
     NumIntraSearch = 0; // to be intra searched in the encoding loop.
     while (numLoop--)
     {
-        for (j = 0; j < mbheight; j++)
+#ifndef HTFM
+        if (encvid->meThreads)
         {
-            if (incr_i > 1)
-                start_i = (start_i == 0 ? 1 : 0) ; /* toggle 0 and 1 */
-
-            offset = pitch * (j << 4) + (start_i << 4);
-
-            mbnum = j * mbwidth + start_i;
-
-            for (i = start_i; i < mbwidth; i += incr_i)
+            AVCMotionSearchPass(encvid, start_i, incr_i, type_pred, &NumIntraSearch, &totalSAD);
+        }
+        else
+#endif
+        {
+            for (j = 0; j < mbheight; j++)
             {
-                video->mbNum = mbnum;
-                video->currMB = currMB = mblock + mbnum;
-                mot_mb_16x16 = mot16x16 + mbnum;
+                if (incr_i > 1)
+                    start_i = (start_i == 0 ? 1 : 0) ; /* toggle 0 and 1 */
 
-                cur = currInput->YCbCr[0] + offset;
-
-                if (currMB->mb_intra == 0) /* for INTER mode */
+                for (i = start_i; i < mbwidth; i += incr_i)
                 {
-#if defined(HTFM)
-                    HTFMPrepareCurMB_AVC(encvid, &htfm_stat, cur, pitch);
-#else
-                    AVCPrepareCurMB(encvid, cur, pitch);
+                    AVCMotionSearchMB(encvid, i, j, type_pred,
+#ifdef HTFM
+                                      &htfm_stat,
 #endif
-                    /************************************************************/
-                    /******** full-pel 1MV search **********************/
-
-                    AVCMBMotionSearch(encvid, cur, best_cand, i << 4, j << 4, type_pred,
-                                      FS_en, &hp_guess);
-
-                    abe_cost = encvid->min_cost[mbnum] = mot_mb_16x16->sad;
-
-                    /* set mbMode and MVs */
-                    currMB->mbMode = AVC_P16;
-                    currMB->MBPartPredMode[0][0] = AVC_Pred_L0;
-                    mv_uint32 = ((mot_mb_16x16->y) << 16) | ((mot_mb_16x16->x) & 0xffff);
-                    for (k = 0; k < 32; k += 2)
-                    {
-                        currMB->mvL0[k>>1] = mv_uint32;
-                    }
-
-                    /* make a decision whether it should be tested for intra or not */
-                    if (i != mbwidth - 1 && j != mbheight - 1 && i != 0 && j != 0)
-                    {
-                        if (false == IntraDecisionABE(&abe_cost, cur, pitch, true))
-                        {
-                            intraSearch[mbnum] = 0;
-                        }
-                        else
-                        {
-                            NumIntraSearch++;
-                            rateCtrl->MADofMB[mbnum] = abe_cost;
-                        }
-                    }
-                    else // boundary MBs, always do intra search
-                    {
-                        NumIntraSearch++;
-                    }
-
-                    totalSAD += (int) rateCtrl->MADofMB[mbnum];//mot_mb_16x16->sad;
-                }
-                else    /* INTRA update, use for prediction */
-                {
-                    mot_mb_16x16[0].x = mot_mb_16x16[0].y = 0;
-
-                    /* reset all other MVs to zero */
-                    /* mot_mb_16x8, mot_mb_8x16, mot_mb_8x8, etc. */
-                    abe_cost = encvid->min_cost[mbnum] = 0x7FFFFFFF;  /* max value for int */
-
-                    if (i != mbwidth - 1 && j != mbheight - 1 && i != 0 && j != 0)
-                    {
-                        IntraDecisionABE(&abe_cost, cur, pitch, false);
-
-                        rateCtrl->MADofMB[mbnum] = abe_cost;
-                        totalSAD += abe_cost;
-                    }
-
-                    NumIntraSearch++ ;
-                    /* cannot do I16 prediction here because it needs full decoding. */
-                    // intraSearch[mbnum] = 1;
-
-                }
-
-                mbnum += incr_i;
-                offset += (incr_i << 4);
-
-            } /* for i */
-        } /* for j */
+                                      &NumIntraSearch, &totalSAD);
+                } /* for i */
+            } /* for j */
+        }
 
         /* since we cannot do intra/inter decision here, the SCD has to be
         based on other criteria such as motion vectors coherency or the SAD */
@@ -472,6 +531,272 @@ void AVCMotionEstimation(AVCEncObject *encvid)
     return ;
 }
 
+#ifndef HTFM
+/* Threaded motion estimation: the calling thread and the workers search the macroblock rows
+   of a pass as a wavefront. A row may search macroblock i only after the row above has
+   finished macroblock i + 1, the top-right candidate. The rows below are then behind, so the
+   right and bottom candidates still are the ones of the previous frame as in raster scan and
+   the motion vectors do not depend on the number of threads. */
+
+/* The calling thread takes part in the search, so up to MAX_ME_THREADS - 1 workers are started */
+#define MAX_ME_THREADS  8
+
+/* A worker searches with its own copy of the encoder and common objects, since the
+   motion search of a macroblock uses currYMB, the sub-pel buffers and mbNum as scratch. */
+typedef struct tagAVCMEWorker
+{
+    struct tagAVCMEThreads *threads;
+    AVCEncObject encvid;
+    AVCCommonObj common;
+    pthread_t thread;
+} AVCMEWorker;
+
+/* State shared by the threads searching a frame, the fields below the mutex are protected
+   by it. */
+struct tagAVCMEThreads
+{
+    int numWorkers;
+    AVCMEWorker *worker[MAX_ME_THREADS - 1];
+    int *progress;  /* number of macroblocks of each row done in the current pass */
+    int numRows;    /* size of progress */
+
+    pthread_mutex_t mutex;
+    pthread_cond_t workCond;
+    pthread_cond_t progressCond;
+    int exit;
+    int generation; /* incremented for each pass */
+    int mbheight;
+    int start_i;    /* same as in AVCMotionEstimation */
+    int incr_i;
+    int type_pred;
+    int nextRow;
+    int rowsDone;
+    int NumIntraSearch;
+    int totalSAD;
+};
+
+static void *AVCMEWorkerThread(void *arg);
+
+/* Start the workers, returns NULL if none could be started */
+static AVCMEThreads *AVCCreateMEThreads(AVCHandle *avcHandle, int numThreads)
+{
+    AVCEncObject *encvid = (AVCEncObject*) avcHandle->AVCObject;
+    AVCMEThreads *threads;
+    AVCMEWorker *worker;
+    int k;
+
+    if (numThreads > MAX_ME_THREADS)
+    {
+        numThreads = MAX_ME_THREADS;
+    }
+
+    threads = (AVCMEThreads*) avcHandle->CBAVC_Malloc(avcHandle->userData, sizeof(AVCMEThreads), DEFAULT_ATTR);
+    if (threads == NULL)
+    {
+        return NULL;
+    }
+    memset(threads, 0, sizeof(AVCMEThreads));
+
+    threads->numRows = encvid->common->FrameHeightInMbs;
+    threads->progress = (int*) avcHandle->CBAVC_Malloc(avcHandle->userData, sizeof(int) * threads->numRows, DEFAULT_ATTR);
+    if (threads->progress == NULL)
+    {
+        avcHandle->CBAVC_Free(avcHandle->userData, (int)threads);
+        return NULL;
+    }
+
+    pthread_mutex_init(&threads->mutex, NULL);
+    pthread_cond_init(&threads->workCond, NULL);
+    pthread_cond_init(&threads->progressCond, NULL);
+
+    for (k = 0; k < numThreads - 1; k++)
+    {
+        worker = (AVCMEWorker*) avcHandle->CBAVC_Malloc(avcHandle->userData, sizeof(AVCMEWorker), DEFAULT_ATTR);
+        if (worker == NULL)
+        {
+            break;
+        }
+        worker->threads = threads;
+
+        if (pthread_create(&worker->thread, NULL, AVCMEWorkerThread, worker))
+        {
+            avcHandle->CBAVC_Free(avcHandle->userData, (int)worker);
+            break;
+        }
+        threads->worker[threads->numWorkers++] = worker;
+    }
+
+    if (threads->numWorkers == 0)
+    {
+        AVCDestroyMEThreads(avcHandle, threads);
+        return NULL;
+    }
+
+    return threads;
+}
+
+/* Stop the workers and free the thread state */
+static void AVCDestroyMEThreads(AVCHandle *avcHandle, AVCMEThreads *threads)
+{
+    int k;
+
+    pthread_mutex_lock(&threads->mutex);
+    threads->exit = 1;
+    pthread_cond_broadcast(&threads->workCond);
+    pthread_mutex_unlock(&threads->mutex);
+
+    for (k = 0; k < threads->numWorkers; k++)
+    {
+        pthread_join(threads->worker[k]->thread, NULL);
+        avcHandle->CBAVC_Free(avcHandle->userData, (int)threads->worker[k]);
+    }
+
+    pthread_cond_destroy(&threads->progressCond);
+    pthread_cond_destroy(&threads->workCond);
+    pthread_mutex_destroy(&threads->mutex);
+
+    avcHandle->CBAVC_Free(avcHandle->userData, (int)threads->progress);
+    avcHandle->CBAVC_Free(avcHandle->userData, (int)threads);
+
+    return ;
+}
+
+/* Search the rows of the current pass until there are none left to pick. Called and returns
+   with the mutex held, which is released while searching. */
+static void AVCMotionSearchRows(AVCMEThreads *threads, AVCEncObject *encvid)
+{
+    int mbwidth = encvid->common->PicWidthInMbs;
+    int i, j, start_i, incr_i, type_pred, needed, available;
+    int NumIntraSearch, totalSAD;
+
+    while (threads->nextRow < threads->mbheight)
+    {
+        j = threads->nextRow++;
+        incr_i = threads->incr_i;
+        type_pred = threads->type_pred;
+        /* the first row of a pass starts at start_i toggled, as in AVCMotionEstimation */
+        start_i = (incr_i > 1) ? ((j & 1) ^(threads->start_i == 0 ? 1 : 0)) : 0;
+        available = j ? threads->progress[j - 1] : mbwidth;
+        NumIntraSearch = totalSAD = 0;
+
+        pthread_mutex_unlock(&threads->mutex);
+
+        for (i = start_i; i < mbwidth; i += incr_i)
+        {
+            needed = (i + 2 < mbwidth) ? i + 2 : mbwidth;
+            if (available < needed)
+            {
+                pthread_mutex_lock(&threads->mutex);
+                while (threads->progress[j - 1] < needed)
+                {
+                    pthread_cond_wait(&threads->progressCond, &threads->mutex);
+                }
+                available = threads->progress[j - 1];
+                pthread_mutex_unlock(&threads->mutex);
+            }
+
+            AVCMotionSearchMB(encvid, i, j, type_pred, &NumIntraSearch, &totalSAD);
+
+            if (i + incr_i < mbwidth)
+            {
+                pthread_mutex_lock(&threads->mutex);
+                threads->progress[j] = i + incr_i;
+                pthread_cond_broadcast(&threads->progressCond);
+                pthread_mutex_unlock(&threads->mutex);
+            }
+        }
+
+        pthread_mutex_lock(&threads->mutex);
+        threads->progress[j] = mbwidth;
+        threads->rowsDone++;
+        threads->NumIntraSearch += NumIntraSearch;
+        threads->totalSAD += totalSAD;
+        pthread_cond_broadcast(&threads->progressCond);
+    }
+
+    return ;
+}
+
+/* Worker thread, helps with each new pass until asked to exit */
+static void *AVCMEWorkerThread(void *arg)
+{
+    AVCMEWorker *worker = (AVCMEWorker*) arg;
+    AVCMEThreads *threads = worker->threads;
+    int generation = 0;
+
+    pthread_mutex_lock(&threads->mutex);
+
+    while (1)
+    {
+        while (!threads->exit && threads->generation == generation)
+        {
+            pthread_cond_wait(&threads->workCond, &threads->mutex);
+        }
+
+        if (threads->exit)
+        {
+            break;
+        }
+
+        generation = threads->generation;
+        AVCMotionSearchRows(threads, &worker->encvid);
+    }
+
+    pthread_mutex_unlock(&threads->mutex);
+
+    return NULL;
+}
+
+/* One pass of AVCMotionEstimation on the calling thread and the workers, with the same
+   results as the single-threaded loop. */
+static void AVCMotionSearchPass(AVCEncObject *encvid, int start_i, int incr_i, int type_pred,
+                                int *NumIntraSearch, int *totalSAD)
+{
+    AVCMEThreads *threads = encvid->meThreads;
+    AVCCommonObj *video = encvid->common;
+    AVCMEWorker *worker;
+    int k;
+
+    pthread_mutex_lock(&threads->mutex);
+
+    /* no worker is searching between passes, so their copies can be refreshed here */
+    for (k = 0; k < threads->numWorkers; k++)
+    {
+        worker = threads->worker[k];
+        memcpy(&worker->encvid, encvid, sizeof(AVCEncObject));
+        memcpy(&worker->common, video, sizeof(AVCCommonObj));
+        worker->encvid.common = &worker->common;
+        AVCInitSubpelPointers(&worker->encvid);
+    }
+
+    threads->mbheight = video->PicHeightInMbs;
+    memset(threads->progress, 0, sizeof(int) * threads->mbheight);
+    threads->start_i = start_i;
+    threads->incr_i = incr_i;
+    threads->type_pred = type_pred;
+    threads->nextRow = 0;
+    threads->rowsDone = 0;
+    threads->NumIntraSearch = 0;
+    threads->totalSAD = 0;
+    threads->generation++;
+    pthread_cond_broadcast(&threads->workCond);
+
+    AVCMotionSearchRows(threads, encvid);
+
+    while (threads->rowsDone < threads->mbheight)
+    {
+        pthread_cond_wait(&threads->progressCond, &threads->mutex);
+    }
+
+    *NumIntraSearch += threads->NumIntraSearch;
+    *totalSAD += threads->totalSAD;
+
+    pthread_mutex_unlock(&threads->mutex);
+
+    return ;
+}
+#endif // HTFM
+
 /*=====================================================================
     Function:   PaddingEdge
     Date:       09/16/2000
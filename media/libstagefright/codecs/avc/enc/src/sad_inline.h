@@ -18,6 +18,10 @@
 #ifndef _SAD_INLINE_H_
 #define _SAD_INLINE_H_
 
+#if defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
+
 #ifdef __cplusplus
 extern "C"
 {
@@ -74,6 +78,41 @@ extern "C"
 #include "sad_mb_offset.h"
 
 
+#if defined(__ARM_NEON__)
+
+    /* NEON loads do not need ref to be word aligned, so there is no offset variant. The SAD
+       is compared with dmin after each row like below, since the partial SAD is returned. */
+    __inline int32 simd_sad_mb(uint8 *ref, uint8 *blk, int dmin, int lx)
+    {
+        uint16x8_t sad16 = vdupq_n_u16(0);
+        uint64x2_t sad64;
+        uint8x16_t x10, x12;
+        int32 sad = 0;
+        int x8 = 16;
+
+        while (x8--)
+        {
+            x10 = vld1q_u8(ref);
+            x12 = vld1q_u8(blk);
+            ref += lx;
+            blk += 16;
+
+            sad16 = vabal_u8(sad16, vget_low_u8(x10), vget_low_u8(x12));
+            sad16 = vabal_u8(sad16, vget_high_u8(x10), vget_high_u8(x12));
+
+            sad64 = vpaddlq_u32(vpaddlq_u16(sad16));
+            sad = (int32)(vgetq_lane_u64(sad64, 0) + vgetq_lane_u64(sad64, 1));
+            if (sad > dmin) /* compare with dmin */
+            {
+                break;
+            }
+        }
+
+        return sad;
+    }
+
+#else
+
     __inline int32 simd_sad_mb(uint8 *ref, uint8 *blk, int dmin, int lx)
     {
         int32 x4, x5, x6, x8, x9, x10, x11, x12, x14;
@@ -167,6 +206,8 @@ SadMBOffset1:
 
     }
 
+#endif // __ARM_NEON__
+
 #elif defined(__CC_ARM)  /* only work with arm v5 */
 
     __inline int32 SUB_SAD(int32 sad, int32 tmp, int32 tmp2)
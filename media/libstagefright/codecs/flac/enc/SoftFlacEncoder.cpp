@@ -20,8 +20,11 @@
 
 #include "SoftFlacEncoder.h"
 
+#include <pthread.h>
+
 #include <media/stagefright/foundation/ADebug.h>
 #include <media/stagefright/MediaDefs.h>
+#include <utils/threads.h>
 
 #define FLAC_COMPRESSION_LEVEL_MIN     0
 #define FLAC_COMPRESSION_LEVEL_DEFAULT 5
@@ -29,6 +32,316 @@
 
 namespace android {
 
+static const char *kEncoderThreadsExtension =
+    "OMX.google.android.index.encoderThreads";
+
+static const OMX_INDEXTYPE kIndexParamEncoderThreads =
+    (OMX_INDEXTYPE)(OMX_IndexVendorStartUnused + 1);
+
+// Sets up |encoder| for 16-bit input with the given parameters and
+// initializes it, the encoded data is passed to |writeCallback|.
+static bool initStreamEncoder(
+        FLAC__StreamEncoder *encoder, unsigned channels, unsigned sampleRate,
+        unsigned compressionLevel, FLAC__StreamEncoderWriteCallback writeCallback,
+        void *clientData) {
+    FLAC__bool ok = true;
+    ok = ok && FLAC__stream_encoder_set_channels(encoder, channels);
+    ok = ok && FLAC__stream_encoder_set_sample_rate(encoder, sampleRate);
+    ok = ok && FLAC__stream_encoder_set_bits_per_sample(encoder, 16);
+    ok = ok && FLAC__stream_encoder_set_compression_level(encoder, compressionLevel);
+    ok = ok && FLAC__stream_encoder_set_verify(encoder, false);
+
+    ok = ok && FLAC__STREAM_ENCODER_INIT_STATUS_OK ==
+            FLAC__stream_encoder_init_stream(encoder,
+                    writeCallback               /*write_callback*/,
+                    NULL /*seek_callback*/,
+                    NULL /*tell_callback*/,
+                    NULL /*metadata_callback*/,
+                    clientData                  /*client_data*/);
+
+    return ok;
+}
+
+// CRC-8 of a FLAC frame header, polynomial x^8 + x^2 + x^1 + x^0
+static uint8_t flacCrc8(const uint8_t *data, size_t size) {
+    uint8_t crc = 0;
+    while (size-- > 0) {
+        crc ^= *data++;
+        for (int i = 0; i < 8; ++i) {
+            crc = (crc & 0x80) ? (crc << 1) ^ 0x07 : crc << 1;
+        }
+    }
+    return crc;
+}
+
+// CRC-16 of a FLAC frame, polynomial x^16 + x^15 + x^2 + x^0
+static uint16_t flacCrc16(const uint8_t *data, size_t size) {
+    uint16_t crc = 0;
+    while (size-- > 0) {
+        crc ^= *data++ << 8;
+        for (int i = 0; i < 8; ++i) {
+            crc = (crc & 0x8000) ? (crc << 1) ^ 0x8005 : crc << 1;
+        }
+    }
+    return crc;
+}
+
+// libFLAC numbers frames from 0 each time an encoder is initialized. Writes
+// |frameNumber| in the header of such a frame 0 of |size| bytes, which may
+// make it longer, and updates both CRCs. Returns the new size of the frame,
+// or -1 if it is not a fixed block size frame 0 or does not fit in
+// |capacity| bytes.
+static ssize_t setFrameNumber(
+        uint8_t *frame, size_t size, size_t capacity, uint32_t frameNumber) {
+    if (size < 8 || frame[0] != 0xff || frame[1] != 0xf8 || frame[4] != 0) {
+        return -1;
+    }
+
+    // coded like UTF-8 extended to 31 bits
+    uint8_t number[6];
+    size_t numberSize = 1;
+    frameNumber &= 0x7fffffff;
+    if (frameNumber < 0x80) {
+        number[0] = frameNumber;
+    } else {
+        numberSize = frameNumber < 0x800 ? 2
+                : frameNumber < 0x10000 ? 3
+                : frameNumber < 0x200000 ? 4
+                : frameNumber < 0x4000000 ? 5 : 6;
+        for (size_t i = numberSize - 1; i > 0; --i) {
+            number[i] = 0x80 | (frameNumber & 0x3f);
+            frameNumber >>= 6;
+        }
+        number[0] = ((0xff00 >> numberSize) & 0xff) | frameNumber;
+    }
+
+    // the header continues with the block size and sample rate if they
+    // don't have a code of their own, then the CRC-8
+    size_t headerSize = 5;
+    unsigned blockSizeCode = frame[2] >> 4;
+    unsigned sampleRateCode = frame[2] & 0x0f;
+    if (blockSizeCode == 6 || blockSizeCode == 7) {
+        headerSize += blockSizeCode - 5;
+    }
+    if (sampleRateCode == 12) {
+        headerSize += 1;
+    } else if (sampleRateCode == 13 || sampleRateCode == 14) {
+        headerSize += 2;
+    }
+
+    size_t newSize = size + numberSize - 1;
+    if (size < headerSize + 1 + 2 || newSize > capacity) {
+        return -1;
+    }
+
+    memmove(frame + 4 + numberSize, frame + 5, size - 5);
+    memcpy(frame + 4, number, numberSize);
+    headerSize += numberSize - 1;
+    frame[headerSize] = flacCrc8(frame, headerSize);
+
+    uint16_t crc = flacCrc16(frame, newSize - 2);
+    frame[newSize - 2] = crc >> 8;
+    frame[newSize - 1] = crc & 0xff;
+
+    return newSize;
+}
+
+// Encodes one block of samples at a time into a single FLAC frame on a
+// thread of its own. mPcm to mTimeUs are set by the component while the
+// worker is IDLE, mData to mError by the worker thread while it is BUSY.
+struct SoftFlacEncoder::Worker {
+    enum State {
+        IDLE,
+        BUSY,
+        DONE,
+    };
+
+    Worker(unsigned channels, unsigned sampleRate, unsigned compressionLevel,
+            unsigned blockSize);
+    ~Worker();
+
+    bool start();
+
+    FLAC__int32 *mPcm;
+    unsigned mNumFrames;
+    uint32_t mFrameNumber;
+    OMX_TICKS mTimeUs;
+
+    uint8_t *mData;
+    size_t mSize;
+    bool mError;
+
+    Mutex mLock;
+    Condition mCondition;
+    State mState;
+
+private:
+    const unsigned mChannels;
+    const unsigned mSampleRate;
+    const unsigned mCompressionLevel;
+
+    FLAC__StreamEncoder *mEncoder;
+
+    pthread_t mThread;
+    bool mThreadStarted;
+    bool mExit;
+
+    static void *ThreadWrapper(void *me);
+    void threadEntry();
+
+    bool encode();
+
+    static FLAC__StreamEncoderWriteStatus writeCallback(
+            const FLAC__StreamEncoder *encoder, const FLAC__byte buffer[],
+            size_t bytes, unsigned samples, unsigned current_frame, void *client_data);
+
+    Worker(const Worker &);
+    Worker &operator=(const Worker &);
+};
+
+SoftFlacEncoder::Worker::Worker(
+        unsigned channels, unsigned sampleRate, unsigned compressionLevel,
+        unsigned blockSize)
+    : mPcm((FLAC__int32 *)malloc(sizeof(FLAC__int32) * channels * blockSize)),
+      mNumFrames(0),
+      mFrameNumber(0),
+      mTimeUs(0),
+      mData((uint8_t *)malloc(kMaxOutputBufferSize)),
+      mSize(0),
+      mError(false),
+      mState(IDLE),
+      mChannels(channels),
+      mSampleRate(sampleRate),
+      mCompressionLevel(compressionLevel),
+      mEncoder(FLAC__stream_encoder_new()),
+      mThreadStarted(false),
+      mExit(false) {
+}
+
+SoftFlacEncoder::Worker::~Worker() {
+    if (mThreadStarted) {
+        {
+            Mutex::Autolock autoLock(mLock);
+            mExit = true;
+            mCondition.broadcast();
+        }
+
+        void *dummy;
+        pthread_join(mThread, &dummy);
+    }
+
+    if (mEncoder != NULL) {
+        FLAC__stream_encoder_delete(mEncoder);
+        mEncoder = NULL;
+    }
+    free(mData);
+    mData = NULL;
+    free(mPcm);
+    mPcm = NULL;
+}
+
+bool SoftFlacEncoder::Worker::start() {
+    if (mPcm == NULL || mData == NULL || mEncoder == NULL
+            || !initStreamEncoder(mEncoder, mChannels, mSampleRate,
+                    mCompressionLevel, writeCallback, this)) {
+        return false;
+    }
+
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_JOINABLE);
+
+    mThreadStarted = pthread_create(&mThread, &attr, ThreadWrapper, this) == 0;
+
+    pthread_attr_destroy(&attr);
+
+    return mThreadStarted;
+}
+
+// static
+void *SoftFlacEncoder::Worker::ThreadWrapper(void *me) {
+    static_cast<Worker *>(me)->threadEntry();
+
+    return NULL;
+}
+
+void SoftFlacEncoder::Worker::threadEntry() {
+    Mutex::Autolock autoLock(mLock);
+
+    for (;;) {
+        while (mState != BUSY && !mExit) {
+            mCondition.wait(mLock);
+        }
+
+        if (mExit) {
+            break;
+        }
+
+        mLock.unlock();
+        bool ok = encode();
+        mLock.lock();
+
+        mError = !ok;
+        mState = DONE;
+        mCondition.broadcast();
+    }
+}
+
+bool SoftFlacEncoder::Worker::encode() {
+    mSize = 0;
+
+    // libFLAC only encodes a block once it has received a sample more than
+    // the block size, or when it is finished. Finishing also makes each frame
+    // independent of the previous ones, such as for the loose mid-side
+    // stereo decision of some compression levels.
+    if (!FLAC__stream_encoder_process_interleaved(mEncoder, mPcm, mNumFrames)
+            || !FLAC__stream_encoder_finish(mEncoder)) {
+        ALOGE("error encoding frame %u: %s", mFrameNumber,
+                FLAC__stream_encoder_get_resolved_state_string(mEncoder));
+        return false;
+    }
+
+    // finishing resets all the settings
+    if (!initStreamEncoder(mEncoder, mChannels, mSampleRate,
+                mCompressionLevel, writeCallback, this)) {
+        ALOGE("error initializing encoder");
+        return false;
+    }
+
+    if (mSize > 0) {
+        ssize_t size = setFrameNumber(mData, mSize, kMaxOutputBufferSize, mFrameNumber);
+        if (size < 0) {
+            ALOGE("unexpected header in encoded frame %u", mFrameNumber);
+            return false;
+        }
+        mSize = size;
+    }
+
+    return true;
+}
+
+// static
+FLAC__StreamEncoderWriteStatus SoftFlacEncoder::Worker::writeCallback(
+            const FLAC__StreamEncoder *encoder, const FLAC__byte buffer[],
+            size_t bytes, unsigned samples, unsigned current_frame, void *client_data) {
+    Worker *me = static_cast<Worker *>(client_data);
+
+    if (samples == 0) {
+        // stream header written when the encoder is initialized
+        return FLAC__STREAM_ENCODER_WRITE_STATUS_OK;
+    }
+
+    if (bytes > kMaxOutputBufferSize - me->mSize) {
+        ALOGE("encoded frame larger than %d bytes", kMaxOutputBufferSize);
+        return FLAC__STREAM_ENCODER_WRITE_STATUS_FATAL_ERROR;
+    }
+
+    memcpy(me->mData + me->mSize, buffer, bytes);
+    me->mSize += bytes;
+
+    return FLAC__STREAM_ENCODER_WRITE_STATUS_OK;
+}
+
 template<class T>
 static void InitOMXParams(T *params) {
     params->nSize = sizeof(T);
@@ -51,6 +364,16 @@ SoftFlacEncoder::SoftFlacEncoder(
       mEncoderWriteData(false),
       mEncoderReturnedEncodedData(false),
       mEncoderReturnedNbBytes(0),
+      mNumThreads(1),
+      mBlockSize(0),
+      mBlockPcm(NULL),
+      mBlockNumFrames(0),
+      mBlockTimeUs(0),
+      mInputFramesConsumed(0),
+      mNextFrameNumber(0),
+      mNumBlocksQueued(0),
+      mNumBlocksSent(0),
+      mSawInputEOS(false),
       mInputBufferPcm32(NULL)
 #ifdef WRITE_FLAC_HEADER_IN_FIRST_BUFFER
       , mHeaderOffset(0)
@@ -77,6 +400,8 @@ SoftFlacEncoder::SoftFlacEncoder(
 
 SoftFlacEncoder::~SoftFlacEncoder() {
     ALOGV("SoftFlacEncoder::~SoftFlacEncoder()");
+    stopWorkers();
+
     if (mFlacStreamEncoder != NULL) {
         FLAC__stream_encoder_delete(mFlacStreamEncoder);
         mFlacStreamEncoder = NULL;
@@ -180,6 +505,14 @@ OMX_ERRORTYPE SoftFlacEncoder::internalGetParameter(
             return OMX_ErrorNone;
         }
 
+        case kIndexParamEncoderThreads:
+        {
+            OMX_PARAM_U32TYPE *threadParams = (OMX_PARAM_U32TYPE *)params;
+
+            threadParams->nU32 = mNumThreads;
+            return OMX_ErrorNone;
+        }
+
         default:
             return SimpleSoftOMXComponent::internalGetParameter(index, params);
     }
@@ -234,12 +567,43 @@ OMX_ERRORTYPE SoftFlacEncoder::internalSetParameter(
             return OMX_ErrorNone;
         }
 
+        case kIndexParamEncoderThreads:
+        {
+            const OMX_PARAM_U32TYPE *threadParams =
+                (const OMX_PARAM_U32TYPE *)params;
+
+            if (threadParams->nU32 < 1
+                    || threadParams->nU32 > kMaxEncoderThreads) {
+                return OMX_ErrorBadParameter;
+            }
+
+            if (!mWorkers.isEmpty() && threadParams->nU32 != mNumThreads) {
+                // the workers are started with the first input buffer
+                return OMX_ErrorIncorrectStateOperation;
+            }
+
+            mNumThreads = threadParams->nU32;
+            ALOGV("will encode on %ld threads", mNumThreads);
+
+            return OMX_ErrorNone;
+        }
+
         default:
             ALOGV("SoftFlacEncoder::internalSetParameter(default)");
             return SimpleSoftOMXComponent::internalSetParameter(index, params);
     }
 }
 
+OMX_ERRORTYPE SoftFlacEncoder::getExtensionIndex(
+        const char *name, OMX_INDEXTYPE *index) {
+    if (!strcmp(name, kEncoderThreadsExtension)) {
+        *index = kIndexParamEncoderThreads;
+        return OMX_ErrorNone;
+    }
+
+    return SimpleSoftOMXComponent::getExtensionIndex(name, index);
+}
+
 void SoftFlacEncoder::onQueueFilled(OMX_U32 portIndex) {
 
     ALOGV("SoftFlacEncoder::onQueueFilled(portIndex=%ld)", portIndex);
@@ -248,6 +612,11 @@ void SoftFlacEncoder::onQueueFilled(OMX_U32 portIndex) {
         return;
     }
 
+    if (mNumThreads > 1) {
+        onQueueFilledWithWorkers();
+        return;
+    }
+
     List<BufferInfo *> &inQueue = getPortQueue(0);
     List<BufferInfo *> &outQueue = getPortQueue(1);
 
@@ -396,25 +765,9 @@ OMX_ERRORTYPE SoftFlacEncoder::configureEncoder() {
         return OMX_ErrorInvalidState;
     }
 
-    FLAC__bool ok = true;
-    FLAC__StreamEncoderInitStatus initStatus = FLAC__STREAM_ENCODER_INIT_STATUS_OK;
-    ok = ok && FLAC__stream_encoder_set_channels(mFlacStreamEncoder, mNumChannels);
-    ok = ok && FLAC__stream_encoder_set_sample_rate(mFlacStreamEncoder, mSampleRate);
-    ok = ok && FLAC__stream_encoder_set_bits_per_sample(mFlacStreamEncoder, 16);
-    ok = ok && FLAC__stream_encoder_set_compression_level(mFlacStreamEncoder,
-            (unsigned)mCompressionLevel);
-    ok = ok && FLAC__stream_encoder_set_verify(mFlacStreamEncoder, false);
-    if (!ok) { goto return_result; }
-
-    ok &= FLAC__STREAM_ENCODER_INIT_STATUS_OK ==
-            FLAC__stream_encoder_init_stream(mFlacStreamEncoder,
-                    flacEncoderWriteCallback    /*write_callback*/,
-                    NULL /*seek_callback*/,
-                    NULL /*tell_callback*/,
-                    NULL /*metadata_callback*/,
-                    (void *) this /*client_data*/);
+    bool ok = initStreamEncoder(mFlacStreamEncoder, mNumChannels, mSampleRate,
+            (unsigned)mCompressionLevel, flacEncoderWriteCallback, (void *) this);
 
-return_result:
     if (ok) {
         ALOGV("encoder successfully configured");
         return OMX_ErrorNone;
@@ -425,6 +778,259 @@ return_result:
 }
 
 
+bool SoftFlacEncoder::startWorkers() {
+    // same block size as the encoder used on the component thread
+    mBlockSize = FLAC__stream_encoder_get_blocksize(mFlacStreamEncoder);
+    mBlockPcm = (FLAC__int32 *)malloc(sizeof(FLAC__int32) * mNumChannels * mBlockSize);
+    if (mBlockPcm == NULL) {
+        return false;
+    }
+
+    for (OMX_U32 i = 0; i < mNumThreads; ++i) {
+        Worker *worker = new Worker(mNumChannels, mSampleRate,
+                (unsigned)mCompressionLevel, mBlockSize);
+        mWorkers.push(worker);
+
+        if (!worker->start()) {
+            stopWorkers();
+            return false;
+        }
+    }
+
+    mBlockNumFrames = 0;
+    mInputFramesConsumed = 0;
+    mNextFrameNumber = 0;
+    mNumBlocksQueued = 0;
+    mNumBlocksSent = 0;
+    mSawInputEOS = false;
+
+    ALOGV("started %d encoder threads, %u samples per frame",
+            mWorkers.size(), mBlockSize);
+
+    return true;
+}
+
+void SoftFlacEncoder::stopWorkers() {
+    for (size_t i = 0; i < mWorkers.size(); ++i) {
+        delete mWorkers[i];
+    }
+    mWorkers.clear();
+
+    free(mBlockPcm);
+    mBlockPcm = NULL;
+}
+
+void SoftFlacEncoder::onQueueFilledWithWorkers() {
+    List<BufferInfo *> &inQueue = getPortQueue(0);
+    List<BufferInfo *> &outQueue = getPortQueue(1);
+
+    if (mWorkers.isEmpty() && !startWorkers()) {
+        ALOGE("unable to start %ld encoder threads", mNumThreads);
+        mSignalledError = true;
+        notify(OMX_EventError, OMX_ErrorInsufficientResources, 0, NULL);
+        return;
+    }
+
+    assert(mNumChannels != 0);
+    const size_t frameSize = mNumChannels * sizeof(OMX_S16);
+
+    for (;;) {
+        // send out the blocks already encoded, in order
+        while (sendEncodedBlock(false /* wait */)) {
+        }
+
+        if (mSignalledError) {
+            return;
+        }
+
+        if (mBlockNumFrames == mBlockSize || (mSawInputEOS && mBlockNumFrames > 0)) {
+            if (mNumBlocksQueued - mNumBlocksSent < mWorkers.size()) {
+                queueBlock();
+            } else if (!sendEncodedBlock(true /* wait */)) {
+                // all the workers have a block, wait for an output buffer
+                return;
+            }
+            continue;
+        }
+
+        if (mSawInputEOS) {
+            if (mNumBlocksSent < mNumBlocksQueued) {
+                if (!sendEncodedBlock(true /* wait */)) {
+                    return;
+                }
+                continue;
+            }
+
+            if (outQueue.empty()) {
+                return;
+            }
+
+            BufferInfo *outInfo = *outQueue.begin();
+            OMX_BUFFERHEADERTYPE *outHeader = outInfo->mHeader;
+
+            outHeader->nOffset = 0;
+            outHeader->nFilledLen = 0;
+            outHeader->nFlags = OMX_BUFFERFLAG_EOS;
+
+            outQueue.erase(outQueue.begin());
+            outInfo->mOwnedByUs = false;
+            notifyFillBufferDone(outHeader);
+
+            mSawInputEOS = false;
+            return;
+        }
+
+        if (inQueue.empty()) {
+            return;
+        }
+
+        BufferInfo *inInfo = *inQueue.begin();
+        OMX_BUFFERHEADERTYPE *inHeader = inInfo->mHeader;
+
+        // an input buffer may fill more than one block
+        const unsigned numInputFrames = inHeader->nFilledLen / frameSize;
+        unsigned numFrames = numInputFrames - mInputFramesConsumed;
+        if (numFrames > mBlockSize - mBlockNumFrames) {
+            numFrames = mBlockSize - mBlockNumFrames;
+        }
+
+        if (numFrames > 0) {
+            if (mBlockNumFrames == 0) {
+                mBlockTimeUs = inHeader->nTimeStamp
+                        + (mInputFramesConsumed * 1000000ll) / mSampleRate;
+            }
+
+            const OMX_S16 *pcm16 =
+                reinterpret_cast<OMX_S16 *>(inHeader->pBuffer + inHeader->nOffset)
+                    + mInputFramesConsumed * mNumChannels;
+            FLAC__int32 *pcm32 = mBlockPcm + mBlockNumFrames * mNumChannels;
+            for (unsigned i = 0; i < numFrames * mNumChannels; i++) {
+                pcm32[i] = (FLAC__int32) pcm16[i];
+            }
+
+            mBlockNumFrames += numFrames;
+            mInputFramesConsumed += numFrames;
+        }
+
+        if (mInputFramesConsumed == numInputFrames) {
+            if (inHeader->nFlags & OMX_BUFFERFLAG_EOS) {
+                mSawInputEOS = true;
+            }
+
+            mInputFramesConsumed = 0;
+
+            inInfo->mOwnedByUs = false;
+            inQueue.erase(inQueue.begin());
+            inInfo = NULL;
+            notifyEmptyBufferDone(inHeader);
+            inHeader = NULL;
+        }
+    }
+}
+
+void SoftFlacEncoder::queueBlock() {
+    Worker *worker = mWorkers[mNumBlocksQueued % mWorkers.size()];
+
+    Mutex::Autolock autoLock(worker->mLock);
+    CHECK_EQ((int)worker->mState, (int)Worker::IDLE);
+
+    // the worker's buffer is the same size, swap them instead of copying
+    FLAC__int32 *pcm = worker->mPcm;
+    worker->mPcm = mBlockPcm;
+    mBlockPcm = pcm;
+
+    worker->mNumFrames = mBlockNumFrames;
+    worker->mFrameNumber = mNextFrameNumber++;
+    worker->mTimeUs = mBlockTimeUs;
+    worker->mState = Worker::BUSY;
+    worker->mCondition.broadcast();
+
+    ++mNumBlocksQueued;
+    mBlockNumFrames = 0;
+}
+
+// Sends the oldest block queued to the workers on the output port, if it has
+// been encoded or |wait| is set, and an output buffer is available. Returns
+// true if the block was sent.
+bool SoftFlacEncoder::sendEncodedBlock(bool wait) {
+    List<BufferInfo *> &outQueue = getPortQueue(1);
+
+    if (mNumBlocksSent == mNumBlocksQueued || outQueue.empty()) {
+        return false;
+    }
+
+    Worker *worker = mWorkers[mNumBlocksSent % mWorkers.size()];
+
+    {
+        Mutex::Autolock autoLock(worker->mLock);
+        if (worker->mState == Worker::BUSY && !wait) {
+            return false;
+        }
+        while (worker->mState == Worker::BUSY) {
+            worker->mCondition.wait(worker->mLock);
+        }
+    }
+
+    if (worker->mError) {
+        ALOGE(" error encountered during encoding");
+        mSignalledError = true;
+        notify(OMX_EventError, OMX_ErrorUndefined, 0, NULL);
+        return false;
+    }
+
+    if (worker->mSize > 0) {
+        BufferInfo *outInfo = *outQueue.begin();
+        OMX_BUFFERHEADERTYPE *outHeader = outInfo->mHeader;
+
+        CHECK_LE(worker->mSize, outHeader->nAllocLen);
+        memcpy(outHeader->pBuffer, worker->mData, worker->mSize);
+
+        outHeader->nOffset = 0;
+        outHeader->nFilledLen = worker->mSize;
+        outHeader->nTimeStamp = worker->mTimeUs;
+        outHeader->nFlags = 0;
+
+        outInfo->mOwnedByUs = false;
+        outQueue.erase(outQueue.begin());
+        outInfo = NULL;
+        notifyFillBufferDone(outHeader);
+        outHeader = NULL;
+    }
+
+    {
+        Mutex::Autolock autoLock(worker->mLock);
+        worker->mState = Worker::IDLE;
+    }
+
+    ++mNumBlocksSent;
+
+    return true;
+}
+
+// Drops the input accumulated so far and the blocks not sent yet.
+void SoftFlacEncoder::drainWorkers() {
+    for (size_t i = 0; i < mWorkers.size(); ++i) {
+        Worker *worker = mWorkers[i];
+
+        Mutex::Autolock autoLock(worker->mLock);
+        while (worker->mState == Worker::BUSY) {
+            worker->mCondition.wait(worker->mLock);
+        }
+        worker->mState = Worker::IDLE;
+    }
+
+    mNumBlocksSent = mNumBlocksQueued;
+    mBlockNumFrames = 0;
+    mInputFramesConsumed = 0;
+    mSawInputEOS = false;
+}
+
+void SoftFlacEncoder::onPortFlushCompleted(OMX_U32 portIndex) {
+    if (portIndex == 0) {
+        drainWorkers();
+    }
+}
+
 // static
 FLAC__StreamEncoderWriteStatus SoftFlacEncoder::flacEncoderWriteCallback(
             const FLAC__StreamEncoder *encoder, const FLAC__byte buffer[],
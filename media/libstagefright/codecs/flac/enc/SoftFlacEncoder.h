@@ -20,6 +20,8 @@
 
 #include "SimpleSoftOMXComponent.h"
 
+#include <utils/Vector.h>
+
 #include "FLAC/stream_encoder.h"
 
 // use this symbol to have the first output buffer start with FLAC frame header so a dump of
@@ -45,14 +47,20 @@ protected:
     virtual OMX_ERRORTYPE internalSetParameter(
             OMX_INDEXTYPE index, const OMX_PTR params);
 
+    virtual OMX_ERRORTYPE getExtensionIndex(
+            const char *name, OMX_INDEXTYPE *index);
+
     virtual void onQueueFilled(OMX_U32 portIndex);
+    virtual void onPortFlushCompleted(OMX_U32 portIndex);
 
 private:
+    struct Worker;
 
     enum {
         kNumBuffers = 2,
         kMaxNumSamplesPerFrame = 1152,
         kMaxOutputBufferSize = 65536,    //TODO check if this can be reduced
+        kMaxEncoderThreads = 8,
     };
 
     bool mSignalledError;
@@ -69,10 +77,31 @@ private:
 
     FLAC__StreamEncoder* mFlacStreamEncoder;
 
+    // With more than one thread, each FLAC frame is encoded by the next
+    // worker in turn, and the frames are sent out in the same order.
+    OMX_U32 mNumThreads;
+    Vector<Worker *> mWorkers;
+    unsigned mBlockSize;            // samples per channel in a FLAC frame
+    FLAC__int32* mBlockPcm;         // frame being filled from the input
+    unsigned mBlockNumFrames;
+    OMX_TICKS mBlockTimeUs;
+    unsigned mInputFramesConsumed;  // from the input buffer at the head of the queue
+    uint32_t mNextFrameNumber;
+    size_t mNumBlocksQueued;        // blocks handed to the workers so far
+    size_t mNumBlocksSent;          // encoded blocks sent on the output port
+    bool mSawInputEOS;
+
     void initPorts();
 
     OMX_ERRORTYPE configureEncoder();
 
+    bool startWorkers();
+    void stopWorkers();
+    void onQueueFilledWithWorkers();
+    void queueBlock();
+    bool sendEncodedBlock(bool wait);
+    void drainWorkers();
+
     // FLAC encoder callbacks
     // maps to encoderEncodeFlac()
     static FLAC__StreamEncoderWriteStatus flacEncoderWriteCallback(
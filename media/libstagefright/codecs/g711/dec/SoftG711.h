@@ -49,7 +49,15 @@ private:
     OMX_U32 mNumChannels;
     bool mSignalledError;
 
+    // Linear sample for every possible code word of the configured law.
+    int16_t mDecodeTable[256];
+
     void initPorts();
+    void initDecodeTable();
+
+    static void DecodeWithTable(
+            int16_t *out, const uint8_t *in, size_t inSize,
+            const int16_t *table);
 
     static void DecodeALaw(int16_t *out, const uint8_t *in, size_t inSize);
     static void DecodeMLaw(int16_t *out, const uint8_t *in, size_t inSize);
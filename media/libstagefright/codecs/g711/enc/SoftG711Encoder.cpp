@@ -0,0 +1,371 @@
+/*
+ * Copyright (C) 2012 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "SoftG711Encoder"
+#include <utils/Log.h>
+
+#include "SoftG711Encoder.h"
+
+#include <media/stagefright/foundation/ADebug.h>
+#include <media/stagefright/MediaDefs.h>
+
+namespace android {
+
+template<class T>
+static void InitOMXParams(T *params) {
+    params->nSize = sizeof(T);
+    params->nVersion.s.nVersionMajor = 1;
+    params->nVersion.s.nVersionMinor = 0;
+    params->nVersion.s.nRevision = 0;
+    params->nVersion.s.nStep = 0;
+}
+
+SoftG711Encoder::SoftG711Encoder(
+        const char *name,
+        const OMX_CALLBACKTYPE *callbacks,
+        OMX_PTR appData,
+        OMX_COMPONENTTYPE **component)
+    : SimpleSoftOMXComponent(name, callbacks, appData, component),
+      mIsMLaw(true),
+      mNumChannels(1),
+      mSignalledError(false) {
+    if (!strcmp(name, "OMX.google.g711.alaw.encoder")) {
+        mIsMLaw = false;
+    } else {
+        CHECK(!strcmp(name, "OMX.google.g711.mlaw.encoder"));
+    }
+
+    initPorts();
+}
+
+SoftG711Encoder::~SoftG711Encoder() {
+}
+
+void SoftG711Encoder::initPorts() {
+    OMX_PARAM_PORTDEFINITIONTYPE def;
+    InitOMXParams(&def);
+
+    def.nPortIndex = 0;
+    def.eDir = OMX_DirInput;
+    def.nBufferCountMin = kNumBuffers;
+    def.nBufferCountActual = def.nBufferCountMin;
+    def.nBufferSize = kMaxNumSamplesPerFrame * sizeof(int16_t);
+    def.bEnabled = OMX_TRUE;
+    def.bPopulated = OMX_FALSE;
+    def.eDomain = OMX_PortDomainAudio;
+    def.bBuffersContiguous = OMX_FALSE;
+    def.nBufferAlignment = 2;
+
+    def.format.audio.cMIMEType = const_cast<char *>("audio/raw");
+    def.format.audio.pNativeRender = NULL;
+    def.format.audio.bFlagErrorConcealment = OMX_FALSE;
+    def.format.audio.eEncoding = OMX_AUDIO_CodingPCM;
+
+    addPort(def);
+
+    def.nPortIndex = 1;
+    def.eDir = OMX_DirOutput;
+    def.nBufferCountMin = kNumBuffers;
+    def.nBufferCountActual = def.nBufferCountMin;
+    def.nBufferSize = kMaxNumSamplesPerFrame;
+    def.bEnabled = OMX_TRUE;
+    def.bPopulated = OMX_FALSE;
+    def.eDomain = OMX_PortDomainAudio;
+    def.bBuffersContiguous = OMX_FALSE;
+    def.nBufferAlignment = 1;
+
+    def.format.audio.cMIMEType =
+        const_cast<char *>(
+                mIsMLaw
+                    ? MEDIA_MIMETYPE_AUDIO_G711_MLAW
+                    : MEDIA_MIMETYPE_AUDIO_G711_ALAW);
+
+    def.format.audio.pNativeRender = NULL;
+    def.format.audio.bFlagErrorConcealment = OMX_FALSE;
+    def.format.audio.eEncoding = OMX_AUDIO_CodingG711;
+
+    addPort(def);
+}
+
+OMX_ERRORTYPE SoftG711Encoder::internalGetParameter(
+        OMX_INDEXTYPE index, OMX_PTR params) {
+    switch (index) {
+        case OMX_IndexParamAudioPortFormat:
+        {
+            OMX_AUDIO_PARAM_PORTFORMATTYPE *formatParams =
+                (OMX_AUDIO_PARAM_PORTFORMATTYPE *)params;
+
+            if (formatParams->nPortIndex > 1) {
+                return OMX_ErrorUndefined;
+            }
+
+            if (formatParams->nIndex > 0) {
+                return OMX_ErrorNoMore;
+            }
+
+            formatParams->eEncoding =
+                (formatParams->nPortIndex == 0)
+                    ? OMX_AUDIO_CodingPCM : OMX_AUDIO_CodingG711;
+
+            return OMX_ErrorNone;
+        }
+
+        case OMX_IndexParamAudioPcm:
+        {
+            OMX_AUDIO_PARAM_PCMMODETYPE *pcmParams =
+                (OMX_AUDIO_PARAM_PCMMODETYPE *)params;
+
+            if (pcmParams->nPortIndex > 1) {
+                return OMX_ErrorUndefined;
+            }
+
+            pcmParams->eNumData = OMX_NumericalDataSigned;
+            pcmParams->eEndian = OMX_EndianBig;
+            pcmParams->bInterleaved = OMX_TRUE;
+            pcmParams->eChannelMapping[0] = OMX_AUDIO_ChannelLF;
+            pcmParams->eChannelMapping[1] = OMX_AUDIO_ChannelRF;
+
+            if (pcmParams->nPortIndex == 0) {
+                pcmParams->nBitPerSample = 16;
+                pcmParams->ePCMMode = OMX_AUDIO_PCMModeLinear;
+            } else {
+                // The output port carries one companded byte per sample.
+                pcmParams->nBitPerSample = 8;
+                pcmParams->ePCMMode =
+                    mIsMLaw ? OMX_AUDIO_PCMModeMULaw : OMX_AUDIO_PCMModeALaw;
+            }
+
+            pcmParams->nChannels = mNumChannels;
+            pcmParams->nSamplingRate = kSampleRate;
+
+            return OMX_ErrorNone;
+        }
+
+        default:
+            return SimpleSoftOMXComponent::internalGetParameter(index, params);
+    }
+}
+
+OMX_ERRORTYPE SoftG711Encoder::internalSetParameter(
+        OMX_INDEXTYPE index, const OMX_PTR params) {
+    switch (index) {
+        case OMX_IndexParamStandardComponentRole:
+        {
+            const OMX_PARAM_COMPONENTROLETYPE *roleParams =
+                (const OMX_PARAM_COMPONENTROLETYPE *)params;
+
+            if (strncmp((const char *)roleParams->cRole,
+                        mIsMLaw
+                            ? "audio_encoder.g711mlaw"
+                            : "audio_encoder.g711alaw",
+                        OMX_MAX_STRINGNAME_SIZE - 1)) {
+                return OMX_ErrorUndefined;
+            }
+
+            return OMX_ErrorNone;
+        }
+
+        case OMX_IndexParamAudioPortFormat:
+        {
+            const OMX_AUDIO_PARAM_PORTFORMATTYPE *formatParams =
+                (const OMX_AUDIO_PARAM_PORTFORMATTYPE *)params;
+
+            if (formatParams->nPortIndex > 1) {
+                return OMX_ErrorUndefined;
+            }
+
+            if (formatParams->nIndex > 0) {
+                return OMX_ErrorNoMore;
+            }
+
+            if ((formatParams->nPortIndex == 0
+                        && formatParams->eEncoding != OMX_AUDIO_CodingPCM)
+                || (formatParams->nPortIndex == 1
+                        && formatParams->eEncoding != OMX_AUDIO_CodingG711)) {
+                return OMX_ErrorUndefined;
+            }
+
+            return OMX_ErrorNone;
+        }
+
+        case OMX_IndexParamAudioPcm:
+        {
+            const OMX_AUDIO_PARAM_PCMMODETYPE *pcmParams =
+                (const OMX_AUDIO_PARAM_PCMMODETYPE *)params;
+
+            if (pcmParams->nPortIndex > 1) {
+                return OMX_ErrorUndefined;
+            }
+
+            if (pcmParams->nChannels < 1 || pcmParams->nChannels > 2
+                    || pcmParams->nSamplingRate != kSampleRate) {
+                return OMX_ErrorUndefined;
+            }
+
+            if (pcmParams->nPortIndex == 0) {
+                mNumChannels = pcmParams->nChannels;
+            }
+
+            return OMX_ErrorNone;
+        }
+
+        default:
+            return SimpleSoftOMXComponent::internalSetParameter(index, params);
+    }
+}
+
+void SoftG711Encoder::onQueueFilled(OMX_U32 portIndex) {
+    if (mSignalledError) {
+        return;
+    }
+
+    List<BufferInfo *> &inQueue = getPortQueue(0);
+    List<BufferInfo *> &outQueue = getPortQueue(1);
+
+    while (!inQueue.empty() && !outQueue.empty()) {
+        BufferInfo *inInfo = *inQueue.begin();
+        OMX_BUFFERHEADERTYPE *inHeader = inInfo->mHeader;
+
+        BufferInfo *outInfo = *outQueue.begin();
+        OMX_BUFFERHEADERTYPE *outHeader = outInfo->mHeader;
+
+        // Only whole frames are encoded, so that the output of every
+        // buffer starts with the first channel.
+        size_t frameSize = mNumChannels * sizeof(int16_t);
+        size_t numFrames = inHeader->nFilledLen / frameSize;
+        size_t maxNumFrames =
+            (outHeader->nAllocLen - outHeader->nOffset) / mNumChannels;
+
+        if (numFrames > maxNumFrames) {
+            numFrames = maxNumFrames;
+        }
+
+        size_t numSamples = numFrames * mNumChannels;
+        const int16_t *inputptr = reinterpret_cast<const int16_t *>(
+                inHeader->pBuffer + inHeader->nOffset);
+        uint8_t *outputptr = outHeader->pBuffer + outHeader->nOffset;
+
+        if (mIsMLaw) {
+            EncodeMLaw(outputptr, inputptr, numSamples);
+        } else {
+            EncodeALaw(outputptr, inputptr, numSamples);
+        }
+
+        outHeader->nTimeStamp = inHeader->nTimeStamp;
+        outHeader->nFilledLen = numSamples;
+        outHeader->nFlags = OMX_BUFFERFLAG_ENDOFFRAME;
+
+        inHeader->nOffset += numFrames * frameSize;
+        inHeader->nFilledLen -= numFrames * frameSize;
+
+        // "Time" on the input buffer has in effect advanced by the
+        // number of audio frames we just advanced nOffset by.
+        inHeader->nTimeStamp += numFrames * 1000000ll / kSampleRate;
+
+        if (inHeader->nFilledLen < frameSize) {
+            if (inHeader->nFlags & OMX_BUFFERFLAG_EOS) {
+                ALOGV("saw input EOS");
+                outHeader->nFlags = OMX_BUFFERFLAG_EOS;
+            } else if (inHeader->nFilledLen > 0) {
+                ALOGW("dropping %ld bytes of a partial frame.",
+                      inHeader->nFilledLen);
+            }
+
+            inInfo->mOwnedByUs = false;
+            inQueue.erase(inQueue.begin());
+            inInfo = NULL;
+            notifyEmptyBufferDone(inHeader);
+            inHeader = NULL;
+        }
+
+        outInfo->mOwnedByUs = false;
+        outQueue.erase(outQueue.begin());
+        outInfo = NULL;
+        notifyFillBufferDone(outHeader);
+        outHeader = NULL;
+    }
+}
+
+// The encoders below are the inverse of SoftG711::DecodeALaw() and
+// SoftG711::DecodeMLaw(). Instead of searching the segment table, the
+// segment of a sample is derived from the position of its most
+// significant bit, which takes a single instruction on ARM.
+
+// static
+void SoftG711Encoder::EncodeALaw(
+        uint8_t *out, const int16_t *in, size_t numSamples) {
+    while (numSamples-- > 0) {
+        int32_t x = *in++ >> 3;
+
+        // 0xd5 is the even bit inversion mask with the sign bit set,
+        // which marks positive samples.
+        int32_t mask = 0xd5;
+        if (x < 0) {
+            mask = 0x55;
+            x = -x - 1;
+        }
+
+        // x now is the 12-bit magnitude, 0..4095.
+        int32_t segment = 0;
+        if (x >= 0x20) {
+            segment = (31 - __builtin_clz(x)) - 4;
+        }
+
+        int32_t mantissa =
+            (segment < 2) ? (x >> 1) & 0x0f : (x >> segment) & 0x0f;
+
+        *out++ = ((segment << 4) | mantissa) ^ mask;
+    }
+}
+
+// static
+void SoftG711Encoder::EncodeMLaw(
+        uint8_t *out, const int16_t *in, size_t numSamples) {
+    while (numSamples-- > 0) {
+        int32_t x = *in++ >> 2;
+
+        int32_t sign = 0;
+        if (x < 0) {
+            sign = 0x80;
+            x = -x;
+        }
+
+        // Clip to the largest magnitude that still falls into the last
+        // segment once the bias is added.
+        if (x > 8158) {
+            x = 8158;
+        }
+
+        // Adding the bias of 33 moves the magnitudes of every segment
+        // into a range that starts with a power of two, whose exponent
+        // then is the segment, 0..7.
+        x += 33;
+
+        int32_t exponent = (31 - __builtin_clz(x)) - 5;
+        int32_t mantissa = (x >> (exponent + 1)) & 0x0f;
+
+        *out++ = ~(sign | (exponent << 4) | mantissa);
+    }
+}
+
+}  // namespace android
+
+android::SoftOMXComponent *createSoftOMXComponent(
+        const char *name, const OMX_CALLBACKTYPE *callbacks,
+        OMX_PTR appData, OMX_COMPONENTTYPE **component) {
+    return new android::SoftG711Encoder(name, callbacks, appData, component);
+}
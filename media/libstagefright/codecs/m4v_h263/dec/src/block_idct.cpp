@@ -103,6 +103,10 @@
 #include "idct.h"
 #include "motion_comp.h"
 
+#ifdef __ARM_NEON__
+#include <arm_neon.h>
+#endif
+
 #define OSCL_DISABLE_WARNING_CONV_POSSIBLE_LOSS_OF_DATA
 /*----------------------------------------------------------------------------
 ; MACROS
@@ -123,6 +127,9 @@
 static void idctrow(int16 *blk, uint8 *pred, uint8 *dst, int width);
 static void idctrow_intra(int16 *blk, PIXEL *, int width);
 static void idctcol(int16 *blk);
+#ifdef __ARM_NEON__
+static void idct_neon(int16 *blk, uint8 *pred, uint8 *dst, int width);
+#endif
 
 #ifdef FAST_IDCT
 // mapping from nz_coefs to functions to be used
@@ -256,7 +263,7 @@ void BlockIDCT_intra(
     int16 *coeff_in = mblock->block[comp];
 #ifdef INTEGER_IDCT
 #ifdef FAST_IDCT  /* VCA IDCT using nzcoefs and bitmaps*/
-    int i, bmapr;
+    int bmapr;
     int nz_coefs = mblock->no_coeff[comp];
     uint8 *bitmapcol = mblock->bitmapcol[comp];
     uint8 bitmaprow = mblock->bitmaprow[comp];
@@ -277,7 +284,10 @@ void BlockIDCT_intra(
     }
     else
     {
-        i = 8;
+#ifdef __ARM_NEON__
+        idct_neon(coeff_in, NULL, c_comp, width);
+#else
+        int i = 8;
         while (i--)
         {
             bmapr = (int)bitmapcol[i];
@@ -302,6 +312,7 @@ void BlockIDCT_intra(
         {
             idctrow_intra(coeff_in, c_comp, width);
         }
+#endif
     }
 #else
     void idct_intra(int *block, uint8 *comp, int width);
@@ -357,7 +368,7 @@ void BlockIDCT(
 {
 #ifdef INTEGER_IDCT
 #ifdef FAST_IDCT  /* VCA IDCT using nzcoefs and bitmaps*/
-    int i, bmapr;
+    int bmapr;
     /*----------------------------------------------------------------------------
     ; Function body here
     ----------------------------------------------------------------------------*/
@@ -374,7 +385,11 @@ void BlockIDCT(
     }
     else
     {
-        i = 8;
+#ifdef __ARM_NEON__
+        idct_neon(coeff_in, pred, dst, width);
+        return ;
+#else
+        int i = 8;
 
         while (i--)
         {
@@ -400,6 +415,7 @@ void BlockIDCT(
             idctrow(coeff_in, pred, dst, width);
         }
         return ;
+#endif
     }
 #else // FAST_IDCT
     void idct(int *block, uint8 *pred, uint8 *dst, int width);
@@ -909,3 +925,171 @@ void idctcol(
 ;  End Function: idctcol
 ----------------------------------------------------------------------------*/
 
+#ifdef __ARM_NEON__
+/*----------------------------------------------------------------------------
+; Function Code FOR idct_neon
+;
+; Full 8x8 IDCT of a dense block, the columns with idctcol and then the rows
+; with idctrow or idctrow_intra arithmetic, four columns or rows per vector.
+; The result is the same as the sparse C path for any input, so the caller
+; does not need the bitmaps. pred has a pitch of 16; when pred is NULL the
+; block is intra and the result is written without prediction. The block is
+; cleared afterwards like the C rows do.
+----------------------------------------------------------------------------*/
+static inline void idct_neon_transpose(int16x8_t r[8])
+{
+    int16x8x2_t t0 = vtrnq_s16(r[0], r[1]);
+    int16x8x2_t t1 = vtrnq_s16(r[2], r[3]);
+    int16x8x2_t t2 = vtrnq_s16(r[4], r[5]);
+    int16x8x2_t t3 = vtrnq_s16(r[6], r[7]);
+
+    int32x4x2_t u0 = vtrnq_s32(vreinterpretq_s32_s16(t0.val[0]), vreinterpretq_s32_s16(t1.val[0]));
+    int32x4x2_t u1 = vtrnq_s32(vreinterpretq_s32_s16(t0.val[1]), vreinterpretq_s32_s16(t1.val[1]));
+    int32x4x2_t u2 = vtrnq_s32(vreinterpretq_s32_s16(t2.val[0]), vreinterpretq_s32_s16(t3.val[0]));
+    int32x4x2_t u3 = vtrnq_s32(vreinterpretq_s32_s16(t2.val[1]), vreinterpretq_s32_s16(t3.val[1]));
+
+    r[0] = vreinterpretq_s16_s32(vcombine_s32(vget_low_s32(u0.val[0]), vget_low_s32(u2.val[0])));
+    r[1] = vreinterpretq_s16_s32(vcombine_s32(vget_low_s32(u1.val[0]), vget_low_s32(u3.val[0])));
+    r[2] = vreinterpretq_s16_s32(vcombine_s32(vget_low_s32(u0.val[1]), vget_low_s32(u2.val[1])));
+    r[3] = vreinterpretq_s16_s32(vcombine_s32(vget_low_s32(u1.val[1]), vget_low_s32(u3.val[1])));
+    r[4] = vreinterpretq_s16_s32(vcombine_s32(vget_high_s32(u0.val[0]), vget_high_s32(u2.val[0])));
+    r[5] = vreinterpretq_s16_s32(vcombine_s32(vget_high_s32(u1.val[0]), vget_high_s32(u3.val[0])));
+    r[6] = vreinterpretq_s16_s32(vcombine_s32(vget_high_s32(u0.val[1]), vget_high_s32(u2.val[1])));
+    r[7] = vreinterpretq_s16_s32(vcombine_s32(vget_high_s32(u1.val[1]), vget_high_s32(u3.val[1])));
+}
+
+/* one pass over four columns (col = 1) or four rows (col = 0), x[l] holds the
+   coefficients l of the four vectors and gets the outputs k, not yet shifted */
+static inline void idct_neon_pass(int32x4_t x[8], int col)
+{
+    int32x4_t x0, x1, x2, x3, x4, x5, x6, x7, x8;
+    int32x4_t rnd = vdupq_n_s32(col ? 0 : 4);
+
+    if (col)
+    {
+        x0 = vaddq_s32(vshlq_n_s32(x[0], 11), vdupq_n_s32(128));
+        x1 = vshlq_n_s32(x[4], 11);
+    }
+    else
+    {
+        x0 = vaddq_s32(vshlq_n_s32(x[0], 8), vdupq_n_s32(8192));
+        x1 = vshlq_n_s32(x[4], 8);
+    }
+    x2 = x[6];
+    x3 = x[2];
+    x4 = x[1];
+    x5 = x[7];
+    x6 = x[5];
+    x7 = x[3];
+
+    /* first stage */
+    x8 = vmlaq_n_s32(rnd, vaddq_s32(x4, x5), W7);
+    x4 = vmlaq_n_s32(x8, x4, W1 - W7);
+    x5 = vmlsq_n_s32(x8, x5, W1 + W7);
+    x8 = vmlaq_n_s32(rnd, vaddq_s32(x6, x7), W3);
+    x6 = vmlsq_n_s32(x8, x6, W3 - W5);
+    x7 = vmlsq_n_s32(x8, x7, W3 + W5);
+    if (!col)
+    {
+        x4 = vshrq_n_s32(x4, 3);
+        x5 = vshrq_n_s32(x5, 3);
+        x6 = vshrq_n_s32(x6, 3);
+        x7 = vshrq_n_s32(x7, 3);
+    }
+
+    /* second stage */
+    x8 = vaddq_s32(x0, x1);
+    x0 = vsubq_s32(x0, x1);
+    x1 = vmlaq_n_s32(rnd, vaddq_s32(x3, x2), W6);
+    x2 = vmlsq_n_s32(x1, x2, W2 + W6);
+    x3 = vmlaq_n_s32(x1, x3, W2 - W6);
+    if (!col)
+    {
+        x2 = vshrq_n_s32(x2, 3);
+        x3 = vshrq_n_s32(x3, 3);
+    }
+    x1 = vaddq_s32(x4, x6);
+    x4 = vsubq_s32(x4, x6);
+    x6 = vaddq_s32(x5, x7);
+    x5 = vsubq_s32(x5, x7);
+
+    /* third stage */
+    x7 = vaddq_s32(x8, x3);
+    x8 = vsubq_s32(x8, x3);
+    x3 = vaddq_s32(x0, x2);
+    x0 = vsubq_s32(x0, x2);
+    x2 = vshrq_n_s32(vmlaq_n_s32(vdupq_n_s32(128), vaddq_s32(x4, x5), 181), 8);
+    x4 = vshrq_n_s32(vmlaq_n_s32(vdupq_n_s32(128), vsubq_s32(x4, x5), 181), 8);
+
+    /* fourth stage */
+    x[0] = vaddq_s32(x7, x1);
+    x[1] = vaddq_s32(x3, x2);
+    x[2] = vaddq_s32(x0, x4);
+    x[3] = vaddq_s32(x8, x6);
+    x[4] = vsubq_s32(x8, x6);
+    x[5] = vsubq_s32(x0, x4);
+    x[6] = vsubq_s32(x3, x2);
+    x[7] = vsubq_s32(x7, x1);
+}
+
+static void idct_neon(int16 *blk, uint8 *pred, uint8 *dst, int width)
+{
+    int16x8_t r[8];
+    int32x4_t lo[8], hi[8];
+    int16x8_t zero = vdupq_n_s16(0);
+    int16x8_t pixels;
+    int i;
+
+    for (i = 0; i < 8; i++)
+    {
+        r[i] = vld1q_s16(blk + 8 * i);
+        vst1q_s16(blk + 8 * i, zero);
+    }
+
+    /* columns, the outputs are truncated to 16 bits like in idctcol */
+    for (i = 0; i < 8; i++)
+    {
+        lo[i] = vmovl_s16(vget_low_s16(r[i]));
+        hi[i] = vmovl_s16(vget_high_s16(r[i]));
+    }
+    idct_neon_pass(lo, 1);
+    idct_neon_pass(hi, 1);
+    for (i = 0; i < 8; i++)
+    {
+        r[i] = vcombine_s16(vmovn_s32(vshrq_n_s32(lo[i], 8)),
+                            vmovn_s32(vshrq_n_s32(hi[i], 8)));
+    }
+
+    /* rows */
+    idct_neon_transpose(r);
+    for (i = 0; i < 8; i++)
+    {
+        lo[i] = vmovl_s16(vget_low_s16(r[i]));
+        hi[i] = vmovl_s16(vget_high_s16(r[i]));
+    }
+    idct_neon_pass(lo, 0);
+    idct_neon_pass(hi, 0);
+
+    /* saturating to 16 bits before adding the prediction does not change the
+       clipped 8-bit result */
+    for (i = 0; i < 8; i++)
+    {
+        r[i] = vcombine_s16(vqshrn_n_s32(lo[i], 14), vqshrn_n_s32(hi[i], 14));
+    }
+    idct_neon_transpose(r);
+
+    for (i = 0; i < 8; i++)
+    {
+        pixels = r[i];
+        if (pred)
+        {
+            pixels = vqaddq_s16(pixels,
+                                vreinterpretq_s16_u16(vmovl_u8(vld1_u8(pred))));
+            pred += 16;
+        }
+        vst1_u8(dst, vqmovun_s16(pixels));
+        dst += width;
+    }
+}
+#endif /* __ARM_NEON__ */
+
@@ -77,6 +77,10 @@
 #include "mp4dec_lib.h"
 #include "motion_comp.h"
 
+#ifdef __ARM_NEON__
+#include <arm_neon.h>
+#endif
+
 #define OSCL_DISABLE_WARNING_CONV_POSSIBLE_LOSS_OF_DATA
 
 int GetPredAdvancedBy0x0(
@@ -1187,4 +1191,137 @@ int GetPredAdvancedBy1x1(
     }
 }
 
+#ifdef __ARM_NEON__
+/**************************************************************************/
+/* NEON versions of the functions above, selected by GetPredAdvBTable.    */
+/* They produce the same prediction for any alignment of prev: one row of */
+/* the block is loaded with unaligned loads instead of being assembled    */
+/* from aligned words.                                                    */
+int GetPredAdvancedBy0x0_NEON(
+    uint8 *prev,        /* i */
+    uint8 *pred_block,      /* i */
+    int width,      /* i */
+    int pred_width_rnd /* i */
+)
+{
+    uint    i;      /* loop variable */
+    int pred_width = pred_width_rnd >> 1;
+
+    for (i = B_SIZE; i > 0; i--)
+    {
+        vst1_u8(pred_block, vld1_u8(prev));
+        prev += width;
+        pred_block += pred_width;
+    }
+
+    return 1;
+}
+
+/**************************************************************************/
+int GetPredAdvancedBy0x1_NEON(
+    uint8 *prev,        /* i */
+    uint8 *pred_block,      /* i */
+    int width,      /* i */
+    int pred_width_rnd /* i */
+)
+{
+    uint    i;      /* loop variable */
+    int pred_width = pred_width_rnd >> 1;
+    uint8x8_t left, right;
+
+    if (pred_width_rnd & 1) /* (a + b + 1) >> 1 */
+    {
+        for (i = B_SIZE; i > 0; i--)
+        {
+            left = vld1_u8(prev);
+            right = vld1_u8(prev + 1);
+            vst1_u8(pred_block, vrhadd_u8(left, right));
+            prev += width;
+            pred_block += pred_width;
+        }
+    }
+    else /* (a + b) >> 1 */
+    {
+        for (i = B_SIZE; i > 0; i--)
+        {
+            left = vld1_u8(prev);
+            right = vld1_u8(prev + 1);
+            vst1_u8(pred_block, vhadd_u8(left, right));
+            prev += width;
+            pred_block += pred_width;
+        }
+    }
+
+    return 1;
+}
+
+/**************************************************************************/
+int GetPredAdvancedBy1x0_NEON(
+    uint8 *prev,        /* i */
+    uint8 *pred_block,      /* i */
+    int width,      /* i */
+    int pred_width_rnd /* i */
+)
+{
+    uint    i;      /* loop variable */
+    int pred_width = pred_width_rnd >> 1;
+    uint8x8_t top, bottom;
+
+    /* each source row is loaded once and used for two output rows */
+    top = vld1_u8(prev);
+
+    if (pred_width_rnd & 1) /* (a + b + 1) >> 1 */
+    {
+        for (i = B_SIZE; i > 0; i--)
+        {
+            bottom = vld1_u8(prev += width);
+            vst1_u8(pred_block, vrhadd_u8(top, bottom));
+            top = bottom;
+            pred_block += pred_width;
+        }
+    }
+    else /* (a + b) >> 1 */
+    {
+        for (i = B_SIZE; i > 0; i--)
+        {
+            bottom = vld1_u8(prev += width);
+            vst1_u8(pred_block, vhadd_u8(top, bottom));
+            top = bottom;
+            pred_block += pred_width;
+        }
+    }
+
+    return 1;
+}
+
+/**************************************************************************/
+int GetPredAdvancedBy1x1_NEON(
+    uint8 *prev,        /* i */
+    uint8 *pred_block,      /* i */
+    int width,      /* i */
+    int pred_width_rnd /* i */
+)
+{
+    uint    i;      /* loop variable */
+    int pred_width = pred_width_rnd >> 1;
+    uint16x8_t rnd2, top, bottom;
+
+    /* (a + b + c + d + rnd1 + 1) >> 2 */
+    rnd2 = vdupq_n_u16((pred_width_rnd & 1) + 1);
+
+    /* horizontal sums of each source row are computed once */
+    top = vaddl_u8(vld1_u8(prev), vld1_u8(prev + 1));
+
+    for (i = B_SIZE; i > 0; i--)
+    {
+        prev += width;
+        bottom = vaddl_u8(vld1_u8(prev), vld1_u8(prev + 1));
+        vst1_u8(pred_block, vshrn_n_u16(vaddq_u16(vaddq_u16(top, bottom), rnd2), 2));
+        top = bottom;
+        pred_block += pred_width;
+    }
+
+    return 1;
+}
+#endif /* __ARM_NEON__ */
 
@@ -74,8 +74,13 @@ extern "C"
 
     static int (*const GetPredAdvBTable[2][2])(uint8*, uint8*, int, int) =
     {
+#ifdef __ARM_NEON__
+        {&GetPredAdvancedBy0x0_NEON, &GetPredAdvancedBy0x1_NEON},
+        {&GetPredAdvancedBy1x0_NEON, &GetPredAdvancedBy1x1_NEON}
+#else
         {&GetPredAdvancedBy0x0, &GetPredAdvancedBy0x1},
         {&GetPredAdvancedBy1x0, &GetPredAdvancedBy1x1}
+#endif
     };
 
     /*----------------------------------------------------------------------------
@@ -242,6 +242,36 @@ extern "C"
         int pred_width_rnd /* i */
     );
 
+#ifdef __ARM_NEON__
+    int GetPredAdvancedBy0x0_NEON(
+        uint8 *c_prev,      /* i */
+        uint8 *pred_block,      /* i */
+        int width,      /* i */
+        int pred_width_rnd /* i */
+    );
+
+    int GetPredAdvancedBy0x1_NEON(
+        uint8 *c_prev,      /* i */
+        uint8 *pred_block,      /* i */
+        int width,      /* i */
+        int pred_width_rnd /* i */
+    );
+
+    int GetPredAdvancedBy1x0_NEON(
+        uint8 *c_prev,      /* i */
+        uint8 *pred_block,      /* i */
+        int width,      /* i */
+        int pred_width_rnd /* i */
+    );
+
+    int GetPredAdvancedBy1x1_NEON(
+        uint8 *c_prev,      /* i */
+        uint8 *pred_block,      /* i */
+        int width,      /* i */
+        int pred_width_rnd /* i */
+    );
+#endif
+
     /*--------------------------------------------------------------------------*/
     /* defined in get_pred_outside.c */
     int GetPredOutside(
@@ -31,6 +31,15 @@
 
 namespace android {
 
+// Vendor parameter (OMX_PARAM_U32TYPE) trading encoding speed for quality,
+// with the same values as the one of the AVC encoder. The fast preset halves
+// the search range and turns on the fast mode decision of the encoder.
+static const char *kMotionSearchPresetExtension =
+    "OMX.google.android.index.motionSearchPreset";
+
+static const OMX_INDEXTYPE kIndexParamMotionSearchPreset =
+    (OMX_INDEXTYPE)(OMX_IndexVendorStartUnused + 1);
+
 template<class T>
 static void InitOMXParams(T *params) {
     params->nSize = sizeof(T);
@@ -83,6 +92,7 @@ SoftMPEG4Encoder::SoftMPEG4Encoder(
       mVideoBitRate(192000),
       mVideoColorFormat(OMX_COLOR_FormatYUV420Planar),
       mIDRFrameRefreshIntervalInSec(1),
+      mMotionSearchPreset(kMotionSearchPresetDefault),
       mNumInputFrames(-1),
       mStarted(false),
       mSawInputEOS(false),
@@ -169,7 +179,21 @@ OMX_ERRORTYPE SoftMPEG4Encoder::initEncParams() {
 
     mEncParams->numIntraMB = 0;
     mEncParams->sceneDetect = PV_ON;
-    mEncParams->searchRange = 16;
+    switch (mMotionSearchPreset) {
+        case kMotionSearchPresetFast:
+            mEncParams->searchRange = 8;
+            mEncParams->fastModeDecision = PV_ON;
+            break;
+        case kMotionSearchPresetQuality:
+            // clamped to 16 by the encoder in H.263 mode
+            mEncParams->searchRange = 32;
+            mEncParams->fastModeDecision = PV_OFF;
+            break;
+        default:
+            mEncParams->searchRange = 16;
+            mEncParams->fastModeDecision = PV_OFF;
+            break;
+    }
     mEncParams->mv8x8Enable = PV_OFF;
     mEncParams->gobHeaderInterval = 0;
     mEncParams->useACPred = PV_ON;
@@ -413,6 +437,14 @@ OMX_ERRORTYPE SoftMPEG4Encoder::internalGetParameter(
             return OMX_ErrorNone;
         }
 
+        case kIndexParamMotionSearchPreset:
+        {
+            OMX_PARAM_U32TYPE *presetParams = (OMX_PARAM_U32TYPE *)params;
+
+            presetParams->nU32 = mMotionSearchPreset;
+            return OMX_ErrorNone;
+        }
+
         default:
             return SimpleSoftOMXComponent::internalGetParameter(index, params);
     }
@@ -578,11 +610,35 @@ OMX_ERRORTYPE SoftMPEG4Encoder::internalSetParameter(
             return OMX_ErrorNone;
         }
 
+        // Takes effect when the encoder is next initialized.
+        case kIndexParamMotionSearchPreset:
+        {
+            const OMX_PARAM_U32TYPE *presetParams =
+                (const OMX_PARAM_U32TYPE *)params;
+
+            if (presetParams->nU32 > kMotionSearchPresetQuality) {
+                return OMX_ErrorBadParameter;
+            }
+
+            mMotionSearchPreset = presetParams->nU32;
+            return OMX_ErrorNone;
+        }
+
         default:
             return SimpleSoftOMXComponent::internalSetParameter(index, params);
     }
 }
 
+OMX_ERRORTYPE SoftMPEG4Encoder::getExtensionIndex(
+        const char *name, OMX_INDEXTYPE *index) {
+    if (!strcmp(name, kMotionSearchPresetExtension)) {
+        *index = kIndexParamMotionSearchPreset;
+        return OMX_ErrorNone;
+    }
+
+    return SimpleSoftOMXComponent::getExtensionIndex(name, index);
+}
+
 void SoftMPEG4Encoder::onQueueFilled(OMX_U32 portIndex) {
     if (mSignalledError || mSawInputEOS) {
         return;
@@ -41,6 +41,9 @@ struct SoftMPEG4Encoder : public SimpleSoftOMXComponent {
     virtual OMX_ERRORTYPE internalSetParameter(
             OMX_INDEXTYPE index, const OMX_PTR params);
 
+    virtual OMX_ERRORTYPE getExtensionIndex(
+            const char *name, OMX_INDEXTYPE *index);
+
     virtual void onQueueFilled(OMX_U32 portIndex);
 
 protected:
@@ -51,6 +54,13 @@ private:
         kNumBuffers = 2,
     };
 
+    // Values of the motion search preset, from the fastest to the best
+    enum {
+        kMotionSearchPresetFast = 0,
+        kMotionSearchPresetDefault = 1,
+        kMotionSearchPresetQuality = 2,
+    };
+
     // OMX input buffer's timestamp and flags
     typedef struct {
         int64_t mTimeUs;
@@ -64,6 +74,7 @@ private:
     int32_t  mVideoBitRate;
     int32_t  mVideoColorFormat;
     int32_t  mIDRFrameRefreshIntervalInSec;
+    OMX_U32  mMotionSearchPreset;
 
     int64_t  mNumInputFrames;
     bool     mStarted;
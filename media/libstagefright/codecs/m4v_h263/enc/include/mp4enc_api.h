@@ -234,6 +234,13 @@ typedef struct tagvideoEncOptions
     /** @brief This flag turns on the use of AC prediction */
     Bool                useACPred;
 
+    /** @brief  Turns on/off the fast mode decision. If on, macroblocks of static areas whose zero motion vector SAD
+    *           is too small to leave any luminance coefficient after quantization are coded without motion search,
+    *           and the motion search of the other macroblocks stops refining, including half-pel, below that SAD.
+    *           The threshold follows the quantizer chosen by the rate control for the previous frame.
+    *           It saves most of the motion estimation on static scenes at a small quality cost. The default is off.*/
+    ParamEncMode        fastModeDecision;
+
 } VideoEncOptions;
 
 #ifdef __cplusplus
@@ -157,6 +157,7 @@ void MotionEstimation(VideoEncData *video)
     Int sad8 = 0, sad16 = 0;
     Int totalSAD = 0;   /* average SAD for rate control */
     Int skip_halfpel_4mv;
+    Int skip_mb = 0, skip_th = 0, QP, lx = currVop->pitch;
     Int f_code_p, f_code_n, max_mag = 0, min_mag = 0;
     Int type_pred;
     Int xh[5] = {0, 0, 0, 0, 0};
@@ -227,6 +228,19 @@ void MotionEstimation(VideoEncData *video)
 
     video->sad_extra_info = NULL;
 
+    /* fast mode decision, the QP of this frame is only set after ME, */
+    /* so use the one the rate control chose for the previous frame */
+    video->meEarlyTh = 0;
+    if (video->encParams->FastModeDecision)
+    {
+        QP = currVop->quantizer;
+        if (video->encParams->RC_Type != CONSTANT_Q && video->rc[video->currLayer]->encoded_frames > 0)
+            QP = video->rc[video->currLayer]->Qc;
+
+        /* CodeMB_H263 zeroes an 8x8 block if a quarter of the 1MV SAD is below 16*QP */
+        skip_th = video->meEarlyTh = QP << 6;
+    }
+
 #ifdef HTFM
     /***** HYPOTHESIS TESTING ********/  /* 2/28/01 */
     InitHTFM(video, &htfm_stat, newvar, &collect);
@@ -287,8 +301,29 @@ void MotionEstimation(VideoEncData *video)
 #ifdef _SAD_STAT
                     num_MB++;
 #endif
-                    MBMotionSearch(video, cur, best_cand, i << 4, j << 4, type_pred,
-                                   FS_en, &hp_guess);
+                    skip_mb = 0;
+                    if (skip_th && mot_mb[0].x == 0 && mot_mb[0].y == 0)
+                    {
+                        /* skip MB detection where the previous frame had the zero MV, */
+                        /* the zero MV residue quantizes to zero */
+                        best_cand[0] = video->forwardRefVop->yChan + (i << 4) + (j << 4) * lx;
+                        sad16 = (*video->functionPointer->SAD_Macroblock)(best_cand[0], video->currYMB,
+                                (skip_th << 16) | lx, video->sad_extra_info);
+                        if (sad16 < skip_th)
+                        {
+                            skip_mb = 1;
+                            hp_guess = 0;
+                            mot_mb[0].x = mot_mb[0].y = 0;
+                            mot_mb[7].sad = sad16;
+                            mot_mb[0].sad = sad16 - PREF_NULL_VEC; /* same bias as MBMotionSearch */
+                            for (comp = 1; comp <= 4; comp++)
+                                mot_mb[comp].sad = 65535; /* no 4MV search */
+                        }
+                    }
+
+                    if (!skip_mb)
+                        MBMotionSearch(video, cur, best_cand, i << 4, j << 4, type_pred,
+                                       FS_en, &hp_guess);
 
 #ifdef PRINT_MV
                     fp_debug = fopen("c:\\bitstream\\mv1_debug.txt", "a");
@@ -337,7 +372,11 @@ void MotionEstimation(VideoEncData *video)
                 }
                 else /* *mode_mb = MODE_INTER;*/
                 {
-                    if (video->encParams->HalfPel_Enabled)
+                    if (skip_mb || (skip_th && sad16 < video->meEarlyTh))
+                    {
+                        /* fast mode decision, keep the full-pel MV */
+                    }
+                    else if (video->encParams->HalfPel_Enabled)
                     {
 #ifdef _SAD_STAT
                         num_HP_MB++;
@@ -1005,6 +1044,9 @@ void MBMotionSearch(VideoEncData *video, UChar *cur, UChar *best_cand[],
                 }
                 last_loc = new_loc;
                 step ++;
+
+                if (video->meEarlyTh && dmin < video->meEarlyTh) /* fast mode decision */
+                    break;
             }
             if (!center_again)
                 MoveNeighborSAD(dn, last_loc);
@@ -158,7 +158,7 @@ OSCL_EXPORT_REF Bool PVGetDefaultEncOption(VideoEncOptions *encOption, Int encUs
 {
     VideoEncOptions defaultUseCase = {H263_MODE, profile_level_max_packet_size[SIMPLE_PROFILE_LEVEL0] >> 3,
                                       SIMPLE_PROFILE_LEVEL0, PV_OFF, 0, 1, 1000, 33, {144, 144}, {176, 176}, {15, 30}, {64000, 128000},
-                                      {10, 10}, {12, 12}, {0, 0}, CBR_1, 0.0, PV_OFF, -1, 0, PV_OFF, 16, PV_OFF, 0, PV_ON
+                                      {10, 10}, {12, 12}, {0, 0}, CBR_1, 0.0, PV_OFF, -1, 0, PV_OFF, 16, PV_OFF, 0, PV_ON, PV_OFF
                                      };
 
     OSCL_UNUSED_ARG(encUseCase); // unused for now. Later we can add more defaults setting and use this
@@ -331,6 +331,7 @@ OSCL_EXPORT_REF Bool    PVInitVideoEncoder(VideoEncControls *encoderControl, Vid
     encParams->HalfPel_Enabled = 1;
     encParams->SearchRange = encOption->searchRange; /* 4/16/2001 */
     encParams->FullSearch_Enabled = 0;
+    encParams->FastModeDecision = ((encOption->fastModeDecision == PV_ON) ? TRUE : FALSE);
 #ifdef NO_INTER4V
     encParams->MV8x8_Enabled = 0;
 #else
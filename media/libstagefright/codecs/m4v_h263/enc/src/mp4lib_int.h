@@ -216,6 +216,7 @@ typedef struct tagVideoEncParams
     Bool    SequenceStartCode;      /* This probably should be removed */
     Bool    FullSearch_Enabled;     /* full-pel exhaustive search motion estimation */
     Bool    HalfPel_Enabled;        /* Turn Halfpel ME on or off */
+    Bool    FastModeDecision;       /* QP driven skip MB detection and early termination of ME */
     Bool    MV8x8_Enabled;          /* Enable 8x8 motion vectors */
     Bool    RD_opt_Enabled;         /* Enable operational R-D optimization */
     Int     GOB_Header_Interval;        /* Enable encoding GOB header in H263_WITH_ERR_RES and SHORT_HERDER_WITH_ERR_RES */
@@ -358,6 +359,7 @@ typedef struct tagVideoEncData
 
     /* to speedup the SAD calculation */
     void *sad_extra_info;
+    Int     meEarlyTh;          /* SAD under which ME stops refining, 0 if FastModeDecision is off */
 #ifdef HTFM
     Int nrmlz_th[48];       /* Threshold for fast SAD calculation using HTFM */
     HTFM_Stat htfm_stat;    /* For statistics collection */
@@ -30,10 +30,21 @@ LOCAL_SRC_FILES := \
 
 ifeq ($(TARGET_ARCH),arm)
 LOCAL_SRC_FILES += \
-	src/asm/pvmp3_polyphase_filter_window_gcc.s \
  	src/asm/pvmp3_mdct_18_gcc.s \
  	src/asm/pvmp3_dct_9_gcc.s \
 	src/asm/pvmp3_dct_16_gcc.s
+
+# the synthesis window has a NEON implementation in C, the ARMv5 assembly
+# version is used otherwise
+ifeq ($(ARCH_ARM_HAVE_NEON),true)
+LOCAL_SRC_FILES += \
+ 	src/pvmp3_polyphase_filter_window.cpp
+
+LOCAL_ARM_NEON := true
+else
+LOCAL_SRC_FILES += \
+	src/asm/pvmp3_polyphase_filter_window_gcc.s
+endif
 else
 LOCAL_SRC_FILES += \
  	src/pvmp3_polyphase_filter_window.cpp \
@@ -79,3 +90,23 @@ LOCAL_MODULE := libstagefright_soft_mp3dec
 LOCAL_MODULE_TAGS := optional
 
 include $(BUILD_SHARED_LIBRARY)
+
+################################################################################
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES := \
+        test/mp3dec_bench.cpp
+
+LOCAL_C_INCLUDES := \
+        $(LOCAL_PATH)/include
+
+LOCAL_STATIC_LIBRARIES := \
+        libstagefright_mp3dec
+
+LOCAL_MODULE := mp3dec_bench
+LOCAL_MODULE_TAGS := debug
+
+LOCAL_ARM_MODE := arm
+
+include $(BUILD_EXECUTABLE)
@@ -192,9 +192,12 @@ void SoftMP3::onQueueFilled(OMX_U32 portIndex) {
             notifyEmptyBufferDone(inHeader);
 
             // pad the end of the stream with 529 samples, since that many samples
-            // were trimmed off the beginning when decoding started
-            outHeader->nFilledLen = kPVMP3DecoderDelay * mNumChannels * sizeof(int16_t);
-            memset(outHeader->pBuffer, 0, outHeader->nFilledLen);
+            // were trimmed off the beginning when decoding started, after the
+            // frames already batched into this buffer if any
+            size_t padding = kPVMP3DecoderDelay * mNumChannels * sizeof(int16_t);
+            memset(outHeader->pBuffer + outHeader->nOffset + outHeader->nFilledLen,
+                   0, padding);
+            outHeader->nFilledLen += padding;
             outHeader->nFlags = OMX_BUFFERFLAG_EOS;
 
             outQueue.erase(outQueue.begin());
@@ -217,8 +220,11 @@ void SoftMP3::onQueueFilled(OMX_U32 portIndex) {
 
         mConfig->outputFrameSize = kOutputBufferSize / sizeof(int16_t);
 
-        mConfig->pOutputBuffer =
-            reinterpret_cast<int16_t *>(outHeader->pBuffer);
+        // in batch mode, append after the frames already in the buffer
+        uint8_t *outPtr =
+            outHeader->pBuffer + outHeader->nOffset + outHeader->nFilledLen;
+
+        mConfig->pOutputBuffer = reinterpret_cast<int16_t *>(outPtr);
 
         ERROR_CODE decoderErr;
         if ((decoderErr = pvmp3_framedecoder(mConfig, mDecoderBuf))
@@ -240,9 +246,7 @@ void SoftMP3::onQueueFilled(OMX_U32 portIndex) {
 
             // This is recoverable, just ignore the current frame and
             // play silence instead.
-            memset(outHeader->pBuffer,
-                   0,
-                   mConfig->outputFrameSize * sizeof(int16_t));
+            memset(outPtr, 0, mConfig->outputFrameSize * sizeof(int16_t));
 
             mConfig->inputBufferUsedLength = inHeader->nFilledLen;
         } else if (mConfig->samplingRate != mSamplingRate
@@ -255,24 +259,27 @@ void SoftMP3::onQueueFilled(OMX_U32 portIndex) {
             return;
         }
 
+        if (outHeader->nFilledLen == 0) {
+            outHeader->nTimeStamp =
+                mAnchorTimeUs
+                    + (mNumFramesOutput * 1000000ll) / mConfig->samplingRate;
+
+            outHeader->nFlags = 0;
+        }
+
         if (mIsFirst) {
             mIsFirst = false;
             // The decoder delay is 529 samples, so trim that many samples off
             // the start of the first output buffer. This essentially makes this
             // decoder have zero delay, which the rest of the pipeline assumes.
+            // Flushing the input drops the batched frames, so this is always
+            // the first frame of the output buffer.
             outHeader->nOffset = kPVMP3DecoderDelay * mNumChannels * sizeof(int16_t);
             outHeader->nFilledLen = mConfig->outputFrameSize * sizeof(int16_t) - outHeader->nOffset;
         } else {
-            outHeader->nOffset = 0;
-            outHeader->nFilledLen = mConfig->outputFrameSize * sizeof(int16_t);
+            outHeader->nFilledLen += mConfig->outputFrameSize * sizeof(int16_t);
         }
 
-        outHeader->nTimeStamp =
-            mAnchorTimeUs
-                + (mNumFramesOutput * 1000000ll) / mConfig->samplingRate;
-
-        outHeader->nFlags = 0;
-
         CHECK_GE(inHeader->nFilledLen, mConfig->inputBufferUsedLength);
 
         inHeader->nOffset += mConfig->inputBufferUsedLength;
@@ -288,6 +295,10 @@ void SoftMP3::onQueueFilled(OMX_U32 portIndex) {
             inHeader = NULL;
         }
 
+        if (keepOutputBuffer(outHeader, kOutputBufferSize)) {
+            continue;
+        }
+
         outInfo->mOwnedByUs = false;
         outQueue.erase(outQueue.begin());
         outInfo = NULL;
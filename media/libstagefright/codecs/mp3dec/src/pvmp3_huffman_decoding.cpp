@@ -134,38 +134,36 @@ void pvmp3_huffman_quad_decoding(struct huffcodetab *h,
 
     if (y)
     {
+        /*
+         *  The sign bits of the non zero values follow the codeword in v, w, x, y
+         *  order, fetch them all at once and consume them from the last one.
+         */
+        int32 nsign = (y & 1) + ((y >> 1) & 1) + ((y >> 2) & 1) + (y >> 3);
+        int32 sign = getUpTo9bits(pMainData, nsign);
+
         v = (y >> 3);
+        w = (y >> 2) & 1;
+        x = (y >> 1) & 1;
+        y =  y & 1;
 
-        if (v)
+        if (y)
         {
-            if (get1bit(pMainData))
-            {
-                v = -v;
-            }
+            y = (sign & 1) ? -y : y;
+            sign >>= 1;
         }
-        w = (y >> 2) & 1;
-        if (w)
+        if (x)
         {
-            if (get1bit(pMainData))
-            {
-                w = -w;
-            }
+            x = (sign & 1) ? -x : x;
+            sign >>= 1;
         }
-        x = (y >> 1) & 1;
-        if (x)
+        if (w)
         {
-            if (get1bit(pMainData))
-            {
-                x = -x;
-            }
+            w = (sign & 1) ? -w : w;
+            sign >>= 1;
         }
-        y =  y & 1;
-        if (y)
+        if (v)
         {
-            if (get1bit(pMainData))
-            {
-                y = -y;
-            }
+            v = (sign & 1) ? -v : v;
         }
 
     }
@@ -202,27 +200,25 @@ void pvmp3_huffman_pair_decoding(struct huffcodetab *h,     /* pointer to huffma
     if (cw)
     {
         x = cw >> 4;
+        y = cw & 0xf;
 
-        if (x)
+        /* one sign bit per non zero value, x first, read at once */
+        if (x && y)
         {
-            if (get1bit(pMainData))
+            int32 sign = getUpTo9bits(pMainData, 2);
+            if (sign & 2)
             {
                 x = -x;
             }
-            y = cw & 0xf;
-            if (y && get1bit(pMainData))
+            if (sign & 1)
             {
                 y = -y;
             }
-
         }
-        else
+        else if (get1bit(pMainData))
         {
-            y = cw & 0xf;
-            if (get1bit(pMainData))
-            {
-                y = -y;
-            }
+            x = -x;
+            y = -y;
         }
 
         *is     = x;
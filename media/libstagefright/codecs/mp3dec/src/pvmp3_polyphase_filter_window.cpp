@@ -76,6 +76,10 @@ Input
 #include "pvmp3_dec_defs.h"
 #include "pvmp3_tables.h"
 
+#ifdef __ARM_NEON__
+#include <arm_neon.h>
+#endif
+
 /*----------------------------------------------------------------------------
 ; MACROS
 ; Define module1 specific macros here
@@ -94,6 +98,25 @@ Input
 ; Function Prototype declaration
 ----------------------------------------------------------------------------*/
 
+#ifdef __ARM_NEON__
+
+/*
+ *  Lane wise fxp_mul32_Q32(): (2*a*b)>>32 followed by >>1 is exactly (a*b)>>32,
+ *  vqdmulh only saturates for a = b = 0x80000000, which the window never holds.
+ */
+static inline int32x4_t fxp_mul32_Q32_neon(int32x4_t a, int32x4_t b)
+{
+    return vshrq_n_s32(vqdmulhq_s32(a, b), 1);
+}
+
+static inline int32x4_t reverse_neon(int32x4_t a)
+{
+    a = vrev64q_s32(a);
+    return vcombine_s32(vget_high_s32(a), vget_low_s32(a));
+}
+
+#endif
+
 /*----------------------------------------------------------------------------
 ; LOCAL STORE/BUFFER/POINTER DEFINITIONS
 ; Variable declaration - defined here and used outside this module1
@@ -122,6 +145,64 @@ void pvmp3_polyphase_filter_window(int32 *synth_buffer,
     int32 i;
 
 
+#ifdef __ARM_NEON__
+
+    /*
+     *  Output samples j and 32-j of 4 consecutive j are computed at once, pt_1[]
+     *  of those j are contiguous in synth_buffer, pt_2[] are contiguous but in
+     *  reverse order. Truncating each product before accumulating keeps the
+     *  result bit exact with the C implementation below.
+     */
+    const int32 *winNeon = &pqmfSynthWinNeon[0][0];
+
+    for (int32 j = 1; j < SUBBANDS_NUMBER / 2; j += 4)
+    {
+        int32x4_t vsum1 = vdupq_n_s32(0x00000020);
+        int32x4_t vsum2 = vdupq_n_s32(0x00000020);
+        const int32 *pt_1 = &synth_buffer[(SUBBANDS_NUMBER >> 1) + j];
+        const int32 *pt_2 = &synth_buffer[(SUBBANDS_NUMBER >> 1) - j - 3];
+
+        for (i = 0; i < 4; i++)
+        {
+            int32x4_t temp1 = vld1q_s32(&pt_1[SUBBANDS_NUMBER*(2*i)]);
+            int32x4_t temp3 = reverse_neon(vld1q_s32(&pt_2[SUBBANDS_NUMBER*(15 - 2*i)]));
+            int32x4_t temp2 = reverse_neon(vld1q_s32(&pt_2[SUBBANDS_NUMBER*(2*i + 1)]));
+            int32x4_t temp4 = vld1q_s32(&pt_1[SUBBANDS_NUMBER*(14 - 2*i)]);
+            int32x4_t win0 = vld1q_s32(&winNeon[ 0]);
+            int32x4_t win1 = vld1q_s32(&winNeon[ 4]);
+            int32x4_t win2 = vld1q_s32(&winNeon[ 8]);
+            int32x4_t win3 = vld1q_s32(&winNeon[12]);
+
+            vsum1 = vaddq_s32(vsum1, fxp_mul32_Q32_neon(temp1, win0));
+            vsum2 = vaddq_s32(vsum2, fxp_mul32_Q32_neon(temp3, win0));
+            vsum2 = vaddq_s32(vsum2, fxp_mul32_Q32_neon(temp1, win1));
+            vsum1 = vsubq_s32(vsum1, fxp_mul32_Q32_neon(temp3, win1));
+            vsum1 = vaddq_s32(vsum1, fxp_mul32_Q32_neon(temp2, win2));
+            vsum2 = vsubq_s32(vsum2, fxp_mul32_Q32_neon(temp4, win2));
+            vsum2 = vaddq_s32(vsum2, fxp_mul32_Q32_neon(temp2, win3));
+            vsum1 = vaddq_s32(vsum1, fxp_mul32_Q32_neon(temp4, win3));
+
+            winNeon += 16;
+        }
+
+        int16 pcm1[4];
+        int16 pcm2[4];
+        vst1_s16(pcm1, vqshrn_n_s32(vsum1, 6));
+        vst1_s16(pcm2, vqshrn_n_s32(vsum2, 6));
+
+        for (i = 0; i < 4 && j + i < SUBBANDS_NUMBER / 2; i++)
+        {
+            int32 k = (j + i) << (numChannels - 1);
+            outPcm[k] = pcm1[i];
+            outPcm[(numChannels<<5) - k] = pcm2[i];
+        }
+    }
+
+    /* the central samples use the coefficients that follow those of j = 1..15 */
+    winPtr += 16 * (SUBBANDS_NUMBER / 2 - 1);
+
+#else
+
     for (int16 j = 1; j < SUBBANDS_NUMBER / 2; j++)
     {
         sum1 = 0x00000020;
@@ -200,6 +281,8 @@ void pvmp3_polyphase_filter_window(int32 *synth_buffer,
         outPcm[(numChannels<<5) - k] = saturate16(sum2 >> 6);
     }
 
+#endif
+
 
 
     sum1 = 0x00000020;
@@ -0,0 +1,252 @@
+/*
+ * Copyright (C) 2012 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Decodes an MP3 file with libstagefright_mp3dec the way SoftMP3 does, one
+// frame per call, and reports the decoder load in MCPS (millions of CPU
+// cycles per second of audio). The decoded PCM can be written out to check
+// that optimizations of the decoder are bit exact.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "pvmp3decoder_api.h"
+
+static const size_t kMaxFrameSize = 4608 * 2;
+
+static void usage(const char *me) {
+    fprintf(stderr,
+            "usage: %s [-m cpu MHz] [-n loops] [-o output.pcm] input.mp3\n"
+            "  -m  clock used to convert CPU time to MCPS, defaults to\n"
+            "      cpuinfo_max_freq of cpu0\n"
+            "  -n  number of times the stream is decoded (default 1)\n"
+            "  -o  write the decoded 16-bit PCM of the first loop\n",
+            me);
+}
+
+// Returns the size in bytes of the MPEG audio layer III frame starting at
+// |header| and its number of samples per channel, or 0 if it is not one.
+static size_t parseFrameHeader(const uint8_t *header, int *samples) {
+    static const int kBitrateV1[15] = {
+        0, 32, 40, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320
+    };
+    static const int kBitrateV2[15] = {
+        0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160
+    };
+    static const int kSamplingRateV1[3] = { 44100, 48000, 32000 };
+
+    if (header[0] != 0xff || (header[1] & 0xe0) != 0xe0) {
+        return 0;
+    }
+
+    int version = (header[1] >> 3) & 3;     // 3: MPEG 1, 2: MPEG 2, 0: MPEG 2.5
+    int layer = (header[1] >> 1) & 3;       // 1: layer III
+    int bitrateIndex = header[2] >> 4;
+    int samplingRateIndex = (header[2] >> 2) & 3;
+    int padding = (header[2] >> 1) & 1;
+
+    if (version == 1 || layer != 1 || bitrateIndex == 0 || bitrateIndex == 15
+            || samplingRateIndex == 3) {
+        return 0;
+    }
+
+    int samplingRate = kSamplingRateV1[samplingRateIndex];
+    if (version == 3) {
+        *samples = 1152;
+        return 144000 * kBitrateV1[bitrateIndex] / samplingRate + padding;
+    }
+
+    samplingRate >>= (version == 2) ? 1 : 2;
+    *samples = 576;
+    return 72000 * kBitrateV2[bitrateIndex] / samplingRate + padding;
+}
+
+// Skips an ID3v2 tag at the start of the file, if any.
+static size_t skipID3(const uint8_t *data, size_t size) {
+    if (size < 10 || memcmp(data, "ID3", 3)) {
+        return 0;
+    }
+    size_t len = ((data[6] & 0x7f) << 21) | ((data[7] & 0x7f) << 14)
+            | ((data[8] & 0x7f) << 7) | (data[9] & 0x7f);
+    len += 10;
+    return len < size ? len : size;
+}
+
+static int getCpuMHz() {
+    FILE *f = fopen("/sys/devices/system/cpu/cpu0/cpufreq/cpuinfo_max_freq", "r");
+    if (f == NULL) {
+        return 0;
+    }
+    int kHz = 0;
+    if (fscanf(f, "%d", &kHz) != 1) {
+        kHz = 0;
+    }
+    fclose(f);
+    return kHz / 1000;
+}
+
+static double cpuTime() {
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+int main(int argc, char **argv) {
+    int mhz = 0;
+    int loops = 1;
+    const char *outPath = NULL;
+
+    int res;
+    while ((res = getopt(argc, argv, "m:n:o:h")) >= 0) {
+        switch (res) {
+            case 'm':
+                mhz = atoi(optarg);
+                break;
+            case 'n':
+                loops = atoi(optarg);
+                break;
+            case 'o':
+                outPath = optarg;
+                break;
+            default:
+                usage(argv[0]);
+                return 1;
+        }
+    }
+
+    if (optind + 1 != argc || loops < 1) {
+        usage(argv[0]);
+        return 1;
+    }
+    if (mhz <= 0) {
+        mhz = getCpuMHz();
+    }
+
+    FILE *in = fopen(argv[optind], "rb");
+    if (in == NULL) {
+        fprintf(stderr, "unable to open %s\n", argv[optind]);
+        return 1;
+    }
+    fseek(in, 0, SEEK_END);
+    size_t size = ftell(in);
+    fseek(in, 0, SEEK_SET);
+    uint8_t *data = (uint8_t *)malloc(size);
+    if (data == NULL || fread(data, 1, size, in) != size) {
+        fprintf(stderr, "unable to read %s\n", argv[optind]);
+        fclose(in);
+        free(data);
+        return 1;
+    }
+    fclose(in);
+
+    FILE *out = NULL;
+    if (outPath != NULL) {
+        out = fopen(outPath, "wb");
+        if (out == NULL) {
+            fprintf(stderr, "unable to open %s\n", outPath);
+            free(data);
+            return 1;
+        }
+    }
+
+    tPVMP3DecoderExternal config;
+    memset(&config, 0, sizeof(config));
+    config.equalizerType = flat;
+    config.crcEnabled = false;
+
+    void *decoderBuf = malloc(pvmp3_decoderMemRequirements());
+    int16_t *pcm = (int16_t *)malloc(kMaxFrameSize);
+
+    size_t start = skipID3(data, size);
+    long frames = 0;
+    long errors = 0;
+    double audioSeconds = 0;
+    double cpuSeconds = 0;
+
+    for (int loop = 0; loop < loops; loop++) {
+        pvmp3_InitDecoder(&config, decoderBuf);
+
+        size_t offset = start;
+        while (offset + 4 <= size) {
+            int samples;
+            size_t frameSize = parseFrameHeader(data + offset, &samples);
+            if (frameSize == 0) {
+                // resync on the next byte, like MP3Extractor does
+                offset++;
+                continue;
+            }
+            if (offset + frameSize > size) {
+                break;
+            }
+
+            config.pInputBuffer = data + offset;
+            config.inputBufferCurrentLength = frameSize;
+            config.inputBufferUsedLength = 0;
+            config.outputFrameSize = kMaxFrameSize / sizeof(int16_t);
+            config.pOutputBuffer = pcm;
+
+            double t = cpuTime();
+            ERROR_CODE err = pvmp3_framedecoder(&config, decoderBuf);
+            cpuSeconds += cpuTime() - t;
+
+            if (err != NO_DECODING_ERROR) {
+                // as in SoftMP3, the frame is replaced with silence
+                errors++;
+                if (config.outputFrameSize == 0) {
+                    config.outputFrameSize = kMaxFrameSize / sizeof(int16_t);
+                }
+                memset(pcm, 0, config.outputFrameSize * sizeof(int16_t));
+            }
+
+            if (out != NULL && loop == 0) {
+                fwrite(pcm, sizeof(int16_t), config.outputFrameSize, out);
+            }
+            if (config.samplingRate > 0) {
+                audioSeconds += (double)samples / config.samplingRate;
+            }
+            frames++;
+            offset += frameSize;
+        }
+    }
+
+    if (out != NULL) {
+        fclose(out);
+    }
+    free(pcm);
+    free(decoderBuf);
+    free(data);
+
+    if (frames == 0 || audioSeconds == 0) {
+        fprintf(stderr, "no MPEG audio layer III frames found\n");
+        return 1;
+    }
+
+    printf("frames:     %ld (%ld errors)\n", frames, errors);
+    printf("channels:   %d, %d Hz\n", (int)config.num_channels, (int)config.samplingRate);
+    printf("audio:      %.3f s\n", audioSeconds);
+    printf("cpu:        %.3f s (%.1fx realtime)\n", cpuSeconds,
+            cpuSeconds > 0 ? audioSeconds / cpuSeconds : 0);
+    if (mhz > 0) {
+        printf("load:       %.2f MCPS at %d MHz\n", cpuSeconds / audioSeconds * mhz, mhz);
+    } else {
+        printf("load:       unknown cpu clock, use -m to report MCPS\n");
+    }
+
+    return 0;
+}
@@ -29,6 +29,17 @@
 
 namespace android {
 
+// Vendor parameter (OMX_PARAM_U32TYPE) selecting the number of threads the
+// VP8 decoder splits the macroblock rows of each frame among. It can only be
+// changed before any data was decoded, in the loaded state.
+static const char *kDecoderThreadsExtension =
+    "OMX.google.android.index.decoderThreads";
+
+static const OMX_INDEXTYPE kIndexParamDecoderThreads =
+    (OMX_INDEXTYPE)(OMX_IndexVendorStartUnused + 1);
+
+static const OMX_U32 kMaxDecoderThreads = 8;
+
 template<class T>
 static void InitOMXParams(T *params) {
     params->nSize = sizeof(T);
@@ -45,6 +56,7 @@ SoftVPX::SoftVPX(
         OMX_COMPONENTTYPE **component)
     : SimpleSoftOMXComponent(name, callbacks, appData, component),
       mCtx(NULL),
+      mNumThreads(0),
       mWidth(320),
       mHeight(240),
       mOutputPortSettingsChange(NONE) {
@@ -131,17 +143,31 @@ static int GetCPUCoreCount() {
 }
 
 status_t SoftVPX::initDecoder() {
-    mCtx = new vpx_codec_ctx_t;
+    if (mNumThreads == 0) {
+        mNumThreads = GetCPUCoreCount();
+        if (mNumThreads > kMaxDecoderThreads) {
+            mNumThreads = kMaxDecoderThreads;
+        }
+    }
+
+    if (mCtx == NULL) {
+        mCtx = new vpx_codec_ctx_t;
+    } else {
+        vpx_codec_destroy((vpx_codec_ctx_t *)mCtx);
+    }
+
     vpx_codec_err_t vpx_err;
     vpx_codec_dec_cfg_t cfg;
     memset(&cfg, 0, sizeof(vpx_codec_dec_cfg_t));
-    cfg.threads = GetCPUCoreCount();
+    cfg.threads = mNumThreads;
     if ((vpx_err = vpx_codec_dec_init(
                 (vpx_codec_ctx_t *)mCtx, &vpx_codec_vp8_dx_algo, &cfg, 0))) {
         ALOGE("on2 decoder failed to initialize. (%d)", vpx_err);
         return UNKNOWN_ERROR;
     }
 
+    ALOGV("decoding with %lu threads", mNumThreads);
+
     return OK;
 }
 
@@ -176,6 +202,14 @@ OMX_ERRORTYPE SoftVPX::internalGetParameter(
             return OMX_ErrorNone;
         }
 
+        case kIndexParamDecoderThreads:
+        {
+            OMX_PARAM_U32TYPE *threadParams = (OMX_PARAM_U32TYPE *)params;
+
+            threadParams->nU32 = mNumThreads;
+            return OMX_ErrorNone;
+        }
+
         default:
             return SimpleSoftOMXComponent::internalGetParameter(index, params);
     }
@@ -214,11 +248,44 @@ OMX_ERRORTYPE SoftVPX::internalSetParameter(
             return OMX_ErrorNone;
         }
 
+        case kIndexParamDecoderThreads:
+        {
+            const OMX_PARAM_U32TYPE *threadParams =
+                (const OMX_PARAM_U32TYPE *)params;
+
+            if (threadParams->nU32 < 1
+                    || threadParams->nU32 > kMaxDecoderThreads) {
+                return OMX_ErrorBadParameter;
+            }
+
+            if (threadParams->nU32 == mNumThreads) {
+                return OMX_ErrorNone;
+            }
+
+            // libvpx only reads the thread count when it is initialized
+            mNumThreads = threadParams->nU32;
+            if (initDecoder() != OK) {
+                return OMX_ErrorInsufficientResources;
+            }
+
+            return OMX_ErrorNone;
+        }
+
         default:
             return SimpleSoftOMXComponent::internalSetParameter(index, params);
     }
 }
 
+OMX_ERRORTYPE SoftVPX::getExtensionIndex(
+        const char *name, OMX_INDEXTYPE *index) {
+    if (!strcmp(name, kDecoderThreadsExtension)) {
+        *index = kIndexParamDecoderThreads;
+        return OMX_ErrorNone;
+    }
+
+    return SimpleSoftOMXComponent::getExtensionIndex(name, index);
+}
+
 void SoftVPX::onQueueFilled(OMX_U32 portIndex) {
     if (mOutputPortSettingsChange != NONE) {
         return;
@@ -37,6 +37,9 @@ protected:
     virtual OMX_ERRORTYPE internalSetParameter(
             OMX_INDEXTYPE index, const OMX_PTR params);
 
+    virtual OMX_ERRORTYPE getExtensionIndex(
+            const char *name, OMX_INDEXTYPE *index);
+
     virtual void onQueueFilled(OMX_U32 portIndex);
     virtual void onPortFlushCompleted(OMX_U32 portIndex);
     virtual void onPortEnableCompleted(OMX_U32 portIndex, bool enabled);
@@ -48,6 +51,10 @@ private:
 
     void *mCtx;
 
+    // threads sharing the macroblock rows of each frame, 0 until the
+    // decoder is first initialized with the default for this device
+    OMX_U32 mNumThreads;
+
     int32_t mWidth;
     int32_t mHeight;
 
@@ -25,6 +25,7 @@
 #include <media/stagefright/MediaErrors.h>
 #include <media/IOMX.h>
 
+#include <unistd.h>
 
 namespace android {
 
@@ -47,6 +48,30 @@ static const CodecProfileLevel kProfileLevels[] = {
     { OMX_VIDEO_AVCProfileBaseline, OMX_VIDEO_AVCLevel51 },
 };
 
+// Vendor parameter (OMX_PARAM_U32TYPE) selecting the number of threads that
+// share the deblocking of each picture. The decoded pictures don't depend
+// on it, only the decoding speed does.
+static const char *kDeblockingThreadsExtension =
+    "OMX.google.android.index.deblockingThreads";
+
+static const OMX_INDEXTYPE kIndexParamDeblockingThreads =
+    (OMX_INDEXTYPE)(OMX_IndexVendorStartUnused + 1);
+
+static const OMX_U32 kMaxDeblockingThreads = 8;
+
+static int GetCPUCoreCount() {
+    int cpuCoreCount = 1;
+#if defined(_SC_NPROCESSORS_ONLN)
+    cpuCoreCount = sysconf(_SC_NPROCESSORS_ONLN);
+#else
+    // _SC_NPROC_ONLN must be defined...
+    cpuCoreCount = sysconf(_SC_NPROC_ONLN);
+#endif
+    CHECK(cpuCoreCount >= 1);
+    ALOGV("Number of CPU cores: %d", cpuCoreCount);
+    return cpuCoreCount;
+}
+
 template<class T>
 static void InitOMXParams(T *params) {
     params->nSize = sizeof(T);
@@ -77,7 +102,12 @@ SoftAVC::SoftAVC(
       mHeadersDecoded(false),
       mEOSStatus(INPUT_DATA_AVAILABLE),
       mOutputPortSettingsChange(NONE),
-      mSignalledError(false) {
+      mSignalledError(false),
+      mNumDeblockingThreads(GetCPUCoreCount()) {
+    if (mNumDeblockingThreads > kMaxDeblockingThreads) {
+        mNumDeblockingThreads = kMaxDeblockingThreads;
+    }
+
     initPorts();
     CHECK_EQ(initDecoder(), (status_t)OK);
 }
@@ -161,10 +191,18 @@ void SoftAVC::initPorts() {
 
 status_t SoftAVC::initDecoder() {
     // Force decoder to output buffers in display order.
-    if (H264SwDecInit(&mHandle, 0) == H264SWDEC_OK) {
-        return OK;
+    if (H264SwDecInit(&mHandle, 0) != H264SWDEC_OK) {
+        return UNKNOWN_ERROR;
     }
-    return UNKNOWN_ERROR;
+
+    if (H264SwDecSetDeblockingThreads(mHandle, mNumDeblockingThreads)
+            != H264SWDEC_OK) {
+        // Not fatal, pictures are then filtered on the decoding thread.
+        ALOGW("Unable to start %lu deblocking threads", mNumDeblockingThreads);
+        mNumDeblockingThreads = 1;
+    }
+
+    return OK;
 }
 
 OMX_ERRORTYPE SoftAVC::internalGetParameter(
@@ -220,6 +258,14 @@ OMX_ERRORTYPE SoftAVC::internalGetParameter(
             return OMX_ErrorNone;
         }
 
+        case kIndexParamDeblockingThreads:
+        {
+            OMX_PARAM_U32TYPE *threadParams = (OMX_PARAM_U32TYPE *)params;
+
+            threadParams->nU32 = mNumDeblockingThreads;
+            return OMX_ErrorNone;
+        }
+
         default:
             return SimpleSoftOMXComponent::internalGetParameter(index, params);
     }
@@ -258,11 +304,42 @@ OMX_ERRORTYPE SoftAVC::internalSetParameter(
             return OMX_ErrorNone;
         }
 
+        case kIndexParamDeblockingThreads:
+        {
+            const OMX_PARAM_U32TYPE *threadParams =
+                (const OMX_PARAM_U32TYPE *)params;
+
+            if (threadParams->nU32 < 1
+                    || threadParams->nU32 > kMaxDeblockingThreads) {
+                return OMX_ErrorBadParameter;
+            }
+
+            if (H264SwDecSetDeblockingThreads(mHandle, threadParams->nU32)
+                    != H264SWDEC_OK) {
+                // The decoder is left filtering on the decoding thread.
+                mNumDeblockingThreads = 1;
+                return OMX_ErrorInsufficientResources;
+            }
+
+            mNumDeblockingThreads = threadParams->nU32;
+            return OMX_ErrorNone;
+        }
+
         default:
             return SimpleSoftOMXComponent::internalSetParameter(index, params);
     }
 }
 
+OMX_ERRORTYPE SoftAVC::getExtensionIndex(
+        const char *name, OMX_INDEXTYPE *index) {
+    if (!strcmp(name, kDeblockingThreadsExtension)) {
+        *index = kIndexParamDeblockingThreads;
+        return OMX_ErrorNone;
+    }
+
+    return SimpleSoftOMXComponent::getExtensionIndex(name, index);
+}
+
 OMX_ERRORTYPE SoftAVC::getConfig(
         OMX_INDEXTYPE index, OMX_PTR params) {
     switch (index) {
@@ -43,6 +43,9 @@ protected:
 
     virtual OMX_ERRORTYPE getConfig(OMX_INDEXTYPE index, OMX_PTR params);
 
+    virtual OMX_ERRORTYPE getExtensionIndex(
+            const char *name, OMX_INDEXTYPE *index);
+
     virtual void onQueueFilled(OMX_U32 portIndex);
     virtual void onPortFlushCompleted(OMX_U32 portIndex);
     virtual void onPortEnableCompleted(OMX_U32 portIndex, bool enabled);
@@ -90,6 +93,8 @@ private:
 
     bool mSignalledError;
 
+    OMX_U32 mNumDeblockingThreads;
+
     void initPorts();
     status_t initDecoder();
     void updatePortDefinitions();
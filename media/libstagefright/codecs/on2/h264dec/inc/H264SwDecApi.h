@@ -153,6 +153,9 @@ extern "C"
     H264SwDecRet H264SwDecGetInfo(H264SwDecInst decInst,
                                   H264SwDecInfo *pDecInfo);
 
+    H264SwDecRet H264SwDecSetDeblockingThreads(H264SwDecInst decInst,
+                                               u32           numThreads);
+
     void  H264SwDecRelease(H264SwDecInst decInst);
 
     H264SwDecApiVersion H264SwDecGetAPIVersion(void);
@@ -175,6 +175,61 @@ H264SwDecRet H264SwDecInit(H264SwDecInst *decInst, u32 noOutputReordering)
 
 }
 
+/*------------------------------------------------------------------------------
+
+    Function: H264SwDecSetDeblockingThreads()
+
+        Functional description:
+            Set the number of threads used for the deblocking filtering of
+            each picture, including the thread calling H264SwDecDecode. The
+            decoded pictures do not depend on the number of threads.
+
+        Inputs:
+            decInst     decoder instance
+            numThreads  number of threads, 1 to filter on the calling
+                        thread only
+
+        Outputs:
+            none
+
+        Returns:
+            H264SWDEC_OK            success
+            H264SWDEC_PARAM_ERR     invalid parameters
+            H264SWDEC_MEMFAIL       threads could not be started
+
+------------------------------------------------------------------------------*/
+
+H264SwDecRet H264SwDecSetDeblockingThreads(H264SwDecInst decInst,
+    u32 numThreads)
+{
+
+    storage_t *pStorage;
+
+    DEC_API_TRC("H264SwDecSetDeblockingThreads#");
+
+    if (decInst == NULL || numThreads == 0)
+    {
+        DEC_API_TRC("H264SwDecSetDeblockingThreads# ERROR: decInst is NULL "
+            "or numThreads is 0");
+        return(H264SWDEC_PARAM_ERR);
+    }
+
+    pStorage = &(((decContainer_t *)decInst)->storage);
+
+    h264bsdDestroyDeblockingThreads(pStorage->deblockThreads);
+    pStorage->deblockThreads = h264bsdCreateDeblockingThreads(numThreads);
+
+    if (numThreads > 1 && pStorage->deblockThreads == NULL)
+    {
+        DEC_API_TRC("H264SwDecSetDeblockingThreads# ERROR: Thread creation "
+            "failed");
+        return(H264SWDEC_MEMFAIL);
+    }
+
+    return(H264SWDEC_OK);
+
+}
+
 /*------------------------------------------------------------------------------
 
     Function: H264SwDecGetInfo()
@@ -53,6 +53,8 @@
 #include "h264bsd_deblocking.h"
 #include "h264bsd_dpb.h"
 
+#include <pthread.h>
+
 #ifdef H264DEC_OMXDL
 #include "omxtypes.h"
 #include "omxVC.h"
@@ -137,6 +139,37 @@ typedef struct {
 enum { TOP = 0, LEFT = 1, INNER = 2 };
 #endif /* H264DEC_OMXDL */
 
+/* upper limit for the number of threads filtering a picture */
+#define MAX_DEBLOCKING_THREADS  8
+
+/* a row publishes its progress to the row below every this many
+ * macroblocks */
+#define PROGRESS_INTERVAL_MBS   4
+
+/* State shared by the threads filtering a picture. Rows are picked in order
+ * by whichever thread is free, and each thread filters its row from left to
+ * right, keeping two macroblocks behind the row above.
+ * Filtering the top edge of macroblock (r,c) modifies the bottom rows of
+ * macroblock (r-1,c), which the left edge of (r-1,c+1) also modifies, so
+ * every pixel is filtered in the same order as in raster scan. All fields
+ * below the mutex are protected by it. */
+struct deblockThreads
+{
+    u32 numWorkers;
+    pthread_t workers[MAX_DEBLOCKING_THREADS];
+    pthread_mutex_t mutex;
+    pthread_cond_t workCond;
+    pthread_cond_t progressCond;
+    u32 exit;
+    u32 generation;
+    image_t *image;
+    mbStorage_t *mb;
+    u32 nextRow;
+    u32 rowsDone;
+    u32 *progress;      /* number of filtered macroblocks in each row */
+    u32 progressSize;
+};
+
 #define FILTER_LEFT_EDGE    0x04
 #define FILTER_TOP_EDGE     0x02
 #define FILTER_INNER_EDGE   0x01
@@ -166,6 +199,13 @@ static u32 IsSliceBoundaryOnTop(mbStorage_t *mb);
 
 static u32 GetMbFilteringFlags(mbStorage_t *mb);
 
+static void FilterMacroblock(image_t *image, mbStorage_t *pMb, u32 mbRow,
+    u32 mbCol);
+
+static void FilterRows(deblockThreads_t *threads);
+
+static void *DeblockingWorker(void *arg);
+
 #ifndef H264DEC_OMXDL
 
 static u32 GetBoundaryStrengths(mbStorage_t *mb, bS_t *bs, u32 flags);
@@ -578,13 +618,8 @@ void h264bsdFilterPicture(
 
 /* Variables */
 
-    u32 flags;
-    u32 picSizeInMbs, mbRow, mbCol;
-    u32 picWidthInMbs;
-    u8 *data;
+    u32 mbRow, mbCol;
     mbStorage_t *pMb;
-    bS_t bS[16];
-    edgeThreshold_t thresholds[3];
 
 /* Code */
 
@@ -594,45 +629,75 @@ void h264bsdFilterPicture(
     ASSERT(image->width);
     ASSERT(image->height);
 
-    picWidthInMbs = image->width;
-    data = image->data;
-    picSizeInMbs = picWidthInMbs * image->height;
-
     pMb = mb;
 
     for (mbRow = 0, mbCol = 0; mbRow < image->height; pMb++)
     {
-        flags = GetMbFilteringFlags(pMb);
+        FilterMacroblock(image, pMb, mbRow, mbCol);
 
-        if (flags)
+        mbCol++;
+        if (mbCol == image->width)
         {
-            /* GetBoundaryStrengths function returns non-zero value if any of
-             * the bS values for the macroblock being processed was non-zero */
-            if (GetBoundaryStrengths(pMb, bS, flags))
-            {
-                /* luma */
-                GetLumaEdgeThresholds(thresholds, pMb, flags);
-                data = image->data + mbRow * picWidthInMbs * 256 + mbCol * 16;
+            mbCol = 0;
+            mbRow++;
+        }
+    }
 
-                FilterLuma((u8*)data, bS, thresholds, picWidthInMbs*16);
+}
 
-                /* chroma */
-                GetChromaEdgeThresholds(thresholds, pMb, flags,
-                    pMb->chromaQpIndexOffset);
-                data = image->data + picSizeInMbs * 256 +
-                    mbRow * picWidthInMbs * 64 + mbCol * 8;
+/*------------------------------------------------------------------------------
 
-                FilterChroma((u8*)data, data + 64*picSizeInMbs, bS,
-                        thresholds, picWidthInMbs*8);
+    Function: FilterMacroblock
 
-            }
-        }
+        Functional description:
+          Perform deblocking filtering for the edges of one macroblock, i.e.
+          its left edge, top edge and inner edges.
 
-        mbCol++;
-        if (mbCol == picWidthInMbs)
+------------------------------------------------------------------------------*/
+void FilterMacroblock(
+  image_t *image,
+  mbStorage_t *pMb,
+  u32 mbRow,
+  u32 mbCol)
+{
+
+/* Variables */
+
+    u32 flags;
+    u32 picSizeInMbs;
+    u32 picWidthInMbs;
+    u8 *data;
+    bS_t bS[16];
+    edgeThreshold_t thresholds[3];
+
+/* Code */
+
+    picWidthInMbs = image->width;
+    picSizeInMbs = picWidthInMbs * image->height;
+
+    flags = GetMbFilteringFlags(pMb);
+
+    if (flags)
+    {
+        /* GetBoundaryStrengths function returns non-zero value if any of
+         * the bS values for the macroblock being processed was non-zero */
+        if (GetBoundaryStrengths(pMb, bS, flags))
         {
-            mbCol = 0;
-            mbRow++;
+            /* luma */
+            GetLumaEdgeThresholds(thresholds, pMb, flags);
+            data = image->data + mbRow * picWidthInMbs * 256 + mbCol * 16;
+
+            FilterLuma((u8*)data, bS, thresholds, picWidthInMbs*16);
+
+            /* chroma */
+            GetChromaEdgeThresholds(thresholds, pMb, flags,
+                pMb->chromaQpIndexOffset);
+            data = image->data + picSizeInMbs * 256 +
+                mbRow * picWidthInMbs * 64 + mbCol * 8;
+
+            FilterChroma((u8*)data, data + 64*picSizeInMbs, bS,
+                    thresholds, picWidthInMbs*8);
+
         }
     }
 
@@ -1770,17 +1835,8 @@ void h264bsdFilterPicture(
 
 /* Variables */
 
-    u32 flags;
-    u32 picSizeInMbs, mbRow, mbCol;
-    u32 picWidthInMbs;
-    u8 *data;
+    u32 mbRow, mbCol;
     mbStorage_t *pMb;
-    u8 bS[2][16];
-    u8 thresholdLuma[2][16];
-    u8 thresholdChroma[2][8];
-    u8 alpha[2][2];
-    u8 beta[2][2];
-    OMXResult res;
 
 /* Code */
 
@@ -1790,77 +1846,14 @@ void h264bsdFilterPicture(
     ASSERT(image->width);
     ASSERT(image->height);
 
-    picWidthInMbs = image->width;
-    data = image->data;
-    picSizeInMbs = picWidthInMbs * image->height;
-
     pMb = mb;
 
     for (mbRow = 0, mbCol = 0; mbRow < image->height; pMb++)
     {
-        flags = GetMbFilteringFlags(pMb);
-
-        if (flags)
-        {
-            /* GetBoundaryStrengths function returns non-zero value if any of
-             * the bS values for the macroblock being processed was non-zero */
-            if (GetBoundaryStrengths(pMb, bS, flags))
-            {
-
-                /* Luma */
-                GetLumaEdgeThresholds(pMb,alpha,beta,thresholdLuma,bS,flags);
-                data = image->data + mbRow * picWidthInMbs * 256 + mbCol * 16;
-
-                res = omxVCM4P10_FilterDeblockingLuma_VerEdge_I( data,
-                                                (OMX_S32)(picWidthInMbs*16),
-                                                (const OMX_U8*)alpha,
-                                                (const OMX_U8*)beta,
-                                                (const OMX_U8*)thresholdLuma,
-                                                (const OMX_U8*)bS );
-
-                res = omxVCM4P10_FilterDeblockingLuma_HorEdge_I( data,
-                                                (OMX_S32)(picWidthInMbs*16),
-                                                (const OMX_U8*)alpha+2,
-                                                (const OMX_U8*)beta+2,
-                                                (const OMX_U8*)thresholdLuma+16,
-                                                (const OMX_U8*)bS+16 );
-                /* Cb */
-                GetChromaEdgeThresholds(pMb, alpha, beta, thresholdChroma,
-                                        bS, flags, pMb->chromaQpIndexOffset);
-                data = image->data + picSizeInMbs * 256 +
-                    mbRow * picWidthInMbs * 64 + mbCol * 8;
-
-                res = omxVCM4P10_FilterDeblockingChroma_VerEdge_I( data,
-                                              (OMX_S32)(picWidthInMbs*8),
-                                              (const OMX_U8*)alpha,
-                                              (const OMX_U8*)beta,
-                                              (const OMX_U8*)thresholdChroma,
-                                              (const OMX_U8*)bS );
-                res = omxVCM4P10_FilterDeblockingChroma_HorEdge_I( data,
-                                              (OMX_S32)(picWidthInMbs*8),
-                                              (const OMX_U8*)alpha+2,
-                                              (const OMX_U8*)beta+2,
-                                              (const OMX_U8*)thresholdChroma+8,
-                                              (const OMX_U8*)bS+16 );
-                /* Cr */
-                data += (picSizeInMbs * 64);
-                res = omxVCM4P10_FilterDeblockingChroma_VerEdge_I( data,
-                                              (OMX_S32)(picWidthInMbs*8),
-                                              (const OMX_U8*)alpha,
-                                              (const OMX_U8*)beta,
-                                              (const OMX_U8*)thresholdChroma,
-                                              (const OMX_U8*)bS );
-                res = omxVCM4P10_FilterDeblockingChroma_HorEdge_I( data,
-                                              (OMX_S32)(picWidthInMbs*8),
-                                              (const OMX_U8*)alpha+2,
-                                              (const OMX_U8*)beta+2,
-                                              (const OMX_U8*)thresholdChroma+8,
-                                              (const OMX_U8*)bS+16 );
-            }
-        }
+        FilterMacroblock(image, pMb, mbRow, mbCol);
 
         mbCol++;
-        if (mbCol == picWidthInMbs)
+        if (mbCol == image->width)
         {
             mbCol = 0;
             mbRow++;
@@ -1869,6 +1862,105 @@ void h264bsdFilterPicture(
 
 }
 
+/*------------------------------------------------------------------------------
+
+    Function: FilterMacroblock
+
+        Functional description:
+          Perform deblocking filtering for the edges of one macroblock, i.e.
+          its left edge, top edge and inner edges.
+
+------------------------------------------------------------------------------*/
+
+/*lint --e{550} Symbol not accessed */
+void FilterMacroblock(
+  image_t *image,
+  mbStorage_t *pMb,
+  u32 mbRow,
+  u32 mbCol)
+{
+
+/* Variables */
+
+    u32 flags;
+    u32 picSizeInMbs;
+    u32 picWidthInMbs;
+    u8 *data;
+    u8 bS[2][16];
+    u8 thresholdLuma[2][16];
+    u8 thresholdChroma[2][8];
+    u8 alpha[2][2];
+    u8 beta[2][2];
+    OMXResult res;
+
+/* Code */
+
+    picWidthInMbs = image->width;
+    picSizeInMbs = picWidthInMbs * image->height;
+
+    flags = GetMbFilteringFlags(pMb);
+
+    if (flags)
+    {
+        /* GetBoundaryStrengths function returns non-zero value if any of
+         * the bS values for the macroblock being processed was non-zero */
+        if (GetBoundaryStrengths(pMb, bS, flags))
+        {
+
+            /* Luma */
+            GetLumaEdgeThresholds(pMb,alpha,beta,thresholdLuma,bS,flags);
+            data = image->data + mbRow * picWidthInMbs * 256 + mbCol * 16;
+
+            res = omxVCM4P10_FilterDeblockingLuma_VerEdge_I( data,
+                                            (OMX_S32)(picWidthInMbs*16),
+                                            (const OMX_U8*)alpha,
+                                            (const OMX_U8*)beta,
+                                            (const OMX_U8*)thresholdLuma,
+                                            (const OMX_U8*)bS );
+
+            res = omxVCM4P10_FilterDeblockingLuma_HorEdge_I( data,
+                                            (OMX_S32)(picWidthInMbs*16),
+                                            (const OMX_U8*)alpha+2,
+                                            (const OMX_U8*)beta+2,
+                                            (const OMX_U8*)thresholdLuma+16,
+                                            (const OMX_U8*)bS+16 );
+            /* Cb */
+            GetChromaEdgeThresholds(pMb, alpha, beta, thresholdChroma,
+                                    bS, flags, pMb->chromaQpIndexOffset);
+            data = image->data + picSizeInMbs * 256 +
+                mbRow * picWidthInMbs * 64 + mbCol * 8;
+
+            res = omxVCM4P10_FilterDeblockingChroma_VerEdge_I( data,
+                                          (OMX_S32)(picWidthInMbs*8),
+                                          (const OMX_U8*)alpha,
+                                          (const OMX_U8*)beta,
+                                          (const OMX_U8*)thresholdChroma,
+                                          (const OMX_U8*)bS );
+            res = omxVCM4P10_FilterDeblockingChroma_HorEdge_I( data,
+                                          (OMX_S32)(picWidthInMbs*8),
+                                          (const OMX_U8*)alpha+2,
+                                          (const OMX_U8*)beta+2,
+                                          (const OMX_U8*)thresholdChroma+8,
+                                          (const OMX_U8*)bS+16 );
+            /* Cr */
+            data += (picSizeInMbs * 64);
+            res = omxVCM4P10_FilterDeblockingChroma_VerEdge_I( data,
+                                          (OMX_S32)(picWidthInMbs*8),
+                                          (const OMX_U8*)alpha,
+                                          (const OMX_U8*)beta,
+                                          (const OMX_U8*)thresholdChroma,
+                                          (const OMX_U8*)bS );
+            res = omxVCM4P10_FilterDeblockingChroma_HorEdge_I( data,
+                                          (OMX_S32)(picWidthInMbs*8),
+                                          (const OMX_U8*)alpha+2,
+                                          (const OMX_U8*)beta+2,
+                                          (const OMX_U8*)thresholdChroma+8,
+                                          (const OMX_U8*)bS+16 );
+        }
+    }
+
+}
+
 /*------------------------------------------------------------------------------
 
     Function: GetBoundaryStrengths
@@ -2413,5 +2505,287 @@ void GetChromaEdgeThresholds(
 
 #endif /* H264DEC_OMXDL */
 
+/*------------------------------------------------------------------------------
+
+    Function: h264bsdCreateDeblockingThreads
+
+        Functional description:
+          Start the worker threads used by h264bsdFilterPictureParallel.
+          The calling thread takes part in filtering, so numThreads - 1
+          workers are started.
+
+        Inputs:
+          numThreads    total number of threads filtering a picture
+
+        Returns:
+          pointer to the thread state, NULL if numThreads is less than 2 or
+          the threads could not be started
+
+------------------------------------------------------------------------------*/
+
+deblockThreads_t *h264bsdCreateDeblockingThreads(u32 numThreads)
+{
+
+/* Variables */
+
+    u32 i;
+    deblockThreads_t *threads;
+
+/* Code */
+
+    if (numThreads < 2)
+        return(NULL);
+
+    if (numThreads > MAX_DEBLOCKING_THREADS + 1)
+        numThreads = MAX_DEBLOCKING_THREADS + 1;
+
+    ALLOCATE(threads, 1, deblockThreads_t);
+    if (threads == NULL)
+        return(NULL);
+
+    H264SwDecMemset(threads, 0, sizeof(deblockThreads_t));
+
+    pthread_mutex_init(&threads->mutex, NULL);
+    pthread_cond_init(&threads->workCond, NULL);
+    pthread_cond_init(&threads->progressCond, NULL);
+
+    for (i = 0; i < numThreads - 1; i++)
+    {
+        if (pthread_create(&threads->workers[i], NULL, DeblockingWorker,
+                threads))
+            break;
+        threads->numWorkers++;
+    }
+
+    if (threads->numWorkers == 0)
+    {
+        h264bsdDestroyDeblockingThreads(threads);
+        return(NULL);
+    }
+
+    return(threads);
+
+}
+
+/*------------------------------------------------------------------------------
+
+    Function: h264bsdDestroyDeblockingThreads
+
+        Functional description:
+          Stop the worker threads and free the thread state.
+
+------------------------------------------------------------------------------*/
+
+void h264bsdDestroyDeblockingThreads(deblockThreads_t *threads)
+{
+
+/* Variables */
+
+    u32 i;
+
+/* Code */
+
+    if (threads == NULL)
+        return;
+
+    pthread_mutex_lock(&threads->mutex);
+    threads->exit = HANTRO_TRUE;
+    pthread_cond_broadcast(&threads->workCond);
+    pthread_mutex_unlock(&threads->mutex);
+
+    for (i = 0; i < threads->numWorkers; i++)
+        pthread_join(threads->workers[i], NULL);
+
+    pthread_cond_destroy(&threads->progressCond);
+    pthread_cond_destroy(&threads->workCond);
+    pthread_mutex_destroy(&threads->mutex);
+
+    FREE(threads->progress);
+    FREE(threads);
+
+}
+
+/*------------------------------------------------------------------------------
+
+    Function: h264bsdFilterPictureParallel
+
+        Functional description:
+          Perform deblocking filtering for a picture using the calling thread
+          and the worker threads. The result is identical to the one of
+          h264bsdFilterPicture, which is used if threads is NULL.
+
+        Inputs:
+          threads       thread state, may be NULL
+          image         pointer to image to be filtered
+          mb            pointer to macroblock data structure of the top-left
+                        macroblock of the picture
+
+        Outputs:
+          image         filtered image stored here
+
+        Returns:
+          none
+
+------------------------------------------------------------------------------*/
+
+void h264bsdFilterPictureParallel(
+  deblockThreads_t *threads,
+  image_t *image,
+  mbStorage_t *mb)
+{
+
+/* Code */
+
+    ASSERT(image);
+    ASSERT(mb);
+
+    if (threads == NULL || image->height < 2)
+    {
+        h264bsdFilterPicture(image, mb);
+        return;
+    }
+
+    /* workers only look at the progress while a picture is being filtered,
+     * so the array can be reallocated here without locking */
+    if (threads->progressSize < image->height)
+    {
+        FREE(threads->progress);
+        threads->progressSize = 0;
+        ALLOCATE(threads->progress, image->height, u32);
+        if (threads->progress == NULL)
+        {
+            h264bsdFilterPicture(image, mb);
+            return;
+        }
+        threads->progressSize = image->height;
+    }
+
+    pthread_mutex_lock(&threads->mutex);
+
+    H264SwDecMemset(threads->progress, 0, image->height * sizeof(u32));
+    threads->image = image;
+    threads->mb = mb;
+    threads->nextRow = 0;
+    threads->rowsDone = 0;
+    threads->generation++;
+    pthread_cond_broadcast(&threads->workCond);
+
+    FilterRows(threads);
+
+    while (threads->rowsDone < image->height)
+        pthread_cond_wait(&threads->progressCond, &threads->mutex);
+
+    threads->image = NULL;
+    threads->mb = NULL;
+
+    pthread_mutex_unlock(&threads->mutex);
+
+}
+
+/*------------------------------------------------------------------------------
+
+    Function: FilterRows
+
+        Functional description:
+          Filter macroblock rows of the current picture until there are no
+          rows left to pick. Called and returns with the mutex held, which
+          is released while filtering.
+
+------------------------------------------------------------------------------*/
+
+void FilterRows(deblockThreads_t *threads)
+{
+
+/* Variables */
+
+    u32 mbRow, mbCol, width, needed, available;
+    image_t *image;
+    mbStorage_t *pMb;
+
+/* Code */
+
+    while (threads->image && threads->nextRow < threads->image->height)
+    {
+        image = threads->image;
+        width = image->width;
+        mbRow = threads->nextRow++;
+        pMb = threads->mb + mbRow * width;
+        available = mbRow ? threads->progress[mbRow - 1] : width;
+
+        pthread_mutex_unlock(&threads->mutex);
+
+        for (mbCol = 0; mbCol < width; mbCol++, pMb++)
+        {
+            needed = MIN(mbCol + 2, width);
+            if (available < needed)
+            {
+                pthread_mutex_lock(&threads->mutex);
+                while (threads->progress[mbRow - 1] < needed)
+                    pthread_cond_wait(&threads->progressCond,
+                        &threads->mutex);
+                available = threads->progress[mbRow - 1];
+                pthread_mutex_unlock(&threads->mutex);
+            }
+
+            FilterMacroblock(image, pMb, mbRow, mbCol);
+
+            if (((mbCol + 1) % PROGRESS_INTERVAL_MBS) == 0 &&
+                mbCol + 1 < width)
+            {
+                pthread_mutex_lock(&threads->mutex);
+                threads->progress[mbRow] = mbCol + 1;
+                pthread_cond_broadcast(&threads->progressCond);
+                pthread_mutex_unlock(&threads->mutex);
+            }
+        }
+
+        pthread_mutex_lock(&threads->mutex);
+        threads->progress[mbRow] = width;
+        threads->rowsDone++;
+        pthread_cond_broadcast(&threads->progressCond);
+    }
+
+}
+
+/*------------------------------------------------------------------------------
+
+    Function: DeblockingWorker
+
+        Functional description:
+          Thread function of the workers, helps filtering each new picture
+          until asked to exit.
+
+------------------------------------------------------------------------------*/
+
+void *DeblockingWorker(void *arg)
+{
+
+/* Variables */
+
+    deblockThreads_t *threads = (deblockThreads_t *)arg;
+    u32 generation = 0;
+
+/* Code */
+
+    pthread_mutex_lock(&threads->mutex);
+
+    for (;;)
+    {
+        while (!threads->exit && threads->generation == generation)
+            pthread_cond_wait(&threads->workCond, &threads->mutex);
+
+        if (threads->exit)
+            break;
+
+        generation = threads->generation;
+        FilterRows(threads);
+    }
+
+    pthread_mutex_unlock(&threads->mutex);
+
+    return(NULL);
+
+}
+
 /*lint +e701 +e702 */
 
@@ -44,6 +44,9 @@
     3. Data types
 ------------------------------------------------------------------------------*/
 
+/* worker threads for h264bsdFilterPictureParallel */
+typedef struct deblockThreads deblockThreads_t;
+
 /*------------------------------------------------------------------------------
     4. Function prototypes
 ------------------------------------------------------------------------------*/
@@ -52,5 +55,14 @@ void h264bsdFilterPicture(
   image_t *image,
   mbStorage_t *mb);
 
+deblockThreads_t *h264bsdCreateDeblockingThreads(u32 numThreads);
+
+void h264bsdDestroyDeblockingThreads(deblockThreads_t *threads);
+
+void h264bsdFilterPictureParallel(
+  deblockThreads_t *threads,
+  image_t *image,
+  mbStorage_t *mb);
+
 #endif /* #ifdef H264SWDEC_DEBLOCKING_H */
 
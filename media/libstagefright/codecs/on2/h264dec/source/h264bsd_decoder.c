@@ -471,7 +471,8 @@ u32 h264bsdDecode(storage_t *pStorage, u8 *byteStrm, u32 len, u32 picId,
 
     if (picReady)
     {
-        h264bsdFilterPicture(pStorage->currImage, pStorage->mb);
+        h264bsdFilterPictureParallel(pStorage->deblockThreads,
+            pStorage->currImage, pStorage->mb);
 
         h264bsdResetStorage(pStorage);
 
@@ -569,6 +570,9 @@ void h264bsdShutdown(storage_t *pStorage)
 
     h264bsdFreeDpb(pStorage->dpb);
 
+    h264bsdDestroyDeblockingThreads(pStorage->deblockThreads);
+    pStorage->deblockThreads = NULL;
+
 }
 
 /*------------------------------------------------------------------------------
@@ -42,6 +42,7 @@
 #include "h264bsd_seq_param_set.h"
 #include "h264bsd_dpb.h"
 #include "h264bsd_pic_order_cnt.h"
+#include "h264bsd_deblocking.h"
 
 /*------------------------------------------------------------------------------
     2. Module defines
@@ -146,6 +147,10 @@ typedef struct
                               HEADERS_RDY to the user */
     u32 intraConcealmentFlag; /* 0 gray picture for corrupted intra
                                  1 previous frame used if available */
+
+    /* threads sharing the deblocking of each picture, NULL if deblocking
+     * is done on the decoding thread only */
+    deblockThreads_t *deblockThreads;
 } storage_t;
 
 /*------------------------------------------------------------------------------
@@ -302,7 +302,7 @@ void SoftVorbis::onQueueFilled(OMX_U32 portIndex) {
             inInfo->mOwnedByUs = false;
             notifyEmptyBufferDone(inHeader);
 
-            outHeader->nFilledLen = 0;
+            // keep the frames already batched into this buffer, if any
             outHeader->nFlags = OMX_BUFFERFLAG_EOS;
 
             outQueue.erase(outQueue.begin());
@@ -355,8 +355,11 @@ void SoftVorbis::onQueueFilled(OMX_U32 portIndex) {
         if (err != 0) {
             ALOGW("vorbis_dsp_synthesis returned %d", err);
         } else {
+            // in batch mode, append after the frames already in the buffer
             numFrames = vorbis_dsp_pcmout(
-                    mState, (int16_t *)outHeader->pBuffer,
+                    mState,
+                    (int16_t *)(outHeader->pBuffer
+                        + outHeader->nOffset + outHeader->nFilledLen),
                     kMaxNumSamplesPerBuffer);
 
             if (numFrames < 0) {
@@ -374,13 +377,15 @@ void SoftVorbis::onQueueFilled(OMX_U32 portIndex) {
             mNumFramesLeftOnPage -= numFrames;
         }
 
-        outHeader->nFilledLen = numFrames * sizeof(int16_t) * mVi->channels;
-        outHeader->nOffset = 0;
-        outHeader->nFlags = 0;
+        if (outHeader->nFilledLen == 0) {
+            outHeader->nFlags = 0;
 
-        outHeader->nTimeStamp =
-            mAnchorTimeUs
-                + (mNumFramesOutput * 1000000ll) / mVi->rate;
+            outHeader->nTimeStamp =
+                mAnchorTimeUs
+                    + (mNumFramesOutput * 1000000ll) / mVi->rate;
+        }
+
+        outHeader->nFilledLen += numFrames * sizeof(int16_t) * mVi->channels;
 
         mNumFramesOutput += numFrames;
 
@@ -390,13 +395,18 @@ void SoftVorbis::onQueueFilled(OMX_U32 portIndex) {
         notifyEmptyBufferDone(inHeader);
         inHeader = NULL;
 
+        ++mInputBufferCount;
+
+        if (keepOutputBuffer(
+                    outHeader, kMaxNumSamplesPerBuffer * sizeof(int16_t))) {
+            continue;
+        }
+
         outInfo->mOwnedByUs = false;
         outQueue.erase(outQueue.begin());
         outInfo = NULL;
         notifyFillBufferDone(outHeader);
         outHeader = NULL;
-
-        ++mInputBufferCount;
     }
 }
 
@@ -24,21 +24,76 @@
 #include <media/stagefright/MediaErrors.h>
 #include <dlfcn.h>
 
+#ifdef __ARM_NEON__
+#include <arm_neon.h>
+#endif
+
 namespace android {
 
+// Frames shorter than this many rows per thread aren't worth splitting.
+static const size_t kMinRowsPerBand = 64;
+
+struct ColorConverter::Worker : public Thread {
+    Worker(ColorConverter *converter)
+        : Thread(false /* canCallJava */),
+          mConverter(converter) {
+    }
+
+protected:
+    virtual bool threadLoop() {
+        return mConverter->workerLoop();
+    }
+
+private:
+    ColorConverter *mConverter;
+
+    Worker(const Worker &);
+    Worker &operator=(const Worker &);
+};
+
 ColorConverter::ColorConverter(
         OMX_COLOR_FORMATTYPE from, OMX_COLOR_FORMATTYPE to)
     : mSrcFormat(from),
       mDstFormat(to),
-      mClip(NULL) {
+      mClip(NULL),
+      mNumThreads(1),
+      mExiting(false),
+      mJobFunc(NULL),
+      mJobSrc(NULL),
+      mJobDst(NULL),
+      mJobNumRows(0),
+      mJobRowsPerBand(0),
+      mJobNumBands(0),
+      mJobNextBand(0),
+      mJobBandsPending(0),
+      mJobErr(OK) {
 }
 
 ColorConverter::~ColorConverter() {
+    {
+        Mutex::Autolock autoLock(mLock);
+        mExiting = true;
+        mWorkAvailableCondition.broadcast();
+    }
+
+    for (size_t i = 0; i < mWorkers.size(); ++i) {
+        mWorkers.editItemAt(i)->requestExitAndWait();
+    }
+    mWorkers.clear();
+
     delete[] mClip;
     mClip = NULL;
 }
 
+void ColorConverter::setNumThreads(size_t numThreads) {
+    mNumThreads = numThreads > 0 ? numThreads : 1;
+}
+
 bool ColorConverter::isValid() const {
+    if (mDstFormat == OMX_COLOR_Format32bitARGB8888) {
+        return isValidARGBSource(mSrcFormat);
+    }
+
     if (mDstFormat != OMX_COLOR_Format16bitRGB565) {
         return false;
     }
@@ -59,6 +114,27 @@ bool ColorConverter::isValid() const {
     }
 }
 
+bool ColorConverter::supportsScaling() const {
+    // The formats that can produce 32 bit output are the ones with a
+    // PlaneLayout.
+    return isValid() && isValidARGBSource(mSrcFormat);
+}
+
+// static
+bool ColorConverter::isValidARGBSource(OMX_COLOR_FORMATTYPE format) {
+    // Only the formats sharing convertRow can produce 32 bit output.
+    switch (format) {
+        case OMX_COLOR_FormatYUV420Planar:
+        case OMX_QCOM_COLOR_FormatYVU420SemiPlanar:
+        case OMX_COLOR_FormatYUV420SemiPlanar:
+        case OMX_TI_COLOR_FormatYUV420PackedSemiPlanar:
+            return true;
+
+        default:
+            return false;
+    }
+}
+
 ColorConverter::BitmapParams::BitmapParams(
         void *bits,
         size_t width, size_t height,
@@ -90,7 +166,11 @@ status_t ColorConverter::convert(
         size_t dstWidth, size_t dstHeight,
         size_t dstCropLeft, size_t dstCropTop,
         size_t dstCropRight, size_t dstCropBottom) {
-    if (mDstFormat != OMX_COLOR_Format16bitRGB565) {
+    if (mDstFormat == OMX_COLOR_Format32bitARGB8888) {
+        if (!isValidARGBSource(mSrcFormat)) {
+            return ERROR_UNSUPPORTED;
+        }
+    } else if (mDstFormat != OMX_COLOR_Format16bitRGB565) {
         return ERROR_UNSUPPORTED;
     }
 
@@ -104,27 +184,39 @@ status_t ColorConverter::convert(
             dstWidth, dstHeight,
             dstCropLeft, dstCropTop, dstCropRight, dstCropBottom);
 
+    if (src.cropWidth() != dst.cropWidth()
+            || src.cropHeight() != dst.cropHeight()) {
+        if (!supportsScaling()) {
+            return ERROR_UNSUPPORTED;
+        }
+
+        return convertRows(&ColorConverter::convertScaledYUV420, src, dst);
+    }
+
     status_t err;
 
     switch (mSrcFormat) {
         case OMX_COLOR_FormatYUV420Planar:
-            err = convertYUV420Planar(src, dst);
+            err = convertRows(&ColorConverter::convertYUV420Planar, src, dst);
             break;
 
         case OMX_COLOR_FormatCbYCrY:
-            err = convertCbYCrY(src, dst);
+            err = convertRows(&ColorConverter::convertCbYCrY, src, dst);
             break;
 
         case OMX_QCOM_COLOR_FormatYVU420SemiPlanar:
-            err = convertQCOMYUV420SemiPlanar(src, dst);
+            err = convertRows(
+                    &ColorConverter::convertQCOMYUV420SemiPlanar, src, dst);
             break;
 
         case OMX_COLOR_FormatYUV420SemiPlanar:
-            err = convertYUV420SemiPlanar(src, dst);
+            err = convertRows(
+                    &ColorConverter::convertYUV420SemiPlanar, src, dst);
             break;
 
         case OMX_TI_COLOR_FormatYUV420PackedSemiPlanar:
-            err = convertTIYUV420PackedSemiPlanar(src, dst);
+            err = convertRows(
+                    &ColorConverter::convertTIYUV420PackedSemiPlanar, src, dst);
             break;
 
 #ifdef QCOM_HARDWARE
@@ -189,8 +281,112 @@ status_t ColorConverter::convert(
     return err;
 }
 
+status_t ColorConverter::convertRows(
+        ConvertFunc func, const BitmapParams &src, const BitmapParams &dst) {
+    const size_t numRows = dst.cropHeight();
+
+    size_t numBands = numRows / kMinRowsPerBand;
+    if (numBands > mNumThreads) {
+        numBands = mNumThreads;
+    }
+
+    if (numBands <= 1) {
+        return (this->*func)(src, dst, 0, numRows);
+    }
+
+    // Bands start on even rows so that each one begins with a fresh
+    // chroma row. Every row is converted exactly as it would be in a single
+    // pass, so the output doesn't depend on the number of threads.
+    const size_t rowsPerBand = ((numRows + numBands - 1) / numBands + 1) & ~1;
+
+    // Allocate the clip table before the bands race to do so.
+    initClip();
+
+    Mutex::Autolock autoLock(mLock);
+
+    while (mWorkers.size() + 1 < mNumThreads) {
+        sp<Worker> worker = new Worker(this);
+        if (worker->run("ColorConverter") != OK) {
+            ALOGW("unable to start color conversion thread");
+            break;
+        }
+        mWorkers.push(worker);
+    }
+
+    mJobFunc = func;
+    mJobSrc = &src;
+    mJobDst = &dst;
+    mJobNumRows = numRows;
+    mJobRowsPerBand = rowsPerBand;
+    mJobNumBands = (numRows + rowsPerBand - 1) / rowsPerBand;
+    mJobNextBand = 0;
+    mJobBandsPending = mJobNumBands;
+    mJobErr = OK;
+
+    mWorkAvailableCondition.broadcast();
+
+    // The calling thread converts bands too, which also covers the case
+    // where no worker could be started.
+    while (mJobNextBand < mJobNumBands) {
+        convertNextBand_l();
+    }
+
+    while (mJobBandsPending > 0) {
+        mWorkDoneCondition.wait(mLock);
+    }
+
+    mJobFunc = NULL;
+    mJobSrc = NULL;
+    mJobDst = NULL;
+    mJobNumBands = 0;
+    mJobNextBand = 0;
+
+    return mJobErr;
+}
+
+void ColorConverter::convertNextBand_l() {
+    const size_t firstRow = mJobNextBand++ * mJobRowsPerBand;
+    size_t numRows = mJobRowsPerBand;
+    if (firstRow + numRows > mJobNumRows) {
+        numRows = mJobNumRows - firstRow;
+    }
+
+    ConvertFunc func = mJobFunc;
+    const BitmapParams &src = *mJobSrc;
+    const BitmapParams &dst = *mJobDst;
+
+    mLock.unlock();
+    status_t err = (this->*func)(src, dst, firstRow, numRows);
+    mLock.lock();
+
+    if (err != OK && mJobErr == OK) {
+        mJobErr = err;
+    }
+
+    if (--mJobBandsPending == 0) {
+        mWorkDoneCondition.signal();
+    }
+}
+
+bool ColorConverter::workerLoop() {
+    Mutex::Autolock autoLock(mLock);
+
+    while (!mExiting && mJobNextBand >= mJobNumBands) {
+        mWorkAvailableCondition.wait(mLock);
+    }
+
+    if (mExiting) {
+        return false;
+    }
+
+    convertNextBand_l();
+
+    return true;
+}
+
 status_t ColorConverter::convertCbYCrY(
-        const BitmapParams &src, const BitmapParams &dst) {
+        const BitmapParams &src, const BitmapParams &dst,
+        size_t firstRow, size_t numRows) {
     // XXX Untested
 
     uint8_t *kAdjustedClip = initClip();
@@ -207,7 +403,10 @@ status_t ColorConverter::convertCbYCrY(
     const uint8_t *src_ptr = (const uint8_t *)src.mBits
         + (src.mCropTop * dst.mWidth + src.mCropLeft) * 2;
 
-    for (size_t y = 0; y < src.cropHeight(); ++y) {
+    src_ptr += firstRow * src.mWidth * 2;
+    dst_ptr += firstRow * dst.mWidth;
+
+    for (size_t y = firstRow; y < firstRow + numRows; ++y) {
         for (size_t x = 0; x < src.cropWidth(); x += 2) {
             signed y1 = (signed)src_ptr[2 * x + 1] - 16;
             signed y2 = (signed)src_ptr[2 * x + 3] - 16;
@@ -254,7 +453,8 @@ status_t ColorConverter::convertCbYCrY(
 }
 
 status_t ColorConverter::convertYUV420Planar(
-        const BitmapParams &src, const BitmapParams &dst) {
+        const BitmapParams &src, const BitmapParams &dst,
+        size_t firstRow, size_t numRows) {
     if (!((src.mCropLeft & 1) == 0
             && src.cropWidth() == dst.cropWidth()
             && src.cropHeight() == dst.cropHeight())) {
@@ -263,8 +463,11 @@ status_t ColorConverter::convertYUV420Planar(
 
     uint8_t *kAdjustedClip = initClip();
 
-    uint16_t *dst_ptr = (uint16_t *)dst.mBits
-        + dst.mCropTop * dst.mWidth + dst.mCropLeft;
+    const bool argb = (mDstFormat == OMX_COLOR_Format32bitARGB8888);
+    const size_t dstBpp = argb ? 4 : 2;
+
+    uint8_t *dst_ptr = (uint8_t *)dst.mBits
+        + (dst.mCropTop * dst.mWidth + dst.mCropLeft) * dstBpp;
 
     const uint8_t *src_y =
         (const uint8_t *)src.mBits + src.mCropTop * src.mWidth + src.mCropLeft;
@@ -276,63 +479,15 @@ status_t ColorConverter::convertYUV420Planar(
     const uint8_t *src_v =
         src_u + (src.mWidth / 2) * (src.mHeight / 2);
 
-    for (size_t y = 0; y < src.cropHeight(); ++y) {
-        for (size_t x = 0; x < src.cropWidth(); x += 2) {
-            // B = 1.164 * (Y - 16) + 2.018 * (U - 128)
-            // G = 1.164 * (Y - 16) - 0.813 * (V - 128) - 0.391 * (U - 128)
-            // R = 1.164 * (Y - 16) + 1.596 * (V - 128)
-
-            // B = 298/256 * (Y - 16) + 517/256 * (U - 128)
-            // G = .................. - 208/256 * (V - 128) - 100/256 * (U - 128)
-            // R = .................. + 409/256 * (V - 128)
-
-            // min_B = (298 * (- 16) + 517 * (- 128)) / 256 = -277
-            // min_G = (298 * (- 16) - 208 * (255 - 128) - 100 * (255 - 128)) / 256 = -172
-            // min_R = (298 * (- 16) + 409 * (- 128)) / 256 = -223
-
-            // max_B = (298 * (255 - 16) + 517 * (255 - 128)) / 256 = 534
-            // max_G = (298 * (255 - 16) - 208 * (- 128) - 100 * (- 128)) / 256 = 432
-            // max_R = (298 * (255 - 16) + 409 * (255 - 128)) / 256 = 481
-
-            // clip range -278 .. 535
-
-            signed y1 = (signed)src_y[x] - 16;
-            signed y2 = (signed)src_y[x + 1] - 16;
-
-            signed u = (signed)src_u[x / 2] - 128;
-            signed v = (signed)src_v[x / 2] - 128;
-
-            signed u_b = u * 517;
-            signed u_g = -u * 100;
-            signed v_g = -v * 208;
-            signed v_r = v * 409;
-
-            signed tmp1 = y1 * 298;
-            signed b1 = (tmp1 + u_b) / 256;
-            signed g1 = (tmp1 + v_g + u_g) / 256;
-            signed r1 = (tmp1 + v_r) / 256;
-
-            signed tmp2 = y2 * 298;
-            signed b2 = (tmp2 + u_b) / 256;
-            signed g2 = (tmp2 + v_g + u_g) / 256;
-            signed r2 = (tmp2 + v_r) / 256;
-
-            uint32_t rgb1 =
-                ((kAdjustedClip[r1] >> 3) << 11)
-                | ((kAdjustedClip[g1] >> 2) << 5)
-                | (kAdjustedClip[b1] >> 3);
-
-            uint32_t rgb2 =
-                ((kAdjustedClip[r2] >> 3) << 11)
-                | ((kAdjustedClip[g2] >> 2) << 5)
-                | (kAdjustedClip[b2] >> 3);
+    src_y += firstRow * src.mWidth;
+    src_u += (firstRow / 2) * (src.mWidth / 2);
+    src_v += (firstRow / 2) * (src.mWidth / 2);
+    dst_ptr += firstRow * dst.mWidth * dstBpp;
 
-            if (x + 1 < src.cropWidth()) {
-                *(uint32_t *)(&dst_ptr[x]) = (rgb2 << 16) | rgb1;
-            } else {
-                dst_ptr[x] = rgb1;
-            }
-        }
+    for (size_t y = firstRow; y < firstRow + numRows; ++y) {
+        convertRow(
+                src_y, src_u, src_v, 1 /* chromaStep */, false /* swapRB */,
+                kAdjustedClip, dst_ptr, argb, src.cropWidth());
 
         src_y += src.mWidth;
 
@@ -341,14 +496,15 @@ status_t ColorConverter::convertYUV420Planar(
             src_v += src.mWidth / 2;
         }
 
-        dst_ptr += dst.mWidth;
+        dst_ptr += dst.mWidth * dstBpp;
     }
 
     return OK;
 }
 
 status_t ColorConverter::convertQCOMYUV420SemiPlanar(
-        const BitmapParams &src, const BitmapParams &dst) {
+        const BitmapParams &src, const BitmapParams &dst,
+        size_t firstRow, size_t numRows) {
     uint8_t *kAdjustedClip = initClip();
 
     if (!((src.mCropLeft & 1) == 0
@@ -357,8 +513,11 @@ status_t ColorConverter::convertQCOMYUV420SemiPlanar(
         return ERROR_UNSUPPORTED;
     }
 
-    uint16_t *dst_ptr = (uint16_t *)dst.mBits
-        + dst.mCropTop * dst.mWidth + dst.mCropLeft;
+    const bool argb = (mDstFormat == OMX_COLOR_Format32bitARGB8888);
+    const size_t dstBpp = argb ? 4 : 2;
+
+    uint8_t *dst_ptr = (uint8_t *)dst.mBits
+        + (dst.mCropTop * dst.mWidth + dst.mCropLeft) * dstBpp;
 
     const uint8_t *src_y =
         (const uint8_t *)src.mBits + src.mCropTop * src.mWidth + src.mCropLeft;
@@ -367,45 +526,14 @@ status_t ColorConverter::convertQCOMYUV420SemiPlanar(
         (const uint8_t *)src_y + src.mWidth * src.mHeight
         + src.mCropTop * src.mWidth + src.mCropLeft;
 
-    for (size_t y = 0; y < src.cropHeight(); ++y) {
-        for (size_t x = 0; x < src.cropWidth(); x += 2) {
-            signed y1 = (signed)src_y[x] - 16;
-            signed y2 = (signed)src_y[x + 1] - 16;
-
-            signed u = (signed)src_u[x & ~1] - 128;
-            signed v = (signed)src_u[(x & ~1) + 1] - 128;
-
-            signed u_b = u * 517;
-            signed u_g = -u * 100;
-            signed v_g = -v * 208;
-            signed v_r = v * 409;
-
-            signed tmp1 = y1 * 298;
-            signed b1 = (tmp1 + u_b) / 256;
-            signed g1 = (tmp1 + v_g + u_g) / 256;
-            signed r1 = (tmp1 + v_r) / 256;
-
-            signed tmp2 = y2 * 298;
-            signed b2 = (tmp2 + u_b) / 256;
-            signed g2 = (tmp2 + v_g + u_g) / 256;
-            signed r2 = (tmp2 + v_r) / 256;
+    src_y += firstRow * src.mWidth;
+    src_u += (firstRow / 2) * src.mWidth;
+    dst_ptr += firstRow * dst.mWidth * dstBpp;
 
-            uint32_t rgb1 =
-                ((kAdjustedClip[b1] >> 3) << 11)
-                | ((kAdjustedClip[g1] >> 2) << 5)
-                | (kAdjustedClip[r1] >> 3);
-
-            uint32_t rgb2 =
-                ((kAdjustedClip[b2] >> 3) << 11)
-                | ((kAdjustedClip[g2] >> 2) << 5)
-                | (kAdjustedClip[r2] >> 3);
-
-            if (x + 1 < src.cropWidth()) {
-                *(uint32_t *)(&dst_ptr[x]) = (rgb2 << 16) | rgb1;
-            } else {
-                dst_ptr[x] = rgb1;
-            }
-        }
+    for (size_t y = firstRow; y < firstRow + numRows; ++y) {
+        convertRow(
+                src_y, src_u, src_u + 1, 2 /* chromaStep */, true /* swapRB */,
+                kAdjustedClip, dst_ptr, argb, src.cropWidth());
 
         src_y += src.mWidth;
 
@@ -413,14 +541,15 @@ status_t ColorConverter::convertQCOMYUV420SemiPlanar(
             src_u += src.mWidth;
         }
 
-        dst_ptr += dst.mWidth;
+        dst_ptr += dst.mWidth * dstBpp;
     }
 
     return OK;
 }
 
 status_t ColorConverter::convertYUV420SemiPlanar(
-        const BitmapParams &src, const BitmapParams &dst) {
+        const BitmapParams &src, const BitmapParams &dst,
+        size_t firstRow, size_t numRows) {
     // XXX Untested
 
     uint8_t *kAdjustedClip = initClip();
@@ -431,8 +560,11 @@ status_t ColorConverter::convertYUV420SemiPlanar(
         return ERROR_UNSUPPORTED;
     }
 
-    uint16_t *dst_ptr = (uint16_t *)dst.mBits
-        + dst.mCropTop * dst.mWidth + dst.mCropLeft;
+    const bool argb = (mDstFormat == OMX_COLOR_Format32bitARGB8888);
+    const size_t dstBpp = argb ? 4 : 2;
+
+    uint8_t *dst_ptr = (uint8_t *)dst.mBits
+        + (dst.mCropTop * dst.mWidth + dst.mCropLeft) * dstBpp;
 
     const uint8_t *src_y =
         (const uint8_t *)src.mBits + src.mCropTop * src.mWidth + src.mCropLeft;
@@ -441,45 +573,15 @@ status_t ColorConverter::convertYUV420SemiPlanar(
         (const uint8_t *)src_y + src.mWidth * src.mHeight
         + src.mCropTop * src.mWidth + src.mCropLeft;
 
-    for (size_t y = 0; y < src.cropHeight(); ++y) {
-        for (size_t x = 0; x < src.cropWidth(); x += 2) {
-            signed y1 = (signed)src_y[x] - 16;
-            signed y2 = (signed)src_y[x + 1] - 16;
-
-            signed v = (signed)src_u[x & ~1] - 128;
-            signed u = (signed)src_u[(x & ~1) + 1] - 128;
-
-            signed u_b = u * 517;
-            signed u_g = -u * 100;
-            signed v_g = -v * 208;
-            signed v_r = v * 409;
-
-            signed tmp1 = y1 * 298;
-            signed b1 = (tmp1 + u_b) / 256;
-            signed g1 = (tmp1 + v_g + u_g) / 256;
-            signed r1 = (tmp1 + v_r) / 256;
-
-            signed tmp2 = y2 * 298;
-            signed b2 = (tmp2 + u_b) / 256;
-            signed g2 = (tmp2 + v_g + u_g) / 256;
-            signed r2 = (tmp2 + v_r) / 256;
-
-            uint32_t rgb1 =
-                ((kAdjustedClip[b1] >> 3) << 11)
-                | ((kAdjustedClip[g1] >> 2) << 5)
-                | (kAdjustedClip[r1] >> 3);
-
-            uint32_t rgb2 =
-                ((kAdjustedClip[b2] >> 3) << 11)
-                | ((kAdjustedClip[g2] >> 2) << 5)
-                | (kAdjustedClip[r2] >> 3);
+    src_y += firstRow * src.mWidth;
+    src_u += (firstRow / 2) * src.mWidth;
+    dst_ptr += firstRow * dst.mWidth * dstBpp;
 
-            if (x + 1 < src.cropWidth()) {
-                *(uint32_t *)(&dst_ptr[x]) = (rgb2 << 16) | rgb1;
-            } else {
-                dst_ptr[x] = rgb1;
-            }
-        }
+    for (size_t y = firstRow; y < firstRow + numRows; ++y) {
+        // V comes first in each chroma pair.
+        convertRow(
+                src_y, src_u + 1, src_u, 2 /* chromaStep */, true /* swapRB */,
+                kAdjustedClip, dst_ptr, argb, src.cropWidth());
 
         src_y += src.mWidth;
 
@@ -487,14 +589,15 @@ status_t ColorConverter::convertYUV420SemiPlanar(
             src_u += src.mWidth;
         }
 
-        dst_ptr += dst.mWidth;
+        dst_ptr += dst.mWidth * dstBpp;
     }
 
     return OK;
 }
 
 status_t ColorConverter::convertTIYUV420PackedSemiPlanar(
-        const BitmapParams &src, const BitmapParams &dst) {
+        const BitmapParams &src, const BitmapParams &dst,
+        size_t firstRow, size_t numRows) {
     uint8_t *kAdjustedClip = initClip();
 
     if (!((src.mCropLeft & 1) == 0
@@ -503,64 +606,342 @@ status_t ColorConverter::convertTIYUV420PackedSemiPlanar(
         return ERROR_UNSUPPORTED;
     }
 
-    uint16_t *dst_ptr = (uint16_t *)dst.mBits
-        + dst.mCropTop * dst.mWidth + dst.mCropLeft;
+    const bool argb = (mDstFormat == OMX_COLOR_Format32bitARGB8888);
+    const size_t dstBpp = argb ? 4 : 2;
+
+    uint8_t *dst_ptr = (uint8_t *)dst.mBits
+        + (dst.mCropTop * dst.mWidth + dst.mCropLeft) * dstBpp;
 
     const uint8_t *src_y = (const uint8_t *)src.mBits;
 
     const uint8_t *src_u =
         (const uint8_t *)src_y + src.mWidth * (src.mHeight - src.mCropTop / 2);
 
-    for (size_t y = 0; y < src.cropHeight(); ++y) {
-        for (size_t x = 0; x < src.cropWidth(); x += 2) {
-            signed y1 = (signed)src_y[x] - 16;
-            signed y2 = (signed)src_y[x + 1] - 16;
+    src_y += firstRow * src.mWidth;
+    src_u += (firstRow / 2) * src.mWidth;
+    dst_ptr += firstRow * dst.mWidth * dstBpp;
 
-            signed u = (signed)src_u[x & ~1] - 128;
-            signed v = (signed)src_u[(x & ~1) + 1] - 128;
+    for (size_t y = firstRow; y < firstRow + numRows; ++y) {
+        convertRow(
+                src_y, src_u, src_u + 1, 2 /* chromaStep */, false /* swapRB */,
+                kAdjustedClip, dst_ptr, argb, src.cropWidth());
 
-            signed u_b = u * 517;
-            signed u_g = -u * 100;
-            signed v_g = -v * 208;
-            signed v_r = v * 409;
+        src_y += src.mWidth;
 
-            signed tmp1 = y1 * 298;
-            signed b1 = (tmp1 + u_b) / 256;
-            signed g1 = (tmp1 + v_g + u_g) / 256;
-            signed r1 = (tmp1 + v_r) / 256;
+        if (y & 1) {
+            src_u += src.mWidth;
+        }
 
-            signed tmp2 = y2 * 298;
-            signed b2 = (tmp2 + u_b) / 256;
-            signed g2 = (tmp2 + v_g + u_g) / 256;
-            signed r2 = (tmp2 + v_r) / 256;
+        dst_ptr += dst.mWidth * dstBpp;
+    }
 
-            uint32_t rgb1 =
-                ((kAdjustedClip[r1] >> 3) << 11)
-                | ((kAdjustedClip[g1] >> 2) << 5)
-                | (kAdjustedClip[b1] >> 3);
+    return OK;
+}
 
-            uint32_t rgb2 =
-                ((kAdjustedClip[r2] >> 3) << 11)
-                | ((kAdjustedClip[g2] >> 2) << 5)
-                | (kAdjustedClip[b2] >> 3);
+void ColorConverter::getPlaneLayout(
+        const BitmapParams &src, PlaneLayout *layout) const {
+    // These mirror the pointer setup of the unscaled converters above.
+    const uint8_t *bits = (const uint8_t *)src.mBits;
+    const uint8_t *y = bits + src.mCropTop * src.mWidth + src.mCropLeft;
 
-            if (x + 1 < src.cropWidth()) {
-                *(uint32_t *)(&dst_ptr[x]) = (rgb2 << 16) | rgb1;
+    layout->mY = y;
+    layout->mLumaStride = src.mWidth;
+    layout->mChromaStride = src.mWidth;
+    layout->mChromaStep = 2;
+    layout->mSwapRB = true;
+
+    switch (mSrcFormat) {
+        case OMX_COLOR_FormatYUV420Planar:
+            layout->mU = y + src.mWidth * src.mHeight
+                + src.mCropTop * (src.mWidth / 2) + src.mCropLeft / 2;
+            layout->mV = layout->mU + (src.mWidth / 2) * (src.mHeight / 2);
+            layout->mChromaStride = src.mWidth / 2;
+            layout->mChromaStep = 1;
+            layout->mSwapRB = false;
+            break;
+
+        case OMX_QCOM_COLOR_FormatYVU420SemiPlanar:
+            layout->mU = y + src.mWidth * src.mHeight
+                + src.mCropTop * src.mWidth + src.mCropLeft;
+            layout->mV = layout->mU + 1;
+            break;
+
+        case OMX_COLOR_FormatYUV420SemiPlanar:
+            layout->mV = y + src.mWidth * src.mHeight
+                + src.mCropTop * src.mWidth + src.mCropLeft;
+            layout->mU = layout->mV + 1;
+            break;
+
+        case OMX_TI_COLOR_FormatYUV420PackedSemiPlanar:
+            layout->mY = bits;
+            layout->mU = bits + src.mWidth * (src.mHeight - src.mCropTop / 2);
+            layout->mV = layout->mU + 1;
+            layout->mSwapRB = false;
+            break;
+
+        default:
+            TRESPASS();
+    }
+}
+
+status_t ColorConverter::convertScaledYUV420(
+        const BitmapParams &src, const BitmapParams &dst,
+        size_t firstRow, size_t numRows) {
+    if ((src.mCropLeft & 1) != 0) {
+        return ERROR_UNSUPPORTED;
+    }
+
+    uint8_t *kAdjustedClip = initClip();
+
+    PlaneLayout planes;
+    getPlaneLayout(src, &planes);
+
+    const bool argb = (mDstFormat == OMX_COLOR_Format32bitARGB8888);
+    const size_t dstBpp = argb ? 4 : 2;
+
+    const size_t srcWidth = src.cropWidth();
+    const size_t srcHeight = src.cropHeight();
+    const size_t width = dst.cropWidth();
+    const size_t height = dst.cropHeight();
+    const size_t chromaWidth = (width + 1) / 2;
+
+    // Each destination pixel takes the source sample nearest to its centre.
+    // Both pixels of a pair share the chroma sample of the first one, just
+    // like in the unscaled conversion. The samples of a row are gathered
+    // into a planar one that convertRow handles as is, |row_y| has room for
+    // the second pixel of an odd width.
+    size_t *lumaColumns = new size_t[width + chromaWidth];
+    size_t *chromaColumns = lumaColumns + width;
+    uint8_t *row_y = new uint8_t[width + 1 + 2 * chromaWidth];
+    uint8_t *row_u = row_y + width + 1;
+    uint8_t *row_v = row_u + chromaWidth;
+
+    for (size_t x = 0; x < width; ++x) {
+        lumaColumns[x] = ((2 * x + 1) * srcWidth) / (2 * width);
+    }
+    for (size_t x = 0; x < chromaWidth; ++x) {
+        chromaColumns[x] = (lumaColumns[2 * x] / 2) * planes.mChromaStep;
+    }
+    row_y[width] = 0;
+
+    uint8_t *dst_ptr = (uint8_t *)dst.mBits
+        + ((dst.mCropTop + firstRow) * dst.mWidth + dst.mCropLeft) * dstBpp;
+
+    for (size_t y = firstRow; y < firstRow + numRows; ++y) {
+        const size_t srcRow = ((2 * y + 1) * srcHeight) / (2 * height);
+
+        const uint8_t *src_y = planes.mY + srcRow * planes.mLumaStride;
+        const uint8_t *src_u = planes.mU + (srcRow / 2) * planes.mChromaStride;
+        const uint8_t *src_v = planes.mV + (srcRow / 2) * planes.mChromaStride;
+
+        for (size_t x = 0; x < width; ++x) {
+            row_y[x] = src_y[lumaColumns[x]];
+        }
+        for (size_t x = 0; x < chromaWidth; ++x) {
+            row_u[x] = src_u[chromaColumns[x]];
+            row_v[x] = src_v[chromaColumns[x]];
+        }
+
+        convertRow(
+                row_y, row_u, row_v, 1 /* chromaStep */, planes.mSwapRB,
+                kAdjustedClip, dst_ptr, argb, width);
+
+        dst_ptr += dst.mWidth * dstBpp;
+    }
+
+    delete[] row_y;
+    row_y = NULL;
+
+    delete[] lumaColumns;
+    lumaColumns = NULL;
+
+    return OK;
+}
+
+#ifdef __ARM_NEON__
+// Shifts the 8 fixed point results down, packs them into bytes and
+// saturates them to 0..255, which is exactly what the clip table does.
+static inline uint8x8_t clampPixels(int32x4_t lo, int32x4_t hi) {
+    return vqmovun_s16(vcombine_s16(vqshrn_n_s32(lo, 8), vqshrn_n_s32(hi, 8)));
+}
+#endif
+
+// static
+void ColorConverter::convertRow(
+        const uint8_t *src_y, const uint8_t *src_u, const uint8_t *src_v,
+        size_t chromaStep, bool swapRB, const uint8_t *kAdjustedClip,
+        void *dstBits, bool argb, size_t width) {
+    size_t x = 0;
+
+#ifdef __ARM_NEON__
+    // 16 pixels and 8 chroma pairs per iteration using the same arithmetic as
+    // the scalar loop below. The arithmetic shift rounds towards minus
+    // infinity instead of zero, which only matters for negative values, and
+    // those clip to 0 either way, so the output is bit-exact.
+    const int16x8_t kBias16 = vdupq_n_s16(16);
+    const int16x8_t kBias128 = vdupq_n_s16(128);
+
+    for (; x + 16 <= width; x += 16) {
+        const uint8x16_t yRaw = vld1q_u8(src_y + x);
+
+        uint8x8_t uRaw, vRaw;
+        if (chromaStep == 1) {
+            uRaw = vld1_u8(src_u + x / 2);
+            vRaw = vld1_u8(src_v + x / 2);
+        } else if (src_u < src_v) {
+            const uint8x8x2_t uv = vld2_u8(src_u + x);
+            uRaw = uv.val[0];
+            vRaw = uv.val[1];
+        } else {
+            const uint8x8x2_t vu = vld2_u8(src_v + x);
+            vRaw = vu.val[0];
+            uRaw = vu.val[1];
+        }
+
+        const int16x8_t u = vsubq_s16(
+                vreinterpretq_s16_u16(vmovl_u8(uRaw)), kBias128);
+        const int16x8_t v = vsubq_s16(
+                vreinterpretq_s16_u16(vmovl_u8(vRaw)), kBias128);
+
+        const int16x8_t yLo = vsubq_s16(
+                vreinterpretq_s16_u16(vmovl_u8(vget_low_u8(yRaw))), kBias16);
+        const int16x8_t yHi = vsubq_s16(
+                vreinterpretq_s16_u16(vmovl_u8(vget_high_u8(yRaw))), kBias16);
+
+        const int32x4_t tmp[4] = {
+            vmull_n_s16(vget_low_s16(yLo), 298),
+            vmull_n_s16(vget_high_s16(yLo), 298),
+            vmull_n_s16(vget_low_s16(yHi), 298),
+            vmull_n_s16(vget_high_s16(yHi), 298),
+        };
+
+        for (size_t half = 0; half < 2; ++half) {
+            const int16x4_t u4 = half ? vget_high_s16(u) : vget_low_s16(u);
+            const int16x4_t v4 = half ? vget_high_s16(v) : vget_low_s16(v);
+
+            // Each chroma term is shared by a pair of pixels.
+            const int32x4_t u_b = vmull_n_s16(u4, 517);
+            const int32x4_t uv_g =
+                vmlal_n_s16(vmull_n_s16(u4, -100), v4, -208);
+            const int32x4_t v_r = vmull_n_s16(v4, 409);
+
+            const int32x4x2_t u_b2 = vzipq_s32(u_b, u_b);
+            const int32x4x2_t uv_g2 = vzipq_s32(uv_g, uv_g);
+            const int32x4x2_t v_r2 = vzipq_s32(v_r, v_r);
+
+            const int32x4_t tmp1 = tmp[2 * half];
+            const int32x4_t tmp2 = tmp[2 * half + 1];
+
+            uint8x8_t b = clampPixels(
+                    vaddq_s32(tmp1, u_b2.val[0]), vaddq_s32(tmp2, u_b2.val[1]));
+            const uint8x8_t g = clampPixels(
+                    vaddq_s32(tmp1, uv_g2.val[0]), vaddq_s32(tmp2, uv_g2.val[1]));
+            uint8x8_t r = clampPixels(
+                    vaddq_s32(tmp1, v_r2.val[0]), vaddq_s32(tmp2, v_r2.val[1]));
+
+            if (swapRB) {
+                const uint8x8_t t = r;
+                r = b;
+                b = t;
+            }
+
+            if (argb) {
+                uint8x8x4_t pixels;
+                pixels.val[0] = b;
+                pixels.val[1] = g;
+                pixels.val[2] = r;
+                pixels.val[3] = vdup_n_u8(0xff);
+                vst4_u8((uint8_t *)dstBits + (x + 8 * half) * 4, pixels);
             } else {
-                dst_ptr[x] = rgb1;
+                uint16x8_t pixels = vshll_n_u8(r, 8);
+                pixels = vsriq_n_u16(pixels, vshll_n_u8(g, 8), 5);
+                pixels = vsriq_n_u16(pixels, vshll_n_u8(b, 8), 11);
+                vst1q_u16((uint16_t *)dstBits + x + 8 * half, pixels);
             }
         }
+    }
+#endif
 
-        src_y += src.mWidth;
+    for (; x < width; x += 2) {
+        // B = 1.164 * (Y - 16) + 2.018 * (U - 128)
+        // G = 1.164 * (Y - 16) - 0.813 * (V - 128) - 0.391 * (U - 128)
+        // R = 1.164 * (Y - 16) + 1.596 * (V - 128)
 
-        if (y & 1) {
-            src_u += src.mWidth;
+        // B = 298/256 * (Y - 16) + 517/256 * (U - 128)
+        // G = .................. - 208/256 * (V - 128) - 100/256 * (U - 128)
+        // R = .................. + 409/256 * (V - 128)
+
+        // min_B = (298 * (- 16) + 517 * (- 128)) / 256 = -277
+        // min_G = (298 * (- 16) - 208 * (255 - 128) - 100 * (255 - 128)) / 256 = -172
+        // min_R = (298 * (- 16) + 409 * (- 128)) / 256 = -223
+
+        // max_B = (298 * (255 - 16) + 517 * (255 - 128)) / 256 = 534
+        // max_G = (298 * (255 - 16) - 208 * (- 128) - 100 * (- 128)) / 256 = 432
+        // max_R = (298 * (255 - 16) + 409 * (255 - 128)) / 256 = 481
+
+        // clip range -278 .. 535
+
+        signed y1 = (signed)src_y[x] - 16;
+        signed y2 = (signed)src_y[x + 1] - 16;
+
+        signed u = (signed)src_u[(x / 2) * chromaStep] - 128;
+        signed v = (signed)src_v[(x / 2) * chromaStep] - 128;
+
+        signed u_b = u * 517;
+        signed u_g = -u * 100;
+        signed v_g = -v * 208;
+        signed v_r = v * 409;
+
+        signed tmp1 = y1 * 298;
+        signed b1 = (tmp1 + u_b) / 256;
+        signed g1 = (tmp1 + v_g + u_g) / 256;
+        signed r1 = (tmp1 + v_r) / 256;
+
+        signed tmp2 = y2 * 298;
+        signed b2 = (tmp2 + u_b) / 256;
+        signed g2 = (tmp2 + v_g + u_g) / 256;
+        signed r2 = (tmp2 + v_r) / 256;
+
+        if (swapRB) {
+            signed t = r1; r1 = b1; b1 = t;
+            t = r2; r2 = b2; b2 = t;
         }
 
-        dst_ptr += dst.mWidth;
-    }
+        if (argb) {
+            uint32_t *dst_ptr = (uint32_t *)dstBits;
 
-    return OK;
+            dst_ptr[x] = 0xff000000
+                | (kAdjustedClip[r1] << 16)
+                | (kAdjustedClip[g1] << 8)
+                | kAdjustedClip[b1];
+
+            if (x + 1 < width) {
+                dst_ptr[x + 1] = 0xff000000
+                    | (kAdjustedClip[r2] << 16)
+                    | (kAdjustedClip[g2] << 8)
+                    | kAdjustedClip[b2];
+            }
+            continue;
+        }
+
+        uint16_t *dst_ptr = (uint16_t *)dstBits;
+
+        uint32_t rgb1 =
+            ((kAdjustedClip[r1] >> 3) << 11)
+            | ((kAdjustedClip[g1] >> 2) << 5)
+            | (kAdjustedClip[b1] >> 3);
+
+        uint32_t rgb2 =
+            ((kAdjustedClip[r2] >> 3) << 11)
+            | ((kAdjustedClip[g2] >> 2) << 5)
+            | (kAdjustedClip[b2] >> 3);
+
+        if (x + 1 < width) {
+            *(uint32_t *)(&dst_ptr[x]) = (rgb2 << 16) | rgb1;
+        } else {
+            dst_ptr[x] = rgb1;
+        }
+    }
 }
 
 uint8_t *ColorConverter::initClip() {
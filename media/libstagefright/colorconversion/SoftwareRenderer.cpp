@@ -38,6 +38,15 @@ static bool runningInEmulator() {
     return (property_get("ro.kernel.qemu", prop, NULL) > 0);
 }
 
+// Semi-planar decoder output is normally converted to RGB565. If this is set
+// it is handed to the window as YUV instead, provided the window can
+// allocate buffers in that format.
+static bool directYUVRenderingEnabled() {
+    char prop[PROPERTY_VALUE_MAX];
+    return property_get("media.stagefright.sw-render-yuv", prop, NULL) > 0
+        && (!strcmp(prop, "1") || !strcasecmp(prop, "true"));
+}
+
 SoftwareRenderer::SoftwareRenderer(
         const sp<ANativeWindow> &nativeWindow, const sp<MetaData> &meta)
     : mConverter(NULL),
@@ -69,6 +78,16 @@ SoftwareRenderer::SoftwareRenderer(
     int halFormat;
     size_t bufWidth, bufHeight;
 
+    if (directYUVRenderingEnabled() && !runningInEmulator()) {
+        if (mColorFormat == OMX_COLOR_FormatYUV420SemiPlanar) {
+            mYUVMode = DeinterleaveToYV12;
+#ifndef QCOM_LEGACY_OMX
+        } else if (mColorFormat == OMX_QCOM_COLOR_FormatYVU420SemiPlanar) {
+            mYUVMode = CopyToYCrCb420SP;
+#endif
+        }
+    }
+
     switch (mColorFormat) {
 #ifndef MISSING_EGL_PIXEL_FORMAT_YV12
         case OMX_COLOR_FormatYUV420Planar:
@@ -95,6 +114,21 @@ SoftwareRenderer::SoftwareRenderer(
             break;
         }
 #endif
+        case OMX_COLOR_FormatYUV420SemiPlanar:
+#ifndef QCOM_LEGACY_OMX
+        case OMX_QCOM_COLOR_FormatYVU420SemiPlanar:
+#endif
+        {
+            if (mYUVMode != None) {
+                halFormat = (mYUVMode == DeinterleaveToYV12)
+                    ? HAL_PIXEL_FORMAT_YV12 : HAL_PIXEL_FORMAT_YCrCb_420_SP;
+                bufWidth = (mCropWidth + 1) & ~1;
+                bufHeight = (mCropHeight + 1) & ~1;
+                break;
+            }
+
+            // fall through.
+        }
 
         default:
             halFormat = HAL_PIXEL_FORMAT_RGB_565;
@@ -143,6 +177,22 @@ SoftwareRenderer::SoftwareRenderer(
                 bufHeight,
                 halFormat));
 
+    if (mYUVMode != None && !canAllocateBuffers()) {
+        ALOGI("native window can't take YUV format 0x%x, converting to RGB565",
+              halFormat);
+
+        mYUVMode = None;
+        mConverter = new ColorConverter(
+                mColorFormat, OMX_COLOR_Format16bitRGB565);
+        CHECK(mConverter->isValid());
+
+        CHECK_EQ(0, native_window_set_buffers_geometry(
+                    mNativeWindow.get(),
+                    mCropWidth,
+                    mCropHeight,
+                    HAL_PIXEL_FORMAT_RGB_565));
+    }
+
     uint32_t transform;
     switch (rotationDegrees) {
         case 0: transform = 0; break;
@@ -163,6 +213,20 @@ SoftwareRenderer::~SoftwareRenderer() {
     mConverter = NULL;
 }
 
+bool SoftwareRenderer::canAllocateBuffers() {
+    // Buffers are only allocated in the requested format once one is
+    // dequeued, so that's the only way to find out whether the window
+    // supports it.
+    ANativeWindowBuffer *buf;
+    if (mNativeWindow->dequeueBuffer(mNativeWindow.get(), &buf) != 0) {
+        return false;
+    }
+
+    mNativeWindow->cancelBuffer(mNativeWindow.get(), buf);
+
+    return true;
+}
+
 static int ALIGN(int x, int y) {
     // y must be a power of 2.
     return (x + y - 1) & ~(y - 1);
@@ -195,6 +259,60 @@ void SoftwareRenderer::render(
                 dst,
                 buf->stride, buf->height,
                 0, 0, mCropWidth - 1, mCropHeight - 1);
+    } else if (mYUVMode == DeinterleaveToYV12) {
+        const uint8_t *src_y = (const uint8_t *)data
+            + mCropTop * mWidth + mCropLeft;
+        const uint8_t *src_uv = (const uint8_t *)data + mWidth * mHeight
+            + (mCropTop / 2) * mWidth + (mCropLeft & ~1);
+
+        uint8_t *dst_y = (uint8_t *)dst;
+        size_t dst_y_size = buf->stride * buf->height;
+        size_t dst_c_stride = ALIGN(buf->stride / 2, 16);
+        size_t dst_c_size = dst_c_stride * buf->height / 2;
+        uint8_t *dst_v = dst_y + dst_y_size;
+        uint8_t *dst_u = dst_v + dst_c_size;
+
+        for (int y = 0; y < mCropHeight; ++y) {
+            memcpy(dst_y, src_y, mCropWidth);
+
+            src_y += mWidth;
+            dst_y += buf->stride;
+        }
+
+        for (int y = 0; y < (mCropHeight + 1) / 2; ++y) {
+            size_t tmp = (mCropWidth + 1) / 2;
+            for (size_t x = 0; x < tmp; ++x) {
+                dst_u[x] = src_uv[2 * x];
+                dst_v[x] = src_uv[2 * x + 1];
+            }
+
+            src_uv += mWidth;
+            dst_u += dst_c_stride;
+            dst_v += dst_c_stride;
+        }
+    } else if (mYUVMode == CopyToYCrCb420SP) {
+        // Same layout on both sides, only the strides differ.
+        const uint8_t *src_y = (const uint8_t *)data
+            + mCropTop * mWidth + mCropLeft;
+        const uint8_t *src_vu = (const uint8_t *)data + mWidth * mHeight
+            + (mCropTop / 2) * mWidth + (mCropLeft & ~1);
+
+        uint8_t *dst_y = (uint8_t *)dst;
+        uint8_t *dst_vu = dst_y + buf->stride * buf->height;
+
+        for (int y = 0; y < mCropHeight; ++y) {
+            memcpy(dst_y, src_y, mCropWidth);
+
+            src_y += mWidth;
+            dst_y += buf->stride;
+        }
+
+        for (int y = 0; y < (mCropHeight + 1) / 2; ++y) {
+            memcpy(dst_vu, src_vu, (mCropWidth + 1) & ~1);
+
+            src_vu += mWidth;
+            dst_vu += buf->stride;
+        }
     } else if (mColorFormat == OMX_COLOR_FormatYUV420Planar) {
         const uint8_t *src_y = (const uint8_t *)data;
         const uint8_t *src_u = (const uint8_t *)data + mWidth * mHeight;
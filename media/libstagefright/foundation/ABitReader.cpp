@@ -27,67 +27,122 @@ ABitReader::ABitReader(const uint8_t *data, size_t size)
       mNumBitsLeft(0) {
 }
 
+// Tops the reservoir up with as many whole bytes as fit, 8 at a time when
+// the reservoir is empty and that much data is left.
 void ABitReader::fillReservoir() {
     CHECK_GT(mSize, 0u);
 
-    mReservoir = 0;
-    size_t i;
-    for (i = 0; mSize > 0 && i < 4; ++i) {
-        mReservoir = (mReservoir << 8) | *mData;
+    size_t numBytes = (64 - mNumBitsLeft) / 8;
+    if (numBytes > mSize) {
+        numBytes = mSize;
+    }
 
-        ++mData;
-        --mSize;
+    uint64_t x;
+    if (numBytes == 8) {
+        x = ((uint64_t)mData[0] << 56) | ((uint64_t)mData[1] << 48)
+            | ((uint64_t)mData[2] << 40) | ((uint64_t)mData[3] << 32)
+            | ((uint64_t)mData[4] << 24) | ((uint64_t)mData[5] << 16)
+            | ((uint64_t)mData[6] << 8) | (uint64_t)mData[7];
+    } else {
+        x = 0;
+        for (size_t i = 0; i < numBytes; ++i) {
+            x = (x << 8) | mData[i];
+        }
+        x <<= 64 - 8 * numBytes;
     }
 
-    mNumBitsLeft = 8 * i;
-    mReservoir <<= 32 - mNumBitsLeft;
+    mReservoir |= x >> mNumBitsLeft;
+    mNumBitsLeft += 8 * numBytes;
+
+    mData += numBytes;
+    mSize -= numBytes;
 }
 
-uint32_t ABitReader::getBits(size_t n) {
+uint32_t ABitReader::getBitsSlow(size_t n) {
     CHECK_LE(n, 32u);
 
-    uint32_t result = 0;
-    while (n > 0) {
-        if (mNumBitsLeft == 0) {
-            fillReservoir();
-        }
+    if (n == 0) {
+        return 0;
+    }
 
-        size_t m = n;
-        if (m > mNumBitsLeft) {
-            m = mNumBitsLeft;
-        }
+    // take what is left in the reservoir, then the rest after a refill
+    size_t m = mNumBitsLeft;
+    uint64_t result = (m > 0) ? mReservoir >> (64 - m) : 0;
+    mReservoir = 0;
+    mNumBitsLeft = 0;
+    n -= m;
 
-        result = (result << m) | (mReservoir >> (32 - m));
-        mReservoir <<= m;
-        mNumBitsLeft -= m;
+    fillReservoir();
+    CHECK_LE(n, mNumBitsLeft);
 
-        n -= m;
-    }
+    result = (result << n) | (mReservoir >> (64 - n));
+    mReservoir <<= n;
+    mNumBitsLeft -= n;
 
     return result;
 }
 
-void ABitReader::skipBits(size_t n) {
-    while (n > 32) {
-        getBits(32);
-        n -= 32;
-    }
+void ABitReader::skipBitsSlow(size_t n) {
+    n -= mNumBitsLeft;
+    mReservoir = 0;
+    mNumBitsLeft = 0;
+
+    // whole bytes are skipped without going through the reservoir
+    size_t numBytes = n / 8;
+    CHECK_LE(numBytes, mSize);
+    mData += numBytes;
+    mSize -= numBytes;
 
+    n %= 8;
     if (n > 0) {
-        getBits(n);
+        fillReservoir();
+
+        mReservoir <<= n;
+        mNumBitsLeft -= n;
     }
 }
 
+uint32_t ABitReader::getUE() {
+    // A code which the reservoir holds entirely is decoded at once, its
+    // leading zeroes counted with clz; the bits past mNumBitsLeft are 0.
+    if (mReservoir != 0) {
+        size_t numZeroes = __builtin_clzll(mReservoir);
+        size_t codeLength = 2 * numZeroes + 1;
+        if (numZeroes < 32 && codeLength <= mNumBitsLeft) {
+            uint64_t code = mReservoir >> (64 - codeLength);
+            mReservoir <<= codeLength;
+            mNumBitsLeft -= codeLength;
+
+            return code - 1;
+        }
+    }
+
+    unsigned numZeroes = 0;
+    while (getBits(1) == 0) {
+        ++numZeroes;
+    }
+
+    uint32_t x = getBits(numZeroes);
+
+    return x + (1u << numZeroes) - 1;
+}
+
 void ABitReader::putBits(uint32_t x, size_t n) {
     CHECK_LE(n, 32u);
 
-    while (mNumBitsLeft + n > 32) {
+    if (n == 0) {
+        return;
+    }
+
+    // bytes pushed out of the reservoir are returned to the data
+    while (mNumBitsLeft + n > 64) {
         mNumBitsLeft -= 8;
         --mData;
         ++mSize;
     }
+    mReservoir &= ~(~0ull >> mNumBitsLeft);
 
-    mReservoir = (mReservoir >> n) | (x << (32 - n));
+    mReservoir = (mReservoir >> n) | ((uint64_t)x << (64 - n));
     mNumBitsLeft += n;
 }
 
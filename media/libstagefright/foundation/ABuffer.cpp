@@ -61,6 +61,16 @@ void ABuffer::setRange(size_t offset, size_t size) {
     mRangeLength = size;
 }
 
+sp<ABuffer> ABuffer::slice(size_t offset, size_t size) {
+    CHECK_LE(offset, mRangeLength);
+    CHECK_LE(offset + size, mRangeLength);
+
+    sp<ABuffer> buffer = new ABuffer(data() + offset, size);
+    buffer->mBacking = (mBacking != NULL) ? mBacking : this;
+
+    return buffer;
+}
+
 void ABuffer::setFarewellMessage(const sp<AMessage> msg) {
     mFarewell = msg;
 }
@@ -0,0 +1,232 @@
+/*
+ * Copyright (C) 2012 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "AConfigCache"
+#include <utils/Log.h>
+
+#include "AConfigCache.h"
+
+#include "ADebug.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace android {
+
+// Words in front of the payload, followed by the source path:
+// magic, source mtime (low, high), source size (low, high)
+static const size_t kNumHeaderWords = 5;
+
+static void appendString(Vector<uint32_t> *data, const char *s) {
+    size_t length = strlen(s);
+    data->push((uint32_t)length);
+
+    size_t offset = data->size();
+    data->insertAt((uint32_t)0, offset, (length + 3) / 4);
+    memcpy(data->editArray() + offset, s, length);
+}
+
+AConfigCacheWriter::AConfigCacheWriter(uint32_t magic)
+    : mMagic(magic) {
+}
+
+void AConfigCacheWriter::writeInt32(int32_t value) {
+    mData.push((uint32_t)value);
+}
+
+void AConfigCacheWriter::writeString(const char *s) {
+    appendString(&mData, s);
+}
+
+static bool writeFully(int fd, const void *data, size_t size) {
+    const uint8_t *ptr = (const uint8_t *)data;
+    while (size > 0) {
+        ssize_t n = write(fd, ptr, size);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        } else if (n <= 0) {
+            return false;
+        }
+        ptr += n;
+        size -= n;
+    }
+    return true;
+}
+
+status_t AConfigCacheWriter::commit(const char *cachePath, const char *sourcePath) {
+    struct stat st;
+    if (stat(sourcePath, &st) != 0) {
+        return -errno;
+    }
+
+    Vector<uint32_t> header;
+    header.push(mMagic);
+    header.push((uint32_t)((uint64_t)st.st_mtime));
+    header.push((uint32_t)((uint64_t)st.st_mtime >> 32));
+    header.push((uint32_t)((uint64_t)st.st_size));
+    header.push((uint32_t)((uint64_t)st.st_size >> 32));
+    appendString(&header, sourcePath);
+    header.push(mData.size());
+
+    AString tmpPath = cachePath;
+    tmpPath.append(".tmp");
+
+    int fd = open(tmpPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        status_t err = -errno;
+        ALOGV("unable to create %s (%s)", tmpPath.c_str(), strerror(errno));
+        return err;
+    }
+
+    // Readable by every process that parses the configuration file, not
+    // just by the one that happened to write the snapshot.
+    fchmod(fd, 0644);
+
+    bool success =
+        writeFully(fd, header.array(), header.size() * sizeof(uint32_t))
+        && writeFully(fd, mData.array(), mData.size() * sizeof(uint32_t));
+
+    if (close(fd) != 0) {
+        success = false;
+    }
+
+    if (!success || rename(tmpPath.c_str(), cachePath) != 0) {
+        ALOGW("unable to write %s", cachePath);
+        unlink(tmpPath.c_str());
+        return UNKNOWN_ERROR;
+    }
+
+    ALOGV("wrote snapshot of %s to %s", sourcePath, cachePath);
+
+    return OK;
+}
+
+AConfigCacheReader::AConfigCacheReader()
+    : mBase(MAP_FAILED),
+      mSize(0),
+      mData(NULL),
+      mNumWords(0),
+      mOffset(0),
+      mStatus(NO_INIT) {
+}
+
+AConfigCacheReader::~AConfigCacheReader() {
+    if (mBase != MAP_FAILED) {
+        munmap(mBase, mSize);
+        mBase = MAP_FAILED;
+    }
+}
+
+status_t AConfigCacheReader::open(
+        const char *cachePath, const char *sourcePath, uint32_t magic) {
+    CHECK(mBase == MAP_FAILED);
+
+    struct stat st;
+    if (stat(sourcePath, &st) != 0) {
+        return -errno;
+    }
+
+    int fd = ::open(cachePath, O_RDONLY);
+    if (fd < 0) {
+        return -errno;
+    }
+
+    struct stat cacheSt;
+    if (fstat(fd, &cacheSt) != 0
+            || cacheSt.st_size < (off_t)((kNumHeaderWords + 2) * sizeof(uint32_t))
+            || (cacheSt.st_size % sizeof(uint32_t)) != 0) {
+        ::close(fd);
+        return BAD_VALUE;
+    }
+
+    mSize = cacheSt.st_size;
+    mBase = mmap(NULL, mSize, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+
+    if (mBase == MAP_FAILED) {
+        return -errno;
+    }
+
+    mData = (const uint32_t *)mBase;
+    mNumWords = mSize / sizeof(uint32_t);
+    mOffset = 0;
+    mStatus = OK;
+
+    // Until the header checks out, reads only look at the header.
+    uint32_t fileMagic = readInt32();
+    uint64_t mtime = (uint32_t)readInt32();
+    mtime |= (uint64_t)(uint32_t)readInt32() << 32;
+    uint64_t size = (uint32_t)readInt32();
+    size |= (uint64_t)(uint32_t)readInt32() << 32;
+    AString path = readString();
+    size_t numWords = (uint32_t)readInt32();
+
+    if (mStatus != OK
+            || fileMagic != magic
+            || mtime != (uint64_t)st.st_mtime
+            || size != (uint64_t)st.st_size
+            || strcmp(path.c_str(), sourcePath)
+            || numWords != mNumWords - mOffset) {
+        ALOGV("%s is not a snapshot of the current %s", cachePath, sourcePath);
+        mStatus = BAD_VALUE;
+        return mStatus;
+    }
+
+    return OK;
+}
+
+int32_t AConfigCacheReader::readInt32() {
+    if (mStatus != OK || mOffset >= mNumWords) {
+        mStatus = NOT_ENOUGH_DATA;
+        return 0;
+    }
+
+    return (int32_t)mData[mOffset++];
+}
+
+AString AConfigCacheReader::readString() {
+    size_t length = (uint32_t)readInt32();
+    size_t numWords = (length + 3) / 4;
+
+    if (mStatus != OK || length > mNumWords * sizeof(uint32_t)
+            || numWords > mNumWords - mOffset) {
+        mStatus = NOT_ENOUGH_DATA;
+        return AString();
+    }
+
+    AString s((const char *)&mData[mOffset], length);
+    mOffset += numWords;
+
+    return s;
+}
+
+size_t AConfigCacheReader::readCount(size_t itemSize) {
+    size_t count = (uint32_t)readInt32();
+
+    if (mStatus != OK || (itemSize > 0 && count > (mNumWords - mOffset) / itemSize)) {
+        mStatus = NOT_ENOUGH_DATA;
+        return 0;
+    }
+
+    return count;
+}
+
+}  // namespace android
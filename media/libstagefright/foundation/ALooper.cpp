@@ -51,6 +51,10 @@ struct ALooper::LooperThread : public Thread {
         return mThreadId == androidGetThreadId();
     }
 
+    bool isExitPending() const {
+        return exitPending();
+    }
+
 protected:
     virtual ~LooperThread() {}
 
@@ -70,7 +74,8 @@ int64_t ALooper::GetNowUs() {
 }
 
 ALooper::ALooper()
-    : mRunningLocally(false) {
+    : mNextSequence(0),
+      mRunningLocally(false) {
 }
 
 ALooper::~ALooper() {
@@ -167,24 +172,28 @@ void ALooper::post(const sp<AMessage> &msg, int64_t delayUs) {
         whenUs = GetNowUs();
     }
 
-    List<Event>::iterator it = mEventQueue.begin();
-    while (it != mEventQueue.end() && (*it).mWhenUs <= whenUs) {
-        ++it;
-    }
-
     Event event;
     event.mWhenUs = whenUs;
+    event.mSequence = mNextSequence++;
     event.mMessage = msg;
 
-    if (it == mEventQueue.begin()) {
+    pushEvent_l(event);
+
+    if (mEventQueue[0].mSequence == event.mSequence) {
         mQueueChangedCondition.signal();
     }
-
-    mEventQueue.insert(it, event);
 }
 
 bool ALooper::loop() {
-    Event event;
+    struct Delivery {
+        sp<AHandler> mHandler;
+        sp<AMessage> mMessage;
+        int64_t mWhenUs;
+    };
+
+    Delivery deliveries[kMaxNumEventsPerLoop];
+    size_t numDeliveries = 0;
+    sp<LooperThread> thread;
 
     {
         Mutex::Autolock autoLock(mLock);
@@ -195,7 +204,7 @@ bool ALooper::loop() {
             mQueueChangedCondition.wait(mLock);
             return true;
         }
-        int64_t whenUs = (*mEventQueue.begin()).mWhenUs;
+        int64_t whenUs = mEventQueue[0].mWhenUs;
         int64_t nowUs = GetNowUs();
 
         if (whenUs > nowUs) {
@@ -205,18 +214,151 @@ bool ALooper::loop() {
             return true;
         }
 
-        event = *mEventQueue.begin();
-        mEventQueue.erase(mEventQueue.begin());
+        while (numDeliveries < kMaxNumEventsPerLoop
+                && !mEventQueue.empty() && mEventQueue[0].mWhenUs <= nowUs) {
+            Event event;
+            popEvent_l(&event);
+
+            sp<AHandler> handler = findHandler_l(event.mMessage->target());
+            if (handler == NULL) {
+                continue;
+            }
+
+            deliveries[numDeliveries].mHandler = handler;
+            deliveries[numDeliveries].mMessage = event.mMessage;
+            deliveries[numDeliveries].mWhenUs = event.mWhenUs;
+            ++numDeliveries;
+        }
+
+        thread = mThread;
     }
 
-    gLooperRoster.deliverMessage(event.mMessage);
+    // NOTE: It's important to note that once the first message has been
+    // delivered our "ALooper" object may no longer exist (its final
+    // reference may have gone away while delivering the message). We have
+    // made sure, however, that loop() won't be called again, and the rest
+    // of the batch is dropped once the looper thread has been asked to exit.
 
-    // NOTE: It's important to note that at this point our "ALooper" object
-    // may no longer exist (its final reference may have gone away while
-    // delivering the message). We have made sure, however, that loop()
-    // won't be called again.
+    for (size_t i = 0; i < numDeliveries; ++i) {
+        Delivery *delivery = &deliveries[i];
+
+        if (thread != NULL && thread->isExitPending()) {
+            break;
+        }
+
+        // The handler may have been unregistered by an earlier delivery.
+        handler_id handlerID = delivery->mMessage->target();
+        if (delivery->mHandler->id() != handlerID) {
+            // Dropped below.
+        } else if (gLooperRoster.statsEnabled()) {
+            uint32_t what = delivery->mMessage->what();
+            int64_t startUs = GetNowUs();
+
+            delivery->mHandler->onMessageReceived(delivery->mMessage);
+
+            gLooperRoster.recordLatency(
+                    handlerID, what,
+                    startUs - delivery->mWhenUs, GetNowUs() - startUs);
+        } else {
+            delivery->mHandler->onMessageReceived(delivery->mMessage);
+        }
+
+        delivery->mHandler.clear();
+        delivery->mMessage.clear();
+    }
 
     return true;
 }
 
+void ALooper::addHandler(
+        handler_id handlerID, const wp<AHandler> &handler) {
+    Mutex::Autolock autoLock(mLock);
+    mHandlers.add(handlerID, handler);
+}
+
+void ALooper::removeHandler(handler_id handlerID) {
+    Mutex::Autolock autoLock(mLock);
+    mHandlers.removeItem(handlerID);
+}
+
+sp<AHandler> ALooper::findHandler_l(handler_id handlerID) {
+    ssize_t index = mHandlers.indexOfKey(handlerID);
+
+    if (index < 0) {
+        ALOGW("failed to deliver message. Target handler not registered.");
+        return NULL;
+    }
+
+    sp<AHandler> handler = mHandlers.valueAt(index).promote();
+
+    if (handler == NULL) {
+        ALOGW("failed to deliver message. "
+             "Target handler %d registered, but object gone.",
+             handlerID);
+
+        mHandlers.removeItemsAt(index);
+    }
+
+    return handler;
+}
+
+// static
+bool ALooper::EventBefore(const Event &a, const Event &b) {
+    if (a.mWhenUs != b.mWhenUs) {
+        return a.mWhenUs < b.mWhenUs;
+    }
+
+    return a.mSequence < b.mSequence;
+}
+
+void ALooper::pushEvent_l(const Event &event) {
+    size_t i = mEventQueue.add(event);
+
+    while (i > 0) {
+        size_t parent = (i - 1) / 2;
+        if (!EventBefore(event, mEventQueue[parent])) {
+            break;
+        }
+
+        mEventQueue.editItemAt(i) = mEventQueue[parent];
+        i = parent;
+    }
+
+    mEventQueue.editItemAt(i) = event;
+}
+
+void ALooper::popEvent_l(Event *event) {
+    *event = mEventQueue[0];
+
+    Event last = mEventQueue.top();
+    mEventQueue.pop();
+
+    size_t n = mEventQueue.size();
+    if (n == 0) {
+        return;
+    }
+
+    size_t i = 0;
+    for (;;) {
+        size_t child = 2 * i + 1;
+        if (child >= n) {
+            break;
+        }
+
+        if (child + 1 < n
+                && EventBefore(mEventQueue[child + 1], mEventQueue[child])) {
+            ++child;
+        }
+
+        if (!EventBefore(mEventQueue[child], last)) {
+            break;
+        }
+
+        mEventQueue.editItemAt(i) = mEventQueue[child];
+        i = child;
+    }
+
+    mEventQueue.editItemAt(i) = last;
+}
+
 }  // namespace android
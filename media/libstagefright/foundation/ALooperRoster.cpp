@@ -20,15 +20,29 @@
 
 #include "ALooperRoster.h"
 
+#include <ctype.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <cutils/properties.h>
+
 #include "ADebug.h"
 #include "AHandler.h"
 #include "AMessage.h"
+#include "AString.h"
 
 namespace android {
 
+static bool LooperStatsEnabled() {
+    char value[PROPERTY_VALUE_MAX];
+    return property_get("media.stagefright.looper-stats", value, NULL)
+        && (!strcmp(value, "1") || !strcasecmp(value, "true"));
+}
+
 ALooperRoster::ALooperRoster()
     : mNextHandlerID(1),
-      mNextReplyID(1) {
+      mNextReplyID(1),
+      mStatsEnabled(LooperStatsEnabled()) {
 }
 
 ALooper::handler_id ALooperRoster::registerHandler(
@@ -46,6 +60,7 @@ ALooper::handler_id ALooperRoster::registerHandler(
     ALooper::handler_id handlerID = mNextHandlerID++;
     mHandlers.add(handlerID, info);
 
+    looper->addHandler(handlerID, handler);
     handler->setID(handlerID);
 
     return handlerID;
@@ -68,6 +83,12 @@ void ALooperRoster::unregisterHandler(ALooper::handler_id handlerID) {
         handler->setID(0);
     }
 
+    sp<ALooper> looper = info.mLooper.promote();
+
+    if (looper != NULL) {
+        looper->removeHandler(handlerID);
+    }
+
     mHandlers.removeItemsAt(index);
 }
 
@@ -104,35 +125,6 @@ status_t ALooperRoster::postMessage_l(
     return OK;
 }
 
-void ALooperRoster::deliverMessage(const sp<AMessage> &msg) {
-    sp<AHandler> handler;
-
-    {
-        Mutex::Autolock autoLock(mLock);
-
-        ssize_t index = mHandlers.indexOfKey(msg->target());
-
-        if (index < 0) {
-            ALOGW("failed to deliver message. Target handler not registered.");
-            return;
-        }
-
-        const HandlerInfo &info = mHandlers.valueAt(index);
-        handler = info.mHandler.promote();
-
-        if (handler == NULL) {
-            ALOGW("failed to deliver message. "
-                 "Target handler %d registered, but object gone.",
-                 msg->target());
-
-            mHandlers.removeItemsAt(index);
-            return;
-        }
-    }
-
-    handler->onMessageReceived(msg);
-}
-
 sp<ALooper> ALooperRoster::findLooper(ALooper::handler_id handlerID) {
     Mutex::Autolock autoLock(mLock);
 
@@ -186,4 +178,138 @@ void ALooperRoster::postReply(uint32_t replyID, const sp<AMessage> &reply) {
     mRepliesCondition.broadcast();
 }
 
+ALooperRoster::LatencyHistogram::LatencyHistogram()
+    : mCount(0),
+      mTotalUs(0),
+      mMaxUs(0) {
+    memset(mBuckets, 0, sizeof(mBuckets));
+}
+
+void ALooperRoster::LatencyHistogram::add(int64_t valueUs) {
+    if (valueUs < 0) {
+        valueUs = 0;
+    }
+
+    size_t bucket = 0;
+    while (bucket + 1 < kNumBuckets && (valueUs >> bucket) != 0) {
+        ++bucket;
+    }
+
+    ++mBuckets[bucket];
+    ++mCount;
+    mTotalUs += valueUs;
+    if (valueUs > mMaxUs) {
+        mMaxUs = valueUs;
+    }
+}
+
+void ALooperRoster::LatencyHistogram::appendTo(
+        AString *s, const char *label) const {
+    s->append(StringPrintf(
+                "    %s: avg %lld max %lld,",
+                label, mCount > 0 ? mTotalUs / mCount : 0ll, mMaxUs));
+
+    for (size_t i = 0; i < kNumBuckets; ++i) {
+        if (mBuckets[i] == 0) {
+            continue;
+        }
+
+        if (i + 1 < kNumBuckets) {
+            s->append(StringPrintf(" <%lld:%u", 1ll << i, mBuckets[i]));
+        } else {
+            s->append(StringPrintf(" >=%lld:%u", 1ll << (i - 1), mBuckets[i]));
+        }
+    }
+
+    s->append("\n");
+}
+
+void ALooperRoster::recordLatency(
+        ALooper::handler_id handlerID, uint32_t what,
+        int64_t queueDelayUs, int64_t handlerTimeUs) {
+    uint64_t key = ((uint64_t)(uint32_t)handlerID << 32) | what;
+
+    Mutex::Autolock autoLock(mStatsLock);
+
+    ssize_t index = mStats.indexOfKey(key);
+    if (index < 0) {
+        index = mStats.add(key, LatencyStats());
+    }
+
+    LatencyStats &stats = mStats.editValueAt(index);
+    stats.mQueueDelay.add(queueDelayUs);
+    stats.mHandlerTime.add(handlerTimeUs);
+}
+
+void ALooperRoster::dump(int fd) {
+    KeyedVector<uint64_t, LatencyStats> stats;
+
+    {
+        Mutex::Autolock autoLock(mStatsLock);
+        stats = mStats;
+    }
+
+    AString s;
+
+    if (!mStatsEnabled) {
+        s = " Looper latency statistics disabled"
+            " (set media.stagefright.looper-stats to enable)\n";
+        write(fd, s.c_str(), s.size());
+        return;
+    }
+
+    s = " Looper latency statistics (us):\n";
+
+    for (size_t i = 0; i < stats.size(); ++i) {
+        ALooper::handler_id handlerID = stats.keyAt(i) >> 32;
+        uint32_t what = stats.keyAt(i) & 0xffffffff;
+
+        AString looperName;
+        {
+            Mutex::Autolock autoLock(mLock);
+
+            ssize_t index = mHandlers.indexOfKey(handlerID);
+            sp<ALooper> looper;
+            if (index >= 0) {
+                looper = mHandlers.valueAt(index).mLooper.promote();
+            }
+
+            if (looper == NULL) {
+                looperName = "unregistered";
+            } else if (looper->mName.empty()) {
+                looperName = "ALooper";
+            } else {
+                looperName = looper->mName;
+            }
+        }
+
+        // Most messages are four character codes.
+        AString whatName;
+        char fourcc[5];
+        bool printable = true;
+        for (size_t j = 0; j < 4; ++j) {
+            fourcc[j] = (what >> (24 - 8 * j)) & 0xff;
+            printable = printable && isprint(fourcc[j]);
+        }
+        fourcc[4] = '\0';
+
+        if (printable) {
+            whatName = StringPrintf("'%s'", fourcc);
+        } else {
+            whatName = StringPrintf("%u", what);
+        }
+
+        const LatencyStats &entry = stats.valueAt(i);
+        s.append(StringPrintf(
+                    "  handler %d (%s) what %s: %u messages\n",
+                    handlerID, looperName.c_str(), whatName.c_str(),
+                    entry.mHandlerTime.mCount));
+
+        entry.mQueueDelay.appendTo(&s, "queue delay");
+        entry.mHandlerTime.appendTo(&s, "handler time");
+    }
+
+    write(fd, s.c_str(), s.size());
+}
+
 }  // namespace android
@@ -87,14 +87,25 @@ void AMessage::freeItem(Item *item) {
     }
 }
 
-AMessage::Item *AMessage::allocateItem(const char *name) {
-    name = AAtomizer::Atomize(name);
-
+size_t AMessage::findItemIndex(const char *name) const {
+    // Names are compared directly rather than atomized first, which would
+    // take the atomizer's lock and hash the name on every lookup. Stored
+    // names are atoms, so a caller passing an atom back matches by pointer.
     size_t i = 0;
-    while (i < mNumItems && mItems[i].mName != name) {
+    while (i < mNumItems) {
+        const char *itemName = mItems[i].mName;
+        if (itemName == name || !strcmp(itemName, name)) {
+            break;
+        }
         ++i;
     }
 
+    return i;
+}
+
+AMessage::Item *AMessage::allocateItem(const char *name) {
+    size_t i = findItemIndex(name);
+
     Item *item;
 
     if (i < mNumItems) {
@@ -105,7 +116,7 @@ AMessage::Item *AMessage::allocateItem(const char *name) {
         i = mNumItems++;
         item = &mItems[i];
 
-        item->mName = name;
+        item->mName = AAtomizer::Atomize(name);
     }
 
     return item;
@@ -113,14 +124,11 @@ AMessage::Item *AMessage::allocateItem(const char *name) {
 
 const AMessage::Item *AMessage::findItem(
         const char *name, Type type) const {
-    name = AAtomizer::Atomize(name);
+    size_t i = findItemIndex(name);
 
-    for (size_t i = 0; i < mNumItems; ++i) {
+    if (i < mNumItems) {
         const Item *item = &mItems[i];
-
-        if (item->mName == name) {
-            return item->mType == type ? item : NULL;
-        }
+        return item->mType == type ? item : NULL;
     }
 
     return NULL;
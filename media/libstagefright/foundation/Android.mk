@@ -5,6 +5,7 @@ LOCAL_SRC_FILES:=                 \
     AAtomizer.cpp                 \
     ABitReader.cpp                \
     ABuffer.cpp                   \
+    AConfigCache.cpp              \
     AHandler.cpp                  \
     AHierarchicalStateMachine.cpp \
     ALooper.cpp                   \
@@ -19,6 +20,7 @@ LOCAL_C_INCLUDES:= \
 
 LOCAL_SHARED_LIBRARIES := \
         libbinder         \
+        libcutils         \
         libutils          \
 
 LOCAL_CFLAGS += -Wno-multichar
@@ -0,0 +1,220 @@
+/*
+ * Copyright (C) 2012 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "AdaptationPolicy"
+#include <utils/Log.h>
+
+#include "AdaptationPolicy.h"
+
+#include "include/HTTPBase.h"
+
+#include <cutils/properties.h>
+#include <media/stagefright/foundation/ADebug.h>
+
+namespace android {
+
+// Weight of the latest segment in the throughput average.
+static const double kThroughputWeight = 0.25;
+
+// Consider only 80% of the estimated throughput usable.
+static const int32_t kUsableThroughputPercent = 80;
+
+// Below this many target durations worth of buffered media, switching up
+// is too risky.
+static const int64_t kMinBufferForUpSwitch = 2;
+
+// At or above this many target durations worth of buffered media, dips in
+// throughput are ignored. LiveSession queues only a few segments ahead, so
+// this is about as much as there ever is.
+static const int64_t kHealthyBuffer = 2;
+
+// static
+sp<AdaptationPolicy> AdaptationPolicy::Create() {
+    char value[PROPERTY_VALUE_MAX];
+    if (property_get("media.httplive.abr", value, NULL)
+            && !strcmp(value, "throughput")) {
+        return new ThroughputPolicy;
+    }
+
+    return new ThroughputBufferPolicy;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+ThroughputPolicy::ThroughputPolicy()
+    : mAverageBps(0),
+      mNumSamples(0) {
+}
+
+void ThroughputPolicy::onSegmentFetched(size_t numBytes, int64_t durationUs) {
+    if (numBytes == 0 || durationUs <= 0) {
+        return;
+    }
+
+    double bps = numBytes * 8E6 / durationUs;
+
+    if (mNumSamples++ == 0) {
+        mAverageBps = bps;
+    } else {
+        mAverageBps += kThroughputWeight * (bps - mAverageBps);
+    }
+
+    ALOGV("segment of %d bytes took %lld us, %.2f kbps, average %.2f kbps",
+          numBytes, durationUs, bps / 1E3, mAverageBps / 1E3);
+}
+
+bool ThroughputPolicy::getThroughputEstimate(int32_t *bandwidthBps) const {
+    if (mNumSamples == 0) {
+        // Start out from what earlier streams saw on this network rather
+        // than from the lowest variant.
+        return HTTPBase::GetNetworkBandwidthEstimate(bandwidthBps);
+    }
+
+    *bandwidthBps = (int32_t)mAverageBps;
+
+    return true;
+}
+
+size_t ThroughputPolicy::selectByThroughput(
+        const Vector<unsigned long> &bandwidths,
+        int32_t *bandwidthBps) const {
+    CHECK_GT(bandwidths.size(), 0u);
+
+    if (!getThroughputEstimate(bandwidthBps)) {
+        *bandwidthBps = -1;
+        return 0;  // Pick the lowest bandwidth stream by default.
+    }
+
+    char value[PROPERTY_VALUE_MAX];
+    if (property_get("media.httplive.max-bw", value, NULL)) {
+        char *end;
+        long maxBw = strtoul(value, &end, 10);
+        if (end > value && *end == '\0') {
+            if (maxBw > 0 && *bandwidthBps > maxBw) {
+                ALOGV("bandwidth capped to %ld bps", maxBw);
+                *bandwidthBps = maxBw;
+            }
+        }
+    }
+
+    int32_t usableBps =
+        (int32_t)((int64_t)*bandwidthBps * kUsableThroughputPercent / 100);
+
+    // Pick the highest bandwidth stream below or equal to the usable
+    // bandwidth.
+    size_t index = bandwidths.size() - 1;
+    while (index > 0 && bandwidths.itemAt(index) > (unsigned long)usableBps) {
+        --index;
+    }
+
+    return index;
+}
+
+size_t ThroughputPolicy::selectVariant(
+        const Vector<unsigned long> &bandwidths,
+        ssize_t currentIndex,
+        int64_t bufferedUs,
+        int64_t targetDurationUs,
+        int64_t nowUs,
+        AString *reason) {
+    int32_t bandwidthBps;
+    size_t index = selectByThroughput(bandwidths, &bandwidthBps);
+
+    if (bandwidthBps < 0) {
+        *reason = "no throughput estimate";
+    } else {
+        *reason = StringPrintf("throughput %d kbps", bandwidthBps / 1000);
+    }
+
+    return index;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+ThroughputBufferPolicy::ThroughputBufferPolicy()
+    : mLastSwitchTimeUs(-1) {
+}
+
+size_t ThroughputBufferPolicy::selectVariant(
+        const Vector<unsigned long> &bandwidths,
+        ssize_t currentIndex,
+        int64_t bufferedUs,
+        int64_t targetDurationUs,
+        int64_t nowUs,
+        AString *reason) {
+    int32_t bandwidthBps;
+    size_t index = selectByThroughput(bandwidths, &bandwidthBps);
+
+    AString state = StringPrintf(
+            "throughput %d kbps, buffered %lld ms",
+            bandwidthBps < 0 ? -1 : bandwidthBps / 1000, bufferedUs / 1000);
+
+    if (currentIndex < 0 || (size_t)currentIndex >= bandwidths.size()) {
+        *reason = StringPrintf("initial selection, %s", state.c_str());
+        mLastSwitchTimeUs = nowUs;
+        return index;
+    }
+
+    size_t current = (size_t)currentIndex;
+
+    if (index == current) {
+        *reason = StringPrintf("current variant fits, %s", state.c_str());
+        return current;
+    }
+
+    bool holding = mLastSwitchTimeUs >= 0
+        && nowUs - mLastSwitchTimeUs < targetDurationUs;
+
+    if (index < current) {
+        if (bufferedUs < targetDurationUs) {
+            // About to run dry, don't wait for the hold time to expire.
+            *reason = StringPrintf("buffer low, %s", state.c_str());
+        } else if (bufferedUs >= kHealthyBuffer * targetDurationUs) {
+            *reason = StringPrintf(
+                    "buffer healthy, ignoring throughput dip, %s",
+                    state.c_str());
+            return current;
+        } else if (holding) {
+            *reason = StringPrintf(
+                    "holding after last switch, %s", state.c_str());
+            return current;
+        } else {
+            *reason = StringPrintf("throughput dropped, %s", state.c_str());
+        }
+    } else {
+        if (bufferedUs < kMinBufferForUpSwitch * targetDurationUs) {
+            *reason = StringPrintf(
+                    "buffer too low to switch up, %s", state.c_str());
+            return current;
+        } else if (holding) {
+            *reason = StringPrintf(
+                    "holding after last switch, %s", state.c_str());
+            return current;
+        }
+
+        // Go up one variant at a time, a single fast segment shouldn't
+        // pull us all the way up.
+        index = current + 1;
+        *reason = StringPrintf("throughput increased, %s", state.c_str());
+    }
+
+    mLastSwitchTimeUs = nowUs;
+
+    return index;
+}
+
+}  // namespace android
@@ -0,0 +1,121 @@
+/*
+ * Copyright (C) 2012 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ADAPTATION_POLICY_H_
+
+#define ADAPTATION_POLICY_H_
+
+#include <media/stagefright/foundation/ABase.h>
+#include <media/stagefright/foundation/AString.h>
+#include <utils/RefBase.h>
+#include <utils/Vector.h>
+
+namespace android {
+
+// Decides which variant of a variant playlist LiveSession fetches the
+// next segment from. The policy is picked by the media.httplive.abr
+// property, see Create().
+struct AdaptationPolicy : public RefBase {
+    AdaptationPolicy() {}
+
+    // Called for every segment downloaded, with its size and the time
+    // its transfer took.
+    virtual void onSegmentFetched(size_t numBytes, int64_t durationUs) = 0;
+
+    // Returns the index into "bandwidths", sorted in ascending order, of
+    // the variant to fetch the next segment from. "currentIndex" is the
+    // variant in use or -1 before the first segment, "bufferedUs" the
+    // amount of media queued ahead of the parser. Describes the reason
+    // for the decision in "reason".
+    virtual size_t selectVariant(
+            const Vector<unsigned long> &bandwidths,
+            ssize_t currentIndex,
+            int64_t bufferedUs,
+            int64_t targetDurationUs,
+            int64_t nowUs,
+            AString *reason) = 0;
+
+    // Returns the current throughput estimate in bits per second, the one
+    // remembered for the current network before the first segment, false
+    // if there's none yet.
+    virtual bool getThroughputEstimate(int32_t *bandwidthBps) const = 0;
+
+    // "throughput" selects ThroughputPolicy, anything else
+    // ThroughputBufferPolicy.
+    static sp<AdaptationPolicy> Create();
+
+protected:
+    virtual ~AdaptationPolicy() {}
+
+private:
+    DISALLOW_EVIL_CONSTRUCTORS(AdaptationPolicy);
+};
+
+// Picks the highest variant that fits into 80% of an exponentially
+// weighted moving average of the per segment throughput.
+struct ThroughputPolicy : public AdaptationPolicy {
+    ThroughputPolicy();
+
+    virtual void onSegmentFetched(size_t numBytes, int64_t durationUs);
+
+    virtual size_t selectVariant(
+            const Vector<unsigned long> &bandwidths,
+            ssize_t currentIndex,
+            int64_t bufferedUs,
+            int64_t targetDurationUs,
+            int64_t nowUs,
+            AString *reason);
+
+    virtual bool getThroughputEstimate(int32_t *bandwidthBps) const;
+
+protected:
+    // Returns the highest variant the throughput estimate allows for.
+    size_t selectByThroughput(
+            const Vector<unsigned long> &bandwidths,
+            int32_t *bandwidthBps) const;
+
+private:
+    double mAverageBps;
+    size_t mNumSamples;
+
+    DISALLOW_EVIL_CONSTRUCTORS(ThroughputPolicy);
+};
+
+// Starts out from the throughput based choice and then takes the amount
+// of buffered media into account. Switches up only while enough is
+// buffered to survive a wrong guess, doesn't switch down on throughput
+// dips as long as the buffer is healthy, and switches at most once per
+// target duration unless the buffer is about to run dry.
+struct ThroughputBufferPolicy : public ThroughputPolicy {
+    ThroughputBufferPolicy();
+
+    virtual size_t selectVariant(
+            const Vector<unsigned long> &bandwidths,
+            ssize_t currentIndex,
+            int64_t bufferedUs,
+            int64_t targetDurationUs,
+            int64_t nowUs,
+            AString *reason);
+
+private:
+    int64_t mLastSwitchTimeUs;
+
+    DISALLOW_EVIL_CONSTRUCTORS(ThroughputBufferPolicy);
+};
+
+}  // namespace android
+
+#endif  // ADAPTATION_POLICY_H_
@@ -3,6 +3,7 @@ LOCAL_PATH:= $(call my-dir)
 include $(CLEAR_VARS)
 
 LOCAL_SRC_FILES:=               \
+        AdaptationPolicy.cpp    \
         LiveDataSource.cpp      \
         LiveSession.cpp         \
         M3UParser.cpp           \
@@ -54,6 +54,18 @@ size_t LiveDataSource::countQueuedBuffers() {
     return mBufferQueue.size();
 }
 
+size_t LiveDataSource::countQueuedBytes() {
+    Mutex::Autolock autoLock(mLock);
+
+    size_t numBytes = 0;
+    for (List<sp<ABuffer> >::iterator it = mBufferQueue.begin();
+         it != mBufferQueue.end(); ++it) {
+        numBytes += (*it)->size();
+    }
+
+    return numBytes;
+}
+
 ssize_t LiveDataSource::readAtNonBlocking(
         off64_t offset, void *data, size_t size) {
     Mutex::Autolock autoLock(mLock);
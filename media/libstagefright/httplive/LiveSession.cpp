@@ -20,6 +20,7 @@
 
 #include "include/LiveSession.h"
 
+#include "AdaptationPolicy.h"
 #include "LiveDataSource.h"
 
 #include "include/M3UParser.h"
@@ -29,17 +30,124 @@
 #include <media/stagefright/foundation/hexdump.h>
 #include <media/stagefright/foundation/ABuffer.h>
 #include <media/stagefright/foundation/ADebug.h>
+#include <media/stagefright/foundation/ALooper.h>
 #include <media/stagefright/foundation/AMessage.h>
 #include <media/stagefright/DataSource.h>
 #include <media/stagefright/FileSource.h>
 #include <media/stagefright/MediaErrors.h>
 
 #include <ctype.h>
+#include <unistd.h>
 #include <openssl/aes.h>
 #include <openssl/md5.h>
 
 namespace android {
 
+// Assumed until the playlist tells otherwise.
+static const int64_t kDefaultTargetDurationUs = 10000000ll;
+
+static Mutex gLiveSessionsLock;
+static List<LiveSession *> gLiveSessions;
+
+// Downloads segments on its own looper so that they're transferred while
+// the session is busy with the current one. All of the prefetchers' HTTP
+// sources share chromium's request context, whose socket pool keeps the
+// connections to the server alive between requests.
+struct LiveSession::Prefetcher : public AHandler {
+    Prefetcher(LiveSession *session, const sp<HTTPBase> &source);
+
+    void fetch(
+            const AString &key, const AString &uri,
+            int64_t range_offset, int64_t range_length,
+            const CipherParams &cipher, int32_t generation);
+
+    void disconnect();
+
+protected:
+    virtual ~Prefetcher();
+
+    virtual void onMessageReceived(const sp<AMessage> &msg);
+
+private:
+    enum {
+        kWhatFetch = 'fetc',
+    };
+
+    LiveSession *mSession;
+    sp<HTTPBase> mHTTPDataSource;
+
+    DISALLOW_EVIL_CONSTRUCTORS(Prefetcher);
+};
+
+LiveSession::Prefetcher::Prefetcher(
+        LiveSession *session, const sp<HTTPBase> &source)
+    : mSession(session),
+      mHTTPDataSource(source) {
+}
+
+LiveSession::Prefetcher::~Prefetcher() {
+}
+
+void LiveSession::Prefetcher::fetch(
+        const AString &key, const AString &uri,
+        int64_t range_offset, int64_t range_length,
+        const CipherParams &cipher, int32_t generation) {
+    sp<ABuffer> cipherBuffer = new ABuffer(sizeof(cipher));
+    memcpy(cipherBuffer->data(), &cipher, sizeof(cipher));
+
+    sp<AMessage> msg = new AMessage(kWhatFetch, id());
+    msg->setString("key", key.c_str());
+    msg->setString("uri", uri.c_str());
+    msg->setInt64("range-offset", range_offset);
+    msg->setInt64("range-length", range_length);
+    msg->setBuffer("cipher", cipherBuffer);
+    msg->setInt32("generation", generation);
+    msg->post();
+}
+
+void LiveSession::Prefetcher::disconnect() {
+    mHTTPDataSource->disconnect();
+}
+
+void LiveSession::Prefetcher::onMessageReceived(const sp<AMessage> &msg) {
+    switch (msg->what()) {
+        case kWhatFetch:
+        {
+            AString key, uri;
+            CHECK(msg->findString("key", &key));
+            CHECK(msg->findString("uri", &uri));
+
+            int64_t range_offset, range_length;
+            CHECK(msg->findInt64("range-offset", &range_offset));
+            CHECK(msg->findInt64("range-length", &range_length));
+
+            sp<ABuffer> cipherBuffer;
+            CHECK(msg->findBuffer("cipher", &cipherBuffer));
+            CHECK_EQ(cipherBuffer->size(), sizeof(CipherParams));
+
+            int32_t generation;
+            CHECK(msg->findInt32("generation", &generation));
+
+            int64_t startTimeUs = ALooper::GetNowUs();
+
+            sp<ABuffer> buffer;
+            status_t err = mSession->fetchFile(
+                    uri.c_str(), &buffer, range_offset, range_length,
+                    (const CipherParams *)cipherBuffer->data(),
+                    mHTTPDataSource);
+
+            mSession->onPrefetchDone(
+                    key, generation, err, buffer,
+                    ALooper::GetNowUs() - startTimeUs);
+            break;
+        }
+
+        default:
+            TRESPASS();
+            break;
+    }
+}
+
 LiveSession::LiveSession(uint32_t flags, bool uidValid, uid_t uid)
     : mFlags(flags),
       mUIDValid(uidValid),
@@ -59,15 +167,36 @@ LiveSession::LiveSession(uint32_t flags, bool uidValid, uid_t uid)
       mSeeking(false),
       mDisconnectPending(false),
       mMonitorQueueGeneration(0),
+      mNextPrefetcher(0),
+      mPrefetchedBytes(0),
+      mLastSegmentBytes(0),
+      mPrefetchGeneration(0),
+      mAdaptationPolicy(AdaptationPolicy::Create()),
+      mLastSegmentDurationUs(0),
       mRefreshState(INITIAL_MINIMUM_RELOAD_DELAY),
       mCurrentPlayingTime(-1),
       mFirstSeqNumber(-1) {
     if (mUIDValid) {
         mHTTPDataSource->setUID(mUID);
     }
+
+    Mutex::Autolock autoLock(gLiveSessionsLock);
+    gLiveSessions.push_back(this);
 }
 
 LiveSession::~LiveSession() {
+    {
+        Mutex::Autolock autoLock(gLiveSessionsLock);
+        for (List<LiveSession *>::iterator it = gLiveSessions.begin();
+             it != gLiveSessions.end(); ++it) {
+            if (*it == this) {
+                gLiveSessions.erase(it);
+                break;
+            }
+        }
+    }
+
+    stopPrefetchers();
 }
 
 sp<DataSource> LiveSession::getDataSource() {
@@ -94,6 +223,10 @@ void LiveSession::disconnect() {
 
     mHTTPDataSource->disconnect();
 
+    for (size_t i = 0; i < mPrefetchers.size(); ++i) {
+        mPrefetchers.editItemAt(i)->disconnect();
+    }
+
     (new AMessage(kWhatDisconnect, id()))->post();
 }
 
@@ -184,7 +317,10 @@ void LiveSession::onConnect(const sp<AMessage> &msg) {
         ALOGI("onConnect <URL suppressed>");
     }
 
-    mMasterURL = url;
+    {
+        Mutex::Autolock autoLock(mLock);
+        mMasterURL = url;
+    }
 
     bool dummy;
     sp<M3UParser> playlist = fetchPlaylist(url.c_str(), &dummy);
@@ -214,6 +350,8 @@ void LiveSession::onConnect(const sp<AMessage> &msg) {
         mBandwidthItems.sort(SortByBandwidth);
     }
 
+    startPrefetchers();
+
     postMonitorQueue();
 }
 
@@ -228,7 +366,9 @@ void LiveSession::onDisconnect() {
 
 status_t LiveSession::fetchFile(
         const char *url, sp<ABuffer> *out,
-        int64_t range_offset, int64_t range_length) {
+        int64_t range_offset, int64_t range_length,
+        const CipherParams *cipher,
+        const sp<HTTPBase> &httpSource) {
     *out = NULL;
     ALOGW("fetchFile %s", url);
 
@@ -259,13 +399,16 @@ status_t LiveSession::fetchFile(
                             range_length < 0
                                 ? "" : StringPrintf("%lld", range_offset + range_length - 1).c_str()).c_str()));
         }
-        status_t err = mHTTPDataSource->connect(url, &headers);
+        sp<HTTPBase> httpDataSource =
+            (httpSource != NULL) ? httpSource : mHTTPDataSource;
+
+        status_t err = httpDataSource->connect(url, &headers);
 
         if (err != OK) {
             return err;
         }
 
-        source = mHTTPDataSource;
+        source = httpDataSource;
     }
 
     off64_t size;
@@ -275,9 +418,25 @@ status_t LiveSession::fetchFile(
         size = 65536;
     }
 
+    AES_KEY aes_key;
+    unsigned char aes_ivec[16];
+    if (cipher != NULL && cipher->mEncrypted) {
+        if (AES_set_decrypt_key(cipher->mKey, 128, &aes_key) != 0) {
+            ALOGE("failed to set AES decryption key.");
+            return UNKNOWN_ERROR;
+        }
+
+        memcpy(aes_ivec, cipher->mIV, sizeof(aes_ivec));
+    } else {
+        cipher = NULL;
+    }
+
     sp<ABuffer> buffer = new ABuffer(size);
     buffer->setRange(0, 0);
 
+    // Number of bytes at the start of "buffer" that have been decrypted.
+    size_t decryptedSize = 0;
+
     for (;;) {
         size_t bufferRemaining = buffer->capacity() - buffer->size();
 
@@ -319,6 +478,47 @@ status_t LiveSession::fetchFile(
         }
 
         buffer->setRange(0, buffer->size() + (size_t)n);
+
+        if (cipher != NULL) {
+            // Decrypt all complete blocks received so far, the padding
+            // can't be told apart until the last one arrived.
+            size_t blockSize = (buffer->size() - decryptedSize) & ~15;
+
+            if (blockSize > 0) {
+                AES_cbc_encrypt(
+                        buffer->data() + decryptedSize,
+                        buffer->data() + decryptedSize,
+                        blockSize, &aes_key, aes_ivec, AES_DECRYPT);
+
+                decryptedSize += blockSize;
+            }
+        }
+    }
+
+    if (cipher != NULL) {
+        size_t n = buffer->size();
+
+        if (n == 0 || decryptedSize != n) {
+            ALOGE("encrypted file of %d bytes isn't a multiple of the "
+                  "block size.", n);
+            return ERROR_MALFORMED;
+        }
+
+        size_t pad = buffer->data()[n - 1];
+
+        if (pad == 0 || pad > 16 || pad > n) {
+            ALOGE("invalid padding of %d bytes.", pad);
+            return ERROR_MALFORMED;
+        }
+
+        for (size_t i = 0; i < pad; ++i) {
+            if (buffer->data()[n - 1 - i] != pad) {
+                ALOGE("invalid padding of %d bytes.", pad);
+                return ERROR_MALFORMED;
+            }
+        }
+
+        buffer->setRange(0, n - pad);
     }
 
     *out = buffer;
@@ -368,8 +568,9 @@ sp<M3UParser> LiveSession::fetchPlaylist(const char *url, bool *unchanged) {
     mRefreshState = INITIAL_MINIMUM_RELOAD_DELAY;
 #endif
 
+    // A refreshed media playlist only needs its new segments parsed.
     sp<M3UParser> playlist =
-        new M3UParser(url, buffer->data(), buffer->size());
+        new M3UParser(url, buffer->data(), buffer->size(), mPlaylist);
 
     if (playlist->initCheck() != OK) {
         ALOGE("failed to parse .m3u8 playlist");
@@ -390,36 +591,44 @@ size_t LiveSession::getBandwidthIndex() {
     }
 
 #if 1
-    int32_t bandwidthBps;
-    if (mHTTPDataSource != NULL
-            && mHTTPDataSource->estimateBandwidth(&bandwidthBps)) {
-        ALOGW("bandwidth estimated at %.2f kbps", bandwidthBps / 1024.0f);
-    } else {
-        ALOGV("no bandwidth estimate.");
-        return 0;  // Pick the lowest bandwidth stream by default.
+    Vector<unsigned long> bandwidths;
+    for (size_t i = 0; i < mBandwidthItems.size(); ++i) {
+        bandwidths.push(mBandwidthItems.itemAt(i).mBandwidth);
     }
 
-    char value[PROPERTY_VALUE_MAX];
-    if (property_get("media.httplive.max-bw", value, NULL)) {
-        char *end;
-        long maxBw = strtoul(value, &end, 10);
-        if (end > value && *end == '\0') {
-            if (maxBw > 0 && bandwidthBps > maxBw) {
-                ALOGW("bandwidth capped to %ld bps", maxBw);
-                bandwidthBps = maxBw;
-            }
-        }
+    int64_t targetDurationUs = kDefaultTargetDurationUs;
+    int32_t targetDurationSecs;
+    if (mPlaylist != NULL && mPlaylist->meta() != NULL
+            && mPlaylist->meta()->findInt32(
+                "target-duration", &targetDurationSecs)
+            && targetDurationSecs > 0) {
+        targetDurationUs = targetDurationSecs * 1000000ll;
     }
 
-    // Consider only 80% of the available bandwidth usable.
-    bandwidthBps = (bandwidthBps * 8) / 10;
+    int64_t bufferedUs = getBufferedDurationUs();
+    int64_t nowUs = ALooper::GetNowUs();
 
-    // Pick the highest bandwidth stream below or equal to estimated bandwidth.
+    // The policy is also inspected by dump().
+    Mutex::Autolock autoLock(mLock);
 
-    size_t index = mBandwidthItems.size() - 1;
-    while (index > 0 && mBandwidthItems.itemAt(index).mBandwidth
-                            > (size_t)bandwidthBps) {
-        --index;
+    AString reason;
+    size_t index = mAdaptationPolicy->selectVariant(
+            bandwidths, mPrevBandwidthIndex, bufferedUs, targetDurationUs,
+            nowUs, &reason);
+
+    AString decision = StringPrintf(
+            "%lld ms: variant %d -> %d (%lu bps), %s",
+            nowUs / 1000,
+            (int32_t)mPrevBandwidthIndex,
+            index,
+            mBandwidthItems.itemAt(index).mBandwidth,
+            reason.c_str());
+
+    ALOGV("%s", decision.c_str());
+
+    mDecisionLog.push_back(decision);
+    if (mDecisionLog.size() > kMaxNumLoggedDecisions) {
+        mDecisionLog.erase(mDecisionLog.begin());
     }
 #elif 0
     // Change bandwidth at random()
@@ -455,6 +664,23 @@ size_t LiveSession::getBandwidthIndex() {
     return index;
 }
 
+int64_t LiveSession::getBufferedDurationUs() {
+    if (mLastSegmentBytes == 0 || mLastSegmentDurationUs <= 0) {
+        return 0;
+    }
+
+    size_t numBytes = mDataSource->countQueuedBytes();
+
+    {
+        Mutex::Autolock autoLock(mLock);
+        numBytes += mPrefetchedBytes;
+    }
+
+    // LiveDataSource only knows about bytes, assume all of the data
+    // queued and prefetched has the same bitrate as the last segment.
+    return (int64_t)numBytes * mLastSegmentDurationUs / mLastSegmentBytes;
+}
+
 bool LiveSession::timeToRefreshPlaylist(int64_t nowUs) const {
     if (mPlaylist == NULL) {
         CHECK_EQ((int)mRefreshState, (int)INITIAL_MINIMUM_RELOAD_DELAY);
@@ -663,8 +889,31 @@ rinse_repeat:
         range_length = -1;
     }
 
+    CipherParams cipher;
+    status_t err = getCipherParams(
+            mSeqNumber - mFirstSeqNumber, mSeqNumber, &cipher);
+
+    if (err != OK) {
+        ALOGE("getCipherParams failed w/ error %d", err);
+
+        mDataSource->queueEOS(err);
+        return;
+    }
+
+    // Get the segments after this one on their way before blocking on it,
+    // so that the connections don't go idle between segments.
+    prefetchSegments(mSeqNumber);
+
     sp<ABuffer> buffer;
-    status_t err = fetchFile(uri.c_str(), &buffer, range_offset, range_length);
+    int64_t fetchDurationUs;
+    if (!takePrefetchedSegment(
+                MakePrefetchKey(uri, range_offset, range_length),
+                &buffer, &fetchDurationUs)) {
+        int64_t startTimeUs = ALooper::GetNowUs();
+        err = fetchFile(
+                uri.c_str(), &buffer, range_offset, range_length, &cipher);
+        fetchDurationUs = ALooper::GetNowUs() - startTimeUs;
+    }
     if (err != OK) {
         Mutex::Autolock autoLock(mLock);
         if( !mSeeking ) {
@@ -678,13 +927,15 @@ rinse_repeat:
 
     CHECK(buffer != NULL);
 
-    err = decryptBuffer(mSeqNumber - mFirstSeqNumber, buffer);
+    mLastSegmentBytes = buffer->size();
 
-    if (err != OK) {
-        ALOGE("decryptBuffer failed w/ error %d", err);
+    if (!itemMeta->findInt64("durationUs", &mLastSegmentDurationUs)) {
+        mLastSegmentDurationUs = 0;
+    }
 
-        mDataSource->queueEOS(err);
-        return;
+    {
+        Mutex::Autolock autoLock(mLock);
+        mAdaptationPolicy->onSegmentFetched(buffer->size(), fetchDurationUs);
     }
 
     if (buffer->size() == 0 || buffer->data()[0] != 0x47) {
@@ -763,8 +1014,10 @@ void LiveSession::onMonitorQueue() {
     }
 }
 
-status_t LiveSession::decryptBuffer(
-        size_t playlistIndex, const sp<ABuffer> &buffer) {
+status_t LiveSession::getCipherParams(
+        size_t playlistIndex, int32_t seqNumber, CipherParams *params) {
+    params->mEncrypted = false;
+
     sp<AMessage> itemMeta;
     bool found = false;
     AString method;
@@ -796,41 +1049,18 @@ status_t LiveSession::decryptBuffer(
         return ERROR_MALFORMED;
     }
 
+    // Keys stay cached for the whole session, across playlist refreshes
+    // and bandwidth switches.
     ssize_t index = mAESKeyForURI.indexOfKey(keyURI);
 
     sp<ABuffer> key;
     if (index >= 0) {
         key = mAESKeyForURI.valueAt(index);
     } else {
-        key = new ABuffer(16);
-
-        sp<HTTPBase> keySource =
-              HTTPBase::Create(
-                  (mFlags & kFlagIncognito)
-                    ? HTTPBase::kFlagIncognito
-                    : 0);
-
-        if (mUIDValid) {
-            keySource->setUID(mUID);
-        }
-
-        status_t err =
-            keySource->connect(
-                    keyURI.c_str(),
-                    mExtraHeaders.isEmpty() ? NULL : &mExtraHeaders);
+        status_t err = fetchFile(keyURI.c_str(), &key);
 
-        if (err == OK) {
-            size_t offset = 0;
-            while (offset < 16) {
-                ssize_t n = keySource->readAt(
-                        offset, key->data() + offset, 16 - offset);
-                if (n <= 0) {
-                    err = ERROR_IO;
-                    break;
-                }
-
-                offset += n;
-            }
+        if (err == OK && key->size() < 16) {
+            err = ERROR_IO;
         }
 
         if (err != OK) {
@@ -841,13 +1071,7 @@ status_t LiveSession::decryptBuffer(
         mAESKeyForURI.add(keyURI, key);
     }
 
-    AES_KEY aes_key;
-    if (AES_set_decrypt_key(key->data(), 128, &aes_key) != 0) {
-        ALOGE("failed to set AES decryption key.");
-        return UNKNOWN_ERROR;
-    }
-
-    unsigned char aes_ivec[16];
+    memcpy(params->mKey, key->data(), sizeof(params->mKey));
 
     AString iv;
     if (itemMeta->findString("cipher-iv", &iv)) {
@@ -857,7 +1081,7 @@ status_t LiveSession::decryptBuffer(
             return ERROR_MALFORMED;
         }
 
-        memset(aes_ivec, 0, sizeof(aes_ivec));
+        memset(params->mIV, 0, sizeof(params->mIV));
         for (size_t i = 0; i < 16; ++i) {
             char c1 = tolower(iv.c_str()[2 + 2 * i]);
             char c2 = tolower(iv.c_str()[3 + 2 * i]);
@@ -868,39 +1092,305 @@ status_t LiveSession::decryptBuffer(
             uint8_t nibble1 = isdigit(c1) ? c1 - '0' : c1 - 'a' + 10;
             uint8_t nibble2 = isdigit(c2) ? c2 - '0' : c2 - 'a' + 10;
 
-            aes_ivec[i] = nibble1 << 4 | nibble2;
+            params->mIV[i] = nibble1 << 4 | nibble2;
         }
     } else {
-        memset(aes_ivec, 0, sizeof(aes_ivec));
-        aes_ivec[15] = mSeqNumber & 0xff;
-        aes_ivec[14] = (mSeqNumber >> 8) & 0xff;
-        aes_ivec[13] = (mSeqNumber >> 16) & 0xff;
-        aes_ivec[12] = (mSeqNumber >> 24) & 0xff;
+        memset(params->mIV, 0, sizeof(params->mIV));
+        params->mIV[15] = seqNumber & 0xff;
+        params->mIV[14] = (seqNumber >> 8) & 0xff;
+        params->mIV[13] = (seqNumber >> 16) & 0xff;
+        params->mIV[12] = (seqNumber >> 24) & 0xff;
     }
 
-    AES_cbc_encrypt(
-            buffer->data(), buffer->data(), buffer->size(),
-            &aes_key, aes_ivec, AES_DECRYPT);
+    params->mEncrypted = true;
 
-    // hexdump(buffer->data(), buffer->size());
+    return OK;
+}
 
-    size_t n = buffer->size();
-    CHECK_GT(n, 0u);
+// static
+AString LiveSession::MakePrefetchKey(
+        const AString &uri, int64_t range_offset, int64_t range_length) {
+    return StringPrintf(
+            "%s@%lld,%lld", uri.c_str(), range_offset, range_length);
+}
 
-    size_t pad = buffer->data()[n - 1];
+void LiveSession::startPrefetchers() {
+    size_t numPrefetchers = kDefaultNumPrefetchers;
 
-    CHECK_GT(pad, 0u);
-    CHECK_LE(pad, 16u);
-    CHECK_GE((size_t)n, pad);
-    for (size_t i = 0; i < pad; ++i) {
-        CHECK_EQ((unsigned)buffer->data()[n - 1 - i], pad);
+    char value[PROPERTY_VALUE_MAX];
+    if (property_get("media.httplive.prefetch-segments", value, NULL)) {
+        char *end;
+        unsigned long n = strtoul(value, &end, 10);
+        if (end > value && *end == '\0') {
+            numPrefetchers = (n > kMaxNumPrefetchers) ? kMaxNumPrefetchers : n;
+        }
     }
 
-    n -= pad;
+    ALOGV("prefetching %d segments ahead", numPrefetchers);
 
-    buffer->setRange(buffer->offset(), n);
+    Mutex::Autolock autoLock(mLock);
 
-    return OK;
+    while (mPrefetchers.size() < numPrefetchers) {
+        sp<HTTPBase> source = HTTPBase::Create(
+                (mFlags & kFlagIncognito) ? HTTPBase::kFlagIncognito : 0);
+
+        if (source == NULL) {
+            break;
+        }
+
+        if (mUIDValid) {
+            source->setUID(mUID);
+        }
+
+        sp<ALooper> looper = new ALooper;
+        looper->setName("LiveSession prefetch");
+        looper->start();
+
+        sp<Prefetcher> prefetcher = new Prefetcher(this, source);
+        looper->registerHandler(prefetcher);
+
+        mPrefetchLoopers.push(looper);
+        mPrefetchers.push(prefetcher);
+    }
+}
+
+void LiveSession::stopPrefetchers() {
+    Vector<sp<ALooper> > loopers;
+
+    {
+        Mutex::Autolock autoLock(mLock);
+
+        for (size_t i = 0; i < mPrefetchers.size(); ++i) {
+            mPrefetchers.editItemAt(i)->disconnect();
+        }
+
+        loopers = mPrefetchLoopers;
+        ++mPrefetchGeneration;
+    }
+
+    // Waits for fetches in progress, which fail quickly once their
+    // sources are disconnected.
+    for (size_t i = 0; i < loopers.size(); ++i) {
+        loopers.editItemAt(i)->stop();
+    }
+
+    Mutex::Autolock autoLock(mLock);
+
+    for (size_t i = 0; i < mPrefetchers.size(); ++i) {
+        mPrefetchLoopers.editItemAt(i)->unregisterHandler(
+                mPrefetchers.itemAt(i)->id());
+    }
+
+    mPrefetchers.clear();
+    mPrefetchLoopers.clear();
+    clearPrefetchedSegments_l();
+}
+
+void LiveSession::prefetchSegments(int32_t seqNumber) {
+    // The segment at "seqNumber" is about to be fetched, the ones after it
+    // are prefetched as long as they are in the playlist and the memory
+    // budget, shared with the data already queued on mDataSource, allows.
+
+    size_t numPrefetchers;
+    {
+        Mutex::Autolock autoLock(mLock);
+        numPrefetchers = mPrefetchers.size();
+    }
+
+    if (numPrefetchers == 0) {
+        return;
+    }
+
+    Vector<AString> keys, uris;
+    Vector<int64_t> rangeOffsets, rangeLengths;
+    Vector<CipherParams> ciphers;
+
+    int32_t lastSeqNumberInPlaylist =
+        mFirstSeqNumber + (int32_t)mPlaylist->size() - 1;
+
+    for (size_t i = 0; i <= numPrefetchers; ++i) {
+        int32_t itemSeqNumber = seqNumber + (int32_t)i;
+        if (itemSeqNumber > lastSeqNumberInPlaylist) {
+            break;
+        }
+
+        AString uri;
+        sp<AMessage> itemMeta;
+        CHECK(mPlaylist->itemAt(
+                    itemSeqNumber - mFirstSeqNumber, &uri, &itemMeta));
+
+        int64_t range_offset, range_length;
+        if (!itemMeta->findInt64("range-offset", &range_offset)
+                || !itemMeta->findInt64("range-length", &range_length)) {
+            range_offset = 0;
+            range_length = -1;
+        }
+
+        // The key is fetched here if necessary, the prefetchers only get
+        // to see the cached copy.
+        CipherParams cipher;
+        if (getCipherParams(
+                    itemSeqNumber - mFirstSeqNumber, itemSeqNumber,
+                    &cipher) != OK) {
+            // Reported once onDownloadNext gets to this segment.
+            break;
+        }
+
+        keys.push(MakePrefetchKey(uri, range_offset, range_length));
+        ciphers.push(cipher);
+        uris.push(uri);
+        rangeOffsets.push(range_offset);
+        rangeLengths.push(range_length);
+    }
+
+    size_t queuedBytes = mDataSource->countQueuedBytes();
+
+    Mutex::Autolock autoLock(mLock);
+
+    // Drop whatever isn't ahead of us anymore, e.g. after a bandwidth
+    // switch. Fetches still in progress are dropped once they complete.
+    size_t numInProgress = 0;
+    List<PrefetchItem>::iterator it = mPrefetchItems.begin();
+    while (it != mPrefetchItems.end()) {
+        bool wanted = false;
+        for (size_t i = 0; i < keys.size(); ++i) {
+            if (keys[i] == it->mKey) {
+                wanted = true;
+                break;
+            }
+        }
+
+        if (!wanted) {
+            if (it->mBuffer != NULL) {
+                mPrefetchedBytes -= it->mBuffer->size();
+            }
+            it = mPrefetchItems.erase(it);
+            continue;
+        }
+
+        if (!it->mDone) {
+            ++numInProgress;
+        }
+        ++it;
+    }
+
+    if (mDisconnectPending) {
+        return;
+    }
+
+    for (size_t i = 1; i < keys.size(); ++i) {
+        bool found = false;
+        for (it = mPrefetchItems.begin(); it != mPrefetchItems.end(); ++it) {
+            if (it->mKey == keys[i]) {
+                found = true;
+                break;
+            }
+        }
+
+        if (found) {
+            continue;
+        }
+
+        // Segments in progress are assumed to be as large as the last one.
+        size_t budgetBytes = queuedBytes + mPrefetchedBytes
+            + (numInProgress + 1) * mLastSegmentBytes;
+
+        if (budgetBytes > kMaxPrefetchBytes) {
+            ALOGV("prefetch budget exhausted (%d bytes)", budgetBytes);
+            break;
+        }
+
+        PrefetchItem item;
+        item.mKey = keys[i];
+        item.mDone = false;
+        item.mFinalResult = OK;
+        item.mFetchDurationUs = 0;
+        mPrefetchItems.push_back(item);
+        ++numInProgress;
+
+        sp<Prefetcher> prefetcher =
+            mPrefetchers.editItemAt(mNextPrefetcher++ % mPrefetchers.size());
+
+        prefetcher->fetch(
+                keys[i], uris[i], rangeOffsets[i], rangeLengths[i],
+                ciphers[i], mPrefetchGeneration);
+    }
+}
+
+bool LiveSession::takePrefetchedSegment(
+        const AString &key, sp<ABuffer> *out, int64_t *fetchDurationUs) {
+    Mutex::Autolock autoLock(mLock);
+
+    for (;;) {
+        List<PrefetchItem>::iterator it = mPrefetchItems.begin();
+        while (it != mPrefetchItems.end() && !(it->mKey == key)) {
+            ++it;
+        }
+
+        if (it == mPrefetchItems.end()) {
+            return false;
+        }
+
+        if (!it->mDone) {
+            mCondition.wait(mLock);
+            continue;
+        }
+
+        status_t err = it->mFinalResult;
+        sp<ABuffer> buffer = it->mBuffer;
+
+        if (buffer != NULL) {
+            mPrefetchedBytes -= buffer->size();
+        }
+        mPrefetchItems.erase(it);
+
+        if (err != OK) {
+            // Let the caller fetch the segment itself, so that it gets
+            // to handle the error.
+            ALOGV("prefetching segment failed w/ err %d", err);
+            return false;
+        }
+
+        *out = buffer;
+        *fetchDurationUs = it->mFetchDurationUs;
+        return true;
+    }
+}
+
+void LiveSession::onPrefetchDone(
+        const AString &key, int32_t generation,
+        status_t err, const sp<ABuffer> &buffer, int64_t fetchDurationUs) {
+    Mutex::Autolock autoLock(mLock);
+
+    if (generation != mPrefetchGeneration) {
+        return;
+    }
+
+    for (List<PrefetchItem>::iterator it = mPrefetchItems.begin();
+         it != mPrefetchItems.end(); ++it) {
+        if (it->mKey == key && !it->mDone) {
+            it->mDone = true;
+            it->mFinalResult = err;
+            it->mFetchDurationUs = fetchDurationUs;
+
+            if (err == OK) {
+                it->mBuffer = buffer;
+                mPrefetchedBytes += buffer->size();
+            }
+
+            mCondition.broadcast();
+            return;
+        }
+    }
+
+    // No longer wanted.
+}
+
+void LiveSession::clearPrefetchedSegments_l() {
+    // Fetches still in progress complete with a stale generation.
+    ++mPrefetchGeneration;
+    mPrefetchItems.clear();
+    mPrefetchedBytes = 0;
 }
 
 void LiveSession::postMonitorQueue(int64_t delayUs) {
@@ -963,6 +1453,7 @@ void LiveSession::onSeek(const sp<AMessage> &msg) {
              } else {
                  mSeqNumber = newSeqNumber;
                  mDataSource->reset();
+                 clearPrefetchedSegments_l();
                  mSeekTimeUs = segmentStartUs;
                  ALOGW("Seeking to seq %d new seek time %0.2f secs", newSeqNumber, mSeekTimeUs/1E6);
              }
@@ -989,6 +1480,46 @@ status_t LiveSession::getDuration(int64_t *durationUs) {
     return OK;
 }
 
+void LiveSession::dump(int fd) {
+    Mutex::Autolock autoLock(mLock);
+
+    AString s = StringPrintf(
+            " LiveSession %s\n",
+            (mFlags & kFlagIncognito) ? "<URL suppressed>" : mMasterURL.c_str());
+
+    int32_t bandwidthBps;
+    if (mAdaptationPolicy->getThroughputEstimate(&bandwidthBps)) {
+        s.append(StringPrintf(
+                    "  throughput estimate %d kbps\n", bandwidthBps / 1000));
+    } else {
+        s.append("  no throughput estimate\n");
+    }
+
+    s.append(StringPrintf(
+                "  %d segments prefetched (%d bytes)\n",
+                mPrefetchItems.size(), mPrefetchedBytes));
+
+    s.append("  variant selections:\n");
+    for (List<AString>::iterator it = mDecisionLog.begin();
+         it != mDecisionLog.end(); ++it) {
+        s.append("   ");
+        s.append(*it);
+        s.append("\n");
+    }
+
+    write(fd, s.c_str(), s.size());
+}
+
+// static
+void LiveSession::DumpSessions(int fd) {
+    Mutex::Autolock autoLock(gLiveSessionsLock);
+
+    for (List<LiveSession *>::iterator it = gLiveSessions.begin();
+         it != gLiveSessions.end(); ++it) {
+        (*it)->dump(fd);
+    }
+}
+
 bool LiveSession::isSeekable() {
     int64_t durationUs;
     return getDuration(&durationUs) == OK && durationUs >= 0;
@@ -27,13 +27,29 @@
 namespace android {
 
 M3UParser::M3UParser(
-        const char *baseURI, const void *data, size_t size)
+        const char *baseURI, const void *data, size_t size,
+        const sp<M3UParser> &previous)
     : mInitCheck(NO_INIT),
       mBaseURI(baseURI),
       mIsExtM3U(false),
       mIsVariantPlaylist(false),
       mIsComplete(false) {
-    mInitCheck = parse(data, size);
+    bool mismatch = false;
+    mInitCheck = parse(data, size, previous, &mismatch);
+
+    if (mismatch) {
+        // A segment changed under its sequence number, don't trust
+        // anything from the previous playlist.
+        ALOGW("playlist segments changed, parsing it from scratch");
+
+        mIsExtM3U = false;
+        mIsVariantPlaylist = false;
+        mIsComplete = false;
+        mMeta.clear();
+        mItems.clear();
+
+        mInitCheck = parse(data, size, NULL, &mismatch);
+    }
 }
 
 M3UParser::~M3UParser() {
@@ -145,8 +161,45 @@ static bool MakeURL(const char *baseURL, const char *url, AString *out) {
     return true;
 }
 
-status_t M3UParser::parse(const void *_data, size_t size) {
+const M3UParser::Item *M3UParser::findReusableItem(
+        const sp<M3UParser> &previous, int32_t seqNumber) const {
+    int32_t firstSeqNumber;
+    if (previous->mMeta == NULL || !previous->mMeta->findInt32(
+                "media-sequence", &firstSeqNumber)) {
+        firstSeqNumber = 0;
+    }
+
+    if (seqNumber < firstSeqNumber
+            || seqNumber >= firstSeqNumber + (int32_t)previous->mItems.size()) {
+        return NULL;
+    }
+
+    return &previous->mItems.itemAt(seqNumber - firstSeqNumber);
+}
+
+// Returns true if the segment had tags other than EXTINF in its playlist.
+static bool HasSegmentTags(const sp<AMessage> &meta) {
+    int32_t discontinuity;
+    int64_t rangeOffset;
+    AString method;
+    return meta->findInt32("discontinuity", &discontinuity)
+        || meta->findInt64("range-offset", &rangeOffset)
+        || meta->findString("cipher-method", &method);
+}
+
+status_t M3UParser::parse(
+        const void *_data, size_t size, const sp<M3UParser> &previous,
+        bool *mismatch) {
+    *mismatch = false;
+
+    bool incremental = previous != NULL
+        && previous->mInitCheck == OK
+        && !previous->mIsVariantPlaylist
+        && previous->mBaseURI == mBaseURI;
+
     int32_t lineNo = 0;
+    int32_t firstSeqNumber = 0;
+    size_t numReusedItems = 0;
 
     sp<AMessage> itemMeta;
 
@@ -177,7 +230,19 @@ status_t M3UParser::parse(const void *_data, size_t size) {
             mIsExtM3U = true;
         }
 
-        if (mIsExtM3U) {
+        // A segment the previous playlist already has keeps its duration
+        // and URI. Its other tags still have to be parsed, keys in
+        // particular attach to whatever segment follows them.
+        const Item *reusableItem = NULL;
+        if (incremental && !mIsVariantPlaylist) {
+            reusableItem = findReusableItem(
+                    previous, firstSeqNumber + (int32_t)mItems.size());
+        }
+
+        if (mIsExtM3U && reusableItem != NULL
+                && line.startsWith("#EXTINF")) {
+            // Parsed as part of the previous playlist.
+        } else if (mIsExtM3U) {
             status_t err = OK;
 
             if (line.startsWith("#EXT-X-TARGETDURATION")) {
@@ -190,6 +255,10 @@ status_t M3UParser::parse(const void *_data, size_t size) {
                     return ERROR_MALFORMED;
                 }
                 err = parseMetaData(line, &mMeta, "media-sequence");
+
+                if (err == OK) {
+                    CHECK(mMeta->findInt32("media-sequence", &firstSeqNumber));
+                }
             } else if (line.startsWith("#EXT-X-KEY")) {
                 if (mIsVariantPlaylist) {
                     return ERROR_MALFORMED;
@@ -241,7 +310,32 @@ status_t M3UParser::parse(const void *_data, size_t size) {
             }
         }
 
-        if (!line.startsWith("#")) {
+        if (!line.startsWith("#") && reusableItem != NULL) {
+            int64_t durationUs;
+            if (!reusableItem->mURI.endsWith(line.c_str())
+                    || !reusableItem->mMeta->findInt64(
+                        "durationUs", &durationUs)) {
+                *mismatch = true;
+                return ERROR_MALFORMED;
+            }
+
+            if (itemMeta == NULL && !HasSegmentTags(reusableItem->mMeta)) {
+                mItems.push(*reusableItem);
+                ++numReusedItems;
+            } else {
+                if (itemMeta == NULL) {
+                    itemMeta = new AMessage;
+                }
+                itemMeta->setInt64("durationUs", durationUs);
+
+                mItems.push();
+                Item *item = &mItems.editItemAt(mItems.size() - 1);
+                item->mURI = reusableItem->mURI;
+                item->mMeta = itemMeta;
+
+                itemMeta.clear();
+            }
+        } else if (!line.startsWith("#")) {
             if (!mIsVariantPlaylist) {
                 int64_t durationUs;
                 if (itemMeta == NULL
@@ -264,6 +358,11 @@ status_t M3UParser::parse(const void *_data, size_t size) {
         ++lineNo;
     }
 
+    if (incremental) {
+        ALOGV("took over %d of %d segments from the previous playlist",
+              numReusedItems, mItems.size());
+    }
+
     return OK;
 }
 
@@ -28,10 +28,20 @@
 
 namespace android {
 
+// Limit on what is loaded into memory at once, the whole tag if it has to
+// be loaded or a single frame.
 static const size_t kMaxMetadataSize = 3 * 1024 * 1024;
 
+// Limit on tags whose frames are read one by one.
+static const size_t kMaxIndexedMetadataSize = 256 * 1024 * 1024;
+
+// Enough for the mime type and description preceding the picture data of
+// all but the most unusual album art frames.
+static const size_t kMaxAlbumArtHeaderSize = 1024;
+
 ID3::ID3(const sp<DataSource> &source)
     : mIsValid(false),
+      mSource(source),
       mData(NULL),
       mSize(0),
       mFirstFrameOffset(0),
@@ -47,7 +57,12 @@ ID3::~ID3() {
     if (mData) {
         free(mData);
         mData = NULL;
+    } else {
+        for (size_t i = 0; i < mFrames.size(); ++i) {
+            free(mFrames.editItemAt(i).mData);
+        }
     }
+    mFrames.clear();
 }
 
 bool ID3::isValid() const {
@@ -128,57 +143,47 @@ struct id3_header {
         return false;
     }
 
-    if (size > kMaxMetadataSize) {
-        ALOGE("skipping huge ID3 metadata of size %d", size);
-        return false;
-    }
+    // Tag-wide unsynchronization of versions 2.2 and 2.3 hides where the
+    // frames are, such tags are loaded and fixed up as a whole. The frames
+    // of all other tags are read from the source as needed.
+    bool loadTag = header.version_major < 4 && (header.flags & 0x80);
 
-    mData = (uint8_t *)malloc(size);
-
-    if (mData == NULL) {
+    if (size > (loadTag ? kMaxMetadataSize : kMaxIndexedMetadataSize)) {
+        ALOGE("skipping huge ID3 metadata of size %d", size);
         return false;
     }
 
     mSize = size;
 
-    if (source->readAt(sizeof(header), mData, mSize) != (ssize_t)mSize) {
-        free(mData);
-        mData = NULL;
+    if (loadTag) {
+        mData = (uint8_t *)malloc(size);
 
-        return false;
-    }
-
-    if (header.version_major == 4) {
-        void *copy = malloc(size);
-        memcpy(copy, mData, size);
-
-        bool success = removeUnsynchronizationV2_4(false /* iTunesHack */);
-        if (!success) {
-            memcpy(mData, copy, size);
-            mSize = size;
-
-            success = removeUnsynchronizationV2_4(true /* iTunesHack */);
-
-            if (success) {
-                ALOGV("Had to apply the iTunes hack to parse this ID3 tag");
-            }
+        if (mData == NULL) {
+            return false;
         }
 
-        free(copy);
-        copy = NULL;
-
-        if (!success) {
+        if (source->readAt(sizeof(header), mData, mSize) != (ssize_t)mSize) {
             free(mData);
             mData = NULL;
 
             return false;
         }
-    } else if (header.flags & 0x80) {
+
         ALOGV("removing unsynchronization");
 
         removeUnsynchronization();
     }
 
+    // Enough for the extended headers we look at.
+    uint8_t ext[10];
+    size_t extSize = mSize < sizeof(ext) ? mSize : sizeof(ext);
+    if (readTag(0, ext, extSize) != (ssize_t)extSize) {
+        free(mData);
+        mData = NULL;
+
+        return false;
+    }
+
     mFirstFrameOffset = 0;
     if (header.version_major == 3 && (header.flags & 0x40)) {
         // Version 2.3 has an optional extended header.
@@ -190,7 +195,7 @@ struct id3_header {
             return false;
         }
 
-        size_t extendedHeaderSize = U32_AT(&mData[0]) + 4;
+        size_t extendedHeaderSize = U32_AT(&ext[0]) + 4;
 
         if (extendedHeaderSize > mSize) {
             free(mData);
@@ -203,10 +208,10 @@ struct id3_header {
 
         uint16_t extendedFlags = 0;
         if (extendedHeaderSize >= 6) {
-            extendedFlags = U16_AT(&mData[4]);
+            extendedFlags = U16_AT(&ext[4]);
 
             if (extendedHeaderSize >= 10) {
-                size_t paddingSize = U32_AT(&mData[6]);
+                size_t paddingSize = U32_AT(&ext[6]);
 
                 if (mFirstFrameOffset + paddingSize > mSize) {
                     free(mData);
@@ -227,24 +232,15 @@ struct id3_header {
         // from Version 2.3's...
 
         if (mSize < 4) {
-            free(mData);
-            mData = NULL;
-
             return false;
         }
 
         size_t ext_size;
-        if (!ParseSyncsafeInteger(mData, &ext_size)) {
-            free(mData);
-            mData = NULL;
-
+        if (!ParseSyncsafeInteger(ext, &ext_size)) {
             return false;
         }
 
         if (ext_size < 6 || ext_size > mSize) {
-            free(mData);
-            mData = NULL;
-
             return false;
         }
 
@@ -260,6 +256,24 @@ struct id3_header {
         mVersion = ID3_V2_4;
     }
 
+    bool success = indexFrames(false /* iTunesHack */);
+
+    if (!success && mVersion == ID3_V2_4) {
+        success = indexFrames(true /* iTunesHack */);
+
+        if (success) {
+            ALOGV("Had to apply the iTunes hack to parse this ID3 tag");
+        }
+    }
+
+    if (!success) {
+        free(mData);
+        mData = NULL;
+        mVersion = ID3_UNKNOWN;
+
+        return false;
+    }
+
     return true;
 }
 
@@ -272,82 +286,145 @@ void ID3::removeUnsynchronization() {
     }
 }
 
-static void WriteSyncsafeInteger(uint8_t *dst, size_t x) {
-    for (size_t i = 0; i < 4; ++i) {
-        dst[3 - i] = (x & 0x7f);
-        x >>= 7;
+ssize_t ID3::readTag(size_t offset, void *data, size_t size) const {
+    if (offset > mSize || size > mSize - offset) {
+        return ERROR_MALFORMED;
     }
+
+    if (mData != NULL) {
+        memcpy(data, &mData[offset], size);
+        return size;
+    }
+
+    // The tag body follows the 10 byte ID3v2 header.
+    return mSource->readAt(10 + offset, data, size);
 }
 
-bool ID3::removeUnsynchronizationV2_4(bool iTunesHack) {
-    size_t oldSize = mSize;
+bool ID3::indexFrames(bool iTunesHack) {
+    mFrames.clear();
 
-    size_t offset = 0;
-    while (offset + 10 <= mSize) {
-        if (!memcmp(&mData[offset], "\0\0\0\0", 4)) {
+    const size_t headerSize = (mVersion == ID3_V2_2) ? 6 : 10;
+    const size_t idSize = (mVersion == ID3_V2_2) ? 3 : 4;
+
+    size_t offset = mFirstFrameOffset;
+    while (offset + headerSize <= mSize) {
+        uint8_t header[10];
+        if (readTag(offset, header, headerSize) != (ssize_t)headerSize) {
+            return false;
+        }
+
+        if (!memcmp(header, "\0\0\0\0", idSize)) {
             break;
         }
 
         size_t dataSize;
-        if (iTunesHack) {
-            dataSize = U32_AT(&mData[offset + 4]);
-        } else if (!ParseSyncsafeInteger(&mData[offset + 4], &dataSize)) {
-            return false;
+        if (mVersion == ID3_V2_2) {
+            dataSize = (header[3] << 16) | (header[4] << 8) | header[5];
+        } else if (mVersion == ID3_V2_4 && !iTunesHack) {
+            if (!ParseSyncsafeInteger(&header[4], &dataSize)) {
+                return false;
+            }
+        } else {
+            dataSize = U32_AT(&header[4]);
         }
 
-        if (offset + dataSize + 10 > mSize) {
-            return false;
+        if (dataSize > mSize - offset - headerSize) {
+            if (mVersion == ID3_V2_4) {
+                return false;
+            }
+
+            ALOGV("partial frame at offset %d (size = %d, bytes-remaining = %d)",
+                 offset, dataSize, mSize - offset - headerSize);
+            break;
         }
 
-        uint16_t flags = U16_AT(&mData[offset + 8]);
-        uint16_t prevFlags = flags;
+        Frame frame;
+        memcpy(frame.mID, header, idSize);
+        frame.mID[idSize] = '\0';
+        frame.mOffset = offset + headerSize;
+        frame.mSize = dataSize;
+        frame.mFlags = (mVersion == ID3_V2_2) ? 0 : U16_AT(&header[8]);
+        frame.mData = (mData != NULL) ? &mData[frame.mOffset] : NULL;
+        frame.mDataSize = dataSize;
+        mFrames.push(frame);
 
-        if (flags & 1) {
-            // Strip data length indicator
+        offset += headerSize + dataSize;
+    }
 
-            memmove(&mData[offset + 10], &mData[offset + 14], mSize - offset - 14);
-            mSize -= 4;
-            dataSize -= 4;
+    return true;
+}
 
-            flags &= ~1;
-        }
+bool ID3::isFrameSupported(const Frame &frame) const {
+    // Compression or encryption are not supported at this time.
+    // Per-frame unsynchronization and data-length indicator are taken care
+    // of when the frame is read.
+    return !((mVersion == ID3_V2_4 && (frame.mFlags & 0x000c))
+            || (mVersion == ID3_V2_3 && (frame.mFlags & 0x00c0)));
+}
 
-        if (flags & 2) {
-            // Unsynchronization added.
+const uint8_t *ID3::getFrameData(size_t index, size_t *size) const {
+    *size = 0;
 
-            for (size_t i = 0; i + 1 < dataSize; ++i) {
-                if (mData[offset + 10 + i] == 0xff
-                        && mData[offset + 11 + i] == 0x00) {
-                    memmove(&mData[offset + 11 + i], &mData[offset + 12 + i],
-                            mSize - offset - 12 - i);
-                    --mSize;
-                    --dataSize;
-                }
-            }
+    Frame *frame = &mFrames.editItemAt(index);
 
-            flags &= ~2;
-        }
+    if (frame->mData != NULL) {
+        *size = frame->mDataSize;
+        return frame->mData;
+    }
+
+    size_t offset = frame->mOffset;
+    size_t dataSize = frame->mSize;
 
-        if (flags != prevFlags || iTunesHack) {
-            WriteSyncsafeInteger(&mData[offset + 4], dataSize);
-            mData[offset + 8] = flags >> 8;
-            mData[offset + 9] = flags & 0xff;
+    if (mVersion == ID3_V2_4 && (frame->mFlags & 1)) {
+        // Skip the data length indicator.
+        if (dataSize < 4) {
+            return NULL;
         }
 
-        offset += 10 + dataSize;
+        offset += 4;
+        dataSize -= 4;
     }
 
-    memset(&mData[mSize], 0, oldSize - mSize);
+    if (dataSize > kMaxMetadataSize) {
+        ALOGE("skipping huge ID3 frame '%s' of size %d", frame->mID, dataSize);
+        return NULL;
+    }
 
-    return true;
+    // Zero padded for the string scans of malformed frames.
+    uint8_t *data = (uint8_t *)malloc(dataSize + 2);
+    if (data == NULL) {
+        return NULL;
+    }
+
+    if (readTag(offset, data, dataSize) != (ssize_t)dataSize) {
+        free(data);
+        return NULL;
+    }
+
+    if (mVersion == ID3_V2_4 && (frame->mFlags & 2)) {
+        // Unsynchronization added.
+        for (size_t i = 0; i + 1 < dataSize; ++i) {
+            if (data[i] == 0xff && data[i + 1] == 0x00) {
+                memmove(&data[i + 1], &data[i + 2], dataSize - i - 2);
+                --dataSize;
+            }
+        }
+    }
+
+    data[dataSize] = 0;
+    data[dataSize + 1] = 0;
+
+    frame->mData = data;
+    frame->mDataSize = dataSize;
+
+    *size = dataSize;
+    return data;
 }
 
 ID3::Iterator::Iterator(const ID3 &parent, const char *id)
     : mParent(parent),
       mID(NULL),
-      mOffset(mParent.mFirstFrameOffset),
-      mFrameData(NULL),
-      mFrameSize(0) {
+      mIndex(0) {
     if (id) {
         mID = strdup(id);
     }
@@ -363,15 +440,15 @@ ID3::Iterator::~Iterator() {
 }
 
 bool ID3::Iterator::done() const {
-    return mFrameData == NULL;
+    return mIndex >= mParent.mFrames.size();
 }
 
 void ID3::Iterator::next() {
-    if (mFrameData == NULL) {
+    if (done()) {
         return;
     }
 
-    mOffset += mFrameSize;
+    ++mIndex;
 
     findFrame();
 }
@@ -379,44 +456,11 @@ void ID3::Iterator::next() {
 void ID3::Iterator::getID(String8 *id) const {
     id->setTo("");
 
-    if (mFrameData == NULL) {
+    if (done()) {
         return;
     }
 
-    if (mParent.mVersion == ID3_V2_2) {
-        id->setTo((const char *)&mParent.mData[mOffset], 3);
-    } else if (mParent.mVersion == ID3_V2_3 || mParent.mVersion == ID3_V2_4) {
-        id->setTo((const char *)&mParent.mData[mOffset], 4);
-    } else {
-        CHECK(mParent.mVersion == ID3_V1 || mParent.mVersion == ID3_V1_1);
-
-        switch (mOffset) {
-            case 3:
-                id->setTo("TT2");
-                break;
-            case 33:
-                id->setTo("TP1");
-                break;
-            case 63:
-                id->setTo("TAL");
-                break;
-            case 93:
-                id->setTo("TYE");
-                break;
-            case 97:
-                id->setTo("COM");
-                break;
-            case 126:
-                id->setTo("TRK");
-                break;
-            case 127:
-                id->setTo("TCO");
-                break;
-            default:
-                CHECK(!"should not be here.");
-                break;
-        }
-    }
+    id->setTo(mParent.mFrames.itemAt(mIndex).mID);
 }
 
 static void convertISO8859ToString8(
@@ -477,15 +521,18 @@ void ID3::Iterator::getString(String8 *id, String8 *comment) const {
 void ID3::Iterator::getstring(String8 *id, bool otherdata) const {
     id->setTo("");
 
-    const uint8_t *frameData = mFrameData;
-    if (frameData == NULL) {
+    size_t frameSize;
+    const uint8_t *frameData = getData(&frameSize);
+    if (frameData == NULL || frameSize == 0) {
         return;
     }
 
+    const uint8_t *start = frameData;
     uint8_t encoding = *frameData;
 
     if (mParent.mVersion == ID3_V1 || mParent.mVersion == ID3_V1_1) {
-        if (mOffset == 126 || mOffset == 127) {
+        const char *frameID = mParent.mFrames.itemAt(mIndex).mID;
+        if (!strcmp(frameID, "TRK") || !strcmp(frameID, "TCO")) {
             // Special treatment for the track number and genre.
             char tmp[16];
             sprintf(tmp, "%d", (int)*frameData);
@@ -494,17 +541,17 @@ void ID3::Iterator::getstring(String8 *id, bool otherdata) const {
             return;
         }
 
-        convertISO8859ToString8(frameData, mFrameSize, id);
+        convertISO8859ToString8(frameData, frameSize, id);
         return;
     }
 
-    size_t n = mFrameSize - getHeaderLength() - 1;
+    size_t n = frameSize - 1;
     if (otherdata) {
         // skip past the encoding, language, and the 0 separator
         frameData += 4;
         int32_t i = n - 4;
         while(--i >= 0 && *++frameData != 0) ;
-        int skipped = (frameData - mFrameData);
+        size_t skipped = (frameData - start);
         if (skipped >= n) {
             return;
         }
@@ -563,252 +610,204 @@ void ID3::Iterator::getstring(String8 *id, bool otherdata) const {
 const uint8_t *ID3::Iterator::getData(size_t *length) const {
     *length = 0;
 
-    if (mFrameData == NULL) {
+    if (done()) {
         return NULL;
     }
 
-    *length = mFrameSize - getHeaderLength();
-
-    return mFrameData;
-}
-
-size_t ID3::Iterator::getHeaderLength() const {
-    if (mParent.mVersion == ID3_V2_2) {
-        return 6;
-    } else if (mParent.mVersion == ID3_V2_3 || mParent.mVersion == ID3_V2_4) {
-        return 10;
-    } else {
-        CHECK(mParent.mVersion == ID3_V1 || mParent.mVersion == ID3_V1_1);
-        return 0;
-    }
+    return mParent.getFrameData(mIndex, length);
 }
 
 void ID3::Iterator::findFrame() {
-    for (;;) {
-        mFrameData = NULL;
-        mFrameSize = 0;
-
-        if (mParent.mVersion == ID3_V2_2) {
-            if (mOffset + 6 > mParent.mSize) {
-                return;
-            }
-
-            if (!memcmp(&mParent.mData[mOffset], "\0\0\0", 3)) {
-                return;
-            }
-
-            mFrameSize =
-                (mParent.mData[mOffset + 3] << 16)
-                | (mParent.mData[mOffset + 4] << 8)
-                | mParent.mData[mOffset + 5];
-
-            mFrameSize += 6;
+    for (; mIndex < mParent.mFrames.size(); ++mIndex) {
+        const Frame &frame = mParent.mFrames.itemAt(mIndex);
 
-            if (mOffset + mFrameSize > mParent.mSize) {
-                ALOGV("partial frame at offset %d (size = %d, bytes-remaining = %d)",
-                     mOffset, mFrameSize, mParent.mSize - mOffset - 6);
-                return;
-            }
-
-            mFrameData = &mParent.mData[mOffset + 6];
-
-            if (!mID) {
-                break;
-            }
-
-            char id[4];
-            memcpy(id, &mParent.mData[mOffset], 3);
-            id[3] = '\0';
-
-            if (!strcmp(id, mID)) {
-                break;
-            }
-        } else if (mParent.mVersion == ID3_V2_3
-                || mParent.mVersion == ID3_V2_4) {
-            if (mOffset + 10 > mParent.mSize) {
-                return;
-            }
-
-            if (!memcmp(&mParent.mData[mOffset], "\0\0\0\0", 4)) {
-                return;
-            }
+        if (!mParent.isFrameSupported(frame)) {
+            ALOGV("Skipping unsupported frame (compression, encryption "
+                 "or per-frame unsynchronization flagged");
+            continue;
+        }
 
-            size_t baseSize;
-            if (mParent.mVersion == ID3_V2_4) {
-                if (!ParseSyncsafeInteger(
-                            &mParent.mData[mOffset + 4], &baseSize)) {
-                    return;
-                }
-            } else {
-                baseSize = U32_AT(&mParent.mData[mOffset + 4]);
-            }
+        if (!mID || !strcmp(frame.mID, mID)) {
+            return;
+        }
+    }
+}
 
-            mFrameSize = 10 + baseSize;
+// Returns the size of the terminated string at |start|, including the
+// terminator, or 0 if it isn't terminated within |size| bytes.
+static size_t StringSize(const uint8_t *start, size_t size, uint8_t encoding) {
+    if (encoding == 0x00 || encoding == 0x03) {
+        // ISO 8859-1 or UTF-8
+        const void *end = memchr(start, '\0', size);
+        return end != NULL ? (const uint8_t *)end - start + 1 : 0;
+    }
 
-            if (mOffset + mFrameSize > mParent.mSize) {
-                ALOGV("partial frame at offset %d (size = %d, bytes-remaining = %d)",
-                     mOffset, mFrameSize, mParent.mSize - mOffset - 10);
-                return;
-            }
+    // UCS-2
+    for (size_t n = 0; n + 1 < size; n += 2) {
+        if (start[n] == '\0' && start[n + 1] == '\0') {
+            return n + 2;
+        }
+    }
 
-            uint16_t flags = U16_AT(&mParent.mData[mOffset + 8]);
+    return 0;
+}
 
-            if ((mParent.mVersion == ID3_V2_4 && (flags & 0x000c))
-                || (mParent.mVersion == ID3_V2_3 && (flags & 0x00c0))) {
-                // Compression or encryption are not supported at this time.
-                // Per-frame unsynchronization and data-length indicator
-                // have already been taken care of.
+// Finds where the picture data starts in the first |size| bytes of an
+// APIC or PIC frame.
+static bool ParseAlbumArtHeader(
+        ID3::Version version, const uint8_t *data, size_t size,
+        size_t *headerSize, String8 *mime) {
+    if (size < 5) {
+        return false;
+    }
 
-                ALOGV("Skipping unsupported frame (compression, encryption "
-                     "or per-frame unsynchronization flagged");
+    uint8_t encoding = data[0];
 
-                mOffset += mFrameSize;
-                continue;
-            }
+    if (version == ID3::ID3_V2_3 || version == ID3::ID3_V2_4) {
+        size_t mimeLen = StringSize(&data[1], size - 1, 0x00);
+        if (mimeLen == 0 || 2 + mimeLen > size) {
+            return false;
+        }
+        mime->setTo((const char *)&data[1]);
 
-            mFrameData = &mParent.mData[mOffset + 10];
+#if 0
+        uint8_t picType = data[1 + mimeLen];
+        if (picType != 0x03) {
+            // Front Cover Art
+            return false;
+        }
+#endif
 
-            if (!mID) {
-                break;
-            }
+        size_t descLen =
+            StringSize(&data[2 + mimeLen], size - 2 - mimeLen, encoding);
+        if (descLen == 0) {
+            return false;
+        }
 
-            char id[5];
-            memcpy(id, &mParent.mData[mOffset], 4);
-            id[4] = '\0';
+        *headerSize = 2 + mimeLen + descLen;
+        return true;
+    }
 
-            if (!strcmp(id, mID)) {
-                break;
-            }
-        } else {
-            CHECK(mParent.mVersion == ID3_V1 || mParent.mVersion == ID3_V1_1);
+    if (!memcmp(&data[1], "PNG", 3)) {
+        mime->setTo("image/png");
+    } else if (!memcmp(&data[1], "JPG", 3)) {
+        mime->setTo("image/jpeg");
+    } else if (!memcmp(&data[1], "-->", 3)) {
+        mime->setTo("text/plain");
+    } else {
+        return false;
+    }
 
-            if (mOffset >= mParent.mSize) {
-                return;
-            }
+#if 0
+    uint8_t picType = data[4];
+    if (picType != 0x03) {
+        // Front Cover Art
+        return false;
+    }
+#endif
 
-            mFrameData = &mParent.mData[mOffset];
-
-            switch (mOffset) {
-                case 3:
-                case 33:
-                case 63:
-                    mFrameSize = 30;
-                    break;
-                case 93:
-                    mFrameSize = 4;
-                    break;
-                case 97:
-                    if (mParent.mVersion == ID3_V1) {
-                        mFrameSize = 30;
-                    } else {
-                        mFrameSize = 29;
-                    }
-                    break;
-                case 126:
-                    mFrameSize = 1;
-                    break;
-                case 127:
-                    mFrameSize = 1;
-                    break;
-                default:
-                    CHECK(!"Should not be here, invalid offset.");
-                    break;
-            }
+    size_t descLen = StringSize(&data[5], size - 5, encoding);
+    if (descLen == 0) {
+        return false;
+    }
 
-            if (!mID) {
-                break;
-            }
+    *headerSize = 5 + descLen;
+    return true;
+}
 
-            String8 id;
-            getID(&id);
+ssize_t ID3::findAlbumArtFrame() const {
+    const char *id =
+        (mVersion == ID3_V2_3 || mVersion == ID3_V2_4) ? "APIC" : "PIC";
 
-            if (id == mID) {
-                break;
-            }
+    for (size_t i = 0; i < mFrames.size(); ++i) {
+        const Frame &frame = mFrames.itemAt(i);
+        if (isFrameSupported(frame) && !strcmp(frame.mID, id)) {
+            return i;
         }
-
-        mOffset += mFrameSize;
     }
+
+    return -1;
 }
 
-static size_t StringSize(const uint8_t *start, uint8_t encoding) {
-    if (encoding == 0x00 || encoding == 0x03) {
-        // ISO 8859-1 or UTF-8
-        return strlen((const char *)start) + 1;
+const void *
+ID3::getAlbumArt(size_t *length, String8 *mime) const {
+    *length = 0;
+    mime->setTo("");
+
+    ssize_t index = findAlbumArtFrame();
+    if (index < 0) {
+        return NULL;
     }
 
-    // UCS-2
-    size_t n = 0;
-    while (start[n] != '\0' || start[n + 1] != '\0') {
-        n += 2;
+    size_t size;
+    const uint8_t *data = getFrameData(index, &size);
+
+    size_t headerSize;
+    if (data == NULL
+            || !ParseAlbumArtHeader(mVersion, data, size, &headerSize, mime)) {
+        mime->setTo("");
+        return NULL;
     }
 
-    return n;
+    *length = size - headerSize;
+
+    return &data[headerSize];
 }
 
-const void *
-ID3::getAlbumArt(size_t *length, String8 *mime) const {
+bool ID3::getAlbumArtLocation(
+        off64_t *offset, size_t *length, String8 *mime) const {
+    *offset = 0;
     *length = 0;
     mime->setTo("");
 
-    Iterator it(
-            *this,
-            (mVersion == ID3_V2_3 || mVersion == ID3_V2_4) ? "APIC" : "PIC");
-
-    while (!it.done()) {
-        size_t size;
-        const uint8_t *data = it.getData(&size);
-
-        if (mVersion == ID3_V2_3 || mVersion == ID3_V2_4) {
-            uint8_t encoding = data[0];
-            mime->setTo((const char *)&data[1]);
-            size_t mimeLen = strlen((const char *)&data[1]) + 1;
+    if (mData != NULL) {
+        // The tag in memory doesn't match the one in the source.
+        return false;
+    }
 
-            uint8_t picType = data[1 + mimeLen];
-#if 0
-            if (picType != 0x03) {
-                // Front Cover Art
-                it.next();
-                continue;
-            }
-#endif
+    ssize_t index = findAlbumArtFrame();
+    if (index < 0) {
+        return false;
+    }
 
-            size_t descLen = StringSize(&data[2 + mimeLen], encoding);
+    const Frame &frame = mFrames.itemAt(index);
 
-            *length = size - 2 - mimeLen - descLen;
+    size_t frameOffset = frame.mOffset;
+    size_t frameSize = frame.mSize;
 
-            return &data[2 + mimeLen + descLen];
-        } else {
-            uint8_t encoding = data[0];
-
-            if (!memcmp(&data[1], "PNG", 3)) {
-                mime->setTo("image/png");
-            } else if (!memcmp(&data[1], "JPG", 3)) {
-                mime->setTo("image/jpeg");
-            } else if (!memcmp(&data[1], "-->", 3)) {
-                mime->setTo("text/plain");
-            } else {
-                return NULL;
-            }
+    if (mVersion == ID3_V2_4) {
+        if (frame.mFlags & 2) {
+            // Unsynchronized, the picture has to be read through
+            // getAlbumArt().
+            return false;
+        }
 
-#if 0
-            uint8_t picType = data[4];
-            if (picType != 0x03) {
-                // Front Cover Art
-                it.next();
-                continue;
+        if (frame.mFlags & 1) {
+            if (frameSize < 4) {
+                return false;
             }
-#endif
 
-            size_t descLen = StringSize(&data[5], encoding);
+            frameOffset += 4;
+            frameSize -= 4;
+        }
+    }
 
-            *length = size - 5 - descLen;
+    uint8_t header[kMaxAlbumArtHeaderSize];
+    size_t size = frameSize < sizeof(header) ? frameSize : sizeof(header);
+    if (readTag(frameOffset, header, size) != (ssize_t)size) {
+        return false;
+    }
 
-            return &data[5 + descLen];
-        }
+    size_t headerSize;
+    if (!ParseAlbumArtHeader(mVersion, header, size, &headerSize, mime)) {
+        mime->setTo("");
+        return false;
     }
 
-    return NULL;
+    *offset = 10 + frameOffset + headerSize;
+    *length = frameSize - headerSize;
+
+    return true;
 }
 
 bool ID3::parseV1(const sp<DataSource> &source) {
@@ -844,6 +843,44 @@ bool ID3::parseV1(const sp<DataSource> &source) {
         mVersion = ID3_V1_1;
     }
 
+    // The fields of a version 1 tag are at fixed offsets, they're listed
+    // under the IDs of the corresponding version 2.2 frames.
+    struct Field {
+        const char *mID;
+        size_t mOffset;
+        size_t mSize;
+    };
+    static const Field kFields[] = {
+        { "TT2", 3, 30 },
+        { "TP1", 33, 30 },
+        { "TAL", 63, 30 },
+        { "TYE", 93, 4 },
+        { "COM", 97, 30 },
+        { "TRK", 126, 1 },
+        { "TCO", 127, 1 },
+    };
+    static const size_t kNumFields = sizeof(kFields) / sizeof(kFields[0]);
+
+    mFrames.clear();
+    for (size_t i = 0; i < kNumFields; ++i) {
+        if (mVersion == ID3_V1 && !strcmp(kFields[i].mID, "TRK")) {
+            // Version 1.1 took the last comment byte for the track number.
+            continue;
+        }
+
+        Frame frame;
+        strcpy(frame.mID, kFields[i].mID);
+        frame.mOffset = kFields[i].mOffset;
+        frame.mSize = kFields[i].mSize;
+        if (mVersion == ID3_V1_1 && !strcmp(frame.mID, "COM")) {
+            frame.mSize = 29;
+        }
+        frame.mFlags = 0;
+        frame.mData = &mData[frame.mOffset];
+        frame.mDataSize = frame.mSize;
+        mFrames.push(frame);
+    }
+
     return true;
 }
 
@@ -20,11 +20,10 @@
 
 #include <media/stagefright/MediaExtractor.h>
 
-#include <utils/Vector.h>
-
 namespace android {
 
 struct AMessage;
+struct FrameOffsetIndex;
 class String8;
 
 class AACExtractor : public MediaExtractor {
@@ -45,7 +44,7 @@ private:
     sp<MetaData> mMeta;
     status_t mInitCheck;
 
-    Vector<uint64_t> mOffsetVector;
+    sp<FrameOffsetIndex> mIndex;
     int64_t mFrameDurationUs;
 
     AACExtractor(const AACExtractor &);
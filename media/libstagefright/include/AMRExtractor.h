@@ -24,8 +24,8 @@
 namespace android {
 
 struct AMessage;
+struct FrameOffsetIndex;
 class String8;
-#define OFFSET_TABLE_LEN    300
 
 class AMRExtractor : public MediaExtractor {
 public:
@@ -46,8 +46,7 @@ private:
     status_t mInitCheck;
     bool mIsWide;
 
-    off64_t mOffsetTable[OFFSET_TABLE_LEN]; //5 min
-    size_t mOffsetTableLength;
+    sp<FrameOffsetIndex> mIndex;
 
     AMRExtractor(const AMRExtractor &);
     AMRExtractor &operator=(const AMRExtractor &);
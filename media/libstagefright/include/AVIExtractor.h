@@ -21,6 +21,7 @@
 #include <media/stagefright/foundation/ABase.h>
 #include <media/stagefright/MediaExtractor.h>
 #include <media/stagefright/MediaSource.h>
+#include <utils/threads.h>
 #include <utils/Vector.h>
 
 namespace android {
@@ -49,9 +50,28 @@ private:
         bool mIsKey;
     };
 
+    // An OpenDML standard index, an 'ix##' chunk listing a range of one
+    // track's chunks. Only its header is read up front, its entries are
+    // loaded once a sample in its range is accessed.
+    struct IndexSegment {
+        off64_t mOffset;
+        uint32_t mSize;
+        off64_t mBaseOffset;
+        size_t mFirstSample;
+        size_t mNumSamples;
+    };
+
     struct Track {
         sp<MetaData> mMeta;
+
+        // All samples if the track is indexed by idx1, otherwise those of
+        // mIndexSegments[mLoadedSegment], relative to its mBaseOffset.
         Vector<SampleInfo> mSamples;
+        size_t mNumSamples;
+
+        Vector<IndexSegment> mIndexSegments;
+        ssize_t mLoadedSegment;
+
         uint32_t mRate;
         uint32_t mScale;
 
@@ -71,6 +91,7 @@ private:
         size_t mThumbnailSampleSize;
         ssize_t mThumbnailSampleIndex;
         size_t mMaxSampleSize;
+        size_t mSuggestedBufferSize;
 
         // If mBytesPerSample > 0:
         double mAvgChunkSize;
@@ -79,6 +100,9 @@ private:
 
     sp<DataSource> mDataSource;
     status_t mInitCheck;
+
+    // Guards the loading of index segments by the tracks' sources.
+    Mutex mLock;
     Vector<Track> mTracks;
 
     off64_t mMovieOffset;
@@ -89,6 +113,12 @@ private:
     status_t parseStreamHeader(off64_t offset, size_t size);
     status_t parseStreamFormat(off64_t offset, size_t size);
     status_t parseIndex(off64_t offset, size_t size);
+    status_t parseSuperIndex(off64_t offset, size_t size);
+    status_t parseIndexSegment(IndexSegment *segment);
+    status_t loadIndexSegment(Track *track, size_t segmentIndex);
+    bool hasOpenDMLIndex() const;
+    status_t scanSyncSamples(size_t trackIndex);
+    status_t finishIndex();
 
     status_t parseHeaders();
 
@@ -97,13 +127,22 @@ private:
             off64_t *offset, size_t *size, bool *isKey,
             int64_t *sampleTimeUs);
 
+    status_t getSampleInfo_l(
+            size_t trackIndex, size_t sampleIndex,
+            off64_t *offset, size_t *size, bool *isKey,
+            int64_t *sampleTimeUs);
+
+    // The offset of the sample's chunk header and whether it's a key frame.
+    status_t getSampleEntry_l(
+            Track *track, size_t sampleIndex, off64_t *offset, bool *isKey);
+
     status_t getSampleTime(
             size_t trackIndex, size_t sampleIndex, int64_t *sampleTimeUs);
 
     status_t getSampleIndexAtTime(
             size_t trackIndex,
             int64_t timeUs, MediaSource::ReadOptions::SeekMode mode,
-            size_t *sampleIndex) const;
+            size_t *sampleIndex);
 
     status_t addMPEG4CodecSpecificData(size_t trackIndex);
     status_t addH264CodecSpecificData(size_t trackIndex);
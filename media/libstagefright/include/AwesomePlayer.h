@@ -261,6 +261,12 @@ private:
     void setVideoSource(sp<MediaSource> source);
     status_t initVideoDecoder(uint32_t flags = 0);
 
+    // Instantiates the audio decoder on a helper thread while the video
+    // decoder is set up on the calling one, see onPrepareAsyncEvent.
+    status_t initDecodersInParallel();
+    static void *InitAudioDecoderWrapper(void *me);
+    status_t mAudioDecoderInitResult;
+
     void addTextSource_l(size_t trackIndex, const sp<MediaSource>& source);
 
     void onStreamDone();
@@ -276,6 +282,7 @@ private:
     void onVideoLagUpdate();
 
     bool getCachedDuration_l(int64_t *durationUs, bool *eos);
+    int64_t getPrepareWaterMarkUs_l();
 
     status_t finishSetDataSource_l();
 
@@ -333,6 +340,14 @@ private:
 
         int64_t mNumVideoFramesDecoded;
         int64_t mNumVideoFramesDropped;
+        int64_t mVideoDecodeTimeUs;
+        int64_t mVideoLatenessUs;
+        int64_t mMaxVideoLatenessUs;
+        int64_t mNumRebuffers;
+        int64_t mRebufferTimeUs;
+        int64_t mRebufferStartUs;
+        int64_t mCachedBytes;
+        int64_t mCachedDurationUs;
         int32_t mVideoWidth;
         int32_t mVideoHeight;
         uint32_t mFlags;
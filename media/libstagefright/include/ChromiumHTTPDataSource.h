@@ -59,6 +59,10 @@ struct ChromiumHTTPDataSource : public HTTPBase {
 
     virtual status_t reconnectAtOffset(off64_t offset);
 
+    virtual sp<HTTPBase> createConnection(off64_t offset);
+
+    virtual String8 getCacheValidator();
+
 protected:
     virtual ~ChromiumHTTPDataSource();
 
@@ -94,12 +98,17 @@ private:
     int64_t mContentSize;
 
     String8 mContentType;
+    String8 mCacheValidator;
 
     sp<DecryptHandle> mDecryptHandle;
     DrmManagerClient *mDrmManagerClient;
 
     void disconnect_l();
 
+    // Reads up to "offset" on the current connection, instead of
+    // reconnecting for a short skip ahead.
+    status_t skipTo_l(off64_t offset);
+
     status_t connect_l(
             const char *uri,
             const KeyedVector<String8, String8> *headers,
@@ -111,7 +120,8 @@ private:
     void initiateRead(void *data, size_t size);
 
     void onConnectionEstablished(
-            int64_t contentSize, const char *contentType);
+            int64_t contentSize, const char *contentType,
+            const char *cacheValidator);
 
     void onConnectionFailed(status_t err);
     void onReadCompleted(ssize_t size);
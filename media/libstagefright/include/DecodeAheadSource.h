@@ -0,0 +1,90 @@
+/*
+ * Copyright (C) 2012 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef DECODE_AHEAD_SOURCE_H_
+
+#define DECODE_AHEAD_SOURCE_H_
+
+#include <media/stagefright/MediaSource.h>
+#include <utils/List.h>
+#include <utils/threads.h>
+
+#include <pthread.h>
+
+namespace android {
+
+// Reads up to "maxQueuedBuffers" buffers ahead from a decoder on its own
+// thread, so that a slow decode doesn't delay the client's next read.
+// Reads with a seek option drop whatever was decoded ahead and are passed
+// to the decoder synchronously.
+struct DecodeAheadSource : public MediaSource {
+    DecodeAheadSource(
+            const sp<MediaSource> &source, size_t maxQueuedBuffers);
+
+    virtual status_t start(MetaData *params = NULL);
+    virtual status_t stop();
+
+    virtual sp<MetaData> getFormat();
+
+    virtual status_t read(
+            MediaBuffer **buffer, const ReadOptions *options = NULL);
+
+    virtual status_t pause();
+
+protected:
+    virtual ~DecodeAheadSource();
+
+private:
+    struct Entry {
+        MediaBuffer *mBuffer;
+        status_t mResult;
+    };
+
+    Mutex mLock;
+    Condition mCondition;
+
+    sp<MediaSource> mSource;
+    size_t mMaxQueuedBuffers;
+
+    pthread_t mThread;
+    bool mStarted;
+    bool mDone;
+
+    // Set while the thread is inside mSource->read().
+    bool mReading;
+
+    // Set while the client performs a seek, the thread stays idle.
+    bool mSeeking;
+
+    // Set once an error other than INFO_FORMAT_CHANGED has been queued,
+    // reads past it keep returning mFinalResult.
+    bool mReachedEOS;
+    status_t mFinalResult;
+
+    List<Entry> mQueue;
+
+    static void *ThreadWrapper(void *me);
+    void threadEntry();
+
+    void flushQueue_l();
+
+    DecodeAheadSource(const DecodeAheadSource &);
+    DecodeAheadSource &operator=(const DecodeAheadSource &);
+};
+
+}  // namespace android
+
+#endif  // DECODE_AHEAD_SOURCE_H_
@@ -0,0 +1,75 @@
+/*
+ * Copyright (C) 2012 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FRAME_OFFSET_INDEX_H_
+
+#define FRAME_OFFSET_INDEX_H_
+
+#include <utils/RefBase.h>
+#include <utils/threads.h>
+#include <utils/Vector.h>
+
+#include <sys/types.h>
+
+namespace android {
+
+// Offsets of every "framesPerEntry"-th frame of a stream made of frames of
+// equal duration, recorded as the stream is read instead of by walking the
+// whole file up front. Shared by an extractor and the sources it creates.
+struct FrameOffsetIndex : public RefBase {
+    FrameOffsetIndex(off64_t firstFrameOffset, size_t framesPerEntry);
+
+    // Records that "frame" starts at "offset" and spans "size" bytes. Only
+    // the frame directly following the indexed ones extends the index.
+    void addFrame(int64_t frame, off64_t offset, size_t size);
+
+    // No frames follow the indexed ones.
+    void setComplete();
+    bool isComplete();
+
+    // Number of frames indexed and the offset just past the last of them.
+    int64_t countFrames();
+    off64_t endOffset();
+
+    // Finds the closest recorded frame at or before "frame", returns false
+    // if "frame" is not indexed yet.
+    bool findFrame(int64_t frame, int64_t *entryFrame, off64_t *offset);
+
+    // Estimates where "frame" starts from the average size of the frames
+    // indexed so far, or from "defaultFrameSize" before any are.
+    off64_t estimateOffset(int64_t frame, size_t defaultFrameSize);
+
+protected:
+    virtual ~FrameOffsetIndex();
+
+private:
+    Mutex mLock;
+
+    off64_t mFirstFrameOffset;
+    size_t mFramesPerEntry;
+
+    Vector<off64_t> mOffsets;
+    int64_t mNumFrames;
+    off64_t mEndOffset;
+    bool mComplete;
+
+    FrameOffsetIndex(const FrameOffsetIndex &);
+    FrameOffsetIndex &operator=(const FrameOffsetIndex &);
+};
+
+}  // namespace android
+
+#endif  // FRAME_OFFSET_INDEX_H_
@@ -0,0 +1,85 @@
+/*
+ * Copyright (C) 2012 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FRAME_SCAN_SEEKER_H_
+
+#define FRAME_SCAN_SEEKER_H_
+
+#include "include/MP3Seeker.h"
+
+#include <utils/threads.h>
+#include <utils/Vector.h>
+
+#include <pthread.h>
+
+namespace android {
+
+struct DataSource;
+
+// Builds an index of frame offsets by walking every frame of the stream on
+// its own thread. Seeks to a time the scan has already passed land on the
+// exact frame containing that time, other seeks fail so that the caller
+// can fall back to an estimate.
+struct FrameScanSeeker : public MP3Seeker {
+    FrameScanSeeker(
+            const sp<DataSource> &source, off64_t first_frame_pos,
+            uint32_t fixed_header);
+
+    void start();
+
+    virtual bool getDuration(int64_t *durationUs);
+    virtual bool getOffsetForTime(int64_t *timeUs, off64_t *pos);
+
+protected:
+    virtual ~FrameScanSeeker();
+
+private:
+    struct Entry {
+        int64_t mTimeUs;
+        off64_t mPos;
+    };
+
+    Mutex mLock;
+
+    sp<DataSource> mSource;
+    off64_t mFirstFramePos;
+    uint32_t mFixedHeader;
+
+    pthread_t mThread;
+    bool mStarted;
+    volatile bool mDone;
+
+    // One entry per kEntryIntervalUs of audio, in increasing time order.
+    Vector<Entry> mEntries;
+
+    // Time of the last frame the scan has reached.
+    int64_t mScannedUs;
+
+    // Set once the scan has reached the end of the stream.
+    bool mComplete;
+    int64_t mDurationUs;
+
+    static void *ThreadWrapper(void *me);
+    void threadEntry();
+
+    bool findFrame(off64_t pos, size_t *frameSize, int64_t *frameUs);
+
+    DISALLOW_EVIL_CONSTRUCTORS(FrameScanSeeker);
+};
+
+}  // namespace android
+
+#endif  // FRAME_SCAN_SEEKER_H_
@@ -41,13 +41,25 @@ struct HTTPBase : public DataSource {
     virtual void disconnect() = 0;
 
     // Returns true if bandwidth could successfully be estimated,
-    // false otherwise.
+    // false otherwise. Until this source has measured enough, the estimate
+    // is the one remembered for the current network.
     virtual bool estimateBandwidth(int32_t *bandwidth_bps);
 
     virtual status_t getEstimatedBandwidthKbps(int32_t *kbps);
 
     virtual status_t setBandwidthStatCollectFreq(int32_t freqMs);
 
+    // Opens another connection to the URI this source is connected to,
+    // with the same headers and UID, starting at offset. Bandwidth
+    // measurements of the new connection are added to this source's.
+    // Returns NULL if not supported or if the connection failed.
+    virtual sp<HTTPBase> createConnection(off64_t offset);
+
+    // Returns the entity tag of the content, or its last modification date
+    // if the server did not send one, empty if neither is known. Content
+    // with the same URI and validator can be cached across connections.
+    virtual String8 getCacheValidator();
+
     void setUID(uid_t uid);
     bool getUID(uid_t *uid) const;
 
@@ -56,9 +68,15 @@ struct HTTPBase : public DataSource {
     static void RegisterSocketUserTag(int sockfd, uid_t uid, uint32_t kTag);
     static void UnRegisterSocketUserTag(int sockfd);
 
+    // Returns the bandwidth recent streams in this process measured on the
+    // network currently in use, false if there's no recent estimate for it.
+    static bool GetNetworkBandwidthEstimate(int32_t *bandwidthBps);
+
 protected:
     void addBandwidthMeasurement(size_t numBytes, int64_t delayUs);
 
+    void setBandwidthOwner(const sp<HTTPBase> &owner);
+
 private:
     struct BandwidthEntry {
         int64_t mDelayUs;
@@ -81,9 +99,16 @@ private:
     int32_t mPrevEstimatedBandWidthKbps;
     int32_t mBandWidthCollectFreqMs;
 
+    int64_t mPrevNetworkBandwidthUpdateUs;
+
     bool mUIDValid;
     uid_t mUID;
 
+    wp<HTTPBase> mBandwidthOwner;
+
+    static void UpdateNetworkBandwidth(double bandwidthBps);
+    static String8 GetNetworkKey();
+
     DISALLOW_EVIL_CONSTRUCTORS(HTTPBase);
 };
 
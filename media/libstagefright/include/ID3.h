@@ -19,6 +19,7 @@
 #define ID3_H_
 
 #include <utils/RefBase.h>
+#include <utils/Vector.h>
 
 namespace android {
 
@@ -44,6 +45,12 @@ struct ID3 {
 
     const void *getAlbumArt(size_t *length, String8 *mime) const;
 
+    // Where the image data of the album art lies in the source, so that it
+    // can be read only once it is wanted. Returns false if there is none or
+    // if it isn't stored as is, getAlbumArt() still works in that case.
+    bool getAlbumArtLocation(
+            off64_t *offset, size_t *length, String8 *mime) const;
+
     struct Iterator {
         Iterator(const ID3 &parent, const char *id);
         ~Iterator();
@@ -57,14 +64,10 @@ struct ID3 {
     private:
         const ID3 &mParent;
         char *mID;
-        size_t mOffset;
-
-        const uint8_t *mFrameData;
-        size_t mFrameSize;
+        size_t mIndex;
 
         void findFrame();
 
-        size_t getHeaderLength() const;
         void getstring(String8 *s, bool secondhalf) const;
 
         Iterator(const Iterator &);
@@ -72,16 +75,44 @@ struct ID3 {
     };
 
 private:
+    // Tag parsing only indexes the frames, their payloads are read when
+    // they are first asked for.
+    struct Frame {
+        char mID[5];
+
+        // Of the payload within the tag, stored size.
+        size_t mOffset;
+        size_t mSize;
+        uint16_t mFlags;
+
+        // The payload as it reads once the per-frame unsynchronization and
+        // data length indicator are undone, NULL until loaded.
+        uint8_t *mData;
+        size_t mDataSize;
+    };
+
     bool mIsValid;
+    sp<DataSource> mSource;
+
+    // The whole tag, only set for ID3v1 tags and ID3v2 tags whose
+    // unsynchronization has to be removed before the frames can be found.
     uint8_t *mData;
+
     size_t mSize;
     size_t mFirstFrameOffset;
     Version mVersion;
 
+    mutable Vector<Frame> mFrames;
+
     bool parseV1(const sp<DataSource> &source);
     bool parseV2(const sp<DataSource> &source);
     void removeUnsynchronization();
-    bool removeUnsynchronizationV2_4(bool iTunesHack);
+    bool indexFrames(bool iTunesHack);
+
+    ssize_t readTag(size_t offset, void *data, size_t size) const;
+    bool isFrameSupported(const Frame &frame) const;
+    const uint8_t *getFrameData(size_t index, size_t *size) const;
+    ssize_t findAlbumArtFrame() const;
 
     static bool ParseSyncsafeInteger(const uint8_t encoded[4], size_t *x);
 
@@ -0,0 +1,66 @@
+/*
+ * Copyright (C) 2012 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef JPEG_DECODER_H_
+
+#define JPEG_DECODER_H_
+
+#include <media/IOMX.h>
+#include <utils/Errors.h>
+
+namespace android {
+
+class MediaAlbumArt;
+
+// Decodes JPEG images for thumbnails. Baseline images go to a hardware OMX
+// JPEG decoder if the device lists one, everything else (and whatever the
+// OMX decoder fails on) is decoded by libjpeg with its scaled IDCT, at 1/2,
+// 1/4 or 1/8 of the full size whenever that still covers the target size.
+struct JPEGDecoder {
+    JPEGDecoder(const sp<IOMX> &omx);
+
+    // Decodes |data| to packed RGB888 that fits |maxDimension| pixels on
+    // its longer side, or at full size if |maxDimension| is 0. On success
+    // |*rgb| is allocated with malloc() and owned by the caller.
+    status_t decode(
+            const void *data, size_t size, int32_t maxDimension,
+            uint8_t **rgb, int32_t *width, int32_t *height);
+
+    // Returns |art| re-encoded as a JPEG that fits |maxDimension| pixels,
+    // or NULL if it isn't a JPEG or is no larger than that already.
+    MediaAlbumArt *createThumbnail(
+            const MediaAlbumArt &art, int32_t maxDimension);
+
+    static status_t Encode(
+            const uint8_t *rgb, int32_t width, int32_t height, int quality,
+            uint8_t **data, size_t *size);
+
+private:
+    sp<IOMX> mOMX;
+    bool mHaveOMXDecoder;
+
+    status_t decodeWithOMX(
+            const void *data, size_t size,
+            int32_t width, int32_t height, int32_t maxDimension,
+            uint8_t **rgb, int32_t *outWidth, int32_t *outHeight);
+
+    JPEGDecoder(const JPEGDecoder &);
+    JPEGDecoder &operator=(const JPEGDecoder &);
+};
+
+}  // namespace android
+
+#endif  // JPEG_DECODER_H_
@@ -20,11 +20,14 @@
 
 #include <media/stagefright/foundation/AHandler.h>
 
+#include <utils/List.h>
 #include <utils/String8.h>
 
 namespace android {
 
 struct ABuffer;
+struct ALooper;
+struct AdaptationPolicy;
 struct DataSource;
 struct LiveDataSource;
 struct M3UParser;
@@ -53,6 +56,12 @@ struct LiveSession : public AHandler {
 
     void setCurrentPlayingTime(int64_t curPlayTime);
 
+    void dump(int fd);
+
+    // Dumps the state and variant selection history of all sessions
+    // of the process.
+    static void DumpSessions(int fd);
+
 protected:
     virtual ~LiveSession();
 
@@ -62,6 +71,10 @@ private:
     enum {
         kMaxNumQueuedFragments = 3,
         kMaxNumRetries         = 5,
+        kDefaultNumPrefetchers = 2,
+        kMaxNumPrefetchers     = 4,
+        kMaxPrefetchBytes      = 8 * 1024 * 1024,
+        kMaxNumLoggedDecisions = 64,
     };
 
     enum {
@@ -76,6 +89,16 @@ private:
         unsigned long mBandwidth;
     };
 
+    struct Prefetcher;
+
+    struct PrefetchItem {
+        AString mKey;
+        bool mDone;
+        status_t mFinalResult;
+        sp<ABuffer> mBuffer;
+        int64_t mFetchDurationUs;
+    };
+
     uint32_t mFlags;
     bool mUIDValid;
     uid_t mUID;
@@ -106,6 +129,23 @@ private:
 
     int32_t mMonitorQueueGeneration;
 
+    // Each prefetcher downloads segments ahead of the one onDownloadNext
+    // is fetching on its own looper and HTTP source. Downloaded segments
+    // wait in mPrefetchItems until onDownloadNext gets to them.
+    Vector<sp<ALooper> > mPrefetchLoopers;
+    Vector<sp<Prefetcher> > mPrefetchers;
+    size_t mNextPrefetcher;
+    List<PrefetchItem> mPrefetchItems;
+    size_t mPrefetchedBytes;
+    size_t mLastSegmentBytes;
+    int32_t mPrefetchGeneration;
+
+    sp<AdaptationPolicy> mAdaptationPolicy;
+    int64_t mLastSegmentDurationUs;
+
+    // Most recent variant selections and their reasons, for dump().
+    List<AString> mDecisionLog;
+
     enum RefreshState {
         INITIAL_MINIMUM_RELOAD_DELAY,
         FIRST_UNCHANGED_RELOAD_ATTEMPT,
@@ -124,15 +164,37 @@ private:
     void onMonitorQueue();
     void onSeek(const sp<AMessage> &msg);
 
+    // Key and initialization vector of an AES-128 encrypted segment.
+    struct CipherParams {
+        bool mEncrypted;
+        uint8_t mKey[16];
+        uint8_t mIV[16];
+    };
+
+    // Decrypts the file as it is downloaded if "cipher" says it's
+    // encrypted.
     status_t fetchFile(
             const char *url, sp<ABuffer> *out,
-            int64_t range_offset = 0, int64_t range_length = -1);
+            int64_t range_offset = 0, int64_t range_length = -1,
+            const CipherParams *cipher = NULL,
+            const sp<HTTPBase> &httpSource = NULL);
+
+    void startPrefetchers();
+    void stopPrefetchers();
+    void prefetchSegments(int32_t seqNumber);
+    bool takePrefetchedSegment(
+            const AString &key, sp<ABuffer> *out, int64_t *fetchDurationUs);
+    void onPrefetchDone(
+            const AString &key, int32_t generation,
+            status_t err, const sp<ABuffer> &buffer, int64_t fetchDurationUs);
+    void clearPrefetchedSegments_l();
 
     sp<M3UParser> fetchPlaylist(const char *url, bool *unchanged);
     size_t getBandwidthIndex();
+    int64_t getBufferedDurationUs();
 
-    status_t decryptBuffer(
-            size_t playlistIndex, const sp<ABuffer> &buffer);
+    status_t getCipherParams(
+            size_t playlistIndex, int32_t seqNumber, CipherParams *params);
 
     void postMonitorQueue(int64_t delayUs = 0);
 
@@ -140,6 +202,9 @@ private:
 
     static int SortByBandwidth(const BandwidthItem *, const BandwidthItem *);
 
+    static AString MakePrefetchKey(
+            const AString &uri, int64_t range_offset, int64_t range_length);
+
     DISALLOW_EVIL_CONSTRUCTORS(LiveSession);
 };
 
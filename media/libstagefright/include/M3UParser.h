@@ -26,7 +26,12 @@
 namespace android {
 
 struct M3UParser : public RefBase {
-    M3UParser(const char *baseURI, const void *data, size_t size);
+    // If "previous" is an earlier version of the same media playlist, the
+    // segments it already has, as identified by their media sequence
+    // number, are taken over from it instead of being parsed again.
+    M3UParser(
+            const char *baseURI, const void *data, size_t size,
+            const sp<M3UParser> &previous = NULL);
 
     status_t initCheck() const;
 
@@ -58,7 +63,12 @@ private:
     sp<AMessage> mMeta;
     Vector<Item> mItems;
 
-    status_t parse(const void *data, size_t size);
+    status_t parse(
+            const void *data, size_t size, const sp<M3UParser> &previous,
+            bool *mismatch);
+
+    const Item *findReusableItem(
+            const sp<M3UParser> &previous, int32_t seqNumber) const;
 
     static status_t parseMetaData(
             const AString &line, sp<AMessage> *meta, const char *key);
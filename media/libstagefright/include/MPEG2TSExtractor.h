@@ -20,6 +20,7 @@
 
 #include <media/stagefright/foundation/ABase.h>
 #include <media/stagefright/MediaExtractor.h>
+#include <utils/KeyedVector.h>
 #include <utils/threads.h>
 #include <utils/Vector.h>
 
@@ -61,9 +62,24 @@ private:
 
     off64_t mOffset;
 
+    // Local files are seeked through PCR samples, built lazily: every
+    // probe taken while bisecting the file for a seek is kept, keyed by
+    // media time, to narrow down the next seek.
+    bool mSeekableFile;
+    off64_t mFileSize;
+    uint64_t mFirstPCR;
+    int64_t mDurationUs;
+    KeyedVector<int64_t, off64_t> mSeekIndex;
+
     void init();
     status_t feedMore();
 
+    void initSeekIndex();
+    status_t findPCR(
+            off64_t offset, off64_t limit,
+            int64_t *timeUs, off64_t *pcrOffset);
+    void seekFile_l(int64_t seekTimeUs);
+
     DISALLOW_EVIL_CONSTRUCTORS(MPEG2TSExtractor);
 };
 
@@ -26,13 +26,16 @@ namespace android {
 
 struct AMessage;
 class DataSource;
+struct MPEG4FragmentIndex;
 class SampleTable;
 class String8;
 
 class MPEG4Extractor : public MediaExtractor {
 public:
-    // Extractor assumes ownership of "source".
-    MPEG4Extractor(const sp<DataSource> &source);
+    // Extractor assumes ownership of "source". With
+    // MediaExtractor::kMetadataOnly the sample tables are not read and
+    // getTrack() returns NULL.
+    MPEG4Extractor(const sp<DataSource> &source, uint32_t flags = 0);
 
     virtual size_t countTracks();
     virtual sp<MediaSource> getTrack(size_t index);
@@ -59,9 +62,13 @@ private:
     sp<DataSource> mDataSource;
     status_t mInitCheck;
     bool mHasVideo;
+    bool mMetadataOnly;
 
     Track *mFirstTrack, *mLastTrack;
 
+    // Only set for fragmented files, those with a 'mvex' box.
+    sp<MPEG4FragmentIndex> mFragmentIndex;
+
     sp<MetaData> mFileMetaData;
 
     Vector<uint32_t> mPath;
@@ -72,11 +79,12 @@ private:
     status_t readMetaData();
     status_t parseChunk(off64_t *offset, int depth);
     status_t parseMetaData(off64_t offset, size_t size);
+    status_t parseFragmentedHeaders(off64_t offset);
 
     status_t updateAudioTrackInfoFromESDS_MPEG4Audio(
             const void *esds_data, size_t esds_size);
 
-    static status_t verifyTrack(Track *track);
+    status_t verifyTrack(Track *track) const;
 
     struct SINF {
         SINF *next;
@@ -91,6 +99,9 @@ private:
     bool mIsDrm;
     status_t parseDrmSINF(off64_t *offset, off64_t data_offset);
 
+    // Set once mDataSource serves the whole movie box from memory.
+    bool mMovieBoxCached;
+
     status_t parseTrackHeader(off64_t data_offset, off64_t data_size);
 
     Track *findTrackByMimePrefix(const char *mimePrefix);
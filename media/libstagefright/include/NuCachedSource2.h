@@ -21,11 +21,14 @@
 #include <media/stagefright/foundation/ABase.h>
 #include <media/stagefright/foundation/AHandlerReflector.h>
 #include <media/stagefright/DataSource.h>
+#include <utils/threads.h>
+#include <utils/Vector.h>
 
 namespace android {
 
 struct ALooper;
 struct PageCache;
+struct DiskPageCache;
 
 struct NuCachedSource2 : public DataSource {
     NuCachedSource2(
@@ -64,6 +67,10 @@ struct NuCachedSource2 : public DataSource {
     status_t getEstimatedBandwidthKbps(int32_t *kbps);
     status_t setCacheStatCollectFreq(int32_t freqMs);
 
+    // Number of bytes read from the cache, including the retained pages,
+    // and of bytes that had to be waited for.
+    void getCacheStats(int64_t *hitBytes, int64_t *missBytes);
+
     static void RemoveCacheSpecificHeaders(
             KeyedVector<String8, String8> *headers,
             String8 *cacheConfig,
@@ -75,11 +82,24 @@ protected:
 private:
     friend struct AHandlerReflector<NuCachedSource2>;
 
+    struct RangeFetcher;
+    friend struct RangeFetcher;
+
     enum {
         kPageSize                       = 65536,
         kDefaultHighWaterThreshold      = 20 * 1024 * 1024,
         kDefaultLowWaterThreshold       = 4 * 1024 * 1024,
 
+        // Pages released from the play-ahead range are retained up to
+        // this size, most recently used first, to serve seeks back and
+        // reads of data stored out of order without fetching them again.
+        kDefaultRetainedThreshold       = 8 * 1024 * 1024,
+
+        // HTTP content is also cached on disk, in the directory set by the
+        // media.stagefright.diskcache property, up to this size or the one
+        // set by media.stagefright.diskcache-kb.
+        kDefaultDiskCacheSize           = 64 * 1024 * 1024,
+
         // Read data after a 15 sec timeout whether we're actively
         // fetching or not.
         kDefaultKeepAliveIntervalUs     = 15000000,
@@ -94,6 +114,13 @@ private:
         kMaxNumRetries = 10,
     };
 
+    enum {
+        // Connections to HTTP sources used to fetch the play-ahead region
+        // in ranges, set by the media.stagefright.cache-conns property.
+        kMaxNumConnections  = 4,
+        kRangeSize          = 1024 * 1024,
+    };
+
     sp<DataSource> mSource;
     sp<AHandlerReflector<NuCachedSource2> > mReflector;
     sp<ALooper> mLooper;
@@ -120,6 +147,24 @@ private:
 
     bool mDisconnectAtHighwatermark;
 
+    size_t mRetainedThresholdBytes;
+
+    int64_t mNumBytesHit;
+    int64_t mNumBytesRetainedHit;
+    int64_t mNumBytesMissed;
+    int64_t mNumBytesRetainedFetched;
+
+    size_t mNumConnections;
+    Vector<sp<RangeFetcher> > mRangeFetchers;
+    Condition mRangeCondition;
+    int32_t mRangeGeneration;   // incremented when the active range moves
+    off64_t mNextRangeOffset;   // next offset to assign to a range fetcher
+    bool mWaitingForRange;
+
+    // Thread safe, NULL if the content is not cached on disk.
+    DiskPageCache *mDiskCache;
+    int64_t mNumBytesDiskFetched;
+
 #ifdef QCOM_HARDWARE
     bool mIsDownloadComplete;
 #endif
@@ -131,6 +176,14 @@ private:
     ssize_t readInternal(off64_t offset, void *data, size_t size);
     status_t seekInternal_l(off64_t offset);
 
+    void scheduleRanges_l();
+
+    void openDiskCache();
+
+    // Returns the first offset at or after the end of the active range that
+    // is pending or being fetched by a range fetcher, -1 if none.
+    off64_t nextFetchedOffset_l() const;
+
     size_t approxDataRemaining_l(status_t *finalStatus) const;
 
     void restartPrefetcherIfNecessary_l(
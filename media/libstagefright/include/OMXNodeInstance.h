@@ -86,6 +86,7 @@ struct OMXNodeInstance {
             const char *parameterName, OMX_INDEXTYPE *index);
 
     void onMessage(const omx_message &msg);
+    void onMessages(const List<omx_message> &messages);
     void onObserverDied(OMXMaster *master);
     void onGetHandleFailed();
 
@@ -111,6 +111,18 @@ private:
     uint32_t mTimeToSampleCount;
     uint32_t *mTimeToSample;
 
+    // Index and decoding time of the first sample of each time-to-sample
+    // entry, to find the decoding time of a sample by binary search.
+    struct TimeToSampleRun {
+        uint32_t mFirstSample;
+        uint64_t mFirstTime;
+    };
+    TimeToSampleRun *mTimeToSampleRuns;
+    uint32_t mNumTimeToSampleSamples;
+    uint32_t mMaxTimeToSampleDelta;
+
+    // Only built if the composition time offsets are too spread out for
+    // findSampleAtTime() to search the samples around the requested time.
     struct SampleTimeEntry {
         uint32_t mSampleIndex;
         uint64_t mCompositionTime;
@@ -120,6 +132,21 @@ private:
     uint32_t *mCompositionTimeDeltaEntries;
     size_t mNumCompositionTimeDeltaEntries;
     CompositionDeltaLookup *mCompositionDeltaLookup;
+    uint32_t mMinCompositionTimeDelta;
+    uint32_t mMaxCompositionTimeDelta;
+
+    // The last page read of the sample size and chunk offset tables,
+    // entries are read from them rather than from the data source one
+    // at a time.
+    struct TablePage {
+        TablePage() : mData(NULL), mOffset(-1), mSize(0) {}
+
+        uint8_t *mData;
+        off64_t mOffset;
+        size_t mSize;
+    };
+    TablePage mSampleSizePage;
+    TablePage mChunkOffsetPage;
 
     off64_t mSyncSampleOffset;
     uint32_t mNumSyncSamples;
@@ -140,10 +167,26 @@ private:
     status_t getSampleSize_l(uint32_t sample_index, size_t *sample_size);
     uint32_t getCompositionTimeOffset(uint32_t sampleIndex);
 
+    status_t readTableData_l(
+            TablePage *page, off64_t tableOffset,
+            off64_t offset, void *data, size_t size);
+
+    // Read size bytes at offset of the sample size/chunk offset table.
+    status_t readSampleSizeData_l(off64_t offset, void *data, size_t size);
+    status_t readChunkOffsetData_l(off64_t offset, void *data, size_t size);
+
     static int CompareIncreasingTime(const void *, const void *);
 
     void buildSampleEntriesTable();
 
+    uint64_t getDecodingTime(uint32_t sampleIndex) const;
+
+    // Returns the index of the first sample decoded at or after time.
+    uint32_t findFirstSampleAtDecodingTime(uint64_t time) const;
+
+    status_t findSampleAtTimeInTable(
+            uint64_t req_time, uint32_t *sample_index, uint32_t flags);
+
     SampleTable(const SampleTable &);
     SampleTable &operator=(const SampleTable &);
 };
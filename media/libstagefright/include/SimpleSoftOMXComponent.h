@@ -66,6 +66,19 @@ protected:
     virtual OMX_ERRORTYPE internalSetParameter(
             OMX_INDEXTYPE index, const OMX_PTR params);
 
+    virtual OMX_ERRORTYPE getExtensionIndex(
+            const char *name, OMX_INDEXTYPE *index);
+
+    // Batched output is requested by offline clients through the
+    // "OMX.google.android.index.batchOutputBuffers" extension, an
+    // OMX_PARAM_U32TYPE with a non-zero nU32. Decoders then append as many frames as
+    // fit to the output buffer at the head of the queue and only return it
+    // once it cannot take another frame of up to |frameSize| bytes, or at
+    // the end of the stream. A buffer that already holds frames has a
+    // non-zero nFilledLen, these are to be appended after it.
+    bool keepOutputBuffer(
+            const OMX_BUFFERHEADERTYPE *header, size_t frameSize) const;
+
     virtual void onQueueFilled(OMX_U32 portIndex);
     List<BufferInfo *> &getPortQueue(OMX_U32 portIndex);
 
@@ -91,6 +104,8 @@ private:
 
     Vector<PortInfo> mPorts;
 
+    bool mBatchOutput;
+
     bool isSetParameterAllowed(
             OMX_INDEXTYPE index, const OMX_PTR params) const;
 
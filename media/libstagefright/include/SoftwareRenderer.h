@@ -39,6 +39,10 @@ public:
 private:
     enum YUVMode {
         None,
+        // NV12 rows go to a YV12 window, the chroma is deinterleaved.
+        DeinterleaveToYV12,
+        // NV21 rows are copied as is to a YCrCb_420_SP window.
+        CopyToYCrCb420SP,
     };
 
     OMX_COLOR_FORMATTYPE mColorFormat;
@@ -52,6 +56,8 @@ private:
     int32_t mAlign;
 #endif
 
+    bool canAllocateBuffers();
+
     SoftwareRenderer(const SoftwareRenderer &);
     SoftwareRenderer &operator=(const SoftwareRenderer &);
 };
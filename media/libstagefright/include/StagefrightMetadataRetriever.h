@@ -27,6 +27,8 @@ namespace android {
 
 struct DataSource;
 class MediaExtractor;
+struct MediaSource;
+class MetaData;
 
 struct StagefrightMetadataRetriever : public MediaMetadataRetrieverInterface {
     StagefrightMetadataRetriever();
@@ -47,11 +49,32 @@ private:
     sp<DataSource> mSource;
     sp<MediaExtractor> mExtractor;
 
+    // Set until getFrameAtTime() replaces the metadata only extractor
+    // created by setDataSource().
+    bool mExtractorIsMetadataOnly;
+
     bool mParsedMetaData;
     KeyedVector<int, String8> mMetaData;
     MediaAlbumArt *mAlbumArt;
 
+    // Where the album art is in mSource if only its location was found.
+    off64_t mAlbumArtOffset;
+    size_t mAlbumArtSize;
+
+    // Set once mAlbumArt has been through JPEGDecoder in thumbnail mode.
+    bool mAlbumArtScaled;
+
+    // Frames and JPEG album art are scaled down to fit this many pixels on
+    // their longer side if "media.stagefright.thumbnail-size" is set, 0
+    // otherwise. In this thumbnail mode the decoder is kept running between
+    // getFrameAtTime() calls on the same data source.
+    int32_t mThumbnailMaxDimension;
+    sp<MediaSource> mThumbnailDecoder;
+    sp<MetaData> mThumbnailTrackMeta;
+
     void parseMetaData();
+    MediaAlbumArt *readAlbumArt();
+    void clearThumbnailDecoder();
 
     StagefrightMetadataRetriever(const StagefrightMetadataRetriever &);
 
@@ -0,0 +1,93 @@
+/*
+ * Copyright (C) 2012 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TEE_SOURCE_H_
+
+#define TEE_SOURCE_H_
+
+#include <media/stagefright/MediaSource.h>
+#include <utils/List.h>
+#include <utils/RefBase.h>
+#include <utils/threads.h>
+#include <utils/Vector.h>
+
+#include <pthread.h>
+
+namespace android {
+
+// Reads from a single source (typically an encoder) on its own thread and
+// hands every buffer to each of its outputs, so that several writers can
+// share one encode. The source is started by the first output that is
+// started, with that output's parameters, and stopped once all started
+// outputs have been stopped again.
+//
+// Each output queues up to "maxQueuedBuffers" buffers. A lossless output
+// whose queue is full blocks the tee, and with it all other outputs. A
+// lossy output instead drops buffers and, for video, everything up to the
+// next sync frame, so a slow consumer such as a network sink never stalls
+// the others. Lossy outputs receive copies of the data so that they never
+// hold on to the source's own buffers.
+struct TeeSource : public RefBase {
+    TeeSource(const sp<MediaSource> &source);
+
+    // All outputs must be created before any of them is started.
+    sp<MediaSource> createOutput(size_t maxQueuedBuffers, bool lossy);
+
+protected:
+    virtual ~TeeSource();
+
+private:
+    struct Output;
+
+    Mutex mLock;
+    Condition mCondition;
+
+    sp<MediaSource> mSource;
+    bool mIsVideo;
+
+    // Outputs are only referenced weakly, they hold a strong reference
+    // to the tee.
+    Vector<Output *> mOutputs;
+    size_t mNumStartedOutputs;
+
+    // Copies of the codec config data read so far, replayed to outputs
+    // that are started after the source.
+    Vector<MediaBuffer *> mCodecConfigBuffers;
+
+    pthread_t mThread;
+    bool mStarted;
+    bool mDone;
+
+    status_t startOutput(Output *output, MetaData *params);
+    status_t stopOutput(Output *output);
+    status_t readOutput(Output *output, MediaBuffer **buffer);
+    void removeOutput(Output *output);
+
+    // Returns true if the tee must wait for a lossless output to drain.
+    bool mustWait_l() const;
+    void queueBuffer_l(Output *output, MediaBuffer *buffer);
+    void signalEOS_l(status_t err);
+
+    static void *ThreadWrapper(void *me);
+    void threadEntry();
+
+    TeeSource(const TeeSource &);
+    TeeSource &operator=(const TeeSource &);
+};
+
+}  // namespace android
+
+#endif  // TEE_SOURCE_H_
@@ -20,8 +20,8 @@
 
 #include <pthread.h>
 
-#include <utils/List.h>
 #include <utils/RefBase.h>
+#include <utils/Vector.h>
 #include <utils/threads.h>
 
 namespace android {
@@ -75,11 +75,16 @@ struct TimedEventQueue {
     event_id postEventToBack(const sp<Event> &event);
 
     // It is an error to post an event with a negative delay.
-    event_id postEventWithDelay(const sp<Event> &event, int64_t delay_us);
+    // An event posted with a slack may fire up to slack_us late, which
+    // lets it share a wakeup with another event. Use it for periodic
+    // checks, not for events that must fire on time.
+    event_id postEventWithDelay(
+            const sp<Event> &event, int64_t delay_us, int64_t slack_us = 0);
 
     // If the event is to be posted at a time that has already passed,
     // it will fire as soon as possible.
-    event_id postTimedEvent(const sp<Event> &event, int64_t realtime_us);
+    event_id postTimedEvent(
+            const sp<Event> &event, int64_t realtime_us, int64_t slack_us = 0);
 
     // Returns true iff event is currently in the queue and has been
     // successfully cancelled. In this case the event will have been
@@ -100,6 +105,8 @@ private:
     struct QueueItem {
         sp<Event> event;
         int64_t realtime_us;
+        int64_t deadline_us;  // realtime_us plus the slack
+        uint64_t sequence;    // keeps items with the same deadline in order
     };
 
     struct StopEvent : public TimedEventQueue::Event {
@@ -109,11 +116,16 @@ private:
     };
 
     pthread_t mThread;
-    List<QueueItem> mQueue;
+
+    // A binary min-heap ordered by (deadline_us, sequence). The thread
+    // sleeps until the deadline of the head, and whenever it wakes anyway
+    // it fires the head early if its realtime_us has already passed.
+    Vector<QueueItem> mQueue;
     Mutex mLock;
     Condition mQueueNotEmptyCondition;
     Condition mQueueHeadChangedCondition;
     event_id mNextEventID;
+    uint64_t mNextSequence;
 
     bool mRunning;
     bool mStopped;
@@ -121,7 +133,12 @@ private:
     static void *ThreadWrapper(void *me);
     void threadEntry();
 
-    sp<Event> removeEventFromQueue_l(event_id id);
+    static bool ItemBefore(const QueueItem &a, const QueueItem &b);
+    void siftUp_l(size_t index);
+    void siftDown_l(size_t index);
+
+    // Removes the item at "index" and returns its event.
+    sp<Event> removeItemAt_l(size_t index);
 
     TimedEventQueue(const TimedEventQueue &);
     TimedEventQueue &operator=(const TimedEventQueue &);
@@ -40,6 +40,13 @@ struct DataSourceReader : public mkvparser::IMkvReader {
         : mSource(source) {
     }
 
+    virtual ~DataSourceReader() {
+        for (size_t i = 0; i < kMaxWindows; ++i) {
+            delete[] mWindows[i].mData;
+            mWindows[i].mData = NULL;
+        }
+    }
+
     virtual int Read(long long position, long length, unsigned char* buffer) {
         CHECK(position >= 0);
         CHECK(length >= 0);
@@ -48,6 +55,23 @@ struct DataSourceReader : public mkvparser::IMkvReader {
             return 0;
         }
 
+        {
+            Mutex::Autolock autoLock(mLock);
+
+            for (size_t i = 0; i < kMaxWindows; ++i) {
+                const Window &window = mWindows[i];
+
+                if (window.mData != NULL
+                        && position >= window.mPos
+                        && position + length <= window.mPos + window.mSize) {
+                    memcpy(buffer, &window.mData[position - window.mPos],
+                           length);
+
+                    return 0;
+                }
+            }
+        }
+
         ssize_t n = mSource->readAt(position, buffer, length);
 
         if (n <= 0) {
@@ -77,9 +101,68 @@ struct DataSourceReader : public mkvparser::IMkvReader {
         return 0;
     }
 
+    // Reads the "size" bytes at "position" in a single request so that
+    // the many small reads parsing a cluster are served from memory.
+    // The two most recently prefetched clusters are kept, one for each
+    // track that is being read in an interleaved file.
+    void prefetch(long long position, long long size) {
+        if (size <= 0 || size > (long long)kMaxPrefetchSize) {
+            return;
+        }
+
+        {
+            Mutex::Autolock autoLock(mLock);
+
+            for (size_t i = 0; i < kMaxWindows; ++i) {
+                if (mWindows[i].mData != NULL
+                        && mWindows[i].mPos == position
+                        && mWindows[i].mSize >= size) {
+                    return;
+                }
+            }
+        }
+
+        uint8_t *data = new uint8_t[size];
+        ssize_t n = mSource->readAt(position, data, size);
+
+        if (n <= 0) {
+            delete[] data;
+            return;
+        }
+
+        Mutex::Autolock autoLock(mLock);
+
+        // Replace the older of the two windows.
+        Window tmp = mWindows[0];
+        mWindows[0] = mWindows[1];
+        mWindows[1] = tmp;
+
+        delete[] mWindows[1].mData;
+        mWindows[1].mData = data;
+        mWindows[1].mPos = position;
+        mWindows[1].mSize = n;
+    }
+
 private:
+    enum {
+        kMaxWindows = 2,
+        kMaxPrefetchSize = 4 * 1024 * 1024,
+    };
+
+    struct Window {
+        Window() : mData(NULL), mPos(0), mSize(0) {}
+
+        uint8_t *mData;
+        long long mPos;
+        long long mSize;
+    };
+
     sp<DataSource> mSource;
 
+    // Reads for different tracks may come from different threads.
+    Mutex mLock;
+    Window mWindows[kMaxWindows];
+
     DataSourceReader(const DataSourceReader &);
     DataSourceReader &operator=(const DataSourceReader &);
 };
@@ -110,6 +193,7 @@ private:
     long mBlockEntryIndex;
 
     void advance_l();
+    void prefetchCluster_l();
 
     BlockIterator(const BlockIterator &);
     BlockIterator &operator=(const BlockIterator &);
@@ -280,6 +364,8 @@ void BlockIterator::advance_l() {
             ALOGV("Parse (2) returned %ld", res);
             CHECK_GE(res, 0);
 
+            prefetchCluster_l();
+
             mBlockEntryIndex = 0;
             continue;
         }
@@ -294,6 +380,13 @@ void BlockIterator::advance_l() {
     }
 }
 
+void BlockIterator::prefetchCluster_l() {
+    if (mCluster != NULL && !mCluster->EOS()) {
+        mExtractor->mReader->prefetch(
+                mCluster->m_element_start, mCluster->GetElementSize());
+    }
+}
+
 void BlockIterator::reset() {
     Mutex::Autolock autoLock(mExtractor->mLock);
 
@@ -301,6 +394,8 @@ void BlockIterator::reset() {
     mBlockEntry = NULL;
     mBlockEntryIndex = 0;
 
+    prefetchCluster_l();
+
     do {
         advance_l();
     } while (!eos() && block()->GetTrackNumber() != mTrackNum);
@@ -323,6 +418,7 @@ void BlockIterator::seek(
         ALOGV("Seek to beginning: %lld", seekTimeUs);
         mCluster = pSegment->GetFirst();
         mBlockEntryIndex = 0;
+        prefetchCluster_l();
         do {
             advance_l();
         } while (!eos() && block()->GetTrackNumber() != mTrackNum);
@@ -331,75 +427,23 @@ void BlockIterator::seek(
 
     ALOGV("Seeking to: %lld", seekTimeUs);
 
-    // If the Cues have not been located then find them.
-    const mkvparser::Cues* pCues = pSegment->GetCues();
-    const mkvparser::SeekHead* pSH = pSegment->GetSeekHead();
-    if (!pCues && pSH) {
-        const size_t count = pSH->GetCount();
-        const mkvparser::SeekHead::Entry* pEntry;
-        ALOGV("No Cues yet");
-
-        for (size_t index = 0; index < count; index++) {
-            pEntry = pSH->GetEntry(index);
-
-            if (pEntry->id == 0x0C53BB6B) { // Cues ID
-                long len; long long pos;
-                pSegment->ParseCues(pEntry->pos, pos, len);
-                pCues = pSegment->GetCues();
-                ALOGV("Cues found");
-                break;
-            }
-        }
-
-        if (!pCues) {
-            ALOGE("No Cues in file");
-            return;
-        }
-    }
-    else if (!pSH) {
-        ALOGE("No SeekHead");
+    long long clusterPos;
+    long blockEntryIndex = 0;
+    if (!mExtractor->findCuePosition_l(
+                seekTimeNs, &clusterPos, &blockEntryIndex)
+            && !mExtractor->findIndexedCluster_l(seekTimeNs, &clusterPos)) {
+        ALOGE("Unable to locate a cluster to seek to");
         return;
     }
 
-    const mkvparser::CuePoint* pCP;
-    while (!pCues->DoneParsing()) {
-        pCues->LoadCuePoint();
-        pCP = pCues->GetLast();
-
-        if (pCP->GetTime(pSegment) >= seekTimeNs) {
-            ALOGV("Parsed past relevant Cue");
-            break;
-        }
-    }
-
-    // The Cue index is built around video keyframes
-    mkvparser::Tracks const *pTracks = pSegment->GetTracks();
-    const mkvparser::Track *pTrack = NULL;
-    for (size_t index = 0; index < pTracks->GetTracksCount(); ++index) {
-        pTrack = pTracks->GetTrackByIndex(index);
-        if (pTrack && pTrack->GetType() == 1) { // VIDEO_TRACK
-            ALOGV("Video track located at %d", index);
-            break;
-        }
-    }
-
-    // Always *search* based on the video track, but finalize based on mTrackNum
-    const mkvparser::CuePoint::TrackPosition* pTP;
-    if (pTrack && pTrack->GetType() == 1) {
-        pCues->Find(seekTimeNs, pTrack, pCP, pTP);
-    } else {
-        ALOGE("Did not locate the video track for seeking");
-        return;
-    }
-
-    mCluster = pSegment->FindOrPreloadCluster(pTP->m_pos);
+    mCluster = pSegment->FindOrPreloadCluster(clusterPos);
 
     CHECK(mCluster);
     CHECK(!mCluster->EOS());
 
-    // mBlockEntryIndex starts at 0 but m_block starts at 1
-    CHECK_GT(pTP->m_block, 0);
-    mBlockEntryIndex = pTP->m_block - 1;
+    mBlockEntryIndex = blockEntryIndex;
+
+    prefetchCluster_l();
 
     for (;;) {
         advance_l();
@@ -628,7 +672,12 @@ MatroskaExtractor::MatroskaExtractor(const sp<DataSource> &source)
       mReader(new DataSourceReader(mDataSource)),
       mSegment(NULL),
       mExtractedThumbnails(false),
-      mIsWebm(false) {
+      mIsWebm(false),
+      mCuesLoaded(false),
+      mCues(NULL),
+      mCueTrack(NULL),
+      mLastIndexedCluster(NULL),
+      mClusterIndexComplete(false) {
     off64_t size;
     mIsLiveStreaming =
         (mDataSource->flags()
@@ -882,6 +931,151 @@ void MatroskaExtractor::addTracks() {
     }
 }
 
+void MatroskaExtractor::loadCues_l() {
+    if (mCuesLoaded) {
+        return;
+    }
+
+    mCuesLoaded = true;
+
+    // If the Cues have not been located then find them.
+    const mkvparser::Cues* pCues = mSegment->GetCues();
+    const mkvparser::SeekHead* pSH = mSegment->GetSeekHead();
+    if (!pCues && pSH) {
+        const size_t count = pSH->GetCount();
+        const mkvparser::SeekHead::Entry* pEntry;
+        ALOGV("No Cues yet");
+
+        for (size_t index = 0; index < count; index++) {
+            pEntry = pSH->GetEntry(index);
+
+            if (pEntry->id == 0x0C53BB6B) { // Cues ID
+                long len; long long pos;
+                mSegment->ParseCues(pEntry->pos, pos, len);
+                pCues = mSegment->GetCues();
+                ALOGV("Cues found");
+                break;
+            }
+        }
+    }
+
+    if (!pCues) {
+        ALOGI("No Cues in file, indexing clusters instead");
+        return;
+    }
+
+    // The Cue index is built around video keyframes
+    mkvparser::Tracks const *pTracks = mSegment->GetTracks();
+    for (size_t index = 0; index < pTracks->GetTracksCount(); ++index) {
+        const mkvparser::Track *pTrack = pTracks->GetTrackByIndex(index);
+        if (pTrack && pTrack->GetType() == 1) { // VIDEO_TRACK
+            ALOGV("Video track located at %d", index);
+            mCueTrack = pTrack;
+            break;
+        }
+    }
+
+    if (mCueTrack == NULL) {
+        ALOGI("Did not locate the video track, indexing clusters instead");
+        return;
+    }
+
+    mCues = pCues;
+}
+
+bool MatroskaExtractor::findCuePosition_l(
+        int64_t seekTimeNs, long long *clusterPos, long *blockEntryIndex) {
+    loadCues_l();
+
+    if (mCues == NULL) {
+        return false;
+    }
+
+    // Cue points stay loaded, later seeks only parse the ones past the
+    // furthest seek so far.
+    const mkvparser::CuePoint* pCP;
+    while (!mCues->DoneParsing()) {
+        mCues->LoadCuePoint();
+        pCP = mCues->GetLast();
+
+        if (pCP->GetTime(mSegment) >= seekTimeNs) {
+            ALOGV("Parsed past relevant Cue");
+            break;
+        }
+    }
+
+    // Always *search* based on the video track, but finalize based on
+    // the track being read.
+    const mkvparser::CuePoint::TrackPosition* pTP;
+    if (!mCues->Find(seekTimeNs, mCueTrack, pCP, pTP)) {
+        return false;
+    }
+
+    // mBlockEntryIndex starts at 0 but m_block starts at 1
+    CHECK_GT(pTP->m_block, 0);
+
+    *clusterPos = pTP->m_pos;
+    *blockEntryIndex = pTP->m_block - 1;
+
+    return true;
+}
+
+bool MatroskaExtractor::findIndexedCluster_l(
+        int64_t seekTimeNs, long long *clusterPos) {
+    // Only walk as many cluster headers as this seek needs, later seeks
+    // pick up where the last one stopped.
+    while (!mClusterIndexComplete
+            && (mClusterIndex.isEmpty()
+                || mClusterIndex.top().mTimeNs < seekTimeNs)) {
+        const mkvparser::Cluster *cluster;
+
+        if (mLastIndexedCluster == NULL) {
+            cluster = mSegment->GetFirst();
+        } else {
+            long long pos;
+            long len;
+            long res = mSegment->ParseNext(
+                    mLastIndexedCluster, cluster, pos, len);
+
+            if (res != 0) {
+                cluster = NULL;
+            }
+        }
+
+        if (cluster == NULL || cluster->EOS()) {
+            mClusterIndexComplete = true;
+            break;
+        }
+
+        ClusterEntry entry;
+        entry.mTimeNs = cluster->GetTime();
+        entry.mPos = cluster->GetPosition();
+        mClusterIndex.push(entry);
+
+        mLastIndexedCluster = cluster;
+    }
+
+    if (mClusterIndex.isEmpty()) {
+        return false;
+    }
+
+    // Find the last cluster starting at or before the seek time.
+    size_t lo = 0;
+    size_t hi = mClusterIndex.size();
+    while (hi - lo > 1) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (mClusterIndex.itemAt(mid).mTimeNs <= seekTimeNs) {
+            lo = mid;
+        } else {
+            hi = mid;
+        }
+    }
+
+    *clusterPos = mClusterIndex.itemAt(lo).mPos;
+
+    return true;
+}
+
 void MatroskaExtractor::findThumbnails() {
     for (size_t i = 0; i < mTracks.size(); ++i) {
         TrackInfo *info = &mTracks.editItemAt(i);
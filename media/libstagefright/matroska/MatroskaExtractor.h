@@ -24,6 +24,9 @@
 
 namespace mkvparser {
 struct Segment;
+struct Cues;
+struct Track;
+struct Cluster;
 };
 
 namespace android {
@@ -60,6 +63,11 @@ private:
         sp<MetaData> mMeta;
     };
 
+    struct ClusterEntry {
+        int64_t mTimeNs;
+        long long mPos;
+    };
+
     Mutex mLock;
     Vector<TrackInfo> mTracks;
 
@@ -70,9 +78,28 @@ private:
     bool mIsLiveStreaming;
     bool mIsWebm;
 
+    // The Cues and the video track they are searched by, located on the
+    // first seek. mCues stays NULL if there are no usable Cues.
+    bool mCuesLoaded;
+    const mkvparser::Cues *mCues;
+    const mkvparser::Track *mCueTrack;
+
+    // Cluster start times, generated on demand for files without usable
+    // Cues.
+    Vector<ClusterEntry> mClusterIndex;
+    const mkvparser::Cluster *mLastIndexedCluster;
+    bool mClusterIndexComplete;
+
     void addTracks();
     void findThumbnails();
 
+    void loadCues_l();
+
+    bool findCuePosition_l(
+            int64_t seekTimeNs, long long *clusterPos, long *blockEntryIndex);
+
+    bool findIndexedCluster_l(int64_t seekTimeNs, long long *clusterPos);
+
     bool isLiveStreaming() const;
 
     MatroskaExtractor(const MatroskaExtractor &);
@@ -78,6 +78,8 @@ struct ATSParser::Program : public RefBase {
         return mProgramMapPID;
     }
 
+    void addStreamsByPID(Stream **streamsByPID);
+
 private:
     ATSParser *mParser;
     unsigned mProgramNumber;
@@ -201,6 +203,17 @@ bool ATSParser::Program::parsePID(
     return true;
 }
 
+void ATSParser::Program::addStreamsByPID(Stream **streamsByPID) {
+    for (size_t i = 0; i < mStreams.size(); ++i) {
+        const sp<Stream> &stream = mStreams.valueAt(i);
+
+        // An earlier program claiming the same PID wins, as in parsePID.
+        if (streamsByPID[stream->pid()] == NULL) {
+            streamsByPID[stream->pid()] = stream.get();
+        }
+    }
+}
+
 void ATSParser::Program::signalDiscontinuity(
         DiscontinuityType type, const sp<AMessage> &extra) {
     for (size_t i = 0; i < mStreams.size(); ++i) {
@@ -903,7 +916,8 @@ sp<MediaSource> ATSParser::Stream::getSource(SourceType type) {
 ////////////////////////////////////////////////////////////////////////////////
 
 ATSParser::ATSParser(uint32_t flags)
-    : mFlags(flags) {
+    : mFlags(flags),
+      mStreamsByPIDValid(false) {
     mPSISections.add(0 /* PID */, new PSISection);
 }
 
@@ -913,12 +927,82 @@ ATSParser::~ATSParser() {
 status_t ATSParser::feedTSPacket(const void *data, size_t size) {
     CHECK_EQ(size, kTSPacketSize);
 
-    ABitReader br((const uint8_t *)data, kTSPacketSize);
-    return parseTS(&br);
+    const uint8_t *packet = (const uint8_t *)data;
+    CHECK_EQ(packet[0], 0x47u);
+
+    unsigned payload_unit_start_indicator = (packet[1] >> 6) & 1;
+    unsigned PID = ((packet[1] & 0x1f) << 8) | packet[2];
+    unsigned adaptation_field_control = (packet[3] >> 4) & 3;
+
+    size_t payloadOffset = 4;
+    if (adaptation_field_control == 2 || adaptation_field_control == 3) {
+        payloadOffset += 1 + packet[4];
+    }
+
+    if (payloadOffset > kTSPacketSize) {
+        // The adaptation field claims more than the packet holds, leave
+        // it to the bit by bit parser.
+        ABitReader br(packet, kTSPacketSize);
+        return parseTS(&br);
+    }
+
+    if (adaptation_field_control != 1 && adaptation_field_control != 3) {
+        return OK;
+    }
+
+    ABitReader br(packet + payloadOffset, kTSPacketSize - payloadOffset);
+
+    if (!mStreamsByPIDValid) {
+        updateStreamsByPID();
+    }
+
+    Stream *stream = mStreamsByPID[PID];
+    if (stream != NULL) {
+        return stream->parse(payload_unit_start_indicator, &br);
+    }
+
+    return parsePID(&br, PID, payload_unit_start_indicator);
+}
+
+status_t ATSParser::feedTSPackets(const void *data, size_t size) {
+    CHECK_EQ(size % kTSPacketSize, 0u);
+
+    const uint8_t *packet = (const uint8_t *)data;
+    for (size_t offset = 0; offset < size; offset += kTSPacketSize) {
+        status_t err = feedTSPacket(packet + offset, kTSPacketSize);
+
+        if (err != OK) {
+            return err;
+        }
+    }
+
+    return OK;
+}
+
+void ATSParser::updateStreamsByPID() {
+    memset(mStreamsByPID, 0, sizeof(mStreamsByPID));
+
+    for (size_t i = 0; i < mPrograms.size(); ++i) {
+        mPrograms.editItemAt(i)->addStreamsByPID(mStreamsByPID);
+    }
+
+    // PSI sections take precedence over elementary streams.
+    for (size_t i = 0; i < mPSISections.size(); ++i) {
+        mStreamsByPID[mPSISections.keyAt(i)] = NULL;
+    }
+
+    mStreamsByPIDValid = true;
 }
 
 void ATSParser::signalDiscontinuity(
         DiscontinuityType type, const sp<AMessage> &extra) {
+    if (type & DISCONTINUITY_TS_PLAYER_SEEK) {
+        // Data resumes at an arbitrary packet, drop partial sections.
+        for (size_t i = 0; i < mPSISections.size(); ++i) {
+            mPSISections.editValueAt(i)->clear();
+        }
+    }
+
     for (size_t i = 0; i < mPrograms.size(); ++i) {
         mPrograms.editItemAt(i)->signalDiscontinuity(type, extra);
     }
@@ -1023,6 +1107,9 @@ status_t ATSParser::parsePID(
             return OK;
         }
 
+        // The programs and their streams may change below.
+        mStreamsByPIDValid = false;
+
         ABitReader sectionBits(section->data(), section->size());
 
         if (PID == 0) {
@@ -1139,6 +1226,21 @@ sp<MediaSource> ATSParser::getSource(SourceType type) {
     return NULL;
 }
 
+bool ATSParser::isFull() {
+    static const SourceType kTypes[] = { AUDIO, VIDEO };
+
+    for (size_t i = 0; i < sizeof(kTypes) / sizeof(kTypes[0]); ++i) {
+        sp<AnotherPacketSource> source =
+            static_cast<AnotherPacketSource *>(getSource(kTypes[i]).get());
+
+        if (source != NULL && source->isFull()) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
 bool ATSParser::PTSTimeDeltaEstablished() {
     if (mPrograms.isEmpty()) {
         return false;
@@ -65,6 +65,9 @@ struct ATSParser : public RefBase {
 
     status_t feedTSPacket(const void *data, size_t size);
 
+    // "size" must be a multiple of the TS packet size.
+    status_t feedTSPackets(const void *data, size_t size);
+
     void signalDiscontinuity(
             DiscontinuityType type, const sp<AMessage> &extra);
 
@@ -76,6 +79,10 @@ struct ATSParser : public RefBase {
     };
     sp<MediaSource> getSource(SourceType type);
 
+    // True if the audio or the video source has reached its queue limits,
+    // in which case the caller should hold off feeding more packets.
+    bool isFull();
+
     bool PTSTimeDeltaEstablished();
 
     enum {
@@ -104,6 +111,17 @@ private:
     // Keyed by PID
     KeyedVector<unsigned, sp<PSISection> > mPSISections;
 
+    enum {
+        kNumPIDs = 1 << 13
+    };
+
+    // Elementary streams indexed directly by PID, rebuilt from mPrograms
+    // after a PSI section has been parsed.
+    Stream *mStreamsByPID[kNumPIDs];
+    bool mStreamsByPIDValid;
+
+    void updateStreamsByPID();
+
     void parseProgramAssociationTable(ABitReader *br);
     void parseProgramMap(ABitReader *br);
     void parsePES(ABitReader *br);
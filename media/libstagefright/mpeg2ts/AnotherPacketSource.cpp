@@ -14,8 +14,14 @@
  * limitations under the License.
  */
 
+//#define LOG_NDEBUG 0
+#define LOG_TAG "AnotherPacketSource"
+#include <utils/Log.h>
+
 #include "AnotherPacketSource.h"
 
+#include "include/avc_utils.h"
+
 #include <media/stagefright/foundation/ABuffer.h>
 #include <media/stagefright/foundation/ADebug.h>
 #include <media/stagefright/foundation/AMessage.h>
@@ -24,14 +30,24 @@
 #include <media/stagefright/MediaBuffer.h>
 #include <media/stagefright/MediaDefs.h>
 #include <media/stagefright/MetaData.h>
+#include <cutils/properties.h>
 #include <utils/Vector.h>
 
 namespace android {
 
 AnotherPacketSource::AnotherPacketSource(const sp<MetaData> &meta)
     : mIsAudio(false),
+      mIsAVC(false),
       mFormat(meta),
-      mEOSResult(OK) {
+      mEOSResult(OK),
+      mMaxDurationUs(0),
+      mMaxBytes(0),
+      mNumDiscontinuities(0),
+      mNumSyncFrames(0),
+      mQueuedBytes(0),
+      mFirstTimeUs(-1),
+      mLastTimeUs(-1),
+      mLastSyncFrame(mBuffers.end()) {
     const char *mime;
     CHECK(meta->findCString(kKeyMIMEType, &mime));
 
@@ -39,6 +55,22 @@ AnotherPacketSource::AnotherPacketSource(const sp<MetaData> &meta)
         mIsAudio = true;
     } else {
         CHECK(!strncasecmp("video/", mime, 6));
+        mIsAVC = !strcasecmp(MEDIA_MIMETYPE_VIDEO_AVC, mime);
+    }
+
+    char value[PROPERTY_VALUE_MAX];
+    if (property_get("media.stagefright.apsource.max-ms", value, NULL)) {
+        int64_t maxDurationMs = atoll(value);
+        if (maxDurationMs > 0) {
+            mMaxDurationUs = maxDurationMs * 1000ll;
+        }
+    }
+
+    if (property_get("media.stagefright.apsource.max-kb", value, NULL)) {
+        int64_t maxKBytes = atoll(value);
+        if (maxKBytes > 0) {
+            mMaxBytes = maxKBytes * 1024;
+        }
     }
 }
 
@@ -77,15 +109,7 @@ status_t AnotherPacketSource::dequeueAccessUnit(sp<ABuffer> *buffer) {
     }
 
     if (!mBuffers.empty()) {
-        *buffer = *mBuffers.begin();
-        mBuffers.erase(mBuffers.begin());
-
-        int32_t discontinuity;
-        if ((*buffer)->meta()->findInt32("discontinuity", &discontinuity)) {
-            if (wasFormatChange(discontinuity)) {
-                mFormat.clear();
-            }
-
+        if (dequeue_l(buffer)) {
             return INFO_DISCONTINUITY;
         }
 
@@ -105,15 +129,8 @@ status_t AnotherPacketSource::read(
     }
 
     if (!mBuffers.empty()) {
-        const sp<ABuffer> buffer = *mBuffers.begin();
-        mBuffers.erase(mBuffers.begin());
-
-        int32_t discontinuity;
-        if (buffer->meta()->findInt32("discontinuity", &discontinuity)) {
-            if (wasFormatChange(discontinuity)) {
-                mFormat.clear();
-            }
-
+        sp<ABuffer> buffer;
+        if (dequeue_l(&buffer)) {
             return INFO_DISCONTINUITY;
         } else {
             int64_t timeUs;
@@ -140,6 +157,111 @@ bool AnotherPacketSource::wasFormatChange(
     return (discontinuityType & ATSParser::DISCONTINUITY_VIDEO_FORMAT) != 0;
 }
 
+bool AnotherPacketSource::isSyncFrame(const sp<ABuffer> &buffer) const {
+    if (mIsAudio) {
+        return true;
+    }
+
+    int32_t isSync;
+    return buffer->meta()->findInt32("isSync", &isSync) && isSync;
+}
+
+bool AnotherPacketSource::exceedsLimits_l(size_t factor) const {
+    if (mMaxBytes > 0 && mQueuedBytes >= factor * mMaxBytes) {
+        return true;
+    }
+
+    return mMaxDurationUs > 0 && mFirstTimeUs >= 0
+        && mLastTimeUs - mFirstTimeUs >= (int64_t)factor * mMaxDurationUs;
+}
+
+List<sp<ABuffer> >::iterator AnotherPacketSource::firstAccessUnit_l() {
+    List<sp<ABuffer> >::iterator it = mBuffers.begin();
+    for (size_t i = 0; i < mNumDiscontinuities; ++i) {
+        ++it;
+    }
+
+    return it;
+}
+
+// Only ever called on the first queued access unit.
+List<sp<ABuffer> >::iterator AnotherPacketSource::eraseAccessUnit_l(
+        List<sp<ABuffer> >::iterator it) {
+    const sp<ABuffer> &buffer = *it;
+
+    mQueuedBytes -= buffer->size();
+
+    if (isSyncFrame(buffer)) {
+        --mNumSyncFrames;
+    }
+
+    if (it == mLastSyncFrame) {
+        mLastSyncFrame = mBuffers.end();
+    }
+
+    it = mBuffers.erase(it);
+
+    if (it != mBuffers.end()) {
+        CHECK((*it)->meta()->findInt64("timeUs", &mFirstTimeUs));
+    } else {
+        mFirstTimeUs = mLastTimeUs = -1;
+    }
+
+    return it;
+}
+
+void AnotherPacketSource::clearAccessUnits_l() {
+    mBuffers.erase(firstAccessUnit_l(), mBuffers.end());
+
+    mNumSyncFrames = 0;
+    mQueuedBytes = 0;
+    mFirstTimeUs = mLastTimeUs = -1;
+    mLastSyncFrame = mBuffers.end();
+}
+
+void AnotherPacketSource::trimToLimits_l() {
+    if (!exceedsLimits_l(2)) {
+        return;
+    }
+
+    // Get back under the limits, then keep dropping up to the next sync
+    // frame so that the decoder resumes on one, unless none is queued.
+    List<sp<ABuffer> >::iterator it = firstAccessUnit_l();
+    size_t numDropped = 0;
+    while (it != mBuffers.end()
+            && (exceedsLimits_l(1)
+                || (mNumSyncFrames > 0 && !isSyncFrame(*it)))) {
+        it = eraseAccessUnit_l(it);
+        ++numDropped;
+    }
+
+    ALOGW("%s queue over its limits, dropped %d access units "
+          "(%d bytes, %.2f secs left)",
+          mIsAudio ? "audio" : "video", numDropped, mQueuedBytes,
+          mFirstTimeUs < 0 ? 0.0 : (mLastTimeUs - mFirstTimeUs) / 1E6);
+}
+
+bool AnotherPacketSource::dequeue_l(sp<ABuffer> *buffer) {
+    *buffer = *mBuffers.begin();
+
+    int32_t discontinuity;
+    if ((*buffer)->meta()->findInt32("discontinuity", &discontinuity)) {
+        mBuffers.erase(mBuffers.begin());
+        --mNumDiscontinuities;
+
+        if (wasFormatChange(discontinuity)) {
+            mFormat.clear();
+        }
+
+        return true;
+    }
+
+    CHECK_EQ(mNumDiscontinuities, 0u);
+    eraseAccessUnit_l(mBuffers.begin());
+
+    return false;
+}
+
 void AnotherPacketSource::queueAccessUnit(const sp<ABuffer> &buffer) {
     int32_t damaged;
     if (buffer->meta()->findInt32("damaged", &damaged) && damaged) {
@@ -152,7 +274,30 @@ void AnotherPacketSource::queueAccessUnit(const sp<ABuffer> &buffer) {
     ALOGV("queueAccessUnit timeUs=%lld us (%.2f secs)", timeUs, timeUs / 1E6);
 
     Mutex::Autolock autoLock(mLock);
+
+    if (mIsAVC && (mMaxDurationUs > 0 || mMaxBytes > 0)) {
+        int32_t isSync;
+        if (!buffer->meta()->findInt32("isSync", &isSync)) {
+            buffer->meta()->setInt32("isSync", IsIDR(buffer));
+        }
+    }
+
     mBuffers.push_back(buffer);
+
+    mQueuedBytes += buffer->size();
+
+    if (isSyncFrame(buffer)) {
+        ++mNumSyncFrames;
+        mLastSyncFrame = --mBuffers.end();
+    }
+
+    if (mFirstTimeUs < 0) {
+        mFirstTimeUs = timeUs;
+    }
+    mLastTimeUs = timeUs;
+
+    trimToLimits_l();
+
     mCondition.signal();
 }
 
@@ -168,35 +313,77 @@ void AnotherPacketSource::queueDiscontinuity(
     if (type == ATSParser::DISCONTINUITY_TS_PLAYER_SEEK ||
         type == ATSParser::DISCONTINUITY_HLS_PLAYER_SEEK) {
         ALOGI("Flushing all Access units for seek");
+        clearAccessUnits_l();
         mBuffers.clear();
+        mNumDiscontinuities = 0;
         mEOSResult = OK;
         mCondition.signal();
         return;
     }
 
     // Leave only discontinuities in the queue.
-    List<sp<ABuffer> >::iterator it = mBuffers.begin();
-    while (it != mBuffers.end()) {
-        sp<ABuffer> oldBuffer = *it;
-
-        int32_t oldDiscontinuityType;
-        if (!oldBuffer->meta()->findInt32(
-                    "discontinuity", &oldDiscontinuityType)) {
-            it = mBuffers.erase(it);
-            continue;
+    clearAccessUnits_l();
+
+    mEOSResult = OK;
+
+    sp<ABuffer> buffer = new ABuffer(0);
+    buffer->meta()->setInt32("discontinuity", static_cast<int32_t>(type));
+    buffer->meta()->setMessage("extra", extra);
+
+    mBuffers.push_back(buffer);
+    ++mNumDiscontinuities;
+    mCondition.signal();
+}
+
+bool AnotherPacketSource::seekWithinQueue(
+        int64_t seekTimeUs, ATSParser::DiscontinuityType type,
+        const sp<AMessage> &extra, int64_t *actualTimeUs) {
+    Mutex::Autolock autoLock(mLock);
+
+    List<sp<ABuffer> >::iterator syncIt = mBuffers.end();
+    int64_t syncTimeUs = -1;
+    int64_t lastTimeUs = -1;
+
+    for (List<sp<ABuffer> >::iterator it = mBuffers.begin();
+         it != mBuffers.end(); ++it) {
+        const sp<ABuffer> &buffer = *it;
+
+        int64_t timeUs;
+        if (!buffer->meta()->findInt64("timeUs", &timeUs)) {
+            // Data beyond a discontinuity is not on the same timeline.
+            return false;
         }
 
-        ++it;
+        int32_t isSync;
+        if (timeUs <= seekTimeUs
+                && buffer->meta()->findInt32("isSync", &isSync) && isSync) {
+            syncIt = it;
+            syncTimeUs = timeUs;
+        }
+
+        lastTimeUs = timeUs;
     }
 
-    mEOSResult = OK;
+    if (syncIt == mBuffers.end() || lastTimeUs < seekTimeUs) {
+        return false;
+    }
+
+    List<sp<ABuffer> >::iterator it = mBuffers.begin();
+    while (it != syncIt) {
+        it = eraseAccessUnit_l(it);
+    }
 
     sp<ABuffer> buffer = new ABuffer(0);
     buffer->meta()->setInt32("discontinuity", static_cast<int32_t>(type));
     buffer->meta()->setMessage("extra", extra);
 
-    mBuffers.push_back(buffer);
+    mBuffers.push_front(buffer);
+    ++mNumDiscontinuities;
     mCondition.signal();
+
+    *actualTimeUs = syncTimeUs;
+
+    return true;
 }
 
 void AnotherPacketSource::signalEOS(status_t result) {
@@ -222,33 +409,44 @@ int64_t AnotherPacketSource::getBufferedDurationUs(status_t *finalResult) {
 
     *finalResult = mEOSResult;
 
-    if (mBuffers.empty()) {
+    if (mFirstTimeUs < 0) {
         return 0;
     }
 
-    int64_t time1 = -1;
-    int64_t time2 = -1;
+    return mLastTimeUs - mFirstTimeUs;
+}
 
-    List<sp<ABuffer> >::iterator it = mBuffers.begin();
-    while (it != mBuffers.end()) {
-        const sp<ABuffer> &buffer = *it;
+void AnotherPacketSource::setQueueLimits(
+        int64_t maxDurationUs, size_t maxBytes) {
+    Mutex::Autolock autoLock(mLock);
 
-        int64_t timeUs;
-        if (buffer->meta()->findInt64("timeUs", &timeUs)) {
-            if (time1 < 0) {
-                time1 = timeUs;
-            }
+    mMaxDurationUs = maxDurationUs;
+    mMaxBytes = maxBytes;
+}
 
-            time2 = timeUs;
-        } else {
-            // This is a discontinuity, reset everything.
-            time1 = time2 = -1;
-        }
+bool AnotherPacketSource::isFull() {
+    Mutex::Autolock autoLock(mLock);
 
-        ++it;
+    return exceedsLimits_l(1);
+}
+
+size_t AnotherPacketSource::discardUntilKeyframe() {
+    Mutex::Autolock autoLock(mLock);
+
+    if (mLastSyncFrame == mBuffers.end()) {
+        return 0;
     }
 
-    return time2 - time1;
+    List<sp<ABuffer> >::iterator it = firstAccessUnit_l();
+    size_t numDropped = 0;
+    while (it != mLastSyncFrame) {
+        it = eraseAccessUnit_l(it);
+        ++numDropped;
+    }
+
+    ALOGV("discarded %d access units up to the last sync frame", numDropped);
+
+    return numDropped;
 }
 
 status_t AnotherPacketSource::nextBufferTime(int64_t *timeUs) {
@@ -47,6 +47,21 @@ struct AnotherPacketSource : public MediaSource {
     // presentation timestamps since the last discontinuity (if any).
     int64_t getBufferedDurationUs(status_t *finalResult);
 
+    // Bounds the buffered duration and bytes, 0 meaning unbounded. The
+    // defaults come from media.stagefright.apsource.max-ms and
+    // media.stagefright.apsource.max-kb.
+    void setQueueLimits(int64_t maxDurationUs, size_t maxBytes);
+
+    // True once either limit is reached, producers that can should hold
+    // off feeding until it clears. If the queue grows to twice a limit
+    // anyway the oldest access units are dropped, up to a sync frame.
+    bool isFull();
+
+    // Drops the access units queued in front of the most recent sync
+    // frame, for catching up after the consumer stalled. Returns the
+    // number of access units dropped.
+    size_t discardUntilKeyframe();
+
     status_t nextBufferTime(int64_t *timeUs);
 
     void queueAccessUnit(const sp<ABuffer> &buffer);
@@ -54,6 +69,14 @@ struct AnotherPacketSource : public MediaSource {
     void queueDiscontinuity(
             ATSParser::DiscontinuityType type, const sp<AMessage> &extra);
 
+    // If the queue holds an access unit marked "isSync" at or before
+    // "seekTimeUs" and data up to "seekTimeUs", drops everything queued
+    // before that access unit, puts a discontinuity of the given type in
+    // front of it and returns true with its time in "actualTimeUs".
+    bool seekWithinQueue(
+            int64_t seekTimeUs, ATSParser::DiscontinuityType type,
+            const sp<AMessage> &extra, int64_t *actualTimeUs);
+
     void signalEOS(status_t result);
 
     status_t dequeueAccessUnit(sp<ABuffer> *buffer);
@@ -68,11 +91,32 @@ private:
     Condition mCondition;
 
     bool mIsAudio;
+    bool mIsAVC;
     sp<MetaData> mFormat;
     List<sp<ABuffer> > mBuffers;
     status_t mEOSResult;
 
+    int64_t mMaxDurationUs;
+    size_t mMaxBytes;
+
+    // The queue always holds discontinuities first and access units after
+    // them, so the accounting below only has to follow its two ends.
+    size_t mNumDiscontinuities;
+    size_t mNumSyncFrames;
+    size_t mQueuedBytes;
+    int64_t mFirstTimeUs;   // of the first queued access unit, -1 if none
+    int64_t mLastTimeUs;    // of the last queued access unit, -1 if none
+    List<sp<ABuffer> >::iterator mLastSyncFrame;
+
     bool wasFormatChange(int32_t discontinuityType) const;
+    bool isSyncFrame(const sp<ABuffer> &buffer) const;
+    bool exceedsLimits_l(size_t factor) const;
+    List<sp<ABuffer> >::iterator firstAccessUnit_l();
+    List<sp<ABuffer> >::iterator eraseAccessUnit_l(
+            List<sp<ABuffer> >::iterator it);
+    void clearAccessUnits_l();
+    void trimToLimits_l();
+    bool dequeue_l(sp<ABuffer> *buffer);
 
     DISALLOW_EVIL_CONSTRUCTORS(AnotherPacketSource);
 };
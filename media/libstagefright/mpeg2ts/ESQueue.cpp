@@ -43,6 +43,10 @@ sp<MetaData> ElementaryStreamQueue::getFormat() {
 
 void ElementaryStreamQueue::clear(bool clearFormat) {
     if (mBuffer != NULL) {
+        if (mBuffer->getStrongCount() > 1) {
+            // Access units handed out still refer to this storage.
+            mBuffer = new ABuffer(mBuffer->capacity());
+        }
         mBuffer->setRange(0, 0);
     }
 
@@ -254,7 +258,18 @@ status_t ElementaryStreamQueue::appendData(
     }
 
     size_t neededSize = (mBuffer == NULL ? 0 : mBuffer->size()) + size;
-    if (mBuffer == NULL || neededSize > mBuffer->capacity()) {
+    if (mBuffer != NULL
+            && mBuffer->offset() + neededSize > mBuffer->capacity()
+            && neededSize <= mBuffer->capacity()
+            && mBuffer->getStrongCount() == 1) {
+        // No access unit refers to the consumed bytes anymore, so the
+        // remaining ones can be moved to the front.
+        memmove(mBuffer->base(), mBuffer->data(), mBuffer->size());
+        mBuffer->setRange(0, mBuffer->size());
+    }
+
+    if (mBuffer == NULL
+            || mBuffer->offset() + neededSize > mBuffer->capacity()) {
         neededSize = (neededSize + 65535) & ~65535;
 
         ALOGV("resizing buffer to size %d", neededSize);
@@ -271,7 +286,7 @@ status_t ElementaryStreamQueue::appendData(
     }
 
     memcpy(mBuffer->data() + mBuffer->size(), data, size);
-    mBuffer->setRange(0, mBuffer->size() + size);
+    mBuffer->setRange(mBuffer->offset(), mBuffer->size() + size);
 
     RangeInfo info;
     info.mLength = size;
@@ -380,18 +395,25 @@ sp<ABuffer> ElementaryStreamQueue::dequeueAccessUnitAAC() {
         return NULL;
     }
 
-    sp<ABuffer> accessUnit = new ABuffer(offset);
-    memcpy(accessUnit->data(), mBuffer->data(), offset);
-
-    memmove(mBuffer->data(), mBuffer->data() + offset,
-            mBuffer->size() - offset);
-    mBuffer->setRange(0, mBuffer->size() - offset);
+    sp<ABuffer> accessUnit = consumeAccessUnit(offset);
 
     accessUnit->meta()->setInt64("timeUs", timeUs);
 
     return accessUnit;
 }
 
+void ElementaryStreamQueue::consume(size_t size) {
+    CHECK_LE(size, mBuffer->size());
+    mBuffer->setRange(mBuffer->offset() + size, mBuffer->size() - size);
+}
+
+sp<ABuffer> ElementaryStreamQueue::consumeAccessUnit(size_t size) {
+    sp<ABuffer> accessUnit = mBuffer->slice(0, size);
+    consume(size);
+
+    return accessUnit;
+}
+
 int64_t ElementaryStreamQueue::fetchTimestamp(size_t size) {
     int64_t timeUs = -1;
     bool first = true;
@@ -476,47 +498,65 @@ sp<ABuffer> ElementaryStreamQueue::dequeueAccessUnitH264() {
             // The access unit will contain all nal units up to, but excluding
             // the current one, separated by 0x00 0x00 0x00 0x01 startcodes.
 
-            size_t auSize = 4 * nals.size() + totalSize;
-            sp<ABuffer> accessUnit = new ABuffer(auSize);
-
-#if !LOG_NDEBUG
-            AString out;
-#endif
+            const NALPosition &lastPos = nals.itemAt(nals.size() - 1);
+            size_t nextScan = lastPos.nalOffset + lastPos.nalSize;
 
-            size_t dstOffset = 0;
+            // If the stream already uses 4 byte startcodes and has nothing
+            // between the nal units, the access unit is the start of mBuffer
+            // as it is.
+            bool contiguous = true;
+            size_t expectedOffset = 4;
             for (size_t i = 0; i < nals.size(); ++i) {
                 const NALPosition &pos = nals.itemAt(i);
 
-                unsigned nalType = mBuffer->data()[pos.nalOffset] & 0x1f;
+                if (pos.nalOffset != expectedOffset
+                        || memcmp(mBuffer->data() + pos.nalOffset - 4,
+                                  "\x00\x00\x00\x01", 4)) {
+                    contiguous = false;
+                    break;
+                }
+
+                expectedOffset = pos.nalOffset + pos.nalSize + 4;
+            }
 
 #if !LOG_NDEBUG
+            AString out;
+            for (size_t i = 0; i < nals.size(); ++i) {
                 char tmp[128];
-                sprintf(tmp, "0x%02x", nalType);
+                sprintf(tmp, "0x%02x",
+                        mBuffer->data()[nals.itemAt(i).nalOffset] & 0x1f);
                 if (i > 0) {
                     out.append(", ");
                 }
                 out.append(tmp);
+            }
 #endif
 
-                memcpy(accessUnit->data() + dstOffset, "\x00\x00\x00\x01", 4);
+            ALOGV("accessUnit contains nal types %s", out.c_str());
 
-                memcpy(accessUnit->data() + dstOffset + 4,
-                       mBuffer->data() + pos.nalOffset,
-                       pos.nalSize);
+            sp<ABuffer> accessUnit;
+            if (contiguous) {
+                accessUnit = consumeAccessUnit(nextScan);
+            } else {
+                size_t auSize = 4 * nals.size() + totalSize;
+                accessUnit = new ABuffer(auSize);
 
-                dstOffset += pos.nalSize + 4;
-            }
+                size_t dstOffset = 0;
+                for (size_t i = 0; i < nals.size(); ++i) {
+                    const NALPosition &pos = nals.itemAt(i);
 
-            ALOGV("accessUnit contains nal types %s", out.c_str());
+                    memcpy(accessUnit->data() + dstOffset,
+                           "\x00\x00\x00\x01", 4);
 
-            const NALPosition &pos = nals.itemAt(nals.size() - 1);
-            size_t nextScan = pos.nalOffset + pos.nalSize;
+                    memcpy(accessUnit->data() + dstOffset + 4,
+                           mBuffer->data() + pos.nalOffset,
+                           pos.nalSize);
 
-            memmove(mBuffer->data(),
-                    mBuffer->data() + nextScan,
-                    mBuffer->size() - nextScan);
+                    dstOffset += pos.nalSize + 4;
+                }
 
-            mBuffer->setRange(0, mBuffer->size() - nextScan);
+                consume(nextScan);
+            }
 
             int64_t timeUs = fetchTimestamp(nextScan);
             CHECK_GE(timeUs, 0ll);
@@ -565,14 +605,7 @@ sp<ABuffer> ElementaryStreamQueue::dequeueAccessUnitMPEGAudio() {
 
     unsigned layer = 4 - ((header >> 17) & 3);
 
-    sp<ABuffer> accessUnit = new ABuffer(frameSize);
-    memcpy(accessUnit->data(), data, frameSize);
-
-    memmove(mBuffer->data(),
-            mBuffer->data() + frameSize,
-            mBuffer->size() - frameSize);
-
-    mBuffer->setRange(0, mBuffer->size() - frameSize);
+    sp<ABuffer> accessUnit = consumeAccessUnit(frameSize);
 
     int64_t timeUs = fetchTimestamp(frameSize);
     CHECK_GE(timeUs, 0ll);
@@ -667,11 +700,11 @@ sp<ABuffer> ElementaryStreamQueue::dequeueAccessUnitMPEGVideo() {
         currentStartCode = data[offset + 3];
 
         if (currentStartCode == 0xb3 && mFormat == NULL) {
-            memmove(mBuffer->data(), mBuffer->data() + offset, size - offset);
+            consume(offset);
+            data = mBuffer->data();
             size -= offset;
             (void)fetchTimestamp(offset);
             offset = 0;
-            mBuffer->setRange(0, size);
         }
 
         if ((prevStartCode == 0xb3 && currentStartCode != 0xb5)
@@ -697,11 +730,8 @@ sp<ABuffer> ElementaryStreamQueue::dequeueAccessUnitMPEGVideo() {
                 sp<ABuffer> csd = new ABuffer(offset);
                 memcpy(csd->data(), data, offset);
 
-                memmove(mBuffer->data(),
-                        mBuffer->data() + offset,
-                        mBuffer->size() - offset);
-
-                mBuffer->setRange(0, mBuffer->size() - offset);
+                consume(offset);
+                data = mBuffer->data();
                 size -= offset;
                 (void)fetchTimestamp(offset);
                 offset = 0;
@@ -722,14 +752,7 @@ sp<ABuffer> ElementaryStreamQueue::dequeueAccessUnitMPEGVideo() {
             if (!sawPictureStart) {
                 sawPictureStart = true;
             } else {
-                sp<ABuffer> accessUnit = new ABuffer(offset);
-                memcpy(accessUnit->data(), data, offset);
-
-                memmove(mBuffer->data(),
-                        mBuffer->data() + offset,
-                        mBuffer->size() - offset);
-
-                mBuffer->setRange(0, mBuffer->size() - offset);
+                sp<ABuffer> accessUnit = consumeAccessUnit(offset);
 
                 int64_t timeUs = fetchTimestamp(offset);
                 CHECK_GE(timeUs, 0ll);
@@ -883,12 +906,7 @@ sp<ABuffer> ElementaryStreamQueue::dequeueAccessUnitMPEG4Video() {
                 if (chunkType == 0xb6) {
                     offset += chunkSize;
 
-                    sp<ABuffer> accessUnit = new ABuffer(offset);
-                    memcpy(accessUnit->data(), data, offset);
-
-                    memmove(data, &data[offset], size - offset);
-                    size -= offset;
-                    mBuffer->setRange(0, size);
+                    sp<ABuffer> accessUnit = consumeAccessUnit(offset);
 
                     int64_t timeUs = fetchTimestamp(offset);
                     CHECK_GE(timeUs, 0ll);
@@ -917,10 +935,10 @@ sp<ABuffer> ElementaryStreamQueue::dequeueAccessUnitMPEG4Video() {
 
         if (discard) {
             (void)fetchTimestamp(offset);
-            memmove(data, &data[offset], size - offset);
+            consume(offset);
+            data = mBuffer->data();
             size -= offset;
             offset = 0;
-            mBuffer->setRange(0, size);
         } else {
             offset += chunkSize;
         }
@@ -68,6 +68,15 @@ private:
     // returns its timestamp in us (or -1 if no time information).
     int64_t fetchTimestamp(size_t size);
 
+    // Drops the first "size" bytes of mBuffer by advancing its range. The
+    // bytes are left in place, since access units returned as slices of
+    // mBuffer may still refer to them.
+    void consume(size_t size);
+
+    // Hands out the first "size" bytes of mBuffer as an access unit
+    // without copying them.
+    sp<ABuffer> consumeAccessUnit(size_t size);
+
     DISALLOW_EVIL_CONSTRUCTORS(ElementaryStreamQueue);
 };
 
@@ -21,7 +21,9 @@
 #include "include/MPEG2TSExtractor.h"
 #include "include/LiveSession.h"
 #include "include/NuCachedSource2.h"
+#include "include/avc_utils.h"
 
+#include <media/stagefright/foundation/ABuffer.h>
 #include <media/stagefright/foundation/ADebug.h>
 #include <media/stagefright/DataSource.h>
 #include <media/stagefright/MediaDefs.h>
@@ -37,6 +39,15 @@ namespace android {
 
 static const size_t kTSPacketSize = 188;
 
+// Packets are read from the data source and handed to the parser in
+// batches rather than one at a time.
+static const size_t kNumPacketsPerRead = 16;
+
+// How far from a PCR sample a seek is allowed to land, and how much of
+// the file is searched for a PCR after each bisection point.
+static const off64_t kSeekPrecisionBytes = 64 * 1024;
+static const off64_t kMaxPCRSearchBytes = 1024 * 1024;
+
 struct MPEG2TSSource : public MediaSource {
     MPEG2TSSource(
             const sp<MPEG2TSExtractor> &extractor,
@@ -58,6 +69,10 @@ private:
     // will be seekable, otherwise the single stream will be seekable.
     bool mSeekable;
 
+    // After a seek within a local file, H.264 access units are dropped
+    // until the first IDR frame.
+    bool mSkipToIDR;
+
     DISALLOW_EVIL_CONSTRUCTORS(MPEG2TSSource);
 };
 
@@ -67,7 +82,8 @@ MPEG2TSSource::MPEG2TSSource(
         bool seekable)
     : mExtractor(extractor),
       mImpl(impl),
-      mSeekable(seekable) {
+      mSeekable(seekable),
+      mSkipToIDR(false) {
 }
 
 status_t MPEG2TSSource::start(MetaData *params) {
@@ -85,6 +101,8 @@ sp<MetaData> MPEG2TSSource::getFormat() {
     if (mExtractor->mLiveSession != NULL
             && mExtractor->mLiveSession->getDuration(&durationUs) == OK) {
         meta->setInt64(kKeyDuration, durationUs);
+    } else if (mExtractor->mSeekableFile) {
+        meta->setInt64(kKeyDuration, mExtractor->mDurationUs);
     }
 
     return meta;
@@ -98,21 +116,44 @@ status_t MPEG2TSSource::read(
     ReadOptions::SeekMode seekMode;
     if (mSeekable && options && options->getSeekTo(&seekTimeUs, &seekMode)) {
         mExtractor->seekTo(seekTimeUs);
+
+        const char *mime;
+        mSkipToIDR = mExtractor->mSeekableFile
+            && mImpl->getFormat() != NULL
+            && mImpl->getFormat()->findCString(kKeyMIMEType, &mime)
+            && !strcasecmp(mime, MEDIA_MIMETYPE_VIDEO_AVC);
     }
 
-    status_t finalResult;
-    while (!mImpl->hasBufferAvailable(&finalResult)) {
-        if (finalResult != OK) {
-            return ERROR_END_OF_STREAM;
+    for (;;) {
+        status_t finalResult;
+        while (!mImpl->hasBufferAvailable(&finalResult)) {
+            if (finalResult != OK) {
+                return ERROR_END_OF_STREAM;
+            }
+
+            status_t err = mExtractor->feedMore();
+            if (err != OK) {
+                mImpl->signalEOS(err);
+            }
         }
 
-        status_t err = mExtractor->feedMore();
-        if (err != OK) {
-            mImpl->signalEOS(err);
+        status_t err = mImpl->read(out, options);
+        if (err != OK || !mSkipToIDR) {
+            return err;
         }
-    }
 
-    return mImpl->read(out, options);
+        sp<ABuffer> accessUnit = new ABuffer(
+                (uint8_t *)(*out)->data() + (*out)->range_offset(),
+                (*out)->range_length());
+
+        if (IsIDR(accessUnit)) {
+            mSkipToIDR = false;
+            return OK;
+        }
+
+        (*out)->release();
+        *out = NULL;
+    }
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -120,7 +161,11 @@ status_t MPEG2TSSource::read(
 MPEG2TSExtractor::MPEG2TSExtractor(const sp<DataSource> &source)
     : mDataSource(source),
       mParser(new ATSParser),
-      mOffset(0) {
+      mOffset(0),
+      mSeekableFile(false),
+      mFileSize(0),
+      mFirstPCR(0),
+      mDurationUs(0) {
     init();
 }
 
@@ -165,7 +210,6 @@ sp<MetaData> MPEG2TSExtractor::getMetaData() {
 void MPEG2TSExtractor::init() {
     bool haveAudio = false;
     bool haveVideo = false;
-    int numPacketsParsed = 0;
 
     while (feedMore() == OK) {
         ATSParser::SourceType type;
@@ -194,26 +238,31 @@ void MPEG2TSExtractor::init() {
             }
         }
 
-        if (++numPacketsParsed > 10000) {
+        if (mOffset > 10000 * (off64_t)kTSPacketSize) {
             break;
         }
     }
 
     ALOGI("haveAudio=%d, haveVideo=%d", haveAudio, haveVideo);
+
+    initSeekIndex();
 }
 
 status_t MPEG2TSExtractor::feedMore() {
     Mutex::Autolock autoLock(mLock);
 
-    uint8_t packet[kTSPacketSize];
-    ssize_t n = mDataSource->readAt(mOffset, packet, kTSPacketSize);
+    uint8_t packets[kNumPacketsPerRead * kTSPacketSize];
+    ssize_t n = mDataSource->readAt(mOffset, packets, sizeof(packets));
 
     if (n < (ssize_t)kTSPacketSize) {
         return (n < 0) ? (status_t)n : ERROR_END_OF_STREAM;
     }
 
-    mOffset += n;
-    return mParser->feedTSPacket(packet, kTSPacketSize);
+    // A trailing partial packet is read again by the next call.
+    size_t size = n - (n % kTSPacketSize);
+
+    mOffset += size;
+    return mParser->feedTSPackets(packets, size);
 }
 
 void MPEG2TSExtractor::setLiveSession(const sp<LiveSession> &liveSession) {
@@ -226,6 +275,9 @@ void MPEG2TSExtractor::seekTo(int64_t seekTimeUs) {
     Mutex::Autolock autoLock(mLock);
 
     if (mLiveSession == NULL) {
+        if (mSeekableFile) {
+            seekFile_l(seekTimeUs);
+        }
         return;
     }
 
@@ -237,13 +289,165 @@ uint32_t MPEG2TSExtractor::flags() const {
 
     uint32_t flags = CAN_PAUSE;
 
-    if (mLiveSession != NULL && mLiveSession->isSeekable()) {
+    if ((mLiveSession != NULL && mLiveSession->isSeekable())
+            || (mLiveSession == NULL && mSeekableFile)) {
         flags |= CAN_SEEK_FORWARD | CAN_SEEK_BACKWARD | CAN_SEEK;
     }
 
     return flags;
 }
 
+// Returns the 90kHz PCR base of the TS packet, if it carries one.
+static bool GetPCR(const uint8_t *packet, uint64_t *pcr) {
+    unsigned adaptation_field_control = (packet[3] >> 4) & 3;
+
+    if (packet[0] != 0x47
+            || (adaptation_field_control != 2 && adaptation_field_control != 3)
+            || packet[4] < 7 /* flags and PCR */
+            || !(packet[5] & 0x10) /* PCR_flag */) {
+        return false;
+    }
+
+    *pcr = ((uint64_t)packet[6] << 25)
+        | ((uint64_t)packet[7] << 17)
+        | ((uint64_t)packet[8] << 9)
+        | ((uint64_t)packet[9] << 1)
+        | (packet[10] >> 7);
+
+    return true;
+}
+
+void MPEG2TSExtractor::initSeekIndex() {
+    // Only local files, seeking through a cache would refetch data from
+    // the network.
+    if (mDataSource->flags()
+            & (DataSource::kIsCachingDataSource
+                | DataSource::kIsHTTPBasedSource)) {
+        return;
+    }
+
+    if (mDataSource->getSize(&mFileSize) != OK
+            || mFileSize < (off64_t)kTSPacketSize) {
+        return;
+    }
+    mFileSize -= mFileSize % kTSPacketSize;
+
+    uint8_t packet[kTSPacketSize];
+    bool found = false;
+    for (off64_t offset = 0;
+            !found && offset < kMaxPCRSearchBytes && offset < mFileSize;
+            offset += kTSPacketSize) {
+        if (mDataSource->readAt(offset, packet, kTSPacketSize)
+                != (ssize_t)kTSPacketSize) {
+            break;
+        }
+        found = GetPCR(packet, &mFirstPCR);
+    }
+
+    if (!found) {
+        ALOGI("no PCR found, file is not seekable");
+        return;
+    }
+
+    // The duration is taken from the last PCR in the file.
+    off64_t offset = mFileSize - kMaxPCRSearchBytes;
+    if (offset < 0) {
+        offset = 0;
+    }
+    offset -= offset % kTSPacketSize;
+
+    int64_t timeUs;
+    off64_t pcrOffset;
+    while (findPCR(offset, mFileSize, &timeUs, &pcrOffset) == OK) {
+        mDurationUs = timeUs;
+        offset = pcrOffset + kTSPacketSize;
+    }
+
+    mSeekableFile = true;
+
+    ALOGV("seekable file, duration %lld us", mDurationUs);
+}
+
+status_t MPEG2TSExtractor::findPCR(
+        off64_t offset, off64_t limit, int64_t *timeUs, off64_t *pcrOffset) {
+    if (limit > offset + kMaxPCRSearchBytes) {
+        limit = offset + kMaxPCRSearchBytes;
+    }
+
+    uint8_t packets[kNumPacketsPerRead * kTSPacketSize];
+    while (offset < limit) {
+        size_t size = sizeof(packets);
+        if (offset + (off64_t)size > limit) {
+            size = limit - offset;
+        }
+
+        ssize_t n = mDataSource->readAt(offset, packets, size);
+        if (n < (ssize_t)kTSPacketSize) {
+            break;
+        }
+
+        for (ssize_t i = 0; i + (ssize_t)kTSPacketSize <= n;
+                i += kTSPacketSize) {
+            uint64_t pcr;
+            if (GetPCR(&packets[i], &pcr)) {
+                // PCRs are 33 bits, this survives one wrap around.
+                pcr = (pcr - mFirstPCR) & ((1ull << 33) - 1);
+
+                *timeUs = (pcr * 100) / 9;
+                *pcrOffset = offset + i;
+                return OK;
+            }
+        }
+
+        offset += n - (n % kTSPacketSize);
+    }
+
+    return ERROR_END_OF_STREAM;
+}
+
+void MPEG2TSExtractor::seekFile_l(int64_t seekTimeUs) {
+    // Start out from the closest samples around the target known so far.
+    off64_t loOffset = 0;
+    off64_t hiOffset = mFileSize;
+    for (size_t i = 0; i < mSeekIndex.size(); ++i) {
+        if (mSeekIndex.keyAt(i) <= seekTimeUs) {
+            loOffset = mSeekIndex.valueAt(i);
+        } else {
+            hiOffset = mSeekIndex.valueAt(i);
+            break;
+        }
+    }
+
+    size_t numProbes = 0;
+    while (hiOffset - loOffset > kSeekPrecisionBytes) {
+        off64_t offset = loOffset + (hiOffset - loOffset) / 2;
+        offset -= offset % kTSPacketSize;
+
+        int64_t timeUs;
+        off64_t pcrOffset;
+        if (findPCR(offset, hiOffset, &timeUs, &pcrOffset) != OK) {
+            hiOffset = offset;
+            continue;
+        }
+
+        ++numProbes;
+        mSeekIndex.add(timeUs, pcrOffset);
+
+        if (timeUs <= seekTimeUs) {
+            loOffset = pcrOffset;
+        } else {
+            hiOffset = pcrOffset;
+        }
+    }
+
+    ALOGV("seek to %lld us lands at offset %lld after %d probes",
+          seekTimeUs, loOffset, numProbes);
+
+    mOffset = loOffset;
+    mParser->signalDiscontinuity(
+            ATSParser::DISCONTINUITY_TS_PLAYER_SEEK, NULL /* extra */);
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 
 bool SniffMPEG2TS(
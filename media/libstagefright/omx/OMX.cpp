@@ -75,7 +75,7 @@ private:
 
     sp<CallbackDispatcherThread> mThread;
 
-    void dispatch(const omx_message &msg);
+    void dispatch(const List<omx_message> &messages);
 
     CallbackDispatcher(const CallbackDispatcher &);
     CallbackDispatcher &operator=(const CallbackDispatcher &);
@@ -113,17 +113,20 @@ void OMX::CallbackDispatcher::post(const omx_message &msg) {
     mQueueChanged.signal();
 }
 
-void OMX::CallbackDispatcher::dispatch(const omx_message &msg) {
+void OMX::CallbackDispatcher::dispatch(const List<omx_message> &messages) {
     if (mOwner == NULL) {
         ALOGV("Would have dispatched a message to a node that's already gone.");
         return;
     }
-    mOwner->onMessage(msg);
+    mOwner->onMessages(messages);
 }
 
 bool OMX::CallbackDispatcher::loop() {
     for (;;) {
-        omx_message msg;
+        // Everything the component posted since the last dispatch, typically
+        // an EMPTY_BUFFER_DONE and the FILL_BUFFER_DONE it produced, goes
+        // out in one transaction to a remote observer.
+        List<omx_message> messages;
 
         {
             Mutex::Autolock autoLock(mLock);
@@ -135,11 +138,13 @@ bool OMX::CallbackDispatcher::loop() {
                 break;
             }
 
-            msg = *mQueue.begin();
-            mQueue.erase(mQueue.begin());
+            while (!mQueue.empty()) {
+                messages.push_back(*mQueue.begin());
+                mQueue.erase(mQueue.begin());
+            }
         }
 
-        dispatch(msg);
+        dispatch(messages);
     }
 
     return false;
@@ -23,13 +23,52 @@
 #include "SoftOMXPlugin.h"
 
 #include <dlfcn.h>
+#include <stdio.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #include <media/stagefright/foundation/ADebug.h>
 
 namespace android {
 
+static const char kVendorLibName[] = "libstagefrighthw.so";
+
+// Where the dynamic linker looks for the vendor plugin, in search order.
+static const char *kVendorLibDirs[] = { "/vendor/lib/", "/system/lib/" };
+
+static const size_t kNumVendorLibDirs =
+    sizeof(kVendorLibDirs) / sizeof(kVendorLibDirs[0]);
+
+// The names and roles of the vendor components, so that mediaserver does
+// not need to load the vendor plugin, and with it usually the vendor's
+// whole OMX core, at startup just to list them. The first line identifies
+// the vendor plugin library the list was built from, each following line
+// is a component name followed by its roles.
+static const char kVendorComponentCachePath[] =
+    "/data/misc/media/omx_vendor_components";
+
+// Identifies the installed vendor plugin library by path, modification time
+// and size. The component cache is only used if it was written for it.
+static bool getVendorLibStamp(String8 *stamp) {
+    for (size_t i = 0; i < kNumVendorLibDirs; ++i) {
+        String8 path(kVendorLibDirs[i]);
+        path.append(kVendorLibName);
+
+        struct stat st;
+        if (stat(path.string(), &st) == 0) {
+            stamp->setTo(path);
+            stamp->appendFormat(" %lld %lld",
+                    (long long)st.st_mtime, (long long)st.st_size);
+            return true;
+        }
+    }
+
+    return false;
+}
+
 OMXMaster::OMXMaster()
-    : mVendorLibHandle(NULL) {
+    : mVendorLibHandle(NULL),
+      mVendorPluginPending(false) {
     addVendorPlugin();
     addPlugin(new SoftOMXPlugin);
 }
@@ -44,14 +83,23 @@ OMXMaster::~OMXMaster() {
 }
 
 void OMXMaster::addVendorPlugin() {
-    addPlugin("libstagefrighthw.so");
+    if (readVendorComponentCache()) {
+        return;
+    }
+
+    OMXPluginBase *plugin = createPlugin(kVendorLibName);
+
+    if (plugin != NULL) {
+        addPlugin(plugin);
+        writeVendorComponentCache(plugin);
+    }
 }
 
-void OMXMaster::addPlugin(const char *libname) {
+OMXPluginBase *OMXMaster::createPlugin(const char *libname) {
     mVendorLibHandle = dlopen(libname, RTLD_NOW);
 
     if (mVendorLibHandle == NULL) {
-        return;
+        return NULL;
     }
 
     typedef OMXPluginBase *(*CreateOMXPluginFunc)();
@@ -63,13 +111,19 @@ void OMXMaster::addPlugin(const char *libname) {
                 mVendorLibHandle, "_ZN7android15createOMXPluginEv");
 
     if (createOMXPlugin) {
-        addPlugin((*createOMXPlugin)());
+        return (*createOMXPlugin)();
     }
+
+    return NULL;
 }
 
 void OMXMaster::addPlugin(OMXPluginBase *plugin) {
     Mutex::Autolock autoLock(mLock);
 
+    addPlugin_l(plugin);
+}
+
+void OMXMaster::addPlugin_l(OMXPluginBase *plugin) {
     mPlugins.push_back(plugin);
 
     OMX_U32 index = 0;
@@ -96,6 +150,59 @@ void OMXMaster::addPlugin(OMXPluginBase *plugin) {
     }
 }
 
+OMXPluginBase *OMXMaster::loadVendorPlugin_l() {
+    mVendorPluginPending = false;
+    mVendorRolesByComponentName.clear();
+
+    OMXPluginBase *plugin = createPlugin(kVendorLibName);
+
+    if (plugin == NULL) {
+        ALOGE("unable to load %s listed in the component cache", kVendorLibName);
+        unlink(kVendorComponentCachePath);
+        return NULL;
+    }
+
+    mPlugins.push_front(plugin);
+
+    // Hand the cached components over to the plugin that implements them.
+    bool stale = false;
+    OMX_U32 index = 0;
+
+    char name[128];
+    while (plugin->enumerateComponents(
+                name, sizeof(name), index++) == OMX_ErrorNone) {
+        String8 name8(name);
+
+        ssize_t nameIndex = mPluginByComponentName.indexOfKey(name8);
+        if (nameIndex >= 0 && mPluginByComponentName.valueAt(nameIndex) == NULL) {
+            mPluginByComponentName.replaceValueAt(nameIndex, plugin);
+            continue;
+        }
+
+        ALOGW("component cache is missing '%s'", name);
+        stale = true;
+
+        if (nameIndex < 0) {
+            mPluginByComponentName.add(name8, plugin);
+        }
+    }
+
+    for (size_t i = 0; i < mPluginByComponentName.size(); ++i) {
+        if (mPluginByComponentName.valueAt(i) == NULL) {
+            ALOGW("component cache lists unknown '%s'",
+                 mPluginByComponentName.keyAt(i).string());
+            stale = true;
+        }
+    }
+
+    if (stale) {
+        // It is rebuilt at the next start.
+        unlink(kVendorComponentCachePath);
+    }
+
+    return plugin;
+}
+
 void OMXMaster::clearPlugins() {
     Mutex::Autolock autoLock(mLock);
 
@@ -134,6 +241,18 @@ OMX_ERRORTYPE OMXMaster::makeComponentInstance(
     }
 
     OMXPluginBase *plugin = mPluginByComponentName.valueAt(index);
+
+    if (plugin == NULL && mVendorPluginPending) {
+        loadVendorPlugin_l();
+
+        index = mPluginByComponentName.indexOfKey(String8(name));
+        plugin = (index < 0) ? NULL : mPluginByComponentName.valueAt(index);
+    }
+
+    if (plugin == NULL) {
+        return OMX_ErrorComponentNotFound;
+    }
+
     OMX_ERRORTYPE err =
         plugin->makeComponentInstance(name, callbacks, appData, component);
 
@@ -196,7 +315,130 @@ OMX_ERRORTYPE OMXMaster::getRolesOfComponent(
     }
 
     OMXPluginBase *plugin = mPluginByComponentName.valueAt(index);
+
+    if (plugin == NULL) {
+        ssize_t rolesIndex = mVendorRolesByComponentName.indexOfKey(String8(name));
+
+        if (rolesIndex < 0) {
+            return OMX_ErrorComponentNotFound;
+        }
+
+        *roles = mVendorRolesByComponentName.valueAt(rolesIndex);
+        return OMX_ErrorNone;
+    }
+
     return plugin->getRolesOfComponent(name, roles);
 }
 
+bool OMXMaster::readVendorComponentCache() {
+    String8 stamp;
+    if (!getVendorLibStamp(&stamp)) {
+        return false;
+    }
+
+    FILE *file = fopen(kVendorComponentCachePath, "r");
+    if (file == NULL) {
+        return false;
+    }
+
+    KeyedVector<String8, Vector<String8> > rolesByComponentName;
+
+    char line[1024];
+    bool valid = false;
+    if (fgets(line, sizeof(line), file) != NULL) {
+        line[strcspn(line, "\n")] = '\0';
+        valid = (stamp == line);
+    }
+
+    while (valid && fgets(line, sizeof(line), file) != NULL) {
+        if (strchr(line, '\n') == NULL) {
+            // truncated
+            valid = false;
+            break;
+        }
+
+        char *savePtr;
+        char *token = strtok_r(line, " \n", &savePtr);
+        if (token == NULL) {
+            continue;
+        }
+
+        String8 name8(token);
+        Vector<String8> roles;
+        while ((token = strtok_r(NULL, " \n", &savePtr)) != NULL) {
+            roles.push(String8(token));
+        }
+
+        rolesByComponentName.add(name8, roles);
+    }
+
+    fclose(file);
+
+    if (!valid || rolesByComponentName.isEmpty()) {
+        ALOGV("component cache does not match %s", stamp.string());
+        return false;
+    }
+
+    Mutex::Autolock autoLock(mLock);
+
+    for (size_t i = 0; i < rolesByComponentName.size(); ++i) {
+        mPluginByComponentName.add(rolesByComponentName.keyAt(i), NULL);
+    }
+    mVendorRolesByComponentName = rolesByComponentName;
+    mVendorPluginPending = true;
+
+    ALOGV("%d vendor components read from the component cache",
+         rolesByComponentName.size());
+
+    return true;
+}
+
+void OMXMaster::writeVendorComponentCache(OMXPluginBase *plugin) {
+    String8 stamp;
+    if (!getVendorLibStamp(&stamp)) {
+        return;
+    }
+
+    String8 tmpPath(kVendorComponentCachePath);
+    tmpPath.append(".tmp");
+
+    FILE *file = fopen(tmpPath.string(), "w");
+    if (file == NULL) {
+        ALOGV("unable to write %s", tmpPath.string());
+        return;
+    }
+
+    fprintf(file, "%s\n", stamp.string());
+
+    bool success = true;
+    size_t numComponents = 0;
+    OMX_U32 index = 0;
+
+    char name[128];
+    while (plugin->enumerateComponents(
+                name, sizeof(name), index++) == OMX_ErrorNone) {
+        Vector<String8> roles;
+        if (plugin->getRolesOfComponent(name, &roles) != OMX_ErrorNone) {
+            success = false;
+            break;
+        }
+
+        fprintf(file, "%s", name);
+        for (size_t i = 0; i < roles.size(); ++i) {
+            fprintf(file, " %s", roles[i].string());
+        }
+        fprintf(file, "\n");
+        ++numComponents;
+    }
+
+    success = success && numComponents > 0 && !ferror(file);
+    if (fclose(file) != 0) {
+        success = false;
+    }
+
+    if (!success || rename(tmpPath.string(), kVendorComponentCachePath) != 0) {
+        unlink(tmpPath.string());
+    }
+}
+
 }  // namespace android
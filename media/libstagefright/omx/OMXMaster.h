@@ -24,6 +24,7 @@
 #include <utils/KeyedVector.h>
 #include <utils/List.h>
 #include <utils/String8.h>
+#include <utils/Vector.h>
 
 namespace android {
 
@@ -57,11 +58,22 @@ private:
 
     void *mVendorLibHandle;
 
+    // Components of the vendor plugin read from the component cache map to
+    // a NULL plugin until the vendor library is actually needed, their
+    // roles are served from the cache in the meantime.
+    bool mVendorPluginPending;
+    KeyedVector<String8, Vector<String8> > mVendorRolesByComponentName;
+
     void addVendorPlugin();
-    void addPlugin(const char *libname);
     void addPlugin(OMXPluginBase *plugin);
+    void addPlugin_l(OMXPluginBase *plugin);
+    OMXPluginBase *createPlugin(const char *libname);
+    OMXPluginBase *loadVendorPlugin_l();
     void clearPlugins();
 
+    bool readVendorComponentCache();
+    void writeVendorComponentCache(OMXPluginBase *plugin);
+
     OMXMaster(const OMXMaster &);
     OMXMaster &operator=(const OMXMaster &);
 };
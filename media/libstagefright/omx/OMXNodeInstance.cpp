@@ -659,18 +659,29 @@ status_t OMXNodeInstance::getExtensionIndex(
 }
 
 void OMXNodeInstance::onMessage(const omx_message &msg) {
-    if (msg.type == omx_message::FILL_BUFFER_DONE) {
-        OMX_BUFFERHEADERTYPE *buffer =
-            static_cast<OMX_BUFFERHEADERTYPE *>(
-                    msg.u.extended_buffer_data.buffer);
+    List<omx_message> messages;
+    messages.push_back(msg);
+    onMessages(messages);
+}
+
+void OMXNodeInstance::onMessages(const List<omx_message> &messages) {
+    for (List<omx_message>::const_iterator it = messages.begin();
+            it != messages.end(); ++it) {
+        const omx_message &msg = *it;
 
-        BufferMeta *buffer_meta =
-            static_cast<BufferMeta *>(buffer->pAppPrivate);
+        if (msg.type == omx_message::FILL_BUFFER_DONE) {
+            OMX_BUFFERHEADERTYPE *buffer =
+                static_cast<OMX_BUFFERHEADERTYPE *>(
+                        msg.u.extended_buffer_data.buffer);
 
-        buffer_meta->CopyFromOMX(buffer);
+            BufferMeta *buffer_meta =
+                static_cast<BufferMeta *>(buffer->pAppPrivate);
+
+            buffer_meta->CopyFromOMX(buffer);
+        }
     }
 
-    mObserver->onMessage(msg);
+    mObserver->onMessages(messages);
 }
 
 void OMXNodeInstance::onObserverDied(OMXMaster *master) {
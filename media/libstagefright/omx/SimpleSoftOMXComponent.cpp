@@ -26,6 +26,14 @@
 
 namespace android {
 
+// The vendor indices of the components derived from this class start at
+// OMX_IndexVendorStartUnused + 1, this one is shared by all of them.
+static const char *kBatchOutputBuffersExtension =
+    "OMX.google.android.index.batchOutputBuffers";
+
+static const OMX_INDEXTYPE kIndexParamBatchOutputBuffers =
+    (OMX_INDEXTYPE)OMX_IndexVendorStartUnused;
+
 SimpleSoftOMXComponent::SimpleSoftOMXComponent(
         const char *name,
         const OMX_CALLBACKTYPE *callbacks,
@@ -35,7 +43,8 @@ SimpleSoftOMXComponent::SimpleSoftOMXComponent(
       mLooper(new ALooper),
       mHandler(new AHandlerReflector<SimpleSoftOMXComponent>(this)),
       mState(OMX_StateLoaded),
-      mTargetState(OMX_StateLoaded) {
+      mTargetState(OMX_StateLoaded),
+      mBatchOutput(false) {
     mLooper->setName(name);
     mLooper->registerHandler(mHandler);
 
@@ -139,6 +148,19 @@ OMX_ERRORTYPE SimpleSoftOMXComponent::internalGetParameter(
             return OMX_ErrorNone;
         }
 
+        case kIndexParamBatchOutputBuffers:
+        {
+            OMX_PARAM_U32TYPE *batchParams = (OMX_PARAM_U32TYPE *)params;
+
+            if (batchParams->nSize != sizeof(OMX_PARAM_U32TYPE)) {
+                return OMX_ErrorUndefined;
+            }
+
+            batchParams->nU32 = mBatchOutput;
+
+            return OMX_ErrorNone;
+        }
+
         default:
             return OMX_ErrorUnsupportedIndex;
     }
@@ -177,11 +199,45 @@ OMX_ERRORTYPE SimpleSoftOMXComponent::internalSetParameter(
             return OMX_ErrorNone;
         }
 
+        case kIndexParamBatchOutputBuffers:
+        {
+            const OMX_PARAM_U32TYPE *batchParams =
+                (const OMX_PARAM_U32TYPE *)params;
+
+            if (batchParams->nSize != sizeof(OMX_PARAM_U32TYPE)) {
+                return OMX_ErrorUndefined;
+            }
+
+            mBatchOutput = batchParams->nU32 != 0;
+
+            return OMX_ErrorNone;
+        }
+
         default:
             return OMX_ErrorUnsupportedIndex;
     }
 }
 
+OMX_ERRORTYPE SimpleSoftOMXComponent::getExtensionIndex(
+        const char *name, OMX_INDEXTYPE *index) {
+    if (!strcmp(name, kBatchOutputBuffersExtension)) {
+        *index = kIndexParamBatchOutputBuffers;
+        return OMX_ErrorNone;
+    }
+
+    return SoftOMXComponent::getExtensionIndex(name, index);
+}
+
+bool SimpleSoftOMXComponent::keepOutputBuffer(
+        const OMX_BUFFERHEADERTYPE *header, size_t frameSize) const {
+    if (!mBatchOutput) {
+        return false;
+    }
+
+    size_t used = header->nOffset + header->nFilledLen;
+    return used <= header->nAllocLen && header->nAllocLen - used >= frameSize;
+}
+
 OMX_ERRORTYPE SimpleSoftOMXComponent::useBuffer(
         OMX_BUFFERHEADERTYPE **header,
         OMX_U32 portIndex,
@@ -527,6 +583,24 @@ void SimpleSoftOMXComponent::onPortFlush(
 
     port->mQueue.clear();
 
+    if (mBatchOutput && port->mDef.eDir == OMX_DirInput) {
+        // Frames batched into the output buffers we still hold were decoded
+        // from the input that was just flushed, start those over.
+        for (size_t i = 0; i < mPorts.size(); ++i) {
+            PortInfo *outPort = &mPorts.editItemAt(i);
+            if (outPort->mDef.eDir != OMX_DirOutput) {
+                continue;
+            }
+
+            for (List<BufferInfo *>::iterator it = outPort->mQueue.begin();
+                    it != outPort->mQueue.end(); ++it) {
+                (*it)->mHeader->nFilledLen = 0;
+                (*it)->mHeader->nOffset = 0;
+                (*it)->mHeader->nFlags = 0;
+            }
+        }
+    }
+
     if (sendFlushComplete) {
         notify(OMX_EventCmdComplete, OMX_CommandFlush, portIndex, NULL);
 
@@ -44,6 +44,8 @@ static const struct {
     { "OMX.google.h264.encoder", "h264enc", "video_encoder.avc" },
     { "OMX.google.g711.alaw.decoder", "g711dec", "audio_decoder.g711alaw" },
     { "OMX.google.g711.mlaw.decoder", "g711dec", "audio_decoder.g711mlaw" },
+    { "OMX.google.g711.alaw.encoder", "g711enc", "audio_encoder.g711alaw" },
+    { "OMX.google.g711.mlaw.encoder", "g711enc", "audio_encoder.g711mlaw" },
     { "OMX.google.h263.decoder", "mpeg4dec", "video_decoder.h263" },
     { "OMX.google.h263.encoder", "mpeg4enc", "video_encoder.h263" },
     { "OMX.google.mpeg4.decoder", "mpeg4dec", "video_decoder.mpeg4" },
@@ -58,9 +60,94 @@ static const struct {
 static const size_t kNumComponents =
     sizeof(kComponents) / sizeof(kComponents[0]);
 
+static const size_t kMaxNumCachedLibraries = 4;
+
 SoftOMXPlugin::SoftOMXPlugin() {
 }
 
+SoftOMXPlugin::~SoftOMXPlugin() {
+    for (size_t i = 0; i < mCachedLibraries.size(); ++i) {
+        dlclose(mCachedLibraries[i].mHandle);
+    }
+    mCachedLibraries.clear();
+}
+
+void *SoftOMXPlugin::acquireLibrary_l(
+        const AString &libName, CreateSoftOMXComponentFunc *createFunc) {
+    CachedLibrary library;
+
+    ssize_t index = -1;
+    for (size_t i = 0; i < mCachedLibraries.size(); ++i) {
+        if (mCachedLibraries[i].mName == libName) {
+            index = i;
+            break;
+        }
+    }
+
+    if (index >= 0) {
+        library = mCachedLibraries[index];
+        mCachedLibraries.removeAt(index);
+    } else {
+        library.mName = libName;
+        library.mHandle = dlopen(libName.c_str(), RTLD_NOW);
+
+        if (library.mHandle == NULL) {
+            ALOGE("unable to dlopen %s", libName.c_str());
+            return NULL;
+        }
+
+        library.mCreateFunc =
+            (CreateSoftOMXComponentFunc)dlsym(
+                    library.mHandle,
+                    "_Z22createSoftOMXComponentPKcPK16OMX_CALLBACKTYPE"
+                    "PvPP17OMX_COMPONENTTYPE");
+
+        if (library.mCreateFunc == NULL) {
+            dlclose(library.mHandle);
+            return NULL;
+        }
+
+        library.mRefCount = 0;
+    }
+
+    ++library.mRefCount;
+    mCachedLibraries.push(library);
+    trimLibraries_l();
+
+    *createFunc = library.mCreateFunc;
+    return library.mHandle;
+}
+
+void SoftOMXPlugin::releaseLibrary_l(void *libHandle) {
+    for (size_t i = 0; i < mCachedLibraries.size(); ++i) {
+        if (mCachedLibraries[i].mHandle == libHandle) {
+            CHECK_GT(mCachedLibraries[i].mRefCount, 0u);
+            --mCachedLibraries.editItemAt(i).mRefCount;
+
+            trimLibraries_l();
+            return;
+        }
+    }
+
+    TRESPASS();
+}
+
+void SoftOMXPlugin::trimLibraries_l() {
+    size_t i = 0;
+    while (mCachedLibraries.size() > kMaxNumCachedLibraries
+            && i < mCachedLibraries.size()) {
+        if (mCachedLibraries[i].mRefCount > 0) {
+            ++i;
+            continue;
+        }
+
+        ALOGV("unloading %s", mCachedLibraries[i].mName.c_str());
+
+        dlclose(mCachedLibraries[i].mHandle);
+        mCachedLibraries.removeAt(i);
+    }
+}
+
 OMX_ERRORTYPE SoftOMXPlugin::makeComponentInstance(
         const char *name,
         const OMX_CALLBACKTYPE *callbacks,
@@ -77,28 +164,12 @@ OMX_ERRORTYPE SoftOMXPlugin::makeComponentInstance(
         libName.append(kComponents[i].mLibNameSuffix);
         libName.append(".so");
 
-        void *libHandle = dlopen(libName.c_str(), RTLD_NOW);
-
-        if (libHandle == NULL) {
-            ALOGE("unable to dlopen %s", libName.c_str());
-
-            return OMX_ErrorComponentNotFound;
-        }
-
-        typedef SoftOMXComponent *(*CreateSoftOMXComponentFunc)(
-                const char *, const OMX_CALLBACKTYPE *,
-                OMX_PTR, OMX_COMPONENTTYPE **);
+        Mutex::Autolock autoLock(mLock);
 
-        CreateSoftOMXComponentFunc createSoftOMXComponent =
-            (CreateSoftOMXComponentFunc)dlsym(
-                    libHandle,
-                    "_Z22createSoftOMXComponentPKcPK16OMX_CALLBACKTYPE"
-                    "PvPP17OMX_COMPONENTTYPE");
-
-        if (createSoftOMXComponent == NULL) {
-            dlclose(libHandle);
-            libHandle = NULL;
+        CreateSoftOMXComponentFunc createSoftOMXComponent;
+        void *libHandle = acquireLibrary_l(libName, &createSoftOMXComponent);
 
+        if (libHandle == NULL) {
             return OMX_ErrorComponentNotFound;
         }
 
@@ -106,7 +177,7 @@ OMX_ERRORTYPE SoftOMXPlugin::makeComponentInstance(
             (*createSoftOMXComponent)(name, callbacks, appData, component);
 
         if (codec == NULL) {
-            dlclose(libHandle);
+            releaseLibrary_l(libHandle);
             libHandle = NULL;
 
             return OMX_ErrorInsufficientResources;
@@ -114,7 +185,8 @@ OMX_ERRORTYPE SoftOMXPlugin::makeComponentInstance(
 
         OMX_ERRORTYPE err = codec->initCheck();
         if (err != OMX_ErrorNone) {
-            dlclose(libHandle);
+            codec.clear();
+            releaseLibrary_l(libHandle);
             libHandle = NULL;
 
             return err;
@@ -143,7 +215,8 @@ OMX_ERRORTYPE SoftOMXPlugin::destroyComponentInstance(
     me->decStrong(this);
     me = NULL;
 
-    dlclose(libHandle);
+    Mutex::Autolock autoLock(mLock);
+    releaseLibrary_l(libHandle);
     libHandle = NULL;
 
     return OMX_ErrorNone;
@@ -19,12 +19,18 @@
 #define SOFT_OMX_PLUGIN_H_
 
 #include <media/stagefright/foundation/ABase.h>
+#include <media/stagefright/foundation/AString.h>
+#include <utils/threads.h>
+#include <utils/Vector.h>
 #include <OMXPluginBase.h>
 
 namespace android {
 
+struct SoftOMXComponent;
+
 struct SoftOMXPlugin : public OMXPluginBase {
     SoftOMXPlugin();
+    virtual ~SoftOMXPlugin();
 
     virtual OMX_ERRORTYPE makeComponentInstance(
             const char *name,
@@ -45,6 +51,31 @@ struct SoftOMXPlugin : public OMXPluginBase {
             Vector<String8> *roles);
 
 private:
+    typedef SoftOMXComponent *(*CreateSoftOMXComponentFunc)(
+            const char *, const OMX_CALLBACKTYPE *,
+            OMX_PTR, OMX_COMPONENTTYPE **);
+
+    struct CachedLibrary {
+        AString mName;
+        void *mHandle;
+        CreateSoftOMXComponentFunc mCreateFunc;
+
+        // Number of live components instantiated from this library.
+        size_t mRefCount;
+    };
+
+    // The codec libraries loaded by this plugin, least recently used first.
+    // Each library is dlopen'ed once and stays loaded as long as one of its
+    // components is alive, the most recently used idle ones are kept on top
+    // of that so that the next component, as in a playlist, is cheap.
+    Mutex mLock;
+    Vector<CachedLibrary> mCachedLibraries;
+
+    void *acquireLibrary_l(
+            const AString &libName, CreateSoftOMXComponentFunc *createFunc);
+    void releaseLibrary_l(void *libHandle);
+    void trimLibraries_l();
+
     DISALLOW_EVIL_CONSTRUCTORS(SoftOMXPlugin);
 };
 
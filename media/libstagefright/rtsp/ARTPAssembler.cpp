@@ -16,6 +16,8 @@
 
 #include "ARTPAssembler.h"
 
+#include "ARTPSource.h"
+
 #include <media/stagefright/foundation/ABuffer.h>
 #include <media/stagefright/foundation/ADebug.h>
 #include <media/stagefright/foundation/AMessage.h>
@@ -42,10 +44,12 @@ void ARTPAssembler::onPacketReceived(const sp<ARTPSource> &source) {
 
         if (status == WRONG_SEQUENCE_NUMBER) {
             if (mFirstFailureTimeUs >= 0) {
-                if (getNowUs() - mFirstFailureTimeUs > 10000ll) {
+                if (getNowUs() - mFirstFailureTimeUs
+                        > source->getTargetDelayUs()) {
                     mFirstFailureTimeUs = -1;
 
                     // LOG(VERBOSE) << "waited too long for packet.";
+                    source->notePacketLost();
                     packetLost();
                     continue;
                 }
@@ -30,12 +30,20 @@
 #include <media/stagefright/foundation/hexdump.h>
 
 #include <arpa/inet.h>
+#include <poll.h>
 #include <sys/socket.h>
+#include <sys/syscall.h>
+#include <unistd.h>
 
 namespace android {
 
 static const size_t kMaxUDPSize = 1500;
 
+// At most this many datagrams are read from a socket per wakeup, each
+// into a buffer large enough for any datagram.
+static const size_t kMaxDatagramsPerReceive = 8;
+static const size_t kMaxDatagramSize = 65536;
+
 static uint16_t u16at(const uint8_t *data) {
     return data[0] << 8 | data[1];
 }
@@ -49,7 +57,7 @@ static uint64_t u64at(const uint8_t *data) {
 }
 
 // static
-const int64_t ARTPConnection::kSelectTimeoutUs = 1000ll;
+const int64_t ARTPConnection::kPollTimeoutUs = 1000ll;
 
 struct ARTPConnection::StreamInfo {
     int mRTPSocket;
@@ -69,7 +77,9 @@ struct ARTPConnection::StreamInfo {
 ARTPConnection::ARTPConnection(uint32_t flags)
     : mFlags(flags),
       mPollEventPending(false),
-      mLastReceiverReportTimeUs(-1) {
+      mLastReceiverReportTimeUs(-1),
+      mNumWakeups(0),
+      mNumDatagramsReceived(0) {
 }
 
 ARTPConnection::~ARTPConnection() {
@@ -244,38 +254,34 @@ void ARTPConnection::onPollStreams() {
         return;
     }
 
-    struct timeval tv;
-    tv.tv_sec = 0;
-    tv.tv_usec = kSelectTimeoutUs;
-
-    fd_set rs;
-    FD_ZERO(&rs);
-
-    int maxSocket = -1;
+    Vector<struct pollfd> fds;
     for (List<StreamInfo>::iterator it = mStreams.begin();
          it != mStreams.end(); ++it) {
         if ((*it).mIsInjected) {
             continue;
         }
 
-        FD_SET(it->mRTPSocket, &rs);
-        FD_SET(it->mRTCPSocket, &rs);
+        struct pollfd fd;
+        fd.events = POLLIN;
+        fd.revents = 0;
 
-        if (it->mRTPSocket > maxSocket) {
-            maxSocket = it->mRTPSocket;
-        }
-        if (it->mRTCPSocket > maxSocket) {
-            maxSocket = it->mRTCPSocket;
-        }
+        fd.fd = it->mRTPSocket;
+        fds.push(fd);
+
+        fd.fd = it->mRTCPSocket;
+        fds.push(fd);
     }
 
-    if (maxSocket == -1) {
+    if (fds.isEmpty()) {
         return;
     }
 
-    int res = select(maxSocket + 1, &rs, NULL, NULL, &tv);
+    int res = poll(fds.editArray(), fds.size(), kPollTimeoutUs / 1000ll);
 
     if (res > 0) {
+        // The pollfds are in the same order as the streams that are
+        // not injected, two per stream.
+        size_t i = 0;
         List<StreamInfo>::iterator it = mStreams.begin();
         while (it != mStreams.end()) {
             if ((*it).mIsInjected) {
@@ -283,11 +289,14 @@ void ARTPConnection::onPollStreams() {
                 continue;
             }
 
+            int rtpEvents = fds[i++].revents;
+            int rtcpEvents = fds[i++].revents;
+
             status_t err = OK;
-            if (FD_ISSET(it->mRTPSocket, &rs)) {
+            if (rtpEvents & (POLLIN | POLLERR | POLLHUP)) {
                 err = receive(&*it, true);
             }
-            if (err == OK && FD_ISSET(it->mRTCPSocket, &rs)) {
+            if (err == OK && (rtcpEvents & (POLLIN | POLLERR | POLLHUP))) {
                 err = receive(&*it, false);
             }
 
@@ -301,6 +310,8 @@ void ARTPConnection::onPollStreams() {
 
             ++it;
         }
+
+        ++mNumWakeups;
     }
 
     int64_t nowUs = ALooper::GetNowUs();
@@ -357,6 +368,9 @@ void ARTPConnection::onPollStreams() {
                 CHECK_EQ(n, (ssize_t)buffer->size());
 
                 mLastReceiverReportTimeUs = nowUs;
+
+                ALOGV("%lld datagrams received in %lld wakeups",
+                      mNumDatagramsReceived, mNumWakeups);
             }
 
             ++it;
@@ -368,41 +382,133 @@ void ARTPConnection::onPollStreams() {
     }
 }
 
+#ifdef __NR_recvmmsg
+// Same layout as the kernel's struct mmsghdr, which the C library does
+// not declare.
+struct MMsgHdr {
+    struct msghdr mHdr;
+    unsigned mLen;
+};
+#endif
+
+// Reads as many datagrams as are queued on "sock", up to one per buffer,
+// without blocking. The sender's address of the first one is stored in
+// "firstAddr" if it is not NULL. Returns the number of datagrams read and
+// their sizes in "sizes", or a negative errno.
+static ssize_t ReceiveDatagrams(
+        int sock, const Vector<sp<ABuffer> > &buffers, size_t *sizes,
+        struct sockaddr_in *firstAddr) {
+#ifdef __NR_recvmmsg
+    struct iovec iov[kMaxDatagramsPerReceive];
+    MMsgHdr msgs[kMaxDatagramsPerReceive];
+    CHECK_LE(buffers.size(), kMaxDatagramsPerReceive);
+
+    memset(msgs, 0, sizeof(msgs));
+    for (size_t i = 0; i < buffers.size(); ++i) {
+        iov[i].iov_base = buffers[i]->data();
+        iov[i].iov_len = buffers[i]->capacity();
+
+        msgs[i].mHdr.msg_iov = &iov[i];
+        msgs[i].mHdr.msg_iovlen = 1;
+    }
+
+    if (firstAddr != NULL) {
+        msgs[0].mHdr.msg_name = firstAddr;
+        msgs[0].mHdr.msg_namelen = sizeof(*firstAddr);
+    }
+
+    int n;
+    do {
+        n = syscall(
+                __NR_recvmmsg, sock, msgs, buffers.size(), MSG_DONTWAIT,
+                NULL /* timeout */);
+    } while (n < 0 && errno == EINTR);
+
+    if (n >= 0) {
+        for (int i = 0; i < n; ++i) {
+            sizes[i] = msgs[i].mLen;
+        }
+        return n;
+    }
+
+    if (errno != ENOSYS) {
+        return (errno == EAGAIN || errno == EWOULDBLOCK) ? 0 : -errno;
+    }
+#endif
+
+    // One recvfrom per datagram until the socket is drained.
+    size_t numDatagrams = 0;
+    while (numDatagrams < buffers.size()) {
+        socklen_t remoteAddrLen =
+            (numDatagrams == 0 && firstAddr != NULL) ? sizeof(*firstAddr) : 0;
+
+        ssize_t nbytes;
+        do {
+            nbytes = recvfrom(
+                sock,
+                buffers[numDatagrams]->data(),
+                buffers[numDatagrams]->capacity(),
+                MSG_DONTWAIT,
+                remoteAddrLen > 0 ? (struct sockaddr *)firstAddr : NULL,
+                remoteAddrLen > 0 ? &remoteAddrLen : NULL);
+        } while (nbytes < 0 && errno == EINTR);
+
+        if (nbytes < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                break;
+            }
+            return numDatagrams > 0 ? numDatagrams : -errno;
+        }
+
+        sizes[numDatagrams++] = nbytes;
+    }
+
+    return numDatagrams;
+}
+
 status_t ARTPConnection::receive(StreamInfo *s, bool receiveRTP) {
     ALOGV("receiving %s", receiveRTP ? "RTP" : "RTCP");
 
     CHECK(!s->mIsInjected);
 
-    sp<ABuffer> buffer = new ABuffer(65536);
+    if (mReceiveBuffers.isEmpty()) {
+        for (size_t i = 0; i < kMaxDatagramsPerReceive; ++i) {
+            mReceiveBuffers.push(new ABuffer(kMaxDatagramSize));
+        }
+    }
 
-    socklen_t remoteAddrLen =
-        (!receiveRTP && s->mNumRTCPPacketsReceived == 0)
-            ? sizeof(s->mRemoteRTCPAddr) : 0;
+    bool needRemoteAddr = !receiveRTP && s->mNumRTCPPacketsReceived == 0;
 
-    ssize_t nbytes;
-    do {
-        nbytes = recvfrom(
+    size_t sizes[kMaxDatagramsPerReceive];
+    ssize_t numDatagrams = ReceiveDatagrams(
             receiveRTP ? s->mRTPSocket : s->mRTCPSocket,
-            buffer->data(),
-            buffer->capacity(),
-            0,
-            remoteAddrLen > 0 ? (struct sockaddr *)&s->mRemoteRTCPAddr : NULL,
-            remoteAddrLen > 0 ? &remoteAddrLen : NULL);
-    } while (nbytes < 0 && errno == EINTR);
-
-    if (nbytes <= 0) {
+            mReceiveBuffers, sizes,
+            needRemoteAddr ? &s->mRemoteRTCPAddr : NULL);
+
+    if (numDatagrams < 0) {
         return -ECONNRESET;
     }
 
-    buffer->setRange(0, nbytes);
+    mNumDatagramsReceived += numDatagrams;
 
-    // ALOGI("received %d bytes.", buffer->size());
+    status_t err = OK;
+    for (ssize_t i = 0; i < numDatagrams; ++i) {
+        if (sizes[i] == 0) {
+            return -ECONNRESET;
+        }
 
-    status_t err;
-    if (receiveRTP) {
-        err = parseRTP(s, buffer);
-    } else {
-        err = parseRTCP(s, buffer);
+        // The sources hold on to packets for a while, give them a buffer
+        // of the datagram's size rather than one of the receive buffers.
+        sp<ABuffer> buffer = new ABuffer(sizes[i]);
+        memcpy(buffer->data(), mReceiveBuffers[i]->data(), sizes[i]);
+
+        // ALOGI("received %d bytes.", buffer->size());
+
+        if (receiveRTP) {
+            err = parseRTP(s, buffer);
+        } else {
+            err = parseRTCP(s, buffer);
+        }
     }
 
     return err;
@@ -643,13 +749,19 @@ void ARTPConnection::injectPacket(int index, const sp<ABuffer> &buffer) {
     msg->post();
 }
 
-void ARTPConnection::onInjectPacket(const sp<AMessage> &msg) {
-    int32_t index;
-    CHECK(msg->findInt32("index", &index));
+sp<AMessage> ARTPConnection::newInjectPacketMessage() {
+    return new AMessage(kWhatInjectPacket, id());
+}
 
+void ARTPConnection::onInjectPacket(const sp<AMessage> &msg) {
     sp<ABuffer> buffer;
     CHECK(msg->findBuffer("buffer", &buffer));
 
+    int32_t index;
+    if (!msg->findInt32("index", &index)) {
+        CHECK(buffer->meta()->findInt32("index", &index));
+    }
+
     List<StreamInfo>::iterator it = mStreams.begin();
     while (it != mStreams.end()
            && it->mRTPSocket != index && it->mRTCPSocket != index) {
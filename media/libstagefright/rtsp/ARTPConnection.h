@@ -20,6 +20,7 @@
 
 #include <media/stagefright/foundation/AHandler.h>
 #include <utils/List.h>
+#include <utils/Vector.h>
 
 namespace android {
 
@@ -44,6 +45,12 @@ struct ARTPConnection : public AHandler {
 
     void injectPacket(int index, const sp<ABuffer> &buffer);
 
+    // Returns a message that injects the packet set as its "buffer" when
+    // posted, as injectPacket() does. The stream index is taken from the
+    // buffer's "index" meta data. Lets the RTSP connection deliver
+    // interleaved packets without going through another handler.
+    sp<AMessage> newInjectPacketMessage();
+
     // Creates a pair of UDP datagram sockets bound to adjacent ports
     // (the rtpSocket is bound to an even port, the rtcpSocket to the
     // next higher port).
@@ -62,7 +69,7 @@ private:
         kWhatInjectPacket,
     };
 
-    static const int64_t kSelectTimeoutUs;
+    static const int64_t kPollTimeoutUs;
 
     uint32_t mFlags;
 
@@ -72,6 +79,14 @@ private:
     bool mPollEventPending;
     int64_t mLastReceiverReportTimeUs;
 
+    // Datagrams are received in batches into these, then copied out into
+    // buffers of their actual size.
+    Vector<sp<ABuffer> > mReceiveBuffers;
+
+    // Wakeups with data to read and the datagrams read in them.
+    int64_t mNumWakeups;
+    int64_t mNumDatagramsReceived;
+
     void onAddStream(const sp<AMessage> &msg);
     void onRemoveStream(const sp<AMessage> &msg);
     void onPollStreams();
@@ -36,6 +36,11 @@ namespace android {
 
 static const uint32_t kSourceID = 0xdeadbeef;
 
+// Bounds of the time waited for a missing packet, the lower one is what
+// used to be the fixed timeout.
+static const int64_t kMinTargetDelayUs = 10000ll;
+static const int64_t kMaxTargetDelayUs = 500000ll;
+
 ARTPSource::ARTPSource(
         uint32_t id,
         const sp<ASessionDescription> &sessionDesc, size_t index,
@@ -43,6 +48,14 @@ ARTPSource::ARTPSource(
     : mID(id),
       mHighestSeqNumber(0),
       mNumBuffersReceived(0),
+      mBaseSeqNumber(0),
+      mExpectedPrior(0),
+      mReceivedPrior(0),
+      mNumPacketsLost(0),
+      mClockRate(0),
+      mLastTransitValid(false),
+      mLastTransit(0),
+      mJitter(0.0),
       mLastNTPTime(0),
       mLastNTPTimeUpdateUs(0),
       mIssueFIRRequests(false),
@@ -54,6 +67,13 @@ ARTPSource::ARTPSource(
     AString params;
     sessionDesc->getFormatType(index, &PT, &desc, &params);
 
+    int32_t numChannels;
+    ASessionDescription::ParseFormatDesc(
+            desc.c_str(), &mClockRate, &numChannels);
+    if (mClockRate <= 0) {
+        mClockRate = 90000;
+    }
+
     if (!strncmp(desc.c_str(), "H264/", 5)) {
         mAssembler = new AAVCAssembler(notify);
         mIssueFIRRequests = true;
@@ -83,6 +103,8 @@ static uint32_t AbsDiff(uint32_t seq1, uint32_t seq2) {
 }
 
 void ARTPSource::processRTPPacket(const sp<ABuffer> &buffer) {
+    updateJitter(buffer);
+
     if (queuePacket(buffer) && mAssembler != NULL) {
         mAssembler->onPacketReceived(this);
     }
@@ -104,6 +126,7 @@ bool ARTPSource::queuePacket(const sp<ABuffer> &buffer) {
 
     if (mNumBuffersReceived++ == 0) {
         mHighestSeqNumber = seqNum;
+        mBaseSeqNumber = seqNum;
         mQueue.push_back(buffer);
         return true;
     }
@@ -141,14 +164,25 @@ bool ARTPSource::queuePacket(const sp<ABuffer> &buffer) {
 
     buffer->setInt32Data(seqNum);
 
-    List<sp<ABuffer> >::iterator it = mQueue.begin();
-    while (it != mQueue.end() && (uint32_t)(*it)->int32Data() < seqNum) {
-        ++it;
-    }
+    // Packets mostly arrive in order, so look for the insertion point
+    // starting from the back of the queue.
+    List<sp<ABuffer> >::iterator it = mQueue.end();
+    while (it != mQueue.begin()) {
+        List<sp<ABuffer> >::iterator prev = it;
+        --prev;
+
+        uint32_t prevSeqNum = (uint32_t)(*prev)->int32Data();
+        if (prevSeqNum < seqNum) {
+            break;
+        }
+
+        if (prevSeqNum == seqNum) {
+            ALOGW("Discarding duplicate buffer");
+            --mNumBuffersReceived;
+            return false;
+        }
 
-    if (it != mQueue.end() && (uint32_t)(*it)->int32Data() == seqNum) {
-        ALOGW("Discarding duplicate buffer");
-        return false;
+        it = prev;
     }
 
     mQueue.insert(it, buffer);
@@ -156,6 +190,47 @@ bool ARTPSource::queuePacket(const sp<ABuffer> &buffer) {
     return true;
 }
 
+void ARTPSource::updateJitter(const sp<ABuffer> &buffer) {
+    uint32_t rtpTime;
+    CHECK(buffer->meta()->findInt32("rtp-time", (int32_t *)&rtpTime));
+
+    // Arrival time in RTP timestamp units. Only differences matter, so
+    // it may wrap around, but the multiplication must not overflow.
+    int64_t nowUs = ALooper::GetNowUs();
+    uint32_t arrival = (uint32_t)((nowUs / 1000000ll) * mClockRate
+            + ((nowUs % 1000000ll) * mClockRate) / 1000000ll);
+
+    int32_t transit = (int32_t)(arrival - rtpTime);
+
+    if (mLastTransitValid) {
+        int32_t d = transit - mLastTransit;
+        if (d < 0) {
+            d = -d;
+        }
+
+        mJitter += (d - mJitter) / 16.0;
+    }
+
+    mLastTransit = transit;
+    mLastTransitValid = true;
+}
+
+int64_t ARTPSource::getJitterUs() const {
+    return (int64_t)(mJitter * 1E6 / mClockRate);
+}
+
+int64_t ARTPSource::getTargetDelayUs() const {
+    int64_t delayUs = 4 * getJitterUs();
+
+    if (delayUs < kMinTargetDelayUs) {
+        delayUs = kMinTargetDelayUs;
+    } else if (delayUs > kMaxTargetDelayUs) {
+        delayUs = kMaxTargetDelayUs;
+    }
+
+    return delayUs;
+}
+
 void ARTPSource::byeReceived() {
     mAssembler->onByeReceived();
 }
@@ -232,21 +307,54 @@ void ARTPSource::addReceiverReport(const sp<ABuffer> &buffer) {
     data[10] = (mID >> 8) & 0xff;
     data[11] = mID & 0xff;
 
-    data[12] = 0x00;  // fraction lost
+    // Loss statistics as computed in RFC 3550, appendix A.3.
+    uint32_t expected = 0;
+    int32_t lost = 0;
+    uint8_t fraction = 0;
+    if (mNumBuffersReceived > 0) {
+        expected = mHighestSeqNumber - mBaseSeqNumber + 1;
+        lost = (int32_t)(expected - mNumBuffersReceived);
+
+        if (lost > 0x7fffff) {
+            lost = 0x7fffff;
+        } else if (lost < -0x800000) {
+            lost = -0x800000;
+        }
+
+        uint32_t expectedInterval = expected - mExpectedPrior;
+        int32_t receivedInterval = mNumBuffersReceived - mReceivedPrior;
+        int32_t lostInterval = (int32_t)expectedInterval - receivedInterval;
+
+        if (expectedInterval > 0 && lostInterval > 0) {
+            fraction = (lostInterval << 8) / expectedInterval;
+        }
+
+        mExpectedPrior = expected;
+        mReceivedPrior = mNumBuffersReceived;
+    }
+
+    uint32_t jitter = (uint32_t)mJitter;
+
+    ALOGV("RR: lost %d, jitter %lld us, target delay %lld us, "
+          "queued %d, given up on %u",
+          lost, getJitterUs(), getTargetDelayUs(),
+          mQueue.size(), mNumPacketsLost);
+
+    data[12] = fraction;  // fraction lost
 
-    data[13] = 0x00;  // cumulative lost
-    data[14] = 0x00;
-    data[15] = 0x00;
+    data[13] = (lost >> 16) & 0xff;  // cumulative lost
+    data[14] = (lost >> 8) & 0xff;
+    data[15] = lost & 0xff;
 
     data[16] = mHighestSeqNumber >> 24;
     data[17] = (mHighestSeqNumber >> 16) & 0xff;
     data[18] = (mHighestSeqNumber >> 8) & 0xff;
     data[19] = mHighestSeqNumber & 0xff;
 
-    data[20] = 0x00;  // Interarrival jitter
-    data[21] = 0x00;
-    data[22] = 0x00;
-    data[23] = 0x00;
+    data[20] = jitter >> 24;  // Interarrival jitter
+    data[21] = (jitter >> 16) & 0xff;
+    data[22] = (jitter >> 8) & 0xff;
+    data[23] = jitter & 0xff;
 
     uint32_t LSR = 0;
     uint32_t DLSR = 0;
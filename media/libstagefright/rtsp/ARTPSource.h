@@ -46,11 +46,34 @@ struct ARTPSource : public RefBase {
     void addReceiverReport(const sp<ABuffer> &buffer);
     void addFIR(const sp<ABuffer> &buffer);
 
+    // Interarrival jitter as defined by RFC 3550.
+    int64_t getJitterUs() const;
+
+    // How long the assembler waits for a missing packet before it gives
+    // up on it, follows the measured jitter.
+    int64_t getTargetDelayUs() const;
+
+    size_t getQueueDepth() const { return mQueue.size(); }
+
+    // Packets the assembler gave up waiting for.
+    uint32_t getNumPacketsLost() const { return mNumPacketsLost; }
+    void notePacketLost() { ++mNumPacketsLost; }
+
 private:
     uint32_t mID;
     uint32_t mHighestSeqNumber;
     int32_t mNumBuffersReceived;
 
+    uint32_t mBaseSeqNumber;
+    uint32_t mExpectedPrior;
+    int32_t mReceivedPrior;
+    uint32_t mNumPacketsLost;
+
+    int32_t mClockRate;
+    bool mLastTransitValid;
+    int32_t mLastTransit;
+    double mJitter;  // in RTP timestamp units
+
     List<sp<ABuffer> > mQueue;
     sp<ARTPAssembler> mAssembler;
 
@@ -64,6 +87,7 @@ private:
     sp<AMessage> mNotify;
 
     bool queuePacket(const sp<ABuffer> &buffer);
+    void updateJitter(const sp<ABuffer> &buffer);
 
     DISALLOW_EVIL_CONSTRUCTORS(ARTPSource);
 };
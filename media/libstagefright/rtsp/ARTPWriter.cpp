@@ -20,7 +20,11 @@
 
 #include "ARTPWriter.h"
 
+#include <errno.h>
 #include <fcntl.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
 
 #include <media/stagefright/foundation/ABuffer.h>
 #include <media/stagefright/foundation/ADebug.h>
@@ -40,6 +44,26 @@ namespace android {
 // static const size_t kMaxPacketSize = 65507;  // maximum payload in UDP over IP
 static const size_t kMaxPacketSize = 1500;
 
+// The token bucket holds at most this much, which bounds the size of the
+// bursts sent after an idle period.
+static const size_t kMaxBurstBytes = 8 * kMaxPacketSize;
+
+// Packets handed to the socket in a single sendmmsg call.
+static const size_t kMaxBatchPackets = 8;
+
+// The pacing rate never drops below 128kbit/sec.
+static const int64_t kMinPacingRate = 16000;
+
+static const int64_t kDefaultFrameIntervalUs = 33333ll;
+static const int64_t kMinFrameIntervalUs = 5000ll;
+static const int64_t kMaxFrameIntervalUs = 200000ll;
+
+// Kernel layout of the struct sendmmsg operates on.
+struct RTPMMsgHdr {
+    struct msghdr msg_hdr;
+    unsigned int msg_len;
+};
+
 static int UniformRand(int limit) {
     return ((double)rand() * limit) / RAND_MAX;
 }
@@ -130,6 +154,26 @@ status_t ARTPWriter::start(MetaData *params) {
     mLastNTPTime = 0;
     mNumSRsSent = 0;
 
+    mQueuedBytes = 0;
+    mSendGeneration = 0;
+    mPacingRate = kMinPacingRate;
+    mTokens = (int64_t)kMaxBurstBytes * 1000000ll;
+    mLastRefillTimeUs = ALooper::GetNowUs();
+    mFrameIntervalUs = kDefaultFrameIntervalUs;
+    mLastAccessUnitTimeUs = -1;
+#ifdef __NR_sendmmsg
+    mUseSendmmsg = true;
+#else
+    mUseSendmmsg = false;
+#endif
+
+    mNumBatchesSent = 0;
+    mNumPacketsDelayed = 0;
+    mMaxBatchPackets = 0;
+    mMaxQueuedPackets = 0;
+    mTotalPacingDelayUs = 0;
+    mMaxPacingDelayUs = 0;
+
     const char *mime;
     CHECK(mSource->getFormat()->findCString(kKeyMIMEType, &mime));
 
@@ -222,8 +266,18 @@ void ARTPWriter::onMessageReceived(const sp<AMessage> &msg) {
         {
             CHECK_EQ(mSource->stop(), (status_t)OK);
 
+            flushPacketQueue();
             sendBye();
 
+            ALOGI("sent %d RTP packets in %d batches, max batch %d packets, "
+                  "max queue %d packets, %d packets delayed by "
+                  "%lld us on average (max %lld us)",
+                  mNumRTPSent, mNumBatchesSent, mMaxBatchPackets,
+                  mMaxQueuedPackets, mNumPacketsDelayed,
+                  mNumPacketsDelayed > 0
+                    ? mTotalPacingDelayUs / mNumPacketsDelayed : 0ll,
+                  mMaxPacingDelayUs);
+
             {
                 Mutex::Autolock autoLock(mLock);
                 mFlags &= ~kFlagStarted;
@@ -258,6 +312,26 @@ void ARTPWriter::onMessageReceived(const sp<AMessage> &msg) {
             break;
         }
 
+        case kWhatSendPackets:
+        {
+            {
+                Mutex::Autolock autoLock(mLock);
+                if (!(mFlags & kFlagStarted)) {
+                    break;
+                }
+            }
+
+            int32_t generation;
+            CHECK(msg->findInt32("generation", &generation));
+
+            if (generation != mSendGeneration) {
+                break;
+            }
+
+            onSendPackets();
+            break;
+        }
+
         default:
             TRESPASS();
             break;
@@ -287,6 +361,11 @@ void ARTPWriter::onRead(const sp<AMessage> &msg) {
         } else if (mMode == AMR_NB || mMode == AMR_WB) {
             sendAMRData(mediaBuf);
         }
+
+        int64_t timeUs;
+        CHECK(mediaBuf->meta_data()->findInt64(kKeyTime, &timeUs));
+        updatePacingRate(timeUs);
+        schedulePacketSend(0);
     }
 
     mediaBuf->release();
@@ -309,6 +388,201 @@ void ARTPWriter::onSendSR(const sp<AMessage> &msg) {
 }
 
 void ARTPWriter::send(const sp<ABuffer> &buffer, bool isRTCP) {
+    if (isRTCP) {
+        sendNow(buffer, isRTCP);
+        return;
+    }
+
+    // The packetizers reuse "buffer" for the next packet.
+    sp<ABuffer> packet;
+    if (!mFreePackets.isEmpty()) {
+        packet = mFreePackets.top();
+        mFreePackets.pop();
+    } else {
+        packet = new ABuffer(kMaxPacketSize);
+    }
+
+    CHECK_LE(buffer->size(), packet->capacity());
+    memcpy(packet->data(), buffer->data(), buffer->size());
+    packet->setRange(0, buffer->size());
+
+    PacedPacket entry;
+    entry.mBuffer = packet;
+    entry.mQueueTimeUs = ALooper::GetNowUs();
+    mPacketQueue.push_back(entry);
+    mQueuedBytes += packet->size();
+
+    if (mPacketQueue.size() > mMaxQueuedPackets) {
+        mMaxQueuedPackets = mPacketQueue.size();
+    }
+}
+
+void ARTPWriter::updatePacingRate(int64_t timeUs) {
+    if (mLastAccessUnitTimeUs >= 0) {
+        int64_t intervalUs = timeUs - mLastAccessUnitTimeUs;
+        if (intervalUs >= kMinFrameIntervalUs
+                && intervalUs <= kMaxFrameIntervalUs) {
+            mFrameIntervalUs = (7 * mFrameIntervalUs + intervalUs) / 8;
+        }
+    }
+    mLastAccessUnitTimeUs = timeUs;
+
+    // Tokens earned so far are credited at the old rate.
+    refillTokens();
+
+    // Drain whatever is queued by the time the next access unit is due.
+    int64_t rate = (int64_t)mQueuedBytes * 1000000ll / mFrameIntervalUs;
+    mPacingRate = rate < kMinPacingRate ? kMinPacingRate : rate;
+}
+
+void ARTPWriter::refillTokens() {
+    int64_t nowUs = ALooper::GetNowUs();
+    mTokens += mPacingRate * (nowUs - mLastRefillTimeUs);
+    mLastRefillTimeUs = nowUs;
+
+    const int64_t maxTokens = (int64_t)kMaxBurstBytes * 1000000ll;
+    if (mTokens > maxTokens) {
+        mTokens = maxTokens;
+    }
+}
+
+void ARTPWriter::schedulePacketSend(int64_t delayUs) {
+    // Any send that is already scheduled is superseded.
+    sp<AMessage> msg = new AMessage(kWhatSendPackets, mReflector->id());
+    msg->setInt32("generation", ++mSendGeneration);
+    msg->post(delayUs);
+}
+
+void ARTPWriter::onSendPackets() {
+    refillTokens();
+
+    size_t count = 0;
+    List<PacedPacket>::iterator it = mPacketQueue.begin();
+    while (it != mPacketQueue.end() && count < kMaxBatchPackets) {
+        int64_t cost = (int64_t)(*it).mBuffer->size() * 1000000ll;
+        if (mTokens < cost) {
+            break;
+        }
+
+        mTokens -= cost;
+        ++count;
+        ++it;
+    }
+
+    if (count > 0) {
+        sendQueuedPackets(count);
+    }
+
+    if (mPacketQueue.empty()) {
+        return;
+    }
+
+    int64_t delayUs = 0;
+    if (count < kMaxBatchPackets) {
+        int64_t cost =
+            (int64_t)(*mPacketQueue.begin()).mBuffer->size() * 1000000ll;
+        delayUs = (cost - mTokens) / mPacingRate + 1;
+    }
+
+    schedulePacketSend(delayUs);
+}
+
+void ARTPWriter::sendQueuedPackets(size_t count) {
+    CHECK_LE(count, kMaxBatchPackets);
+    CHECK_LE(count, mPacketQueue.size());
+
+    struct iovec iov[kMaxBatchPackets];
+    RTPMMsgHdr msgs[kMaxBatchPackets];
+
+    const int64_t nowUs = ALooper::GetNowUs();
+
+    List<PacedPacket>::iterator it = mPacketQueue.begin();
+    for (size_t i = 0; i < count; ++i, ++it) {
+        const sp<ABuffer> &buffer = (*it).mBuffer;
+
+        iov[i].iov_base = buffer->data();
+        iov[i].iov_len = buffer->size();
+
+        memset(&msgs[i], 0, sizeof(msgs[i]));
+        msgs[i].msg_hdr.msg_name = &mRTPAddr;
+        msgs[i].msg_hdr.msg_namelen = sizeof(mRTPAddr);
+        msgs[i].msg_hdr.msg_iov = &iov[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+
+        int64_t delayUs = nowUs - (*it).mQueueTimeUs;
+        if (delayUs > 0) {
+            ++mNumPacketsDelayed;
+            mTotalPacingDelayUs += delayUs;
+            if (delayUs > mMaxPacingDelayUs) {
+                mMaxPacingDelayUs = delayUs;
+            }
+        }
+    }
+
+    size_t sent = 0;
+    while (sent < count) {
+        ssize_t n = -1;
+
+#ifdef __NR_sendmmsg
+        if (mUseSendmmsg) {
+            n = syscall(__NR_sendmmsg, mSocket, &msgs[sent], count - sent, 0);
+
+            if (n < 0 && errno == ENOSYS) {
+                ALOGI("sendmmsg is not supported, falling back to sendto.");
+                mUseSendmmsg = false;
+            }
+        }
+#endif
+
+        if (!mUseSendmmsg) {
+            n = sendto(
+                    mSocket, iov[sent].iov_base, iov[sent].iov_len, 0,
+                    (const struct sockaddr *)&mRTPAddr, sizeof(mRTPAddr));
+
+            CHECK_EQ(n, (ssize_t)iov[sent].iov_len);
+            n = 1;
+        }
+
+        CHECK_GT(n, 0);
+        sent += n;
+    }
+
+    ++mNumBatchesSent;
+    if (count > mMaxBatchPackets) {
+        mMaxBatchPackets = count;
+    }
+
+    for (size_t i = 0; i < count; ++i) {
+        const sp<ABuffer> buffer = (*mPacketQueue.begin()).mBuffer;
+
+#if LOG_TO_FILES
+        uint32_t ms = tolel(nowUs / 1000ll);
+        uint32_t length = tolel(buffer->size());
+        write(mRTPFd, &ms, sizeof(ms));
+        write(mRTPFd, &length, sizeof(length));
+        write(mRTPFd, buffer->data(), buffer->size());
+#endif
+
+        mQueuedBytes -= buffer->size();
+        mFreePackets.push(buffer);
+        mPacketQueue.erase(mPacketQueue.begin());
+    }
+}
+
+void ARTPWriter::flushPacketQueue() {
+    while (!mPacketQueue.empty()) {
+        size_t count = mPacketQueue.size();
+        if (count > kMaxBatchPackets) {
+            count = kMaxBatchPackets;
+        }
+
+        sendQueuedPackets(count);
+    }
+
+    ++mSendGeneration;
+}
+
+void ARTPWriter::sendNow(const sp<ABuffer> &buffer, bool isRTCP) {
     ssize_t n = sendto(
             mSocket, buffer->data(), buffer->size(), 0,
             (const struct sockaddr *)(isRTCP ? &mRTCPAddr : &mRTPAddr),
@@ -23,6 +23,8 @@
 #include <media/stagefright/foundation/AString.h>
 #include <media/stagefright/foundation/base64.h>
 #include <media/stagefright/MediaWriter.h>
+#include <utils/List.h>
+#include <utils/Vector.h>
 
 #include <arpa/inet.h>
 #include <sys/socket.h>
@@ -54,6 +56,7 @@ private:
         kWhatStop   = 'stop',
         kWhatRead   = 'read',
         kWhatSendSR = 'sr  ',
+        kWhatSendPackets = 'send',
     };
 
     enum {
@@ -94,6 +97,35 @@ private:
 
     int32_t mNumSRsSent;
 
+    // RTP packets are not sent as soon as an access unit is packetized
+    // but queued and paced out by a token bucket, at a rate that spreads
+    // each access unit over the frame interval.
+    struct PacedPacket {
+        sp<ABuffer> mBuffer;
+        int64_t mQueueTimeUs;
+    };
+
+    List<PacedPacket> mPacketQueue;
+    size_t mQueuedBytes;
+    Vector<sp<ABuffer> > mFreePackets;
+    int32_t mSendGeneration;
+
+    int64_t mPacingRate;  // bytes per second
+    int64_t mTokens;      // bytes times 1E6
+    int64_t mLastRefillTimeUs;
+    int64_t mFrameIntervalUs;
+    int64_t mLastAccessUnitTimeUs;
+
+    bool mUseSendmmsg;
+
+    // Pacing statistics, logged on stop().
+    uint32_t mNumBatchesSent;
+    uint32_t mNumPacketsDelayed;
+    size_t mMaxBatchPackets;
+    size_t mMaxQueuedPackets;
+    int64_t mTotalPacingDelayUs;
+    int64_t mMaxPacingDelayUs;
+
     enum {
         INVALID,
         H264,
@@ -119,6 +151,14 @@ private:
     void sendAMRData(MediaBuffer *mediaBuf);
 
     void send(const sp<ABuffer> &buffer, bool isRTCP);
+    void sendNow(const sp<ABuffer> &buffer, bool isRTCP);
+
+    void updatePacingRate(int64_t timeUs);
+    void refillTokens();
+    void schedulePacketSend(int64_t delayUs);
+    void onSendPackets();
+    void sendQueuedPackets(size_t count);
+    void flushPacketQueue();
 
     DISALLOW_EVIL_CONSTRUCTORS(ARTPWriter);
 };
@@ -41,6 +41,8 @@ namespace android {
 // static
 const int64_t ARTSPConnection::kSelectTimeoutUs = 1000ll;
 
+static const size_t kReadBufferSize = 32768;
+
 ARTSPConnection::ARTSPConnection(bool uidValid, uid_t uid)
     : mUIDValid(uidValid),
       mUID(uid),
@@ -314,6 +316,8 @@ void ARTSPConnection::performDisconnect() {
     close(mSocket);
     mSocket = -1;
 
+    mReadBuffer.clear();
+
     flushPendingRequests();
 
     mUser.clear();
@@ -486,7 +490,12 @@ void ARTSPConnection::onReceiveResponse() {
     if (res == 1) {
         MakeSocketBlocking(mSocket, true);
 
-        bool success = receiveRTSPReponse();
+        // Handle everything that has been read along with the first
+        // response or packet in one go.
+        bool success;
+        do {
+            success = receiveRTSPReponse();
+        } while (success && mReadBuffer != NULL && mReadBuffer->size() > 0);
 
         MakeSocketBlocking(mSocket, false);
 
@@ -522,10 +531,35 @@ void ARTSPConnection::postReceiveReponseEvent() {
     mReceiveResponseEventPending = true;
 }
 
-status_t ARTSPConnection::receive(void *data, size_t size) {
-    size_t offset = 0;
-    while (offset < size) {
-        ssize_t n = recv(mSocket, (uint8_t *)data + offset, size - offset, 0);
+status_t ARTSPConnection::fillReadBuffer() {
+    if (mReadBuffer == NULL) {
+        mReadBuffer = new ABuffer(kReadBufferSize);
+        mReadBuffer->setRange(0, 0);
+    } else if (mReadBuffer->offset() + mReadBuffer->size()
+            == mReadBuffer->capacity()) {
+        // No room left at the end. Data before the range may still be
+        // referred to by binary data handed out as slices, in which case
+        // the unread data moves to a new buffer instead.
+        if (mReadBuffer->getStrongCount() > 1) {
+            sp<ABuffer> buffer = new ABuffer(kReadBufferSize);
+            memcpy(buffer->data(), mReadBuffer->data(), mReadBuffer->size());
+            buffer->setRange(0, mReadBuffer->size());
+
+            mReadBuffer = buffer;
+        } else {
+            memmove(mReadBuffer->base(), mReadBuffer->data(),
+                    mReadBuffer->size());
+            mReadBuffer->setRange(0, mReadBuffer->size());
+        }
+    }
+
+    size_t end = mReadBuffer->offset() + mReadBuffer->size();
+    CHECK_LT(end, mReadBuffer->capacity());
+
+    for (;;) {
+        ssize_t n = recv(
+                mSocket, mReadBuffer->base() + end,
+                mReadBuffer->capacity() - end, 0);
 
         if (n < 0 && errno == EINTR) {
             continue;
@@ -544,7 +578,34 @@ status_t ARTSPConnection::receive(void *data, size_t size) {
             }
         }
 
-        offset += (size_t)n;
+        mReadBuffer->setRange(
+                mReadBuffer->offset(), mReadBuffer->size() + (size_t)n);
+
+        return OK;
+    }
+}
+
+status_t ARTSPConnection::receive(void *data, size_t size) {
+    size_t offset = 0;
+    while (offset < size) {
+        if (mReadBuffer == NULL || mReadBuffer->size() == 0) {
+            status_t err = fillReadBuffer();
+
+            if (err != OK) {
+                return err;
+            }
+        }
+
+        size_t copy = size - offset;
+        if (copy > mReadBuffer->size()) {
+            copy = mReadBuffer->size();
+        }
+
+        memcpy((uint8_t *)data + offset, mReadBuffer->data(), copy);
+        mReadBuffer->setRange(
+                mReadBuffer->offset() + copy, mReadBuffer->size() - copy);
+
+        offset += copy;
     }
 
     return OK;
@@ -582,9 +643,25 @@ sp<ABuffer> ARTSPConnection::receiveBinaryData() {
         return NULL;
     }
 
-    sp<ABuffer> buffer = new ABuffer((x[1] << 8) | x[2]);
-    if (receive(buffer->data(), buffer->size()) != OK) {
-        return NULL;
+    size_t size = (x[1] << 8) | x[2];
+
+    sp<ABuffer> buffer;
+    if (size <= kReadBufferSize / 2) {
+        // Cut the packet out of the read buffer without copying it.
+        while (mReadBuffer->size() < size) {
+            if (fillReadBuffer() != OK) {
+                return NULL;
+            }
+        }
+
+        buffer = mReadBuffer->slice(0, size);
+        mReadBuffer->setRange(
+                mReadBuffer->offset() + size, mReadBuffer->size() - size);
+    } else {
+        buffer = new ABuffer(size);
+        if (receive(buffer->data(), buffer->size()) != OK) {
+            return NULL;
+        }
     }
 
     buffer->meta()->setInt32("index", (int32_t)x[0]);
@@ -89,6 +89,10 @@ private:
 
     sp<AMessage> mObserveBinaryMessage;
 
+    // Data read from the socket but not parsed yet, the range of the
+    // buffer. Interleaved binary data is handed out as slices of it.
+    sp<ABuffer> mReadBuffer;
+
     AString mUserAgent;
 
     void performDisconnect();
@@ -105,6 +109,7 @@ private:
     // Return false iff something went unrecoverably wrong.
     bool receiveRTSPReponse();
     status_t receive(void *data, size_t size);
+    status_t fillReadBuffer();
     bool receiveLine(AString *line);
     sp<ABuffer> receiveBinaryData();
     bool notifyResponseListener(const sp<ARTSPResponse> &response);
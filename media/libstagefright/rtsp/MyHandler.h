@@ -54,6 +54,12 @@ static int64_t kDefaultKeepAliveTimeoutUs = 60000000ll;
 
 namespace android {
 
+static bool GetBoolProperty(const char *key) {
+    char value[PROPERTY_VALUE_MAX];
+    return property_get(key, value, NULL)
+        && (!strcmp(value, "1") || !strcasecmp(value, "true"));
+}
+
 static void MakeUserAgentString(AString *s) {
     s->setTo("stagefright/1.1 (Linux;Android ");
 
@@ -135,7 +141,17 @@ struct MyHandler : public AHandler {
           mReceivedFirstRTPPacket(false),
           mSeekable(false),
           mKeepAliveTimeoutUs(kDefaultKeepAliveTimeoutUs),
-          mKeepAliveGeneration(0) {
+          mKeepAliveGeneration(0),
+          mPipelineSetup(GetBoolProperty("media.rtsp.pipeline-setup")),
+          mEarlyPlay(GetBoolProperty("media.rtsp.early-play")),
+          mNumPendingSetups(0),
+          mSetupGeneration(0),
+          mPlaySent(false),
+          mStartTimeUs(-1),
+          mConnectedTimeUs(-1),
+          mDescribedTimeUs(-1),
+          mSetupTimeUs(-1),
+          mPlayedTimeUs(-1) {
         mNetLooper->setName("rtsp net");
         mNetLooper->start(false /* runOnCallingThread */,
                           false /* canCallJava */,
@@ -166,8 +182,10 @@ struct MyHandler : public AHandler {
         looper()->registerHandler(mConn);
         (1 ? mNetLooper : looper())->registerHandler(mRTPConn);
 
-        sp<AMessage> notify = new AMessage('biny', id());
-        mConn->observeBinaryData(notify);
+        // Interleaved RTP/RTCP goes straight to the RTP connection.
+        mConn->observeBinaryData(mRTPConn->newInjectPacketMessage());
+
+        mStartTimeUs = ALooper::GetNowUs();
 
         sp<AMessage> reply = new AMessage('conn', id());
         mConn->connect(mOriginalSessionURL.c_str(), reply);
@@ -358,6 +376,8 @@ struct MyHandler : public AHandler {
                 ALOGI("connection request completed with result %d (%s)",
                      result, strerror(-result));
 
+                mConnectedTimeUs = ALooper::GetNowUs();
+
                 if (result == OK) {
                     AString request;
                     request = "DESCRIBE ";
@@ -396,6 +416,8 @@ struct MyHandler : public AHandler {
                 ALOGI("DESCRIBE completed with result %d (%s)",
                      result, strerror(-result));
 
+                mDescribedTimeUs = ALooper::GetNowUs();
+
                 if (result == OK) {
                     sp<RefBase> obj;
                     CHECK(msg->findObject("response", &obj));
@@ -473,7 +495,7 @@ struct MyHandler : public AHandler {
                                      "tracks. Aborting.");
                                 result = ERROR_UNSUPPORTED;
                             } else {
-                                setupTrack(1);
+                                setupTracks(1);
                             }
                         }
                     }
@@ -488,9 +510,20 @@ struct MyHandler : public AHandler {
 
             case 'setu':
             {
+                int32_t generation;
+                CHECK(msg->findInt32("generation", &generation));
+
+                if (generation != mSetupGeneration) {
+                    // Reply to a pipelined SETUP of an aborted session.
+                    break;
+                }
+
                 size_t index;
                 CHECK(msg->findSize("index", &index));
 
+                // The other tracks have been requested already.
+                bool pipelined = mNumPendingSetups > 0;
+
                 TrackInfo *track = NULL;
                 size_t trackIndex;
                 if (msg->findSize("track-index", &trackIndex)) {
@@ -578,6 +611,22 @@ struct MyHandler : public AHandler {
                     }
                 }
 
+                if (result != OK && track && pipelined) {
+                    // Tracks requested after this one already refer to
+                    // it by index, so start over one track at a time.
+                    ALOGW("Pipelined SETUP failed, setting up the session "
+                         "again without pipelining.");
+
+                    mPipelineSetup = false;
+                    ++mSetupGeneration;
+                    mNumPendingSetups = 0;
+
+                    sp<AMessage> msg = new AMessage('abor', id());
+                    msg->setInt32("reconnect", true);
+                    msg->post();
+                    break;
+                }
+
                 if (result != OK) {
                     if (track) {
                         if (!track->mUsingInterleavedTCP) {
@@ -595,25 +644,24 @@ struct MyHandler : public AHandler {
                     }
                 }
 
-                ++index;
-                if (index < mSessionDesc->countTracks()) {
-                    setupTrack(index);
-                } else if (mSetupTracksSuccessful) {
-                    ++mKeepAliveGeneration;
-                    postKeepAlive();
-
-                    AString request = "PLAY ";
-                    request.append(mSessionURL);
-                    request.append(" RTSP/1.0\r\n");
+                if (pipelined) {
+                    if (--mNumPendingSetups > 0) {
+                        break;
+                    }
 
-                    request.append("Session: ");
-                    request.append(mSessionID);
-                    request.append("\r\n");
+                    index = mSessionDesc->countTracks();
+                } else {
+                    ++index;
+                }
 
-                    request.append("\r\n");
+                if (index < mSessionDesc->countTracks()) {
+                    setupTracks(index);
+                } else if (mSetupTracksSuccessful) {
+                    mSetupTimeUs = ALooper::GetNowUs();
 
-                    sp<AMessage> reply = new AMessage('play', id());
-                    mConn->sendRequest(request.c_str(), reply);
+                    if (!mPlaySent) {
+                        sendPlay();
+                    }
                 } else {
                     sp<AMessage> reply = new AMessage('disc', id());
                     mConn->disconnect(reply);
@@ -623,12 +671,22 @@ struct MyHandler : public AHandler {
 
             case 'play':
             {
+                int32_t generation;
+                CHECK(msg->findInt32("generation", &generation));
+
+                if (generation != mSetupGeneration) {
+                    // Early PLAY of an aborted session.
+                    break;
+                }
+
                 int32_t result;
                 CHECK(msg->findInt32("result", &result));
 
                 ALOGI("PLAY completed with result %d (%s)",
                      result, strerror(-result));
 
+                mPlayedTimeUs = ALooper::GetNowUs();
+
                 if (result == OK) {
                     sp<RefBase> obj;
                     CHECK(msg->findObject("response", &obj));
@@ -722,6 +780,9 @@ struct MyHandler : public AHandler {
                 }
                 mTracks.clear();
                 mSetupTracksSuccessful = false;
+                ++mSetupGeneration;
+                mNumPendingSetups = 0;
+                mPlaySent = false;
                 mSeekPending = false;
                 mFirstAccessUnit = true;
                 mAllTracksHaveTime = false;
@@ -1001,18 +1062,6 @@ struct MyHandler : public AHandler {
                 break;
             }
 
-            case 'biny':
-            {
-                sp<ABuffer> buffer;
-                CHECK(msg->findBuffer("buffer", &buffer));
-
-                int32_t index;
-                CHECK(buffer->meta()->findInt32("index", &index));
-
-                mRTPConn->injectPacket(index, buffer);
-                break;
-            }
-
             case 'tiou':
             {
                 if (!mReceivedFirstRTCPPacket) {
@@ -1055,6 +1104,49 @@ struct MyHandler : public AHandler {
         }
     }
 
+    // Sends the SETUP for track "index" or, once the first SETUP has
+    // returned the session id and pipelining is enabled, the SETUPs for it
+    // and all the remaining tracks at once. With early PLAY enabled the
+    // PLAY follows the last SETUP without waiting for its response.
+    void setupTracks(size_t index) {
+        size_t numTracks = mSessionDesc->countTracks();
+
+        size_t lastIndex = index;
+        if (mPipelineSetup && mSetupTracksSuccessful) {
+            lastIndex = numTracks - 1;
+            mNumPendingSetups = numTracks - index;
+        }
+
+        for (size_t i = index; i <= lastIndex; ++i) {
+            setupTrack(i);
+        }
+
+        if (mEarlyPlay && mSetupTracksSuccessful && lastIndex == numTracks - 1) {
+            sendPlay();
+        }
+    }
+
+    void sendPlay() {
+        ++mKeepAliveGeneration;
+        postKeepAlive();
+
+        AString request = "PLAY ";
+        request.append(mSessionURL);
+        request.append(" RTSP/1.0\r\n");
+
+        request.append("Session: ");
+        request.append(mSessionID);
+        request.append("\r\n");
+
+        request.append("\r\n");
+
+        sp<AMessage> reply = new AMessage('play', id());
+        reply->setInt32("generation", mSetupGeneration);
+        mConn->sendRequest(request.c_str(), reply);
+
+        mPlaySent = true;
+    }
+
     void postKeepAlive() {
         sp<AMessage> msg = new AMessage('aliv', id());
         msg->setInt32("generation", mKeepAliveGeneration);
@@ -1235,6 +1327,19 @@ private:
     int64_t mKeepAliveTimeoutUs;
     int32_t mKeepAliveGeneration;
 
+    bool mPipelineSetup;
+    bool mEarlyPlay;
+    size_t mNumPendingSetups;
+    int32_t mSetupGeneration;
+    bool mPlaySent;
+
+    // Startup timeline, -1 until reached.
+    int64_t mStartTimeUs;
+    int64_t mConnectedTimeUs;
+    int64_t mDescribedTimeUs;
+    int64_t mSetupTimeUs;
+    int64_t mPlayedTimeUs;
+
     Vector<TrackInfo> mTracks;
 
     void setupTrack(size_t index) {
@@ -1246,6 +1351,7 @@ private:
 
             sp<AMessage> reply = new AMessage('setu', id());
             reply->setSize("index", index);
+            reply->setInt32("generation", mSetupGeneration);
             reply->setInt32("result", ERROR_UNSUPPORTED);
             reply->post();
             return;
@@ -1328,6 +1434,7 @@ private:
         sp<AMessage> reply = new AMessage('setu', id());
         reply->setSize("index", index);
         reply->setSize("track-index", mTracks.size() - 1);
+        reply->setInt32("generation", mSetupGeneration);
         mConn->sendRequest(request.c_str(), reply);
     }
 
@@ -1409,8 +1516,27 @@ private:
         ALOGV("onAccessUnitComplete track %d", trackIndex);
 
         if (mFirstAccessUnit) {
+            int64_t nowUs = ALooper::GetNowUs();
+
+            ALOGI("startup took %.2f secs: connect %.2f, DESCRIBE %.2f, "
+                 "SETUP %.2f, PLAY %.2f, first access unit %.2f secs in "
+                 "(%s SETUP%s)",
+                 (nowUs - mStartTimeUs) / 1E6,
+                 (mConnectedTimeUs - mStartTimeUs) / 1E6,
+                 (mDescribedTimeUs - mStartTimeUs) / 1E6,
+                 (mSetupTimeUs - mStartTimeUs) / 1E6,
+                 (mPlayedTimeUs - mStartTimeUs) / 1E6,
+                 (nowUs - mStartTimeUs) / 1E6,
+                 mPipelineSetup ? "pipelined" : "sequential",
+                 mEarlyPlay ? ", early PLAY" : "");
+
             sp<AMessage> msg = mNotify->dup();
             msg->setInt32("what", kWhatConnected);
+            msg->setInt64("startup-connect-us", mConnectedTimeUs - mStartTimeUs);
+            msg->setInt64("startup-describe-us", mDescribedTimeUs - mStartTimeUs);
+            msg->setInt64("startup-setup-us", mSetupTimeUs - mStartTimeUs);
+            msg->setInt64("startup-play-us", mPlayedTimeUs - mStartTimeUs);
+            msg->setInt64("startup-first-access-unit-us", nowUs - mStartTimeUs);
             msg->post();
 
             if (mSeekable) {
@@ -35,14 +35,22 @@ namespace android {
 TimedTextSRTSource::TimedTextSRTSource(const sp<DataSource>& dataSource)
         : mSource(dataSource),
           mMetaData(new MetaData),
-          mIndex(0) {
+          mIndex(0),
+          mScanOffset(0),
+          mScanComplete(false),
+          mBufferOffset(0),
+          mBufferLength(0) {
 }
 
 TimedTextSRTSource::~TimedTextSRTSource() {
 }
 
 status_t TimedTextSRTSource::start() {
-    status_t err = scanFile();
+    // Only the first subtitle is parsed up front, the rest as needed.
+    status_t err = scanNextSubtitle();
+    if (err == ERROR_END_OF_STREAM) {
+        err = ERROR_MALFORMED;
+    }
     if (err != OK) {
         reset();
     }
@@ -56,6 +64,10 @@ void TimedTextSRTSource::reset() {
     mMetaData->clear();
     mTextVector.clear();
     mIndex = 0;
+    mScanOffset = 0;
+    mScanComplete = false;
+    mBufferOffset = 0;
+    mBufferLength = 0;
 }
 
 status_t TimedTextSRTSource::stop() {
@@ -79,27 +91,49 @@ status_t TimedTextSRTSource::read(
     return OK;
 }
 
-status_t TimedTextSRTSource::scanFile() {
-    off64_t offset = 0;
-    int64_t startTimeUs;
-    bool endOfFile = false;
-
-    while (!endOfFile) {
-        TextInfo info;
-        status_t err = getNextSubtitleInfo(&offset, &startTimeUs, &info);
-        switch (err) {
-            case OK:
-                mTextVector.add(startTimeUs, info);
-                break;
-            case ERROR_END_OF_STREAM:
-                endOfFile = true;
-                break;
-            default:
-                return err;
+status_t TimedTextSRTSource::scanNextSubtitle() {
+    if (mScanComplete) {
+        return ERROR_END_OF_STREAM;
+    }
+
+    TextInfo info;
+    status_t err = getNextSubtitleInfo(&mScanOffset, &info);
+    if (err != OK) {
+        if (err != ERROR_END_OF_STREAM && !mTextVector.isEmpty()) {
+            ALOGW("ignoring subtitles after offset %lld, error %d",
+                  mScanOffset, err);
         }
+        mScanComplete = true;
+        return mTextVector.isEmpty() ? err : ERROR_END_OF_STREAM;
     }
-    if (mTextVector.isEmpty()) {
-        return ERROR_MALFORMED;
+
+    // Subtitles are almost always in order, search from the back.
+    size_t index = mTextVector.size();
+    while (index > 0
+            && mTextVector.itemAt(index - 1).startTimeUs > info.startTimeUs) {
+        --index;
+    }
+    mTextVector.insertAt(info, index);
+
+    if (index < mIndex) {
+        // Out of order and before the current position, it's missed
+        // just as if it had been seeked past.
+        ++mIndex;
+    }
+
+    return OK;
+}
+
+// Parses until a subtitle starts after "timeUs", so that any subtitle
+// shown at "timeUs" is in mTextVector.
+status_t TimedTextSRTSource::scanUntil(int64_t timeUs) {
+    while (!mScanComplete && (mTextVector.isEmpty()
+                || mTextVector.itemAt(mTextVector.size() - 1).startTimeUs
+                    <= timeUs)) {
+        status_t err = scanNextSubtitle();
+        if (err != OK && err != ERROR_END_OF_STREAM) {
+            return err;
+        }
     }
     return OK;
 }
@@ -120,7 +154,7 @@ status_t TimedTextSRTSource::scanFile() {
  * and twenty thousand feet above ground level.
  */
 status_t TimedTextSRTSource::getNextSubtitleInfo(
-          off64_t *offset, int64_t *startTimeUs, TextInfo *info) {
+          off64_t *offset, TextInfo *info) {
     AString data;
     status_t err;
 
@@ -144,9 +178,10 @@ status_t TimedTextSRTSource::getNextSubtitleInfo(
         return ERROR_MALFORMED;
     }
 
-    *startTimeUs = ((hour1 * 3600 + min1 * 60 + sec1) * 1000 + msec1) * 1000ll;
+    info->startTimeUs =
+        ((hour1 * 3600 + min1 * 60 + sec1) * 1000 + msec1) * 1000ll;
     info->endTimeUs = ((hour2 * 3600 + min2 * 60 + sec2) * 1000 + msec2) * 1000ll;
-    if (info->endTimeUs <= *startTimeUs) {
+    if (info->endTimeUs <= info->startTimeUs) {
         return ERROR_MALFORMED;
     }
 
@@ -173,16 +208,29 @@ status_t TimedTextSRTSource::getNextSubtitleInfo(
     return OK;
 }
 
+status_t TimedTextSRTSource::readByte(off64_t offset, char *character) {
+    if (offset < mBufferOffset
+            || offset >= mBufferOffset + (off64_t)mBufferLength) {
+        ssize_t readSize = mSource->readAt(offset, mBuffer, sizeof(mBuffer));
+        if (readSize < 1) {
+            mBufferLength = 0;
+            return readSize == 0 ? ERROR_END_OF_STREAM : ERROR_IO;
+        }
+        mBufferOffset = offset;
+        mBufferLength = readSize;
+    }
+
+    *character = mBuffer[offset - mBufferOffset];
+    return OK;
+}
+
 status_t TimedTextSRTSource::readNextLine(off64_t *offset, AString *data) {
     data->clear();
     while (true) {
-        ssize_t readSize;
+        status_t err;
         char character;
-        if ((readSize = mSource->readAt(*offset, &character, 1)) < 1) {
-            if (readSize == 0) {
-                return ERROR_END_OF_STREAM;
-            }
-            return ERROR_IO;
+        if ((err = readByte(*offset, &character)) != OK) {
+            return err;
         }
 
         (*offset)++;
@@ -191,11 +239,11 @@ status_t TimedTextSRTSource::readNextLine(off64_t *offset, AString *data) {
         if (character == 10) {
             break;
         } else if (character == 13) {
-            if ((readSize = mSource->readAt(*offset, &character, 1)) < 1) {
-                if (readSize == 0) {  // end of the stream
+            if ((err = readByte(*offset, &character)) != OK) {
+                if (err == ERROR_END_OF_STREAM) {  // end of the stream
                     return OK;
                 }
-                return ERROR_IO;
+                return err;
             }
 
             (*offset)++;
@@ -219,49 +267,40 @@ status_t TimedTextSRTSource::getText(
     int64_t seekTimeUs;
     MediaSource::ReadOptions::SeekMode mode;
     if (options != NULL && options->getSeekTo(&seekTimeUs, &mode)) {
+        status_t err = scanUntil(seekTimeUs);
+        if (err != OK) {
+            return err;
+        }
+
         int64_t lastEndTimeUs =
-                mTextVector.valueAt(mTextVector.size() - 1).endTimeUs;
-        int64_t firstStartTimeUs = mTextVector.keyAt(0);
-        if (seekTimeUs < 0 || seekTimeUs > lastEndTimeUs) {
+                mTextVector.itemAt(mTextVector.size() - 1).endTimeUs;
+        if (seekTimeUs < 0 || (mScanComplete && seekTimeUs > lastEndTimeUs)) {
             return ERROR_OUT_OF_RANGE;
-        } else if (seekTimeUs < firstStartTimeUs) {
-            mIndex = 0;
-        } else {
-            // binary search
-            size_t low = 0;
-            size_t high = mTextVector.size() - 1;
-            size_t mid = 0;
-            int64_t currTimeUs;
-
-            while (low <= high) {
-                mid = low + (high - low)/2;
-                currTimeUs = mTextVector.keyAt(mid);
-                const int64_t diffTime = currTimeUs - seekTimeUs;
-
-                if (diffTime == 0) {
-                    break;
-                } else if (diffTime < 0) {
-                    low = mid + 1;
-                } else {
-                    if ((high == mid + 1)
-                        && (seekTimeUs < mTextVector.keyAt(high))) {
-                        break;
-                    }
-                    if (mid < 1) {
-                        break;
-                    }
-                    high = mid - 1;
-                }
+        }
+
+        // binary search for the last subtitle starting at or before
+        // seekTimeUs, or the first one if none does
+        size_t low = 0;
+        size_t high = mTextVector.size();
+        while (low < high) {
+            size_t mid = low + (high - low) / 2;
+            if (mTextVector.itemAt(mid).startTimeUs <= seekTimeUs) {
+                low = mid + 1;
+            } else {
+                high = mid;
             }
-            mIndex = mid;
         }
+        mIndex = (low > 0) ? low - 1 : 0;
     }
 
-    if (mIndex >= mTextVector.size()) {
-        return ERROR_END_OF_STREAM;
+    while (mIndex >= mTextVector.size()) {
+        status_t err = scanNextSubtitle();
+        if (err != OK) {
+            return err;
+        }
     }
-    const TextInfo &info = mTextVector.valueAt(mIndex);
-    *startTimeUs = mTextVector.keyAt(mIndex);
+    const TextInfo &info = mTextVector.itemAt(mIndex);
+    *startTimeUs = info.startTimeUs;
     *endTimeUs = info.endTimeUs;
     mIndex++;
 
@@ -20,6 +20,7 @@
 #include <media/stagefright/MediaErrors.h>
 #include <media/stagefright/MediaSource.h>
 #include <utils/Compat.h>  // off64_t
+#include <utils/Vector.h>
 
 #include "TimedTextSource.h"
 
@@ -49,7 +50,12 @@ private:
     sp<DataSource> mSource;
     sp<MetaData> mMetaData;
 
+    enum {
+        kBufferSize = 4096,
+    };
+
     struct TextInfo {
+        int64_t startTimeUs;
         int64_t endTimeUs;
         // The offset of the text in the original file.
         off64_t offset;
@@ -57,13 +63,24 @@ private:
     };
 
     size_t mIndex;
-    KeyedVector<int64_t, TextInfo> mTextVector;
+
+    // Sorted by start time and only as far into the file as playback and
+    // seeks have needed so far. The text itself is read when displayed.
+    Vector<TextInfo> mTextVector;
+    off64_t mScanOffset;
+    bool mScanComplete;
+
+    // Lines are read through this rather than a byte at a time.
+    char mBuffer[kBufferSize];
+    off64_t mBufferOffset;
+    size_t mBufferLength;
 
     void reset();
-    status_t scanFile();
-    status_t getNextSubtitleInfo(
-            off64_t *offset, int64_t *startTimeUs, TextInfo *info);
+    status_t scanNextSubtitle();
+    status_t scanUntil(int64_t timeUs);
+    status_t getNextSubtitleInfo(off64_t *offset, TextInfo *info);
     status_t readNextLine(off64_t *offset, AString *data);
+    status_t readByte(off64_t offset, char *character);
     status_t getText(
             const MediaSource::ReadOptions *options,
             AString *text, int64_t *startTimeUs, int64_t *endTimeUs);
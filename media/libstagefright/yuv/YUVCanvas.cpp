@@ -32,20 +32,14 @@ YUVCanvas::~YUVCanvas() {
 }
 
 void YUVCanvas::FillYUV(uint8_t yValue, uint8_t uValue, uint8_t vValue) {
-    for (int32_t y = 0; y < mYUVImage.height(); ++y) {
-        for (int32_t x = 0; x < mYUVImage.width(); ++x) {
-            mYUVImage.setPixelValue(x, y, yValue, uValue, vValue);
-        }
-    }
+    mYUVImage.fillRectangle(
+            Rect(mYUVImage.width(), mYUVImage.height()),
+            yValue, uValue, vValue);
 }
 
 void YUVCanvas::FillYUVRectangle(const Rect& rect,
         uint8_t yValue, uint8_t uValue, uint8_t vValue) {
-    for (int32_t y = rect.top; y < rect.bottom; ++y) {
-        for (int32_t x = rect.left; x < rect.right; ++x) {
-            mYUVImage.setPixelValue(x, y, yValue, uValue, vValue);
-        }
-    }
+    mYUVImage.fillRectangle(rect, yValue, uValue, vValue);
 }
 
 void YUVCanvas::CopyImageRect(
@@ -108,4 +102,13 @@ void YUVCanvas::downsample(
     }
 }
 
+void YUVCanvas::resize(const YUVImage &srcImage) {
+    if (mYUVImage.width() == srcImage.width() / 2
+            && mYUVImage.height() == srcImage.height() / 2) {
+        YUVImage::downscaleBy2(srcImage, mYUVImage);
+    } else {
+        YUVImage::resizeBilinear(srcImage, mYUVImage);
+    }
+}
+
 }  // namespace android
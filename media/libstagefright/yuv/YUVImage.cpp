@@ -21,6 +21,10 @@
 #include <media/stagefright/YUVImage.h>
 #include <ui/Rect.h>
 
+#ifdef __ARM_NEON__
+#include <arm_neon.h>
+#endif
+
 namespace android {
 
 YUVImage::YUVImage(YUVFormat yuvFormat, int32_t width, int32_t height) {
@@ -342,6 +346,230 @@ void YUVImage::fastCopyRectangle420SemiPlanar(
     }
 }
 
+// Row primitives shared by the rectangle and scaling functions below. Each
+// has a NEON loop for 16 or 8 samples at a time and a scalar tail that
+// computes exactly the same values.
+
+// Writes |numPairs| pairs of (first, second).
+static void fillRowPairs(uint8_t *dst, size_t numPairs, uint8_t first, uint8_t second) {
+    size_t i = 0;
+
+#ifdef __ARM_NEON__
+    uint8x16x2_t pair;
+    pair.val[0] = vdupq_n_u8(first);
+    pair.val[1] = vdupq_n_u8(second);
+    for (; i + 16 <= numPairs; i += 16) {
+        vst2q_u8(dst + 2 * i, pair);
+    }
+#endif
+
+    for (; i < numPairs; ++i) {
+        dst[2 * i] = first;
+        dst[2 * i + 1] = second;
+    }
+}
+
+// dst = first[0] second[0] first[1] second[1] ...
+static void interleaveRow(
+        const uint8_t *first, const uint8_t *second, uint8_t *dst, size_t numPairs) {
+    size_t i = 0;
+
+#ifdef __ARM_NEON__
+    for (; i + 16 <= numPairs; i += 16) {
+        uint8x16x2_t pair;
+        pair.val[0] = vld1q_u8(first + i);
+        pair.val[1] = vld1q_u8(second + i);
+        vst2q_u8(dst + 2 * i, pair);
+    }
+#endif
+
+    for (; i < numPairs; ++i) {
+        dst[2 * i] = first[i];
+        dst[2 * i + 1] = second[i];
+    }
+}
+
+// The inverse of interleaveRow().
+static void deinterleaveRow(
+        const uint8_t *src, uint8_t *first, uint8_t *second, size_t numPairs) {
+    size_t i = 0;
+
+#ifdef __ARM_NEON__
+    for (; i + 16 <= numPairs; i += 16) {
+        uint8x16x2_t pair = vld2q_u8(src + 2 * i);
+        vst1q_u8(first + i, pair.val[0]);
+        vst1q_u8(second + i, pair.val[1]);
+    }
+#endif
+
+    for (; i < numPairs; ++i) {
+        first[i] = src[2 * i];
+        second[i] = src[2 * i + 1];
+    }
+}
+
+// Averages 2x2 blocks of two source rows into |numPixels| pixels of
+// |channels| (1 or 2) interleaved samples each, rounding to nearest.
+static void downscaleRowBy2(
+        const uint8_t *row0, const uint8_t *row1, uint8_t *dst,
+        size_t numPixels, int32_t channels) {
+    size_t i = 0;
+
+#ifdef __ARM_NEON__
+    if (channels == 1) {
+        for (; i + 8 <= numPixels; i += 8) {
+            uint16x8_t sum = vpaddlq_u8(vld1q_u8(row0 + 2 * i));
+            sum = vpadalq_u8(sum, vld1q_u8(row1 + 2 * i));
+            vst1_u8(dst + i, vrshrn_n_u16(sum, 2));
+        }
+    } else {
+        for (; i + 8 <= numPixels; i += 8) {
+            // val[0..3] are channel 0 and 1 of the even pixels, then of the
+            // odd ones.
+            uint8x8x4_t a = vld4_u8(row0 + 4 * i);
+            uint8x8x4_t b = vld4_u8(row1 + 4 * i);
+
+            uint16x8_t sum0 = vaddq_u16(vaddl_u8(a.val[0], a.val[2]),
+                                        vaddl_u8(b.val[0], b.val[2]));
+            uint16x8_t sum1 = vaddq_u16(vaddl_u8(a.val[1], a.val[3]),
+                                        vaddl_u8(b.val[1], b.val[3]));
+
+            uint8x8x2_t out;
+            out.val[0] = vrshrn_n_u16(sum0, 2);
+            out.val[1] = vrshrn_n_u16(sum1, 2);
+            vst2_u8(dst + 2 * i, out);
+        }
+    }
+#endif
+
+    for (; i < numPixels; ++i) {
+        for (int32_t c = 0; c < channels; ++c) {
+            size_t x = 2 * i * channels + c;
+            dst[i * channels + c] =
+                (row0[x] + row0[x + channels] + row1[x] + row1[x + channels] + 2) >> 2;
+        }
+    }
+}
+
+// dst = (row0 * (256 - weight) + row1 * weight) / 256, rounded, for weight
+// in [0, 256).
+static void blendRows(
+        const uint8_t *row0, const uint8_t *row1, uint32_t weight,
+        uint8_t *dst, size_t numSamples) {
+    if (weight == 0) {
+        memcpy(dst, row0, numSamples);
+        return;
+    }
+
+    size_t i = 0;
+
+#ifdef __ARM_NEON__
+    const uint8x8_t w0 = vdup_n_u8(256 - weight);
+    const uint8x8_t w1 = vdup_n_u8(weight);
+    for (; i + 16 <= numSamples; i += 16) {
+        uint8x16_t a = vld1q_u8(row0 + i);
+        uint8x16_t b = vld1q_u8(row1 + i);
+
+        uint16x8_t lo = vmull_u8(vget_low_u8(a), w0);
+        lo = vmlal_u8(lo, vget_low_u8(b), w1);
+        uint16x8_t hi = vmull_u8(vget_high_u8(a), w0);
+        hi = vmlal_u8(hi, vget_high_u8(b), w1);
+
+        vst1q_u8(dst + i, vcombine_u8(vrshrn_n_u16(lo, 8), vrshrn_n_u16(hi, 8)));
+    }
+#endif
+
+    for (; i < numSamples; ++i) {
+        dst[i] = (row0[i] * (256 - weight) + row1[i] * weight + 128) >> 8;
+    }
+}
+
+// Maps destination sample |i| of |destSize| to a 16.16 source position, with
+// the centers of the first and last samples aligned.
+static int64_t sourcePosition(int32_t i, int32_t srcSize, int32_t destSize) {
+    int64_t pos = (((int64_t)(2 * i + 1) * srcSize - destSize) << 16) / (2 * destSize);
+    return pos < 0 ? 0 : pos;
+}
+
+// Horizontal bilinear resampling of one row of |channels| interleaved
+// samples per pixel.
+static void resizeRow(
+        const uint8_t *src, int32_t srcWidth,
+        uint8_t *dst, int32_t destWidth, int32_t channels) {
+    for (int32_t x = 0; x < destWidth; ++x) {
+        int64_t pos = sourcePosition(x, srcWidth, destWidth);
+        int32_t x0 = pos >> 16;
+        int32_t x1 = x0 + 1 < srcWidth ? x0 + 1 : srcWidth - 1;
+        if (x0 > x1) {
+            x0 = x1;
+        }
+        uint32_t weight = (pos >> 8) & 0xff;
+
+        for (int32_t c = 0; c < channels; ++c) {
+            uint32_t a = src[x0 * channels + c];
+            uint32_t b = src[x1 * channels + c];
+            dst[x * channels + c] = (a * (256 - weight) + b * weight + 128) >> 8;
+        }
+    }
+}
+
+void YUVImage::fastCopyRectangleAcrossFormats(
+        const Rect& srcRect,
+        int32_t destStartX, int32_t destStartY,
+        const YUVImage &srcImage, YUVImage &destImage) {
+    CHECK(srcImage.mYUVFormat != destImage.mYUVFormat);
+
+    int32_t width = srcRect.width();
+    int32_t height = srcRect.height();
+
+    uint8_t *ySrcAddr;
+    uint8_t *uSrcAddr;
+    uint8_t *vSrcAddr;
+    srcImage.getYUVAddresses(srcRect.left, srcRect.top,
+            &ySrcAddr, &uSrcAddr, &vSrcAddr);
+
+    uint8_t *yDestAddr;
+    uint8_t *uDestAddr;
+    uint8_t *vDestAddr;
+    destImage.getYUVAddresses(destStartX, destStartY,
+            &yDestAddr, &uDestAddr, &vDestAddr);
+
+    int32_t ySrcOffsetIncrement;
+    int32_t uSrcOffsetIncrement;
+    int32_t vSrcOffsetIncrement;
+    srcImage.getOffsetIncrementsPerDataRow(
+            &ySrcOffsetIncrement, &uSrcOffsetIncrement, &vSrcOffsetIncrement);
+
+    int32_t yDestOffsetIncrement;
+    int32_t uDestOffsetIncrement;
+    int32_t vDestOffsetIncrement;
+    destImage.getOffsetIncrementsPerDataRow(
+            &yDestOffsetIncrement, &uDestOffsetIncrement, &vDestOffsetIncrement);
+
+    // Copy Y
+    for (int32_t offsetY = 0; offsetY < height; ++offsetY) {
+        memcpy(yDestAddr, ySrcAddr, (size_t) width);
+
+        ySrcAddr += ySrcOffsetIncrement;
+        yDestAddr += yDestOffsetIncrement;
+    }
+
+    // Copy U and V. Semi planar rows start with V, i.e. at vAddr.
+    size_t numberOfUVPairsPerRow = (size_t) (width >> 1);
+    for (int32_t offsetY = 0; offsetY < (height >> 1); ++offsetY) {
+        if (srcImage.mYUVFormat == YUV420Planar) {
+            interleaveRow(vSrcAddr, uSrcAddr, vDestAddr, numberOfUVPairsPerRow);
+        } else {
+            deinterleaveRow(vSrcAddr, vDestAddr, uDestAddr, numberOfUVPairsPerRow);
+        }
+
+        uSrcAddr += uSrcOffsetIncrement;
+        vSrcAddr += vSrcOffsetIncrement;
+        uDestAddr += uDestOffsetIncrement;
+        vDestAddr += vDestOffsetIncrement;
+    }
+}
+
 // static
 bool YUVImage::fastCopyRectangle(
         const Rect& srcRect,
@@ -361,9 +589,155 @@ bool YUVImage::fastCopyRectangle(
         }
         return true;
     }
+
+    // Across formats every chroma sample has to be copied whole, which takes
+    // 2x2 aligned rectangles.
+    if (((srcRect.left | srcRect.top | srcRect.width() | srcRect.height()
+                | destStartX | destStartY) & 1) == 0) {
+        fastCopyRectangleAcrossFormats(
+                srcRect,
+                destStartX, destStartY,
+                srcImage, destImage);
+        return true;
+    }
     return false;
 }
 
+void YUVImage::fillRectangle(const Rect& rect,
+        uint8_t yValue, uint8_t uValue, uint8_t vValue) {
+    int32_t left = rect.left < 0 ? 0 : rect.left;
+    int32_t top = rect.top < 0 ? 0 : rect.top;
+    int32_t right = rect.right > mWidth ? mWidth : rect.right;
+    int32_t bottom = rect.bottom > mHeight ? mHeight : rect.bottom;
+    if (left >= right || top >= bottom) {
+        return;
+    }
+
+    int32_t yOffsetIncrement;
+    int32_t uOffsetIncrement;
+    int32_t vOffsetIncrement;
+    getOffsetIncrementsPerDataRow(
+            &yOffsetIncrement, &uOffsetIncrement, &vOffsetIncrement);
+
+    // Fill Y
+    uint8_t *yAddr;
+    uint8_t *uAddr;
+    uint8_t *vAddr;
+    getYUVAddresses(left, top, &yAddr, &uAddr, &vAddr);
+    for (int32_t y = top; y < bottom; ++y) {
+        memset(yAddr, yValue, (size_t) (right - left));
+        yAddr += yOffsetIncrement;
+    }
+
+    // Fill U and V, for every 2x2 block the rectangle touches.
+    getYUVAddresses(left & ~1, top & ~1, &yAddr, &uAddr, &vAddr);
+    size_t numberOfUVPerRow = (size_t) (((right + 1) >> 1) - (left >> 1));
+    for (int32_t y = top >> 1; y < ((bottom + 1) >> 1); ++y) {
+        if (mYUVFormat == YUV420Planar) {
+            memset(uAddr, uValue, numberOfUVPerRow);
+            memset(vAddr, vValue, numberOfUVPerRow);
+        } else {
+            fillRowPairs(vAddr, numberOfUVPerRow, vValue, uValue);
+        }
+
+        uAddr += uOffsetIncrement;
+        vAddr += vOffsetIncrement;
+    }
+}
+
+int32_t YUVImage::getPlanes(Plane *planes) const {
+    planes[0].mData = mYdata;
+    planes[0].mWidth = mWidth;
+    planes[0].mHeight = mHeight;
+    planes[0].mStride = mWidth;
+    planes[0].mChannels = 1;
+
+    if (mYUVFormat == YUV420SemiPlanar) {
+        planes[1].mData = mVdata;
+        planes[1].mWidth = mWidth >> 1;
+        planes[1].mHeight = mHeight >> 1;
+        planes[1].mStride = mWidth;
+        planes[1].mChannels = 2;
+        return 2;
+    }
+
+    for (int32_t i = 1; i <= 2; ++i) {
+        planes[i].mData = (i == 1) ? mUdata : mVdata;
+        planes[i].mWidth = mWidth >> 1;
+        planes[i].mHeight = mHeight >> 1;
+        planes[i].mStride = mWidth >> 1;
+        planes[i].mChannels = 1;
+    }
+    return 3;
+}
+
+// static
+void YUVImage::downscaleBy2(const YUVImage &srcImage, YUVImage &destImage) {
+    CHECK(srcImage.mYUVFormat == destImage.mYUVFormat);
+    CHECK_EQ(destImage.mWidth, srcImage.mWidth / 2);
+    CHECK_EQ(destImage.mHeight, srcImage.mHeight / 2);
+
+    Plane srcPlanes[3];
+    Plane destPlanes[3];
+    int32_t numPlanes = srcImage.getPlanes(srcPlanes);
+    destImage.getPlanes(destPlanes);
+
+    for (int32_t i = 0; i < numPlanes; ++i) {
+        const Plane &src = srcPlanes[i];
+        const Plane &dest = destPlanes[i];
+
+        for (int32_t y = 0; y < dest.mHeight; ++y) {
+            const uint8_t *row0 = src.mData + (2 * y) * src.mStride;
+            downscaleRowBy2(row0, row0 + src.mStride,
+                    dest.mData + y * dest.mStride, dest.mWidth, dest.mChannels);
+        }
+    }
+}
+
+// static
+void YUVImage::resizePlane(const Plane &src, const Plane &dest) {
+    // Vertical first into a scratch row, then horizontally into place.
+    uint8_t *row = new uint8_t[src.mWidth * src.mChannels];
+
+    for (int32_t y = 0; y < dest.mHeight; ++y) {
+        int64_t pos = sourcePosition(y, src.mHeight, dest.mHeight);
+        int32_t y0 = pos >> 16;
+        int32_t y1 = y0 + 1 < src.mHeight ? y0 + 1 : src.mHeight - 1;
+        if (y0 > y1) {
+            y0 = y1;
+        }
+
+        blendRows(src.mData + y0 * src.mStride, src.mData + y1 * src.mStride,
+                (pos >> 8) & 0xff, row, src.mWidth * src.mChannels);
+
+        uint8_t *destRow = dest.mData + y * dest.mStride;
+        if (src.mWidth == dest.mWidth) {
+            memcpy(destRow, row, dest.mWidth * dest.mChannels);
+        } else {
+            resizeRow(row, src.mWidth, destRow, dest.mWidth, dest.mChannels);
+        }
+    }
+
+    delete[] row;
+}
+
+// static
+void YUVImage::resizeBilinear(const YUVImage &srcImage, YUVImage &destImage) {
+    CHECK(srcImage.mYUVFormat == destImage.mYUVFormat);
+
+    Plane srcPlanes[3];
+    Plane destPlanes[3];
+    int32_t numPlanes = srcImage.getPlanes(srcPlanes);
+    destImage.getPlanes(destPlanes);
+
+    for (int32_t i = 0; i < numPlanes; ++i) {
+        if (srcPlanes[i].mWidth > 0 && srcPlanes[i].mHeight > 0
+                && destPlanes[i].mWidth > 0 && destPlanes[i].mHeight > 0) {
+            resizePlane(srcPlanes[i], destPlanes[i]);
+        }
+    }
+}
+
 uint8_t clamp(uint8_t v, uint8_t minValue, uint8_t maxValue) {
     CHECK(maxValue >= minValue);
 
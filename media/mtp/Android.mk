@@ -24,9 +24,11 @@ LOCAL_SRC_FILES:=                                       \
                   MtpDevice.cpp                         \
                   MtpEventPacket.cpp                    \
                   MtpDeviceInfo.cpp                     \
+                  MtpFileTransfer.cpp                   \
                   MtpObjectInfo.cpp                     \
                   MtpPacket.cpp                         \
                   MtpProperty.cpp                       \
+                  MtpPropertyCache.cpp                  \
                   MtpRequestPacket.cpp                  \
                   MtpResponsePacket.cpp                 \
                   MtpServer.cpp                         \
@@ -255,24 +255,40 @@ void MtpDataPacket::putUInt128(uint64_t value) {
 }
 
 void MtpDataPacket::putAInt8(const int8_t* values, int count) {
+    reserve(4 + count * 1);
     putUInt32(count);
     for (int i = 0; i < count; i++)
         putInt8(*values++);
 }
 
+void MtpDataPacket::reserve(int length) {
+    allocate(mOffset + length);
+}
+
+void MtpDataPacket::putData(const void* data, int length) {
+    allocate(mOffset + length);
+    memcpy(mBuffer + mOffset, data, length);
+    mOffset += length;
+    if (mPacketSize < mOffset)
+        mPacketSize = mOffset;
+}
+
 void MtpDataPacket::putAUInt8(const uint8_t* values, int count) {
+    reserve(4 + count * 1);
     putUInt32(count);
     for (int i = 0; i < count; i++)
         putUInt8(*values++);
 }
 
 void MtpDataPacket::putAInt16(const int16_t* values, int count) {
+    reserve(4 + count * 2);
     putUInt32(count);
     for (int i = 0; i < count; i++)
         putInt16(*values++);
 }
 
 void MtpDataPacket::putAUInt16(const uint16_t* values, int count) {
+    reserve(4 + count * 2);
     putUInt32(count);
     for (int i = 0; i < count; i++)
         putUInt16(*values++);
@@ -280,18 +296,21 @@ void MtpDataPacket::putAUInt16(const uint16_t* values, int count) {
 
 void MtpDataPacket::putAUInt16(const UInt16List* values) {
     size_t count = (values ? values->size() : 0);
+    reserve(4 + count * 2);
     putUInt32(count);
     for (size_t i = 0; i < count; i++)
         putUInt16((*values)[i]);
 }
 
 void MtpDataPacket::putAInt32(const int32_t* values, int count) {
+    reserve(4 + count * 4);
     putUInt32(count);
     for (int i = 0; i < count; i++)
         putInt32(*values++);
 }
 
 void MtpDataPacket::putAUInt32(const uint32_t* values, int count) {
+    reserve(4 + count * 4);
     putUInt32(count);
     for (int i = 0; i < count; i++)
         putUInt32(*values++);
@@ -302,6 +321,7 @@ void MtpDataPacket::putAUInt32(const UInt32List* list) {
         putEmptyArray();
     } else {
         size_t size = list->size();
+        reserve(4 + size * 4);
         putUInt32(size);
         for (size_t i = 0; i < size; i++)
             putUInt32((*list)[i]);
@@ -309,12 +329,14 @@ void MtpDataPacket::putAUInt32(const UInt32List* list) {
 }
 
 void MtpDataPacket::putAInt64(const int64_t* values, int count) {
+    reserve(4 + count * 8);
     putUInt32(count);
     for (int i = 0; i < count; i++)
         putInt64(*values++);
 }
 
 void MtpDataPacket::putAUInt64(const uint64_t* values, int count) {
+    reserve(4 + count * 8);
     putUInt32(count);
     for (int i = 0; i < count; i++)
         putUInt64(*values++);
@@ -337,6 +359,7 @@ void MtpDataPacket::putString(const uint16_t* string) {
         else
             break;
     }
+    reserve(1 + (count + 1) * 2);
     putUInt8(count > 0 ? count + 1 : 0);
     for (int i = 0; i < count; i++)
         putUInt16(string[i]);
@@ -366,6 +389,7 @@ int MtpDataPacket::writeData(int fd, void* data, uint32_t length) {
     allocate(length);
     memcpy(mBuffer + MTP_CONTAINER_HEADER_SIZE, data, length);
     length += MTP_CONTAINER_HEADER_SIZE;
+    mPacketSize = length;
     MtpPacket::putUInt32(MTP_CONTAINER_LENGTH_OFFSET, length);
     MtpPacket::putUInt16(MTP_CONTAINER_TYPE_OFFSET, MTP_CONTAINER_TYPE_DATA);
     int ret = ::write(fd, mBuffer, length);
@@ -452,14 +476,22 @@ int MtpDataPacket::write(struct usb_request *request) {
     MtpPacket::putUInt32(MTP_CONTAINER_LENGTH_OFFSET, mPacketSize);
     MtpPacket::putUInt16(MTP_CONTAINER_TYPE_OFFSET, MTP_CONTAINER_TYPE_DATA);
 
-    // send header separately from data
-    request->buffer = mBuffer;
-    request->buffer_length = MTP_CONTAINER_HEADER_SIZE;
-    int ret = transfer(request);
-    if (ret == MTP_CONTAINER_HEADER_SIZE) {
-        request->buffer = mBuffer + MTP_CONTAINER_HEADER_SIZE;
-        request->buffer_length = mPacketSize - MTP_CONTAINER_HEADER_SIZE;
+    // send the header in the same transfer as the start of the data,
+    // in chunks no larger than usbfs accepts
+    int offset = 0;
+    int ret = 0;
+    while (offset < mPacketSize) {
+        int length = mPacketSize - offset;
+        if (length > MTP_BUFFER_SIZE)
+            length = MTP_BUFFER_SIZE;
+        request->buffer = mBuffer + offset;
+        request->buffer_length = length;
         ret = transfer(request);
+        if (ret <= 0) {
+            ret = -1;
+            break;
+        }
+        offset += ret;
     }
     return (ret < 0 ? ret : 0);
 }
@@ -42,6 +42,7 @@ public:
     void                setTransactionID(MtpTransactionID id);
 
     inline const uint8_t*     getData() const { return mBuffer + MTP_CONTAINER_HEADER_SIZE; }
+    inline int          getDataLength() const { return mPacketSize - MTP_CONTAINER_HEADER_SIZE; }
     inline uint8_t      getUInt8() { return (uint8_t)mBuffer[mOffset++]; }
     inline int8_t       getInt8() { return (int8_t)mBuffer[mOffset++]; }
     uint16_t            getUInt16();
@@ -89,6 +90,11 @@ public:
     void                putString(const MtpStringBuffer& string);
     void                putString(const char* string);
     void                putString(const uint16_t* string);
+    // makes room for "length" more bytes of data, to avoid growing the buffer
+    // repeatedly while a large dataset is built
+    void                reserve(int length);
+    // appends raw, already encoded data
+    void                putData(const void* data, int length);
     inline void         putEmptyString() { putUInt8(0); }
     inline void         putEmptyArray() { putUInt32(0); }
 
@@ -399,4 +399,30 @@ const char* MtpDebug::getDevicePropCodeName(MtpPropertyCode code) {
     return getCodeName(code, sDevicePropCodes);
 }
 
+void MtpDebug::logTransfer(MtpOperationCode code, uint64_t bytes,
+                           nsecs_t duration, bool userspace) {
+    // totals for the process, reported every kReportInterval bytes
+    static const uint64_t kReportInterval = 256 * 1024 * 1024;
+    static uint64_t sTotalBytes = 0;
+    static nsecs_t sTotalDuration = 0;
+    static uint64_t sLastReport = 0;
+
+    sTotalBytes += bytes;
+    sTotalDuration += duration;
+
+    int64_t durationUs = ns2us(duration);
+    ALOGV("%s: %llu bytes in %lld us (%lld KB/s)%s",
+            getOperationCodeName(code), bytes, durationUs,
+            durationUs > 0 ? (int64_t)(bytes * 1000000 / 1024 / durationUs) : 0ll,
+            userspace ? " userspace" : "");
+
+    if (sTotalBytes - sLastReport >= kReportInterval) {
+        int64_t totalUs = ns2us(sTotalDuration);
+        ALOGD("transferred %llu bytes in %lld ms (%lld KB/s)",
+                sTotalBytes, totalUs / 1000,
+                totalUs > 0 ? (int64_t)(sTotalBytes * 1000000 / 1024 / totalUs) : 0ll);
+        sLastReport = sTotalBytes;
+    }
+}
+
 }  // namespace android
@@ -19,6 +19,7 @@
 
 // #define LOG_NDEBUG 0
 #include <utils/Log.h>
+#include <utils/Timers.h>
 
 #include "MtpTypes.h"
 
@@ -30,6 +31,10 @@ public:
     static const char* getFormatCodeName(MtpObjectFormat code);
     static const char* getObjectPropCodeName(MtpPropertyCode code);
     static const char* getDevicePropCodeName(MtpPropertyCode code);
+
+    // Logs the throughput of an object transfer along with running totals.
+    static void logTransfer(MtpOperationCode code, uint64_t bytes,
+                            nsecs_t duration, bool userspace);
 };
 
 }; // namespace android
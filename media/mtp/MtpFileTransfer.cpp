@@ -0,0 +1,170 @@
+/*
+ * Copyright (C) 2012 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "MtpFileTransfer"
+
+#include <errno.h>
+#include <malloc.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/types.h>
+
+#include "MtpDebug.h"
+#include "MtpFileTransfer.h"
+
+namespace android {
+
+MtpFileReceiver::MtpFileReceiver(int usbFd, int fileFd,
+                                 uint64_t offset, uint64_t length)
+    :   mUsbFd(usbFd),
+        mFileFd(fileFd),
+        mOffset(offset),
+        mLength(length),
+        mReadDone(false),
+        mError(0)
+{
+    for (int i = 0; i < kNumBuffers; i++) {
+        // page aligned so the file writes can go straight to the page cache
+        mBuffers[i].mData = (uint8_t *)memalign(4096, kBufferSize);
+        mBuffers[i].mLength = 0;
+        mBuffers[i].mFull = false;
+    }
+}
+
+MtpFileReceiver::~MtpFileReceiver() {
+    for (int i = 0; i < kNumBuffers; i++)
+        free(mBuffers[i].mData);
+}
+
+int64_t MtpFileReceiver::receive() {
+    for (int i = 0; i < kNumBuffers; i++) {
+        if (!mBuffers[i].mData) {
+            errno = ENOMEM;
+            return -1;
+        }
+    }
+    if (lseek64(mFileFd, mOffset, SEEK_SET) != (off64_t)mOffset)
+        return -1;
+
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, writerThread, this)) {
+        errno = EAGAIN;
+        return -1;
+    }
+
+    uint64_t remaining = (mLength == 0xFFFFFFFF ? ~0ULL : mLength);
+    int64_t received = 0;
+    int index = 0;
+    bool more = true;
+    while (more) {
+        Buffer& buffer = mBuffers[index];
+        {
+            Mutex::Autolock autoLock(mLock);
+            while (buffer.mFull && !mError)
+                mCondition.wait(mLock);
+            if (mError)
+                break;
+        }
+
+        more = fillBuffer(buffer, remaining);
+        received += buffer.mLength;
+
+        Mutex::Autolock autoLock(mLock);
+        buffer.mFull = true;
+        mCondition.broadcast();
+        index = (index + 1) % kNumBuffers;
+    }
+
+    {
+        Mutex::Autolock autoLock(mLock);
+        mReadDone = true;
+        mCondition.broadcast();
+    }
+    pthread_join(thread, NULL);
+
+    if (mError) {
+        errno = mError;
+        return -1;
+    }
+    return received;
+}
+
+bool MtpFileReceiver::fillBuffer(Buffer& buffer, uint64_t& remaining) {
+    buffer.mLength = 0;
+    while (buffer.mLength < kBufferSize && remaining > 0) {
+        size_t request = kBufferSize - buffer.mLength;
+        if (request > kMaxReadSize)
+            request = kMaxReadSize;
+        if (request > remaining)
+            request = remaining;
+
+        int ret = ::read(mUsbFd, buffer.mData + buffer.mLength, request);
+        if (ret < 0) {
+            Mutex::Autolock autoLock(mLock);
+            if (!mError)
+                mError = errno;
+            return false;
+        }
+        buffer.mLength += ret;
+        remaining -= ret;
+        // a short packet ends the transfer
+        if ((size_t)ret < request)
+            return false;
+    }
+    return remaining > 0;
+}
+
+void* MtpFileReceiver::writerThread(void* me) {
+    ((MtpFileReceiver *)me)->writeBuffers();
+    return NULL;
+}
+
+void MtpFileReceiver::writeBuffers() {
+    int index = 0;
+    for (;;) {
+        Buffer& buffer = mBuffers[index];
+        {
+            Mutex::Autolock autoLock(mLock);
+            while (!buffer.mFull && !mReadDone && !mError)
+                mCondition.wait(mLock);
+            // the reader marks its last buffer full before setting mReadDone
+            if (!buffer.mFull || mError)
+                return;
+        }
+
+        size_t written = 0;
+        while (written < buffer.mLength) {
+            int ret = ::write(mFileFd, buffer.mData + written, buffer.mLength - written);
+            if (ret < 0) {
+                ALOGE("write failed: %s", strerror(errno));
+                Mutex::Autolock autoLock(mLock);
+                if (!mError)
+                    mError = errno;
+                mCondition.broadcast();
+                return;
+            }
+            written += ret;
+        }
+
+        Mutex::Autolock autoLock(mLock);
+        buffer.mFull = false;
+        mCondition.broadcast();
+        index = (index + 1) % kNumBuffers;
+    }
+}
+
+}  // namespace android
@@ -0,0 +1,80 @@
+/*
+ * Copyright (C) 2012 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _MTP_FILE_TRANSFER_H
+#define _MTP_FILE_TRANSFER_H
+
+#include <stdint.h>
+#include <pthread.h>
+
+#include <utils/threads.h>
+
+namespace android {
+
+// Receives the data phase of a SendObject or SendPartialObject from the USB
+// driver into a file without the MTP_RECEIVE_FILE ioctl.
+// USB reads fill one buffer while a second thread writes the previous one to
+// the file, so that storage and USB transfers overlap.
+class MtpFileReceiver {
+public:
+    // Reads "length" bytes, or until a short packet if length is 0xFFFFFFFF,
+    // from usbFd and writes them to fileFd starting at "offset".
+                        MtpFileReceiver(int usbFd, int fileFd,
+                                        uint64_t offset, uint64_t length);
+    virtual             ~MtpFileReceiver();
+
+    // Returns the number of bytes received, or -1 with errno set.
+    int64_t             receive();
+
+private:
+    enum {
+        kNumBuffers = 2,
+        kBufferSize = 256 * 1024,
+        // the driver returns at most one bulk request per read()
+        kMaxReadSize = 16384,
+    };
+
+    struct Buffer {
+        uint8_t*        mData;
+        size_t          mLength;
+        bool            mFull;
+    };
+
+    int                 mUsbFd;
+    int                 mFileFd;
+    uint64_t            mOffset;
+    uint64_t            mLength;
+
+    Mutex               mLock;
+    Condition           mCondition;
+    Buffer              mBuffers[kNumBuffers];
+    bool                mReadDone;
+    // errno of the first failure on either side, 0 if none
+    int                 mError;
+
+    static void*        writerThread(void* me);
+    void                writeBuffers();
+
+    // fills one buffer from usbFd, returns false at the end of the transfer
+    bool                fillBuffer(Buffer& buffer, uint64_t& remaining);
+
+                        MtpFileReceiver(const MtpFileReceiver&);
+    MtpFileReceiver&    operator=(const MtpFileReceiver&);
+};
+
+}; // namespace android
+
+#endif // _MTP_FILE_TRANSFER_H
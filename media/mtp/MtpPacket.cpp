@@ -48,18 +48,27 @@ MtpPacket::~MtpPacket() {
 
 void MtpPacket::reset() {
     allocate(MTP_CONTAINER_HEADER_SIZE);
+    // a buffer grown for a large packet is only dirty up to the packet size,
+    // reads go to the start of the buffer and grown space starts out zeroed
+    int dirty = (mPacketSize > mAllocationIncrement ? mPacketSize : mAllocationIncrement);
+    if (dirty > mBufferSize)
+        dirty = mBufferSize;
     mPacketSize = MTP_CONTAINER_HEADER_SIZE;
-    memset(mBuffer, 0, mBufferSize);
+    memset(mBuffer, 0, dirty);
 }
 
 void MtpPacket::allocate(int length) {
     if (length > mBufferSize) {
+        // grow geometrically so building large datasets doesn't realloc per increment
         int newLength = length + mAllocationIncrement;
+        if (newLength < mBufferSize * 2)
+            newLength = mBufferSize * 2;
         mBuffer = (uint8_t *)realloc(mBuffer, newLength);
         if (!mBuffer) {
             ALOGE("out of memory!");
             abort();
         }
+        memset(mBuffer + mBufferSize, 0, newLength - mBufferSize);
         mBufferSize = newLength;
     }
 }
@@ -0,0 +1,196 @@
+/*
+ * Copyright (C) 2012 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "MtpPropertyCache"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "MtpDataPacket.h"
+#include "MtpDebug.h"
+#include "MtpPropertyCache.h"
+#include "mtp.h"
+
+namespace android {
+
+static inline uint16_t readUInt16(const uint8_t* data) {
+    return (uint16_t)data[0] | ((uint16_t)data[1] << 8);
+}
+
+static inline uint32_t readUInt32(const uint8_t* data) {
+    return (uint32_t)data[0] | ((uint32_t)data[1] << 8)
+            | ((uint32_t)data[2] << 16) | ((uint32_t)data[3] << 24);
+}
+
+MtpPropertyCache::MtpPropertyCache()
+    :   mProperty(0),
+        mGroupCode(0),
+        mData(NULL)
+{
+}
+
+MtpPropertyCache::~MtpPropertyCache() {
+    free(mData);
+}
+
+bool MtpPropertyCache::add(uint32_t property, int groupCode, const MtpDataPacket& packet) {
+    Mutex::Autolock autoLock(mLock);
+    clear_l();
+
+    const uint8_t* data = packet.getData();
+    int length = packet.getDataLength();
+    if (length < 4 || length > kMaxDataSize)
+        return false;
+
+    // the dataset is a count followed by (handle, property, type, value) elements
+    uint32_t count = readUInt32(data);
+    size_t offset = 4;
+    for (uint32_t i = 0; i < count; i++) {
+        if (offset + 8 > (size_t)length)
+            goto fail;
+        MtpObjectHandle handle = readUInt32(data + offset);
+        uint16_t type = readUInt16(data + offset + 6);
+        int valueSize = getValueSize(type, data + offset + 8, length - offset - 8);
+        if (valueSize < 0)
+            goto fail;
+        size_t elementSize = 8 + valueSize;
+
+        if (mObjects.size() > 0 && mObjects.top().mHandle == handle) {
+            ObjectRows& rows = mObjects.editTop();
+            rows.mCount++;
+            rows.mLength += elementSize;
+        } else {
+            ObjectRows rows;
+            rows.mHandle = handle;
+            rows.mCount = 1;
+            rows.mOffset = offset - 4;
+            rows.mLength = elementSize;
+            mObjects.add(rows);
+        }
+        offset += elementSize;
+    }
+
+    mObjects.sort(compareHandles);
+    for (size_t i = 1; i < mObjects.size(); i++) {
+        // rows for an object are expected to be contiguous
+        if (mObjects[i].mHandle == mObjects[i - 1].mHandle)
+            goto fail;
+    }
+
+    mData = (uint8_t *)malloc(offset - 4);
+    if (!mData)
+        goto fail;
+    memcpy(mData, data + 4, offset - 4);
+    mProperty = property;
+    mGroupCode = groupCode;
+    ALOGV("cached %d objects, %d bytes", mObjects.size(), offset - 4);
+    return true;
+
+fail:
+    ALOGD("not caching GetObjectPropList dataset");
+    clear_l();
+    return false;
+}
+
+bool MtpPropertyCache::get(MtpObjectHandle handle, uint32_t property, int groupCode,
+                           MtpDataPacket& packet) {
+    Mutex::Autolock autoLock(mLock);
+    if (!mData || property != mProperty || groupCode != mGroupCode)
+        return false;
+
+    ssize_t low = 0;
+    ssize_t high = (ssize_t)mObjects.size() - 1;
+    while (low <= high) {
+        ssize_t mid = (low + high) / 2;
+        const ObjectRows& rows = mObjects[mid];
+        if (rows.mHandle == handle) {
+            packet.putUInt32(rows.mCount);
+            packet.putData(mData + rows.mOffset, rows.mLength);
+            return true;
+        }
+        if (rows.mHandle < handle)
+            low = mid + 1;
+        else
+            high = mid - 1;
+    }
+    return false;
+}
+
+void MtpPropertyCache::clear() {
+    Mutex::Autolock autoLock(mLock);
+    clear_l();
+}
+
+void MtpPropertyCache::clear_l() {
+    free(mData);
+    mData = NULL;
+    mObjects.clear();
+}
+
+// static
+int MtpPropertyCache::compareHandles(const ObjectRows* lhs, const ObjectRows* rhs) {
+    if (lhs->mHandle < rhs->mHandle)
+        return -1;
+    return (lhs->mHandle > rhs->mHandle ? 1 : 0);
+}
+
+// static
+int MtpPropertyCache::getValueSize(uint16_t type, const uint8_t* data, size_t length) {
+    int elementSize;
+    switch (type & ~0x4000) {
+        case MTP_TYPE_INT8:
+        case MTP_TYPE_UINT8:
+            elementSize = 1;
+            break;
+        case MTP_TYPE_INT16:
+        case MTP_TYPE_UINT16:
+            elementSize = 2;
+            break;
+        case MTP_TYPE_INT32:
+        case MTP_TYPE_UINT32:
+            elementSize = 4;
+            break;
+        case MTP_TYPE_INT64:
+        case MTP_TYPE_UINT64:
+            elementSize = 8;
+            break;
+        case MTP_TYPE_INT128:
+        case MTP_TYPE_UINT128:
+            elementSize = 16;
+            break;
+        default:
+            if (type == MTP_TYPE_STR) {
+                // length in characters including the terminator, then UTF-16
+                if (length < 1 || 1 + data[0] * 2 > length)
+                    return -1;
+                return 1 + data[0] * 2;
+            }
+            ALOGE("unknown property type %04X", type);
+            return -1;
+    }
+
+    if (type & 0x4000) {
+        if (length < 4)
+            return -1;
+        uint32_t count = readUInt32(data);
+        if (count > (length - 4) / elementSize)
+            return -1;
+        return 4 + count * elementSize;
+    }
+    return ((size_t)elementSize > length ? -1 : elementSize);
+}
+
+}  // namespace android
@@ -0,0 +1,84 @@
+/*
+ * Copyright (C) 2012 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _MTP_PROPERTY_CACHE_H
+#define _MTP_PROPERTY_CACHE_H
+
+#include "MtpTypes.h"
+
+#include <utils/threads.h>
+
+namespace android {
+
+class MtpDataPacket;
+
+// Holds the GetObjectPropList rows of every object returned by one bulk
+// (depth 1 or all objects) query, so that the per-object GetObjectPropList
+// requests hosts send while enumerating can be answered without going back
+// to the database. Only one bulk result is kept at a time.
+class MtpPropertyCache {
+public:
+                        MtpPropertyCache();
+    virtual             ~MtpPropertyCache();
+
+    // Replaces the cache with the dataset in "packet", the response to a
+    // GetObjectPropList for all formats with the given property and group code.
+    // Returns false and leaves the cache empty if the dataset can't be split.
+    bool                add(uint32_t property, int groupCode, const MtpDataPacket& packet);
+
+    // Appends the dataset for a single object to "packet".
+    // Returns false if the object's rows for this property and group code
+    // are not cached.
+    bool                get(MtpObjectHandle handle, uint32_t property, int groupCode,
+                            MtpDataPacket& packet);
+
+    void                clear();
+
+private:
+    enum {
+        // larger datasets are passed through without caching them
+        kMaxDataSize = 32 * 1024 * 1024,
+    };
+
+    struct ObjectRows {
+        MtpObjectHandle mHandle;
+        uint32_t        mCount;
+        // offset and length of the rows in mData
+        size_t          mOffset;
+        size_t          mLength;
+    };
+
+    Mutex               mLock;
+
+    uint32_t            mProperty;
+    int                 mGroupCode;
+    uint8_t*            mData;
+    Vector<ObjectRows>  mObjects;
+
+    void                clear_l();
+
+    static int          compareHandles(const ObjectRows* lhs, const ObjectRows* rhs);
+
+    // returns the size of a property value of the given type at "data", or -1
+    static int          getValueSize(uint16_t type, const uint8_t* data, size_t length);
+
+                        MtpPropertyCache(const MtpPropertyCache&);
+    MtpPropertyCache&   operator=(const MtpPropertyCache&);
+};
+
+}; // namespace android
+
+#endif // _MTP_PROPERTY_CACHE_H
@@ -30,6 +30,7 @@
 
 #include "MtpDebug.h"
 #include "MtpDatabase.h"
+#include "MtpFileTransfer.h"
 #include "MtpObjectInfo.h"
 #include "MtpProperty.h"
 #include "MtpServer.h"
@@ -107,7 +108,10 @@ MtpServer::MtpServer(int fd, MtpDatabase* database, bool ptp,
         mSessionOpen(false),
         mSendObjectHandle(kInvalidObjectHandle),
         mSendObjectFormat(0),
-        mSendObjectFileSize(0)
+        mSendObjectFileSize(0),
+        mUserspaceReceive(false),
+        mEventThreadStarted(false),
+        mStopEventThread(false)
 {
 }
 
@@ -118,6 +122,7 @@ void MtpServer::addStorage(MtpStorage* storage) {
     Mutex::Autolock autoLock(mMutex);
 
     mStorages.push(storage);
+    mPropertyCache.clear();
     sendStoreAdded(storage->getStorageID());
 }
 
@@ -127,6 +132,7 @@ void MtpServer::removeStorage(MtpStorage* storage) {
     for (int i = 0; i < mStorages.size(); i++) {
         if (mStorages[i] == storage) {
             mStorages.removeAt(i);
+            mPropertyCache.clear();
             sendStoreRemoved(storage->getStorageID());
             break;
         }
@@ -155,6 +161,8 @@ void MtpServer::run() {
 
     ALOGV("MtpServer::run fd: %d\n", fd);
 
+    startEventThread();
+
     while (1) {
         int ret = mRequest.read(fd);
         if (ret < 0) {
@@ -237,17 +245,20 @@ void MtpServer::run() {
 
     if (mSessionOpen)
         mDatabase->sessionEnded();
+    stopEventThread();
     close(fd);
     mFD = -1;
 }
 
 void MtpServer::sendObjectAdded(MtpObjectHandle handle) {
     ALOGV("sendObjectAdded %d\n", handle);
+    mPropertyCache.clear();
     sendEvent(MTP_EVENT_OBJECT_ADDED, handle);
 }
 
 void MtpServer::sendObjectRemoved(MtpObjectHandle handle) {
     ALOGV("sendObjectRemoved %d\n", handle);
+    mPropertyCache.clear();
     sendEvent(MTP_EVENT_OBJECT_REMOVED, handle);
 }
 
@@ -263,11 +274,66 @@ void MtpServer::sendStoreRemoved(MtpStorageID id) {
 
 void MtpServer::sendEvent(MtpEventCode code, uint32_t param1) {
     if (mSessionOpen) {
-        mEvent.setEventCode(code);
-        mEvent.setTransactionID(mRequest.getTransactionID());
-        mEvent.setParameter(1, param1);
+        PendingEvent event;
+        event.mCode = code;
+        event.mTransactionID = mRequest.getTransactionID();
+        event.mParameter = param1;
+
+        Mutex::Autolock autoLock(mEventLock);
+        mEventQueue.push_back(event);
+        mEventCondition.signal();
+    }
+}
+
+void MtpServer::startEventThread() {
+    Mutex::Autolock autoLock(mEventLock);
+    mStopEventThread = false;
+    if (pthread_create(&mEventThread, NULL, eventThread, this) == 0)
+        mEventThreadStarted = true;
+    else
+        ALOGE("could not start MTP event thread");
+}
+
+void MtpServer::stopEventThread() {
+    {
+        Mutex::Autolock autoLock(mEventLock);
+        if (!mEventThreadStarted)
+            return;
+        mStopEventThread = true;
+        mEventCondition.signal();
+    }
+    pthread_join(mEventThread, NULL);
+
+    Mutex::Autolock autoLock(mEventLock);
+    mEventThreadStarted = false;
+    // the host is gone, events for the next connection start from scratch
+    mEventQueue.clear();
+}
+
+// static
+void* MtpServer::eventThread(void* me) {
+    ((MtpServer *)me)->sendEvents();
+    return NULL;
+}
+
+void MtpServer::sendEvents() {
+    Mutex::Autolock autoLock(mEventLock);
+    while (!mStopEventThread) {
+        if (mEventQueue.empty()) {
+            mEventCondition.wait(mEventLock);
+            continue;
+        }
+        PendingEvent event = *mEventQueue.begin();
+        mEventQueue.erase(mEventQueue.begin());
+
+        // mEvent is only used by this thread
+        mEventLock.unlock();
+        mEvent.setEventCode(event.mCode);
+        mEvent.setTransactionID(event.mTransactionID);
+        mEvent.setParameter(1, event.mParameter);
         int ret = mEvent.write(mFD);
         ALOGV("mEvent.write returned %d\n", ret);
+        mEventLock.lock();
     }
 }
 
@@ -300,6 +366,7 @@ void MtpServer::removeEditObject(MtpObjectHandle handle) {
 }
 
 void MtpServer::commitEdit(ObjectEdit* edit) {
+    mPropertyCache.clear();
     mDatabase->endSendObject((const char *)edit->mPath, edit->mHandle, edit->mFormat, true);
 }
 
@@ -419,6 +486,30 @@ bool MtpServer::handleRequest() {
     return true;
 }
 
+int64_t MtpServer::receiveFile(struct mtp_file_range& mfr) {
+    nsecs_t start = systemTime();
+    int64_t ret = -1;
+    if (!mUserspaceReceive) {
+        ret = ioctl(mFD, MTP_RECEIVE_FILE, (unsigned long)&mfr);
+        ALOGV("MTP_RECEIVE_FILE returned %lld", ret);
+        // older gadget drivers don't know the ioctl and have not touched the data
+        if (ret < 0 && (errno == ENOTTY || errno == EINVAL)) {
+            ALOGW("MTP_RECEIVE_FILE not supported, receiving in userspace");
+            mUserspaceReceive = true;
+        }
+    }
+    if (mUserspaceReceive) {
+        MtpFileReceiver receiver(mFD, mfr.fd, mfr.offset, mfr.length);
+        ret = receiver.receive();
+        ALOGV("MtpFileReceiver returned %lld", ret);
+    }
+    if (ret >= 0) {
+        uint64_t bytes = (mfr.length == 0xFFFFFFFF || mUserspaceReceive ? ret : mfr.length);
+        MtpDebug::logTransfer(mfr.command, bytes, systemTime() - start, mUserspaceReceive);
+    }
+    return ret;
+}
+
 MtpResponseCode MtpServer::doGetDeviceInfo() {
     MtpStringBuffer   string;
     char prop_value[PROPERTY_VALUE_MAX];
@@ -481,6 +572,7 @@ MtpResponseCode MtpServer::doOpenSession() {
     }
     mSessionID = mRequest.getParameter(1);
     mSessionOpen = true;
+    mPropertyCache.clear();
 
     mDatabase->sessionStarted();
 
@@ -492,6 +584,7 @@ MtpResponseCode MtpServer::doCloseSession() {
         return MTP_RESPONSE_SESSION_NOT_OPEN;
     mSessionID = 0;
     mSessionOpen = false;
+    mPropertyCache.clear();
     mDatabase->sessionEnded();
     return MTP_RESPONSE_OK;
 }
@@ -628,6 +721,7 @@ MtpResponseCode MtpServer::doSetObjectPropValue() {
     ALOGV("SetObjectPropValue %d %s\n", handle,
             MtpDebug::getObjectPropCodeName(property));
 
+    mPropertyCache.clear();
     return mDatabase->setObjectPropertyValue(handle, property, mData);
 }
 
@@ -669,7 +763,30 @@ MtpResponseCode MtpServer::doGetObjectPropList() {
             handle, MtpDebug::getFormatCodeName(format),
             MtpDebug::getObjectPropCodeName(property), groupCode, depth);
 
-    return mDatabase->getObjectPropertyList(handle, format, property, groupCode, depth, mData);
+    // all formats of a single object, as hosts request while enumerating
+    bool single = (depth == 0 && format == 0 && handle != 0xFFFFFFFF);
+    if (single) {
+        if (mPropertyCache.get(handle, property, groupCode, mData))
+            return MTP_RESPONSE_OK;
+
+        // fetch the rows of the object and all its siblings in one query,
+        // into a separate packet so mData doesn't keep a large buffer
+        MtpObjectInfo info(handle);
+        MtpDataPacket siblings;
+        if (mDatabase->getObjectInfo(handle, info) == MTP_RESPONSE_OK
+                && mDatabase->getObjectPropertyList(info.mParent, 0, property, groupCode,
+                        1, siblings) == MTP_RESPONSE_OK
+                && mPropertyCache.add(property, groupCode, siblings)
+                && mPropertyCache.get(handle, property, groupCode, mData))
+            return MTP_RESPONSE_OK;
+    }
+
+    MtpResponseCode result = mDatabase->getObjectPropertyList(handle, format, property,
+            groupCode, depth, mData);
+    // keep the rows of bulk requests for the per-object requests that follow
+    if (result == MTP_RESPONSE_OK && !single && format == 0)
+        mPropertyCache.add(property, groupCode, mData);
+    return result;
 }
 
 MtpResponseCode MtpServer::doGetObjectInfo() {
@@ -735,9 +852,12 @@ MtpResponseCode MtpServer::doGetObject() {
     mfr.transaction_id = mRequest.getTransactionID();
 
     // then transfer the file
+    nsecs_t start = systemTime();
     int ret = ioctl(mFD, MTP_SEND_FILE_WITH_HEADER, (unsigned long)&mfr);
     ALOGV("MTP_SEND_FILE_WITH_HEADER returned %d\n", ret);
     close(mfr.fd);
+    if (ret >= 0)
+        MtpDebug::logTransfer(mfr.command, mfr.length, systemTime() - start, false);
     if (ret < 0) {
         if (errno == ECANCELED)
             return MTP_RESPONSE_TRANSACTION_CANCELLED;
@@ -801,9 +921,12 @@ MtpResponseCode MtpServer::doGetPartialObject(MtpOperationCode operation) {
     mResponse.setParameter(1, length);
 
     // transfer the file
+    nsecs_t start = systemTime();
     int ret = ioctl(mFD, MTP_SEND_FILE_WITH_HEADER, (unsigned long)&mfr);
     ALOGV("MTP_SEND_FILE_WITH_HEADER returned %d\n", ret);
     close(mfr.fd);
+    if (ret >= 0)
+        MtpDebug::logTransfer(mfr.command, mfr.length, systemTime() - start, false);
     if (ret < 0) {
         if (errno == ECANCELED)
             return MTP_RESPONSE_TRANSACTION_CANCELLED;
@@ -820,6 +943,7 @@ MtpResponseCode MtpServer::doSendObjectInfo() {
     MtpObjectHandle parent = mRequest.getParameter(2);
     if (!storage)
         return MTP_RESPONSE_INVALID_STORAGE_ID;
+    mPropertyCache.clear();
 
     // special case the root
     if (parent == MTP_PARENT_ROOT) {
@@ -953,11 +1077,12 @@ MtpResponseCode MtpServer::doSendObject() {
         } else {
             mfr.length = mSendObjectFileSize - initialData;
         }
+        mfr.command = mRequest.getOperationCode();
+        mfr.transaction_id = mRequest.getTransactionID();
 
         ALOGV("receiving %s\n", (const char *)mSendObjectFilePath);
         // transfer the file
-        ret = ioctl(mFD, MTP_RECEIVE_FILE, (unsigned long)&mfr);
-        ALOGV("MTP_RECEIVE_FILE returned %d\n", ret);
+        ret = (receiveFile(mfr) < 0 ? -1 : 0);
     }
     close(mfr.fd);
 
@@ -972,6 +1097,7 @@ MtpResponseCode MtpServer::doSendObject() {
 done:
     // reset so we don't attempt to send the data back
     mData.reset();
+    mPropertyCache.clear();
 
     mDatabase->endSendObject(mSendObjectFilePath, mSendObjectHandle, mSendObjectFormat,
             result == MTP_RESPONSE_OK);
@@ -1048,6 +1174,7 @@ MtpResponseCode MtpServer::doDeleteObject() {
     // FIXME - support deleting all objects if handle is 0xFFFFFFFF
     // FIXME - implement deleting objects by format
 
+    mPropertyCache.clear();
     MtpString filePath;
     int64_t fileLength;
     int result = mDatabase->getObjectFilePath(handle, filePath, fileLength, format);
@@ -1128,10 +1255,11 @@ MtpResponseCode MtpServer::doSendPartialObject() {
         mfr.fd = edit->mFD;
         mfr.offset = offset;
         mfr.length = length;
+        mfr.command = mRequest.getOperationCode();
+        mfr.transaction_id = mRequest.getTransactionID();
 
         // transfer the file
-        ret = ioctl(mFD, MTP_RECEIVE_FILE, (unsigned long)&mfr);
-        ALOGV("MTP_RECEIVE_FILE returned %d", ret);
+        ret = (receiveFile(mfr) < 0 ? -1 : 0);
     }
     if (ret < 0) {
         mResponse.setParameter(1, 0);
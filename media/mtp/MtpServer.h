@@ -21,11 +21,17 @@
 #include "MtpDataPacket.h"
 #include "MtpResponsePacket.h"
 #include "MtpEventPacket.h"
+#include "MtpPropertyCache.h"
 #include "mtp.h"
 #include "MtpUtils.h"
 
+#include <utils/List.h>
 #include <utils/threads.h>
 
+#include <pthread.h>
+
+struct mtp_file_range;
+
 namespace android {
 
 class MtpDatabase;
@@ -60,14 +66,35 @@ private:
 
     MtpStorageList      mStorages;
 
+    // GetObjectPropList rows from the last bulk query
+    MtpPropertyCache    mPropertyCache;
+
     // handle for new object, set by SendObjectInfo and used by SendObject
     MtpObjectHandle     mSendObjectHandle;
     MtpObjectFormat     mSendObjectFormat;
     MtpString           mSendObjectFilePath;
     size_t              mSendObjectFileSize;
 
+    // set once the driver has rejected MTP_RECEIVE_FILE, so that objects are
+    // received through MtpFileReceiver instead
+    bool                mUserspaceReceive;
+
     Mutex               mMutex;
 
+    // events are queued by sendEvent and written by mEventThread, so that
+    // neither the caller nor the request loop waits for the interrupt endpoint
+    struct PendingEvent {
+        MtpEventCode        mCode;
+        MtpTransactionID    mTransactionID;
+        uint32_t            mParameter;
+    };
+    Mutex               mEventLock;
+    Condition           mEventCondition;
+    List<PendingEvent>  mEventQueue;
+    pthread_t           mEventThread;
+    bool                mEventThreadStarted;
+    bool                mStopEventThread;
+
     // represents an MTP object that is being edited using the android extensions
     // for direct editing (BeginEditObject, SendPartialObject, TruncateObject and EndEditObject)
     class ObjectEdit {
@@ -110,6 +137,11 @@ private:
     void                sendStoreRemoved(MtpStorageID id);
     void                sendEvent(MtpEventCode code, uint32_t param1);
 
+    void                startEventThread();
+    void                stopEventThread();
+    static void*        eventThread(void* me);
+    void                sendEvents();
+
     void                addEditObject(MtpObjectHandle handle, MtpString& path,
                                 uint64_t size, MtpObjectFormat format, int fd);
     ObjectEdit*         getEditObject(MtpObjectHandle handle);
@@ -118,6 +150,9 @@ private:
 
     bool                handleRequest();
 
+    // receives the rest of a data phase into mfr.fd, returns bytes or -1 with errno
+    int64_t             receiveFile(struct mtp_file_range& mfr);
+
     MtpResponseCode     doGetDeviceInfo();
     MtpResponseCode     doOpenSession();
     MtpResponseCode     doCloseSession();
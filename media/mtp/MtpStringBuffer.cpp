@@ -142,6 +142,7 @@ void MtpStringBuffer::readFromPacket(MtpDataPacket* packet) {
 void MtpStringBuffer::writeToPacket(MtpDataPacket* packet) const {
     int count = mCharCount;
     const uint8_t* src = mBuffer;
+    packet->reserve(1 + (count + 1) * 2);
     packet->putUInt8(count > 0 ? count + 1 : 0);
 
     // expand utf8 to 16 bit chars
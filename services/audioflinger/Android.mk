@@ -20,6 +20,8 @@ LOCAL_SRC_FILES := \
     NBAIO.cpp                       \
     MonoPipe.cpp                    \
     MonoPipeReader.cpp              \
+    MultiPipe.cpp                   \
+    MultiPipeWriter.cpp             \
     Pipe.cpp                        \
     PipeReader.cpp                  \
     roundup.c                       \
@@ -43,6 +45,7 @@ LOCAL_SRC_FILES:=               \
     AudioFlinger.cpp            \
     AudioMixer.cpp.arm          \
     AudioResampler.cpp.arm      \
+    AudioResamplerPolyphase.cpp.arm \
     AudioPolicyService.cpp      \
     ServiceUtilities.cpp
 #   AudioResamplerSinc.cpp.arm
@@ -50,6 +53,8 @@ LOCAL_SRC_FILES:=               \
 
 LOCAL_SRC_FILES += StateQueue.cpp
 
+LOCAL_SRC_FILES += CycleProfiler.cpp
+
 # uncomment for debugging timing problems related to StateQueue::push()
 LOCAL_CFLAGS += -DSTATE_QUEUE_DUMP
 
@@ -82,6 +87,8 @@ LOCAL_MODULE:= libaudioflinger
 
 LOCAL_SRC_FILES += FastMixer.cpp FastMixerState.cpp
 
+LOCAL_SRC_FILES += FastCapture.cpp FastCaptureState.cpp
+
 LOCAL_CFLAGS += -DFAST_MIXER_STATISTICS
 
 # uncomment to display CPU load adjusted for CPU frequency
@@ -107,3 +114,64 @@ ifeq ($(BOARD_HAS_SAMSUNG_VOLUME_BUG),true)
 endif
 
 include $(BUILD_SHARED_LIBRARY)
+
+################################################################################
+
+# audiomixer_bench, for kernel changes to AudioMixer, the resamplers and the
+# NBAIO pipes. Builds for the target and, without effects and local time, for
+# the host.
+
+audiomixer_bench_src_files := \
+    test/audiomixer_bench.cpp       \
+    AudioMixer.cpp                  \
+    AudioResampler.cpp              \
+    AudioResamplerPolyphase.cpp     \
+    NBAIO.cpp                       \
+    MonoPipe.cpp                    \
+    MonoPipeReader.cpp              \
+    Pipe.cpp                        \
+    PipeReader.cpp                  \
+    roundup.c
+
+audiomixer_bench_c_includes := \
+    $(LOCAL_PATH) \
+    $(call include-path-for, audio-effects) \
+    $(call include-path-for, audio-utils)
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES := $(audiomixer_bench_src_files)
+
+LOCAL_C_INCLUDES := $(audiomixer_bench_c_includes)
+
+LOCAL_SHARED_LIBRARIES := \
+    libaudioutils \
+    libcommon_time_client \
+    libcutils \
+    libutils \
+    libeffects
+
+LOCAL_MODULE := audiomixer_bench
+LOCAL_MODULE_TAGS := debug
+
+include $(BUILD_EXECUTABLE)
+
+include $(CLEAR_VARS)
+
+# libaudioutils has no host build, its primitives are built in directly
+LOCAL_SRC_FILES := $(audiomixer_bench_src_files) \
+    ../../../../system/media/audio_utils/primitives.c
+
+LOCAL_C_INCLUDES := $(audiomixer_bench_c_includes)
+
+LOCAL_STATIC_LIBRARIES := \
+    libcutils \
+    libutils \
+    liblog
+
+LOCAL_LDLIBS := -lpthread -lrt
+
+LOCAL_MODULE := audiomixer_bench
+LOCAL_MODULE_TAGS := debug
+
+include $(BUILD_HOST_EXECUTABLE)
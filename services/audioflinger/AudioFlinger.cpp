@@ -63,6 +63,10 @@
 
 #include <audio_utils/primitives.h>
 
+#ifdef __ARM_NEON__
+#include <arm_neon.h>
+#endif
+
 #include <powermanager/PowerManager.h>
 
 // #define DEBUG_CPU_USAGE 10  // log statistics every n wall clock seconds
@@ -77,6 +81,7 @@
 #include "FastMixer.h"
 
 // NBAIO implementations
+#include "AudioStreamInSource.h"
 #include "AudioStreamOutSink.h"
 #include "MonoPipe.h"
 #include "MonoPipeReader.h"
@@ -135,6 +140,9 @@ static const nsecs_t kWarningThrottleNs = seconds(5);
 // RecordThread loop sleep time upon application overrun or audio HAL read error
 static const int kRecordThreadSleepUs = 5000;
 
+// maximum time for the RecordThread to wait for the fast capture to fill one read request
+static const uint32_t kFastCaptureReadTimeoutUs = 500000;
+
 // maximum time to wait for setParameters to complete
 static const nsecs_t kSetParametersTimeoutNs = seconds(2);
 
@@ -143,6 +151,13 @@ static const uint32_t kMinThreadSleepTimeUs = 5000;
 // maximum divider applied to the active sleep time in the mixer thread loop
 static const uint32_t kMaxThreadSleepTimeShift = 2;
 
+// bounds of PlaybackThread::mStandbyScore; each short standby period adds one, each long one
+// removes one: at the maximum the standby delay is tripled, at the minimum it is halved
+static const int kMaxStandbyScore = 4;
+// a standby period is short if it ends within the standby delay, and long if it lasts more than
+// this many times the standby delay
+static const int kLongStandbyFactor = 8;
+
 // minimum normal mix buffer size, expressed in milliseconds rather than frames
 static const uint32_t kMinNormalMixBufferSizeMs = 20;
 // maximum normal mix buffer size
@@ -239,7 +254,10 @@ AudioFlinger::AudioFlinger()
       mMasterMute(false),
       mNextUniqueId(1),
       mMode(AUDIO_MODE_INVALID),
-      mBtNrecIsOff(false)
+      mBtNrecIsOff(false),
+      mNumTracksCreated(0),
+      mCreateTrackTotalNs(0),
+      mCreateTrackMaxNs(0)
 {
 }
 
@@ -339,7 +357,7 @@ status_t AudioFlinger::dumpClients(int fd, const Vector<String16>& args)
     for (size_t i = 0; i < mClients.size(); ++i) {
         sp<Client> client = mClients.valueAt(i).promote();
         if (client != 0) {
-            snprintf(buffer, SIZE, "  pid: %d\n", client->pid());
+            client->dump(buffer, SIZE);
             result.append(buffer);
         }
     }
@@ -368,6 +386,15 @@ status_t AudioFlinger::dumpInternals(int fd, const Vector<String16>& args)
                             hardwareStatus,
                             (uint32_t)(mStandbyTimeInNsecs / 1000000));
     result.append(buffer);
+
+    {
+        Mutex::Autolock _l(mCreateTrackStatsLock);
+        snprintf(buffer, SIZE, "Tracks created: %u, average createTrack %.2f ms, max %.2f ms\n",
+                mNumTracksCreated,
+                mNumTracksCreated > 0 ? mCreateTrackTotalNs * 1e-6 / mNumTracksCreated : 0.0,
+                mCreateTrackMaxNs * 1e-6);
+        result.append(buffer);
+    }
     write(fd, result.string(), result.size());
     return NO_ERROR;
 }
@@ -474,6 +501,7 @@ sp<IAudioTrack> AudioFlinger::createTrack(
         int *sessionId,
         status_t *status)
 {
+    nsecs_t startNs = systemTime();
     sp<PlaybackThread::Track> track;
     sp<TrackHandle> trackHandle;
     sp<Client> client;
@@ -552,6 +580,14 @@ sp<IAudioTrack> AudioFlinger::createTrack(
     }
     if (lStatus == NO_ERROR) {
         trackHandle = new TrackHandle(track);
+
+        nsecs_t elapsedNs = systemTime() - startNs;
+        Mutex::Autolock _l(mCreateTrackStatsLock);
+        mNumTracksCreated++;
+        mCreateTrackTotalNs += elapsedNs;
+        if (elapsedNs > mCreateTrackMaxNs) {
+            mCreateTrackMaxNs = elapsedNs;
+        }
     } else {
         // remove local strong reference to Client before deleting the Track so that the Client
         // destructor is called by the TrackBase destructor with mLock held
@@ -850,6 +886,29 @@ uint32_t AudioFlinger::latency(audio_io_handle_t output) const
     return thread->latency();
 }
 
+status_t AudioFlinger::getOutputConfig(audio_io_handle_t output,
+                                       uint32_t *samplingRate,
+                                       audio_format_t *format,
+                                       audio_channel_mask_t *channelMask,
+                                       size_t *frameCount,
+                                       uint32_t *latency) const
+{
+    Mutex::Autolock _l(mLock);
+    // Direct sessions are not playback threads: callers fall back to the single queries.
+    PlaybackThread *thread = checkPlaybackThread_l(output);
+    if (thread == NULL) {
+        ALOGV("getOutputConfig() unknown thread %d", output);
+        return BAD_VALUE;
+    }
+    // same values as PlaybackThread::audioConfigChanged_l() reports
+    *samplingRate = thread->sampleRate();
+    *format = thread->format();
+    *channelMask = thread->channelMask();
+    *frameCount = thread->frameCount();
+    *latency = thread->latency();
+    return NO_ERROR;
+}
+
 status_t AudioFlinger::setMasterVolume(float value)
 {
     status_t ret = initCheck();
@@ -1682,6 +1741,8 @@ status_t AudioFlinger::ThreadBase::dumpBase(int fd, const Vector<String16>& args
 
     write(fd, result.string(), result.size());
 
+    mCycleProfiler.dump(fd);
+
     if (locked) {
         mLock.unlock();
     }
@@ -1908,6 +1969,28 @@ void AudioFlinger::ThreadBase::checkSuspendOnEffectEnabled_l(const sp<EffectModu
 
 // ----------------------------------------------------------------------------
 
+// Returns the initial mask of available fast track slots; the number of slots is
+// FastMixerState::kDefaultFastTracks unless overridden by ro.audio.fast_track_count.
+static unsigned initialFastTrackAvailMask()
+{
+    unsigned count = FastMixerState::kDefaultFastTracks;
+    char value[PROPERTY_VALUE_MAX];
+    if (property_get("ro.audio.fast_track_count", value, NULL) > 0) {
+        unsigned requested;
+        if (sscanf(value, "%u", &requested) == 1) {
+            if (requested < 2) {
+                requested = 2;
+            } else if (requested > FastMixerState::kMaxFastTracks) {
+                requested = FastMixerState::kMaxFastTracks;
+            }
+            count = requested;
+        }
+    }
+    unsigned mask = count >= 32 ? ~0U : (1U << count) - 1;
+    // index 0 is reserved for normal mixer's submix
+    return mask & ~1;
+}
+
 AudioFlinger::PlaybackThread::PlaybackThread(const sp<AudioFlinger>& audioFlinger,
                                              AudioStreamOut* output,
                                              audio_io_handle_t id,
@@ -1924,12 +2007,13 @@ AudioFlinger::PlaybackThread::PlaybackThread(const sp<AudioFlinger>& audioFlinge
         // but it would be safer to explicitly pass initial masterVolume as parameter
         mMasterVolume(audioFlinger->masterVolumeSW_l()),
         mLastWriteTime(0), mNumWrites(0), mNumDelayedWrites(0), mInWrite(false),
+        mStandbyScore(0), mStandbyCount(0), mWakeupCount(0), mStandbyStartTime(0),
+        mStandbyTotalTime(0),
         mMixerStatus(MIXER_IDLE),
         mMixerStatusIgnoringFastTracks(MIXER_IDLE),
         standbyDelay(AudioFlinger::mStandbyTimeInNsecs),
         mScreenState(gScreenState),
-        // index 0 is reserved for normal mixer's submix
-        mFastTrackAvailMask(((1 << FastMixerState::kMaxFastTracks) - 1) & ~1)
+        mFastTrackAvailMask(initialFastTrackAvailMask())
 {
     snprintf(mName, kNameLength, "AudioOut_%X", id);
 
@@ -2029,6 +2113,16 @@ status_t AudioFlinger::PlaybackThread::dumpInternals(int fd, const Vector<String
     result.append(buffer);
     snprintf(buffer, SIZE, "suspend count: %d\n", mSuspended);
     result.append(buffer);
+    nsecs_t standbyTotalTime = mStandbyTotalTime;
+    if (mStandbyStartTime != 0) {
+        standbyTotalTime += systemTime() - mStandbyStartTime;
+    }
+    snprintf(buffer, SIZE, "standby entries: %u, time in standby (msecs): %llu, wakeups: %u\n",
+            mStandbyCount, ns2ms(standbyTotalTime), mWakeupCount);
+    result.append(buffer);
+    snprintf(buffer, SIZE, "standby score: %d, delay adjustment (msecs): %lld\n",
+            mStandbyScore, ns2ms(standbyDelayAdjust_l()));
+    result.append(buffer);
     snprintf(buffer, SIZE, "mix buffer : %p\n", mMixBuffer);
     result.append(buffer);
     write(fd, result.string(), result.size());
@@ -2039,6 +2133,24 @@ status_t AudioFlinger::PlaybackThread::dumpInternals(int fd, const Vector<String
     return NO_ERROR;
 }
 
+// Returns the amount of time to add to standbyDelay before entering standby, based on the
+// recent history of standby periods and on the tracks still attached to the thread.
+// Must be called with ThreadBase::mLock held.
+nsecs_t AudioFlinger::PlaybackThread::standbyDelayAdjust_l() const
+{
+    if (mStandbyScore > 0) {
+        // standby has recently been exited soon after being entered: the power saved was not
+        // worth the resume latency, so wait longer before the next one
+        return (standbyDelay * mStandbyScore) / 2;
+    }
+    if (mStandbyScore < 0 && mTracks.isEmpty()) {
+        // the output is mostly idle and no client could resume playback without first
+        // creating a track, so enter standby sooner
+        return (standbyDelay * mStandbyScore) / (kMaxStandbyScore * 2);
+    }
+    return 0;
+}
+
 // Thread virtuals
 status_t AudioFlinger::PlaybackThread::readyToRun()
 {
@@ -2135,8 +2247,10 @@ sp<AudioFlinger::PlaybackThread::Track> AudioFlinger::PlaybackThread::createTrac
                 ( (channelMask == AUDIO_CHANNEL_OUT_MONO) ||
                   (channelMask == AUDIO_CHANNEL_OUT_STEREO) ) &&
 #ifndef FAST_TRACKS_AT_NON_NATIVE_SAMPLE_RATE
-                // hardware sample rate
-                (sampleRate == mSampleRate) &&
+                // hardware sample rate, or a rate the fast mixer can convert with the low
+                // quality resampler, which is cheapest within an octave of the hardware rate
+                ((sampleRate == mSampleRate) ||
+                  ((sampleRate <= mSampleRate * 2) && (sampleRate * 2 >= mSampleRate))) &&
 #endif
                 // normal mixer has an associated fast mixer
                 hasFastMixer() &&
@@ -2218,8 +2332,9 @@ sp<AudioFlinger::PlaybackThread::Track> AudioFlinger::PlaybackThread::createTrac
     if ((flags & IAudioFlinger::TRACK_FAST) && (tid != -1)) {
         pid_t callingPid = IPCThreadState::self()->getCallingPid();
         // we don't have CAP_SYS_NICE, nor do we want to have it as it's too powerful,
-        // so ask activity manager to do this on our behalf
-        int err = requestPriority(callingPid, tid, 1);
+        // so ask activity manager to do this on our behalf.
+        // A callback thread that uses more than half a CPU is reported as runaway.
+        int err = requestPriorityWithBudget(callingPid, tid, 1, 50 /*budgetPercent*/);
         if (err != 0) {
             ALOGW("Policy SCHED_FIFO priority %d is unavailable for pid %d tid %d; error %d",
                     1, callingPid, tid, err);
@@ -2610,6 +2725,7 @@ AudioFlinger::MixerThread::MixerThread(const sp<AudioFlinger>& audioFlinger, Aud
         mSoaker(NULL),
 #endif
         // mFastMixer below
+        mAudioWatchdogClient(-1),
         mFastMixerFutex(0)
         // mOutputSink below
         // mPipeSink below
@@ -2620,11 +2736,12 @@ AudioFlinger::MixerThread::MixerThread(const sp<AudioFlinger>& audioFlinger, Aud
             "mFrameCount=%d, mNormalFrameCount=%d",
             mSampleRate, mChannelMask, mChannelCount, mFormat, mFrameSize, mFrameCount,
             mNormalFrameCount);
-    mAudioMixer = new AudioMixer(mNormalFrameCount, mSampleRate);
+    mAudioMixer = new AudioMixer(mNormalFrameCount, mSampleRate, AudioMixer::MAX_NUM_TRACKS,
+            (audio_channel_mask_t)mChannelMask);
 
-    // FIXME - Current mixer implementation only supports stereo output
-    if (mChannelCount == 1) {
-        ALOGE("Invalid audio hardware channel count");
+    // FIXME - Current mixer implementation only supports stereo and multichannel output
+    if (mAudioMixer->channelCount() != mChannelCount) {
+        ALOGE("Invalid audio hardware channel count %u", mChannelCount);
     }
 
     // create an NBAIO sink for the HAL output stream, and negotiate
@@ -2645,7 +2762,8 @@ AudioFlinger::MixerThread::MixerThread(const sp<AudioFlinger>& audioFlinger, Aud
         break;
     case FastMixer_Static:
     case FastMixer_Dynamic:
-        initFastMixer = mFrameCount < mNormalFrameCount;
+        // FastMixer only mixes to stereo
+        initFastMixer = mFrameCount < mNormalFrameCount && mChannelCount == FCC_2;
         break;
     }
     if (initFastMixer) {
@@ -2685,6 +2803,21 @@ AudioFlinger::MixerThread::MixerThread(const sp<AudioFlinger>& audioFlinger, Aud
         mSoaker->run("Soaker", PRIORITY_LOWEST);
 #endif
 
+#ifdef AUDIO_WATCHDOG
+        // create the watchdog, which monitors both the fast mixer and this thread.
+        // FastMixer already runs at SCHED_FIFO priority 2; this thread is boosted to 1 when needed.
+        // A fast mixer cycle of 1.5 periods is close to its 1.75 underrun threshold, while the
+        // MonoPipe hides normal mixer cycles of up to about 3 periods.
+        mAudioWatchdog = new AudioWatchdog();
+        mAudioWatchdog->setDump(&mAudioWatchdogDump);
+        uint32_t fastPeriodNs = (uint32_t) ((mFrameCount * 1000000000LL) / mSampleRate);
+        uint32_t normalPeriodNs = (uint32_t) ((mNormalFrameCount * 1000000000LL) / mSampleRate);
+        int fastMixerWatchdogClient = mAudioWatchdog->addClient("FastMixer",
+                fastPeriodNs, fastPeriodNs + fastPeriodNs / 2, 0 /*boostPriority*/);
+        mAudioWatchdogClient = mAudioWatchdog->addClient("MixerThread",
+                normalPeriodNs, normalPeriodNs * 3, 1 /*boostPriority*/);
+#endif
+
         // create fast mixer and configure it initially with just one fast track for our submix
         mFastMixer = new FastMixer();
         FastMixerStateQueue *sq = mFastMixer->sq();
@@ -2711,6 +2844,10 @@ AudioFlinger::MixerThread::MixerThread(const sp<AudioFlinger>& audioFlinger, Aud
         state->mColdGen++;
         state->mDumpState = &mFastMixerDumpState;
         state->mTeeSink = mTeeSink.get();
+#ifdef AUDIO_WATCHDOG
+        state->mWatchdog = mAudioWatchdog.get();
+        state->mWatchdogClient = fastMixerWatchdogClient;
+#endif
         sq->end();
         sq->push(FastMixerStateQueue::BLOCK_UNTIL_PUSHED);
 
@@ -2726,9 +2863,7 @@ AudioFlinger::MixerThread::MixerThread(const sp<AudioFlinger>& audioFlinger, Aud
 #endif
 
 #ifdef AUDIO_WATCHDOG
-        // create and start the watchdog
-        mAudioWatchdog = new AudioWatchdog();
-        mAudioWatchdog->setDump(&mAudioWatchdogDump);
+        // start the watchdog
         mAudioWatchdog->run("AudioWatchdog", PRIORITY_URGENT_AUDIO);
         tid = mAudioWatchdog->getTid();
         err = requestPriority(getpid_cached, tid, 1);
@@ -2958,7 +3093,8 @@ if (mType == MIXER) {
             saveOutputTracks();
 
             // put audio hardware into standby after short delay
-            if (CC_UNLIKELY((!mActiveTracks.size() && systemTime() > standbyTime) ||
+            if (CC_UNLIKELY((!mActiveTracks.size() &&
+                        systemTime() > standbyTime + standbyDelayAdjust_l()) ||
                         mSuspended > 0)) {
                 if (!mStandby) {
 
@@ -2966,6 +3102,8 @@ if (mType == MIXER) {
 
                     mStandby = true;
                     mBytesWritten = 0;
+                    mStandbyCount++;
+                    mStandbyStartTime = systemTime();
                 }
 
                 if (!mActiveTracks.size() && mConfigEvents.isEmpty()) {
@@ -2981,6 +3119,7 @@ if (mType == MIXER) {
                     ALOGV("%s going to sleep", myName.string());
                     mWaitWorkCV.wait(mLock);
                     ALOGV("%s waking up", myName.string());
+                    mWakeupCount++;
                     acquireWakeLock_l();
 
                     mMixerStatus = MIXER_IDLE;
@@ -3007,8 +3146,10 @@ if (mType == MIXER) {
             lockEffectChains_l(effectChains);
         }
 
+        nsecs_t workStart = systemTime();
         if (CC_LIKELY(mMixerStatus == MIXER_TRACKS_READY)) {
             threadLoop_mix();
+            mCycleProfiler.record(CycleProfiler::MIX, systemTime() - workStart);
         } else {
             threadLoop_sleepTime();
         }
@@ -3029,11 +3170,15 @@ if (mType == MIXER) {
 
         // enable changes in effect chain
         unlockEffectChains(effectChains);
+        nsecs_t workNs = systemTime() - workStart;
 
         // sleepTime == 0 means we must write to audio hardware
         if (sleepTime == 0) {
 
+            nsecs_t lastWriteTime = mLastWriteTime;
+            nsecs_t writeStart = systemTime();
             threadLoop_write();
+            mCycleProfiler.record(CycleProfiler::WRITE, systemTime() - writeStart);
 
 if (mType == MIXER) {
             // write blocked detection
@@ -3041,6 +3186,7 @@ if (mType == MIXER) {
             nsecs_t delta = now - mLastWriteTime;
             if (!mStandby && delta > maxPeriod) {
                 mNumDelayedWrites++;
+                mCycleProfiler.xrun();
                 if ((now - lastWarning) > kWarningThrottleNs) {
 #if defined(ATRACE_TAG) && (ATRACE_TAG != ATRACE_TAG_NEVER)
                     ScopedTrace st(ATRACE_TAG, "underrun");
@@ -3055,11 +3201,32 @@ if (mType == MIXER) {
                     longStandbyExit = true;
                 }
             }
+            if (!mStandby) {
+                threadLoop_reportCycle(workNs, mLastWriteTime - lastWriteTime);
+            }
 }
 
+            if (mStandbyStartTime != 0) {
+                // learn from the length of the standby period which just ended
+                nsecs_t standbyDuration = systemTime() - mStandbyStartTime;
+                mStandbyTotalTime += standbyDuration;
+                mStandbyStartTime = 0;
+                if (standbyDuration < standbyDelay) {
+                    if (mStandbyScore < kMaxStandbyScore) {
+                        mStandbyScore++;
+                    }
+                } else if (standbyDuration > standbyDelay * kLongStandbyFactor) {
+                    if (mStandbyScore > -kMaxStandbyScore) {
+                        mStandbyScore--;
+                    }
+                }
+            }
             mStandby = false;
         } else {
+            nsecs_t sleepStart = systemTime();
             usleep(sleepTime);
+            mCycleProfiler.record(CycleProfiler::SLEEP_OVERSHOOT,
+                    systemTime() - sleepStart - (nsecs_t) sleepTime * 1000);
         }
 
         // Finally let go of removed track(s), without the lock held
@@ -3230,7 +3397,12 @@ void AudioFlinger::MixerThread::threadLoop_mix()
     }
 
     // mix buffers...
-    mAudioMixer->process(pts);
+    {
+#if defined(ATRACE_TAG) && (ATRACE_TAG != ATRACE_TAG_NEVER)
+        ScopedTrace st(ATRACE_TAG, "mix");
+#endif
+        mAudioMixer->process(pts);
+    }
     // increase sleep time progressively when application underrun condition clears.
     // Only increase sleep time if the mixer is ready for two consecutive times to avoid
     // that a steady state of alternating ready/not ready conditions keeps the sleep time
@@ -3498,7 +3670,18 @@ AudioFlinger::PlaybackThread::mixer_state AudioFlinger::MixerThread::prepareTrac
                 ALOG_ASSERT(minFrames <= cblk->frameCount);
             }
         }
-        if ((track->framesReady() >= minFrames) && track->isReady() &&
+        size_t framesReady = track->framesReady();
+#if defined(ATRACE_TAG) && (ATRACE_TAG != ATRACE_TAG_NEVER)
+        if (Tracer::isTagEnabled(ATRACE_TAG)) {
+            // same naming as the fast mixer's, with an 'n' for normal tracks
+            char traceName[16];
+            strcpy(traceName, "nFramesReady");
+            traceName[12] = name + (name < 10 ? '0' : 'A' - 10);
+            traceName[13] = '\0';
+            ATRACE_INT(traceName, framesReady);
+        }
+#endif
+        if ((framesReady >= minFrames) && track->isReady() &&
                 !track->isPaused() && !track->isTerminated())
         {
             //ALOGV("track %d u=%08x, s=%08x [OK] on thread %p", name, cblk->user, cblk->server, this);
@@ -3645,6 +3828,14 @@ AudioFlinger::PlaybackThread::mixer_state AudioFlinger::MixerThread::prepareTrac
                 name,
                 AudioMixer::TRACK,
                 AudioMixer::CHANNEL_MASK, (void *)track->channelMask());
+            // music gets the polyphase sample rate converter, other streams such as
+            // notifications and SoundPool keep the cheaper default one
+            mAudioMixer->setParameter(
+                name,
+                AudioMixer::RESAMPLE,
+                AudioMixer::QUALITY,
+                (void *)(track->streamType() == AUDIO_STREAM_MUSIC ?
+                        AudioResampler::HIGH_POLYPHASE_QUALITY : AudioResampler::DEFAULT));
             mAudioMixer->setParameter(
                 name,
                 AudioMixer::RESAMPLE,
@@ -3788,6 +3979,11 @@ track_is_ready: ;
         memset(mMixBuffer, 0, mNormalFrameCount * mChannelCount * sizeof(int16_t));
     }
 
+#if defined(ATRACE_TAG) && (ATRACE_TAG != ATRACE_TAG_NEVER)
+    ATRACE_INT("mixedTracks", mixedTracks);
+    ATRACE_INT("fastTracks", fastTracks);
+#endif
+
     // if any fast tracks, then status is ready
     mMixerStatusIgnoringFastTracks = mixerStatus;
     if (fastTracks > 0) {
@@ -3952,7 +4148,8 @@ bool AudioFlinger::MixerThread::checkForNewParameters_l()
                 // for safety in case readOutputParameters() accesses mAudioMixer (it doesn't)
                 mAudioMixer = NULL;
                 readOutputParameters();
-                mAudioMixer = new AudioMixer(mNormalFrameCount, mSampleRate);
+                mAudioMixer = new AudioMixer(mNormalFrameCount, mSampleRate,
+                        AudioMixer::MAX_NUM_TRACKS, (audio_channel_mask_t)mChannelMask);
                 for (size_t i = 0; i < mTracks.size() ; i++) {
                     int name = getTrackName_l((audio_channel_mask_t)mTracks[i]->mChannelMask);
                     if (name < 0) break;
@@ -4004,6 +4201,16 @@ status_t AudioFlinger::MixerThread::dumpInternals(int fd, const Vector<String16>
     FastMixerDumpState copy = mFastMixerDumpState;
     copy.dump(fd);
 
+    // The state most recently pushed to the fast mixer, as a secondary observer of its queue
+    if (mFastMixer != NULL) {
+        FastMixerState pushed;
+        if (mFastMixer->sq()->observe(&pushed)) {
+            fdprintf(fd, "FastMixer pushed state: command=%#x trackMask=%#x frameCount=%u "
+                    "fastTracksGen=%d coldGen=%u\n", pushed.mCommand, pushed.mTrackMask,
+                    pushed.mFrameCount, pushed.mFastTracksGen, pushed.mColdGen);
+        }
+    }
+
 #ifdef STATE_QUEUE_DUMP
     // Similar for state queue
     StateQueueObserverDump observerCopy = mStateQueueObserverDump;
@@ -4077,6 +4284,17 @@ status_t AudioFlinger::MixerThread::dumpInternals(int fd, const Vector<String16>
     return NO_ERROR;
 }
 
+void AudioFlinger::MixerThread::threadLoop_reportCycle(nsecs_t workNs, nsecs_t cycleNs)
+{
+    if (mAudioWatchdog != 0 && mAudioWatchdogClient >= 0) {
+        // both are limited to about 4 seconds, as in the watchdog itself
+        const nsecs_t kMaxNs = 4000000000LL;
+        mAudioWatchdog->reportCycle(mAudioWatchdogClient,
+                (uint32_t) (workNs < kMaxNs ? workNs : kMaxNs),
+                (uint32_t) (cycleNs < kMaxNs ? cycleNs : kMaxNs));
+    }
+}
+
 uint32_t AudioFlinger::MixerThread::idleSleepTimeUs() const
 {
     return (uint32_t)(((mNormalFrameCount * 1000) / mSampleRate) * 1000) / 2;
@@ -4615,7 +4833,8 @@ AudioFlinger::ThreadBase::TrackBase::TrackBase(
     }
 
     if (client != NULL) {
-        mCblkMemory = client->heap()->allocate(size);
+        bool zeroed;
+        mCblkMemory = client->allocateTrackMemory(size, &zeroed);
         if (mCblkMemory != 0) {
             mCblk = static_cast<audio_track_cblk_t *>(mCblkMemory->pointer());
             if (mCblk != NULL) { // construct the shared structure in-place.
@@ -4632,36 +4851,38 @@ AudioFlinger::ThreadBase::TrackBase::TrackBase(
                 mChannelMask = channelMask;
                 if (sharedBuffer == 0) {
                     mBuffer = (char*)mCblk + sizeof(audio_track_cblk_t);
+                    if (!zeroed) {
 #ifdef QCOM_HARDWARE
-                    if ((int16_t)flags == 0x1) {
-                        bufferSize = frameCount*channelCount*sizeof(int16_t);
-                    }
-                    else {
-                       if ((format == AUDIO_FORMAT_PCM_16_BIT) ||
-                           (format == AUDIO_FORMAT_PCM_8_BIT))
-                       {
-                          memset(mBuffer, 0, frameCount*channelCount*sizeof(int16_t));
-                       }
-                       else if (format == AUDIO_FORMAT_AMR_NB)
-                       {
-                          memset(mBuffer, 0, frameCount*channelCount*32); // full rate frame size
-                       }
-                       else if (format == AUDIO_FORMAT_EVRC)
-                       {
-                          memset(mBuffer, 0, frameCount*channelCount*23); // full rate frame size
-                       }
-                       else if (format == AUDIO_FORMAT_QCELP)
-                       {
-                          memset(mBuffer, 0, frameCount*channelCount*35); // full rate frame size
-                       }
-                       else if (format == AUDIO_FORMAT_AAC)
-                       {
-                          memset(mBuffer, 0, frameCount*2048); // full rate frame size
-                       }
-                    }
+                        if ((int16_t)flags == 0x1) {
+                            bufferSize = frameCount*channelCount*sizeof(int16_t);
+                        }
+                        else {
+                           if ((format == AUDIO_FORMAT_PCM_16_BIT) ||
+                               (format == AUDIO_FORMAT_PCM_8_BIT))
+                           {
+                              memset(mBuffer, 0, frameCount*channelCount*sizeof(int16_t));
+                           }
+                           else if (format == AUDIO_FORMAT_AMR_NB)
+                           {
+                              memset(mBuffer, 0, frameCount*channelCount*32); // full rate frame size
+                           }
+                           else if (format == AUDIO_FORMAT_EVRC)
+                           {
+                              memset(mBuffer, 0, frameCount*channelCount*23); // full rate frame size
+                           }
+                           else if (format == AUDIO_FORMAT_QCELP)
+                           {
+                              memset(mBuffer, 0, frameCount*channelCount*35); // full rate frame size
+                           }
+                           else if (format == AUDIO_FORMAT_AAC)
+                           {
+                              memset(mBuffer, 0, frameCount*2048); // full rate frame size
+                           }
+                        }
 #else
-                    memset(mBuffer, 0, frameCount*channelCount*sizeof(int16_t));
+                        memset(mBuffer, 0, frameCount*channelCount*sizeof(int16_t));
 #endif
+                    }
                     // Force underrun condition to avoid false underrun callback until first data is
                     // written to buffer (other flags are cleared)
                     mCblk->flags = CBLK_UNDERRUN_ON;
@@ -4707,6 +4928,9 @@ AudioFlinger::ThreadBase::TrackBase::~TrackBase()
             mCblk->~audio_track_cblk_t();   // destroy our shared-structure.
         }
     }
+    if (mClient != 0 && mCblkMemory != 0) {
+        mClient->releaseTrackMemory(mCblkMemory);
+    }
     mCblkMemory.clear();    // free the shared memory before releasing the heap it belongs to
     if (mClient != 0) {
         // Client destructor must run with AudioFlinger mutex locked
@@ -5385,7 +5609,12 @@ AudioFlinger::PlaybackThread::TimedTrack::TimedTrack(
       mTimedSilenceBuffer(NULL),
       mTimedSilenceBufferSize(0),
       mTimedAudioOutputOnTime(false),
-      mMediaTimeTransformValid(false)
+      mMediaTimeTransformValid(false),
+      mMediaTimeTransformGeneration(0),
+      mHeadLocalPTSValid(false),
+      mHeadMediaPTS(0),
+      mHeadLocalPTS(0),
+      mHeadLocalPTSGeneration(0)
 {
     LocalClock lc;
     mLocalTimeFreq = lc.getLocalFreq();
@@ -5460,61 +5689,75 @@ void AudioFlinger::PlaybackThread::TimedTrack::trimTimedBufferQueue_l() {
         }
     }
 
-    size_t trimEnd;
-    for (trimEnd = 0; trimEnd < mTimedBufferQueue.size(); trimEnd++) {
-        int64_t bufEnd;
+    trimTimedBufferQueueBefore_l(mediaTimeNow, "trim");
+}
 
-        if ((trimEnd + 1) < mTimedBufferQueue.size()) {
-            // We have a next buffer.  Just use its PTS as the PTS of the frame
-            // following the last frame in this buffer.  If the stream is sparse
-            // (ie, there are deliberate gaps left in the stream which should be
-            // filled with silence by the TimedAudioTrack), then this can result
-            // in one extra buffer being left un-trimmed when it could have
-            // been.  In general, this is not typical, and we would rather
-            // optimized away the TS calculation below for the more common case
-            // where PTSes are contiguous.
-            bufEnd = mTimedBufferQueue[trimEnd + 1].pts();
+// caller must hold mTimedBufferQueueLock
+void AudioFlinger::PlaybackThread::TimedTrack::trimTimedBufferQueueBefore_l(
+        int64_t mediaTime, const char* logTag) {
+    size_t count = mTimedBufferQueue.size();
+    if (count == 0) {
+        return;
+    }
+
+    // The PTS of the next buffer is used as the PTS of the frame following the
+    // last frame in a buffer.  If the stream is sparse (ie, there are
+    // deliberate gaps left in the stream which should be filled with silence
+    // by the TimedAudioTrack), then this can result in one extra buffer being
+    // left un-trimmed when it could have been.  In general, this is not
+    // typical, and we would rather optimize away the TS calculation below for
+    // the more common case where PTSes are contiguous.  Since the queue is
+    // sorted by PTS, find the first buffer after the head whose PTS is past
+    // mediaTime; every buffer before the one preceding it has ended.
+    size_t lo = 1;
+    size_t hi = count;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (mTimedBufferQueue[mid].pts() > mediaTime) {
+            hi = mid;
         } else {
-            // We have no next buffer.  Compute the PTS of the frame following
-            // the last frame in this buffer by computing the duration of of
-            // this frame in media time units and adding it to the PTS of the
-            // buffer.
-            int64_t frameCount = mTimedBufferQueue[trimEnd].buffer()->size()
-                               / mCblk->frameSize;
-
-            if (!mMediaTimeToSampleTransform.doReverseTransform(frameCount,
-                                                                &bufEnd)) {
-                ALOGE("Failed to convert frame count of %lld to media time"
-                      " duration" " (scale factor %d/%u) in %s",
-                      frameCount,
-                      mMediaTimeToSampleTransform.a_to_b_numer,
-                      mMediaTimeToSampleTransform.a_to_b_denom,
-                      __PRETTY_FUNCTION__);
-                break;
-            }
-            bufEnd += mTimedBufferQueue[trimEnd].pts();
+            lo = mid + 1;
         }
+    }
+    size_t trimEnd = lo - 1;
 
-        if (bufEnd > mediaTimeNow)
-            break;
+    if (trimEnd == count - 1) {
+        // We have no next buffer.  Compute the PTS of the frame following the
+        // last frame in this buffer by computing the duration of of this frame
+        // in media time units and adding it to the PTS of the buffer.
+        int64_t frameCount = mTimedBufferQueue[trimEnd].buffer()->size()
+                           / mCblk->frameSize;
+        int64_t bufEnd;
 
-        // Is the buffer we want to use in the middle of a mix operation right
-        // now?  If so, don't actually trim it.  Just wait for the releaseBuffer
-        // from the mixer which should be coming back shortly.
-        if (!trimEnd && mQueueHeadInFlight) {
-            mTrimQueueHeadOnRelease = true;
+        if (!mMediaTimeToSampleTransform.doReverseTransform(frameCount,
+                                                            &bufEnd)) {
+            ALOGE("Failed to convert frame count of %lld to media time"
+                  " duration" " (scale factor %d/%u) in %s",
+                  frameCount,
+                  mMediaTimeToSampleTransform.a_to_b_numer,
+                  mMediaTimeToSampleTransform.a_to_b_denom,
+                  __PRETTY_FUNCTION__);
+        } else if (bufEnd + mTimedBufferQueue[trimEnd].pts() <= mediaTime) {
+            trimEnd = count;
         }
     }
 
+    // Is the buffer we want to use in the middle of a mix operation right
+    // now?  If so, don't actually trim it.  Just wait for the releaseBuffer
+    // from the mixer which should be coming back shortly.
+    if (trimEnd && mQueueHeadInFlight) {
+        mTrimQueueHeadOnRelease = true;
+    }
+
     size_t trimStart = mTrimQueueHeadOnRelease ? 1 : 0;
     if (trimStart < trimEnd) {
         // Update the bookkeeping for framesReady()
         for (size_t i = trimStart; i < trimEnd; ++i) {
-            updateFramesPendingAfterTrim_l(mTimedBufferQueue[i], "trim");
+            updateFramesPendingAfterTrim_l(mTimedBufferQueue[i], logTag);
         }
 
         // Now actually remove the buffers from the queue.
-        mTimedBufferQueue.removeItemsAt(trimStart, trimEnd);
+        mTimedBufferQueue.removeItemsAt(trimStart, trimEnd - trimStart);
     }
 }
 
@@ -5563,7 +5806,26 @@ status_t AudioFlinger::PlaybackThread::TimedTrack::queueTimedBuffer(
 
     uint32_t bufFrames = buffer->size() / mCblk->frameSize;
     mFramesPendingInQueue += bufFrames;
-    mTimedBufferQueue.add(TimedBuffer(buffer, pts));
+
+    // keep the queue sorted by PTS; buffers normally arrive in order, so check
+    // the tail first and only bisect for the occasional out of order buffer
+    size_t count = mTimedBufferQueue.size();
+    if (count == 0 || mTimedBufferQueue[count - 1].pts() <= pts) {
+        mTimedBufferQueue.add(TimedBuffer(buffer, pts));
+    } else {
+        // never insert in front of a head which is being mixed
+        size_t lo = mQueueHeadInFlight ? 1 : 0;
+        size_t hi = count;
+        while (lo < hi) {
+            size_t mid = lo + (hi - lo) / 2;
+            if (mTimedBufferQueue[mid].pts() > pts) {
+                hi = mid;
+            } else {
+                lo = mid + 1;
+            }
+        }
+        mTimedBufferQueue.insertAt(TimedBuffer(buffer, pts), lo);
+    }
 
     return NO_ERROR;
 }
@@ -5580,10 +5842,19 @@ status_t AudioFlinger::PlaybackThread::TimedTrack::setMediaTimeTransform(
         return BAD_VALUE;
     }
 
-    Mutex::Autolock lock(mMediaTimeTransformLock);
-    mMediaTimeTransform = xform;
-    mMediaTimeTransformTarget = target;
-    mMediaTimeTransformValid = true;
+    {
+        Mutex::Autolock lock(mMediaTimeTransformLock);
+        mMediaTimeTransform = xform;
+        mMediaTimeTransformTarget = target;
+        mMediaTimeTransformValid = true;
+        mMediaTimeTransformGeneration++;
+    }
+
+    // A new transform usually means the clock was re-synchronized or the
+    // stream was seeked, which can leave a long run of queued buffers in the
+    // past; drop them now in bulk instead of one at a time from the mixer.
+    Mutex::Autolock _l(mTimedBufferQueueLock);
+    trimTimedBufferQueue_l();
 
     return NO_ERROR;
 }
@@ -5631,27 +5902,38 @@ status_t AudioFlinger::PlaybackThread::TimedTrack::getNextBuffer(
                 return NO_ERROR;
             }
 
-            int64_t transformedPTS;
-            if (!mMediaTimeTransform.doForwardTransform(head.pts(),
-                                                        &transformedPTS)) {
-                // the transform failed.  this shouldn't happen, but if it does
-                // then just drop this buffer
-                ALOGW("timedGetNextBuffer transform failed");
-                buffer->raw = 0;
-                buffer->frameCount = 0;
-                trimTimedBufferQueueHead_l("getNextBuffer; no transform");
-                return NO_ERROR;
-            }
-
-            if (mMediaTimeTransformTarget == TimedAudioTrack::COMMON_TIME) {
-                if (OK != mCCHelper.commonTimeToLocalTime(transformedPTS,
-                                                          &headLocalPTS)) {
+            if (mHeadLocalPTSValid && mHeadMediaPTS == head.pts() &&
+                    mHeadLocalPTSGeneration == mMediaTimeTransformGeneration) {
+                // the head has not changed since the last mix
+                headLocalPTS = mHeadLocalPTS;
+            } else {
+                int64_t transformedPTS;
+                if (!mMediaTimeTransform.doForwardTransform(head.pts(),
+                                                            &transformedPTS)) {
+                    // the transform failed.  this shouldn't happen, but if it does
+                    // then just drop this buffer
+                    ALOGW("timedGetNextBuffer transform failed");
                     buffer->raw = 0;
                     buffer->frameCount = 0;
-                    return INVALID_OPERATION;
+                    trimTimedBufferQueueHead_l("getNextBuffer; no transform");
+                    return NO_ERROR;
                 }
-            } else {
-                headLocalPTS = transformedPTS;
+
+                if (mMediaTimeTransformTarget == TimedAudioTrack::COMMON_TIME) {
+                    if (OK != mCCHelper.commonTimeToLocalTime(transformedPTS,
+                                                              &headLocalPTS)) {
+                        buffer->raw = 0;
+                        buffer->frameCount = 0;
+                        return INVALID_OPERATION;
+                    }
+                } else {
+                    headLocalPTS = transformedPTS;
+                }
+
+                mHeadLocalPTSValid = true;
+                mHeadMediaPTS = head.pts();
+                mHeadLocalPTS = headLocalPTS;
+                mHeadLocalPTSGeneration = mMediaTimeTransformGeneration;
             }
         }
 
@@ -6247,7 +6529,10 @@ AudioFlinger::Client::Client(const sp<AudioFlinger>& audioFlinger, pid_t pid)
         // FIXME should be a "k" constant not hard-coded, in .h or ro. property, see 4 lines below
         mMemoryDealer(new MemoryDealer(1024*1024, "AudioFlinger::Client")),
         mPid(pid),
-        mTimedTrackCount(0)
+        mTimedTrackCount(0),
+        mPooledTrackMemoryBytes(0),
+        mNumTrackMemoryAllocated(0),
+        mNumTrackMemoryReused(0)
 {
     // 1 MB of address space is good for 32 tracks, 8 buffers each, 4 KB/buffer
 }
@@ -6263,6 +6548,64 @@ sp<MemoryDealer> AudioFlinger::Client::heap() const
     return mMemoryDealer;
 }
 
+// The regions stay in this client's own heap, as they are mapped by the client process;
+// clients that create and destroy tracks back to back, like SoundPool, mostly reuse them.
+sp<IMemory> AudioFlinger::Client::allocateTrackMemory(size_t size, bool *zeroed)
+{
+    Mutex::Autolock _l(mTrackMemoryLock);
+    mNumTrackMemoryAllocated++;
+    for (size_t i = mPooledTrackMemory.size(); i > 0; ) {
+        --i;
+        if (mPooledTrackMemory[i]->size() == size) {
+            sp<IMemory> memory = mPooledTrackMemory[i];
+            mPooledTrackMemory.removeAt(i);
+            mPooledTrackMemoryBytes -= size;
+            mNumTrackMemoryReused++;
+            *zeroed = true;
+            return memory;
+        }
+    }
+
+    *zeroed = false;
+    sp<IMemory> memory = mMemoryDealer->allocate(size);
+    if (memory == 0 && !mPooledTrackMemory.isEmpty()) {
+        // give the pooled regions back to the heap and try again
+        mPooledTrackMemory.clear();
+        mPooledTrackMemoryBytes = 0;
+        memory = mMemoryDealer->allocate(size);
+    }
+    return memory;
+}
+
+void AudioFlinger::Client::releaseTrackMemory(const sp<IMemory>& memory)
+{
+    size_t size = memory->size();
+    // the caller's reference must be the only one, otherwise the region is still in use
+    if (memory->getStrongCount() > 1 || size > kMaxPooledTrackMemorySize) {
+        return;
+    }
+
+    Mutex::Autolock _l(mTrackMemoryLock);
+    // make room by dropping the least recently released regions
+    while (!mPooledTrackMemory.isEmpty() &&
+            (mPooledTrackMemory.size() >= kMaxPooledTrackMemory ||
+             mPooledTrackMemoryBytes + size > kMaxPooledTrackMemoryBytes)) {
+        mPooledTrackMemoryBytes -= mPooledTrackMemory[0]->size();
+        mPooledTrackMemory.removeAt(0);
+    }
+    memset(memory->pointer(), 0, size);
+    mPooledTrackMemory.add(memory);
+    mPooledTrackMemoryBytes += size;
+}
+
+void AudioFlinger::Client::dump(char* buffer, size_t size)
+{
+    Mutex::Autolock _l(mTrackMemoryLock);
+    snprintf(buffer, size, "  pid: %d track memory: %u allocated, %u reused, %u pooled (%u bytes)\n",
+            mPid, mNumTrackMemoryAllocated, mNumTrackMemoryReused,
+            mPooledTrackMemory.size(), mPooledTrackMemoryBytes);
+}
+
 // Reserve one of the limited slots for a timed audio track associated
 // with this client
 bool AudioFlinger::Client::reserveTimedTrack()
@@ -6323,7 +6666,8 @@ AudioFlinger::DirectAudioTrack::DirectAudioTrack(const sp<AudioFlinger>& audioFl
                                                  int output, AudioSessionDescriptor *outputDesc,
                                                  IDirectTrackClient* client, audio_output_flags_t outflag)
     : BnDirectTrack(), mIsPaused(false), mAudioFlinger(audioFlinger), mOutput(output), mOutputDesc(outputDesc),
-      mClient(client), mEffectConfigChanged(false), mKillEffectsThread(false), mFlag(outflag)
+      mClient(client), mEffectConfigChanged(false), mKillEffectsThread(false), mFlag(outflag),
+      mRing(NULL), mKillRingThread(false), mRingThreadAlive(false)
 {
 #ifdef SRS_PROCESSING
     LOGD("SRS_Processing - DirectAudioTrack - OutNotify_Init: %p TID %d\n", this, gettid());
@@ -6347,6 +6691,7 @@ AudioFlinger::DirectAudioTrack::~DirectAudioTrack() {
     SRS_Processing::ProcessOutNotify(SRS_Processing::AUTO, this, false);
 #endif
 
+    requestAndWaitForRingThreadExit();
     if (mFlag & AUDIO_OUTPUT_FLAG_LPA) {
         requestAndWaitForEffectsThreadExit();
         mAudioFlinger->deregisterClient(mAudioFlingerClient);
@@ -6369,6 +6714,7 @@ status_t AudioFlinger::DirectAudioTrack::start() {
     }
     mOutputDesc->mActive = true;
     AudioSystem::startOutput(mOutput, (audio_stream_type_t)mOutputDesc->mStreamType);
+    mRingCv.signal();
     return NO_ERROR;
 }
 
@@ -6414,6 +6760,13 @@ void AudioFlinger::DirectAudioTrack::flush() {
         mEffectsPool.clear();
         mEffectsPool = mBufPool;
     }
+    {
+        Mutex::Autolock _l(mRingLock);
+        if (mRing != NULL) {
+            android_atomic_release_store(android_atomic_acquire_load(&mRing->rear),
+                    &mRing->front);
+        }
+    }
     mOutputDesc->stream->flush(mOutputDesc->stream);
 }
 
@@ -6432,6 +6785,108 @@ int64_t AudioFlinger::DirectAudioTrack::getTimeStamp() {
     return time;
 }
 
+sp<IMemory> AudioFlinger::DirectAudioTrack::allocateRing(size_t size, size_t watermark) {
+    Mutex::Autolock _l(mRingLock);
+    if (mRing != NULL) {
+        ALOGW("allocateRing: ring already allocated");
+        return mRingMemory;
+    }
+    if (size == 0 || size > INT_MAX || watermark > size) {
+        ALOGE("allocateRing: invalid size %u watermark %u", size, watermark);
+        return 0;
+    }
+
+    size_t totalSize = sizeof(direct_track_ring_t) + size;
+    mRingDealer = new MemoryDealer(totalSize, "DirectTrackRing");
+    mRingMemory = mRingDealer->allocate(totalSize);
+    if (mRingMemory == 0) {
+        ALOGE("allocateRing: cannot allocate %u bytes", totalSize);
+        mRingDealer.clear();
+        return 0;
+    }
+    mRing = static_cast<direct_track_ring_t*>(mRingMemory->pointer());
+    memset(mRing, 0, sizeof(direct_track_ring_t));
+    mRing->size = size;
+    mRing->watermark = watermark;
+
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_JOINABLE);
+    mRingThreadAlive = true;
+    ALOGV("Creating Ring Thread, ring size %u watermark %u", size, watermark);
+    pthread_create(&mRingThread, &attr, RingThreadWrapper, this);
+    return mRingMemory;
+}
+
+void AudioFlinger::DirectAudioTrack::signalRing() {
+    Mutex::Autolock _l(mRingLock);
+    if (mRing != NULL) {
+        android_atomic_release_store(0, &mRing->waiting);
+    }
+    mRingCv.signal();
+}
+
+void *AudioFlinger::DirectAudioTrack::RingThreadWrapper(void *me) {
+    static_cast<DirectAudioTrack *>(me)->RingThreadEntry();
+    return NULL;
+}
+
+void AudioFlinger::DirectAudioTrack::RingThreadEntry() {
+    // how long to wait for the HAL to free a buffer, or for a client which missed
+    // the waiting flag
+    const nsecs_t kRingPollNs = 10000000;   // 10 ms
+    const uint8_t* data = reinterpret_cast<const uint8_t*>(mRing + 1);
+
+    mRingLock.lock();
+    while (!mKillRingThread) {
+        int32_t front = mRing->front;
+        uint32_t avail = (uint32_t) (android_atomic_acquire_load(&mRing->rear) - front);
+        if (avail == 0 || mIsPaused || !mOutputDesc->mActive) {
+            android_atomic_release_store(1, &mRing->waiting);
+            // data added before the flag was set would not be signaled
+            if (avail == 0 && android_atomic_acquire_load(&mRing->rear) != front) {
+                android_atomic_release_store(0, &mRing->waiting);
+                continue;
+            }
+            mRingCv.waitRelative(mRingLock, kRingPollNs);
+            continue;
+        }
+        uint32_t offset = (uint32_t) front % mRing->size;
+        size_t bytes = avail < mRing->size - offset ? avail : mRing->size - offset;
+
+        mRingLock.unlock();
+        ssize_t written = write(data + offset, bytes);
+        mRingLock.lock();
+
+        if (written > 0) {
+            // unless the ring was flushed meanwhile
+            if (mRing->front == front) {
+                android_atomic_release_store(front + written, &mRing->front);
+            }
+        } else {
+            if (written < 0) {
+                ALOGE("Ring Thread: write error %d", (int) written);
+            }
+            mRingCv.waitRelative(mRingLock, kRingPollNs);
+        }
+    }
+    mRingLock.unlock();
+    ALOGV("Ring thread is dead");
+    mRingThreadAlive = false;
+}
+
+void AudioFlinger::DirectAudioTrack::requestAndWaitForRingThreadExit() {
+    if (!mRingThreadAlive)
+        return;
+    {
+        Mutex::Autolock _l(mRingLock);
+        mKillRingThread = true;
+        mRingCv.signal();
+    }
+    pthread_join(mRingThread, NULL);
+    ALOGV("ring thread killed");
+}
+
 void AudioFlinger::DirectAudioTrack::postEOS(int64_t delayUs) {
     ALOGV("Notify Audio Track of EOS event");
     mClient->notify(LPA_EOS);
@@ -6882,18 +7337,52 @@ AudioFlinger::RecordThread::RecordThread(const sp<AudioFlinger>& audioFlinger,
 #else
     mReqChannelCount(popcount(channels)),
 #endif
-    mReqSampleRate(sampleRate)
+    mReqSampleRate(sampleRate),
     // mBytesRead is only meaningful while active, and so is cleared in start()
     // (but might be better to also clear here for dump?)
+    mCaptureSinkEnabled(false),
+    mFastCapture(NULL), mFastCaptureFutex(0), mFastCaptureEnabled(false), mFastCapturePollUs(0)
 {
     snprintf(mName, kNameLength, "AudioIn_%X", id);
 
     readInputParameters();
+
+    // the capture pipe is sized for a few HAL buffers and keeps its initial format, so that
+    // readers never see it reallocated; readInputParameters() enables and disables writes to it
+    if (mFormat == AUDIO_FORMAT_PCM_16_BIT) {
+        NBAIO_Format format = Format_from_SR_C(mSampleRate, mChannelCount);
+        if (format != Format_Invalid) {
+            Pipe *pipe = new Pipe(mInputBytes / mFrameSize * 4, format);
+            const NBAIO_Format offers[1] = {format};
+            size_t numCounterOffers = 0;
+            ssize_t index = pipe->negotiate(offers, 1, NULL, numCounterOffers);
+            ALOG_ASSERT(index == 0);
+            mCaptureSink = pipe;
+            mCaptureSinkEnabled = true;
+        }
+    }
+
+    initFastCapture();
 }
 
 
 AudioFlinger::RecordThread::~RecordThread()
 {
+    if (mFastCapture != NULL) {
+        FastCaptureStateQueue *sq = mFastCapture->sq();
+        FastCaptureState *state = sq->begin();
+        if (state->mCommand == FastCaptureState::COLD_IDLE) {
+            int32_t old = android_atomic_inc(&mFastCaptureFutex);
+            if (old == -1) {
+                __futex_syscall3(&mFastCaptureFutex, FUTEX_WAKE_PRIVATE, 1);
+            }
+        }
+        state->mCommand = FastCaptureState::EXIT;
+        sq->end();
+        sq->push(FastCaptureStateQueue::BLOCK_UNTIL_PUSHED);
+        mFastCapture->join();
+        delete mFastCapture;
+    }
     delete[] mRsmpInBuffer;
     delete mResampler;
     delete[] mRsmpOutBuffer;
@@ -6931,7 +7420,7 @@ bool AudioFlinger::RecordThread::threadLoop()
             checkForNewParameters_l();
             if (mActiveTrack == 0 && mConfigEvents.isEmpty()) {
                 if (!mStandby) {
-                    mInput->stream->common.standby(&mInput->stream->common);
+                    inputStandby();
                     mStandby = true;
                 }
 
@@ -6948,7 +7437,7 @@ bool AudioFlinger::RecordThread::threadLoop()
             if (mActiveTrack != 0) {
                 if (mActiveTrack->mState == TrackBase::PAUSING) {
                     if (!mStandby) {
-                        mInput->stream->common.standby(&mInput->stream->common);
+                        inputStandby();
                         mStandby = true;
                     }
                     mActiveTrack.clear();
@@ -7022,7 +7511,7 @@ bool AudioFlinger::RecordThread::threadLoop()
                             if (((int) framesOut != mFrameCount) &&
                                 ((mFormat != AUDIO_FORMAT_PCM_16_BIT)&&
                                   ((audio_source_t)mInputSource != AUDIO_SOURCE_VOICE_COMMUNICATION))) {
-                                mBytesRead = mInput->stream->read(mInput->stream, buffer.raw, buffer.frameCount * mFrameSize);
+                                mBytesRead = readInput(buffer.raw, buffer.frameCount * mFrameSize);
                                 ALOGE("IR mBytesRead = %d",mBytesRead);
                                 if(mBytesRead >= 0 ){
                                   buffer.frameCount = mBytesRead/mFrameSize;
@@ -7039,7 +7528,7 @@ bool AudioFlinger::RecordThread::threadLoop()
                                   mFormat != AUDIO_FORMAT_PCM_16_BIT))
 #endif
                                         {
-                                                mBytesRead = mInput->stream->read(mInput->stream, buffer.raw, mInputBytes);
+                                                mBytesRead = readInput(buffer.raw, mInputBytes);
 #ifdef QCOM_HARDWARE
                                 if( mBytesRead >= 0 ){
                                   buffer.frameCount = mBytesRead/mFrameSize;
@@ -7047,7 +7536,7 @@ bool AudioFlinger::RecordThread::threadLoop()
 #endif
                                 framesOut = 0;
                             } else {
-                                mBytesRead = mInput->stream->read(mInput->stream, mRsmpInBuffer, mInputBytes);
+                                mBytesRead = readInput(mRsmpInBuffer, mInputBytes);
                                 mRsmpInIndex = 0;
                             }
                             if (mBytesRead < 0) {
@@ -7055,7 +7544,7 @@ bool AudioFlinger::RecordThread::threadLoop()
                                 if (mActiveTrack->mState == TrackBase::ACTIVE) {
                                     // Force input into standby so that it tries to
                                     // recover at next read attempt
-                                    mInput->stream->common.standby(&mInput->stream->common);
+                                    inputStandby();
                                     usleep(kRecordThreadSleepUs);
                                 }
                                 mRsmpInIndex = mFrameCount;
@@ -7114,6 +7603,7 @@ bool AudioFlinger::RecordThread::threadLoop()
             // client isn't retrieving buffers fast enough
             else {
                 if (!mActiveTrack->setOverflow()) {
+                    mCycleProfiler.xrun();
                     nsecs_t now = systemTime();
                     if ((now - lastWarning) > kWarningThrottleNs) {
                         ALOGW("RecordThread: buffer overflow");
@@ -7132,7 +7622,10 @@ bool AudioFlinger::RecordThread::threadLoop()
     }
 
     if (!mStandby) {
-        mInput->stream->common.standby(&mInput->stream->common);
+        inputStandby();
+    } else {
+        // the fast capture may still be reading after a read error left the HAL out of standby
+        stopFastCapture();
     }
     mActiveTrack.clear();
 
@@ -7379,6 +7872,12 @@ status_t AudioFlinger::RecordThread::dump(int fd, const Vector<String16>& args)
     }
     write(fd, result.string(), result.size());
 
+    if (mFastCapture != NULL) {
+        // Make a non-atomic copy of fast capture dump state so it won't change underneath us
+        FastCaptureDumpState copy = mFastCaptureDumpState;
+        copy.dump(fd);
+    }
+
     dumpBase(fd, args);
     dumpEffectChains(fd, args);
 
@@ -7392,13 +7891,13 @@ status_t AudioFlinger::RecordThread::getNextBuffer(AudioBufferProvider::Buffer*
     size_t framesReady = mFrameCount - mRsmpInIndex;
     int channelCount;
     if (framesReady == 0) {
-        mBytesRead = mInput->stream->read(mInput->stream, mRsmpInBuffer, mInputBytes);
+        mBytesRead = readInput(mRsmpInBuffer, mInputBytes);
         if (mBytesRead < 0) {
             ALOGE("RecordThread::getNextBuffer() Error reading audio input");
             if (mActiveTrack->mState == TrackBase::ACTIVE) {
                 // Force input into standby so that it tries to
                 // recover at next read attempt
-                mInput->stream->common.standby(&mInput->stream->common);
+                inputStandby();
                 usleep(kRecordThreadSleepUs);
             }
             buffer->raw = NULL;
@@ -7435,6 +7934,10 @@ bool AudioFlinger::RecordThread::checkForNewParameters_l()
     bool reconfig = false;
 
     while (!mNewParameters.isEmpty()) {
+        // the fast capture must not read while the HAL is reconfigured;
+        // the next readInput() restarts it
+        stopFastCapture();
+
         status_t status = NO_ERROR;
         String8 keyValuePair = mNewParameters[0];
         AudioParameter param = AudioParameter(keyValuePair);
@@ -7496,7 +7999,7 @@ bool AudioFlinger::RecordThread::checkForNewParameters_l()
         if (status == NO_ERROR) {
             status = mInput->stream->common.set_parameters(&mInput->stream->common, keyValuePair.string());
             if (status == INVALID_OPERATION) {
-                mInput->stream->common.standby(&mInput->stream->common);
+                inputStandby();
                 status = mInput->stream->common.set_parameters(&mInput->stream->common,
                         keyValuePair.string());
             }
@@ -7569,6 +8072,193 @@ void AudioFlinger::RecordThread::audioConfigChanged_l(int event, int param) {
     mAudioFlinger->audioConfigChanged_l(event, mId, param2);
 }
 
+ssize_t AudioFlinger::RecordThread::readInput(void *buffer, size_t bytes)
+{
+    nsecs_t readStart = systemTime();
+    if (mFastCapture != NULL && mFastCaptureEnabled) {
+        // the fast capture also writes the capture pipe
+        ssize_t bytesRead = readFastCapture(buffer, bytes);
+        mCycleProfiler.record(CycleProfiler::READ, systemTime() - readStart);
+        return bytesRead;
+    }
+    // the fast capture may still be running if the input format changed since it was started
+    stopFastCapture();
+    ssize_t bytesRead = mInput->stream->read(mInput->stream, buffer, bytes);
+    mCycleProfiler.record(CycleProfiler::READ, systemTime() - readStart);
+    if (bytesRead > 0 && mCaptureSinkEnabled) {
+        // the pipe permits overruns, so this never blocks
+        mCaptureSink->write(buffer, bytesRead / mFrameSize);
+    }
+    return bytesRead;
+}
+
+void AudioFlinger::RecordThread::initFastCapture()
+{
+    char value[PROPERTY_VALUE_MAX];
+    if (property_get("ro.audio.fast_capture_frames", value, "0") <= 0) {
+        return;
+    }
+    size_t frameCount = (size_t) atoi(value);
+    size_t halFrameCount = mInputBytes / mFrameSize;
+    if (frameCount == 0 || mFormat != AUDIO_FORMAT_PCM_16_BIT || mChannelCount > FCC_2) {
+        return;
+    }
+    if (frameCount > halFrameCount) {
+        frameCount = halFrameCount;
+    }
+
+    NBAIO_Format format = Format_from_SR_C(mSampleRate, mChannelCount);
+    const NBAIO_Format offers[1] = {format};
+    size_t numCounterOffers = 0;
+    AudioStreamInSource *inputSource = new AudioStreamInSource(mInput->stream);
+    if (format == Format_Invalid ||
+            inputSource->negotiate(offers, 1, NULL, numCounterOffers) != 0) {
+        ALOGW("fast capture is unavailable for input %d", mId);
+        delete inputSource;
+        return;
+    }
+    mInputSource = inputSource;
+
+    // The pipe depth compensates for scheduling latency of this thread, which reads a whole
+    // HAL buffer at a time; the fast capture drops what doesn't fit rather than blocking.
+    MonoPipe *monoPipe = new MonoPipe(halFrameCount * 4, format, false /*writeCanBlock*/);
+    numCounterOffers = 0;
+    ssize_t index = monoPipe->negotiate(offers, 1, NULL, numCounterOffers);
+    ALOG_ASSERT(index == 0);
+    mPipeSink = monoPipe;
+    MonoPipeReader *monoPipeReader = new MonoPipeReader(monoPipe);
+    numCounterOffers = 0;
+    index = monoPipeReader->negotiate(offers, 1, NULL, numCounterOffers);
+    ALOG_ASSERT(index == 0);
+    mPipeSource = monoPipeReader;
+    mFastCaptureEnabled = true;
+    mFastCapturePollUs = (uint32_t) ((frameCount * 500000LL) / mSampleRate);
+
+    // create the fast capture in cold idle; the first readInput() starts it
+    mFastCapture = new FastCapture();
+    FastCaptureStateQueue *sq = mFastCapture->sq();
+    FastCaptureState *state = sq->begin();
+    state->mInputSource = mInputSource.get();
+    state->mInputSourceGen++;
+    state->mPipeSink = mPipeSink.get();
+    state->mPipeSinkGen++;
+    state->mFrameCount = frameCount;
+    state->mCommand = FastCaptureState::COLD_IDLE;
+    // already done in constructor initialization list
+    //mFastCaptureFutex = 0;
+    state->mColdFutexAddr = &mFastCaptureFutex;
+    state->mColdGen++;
+    state->mDumpState = &mFastCaptureDumpState;
+    state->mCaptureSink = mCaptureSinkEnabled ? mCaptureSink.get() : NULL;
+    sq->end();
+    sq->push(FastCaptureStateQueue::BLOCK_UNTIL_PUSHED);
+
+    mFastCapture->run("FastCapture", PRIORITY_URGENT_AUDIO);
+#ifdef HAVE_REQUEST_PRIORITY
+    pid_t tid = mFastCapture->getTid();
+    int err = requestPriority(getpid_cached, tid, 2);
+    if (err != 0) {
+        ALOGW("Policy SCHED_FIFO priority %d is unavailable for pid %d tid %d; error %d",
+                2, getpid_cached, tid, err);
+    }
+#endif
+}
+
+ssize_t AudioFlinger::RecordThread::readFastCapture(void *buffer, size_t bytes)
+{
+    startFastCapture();
+
+    // Callers expect a full buffer, as from a blocking HAL read, so wait for the fast capture
+    // to deliver the rest; it writes one read every 2 * mFastCapturePollUs.
+    size_t framesReq = bytes / mFrameSize;
+    size_t framesRead = 0;
+    uint32_t waitedUs = 0;
+    while (framesRead < framesReq) {
+        ssize_t frames = mPipeSource->read((char *) buffer + framesRead * mFrameSize,
+                framesReq - framesRead);
+        if (frames > 0) {
+            framesRead += frames;
+            continue;
+        }
+        if (waitedUs >= kFastCaptureReadTimeoutUs) {
+            ALOGE("fast capture delivered %u of %u frames in %u us", framesRead, framesReq,
+                    waitedUs);
+            return -EIO;
+        }
+        usleep(mFastCapturePollUs);
+        waitedUs += mFastCapturePollUs;
+    }
+    return framesRead * mFrameSize;
+}
+
+void AudioFlinger::RecordThread::startFastCapture()
+{
+    if (mFastCapture == NULL) {
+        return;
+    }
+    FastCaptureStateQueue *sq = mFastCapture->sq();
+    FastCaptureState *state = sq->begin();
+    if (state->mCommand == FastCaptureState::READ_WRITE) {
+        sq->end(false /*didModify*/);
+        return;
+    }
+
+    // discard what was captured before the last idle, so this thread doesn't return stale audio
+    char discard[256];
+    size_t discardFrames = sizeof(discard) / mFrameSize;
+    while (mPipeSource->read(discard, discardFrames) > 0) {
+    }
+
+    if (state->mCommand == FastCaptureState::COLD_IDLE) {
+        int32_t old = android_atomic_inc(&mFastCaptureFutex);
+        if (old == -1) {
+            __futex_syscall3(&mFastCaptureFutex, FUTEX_WAKE_PRIVATE, 1);
+        }
+    }
+    state->mCommand = FastCaptureState::READ_WRITE;
+    sq->end();
+    sq->push(FastCaptureStateQueue::BLOCK_UNTIL_PUSHED);
+}
+
+void AudioFlinger::RecordThread::stopFastCapture()
+{
+    if (mFastCapture == NULL) {
+        return;
+    }
+    FastCaptureStateQueue *sq = mFastCapture->sq();
+    FastCaptureState *state = sq->begin();
+    if (!(state->mCommand & FastCaptureState::IDLE)) {
+        state->mCommand = FastCaptureState::COLD_IDLE;
+        state->mColdFutexAddr = &mFastCaptureFutex;
+        state->mColdGen++;
+        mFastCaptureFutex = 0;
+        sq->end();
+        // BLOCK_UNTIL_PUSHED would be insufficient, as we need it to stop doing I/O now
+        sq->push(FastCaptureStateQueue::BLOCK_UNTIL_ACKED);
+    } else {
+        sq->end(false /*didModify*/);
+    }
+}
+
+void AudioFlinger::RecordThread::inputStandby()
+{
+    stopFastCapture();
+    mInput->stream->common.standby(&mInput->stream->common);
+}
+
+sp<NBAIO_Source> AudioFlinger::RecordThread::createCaptureReader()
+{
+    if (mCaptureSink == 0) {
+        return 0;
+    }
+    PipeReader *reader = new PipeReader(*(Pipe *) mCaptureSink.get());
+    const NBAIO_Format offers[1] = {mCaptureSink->format()};
+    size_t numCounterOffers = 0;
+    ssize_t index = reader->negotiate(offers, 1, NULL, numCounterOffers);
+    ALOG_ASSERT(index == 0);
+    return reader;
+}
+
 void AudioFlinger::RecordThread::readInputParameters()
 {
     delete mRsmpInBuffer;
@@ -7592,6 +8282,18 @@ void AudioFlinger::RecordThread::readInputParameters()
     mNormalFrameCount = mFrameCount; // not used by record, but used by input effects
     mRsmpInBuffer = new int16_t[mFrameCount * mChannelCount];
 
+    if (mCaptureSink != 0) {
+        mCaptureSinkEnabled = mFormat == AUDIO_FORMAT_PCM_16_BIT &&
+                Format_from_SR_C(mSampleRate, mChannelCount) == mCaptureSink->format();
+    }
+    // the fast capture keeps the pipe and configuration it was created with, so the input is
+    // read directly while its format differs; the HAL buffer size must not have shrunk either
+    if (mPipeSink != 0) {
+        mFastCaptureEnabled = mFormat == AUDIO_FORMAT_PCM_16_BIT &&
+                Format_from_SR_C(mSampleRate, mChannelCount) == mPipeSink->format() &&
+                mInputBytes / mFrameSize * 4 <= ((MonoPipe *) mPipeSink.get())->maxFrames();
+    }
+
     if (mSampleRate != mReqSampleRate && mChannelCount <= FCC_2 && mReqChannelCount <= FCC_2)
     {
         int channelCount;
@@ -9103,7 +9805,8 @@ AudioFlinger::EffectModule::EffectModule(ThreadBase *thread,
                                         int id,
                                         int sessionId)
     : mThread(thread), mChain(chain), mId(id), mSessionId(sessionId), mEffectInterface(NULL),
-      mStatus(NO_INIT), mState(IDLE), mSuspended(false)
+      mStatus(NO_INIT), mState(IDLE), mSuspended(false),
+      mProcessCount(0), mProcessTotalNs(0), mProcessMaxNs(0)
 #ifdef QCOM_HARDWARE
       ,mIsForLPA(false)
 #endif
@@ -9287,6 +9990,20 @@ void AudioFlinger::EffectModule::updateState() {
     }
 }
 
+// Accumulates count samples of in onto out with saturation, as clamp16(out + in) would.
+static void accumulate_i16(int16_t *out, const int16_t *in, size_t count)
+{
+#ifdef __ARM_NEON__
+    for (; count >= 8; count -= 8, in += 8, out += 8) {
+        vst1q_s16(out, vqaddq_s16(vld1q_s16(out), vld1q_s16(in)));
+    }
+#endif
+    for (; count > 0; count--) {
+        *out = clamp16((int32_t)*out + (int32_t)*in++);
+        out++;
+    }
+}
+
 void AudioFlinger::EffectModule::process()
 {
     Mutex::Autolock _l(mLock);
@@ -9306,9 +10023,16 @@ void AudioFlinger::EffectModule::process()
         }
 
         // do the actual processing in the effect engine
+        nsecs_t processStart = systemTime();
         int ret = (*mEffectInterface)->process(mEffectInterface,
                                                &mConfig.inputCfg.buffer,
                                                &mConfig.outputCfg.buffer);
+        nsecs_t processNs = systemTime() - processStart;
+        mProcessCount++;
+        mProcessTotalNs += processNs;
+        if (processNs > mProcessMaxNs) {
+            mProcessMaxNs = processNs;
+        }
 
         // force transition to IDLE state when engine is ready
         if (mState == STOPPED && ret == -ENODATA) {
@@ -9327,11 +10051,7 @@ void AudioFlinger::EffectModule::process()
         sp<EffectChain> chain = mChain.promote();
         if (chain != 0 && chain->activeTrackCnt() != 0) {
             size_t frameCnt = mConfig.inputCfg.buffer.frameCount * 2;  //always stereo here
-            int16_t *in = mConfig.inputCfg.buffer.s16;
-            int16_t *out = mConfig.outputCfg.buffer.s16;
-            for (size_t i = 0; i < frameCnt; i++) {
-                out[i] = clamp16((int32_t)out[i] + (int32_t)in[i]);
-            }
+            accumulate_i16(mConfig.outputCfg.buffer.s16, mConfig.inputCfg.buffer.s16, frameCnt);
         }
     }
 }
@@ -9877,6 +10597,12 @@ status_t AudioFlinger::EffectModule::dump(int fd, const Vector<String16>& args)
             mConfig.outputCfg.format);
     result.append(buffer);
 
+    snprintf(buffer, SIZE, "\t\t- Process: count %u, mean %.3f ms, max %.3f ms\n",
+            mProcessCount,
+            mProcessCount != 0 ? mProcessTotalNs / (mProcessCount * 1000000.0) : 0.0,
+            mProcessMaxNs / 1000000.0);
+    result.append(buffer);
+
     snprintf(buffer, SIZE, "\t\t%d Clients:\n", mHandles.size());
     result.append(buffer);
     result.append("\t\t\tPid   Priority Ctrl Locked client server\n");
@@ -10184,7 +10910,8 @@ AudioFlinger::EffectChain::EffectChain(ThreadBase *thread,
                                         int sessionId)
     : mThread(thread), mSessionId(sessionId), mActiveTrackCnt(0), mTrackCnt(0), mTailBufferCount(0),
       mOwnInBuffer(false), mVolumeCtrlIdx(-1), mLeftVolume(UINT_MAX), mRightVolume(UINT_MAX),
-      mNewLeftVolume(UINT_MAX), mNewRightVolume(UINT_MAX)
+      mNewLeftVolume(UINT_MAX), mNewRightVolume(UINT_MAX),
+      mProcessCount(0), mProcessTotalNs(0), mProcessMaxNs(0)
 #ifdef QCOM_HARDWARE
       ,mIsForLPATrack(false)
 #endif
@@ -10317,9 +11044,16 @@ void AudioFlinger::EffectChain::process_l()
 #else
     if (doProcess) {
 #endif
+        nsecs_t processStart = systemTime();
         for (size_t i = 0; i < size; i++) {
             mEffects[i]->process();
         }
+        nsecs_t processNs = systemTime() - processStart;
+        mProcessCount++;
+        mProcessTotalNs += processNs;
+        if (processNs > mProcessMaxNs) {
+            mProcessMaxNs = processNs;
+        }
     }
     for (size_t i = 0; i < size; i++) {
         mEffects[i]->updateState();
@@ -10571,6 +11305,12 @@ status_t AudioFlinger::EffectChain::dump(int fd, const Vector<String16>& args)
             (uint32_t)mOutBuffer,
             mActiveTrackCnt);
     result.append(buffer);
+    // cost of the whole chain, including idle insert effects accumulating their input
+    snprintf(buffer, SIZE, "\tProcess: count %u, mean %.3f ms, max %.3f ms\n",
+            mProcessCount,
+            mProcessCount != 0 ? mProcessTotalNs / (mProcessCount * 1000000.0) : 0.0,
+            mProcessMaxNs / 1000000.0);
+    result.append(buffer);
     write(fd, result.string(), result.size());
 
     for (size_t i = 0; i < mEffects.size(); ++i) {
@@ -52,9 +52,11 @@
 
 #include "AudioBufferProvider.h"
 #include "ExtendedAudioBufferProvider.h"
+#include "FastCapture.h"
 #include "FastMixer.h"
 #include "NBAIO.h"
 #include "AudioWatchdog.h"
+#include "CycleProfiler.h"
 
 #include <powermanager/IPowerManager.h>
 #include <utils/List.h>
@@ -135,6 +137,12 @@ public:
     virtual     audio_format_t format(audio_io_handle_t output) const;
     virtual     size_t      frameCount(audio_io_handle_t output) const;
     virtual     uint32_t    latency(audio_io_handle_t output) const;
+    virtual     status_t    getOutputConfig(audio_io_handle_t output,
+                                            uint32_t *samplingRate,
+                                            audio_format_t *format,
+                                            audio_channel_mask_t *channelMask,
+                                            size_t *frameCount,
+                                            uint32_t *latency) const;
 
     virtual     status_t    setMasterVolume(float value);
     virtual     status_t    setMasterMute(bool muted);
@@ -324,6 +332,16 @@ private:
         bool reserveTimedTrack();
         void releaseTimedTrack();
 
+        // Allocates a track's control block and buffer from heap(), reusing the
+        // region of an earlier track of the same size if one was kept. Such a
+        // region is already zeroed, which *zeroed reports.
+        sp<IMemory>         allocateTrackMemory(size_t size, bool *zeroed);
+        // Zeroes and keeps a track's region for the next track of the same size,
+        // unless the pool is full or the region is still mapped by the client.
+        void                releaseTrackMemory(const sp<IMemory>& memory);
+
+        void                dump(char* buffer, size_t size);
+
     private:
                             Client(const Client&);
                             Client& operator = (const Client&);
@@ -333,6 +351,16 @@ private:
 
         Mutex               mTimedTrackLock;
         int                 mTimedTrackCount;
+
+        static const size_t kMaxPooledTrackMemory = 4;
+        static const size_t kMaxPooledTrackMemorySize = 64 * 1024;
+        static const size_t kMaxPooledTrackMemoryBytes = 128 * 1024;
+
+        Mutex               mTrackMemoryLock;
+        Vector< sp<IMemory> > mPooledTrackMemory;   // most recently released last
+        size_t              mPooledTrackMemoryBytes;
+        uint32_t            mNumTrackMemoryAllocated;
+        uint32_t            mNumTrackMemoryReused;
     };
 
     // --- Notification Client ---
@@ -535,6 +563,7 @@ private:
                     type_t      type() const { return mType; }
                     uint32_t    sampleRate() const { return mSampleRate; }
                     int         channelCount() const { return mChannelCount; }
+                    uint32_t    channelMask() const { return mChannelMask; }
                     audio_format_t format() const { return mFormat; }
                     // Called by AudioFlinger::frameCount(audio_io_handle_t output) and effects,
                     // and returns the normal mix buffer's frame count.  No API for HAL frame count.
@@ -711,6 +740,8 @@ private:
                     // list of suspended effects per session and per type. The first vector is
                     // keyed by session ID, the second by type UUID timeLow field
                     KeyedVector< int, KeyedVector< int, sp<SuspendedSessionDesc> > >  mSuspendedSessions;
+                    // timing statistics of threadLoop, only updated by the thread itself
+                    CycleProfiler           mCycleProfiler;
     };
 
     struct  stream_type_t {
@@ -917,6 +948,9 @@ private:
             void timedYieldSilence_l(uint32_t numFrames,
                                      AudioBufferProvider::Buffer* buffer);
             void trimTimedBufferQueue_l();
+            // drops, in one pass, the buffers which end at or before the given media
+            // time; the queue is sorted by PTS, so the trim point is found by bisection
+            void trimTimedBufferQueueBefore_l(int64_t mediaTime, const char* logTag);
             void trimTimedBufferQueueHead_l(const char* logTag);
             void updateFramesPendingAfterTrim_l(const TimedBuffer& buf,
                                                 const char* logTag);
@@ -941,6 +975,15 @@ private:
             LinearTransform     mMediaTimeTransform;
             bool                mMediaTimeTransformValid;
             TimedAudioTrack::TargetTimeline mMediaTimeTransformTarget;
+            // incremented each time mMediaTimeTransform is set
+            uint32_t            mMediaTimeTransformGeneration;
+
+            // local time PTS of the queue head, so that the transforms are done once per
+            // buffer rather than once per mix; protected by mTimedBufferQueueLock
+            bool                mHeadLocalPTSValid;
+            int64_t             mHeadMediaPTS;
+            int64_t             mHeadLocalPTS;
+            uint32_t            mHeadLocalPTSGeneration;
         };
 
 
@@ -1007,6 +1050,9 @@ protected:
         virtual     void        threadLoop_write();
         virtual     void        threadLoop_standby();
         virtual     void        threadLoop_removeTracks(const Vector< sp<Track> >& tracksToRemove);
+                    // called after each write; workNs is the time spent mixing and in effects,
+                    // cycleNs the time since the previous write
+        virtual     void        threadLoop_reportCycle(nsecs_t workNs, nsecs_t cycleNs) { }
 
                     // prepareTracks_l reads and writes mActiveTracks, and returns
                     // the pending set of tracks to remove via Vector 'tracksToRemove'.  The caller
@@ -1134,6 +1180,14 @@ public:
         int                             mNumDelayedWrites;
         bool                            mInWrite;
 
+        // adaptive standby delay, see standbyDelayAdjust_l(), and standby statistics for dumpsys
+        nsecs_t                         standbyDelayAdjust_l() const;
+        int                             mStandbyScore;      // > 0 if recent standbys were short
+        uint32_t                        mStandbyCount;      // standby entries by threadLoop
+        uint32_t                        mWakeupCount;       // threadLoop wakeups from mWaitWorkCV
+        nsecs_t                         mStandbyStartTime;  // 0 if not in standby from threadLoop
+        nsecs_t                         mStandbyTotalTime;  // time in standby, excluding current
+
         // FIXME rename these former local variables of threadLoop to standard "m" names
         nsecs_t                         standbyTime;
         size_t                          mixBufferSize;
@@ -1215,6 +1269,7 @@ public:
         virtual     void        threadLoop_mix();
         virtual     void        threadLoop_sleepTime();
         virtual     void        threadLoop_removeTracks(const Vector< sp<Track> >& tracksToRemove);
+        virtual     void        threadLoop_reportCycle(nsecs_t workNs, nsecs_t cycleNs);
         virtual     uint32_t    correctLatency(uint32_t latency) const;
 
                     AudioMixer* mAudioMixer;    // normal mixer
@@ -1225,6 +1280,7 @@ public:
                     // one-time initialization, no locks required
                     FastMixer*  mFastMixer;         // non-NULL if there is also a fast mixer
                     sp<AudioWatchdog> mAudioWatchdog; // non-0 if there is an audio watchdog thread
+                    int         mAudioWatchdogClient;   // our client index in mAudioWatchdog
 
                     // contents are not guaranteed to be consistent, no locks required
                     FastMixerDumpState mFastMixerDumpState;
@@ -1361,6 +1417,8 @@ private:
         virtual ssize_t     write(const void *buffer, size_t bytes);
         virtual void        setVolume(float left, float right);
         virtual int64_t     getTimeStamp();
+        virtual sp<IMemory> allocateRing(size_t size, size_t watermark);
+        virtual void        signalRing();
         virtual void        postEOS(int64_t delayUs);
 
         virtual status_t    onTransact(
@@ -1429,6 +1487,21 @@ private:
         bool mEffectsThreadAlive;
         bool mEffectConfigChanged;
 
+        //******Ring mode*************
+        // in ring mode the client writes into mRing and this thread writes to the HAL,
+        // so that no transaction is needed per buffer
+        static void *RingThreadWrapper(void *me);
+        void RingThreadEntry();
+        void requestAndWaitForRingThreadExit();
+        sp<MemoryDealer> mRingDealer;
+        sp<IMemory> mRingMemory;
+        direct_track_ring_t* mRing;
+        Condition mRingCv;
+        Mutex mRingLock;
+        pthread_t mRingThread;
+        bool mKillRingThread;
+        bool mRingThreadAlive;
+
         //Structure to recieve the Effect notification from the flinger.
         class AudioFlingerDirectTrackClient: public IBinder::DeathRecipient, public BnAudioFlingerClient {
         public:
@@ -1562,6 +1635,12 @@ private:
                 AudioStreamIn* clearInput();
                 virtual audio_stream_t* stream() const;
 
+                // Returns a new reader of the data read from the input stream, before any
+                // resampling or channel conversion; all readers share one ring buffer and each
+                // has its own cursor.  Returns 0 if the input format is not 16-bit mono or stereo.
+                // The reader must be released before the RecordThread is destroyed.
+                sp<NBAIO_Source> createCaptureReader();
+
         // AudioBufferProvider interface
         virtual status_t    getNextBuffer(AudioBufferProvider::Buffer* buffer, int64_t pts);
         virtual void        releaseBuffer(AudioBufferProvider::Buffer* buffer);
@@ -1586,6 +1665,19 @@ private:
     private:
                 void clearSyncStartEvent();
 
+                // reads from the input stream and records the time spent blocked in read
+                ssize_t readInput(void *buffer, size_t bytes);
+
+                // creates the fast capture thread if enabled by property ro.audio.fast_capture_frames
+                void    initFastCapture();
+                // reads from the fast capture pipe, waiting until the request is filled
+                ssize_t readFastCapture(void *buffer, size_t bytes);
+                // starts or cold idles the fast capture thread; no-ops if there is none
+                void    startFastCapture();
+                void    stopFastCapture();
+                // stops the fast capture thread, which must not be reading, then puts the HAL in standby
+                void    inputStandby();
+
                 RecordThread();
                 AudioStreamIn                       *mInput;
                 RecordTrack*                        mTrack;
@@ -1609,6 +1701,21 @@ private:
 #ifdef QCOM_HARDWARE
                 int16_t                             mInputSource;
 #endif
+                // a Pipe which receives a copy of every successful read from the input stream,
+                // allocated once and only written while the input format matches its format
+                sp<NBAIO_Sink>                      mCaptureSink;
+                bool                                mCaptureSinkEnabled;
+
+                // when non-NULL, reads the HAL at SCHED_FIFO priority into mPipeSink, which this
+                // thread reads through mPipeSource while the input format matches the pipe format
+                FastCapture*                        mFastCapture;
+                int32_t                             mFastCaptureFutex;  // for cold idle
+                FastCaptureDumpState                mFastCaptureDumpState;
+                sp<NBAIO_Source>                    mInputSource;
+                sp<NBAIO_Sink>                      mPipeSink;
+                sp<NBAIO_Source>                    mPipeSource;
+                bool                                mFastCaptureEnabled;
+                uint32_t                            mFastCapturePollUs; // half a fast capture read
     };
 
     // server side of the client's IAudioRecord
@@ -1755,6 +1862,9 @@ mutable Mutex               mLock;      // mutex for process, commands and handl
                                         // sending disable command.
         uint32_t mDisableWaitCnt;       // current process() calls count during disable period.
         bool     mSuspended;            // effect is suspended: temporarily disabled by framework
+        uint32_t mProcessCount;         // number of calls to the engine process() since creation
+        nsecs_t  mProcessTotalNs;       // total time spent in the engine process()
+        nsecs_t  mProcessMaxNs;         // longest engine process() call
 #ifdef QCOM_HARDWARE
         bool     mIsForLPA;
 #endif
@@ -1966,6 +2076,9 @@ mutable Mutex               mLock;      // mutex for process, commands and handl
         uint32_t mNewLeftVolume;       // new volume on left channel
         uint32_t mNewRightVolume;      // new volume on right channel
         uint32_t mStrategy; // strategy for this effect chain
+        uint32_t mProcessCount;     // number of process_l() calls which processed effects
+        nsecs_t mProcessTotalNs;    // total time spent processing effects in process_l()
+        nsecs_t mProcessMaxNs;      // longest process_l() call
 #ifdef QCOM_HARDWARE
         bool     mIsForLPATrack;
 #endif
@@ -2137,6 +2250,12 @@ mutable Mutex               mLock;      // mutex for process, commands and handl
                 Vector < sp<SyncEvent> > mPendingSyncEvents; // sync events awaiting for a session
                                                              // to be created
 
+                // createTrack() latency, from the binder call to the returned handle
+                Mutex                               mCreateTrackStatsLock;
+                uint32_t                            mNumTracksCreated;
+                nsecs_t                             mCreateTrackTotalNs;
+                nsecs_t                             mCreateTrackMaxNs;
+
 private:
     sp<Client>  registerPid_l(pid_t pid);    // always returns non-0
 
@@ -28,6 +28,7 @@
 
 #include <cutils/bitops.h>
 #include <cutils/compiler.h>
+#include <cutils/properties.h>
 #include <utils/Debug.h>
 
 #include <system/audio.h>
@@ -40,6 +41,10 @@
 
 #include "AudioMixer.h"
 
+#ifdef __ARM_NEON__
+#include <arm_neon.h>
+#endif
+
 namespace android {
 
 // ----------------------------------------------------------------------------
@@ -91,10 +96,13 @@ void AudioMixer::DownmixerBufferProvider::releaseBuffer(AudioBufferProvider::Buf
 // ----------------------------------------------------------------------------
 bool AudioMixer::isMultichannelCapable = false;
 
+bool AudioMixer::isNeonCapable = false;
+
 effect_descriptor_t AudioMixer::dwnmFxDesc;
 
-AudioMixer::AudioMixer(size_t frameCount, uint32_t sampleRate, uint32_t maxNumTracks)
-    :   mTrackNames(0), mConfiguredNames((1 << maxNumTracks) - 1), mSampleRate(sampleRate)
+AudioMixer::AudioMixer(size_t frameCount, uint32_t sampleRate, uint32_t maxNumTracks,
+        audio_channel_mask_t channelMask)
+    :   mTrackNames(0), mConfiguredNames(maxNumTracks >= 32 ? ~0 : (1 << maxNumTracks) - 1), mSampleRate(sampleRate)
 {
     // AudioMixer is not yet capable of multi-channel beyond stereo
     COMPILE_TIME_ASSERT_FUNCTION_SCOPE(2 == MAX_NUM_CHANNELS);
@@ -104,13 +112,29 @@ AudioMixer::AudioMixer(size_t frameCount, uint32_t sampleRate, uint32_t maxNumTr
 
     LocalClock lc;
 
+#ifdef __ARM_NEON__
+    char value[PROPERTY_VALUE_MAX];
+    property_get("af.mixer.neon", value, "1");
+    isNeonCapable = atoi(value) != 0;
+    ALOGV("NEON track hooks %s", isNeonCapable ? "enabled" : "disabled");
+#endif
+
     mState.enabledTracks= 0;
     mState.needsChanged = 0;
     mState.frameCount   = frameCount;
     mState.hook         = process__nop;
     mState.outputTemp   = NULL;
     mState.resampleTemp = NULL;
-    // mState.reserved
+    // the output is written as pairs of 16-bit samples, so the channel count must be even
+    uint32_t channelCount = popcount(channelMask);
+    if (channelCount < MAX_NUM_CHANNELS || channelCount > MAX_NUM_OUT_CHANNELS ||
+            (channelCount & 1)) {
+        ALOGE("AudioMixer() unsupported output channel mask 0x%x, using stereo", channelMask);
+        channelMask = AUDIO_CHANNEL_OUT_STEREO;
+        channelCount = MAX_NUM_CHANNELS;
+    }
+    mState.channelCount = channelCount;
+    mState.channelMask  = channelMask;
 
     // FIXME Most of the following initialization is probably redundant since
     // tracks[i] should only be referenced if (mTrackNames & (1 << i)) != 0
@@ -194,13 +218,14 @@ int AudioMixer::getTrackName(audio_channel_mask_t channelMask)
         t->hook = NULL;
         t->in = NULL;
         t->resampler = NULL;
+        t->resamplerQuality = AudioResampler::DEFAULT;
         t->sampleRate = mSampleRate;
         // setParameter(name, TRACK, MAIN_BUFFER, mixBuffer) is required before enable(name)
         t->mainBuffer = NULL;
         t->auxBuffer = NULL;
         // see t->localTimeFreq in constructor above
 
-        status_t status = initTrackDownmix(&mState.tracks[n], n, channelMask);
+        status_t status = initTrackDownmix(&mState.tracks[n], n, channelMask, mState.channelMask);
         if (status == OK) {
             return TRACK0 + n;
         }
@@ -218,12 +243,17 @@ void AudioMixer::invalidateState(uint32_t mask)
     }
  }
 
-status_t AudioMixer::initTrackDownmix(track_t* pTrack, int trackNum, audio_channel_mask_t mask)
+status_t AudioMixer::initTrackDownmix(track_t* pTrack, int trackNum, audio_channel_mask_t mask,
+        audio_channel_mask_t outMask)
 {
     uint32_t channelCount = popcount(mask);
     ALOG_ASSERT((channelCount <= MAX_NUM_CHANNELS_TO_DOWNMIX) && channelCount);
     status_t status = OK;
-    if (channelCount > MAX_NUM_CHANNELS) {
+    // a multichannel output mixes the track natively if it has all the track channels,
+    // a resampled multichannel track is downmixed when its resampler is created
+    if (channelCount > MAX_NUM_CHANNELS &&
+            (popcount(outMask) <= MAX_NUM_CHANNELS || (mask & ~outMask) != 0 ||
+             pTrack->resampler != NULL)) {
         pTrack->channelMask = mask;
         pTrack->channelCount = channelCount;
         ALOGV("initTrackDownmix(track=%d, mask=0x%x) calls prepareTrackForDownmix()",
@@ -419,7 +449,7 @@ void AudioMixer::setParameter(int name, int target, int param, void *value)
                 track.channelMask = mask;
                 track.channelCount = channelCount;
                 // the mask has changed, does this track need a downmixer?
-                initTrackDownmix(&mState.tracks[name], name, mask);
+                initTrackDownmix(&mState.tracks[name], name, mask, mState.channelMask);
                 ALOGV("setParameter(TRACK, CHANNEL_MASK, %x)", mask);
                 invalidateState(1 << name);
             }
@@ -454,6 +484,13 @@ void AudioMixer::setParameter(int name, int target, int param, void *value)
         switch (param) {
         case SAMPLE_RATE:
             ALOG_ASSERT(valueInt > 0, "bad sample rate %d", valueInt);
+            // AudioResampler is limited to stereo, so a track which is mixed natively
+            // by the multichannel path must go through the downmixer to be resampled
+            if (track.channelCount > MAX_NUM_CHANNELS && track.downmixerBufferProvider == NULL &&
+                    uint32_t(valueInt) != mSampleRate) {
+                ALOGV("setParameter(RESAMPLE, SAMPLE_RATE) track %d needs downmix", name);
+                prepareTrackForDownmix(&track, name);
+            }
             if (track.setResampler(uint32_t(valueInt), mSampleRate)) {
                 ALOGV("setParameter(RESAMPLE, SAMPLE_RATE, %u)",
                         uint32_t(valueInt));
@@ -470,6 +507,21 @@ void AudioMixer::setParameter(int name, int target, int param, void *value)
             track.sampleRate = mSampleRate;
             invalidateState(1 << name);
             break;
+        case QUALITY:
+            if (track.resamplerQuality != valueInt) {
+                ALOGV("setParameter(RESAMPLE, QUALITY, %d)", valueInt);
+                track.resamplerQuality = valueInt;
+                if (track.resampler != NULL) {
+                    // recreate the converter at the current track sample rate
+                    const uint32_t sampleRate = track.sampleRate;
+                    delete track.resampler;
+                    track.resampler = NULL;
+                    track.sampleRate = mSampleRate;
+                    track.setResampler(sampleRate, mSampleRate);
+                    invalidateState(1 << name);
+                }
+            }
+            break;
         default:
             LOG_FATAL("bad param");
         }
@@ -538,7 +590,7 @@ bool AudioMixer::track_t::setResampler(uint32_t value, uint32_t devSampleRate)
                         format,
                         // the resampler sees the number of channels after the downmixer, if any
                         downmixerBufferProvider != NULL ? MAX_NUM_CHANNELS : channelCount,
-                        devSampleRate);
+                        devSampleRate, resamplerQuality);
                 resampler->setLocalTimeFreq(localTimeFreq);
             }
             return true;
@@ -566,6 +618,46 @@ void AudioMixer::track_t::adjustVolumeRamp(bool aux)
     }
 }
 
+// Computes the channel routing used by the multichannel hooks: each mixer output channel
+// receives the track channel at the same position if any (mono feeds both front channels),
+// with the left volume for left channels, the right volume for right channels and the
+// average of both for the others (center, LFE...).
+void AudioMixer::track_t::mapChannels(audio_channel_mask_t outMask)
+{
+    static const uint32_t kLeftChannels = AUDIO_CHANNEL_OUT_FRONT_LEFT |
+            AUDIO_CHANNEL_OUT_BACK_LEFT | AUDIO_CHANNEL_OUT_FRONT_LEFT_OF_CENTER |
+            AUDIO_CHANNEL_OUT_SIDE_LEFT | AUDIO_CHANNEL_OUT_TOP_FRONT_LEFT |
+            AUDIO_CHANNEL_OUT_TOP_BACK_LEFT;
+    static const uint32_t kRightChannels = AUDIO_CHANNEL_OUT_FRONT_RIGHT |
+            AUDIO_CHANNEL_OUT_BACK_RIGHT | AUDIO_CHANNEL_OUT_FRONT_RIGHT_OF_CENTER |
+            AUDIO_CHANNEL_OUT_SIDE_RIGHT | AUDIO_CHANNEL_OUT_TOP_FRONT_RIGHT |
+            AUDIO_CHANNEL_OUT_TOP_BACK_RIGHT;
+
+    // the resampler always outputs stereo, and so does the downmixer
+    uint32_t inMask = channelMask;
+    if (resampler != NULL || downmixerBufferProvider != NULL) {
+        inMask = AUDIO_CHANNEL_OUT_STEREO;
+    }
+    mapInChannelCount = popcount(inMask);
+
+    uint32_t out = 0;
+    for (uint32_t bit = 1; bit != 0 && bit <= outMask && out < MAX_NUM_OUT_CHANNELS; bit <<= 1) {
+        if (!(outMask & bit)) {
+            continue;
+        }
+        int8_t in = -1;
+        if (inMask & bit) {
+            in = popcount(inMask & (bit - 1));
+        } else if (inMask == AUDIO_CHANNEL_OUT_MONO && bit == AUDIO_CHANNEL_OUT_FRONT_RIGHT) {
+            in = 0;
+        }
+        channelMap[out] = in;
+        channelVolume[out] = (bit & kLeftChannels) ? 0 : ((bit & kRightChannels) ? 1 : 2);
+        out++;
+    }
+    mapOutChannelCount = out;
+}
+
 size_t AudioMixer::getUnreleasedFrames(int name) const
 {
     name -= TRACK0;
@@ -575,6 +667,19 @@ size_t AudioMixer::getUnreleasedFrames(int name) const
     return 0;
 }
 
+const char* AudioMixer::hookName() const
+{
+    if (mState.hook == process__validate) return "validate";
+    if (mState.hook == process__nop) return "nop";
+    if (mState.hook == process__genericNoResampling) return "genericNoResampling";
+    if (mState.hook == process__genericResampling) return "genericResampling";
+    if (mState.hook == process__genericMultichannel) return "genericMultichannel";
+    if (mState.hook == process__OneTrack16BitsStereoNoResampling) {
+        return "OneTrack16BitsStereoNoResampling";
+    }
+    return "unknown";
+}
+
 void AudioMixer::setBufferProvider(int name, AudioBufferProvider* bufferProvider)
 {
     name -= TRACK0;
@@ -627,6 +732,7 @@ void AudioMixer::process__validate(state_t* state, int64_t pts)
     state->enabledTracks |=  enabled;
 
     // compute everything we need...
+    const bool multichannel = state->channelCount > MAX_NUM_CHANNELS;
     int countActiveTracks = 0;
     bool all16BitsStereoNoResample = true;
     bool resampling = false;
@@ -655,6 +761,15 @@ void AudioMixer::process__validate(state_t* state, int64_t pts)
 
         if ((n & NEEDS_MUTE__MASK) == NEEDS_MUTE_ENABLED) {
             t.hook = track__nop;
+        } else if (multichannel) {
+            all16BitsStereoNoResample = false;
+            t.mapChannels(state->channelMask);
+            if ((n & NEEDS_RESAMPLE__MASK) == NEEDS_RESAMPLE_ENABLED) {
+                resampling = true;
+                t.hook = track__genericResampleMultichannel;
+            } else {
+                t.hook = track__16BitsMultichannel;
+            }
         } else {
             if ((n & NEEDS_AUX__MASK) == NEEDS_AUX_ENABLED) {
                 all16BitsStereoNoResample = false;
@@ -668,10 +783,20 @@ void AudioMixer::process__validate(state_t* state, int64_t pts)
             } else {
                 if ((n & NEEDS_CHANNEL_COUNT__MASK) == NEEDS_CHANNEL_1){
                     t.hook = track__16BitsMono;
+#ifdef __ARM_NEON__
+                    if (isNeonCapable) {
+                        t.hook = track__16BitsMonoNeon;
+                    }
+#endif
                     all16BitsStereoNoResample = false;
                 }
                 if ((n & NEEDS_CHANNEL_COUNT__MASK) >= NEEDS_CHANNEL_2){
                     t.hook = track__16BitsStereo;
+#ifdef __ARM_NEON__
+                    if (isNeonCapable) {
+                        t.hook = track__16BitsStereoNeon;
+                    }
+#endif
                     ALOGV_IF((n & NEEDS_CHANNEL_COUNT__MASK) > NEEDS_CHANNEL_2,
                             "Track %d needs downmix", i);
                 }
@@ -681,7 +806,16 @@ void AudioMixer::process__validate(state_t* state, int64_t pts)
 
     // select the processing hooks
     state->hook = process__nop;
-    if (countActiveTracks) {
+    if (countActiveTracks && multichannel) {
+        // the multichannel path always mixes the whole buffer at once
+        if (!state->outputTemp) {
+            state->outputTemp = new int32_t[MAX_NUM_OUT_CHANNELS * state->frameCount];
+        }
+        if (resampling && !state->resampleTemp) {
+            state->resampleTemp = new int32_t[MAX_NUM_CHANNELS * state->frameCount];
+        }
+        state->hook = process__genericMultichannel;
+    } else if (countActiveTracks) {
         if (resampling) {
             if (!state->outputTemp) {
                 state->outputTemp = new int32_t[MAX_NUM_CHANNELS * state->frameCount];
@@ -756,8 +890,18 @@ void AudioMixer::track__genericResample(track_t* t, int32_t* out, size_t outFram
         memset(temp, 0, outFrameCount * MAX_NUM_CHANNELS * sizeof(int32_t));
         t->resampler->resample(temp, outFrameCount, t->bufferProvider);
         if (CC_UNLIKELY(t->volumeInc[0]|t->volumeInc[1]|t->auxInc)) {
+#ifdef __ARM_NEON__
+            if (isNeonCapable) {
+                volumeRampStereoNeon(t, out, outFrameCount, temp, aux);
+            } else
+#endif
             volumeRampStereo(t, out, outFrameCount, temp, aux);
         } else {
+#ifdef __ARM_NEON__
+            if (isNeonCapable) {
+                volumeStereoNeon(t, out, outFrameCount, temp, aux);
+            } else
+#endif
             volumeStereo(t, out, outFrameCount, temp, aux);
         }
     } else {
@@ -765,6 +909,11 @@ void AudioMixer::track__genericResample(track_t* t, int32_t* out, size_t outFram
             t->resampler->setVolume(UNITY_GAIN, UNITY_GAIN);
             memset(temp, 0, outFrameCount * MAX_NUM_CHANNELS * sizeof(int32_t));
             t->resampler->resample(temp, outFrameCount, t->bufferProvider);
+#ifdef __ARM_NEON__
+            if (isNeonCapable) {
+                volumeRampStereoNeon(t, out, outFrameCount, temp, aux);
+            } else
+#endif
             volumeRampStereo(t, out, outFrameCount, temp, aux);
         }
 
@@ -1026,11 +1175,444 @@ void AudioMixer::track__16BitsMono(track_t* t, int32_t* out, size_t frameCount,
     t->in = in;
 }
 
+void AudioMixer::track__16BitsMultichannel(track_t* t, int32_t* out, size_t frameCount, int32_t* temp, int32_t* aux)
+{
+    const int16_t *in = static_cast<const int16_t *>(t->in);
+    const uint32_t inChannels = t->mapInChannelCount;
+    const uint32_t outChannels = t->mapOutChannelCount;
+
+    // the constant gain case is a ramp with a zero increment, see setParameter()
+    int32_t vl = t->prevVolume[0];
+    int32_t vr = t->prevVolume[1];
+    const int32_t vlInc = t->volumeInc[0];
+    const int32_t vrInc = t->volumeInc[1];
+    int32_t va = t->prevAuxLevel;
+    const int32_t vaInc = t->auxInc;
+
+    do {
+        int32_t v[3];
+        v[0] = vl >> 16;
+        v[1] = vr >> 16;
+        v[2] = (v[0] + v[1]) >> 1;
+        for (uint32_t c = 0; c < outChannels; c++) {
+            const int8_t i = t->channelMap[c];
+            if (i >= 0) {
+                out[c] += v[t->channelVolume[c]] * in[i];
+            }
+        }
+        if (CC_UNLIKELY(aux != NULL)) {
+            int32_t sum = 0;
+            for (uint32_t i = 0; i < inChannels; i++) {
+                sum += in[i];
+            }
+            *aux++ += (va >> 16) * (sum / int32_t(inChannels));
+            va += vaInc;
+        }
+        in += inChannels;
+        out += outChannels;
+        vl += vlInc;
+        vr += vrInc;
+    } while (--frameCount);
+
+    t->prevVolume[0] = vl;
+    t->prevVolume[1] = vr;
+    if (aux != NULL) {
+        t->prevAuxLevel = va;
+    }
+    t->adjustVolumeRamp(aux != NULL);
+    t->in = in;
+}
+
+void AudioMixer::track__genericResampleMultichannel(track_t* t, int32_t* out, size_t outFrameCount, int32_t* temp, int32_t* aux)
+{
+    t->resampler->setSampleRate(t->sampleRate);
+
+    // resample to temp with unity gain, then apply volume and spread to the output channels
+    t->resampler->setVolume(UNITY_GAIN, UNITY_GAIN);
+    memset(temp, 0, outFrameCount * MAX_NUM_CHANNELS * sizeof(int32_t));
+    t->resampler->resample(temp, outFrameCount, t->bufferProvider);
+
+    const uint32_t outChannels = t->mapOutChannelCount;
+    int32_t vl = t->prevVolume[0];
+    int32_t vr = t->prevVolume[1];
+    const int32_t vlInc = t->volumeInc[0];
+    const int32_t vrInc = t->volumeInc[1];
+    int32_t va = t->prevAuxLevel;
+    const int32_t vaInc = t->auxInc;
+
+    do {
+        const int32_t in[MAX_NUM_CHANNELS] = { temp[0] >> 12, temp[1] >> 12 };
+        int32_t v[3];
+        v[0] = vl >> 16;
+        v[1] = vr >> 16;
+        v[2] = (v[0] + v[1]) >> 1;
+        for (uint32_t c = 0; c < outChannels; c++) {
+            const int8_t i = t->channelMap[c];
+            if (i >= 0) {
+                out[c] += v[t->channelVolume[c]] * in[i];
+            }
+        }
+        if (CC_UNLIKELY(aux != NULL)) {
+            *aux++ += (va >> 17) * (in[0] + in[1]);
+            va += vaInc;
+        }
+        temp += MAX_NUM_CHANNELS;
+        out += outChannels;
+        vl += vlInc;
+        vr += vrInc;
+    } while (--outFrameCount);
+
+    t->prevVolume[0] = vl;
+    t->prevVolume[1] = vr;
+    if (aux != NULL) {
+        t->prevAuxLevel = va;
+    }
+    t->adjustVolumeRamp(aux != NULL);
+}
+
+#ifdef __ARM_NEON__
+// The NEON hooks below mirror volumeRampStereo(), volumeStereo(), track__16BitsStereo() and
+// track__16BitsMono() operation for operation, so that the result is bit-exact with the C hooks.
+// They consume the frame count in multiples of 4 and hand the remaining frames, if any,
+// to the C hook, which also takes care of adjusting the volume ramp.
+
+// returns the 4 ramp values v, v+inc, v+2*inc, v+3*inc
+static inline int32x4_t rampStart(int32_t v, int32_t inc)
+{
+    const int32_t ramp[4] = { v, v + inc, v + 2 * inc, v + 3 * inc };
+    return vld1q_s32(ramp);
+}
+
+void AudioMixer::volumeRampStereoNeon(track_t* t, int32_t* out, size_t frameCount, int32_t* temp, int32_t* aux)
+{
+    size_t n = frameCount & ~3;
+    if (n == 0) {
+        volumeRampStereo(t, out, frameCount, temp, aux);
+        return;
+    }
+    frameCount -= n;
+
+    int32x4_t vl = rampStart(t->prevVolume[0], t->volumeInc[0]);
+    int32x4_t vr = rampStart(t->prevVolume[1], t->volumeInc[1]);
+    const int32x4_t vlInc = vdupq_n_s32(t->volumeInc[0] * 4);
+    const int32x4_t vrInc = vdupq_n_s32(t->volumeInc[1] * 4);
+
+    if (CC_UNLIKELY(aux != NULL)) {
+        int32x4_t va = rampStart(t->prevAuxLevel, t->auxInc);
+        const int32x4_t vaInc = vdupq_n_s32(t->auxInc * 4);
+        do {
+            int32x4x2_t in = vld2q_s32(temp);
+            int32x4x2_t o = vld2q_s32(out);
+            int32x4_t a = vld1q_s32(aux);
+            const int32x4_t l = vshrq_n_s32(in.val[0], 12);
+            const int32x4_t r = vshrq_n_s32(in.val[1], 12);
+            o.val[0] = vmlaq_s32(o.val[0], vshrq_n_s32(vl, 16), l);
+            o.val[1] = vmlaq_s32(o.val[1], vshrq_n_s32(vr, 16), r);
+            a = vmlaq_s32(a, vshrq_n_s32(va, 17), vaddq_s32(l, r));
+            vst2q_s32(out, o);
+            vst1q_s32(aux, a);
+            vl = vaddq_s32(vl, vlInc);
+            vr = vaddq_s32(vr, vrInc);
+            va = vaddq_s32(va, vaInc);
+            temp += 8;
+            out += 8;
+            aux += 4;
+        } while (n -= 4);
+        t->prevAuxLevel = vgetq_lane_s32(va, 0);
+    } else {
+        do {
+            int32x4x2_t in = vld2q_s32(temp);
+            int32x4x2_t o = vld2q_s32(out);
+            o.val[0] = vmlaq_s32(o.val[0], vshrq_n_s32(vl, 16), vshrq_n_s32(in.val[0], 12));
+            o.val[1] = vmlaq_s32(o.val[1], vshrq_n_s32(vr, 16), vshrq_n_s32(in.val[1], 12));
+            vst2q_s32(out, o);
+            vl = vaddq_s32(vl, vlInc);
+            vr = vaddq_s32(vr, vrInc);
+            temp += 8;
+            out += 8;
+        } while (n -= 4);
+    }
+    t->prevVolume[0] = vgetq_lane_s32(vl, 0);
+    t->prevVolume[1] = vgetq_lane_s32(vr, 0);
+
+    if (frameCount) {
+        volumeRampStereo(t, out, frameCount, temp, aux);
+    } else {
+        t->adjustVolumeRamp(aux != NULL);
+    }
+}
+
+void AudioMixer::volumeStereoNeon(track_t* t, int32_t* out, size_t frameCount, int32_t* temp, int32_t* aux)
+{
+    size_t n = frameCount & ~3;
+    if (n == 0) {
+        volumeStereo(t, out, frameCount, temp, aux);
+        return;
+    }
+    frameCount -= n;
+
+    const int16_t vl = t->volume[0];
+    const int16_t vr = t->volume[1];
+
+    if (CC_UNLIKELY(aux != NULL)) {
+        const int16_t va = t->auxLevel;
+        do {
+            int32x4x2_t in = vld2q_s32(temp);
+            int32x4x2_t o = vld2q_s32(out);
+            int32x4_t a = vld1q_s32(aux);
+            const int16x4_t l = vmovn_s32(vshrq_n_s32(in.val[0], 12));
+            const int16x4_t r = vmovn_s32(vshrq_n_s32(in.val[1], 12));
+            o.val[0] = vmlal_n_s16(o.val[0], l, vl);
+            o.val[1] = vmlal_n_s16(o.val[1], r, vr);
+            a = vmlal_n_s16(a, vmovn_s32(vshrq_n_s32(vaddl_s16(l, r), 1)), va);
+            vst2q_s32(out, o);
+            vst1q_s32(aux, a);
+            temp += 8;
+            out += 8;
+            aux += 4;
+        } while (n -= 4);
+    } else {
+        do {
+            int32x4x2_t in = vld2q_s32(temp);
+            int32x4x2_t o = vld2q_s32(out);
+            o.val[0] = vmlal_n_s16(o.val[0], vmovn_s32(vshrq_n_s32(in.val[0], 12)), vl);
+            o.val[1] = vmlal_n_s16(o.val[1], vmovn_s32(vshrq_n_s32(in.val[1], 12)), vr);
+            vst2q_s32(out, o);
+            temp += 8;
+            out += 8;
+        } while (n -= 4);
+    }
+
+    if (frameCount) {
+        volumeStereo(t, out, frameCount, temp, aux);
+    }
+}
+
+void AudioMixer::track__16BitsStereoNeon(track_t* t, int32_t* out, size_t frameCount, int32_t* temp, int32_t* aux)
+{
+    size_t n = frameCount & ~3;
+    if (n == 0) {
+        track__16BitsStereo(t, out, frameCount, temp, aux);
+        return;
+    }
+    frameCount -= n;
+
+    const int16_t *in = static_cast<const int16_t *>(t->in);
+
+    if (CC_UNLIKELY(aux != NULL)) {
+        // ramp gain
+        if (CC_UNLIKELY(t->volumeInc[0]|t->volumeInc[1]|t->auxInc)) {
+            int32x4_t vl = rampStart(t->prevVolume[0], t->volumeInc[0]);
+            int32x4_t vr = rampStart(t->prevVolume[1], t->volumeInc[1]);
+            int32x4_t va = rampStart(t->prevAuxLevel, t->auxInc);
+            const int32x4_t vlInc = vdupq_n_s32(t->volumeInc[0] * 4);
+            const int32x4_t vrInc = vdupq_n_s32(t->volumeInc[1] * 4);
+            const int32x4_t vaInc = vdupq_n_s32(t->auxInc * 4);
+            do {
+                int16x4x2_t lr = vld2_s16(in);
+                int32x4x2_t o = vld2q_s32(out);
+                int32x4_t a = vld1q_s32(aux);
+                o.val[0] = vmlaq_s32(o.val[0], vshrq_n_s32(vl, 16), vmovl_s16(lr.val[0]));
+                o.val[1] = vmlaq_s32(o.val[1], vshrq_n_s32(vr, 16), vmovl_s16(lr.val[1]));
+                a = vmlaq_s32(a, vshrq_n_s32(va, 17), vaddl_s16(lr.val[0], lr.val[1]));
+                vst2q_s32(out, o);
+                vst1q_s32(aux, a);
+                vl = vaddq_s32(vl, vlInc);
+                vr = vaddq_s32(vr, vrInc);
+                va = vaddq_s32(va, vaInc);
+                in += 8;
+                out += 8;
+                aux += 4;
+            } while (n -= 4);
+            t->prevVolume[0] = vgetq_lane_s32(vl, 0);
+            t->prevVolume[1] = vgetq_lane_s32(vr, 0);
+            t->prevAuxLevel = vgetq_lane_s32(va, 0);
+            if (!frameCount) {
+                t->adjustVolumeRamp(true);
+            }
+        }
+
+        // constant gain
+        else {
+            const int16_t vl = t->volume[0];
+            const int16_t vr = t->volume[1];
+            const int16_t va = (int16_t)t->auxLevel;
+            do {
+                int16x4x2_t lr = vld2_s16(in);
+                int32x4x2_t o = vld2q_s32(out);
+                int32x4_t a = vld1q_s32(aux);
+                o.val[0] = vmlal_n_s16(o.val[0], lr.val[0], vl);
+                o.val[1] = vmlal_n_s16(o.val[1], lr.val[1], vr);
+                a = vmlal_n_s16(a, vmovn_s32(vshrq_n_s32(vaddl_s16(lr.val[0], lr.val[1]), 1)), va);
+                vst2q_s32(out, o);
+                vst1q_s32(aux, a);
+                in += 8;
+                out += 8;
+                aux += 4;
+            } while (n -= 4);
+        }
+    } else {
+        // ramp gain
+        if (CC_UNLIKELY(t->volumeInc[0]|t->volumeInc[1])) {
+            int32x4_t vl = rampStart(t->prevVolume[0], t->volumeInc[0]);
+            int32x4_t vr = rampStart(t->prevVolume[1], t->volumeInc[1]);
+            const int32x4_t vlInc = vdupq_n_s32(t->volumeInc[0] * 4);
+            const int32x4_t vrInc = vdupq_n_s32(t->volumeInc[1] * 4);
+            do {
+                int16x4x2_t lr = vld2_s16(in);
+                int32x4x2_t o = vld2q_s32(out);
+                o.val[0] = vmlaq_s32(o.val[0], vshrq_n_s32(vl, 16), vmovl_s16(lr.val[0]));
+                o.val[1] = vmlaq_s32(o.val[1], vshrq_n_s32(vr, 16), vmovl_s16(lr.val[1]));
+                vst2q_s32(out, o);
+                vl = vaddq_s32(vl, vlInc);
+                vr = vaddq_s32(vr, vrInc);
+                in += 8;
+                out += 8;
+            } while (n -= 4);
+            t->prevVolume[0] = vgetq_lane_s32(vl, 0);
+            t->prevVolume[1] = vgetq_lane_s32(vr, 0);
+            if (!frameCount) {
+                t->adjustVolumeRamp(false);
+            }
+        }
+
+        // constant gain, unity gain being the common case
+        else {
+            const int16x4_t vrl = vreinterpret_s16_u32(vdup_n_u32(t->volumeRL));
+            do {
+                int16x8_t lr = vld1q_s16(in);
+                int32x4_t o0 = vld1q_s32(out);
+                int32x4_t o1 = vld1q_s32(out + 4);
+                o0 = vmlal_s16(o0, vget_low_s16(lr), vrl);
+                o1 = vmlal_s16(o1, vget_high_s16(lr), vrl);
+                vst1q_s32(out, o0);
+                vst1q_s32(out + 4, o1);
+                in += 8;
+                out += 8;
+            } while (n -= 4);
+        }
+    }
+    t->in = in;
+
+    if (frameCount) {
+        track__16BitsStereo(t, out, frameCount, temp, aux);
+    }
+}
+
+void AudioMixer::track__16BitsMonoNeon(track_t* t, int32_t* out, size_t frameCount, int32_t* temp, int32_t* aux)
+{
+    size_t n = frameCount & ~3;
+    if (n == 0) {
+        track__16BitsMono(t, out, frameCount, temp, aux);
+        return;
+    }
+    frameCount -= n;
+
+    const int16_t *in = static_cast<int16_t const *>(t->in);
+
+    if (CC_UNLIKELY(aux != NULL)) {
+        // ramp gain
+        if (CC_UNLIKELY(t->volumeInc[0]|t->volumeInc[1]|t->auxInc)) {
+            int32x4_t vl = rampStart(t->prevVolume[0], t->volumeInc[0]);
+            int32x4_t vr = rampStart(t->prevVolume[1], t->volumeInc[1]);
+            int32x4_t va = rampStart(t->prevAuxLevel, t->auxInc);
+            const int32x4_t vlInc = vdupq_n_s32(t->volumeInc[0] * 4);
+            const int32x4_t vrInc = vdupq_n_s32(t->volumeInc[1] * 4);
+            const int32x4_t vaInc = vdupq_n_s32(t->auxInc * 4);
+            do {
+                const int32x4_t l = vmovl_s16(vld1_s16(in));
+                int32x4x2_t o = vld2q_s32(out);
+                int32x4_t a = vld1q_s32(aux);
+                o.val[0] = vmlaq_s32(o.val[0], vshrq_n_s32(vl, 16), l);
+                o.val[1] = vmlaq_s32(o.val[1], vshrq_n_s32(vr, 16), l);
+                a = vmlaq_s32(a, vshrq_n_s32(va, 16), l);
+                vst2q_s32(out, o);
+                vst1q_s32(aux, a);
+                vl = vaddq_s32(vl, vlInc);
+                vr = vaddq_s32(vr, vrInc);
+                va = vaddq_s32(va, vaInc);
+                in += 4;
+                out += 8;
+                aux += 4;
+            } while (n -= 4);
+            t->prevVolume[0] = vgetq_lane_s32(vl, 0);
+            t->prevVolume[1] = vgetq_lane_s32(vr, 0);
+            t->prevAuxLevel = vgetq_lane_s32(va, 0);
+            if (!frameCount) {
+                t->adjustVolumeRamp(true);
+            }
+        }
+        // constant gain
+        else {
+            const int16_t vl = t->volume[0];
+            const int16_t vr = t->volume[1];
+            const int16_t va = (int16_t)t->auxLevel;
+            do {
+                const int16x4_t l = vld1_s16(in);
+                int32x4x2_t o = vld2q_s32(out);
+                int32x4_t a = vld1q_s32(aux);
+                o.val[0] = vmlal_n_s16(o.val[0], l, vl);
+                o.val[1] = vmlal_n_s16(o.val[1], l, vr);
+                a = vmlal_n_s16(a, l, va);
+                vst2q_s32(out, o);
+                vst1q_s32(aux, a);
+                in += 4;
+                out += 8;
+                aux += 4;
+            } while (n -= 4);
+        }
+    } else {
+        // ramp gain
+        if (CC_UNLIKELY(t->volumeInc[0]|t->volumeInc[1])) {
+            int32x4_t vl = rampStart(t->prevVolume[0], t->volumeInc[0]);
+            int32x4_t vr = rampStart(t->prevVolume[1], t->volumeInc[1]);
+            const int32x4_t vlInc = vdupq_n_s32(t->volumeInc[0] * 4);
+            const int32x4_t vrInc = vdupq_n_s32(t->volumeInc[1] * 4);
+            do {
+                const int32x4_t l = vmovl_s16(vld1_s16(in));
+                int32x4x2_t o = vld2q_s32(out);
+                o.val[0] = vmlaq_s32(o.val[0], vshrq_n_s32(vl, 16), l);
+                o.val[1] = vmlaq_s32(o.val[1], vshrq_n_s32(vr, 16), l);
+                vst2q_s32(out, o);
+                vl = vaddq_s32(vl, vlInc);
+                vr = vaddq_s32(vr, vrInc);
+                in += 4;
+                out += 8;
+            } while (n -= 4);
+            t->prevVolume[0] = vgetq_lane_s32(vl, 0);
+            t->prevVolume[1] = vgetq_lane_s32(vr, 0);
+            if (!frameCount) {
+                t->adjustVolumeRamp(false);
+            }
+        }
+        // constant gain
+        else {
+            const int16_t vl = t->volume[0];
+            const int16_t vr = t->volume[1];
+            do {
+                const int16x4_t l = vld1_s16(in);
+                int32x4x2_t o = vld2q_s32(out);
+                o.val[0] = vmlal_n_s16(o.val[0], l, vl);
+                o.val[1] = vmlal_n_s16(o.val[1], l, vr);
+                vst2q_s32(out, o);
+                in += 4;
+                out += 8;
+            } while (n -= 4);
+        }
+    }
+    t->in = in;
+
+    if (frameCount) {
+        track__16BitsMono(t, out, frameCount, temp, aux);
+    }
+}
+#endif // __ARM_NEON__
+
 // no-op case
 void AudioMixer::process__nop(state_t* state, int64_t pts)
 {
     uint32_t e0 = state->enabledTracks;
-    size_t bufSize = state->frameCount * sizeof(int16_t) * MAX_NUM_CHANNELS;
+    size_t bufSize = state->frameCount * sizeof(int16_t) * state->channelCount;
     while (e0) {
         // process by group of tracks with same output buffer to
         // avoid multiple memset() on same buffer
@@ -1234,6 +1816,71 @@ void AudioMixer::process__genericResampling(state_t* state, int64_t pts)
     }
 }
 
+// generic code for a multichannel output, with or without resampling
+void AudioMixer::process__genericMultichannel(state_t* state, int64_t pts)
+{
+    const uint32_t channelCount = state->channelCount;
+    int32_t* const outTemp = state->outputTemp;
+    const size_t size = sizeof(int32_t) * channelCount * state->frameCount;
+
+    size_t numFrames = state->frameCount;
+
+    uint32_t e0 = state->enabledTracks;
+    while (e0) {
+        // process by group of tracks with same output buffer
+        // to optimize cache use
+        uint32_t e1 = e0, e2 = e0;
+        int j = 31 - __builtin_clz(e1);
+        track_t& t1 = state->tracks[j];
+        e2 &= ~(1<<j);
+        while (e2) {
+            j = 31 - __builtin_clz(e2);
+            e2 &= ~(1<<j);
+            track_t& t2 = state->tracks[j];
+            if (CC_UNLIKELY(t2.mainBuffer != t1.mainBuffer)) {
+                e1 &= ~(1<<j);
+            }
+        }
+        e0 &= ~(e1);
+        int32_t *out = t1.mainBuffer;
+        memset(outTemp, 0, size);
+        while (e1) {
+            const int i = 31 - __builtin_clz(e1);
+            e1 &= ~(1<<i);
+            track_t& t = state->tracks[i];
+            int32_t *aux = NULL;
+            if (CC_UNLIKELY((t.needs & NEEDS_AUX__MASK) == NEEDS_AUX_ENABLED)) {
+                aux = t.auxBuffer;
+            }
+
+            if ((t.needs & NEEDS_RESAMPLE__MASK) == NEEDS_RESAMPLE_ENABLED) {
+                t.resampler->setPTS(pts);
+                t.hook(&t, outTemp, numFrames, state->resampleTemp, aux);
+            } else {
+
+                size_t outFrames = 0;
+
+                while (outFrames < numFrames) {
+                    t.buffer.frameCount = numFrames - outFrames;
+                    int64_t outputPTS = calculateOutputPTS(t, pts, outFrames);
+                    t.bufferProvider->getNextBuffer(&t.buffer, outputPTS);
+                    t.in = t.buffer.raw;
+                    // t.in == NULL can happen if the track was flushed just after having
+                    // been enabled for mixing.
+                    if (t.in == NULL) break;
+
+                    t.hook(&t, outTemp + outFrames*channelCount, t.buffer.frameCount,
+                            state->resampleTemp, aux != NULL ? aux + outFrames : NULL);
+                    outFrames += t.buffer.frameCount;
+                    t.bufferProvider->releaseBuffer(&t.buffer);
+                }
+            }
+        }
+        // ditherAndClamp() works on pairs of samples, the channel count is even
+        ditherAndClamp(out, outTemp, numFrames * channelCount / 2);
+    }
+}
+
 // one track, 16 bits stereo without resampling is the most common case
 void AudioMixer::process__OneTrack16BitsStereoNoResampling(state_t* state,
                                                            int64_t pts)
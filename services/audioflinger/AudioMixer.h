@@ -37,7 +37,9 @@ class AudioMixer
 {
 public:
                             AudioMixer(size_t frameCount, uint32_t sampleRate,
-                                       uint32_t maxNumTracks = MAX_NUM_TRACKS);
+                                       uint32_t maxNumTracks = MAX_NUM_TRACKS,
+                                       audio_channel_mask_t channelMask =
+                                               AUDIO_CHANNEL_OUT_STEREO);
 
     /*virtual*/             ~AudioMixer();  // non-virtual saves a v-table, restore if sub-classed
 
@@ -46,6 +48,9 @@ public:
     static const uint32_t MAX_NUM_CHANNELS = 2;
     // maximum number of channels supported for the content
     static const uint32_t MAX_NUM_CHANNELS_TO_DOWNMIX = 8;
+    // maximum number of channels of the mixer output, when more than MAX_NUM_CHANNELS
+    // the tracks are mixed by the multichannel path instead of the stereo hooks
+    static const uint32_t MAX_NUM_OUT_CHANNELS = 8;
 
     static const uint16_t UNITY_GAIN = 0x1000;
 
@@ -81,6 +86,9 @@ public:
                                   // This clears out the resampler's input buffer.
         REMOVE          = 0x4102, // Remove the sample rate converter on this track name;
                                   // the track is restored to the mix sample rate.
+        QUALITY         = 0x4103, // Select the AudioResampler::src_quality used by the sample rate
+                                  // converter of this track name; parameter 'value' is the quality.
+                                  // An existing sample rate converter is replaced if needed.
         // for target RAMP_VOLUME and VOLUME (8 channels max)
         VOLUME0         = 0x4200,
         VOLUME1         = 0x4201,
@@ -107,8 +115,14 @@ public:
 
     uint32_t    trackNames() const { return mTrackNames; }
 
+    uint32_t    channelCount() const { return mState.channelCount; }
+
     size_t      getUnreleasedFrames(int name) const;
 
+    // Name of the process__ hook the mixer selected for its current tracks, or
+    // "validate" until the next process() has selected one.  For benchmarks.
+    const char* hookName() const;
+
 private:
 
     enum {
@@ -196,10 +210,26 @@ private:
 
         // 16-byte boundary
 
+        // used by the multichannel path only, see mapChannels():
+        //  for each mixer output channel, the index of the track channel mixed into it or -1,
+        int8_t      channelMap[MAX_NUM_OUT_CHANNELS];
+        //  and the volume applied to it: 0 for volume[0], 1 for volume[1], 2 for their average
+        uint8_t     channelVolume[MAX_NUM_OUT_CHANNELS];
+
+        // 16-byte boundary
+
+        uint32_t    mapInChannelCount;  // number of channels read by the hook, see mapChannels()
+        uint32_t    mapOutChannelCount; // number of channels of the mixer output
+        int32_t     resamplerQuality;   // AudioResampler::src_quality for the next resampler
+        int32_t     padding2;
+
+        // 16-byte boundary
+
         bool        setResampler(uint32_t sampleRate, uint32_t devSampleRate);
         bool        doesResample() const { return resampler != NULL; }
         void        resetResampler() { if (resampler != NULL) resampler->reset(); }
         void        adjustVolumeRamp(bool aux);
+        void        mapChannels(audio_channel_mask_t outMask);
         size_t      getUnreleasedFrames() const { return resampler != NULL ?
                                                     resampler->getUnreleasedFrames() : 0; };
     };
@@ -212,7 +242,8 @@ private:
         void            (*hook)(state_t* state, int64_t pts);   // one of process__*, never NULL
         int32_t         *outputTemp;
         int32_t         *resampleTemp;
-        int32_t         reserved[2];
+        uint32_t        channelCount;   // number of channels of the mix output
+        audio_channel_mask_t channelMask;
         // FIXME allocate dynamically to save some memory when maxNumTracks < MAX_NUM_TRACKS
         track_t         tracks[MAX_NUM_TRACKS]; __attribute__((aligned(32)));
     };
@@ -245,12 +276,16 @@ private:
     static effect_descriptor_t dwnmFxDesc;
     // indicates whether a downmix effect has been found and is usable by this mixer
     static bool                isMultichannelCapable;
+    // indicates whether process__validate() may select the NEON track hooks,
+    // can be cleared with property af.mixer.neon=0 to compare against the C hooks
+    static bool                isNeonCapable;
 
     // Call after changing either the enabled status of a track, or parameters of an enabled track.
     // OK to call more often than that, but unnecessary.
     void invalidateState(uint32_t mask);
 
-    static status_t initTrackDownmix(track_t* pTrack, int trackNum, audio_channel_mask_t mask);
+    static status_t initTrackDownmix(track_t* pTrack, int trackNum, audio_channel_mask_t mask,
+            audio_channel_mask_t outMask);
     static status_t prepareTrackForDownmix(track_t* pTrack, int trackNum);
     static void unprepareTrackForDownmix(track_t* pTrack, int trackName);
 
@@ -260,11 +295,22 @@ private:
     static void track__16BitsMono(track_t* t, int32_t* out, size_t numFrames, int32_t* temp, int32_t* aux);
     static void volumeRampStereo(track_t* t, int32_t* out, size_t frameCount, int32_t* temp, int32_t* aux);
     static void volumeStereo(track_t* t, int32_t* out, size_t frameCount, int32_t* temp, int32_t* aux);
+    static void track__16BitsMultichannel(track_t* t, int32_t* out, size_t numFrames, int32_t* temp, int32_t* aux);
+    static void track__genericResampleMultichannel(track_t* t, int32_t* out, size_t numFrames, int32_t* temp, int32_t* aux);
+#ifdef __ARM_NEON__
+    // NEON specializations of the hooks above, bit-exact with the C versions.
+    // They process 4 frames per iteration and defer any remainder to the C version.
+    static void track__16BitsStereoNeon(track_t* t, int32_t* out, size_t numFrames, int32_t* temp, int32_t* aux);
+    static void track__16BitsMonoNeon(track_t* t, int32_t* out, size_t numFrames, int32_t* temp, int32_t* aux);
+    static void volumeRampStereoNeon(track_t* t, int32_t* out, size_t frameCount, int32_t* temp, int32_t* aux);
+    static void volumeStereoNeon(track_t* t, int32_t* out, size_t frameCount, int32_t* temp, int32_t* aux);
+#endif
 
     static void process__validate(state_t* state, int64_t pts);
     static void process__nop(state_t* state, int64_t pts);
     static void process__genericNoResampling(state_t* state, int64_t pts);
     static void process__genericResampling(state_t* state, int64_t pts);
+    static void process__genericMultichannel(state_t* state, int64_t pts);
     static void process__OneTrack16BitsStereoNoResampling(state_t* state,
                                                           int64_t pts);
 #if 0
@@ -623,7 +623,9 @@ status_t AudioPolicyService::onTransact(
 // -----------  AudioPolicyService::AudioCommandThread implementation ----------
 
 AudioPolicyService::AudioCommandThread::AudioCommandThread(String8 name)
-    : Thread(false), mName(name)
+    : Thread(false), mName(name),
+      mProcessedCount(0), mSupersededCount(0), mMaxQueueDepth(0),
+      mTotalLatency(0), mMaxLatency(0)
 {
     mpToneGenerator = NULL;
 }
@@ -662,6 +664,16 @@ bool AudioPolicyService::AudioCommandThread::threadLoop()
                 mAudioCommands.removeAt(0);
                 mLastCommand = *command;
 
+                nsecs_t latency = curTime - command->mTime;
+                mProcessedCount++;
+                mTotalLatency += latency;
+                if (latency > mMaxLatency) {
+                    mMaxLatency = latency;
+                }
+                if (command->mSuperseded) {
+                    mSupersededCount++;
+                }
+
                 switch (command->mCommand) {
                 case START_TONE: {
                     mLock.unlock();
@@ -688,9 +700,8 @@ bool AudioPolicyService::AudioCommandThread::threadLoop()
                     VolumeData *data = (VolumeData *)command->mParam;
                     ALOGV("AudioCommandThread() processing set volume stream %d, \
                             volume %f, output %d", data->mStream, data->mVolume, data->mIO);
-                    command->mStatus = AudioSystem::setStreamVolume(data->mStream,
-                                                                    data->mVolume,
-                                                                    data->mIO);
+                    command->mStatus = command->mSuperseded ? NO_ERROR :
+                            AudioSystem::setStreamVolume(data->mStream, data->mVolume, data->mIO);
                     if (command->mWaitStatus) {
                         command->mCond.signal();
                         mWaitWorkCV.wait(mLock);
@@ -701,7 +712,8 @@ bool AudioPolicyService::AudioCommandThread::threadLoop()
                     ParametersData *data = (ParametersData *)command->mParam;
                     ALOGV("AudioCommandThread() processing set parameters string %s, io %d",
                             data->mKeyValuePairs.string(), data->mIO);
-                    command->mStatus = AudioSystem::setParameters(data->mIO, data->mKeyValuePairs);
+                    command->mStatus = command->mSuperseded ? NO_ERROR :
+                            AudioSystem::setParameters(data->mIO, data->mKeyValuePairs);
                     if (command->mWaitStatus) {
                         command->mCond.signal();
                         mWaitWorkCV.wait(mLock);
@@ -712,7 +724,8 @@ bool AudioPolicyService::AudioCommandThread::threadLoop()
                     VoiceVolumeData *data = (VoiceVolumeData *)command->mParam;
                     ALOGV("AudioCommandThread() processing set voice volume volume %f",
                             data->mVolume);
-                    command->mStatus = AudioSystem::setVoiceVolume(data->mVolume);
+                    command->mStatus = command->mSuperseded ? NO_ERROR :
+                            AudioSystem::setVoiceVolume(data->mVolume);
                     if (command->mWaitStatus) {
                         command->mCond.signal();
                         mWaitWorkCV.wait(mLock);
@@ -723,7 +736,8 @@ bool AudioPolicyService::AudioCommandThread::threadLoop()
                 case SET_FM_VOLUME: {
                     FmVolumeData *data = (FmVolumeData *)command->mParam;
                     ALOGV("AudioCommandThread() processing set fm volume volume %f", data->mVolume);
-                    command->mStatus = AudioSystem::setFmVolume(data->mVolume);
+                    command->mStatus = command->mSuperseded ? NO_ERROR :
+                            AudioSystem::setFmVolume(data->mVolume);
                     if (command->mWaitStatus) {
                         command->mCond.signal();
                         mWaitWorkCV.wait(mLock);
@@ -780,6 +794,14 @@ status_t AudioPolicyService::AudioCommandThread::dump(int fd)
     mLastCommand.dump(buffer, SIZE);
     result.append(buffer);
 
+    snprintf(buffer, SIZE, "- Processed %u commands, %u superseded, max queue depth %u\n",
+            mProcessedCount, mSupersededCount, mMaxQueueDepth);
+    result.append(buffer);
+    snprintf(buffer, SIZE, "- Latency: average %.2f ms, max %.2f ms\n",
+            mProcessedCount ? (double)mTotalLatency / mProcessedCount / 1000000 : 0.0,
+            (double)mMaxLatency / 1000000);
+    result.append(buffer);
+
     write(fd, result.string(), result.size());
 
     if (locked) mLock.unlock();
@@ -1018,10 +1040,69 @@ void AudioPolicyService::AudioCommandThread::insertCommand_l(AudioCommand *comma
     }
     removedCommands.clear();
 
+    // the commands due before this one are not removed, their callers may be waiting
+    supersedeCommands_l(command, i + 1);
+
     // insert command at the right place according to its time stamp
     ALOGV("inserting command: %d at index %d, num commands %d",
             command->mCommand, (int)i+1, mAudioCommands.size());
     mAudioCommands.insertAt(command, i + 1);
+    if (mAudioCommands.size() > mMaxQueueDepth) {
+        mMaxQueueDepth = mAudioCommands.size();
+    }
+}
+
+// supersedeCommands_l() must be called with mLock held
+void AudioPolicyService::AudioCommandThread::supersedeCommands_l(AudioCommand *command,
+                                                                 size_t end)
+{
+    for (size_t i = 0; i < end; i++) {
+        AudioCommand *command2 = mAudioCommands[i];
+        if (command2->mCommand != command->mCommand || command2->mSuperseded) continue;
+
+        switch (command->mCommand) {
+        case SET_PARAMETERS: {
+            ParametersData *data = (ParametersData *)command->mParam;
+            ParametersData *data2 = (ParametersData *)command2->mParam;
+            if (data->mIO != data2->mIO) break;
+            // the keys set again by the new command need not be set by the earlier one
+            AudioParameter param = AudioParameter(data->mKeyValuePairs);
+            AudioParameter param2 = AudioParameter(data2->mKeyValuePairs);
+            for (size_t j = 0; j < param.size(); j++) {
+                String8 key;
+                String8 value;
+                param.getAt(j, key, value);
+                param2.remove(key);
+            }
+            if (param2.size() == 0) {
+                command2->mSuperseded = true;
+            } else {
+                data2->mKeyValuePairs = param2.toString();
+            }
+        } break;
+
+        case SET_VOLUME: {
+            VolumeData *data = (VolumeData *)command->mParam;
+            VolumeData *data2 = (VolumeData *)command2->mParam;
+            if (data->mIO != data2->mIO) break;
+            if (data->mStream != data2->mStream) break;
+            command2->mSuperseded = true;
+        } break;
+
+        case SET_VOICE_VOLUME:
+#if defined(QCOM_HARDWARE) && defined(QCOM_FM_ENABLED)
+        case SET_FM_VOLUME:
+#endif
+            command2->mSuperseded = true;
+            break;
+
+        case START_TONE:
+        case STOP_TONE:
+        default:
+            break;
+        }
+        ALOGV_IF(command2->mSuperseded, "superseding command: %d", command2->mCommand);
+    }
 }
 
 void AudioPolicyService::AudioCommandThread::exit()
@@ -196,7 +196,7 @@ private:
 
         public:
             AudioCommand()
-            : mCommand(-1) {}
+            : mCommand(-1), mSuperseded(false) {}
 
             void dump(char* buffer, size_t size);
 
@@ -205,9 +205,14 @@ private:
             Condition mCond; // condition for status return
             status_t mStatus; // command status
             bool mWaitStatus; // true if caller is waiting for status
+            bool mSuperseded; // true if a later command overrides its whole effect
             void *mParam;     // command parameter (ToneData, VolumeData, ParametersData)
         };
 
+        // marks the pending commands overridden by command, which is about to be queued
+        // at index end, as superseded so that they are not applied
+        void supersedeCommands_l(AudioCommand *command, size_t end);
+
         class ToneData {
         public:
             ToneGenerator::tone_type mType; // tone type (START_TONE only)
@@ -245,6 +250,13 @@ private:
         ToneGenerator *mpToneGenerator;     // the tone generator
         AudioCommand mLastCommand;          // last processed command (used by dump)
         String8 mName;                      // string used by wake lock fo delayed commands
+
+        // statistics (used by dump)
+        uint32_t mProcessedCount;           // commands taken from mAudioCommands
+        uint32_t mSupersededCount;          // of which were superseded
+        size_t mMaxQueueDepth;              // largest size of mAudioCommands
+        nsecs_t mTotalLatency;              // sum of the delays past the commands' time stamps
+        nsecs_t mMaxLatency;
     };
 
     class EffectDesc {
@@ -19,10 +19,12 @@
 
 #include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 #include <sys/types.h>
 #include <cutils/log.h>
 #include <cutils/properties.h>
 #include "AudioResampler.h"
+#include "AudioResamplerPolyphase.h"
 #if 0
 #include "AudioResamplerSinc.h"
 #include "AudioResamplerCubic.h"
@@ -46,7 +48,7 @@ public:
     }
     virtual void resample(int32_t* out, size_t outFrameCount,
             AudioBufferProvider* provider);
-private:
+protected:
     // number of bits used in interpolation multiply - 15 bits avoids overflow
     static const int kNumInterpBits = 15;
 
@@ -79,6 +81,55 @@ private:
     int mX0R;
 };
 
+// ----------------------------------------------------------------------------
+
+// Linear resampler with dedicated halfband filters for the exact 2:1 and 1:2 ratios,
+// e.g. 96 kHz to 48 kHz or 24 kHz to 48 kHz. The ratio is checked on each call to
+// resample() since the input sample rate may change at any time, other ratios use the
+// AudioResamplerOrder1 implementation.
+class AudioResamplerHalfband : public AudioResamplerOrder1 {
+public:
+    AudioResamplerHalfband(int bitDepth, int inChannelCount, int32_t sampleRate) :
+        AudioResamplerOrder1(bitDepth, inChannelCount, sampleRate),
+        mMode(MODE_GENERIC), mHistoryIndex(0), mHalfbandPhase(0) {
+        memset(mHistory, 0, sizeof(mHistory));
+    }
+    virtual void resample(int32_t* out, size_t outFrameCount,
+            AudioBufferProvider* provider);
+    virtual void reset();
+private:
+    enum mode_t {
+        MODE_GENERIC,       // AudioResamplerOrder1
+        MODE_DECIMATE,      // 2:1
+        MODE_INTERPOLATE,   // 1:2
+    };
+
+    // the halfband filter has 4 * kNumHalfCoefs - 1 taps, of which only the center one
+    // and the 2 * kNumHalfCoefs odd ones are non-zero
+    static const int kNumHalfCoefs = 6;
+    static const int kNumTaps = 4 * kNumHalfCoefs - 1;
+    static const int kCenterTap = kNumTaps / 2;
+    static const int kCoefBits = 15;
+    static const int16_t kHalfCoefs[kNumHalfCoefs];
+
+    template<int CHANNELS>
+    void decimate(int32_t* out, size_t outFrameCount, AudioBufferProvider* provider);
+    template<int CHANNELS>
+    void interpolate(int32_t* out, size_t outFrameCount, AudioBufferProvider* provider);
+    // reads one frame from the provider into the history, returns false if none available
+    template<int CHANNELS>
+    inline bool read(AudioBufferProvider* provider, size_t inFrameCount, size_t outputIndex);
+
+    mode_t mMode;
+    // the last kNumTaps input frames, written twice so the window is always contiguous:
+    // oldest frame at mHistoryIndex + 1, newest at mHistoryIndex + kNumTaps
+    int16_t mHistory[kNumTaps * 2 * 2];
+    int mHistoryIndex;
+    // MODE_DECIMATE: number of frames read since the last output frame
+    // MODE_INTERPOLATE: 1 if the odd output frame of the current window is still due
+    int mHalfbandPhase;
+};
+
 // ----------------------------------------------------------------------------
 AudioResampler* AudioResampler::create(int bitDepth, int inChannelCount,
         int32_t sampleRate, int quality) {
@@ -99,7 +150,12 @@ AudioResampler* AudioResampler::create(int bitDepth, int inChannelCount,
     default:
     case LOW_QUALITY:
         ALOGV("Create linear Resampler");
-        resampler = new AudioResamplerOrder1(bitDepth, inChannelCount, sampleRate);
+        resampler = new AudioResamplerHalfband(bitDepth, inChannelCount, sampleRate);
+        break;
+    case MED_POLYPHASE_QUALITY:
+    case HIGH_POLYPHASE_QUALITY:
+        ALOGV("Create polyphase Resampler, quality %d", quality);
+        resampler = new AudioResamplerPolyphase(bitDepth, inChannelCount, sampleRate, quality);
         break;
 #if 0
     case MED_QUALITY:
@@ -619,6 +675,179 @@ void AudioResamplerOrder1::AsmStereo16Loop(int16_t *in, int32_t* maxOutPt, int32
 #endif  // ASM_ARM_RESAMP1
 
 
+// ----------------------------------------------------------------------------
+
+// Kaiser windowed (beta 7) halfband filter, Q1.15, odd taps from the center outwards.
+// The center tap is 0.5 and the taps add up to exactly unity.
+const int16_t AudioResamplerHalfband::kHalfCoefs[kNumHalfCoefs] = {
+        10197, -2831, 1160, -446, 135, -23
+};
+
+void AudioResamplerHalfband::reset() {
+    AudioResamplerOrder1::reset();
+    memset(mHistory, 0, sizeof(mHistory));
+    mHistoryIndex = 0;
+    mHalfbandPhase = 0;
+}
+
+void AudioResamplerHalfband::resample(int32_t* out, size_t outFrameCount,
+        AudioBufferProvider* provider) {
+
+    mode_t mode = MODE_GENERIC;
+    if (mInSampleRate == mSampleRate * 2) {
+        mode = MODE_DECIMATE;
+    } else if (mInSampleRate * 2 == mSampleRate) {
+        mode = MODE_INTERPOLATE;
+    }
+    if (mode != mMode) {
+        ALOGV("halfband resampler mode %d -> %d", mMode, mode);
+        if (mode == MODE_GENERIC) {
+            // mInputIndex is the next frame to read, so the last frame read is the one
+            // AudioResamplerOrder1 interpolates from
+            const int16_t* last = mHistory + (mHistoryIndex + kNumTaps) * mChannelCount;
+            mX0L = last[0];
+            mX0R = last[mChannelCount - 1];
+        } else {
+            memset(mHistory, 0, sizeof(mHistory));
+            mHistoryIndex = 0;
+            mHalfbandPhase = 0;
+        }
+        mPhaseFraction = 0;
+        mMode = mode;
+    }
+
+    switch (mode) {
+    case MODE_DECIMATE:
+        if (mChannelCount == 1) {
+            decimate<1>(out, outFrameCount, provider);
+        } else {
+            decimate<2>(out, outFrameCount, provider);
+        }
+        break;
+    case MODE_INTERPOLATE:
+        if (mChannelCount == 1) {
+            interpolate<1>(out, outFrameCount, provider);
+        } else {
+            interpolate<2>(out, outFrameCount, provider);
+        }
+        break;
+    default:
+        AudioResamplerOrder1::resample(out, outFrameCount, provider);
+        break;
+    }
+}
+
+template<int CHANNELS>
+bool AudioResamplerHalfband::read(AudioBufferProvider* provider, size_t inFrameCount,
+        size_t outputIndex) {
+    if (mBuffer.frameCount == 0) {
+        mBuffer.frameCount = inFrameCount;
+        provider->getNextBuffer(&mBuffer, calculateOutputPTS(outputIndex / 2));
+        if (mBuffer.raw == NULL) {
+            return false;
+        }
+    }
+    if (++mHistoryIndex >= kNumTaps) {
+        mHistoryIndex = 0;
+    }
+    int16_t* head = mHistory + mHistoryIndex * CHANNELS;
+    const int16_t* in = mBuffer.i16 + mInputIndex * CHANNELS;
+    head[0] = head[kNumTaps * CHANNELS] = in[0];
+    if (CHANNELS == 2) {
+        head[1] = head[kNumTaps * CHANNELS + 1] = in[1];
+    }
+    if (++mInputIndex >= mBuffer.frameCount) {
+        mInputIndex -= mBuffer.frameCount;
+        provider->releaseBuffer(&mBuffer);
+    }
+    return true;
+}
+
+template<int CHANNELS>
+void AudioResamplerHalfband::decimate(int32_t* out, size_t outFrameCount,
+        AudioBufferProvider* provider) {
+
+    const int32_t vl = mVolume[0];
+    const int32_t vr = mVolume[1];
+    size_t outputIndex = 0;
+    const size_t outputSampleCount = outFrameCount * 2;
+
+    while (outputIndex < outputSampleCount) {
+        // two input frames per output frame, that is one per output sample
+        while (mHalfbandPhase < 2) {
+            if (!read<CHANNELS>(provider, outputSampleCount - outputIndex, outputIndex)) {
+                return;
+            }
+            mHalfbandPhase++;
+        }
+        mHalfbandPhase = 0;
+
+        const int16_t* center = mHistory + (mHistoryIndex + 1 + kCenterTap) * CHANNELS;
+        int32_t l = center[0] << (kCoefBits - 1);
+        int32_t r = center[CHANNELS - 1] << (kCoefBits - 1);
+        for (int j = 0; j < kNumHalfCoefs; j++) {
+            const int offset = (2 * j + 1) * CHANNELS;
+            l += kHalfCoefs[j] * (center[-offset] + center[offset]);
+            if (CHANNELS == 2) {
+                r += kHalfCoefs[j] * (center[1 - offset] + center[1 + offset]);
+            }
+        }
+        if (CHANNELS == 1) {
+            r = l;
+        }
+        out[outputIndex++] += vl * (l >> kCoefBits);
+        out[outputIndex++] += vr * (r >> kCoefBits);
+    }
+}
+
+template<int CHANNELS>
+void AudioResamplerHalfband::interpolate(int32_t* out, size_t outFrameCount,
+        AudioBufferProvider* provider) {
+
+    const int32_t vl = mVolume[0];
+    const int32_t vr = mVolume[1];
+    size_t outputIndex = 0;
+    const size_t outputSampleCount = outFrameCount * 2;
+
+    while (outputIndex < outputSampleCount) {
+        const int16_t* center;
+        int32_t l, r;
+        if (mHalfbandPhase == 0) {
+            // even output frame: the center input frame itself,
+            // one input frame per two output frames, that is per four output samples
+            if (!read<CHANNELS>(provider, (outputSampleCount - outputIndex) / 4 + 1,
+                    outputIndex)) {
+                return;
+            }
+            center = mHistory + (mHistoryIndex + 1 + kCenterTap) * CHANNELS;
+            l = center[0];
+            r = center[CHANNELS - 1];
+            mHalfbandPhase = 1;
+        } else {
+            // odd output frame: halfway between the center frame and the next one,
+            // the filter gain is doubled to compensate for the inserted zeroes
+            center = mHistory + (mHistoryIndex + 1 + kCenterTap) * CHANNELS;
+            l = 0;
+            r = 0;
+            for (int j = 0; j < kNumHalfCoefs; j++) {
+                l += kHalfCoefs[j] * (center[-j * CHANNELS] + center[(j + 1) * CHANNELS]);
+                if (CHANNELS == 2) {
+                    r += kHalfCoefs[j] *
+                            (center[1 - j * CHANNELS] + center[1 + (j + 1) * CHANNELS]);
+                }
+            }
+            if (CHANNELS == 1) {
+                r = l;
+            }
+            l >>= kCoefBits - 1;
+            r >>= kCoefBits - 1;
+            mHalfbandPhase = 0;
+        }
+        out[outputIndex++] += vl * l;
+        out[outputIndex++] += vr * r;
+    }
+}
+
 // ----------------------------------------------------------------------------
 
 } // namespace android
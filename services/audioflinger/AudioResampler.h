@@ -31,14 +31,20 @@ public:
     //  LOW_QUALITY: linear interpolator (1st order)
     //  MED_QUALITY: cubic interpolator (3rd order)
     //  HIGH_QUALITY: fixed multi-tap FIR (e.g. 48KHz->44.1KHz)
+    //  MED_POLYPHASE_QUALITY: 16-tap polyphase windowed sinc
+    //  HIGH_POLYPHASE_QUALITY: 32-tap polyphase windowed sinc
     // NOTE: high quality SRC will only be supported for
     // certain fixed rate conversions. Sample rate cannot be
     // changed dynamically.
+    // The polyphase qualities support any conversion up to 2x in either direction,
+    // and their cost per output frame does not depend on the conversion ratio.
     enum src_quality {
         DEFAULT=0,
         LOW_QUALITY=1,
         MED_QUALITY=2,
-        HIGH_QUALITY=3
+        HIGH_QUALITY=3,
+        MED_POLYPHASE_QUALITY=4,
+        HIGH_POLYPHASE_QUALITY=5
     };
 
     static AudioResampler* create(int bitDepth, int inChannelCount,
@@ -0,0 +1,254 @@
+/*
+ * Copyright (C) 2012 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "AudioResamplerPolyphase"
+//#define LOG_NDEBUG 0
+
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/types.h>
+#include <cutils/log.h>
+
+#include "AudioResamplerPolyphase.h"
+
+#ifdef __ARM_NEON__
+#include <arm_neon.h>
+#endif
+
+namespace android {
+// ----------------------------------------------------------------------------
+
+// zeroth order modified Bessel function of the first kind, for the Kaiser window
+static double besselI0(double x)
+{
+    double sum = 1.0;
+    double term = 1.0;
+    const double x2 = x * x / 4.0;
+    for (int k = 1; k < 32; k++) {
+        term *= x2 / (k * k);
+        sum += term;
+        if (term < sum * 1e-12) {
+            break;
+        }
+    }
+    return sum;
+}
+
+AudioResamplerPolyphase::AudioResamplerPolyphase(int bitDepth,
+        int inChannelCount, int32_t sampleRate, int quality)
+    : AudioResampler(bitDepth, inChannelCount, sampleRate),
+    // MED: 16 taps x 64 phases, HIGH: 32 taps x 256 phases,
+    // the cost of one output frame is proportional to the number of taps only
+    mNumTaps(quality == MED_POLYPHASE_QUALITY ? 16 : 32),
+    mPhaseBits(quality == MED_POLYPHASE_QUALITY ? 6 : 8),
+    mRolloff(quality == MED_POLYPHASE_QUALITY ? 0.90 : 0.95),
+    mBeta(quality == MED_POLYPHASE_QUALITY ? 6.0 : 8.0),
+    mCutoff(0), mCoefs(NULL), mHistory(NULL), mHistoryIndex(0)
+{
+    mCoefs = new int16_t[mNumTaps << mPhaseBits];
+    const size_t historySize = mNumTaps * 2 * inChannelCount;
+    mHistory = new int16_t[historySize];
+    memset(mHistory, 0, sizeof(int16_t) * historySize);
+}
+
+AudioResamplerPolyphase::~AudioResamplerPolyphase()
+{
+    delete [] mCoefs;
+    delete [] mHistory;
+}
+
+void AudioResamplerPolyphase::init() {
+}
+
+void AudioResamplerPolyphase::reset() {
+    AudioResampler::reset();
+    memset(mHistory, 0, sizeof(int16_t) * mNumTaps * 2 * mChannelCount);
+    mHistoryIndex = 0;
+}
+
+void AudioResamplerPolyphase::updateCoefficients()
+{
+    // when downsampling, the cut-off follows the output Nyquist frequency
+    double cutoff = mRolloff;
+    if (mInSampleRate > mSampleRate) {
+        cutoff *= double(mSampleRate) / double(mInSampleRate);
+    }
+    if (cutoff == mCutoff) {
+        return;
+    }
+    mCutoff = cutoff;
+    ALOGV("computing %d x %d coefficients, cut-off %f", 1 << mPhaseBits, mNumTaps, cutoff);
+
+    // Phase p interpolates at fraction p / numPhases after the frame in the middle of the
+    // window, tap k is applied to the input frame at distance (k - numTaps/2 + 1 - fraction).
+    const int numPhases = 1 << mPhaseBits;
+    const double halfTaps = mNumTaps / 2;
+    const double i0Beta = besselI0(mBeta);
+    double h[kMaxNumTaps];
+    for (int p = 0; p < numPhases; p++) {
+        const double fraction = double(p) / numPhases;
+        double sum = 0;
+        for (int k = 0; k < mNumTaps; k++) {
+            const double d = k - halfTaps + 1 - fraction;
+            const double x = d / halfTaps;
+            const double window = (x <= -1.0 || x >= 1.0) ? 0.0 :
+                    besselI0(mBeta * sqrt(1.0 - x * x)) / i0Beta;
+            const double t = M_PI * cutoff * d;
+            const double sinc = (t == 0.0) ? 1.0 : sin(t) / t;
+            h[k] = sinc * window;
+            sum += h[k];
+        }
+        int16_t* coefs = mCoefs + p * mNumTaps;
+        for (int k = 0; k < mNumTaps; k++) {
+            double c = floor(h[k] / sum * (1 << kCoefBits) + 0.5);
+            if (c > 32767) {
+                c = 32767;
+            } else if (c < -32768) {
+                c = -32768;
+            }
+            coefs[k] = int16_t(c);
+        }
+    }
+}
+
+void AudioResamplerPolyphase::resample(int32_t* out, size_t outFrameCount,
+            AudioBufferProvider* provider)
+{
+    updateCoefficients();
+
+    // select the appropriate resampler
+    switch (mChannelCount) {
+    case 1:
+        resample<1>(out, outFrameCount, provider);
+        break;
+    case 2:
+        resample<2>(out, outFrameCount, provider);
+        break;
+    }
+}
+
+template<int CHANNELS>
+void AudioResamplerPolyphase::resample(int32_t* out, size_t outFrameCount,
+        AudioBufferProvider* provider)
+{
+    const int32_t vl = mVolume[0];
+    const int32_t vr = mVolume[1];
+    size_t inputIndex = mInputIndex;
+    uint32_t phaseFraction = mPhaseFraction;
+    const uint32_t phaseIncrement = mPhaseIncrement;
+    const int phaseShift = kNumPhaseBits - mPhaseBits;
+    size_t outputIndex = 0;
+    const size_t outputSampleCount = outFrameCount * 2;
+    const size_t inFrameCount = (outFrameCount*mInSampleRate)/mSampleRate + 1;
+
+    while (outputIndex < outputSampleCount) {
+        // push the input frames due before the next output frame
+        while (phaseFraction >> kNumPhaseBits) {
+            if (mBuffer.frameCount == 0) {
+                mBuffer.frameCount = inFrameCount;
+                provider->getNextBuffer(&mBuffer, calculateOutputPTS(outputIndex / 2));
+                if (mBuffer.raw == NULL) {
+                    goto resample_exit;
+                }
+            }
+            push<CHANNELS>(mBuffer.i16 + inputIndex * CHANNELS);
+            phaseFraction -= 1LU << kNumPhaseBits;
+            if (++inputIndex >= mBuffer.frameCount) {
+                inputIndex -= mBuffer.frameCount;
+                provider->releaseBuffer(&mBuffer);
+            }
+        }
+
+        // then compute as many output frames as possible from the current window
+        const int16_t* samples = mHistory + (mHistoryIndex + 1) * CHANNELS;
+        do {
+            int32_t l, r;
+            dotProduct<CHANNELS>(l, r, mCoefs + (phaseFraction >> phaseShift) * mNumTaps,
+                    samples);
+            out[outputIndex++] += vl * (l >> kCoefBits);
+            out[outputIndex++] += vr * (r >> kCoefBits);
+            phaseFraction += phaseIncrement;
+        } while (!(phaseFraction >> kNumPhaseBits) && outputIndex < outputSampleCount);
+    }
+
+resample_exit:
+    mInputIndex = inputIndex;
+    mPhaseFraction = phaseFraction;
+}
+
+template<int CHANNELS>
+void AudioResamplerPolyphase::push(const int16_t* frame)
+{
+    if (++mHistoryIndex >= mNumTaps) {
+        mHistoryIndex = 0;
+    }
+    int16_t* head = mHistory + mHistoryIndex * CHANNELS;
+    head[0] = head[mNumTaps * CHANNELS] = frame[0];
+    if (CHANNELS == 2) {
+        head[1] = head[mNumTaps * CHANNELS + 1] = frame[1];
+    }
+}
+
+template<int CHANNELS>
+void AudioResamplerPolyphase::dotProduct(int32_t& l, int32_t& r, const int16_t* coefs,
+        const int16_t* samples) const
+{
+    // The coefficients of a phase add up to unity and the window is at most a few percent
+    // above it in absolute value, so the 32-bit accumulators cannot overflow.
+#ifdef __ARM_NEON__
+    if (CHANNELS == 2) {
+        int32x4_t accL = vdupq_n_s32(0);
+        int32x4_t accR = vdupq_n_s32(0);
+        for (int i = 0; i < mNumTaps; i += 4) {
+            const int16x4x2_t s = vld2_s16(samples + i * 2);
+            const int16x4_t c = vld1_s16(coefs + i);
+            accL = vmlal_s16(accL, s.val[0], c);
+            accR = vmlal_s16(accR, s.val[1], c);
+        }
+        const int32x2_t sum = vpadd_s32(
+                vpadd_s32(vget_low_s32(accL), vget_high_s32(accL)),
+                vpadd_s32(vget_low_s32(accR), vget_high_s32(accR)));
+        l = vget_lane_s32(sum, 0);
+        r = vget_lane_s32(sum, 1);
+    } else {
+        int32x4_t acc = vdupq_n_s32(0);
+        for (int i = 0; i < mNumTaps; i += 8) {
+            const int16x8_t s = vld1q_s16(samples + i);
+            const int16x8_t c = vld1q_s16(coefs + i);
+            acc = vmlal_s16(acc, vget_low_s16(s), vget_low_s16(c));
+            acc = vmlal_s16(acc, vget_high_s16(s), vget_high_s16(c));
+        }
+        int32x2_t sum = vpadd_s32(vget_low_s32(acc), vget_high_s32(acc));
+        sum = vpadd_s32(sum, sum);
+        r = l = vget_lane_s32(sum, 0);
+    }
+#else
+    int32_t accL = 0;
+    int32_t accR = 0;
+    for (int i = 0; i < mNumTaps; i++) {
+        accL += coefs[i] * samples[i * CHANNELS];
+        if (CHANNELS == 2) {
+            accR += coefs[i] * samples[i * CHANNELS + 1];
+        }
+    }
+    l = accL;
+    r = (CHANNELS == 2) ? accR : accL;
+#endif
+}
+
+// ----------------------------------------------------------------------------
+}; // namespace android
@@ -0,0 +1,83 @@
+/*
+ * Copyright (C) 2012 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_AUDIO_RESAMPLER_POLYPHASE_H
+#define ANDROID_AUDIO_RESAMPLER_POLYPHASE_H
+
+#include <stdint.h>
+#include <sys/types.h>
+#include <cutils/log.h>
+
+#include "AudioResampler.h"
+
+namespace android {
+
+// ----------------------------------------------------------------------------
+
+// Windowed sinc resampler using a table of precomputed polyphase filters.
+// Unlike AudioResamplerSinc, the coefficients of each phase are computed once when the
+// sample rate ratio changes, so that each output frame costs a single dot product of
+// numTaps input frames, which is done with NEON when available.
+class AudioResamplerPolyphase : public AudioResampler {
+public:
+    AudioResamplerPolyphase(int bitDepth, int inChannelCount, int32_t sampleRate,
+            int quality);
+
+    virtual ~AudioResamplerPolyphase();
+
+    virtual void resample(int32_t* out, size_t outFrameCount,
+            AudioBufferProvider* provider);
+    virtual void reset();
+
+private:
+    void init();
+
+    // (re)computes mCoefs if the cut-off frequency changed since the last call
+    void updateCoefficients();
+
+    template<int CHANNELS>
+    void resample(int32_t* out, size_t outFrameCount,
+            AudioBufferProvider* provider);
+
+    template<int CHANNELS>
+    inline void dotProduct(int32_t& l, int32_t& r, const int16_t* coefs,
+            const int16_t* samples) const;
+
+    template<int CHANNELS>
+    inline void push(const int16_t* frame);
+
+    // coefficients are Q1.15, the sum of each phase is normalized to unity gain
+    static const int kCoefBits = 15;
+    static const int kMaxNumTaps = 32;
+
+    const int       mNumTaps;       // filter length, multiple of 8
+    const int       mPhaseBits;     // log2 of the number of phases
+    const double    mRolloff;       // cut-off frequency relative to the Nyquist frequency
+    const double    mBeta;          // Kaiser window parameter
+
+    double          mCutoff;        // cut-off used for mCoefs, 0 if not computed yet
+    int16_t*        mCoefs;         // (1 << mPhaseBits) phases of mNumTaps coefficients
+
+    // the last mNumTaps input frames are written twice so that the filter window
+    // is always contiguous: it starts right after the newest frame at mHistoryIndex
+    int16_t*        mHistory;
+    int             mHistoryIndex;
+};
+
+// ----------------------------------------------------------------------------
+}; // namespace android
+
+#endif /*ANDROID_AUDIO_RESAMPLER_POLYPHASE_H*/
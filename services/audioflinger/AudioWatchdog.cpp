@@ -17,11 +17,58 @@
 #define LOG_TAG "AudioWatchdog"
 //#define LOG_NDEBUG 0
 
+#include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <cutils/properties.h>
 #include <utils/Log.h>
 #include "AudioWatchdog.h"
+#include "SchedulingPolicyService.h"
+
+#define MIN_TIME_BETWEEN_LOGS_SEC 60
+
+// A boost starts when the load of a client, extrapolated over this many watchdog cycles along
+// its trend, exceeds kBoostLoad permille of its period, or when one of its cycles runs late.
+// It ends after kReleaseCycles consecutive cycles in which no client exceeds kReleaseLoad.
+static const int32_t kLookaheadCycles = 4;
+static const int32_t kBoostLoad = 700;
+static const int32_t kReleaseLoad = 400;
+static const uint32_t kReleaseCycles = 20;
 
 namespace android {
 
+AudioWatchdog::AudioWatchdog(unsigned periodMs) : Thread(false /*canCallJava*/), mPaused(false),
+        mPeriodNs(periodMs * 1000000), mMaxCycleNs(mPeriodNs * 2),
+        // mOldTs
+        // mLogTs initialized below
+        mOldTsValid(false), mUnderruns(0), mLogs(0), mDump(&mDummyDump),
+        // mClients initialized by addClient()
+        mNumClients(0), mBoosted(false), mHeadroomCycles(0), mBoosts(0), mPriorityBoosts(0),
+        mFrequencyBoosts(0), mBoostedNs(0), mCpuFloorKHz(0)
+{
+    // force an immediate log on first underrun
+    mLogTs.tv_sec = MIN_TIME_BETWEEN_LOGS_SEC;
+    mLogTs.tv_nsec = 0;
+
+    char value[PROPERTY_VALUE_MAX];
+    if (property_get("ro.audio.cpu_floor_khz", value, NULL) > 0) {
+        mCpuFloorKHz = atoi(value);
+    }
+    memset(mSavedMinKHz, 0, sizeof(mSavedMinKHz));
+}
+
+AudioWatchdog::~AudioWatchdog()
+{
+    // don't leave a CPU frequency floor behind
+    if (mBoosted) {
+        unboost();
+    }
+}
+
 void AudioWatchdogDump::dump(int fd)
 {
     char buf[32];
@@ -33,6 +80,212 @@ void AudioWatchdogDump::dump(int fd)
     }
     fdprintf(fd, "Watchdog: underruns=%u, logs=%u, most recent underrun log at %s",
             mUnderruns, mLogs, buf);
+    fdprintf(fd, "Watchdog: boosts=%u, priority boosts=%u, frequency floors=%u, "
+            "boosted for %u ms, %s\n", mBoosts, mPriorityBoosts, mFrequencyBoosts, mBoostedMs,
+            mBoosted ? "boosted now" : "not boosted now");
+}
+
+int AudioWatchdog::addClient(const char* name, uint32_t periodNs, uint32_t lateNs,
+        int32_t boostPriority)
+{
+    AutoMutex _l(mMyLock);
+    int32_t index = mNumClients;
+    if (index >= kMaxClients) {
+        return -1;
+    }
+    Client* c = &mClients[index];
+    c->mName = name;
+    c->mPeriodNs = periodNs;
+    c->mLateNs = lateNs;
+    c->mBoostPriority = boostPriority;
+    c->mTid = 0;
+    c->mWorkNs = 0;
+    c->mLateCycles = 0;
+    c->mCycles = 0;
+    c->mOldCycles = 0;
+    c->mOldWorkNs = 0;
+    c->mOldLateCycles = 0;
+    c->mLoad = 0;
+    c->mTrend = 0;
+    c->mBoosted = false;
+    c->mOldNice = 0;
+    // publishes the client to the watchdog thread
+    android_atomic_release_store(index + 1, &mNumClients);
+    return index;
+}
+
+void AudioWatchdog::checkClients(bool cpuShortage, uint32_t cycleNs)
+{
+    bool wantBoost = cpuShortage;
+    bool headroom = !cpuShortage;
+    int32_t numClients = android_atomic_acquire_load(&mNumClients);
+    for (int32_t i = 0; i < numClients; ++i) {
+        Client* c = &mClients[i];
+        int32_t cycles = android_atomic_acquire_load(&c->mCycles);
+        int32_t deltaCycles = cycles - c->mOldCycles;
+        if (deltaCycles <= 0) {
+            // idle, e.g. in standby: neither needs a boost nor prevents releasing one
+            continue;
+        }
+        uint32_t deltaWorkNs = c->mWorkNs - c->mOldWorkNs;
+        uint32_t deltaLateCycles = c->mLateCycles - c->mOldLateCycles;
+        c->mOldCycles = cycles;
+        c->mOldWorkNs += deltaWorkNs;
+        c->mOldLateCycles += deltaLateCycles;
+
+        int32_t load = (int32_t) (((uint64_t) deltaWorkNs * 1000) /
+                ((uint64_t) deltaCycles * c->mPeriodNs));
+        int32_t oldLoad = c->mLoad;
+        c->mLoad += (load - c->mLoad) / 4;
+        c->mTrend += ((c->mLoad - oldLoad) - c->mTrend) / 4;
+
+        if (deltaLateCycles > 0 || c->mLoad + c->mTrend * kLookaheadCycles > kBoostLoad) {
+            if (!mBoosted) {
+                ALOGV("%s: load %d trend %d permille, %u late cycles; boosting", c->mName,
+                        c->mLoad, c->mTrend, deltaLateCycles);
+            }
+            wantBoost = true;
+        }
+        if (deltaLateCycles > 0 || c->mLoad > kReleaseLoad) {
+            headroom = false;
+        }
+    }
+
+    if (mBoosted) {
+        mBoostedNs += cycleNs;
+        mDump->mBoostedMs = (uint32_t) (mBoostedNs / 1000000);
+    }
+    if (wantBoost) {
+        mHeadroomCycles = 0;
+        if (!mBoosted) {
+            boost();
+        }
+    } else if (mBoosted) {
+        if (!headroom) {
+            mHeadroomCycles = 0;
+        } else if (++mHeadroomCycles >= kReleaseCycles) {
+            unboost();
+        }
+    }
+}
+
+void AudioWatchdog::boost()
+{
+    mBoosted = true;
+    mDump->mBoosted = true;
+    mDump->mBoosts = ++mBoosts;
+#ifdef HAVE_REQUEST_PRIORITY
+    int32_t numClients = android_atomic_acquire_load(&mNumClients);
+    for (int32_t i = 0; i < numClients; ++i) {
+        Client* c = &mClients[i];
+        if (c->mBoostPriority == 0 || c->mTid == 0) {
+            continue;
+        }
+        errno = 0;
+        int nice = getpriority(PRIO_PROCESS, c->mTid);
+        if (errno != 0) {
+            continue;
+        }
+        int err = requestPriority(getpid(), c->mTid, c->mBoostPriority);
+        if (err != 0) {
+            ALOGW("Policy SCHED_FIFO priority %d is unavailable for %s tid %d; error %d",
+                    c->mBoostPriority, c->mName, c->mTid, err);
+            continue;
+        }
+        c->mOldNice = nice;
+        c->mBoosted = true;
+        mDump->mPriorityBoosts = ++mPriorityBoosts;
+    }
+#endif
+    if (mCpuFloorKHz > 0 && setCpuFloor(true)) {
+        mDump->mFrequencyBoosts = ++mFrequencyBoosts;
+    }
+}
+
+void AudioWatchdog::unboost()
+{
+    int32_t numClients = android_atomic_acquire_load(&mNumClients);
+    for (int32_t i = 0; i < numClients; ++i) {
+        Client* c = &mClients[i];
+        if (!c->mBoosted) {
+            continue;
+        }
+        // lowering our own threads' priority needs no privilege
+        struct sched_param param;
+        param.sched_priority = 0;
+        sched_setscheduler(c->mTid, SCHED_OTHER, &param);
+        setpriority(PRIO_PROCESS, c->mTid, c->mOldNice);
+        c->mBoosted = false;
+    }
+    setCpuFloor(false);
+    mBoosted = false;
+    mDump->mBoosted = false;
+    mHeadroomCycles = 0;
+}
+
+static bool readKHz(const char* path, uint32_t* kHz)
+{
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    char buf[16];
+    ssize_t n = read(fd, buf, sizeof(buf) - 1);
+    close(fd);
+    if (n <= 0) {
+        return false;
+    }
+    buf[n] = '\0';
+    *kHz = strtoul(buf, NULL, 10);
+    return true;
+}
+
+static bool writeKHz(const char* path, uint32_t kHz)
+{
+    int fd = open(path, O_WRONLY);
+    if (fd < 0) {
+        return false;
+    }
+    char buf[16];
+    int len = snprintf(buf, sizeof(buf), "%u", kHz);
+    bool ok = write(fd, buf, len) == len;
+    close(fd);
+    return ok;
+}
+
+bool AudioWatchdog::setCpuFloor(bool enable)
+{
+    bool raised = false;
+    bool failed = false;
+    for (int cpu = 0; cpu < kMaxCpus; ++cpu) {
+        char path[64];
+        snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/cpufreq/scaling_min_freq",
+                cpu);
+        if (!enable) {
+            if (mSavedMinKHz[cpu] != 0) {
+                writeKHz(path, mSavedMinKHz[cpu]);
+                mSavedMinKHz[cpu] = 0;
+            }
+            continue;
+        }
+        uint32_t kHz;
+        // an offline CPU has no cpufreq directory
+        if (!readKHz(path, &kHz) || kHz >= mCpuFloorKHz) {
+            continue;
+        }
+        if (writeKHz(path, mCpuFloorKHz)) {
+            mSavedMinKHz[cpu] = kHz;
+            raised = true;
+        } else {
+            failed = true;
+        }
+    }
+    if (failed && !raised) {
+        ALOGW("Unable to set a CPU frequency floor of %u kHz, errno %d; disabled",
+                mCpuFloorKHz, errno);
+        mCpuFloorKHz = 0;
+    }
+    return raised;
 }
 
 bool AudioWatchdog::threadLoop()
@@ -40,6 +293,10 @@ bool AudioWatchdog::threadLoop()
     {
         AutoMutex _l(mMyLock);
         if (mPaused) {
+            // nothing to protect while the mixers are idle
+            if (mBoosted) {
+                unboost();
+            }
             mMyCond.wait(mMyLock);
             // ignore previous timestamp after resume()
             mOldTsValid = false;
@@ -93,6 +350,7 @@ bool AudioWatchdog::threadLoop()
             mLogTs.tv_nsec = 0;
         }
     }
+    checkClients(cycleNs > mMaxCycleNs, cycleNs);
     struct timespec req;
     req.tv_sec = 0;
     req.tv_nsec = mPeriodNs;
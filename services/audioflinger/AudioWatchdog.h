@@ -17,12 +17,17 @@
 // The watchdog thread runs periodically.  It has two functions:
 //   (a) verify that adequate CPU time is available, and log
 //       as soon as possible when there appears to be a CPU shortage
-//   (b) monitor the other threads [not yet implemented]
+//   (b) monitor the other threads: clients such as FastMixer and the normal mixer report the
+//       CPU time each of their cycles took, and when the trend of that load predicts an
+//       underrun the watchdog boosts them, until there is enough headroom again
 
 #ifndef AUDIO_WATCHDOG_H
 #define AUDIO_WATCHDOG_H
 
+#include <sys/types.h>
 #include <time.h>
+#include <unistd.h>
+#include <cutils/atomic.h>
 #include <utils/Thread.h>
 
 namespace android {
@@ -30,29 +35,25 @@ namespace android {
 // Keeps a cache of AudioWatchdog statistics that can be logged by dumpsys.
 // The usual caveats about atomicity of information apply.
 struct AudioWatchdogDump {
-    AudioWatchdogDump() : mUnderruns(0), mLogs(0), mMostRecent(0) { }
+    AudioWatchdogDump() : mUnderruns(0), mLogs(0), mMostRecent(0), mBoosts(0),
+            mPriorityBoosts(0), mFrequencyBoosts(0), mBoostedMs(0), mBoosted(false) { }
     /*virtual*/ ~AudioWatchdogDump() { }
     uint32_t mUnderruns;    // total number of underruns
     uint32_t mLogs;         // total number of log messages
     time_t   mMostRecent;   // time of most recent log
+    uint32_t mBoosts;       // total number of times an underrun was predicted and a boost started
+    uint32_t mPriorityBoosts;   // total number of client thread priority boosts granted
+    uint32_t mFrequencyBoosts;  // total number of times a CPU frequency floor was applied
+    uint32_t mBoostedMs;    // total time spent boosted
+    bool     mBoosted;      // whether a boost is in effect
     void     dump(int fd);  // should only be called on a stable copy, not the original
 };
 
 class AudioWatchdog : public Thread {
 
 public:
-    AudioWatchdog(unsigned periodMs = 50) : Thread(false /*canCallJava*/), mPaused(false),
-            mPeriodNs(periodMs * 1000000), mMaxCycleNs(mPeriodNs * 2),
-            // mOldTs
-            // mLogTs initialized below
-            mOldTsValid(false), mUnderruns(0), mLogs(0), mDump(&mDummyDump)
-        {
-#define MIN_TIME_BETWEEN_LOGS_SEC 60
-            // force an immediate log on first underrun
-            mLogTs.tv_sec = MIN_TIME_BETWEEN_LOGS_SEC;
-            mLogTs.tv_nsec = 0;
-        }
-    virtual         ~AudioWatchdog() { }
+    AudioWatchdog(unsigned periodMs = 50);
+    virtual         ~AudioWatchdog();
 
      // Do not call Thread::requestExitAndWait() without first calling requestExit().
     // Thread::requestExitAndWait() is not virtual, and the implementation doesn't do enough.
@@ -65,9 +66,64 @@ public:
     // Where to store the dump, or NULL to not update
     void            setDump(AudioWatchdogDump* dump);
 
+    static const int kMaxClients = 4;
+
+    // Registers a thread that will call reportCycle() once per cycle.  periodNs is its nominal
+    // cycle time, and a cycle longer than lateNs is taken as a sign of an impending underrun.
+    // boostPriority is the SCHED_FIFO priority (1 or 2) to request for it while boosted,
+    // or 0 if it already runs at a sufficient priority.
+    // Returns the client index, or -1 if there are already kMaxClients.
+    int             addClient(const char* name, uint32_t periodNs, uint32_t lateNs,
+                            int32_t boostPriority);
+
+    // Called by the client thread at the end of each cycle; never blocks.  workNs is the CPU time
+    // the cycle needed, and cycleNs is the time since the end of the previous cycle.
+    void            reportCycle(int client, uint32_t workNs, uint32_t cycleNs) {
+                        Client* c = &mClients[client];
+                        if (c->mTid == 0) {
+                            c->mTid = gettid();
+                        }
+                        c->mWorkNs += workNs;
+                        if (cycleNs > c->mLateNs) {
+                            c->mLateCycles++;
+                        }
+                        // publishes the stores above to the watchdog thread
+                        android_atomic_release_store(c->mCycles + 1, &c->mCycles);
+                    }
+
 private:
     virtual bool    threadLoop();
 
+    // Per-client statistics.  The totals wrap around; only their deltas are used.
+    struct Client {
+        // immutable after addClient()
+        const char* mName;
+        uint32_t    mPeriodNs;      // nominal cycle time
+        uint32_t    mLateNs;        // a cycle taking longer than this is close to an underrun
+        int32_t     mBoostPriority; // SCHED_FIFO priority while boosted, or 0
+        // written only by the client thread, in reportCycle()
+        pid_t       mTid;           // 0 until the first report
+        uint32_t    mWorkNs;        // total CPU time of all cycles
+        uint32_t    mLateCycles;    // total number of late cycles
+        volatile int32_t mCycles;   // total number of cycles, stored last
+        // used only by the watchdog thread
+        int32_t     mOldCycles;     // values of the totals at the previous watchdog cycle
+        uint32_t    mOldWorkNs;
+        uint32_t    mOldLateCycles;
+        int32_t     mLoad;          // smoothed CPU time per cycle, in permille of mPeriodNs
+        int32_t     mTrend;         // smoothed change of mLoad per watchdog cycle
+        bool        mBoosted;       // whether its priority is boosted
+        int         mOldNice;       // nice value to restore when the boost ends
+    };
+
+    // Examines the load of the clients since the previous call, and starts or ends a boost.
+    // cpuShortage is true if the watchdog itself ran late.
+    void            checkClients(bool cpuShortage, uint32_t cycleNs);
+    void            boost();
+    void            unboost();
+    // Raises or restores the minimum CPU frequency, returns whether any CPU was raised
+    bool            setCpuFloor(bool enable);
+
     Mutex           mMyLock;        // Thread::mLock is private
     Condition       mMyCond;        // Thread::mThreadExitedCondition is private
     bool            mPaused;        // whether thread is currently paused
@@ -81,6 +137,18 @@ private:
     uint32_t        mLogs;          // total number of logs
     AudioWatchdogDump*  mDump;      // where to store the dump, always non-NULL
     AudioWatchdogDump   mDummyDump; // default area for dump in case setDump() is not called
+
+    Client          mClients[kMaxClients];
+    volatile int32_t mNumClients;   // number of entries of mClients that are initialized
+    bool            mBoosted;       // whether a boost is in effect
+    uint32_t        mHeadroomCycles;    // consecutive cycles with enough headroom while boosted
+    uint32_t        mBoosts;        // total number of boosts
+    uint32_t        mPriorityBoosts;    // total number of client priority boosts
+    uint32_t        mFrequencyBoosts;   // total number of CPU frequency floors applied
+    uint64_t        mBoostedNs;     // total time spent boosted
+    uint32_t        mCpuFloorKHz;   // from ro.audio.cpu_floor_khz, or 0 to not touch cpufreq
+    static const int kMaxCpus = 8;
+    uint32_t        mSavedMinKHz[kMaxCpus]; // scaling_min_freq replaced by the floor, or 0
 };
 
 }   // namespace android
@@ -0,0 +1,91 @@
+/*
+ * Copyright (C) 2012 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "CycleProfiler"
+//#define LOG_NDEBUG 0
+
+#include <string.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <utils/String8.h>
+#include "CycleProfiler.h"
+
+namespace android {
+
+void CycleProfiler::reset()
+{
+    memset(mStats, 0, sizeof(mStats));
+    mXruns = 0;
+    mResetTime = systemTime();
+}
+
+void CycleProfiler::record(event_t event, nsecs_t ns)
+{
+    Stats& stats = mStats[event];
+    uint32_t us = ns > 0 ? (uint32_t) (ns / 1000) : 0;
+    int bucket = 31 - __builtin_clz(us | 1);
+    if (bucket >= kNumBuckets) {
+        bucket = kNumBuckets - 1;
+    }
+    stats.mBuckets[bucket]++;
+    stats.mTotalUs += us;
+    if (us > stats.mMaxUs) {
+        stats.mMaxUs = us;
+    }
+    stats.mCount++;
+}
+
+void CycleProfiler::dump(int fd) const
+{
+    static const char * const names[NUM_EVENTS] = {
+        "mix", "write", "read", "sleep overshoot"
+    };
+    const size_t SIZE = 256;
+    char buffer[SIZE];
+    String8 result;
+
+    // work on a copy so that the statistics printed are consistent with each other
+    CycleProfiler copy(*this);
+
+    snprintf(buffer, SIZE, "Cycle profile over the last %llu secs, xruns: %u\n",
+            ns2s(systemTime() - copy.mResetTime), copy.mXruns);
+    result.append(buffer);
+    for (int i = 0; i < NUM_EVENTS; i++) {
+        const Stats& stats = copy.mStats[i];
+        if (stats.mCount == 0) {
+            continue;
+        }
+        snprintf(buffer, SIZE, "  %s: count=%u mean=%.3f ms max=%.3f ms\n    us:",
+                names[i], stats.mCount, stats.mTotalUs / (stats.mCount * 1000.0),
+                stats.mMaxUs / 1000.0);
+        result.append(buffer);
+        for (int j = 0; j < kNumBuckets; j++) {
+            if (stats.mBuckets[j] == 0) {
+                continue;
+            }
+            if (j == kNumBuckets - 1) {
+                snprintf(buffer, SIZE, " >=%u:%u", 1u << j, stats.mBuckets[j]);
+            } else {
+                snprintf(buffer, SIZE, " <%u:%u", 2u << j, stats.mBuckets[j]);
+            }
+            result.append(buffer);
+        }
+        result.append("\n");
+    }
+    write(fd, result.string(), result.size());
+}
+
+};  // namespace android
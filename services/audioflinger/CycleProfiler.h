@@ -0,0 +1,71 @@
+/*
+ * Copyright (C) 2012 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_AUDIO_CYCLE_PROFILER_H
+#define ANDROID_AUDIO_CYCLE_PROFILER_H
+
+#include <stdint.h>
+#include <utils/Timers.h>
+
+namespace android {
+
+// Cheap timing statistics for the threadLoop of a normal mixer, direct or record thread,
+// similar in spirit to FastMixerDumpState.  Durations are accumulated into a fixed-size
+// histogram with power of two buckets in microseconds, so that recording costs a few
+// integer operations and no allocation.
+// There is a single writer, the thread itself, and no lock: dumpsys may observe
+// a partially updated sample, which is acceptable for diagnostics.
+class CycleProfiler {
+public:
+    enum event_t {
+        MIX,                // PlaybackThread::threadLoop_mix()
+        WRITE,              // PlaybackThread::threadLoop_write()
+        READ,               // input stream read in RecordThread
+        SLEEP_OVERSHOOT,    // time slept beyond the requested sleep time
+        NUM_EVENTS
+    };
+
+    // bucket i counts durations in [2^i, 2^(i+1)) us, the last bucket is open ended
+    static const int kNumBuckets = 20;
+
+    CycleProfiler() { reset(); }
+
+    void        reset();
+
+    // record one occurrence of event lasting ns nanoseconds
+    void        record(event_t event, nsecs_t ns);
+
+    // record a playback underrun (write blocked too long) or capture overrun
+    void        xrun() { mXruns++; }
+
+    void        dump(int fd) const;
+
+private:
+    struct Stats {
+        uint32_t    mCount;
+        uint32_t    mMaxUs;
+        uint64_t    mTotalUs;
+        uint32_t    mBuckets[kNumBuckets];
+    };
+
+    Stats       mStats[NUM_EVENTS];
+    uint32_t    mXruns;
+    nsecs_t     mResetTime;     // systemTime() of the last reset()
+};
+
+};  // namespace android
+
+#endif  // ANDROID_AUDIO_CYCLE_PROFILER_H
@@ -0,0 +1,69 @@
+/*
+ * Copyright (C) 2012 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_AUDIO_FAST_CAPTURE_H
+#define ANDROID_AUDIO_FAST_CAPTURE_H
+
+#include <utils/Thread.h>
+extern "C" {
+#include "../private/bionic_futex.h"
+}
+#include "StateQueue.h"
+#include "FastCaptureState.h"
+
+namespace android {
+
+typedef StateQueue<FastCaptureState> FastCaptureStateQueue;
+
+// Reads the HAL input in small chunks at SCHED_FIFO priority, and writes what it reads into
+// a non-blocking MonoPipe for the RecordThread and optionally into the capture Pipe, so that
+// neither the HAL read period nor direct capture readers depend on RecordThread scheduling.
+class FastCapture : public Thread {
+
+public:
+            FastCapture() : Thread(false /*canCallJava*/) { }
+    virtual ~FastCapture() { }
+
+            FastCaptureStateQueue* sq() { return &mSQ; }
+
+private:
+    virtual bool                threadLoop();
+            FastCaptureStateQueue mSQ;
+
+};  // class FastCapture
+
+// The FastCaptureDumpState keeps a cache of FastCapture statistics that can be logged by dumpsys.
+// Like FastMixerDumpState, each word-sized field is accessed atomically but the structure as
+// a whole is not, and it has a different lifetime than the FastCapture.
+struct FastCaptureDumpState {
+    FastCaptureDumpState();
+    /*virtual*/ ~FastCaptureDumpState();
+
+    void dump(int fd);          // should only be called on a stable copy, not the original
+
+    FastCaptureState::Command mCommand; // current command
+    uint32_t mReadSequence;     // incremented before and after each read()
+    uint32_t mFramesRead;       // total number of frames read successfully
+    uint32_t mReadErrors;       // total number of read() errors
+    uint32_t mOverruns;         // total number of reads not fully written to the pipe sink
+    uint32_t mSampleRate;
+    size_t   mFrameCount;
+    uint32_t mMaxReadNs;        // longest read() since the last cold idle
+};
+
+}   // namespace android
+
+#endif  // ANDROID_AUDIO_FAST_CAPTURE_H
@@ -29,6 +29,9 @@
 #endif
 #endif
 #include "AudioMixer.h"
+#ifdef AUDIO_WATCHDOG
+#include "AudioWatchdog.h"
+#endif
 #include "FastMixer.h"
 
 #define FAST_HOT_IDLE_NS     1000000L   // 1 ms: time to sleep while hot idling
@@ -84,6 +87,10 @@ bool FastMixer::threadLoop()
     struct timespec measuredWarmupTs = {0, 0};  // how long did it take for warmup to complete
     uint32_t warmupCycles = 0;  // counter of number of loop cycles required to warmup
     NBAIO_Sink* teeSink = NULL; // if non-NULL, then duplicate write() to this non-blocking sink
+#ifdef AUDIO_WATCHDOG
+    AudioWatchdog* watchdog = NULL; // if non-NULL, then report the load of each cycle to it
+    int watchdogClient = -1;
+#endif
 
     for (;;) {
 
@@ -114,6 +121,10 @@ bool FastMixer::threadLoop()
             // As soon as possible of learning of a new dump area, start using it
             dumpState = next->mDumpState != NULL ? next->mDumpState : &dummyDumpState;
             teeSink = next->mTeeSink;
+#ifdef AUDIO_WATCHDOG
+            watchdog = next->mWatchdog;
+            watchdogClient = next->mWatchdogClient;
+#endif
 
             // We want to always have a valid reference to the previous (non-idle) state.
             // However, the state queue only guarantees access to current and previous states.
@@ -290,6 +301,9 @@ bool FastMixer::threadLoop()
                                 (void *) mixBuffer);
                         // newly allocated track names default to full scale volume
                         if (fastTrack->mSampleRate != 0 && fastTrack->mSampleRate != sampleRate) {
+                            // only the low cost resampler fits in the fast mixer's budget
+                            mixer->setParameter(name, AudioMixer::RESAMPLE,
+                                    AudioMixer::QUALITY, (void*) AudioResampler::LOW_QUALITY);
                             mixer->setParameter(name, AudioMixer::RESAMPLE,
                                     AudioMixer::SAMPLE_RATE, (void*) fastTrack->mSampleRate);
                         }
@@ -322,6 +336,8 @@ bool FastMixer::threadLoop()
                             }
                             if (fastTrack->mSampleRate != 0 &&
                                     fastTrack->mSampleRate != sampleRate) {
+                                mixer->setParameter(name, AudioMixer::RESAMPLE,
+                                        AudioMixer::QUALITY, (void*) AudioResampler::LOW_QUALITY);
                                 mixer->setParameter(name, AudioMixer::RESAMPLE,
                                         AudioMixer::SAMPLE_RATE, (void*) fastTrack->mSampleRate);
                             } else {
@@ -400,7 +416,14 @@ bool FastMixer::threadLoop()
                 ftDump->mFramesReady = framesReady;
             }
             // process() is CPU-bound
+#if defined(ATRACE_TAG) && (ATRACE_TAG != ATRACE_TAG_NEVER)
+            ATRACE_INT("fastMixedTracks", popcount(current->mTrackMask));
+            Tracer::traceBegin(ATRACE_TAG, "mix");
+#endif
             mixer->process(AudioBufferProvider::kInvalidPTS);
+#if defined(ATRACE_TAG) && (ATRACE_TAG != ATRACE_TAG_NEVER)
+            Tracer::traceEnd(ATRACE_TAG);
+#endif
             mixBufferState = MIXED;
         } else if (mixBufferState == MIXED) {
             mixBufferState = UNDEFINED;
@@ -558,6 +581,11 @@ bool FastMixer::threadLoop()
                 // this store #4 is not atomic with respect to stores #1, #2, #3 above, but
                 // the newest open and oldest closed halves are atomic with respect to each other
                 dumpState->mBounds = bounds;
+#ifdef AUDIO_WATCHDOG
+                if (watchdog != NULL) {
+                    watchdog->reportCycle(watchdogClient, loadNs, monotonicNs);
+                }
+#endif
 #if defined(ATRACE_TAG) && (ATRACE_TAG != ATRACE_TAG_NEVER)
                 ATRACE_INT("cycle_ms", monotonicNs / 1000000);
                 ATRACE_INT("load_us", loadNs / 1000);
@@ -710,7 +738,7 @@ void FastMixerDumpState::dump(int fd)
     // The active track mask and track states are updated non-atomically.
     // So if we relied on isActive to decide whether to display,
     // then we might display an obsolete track or omit an active track.
-    // Instead we always display all tracks, with an indication
+    // Instead we always display all tracks that have been used, with an indication
     // of whether we think the track is active.
     uint32_t trackMask = mTrackMask;
     fdprintf(fd, "Fast tracks: kMaxFastTracks=%u activeMask=%#x\n",
@@ -720,6 +748,10 @@ void FastMixerDumpState::dump(int fd)
         bool isActive = trackMask & 1;
         const FastTrackDump *ftDump = &mTracks[i];
         const FastTrackUnderruns& underruns = ftDump->mUnderruns;
+        // with a large capacity most slots are never used, skip them
+        if (!isActive && underruns.mAtomic == 0 && ftDump->mFramesReady == 0) {
+            continue;
+        }
         const char *mostRecent;
         switch (underruns.mBitFields.mMostRecent) {
         case UNDERRUN_FULL:
@@ -31,7 +31,7 @@ FastTrack::~FastTrack()
 FastMixerState::FastMixerState() :
     mFastTracksGen(0), mTrackMask(0), mOutputSink(NULL), mOutputSinkGen(0),
     mFrameCount(0), mCommand(INITIAL), mColdFutexAddr(NULL), mColdGen(0),
-    mDumpState(NULL), mTeeSink(NULL)
+    mDumpState(NULL), mTeeSink(NULL), mWatchdog(NULL), mWatchdogClient(-1)
 {
 }
 
@@ -39,4 +39,25 @@ FastMixerState::~FastMixerState()
 {
 }
 
+template<> void StateQueueCopy<FastMixerState>(FastMixerState *dst, const FastMixerState *src)
+{
+    for (unsigned i = 0; i < FastMixerState::kMaxFastTracks; ++i) {
+        if (dst->mFastTracks[i].mGeneration != src->mFastTracks[i].mGeneration) {
+            dst->mFastTracks[i] = src->mFastTracks[i];
+        }
+    }
+    dst->mFastTracksGen = src->mFastTracksGen;
+    dst->mTrackMask = src->mTrackMask;
+    dst->mOutputSink = src->mOutputSink;
+    dst->mOutputSinkGen = src->mOutputSinkGen;
+    dst->mFrameCount = src->mFrameCount;
+    dst->mCommand = src->mCommand;
+    dst->mColdFutexAddr = src->mColdFutexAddr;
+    dst->mColdGen = src->mColdGen;
+    dst->mDumpState = src->mDumpState;
+    dst->mTeeSink = src->mTeeSink;
+    dst->mWatchdog = src->mWatchdog;
+    dst->mWatchdogClient = src->mWatchdogClient;
+}
+
 }   // namespace android
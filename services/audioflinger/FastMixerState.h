@@ -20,9 +20,11 @@
 #include <system/audio.h>
 #include "ExtendedAudioBufferProvider.h"
 #include "NBAIO.h"
+#include "StateQueue.h"
 
 namespace android {
 
+class AudioWatchdog;
 struct FastMixerDumpState;
 
 class VolumeProvider {
@@ -52,7 +54,10 @@ struct FastMixerState {
                 FastMixerState();
     /*virtual*/ ~FastMixerState();
 
-    static const unsigned kMaxFastTracks = 8;   // must be between 2 and 32 inclusive
+    // Capacity of the state; the number of fast track slots actually offered by the normal
+    // mixer is kDefaultFastTracks unless overridden by property ro.audio.fast_track_count.
+    static const unsigned kMaxFastTracks = 32;  // must be between 2 and 32 inclusive
+    static const unsigned kDefaultFastTracks = 8;
 
     // all pointer fields use raw pointers; objects are owned and ref-counted by the normal mixer
     FastTrack   mFastTracks[kMaxFastTracks];
@@ -77,8 +82,14 @@ struct FastMixerState {
     // This might be a one-time configuration rather than per-state
     FastMixerDumpState* mDumpState; // if non-NULL, then update dump state periodically
     NBAIO_Sink* mTeeSink;       // if non-NULL, then duplicate write()s to this non-blocking sink
+    AudioWatchdog* mWatchdog;   // if non-NULL, then report the load of each cycle to the watchdog
+    int         mWatchdogClient;    // client index returned by mWatchdog->addClient()
 };  // struct FastMixerState
 
+// Copies only the fast tracks whose mGeneration differs, as every assignment to a fast track
+// increments it; that avoids copying the whole array when one track is added or removed.
+template<> void StateQueueCopy<FastMixerState>(FastMixerState *dst, const FastMixerState *src);
+
 }   // namespace android
 
 #endif  // ANDROID_AUDIO_FAST_MIXER_STATE_H
@@ -0,0 +1,178 @@
+/*
+ * Copyright (C) 2012 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "MultiPipe"
+//#define LOG_NDEBUG 0
+
+#include <string.h>
+#include <cutils/atomic.h>
+#include <cutils/compiler.h>
+#include <utils/Log.h>
+#include "MultiPipe.h"
+#include "roundup.h"
+
+namespace android {
+
+MultiPipe::MultiPipe(size_t maxFrames, NBAIO_Format format, unsigned maxWriters) :
+        NBAIO_Source(format),
+        mMaxFrames(roundup(maxFrames)),
+        mMaxWriters(maxWriters < kMaxWriters ? maxWriters : kMaxWriters),
+        mBuffer(malloc(mMaxWriters * mMaxFrames * Format_frameSize(format))),
+        mLanes(new Lane[mMaxWriters]),
+        mWriterMask(0),
+        mFront(0)
+{
+    for (unsigned i = 0; i < mMaxWriters; ++i) {
+        mLanes[i].mRear = 0;
+    }
+}
+
+MultiPipe::~MultiPipe()
+{
+    ALOG_ASSERT(android_atomic_acquire_load(&mWriterMask) == 0);
+    delete[] mLanes;
+    free(mBuffer);
+}
+
+int MultiPipe::attachWriter()
+{
+    const uint32_t allLanes = mMaxWriters >= 32 ? ~0U : (1U << mMaxWriters) - 1;
+    for (;;) {
+        int32_t mask = android_atomic_acquire_load(&mWriterMask);
+        uint32_t freeLanes = ~(uint32_t) mask & allLanes;
+        if (freeLanes == 0) {
+            return -1;
+        }
+        int i = __builtin_ctz(freeLanes);
+        // A new writer starts at the current position of the reader.  If another writer races
+        // for the same lane, it stores the same kind of value and then loses the cas below.
+        android_atomic_release_store(android_atomic_acquire_load(&mFront), &mLanes[i].mRear);
+        if (android_atomic_release_cas(mask, mask | (1 << i), &mWriterMask) == 0) {
+            return i;
+        }
+    }
+}
+
+void MultiPipe::detachWriter(int lane)
+{
+    ALOG_ASSERT(0 <= lane && lane < (int) mMaxWriters);
+    android_atomic_and(~(1 << lane), &mWriterMask);
+}
+
+ssize_t MultiPipe::availableToRead()
+{
+    if (CC_UNLIKELY(!mNegotiated)) {
+        return NEGOTIATE;
+    }
+    uint32_t mask = android_atomic_acquire_load(&mWriterMask);
+    if (mask == 0) {
+        return 0;
+    }
+    // read() is not multi-thread safe w.r.t. itself, so no mutex or atomic op needed to read mFront
+    int32_t fill[kMaxWriters];
+    int32_t leader = 0;
+    for (uint32_t m = mask; m != 0; ) {
+        unsigned i = __builtin_ctz(m);
+        m &= ~(1 << i);
+        fill[i] = android_atomic_acquire_load(&mLanes[i].mRear) - mFront;
+        if (fill[i] < 0) {
+            // writer is late and will catch up at its next write()
+            fill[i] = 0;
+        }
+        if (fill[i] > leader) {
+            leader = fill[i];
+        }
+    }
+    // wait for the writers which are close behind the leader, but not for those which stalled
+    int32_t avail = leader;
+    for (uint32_t m = mask; m != 0; ) {
+        unsigned i = __builtin_ctz(m);
+        m &= ~(1 << i);
+        if (fill[i] < avail && leader - fill[i] <= (int32_t) (mMaxFrames >> 1)) {
+            avail = fill[i];
+        }
+    }
+    return avail;
+}
+
+ssize_t MultiPipe::read(void *buffer, size_t count)
+{
+    ssize_t avail = availableToRead();
+    if (CC_UNLIKELY(avail <= 0)) {
+        return avail;
+    }
+    if (CC_LIKELY(count > (size_t) avail)) {
+        count = avail;
+    }
+    bool first = true;
+    uint32_t mask = android_atomic_acquire_load(&mWriterMask);
+    while (mask != 0) {
+        unsigned i = __builtin_ctz(mask);
+        mask &= ~(1 << i);
+        mixLane(i, (int16_t *) buffer, count, first);
+        first = false;
+    }
+    if (CC_UNLIKELY(first)) {
+        // the last writer went away since availableToRead()
+        memset(buffer, 0, count << mBitShift);
+    }
+    android_atomic_release_store(mFront + count, &mFront);
+    mFramesRead += count;
+    return count;
+}
+
+void MultiPipe::mixLane(unsigned i, int16_t *buffer, size_t count, bool first) const
+{
+    // frames the writer has not provided yet, or dropped, are silence
+    int32_t fill = android_atomic_acquire_load(&mLanes[i].mRear) - mFront;
+    size_t valid = fill < 0 ? 0 : (size_t) fill;
+    if (valid > count) {
+        valid = count;
+    }
+    const size_t samplesPerFrame = Format_channelCount(mFormat);
+    const int16_t *ring = (const int16_t *) ((char *) mBuffer + ((i * mMaxFrames) << mBitShift));
+    size_t front = mFront & (mMaxFrames - 1);
+    size_t done = 0;
+    while (done < valid) {
+        size_t part = mMaxFrames - front;
+        if (part > valid - done) {
+            part = valid - done;
+        }
+        const int16_t *src = ring + front * samplesPerFrame;
+        int16_t *dst = buffer + done * samplesPerFrame;
+        size_t samples = part * samplesPerFrame;
+        if (first) {
+            memcpy(dst, src, samples * sizeof(int16_t));
+        } else {
+            while (samples--) {
+                int32_t sum = *dst + *src++;
+                if (CC_UNLIKELY(sum > 32767)) {
+                    sum = 32767;
+                } else if (CC_UNLIKELY(sum < -32768)) {
+                    sum = -32768;
+                }
+                *dst++ = sum;
+            }
+        }
+        done += part;
+        front = (front + part) & (mMaxFrames - 1);
+    }
+    if (first && valid < count) {
+        memset(buffer + valid * samplesPerFrame, 0, (count - valid) << mBitShift);
+    }
+}
+
+}   // namespace android
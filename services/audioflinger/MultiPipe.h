@@ -0,0 +1,90 @@
+/*
+ * Copyright (C) 2012 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_AUDIO_MULTI_PIPE_H
+#define ANDROID_AUDIO_MULTI_PIPE_H
+
+#include "NBAIO.h"
+
+namespace android {
+
+// MultiPipe is the mirror image of Pipe: it has any number of writers (see MultiPipeWriter), up to
+// a maximum fixed at construction, but only a single reader which is the MultiPipe itself.
+// Each writer owns a lane, a private ring buffer indexed by a per-writer sequence number on the
+// timeline of the reader, so that neither writers nor the reader ever wait for each other.
+// read() sums the frames of all writers at the same position with saturation, and assumes
+// 16-bit PCM.  A writer that falls behind the reader by more than half the pipe is not waited for,
+// and its late frames are dropped when it catches up; this is counted as an underrun of that writer.
+// Writers can be added and removed dynamically, and it's OK to have no writers.
+// MultiPipe is safe for only a single reader thread, MultiPipeWriter for a single thread per writer.
+class MultiPipe : public NBAIO_Source {
+
+    friend class MultiPipeWriter;
+
+public:
+    static const unsigned kMaxWriters = 32;
+
+    // maxFrames will be rounded up to a power of 2, and all slots are available. Must be >= 2.
+    // maxWriters is limited to kMaxWriters.
+    MultiPipe(size_t maxFrames, NBAIO_Format format, unsigned maxWriters = 4);
+    virtual ~MultiPipe();
+
+    // NBAIO_Port interface
+
+    //virtual ssize_t negotiate(const NBAIO_Format offers[], size_t numOffers,
+    //                          NBAIO_Format counterOffers[], size_t& numCounterOffers);
+    //virtual NBAIO_Format format() const;
+
+    // NBAIO_Source interface
+
+    //virtual size_t framesRead() const;
+    //virtual size_t framesOverrun();
+    //virtual size_t overruns();
+
+    virtual ssize_t availableToRead();
+
+    virtual ssize_t read(void *buffer, size_t count);
+
+    // NBAIO_Source end
+
+            size_t  maxFrames() const { return mMaxFrames; }
+
+private:
+    struct Lane {
+        volatile int32_t mRear;     // written by the writer with android_atomic_release_store,
+                                    // read by the reader with android_atomic_acquire_load
+    };
+
+    // called by MultiPipeWriter, return the index of the lane attached or -1 if none is free
+    int             attachWriter();
+    void            detachWriter(int lane);
+
+    // mix frames [mFront, mFront + count) of lane i into buffer, with preceding lanes if !first
+    void            mixLane(unsigned i, int16_t *buffer, size_t count, bool first) const;
+
+    const size_t    mMaxFrames;     // always a power of 2
+    const unsigned  mMaxWriters;
+    void * const    mBuffer;        // mMaxWriters consecutive rings of mMaxFrames
+    Lane * const    mLanes;
+    volatile int32_t mWriterMask;   // bit i is set if and only if lane i has a writer,
+                                    // modified by writers with android_atomic_release_cas
+    volatile int32_t mFront;        // written by the reader with android_atomic_release_store,
+                                    // read by writers with android_atomic_acquire_load
+};
+
+}   // namespace android
+
+#endif  // ANDROID_AUDIO_MULTI_PIPE_H
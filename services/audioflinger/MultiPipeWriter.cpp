@@ -0,0 +1,107 @@
+/*
+ * Copyright (C) 2012 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "MultiPipeWriter"
+//#define LOG_NDEBUG 0
+
+#include <string.h>
+#include <cutils/atomic.h>
+#include <cutils/compiler.h>
+#include <utils/Errors.h>
+#include <utils/Log.h>
+#include "MultiPipeWriter.h"
+
+namespace android {
+
+MultiPipeWriter::MultiPipeWriter(MultiPipe& pipe) :
+        NBAIO_Sink(pipe.mFormat),
+        mPipe(pipe),
+        mLane(pipe.attachWriter()),
+        mFramesUnderrun(0),
+        mUnderruns(0)
+{
+    if (mLane < 0) {
+        ALOGW("no free lane in MultiPipe %p", &pipe);
+    }
+}
+
+MultiPipeWriter::~MultiPipeWriter()
+{
+    if (mLane >= 0) {
+        mPipe.detachWriter(mLane);
+    }
+}
+
+ssize_t MultiPipeWriter::availableToWrite() const
+{
+    if (CC_UNLIKELY(!mNegotiated)) {
+        return NEGOTIATE;
+    }
+    if (CC_UNLIKELY(mLane < 0)) {
+        return NO_INIT;
+    }
+    // write() is not multi-thread safe w.r.t. itself, so no atomic op needed to read our mRear
+    int32_t fill = mPipe.mLanes[mLane].mRear - android_atomic_acquire_load(&mPipe.mFront);
+    if (fill < 0) {
+        // late, the next write() will restart at the reader position
+        fill = 0;
+    }
+    ssize_t ret = mPipe.mMaxFrames - fill;
+    ALOG_ASSERT((0 <= ret) && (ret <= (ssize_t) mPipe.mMaxFrames));
+    return ret;
+}
+
+ssize_t MultiPipeWriter::write(const void *buffer, size_t count)
+{
+    if (CC_UNLIKELY(!mNegotiated)) {
+        return NEGOTIATE;
+    }
+    if (CC_UNLIKELY(mLane < 0)) {
+        return NO_INIT;
+    }
+    MultiPipe::Lane& lane = mPipe.mLanes[mLane];
+    int32_t front = android_atomic_acquire_load(&mPipe.mFront);
+    int32_t rear = lane.mRear;
+    if (CC_UNLIKELY(rear - front < 0)) {
+        // the reader has already mixed silence in place of these frames, so drop them
+        size_t late = (size_t) (front - rear);
+        mFramesUnderrun += late;
+        ++mUnderruns;
+        rear = front;
+    }
+    size_t written = mPipe.mMaxFrames - (rear - front);
+    if (CC_LIKELY(written > count)) {
+        written = count;
+    }
+    char *ring = (char *) mPipe.mBuffer + ((mLane * mPipe.mMaxFrames) << mBitShift);
+    size_t index = rear & (mPipe.mMaxFrames - 1);
+    size_t part1 = mPipe.mMaxFrames - index;
+    if (part1 > written) {
+        part1 = written;
+    }
+    if (CC_LIKELY(part1 > 0)) {
+        memcpy(ring + (index << mBitShift), buffer, part1 << mBitShift);
+        if (CC_UNLIKELY(written > part1)) {
+            memcpy(ring, (const char *) buffer + (part1 << mBitShift),
+                    (written - part1) << mBitShift);
+        }
+    }
+    android_atomic_release_store(rear + written, &lane.mRear);
+    mFramesWritten += written;
+    return written;
+}
+
+}   // namespace android
@@ -0,0 +1,63 @@
+/*
+ * Copyright (C) 2012 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_AUDIO_MULTI_PIPE_WRITER_H
+#define ANDROID_AUDIO_MULTI_PIPE_WRITER_H
+
+#include "MultiPipe.h"
+
+namespace android {
+
+// MultiPipeWriter is safe for only a single thread, but each writer of a MultiPipe can run
+// in its own thread.
+class MultiPipeWriter : public NBAIO_Sink {
+
+public:
+
+    // Construct a MultiPipeWriter and attach it to a free lane of a MultiPipe.
+    // If all lanes are in use, write() returns NO_INIT.
+    MultiPipeWriter(MultiPipe& pipe);
+    virtual ~MultiPipeWriter();
+
+    // NBAIO_Port interface
+
+    //virtual ssize_t negotiate(const NBAIO_Format offers[], size_t numOffers,
+    //                          NBAIO_Format counterOffers[], size_t& numCounterOffers);
+    //virtual NBAIO_Format format() const;
+
+    // NBAIO_Sink interface
+
+    //virtual size_t framesWritten() const;
+    virtual size_t framesUnderrun() const { return mFramesUnderrun; }
+    virtual size_t underruns() const { return mUnderruns; }
+
+    // Like MonoPipe, write() cannot overrun and returns a short count if the lane is full
+    virtual ssize_t availableToWrite() const;
+    virtual ssize_t write(const void *buffer, size_t count);
+    //virtual ssize_t writeVia(writeVia_t via, size_t total, void *user, size_t block);
+
+    // NBAIO_Sink end
+
+private:
+    MultiPipe&      mPipe;
+    const int       mLane;          // index of the lane in mPipe, or -1 if none was available
+    size_t          mFramesUnderrun;
+    size_t          mUnderruns;
+};
+
+}   // namespace android
+
+#endif  // ANDROID_AUDIO_MULTI_PIPE_WRITER_H
@@ -14,8 +14,23 @@
  * limitations under the License.
  */
 
+#define LOG_TAG "SchedulingPolicyService"
+//#define LOG_NDEBUG 0
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/resource.h>
+#include <unistd.h>
 #include <binder/IServiceManager.h>
+#include <utils/Log.h>
 #include <utils/Mutex.h>
+#include <utils/Thread.h>
+#include <utils/ThreadDefs.h>
+#include <utils/Timers.h>
+#include <utils/Vector.h>
 #include "ISchedulingPolicyService.h"
 #include "SchedulingPolicyService.h"
 
@@ -49,4 +64,184 @@ int requestPriority(pid_t pid, pid_t tid, int32_t prio)
     return sps->requestPriority(pid, tid, prio);
 }
 
+// The budget watchdog samples the CPU time of every registered thread each kBudgetPeriodMs,
+// and demotes a thread that was over budget for kMaxOverBudgetPeriods periods in a row.
+static const int kBudgetPeriodMs = 500;
+static const int kMaxOverBudgetPeriods = 2;
+
+struct BudgetedThread {
+    pid_t       mPid;
+    pid_t       mTid;
+    int32_t     mBudgetPercent;
+    uint64_t    mRuntimeNs;         // CPU time at the previous sample
+    nsecs_t     mSampleTime;        // systemTime() of the previous sample
+    int         mOverBudgetPeriods; // consecutive periods over budget
+};
+
+// Returns the CPU time thread tid of process pid has used, from its schedstat.
+static bool getThreadRuntimeNs(pid_t pid, pid_t tid, uint64_t *runtimeNs)
+{
+    char path[64];
+    snprintf(path, sizeof(path), "/proc/%d/task/%d/schedstat", pid, tid);
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    char buf[64];
+    ssize_t n = read(fd, buf, sizeof(buf) - 1);
+    close(fd);
+    if (n <= 0) {
+        return false;
+    }
+    buf[n] = '\0';
+    *runtimeNs = strtoull(buf, NULL, 10);
+    return true;
+}
+
+// Returns tid to SCHED_OTHER at audio priority; false if it is not ours to change.
+static bool demoteThread(pid_t tid)
+{
+    int policy = sched_getscheduler(tid);
+    if (policy != SCHED_FIFO && policy != SCHED_RR) {
+        return true;
+    }
+    struct sched_param param;
+    param.sched_priority = 0;
+    if (sched_setscheduler(tid, SCHED_OTHER, &param) != 0) {
+        return false;
+    }
+    setpriority(PRIO_PROCESS, tid, ANDROID_PRIORITY_AUDIO);
+    return true;
+}
+
+class BudgetWatchdog : public Thread {
+public:
+    BudgetWatchdog() : Thread(false /*canCallJava*/) { }
+
+    void add(pid_t pid, pid_t tid, int32_t budgetPercent) {
+        BudgetedThread thread;
+        thread.mPid = pid;
+        thread.mTid = tid;
+        thread.mBudgetPercent = budgetPercent;
+        thread.mRuntimeNs = 0;
+        thread.mSampleTime = systemTime();
+        thread.mOverBudgetPeriods = 0;
+        getThreadRuntimeNs(pid, tid, &thread.mRuntimeNs);
+
+        Mutex::Autolock _l(mLock);
+        remove_l(tid);
+        mThreads.push(thread);
+    }
+
+    bool remove(pid_t tid) {
+        Mutex::Autolock _l(mLock);
+        return remove_l(tid);
+    }
+
+private:
+    Mutex mLock;
+    Vector<BudgetedThread> mThreads;
+
+    bool remove_l(pid_t tid) {
+        for (size_t i = 0; i < mThreads.size(); ++i) {
+            if (mThreads[i].mTid == tid) {
+                mThreads.removeAt(i);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    virtual bool threadLoop() {
+        usleep(kBudgetPeriodMs * 1000);
+
+        Mutex::Autolock _l(mLock);
+        nsecs_t now = systemTime();
+        for (size_t i = 0; i < mThreads.size();) {
+            BudgetedThread *thread = &mThreads.editItemAt(i);
+
+            uint64_t runtimeNs;
+            if (!getThreadRuntimeNs(thread->mPid, thread->mTid, &runtimeNs)) {
+                // the thread has exited
+                mThreads.removeAt(i);
+                continue;
+            }
+
+            nsecs_t elapsedNs = now - thread->mSampleTime;
+            uint64_t usedNs = runtimeNs - thread->mRuntimeNs;
+            thread->mRuntimeNs = runtimeNs;
+            thread->mSampleTime = now;
+            if (elapsedNs <= 0
+                    || usedNs * 100 <= (uint64_t) elapsedNs * thread->mBudgetPercent) {
+                thread->mOverBudgetPeriods = 0;
+                ++i;
+                continue;
+            }
+
+            if (++thread->mOverBudgetPeriods < kMaxOverBudgetPeriods) {
+                ++i;
+                continue;
+            }
+
+            int percent = (int) (usedNs * 100 / elapsedNs);
+            if (demoteThread(thread->mTid)) {
+                ALOGW("Demoted pid %d tid %d to SCHED_OTHER: used %d%% of a CPU, budget %d%%",
+                        thread->mPid, thread->mTid, percent, thread->mBudgetPercent);
+            } else {
+                ALOGW("Unable to demote pid %d tid %d, which used %d%% of a CPU, budget %d%%; "
+                        "error %d", thread->mPid, thread->mTid, percent,
+                        thread->mBudgetPercent, errno);
+            }
+            mThreads.removeAt(i);
+        }
+        return true;
+    }
+};
+
+static sp<BudgetWatchdog> sBudgetWatchdog;
+
+int requestPriorityWithBudget(pid_t pid, pid_t tid, int32_t prio, int32_t budgetPercent)
+{
+    int err = requestPriority(pid, tid, prio);
+    if (err != 0) {
+        return err;
+    }
+
+    sp<BudgetWatchdog> watchdog;
+    bool created = false;
+    sMutex.lock();
+    if (sBudgetWatchdog == 0) {
+        sBudgetWatchdog = new BudgetWatchdog();
+        sBudgetWatchdog->run("BudgetWatchdog", ANDROID_PRIORITY_URGENT_AUDIO);
+        created = true;
+    }
+    watchdog = sBudgetWatchdog;
+    sMutex.unlock();
+
+    // the watchdog must be able to preempt the threads it watches
+    if (created) {
+        pid_t watchdogTid = watchdog->getTid();
+        err = requestPriority(getpid(), watchdogTid, 2);
+        if (err != 0) {
+            ALOGW("Policy SCHED_FIFO priority %d is unavailable for BudgetWatchdog tid %d; "
+                    "error %d", 2, watchdogTid, err);
+        }
+    }
+
+    watchdog->add(pid, tid, budgetPercent);
+    return 0;
+}
+
+void releasePriority(pid_t tid)
+{
+    sp<BudgetWatchdog> watchdog;
+    sMutex.lock();
+    watchdog = sBudgetWatchdog;
+    sMutex.unlock();
+
+    if (watchdog != 0 && watchdog->remove(tid) && !demoteThread(tid)) {
+        ALOGW("Unable to return tid %d to SCHED_OTHER; error %d", tid, errno);
+    }
+}
+
 }   // namespace android
@@ -17,12 +17,25 @@
 #ifndef _ANDROID_SCHEDULING_POLICY_SERVICE_H
 #define _ANDROID_SCHEDULING_POLICY_SERVICE_H
 
+#include <sys/types.h>
+
 namespace android {
 
 // Request elevated priority for thread tid, whose thread group leader must be pid.
 // The priority parameter is currently restricted to either 1 or 2.
 int requestPriority(pid_t pid, pid_t tid, int32_t prio);
 
+// Like requestPriority(), for threads that are not as well behaved as FastMixer.  The thread is
+// also watched by a budget watchdog in the calling process: once it has used more than
+// budgetPercent of one CPU for about a second, it is demoted to SCHED_OTHER so that a runaway
+// real-time thread cannot lock up the system.  Demoting a thread of another process needs
+// CAP_SYS_NICE, so without it such a thread is only reported.
+int requestPriorityWithBudget(pid_t pid, pid_t tid, int32_t prio, int32_t budgetPercent);
+
+// Ends the budget of a thread registered with requestPriorityWithBudget(), and demotes it if it
+// is still real-time.  Threads that exit are forgotten without it.
+void releasePriority(pid_t tid);
+
 }   // namespace android
 
 #endif  // _ANDROID_SCHEDULING_POLICY_SERVICE_H
@@ -40,7 +40,7 @@ void StateQueueMutatorDump::dump(int fd)
 // Constructor and destructor
 
 template<typename T> StateQueue<T>::StateQueue() :
-    mNext(NULL), mAck(NULL), mCurrent(NULL),
+    mNext(NULL), mAck(NULL), mPushes(0), mCurrent(NULL),
     mMutating(&mStates[0]), mExpecting(NULL),
     mInMutation(false), mIsDirty(false), mIsInitialized(false)
 #ifdef STATE_QUEUE_DUMP
@@ -68,6 +68,20 @@ template<typename T> const T* StateQueue<T>::poll()
     return next;
 }
 
+template<typename T> bool StateQueue<T>::observe(T *state) const
+{
+    // A published state is next overwritten when it becomes the mutating state again,
+    // kN - 1 pushes later, so a copy is intact if fewer pushes than that happened around it.
+    int32_t pushes = android_atomic_acquire_load(&mPushes);
+    const T *next = (const T *) android_atomic_acquire_load((volatile int32_t *) &mNext);
+    if (next == NULL) {
+        return false;
+    }
+    *state = *next;
+    android_memory_barrier();
+    return (uint32_t) (mPushes - pushes) < kN - 1;
+}
+
 // Mutator APIs
 
 template<typename T> T* StateQueue<T>::begin()
@@ -141,12 +155,15 @@ template<typename T> bool StateQueue<T>::push(StateQueue<T>::block_t block)
         // publish
         android_atomic_release_store((int32_t) mMutating, (volatile int32_t *) &mNext);
         mExpecting = mMutating;
+        // secondary observers must see this before any write to the next mutating state
+        android_atomic_inc(&mPushes);
+        android_memory_barrier();
 
         // copy with circular wraparound
         if (++mMutating >= &mStates[kN]) {
             mMutating = &mStates[0];
         }
-        *mMutating = *mExpecting;
+        StateQueueCopy(mMutating, mExpecting);
         mIsDirty = false;
 
     }
@@ -47,6 +47,14 @@ struct StateQueueMutatorDump {
 };
 #endif
 
+// Called by push() to bring the next mutating state, which holds an older state of the same
+// queue, up to date with the state just pushed.  The default is a full copy; a state type with
+// parts that seldom change can specialize it to copy only the parts that differ.
+template<typename T> inline void StateQueueCopy(T *dst, const T *src)
+{
+    *dst = *src;
+}
+
 // manages a FIFO queue of states
 template<typename T> class StateQueue {
 
@@ -64,6 +72,15 @@ public:
     // this allows the observer to diff the previous and new states.
     const T* poll();
 
+    // Secondary observer APIs, for any number of other threads that only want to look at the
+    // state, e.g. for telemetry or dumpsys.  The mutator never waits for them.
+
+    // Copy the most recently pushed state into *state.  Returns false if no state has been
+    // pushed yet, or if the mutator pushed so many new states during the copy that it may be
+    // torn; the contents of *state are then undefined.  Pointers within the state refer to
+    // objects that only the primary observer is guaranteed to be able to use.
+    bool    observe(T *state) const;
+
     // Mutator APIs
 
     // Begin a mutation.  Returns a pointer to a read/write state, except the
@@ -114,6 +131,7 @@ private:
     // "volatile" is meaningless with SMP, but here it indicates that we're using atomic ops
     volatile const T* mNext; // written by mutator to advance next, read by observer
     volatile const T* mAck;  // written by observer to acknowledge advance of next, read by mutator
+    volatile int32_t  mPushes;  // written by mutator after each publish, read by observe()
 
     // only used by observer
     const T*          mCurrent;         // most recent value returned by poll()
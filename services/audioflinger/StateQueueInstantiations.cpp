@@ -15,6 +15,7 @@
  */
 
 #include "FastMixerState.h"
+#include "FastCaptureState.h"
 #include "StateQueue.h"
 
 // FIXME hack for gcc
@@ -22,5 +23,6 @@
 namespace android {
 
 template class StateQueue<FastMixerState>;  // typedef FastMixerStateQueue
+template class StateQueue<FastCaptureState>;    // typedef FastCaptureStateQueue
 
 }
@@ -0,0 +1,328 @@
+/*
+ * Copyright (C) 2012 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Mixes N tracks of random PCM with AudioMixer for every combination of
+// track count, channel count, volume and resampler quality, and reports the
+// time per output frame together with the process__ hook the mixer picked.
+// Then measures the write and read throughput of Pipe and MonoPipe.
+//
+// Builds for the target and for the host. The host build has no effect
+// factory and no local time HAL, which AudioMixer only uses for downmixing
+// multichannel tracks and for timed tracks, so small stand-ins for them are
+// provided below.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <common_time/local_clock.h>
+#include <media/EffectsFactoryApi.h>
+
+#include "AudioBufferProvider.h"
+#include "AudioMixer.h"
+#include "AudioResampler.h"
+#include "MonoPipe.h"
+#include "MonoPipeReader.h"
+#include "Pipe.h"
+#include "PipeReader.h"
+
+using namespace android;
+
+#ifndef HAVE_ANDROID_OS
+namespace android {
+
+LocalClock::LocalClock() {}
+uint64_t LocalClock::getLocalFreq() { return 1000000000ull; }
+
+}  // namespace android
+
+extern "C" {
+
+int EffectQueryNumberEffects(uint32_t *pNumEffects) {
+    *pNumEffects = 0;
+    return 0;
+}
+
+int EffectQueryEffect(uint32_t index, effect_descriptor_t *pDescriptor) {
+    return -ENOENT;
+}
+
+int EffectCreate(const effect_uuid_t *pEffectUuid, int32_t sessionId,
+        int32_t ioId, effect_handle_t *pHandle) {
+    return -ENOENT;
+}
+
+int EffectRelease(effect_handle_t handle) {
+    return 0;
+}
+
+}  // extern "C"
+#endif  // HAVE_ANDROID_OS
+
+static const uint32_t kMixSampleRate = 44100;
+static const size_t kMixFrameCount = 512;
+static const size_t kSourceFrames = 8192;
+
+static int64_t getNowNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ll + ts.tv_nsec;
+}
+
+// Loops over a buffer of random PCM forever.
+class LoopingProvider : public AudioBufferProvider {
+public:
+    LoopingProvider(size_t channelCount)
+        : mChannelCount(channelCount), mPosition(0) {
+        mData = new int16_t[kSourceFrames * channelCount];
+        for (size_t i = 0; i < kSourceFrames * channelCount; ++i) {
+            mData[i] = (int16_t)((lrand48() & 0xFFFF) - 0x8000) / 2;
+        }
+    }
+
+    virtual ~LoopingProvider() {
+        delete[] mData;
+    }
+
+    virtual status_t getNextBuffer(Buffer* buffer, int64_t pts) {
+        size_t frameCount = kSourceFrames - mPosition;
+        if (frameCount > buffer->frameCount) {
+            frameCount = buffer->frameCount;
+        }
+        buffer->i16 = mData + mPosition * mChannelCount;
+        buffer->frameCount = frameCount;
+        return NO_ERROR;
+    }
+
+    virtual void releaseBuffer(Buffer* buffer) {
+        mPosition = (mPosition + buffer->frameCount) % kSourceFrames;
+        buffer->raw = NULL;
+        buffer->frameCount = 0;
+    }
+
+private:
+    size_t mChannelCount;
+    size_t mPosition;
+    int16_t* mData;
+};
+
+struct Quality {
+    const char* name;
+    int quality;        // -1 for no resampling
+    uint32_t sampleRate;
+};
+
+static const Quality kQualities[] = {
+    { "none",           -1,                                     kMixSampleRate },
+    { "low",            AudioResampler::LOW_QUALITY,            48000 },
+    { "med",            AudioResampler::MED_QUALITY,            48000 },
+    { "high",           AudioResampler::HIGH_QUALITY,           48000 },
+    { "med_polyphase",  AudioResampler::MED_POLYPHASE_QUALITY,  48000 },
+    { "high_polyphase", AudioResampler::HIGH_POLYPHASE_QUALITY, 48000 },
+};
+
+static double benchMixer(size_t numTracks, size_t channelCount, uint16_t gain,
+        const Quality& quality, int64_t durationNs, const char** hookName)
+{
+    AudioMixer mixer(kMixFrameCount, kMixSampleRate);
+    int16_t* mixBuffer = new int16_t[kMixFrameCount * 2];
+    LoopingProvider* providers[AudioMixer::MAX_NUM_TRACKS];
+    audio_channel_mask_t mask = channelCount == 1 ?
+            AUDIO_CHANNEL_OUT_MONO : AUDIO_CHANNEL_OUT_STEREO;
+
+    for (size_t i = 0; i < numTracks; ++i) {
+        providers[i] = new LoopingProvider(channelCount);
+        int name = mixer.getTrackName(mask);
+        mixer.setParameter(name, AudioMixer::TRACK, AudioMixer::CHANNEL_MASK,
+                (void *)mask);
+        mixer.setParameter(name, AudioMixer::TRACK, AudioMixer::MAIN_BUFFER,
+                mixBuffer);
+        if (quality.quality >= 0) {
+            mixer.setParameter(name, AudioMixer::RESAMPLE, AudioMixer::QUALITY,
+                    (void *)quality.quality);
+            mixer.setParameter(name, AudioMixer::RESAMPLE, AudioMixer::SAMPLE_RATE,
+                    (void *)quality.sampleRate);
+        }
+        mixer.setParameter(name, AudioMixer::VOLUME, AudioMixer::VOLUME0,
+                (void *)(uintptr_t)gain);
+        mixer.setParameter(name, AudioMixer::VOLUME, AudioMixer::VOLUME1,
+                (void *)(uintptr_t)gain);
+        mixer.setBufferProvider(name, providers[i]);
+        mixer.enable(name);
+    }
+
+    // the first call validates the state and creates the resamplers
+    mixer.process(AudioBufferProvider::kInvalidPTS);
+    *hookName = mixer.hookName();
+
+    int64_t numFrames = 0;
+    int64_t startNs = getNowNs();
+    int64_t elapsedNs;
+    do {
+        for (int i = 0; i < 16; ++i) {
+            mixer.process(AudioBufferProvider::kInvalidPTS);
+        }
+        numFrames += 16 * kMixFrameCount;
+        elapsedNs = getNowNs() - startNs;
+    } while (elapsedNs < durationNs);
+
+    for (size_t i = 0; i < numTracks; ++i) {
+        mixer.deleteTrackName(AudioMixer::TRACK0 + i);
+        delete providers[i];
+    }
+    delete[] mixBuffer;
+
+    return (double)elapsedNs / numFrames;
+}
+
+// Writes and reads blocks of blockFrames stereo frames from one thread.
+template <class Sink, class Source>
+static void benchPipe(const char* name, Sink* sink, Source* source,
+        size_t blockFrames, int64_t durationNs)
+{
+    NBAIO_Format format = Format_from_SR_C(kMixSampleRate, 2);
+    NBAIO_Format offers[1] = { format };
+    size_t numCounterOffers = 0;
+    sink->negotiate(offers, 1, NULL, numCounterOffers);
+    numCounterOffers = 0;
+    source->negotiate(offers, 1, NULL, numCounterOffers);
+
+    int16_t* block = new int16_t[blockFrames * 2];
+    memset(block, 0, blockFrames * 2 * sizeof(int16_t));
+
+    int64_t writeNs = 0, readNs = 0, numFrames = 0;
+    int64_t startNs = getNowNs();
+    while (getNowNs() - startNs < durationNs) {
+        for (int i = 0; i < 64; ++i) {
+            int64_t t0 = getNowNs();
+            ssize_t written = sink->write(block, blockFrames);
+            int64_t t1 = getNowNs();
+            ssize_t read = source->read(block, blockFrames);
+            int64_t t2 = getNowNs();
+            if (written != (ssize_t)blockFrames || read != (ssize_t)blockFrames) {
+                printf("%s: wrote %d and read %d of %u frames\n", name, (int)written,
+                        (int)read, blockFrames);
+                delete[] block;
+                return;
+            }
+            writeNs += t1 - t0;
+            readNs += t2 - t1;
+            numFrames += blockFrames;
+        }
+    }
+
+    printf("%-10s %6u %12.3f %12.3f\n", name, blockFrames,
+            (double)writeNs / numFrames, (double)readNs / numFrames);
+    delete[] block;
+}
+
+static void usage(const char* me)
+{
+    fprintf(stderr, "usage: %s [-d ms per configuration (default 200)]\n"
+                    "\t\t[-t max tracks (default 16)]\n"
+                    "\t\t[-q resampler quality name only]\n"
+                    "\t\t[-M] mixer only\n"
+                    "\t\t[-P] pipes only\n",
+                    me);
+    exit(1);
+}
+
+int main(int argc, char** argv)
+{
+    int64_t durationNs = 200000000ll;
+    size_t maxTracks = 16;
+    const char* qualityName = NULL;
+    bool useMixer = true;
+    bool usePipes = true;
+
+    int res;
+    while ((res = getopt(argc, argv, "hd:t:q:MP")) >= 0) {
+        switch (res) {
+        case 'd':
+            durationNs = atoll(optarg) * 1000000ll;
+            break;
+        case 't':
+            maxTracks = atoi(optarg);
+            break;
+        case 'q':
+            qualityName = optarg;
+            break;
+        case 'M':
+            usePipes = false;
+            break;
+        case 'P':
+            useMixer = false;
+            break;
+        default:
+            usage(argv[0]);
+        }
+    }
+
+    if (optind != argc || durationNs <= 0 || maxTracks < 1 ||
+            maxTracks > AudioMixer::MAX_NUM_TRACKS || (!useMixer && !usePipes)) {
+        usage(argv[0]);
+    }
+
+    srand48(1);
+
+    if (useMixer) {
+        static const uint16_t kGains[] = { AudioMixer::UNITY_GAIN, AudioMixer::UNITY_GAIN / 2 };
+
+        printf("%-15s %6s %8s %6s %-34s %10s\n", "resampler", "tracks", "channels",
+                "gain", "hook", "ns/frame");
+        for (size_t q = 0; q < sizeof(kQualities) / sizeof(kQualities[0]); ++q) {
+            const Quality& quality = kQualities[q];
+            if (qualityName != NULL && strcmp(qualityName, quality.name)) {
+                continue;
+            }
+            for (size_t numTracks = 1; numTracks <= maxTracks; numTracks *= 2) {
+                for (size_t channelCount = 1; channelCount <= 2; ++channelCount) {
+                    for (size_t g = 0; g < sizeof(kGains) / sizeof(kGains[0]); ++g) {
+                        const char* hookName;
+                        double ns = benchMixer(numTracks, channelCount, kGains[g],
+                                quality, durationNs, &hookName);
+                        printf("%-15s %6u %8u %#6x %-34s %10.2f\n", quality.name,
+                                numTracks, channelCount, kGains[g], hookName, ns);
+                    }
+                }
+            }
+        }
+    }
+
+    if (usePipes) {
+        static const size_t kBlockFrames[] = { 64, 256, 1024 };
+        NBAIO_Format format = Format_from_SR_C(kMixSampleRate, 2);
+
+        printf("\n%-10s %6s %12s %12s\n", "pipe", "frames", "write ns/fr", "read ns/fr");
+        for (size_t b = 0; b < sizeof(kBlockFrames) / sizeof(kBlockFrames[0]); ++b) {
+            size_t blockFrames = kBlockFrames[b];
+            {
+                sp<Pipe> pipe = new Pipe(blockFrames * 4, format);
+                sp<PipeReader> reader = new PipeReader(*pipe);
+                benchPipe("Pipe", pipe.get(), reader.get(), blockFrames, durationNs);
+            }
+            {
+                sp<MonoPipe> pipe = new MonoPipe(blockFrames * 4, format);
+                sp<MonoPipeReader> reader = new MonoPipeReader(pipe.get());
+                benchPipe("MonoPipe", pipe.get(), reader.get(), blockFrames, durationNs);
+            }
+        }
+    }
+
+    return 0;
+}
@@ -7,7 +7,8 @@ LOCAL_PATH:= $(call my-dir)
 include $(CLEAR_VARS)
 
 LOCAL_SRC_FILES:=               \
-    CameraService.cpp
+    CameraService.cpp \
+    CameraCallbackQueue.cpp
 
 LOCAL_SHARED_LIBRARIES:= \
     libui \
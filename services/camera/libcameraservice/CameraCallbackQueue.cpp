@@ -0,0 +1,178 @@
+/*
+ * Copyright (C) 2012 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "CameraCallbackQueue"
+//#define LOG_NDEBUG 0
+#include <utils/Log.h>
+
+#include "CameraCallbackQueue.h"
+
+namespace android {
+
+CameraCallbackQueue::CameraCallbackQueue(int cameraId)
+    : Thread(false),
+      mCameraId(cameraId),
+      mQueuedPreviewFrames(0),
+      mDroppedPreviewFrames(0),
+      mDeliveredCallbacks(0) {
+}
+
+CameraCallbackQueue::~CameraCallbackQueue() {
+}
+
+void CameraCallbackQueue::postNotify(const sp<ICameraClient>& client,
+        int32_t msgType, int32_t ext1, int32_t ext2) {
+    Callback callback;
+    callback.mKind = NOTIFY;
+    callback.mClient = client;
+    callback.mMsgType = msgType;
+    callback.mExt1 = ext1;
+    callback.mExt2 = ext2;
+    callback.mTimestamp = 0;
+    callback.mHasMetadata = false;
+    callback.mNumberOfFaces = 0;
+    post(callback);
+}
+
+void CameraCallbackQueue::postData(const sp<ICameraClient>& client,
+        int32_t msgType, const sp<IMemory>& data,
+        camera_frame_metadata_t *metadata) {
+    Callback callback;
+    callback.mKind = DATA;
+    callback.mClient = client;
+    callback.mMsgType = msgType;
+    callback.mExt1 = 0;
+    callback.mExt2 = 0;
+    callback.mTimestamp = 0;
+    callback.mData = data;
+    callback.mHasMetadata = (metadata != NULL);
+    callback.mNumberOfFaces = 0;
+    if (metadata != NULL) {
+        callback.mNumberOfFaces = metadata->number_of_faces;
+        if (metadata->faces != NULL && metadata->number_of_faces > 0) {
+            callback.mFaces.appendArray(metadata->faces, metadata->number_of_faces);
+        }
+    }
+    post(callback);
+}
+
+void CameraCallbackQueue::postDataTimestamp(const sp<ICameraClient>& client,
+        nsecs_t timestamp, int32_t msgType, const sp<IMemory>& data) {
+    Callback callback;
+    callback.mKind = DATA_TIMESTAMP;
+    callback.mClient = client;
+    callback.mMsgType = msgType;
+    callback.mExt1 = 0;
+    callback.mExt2 = 0;
+    callback.mTimestamp = timestamp;
+    callback.mData = data;
+    callback.mHasMetadata = false;
+    callback.mNumberOfFaces = 0;
+    post(callback);
+}
+
+// static
+bool CameraCallbackQueue::isDroppable(const Callback &callback) {
+    return callback.mKind == DATA
+        && ((callback.mMsgType & CAMERA_MSG_PREVIEW_FRAME)
+            || callback.mMsgType == CAMERA_MSG_PREVIEW_METADATA);
+}
+
+void CameraCallbackQueue::post(const Callback &callback) {
+    Mutex::Autolock lock(mLock);
+    if (exitPending()) return;
+
+    if (isDroppable(callback)) {
+        if (mQueuedPreviewFrames >= kMaxQueuedPreviewFrames) {
+            for (List<Callback>::iterator it = mQueue.begin();
+                    it != mQueue.end(); ++it) {
+                if (isDroppable(*it)) {
+                    mQueue.erase(it);
+                    --mQueuedPreviewFrames;
+                    ++mDroppedPreviewFrames;
+                    ALOGV("camera %d: dropped a preview callback (%d so far)",
+                            mCameraId, mDroppedPreviewFrames);
+                    break;
+                }
+            }
+        }
+        ++mQueuedPreviewFrames;
+    }
+
+    mQueue.push_back(callback);
+    if (mQueue.size() == kQueueWarningSize) {
+        ALOGW("camera %d: %d callbacks waiting for the client",
+                mCameraId, mQueue.size());
+    }
+    mCondition.signal();
+}
+
+void CameraCallbackQueue::stop() {
+    Mutex::Autolock lock(mLock);
+    requestExit();
+    mQueue.clear();
+    mQueuedPreviewFrames = 0;
+    mCondition.signal();
+
+    ALOGI_IF(mDroppedPreviewFrames > 0,
+            "camera %d: delivered %d callbacks, dropped %d preview callbacks",
+            mCameraId, mDeliveredCallbacks, mDroppedPreviewFrames);
+}
+
+bool CameraCallbackQueue::threadLoop() {
+    Callback callback;
+    {
+        Mutex::Autolock lock(mLock);
+        while (mQueue.empty() && !exitPending()) {
+            mCondition.wait(mLock);
+        }
+        if (exitPending()) return false;
+
+        callback = *mQueue.begin();
+        mQueue.erase(mQueue.begin());
+        if (isDroppable(callback)) {
+            --mQueuedPreviewFrames;
+        }
+        ++mDeliveredCallbacks;
+    }
+
+    switch (callback.mKind) {
+        case NOTIFY:
+            callback.mClient->notifyCallback(
+                    callback.mMsgType, callback.mExt1, callback.mExt2);
+            break;
+        case DATA:
+            if (callback.mHasMetadata) {
+                camera_frame_metadata_t metadata;
+                metadata.number_of_faces = callback.mNumberOfFaces;
+                metadata.faces = callback.mFaces.isEmpty()
+                        ? NULL : callback.mFaces.editArray();
+                callback.mClient->dataCallback(
+                        callback.mMsgType, callback.mData, &metadata);
+            } else {
+                callback.mClient->dataCallback(
+                        callback.mMsgType, callback.mData, NULL);
+            }
+            break;
+        case DATA_TIMESTAMP:
+            callback.mClient->dataCallbackTimestamp(
+                    callback.mTimestamp, callback.mMsgType, callback.mData);
+            break;
+    }
+    return true;
+}
+
+}; // namespace android
@@ -0,0 +1,100 @@
+/*
+ * Copyright (C) 2012 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_SERVERS_CAMERA_CAMERACALLBACKQUEUE_H
+#define ANDROID_SERVERS_CAMERA_CAMERACALLBACKQUEUE_H
+
+#include <binder/IMemory.h>
+#include <camera/ICameraClient.h>
+#include <system/camera.h>
+#include <utils/List.h>
+#include <utils/threads.h>
+#include <utils/Vector.h>
+
+namespace android {
+
+// Delivers callbacks to an ICameraClient on its own thread, so that the
+// HAL callback thread only has to queue them.
+// Preview frames and preview metadata are dropped oldest first once
+// kMaxQueuedPreviewFrames of them are waiting; every other callback
+// (recording frames, pictures, notifications) is kept.
+class CameraCallbackQueue : public Thread {
+public:
+    CameraCallbackQueue(int cameraId);
+
+    void postNotify(const sp<ICameraClient>& client,
+            int32_t msgType, int32_t ext1, int32_t ext2);
+    void postData(const sp<ICameraClient>& client,
+            int32_t msgType, const sp<IMemory>& data,
+            camera_frame_metadata_t *metadata);
+    void postDataTimestamp(const sp<ICameraClient>& client,
+            nsecs_t timestamp, int32_t msgType, const sp<IMemory>& data);
+
+    // Drops whatever is still queued and lets the thread exit. Doesn't wait
+    // for it, as a callback being delivered may call back into the camera.
+    void stop();
+
+protected:
+    virtual ~CameraCallbackQueue();
+
+private:
+    enum {
+        kMaxQueuedPreviewFrames = 2,
+        // logged when the lossless callbacks pile up beyond this
+        kQueueWarningSize = 32,
+    };
+
+    enum Kind {
+        NOTIFY,
+        DATA,
+        DATA_TIMESTAMP,
+    };
+
+    struct Callback {
+        Kind mKind;
+        sp<ICameraClient> mClient;
+        int32_t mMsgType;
+        int32_t mExt1;
+        int32_t mExt2;
+        nsecs_t mTimestamp;
+        sp<IMemory> mData;
+        // the HAL's metadata is only valid during its callback
+        bool mHasMetadata;
+        int32_t mNumberOfFaces;
+        Vector<camera_face_t> mFaces;
+    };
+
+    int mCameraId;
+
+    Mutex mLock;
+    Condition mCondition;
+    List<Callback> mQueue;
+    size_t mQueuedPreviewFrames;
+    size_t mDroppedPreviewFrames;
+    size_t mDeliveredCallbacks;
+
+    static bool isDroppable(const Callback &callback);
+    void post(const Callback &callback);
+
+    virtual bool threadLoop();
+
+    CameraCallbackQueue(const CameraCallbackQueue &);
+    CameraCallbackQueue &operator=(const CameraCallbackQueue &);
+};
+
+}; // namespace android
+
+#endif
@@ -397,6 +397,33 @@ public:
         return INVALID_OPERATION;
     }
 
+    /**
+     * Set the camera parameters from their flattened form, without parsing
+     * them first. */
+    status_t setParameters(const String8 &params)
+    {
+        ALOGV("%s(%s)", __FUNCTION__, mName.string());
+        if (mDevice->ops->set_parameters)
+            return mDevice->ops->set_parameters(mDevice, params.string());
+        return INVALID_OPERATION;
+    }
+
+    /** Return the camera parameters in flattened form, as the HAL reports them. */
+    String8 getParametersString() const
+    {
+        ALOGV("%s(%s)", __FUNCTION__, mName.string());
+        String8 str_parms;
+        if (mDevice->ops->get_parameters) {
+            char *temp = mDevice->ops->get_parameters(mDevice);
+            str_parms.setTo(temp);
+            if (mDevice->ops->put_parameters)
+                mDevice->ops->put_parameters(mDevice, temp);
+            else
+                free(temp);
+        }
+        return str_parms;
+    }
+
     /** Return the camera parameters. */
     CameraParameters getParameters() const
     {
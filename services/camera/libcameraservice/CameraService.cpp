@@ -40,6 +40,7 @@
 #include <utils/String16.h>
 #include <system/camera.h>
 #include "CameraService.h"
+#include "CameraCallbackQueue.h"
 #include "CameraHardwareInterface.h"
 
 namespace android {
@@ -383,6 +384,10 @@ CameraService::Client::Client(const sp<CameraService>& cameraService,
     mSurface = 0;
     mPreviewWindow = 0;
     mDestructionStarted = false;
+    mPreviewBufferSize = 0;
+    mOldestPreviewBuffer = 0;
+    mCallbackQueue = new CameraCallbackQueue(cameraId);
+    mCallbackQueue->run("CameraCallbacks");
     mHardware->setCallbacks(notifyCallback,
                             dataCallback,
                             dataCallbackTimestamp,
@@ -566,6 +571,7 @@ void CameraService::Client::disconnect() {
 #endif
     }
     mHardware.clear();
+    mCallbackQueue->stop();
 
     mCameraService->removeClient(mCameraClient);
     mCameraService->setCameraFree(mCameraId);
@@ -787,7 +793,7 @@ void CameraService::Client::stopPreview() {
     disableMsgType(CAMERA_MSG_PREVIEW_FRAME);
     mHardware->stopPreview();
 
-    mPreviewBuffer.clear();
+    clearPreviewBuffers_l();
 }
 
 // stop recording mode
@@ -801,7 +807,7 @@ void CameraService::Client::stopRecording() {
     disableMsgType(CAMERA_MSG_VIDEO_FRAME);
     mHardware->stopRecording();
 
-    mPreviewBuffer.clear();
+    clearPreviewBuffers_l();
 }
 
 // release a recording frame
@@ -926,8 +932,9 @@ status_t CameraService::Client::setParameters(const String8& params) {
     status_t result = checkPidAndHardware();
     if (result != NO_ERROR) return result;
 
-    CameraParameters p(params);
-    return mHardware->setParameters(p);
+    // the HAL parses the string itself, don't round-trip it through
+    // CameraParameters first
+    return mHardware->setParameters(params);
 }
 
 // get preview/capture parameters - key/value pairs
@@ -936,7 +943,7 @@ String8 CameraService::Client::getParameters() const {
     Mutex::Autolock lock(mLock);
     if (checkPidAndHardware() != NO_ERROR) return String8();
 
-    String8 params(mHardware->getParameters().flatten());
+    String8 params(mHardware->getParametersString());
     LOG1("getParameters (pid %d) (%s)", getCallingPid(), params.string());
     return params;
 }
@@ -1108,11 +1115,10 @@ CameraService::Client* CameraService::Client::getClientFromCookie(void* user) {
 //
 // NOTE: the *Callback functions grab mLock of the client before passing
 // control to handle* functions. So the handle* functions must release the
-// lock before calling the ICameraClient's callbacks, so those callbacks can
-// invoke methods in the Client class again (For example, the preview frame
-// callback may want to releaseRecordingFrame). The handle* functions must
-// release the lock after all accesses to member variables, so it must be
-// handled very carefully.
+// lock after all accesses to member variables, so it must be handled very
+// carefully. The ICameraClient's callbacks are posted to mCallbackQueue and
+// run on its thread, where they can invoke methods in the Client class again
+// (For example, the preview frame callback may want to releaseRecordingFrame).
 
 void CameraService::Client::notifyCallback(int32_t msgType, int32_t ext1,
         int32_t ext2, void* user) {
@@ -1219,9 +1225,7 @@ void CameraService::Client::handleShutter(void) {
 
     sp<ICameraClient> c = mCameraClient;
     if (c != 0) {
-        mLock.unlock();
-        c->notifyCallback(CAMERA_MSG_SHUTTER, 0, 0);
-        if (!lockIfMessageWanted(CAMERA_MSG_SHUTTER)) return;
+        mCallbackQueue->postNotify(c, CAMERA_MSG_SHUTTER, 0, 0);
     }
 #ifndef SAMSUNG_CAMERA_QCOM
     disableMsgType(CAMERA_MSG_SHUTTER);
@@ -1269,7 +1273,7 @@ void CameraService::Client::handlePreviewData(int32_t msgType,
         } else {
             LOG2("frame is forwarded");
             mLock.unlock();
-            c->dataCallback(msgType, mem, metadata);
+            mCallbackQueue->postData(c, msgType, mem, metadata);
         }
     } else {
         mLock.unlock();
@@ -1283,7 +1287,7 @@ void CameraService::Client::handlePostview(const sp<IMemory>& mem) {
     sp<ICameraClient> c = mCameraClient;
     mLock.unlock();
     if (c != 0) {
-        c->dataCallback(CAMERA_MSG_POSTVIEW_FRAME, mem, NULL);
+        mCallbackQueue->postData(c, CAMERA_MSG_POSTVIEW_FRAME, mem, NULL);
     }
 }
 
@@ -1298,7 +1302,7 @@ void CameraService::Client::handleRawPicture(const sp<IMemory>& mem) {
     sp<ICameraClient> c = mCameraClient;
     mLock.unlock();
     if (c != 0) {
-        c->dataCallback(CAMERA_MSG_RAW_IMAGE, mem, NULL);
+        mCallbackQueue->postData(c, CAMERA_MSG_RAW_IMAGE, mem, NULL);
     }
 }
 
@@ -1318,7 +1322,7 @@ void CameraService::Client::handleCompressedPicture(const sp<IMemory>& mem) {
     sp<ICameraClient> c = mCameraClient;
     mLock.unlock();
     if (c != 0) {
-        c->dataCallback(CAMERA_MSG_COMPRESSED_IMAGE, mem, NULL);
+        mCallbackQueue->postData(c, CAMERA_MSG_COMPRESSED_IMAGE, mem, NULL);
     }
 }
 
@@ -1332,7 +1336,7 @@ void CameraService::Client::handleCompressedBurstPicture(const sp<IMemory>& mem)
     sp<ICameraClient> c = mCameraClient;
     mLock.unlock();
     if (c != 0) {
-        c->dataCallback(CAMERA_MSG_COMPRESSED_IMAGE, mem, NULL);
+        mCallbackQueue->postData(c, CAMERA_MSG_COMPRESSED_IMAGE, mem, NULL);
     }
 }
 #endif
@@ -1342,7 +1346,7 @@ void CameraService::Client::handleGenericNotify(int32_t msgType,
     sp<ICameraClient> c = mCameraClient;
     mLock.unlock();
     if (c != 0) {
-        c->notifyCallback(msgType, ext1, ext2);
+        mCallbackQueue->postNotify(c, msgType, ext1, ext2);
     }
 }
 
@@ -1351,7 +1355,7 @@ void CameraService::Client::handleGenericData(int32_t msgType,
     sp<ICameraClient> c = mCameraClient;
     mLock.unlock();
     if (c != 0) {
-        c->dataCallback(msgType, dataPtr, metadata);
+        mCallbackQueue->postData(c, msgType, dataPtr, metadata);
     }
 }
 
@@ -1360,7 +1364,7 @@ void CameraService::Client::handleGenericDataTimestamp(nsecs_t timestamp,
     sp<ICameraClient> c = mCameraClient;
     mLock.unlock();
     if (c != 0) {
-        c->dataCallbackTimestamp(timestamp, msgType, dataPtr);
+        mCallbackQueue->postDataTimestamp(c, timestamp, msgType, dataPtr);
     }
 }
 
@@ -1370,36 +1374,62 @@ void CameraService::Client::copyFrameAndPostCopiedFrame(
         camera_frame_metadata_t *metadata) {
     LOG2("copyFrameAndPostCopiedFrame");
     // It is necessary to copy out of pmem before sending this to
-    // the callback. For efficiency, reuse the same MemoryHeapBase
-    // provided it's big enough. Don't allocate the memory or
+    // the callback. For efficiency, reuse a buffer from the pool
+    // provided the client is done with it. Don't allocate the memory or
     // perform the copy if there's no callback.
     // hold the preview lock while we grab a reference to the preview buffer
-    sp<MemoryHeapBase> previewBuffer;
-
-    if (mPreviewBuffer == 0) {
-        mPreviewBuffer = new MemoryHeapBase(size, 0, NULL);
-    } else if (size > mPreviewBuffer->virtualSize()) {
-        mPreviewBuffer.clear();
-        mPreviewBuffer = new MemoryHeapBase(size, 0, NULL);
-    }
-    if (mPreviewBuffer == 0) {
+    sp<MemoryBase> frame = getPreviewBuffer_l(size);
+    if (frame == 0) {
         ALOGE("failed to allocate space for preview buffer");
         mLock.unlock();
         return;
     }
-    previewBuffer = mPreviewBuffer;
 
-    memcpy(previewBuffer->base(), (uint8_t *)heap->base() + offset, size);
+    memcpy(frame->pointer(), (uint8_t *)heap->base() + offset, size);
 
-    sp<MemoryBase> frame = new MemoryBase(previewBuffer, 0, size);
-    if (frame == 0) {
-        ALOGE("failed to allocate space for frame callback");
-        mLock.unlock();
-        return;
+    mLock.unlock();
+    mCallbackQueue->postData(client, msgType, frame, metadata);
+}
+
+// Returns a buffer of the given size that nobody but the pool refers to.
+// Frames handed to the client hold a strong reference until the client
+// (through binder) releases them.
+sp<MemoryBase> CameraService::Client::getPreviewBuffer_l(size_t size) {
+    if (size != mPreviewBufferSize) {
+        clearPreviewBuffers_l();
+        mPreviewBufferSize = size;
     }
 
-    mLock.unlock();
-    client->dataCallback(msgType, frame, metadata);
+    for (size_t i = 0; i < mPreviewBuffers.size(); i++) {
+        if (mPreviewBuffers[i]->getStrongCount() == 1) {
+            return mPreviewBuffers[i];
+        }
+    }
+
+    if (mPreviewBuffers.size() < kMaxPreviewBuffers) {
+        sp<MemoryHeapBase> heap = new MemoryHeapBase(size, 0, NULL);
+        if (heap == 0 || heap->getHeapID() < 0) {
+            return NULL;
+        }
+        sp<MemoryBase> buffer = new MemoryBase(heap, 0, size);
+        mPreviewBuffers.push(buffer);
+        return buffer;
+    }
+
+    // The client holds on to every buffer, overwrite the oldest one as
+    // a single shared buffer would have been.
+    LOG2("all preview buffers in use, reusing buffer %d", mOldestPreviewBuffer);
+    sp<MemoryBase> buffer = mPreviewBuffers[mOldestPreviewBuffer];
+    mOldestPreviewBuffer = (mOldestPreviewBuffer + 1) % mPreviewBuffers.size();
+    return buffer;
+}
+
+void CameraService::Client::clearPreviewBuffers_l() {
+    mPreviewBuffers.clear();
+    mPreviewBufferSize = 0;
+    mOldestPreviewBuffer = 0;
+    mCallbackQueue = new CameraCallbackQueue(cameraId);
+    mCallbackQueue->run("CameraCallbacks");
 }
 
 int CameraService::Client::getOrientation(int degrees, bool mirror) {
@@ -31,8 +31,10 @@
 
 namespace android {
 
+class MemoryBase;
 class MemoryHeapBase;
 class MediaPlayer;
+class CameraCallbackQueue;
 class CameraHardwareInterface;
 
 class CameraService :
@@ -207,9 +209,22 @@ private:
         sp<IBinder>                     mSurface;
         sp<ANativeWindow>               mPreviewWindow;
 
+        // Callbacks to the ICameraClient go through here, so that the HAL
+        // callback thread doesn't wait for the client.
+        sp<CameraCallbackQueue>         mCallbackQueue;
+
         // If the user want us to return a copy of the preview frame (instead
-        // of the original one), we allocate mPreviewBuffer and reuse it if possible.
-        sp<MemoryHeapBase>              mPreviewBuffer;
+        // of the original one), frames are copied into a pool of buffers. A
+        // buffer is reused once the client has dropped its last reference to
+        // the frame, so a frame isn't overwritten while the client reads it.
+        enum { kMaxPreviewBuffers = 4 };
+        Vector<sp<MemoryBase> >         mPreviewBuffers;
+        size_t                          mPreviewBufferSize;
+        // the buffer reused when all of them are still held by the client
+        size_t                          mOldestPreviewBuffer;
+
+        sp<MemoryBase>                  getPreviewBuffer_l(size_t size);
+        void                            clearPreviewBuffers_l();
 
         // the instance is in the middle of destruction. When this is set,
         // the instance should not be accessed from callback.